@@ -34,15 +34,30 @@
 
 #include "util/ConstBuffer.hxx"
 #include "util/StringView.hxx"
+#include "util/Arena.hxx"
 
 #include <forward_list>
 #include <functional>
 #include <new>
+#include <type_traits>
 
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * A simplified memory pool: plain memory and trivially destructible
+ * objects are allocated from an #Arena; other objects are allocated
+ * on the heap and deleted by the destructor.
+ */
 class Allocator {
+    /**
+     * The size of the first arena chunk; most translation
+     * responses fit into it.
+     */
+    static constexpr size_t INITIAL_CHUNK_SIZE = 2048 - 32;
+
+    Arena arena{INITIAL_CHUNK_SIZE};
+
     std::forward_list<std::function<void()>> cleanup;
 
 public:
@@ -57,21 +72,12 @@ public:
     Allocator &operator=(Allocator &&src) = delete;
 
     void *Allocate(size_t size) {
-        void *p = malloc(size);
-        if (p == nullptr)
-            throw std::bad_alloc();
-
-        cleanup.emplace_front([p](){ free(p); });
-        return p;
+        return arena.Allocate(size);
     }
 
     char *Dup(const char *src) {
-        char *p = strdup(src);
-        if (p == nullptr)
-            throw std::bad_alloc();
-
-        cleanup.emplace_front([p](){ free(p); });
-        return p;
+        const size_t size = strlen(src) + 1;
+        return (char *)memcpy(Allocate(size), src, size);
     }
 
     const char *CheckDup(const char *src) {
@@ -88,19 +94,46 @@ public:
 
     template<typename T, typename... Args>
     T *New(Args&&... args) {
+        return NewImpl<T>(std::is_trivially_destructible<T>(),
+                          std::forward<Args>(args)...);
+    }
+
+    template<typename T>
+    T *NewArray(size_t n) {
+        return NewArrayImpl<T>(std::is_trivially_destructible<T>(), n);
+    }
+
+private:
+    template<typename T, typename... Args>
+    T *NewImpl(std::true_type, Args&&... args) {
+        return arena.New<T>(std::forward<Args>(args)...);
+    }
+
+    template<typename T, typename... Args>
+    T *NewImpl(std::false_type, Args&&... args) {
         auto p = new T(std::forward<Args>(args)...);
         cleanup.emplace_front([p](){ delete p; });
         return p;
     }
 
     template<typename T>
-    T *NewArray(size_t n) {
+    T *NewArrayImpl(std::true_type, size_t n) {
+        /* like a real pool, align all allocations (even
+           strings), because translation packet payloads are
+           accessed as integers */
+        T *p = (T *)arena.Allocate(sizeof(T) * n);
+        for (size_t i = 0; i < n; ++i)
+            ::new(p + i) T;
+        return p;
+    }
+
+    template<typename T>
+    T *NewArrayImpl(std::false_type, size_t n) {
         auto p = new T[n];
         cleanup.emplace_front([p](){ delete[] p; });
         return p;
     }
 
-private:
     template<typename... Args>
     static size_t ConcatLength(const char *s, Args... args) {
         return strlen(s) + ConcatLength(args...);
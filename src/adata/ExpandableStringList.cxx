@@ -40,21 +40,30 @@
 
 #include <algorithm>
 
-#include <assert.h>
+#include <string.h>
 
 ExpandableStringList::ExpandableStringList(AllocatorPtr alloc,
                                            const ExpandableStringList &src)
+    :size(src.size)
 {
-    Builder builder(*this);
+    if (size == 0)
+        return;
+
+    size_t total = 0;
+    for (size_t i = 0; i < size; ++i)
+        total += strlen(src.values[i]) + 1;
+
+    values = alloc.NewArray<const char *>(size);
+    char *p = alloc.NewArray<char>(total);
+    for (size_t i = 0; i < size; ++i) {
+        values[i] = p;
+        p = stpcpy(p, src.values[i]) + 1;
+    }
 
-    for (const auto *i = src.head; i != nullptr; i = i->next)
-        builder.Add(alloc, alloc.Dup(i->value),
 #if TRANSLATION_ENABLE_EXPAND
-                    i->expandable
-#else
-                    false
+    expandable = alloc.NewArray<bool>(size);
+    std::copy_n(src.expandable, size, expandable);
 #endif
-                    );
 }
 
 #if TRANSLATION_ENABLE_EXPAND
@@ -62,40 +71,60 @@ ExpandableStringList::ExpandableStringList(AllocatorPtr alloc,
 bool
 ExpandableStringList::IsExpandable() const
 {
-    for (const auto *i = head; i != nullptr; i = i->next)
-        if (i->expandable)
-            return true;
-
-    return false;
+    return std::find(expandable, expandable + size, true) !=
+        expandable + size;
 }
 
 void
 ExpandableStringList::Expand(AllocatorPtr alloc, const MatchInfo &match_info)
 {
-    for (auto *i = head; i != nullptr; i = i->next) {
-        if (!i->expandable)
-            continue;
-
-        i->value = expand_string_unescaped(alloc, i->value, match_info);
-    }
+    for (size_t i = 0; i < size; ++i)
+        if (expandable[i])
+            values[i] = expand_string_unescaped(alloc, values[i],
+                                                match_info);
 }
 
 #endif
 
+void
+ExpandableStringList::Builder::Grow(AllocatorPtr alloc)
+{
+    /* the old arrays are not freed; they are allocated from a
+       pool which is freed as a whole */
+    const size_t old_size = capacity > 0 ? list->size : 0;
+    capacity = capacity > 0 ? capacity * 2 : 8;
+
+    auto *new_values = alloc.NewArray<const char *>(capacity);
+    std::copy_n(list->values, old_size, new_values);
+    list->values = new_values;
+
+#if TRANSLATION_ENABLE_EXPAND
+    auto *new_expandable = alloc.NewArray<bool>(capacity);
+    std::copy_n(list->expandable, old_size, new_expandable);
+    list->expandable = new_expandable;
+#endif
+
+    list->size = old_size;
+}
+
 void
 ExpandableStringList::Builder::Add(AllocatorPtr alloc,
                                    const char *value, bool expandable)
 {
-    auto *item = last = alloc.New<Item>(value, expandable);
-    *tail_r = item;
-    tail_r = &item->next;
+    if (capacity == 0 || list->size == capacity)
+        Grow(alloc);
+
+    const size_t i = list->size++;
+    list->values[i] = value;
+#if TRANSLATION_ENABLE_EXPAND
+    list->expandable[i] = expandable;
+#else
+    (void)expandable;
+#endif
 }
 
 ConstBuffer<const char *>
-ExpandableStringList::ToArray(AllocatorPtr alloc) const
+ExpandableStringList::ToArray() const
 {
-    const size_t n = std::distance(begin(), end());
-    const char **p = alloc.NewArray<const char *>(n);
-    std::copy(begin(), end(), p);
-    return {p, n};
+    return {values, size};
 }
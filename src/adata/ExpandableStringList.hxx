@@ -38,30 +38,34 @@
 
 #include "util/Compiler.h"
 
-#include <iterator>
+#include <stddef.h>
 
 class AllocatorPtr;
 class MatchInfo;
 template<typename T> struct ConstBuffer;
 
+/**
+ * A list of strings, some of which may be marked "expandable".  The
+ * items are stored in one packed pointer array, so iterating it and
+ * converting it to an argv/envp array does not need to chase
+ * pointers.
+ */
 class ExpandableStringList final {
-    struct Item {
-        Item *next = nullptr;
-
-        const char *value;
+    /**
+     * The string pointers; #size elements are valid.  This array is
+     * shared by shallow copies.
+     */
+    const char **values = nullptr;
 
 #if TRANSLATION_ENABLE_EXPAND
-        bool expandable;
-
-        Item(const char *_value, bool _expandable)
-            :value(_value), expandable(_expandable) {}
-#else
-        Item(const char *_value, bool)
-            :value(_value) {}
+    /**
+     * A parallel array of #size flags specifying which item is
+     * expandable.
+     */
+    bool *expandable = nullptr;
 #endif
-    };
 
-    Item *head = nullptr;
+    size_t size = 0;
 
 public:
     ExpandableStringList() = default;
@@ -70,43 +74,31 @@ public:
 
     constexpr ExpandableStringList(ShallowCopy,
                                    const ExpandableStringList &src)
-        :head(src.head) {}
+        :values(src.values),
+#if TRANSLATION_ENABLE_EXPAND
+         expandable(src.expandable),
+#endif
+         size(src.size) {}
 
+    /**
+     * Deep copy.  The strings are copied into one contiguous
+     * buffer.
+     */
     ExpandableStringList(AllocatorPtr alloc, const ExpandableStringList &src);
 
     gcc_pure
     bool IsEmpty() const {
-        return head == nullptr;
+        return size == 0;
     }
 
-    class const_iterator final
-        : public std::iterator<std::forward_iterator_tag, const char *> {
-
-        const Item *cursor;
-
-    public:
-        const_iterator(const Item *_cursor):cursor(_cursor) {}
-
-        bool operator!=(const const_iterator &other) const {
-            return cursor != other.cursor;
-        }
-
-        const char *operator*() const {
-            return cursor->value;
-        }
-
-        const_iterator &operator++() {
-            cursor = cursor->next;
-            return *this;
-        }
-    };
+    typedef const char *const*const_iterator;
 
     const_iterator begin() const {
-        return {head};
+        return values;
     }
 
     const_iterator end() const {
-        return {nullptr};
+        return values + size;
     }
 
 #if TRANSLATION_ENABLE_EXPAND
@@ -114,42 +106,56 @@ public:
     bool IsExpandable() const;
 
     /**
+     * Expand all expandable items in place.
+     *
      * Throws std::runtime_error on error.
      */
     void Expand(AllocatorPtr alloc, const MatchInfo &match_info);
 #endif
 
     class Builder final {
-        Item **tail_r;
+        ExpandableStringList *list;
 
-        Item *last;
+        /**
+         * The number of items allocated in the list's arrays.  Zero
+         * means the arrays have not been allocated by this builder
+         * yet; the first Add() call discards the list's previous
+         * contents.
+         */
+        size_t capacity;
 
     public:
         Builder() = default;
 
         Builder(ExpandableStringList &_list)
-            :tail_r(&_list.head), last(nullptr) {}
+            :list(&_list), capacity(0) {}
 
         /**
          * Add a new item to the end of the list.  The allocator is only
-         * used to allocate the item structure, it does not copy the
-         * string.
+         * used to grow the arrays, it does not copy the string.
          */
         void Add(AllocatorPtr alloc, const char *value, bool expandable);
 
 #if TRANSLATION_ENABLE_EXPAND
         bool CanSetExpand() const {
-            return last != nullptr && !last->expandable;
+            return capacity > 0 && !list->expandable[list->size - 1];
         }
 
         void SetExpand(const char *value) const {
-            last->value = value;
-            last->expandable = true;
+            list->values[list->size - 1] = value;
+            list->expandable[list->size - 1] = true;
         }
 #endif
+
+    private:
+        void Grow(AllocatorPtr alloc);
     };
 
-    ConstBuffer<const char *> ToArray(AllocatorPtr alloc) const;
+    /**
+     * Returns the list as an array.  This is a view of the list's
+     * internal storage and does not allocate.
+     */
+    ConstBuffer<const char *> ToArray() const;
 };
 
 #endif
@@ -87,6 +87,14 @@ public:
 		return handle;
 	}
 
+	/**
+	 * Reset all options to their defaults, but keep live
+	 * connections and internal buffers (curl_easy_reset()).
+	 */
+	void Reset() noexcept {
+		curl_easy_reset(handle);
+	}
+
 	template<typename T>
 	void SetOption(CURLoption option, T value) {
 		CURLcode code = curl_easy_setopt(handle, option, value);
@@ -98,6 +106,10 @@ public:
 		SetOption(CURLOPT_PRIVATE, pointer);
 	}
 
+	void SetShare(CURLSH *share) {
+		SetOption(CURLOPT_SHARE, share);
+	}
+
 	void SetErrorBuffer(char *buf) {
 		SetOption(CURLOPT_ERRORBUFFER, buf);
 	}
@@ -134,6 +146,39 @@ public:
 		SetOption(CURLOPT_CONNECTTIMEOUT, timeout);
 	}
 
+	/**
+	 * @param version one of the CURL_HTTP_VERSION_* constants
+	 */
+	void SetHttpVersion(long version) {
+		SetOption(CURLOPT_HTTP_VERSION, version);
+	}
+
+#if LIBCURL_VERSION_NUM >= 0x072b00
+	/**
+	 * Wait for a connection which can be multiplexed instead of
+	 * opening a new one?
+	 */
+	void SetPipeWait(bool value=true) {
+		SetOption(CURLOPT_PIPEWAIT, (long)value);
+	}
+#endif
+
+	/**
+	 * Close the connection after this transfer instead of
+	 * returning it to the connection cache?
+	 */
+	void SetForbidReuse(bool value=true) {
+		SetOption(CURLOPT_FORBID_REUSE, (long)value);
+	}
+
+	/**
+	 * Open a new connection instead of using one from the
+	 * connection cache?
+	 */
+	void SetFreshConnect(bool value=true) {
+		SetOption(CURLOPT_FRESH_CONNECT, (long)value);
+	}
+
 	void SetHeaderFunction(size_t (*function)(char *buffer, size_t size,
 						  size_t nitems,
 						  void *userdata),
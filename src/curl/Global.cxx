@@ -110,14 +110,81 @@ private:
 
 CurlGlobal::CurlGlobal(EventLoop &_loop)
 	:event_loop(_loop),
+	 easy_pool_limit(DEFAULT_EASY_POOL_SIZE),
 	 read_info_event(_loop, BIND_THIS_METHOD(OnDeferredReadInfo)),
 	 timeout_event(event_loop, BIND_THIS_METHOD(OnTimeout))
 {
+	easy_pool.reserve(easy_pool_limit);
+
 	multi.SetOption(CURLMOPT_SOCKETFUNCTION, CurlSocket::SocketFunction);
 	multi.SetOption(CURLMOPT_SOCKETDATA, this);
 
 	multi.SetOption(CURLMOPT_TIMERFUNCTION, TimerFunction);
 	multi.SetOption(CURLMOPT_TIMERDATA, this);
+
+	own_share.Share(CURL_LOCK_DATA_DNS);
+	own_share.Share(CURL_LOCK_DATA_SSL_SESSION);
+}
+
+CurlGlobal::CurlGlobal(EventLoop &_loop, const Config &config)
+	:CurlGlobal(_loop)
+{
+	Configure(config);
+}
+
+void
+CurlGlobal::Configure(const Config &config)
+{
+	if (config.multiplex) {
+#ifdef CURLPIPE_MULTIPLEX
+		multi.SetOption(CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#else
+		throw std::runtime_error("libcurl is too old for HTTP/2 multiplexing");
+#endif
+	}
+
+	if (config.max_host_connections > 0)
+		multi.SetOption(CURLMOPT_MAX_HOST_CONNECTIONS,
+				long(config.max_host_connections));
+
+	if (config.max_total_connections > 0)
+		multi.SetOption(CURLMOPT_MAX_TOTAL_CONNECTIONS,
+				long(config.max_total_connections));
+
+	if (config.max_connects > 0)
+		multi.SetOption(CURLMOPT_MAXCONNECTS,
+				long(config.max_connects));
+
+	if (config.share != nullptr)
+		share = config.share;
+
+	easy_pool_limit = config.easy_pool_size;
+	easy_pool.reserve(easy_pool_limit);
+	if (easy_pool.size() > easy_pool_limit)
+		easy_pool.erase(std::next(easy_pool.begin(), easy_pool_limit),
+				easy_pool.end());
+}
+
+CurlEasy
+CurlGlobal::AllocateEasy()
+{
+	if (easy_pool.empty())
+		return CurlEasy();
+
+	CurlEasy easy = std::move(easy_pool.back());
+	easy_pool.pop_back();
+	return easy;
+}
+
+void
+CurlGlobal::RecycleEasy(CurlEasy &&easy) noexcept
+{
+	if (!easy || easy_pool.size() >= easy_pool_limit)
+		/* pool is full: let the destructor free it */
+		return;
+
+	easy.Reset();
+	easy_pool.push_back(std::move(easy));
 }
 
 int
@@ -157,6 +224,7 @@ CurlGlobal::Add(CurlRequest &r)
 		throw FormatRuntimeError("curl_multi_add_handle() failed: %s",
 					 curl_multi_strerror(mcode));
 
+	n_active.fetch_add(1, std::memory_order_relaxed);
 	InvalidateSockets();
 }
 
@@ -164,6 +232,7 @@ void
 CurlGlobal::Remove(CurlRequest &r)
 {
 	curl_multi_remove_handle(multi.Get(), r.Get());
+	n_active.fetch_sub(1, std::memory_order_relaxed);
 	InvalidateSockets();
 }
 
@@ -30,31 +30,184 @@
 #ifndef CURL_GLOBAL_HXX
 #define CURL_GLOBAL_HXX
 
+#include "Easy.hxx"
 #include "Multi.hxx"
+#include "Share.hxx"
 #include "event/TimerEvent.hxx"
 #include "event/DeferEvent.hxx"
 
+#include <atomic>
+#include <vector>
+
 class CurlSocket;
 class CurlRequest;
+class CurlInstrumentation;
 
 /**
  * Manager for the global CURLM object.
  */
 class CurlGlobal final {
+public:
+	static constexpr unsigned DEFAULT_EASY_POOL_SIZE = 16;
+
+	/**
+	 * Tuning parameters for the CURLM object.  A zero value means
+	 * the libcurl default.
+	 */
+	struct Config {
+		/**
+		 * Multiplex transfers to the same host over one
+		 * HTTP/2 connection (CURLMOPT_PIPELINING)?  This
+		 * applies only to requests which have called
+		 * CurlRequest::EnableHttp2().  If false, the libcurl
+		 * default is used.
+		 */
+		bool multiplex;
+
+		/**
+		 * The maximum number of connections to one host
+		 * (CURLMOPT_MAX_HOST_CONNECTIONS).  Further transfers
+		 * are queued by libcurl.
+		 */
+		unsigned max_host_connections;
+
+		/**
+		 * The maximum number of connections in total
+		 * (CURLMOPT_MAX_TOTAL_CONNECTIONS).
+		 */
+		unsigned max_total_connections;
+
+		/**
+		 * The maximum number of idle connections kept in the
+		 * connection cache (CURLMOPT_MAXCONNECTS).
+		 */
+		unsigned max_connects;
+
+		/**
+		 * If set, then requests created after Configure() use
+		 * this object instead of the #CurlGlobal's own one,
+		 * which shares the DNS cache and TLS session ids only
+		 * within this #CurlGlobal.  This allows sharing them
+		 * with #CurlGlobal instances in other threads; in that
+		 * case, CurlShare::EnableLocking() must have been
+		 * called.  The object is owned by the caller and must
+		 * outlive this #CurlGlobal, which keeps idle "easy"
+		 * handles attached to it.
+		 */
+		CurlShare *share;
+
+		/**
+		 * The maximum number of idle "easy" handles kept for
+		 * new requests.  0 disables recycling.
+		 */
+		unsigned easy_pool_size;
+
+		Config() noexcept
+			:multiplex(false),
+			 max_host_connections(0), max_total_connections(0),
+			 max_connects(0), share(nullptr),
+			 easy_pool_size(DEFAULT_EASY_POOL_SIZE) {}
+	};
+
+private:
 	EventLoop &event_loop;
 
+	/**
+	 * The default for #share.
+	 */
+	CurlShare own_share;
+
+	/**
+	 * The share handle passed to new requests.
+	 */
+	CurlShare *share = &own_share;
+
 	CurlMulti multi;
 
+	/**
+	 * Idle "easy" handles which have been reset, for
+	 * AllocateEasy().  Its capacity is at least
+	 * #easy_pool_limit, so RecycleEasy() never allocates.
+	 */
+	std::vector<CurlEasy> easy_pool;
+
+	std::size_t easy_pool_limit;
+
+	CurlInstrumentation *instrumentation = nullptr;
+
+	/**
+	 * The number of requests registered with Add().  This is
+	 * atomic because other threads may read it to balance load
+	 * (see #CurlGlobalPool).
+	 */
+	std::atomic<unsigned> n_active{0};
+
 	DeferEvent read_info_event;
 	TimerEvent timeout_event;
 
 public:
 	explicit CurlGlobal(EventLoop &_loop);
 
+	/**
+	 * Throws std::runtime_error if libcurl rejects the
+	 * configuration.
+	 */
+	CurlGlobal(EventLoop &_loop, const Config &config);
+
+	/**
+	 * Apply a new configuration.  It affects only connections
+	 * created after this call.
+	 *
+	 * Throws std::runtime_error if libcurl rejects the
+	 * configuration.
+	 */
+	void Configure(const Config &config);
+
 	EventLoop &GetEventLoop() {
 		return event_loop;
 	}
 
+	CurlShare &GetShare() {
+		return *share;
+	}
+
+	/**
+	 * Install (or, with nullptr, remove) an object which collects
+	 * the #CurlTiming of all requests.  The object is owned by
+	 * the caller.
+	 */
+	void SetInstrumentation(CurlInstrumentation *_instrumentation) noexcept {
+		instrumentation = _instrumentation;
+	}
+
+	CurlInstrumentation *GetInstrumentation() noexcept {
+		return instrumentation;
+	}
+
+	/**
+	 * Obtain an "easy" handle for a new request: a recycled one
+	 * if available, or a new one.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	CurlEasy AllocateEasy();
+
+	/**
+	 * Return an "easy" handle which is no longer used, to be
+	 * reset and reused by AllocateEasy().  This keeps libcurl's
+	 * per-handle allocations.  It must not be registered in the
+	 * CURLM.
+	 */
+	void RecycleEasy(CurlEasy &&easy) noexcept;
+
+	/**
+	 * Returns the number of running requests.  This method is
+	 * thread-safe, but the value is only a snapshot.
+	 */
+	unsigned GetActiveCount() const noexcept {
+		return n_active.load(std::memory_order_relaxed);
+	}
+
 	void Add(CurlRequest &r);
 	void Remove(CurlRequest &r);
 
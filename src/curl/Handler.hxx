@@ -30,19 +30,57 @@
 #ifndef CURL_HANDLER_HXX
 #define CURL_HANDLER_HXX
 
+#include "Headers.hxx"
+#include "Timing.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
 
 #include <exception>
-#include <string>
-#include <map>
 
 class CurlResponseHandler {
 public:
+	/**
+	 * @param headers the response headers; they remain valid
+	 * until the #CurlRequest is destroyed; use
+	 * CurlHeaders::ToMultimap() to keep a copy
+	 */
 	virtual void OnHeaders(unsigned status,
-			       std::multimap<std::string, std::string> &&headers) = 0;
+			       const CurlHeaders &headers) = 0;
 	virtual void OnData(ConstBuffer<void> data) = 0;
 	virtual void OnEnd() = 0;
 	virtual void OnError(std::exception_ptr e) = 0;
+
+	/**
+	 * The transfer has finished (successfully or not); this is
+	 * called right before OnEnd() or OnError().  The
+	 * #CurlRequest must not be destroyed by this method.
+	 */
+	virtual void OnTiming(const CurlTiming &) noexcept {}
+};
+
+/**
+ * Receives the response body of a #CurlRequest with flow control,
+ * instead of CurlResponseHandler::OnData(); see
+ * CurlRequest::SetBodySink().  The body is copied from libcurl's
+ * receive buffer directly into the buffers provided by this object.
+ */
+class CurlBodySink {
+public:
+	/**
+	 * Returns the buffer the next part of the body shall be
+	 * copied to.  Returning an empty buffer pauses the transfer;
+	 * call CurlRequest::Resume() as soon as there is room again.
+	 */
+	virtual WritableBuffer<void> GetBodyBuffer() noexcept = 0;
+
+	/**
+	 * The given number of bytes have been copied to the buffer
+	 * returned by GetBodyBuffer().
+	 *
+	 * Exceptions thrown by this method abort the request, and
+	 * are passed to CurlResponseHandler::OnError().
+	 */
+	virtual void OnBodyAppended(size_t nbytes) = 0;
 };
 
 #endif
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2008-2017 Max Kellermann <max@duempel.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "HeaderList.hxx"
+
+#include <new>
+
+#include <string.h>
+
+CurlHeaderTemplate::CurlHeaderTemplate(std::initializer_list<const char *> headers)
+{
+	if (headers.size() == 0)
+		return;
+
+	/* one block: the nodes first (for alignment), then the
+	   strings */
+	size_t size = headers.size() * sizeof(struct curl_slist);
+	for (const char *i : headers)
+		size += strlen(i) + 1;
+
+	buffer.reset(new char[size]);
+
+	auto *nodes = reinterpret_cast<struct curl_slist *>(buffer.get());
+	char *p = buffer.get() + headers.size() * sizeof(*nodes);
+
+	struct curl_slist *node = nodes;
+	for (const char *i : headers) {
+		const size_t length = strlen(i) + 1;
+		memcpy(p, i, length);
+
+		node = new(node) struct curl_slist;
+		node->data = p;
+		node->next = node + 1;
+		++node;
+
+		p += length;
+	}
+
+	node[-1].next = nullptr;
+	head = nodes;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2008-2017 Max Kellermann <max@duempel.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CURL_HEADER_LIST_HXX
+#define CURL_HEADER_LIST_HXX
+
+#include <curl/curl.h>
+
+#include <array>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+
+#include <stddef.h>
+
+/**
+ * An immutable list of request headers which is built once and may
+ * then be used by many transfers at the same time (e.g. shared with
+ * std::shared_ptr).  Unlike #CurlSlist, all strings and list nodes
+ * are allocated in one block, and using the list does not allocate
+ * anything.
+ *
+ * This relies on libcurl never modifying a CURLOPT_HTTPHEADER list.
+ */
+class CurlHeaderTemplate {
+	std::unique_ptr<char[]> buffer;
+
+	struct curl_slist *head = nullptr;
+
+public:
+	/**
+	 * @param headers the header lines (e.g. "Accept: text/html");
+	 * they are copied
+	 */
+	explicit CurlHeaderTemplate(std::initializer_list<const char *> headers);
+
+	CurlHeaderTemplate(const CurlHeaderTemplate &) = delete;
+	CurlHeaderTemplate &operator=(const CurlHeaderTemplate &) = delete;
+
+	bool empty() const noexcept {
+		return head == nullptr;
+	}
+
+	/**
+	 * Returns the list for CurlEasy::SetRequestHeaders().  It
+	 * remains owned by this object, and must not be modified.
+	 */
+	struct curl_slist *Get() const noexcept {
+		return head;
+	}
+};
+
+/**
+ * A small per-request list of request headers which get sent in
+ * addition to a #CurlHeaderTemplate.  It stores only pointers to the
+ * caller's strings in a fixed-size array, and does not allocate any
+ * memory.
+ *
+ * The header strings and the template must remain valid until the
+ * transfer is finished, and so must this object (it must not be
+ * moved after Get() has been called).
+ */
+template<size_t max_size=8>
+class CurlHeaderOverlay {
+	/**
+	 * The list which gets appended to our own headers; may be
+	 * nullptr.
+	 */
+	struct curl_slist *const tail;
+
+	std::array<struct curl_slist, max_size> nodes;
+
+	size_t n = 0;
+
+public:
+	explicit CurlHeaderOverlay(const CurlHeaderTemplate *base=nullptr) noexcept
+		:tail(base != nullptr ? base->Get() : nullptr) {}
+
+	CurlHeaderOverlay(const CurlHeaderOverlay &) = delete;
+	CurlHeaderOverlay &operator=(const CurlHeaderOverlay &) = delete;
+
+	bool empty() const noexcept {
+		return n == 0 && tail == nullptr;
+	}
+
+	/**
+	 * Add a header line.  The string is not copied.
+	 *
+	 * Throws std::runtime_error if the overlay is full.
+	 */
+	void Append(const char *value) {
+		if (n >= max_size)
+			throw std::runtime_error("Too many request headers");
+
+		/* libcurl does not modify the string */
+		nodes[n++].data = const_cast<char *>(value);
+	}
+
+	/**
+	 * Returns the combined list (our own headers first, then the
+	 * template's) for CurlEasy::SetRequestHeaders().
+	 */
+	struct curl_slist *Get() noexcept {
+		if (n == 0)
+			return tail;
+
+		for (size_t i = 0; i + 1 < n; ++i)
+			nodes[i].next = &nodes[i + 1];
+		nodes[n - 1].next = tail;
+		return &nodes.front();
+	}
+};
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2016-2017 Max Kellermann <max@duempel.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "Headers.hxx"
+#include "util/CharUtil.hxx"
+
+#include <algorithm>
+
+#include <string.h>
+
+void
+CurlHeaders::Add(StringView name, StringView value)
+{
+	/* one allocation for both strings */
+	char *p = (char *)arena.Allocate(name.size + value.size, 1);
+
+	std::transform(name.begin(), name.end(), p, ToLowerASCII);
+	memcpy(p + name.size, value.data, value.size);
+
+	list.push_back({{p, name.size}, {p + name.size, value.size}});
+}
+
+StringView
+CurlHeaders::Get(StringView name) const noexcept
+{
+	for (const auto &i : list)
+		if (i.name.Equals(name))
+			return i.value;
+
+	return nullptr;
+}
+
+std::multimap<std::string, std::string>
+CurlHeaders::ToMultimap() const
+{
+	std::multimap<std::string, std::string> result;
+	for (const auto &i : list)
+		result.emplace(std::string(i.name.data, i.name.size),
+			       std::string(i.value.data, i.value.size));
+	return result;
+}
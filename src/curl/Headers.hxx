@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2016-2017 Max Kellermann <max@duempel.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef CURL_HEADERS_HXX
+#define CURL_HEADERS_HXX
+
+#include "util/Arena.hxx"
+#include "util/StringView.hxx"
+#include "util/Compiler.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * The response headers of a #CurlRequest.  Names and values are
+ * copied into one #Arena, and names are converted to lower case.
+ */
+class CurlHeaders {
+public:
+	struct Header {
+		/**
+		 * The header name in lower case.
+		 */
+		StringView name;
+
+		StringView value;
+	};
+
+private:
+	Arena arena;
+
+	std::vector<Header> list;
+
+public:
+	CurlHeaders() noexcept
+		:arena(4096) {}
+
+	CurlHeaders(const CurlHeaders &) = delete;
+	CurlHeaders &operator=(const CurlHeaders &) = delete;
+
+	bool empty() const noexcept {
+		return list.empty();
+	}
+
+	size_t size() const noexcept {
+		return list.size();
+	}
+
+	typedef std::vector<Header>::const_iterator const_iterator;
+
+	const_iterator begin() const noexcept {
+		return list.begin();
+	}
+
+	const_iterator end() const noexcept {
+		return list.end();
+	}
+
+	void Clear() noexcept {
+		list.clear();
+		arena.Clear();
+	}
+
+	/**
+	 * Copy a header into this object.  The name is converted to
+	 * lower case.
+	 *
+	 * Throws std::bad_alloc on error.
+	 */
+	void Add(StringView name, StringView value);
+
+	/**
+	 * Look up the first header with the given name.
+	 *
+	 * @param name the header name in lower case
+	 * @return the value or nullptr if there is no such header
+	 */
+	gcc_pure
+	StringView Get(StringView name) const noexcept;
+
+	/**
+	 * Copy all headers into a new std::multimap.
+	 */
+	std::multimap<std::string, std::string> ToMultimap() const;
+};
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2016-2017 Max Kellermann <max@duempel.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "Instrumentation.hxx"
+#include "Timing.hxx"
+
+void
+CurlInstrumentation::Clear() noexcept
+{
+	n_requests = n_errors = n_reused = 0;
+	bytes_sent = bytes_received = 0;
+
+	name_lookup.Clear();
+	connect.Clear();
+	tls.Clear();
+	wait.Clear();
+	transfer.Clear();
+	total.Clear();
+}
+
+void
+CurlInstrumentation::Add(const CurlTiming &t, bool error) noexcept
+{
+	++n_requests;
+	if (error)
+		++n_errors;
+
+	bytes_sent += t.bytes_sent;
+	bytes_received += t.bytes_received;
+
+	if (t.IsReused()) {
+		++n_reused;
+	} else {
+		name_lookup.Add(t.GetNameLookup());
+		connect.Add(t.GetConnect());
+		if (t.app_connect > t.app_connect.zero())
+			tls.Add(t.GetTLS());
+	}
+
+	wait.Add(t.GetWait());
+	transfer.Add(t.GetTransfer());
+	total.Add(t.total);
+}
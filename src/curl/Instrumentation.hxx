@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2016-2017 Max Kellermann <max@duempel.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef CURL_INSTRUMENTATION_HXX
+#define CURL_INSTRUMENTATION_HXX
+
+#include "util/Log2Histogram.hxx"
+
+#include <stdint.h>
+
+struct CurlTiming;
+
+/**
+ * Collects statistics about all requests of a #CurlGlobal.  Install
+ * it with CurlGlobal::SetInstrumentation().
+ */
+class CurlInstrumentation {
+public:
+	uint64_t n_requests = 0, n_errors = 0;
+
+	/**
+	 * The number of requests which reused a cached connection.
+	 */
+	uint64_t n_reused = 0;
+
+	uint64_t bytes_sent = 0, bytes_received = 0;
+
+	/**
+	 * Histograms of the phases described by #CurlTiming.  The
+	 * connection phases (#name_lookup, #connect, #tls) only count
+	 * requests which have created a new connection.
+	 */
+	Log2Histogram name_lookup, connect, tls, wait, transfer, total;
+
+	void Clear() noexcept;
+
+	void Add(const CurlTiming &t, bool error) noexcept;
+};
+
+#endif
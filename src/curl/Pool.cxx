@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2016-2017 Max Kellermann <max@duempel.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "Pool.hxx"
+#include "event/Pool.hxx"
+#include "event/InjectEvent.hxx"
+
+#include <mutex>
+
+#include <assert.h>
+
+class CurlGlobalPool::Shard {
+public:
+	CurlGlobal global;
+
+private:
+	std::mutex mutex;
+
+	/**
+	 * Functions submitted by other threads, protected by
+	 * #mutex.
+	 */
+	std::vector<Function> queue;
+
+	/**
+	 * The number of functions in #queue; for GetLoad().
+	 */
+	std::atomic<unsigned> n_queued{0};
+
+	InjectEvent inject_event;
+
+public:
+	Shard(EventLoop &loop, const CurlGlobal::Config &config)
+		:global(loop, config),
+		 inject_event(loop, BIND_THIS_METHOD(OnInject)) {}
+
+	EventLoop &GetEventLoop() noexcept {
+		return global.GetEventLoop();
+	}
+
+	unsigned GetLoad() const noexcept {
+		return global.GetActiveCount() +
+			n_queued.load(std::memory_order_relaxed);
+	}
+
+	void Post(Function &&f) {
+		{
+			const std::lock_guard<std::mutex> lock(mutex);
+			queue.emplace_back(std::move(f));
+		}
+
+		n_queued.fetch_add(1, std::memory_order_relaxed);
+		inject_event.Schedule();
+	}
+
+private:
+	void OnInject() noexcept {
+		std::vector<Function> q;
+
+		{
+			const std::lock_guard<std::mutex> lock(mutex);
+			q.swap(queue);
+		}
+
+		for (auto &f : q) {
+			n_queued.fetch_sub(1, std::memory_order_relaxed);
+			f(global);
+		}
+	}
+};
+
+CurlGlobalPool::CurlGlobalPool(EventLoopPool &pool, CurlGlobal::Config config,
+			       unsigned _max_imbalance)
+	:max_imbalance(_max_imbalance)
+{
+	share.EnableLocking();
+	share.Share(CURL_LOCK_DATA_DNS);
+	share.Share(CURL_LOCK_DATA_SSL_SESSION);
+
+	config.share = &share;
+
+	shards.reserve(pool.size());
+	pool.ForEach([this, &config](EventLoop &loop){
+			shards.emplace_back(new Shard(loop, config));
+		});
+}
+
+CurlGlobalPool::~CurlGlobalPool() noexcept = default;
+
+CurlGlobal &
+CurlGlobalPool::Get(unsigned i) noexcept
+{
+	assert(i < shards.size());
+
+	return shards[i]->global;
+}
+
+CurlGlobal *
+CurlGlobalPool::Find(const EventLoop &loop) noexcept
+{
+	for (auto &i : shards)
+		if (&i->GetEventLoop() == &loop)
+			return &i->global;
+
+	return nullptr;
+}
+
+unsigned
+CurlGlobalPool::Select(const EventLoop *caller) noexcept
+{
+	assert(!shards.empty());
+
+	unsigned best = 0, best_load = shards.front()->GetLoad();
+	unsigned own = shards.size(), own_load = 0;
+
+	for (unsigned i = 0; i < shards.size(); ++i) {
+		const unsigned load = i == 0
+			? best_load
+			: shards[i]->GetLoad();
+
+		if (load < best_load) {
+			best = i;
+			best_load = load;
+		}
+
+		if (caller == &shards[i]->GetEventLoop()) {
+			own = i;
+			own_load = load;
+		}
+	}
+
+	if (own < shards.size() && own_load <= best_load + max_imbalance)
+		return own;
+
+	return best;
+}
+
+void
+CurlGlobalPool::Submit(const EventLoop *caller, Function f)
+{
+	auto &shard = *shards[Select(caller)];
+
+	if (caller == &shard.GetEventLoop())
+		f(shard.global);
+	else
+		shard.Post(std::move(f));
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2016-2017 Max Kellermann <max@duempel.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef CURL_POOL_HXX
+#define CURL_POOL_HXX
+
+#include "Global.hxx"
+#include "Share.hxx"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+class EventLoop;
+class EventLoopPool;
+
+/**
+ * One #CurlGlobal for each #EventLoop of an #EventLoopPool.  All
+ * instances share the DNS cache and TLS session ids through one
+ * (locked) #CurlShare, while connections stay local to each thread.
+ *
+ * Construct this object after the #EventLoopPool and before
+ * EventLoopPool::Start(), and destroy it after EventLoopPool::Stop().
+ *
+ * A #CurlRequest must be created, started and destroyed in the
+ * thread of its #CurlGlobal.  Submit() picks an instance and runs a
+ * function in its thread, which is where the request shall be
+ * created.
+ */
+class CurlGlobalPool {
+	CurlShare share;
+
+	class Shard;
+	std::vector<std::unique_ptr<Shard>> shards;
+
+	/**
+	 * @see Select()
+	 */
+	const unsigned max_imbalance;
+
+public:
+	typedef std::function<void(CurlGlobal &global)> Function;
+
+	/**
+	 * Throws on error.
+	 *
+	 * @param config the configuration of each #CurlGlobal; its
+	 * "share" attribute is ignored
+	 * @param _max_imbalance see Select()
+	 */
+	CurlGlobalPool(EventLoopPool &pool, CurlGlobal::Config config,
+		       unsigned _max_imbalance=16);
+
+	~CurlGlobalPool() noexcept;
+
+	CurlGlobalPool(const CurlGlobalPool &) = delete;
+	CurlGlobalPool &operator=(const CurlGlobalPool &) = delete;
+
+	unsigned size() const noexcept {
+		return shards.size();
+	}
+
+	CurlGlobal &Get(unsigned i) noexcept;
+
+	/**
+	 * Find the instance running in the given #EventLoop.
+	 *
+	 * @return nullptr if the #EventLoop is not part of this pool
+	 */
+	gcc_pure
+	CurlGlobal *Find(const EventLoop &loop) noexcept;
+
+	/**
+	 * Choose an instance for a new request: the one of the
+	 * caller's #EventLoop, unless its load exceeds the least
+	 * loaded one's by more than #max_imbalance requests.  The
+	 * load is the number of running and submitted requests.
+	 * This method is thread-safe.
+	 *
+	 * @param caller the caller's #EventLoop or nullptr if the
+	 * caller is not an #EventLoop thread of this pool
+	 */
+	gcc_pure
+	unsigned Select(const EventLoop *caller) noexcept;
+
+	/**
+	 * Invoke the given function in the thread of the instance
+	 * chosen by Select().  If that is the caller's own
+	 * #EventLoop, it is invoked right away; else it is queued and
+	 * the other #EventLoop is woken up.  This method is
+	 * thread-safe.
+	 *
+	 * The function must not throw.
+	 *
+	 * Throws std::bad_alloc on error.
+	 */
+	void Submit(const EventLoop *caller, Function f);
+};
+
+#endif
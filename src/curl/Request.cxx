@@ -31,10 +31,10 @@
 #include "Global.hxx"
 #include "Version.hxx"
 #include "Handler.hxx"
+#include "Instrumentation.hxx"
 #include "util/RuntimeError.hxx"
 #include "util/StringUtil.hxx"
 #include "util/StringView.hxx"
-#include "util/CharUtil.hxx"
 
 #include <curl/curl.h>
 
@@ -45,8 +45,9 @@
 
 CurlRequest::CurlRequest(CurlGlobal &_global, const char *url,
 			 CurlResponseHandler &_handler)
-	:CurlRequest(_global, CurlEasy(url), _handler)
+	:CurlRequest(_global, _global.AllocateEasy(), _handler)
 {
+	easy.SetURL(url);
 }
 
 CurlRequest::CurlRequest(CurlGlobal &_global, CurlEasy &&_easy,
@@ -59,6 +60,7 @@ CurlRequest::CurlRequest(CurlGlobal &_global, CurlEasy &&_easy,
 	error_buffer[0] = 0;
 
 	easy.SetPrivate((void *)this);
+	easy.SetShare(global.GetShare().Get());
 	easy.SetUserAgent(PACKAGE " " VERSION);
 	easy.SetHeaderFunction(_HeaderFunction, this);
 	easy.SetWriteFunction(WriteFunction, this);
@@ -73,6 +75,17 @@ CurlRequest::~CurlRequest()
 	FreeEasy();
 }
 
+void
+CurlRequest::EnableHttp2()
+{
+#if LIBCURL_VERSION_NUM >= 0x072f00
+	easy.SetHttpVersion(CURL_HTTP_VERSION_2TLS);
+	easy.SetPipeWait();
+#else
+	throw std::runtime_error("libcurl is too old for HTTP/2");
+#endif
+}
+
 void
 CurlRequest::Start()
 {
@@ -99,6 +112,7 @@ CurlRequest::FreeEasy()
 		return;
 
 	Stop();
+	global.RecycleEasy(std::move(easy));
 	easy = nullptr;
 }
 
@@ -129,7 +143,7 @@ CurlRequest::FinishHeaders()
 	long status = 0;
 	easy.GetInfo(CURLINFO_RESPONSE_CODE, &status);
 
-	handler.OnHeaders(status, std::move(headers));
+	handler.OnHeaders(status, headers);
 }
 
 void
@@ -149,6 +163,12 @@ CurlRequest::Done(CURLcode result)
 {
 	Stop();
 
+	const auto timing = CurlTiming::Read(easy);
+	auto *instrumentation = global.GetInstrumentation();
+	if (instrumentation != nullptr)
+		instrumentation->Add(timing, result != CURLE_OK);
+	handler.OnTiming(timing);
+
 	try {
 		if (result != CURLE_OK) {
 			StripRight(error_buffer);
@@ -180,7 +200,7 @@ CurlRequest::HeaderFunction(StringView s)
 	if (s.size > 5 && memcmp(s.data, "HTTP/", 5) == 0) {
 		/* this is the boundary to a new response, for example
 		   after a redirect */
-		headers.clear();
+		headers.Clear();
 		return;
 	}
 
@@ -191,8 +211,7 @@ CurlRequest::HeaderFunction(StringView s)
 	if (value == nullptr)
 		return;
 
-	std::string name(header, value);
-	std::transform(name.begin(), name.end(), name.begin(), ToLowerASCII);
+	const StringView name(header, value);
 
 	/* skip the colon */
 
@@ -203,7 +222,7 @@ CurlRequest::HeaderFunction(StringView s)
 	value = StripLeft(value, end);
 	end = StripRight(value, end);
 
-	headers.emplace(std::move(name), std::string(value, end));
+	headers.Add(name, {value, end});
 }
 
 size_t
@@ -217,6 +236,39 @@ CurlRequest::_HeaderFunction(char *ptr, size_t size, size_t nmemb, void *stream)
 	return size;
 }
 
+inline size_t
+CurlRequest::FeedBodySink(const uint8_t *data, size_t size)
+{
+	assert(body_sink != nullptr);
+
+	if (body_skip >= size) {
+		/* this was copied before the transfer was paused */
+		body_skip -= size;
+		return size;
+	}
+
+	size_t position = std::exchange(body_skip, 0);
+
+	while (position < size) {
+		auto w = body_sink->GetBodyBuffer();
+		if (w.empty()) {
+			/* the sink is full: pause the transfer; libcurl
+			   will pass the whole buffer again after
+			   Resume(), so remember how much of it we
+			   have already consumed */
+			body_skip = position;
+			return CURL_WRITEFUNC_PAUSE;
+		}
+
+		const size_t n = std::min(w.size, size - position);
+		memcpy(w.data, data + position, n);
+		position += n;
+		body_sink->OnBodyAppended(n);
+	}
+
+	return size;
+}
+
 inline size_t
 CurlRequest::DataReceived(const void *ptr, size_t received_size)
 {
@@ -224,6 +276,10 @@ CurlRequest::DataReceived(const void *ptr, size_t received_size)
 
 	try {
 		FinishHeaders();
+
+		if (body_sink != nullptr)
+			return FeedBodySink((const uint8_t *)ptr, received_size);
+
 		handler.OnData({ptr, received_size});
 		return received_size;
 	} catch (Pause) {
@@ -31,21 +31,36 @@
 #define CURL_REQUEST_HXX
 
 #include "Easy.hxx"
+#include "Headers.hxx"
 #include "event/DeferEvent.hxx"
 
-#include <map>
-#include <string>
 #include <exception>
 
+#include <stdint.h>
+
 struct StringView;
 class CurlGlobal;
 class CurlResponseHandler;
+class CurlBodySink;
 
 class CurlRequest {
 	CurlGlobal &global;
 
 	CurlResponseHandler &handler;
 
+	/**
+	 * @see SetBodySink()
+	 */
+	CurlBodySink *body_sink = nullptr;
+
+	/**
+	 * The number of bytes at the start of the next
+	 * WriteFunction() call which have already been copied to the
+	 * #body_sink: libcurl delivers the same data again after a
+	 * CURL_WRITEFUNC_PAUSE.
+	 */
+	size_t body_skip = 0;
+
 	/** the curl handle */
 	CurlEasy easy;
 
@@ -55,7 +70,7 @@ class CurlRequest {
 		CLOSED,
 	} state = State::HEADERS;
 
-	std::multimap<std::string, std::string> headers;
+	CurlHeaders headers;
 
 	DeferEvent defer_error_event;
 
@@ -106,6 +121,48 @@ public:
 		return easy.Get();
 	}
 
+	/**
+	 * Ask for HTTP/2, negotiated with ALPN on https:// URLs and
+	 * falling back to HTTP/1.1, and prefer waiting for a
+	 * connection which can be multiplexed (see
+	 * CurlGlobal::Config::multiplex) over opening a new one.
+	 * Call this before Start().
+	 *
+	 * Throws std::runtime_error if libcurl does not support
+	 * HTTP/2.
+	 */
+	void EnableHttp2();
+
+	/**
+	 * Allow (the default) or forbid sharing this request's
+	 * connection with other requests: if disabled, a new
+	 * connection is opened and closed after the transfer.  Call
+	 * this before Start().
+	 */
+	void SetConnectionReuse(bool value) {
+		easy.SetFreshConnect(!value);
+		easy.SetForbidReuse(!value);
+	}
+
+	/**
+	 * Send the given request headers, e.g. from
+	 * CurlHeaderTemplate::Get() or CurlHeaderOverlay::Get().  The
+	 * list remains owned by the caller and must remain valid
+	 * until the transfer is finished.  Call this before Start().
+	 */
+	void SetRequestHeaders(struct curl_slist *_headers) {
+		easy.SetRequestHeaders(_headers);
+	}
+
+	/**
+	 * Copy the response body to the given #CurlBodySink instead
+	 * of passing it to CurlResponseHandler::OnData().  Call this
+	 * before Start().
+	 */
+	void SetBodySink(CurlBodySink &_sink) noexcept {
+		body_sink = &_sink;
+	}
+
 	/**
 	 * CurlResponseHandler::OnData() shall throw this to pause the
 	 * stream.  Call Resume() to resume the transfer.
@@ -130,6 +187,7 @@ private:
 	void FinishBody();
 
 	size_t DataReceived(const void *ptr, size_t size);
+	size_t FeedBodySink(const uint8_t *data, size_t size);
 
 	void HeaderFunction(StringView s);
 
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2016-2017 Max Kellermann <max@duempel.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef CURL_SHARE_HXX
+#define CURL_SHARE_HXX
+
+#include <curl/curl.h>
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+/**
+ * An OO wrapper for a "CURLSH*" (a libCURL "share" handle).  It
+ * allows several "easy" handles to share caches, e.g. the DNS cache
+ * and TLS session ids, even if they are not attached to the same
+ * "multi" handle.
+ *
+ * The object must outlive all "easy" handles using it.
+ */
+class CurlShare {
+	CURLSH *handle;
+
+	/**
+	 * One mutex for each #curl_lock_data value; only allocated by
+	 * EnableLocking().
+	 */
+	std::unique_ptr<std::array<std::mutex, CURL_LOCK_DATA_LAST>> locks;
+
+public:
+	/**
+	 * Allocate a new CURLSH*.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	CurlShare()
+		:handle(curl_share_init())
+	{
+		if (handle == nullptr)
+			throw std::runtime_error("curl_share_init() failed");
+	}
+
+	~CurlShare() {
+		curl_share_cleanup(handle);
+	}
+
+	CurlShare(const CurlShare &) = delete;
+	CurlShare &operator=(const CurlShare &) = delete;
+
+	CURLSH *Get() {
+		return handle;
+	}
+
+	template<typename T>
+	void SetOption(CURLSHoption option, T value) {
+		auto code = curl_share_setopt(handle, option, value);
+		if (code != CURLSHE_OK)
+			throw std::runtime_error(curl_share_strerror(code));
+	}
+
+	/**
+	 * Share the given kind of data (e.g. CURL_LOCK_DATA_DNS)
+	 * between all users of this object.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void Share(curl_lock_data data) {
+		SetOption(CURLSHOPT_SHARE, data);
+	}
+
+	/**
+	 * Protect the shared data with mutexes, which is necessary if
+	 * it is used by "easy" handles in more than one thread.  Call
+	 * this before the object is used.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void EnableLocking() {
+		locks.reset(new std::array<std::mutex, CURL_LOCK_DATA_LAST>());
+		SetOption(CURLSHOPT_LOCKFUNC, LockFunction);
+		SetOption(CURLSHOPT_UNLOCKFUNC, UnlockFunction);
+		SetOption(CURLSHOPT_USERDATA, this);
+	}
+
+private:
+	static void LockFunction(CURL *, curl_lock_data data,
+				 curl_lock_access, void *userptr) {
+		auto &share = *(CurlShare *)userptr;
+		(*share.locks)[data].lock();
+	}
+
+	static void UnlockFunction(CURL *, curl_lock_data data,
+				   void *userptr) {
+		auto &share = *(CurlShare *)userptr;
+		(*share.locks)[data].unlock();
+	}
+};
+
+#endif
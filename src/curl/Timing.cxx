@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2016-2017 Max Kellermann <max@duempel.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "Timing.hxx"
+#include "Easy.hxx"
+
+/* the curl_off_t variants (in microseconds) are available since
+   libcurl 7.61; older versions only have double (in seconds) */
+#if LIBCURL_VERSION_NUM >= 0x073d00
+#define CURL_TIMING_INFO(name) name ## _T
+typedef curl_off_t CurlTimingValue;
+#else
+#define CURL_TIMING_INFO(name) name
+typedef double CurlTimingValue;
+#endif
+
+static CurlTiming::Duration
+GetTime(const CurlEasy &easy, CURLINFO info) noexcept
+{
+	CurlTimingValue value;
+	if (!easy.GetInfo(info, &value) || value <= 0)
+		return CurlTiming::Duration::zero();
+
+#if LIBCURL_VERSION_NUM >= 0x073d00
+	return CurlTiming::Duration(value);
+#else
+	return std::chrono::duration_cast<CurlTiming::Duration>(std::chrono::duration<double>(value));
+#endif
+}
+
+static uint64_t
+GetSize(const CurlEasy &easy, CURLINFO info) noexcept
+{
+	CurlTimingValue value;
+	return easy.GetInfo(info, &value) && value > 0
+		? uint64_t(value)
+		: 0;
+}
+
+CurlTiming
+CurlTiming::Read(const CurlEasy &easy) noexcept
+{
+	CurlTiming t;
+	t.name_lookup = GetTime(easy, CURL_TIMING_INFO(CURLINFO_NAMELOOKUP_TIME));
+	t.connect = GetTime(easy, CURL_TIMING_INFO(CURLINFO_CONNECT_TIME));
+	t.app_connect = GetTime(easy, CURL_TIMING_INFO(CURLINFO_APPCONNECT_TIME));
+	t.pre_transfer = GetTime(easy, CURL_TIMING_INFO(CURLINFO_PRETRANSFER_TIME));
+	t.start_transfer = GetTime(easy, CURL_TIMING_INFO(CURLINFO_STARTTRANSFER_TIME));
+	t.total = GetTime(easy, CURL_TIMING_INFO(CURLINFO_TOTAL_TIME));
+
+	t.bytes_sent = GetSize(easy, CURL_TIMING_INFO(CURLINFO_SIZE_UPLOAD));
+	t.bytes_received = GetSize(easy, CURL_TIMING_INFO(CURLINFO_SIZE_DOWNLOAD));
+
+	long header_size, request_size, n_connects;
+	if (easy.GetInfo(CURLINFO_HEADER_SIZE, &header_size) && header_size > 0)
+		t.bytes_received += header_size;
+	if (easy.GetInfo(CURLINFO_REQUEST_SIZE, &request_size) && request_size > 0)
+		t.bytes_sent += request_size;
+	if (easy.GetInfo(CURLINFO_NUM_CONNECTS, &n_connects) && n_connects > 0)
+		t.n_connects = n_connects;
+
+	return t;
+}
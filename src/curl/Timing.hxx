@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2016-2017 Max Kellermann <max@duempel.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef CURL_TIMING_HXX
+#define CURL_TIMING_HXX
+
+#include <chrono>
+
+#include <stdint.h>
+
+class CurlEasy;
+
+/**
+ * Timing information and transfer statistics of one finished
+ * #CurlRequest, obtained from libcurl with curl_easy_getinfo().
+ */
+struct CurlTiming {
+	typedef std::chrono::microseconds Duration;
+
+	/*
+	 * The following points in time are relative to the start of
+	 * the request (including redirects), as reported by libcurl.
+	 */
+
+	/**
+	 * Name resolution has completed.
+	 */
+	Duration name_lookup = Duration::zero();
+
+	/**
+	 * The TCP connection has been established.
+	 */
+	Duration connect = Duration::zero();
+
+	/**
+	 * The TLS handshake has completed; zero for plain-text
+	 * connections.
+	 */
+	Duration app_connect = Duration::zero();
+
+	/**
+	 * The request is about to be sent.
+	 */
+	Duration pre_transfer = Duration::zero();
+
+	/**
+	 * The first response byte has been received.
+	 */
+	Duration start_transfer = Duration::zero();
+
+	/**
+	 * The request has finished.
+	 */
+	Duration total = Duration::zero();
+
+	/**
+	 * The number of bytes sent and received, including headers.
+	 */
+	uint64_t bytes_sent = 0, bytes_received = 0;
+
+	/**
+	 * The number of new connections which were created for this
+	 * request.  Zero means a cached connection was reused.
+	 */
+	unsigned n_connects = 0;
+
+	bool IsReused() const noexcept {
+		return n_connects == 0;
+	}
+
+	Duration GetNameLookup() const noexcept {
+		return name_lookup;
+	}
+
+	/**
+	 * The time spent establishing the TCP connection.
+	 */
+	Duration GetConnect() const noexcept {
+		return connect > name_lookup ? connect - name_lookup : Duration::zero();
+	}
+
+	/**
+	 * The time spent on the TLS handshake.
+	 */
+	Duration GetTLS() const noexcept {
+		return app_connect > connect ? app_connect - connect : Duration::zero();
+	}
+
+	/**
+	 * The time the server took to respond, i.e. from sending the
+	 * request until the first response byte.
+	 */
+	Duration GetWait() const noexcept {
+		return start_transfer > pre_transfer
+			? start_transfer - pre_transfer
+			: Duration::zero();
+	}
+
+	/**
+	 * The time spent receiving the response.
+	 */
+	Duration GetTransfer() const noexcept {
+		return total > start_transfer ? total - start_transfer : Duration::zero();
+	}
+
+	/**
+	 * Obtain the information of a finished transfer.
+	 */
+	static CurlTiming Read(const CurlEasy &easy) noexcept;
+};
+
+#endif
@@ -0,0 +1,287 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AsyncFileWriter.hxx"
+#include "system/Error.hxx"
+
+#include <algorithm>
+#include <new>
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct AsyncFileWriter::Block {
+	char *const data;
+	size_t fill = 0;
+
+	Block()
+		:data((char *)aligned_alloc(DIRECT_ALIGNMENT, BLOCK_SIZE)) {
+		if (data == nullptr)
+			throw std::bad_alloc();
+	}
+
+	~Block() noexcept {
+		free(data);
+	}
+
+	Block(const Block &) = delete;
+	Block &operator=(const Block &) = delete;
+
+	bool IsFull() const noexcept {
+		return fill == BLOCK_SIZE;
+	}
+};
+
+AsyncFileWriter::AsyncFileWriter(EventLoop &event_loop, const char *path,
+				 AsyncFileWriterHandler &_handler,
+				 const Config &_config)
+	:handler(_handler), config(_config),
+	 done_event(event_loop, BIND_THIS_METHOD(OnDone)),
+	 writer(path)
+{
+	thread = std::thread(&AsyncFileWriter::Run, this);
+}
+
+AsyncFileWriter::~AsyncFileWriter() noexcept
+{
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		cancel = true;
+	}
+
+	cond.notify_one();
+
+	if (thread.joinable())
+		thread.join();
+
+	done_event.Cancel();
+}
+
+size_t
+AsyncFileWriter::GetPendingBytes() noexcept
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+	return queued_bytes + (current ? current->fill : 0);
+}
+
+AsyncFileWriter::BlockPtr
+AsyncFileWriter::AllocateBlock()
+{
+	return BlockPtr(new Block());
+}
+
+void
+AsyncFileWriter::SubmitCurrent() noexcept
+{
+	assert(current);
+
+	const size_t size = current->fill;
+
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		if (done) {
+			/* the worker thread has failed already; discard
+			   the data */
+			current.reset();
+			return;
+		}
+
+		queue.push_back(std::move(current));
+		queued_bytes += size;
+	}
+
+	cond.notify_one();
+}
+
+void
+AsyncFileWriter::Write(const void *_data, size_t size)
+{
+	assert(!commit);
+
+	const char *data = (const char *)_data;
+
+	while (size > 0) {
+		if (!current)
+			current = AllocateBlock();
+
+		const size_t chunk = std::min(size, BLOCK_SIZE - current->fill);
+		memcpy(current->data + current->fill, data, chunk);
+		current->fill += chunk;
+		data += chunk;
+		size -= chunk;
+
+		if (current->IsFull())
+			SubmitCurrent();
+	}
+}
+
+void
+AsyncFileWriter::Commit()
+{
+	assert(!commit);
+
+	if (current)
+		SubmitCurrent();
+
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		commit = true;
+	}
+
+	cond.notify_one();
+}
+
+inline void
+AsyncFileWriter::EnableDirect() noexcept
+{
+	const int fd = writer.GetFileDescriptor().Get();
+	const int flags = fcntl(fd, F_GETFL);
+
+	/* this fails with EINVAL if the file system does not support
+	   O_DIRECT; fall back to buffered I/O then */
+	direct = flags >= 0 && fcntl(fd, F_SETFL, flags|O_DIRECT) == 0;
+}
+
+inline void
+AsyncFileWriter::DisableDirect()
+{
+	const int fd = writer.GetFileDescriptor().Get();
+	const int flags = fcntl(fd, F_GETFL);
+	if (flags < 0 || fcntl(fd, F_SETFL, flags & ~O_DIRECT) < 0)
+		throw MakeErrno("Failed to disable O_DIRECT");
+
+	direct = false;
+}
+
+inline void
+AsyncFileWriter::WriteBlock(const Block &block)
+{
+	if (direct && block.fill % DIRECT_ALIGNMENT != 0)
+		/* O_DIRECT requires aligned lengths; this can only
+		   be the last block, so simply write its tail
+		   through the page cache */
+		DisableDirect();
+
+	writer.Write(block.data, block.fill);
+}
+
+inline void
+AsyncFileWriter::RunLoop(std::unique_lock<std::mutex> &lock)
+{
+	while (!cancel) {
+		if (!queue.empty()) {
+			auto block = std::move(queue.front());
+			queue.pop_front();
+
+			lock.unlock();
+			WriteBlock(*block);
+			lock.lock();
+
+			queued_bytes -= block->fill;
+			continue;
+		}
+
+		if (commit) {
+			lock.unlock();
+
+			if (config.sync &&
+			    fdatasync(writer.GetFileDescriptor().Get()) < 0)
+				throw MakeErrno("Failed to flush file");
+
+			writer.Commit();
+			lock.lock();
+			return;
+		}
+
+		cond.wait(lock);
+	}
+
+	lock.unlock();
+	writer.Cancel();
+	lock.lock();
+}
+
+void
+AsyncFileWriter::Run() noexcept
+{
+	std::exception_ptr _error;
+
+	try {
+		if (config.size > 0)
+			writer.Allocate(config.size);
+
+		if (config.direct)
+			EnableDirect();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		RunLoop(lock);
+	} catch (...) {
+		_error = std::current_exception();
+
+		if (writer.GetFileDescriptor().IsDefined())
+			writer.Cancel();
+	}
+
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		error = std::move(_error);
+		done = true;
+
+		/* free memory now; nobody is going to consume it */
+		queue.clear();
+		queued_bytes = 0;
+	}
+
+	done_event.Schedule();
+}
+
+void
+AsyncFileWriter::OnDone() noexcept
+{
+	thread.join();
+
+	std::exception_ptr _error;
+
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		assert(done);
+		_error = std::move(error);
+	}
+
+	if (_error)
+		handler.OnFileWriterError(std::move(_error));
+	else
+		handler.OnFileWriterCommitted();
+}
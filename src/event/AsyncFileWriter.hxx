@@ -0,0 +1,223 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "InjectEvent.hxx"
+#include "io/FileWriter.hxx"
+
+#include <condition_variable>
+#include <exception>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <stddef.h>
+#include <sys/types.h>
+
+class AsyncFileWriterHandler {
+public:
+	/**
+	 * The file has been committed successfully.
+	 */
+	virtual void OnFileWriterCommitted() noexcept = 0;
+
+	/**
+	 * An error has occurred; the file has been discarded (see
+	 * FileWriter::Cancel()).
+	 */
+	virtual void OnFileWriterError(std::exception_ptr ep) noexcept = 0;
+};
+
+/**
+ * An asynchronous wrapper for #FileWriter: data is copied into
+ * queued blocks, and a worker thread writes them and finally
+ * commits the file, so large files do not stall the #EventLoop.
+ * The result is delivered to the #AsyncFileWriterHandler in the
+ * #EventLoop thread.
+ *
+ * This class is not thread-safe; all methods must be called in the
+ * #EventLoop thread.
+ */
+class AsyncFileWriter final {
+	struct Block;
+	typedef std::unique_ptr<Block> BlockPtr;
+
+public:
+	struct Config {
+		/**
+		 * The expected file size; if non-zero, the space
+		 * is allocated up front with FileWriter::Allocate().
+		 */
+		off_t size;
+
+		/**
+		 * Write with O_DIRECT, bypassing the page cache.
+		 * Useful for large sequential dumps which will not
+		 * be read again soon.  Falls back to buffered I/O
+		 * if the file system does not support it.
+		 */
+		bool direct;
+
+		/**
+		 * Call fdatasync() before committing the file, so a
+		 * committed file survives a crash.
+		 */
+		bool sync;
+
+		Config() noexcept
+			:size(0), direct(false), sync(true) {}
+	};
+
+private:
+	/**
+	 * The size of each queued block; it is a multiple of the
+	 * O_DIRECT alignment.
+	 */
+	static constexpr size_t BLOCK_SIZE = 1024 * 1024;
+
+	/**
+	 * The alignment of buffers, file offsets and lengths
+	 * required by O_DIRECT.
+	 */
+	static constexpr size_t DIRECT_ALIGNMENT = 4096;
+
+	AsyncFileWriterHandler &handler;
+
+	const Config config;
+
+	/**
+	 * Delivers the result of the worker thread.
+	 */
+	InjectEvent done_event;
+
+	/**
+	 * The block currently being filled by Write() in the
+	 * #EventLoop thread.
+	 */
+	BlockPtr current;
+
+	/* the following attributes are protected by #mutex */
+
+	std::mutex mutex;
+	std::condition_variable cond;
+
+	std::list<BlockPtr> queue;
+
+	/**
+	 * The number of bytes in #queue and in the block the worker
+	 * is writing.
+	 */
+	size_t queued_bytes = 0;
+
+	bool commit = false, cancel = false;
+
+	/**
+	 * Set by the worker thread on completion.
+	 */
+	bool done = false;
+	std::exception_ptr error;
+
+	/**
+	 * Used only by the worker thread after the constructor
+	 * returns.
+	 */
+	FileWriter writer;
+
+	/**
+	 * Is O_DIRECT currently enabled on the file?  Used only by
+	 * the worker thread.
+	 */
+	bool direct = false;
+
+	std::thread thread;
+
+public:
+	/**
+	 * Create the file (see #FileWriter) and launch the worker
+	 * thread.
+	 *
+	 * Throws on error.
+	 */
+	AsyncFileWriter(EventLoop &event_loop, const char *path,
+			AsyncFileWriterHandler &_handler,
+			const Config &_config=Config());
+
+	/**
+	 * If the file has not been committed yet, it is discarded.
+	 * This waits for the worker thread to finish the block it is
+	 * currently writing.
+	 */
+	~AsyncFileWriter() noexcept;
+
+	AsyncFileWriter(const AsyncFileWriter &) = delete;
+	AsyncFileWriter &operator=(const AsyncFileWriter &) = delete;
+
+	/**
+	 * Returns the number of bytes passed to Write() which have
+	 * not yet been written to the file.  Callers producing large
+	 * amounts of data may use this to throttle themselves.
+	 */
+	size_t GetPendingBytes() noexcept;
+
+	/**
+	 * Append data to the file.  The data is copied, and the
+	 * actual write happens later in the worker thread.
+	 */
+	void Write(const void *data, size_t size);
+
+	/**
+	 * Finish writing and commit the file (see
+	 * FileWriter::Commit()).  After that,
+	 * AsyncFileWriterHandler::OnFileWriterCommitted() or
+	 * AsyncFileWriterHandler::OnFileWriterError() will be
+	 * invoked.  Write() must not be called after this.
+	 */
+	void Commit();
+
+private:
+	static BlockPtr AllocateBlock();
+
+	/**
+	 * Submit the #current block to the worker thread.
+	 */
+	void SubmitCurrent() noexcept;
+
+	void Run() noexcept;
+	void RunLoop(std::unique_lock<std::mutex> &lock);
+	void WriteBlock(const Block &block);
+	void EnableDirect() noexcept;
+	void DisableDirect();
+
+	void OnDone() noexcept;
+};
@@ -33,16 +33,16 @@
 #ifndef BENG_PROXY_CLEANUP_TIMER_HXX
 #define BENG_PROXY_CLEANUP_TIMER_HXX
 
-#include "TimerEvent.hxx"
+#include "CoarseTimerEvent.hxx"
 
 /**
- * Wrapper for #TimerEvent which aims to simplify installing recurring
- * events.
+ * Wrapper for #CoarseTimerEvent which aims to simplify installing
+ * recurring events.
  */
 class CleanupTimer {
-	TimerEvent event;
+	CoarseTimerEvent event;
 
-	const struct timeval delay;
+	const std::chrono::seconds delay;
 
 	/**
 	 * @return true if another cleanup shall be scheduled
@@ -54,7 +54,7 @@ public:
 	CleanupTimer(EventLoop &loop, unsigned delay_s,
 		     Callback _callback)
 		:event(loop, BIND_THIS_METHOD(OnTimer)),
-		 delay{time_t(delay_s), 0},
+		 delay(delay_s),
 		 callback(_callback) {}
 
 	~CleanupTimer() {
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "time/CoarseClock.hxx"
+#include "util/BindMethod.hxx"
+
+#include <boost/intrusive/list_hook.hpp>
+
+#include <chrono>
+
+class EventLoop;
+
+/**
+ * A timer with a coarse resolution (see TimerWheel::RESOLUTION).  It
+ * is managed by the #EventLoop's #TimerWheel instead of a libevent
+ * timer, which makes scheduling and canceling O(1) operations.  This
+ * is useful for timeouts which are rescheduled frequently and rarely
+ * expire, e.g. socket timeouts.
+ *
+ * The callback may be invoked up to one TimerWheel::RESOLUTION late,
+ * but never too early.
+ */
+class CoarseTimerEvent final {
+	friend class TimerWheel;
+
+	typedef boost::intrusive::list_member_hook<boost::intrusive::link_mode<boost::intrusive::auto_unlink>> SiblingsHook;
+	SiblingsHook siblings;
+
+	EventLoop &loop;
+
+	typedef BoundMethod<void()> Callback;
+	const Callback callback;
+
+public:
+	typedef CoarseSteadyClock Clock;
+	typedef Clock::duration Duration;
+	typedef Clock::time_point TimePoint;
+
+private:
+	/**
+	 * When is this timer due?  This is only valid if IsPending()
+	 * returns true.
+	 */
+	TimePoint due;
+
+public:
+	CoarseTimerEvent(EventLoop &_loop, Callback _callback) noexcept
+		:loop(_loop), callback(_callback) {}
+
+	CoarseTimerEvent(const CoarseTimerEvent &) = delete;
+	CoarseTimerEvent &operator=(const CoarseTimerEvent &) = delete;
+
+	EventLoop &GetEventLoop() noexcept {
+		return loop;
+	}
+
+	bool IsPending() const noexcept {
+		return siblings.is_linked();
+	}
+
+	TimePoint GetDue() const noexcept {
+		return due;
+	}
+
+	/**
+	 * Schedule (or reschedule) the timer.
+	 */
+	void Schedule(Duration d) noexcept;
+
+	void Cancel() noexcept {
+		if (IsPending())
+			siblings.unlink();
+	}
+
+private:
+	void Run() noexcept;
+};
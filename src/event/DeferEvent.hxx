@@ -43,6 +43,12 @@ class EventLoop;
  * Defer execution until the next event loop iteration.  Use this to
  * move calls out of the current stack frame, to avoid surprising side
  * effects for callers up in the call chain.
+ *
+ * Each instance is assigned to one of two lanes: #IMMEDIATE events
+ * run before the next poll, and #IDLE events run only when there is
+ * nothing else to do, i.e. when the poll would otherwise block.  The
+ * number of #IDLE events per iteration is limited, see
+ * EventLoop::SetIdleBudget().
  */
 class DeferEvent final {
 	friend class EventLoop;
@@ -56,8 +62,26 @@ class DeferEvent final {
 	const Callback callback;
 
 public:
-	DeferEvent(EventLoop &_loop, Callback _callback)
-		:loop(_loop), callback(_callback) {}
+	enum class Priority {
+		/**
+		 * Run before the next poll.  This is the default.
+		 */
+		IMMEDIATE,
+
+		/**
+		 * Run only when the #EventLoop is idle; use this for
+		 * housekeeping which is not latency-critical.
+		 */
+		IDLE,
+	};
+
+private:
+	const Priority priority;
+
+public:
+	DeferEvent(EventLoop &_loop, Callback _callback,
+		   Priority _priority=Priority::IMMEDIATE)
+		:loop(_loop), callback(_callback), priority(_priority) {}
 
 	DeferEvent(const DeferEvent &) = delete;
 	DeferEvent &operator=(const DeferEvent &) = delete;
@@ -66,6 +90,10 @@ public:
 		return loop;
 	}
 
+	Priority GetPriority() const {
+		return priority;
+	}
+
 	bool IsPending() const {
 		return siblings.is_linked();
 	}
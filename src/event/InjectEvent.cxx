@@ -0,0 +1,73 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "InjectEvent.hxx"
+#include "Loop.hxx"
+
+InjectEvent::InjectEvent(EventLoop &_loop, Callback _callback) noexcept
+	:loop(_loop), callback(_callback)
+{
+	loop.AddInjectEvent();
+}
+
+InjectEvent::~InjectEvent() noexcept
+{
+	if (state.load(std::memory_order_acquire) != State::IDLE)
+		loop.RemoveInject(*this);
+
+	loop.RemoveInjectEvent();
+}
+
+void
+InjectEvent::Schedule() noexcept
+{
+	State old = state.load(std::memory_order_relaxed);
+	do {
+		if (old == State::PENDING)
+			/* already scheduled */
+			return;
+	} while (!state.compare_exchange_weak(old, State::PENDING,
+					      std::memory_order_acq_rel));
+
+	if (old == State::IDLE)
+		loop.Inject(*this);
+	/* else: it was canceled, but is still in the queue; we
+	   just revived it */
+}
+
+void
+InjectEvent::Cancel() noexcept
+{
+	State expected = State::PENDING;
+	state.compare_exchange_strong(expected, State::CANCELED,
+				      std::memory_order_acq_rel);
+}
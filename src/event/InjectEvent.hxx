@@ -0,0 +1,114 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "util/BindMethod.hxx"
+
+#include <atomic>
+
+class EventLoop;
+
+/**
+ * Invoke a method call in the context of the #EventLoop.  Unlike
+ * #DeferEvent, Schedule() may be called from any thread; this is
+ * the way to hand results from worker threads back to the
+ * #EventLoop thread.
+ *
+ * Injections are pushed to a lock-free queue and the #EventLoop is
+ * woken up through an eventfd; all injections which happen before
+ * the #EventLoop gets to run them are coalesced into one wakeup.
+ */
+class InjectEvent final {
+	friend class EventLoop;
+
+	enum class State {
+		/**
+		 * Not in the queue.
+		 */
+		IDLE,
+
+		/**
+		 * In the queue, the callback will be invoked.
+		 */
+		PENDING,
+
+		/**
+		 * Still in the queue, but Cancel() has been called;
+		 * the callback will not be invoked.
+		 */
+		CANCELED,
+	};
+
+	std::atomic<State> state{State::IDLE};
+
+	/**
+	 * The next item in the #EventLoop's inject queue.
+	 */
+	InjectEvent *next;
+
+	EventLoop &loop;
+
+	typedef BoundMethod<void()> Callback;
+	const Callback callback;
+
+public:
+	/**
+	 * The constructor must be called in the #EventLoop thread, or
+	 * before the #EventLoop runs.
+	 */
+	InjectEvent(EventLoop &_loop, Callback _callback) noexcept;
+
+	/**
+	 * The destructor must be called in the #EventLoop thread.
+	 */
+	~InjectEvent() noexcept;
+
+	InjectEvent(const InjectEvent &) = delete;
+	InjectEvent &operator=(const InjectEvent &) = delete;
+
+	EventLoop &GetEventLoop() noexcept {
+		return loop;
+	}
+
+	/**
+	 * Schedule the callback.  This method is thread-safe.
+	 */
+	void Schedule() noexcept;
+
+	/**
+	 * Cancel a pending callback.  This method is thread-safe,
+	 * but if the callback is already being invoked in the
+	 * #EventLoop thread, it may not be stopped.
+	 */
+	void Cancel() noexcept;
+};
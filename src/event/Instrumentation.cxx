@@ -0,0 +1,90 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Instrumentation.hxx"
+
+#include <dlfcn.h>
+#include <stdio.h>
+
+const char *
+ToString(EventHandlerType type) noexcept
+{
+	switch (type) {
+	case EventHandlerType::SOCKET:
+		return "socket";
+
+	case EventHandlerType::TIMER:
+		return "timer";
+
+	case EventHandlerType::COARSE_TIMER:
+		return "coarse_timer";
+
+	case EventHandlerType::DEFER:
+		return "defer";
+
+	case EventHandlerType::INJECT:
+		return "inject";
+	}
+
+	return "unknown";
+}
+
+void
+EventLoopInstrumentation::Clear() noexcept
+{
+	busy.Clear();
+	idle.Clear();
+
+	for (auto &i : handlers)
+		i.Clear();
+
+	n_slow_handlers = 0;
+}
+
+void
+EventLoopInstrumentation::OnSlowHandler(EventHandlerType type,
+					Duration duration,
+					const void *instance,
+					const void *function) noexcept
+{
+	const auto ms = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(duration);
+
+	/* the wrapper function generated by BIND_METHOD() carries
+	   the class and method name in its (mangled) symbol name */
+	Dl_info info;
+	const char *symbol = dladdr(function, &info) && info.dli_sname != nullptr
+		? info.dli_sname
+		: "?";
+
+	fprintf(stderr, "slow %s handler: %1.3f ms in %s (function=%p instance=%p)\n",
+		ToString(type), ms.count(), symbol, function, instance);
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "util/Log2Histogram.hxx"
+#include "util/Compiler.h"
+
+#include <array>
+#include <chrono>
+
+#include <stdint.h>
+
+/**
+ * The kind of event handler, used by #EventLoopInstrumentation to
+ * group measurements.
+ */
+enum class EventHandlerType {
+	SOCKET,
+	TIMER,
+	COARSE_TIMER,
+	DEFER,
+	INJECT,
+};
+
+static constexpr unsigned N_EVENT_HANDLER_TYPES = 5;
+
+/**
+ * Collects latency statistics of an #EventLoop.  Install it with
+ * EventLoop::SetInstrumentation().  While no instance is installed,
+ * the overhead is one branch per handler invocation.
+ */
+class EventLoopInstrumentation {
+public:
+	typedef std::chrono::steady_clock::duration Duration;
+
+	/**
+	 * The time spent running handlers per event loop iteration.
+	 */
+	Log2Histogram busy;
+
+	/**
+	 * The time spent waiting for events per event loop iteration.
+	 */
+	Log2Histogram idle;
+
+	/**
+	 * The run time of each handler invocation.
+	 */
+	std::array<Log2Histogram, N_EVENT_HANDLER_TYPES> handlers;
+
+	/**
+	 * Handlers which run for at least this duration are reported
+	 * to OnSlowHandler().
+	 */
+	Duration slow_threshold;
+
+	uint64_t n_slow_handlers = 0;
+
+	explicit EventLoopInstrumentation(Duration _slow_threshold=std::chrono::milliseconds(100)) noexcept
+		:slow_threshold(_slow_threshold) {}
+
+	virtual ~EventLoopInstrumentation() noexcept = default;
+
+	EventLoopInstrumentation(const EventLoopInstrumentation &) = delete;
+	EventLoopInstrumentation &operator=(const EventLoopInstrumentation &) = delete;
+
+	Log2Histogram &GetHandlerHistogram(EventHandlerType type) noexcept {
+		return handlers[unsigned(type)];
+	}
+
+	void Clear() noexcept;
+
+	void AddHandler(EventHandlerType type, Duration duration,
+			const void *instance, const void *function) noexcept {
+		GetHandlerHistogram(type).Add(duration);
+
+		if (duration >= slow_threshold) {
+			++n_slow_handlers;
+			OnSlowHandler(type, duration, instance, function);
+		}
+	}
+
+	void AddIteration(Duration busy_duration,
+			  Duration idle_duration) noexcept {
+		busy.Add(busy_duration);
+		idle.Add(idle_duration);
+	}
+
+protected:
+	/**
+	 * A handler has exceeded #slow_threshold.  The default
+	 * implementation prints a message with the symbol name of
+	 * the bound method to stderr.
+	 *
+	 * @param instance the instance pointer of the #BoundMethod
+	 * @param function the wrapper function of the #BoundMethod
+	 */
+	virtual void OnSlowHandler(EventHandlerType type, Duration duration,
+				   const void *instance,
+				   const void *function) noexcept;
+};
+
+gcc_const
+const char *
+ToString(EventHandlerType type) noexcept;
@@ -31,26 +31,311 @@
  */
 
 #include "Loop.hxx"
+#include "Duration.hxx"
+#include "system/Error.hxx"
+
+#ifdef HAVE_URING
+#include "uring/Manager.hxx"
+#endif
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <stdint.h>
+
+EventLoop::EventLoop()
+	:event_base(Create()),
+	 inject_fd(eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC))
+{
+	if (inject_fd < 0) {
+		::event_base_free(event_base);
+		throw MakeErrno("eventfd() failed");
+	}
+
+	event_assign(&inject_event, event_base, inject_fd,
+		     EV_READ|EV_PERSIST, OnInject, this);
+
+	evtimer_assign(&coarse_timer_event, event_base,
+		       OnCoarseTimer, this);
+}
+
+EventLoop::~EventLoop()
+{
+#ifdef HAVE_URING
+	/* the io_uring manager owns events which must be deleted
+	   before the event_base gets freed */
+	uring.reset();
+#endif
+
+	assert(defer.empty());
+	assert(idle.empty());
+	assert(inject_head.load() == nullptr);
+	assert(injected == nullptr);
+	assert(n_inject_events == 0);
+
+	event_del(&inject_event);
+	event_del(&coarse_timer_event);
+#ifndef NDEBUG
+	event_debug_unassign(&inject_event);
+	event_debug_unassign(&coarse_timer_event);
+#endif
+
+	close(inject_fd);
+
+	::event_base_free(event_base);
+}
+
+#ifdef HAVE_URING
+
+void
+EventLoop::EnableUring(unsigned entries, unsigned flags)
+{
+	assert(!uring);
+
+	uring.reset(new Uring::Manager(*this, entries, flags));
+}
+
+Uring::Queue *
+EventLoop::GetUring() noexcept
+{
+	return uring.get();
+}
+
+#endif
 
 void
 EventLoop::Defer(DeferEvent &e)
 {
-	defer.push_front(e);
+	if (e.GetPriority() == DeferEvent::Priority::IDLE)
+		idle.push_back(e);
+	else
+		defer.push_front(e);
 }
 
 void
 EventLoop::CancelDefer(DeferEvent &e)
 {
-	defer.erase(defer.iterator_to(e));
+	auto &list = e.GetPriority() == DeferEvent::Priority::IDLE
+		? idle
+		: defer;
+	list.erase(list.iterator_to(e));
+}
+
+bool
+EventLoop::Poll(int flags)
+{
+	if (gcc_likely(idle.empty()))
+		return Loop(flags);
+
+	/* there is idle work: find out whether the poll would block
+	   by polling without blocking first */
+	const unsigned old_n_handlers = n_handlers;
+	const bool result = Loop(flags|EVLOOP_NONBLOCK);
+	if (n_handlers != old_n_handlers)
+		/* not idle */
+		return result;
+
+	RunIdle();
+
+	if (!result)
+		/* no events registered; keep going while there is
+		   deferred work left */
+		return !defer.empty() || !idle.empty();
+
+	if ((flags & EVLOOP_NONBLOCK) != 0 ||
+	    !defer.empty() || !idle.empty())
+		/* don't block while there is more work to do */
+		return true;
+
+	return Loop(flags);
 }
 
 bool
 EventLoop::RunDeferred()
 {
 	while (!defer.empty())
-		defer.pop_front_and_dispose([](DeferEvent *e){
-				e->OnDeferred();
+		defer.pop_front_and_dispose([this](DeferEvent *e){
+				InvokeHandler(EventHandlerType::DEFER,
+					      e->callback);
 			});
 
 	return true;
 }
+
+void
+EventLoop::RunIdle()
+{
+	for (unsigned i = idle_budget; i > 0 && !idle.empty(); --i)
+		idle.pop_front_and_dispose([this](DeferEvent *e){
+				InvokeHandler(EventHandlerType::DEFER,
+					      e->callback);
+			});
+}
+
+void
+EventLoop::Inject(InjectEvent &e) noexcept
+{
+	InjectEvent *old = inject_head.load(std::memory_order_relaxed);
+	do {
+		e.next = old;
+	} while (!inject_head.compare_exchange_weak(old, &e,
+						    std::memory_order_release,
+						    std::memory_order_relaxed));
+
+	if (old == nullptr) {
+		/* the queue was empty: this is the first injection
+		   since the EventLoop has last looked at it, so wake
+		   it up; later injections are coalesced into this
+		   wakeup */
+		static constexpr uint64_t value = 1;
+		(void)write(inject_fd, &value, sizeof(value));
+	}
+}
+
+void
+EventLoop::FetchInjected() noexcept
+{
+	InjectEvent *head = inject_head.exchange(nullptr,
+						 std::memory_order_acquire);
+
+	/* the stack is in LIFO order; reverse it */
+	InjectEvent *reversed = nullptr;
+	while (head != nullptr) {
+		InjectEvent *e = head;
+		head = e->next;
+		e->next = reversed;
+		reversed = e;
+	}
+
+	if (reversed == nullptr)
+		return;
+
+	*injected_tail = reversed;
+	while (reversed->next != nullptr)
+		reversed = reversed->next;
+	injected_tail = &reversed->next;
+}
+
+void
+EventLoop::AddInjectEvent() noexcept
+{
+	if (n_inject_events++ == 0)
+		event_add(&inject_event, nullptr);
+}
+
+void
+EventLoop::RemoveInjectEvent() noexcept
+{
+	assert(n_inject_events > 0);
+
+	if (--n_inject_events == 0)
+		event_del(&inject_event);
+}
+
+void
+EventLoop::RemoveInject(InjectEvent &e) noexcept
+{
+	FetchInjected();
+
+	for (InjectEvent **i = &injected; *i != nullptr; i = &(*i)->next) {
+		if (*i == &e) {
+			*i = e.next;
+			if (injected_tail == &e.next)
+				injected_tail = i;
+			break;
+		}
+	}
+
+	e.state.store(InjectEvent::State::IDLE, std::memory_order_release);
+}
+
+inline void
+EventLoop::RunInjected() noexcept
+{
+	FetchInjected();
+
+	while (injected != nullptr) {
+		InjectEvent &e = *injected;
+		injected = e.next;
+		if (injected == nullptr)
+			injected_tail = &injected;
+
+		const auto old = e.state.exchange(InjectEvent::State::IDLE,
+						  std::memory_order_acq_rel);
+		if (old == InjectEvent::State::PENDING)
+			InvokeHandler(EventHandlerType::INJECT, e.callback);
+	}
+}
+
+void
+EventLoop::OnInject(evutil_socket_t fd, short, void *ctx) noexcept
+{
+	auto &loop = *(EventLoop *)ctx;
+
+	uint64_t value;
+	(void)read(fd, &value, sizeof(value));
+
+	loop.RunInjected();
+}
+
+void
+EventLoop::AddCoarseTimer(CoarseTimerEvent &t) noexcept
+{
+	coarse_timers.Insert(t);
+
+	if (!evtimer_pending(&coarse_timer_event, nullptr))
+		/* while there are coarse timers, the wheel is
+		   advanced once per tick */
+		ScheduleCoarseTimers(TimerWheel::RESOLUTION);
+}
+
+void
+EventLoop::ScheduleCoarseTimers(TimerWheel::Duration d) noexcept
+{
+	const auto tv = ToEventDuration(std::chrono::duration_cast<std::chrono::microseconds>(d));
+	evtimer_add(&coarse_timer_event, &tv);
+}
+
+inline void
+EventLoop::RunCoarseTimers() noexcept
+{
+	const auto d = coarse_timers.Run(CoarseSteadyNow());
+	if (d >= d.zero())
+		ScheduleCoarseTimers(d);
+}
+
+void
+EventLoop::OnCoarseTimer(evutil_socket_t, short, void *ctx) noexcept
+{
+	auto &loop = *(EventLoop *)ctx;
+	loop.RunCoarseTimers();
+}
+
+void
+EventLoop::BeginIteration() noexcept
+{
+	assert(instrumentation != nullptr);
+
+	const auto now = std::chrono::steady_clock::now();
+	if (iteration_start != std::chrono::steady_clock::time_point()) {
+		const auto total = now - iteration_start;
+		instrumentation->AddIteration(iteration_busy,
+					      total - iteration_busy);
+	}
+
+	iteration_start = now;
+	iteration_busy = iteration_busy.zero();
+}
+
+void
+EventLoop::FinishHandler(EventHandlerType type,
+			 std::chrono::steady_clock::time_point start,
+			 const void *instance, const void *function) noexcept
+{
+	if (instrumentation == nullptr)
+		/* disabled by the handler */
+		return;
+
+	const auto duration = std::chrono::steady_clock::now() - start;
+	iteration_busy += duration;
+	instrumentation->AddHandler(type, duration, instance, function);
+}
@@ -34,14 +34,31 @@
 #define EVENT_BASE_HXX
 
 #include "DeferEvent.hxx"
+#include "InjectEvent.hxx"
+#include "TimerWheel.hxx"
+#include "Instrumentation.hxx"
 #include "util/BindMethod.hxx"
+#include "io/PipePool.hxx"
+#include "util/SlabBufferPool.hxx"
+#include "util/Compiler.h"
+#include "util/Trace.h"
 
 #include <boost/intrusive/list.hpp>
 
 #include <event.h>
 
+#include <chrono>
+
+#ifdef HAVE_URING
+#include <memory>
+#endif
+
 #include <assert.h>
 
+#ifdef HAVE_URING
+namespace Uring { class Queue; class Manager; }
+#endif
+
 /**
  * Wrapper for a struct event_base.
  */
@@ -66,27 +83,116 @@ class EventLoop {
 		return ::event_init();
 	}
 
-	boost::intrusive::list<DeferEvent,
-			       boost::intrusive::member_hook<DeferEvent,
-							     DeferEvent::SiblingsHook,
-							     &DeferEvent::siblings>,
-			       boost::intrusive::constant_time_size<false>> defer;
+	typedef boost::intrusive::list<DeferEvent,
+				       boost::intrusive::member_hook<DeferEvent,
+								     DeferEvent::SiblingsHook,
+								     &DeferEvent::siblings>,
+				       boost::intrusive::constant_time_size<false>> DeferList;
+
+	/**
+	 * #DeferEvent instances with DeferEvent::Priority::IMMEDIATE.
+	 */
+	DeferList defer;
+
+	/**
+	 * #DeferEvent instances with DeferEvent::Priority::IDLE.
+	 */
+	DeferList idle;
+
+	/**
+	 * The maximum number of #idle events per iteration.
+	 */
+	unsigned idle_budget = 16;
+
+	/**
+	 * Incremented by InvokeHandler(); used by Poll() to detect
+	 * whether a non-blocking poll has found something to do.
+	 */
+	unsigned n_handlers = 0;
 
 #ifndef NDEBUG
 	typedef BoundMethod<void()> PostCallback;
 	PostCallback post_callback = nullptr;
 #endif
 
+	/**
+	 * A lock-free stack of #InjectEvent instances pushed by
+	 * Inject().  It is drained by the #EventLoop thread.
+	 */
+	std::atomic<InjectEvent *> inject_head{nullptr};
+
+	/**
+	 * #InjectEvent instances which have been taken from
+	 * #inject_head, in FIFO order.  Only accessed by the
+	 * #EventLoop thread.
+	 */
+	InjectEvent *injected = nullptr, **injected_tail = &injected;
+
+	/**
+	 * An eventfd which wakes up the #EventLoop after Inject().
+	 */
+	int inject_fd;
+	struct event inject_event;
+
+	/**
+	 * The number of #InjectEvent instances; #inject_event is only
+	 * registered while there is at least one, so it does not keep
+	 * Dispatch() running.
+	 */
+	unsigned n_inject_events = 0;
+
+	TimerWheel coarse_timers;
+
+	/**
+	 * A libevent timer which invokes TimerWheel::Run() (only
+	 * while there are #CoarseTimerEvent instances).
+	 */
+	struct event coarse_timer_event;
+
+#ifdef HAVE_URING
+	std::unique_ptr<Uring::Manager> uring;
+#endif
+
+	/**
+	 * Cached time stamps, see SteadyNow(), CoarseSteadyNow() and
+	 * SystemNow().
+	 */
+	std::chrono::steady_clock::time_point steady_now, coarse_steady_now;
+	std::chrono::system_clock::time_point system_now;
+	bool steady_now_valid = false, coarse_steady_now_valid = false;
+	bool system_now_valid = false;
+
+	/**
+	 * Input buffers for sockets running in this loop, see
+	 * GetBufferPool().  Slabs are allocated lazily by the loop
+	 * thread and are bound to its NUMA node.
+	 */
+	SlabBufferPool buffer_pool{8192, 64, {LargeAllocationOptions::HugePages::TRANSPARENT, true}};
+
+	/**
+	 * Pipes for splice() transfers, see GetPipePool().
+	 */
+	PipePool pipe_pool{256 * 1024};
+
+	EventLoopInstrumentation *instrumentation = nullptr;
+
+	/**
+	 * The start of the current iteration and the time spent in
+	 * handlers since then; only maintained while #instrumentation
+	 * is set.
+	 */
+	std::chrono::steady_clock::time_point iteration_start;
+	std::chrono::steady_clock::duration iteration_busy;
+
 	bool quit;
 
 public:
-	EventLoop():event_base(Create()) {}
-
-	~EventLoop() {
-		assert(defer.empty());
+	/**
+	 * Throws on error.
+	 */
+	EventLoop();
 
-		::event_base_free(event_base);
-	}
+	~EventLoop();
 
 	EventLoop(const EventLoop &other) = delete;
 	EventLoop &operator=(const EventLoop &other) = delete;
@@ -99,6 +205,45 @@ public:
 		event_reinit(event_base);
 	}
 
+	/**
+	 * Returns a pool of equally sized I/O buffers which may be
+	 * used by objects running in this #EventLoop (e.g. the input
+	 * buffer of #BufferedSocket).  Since it is only accessed
+	 * from this loop's thread, it needs no locking.
+	 */
+	SlabBufferPool &GetBufferPool() noexcept {
+		return buffer_pool;
+	}
+
+	/**
+	 * Returns a pool of pipes which may be used by objects
+	 * running in this #EventLoop for splice() transfers.
+	 */
+	PipePool &GetPipePool() noexcept {
+		return pipe_pool;
+	}
+
+#ifdef HAVE_URING
+	/**
+	 * Enable io_uring support on this #EventLoop.  After this,
+	 * GetUring() returns a #Uring::Queue which batches all
+	 * submissions of one event loop iteration into a single
+	 * system call.  All other events continue to be handled by
+	 * libevent.
+	 *
+	 * Throws on error (e.g. if the kernel does not support
+	 * io_uring).
+	 */
+	void EnableUring(unsigned entries, unsigned flags);
+
+	/**
+	 * Returns the io_uring queue or nullptr if EnableUring() was
+	 * not called (or has failed).
+	 */
+	gcc_pure
+	Uring::Queue *GetUring() noexcept;
+#endif
+
 #ifndef NDEBUG
 	/**
 	 * Set a callback function which will be invoked each time an even
@@ -114,26 +259,26 @@ public:
 		quit = false;
 
 		RunDeferred();
-		while (Loop(EVLOOP_ONCE) && !quit) {
+		while (Poll(EVLOOP_ONCE) && !quit) {
 			RunDeferred();
 			RunPost();
 		}
 	}
 
 	bool LoopNonBlock() {
-		return RunDeferred() && Loop(EVLOOP_NONBLOCK) &&
+		return RunDeferred() && Poll(EVLOOP_NONBLOCK) &&
 			RunDeferred() &&
 			RunPost();
 	}
 
 	bool LoopOnce() {
-		return RunDeferred() && Loop(EVLOOP_ONCE) &&
+		return RunDeferred() && Poll(EVLOOP_ONCE) &&
 			RunDeferred() &&
 			RunPost();
 	}
 
 	bool LoopOnceNonBlock() {
-		return RunDeferred() && Loop(EVLOOP_ONCE|EVLOOP_NONBLOCK) &&
+		return RunDeferred() && Poll(EVLOOP_ONCE|EVLOOP_NONBLOCK) &&
 			RunDeferred() &&
 			RunPost();
 	}
@@ -143,20 +288,183 @@ public:
 		::event_base_loopbreak(event_base);
 	}
 
+	/**
+	 * Install an object which collects latency statistics; pass
+	 * nullptr to disable instrumentation.  The object is owned by
+	 * the caller.
+	 */
+	void SetInstrumentation(EventLoopInstrumentation *_instrumentation) noexcept {
+		instrumentation = _instrumentation;
+		iteration_start = std::chrono::steady_clock::time_point();
+	}
+
+	EventLoopInstrumentation *GetInstrumentation() noexcept {
+		return instrumentation;
+	}
+
+	/**
+	 * Set the maximum number of DeferEvent::Priority::IDLE
+	 * events which are invoked per idle iteration.
+	 */
+	void SetIdleBudget(unsigned _budget) noexcept {
+		assert(_budget > 0);
+
+		idle_budget = _budget;
+	}
+
+	/**
+	 * Invoke an event handler callback, measuring its run time
+	 * if instrumentation is enabled.
+	 */
+	template<typename S, typename... Args>
+	void InvokeHandler(EventHandlerType type,
+			   const BoundMethod<S> &_callback,
+			   Args&&... args) {
+		++n_handlers;
+
+		if (gcc_likely(instrumentation == nullptr)) {
+			_callback(std::forward<Args>(args)...);
+			return;
+		}
+
+		/* copy the callback, because the handler may destroy
+		   the object which owns it */
+		const BoundMethod<S> callback = _callback;
+		const auto start = std::chrono::steady_clock::now();
+		callback(std::forward<Args>(args)...);
+		FinishHandler(type, start, callback.GetInstance(),
+			      callback.GetFunctionAddress());
+	}
+
 	void DumpEvents(FILE *file) {
 		event_base_dump_events(event_base, file);
 	}
 
+	/**
+	 * Returns the monotonic time stamp of the current event loop
+	 * iteration.  The clock is read only once per iteration (on
+	 * the first call), which saves system calls but means the
+	 * value is slightly in the past.
+	 */
+	std::chrono::steady_clock::time_point SteadyNow() noexcept {
+		if (!steady_now_valid) {
+			steady_now = std::chrono::steady_clock::now();
+			steady_now_valid = true;
+		}
+
+		return steady_now;
+	}
+
+	/**
+	 * Like SteadyNow(), but read #CoarseSteadyClock, which is
+	 * cheaper, but lags behind by up to one kernel tick.  Do not
+	 * compare its values with those of SteadyNow() where a few
+	 * milliseconds matter.  This is used by the #TimerWheel.
+	 */
+	std::chrono::steady_clock::time_point CoarseSteadyNow() noexcept {
+		if (!coarse_steady_now_valid) {
+			coarse_steady_now = CoarseSteadyClock::now();
+			coarse_steady_now_valid = true;
+		}
+
+		return coarse_steady_now;
+	}
+
+	/**
+	 * Like SteadyNow(), but returns the wall-clock time.
+	 */
+	std::chrono::system_clock::time_point SystemNow() noexcept {
+		if (!system_now_valid) {
+			system_now = std::chrono::system_clock::now();
+			system_now_valid = true;
+		}
+
+		return system_now;
+	}
+
+	/**
+	 * Discard the cached time stamps, forcing the next
+	 * SteadyNow()/CoarseSteadyNow()/SystemNow() call to read the
+	 * clock.  This is done automatically before waiting for
+	 * events; call it manually after an operation which may have
+	 * blocked for a noticeable amount of time.
+	 */
+	void FlushClockCaches() noexcept {
+		steady_now_valid = coarse_steady_now_valid =
+			system_now_valid = false;
+	}
+
 	void Defer(DeferEvent &e);
 	void CancelDefer(DeferEvent &e);
 
+	/**
+	 * Add an #InjectEvent to the inject queue.  This method is
+	 * thread-safe.  Use InjectEvent::Schedule() instead of calling
+	 * this method directly.
+	 */
+	void Inject(InjectEvent &e) noexcept;
+
+	/**
+	 * Remove an #InjectEvent from the inject queue.  This must be
+	 * called from the #EventLoop thread.
+	 */
+	void RemoveInject(InjectEvent &e) noexcept;
+
+	/**
+	 * Called by the #InjectEvent constructor and destructor.
+	 */
+	void AddInjectEvent() noexcept;
+	void RemoveInjectEvent() noexcept;
+
+	/**
+	 * Insert a #CoarseTimerEvent into the #TimerWheel.  Use
+	 * CoarseTimerEvent::Schedule() instead of calling this
+	 * method directly.
+	 */
+	void AddCoarseTimer(CoarseTimerEvent &t) noexcept;
+
 private:
 	bool Loop(int flags) {
-		return ::event_base_loop(event_base, flags) == 0;
+		FlushClockCaches();
+
+		if (instrumentation != nullptr)
+			BeginIteration();
+
+		TRACE_POINT(event_loop_begin, this);
+		const bool result = ::event_base_loop(event_base, flags) == 0;
+		TRACE_POINT(event_loop_end, this);
+		return result;
 	}
 
+	/**
+	 * Like Loop(), but run DeferEvent::Priority::IDLE events if
+	 * there is nothing else to do.
+	 */
+	bool Poll(int flags);
+
 	bool RunDeferred();
 
+	/**
+	 * Run up to #idle_budget idle events.
+	 */
+	void RunIdle();
+
+	void BeginIteration() noexcept;
+	void FinishHandler(EventHandlerType type,
+			   std::chrono::steady_clock::time_point start,
+			   const void *instance,
+			   const void *function) noexcept;
+
+	void FetchInjected() noexcept;
+	void RunInjected() noexcept;
+	static void OnInject(evutil_socket_t fd, short events,
+			     void *ctx) noexcept;
+
+	void ScheduleCoarseTimers(TimerWheel::Duration d) noexcept;
+	void RunCoarseTimers() noexcept;
+	static void OnCoarseTimer(evutil_socket_t fd, short events,
+				  void *ctx) noexcept;
+
 	bool RunPost() {
 #ifndef NDEBUG
 		if (post_callback)
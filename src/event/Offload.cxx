@@ -0,0 +1,122 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Offload.hxx"
+
+void
+OffloadQueue::Operation::Run() noexcept
+{
+	if (!canceled.load(std::memory_order_relaxed))
+		Execute();
+
+	queue.OnOperationDone(*this);
+}
+
+OffloadQueue::OffloadQueue(EventLoop &loop, WorkStealingPool &_pool) noexcept
+	:pool(_pool),
+	 inject_event(loop, BIND_THIS_METHOD(OnInject))
+{
+}
+
+OffloadQueue::~OffloadQueue() noexcept
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		cond.wait(lock, [this]{ return n_running == 0; });
+	}
+
+	Operation *operation = TakeDone();
+	while (operation != nullptr) {
+		Operation *next = operation->next;
+		delete operation;
+		operation = next;
+	}
+}
+
+void
+OffloadQueue::Submit(Operation &operation)
+{
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		++n_running;
+	}
+
+	try {
+		pool.Submit(operation);
+	} catch (...) {
+		const std::lock_guard<std::mutex> lock(mutex);
+		--n_running;
+		throw;
+	}
+}
+
+void
+OffloadQueue::OnOperationDone(Operation &operation) noexcept
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+
+	*done_tail = &operation;
+	done_tail = &operation.next;
+
+	/* both of these must happen while the mutex is held: as soon
+	   as it is released with n_running==0, the destructor may
+	   free this object */
+	inject_event.Schedule();
+
+	if (--n_running == 0)
+		cond.notify_all();
+}
+
+OffloadQueue::Operation *
+OffloadQueue::TakeDone() noexcept
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+
+	Operation *head = done_head;
+	done_head = nullptr;
+	done_tail = &done_head;
+	return head;
+}
+
+void
+OffloadQueue::OnInject() noexcept
+{
+	Operation *operation = TakeDone();
+	while (operation != nullptr) {
+		Operation *next = operation->next;
+
+		if (!operation->canceled.load(std::memory_order_relaxed))
+			operation->Complete();
+
+		delete operation;
+		operation = next;
+	}
+}
@@ -0,0 +1,264 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include "InjectEvent.hxx"
+#include "util/WorkStealingPool.hxx"
+#include "util/Cancellable.hxx"
+#include "util/Manual.hxx"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+#include <stddef.h>
+
+/**
+ * Runs CPU-bound functions (key generation, regex compilation,
+ * parsing large files) on a #WorkStealingPool and delivers their
+ * results back to the #EventLoop thread through an #InjectEvent, so
+ * heavy work does not block latency-sensitive I/O.
+ *
+ * All methods must be called in the #EventLoop thread.
+ */
+class OffloadQueue final {
+	class Operation : public WorkStealingPool::Job, public Cancellable {
+		friend class OffloadQueue;
+
+		OffloadQueue &queue;
+
+		/**
+		 * The next item in #done; protected by
+		 * OffloadQueue::mutex.
+		 */
+		Operation *next = nullptr;
+
+		/**
+		 * Set by Cancel() in the #EventLoop thread; read by
+		 * the worker to skip the work if it has not started
+		 * yet.
+		 */
+		std::atomic<bool> canceled{false};
+
+	protected:
+		explicit Operation(OffloadQueue &_queue) noexcept
+			:queue(_queue) {}
+
+		virtual ~Operation() noexcept = default;
+
+		/**
+		 * Do the work; called in a worker thread.
+		 */
+		virtual void Execute() noexcept = 0;
+
+		/**
+		 * Deliver the result; called in the #EventLoop
+		 * thread.
+		 */
+		virtual void Complete() noexcept = 0;
+
+	private:
+		/* virtual methods from WorkStealingPool::Job */
+		void Run() noexcept final;
+
+		/* virtual methods from Cancellable */
+		void Cancel() noexcept override {
+			canceled.store(true, std::memory_order_relaxed);
+		}
+	};
+
+	/**
+	 * Stores the return value of a work function (or nothing if
+	 * it returns void) and passes it to the success handler.
+	 */
+	template<typename R>
+	class Result {
+		Manual<R> value;
+		bool defined = false;
+
+	public:
+		~Result() noexcept {
+			if (defined)
+				value.Destruct();
+		}
+
+		template<typename W>
+		void Set(W &work) {
+			value.Construct(work());
+			defined = true;
+		}
+
+		template<typename S>
+		void Invoke(S &on_success) {
+			on_success(std::move(value.Get()));
+		}
+	};
+
+	template<typename W, typename S, typename E>
+	class OperationImpl final : public Operation {
+		W work;
+		S on_success;
+		E on_error;
+
+		Result<typename std::result_of<W()>::type> result;
+		std::exception_ptr error;
+
+	public:
+		template<typename W2, typename S2, typename E2>
+		OperationImpl(OffloadQueue &_queue,
+			      W2 &&_work, S2 &&_on_success, E2 &&_on_error)
+			:Operation(_queue),
+			 work(std::forward<W2>(_work)),
+			 on_success(std::forward<S2>(_on_success)),
+			 on_error(std::forward<E2>(_on_error)) {}
+
+	private:
+		void Execute() noexcept override {
+			try {
+				result.Set(work);
+			} catch (...) {
+				error = std::current_exception();
+			}
+		}
+
+		void Complete() noexcept override {
+			if (error)
+				on_error(std::move(error));
+			else
+				result.Invoke(on_success);
+		}
+	};
+
+	WorkStealingPool &pool;
+
+	InjectEvent inject_event;
+
+	std::mutex mutex;
+	std::condition_variable cond;
+
+	/**
+	 * Operations which have been executed (or skipped) and are
+	 * waiting for the #EventLoop thread; protected by #mutex.
+	 */
+	Operation *done_head = nullptr, **done_tail = &done_head;
+
+	/**
+	 * The number of operations which have been submitted and
+	 * are not yet in #done_head; protected by #mutex.
+	 */
+	size_t n_running = 0;
+
+public:
+	OffloadQueue(EventLoop &loop, WorkStealingPool &_pool) noexcept;
+
+	/**
+	 * Waits for all operations which are currently being executed
+	 * (or are queued in the #WorkStealingPool) and discards their
+	 * results without invoking any handler.
+	 */
+	~OffloadQueue() noexcept;
+
+	OffloadQueue(const OffloadQueue &) = delete;
+	OffloadQueue &operator=(const OffloadQueue &) = delete;
+
+	EventLoop &GetEventLoop() noexcept {
+		return inject_event.GetEventLoop();
+	}
+
+	/**
+	 * Run a function in the #WorkStealingPool.  Its return value
+	 * is passed to @on_success in the #EventLoop thread; if it
+	 * throws, @on_error is invoked with the std::exception_ptr
+	 * instead.  After cancellation, neither is invoked (but the
+	 * work function may still run if it has already started).
+	 *
+	 * Throws std::bad_alloc on error.
+	 *
+	 * @param work a function which is called in a worker thread;
+	 * it must not access #EventLoop objects
+	 * @param on_success a function which gets the result (or no
+	 * argument if @work returns void)
+	 * @param on_error a function which gets a std::exception_ptr
+	 */
+	template<typename W, typename S, typename E>
+	void Submit(W &&work, S &&on_success, E &&on_error,
+		    CancellablePointer &cancel_ptr) {
+		auto *operation = new OperationImpl<typename std::decay<W>::type,
+						    typename std::decay<S>::type,
+						    typename std::decay<E>::type>
+			(*this, std::forward<W>(work),
+			 std::forward<S>(on_success),
+			 std::forward<E>(on_error));
+
+		try {
+			Submit(*operation);
+		} catch (...) {
+			delete operation;
+			throw;
+		}
+
+		cancel_ptr = *operation;
+	}
+
+private:
+	void Submit(Operation &operation);
+
+	/**
+	 * Called by the worker thread after the operation has been
+	 * executed.
+	 */
+	void OnOperationDone(Operation &operation) noexcept;
+
+	/**
+	 * Detach the list of finished operations.
+	 */
+	Operation *TakeDone() noexcept;
+
+	void OnInject() noexcept;
+};
+
+template<>
+class OffloadQueue::Result<void> {
+public:
+	template<typename W>
+	void Set(W &work) {
+		work();
+	}
+
+	template<typename S>
+	void Invoke(S &on_success) {
+		on_success();
+	}
+};
@@ -32,31 +32,25 @@
 
 #include "PipeLineReader.hxx"
 
+#include <assert.h>
+#include <errno.h>
 #include <string.h>
 
-void
-PipeLineReader::TryRead(bool flush)
+inline bool
+PipeLineReader::SubmitLines()
 {
-	assert(!buffer.IsFull());
-
-	auto w = buffer.Write();
-	assert(!w.empty());
-
-	auto nbytes = fd.Read(w.data, w.size);
-	if (nbytes <= 0) {
-		event.Delete();
-		callback(nullptr);
-		return;
-	}
-
-	buffer.Append(nbytes);
-
 	while (true) {
 		auto r = buffer.Read();
-		char *newline = (char *)memchr(r.data, '\n', r.size);
-		if (newline == nullptr)
-			break;
+		assert(scan_position <= r.size);
 
+		char *newline = (char *)memchr(r.data + scan_position, '\n',
+					       r.size - scan_position);
+		if (newline == nullptr) {
+			scan_position = r.size;
+			return true;
+		}
+
+		scan_position = 0;
 		buffer.Consume(newline + 1 - r.data);
 
 		while (newline > r.data && newline[-1] == '\r')
@@ -64,14 +58,59 @@ PipeLineReader::TryRead(bool flush)
 
 		r.size = newline - r.data;
 		if (!callback(r))
-			return;
+			return false;
 	}
+}
 
-	if (flush || buffer.IsFull()) {
-		auto r = buffer.Read();
-		buffer.Clear();
+inline bool
+PipeLineReader::SubmitRest()
+{
+	auto r = buffer.Read();
+	buffer.Clear();
+	scan_position = 0;
+
+	return r.empty() || callback(r);
+}
 
-		if (!r.empty())
-			callback(r);
+void
+PipeLineReader::TryRead(bool flush)
+{
+	for (unsigned i = 0; i < MAX_READS; ++i) {
+		if (buffer.IsFull()) {
+			/* the buffer is full of one partial line */
+			if (buffer.GetCapacity() < MAX_LINE_LENGTH)
+				buffer.Grow(buffer.GetCapacity() * 2);
+			else if (!SubmitRest())
+				/* too long: split it, but the callback
+				   has asked us to stop */
+				return;
+		}
+
+		auto w = buffer.Write();
+		assert(!w.empty());
+
+		auto nbytes = fd.Read(w.data, w.size);
+		if (nbytes < 0 && errno == EAGAIN)
+			/* the pipe is empty */
+			break;
+
+		if (nbytes <= 0) {
+			event.Delete();
+			callback(nullptr);
+			return;
+		}
+
+		buffer.Append(nbytes);
+
+		if (!SubmitLines())
+			return;
+
+		if (size_t(nbytes) < w.size)
+			/* the pipe is probably empty; don't waste a
+			   system call */
+			break;
 	}
+
+	if (flush)
+		SubmitRest();
 }
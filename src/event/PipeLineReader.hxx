@@ -34,31 +34,55 @@
 
 #include "SocketEvent.hxx"
 #include "io/UniqueFileDescriptor.hxx"
+#include "io/MirroredFifoBuffer.hxx"
 #include "util/BindMethod.hxx"
-#include "util/StaticFifoBuffer.hxx"
 #include "util/WritableBuffer.hxx"
 
 /**
  * Read text lines from a (non-blocking) pipe.  Whenever a newline
  * character is found, the line (without trailing NL/CR characters) is
  * passed to the callback.
+ *
+ * The buffer grows for long lines up to #MAX_LINE_LENGTH; only lines
+ * longer than that are split.  It is a #MirroredFifoBuffer, so a
+ * partial line at the end never needs to be moved to the front.
  */
 class PipeLineReader {
+	static constexpr size_t INITIAL_BUFFER_SIZE = 8192;
+	static constexpr size_t MAX_LINE_LENGTH = 1024 * 1024;
+
+	/**
+	 * The maximum number of read() calls per event; this is a
+	 * tradeoff between batching and fairness.
+	 */
+	static constexpr unsigned MAX_READS = 8;
+
 	UniqueFileDescriptor fd;
 	SocketEvent event;
 
-	StaticFifoBuffer<char, 8192> buffer;
+	MirroredFifoBuffer<char> buffer;
+
+	/**
+	 * The number of bytes at the beginning of #buffer which are
+	 * known to contain no newline character.  This avoids
+	 * scanning a long line again after each read().
+	 */
+	size_t scan_position = 0;
 
 	typedef BoundMethod<bool(WritableBuffer<char> line)> Callback;
 	const Callback callback;
 
 public:
+	/**
+	 * Throws std::system_error if the buffer cannot be allocated.
+	 */
 	PipeLineReader(EventLoop &event_loop,
 		       UniqueFileDescriptor &&_fd,
 		       Callback _callback)
 		:fd(std::move(_fd)),
 		 event(event_loop, fd.Get(), SocketEvent::READ|SocketEvent::PERSIST,
 		       BIND_THIS_METHOD(OnPipeReadable)),
+		 buffer(INITIAL_BUFFER_SIZE),
 		 callback(_callback) {
 		event.Add();
 	}
@@ -81,6 +105,21 @@ public:
 private:
 	void TryRead(bool flush);
 
+	/**
+	 * Pass all complete lines in the buffer to the callback.
+	 *
+	 * @return false if the callback has returned false
+	 */
+	bool SubmitLines();
+
+	/**
+	 * Pass the rest of the buffer to the callback, even though
+	 * it is not terminated with a newline character.
+	 *
+	 * @return false if the callback has returned false
+	 */
+	bool SubmitRest();
+
 	void OnPipeReadable(unsigned) {
 		TryRead(false);
 	}
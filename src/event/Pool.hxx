@@ -0,0 +1,92 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Thread.hxx"
+
+#include <memory>
+#include <vector>
+
+/**
+ * A pool of #EventThread instances, usually one per CPU.
+ */
+class EventLoopPool {
+	std::vector<std::unique_ptr<EventThread>> threads;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param n the number of threads; 0 means one for each CPU
+	 * @param pin_cpus pin thread i to CPU i?
+	 */
+	explicit EventLoopPool(unsigned n=0, bool pin_cpus=true);
+
+	~EventLoopPool() noexcept {
+		Stop();
+	}
+
+	EventLoopPool(const EventLoopPool &) = delete;
+	EventLoopPool &operator=(const EventLoopPool &) = delete;
+
+	unsigned size() const noexcept {
+		return threads.size();
+	}
+
+	EventLoop &GetEventLoop(unsigned i) noexcept {
+		return threads[i]->GetEventLoop();
+	}
+
+	/**
+	 * Invoke the given function for each #EventLoop.  This may
+	 * be used to set up per-thread objects before Start() is
+	 * called.
+	 */
+	template<typename F>
+	void ForEach(F &&f) {
+		for (auto &i : threads)
+			f(i->GetEventLoop());
+	}
+
+	/**
+	 * Launch all threads.
+	 *
+	 * Throws on error.
+	 */
+	void Start();
+
+	/**
+	 * Stop all threads and wait for them to exit.
+	 */
+	void Stop() noexcept;
+};
@@ -34,10 +34,19 @@
 #include "system/Error.hxx"
 
 #include <sys/signalfd.h>
+#include <errno.h>
 #include <unistd.h>
 
 SignalEvent::SignalEvent(EventLoop &loop, Callback _callback)
-	:event(loop, BIND_THIS_METHOD(EventCallback)), callback(_callback)
+	:event(loop, BIND_THIS_METHOD(EventCallback)),
+	 callback(_callback), info_callback(nullptr)
+{
+	sigemptyset(&mask);
+}
+
+SignalEvent::SignalEvent(EventLoop &loop, InfoCallback _callback)
+	:event(loop, BIND_THIS_METHOD(EventCallback)),
+	 callback(nullptr), info_callback(_callback)
 {
 	sigemptyset(&mask);
 }
@@ -74,13 +83,26 @@ SignalEvent::Disable()
 void
 SignalEvent::EventCallback(unsigned)
 {
-	struct signalfd_siginfo info;
-	ssize_t nbytes = read(fd, &info, sizeof(info));
+	struct signalfd_siginfo info[MAX_BATCH];
+	ssize_t nbytes = read(fd, info, sizeof(info));
 	if (nbytes <= 0) {
+		if (nbytes < 0 && errno == EAGAIN)
+			return;
+
 		// TODO: log error?
 		Disable();
 		return;
 	}
 
-	callback(info.ssi_signo);
+	const size_t n = size_t(nbytes) / sizeof(info[0]);
+
+	if (info_callback) {
+		info_callback({info, n});
+		return;
+	}
+
+	/* the callback may disable this object; stop delivering the
+	   rest of the batch in that case */
+	for (size_t i = 0; i < n && event.IsPending(SocketEvent::READ); ++i)
+		callback(info[i].ssi_signo);
 }
@@ -35,10 +35,13 @@
 
 #include "SocketEvent.hxx"
 #include "util/BindMethod.hxx"
+#include "util/ConstBuffer.hxx"
 
 #include <assert.h>
 #include <signal.h>
 
+struct signalfd_siginfo;
+
 /**
  * Listen for signals delivered to this process, and then invoke a
  * callback.
@@ -46,6 +49,14 @@
  * After constructing an instance, call Add() to add signals to listen
  * on.  When done, call Enable().  After that, Add() must not be
  * called again.
+ *
+ * All pending signals are read with one system call.  The callback
+ * gets either only the signal number (#Callback, invoked once per
+ * signal) or the whole batch of #signalfd_siginfo structs
+ * (#InfoCallback), which contain details such as the sender's pid
+ * or (for SIGCHLD) the child's exit status.  Note that the kernel
+ * does not queue multiple instances of a standard (non-realtime)
+ * signal, so one SIGCHLD may stand for several exited children.
  */
 class SignalEvent {
 	int fd = -1;
@@ -55,16 +66,30 @@ class SignalEvent {
 	sigset_t mask;
 
 	typedef BoundMethod<void(int)> Callback;
+	typedef BoundMethod<void(ConstBuffer<struct signalfd_siginfo>)> InfoCallback;
+
 	const Callback callback;
+	const InfoCallback info_callback;
+
+	/**
+	 * The maximum number of signals read at a time.
+	 */
+	static constexpr size_t MAX_BATCH = 16;
 
 public:
 	SignalEvent(EventLoop &loop, Callback _callback);
+	SignalEvent(EventLoop &loop, InfoCallback _callback);
 
 	SignalEvent(EventLoop &loop, int signo, Callback _callback)
 		:SignalEvent(loop, _callback) {
 		Add(signo);
 	}
 
+	SignalEvent(EventLoop &loop, int signo, InfoCallback _callback)
+		:SignalEvent(loop, _callback) {
+		Add(signo);
+	}
+
 	~SignalEvent();
 
 	bool IsDefined() const {
@@ -50,6 +50,15 @@ public:
 	static constexpr unsigned PERSIST = EV_PERSIST;
 	static constexpr unsigned TIMEOUT = EV_TIMEOUT;
 
+	/**
+	 * Edge-triggered: the event fires only when the socket
+	 * becomes ready, not as long as it is ready; the handler
+	 * must therefore consume everything until EAGAIN.  Only
+	 * supported by the epoll backend, which libevent uses on
+	 * Linux.
+	 */
+	static constexpr unsigned EDGE_TRIGGERED = EV_ET;
+
 	SocketEvent(EventLoop &_event_loop, Callback _callback)
 		:event_loop(_event_loop), callback(_callback) {}
 
@@ -103,7 +112,9 @@ private:
 	static void EventCallback(gcc_unused evutil_socket_t fd, short events,
 				  void *ctx) {
 		auto &event = *(SocketEvent *)ctx;
-		event.callback(events);
+		event.event_loop.InvokeHandler(EventHandlerType::SOCKET,
+					       event.callback,
+					       unsigned(events));
 	}
 };
 
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Thread.hxx"
+#include "system/Error.hxx"
+
+#include <pthread.h>
+#include <sched.h>
+
+EventThread::EventThread(int _cpu)
+	:cpu(_cpu),
+	 stop_event(event_loop, BIND_THIS_METHOD(OnStop))
+{
+}
+
+EventThread::~EventThread() noexcept
+{
+	Stop();
+}
+
+void
+EventThread::Start()
+{
+	assert(!IsRunning());
+
+	thread = std::thread(&EventThread::Run, this);
+
+	if (cpu >= 0) {
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		CPU_SET(cpu, &cpuset);
+
+		int error = pthread_setaffinity_np(thread.native_handle(),
+						   sizeof(cpuset), &cpuset);
+		if (error != 0)
+			throw MakeErrno(error, "pthread_setaffinity_np() failed");
+	}
+}
+
+void
+EventThread::Stop() noexcept
+{
+	if (!IsRunning())
+		return;
+
+	stop_event.Schedule();
+	thread.join();
+}
+
+void
+EventThread::Run() noexcept
+{
+	event_loop.Dispatch();
+}
+
+void
+EventThread::OnStop() noexcept
+{
+	event_loop.Break();
+}
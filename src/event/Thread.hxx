@@ -0,0 +1,101 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Loop.hxx"
+#include "InjectEvent.hxx"
+
+#include <thread>
+
+/**
+ * A thread running an #EventLoop.  The thread may optionally be
+ * pinned to one CPU.
+ */
+class EventThread final {
+	EventLoop event_loop;
+
+	/**
+	 * The CPU this thread shall be pinned to; -1 means no
+	 * pinning.
+	 */
+	const int cpu;
+
+	/**
+	 * Used by Stop() to break the event loop from another
+	 * thread.
+	 */
+	InjectEvent stop_event;
+
+	std::thread thread;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param _cpu the CPU this thread shall be pinned to; -1
+	 * disables pinning
+	 */
+	explicit EventThread(int _cpu=-1);
+
+	~EventThread() noexcept;
+
+	EventThread(const EventThread &) = delete;
+	EventThread &operator=(const EventThread &) = delete;
+
+	EventLoop &GetEventLoop() noexcept {
+		return event_loop;
+	}
+
+	bool IsRunning() const noexcept {
+		return thread.joinable();
+	}
+
+	/**
+	 * Launch the thread.  Before this call, the #EventLoop may be
+	 * set up from the calling thread; after it, only the new
+	 * thread may access it.
+	 *
+	 * Throws on error.
+	 */
+	void Start();
+
+	/**
+	 * Ask the thread to leave its event loop and wait for it to
+	 * exit.  May be called from any thread except this one.
+	 */
+	void Stop() noexcept;
+
+private:
+	void Run() noexcept;
+	void OnStop() noexcept;
+};
@@ -40,13 +40,20 @@
  * Invoke an event callback after a certain amount of time.
  */
 class TimerEvent {
+	EventLoop &loop;
+
 	Event event;
 
 	const BoundMethod<void()> callback;
 
 public:
-	TimerEvent(EventLoop &loop, BoundMethod<void()> _callback)
-		:event(loop, -1, 0, Callback, this), callback(_callback) {}
+	TimerEvent(EventLoop &_loop, BoundMethod<void()> _callback)
+		:loop(_loop), event(loop, -1, 0, Callback, this),
+		 callback(_callback) {}
+
+	EventLoop &GetEventLoop() {
+		return loop;
+	}
 
 	bool IsPending() const {
 		return event.IsTimerPending();
@@ -65,7 +72,8 @@ private:
 			     gcc_unused short events,
 			     void *ctx) {
 		auto &event = *(TimerEvent *)ctx;
-		event.callback();
+		event.loop.InvokeHandler(EventHandlerType::TIMER,
+					 event.callback);
 	}
 };
 
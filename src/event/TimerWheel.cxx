@@ -0,0 +1,105 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "TimerWheel.hxx"
+
+#include <algorithm>
+
+constexpr TimerWheel::Duration TimerWheel::RESOLUTION;
+
+TimerWheel::TimerWheel() noexcept
+	:last_tick(ToTick(Clock::now()))
+{
+}
+
+bool
+TimerWheel::IsEmpty() const noexcept
+{
+	return std::all_of(buckets.begin(), buckets.end(),
+			   [](const List &list){
+				   return list.empty();
+			   });
+}
+
+void
+TimerWheel::Insert(CoarseTimerEvent &t) noexcept
+{
+	/* never insert into a bucket which has already been
+	   processed in this round */
+	const auto tick = std::max(ToTick(t.GetDue()), last_tick + 1);
+	GetBucket(tick).push_back(t);
+}
+
+inline void
+TimerWheel::RunBucket(List &bucket, uint_least64_t tick) noexcept
+{
+	/* move the bucket contents to a temporary list, to be able to
+	   deal with timers being added or canceled by callbacks */
+	List tmp;
+	tmp.splice(tmp.end(), bucket);
+
+	while (!tmp.empty()) {
+		auto &t = tmp.front();
+		tmp.pop_front();
+
+		if (ToTick(t.GetDue()) <= tick)
+			t.Run();
+		else
+			/* due in a later round */
+			bucket.push_back(t);
+	}
+}
+
+TimerWheel::Duration
+TimerWheel::Run(TimePoint now) noexcept
+{
+	/* only ticks which have elapsed completely are processed, so
+	   timers never fire too early */
+	const auto end_tick = ToTick(now) - 1;
+
+	if (end_tick > last_tick) {
+		auto tick = end_tick - last_tick > N_BUCKETS
+			? end_tick - N_BUCKETS + 1
+			: last_tick + 1;
+
+		for (; tick <= end_tick; ++tick) {
+			last_tick = tick;
+			RunBucket(GetBucket(tick), end_tick);
+		}
+	}
+
+	if (IsEmpty())
+		return Duration(-1);
+
+	/* wake up again when the next tick has elapsed */
+	return TimePoint((last_tick + 2) * RESOLUTION) - now;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "CoarseTimerEvent.hxx"
+#include "util/Compiler.h"
+
+#include <boost/intrusive/list.hpp>
+
+#include <array>
+
+#include <stdint.h>
+
+/**
+ * A hashed timer wheel for #CoarseTimerEvent instances.  Each bucket
+ * covers one #RESOLUTION tick; timers are appended to the bucket of
+ * their due tick (modulo the number of buckets), which makes
+ * inserting and removing O(1) operations, independent of the number of
+ * pending timers.
+ */
+class TimerWheel final {
+public:
+	typedef CoarseTimerEvent::Clock Clock;
+	typedef CoarseTimerEvent::Duration Duration;
+	typedef CoarseTimerEvent::TimePoint TimePoint;
+
+	static constexpr Duration RESOLUTION = std::chrono::seconds(1);
+
+private:
+	static constexpr size_t N_BUCKETS = 64;
+
+	typedef boost::intrusive::list<CoarseTimerEvent,
+				       boost::intrusive::member_hook<CoarseTimerEvent,
+								     CoarseTimerEvent::SiblingsHook,
+								     &CoarseTimerEvent::siblings>,
+				       boost::intrusive::constant_time_size<false>> List;
+
+	std::array<List, N_BUCKETS> buckets;
+
+	/**
+	 * All ticks up to (and including) this one have been
+	 * processed by Run().
+	 */
+	uint_least64_t last_tick;
+
+public:
+	TimerWheel() noexcept;
+
+	TimerWheel(const TimerWheel &) = delete;
+	TimerWheel &operator=(const TimerWheel &) = delete;
+
+	gcc_pure
+	bool IsEmpty() const noexcept;
+
+	void Insert(CoarseTimerEvent &t) noexcept;
+
+	/**
+	 * Invoke all expired timers.
+	 *
+	 * @return the time until Run() should be called again, or a
+	 * negative value if there are no more timers
+	 */
+	Duration Run(TimePoint now) noexcept;
+
+private:
+	static uint_least64_t ToTick(TimePoint t) noexcept {
+		return t.time_since_epoch() / RESOLUTION;
+	}
+
+	List &GetBucket(uint_least64_t tick) noexcept {
+		return buckets[tick % N_BUCKETS];
+	}
+
+	/**
+	 * Invoke all timers of the given bucket which are due on or
+	 * before the given tick.
+	 */
+	void RunBucket(List &bucket, uint_least64_t tick) noexcept;
+};
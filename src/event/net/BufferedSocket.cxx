@@ -34,8 +34,11 @@
 #include "system/Error.hxx"
 #include "net/SocketProtocolError.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/Macros.hxx"
+#include "util/Trace.h"
 
 #include <utility>
+#include <algorithm>
 
 #include <errno.h>
 
@@ -172,8 +175,12 @@ BufferedSocket::InvokeData() noexcept
 bool
 BufferedSocket::SubmitFromBuffer() noexcept
 {
-	if (IsEmpty())
+	if (IsEmpty()) {
+		/* the handler may have consumed everything outside of
+		   OnBufferedData(); give the buffer back to the pool */
+		input.FreeIfDefined();
 		return true;
+	}
 
 	const bool old_expect_more = expect_more;
 	expect_more = false;
@@ -186,7 +193,7 @@ BufferedSocket::SubmitFromBuffer() noexcept
 		assert(input.IsEmpty());
 		assert(!expect_more);
 
-		input.Free();
+		input.FreeIfDefined();
 
 		if (!IsConnected()) {
 			Ended();
@@ -290,6 +297,9 @@ BufferedSocket::SubmitDirect() noexcept
 		return false;
 
 	case DirectResult::EMPTY:
+		/* the handler's read failed with EAGAIN */
+		base.SetReadDrained();
+
 		/* schedule read, but don't refresh timeout of old scheduled
 		   read */
 		if (!base.IsReadPending())
@@ -321,6 +331,7 @@ BufferedSocket::FillBuffer() noexcept
 		input.Allocate();
 
 	ssize_t nbytes = base.ReadToBuffer(input);
+	TRACE_POINT(buffered_socket_read, this, nbytes);
 	if (gcc_likely(nbytes > 0)) {
 		/* success: data was added to the buffer */
 		expect_more = false;
@@ -441,6 +452,16 @@ BufferedSocket::OnSocketWrite() noexcept
 	assert(!destroyed);
 	assert(!ended);
 
+	if (!corked.IsEmpty()) {
+		if (!TryFlushCorked())
+			return false;
+
+		if (!corked.IsEmpty())
+			/* still not all corked data sent; wait for the
+			   next event */
+			return true;
+	}
+
 	try {
 		return handler->OnBufferedWrite();
 	} catch (...) {
@@ -464,9 +485,20 @@ BufferedSocket::OnSocketTimeout() noexcept
 	assert(!destroyed);
 	assert(!ended);
 
+	TRACE_POINT(buffered_socket_timeout, this);
+
 	return handler->OnBufferedTimeout();
 }
 
+bool
+BufferedSocket::OnSocketZeroCopyCompleted(uint32_t first,
+					  uint32_t last) noexcept
+{
+	assert(!destroyed);
+
+	return handler->OnBufferedZeroCopyCompleted(first, last);
+}
+
 /*
  * public API
  *
@@ -484,7 +516,9 @@ BufferedSocket::Init(SocketDescriptor _fd, FdType _fd_type,
 	write_timeout = _write_timeout;
 
 	handler = &_handler;
-	input.SetNull();
+	input.FreeIfDefined();
+	corked.FreeIfDefined();
+	cork_threshold = 0;
 	direct = false;
 	expect_more = false;
 	destroyed = false;
@@ -528,6 +562,11 @@ BufferedSocket::Init(BufferedSocket &&src,
 
 	/* steal the input buffer (after we already stole the socket) */
 	input = std::move(src.input);
+	corked = std::move(src.corked);
+	cork_threshold = src.cork_threshold;
+	if (!corked.IsEmpty())
+		defer_flush.Schedule();
+	src.defer_flush.Cancel();
 
 	direct = false;
 	expect_more = false;
@@ -547,6 +586,7 @@ BufferedSocket::Destroy() noexcept
 	assert(!destroyed);
 
 	input.FreeIfDefined();
+	corked.FreeIfDefined();
 
 	destroyed = true;
 }
@@ -587,47 +627,90 @@ BufferedSocket::Read(bool _expect_more) noexcept
 }
 
 ssize_t
-BufferedSocket::Write(const void *data, size_t length) noexcept
+BufferedSocket::HandleWriteError(ssize_t nbytes) noexcept
 {
-	ssize_t nbytes = base.Write(data, length);
-
-	if (gcc_unlikely(nbytes < 0)) {
-		const int e = errno;
-		if (gcc_likely(e == EAGAIN)) {
-			ScheduleWrite();
-			return WRITE_BLOCKING;
-		} else if (e == EPIPE || e == ECONNRESET) {
-			enum write_result r = handler->OnBufferedBroken();
+	assert(nbytes < 0);
+
+	const int e = errno;
+	if (gcc_likely(e == EAGAIN)) {
+		ScheduleWrite();
+		return WRITE_BLOCKING;
+	} else if (e == EPIPE || e == ECONNRESET) {
+		enum write_result r = handler->OnBufferedBroken();
+		if (r == WRITE_BROKEN)
+			UnscheduleWrite();
+
+		nbytes = ssize_t(r);
+	}
 
-			if (r == WRITE_BROKEN)
-				UnscheduleWrite();
+	return nbytes;
+}
 
-			nbytes = ssize_t(r);
-		}
+ssize_t
+BufferedSocket::Write(const void *data, size_t length) noexcept
+{
+	if (cork_threshold > 0) {
+		struct iovec v;
+		v.iov_base = const_cast<void *>(data);
+		v.iov_len = length;
+		return CorkedWriteV(&v, 1);
 	}
 
+	ssize_t nbytes = base.Write(data, length);
+	TRACE_POINT(buffered_socket_write, this, nbytes);
+	if (gcc_unlikely(nbytes < 0))
+		nbytes = HandleWriteError(nbytes);
+
 	return nbytes;
 }
 
 ssize_t
 BufferedSocket::WriteV(const struct iovec *v, size_t n) noexcept
 {
+	if (cork_threshold > 0)
+		return CorkedWriteV(v, n);
+
 	ssize_t nbytes = base.WriteV(v, n);
+	TRACE_POINT(buffered_socket_write, this, nbytes);
+	if (gcc_unlikely(nbytes < 0))
+		nbytes = HandleWriteError(nbytes);
 
-	if (gcc_unlikely(nbytes < 0)) {
-		const int e = errno;
-		if (gcc_likely(e == EAGAIN)) {
-			ScheduleWrite();
-			return WRITE_BLOCKING;
-		} else if (e == EPIPE || e == ECONNRESET) {
-			enum write_result r = handler->OnBufferedBroken();
-			if (r == WRITE_BROKEN)
-				UnscheduleWrite();
+	return nbytes;
+}
 
-			nbytes = ssize_t(r);
-		}
+ssize_t
+BufferedSocket::WriteZeroCopy(const void *data, size_t length,
+			      uint32_t &id_r, bool &zerocopy_r) noexcept
+{
+	struct iovec v;
+	v.iov_base = const_cast<void *>(data);
+	v.iov_len = length;
+
+	return WriteVZeroCopy(&v, 1, id_r, zerocopy_r);
+}
+
+ssize_t
+BufferedSocket::WriteVZeroCopy(const struct iovec *v, size_t n,
+			       uint32_t &id_r, bool &zerocopy_r) noexcept
+{
+	zerocopy_r = true;
+
+	ssize_t nbytes = FlushCorkedBeforeWrite();
+	if (nbytes != 0) {
+		zerocopy_r = false;
+		return nbytes;
+	}
+
+	nbytes = base.WriteVZeroCopy(v, n, id_r);
+	if (gcc_unlikely(nbytes < 0) && errno == ENOBUFS) {
+		/* too many pinned pages: fall back to copying */
+		zerocopy_r = false;
+		nbytes = base.WriteV(v, n);
 	}
 
+	if (gcc_unlikely(nbytes < 0))
+		nbytes = HandleWriteError(nbytes);
+
 	return nbytes;
 }
 
@@ -635,7 +718,11 @@ ssize_t
 BufferedSocket::WriteFrom(int other_fd, FdType other_fd_type,
 			  size_t length) noexcept
 {
-	ssize_t nbytes = base.WriteFrom(other_fd, other_fd_type, length);
+	ssize_t nbytes = FlushCorkedBeforeWrite();
+	if (nbytes != 0)
+		return nbytes;
+
+	nbytes = base.WriteFrom(other_fd, other_fd_type, length);
 	if (gcc_unlikely(nbytes < 0)) {
 		const int e = errno;
 		if (gcc_likely(e == EAGAIN)) {
@@ -654,6 +741,169 @@ BufferedSocket::WriteFrom(int other_fd, FdType other_fd_type,
 	return nbytes;
 }
 
+ssize_t
+BufferedSocket::SendFile(int file_fd, off_t &offset, size_t length,
+			 bool one_shot) noexcept
+{
+	ssize_t nbytes = FlushCorkedBeforeWrite();
+	if (nbytes != 0)
+		return nbytes;
+
+	nbytes = base.SendFile(file_fd, offset, length, one_shot);
+	if (gcc_unlikely(nbytes < 0)) {
+		const int e = errno;
+		if (gcc_likely(e == EAGAIN)) {
+			if (!IsReadyForWriting()) {
+				ScheduleWrite();
+				return WRITE_BLOCKING;
+			}
+
+			/* try again, just in case our fd has become ready
+			   between the first sendfile() call and
+			   IsReadyForWriting() */
+			nbytes = base.SendFile(file_fd, offset, length, one_shot);
+		}
+	}
+
+	return nbytes;
+}
+
+void
+BufferedSocket::SetAutoCork(size_t threshold) noexcept
+{
+	assert(!destroyed);
+
+	cork_threshold = std::min(threshold, corked.GetPool().GetBufferSize());
+
+	if (cork_threshold == 0 && !corked.IsEmpty()) {
+		defer_flush.Cancel();
+		TryFlushCorked();
+	}
+}
+
+ssize_t
+BufferedSocket::CorkedWriteV(const struct iovec *v, size_t n) noexcept
+{
+	assert(cork_threshold > 0);
+
+	size_t length = 0;
+	for (size_t i = 0; i < n; ++i)
+		length += v[i].iov_len;
+
+	corked.AllocateIfNull();
+
+	auto w = corked.WriteCompact();
+	if (corked.GetAvailable() + length < cork_threshold &&
+	    length <= w.size) {
+		/* small write: collect it and flush later */
+		uint8_t *p = w.data;
+		for (size_t i = 0; i < n; ++i)
+			p = std::copy_n((const uint8_t *)v[i].iov_base,
+					v[i].iov_len, p);
+
+		corked.Append(length);
+		defer_flush.Schedule();
+		return length;
+	}
+
+	/* threshold reached: send the corked data together with the
+	   new data in one writev() */
+
+	struct iovec buffer[32];
+	size_t n_buffer = 0;
+
+	auto r = corked.Read();
+	if (!r.empty()) {
+		buffer[n_buffer].iov_base = r.data;
+		buffer[n_buffer].iov_len = r.size;
+		++n_buffer;
+	}
+
+	for (size_t i = 0; i < n && n_buffer < ARRAY_SIZE(buffer); ++i)
+		buffer[n_buffer++] = v[i];
+
+	ssize_t nbytes = base.WriteV(buffer, n_buffer);
+	if (gcc_unlikely(nbytes < 0)) {
+		corked.FreeIfEmpty();
+		return HandleWriteError(nbytes);
+	}
+
+	const size_t from_corked = std::min<size_t>(nbytes, r.size);
+	corked.Consume(from_corked);
+	nbytes -= from_corked;
+
+	if (corked.IsEmpty()) {
+		corked.Free();
+		defer_flush.Cancel();
+	} else {
+		/* not even the corked data was sent completely */
+		assert(nbytes == 0);
+		ScheduleWrite();
+		return WRITE_BLOCKING;
+	}
+
+	return nbytes;
+}
+
+bool
+BufferedSocket::TryFlushCorked() noexcept
+{
+	defer_flush.Cancel();
+
+	auto r = corked.Read();
+	if (r.empty()) {
+		corked.FreeIfDefined();
+		return true;
+	}
+
+	ssize_t nbytes = base.Write(r.data, r.size);
+	if (gcc_unlikely(nbytes < 0)) {
+		if (gcc_likely(errno == EAGAIN)) {
+			ScheduleWrite();
+			return true;
+		}
+
+		handler->OnBufferedError(std::make_exception_ptr(MakeErrno("Failed to send")));
+		return false;
+	}
+
+	corked.Consume(nbytes);
+	if (corked.IsEmpty())
+		corked.Free();
+	else
+		ScheduleWrite();
+
+	return true;
+}
+
+ssize_t
+BufferedSocket::FlushCorkedBeforeWrite() noexcept
+{
+	if (corked.IsEmpty())
+		return 0;
+
+	if (!TryFlushCorked())
+		return WRITE_DESTROYED;
+
+	if (!corked.IsEmpty())
+		return WRITE_BLOCKING;
+
+	return 0;
+}
+
+void
+BufferedSocket::DiscardCorked() noexcept
+{
+	defer_flush.Cancel();
+
+	if (!corked.IsEmpty() && base.IsValid()) {
+		auto r = corked.Read();
+		base.Write(r.data, r.size);
+	}
+
+	corked.FreeIfDefined();
+}
+
 void
 BufferedSocket::DeferRead(bool _expect_more) noexcept
 {
@@ -32,11 +32,12 @@
 
 #pragma once
 
-#include "DefaultFifoBuffer.hxx"
 #include "SocketWrapper.hxx"
 #include "event/DeferEvent.hxx"
+#include "util/PooledFifoBuffer.hxx"
 #include "util/DestructObserver.hxx"
 #include "util/LeakDetector.hxx"
+#include "util/InstanceCounter.hxx"
 
 #include <exception>
 
@@ -262,6 +263,18 @@ public:
 		return true;
 	}
 
+	/**
+	 * The buffers passed to BufferedSocket::WriteZeroCopy() with
+	 * the given (inclusive) range of ids have been transmitted by
+	 * the kernel and may now be reused or freed.
+	 *
+	 * @return false if the method has destroyed the socket
+	 */
+	virtual bool OnBufferedZeroCopyCompleted(gcc_unused uint32_t first,
+						 gcc_unused uint32_t last) noexcept {
+		return true;
+	}
+
 	/**
 	 * @return false when the socket has been closed
 	 */
@@ -308,7 +321,8 @@ public:
  *
  * - destroyed (after Destroy())
  */
-class BufferedSocket final : DestructAnchor, LeakDetector, SocketHandler {
+class BufferedSocket final : DestructAnchor, LeakDetector,
+	CountedInstance<BufferedSocket>, SocketHandler {
 	SocketWrapper base;
 
 	const struct timeval *read_timeout, *write_timeout;
@@ -320,7 +334,32 @@ class BufferedSocket final : DestructAnchor, LeakDetector, SocketHandler {
 
 	BufferedSocketHandler *handler;
 
-	DefaultFifoBuffer input;
+	/**
+	 * The input buffer.  It is borrowed from the
+	 * #EventLoop's #SlabBufferPool only while there is data in
+	 * it, so idle connections do not occupy buffer memory.
+	 */
+	PooledFifoBuffer input;
+
+	/**
+	 * Data collected by Write() and WriteV() in auto-cork mode,
+	 * see SetAutoCork().  Like #input, it is borrowed from the
+	 * #SlabBufferPool only while it contains data.
+	 */
+	PooledFifoBuffer corked;
+
+	/**
+	 * Flushes #corked at the end of the current #EventLoop
+	 * iteration.
+	 */
+	DeferEvent defer_flush;
+
+	/**
+	 * If non-zero, auto-cork mode is enabled and #corked is
+	 * flushed as soon as it contains at least this number of
+	 * bytes.
+	 */
+	size_t cork_threshold = 0;
 
 	/**
 	 * Attempt to do "direct" transfers?
@@ -349,7 +388,10 @@ class BufferedSocket final : DestructAnchor, LeakDetector, SocketHandler {
 public:
 	explicit BufferedSocket(EventLoop &_event_loop) noexcept
 		:base(_event_loop, *this),
-		 defer_read(_event_loop, BIND_THIS_METHOD(DeferReadCallback)) {}
+		 defer_read(_event_loop, BIND_THIS_METHOD(DeferReadCallback)),
+		 input(_event_loop.GetBufferPool()),
+		 corked(_event_loop.GetBufferPool()),
+		 defer_flush(_event_loop, BIND_THIS_METHOD(FlushCorked)) {}
 
 	EventLoop &GetEventLoop() noexcept {
 		return defer_read.GetEventLoop();
@@ -387,6 +429,7 @@ public:
 		assert(!destroyed);
 
 		defer_read.Cancel();
+		DiscardCorked();
 		base.Close();
 	}
 
@@ -400,6 +443,7 @@ public:
 		assert(!destroyed);
 
 		defer_read.Cancel();
+		DiscardCorked();
 		base.Abandon();
 	}
 
@@ -523,6 +567,76 @@ public:
 
 	ssize_t WriteV(const struct iovec *v, size_t n) noexcept;
 
+	/**
+	 * Enable or disable auto-cork mode.  In this mode, small
+	 * Write() and WriteV() calls are copied to a buffer instead
+	 * of being sent immediately, and the buffer is flushed with
+	 * one send() at the end of the current #EventLoop iteration,
+	 * or as soon as #threshold bytes have been collected.  This
+	 * reduces the number of system calls and packets for
+	 * protocols which emit many small chunks per response.
+	 *
+	 * Corked data counts as written; errors which occur while it
+	 * is flushed later are reported to
+	 * BufferedSocketHandler::OnBufferedError().  Other write
+	 * methods flush the corked data first.
+	 *
+	 * @param threshold the flush threshold in bytes; 0 disables
+	 * auto-cork mode (and flushes pending data)
+	 */
+	void SetAutoCork(size_t threshold) noexcept;
+
+	/**
+	 * Start collecting traffic and latency counters, see
+	 * GetStats().
+	 */
+	void EnableStats() noexcept {
+		base.EnableStats();
+	}
+
+	const SocketStats &GetStats() const noexcept {
+		return base.GetStats();
+	}
+
+	/**
+	 * Register the read event edge-triggered, see
+	 * SocketWrapper::EnableEdgeTriggered().  Call this after
+	 * Init() and before the first Read().
+	 */
+	void EnableEdgeTriggered() noexcept {
+		base.EnableEdgeTriggered();
+	}
+
+	/**
+	 * Opt in to zero-copy writes with WriteZeroCopy().
+	 *
+	 * @return false if the kernel does not support MSG_ZEROCOPY
+	 */
+	bool EnableZeroCopy() noexcept {
+		return base.EnableZeroCopy();
+	}
+
+	bool IsZeroCopyEnabled() const noexcept {
+		return base.IsZeroCopyEnabled();
+	}
+
+	/**
+	 * Like Write(), but with MSG_ZEROCOPY: the buffer must stay
+	 * valid until BufferedSocketHandler::OnBufferedZeroCopyCompleted()
+	 * reports the id returned in #id_r.  Requires
+	 * EnableZeroCopy().
+	 *
+	 * If the kernel refuses to pin more pages, the data is
+	 * copied like Write() would; in that case, #id_r is not
+	 * modified, the method returns false in #zerocopy_r and the
+	 * buffer may be reused immediately.
+	 */
+	ssize_t WriteZeroCopy(const void *data, size_t length,
+			      uint32_t &id_r, bool &zerocopy_r) noexcept;
+
+	ssize_t WriteVZeroCopy(const struct iovec *v, size_t n,
+			       uint32_t &id_r, bool &zerocopy_r) noexcept;
+
 	/**
 	 * Transfer data from the given file descriptor to the socket.
 	 *
@@ -532,6 +646,20 @@ public:
 	ssize_t WriteFrom(int other_fd, FdType other_fd_type,
 			  size_t length) noexcept;
 
+	/**
+	 * Transfer data from a regular file to the socket with
+	 * sendfile().  Unlike WriteFrom(), this tracks the file
+	 * offset in the caller's variable (advanced by the number of
+	 * bytes transferred) instead of using the file position, so
+	 * one file descriptor may be shared by many transfers.
+	 *
+	 * @param one_shot see SocketWrapper::SendFile()
+	 * @return the positive number of bytes transferred or a #write_result
+	 * code
+	 */
+	ssize_t SendFile(int file_fd, off_t &offset, size_t length,
+			 bool one_shot=false) noexcept;
+
 	gcc_pure
 	bool IsReadyForWriting() const noexcept {
 		assert(!destroyed);
@@ -578,6 +706,42 @@ public:
 	}
 
 private:
+	/**
+	 * Translate the error of a failed write to a #write_result
+	 * code.
+	 */
+	ssize_t HandleWriteError(ssize_t nbytes) noexcept;
+
+	/**
+	 * Implementation of WriteV() in auto-cork mode.
+	 */
+	ssize_t CorkedWriteV(const struct iovec *v, size_t n) noexcept;
+
+	/**
+	 * Try to send all of #corked.
+	 *
+	 * @return false if an error has been reported to the handler
+	 */
+	bool TryFlushCorked() noexcept;
+
+	/**
+	 * Flush #corked before writing other data, to preserve the
+	 * order.
+	 *
+	 * @return 0 if #corked is empty now, or a #write_result code
+	 */
+	ssize_t FlushCorkedBeforeWrite() noexcept;
+
+	void FlushCorked() noexcept {
+		TryFlushCorked();
+	}
+
+	/**
+	 * Make a last attempt to send #corked (without blocking)
+	 * before the socket goes away, and free the buffer.
+	 */
+	void DiscardCorked() noexcept;
+
 	void ClosedPrematurely() noexcept;
 	void Ended() noexcept;
 
@@ -600,4 +764,6 @@ private:
 	bool OnSocketRead() noexcept override;
 	bool OnSocketWrite() noexcept override;
 	bool OnSocketTimeout() noexcept override;
+	bool OnSocketZeroCopyCompleted(uint32_t first,
+				       uint32_t last) noexcept override;
 };
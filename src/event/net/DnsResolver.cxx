@@ -0,0 +1,969 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "DnsResolver.hxx"
+#include "event/TimerEvent.hxx"
+#include "net/AddressInfo.hxx"
+#include "net/DnsMessage.hxx"
+#include "net/HostParser.hxx"
+#include "net/Parser.hxx"
+#include "net/Resolver.hxx"
+#include "net/SocketProtocolError.hxx"
+#include "system/Error.hxx"
+#include "util/Cancellable.hxx"
+#include "util/CharUtil.hxx"
+#include "util/DeleteDisposer.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/ScopeExit.hxx"
+#include "util/StringUtil.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+class DnsResolver::Request final
+	: public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>>,
+	  public Cancellable {
+
+	Lookup &lookup;
+
+public:
+	DnsResolverHandler &handler;
+
+	const unsigned port;
+
+	const int socktype;
+
+	Request(Lookup &_lookup, DnsResolverHandler &_handler,
+		unsigned _port, int _socktype) noexcept
+		:lookup(_lookup), handler(_handler),
+		 port(_port), socktype(_socktype) {}
+
+	/* virtual methods from Cancellable */
+	void Cancel() override;
+};
+
+/**
+ * Repeat a query over TCP after the UDP response was truncated.
+ */
+class DnsResolver::TcpQuery {
+	Question &question;
+
+	UniqueSocketDescriptor fd;
+
+	SocketEvent event;
+
+	/**
+	 * The query with its length prefix; it is freed after it
+	 * has been sent.
+	 */
+	std::vector<uint8_t> request;
+
+	uint8_t response_length[2];
+
+	std::vector<uint8_t> response;
+
+	/**
+	 * The number of bytes received, including the length
+	 * prefix.
+	 */
+	size_t fill = 0;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	TcpQuery(EventLoop &event_loop, Question &_question,
+		 SocketAddress server, ConstBuffer<void> query);
+
+	~TcpQuery() noexcept {
+		event.Delete();
+	}
+
+private:
+	void OnSocketReady(unsigned events) noexcept;
+};
+
+/**
+ * One query (A or AAAA) of a #Lookup.
+ */
+class DnsResolver::Question {
+public:
+	Lookup &lookup;
+
+	const uint16_t type;
+
+	/**
+	 * The transaction id; only valid if #registered is set.
+	 */
+	uint16_t id;
+
+	/**
+	 * Is this question registered in DnsResolver::questions?
+	 */
+	bool registered = false;
+
+	/**
+	 * Has a response been received (or has this question
+	 * failed)?
+	 */
+	bool done = false;
+
+	size_t query_size;
+	uint8_t query[DNS_MAX_UDP_SIZE];
+
+	std::unique_ptr<TcpQuery> tcp;
+
+	Question(Lookup &_lookup, uint16_t _type) noexcept
+		:lookup(_lookup), type(_type) {}
+
+	/**
+	 * A response has been received.  This method may destroy
+	 * the #Lookup.
+	 */
+	void OnResponse(ConstBuffer<void> packet, bool via_tcp) noexcept;
+
+	void OnTcpError(std::exception_ptr ep) noexcept;
+
+	/**
+	 * Mark this question as failed without checking whether the
+	 * #Lookup is complete.
+	 */
+	void Fail(std::exception_ptr ep) noexcept;
+
+	void Done() noexcept;
+};
+
+/**
+ * Resolving one host name on behalf of one or more #Request
+ * instances.
+ */
+class DnsResolver::Lookup {
+public:
+	DnsResolver &resolver;
+
+	const std::string name;
+
+	Question aaaa, a;
+
+	typedef boost::intrusive::list<Request,
+				       boost::intrusive::constant_time_size<false>> RequestList;
+
+	RequestList requests;
+
+	/**
+	 * Retransmits the queries after
+	 * DnsResolver::retry_timeout.
+	 */
+	TimerEvent timer;
+
+	unsigned tries = 1;
+
+	std::vector<DnsAnswer> answers;
+
+	/**
+	 * The lowest TTL of all positive responses and of all
+	 * negative responses.
+	 */
+	uint32_t ttl = UINT32_MAX, negative_ttl = UINT32_MAX;
+
+	/**
+	 * The first error; it is reported if no addresses were
+	 * found.
+	 */
+	std::exception_ptr error;
+
+	/**
+	 * Set by Finish(); from then on, this object is owned by
+	 * DnsResolver::FinishLookup().
+	 */
+	bool finished = false;
+
+	Lookup(DnsResolver &_resolver, std::string &&_name) noexcept
+		:resolver(_resolver), name(std::move(_name)),
+		 aaaa(*this, DNS_TYPE_AAAA), a(*this, DNS_TYPE_A),
+		 timer(resolver.event_loop, BIND_THIS_METHOD(OnTimer)) {}
+
+	~Lookup() noexcept {
+		assert(requests.empty());
+
+		resolver.Unregister(aaaa);
+		resolver.Unregister(a);
+	}
+
+	bool IsDone() const noexcept {
+		return aaaa.done && a.done;
+	}
+
+	void SetError(std::exception_ptr ep) noexcept {
+		if (!error)
+			error = std::move(ep);
+	}
+
+	/**
+	 * Send the queries.  This method may destroy this object.
+	 */
+	void Start() noexcept;
+
+	/**
+	 * Call DnsResolver::FinishLookup() if both questions are
+	 * done.  This method may destroy this object.
+	 */
+	void CheckDone() noexcept {
+		if (IsDone())
+			resolver.FinishLookup(*this);
+	}
+
+	void Cancel(Request &request) noexcept;
+
+	/**
+	 * Invoke the handlers of all requests (and delete the
+	 * requests).
+	 */
+	void Finish() noexcept;
+
+	/**
+	 * Forget all requests without invoking their handlers.
+	 */
+	void Clear() noexcept {
+		requests.clear_and_dispose(DeleteDisposer());
+	}
+
+private:
+	void Send(Question &question) noexcept;
+
+	void OnTimer() noexcept;
+};
+
+/**
+ * Allocate an #addrinfo with the socket address in the same memory
+ * block, just like glibc's getaddrinfo() does, so freeaddrinfo()
+ * can free it.
+ */
+static struct addrinfo *
+NewAddressInfo(const DnsAnswer &answer, unsigned port, int socktype)
+{
+	union Address {
+		struct sockaddr_in in;
+		struct sockaddr_in6 in6;
+	};
+
+	auto *ai = (struct addrinfo *)
+		calloc(1, sizeof(struct addrinfo) + sizeof(Address));
+	if (ai == nullptr)
+		throw std::bad_alloc();
+
+	auto &address = *(Address *)(ai + 1);
+
+	ai->ai_family = answer.family;
+	ai->ai_socktype = socktype;
+	ai->ai_protocol = socktype == SOCK_STREAM
+		? IPPROTO_TCP
+		: (socktype == SOCK_DGRAM ? IPPROTO_UDP : 0);
+	ai->ai_addr = (struct sockaddr *)&address;
+
+	if (answer.family == AF_INET6) {
+		address.in6.sin6_family = AF_INET6;
+		address.in6.sin6_port = htons(port);
+		memcpy(&address.in6.sin6_addr, answer.address, 16);
+		ai->ai_addrlen = sizeof(address.in6);
+	} else {
+		address.in.sin_family = AF_INET;
+		address.in.sin_port = htons(port);
+		memcpy(&address.in.sin_addr, answer.address, 4);
+		ai->ai_addrlen = sizeof(address.in);
+	}
+
+	return ai;
+}
+
+static AddressInfoList
+MakeAddressInfoList(const std::vector<DnsAnswer> &answers,
+		    unsigned port, int socktype)
+{
+	struct addrinfo *head = nullptr, **tail_r = &head;
+	AtScopeExit(&head) { freeaddrinfo(head); };
+
+	for (const auto &i : answers) {
+		*tail_r = NewAddressInfo(i, port, socktype);
+		tail_r = &(*tail_r)->ai_next;
+	}
+
+	return AddressInfoList(std::exchange(head, nullptr));
+}
+
+void
+DnsResolver::Request::Cancel()
+{
+	lookup.Cancel(*this);
+}
+
+DnsResolver::TcpQuery::TcpQuery(EventLoop &event_loop, Question &_question,
+				SocketAddress server,
+				ConstBuffer<void> query)
+	:question(_question),
+	 event(event_loop, BIND_THIS_METHOD(OnSocketReady))
+{
+	request.reserve(2 + query.size);
+	request.push_back(query.size >> 8);
+	request.push_back(query.size);
+	request.insert(request.end(), (const uint8_t *)query.data,
+		       (const uint8_t *)query.data + query.size);
+
+	if (!fd.CreateNonBlock(server.GetFamily(), SOCK_STREAM, 0))
+		throw MakeErrno("Failed to create socket");
+
+	if (!fd.Connect(server) && errno != EINPROGRESS)
+		throw MakeErrno("Failed to connect to DNS server");
+
+	event.Set(fd.Get(), SocketEvent::WRITE);
+	event.Add();
+}
+
+void
+DnsResolver::TcpQuery::OnSocketReady(unsigned) noexcept
+try {
+	if (!request.empty()) {
+		int error = fd.GetError();
+		if (error != 0)
+			throw MakeErrno(error, "Failed to connect to DNS server");
+
+		/* the query is small enough to fit into the socket
+		   buffer of a freshly connected socket */
+		ssize_t nbytes = fd.Write(request.data(), request.size());
+		if (nbytes < 0)
+			throw MakeErrno("Failed to send DNS query");
+
+		if (size_t(nbytes) < request.size())
+			throw SocketProtocolError("Short write to DNS server");
+
+		request.clear();
+		request.shrink_to_fit();
+
+		event.Set(fd.Get(), SocketEvent::READ|SocketEvent::PERSIST);
+		event.Add();
+		return;
+	}
+
+	uint8_t *dest;
+	size_t max_length;
+	if (fill < sizeof(response_length)) {
+		dest = response_length + fill;
+		max_length = sizeof(response_length) - fill;
+	} else {
+		const size_t position = fill - sizeof(response_length);
+		dest = response.data() + position;
+		max_length = response.size() - position;
+	}
+
+	ssize_t nbytes = fd.Read(dest, max_length);
+	if (nbytes < 0) {
+		if (errno == EAGAIN)
+			return;
+
+		throw MakeErrno("Failed to receive from DNS server");
+	}
+
+	if (nbytes == 0)
+		throw SocketClosedPrematurelyError();
+
+	fill += nbytes;
+
+	if (fill == sizeof(response_length)) {
+		const size_t length = (response_length[0] << 8) |
+			response_length[1];
+		if (length == 0)
+			throw SocketProtocolError("Empty DNS response");
+
+		response.resize(length);
+		return;
+	}
+
+	if (fill == sizeof(response_length) + response.size()) {
+		event.Delete();
+
+		/* this call destroys this object */
+		question.OnResponse({response.data(), response.size()},
+				    true);
+	}
+} catch (...) {
+	question.OnTcpError(std::current_exception());
+}
+
+void
+DnsResolver::Question::OnResponse(ConstBuffer<void> packet,
+				  bool via_tcp) noexcept
+{
+	try {
+		auto response = ParseDnsResponse(packet, lookup.name.c_str(),
+						 type);
+		if (response.truncated) {
+			if (via_tcp)
+				throw SocketProtocolError("Truncated DNS response over TCP");
+
+			/* ignore further UDP responses */
+			lookup.resolver.Unregister(*this);
+
+			tcp.reset(new TcpQuery(lookup.resolver.event_loop,
+					       *this, lookup.resolver.server,
+					       {query, query_size}));
+			return;
+		}
+
+		if (response.rcode != DNS_RCODE_NOERROR &&
+		    response.rcode != DNS_RCODE_NXDOMAIN)
+			throw FormatRuntimeError("Failed to resolve '%s': DNS error %u",
+						 lookup.name.c_str(),
+						 response.rcode);
+
+		if (response.answers.empty()) {
+			lookup.negative_ttl = std::min(lookup.negative_ttl,
+						       response.ttl);
+		} else {
+			lookup.answers.insert(lookup.answers.end(),
+					      response.answers.begin(),
+					      response.answers.end());
+			lookup.ttl = std::min(lookup.ttl, response.ttl);
+		}
+	} catch (const SocketProtocolError &) {
+		if (!via_tcp)
+			/* a bogus UDP datagram is more likely to be
+			   spoofed than to come from the real server;
+			   keep waiting for the real response */
+			return;
+
+		lookup.SetError(std::current_exception());
+	} catch (...) {
+		lookup.SetError(std::current_exception());
+	}
+
+	Done();
+	lookup.CheckDone();
+}
+
+void
+DnsResolver::Question::OnTcpError(std::exception_ptr ep) noexcept
+{
+	Fail(std::move(ep));
+	lookup.CheckDone();
+}
+
+void
+DnsResolver::Question::Fail(std::exception_ptr ep) noexcept
+{
+	lookup.SetError(std::move(ep));
+	Done();
+}
+
+void
+DnsResolver::Question::Done() noexcept
+{
+	assert(!done);
+
+	done = true;
+	lookup.resolver.Unregister(*this);
+	tcp.reset();
+}
+
+void
+DnsResolver::Lookup::Send(Question &question) noexcept
+{
+	try {
+		resolver.Send(question);
+	} catch (...) {
+		question.Fail(std::current_exception());
+	}
+}
+
+void
+DnsResolver::Lookup::Start() noexcept
+{
+	Send(aaaa);
+	Send(a);
+
+	if (IsDone()) {
+		resolver.FinishLookup(*this);
+		return;
+	}
+
+	timer.Add(resolver.retry_timeout);
+}
+
+void
+DnsResolver::Lookup::OnTimer() noexcept
+{
+	if (tries >= resolver.max_tries) {
+		if (!aaaa.done)
+			aaaa.Done();
+		if (!a.done)
+			a.Done();
+
+		SetError(std::make_exception_ptr(SocketTimeoutError()));
+		resolver.FinishLookup(*this);
+		return;
+	}
+
+	++tries;
+
+	/* questions which are being repeated over TCP are not
+	   retransmitted; they are only subject to the overall
+	   timeout */
+	if (!aaaa.done && !aaaa.tcp)
+		Send(aaaa);
+	if (!a.done && !a.tcp)
+		Send(a);
+
+	if (IsDone()) {
+		resolver.FinishLookup(*this);
+		return;
+	}
+
+	timer.Add(resolver.retry_timeout);
+}
+
+void
+DnsResolver::Lookup::Cancel(Request &request) noexcept
+{
+	requests.erase_and_dispose(requests.iterator_to(request),
+				   DeleteDisposer());
+
+	if (requests.empty() && !finished)
+		/* nobody is interested in the result anymore */
+		resolver.RemoveLookup(*this);
+}
+
+void
+DnsResolver::Lookup::Finish() noexcept
+{
+	assert(!finished);
+
+	finished = true;
+	timer.Cancel();
+
+	/* prefer IPv6, just like getaddrinfo() usually does */
+	std::stable_partition(answers.begin(), answers.end(),
+			      [](const DnsAnswer &i){
+				      return i.family == AF_INET6;
+			      });
+
+	if (!error)
+		/* only complete results are cached; errors such as
+		   timeouts are not */
+		resolver.StoreCache(name, answers,
+				    answers.empty() ? negative_ttl : ttl);
+
+	if (answers.empty() && !error)
+		error = std::make_exception_ptr(FormatRuntimeError("Failed to resolve '%s': host not found",
+								   name.c_str()));
+
+	while (!requests.empty()) {
+		auto &request = requests.front();
+		requests.pop_front();
+
+		auto &handler = request.handler;
+		const unsigned port = request.port;
+		const int socktype = request.socktype;
+		delete &request;
+
+		if (answers.empty()) {
+			handler.OnDnsError(error);
+			continue;
+		}
+
+		AddressInfoList list;
+		try {
+			list = MakeAddressInfoList(answers, port, socktype);
+		} catch (...) {
+			handler.OnDnsError(std::current_exception());
+			continue;
+		}
+
+		handler.OnDnsResolved(std::move(list));
+	}
+}
+
+DnsResolver::DnsResolver(EventLoop &_event_loop, SocketAddress _server)
+	:event_loop(_event_loop), server(_server),
+	 udp_event(event_loop, BIND_THIS_METHOD(OnUdpReady)),
+	 random(std::random_device()())
+{
+}
+
+DnsResolver::~DnsResolver() noexcept
+{
+	for (auto &i : lookups)
+		i.second->Clear();
+
+	lookups.clear();
+
+	udp_event.Delete();
+}
+
+AllocatedSocketAddress
+DnsResolver::GetSystemServer()
+{
+	FILE *file = fopen("/etc/resolv.conf", "r");
+	if (file != nullptr) {
+		AtScopeExit(file) { fclose(file); };
+
+		char line[256];
+		while (fgets(line, sizeof(line), file) != nullptr) {
+			char *p = StripLeft(line);
+			if (strncmp(p, "nameserver", 10) != 0 ||
+			    !IsWhitespaceNotNull(p[10]))
+				continue;
+
+			p = StripLeft(p + 10);
+			StripRight(p);
+
+			try {
+				return ParseSocketAddress(p, 53, false);
+			} catch (...) {
+				/* malformed line; try the next one */
+			}
+		}
+	}
+
+	return ParseSocketAddress("127.0.0.1", 53, false);
+}
+
+static std::string
+NormalizeHostName(StringView host) noexcept
+{
+	std::string result;
+	result.reserve(host.size);
+	for (char ch : host)
+		result.push_back(ToLowerASCII(ch));
+
+	if (!result.empty() && result.back() == '.')
+		result.pop_back();
+
+	return result;
+}
+
+gcc_pure
+static bool
+IsNumericHost(const char *host) noexcept
+{
+	if (strchr(host, ':') != nullptr)
+		/* host names cannot contain colons; this must be an
+		   IPv6 address */
+		return true;
+
+	struct in_addr dummy;
+	return inet_pton(AF_INET, host, &dummy) == 1;
+}
+
+void
+DnsResolver::Resolve(const char *host_and_port, int default_port,
+		     int socktype,
+		     DnsResolverHandler &handler,
+		     CancellablePointer &cancel_ptr) noexcept
+{
+	unsigned port;
+	std::string name;
+
+	try {
+		const auto eh = ExtractHost(host_and_port);
+		if (eh.HasFailed())
+			throw FormatRuntimeError("Malformed host name: %s",
+						 host_and_port);
+
+		name = NormalizeHostName(eh.host);
+
+		if (IsNumericHost(name.c_str())) {
+			/* no DNS query needed; getaddrinfo() does not
+			   block with AI_NUMERICHOST */
+			struct addrinfo hints{};
+			hints.ai_flags = AI_NUMERICHOST;
+			hints.ai_socktype = socktype;
+
+			auto list = ::Resolve(host_and_port, default_port,
+					      &hints);
+			handler.OnDnsResolved(std::move(list));
+			return;
+		}
+
+		const char *p = eh.end;
+		if (*p == ':') {
+			char *endptr;
+			const unsigned long value = strtoul(p + 1, &endptr, 10);
+			if (endptr == p + 1 || *endptr != 0 || value > 0xffff)
+				throw FormatRuntimeError("Malformed port: %s",
+							 p + 1);
+
+			port = value;
+		} else if (*p == 0)
+			port = default_port;
+		else
+			throw std::runtime_error("Garbage after host name");
+	} catch (...) {
+		handler.OnDnsError(std::current_exception());
+		return;
+	}
+
+	auto c = cache.find(name);
+	if (c != cache.end()) {
+		const auto now = event_loop.SteadyNow();
+		if (now < c->second.expires) {
+			const bool refresh = now >= c->second.refresh &&
+				lookups.find(name) == lookups.end();
+
+			AddressInfoList list;
+			std::exception_ptr error;
+			if (c->second.answers.empty())
+				error = std::make_exception_ptr(FormatRuntimeError("Failed to resolve '%s': host not found",
+										   name.c_str()));
+			else {
+				try {
+					list = MakeAddressInfoList(c->second.answers,
+								   port, socktype);
+				} catch (...) {
+					error = std::current_exception();
+				}
+			}
+
+			if (refresh)
+				/* this item is still in use and will
+				   expire soon: refresh it in the
+				   background (with no request
+				   attached) */
+				StartLookup(std::move(name)).Start();
+
+			if (error)
+				handler.OnDnsError(std::move(error));
+			else
+				handler.OnDnsResolved(std::move(list));
+			return;
+		}
+
+		cache.erase(c);
+	}
+
+	auto i = lookups.find(name);
+	Lookup *lookup;
+	const bool is_new = i == lookups.end();
+	if (is_new)
+		lookup = &StartLookup(std::move(name));
+	else
+		lookup = i->second.get();
+
+	auto *request = new Request(*lookup, handler, port, socktype);
+	lookup->requests.push_back(*request);
+	cancel_ptr = *request;
+
+	if (is_new)
+		lookup->Start();
+}
+
+DnsResolver::Lookup &
+DnsResolver::StartLookup(std::string &&name) noexcept
+{
+	std::unique_ptr<Lookup> lookup(new Lookup(*this, std::string(name)));
+	auto &result = *lookup;
+	lookups.emplace(std::move(name), std::move(lookup));
+	return result;
+}
+
+void
+DnsResolver::RemoveLookup(Lookup &lookup) noexcept
+{
+	auto i = lookups.find(lookup.name);
+	assert(i != lookups.end());
+	assert(i->second.get() == &lookup);
+
+	lookups.erase(i);
+}
+
+void
+DnsResolver::FinishLookup(Lookup &lookup) noexcept
+{
+	auto i = lookups.find(lookup.name);
+	assert(i != lookups.end());
+	assert(i->second.get() == &lookup);
+
+	/* unregister the lookup before invoking the handlers, so
+	   they may start new lookups for the same name */
+	auto l = std::move(i->second);
+	lookups.erase(i);
+
+	l->Finish();
+}
+
+void
+DnsResolver::StoreCache(const std::string &name,
+			const std::vector<DnsAnswer> &answers,
+			uint32_t ttl) noexcept
+{
+	if (max_cache_items == 0)
+		return;
+
+	const auto d = std::min<std::chrono::steady_clock::duration>(std::chrono::seconds(ttl),
+								     answers.empty()
+								     ? max_negative_ttl
+								     : max_ttl);
+	if (d <= d.zero()) {
+		cache.erase(name);
+		return;
+	}
+
+	auto i = cache.find(name);
+	if (i == cache.end()) {
+		if (cache.size() >= max_cache_items)
+			EvictCacheItem();
+
+		i = cache.emplace(name, CacheItem()).first;
+	}
+
+	const auto now = event_loop.SteadyNow();
+	auto &item = i->second;
+	item.answers = answers;
+	item.expires = now + d;
+
+	/* refresh during the last 10% of the TTL */
+	item.refresh = now + d - d / 10;
+}
+
+void
+DnsResolver::EvictCacheItem() noexcept
+{
+	assert(!cache.empty());
+
+	const auto now = event_loop.SteadyNow();
+
+	auto victim = cache.begin();
+	for (auto i = cache.begin(); i != cache.end(); ++i) {
+		if (i->second.expires <= now) {
+			victim = i;
+			break;
+		}
+
+		if (i->second.expires < victim->second.expires)
+			victim = i;
+	}
+
+	cache.erase(victim);
+}
+
+void
+DnsResolver::Send(Question &question)
+{
+	if (!udp.IsDefined())
+		OpenUdp();
+
+	if (!question.registered) {
+		uint16_t id;
+		do {
+			id = random();
+		} while (questions.find(id) != questions.end());
+
+		question.query_size = BuildDnsQuery(question.query,
+						    sizeof(question.query),
+						    id,
+						    question.lookup.name.c_str(),
+						    question.type);
+		if (question.query_size == 0)
+			throw FormatRuntimeError("Malformed host name: %s",
+						 question.lookup.name.c_str());
+
+		question.id = id;
+		question.registered = true;
+		questions.emplace(id, &question);
+	}
+
+	if (udp.Write(question.query, question.query_size) < 0)
+		throw MakeErrno("Failed to send DNS query");
+}
+
+void
+DnsResolver::Unregister(Question &question) noexcept
+{
+	if (!question.registered)
+		return;
+
+	questions.erase(question.id);
+	question.registered = false;
+}
+
+void
+DnsResolver::OpenUdp()
+{
+	UniqueSocketDescriptor fd;
+	if (!fd.CreateNonBlock(server.GetFamily(), SOCK_DGRAM, 0))
+		throw MakeErrno("Failed to create socket");
+
+	/* connecting the socket makes the kernel discard datagrams
+	   from other senders */
+	if (!fd.Connect(server))
+		throw MakeErrno("Failed to connect to DNS server");
+
+	udp = std::move(fd);
+	udp_event.Set(udp.Get(), SocketEvent::READ|SocketEvent::PERSIST);
+	udp_event.Add();
+}
+
+void
+DnsResolver::OnUdpReady(unsigned) noexcept
+{
+	uint8_t buffer[4096];
+
+	while (true) {
+		ssize_t nbytes = udp.Read(buffer, sizeof(buffer));
+		if (nbytes < 0)
+			/* EAGAIN, or an asynchronous error such as
+			   ECONNREFUSED; in the latter case, the
+			   retransmit timer will catch it */
+			break;
+
+		const ConstBuffer<void> packet(buffer, nbytes);
+		const int id = GetDnsId(packet);
+		if (id < 0)
+			continue;
+
+		auto i = questions.find(id);
+		if (i == questions.end())
+			/* late or unsolicited response */
+			continue;
+
+		i->second->OnResponse(packet, false);
+	}
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "event/SocketEvent.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "net/DnsMessage.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+
+#include <chrono>
+#include <exception>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/time.h>
+
+class AddressInfoList;
+class CancellablePointer;
+
+class DnsResolverHandler {
+public:
+	virtual void OnDnsResolved(AddressInfoList &&list) noexcept = 0;
+	virtual void OnDnsError(std::exception_ptr ep) noexcept = 0;
+};
+
+/**
+ * A non-blocking stub resolver which sends DNS queries (A and AAAA)
+ * to a recursive name server from the #EventLoop.  Responses with
+ * the "TC" flag are repeated over TCP.  Concurrent requests for the
+ * same host name share one lookup.
+ *
+ * Results are cached according to the TTLs of the DNS records,
+ * including negative results (RFC 2308).  The cache is keyed on the
+ * host name only, because port and socket type do not affect the
+ * query.  When a cached entry is used shortly before it expires, it
+ * is refreshed in the background, so frequently used names never
+ * need to wait for the name server.
+ *
+ * Unlike getaddrinfo(), this does not consult /etc/hosts or the
+ * "search" domains from /etc/resolv.conf; names are always queried
+ * as absolute names.
+ */
+class DnsResolver {
+	class Request;
+	class Question;
+	class TcpQuery;
+	class Lookup;
+
+	EventLoop &event_loop;
+
+	const AllocatedSocketAddress server;
+
+	/**
+	 * The UDP socket connected to #server; it is created on
+	 * demand.
+	 */
+	UniqueSocketDescriptor udp;
+
+	SocketEvent udp_event;
+
+	std::mt19937 random;
+
+	struct timeval retry_timeout{1, 0};
+
+	unsigned max_tries = 3;
+
+	/**
+	 * All pending lookups, indexed by the (lower case) host
+	 * name.
+	 */
+	std::map<std::string, std::unique_ptr<Lookup>> lookups;
+
+	/**
+	 * All questions waiting for a response, indexed by
+	 * transaction id.
+	 */
+	std::map<uint16_t, Question *> questions;
+
+	struct CacheItem {
+		/**
+		 * The addresses; empty for negative entries.
+		 */
+		std::vector<DnsAnswer> answers;
+
+		std::chrono::steady_clock::time_point expires;
+
+		/**
+		 * When using this item after this time point, a
+		 * refresh is started in the background.
+		 */
+		std::chrono::steady_clock::time_point refresh;
+	};
+
+	std::map<std::string, CacheItem> cache;
+
+	size_t max_cache_items = 1024;
+
+	std::chrono::steady_clock::duration max_ttl = std::chrono::hours(1);
+
+	std::chrono::steady_clock::duration max_negative_ttl = std::chrono::minutes(1);
+
+public:
+	DnsResolver(EventLoop &_event_loop, SocketAddress _server);
+	~DnsResolver() noexcept;
+
+	DnsResolver(const DnsResolver &) = delete;
+	DnsResolver &operator=(const DnsResolver &) = delete;
+
+	/**
+	 * Determine the first name server listed in
+	 * /etc/resolv.conf.  Falls back to 127.0.0.1 if there is
+	 * none.
+	 */
+	static AllocatedSocketAddress GetSystemServer();
+
+	EventLoop &GetEventLoop() noexcept {
+		return event_loop;
+	}
+
+	/**
+	 * Configure how long to wait for a response before the
+	 * query is sent again, and how often to send it.
+	 */
+	void SetRetry(const struct timeval &timeout, unsigned tries) noexcept {
+		retry_timeout = timeout;
+		max_tries = tries;
+	}
+
+	/**
+	 * Configure the result cache.
+	 *
+	 * @param max_items the maximum number of host names in the
+	 * cache; 0 disables the cache
+	 * @param _max_ttl an upper limit for the TTL of positive
+	 * entries
+	 * @param _max_negative_ttl an upper limit for the TTL of
+	 * negative entries ("host not found")
+	 */
+	void SetCache(size_t max_items,
+		      std::chrono::steady_clock::duration _max_ttl,
+		      std::chrono::steady_clock::duration _max_negative_ttl) noexcept {
+		max_cache_items = max_items;
+		max_ttl = _max_ttl;
+		max_negative_ttl = _max_negative_ttl;
+
+		while (cache.size() > max_cache_items)
+			EvictCacheItem();
+	}
+
+	void FlushCache() noexcept {
+		cache.clear();
+	}
+
+	/**
+	 * Start resolving a host name.  Numeric addresses are
+	 * handled without a query.  The handler is invoked exactly
+	 * once unless the operation gets canceled (possibly from
+	 * inside this method, e.g. on a cache hit).
+	 *
+	 * @param host_and_port the host name with an optional port,
+	 * in the syntax understood by Resolve()
+	 * @param socktype the value for addrinfo.ai_socktype in the
+	 * result
+	 */
+	void Resolve(const char *host_and_port, int default_port,
+		     int socktype,
+		     DnsResolverHandler &handler,
+		     CancellablePointer &cancel_ptr) noexcept;
+
+private:
+	Lookup &StartLookup(std::string &&name) noexcept;
+	void RemoveLookup(Lookup &lookup) noexcept;
+	void FinishLookup(Lookup &lookup) noexcept;
+
+	/**
+	 * Send a query for the given question via UDP and register
+	 * it in #questions.  Throws on error.
+	 */
+	void Send(Question &question);
+
+	void Unregister(Question &question) noexcept;
+
+	void StoreCache(const std::string &name,
+			const std::vector<DnsAnswer> &answers,
+			uint32_t ttl) noexcept;
+
+	/**
+	 * Remove one item from the cache, preferably an expired
+	 * one.
+	 */
+	void EvictCacheItem() noexcept;
+
+	void OpenUdp();
+	void OnUdpReady(unsigned events) noexcept;
+};
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "InterfaceMonitor.hxx"
+#include "system/Error.hxx"
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+
+NetworkInterfaceMonitor::NetworkInterfaceMonitor(EventLoop &event_loop)
+	:event(event_loop, BIND_THIS_METHOD(OnSocketReady))
+{
+	if (!fd.CreateNonBlock(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE))
+		throw MakeErrno("Failed to create netlink socket");
+
+	struct sockaddr_nl sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.nl_family = AF_NETLINK;
+	sa.nl_groups = RTMGRP_LINK|RTMGRP_IPV4_IFADDR|RTMGRP_IPV6_IFADDR;
+
+	if (bind(fd.Get(), (const struct sockaddr *)&sa, sizeof(sa)) < 0)
+		throw MakeErrno("Failed to bind netlink socket");
+
+	/* subscribe before loading; notifications which arrive
+	   during the dump are queued on the socket and applied
+	   afterwards, which converges to the same state */
+	table.Load();
+
+	event.Set(fd.Get(), SocketEvent::READ|SocketEvent::PERSIST);
+	event.Add();
+}
+
+void
+NetworkInterfaceMonitor::OnSocketReady(unsigned) noexcept
+{
+	while (true) {
+		alignas(struct nlmsghdr) char buffer[16384];
+		ssize_t nbytes = recv(fd.Get(), buffer, sizeof(buffer), 0);
+		if (nbytes < 0) {
+			if (errno == ENOBUFS) {
+				/* the socket buffer has overflowed and
+				   notifications were lost: start over
+				   with a full dump */
+				try {
+					table.Load();
+				} catch (...) {
+					/* keep the old table and try
+					   again on the next overflow */
+				}
+
+				continue;
+			}
+
+			/* EAGAIN: all notifications have been
+			   applied */
+			break;
+		}
+
+		if (nbytes == 0)
+			break;
+
+		table.Feed(buffer, nbytes);
+	}
+}
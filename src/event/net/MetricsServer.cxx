@@ -0,0 +1,173 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "MetricsServer.hxx"
+#include "util/Metrics.hxx"
+
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+
+static constexpr auto TIMEOUT = std::chrono::seconds(10);
+
+MetricsConnection::MetricsConnection(EventLoop &event_loop,
+				     const MetricsRegistry &_registry,
+				     UniqueSocketDescriptor &&_fd,
+				     SocketAddress) noexcept
+	:registry(_registry), fd(std::move(_fd)),
+	 event(event_loop, fd.Get(), SocketEvent::READ|SocketEvent::PERSIST,
+	       BIND_THIS_METHOD(OnSocketReady)),
+	 timeout_event(event_loop, BIND_THIS_METHOD(OnTimeout))
+{
+	event.Add();
+	timeout_event.Schedule(TIMEOUT);
+}
+
+MetricsConnection::~MetricsConnection() noexcept
+{
+	event.Delete();
+}
+
+gcc_pure
+static bool
+IsMetricsPath(const char *request) noexcept
+{
+	const char *path;
+	if (memcmp(request, "GET ", 4) == 0)
+		path = request + 4;
+	else if (memcmp(request, "HEAD ", 5) == 0)
+		path = request + 5;
+	else
+		return false;
+
+	const size_t length = strcspn(path, " ?\r\n");
+	return (length == 1 && *path == '/') ||
+		(length == 8 && memcmp(path, "/metrics", 8) == 0);
+}
+
+inline void
+MetricsConnection::MakeResponse() noexcept
+{
+	const bool head = memcmp(request, "HEAD ", 5) == 0;
+
+	try {
+		if (!IsMetricsPath(request)) {
+			response = "HTTP/1.0 404 Not Found\r\n"
+				"Content-Type: text/plain\r\n"
+				"Connection: close\r\n"
+				"\r\n"
+				"Not Found\n";
+			return;
+		}
+
+		const std::string body = registry.Format();
+
+		char header[256];
+		snprintf(header, sizeof(header),
+			 "HTTP/1.0 200 OK\r\n"
+			 "Content-Type: text/plain; version=0.0.4\r\n"
+			 "Content-Length: %zu\r\n"
+			 "Connection: close\r\n"
+			 "\r\n", body.size());
+
+		response = header;
+		if (!head)
+			response += body;
+	} catch (...) {
+		response = "HTTP/1.0 500 Internal Server Error\r\n"
+			"Connection: close\r\n"
+			"\r\n";
+	}
+}
+
+inline bool
+MetricsConnection::OnReadable() noexcept
+{
+	const size_t max_length = sizeof(request) - 1;
+	ssize_t nbytes = fd.Read(request + request_length,
+				 max_length - request_length);
+	if (nbytes <= 0)
+		return nbytes < 0 && errno == EAGAIN;
+
+	request_length += nbytes;
+	request[request_length] = 0;
+
+	if (strstr(request, "\r\n\r\n") == nullptr &&
+	    strstr(request, "\n\n") == nullptr) {
+		/* incomplete request; a request which does not fit
+		   into the buffer is rejected */
+		if (request_length < max_length)
+			return true;
+
+		request[0] = 0;
+	}
+
+	MakeResponse();
+
+	event.Delete();
+	event.Set(fd.Get(), SocketEvent::WRITE|SocketEvent::PERSIST);
+	event.Add();
+	return OnWritable();
+}
+
+inline bool
+MetricsConnection::OnWritable() noexcept
+{
+	ssize_t nbytes = fd.Write(response.data() + response_position,
+				  response.size() - response_position);
+	if (nbytes < 0)
+		return errno == EAGAIN;
+
+	response_position += nbytes;
+	if (response_position < response.size())
+		return true;
+
+	fd.ShutdownWrite();
+	return false;
+}
+
+void
+MetricsConnection::OnSocketReady(unsigned events) noexcept
+{
+	const bool keep = (events & SocketEvent::WRITE) != 0
+		? OnWritable()
+		: OnReadable();
+
+	if (!keep)
+		delete this;
+}
+
+void
+MetricsConnection::OnTimeout() noexcept
+{
+	delete this;
+}
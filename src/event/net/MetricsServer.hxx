@@ -0,0 +1,108 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "TemplateServerSocket.hxx"
+#include "event/SocketEvent.hxx"
+#include "event/CoarseTimerEvent.hxx"
+
+#include <boost/intrusive/list_hook.hpp>
+
+#include <string>
+
+class MetricsRegistry;
+
+/**
+ * One connection of a #MetricsServer: reads a HTTP request, responds
+ * with the metrics and closes the connection.
+ */
+class MetricsConnection final
+	: public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::auto_unlink>> {
+
+	const MetricsRegistry &registry;
+
+	UniqueSocketDescriptor fd;
+
+	SocketEvent event;
+
+	CoarseTimerEvent timeout_event;
+
+	char request[2048];
+	size_t request_length = 0;
+
+	std::string response;
+	size_t response_position = 0;
+
+public:
+	MetricsConnection(EventLoop &event_loop,
+			  const MetricsRegistry &_registry,
+			  UniqueSocketDescriptor &&_fd,
+			  SocketAddress address) noexcept;
+
+	~MetricsConnection() noexcept;
+
+	MetricsConnection(const MetricsConnection &) = delete;
+	MetricsConnection &operator=(const MetricsConnection &) = delete;
+
+private:
+	/**
+	 * @return false if the connection shall be closed
+	 */
+	bool OnReadable() noexcept;
+
+	/**
+	 * @return false if the connection shall be closed
+	 */
+	bool OnWritable() noexcept;
+
+	void MakeResponse() noexcept;
+
+	void OnSocketReady(unsigned events) noexcept;
+	void OnTimeout() noexcept;
+};
+
+/**
+ * A minimal HTTP server which exposes a #MetricsRegistry in the
+ * Prometheus text format on "/metrics" (and "/").  It runs in an
+ * #EventLoop; the metrics are formatted in that thread.
+ *
+ * Call one of the Listen() methods to start it.
+ */
+class MetricsServer final
+	: public TemplateServerSocket<MetricsConnection, EventLoop &,
+				      const MetricsRegistry &> {
+public:
+	MetricsServer(EventLoop &event_loop,
+		      const MetricsRegistry &registry) noexcept
+		:TemplateServerSocket(event_loop, event_loop, registry) {}
+};
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ParallelConnectSocket.hxx"
+#include "net/AddressInfo.hxx"
+#include "system/Error.hxx"
+#include "util/DeleteDisposer.hxx"
+
+#include <stdexcept>
+
+#include <assert.h>
+#include <errno.h>
+
+ParallelConnectSocket::ParallelConnectSocket(EventLoop &_event_loop,
+					     ConnectSocketHandler &_handler) noexcept
+	:event_loop(_event_loop), handler(_handler),
+	 next_candidate(0),
+	 delay_timer(event_loop, BIND_THIS_METHOD(OnDelay)),
+	 timeout_timer(event_loop, BIND_THIS_METHOD(OnTimeout))
+{
+}
+
+ParallelConnectSocket::~ParallelConnectSocket() noexcept
+{
+	if (IsPending())
+		Cancel();
+}
+
+void
+ParallelConnectSocket::ClearAttempts() noexcept
+{
+	attempts.clear_and_dispose(DeleteDisposer());
+	candidates.clear();
+	next_candidate = 0;
+	delay_timer.Cancel();
+	timeout_timer.Cancel();
+}
+
+void
+ParallelConnectSocket::Cancel()
+{
+	assert(IsPending());
+
+	ClearAttempts();
+	last_error = nullptr;
+}
+
+void
+ParallelConnectSocket::Connect(const AddressInfoList &list,
+			       const struct timeval &timeout,
+			       const struct timeval &delay)
+{
+	assert(!IsPending());
+
+	/* RFC 8305 6: interleave the address families, starting
+	   with the first one returned by the resolver */
+	std::vector<const AddressInfo *> first, second;
+	int first_family = AF_UNSPEC;
+	for (const auto &i : list) {
+		if (first_family == AF_UNSPEC)
+			first_family = i.GetFamily();
+
+		(i.GetFamily() == first_family ? first : second).push_back(&i);
+	}
+
+	candidates.clear();
+	candidates.reserve(first.size() + second.size());
+	for (size_t i = 0; i < first.size() || i < second.size(); ++i) {
+		if (i < first.size())
+			candidates.push_back({AllocatedSocketAddress(*first[i]),
+					      first[i]->GetType(),
+					      first[i]->GetProtocol()});
+		if (i < second.size())
+			candidates.push_back({AllocatedSocketAddress(*second[i]),
+					      second[i]->GetType(),
+					      second[i]->GetProtocol()});
+	}
+
+	next_candidate = 0;
+	attempt_delay = delay;
+	last_error = nullptr;
+
+	if (candidates.empty()) {
+		handler.OnSocketConnectError(std::make_exception_ptr(std::runtime_error("No address")));
+		return;
+	}
+
+	timeout_timer.Add(timeout);
+	StartAttempts();
+}
+
+bool
+ParallelConnectSocket::StartAttempts() noexcept
+{
+	while (next_candidate < candidates.size()) {
+		const auto &c = candidates[next_candidate++];
+
+		try {
+			UniqueSocketDescriptor fd;
+			if (!fd.CreateNonBlock(c.address.GetFamily(), c.type,
+					       c.protocol))
+				throw MakeErrno("Failed to create socket");
+
+			if (!fd.Connect(c.address) && errno != EINPROGRESS)
+				throw MakeErrno("Failed to connect");
+
+			attempts.push_back(*new Attempt(*this, std::move(fd)));
+
+			if (next_candidate < candidates.size())
+				delay_timer.Add(attempt_delay);
+
+			return true;
+		} catch (...) {
+			/* this attempt has failed immediately; try the
+			   next one right now */
+			last_error = std::current_exception();
+		}
+	}
+
+	delay_timer.Cancel();
+
+	if (attempts.empty()) {
+		/* all attempts have failed */
+		auto error = std::exchange(last_error, nullptr);
+		ClearAttempts();
+		handler.OnSocketConnectError(error);
+		return false;
+	}
+
+	return true;
+}
+
+void
+ParallelConnectSocket::OnAttemptSuccess(Attempt &attempt,
+					UniqueSocketDescriptor &&fd) noexcept
+{
+	attempts.erase_and_dispose(attempts.iterator_to(attempt),
+				   DeleteDisposer());
+
+	/* the winner takes it all: cancel the other attempts */
+	ClearAttempts();
+	last_error = nullptr;
+
+	handler.OnSocketConnectSuccess(std::move(fd));
+}
+
+void
+ParallelConnectSocket::OnAttemptError(Attempt &attempt,
+				      std::exception_ptr ep) noexcept
+{
+	attempts.erase_and_dispose(attempts.iterator_to(attempt),
+				   DeleteDisposer());
+
+	last_error = ep;
+
+	/* don't wait for the delay to elapse; start the next attempt
+	   right now */
+	StartAttempts();
+}
+
+void
+ParallelConnectSocket::OnDelay() noexcept
+{
+	StartAttempts();
+}
+
+void
+ParallelConnectSocket::OnTimeout() noexcept
+{
+	ClearAttempts();
+	last_error = nullptr;
+
+	handler.OnSocketConnectTimeout();
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "ConnectSocket.hxx"
+#include "event/TimerEvent.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "util/Cancellable.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <exception>
+#include <vector>
+
+class AddressInfoList;
+
+/**
+ * Connect to one of several addresses, racing connection attempts
+ * with staggered starts ("Happy Eyeballs", RFC 8305).  Addresses
+ * are tried with alternating address families; a new attempt is
+ * started each time the "connection attempt delay" elapses or the
+ * previous attempt fails.  The first successful connection wins,
+ * and all other attempts are canceled.
+ */
+class ParallelConnectSocket final : public Cancellable {
+	EventLoop &event_loop;
+
+	ConnectSocketHandler &handler;
+
+	struct Candidate {
+		AllocatedSocketAddress address;
+		int type, protocol;
+	};
+
+	/**
+	 * The addresses in the order they will be tried.
+	 */
+	std::vector<Candidate> candidates;
+
+	/**
+	 * Index of the next element of #candidates to be tried.
+	 */
+	size_t next_candidate;
+
+	class Attempt final
+		: public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>>,
+		  ConnectSocketHandler {
+
+		ParallelConnectSocket &parent;
+
+		ConnectSocket connect;
+
+	public:
+		Attempt(ParallelConnectSocket &_parent,
+			UniqueSocketDescriptor &&fd) noexcept
+			:parent(_parent), connect(parent.event_loop, *this) {
+			connect.WaitConnected(std::move(fd), nullptr);
+		}
+
+		~Attempt() noexcept {
+			if (connect.IsPending())
+				connect.Cancel();
+		}
+
+	private:
+		/* virtual methods from ConnectSocketHandler */
+		void OnSocketConnectSuccess(UniqueSocketDescriptor &&fd) override {
+			parent.OnAttemptSuccess(*this, std::move(fd));
+		}
+
+		void OnSocketConnectError(std::exception_ptr ep) override {
+			parent.OnAttemptError(*this, ep);
+		}
+	};
+
+	typedef boost::intrusive::list<Attempt,
+				       boost::intrusive::constant_time_size<false>> AttemptList;
+
+	AttemptList attempts;
+
+	/**
+	 * Starts the next attempt after the connection attempt delay.
+	 */
+	TimerEvent delay_timer;
+
+	/**
+	 * The overall timeout.
+	 */
+	TimerEvent timeout_timer;
+
+	struct timeval attempt_delay;
+
+	/**
+	 * The error of the most recent failed attempt; it is passed
+	 * to the handler if all attempts fail.
+	 */
+	std::exception_ptr last_error;
+
+public:
+	ParallelConnectSocket(EventLoop &_event_loop,
+			      ConnectSocketHandler &_handler) noexcept;
+	~ParallelConnectSocket() noexcept;
+
+	ParallelConnectSocket(const ParallelConnectSocket &) = delete;
+	ParallelConnectSocket &operator=(const ParallelConnectSocket &) = delete;
+
+	bool IsPending() const noexcept {
+		return !attempts.empty() || next_candidate < candidates.size();
+	}
+
+	/**
+	 * Start connecting.  The #ConnectSocketHandler is invoked
+	 * exactly once (possibly from inside this method, e.g. if
+	 * the list is empty).
+	 *
+	 * @param timeout the overall timeout
+	 * @param delay the connection attempt delay; RFC 8305
+	 * recommends 250 ms
+	 */
+	void Connect(const AddressInfoList &list,
+		     const struct timeval &timeout,
+		     const struct timeval &delay={0, 250000});
+
+	/* virtual methods from Cancellable */
+	void Cancel() override;
+
+private:
+	/**
+	 * Start more attempts until one has been started
+	 * successfully or all candidates have failed.
+	 *
+	 * @return false if the handler has been invoked
+	 */
+	bool StartAttempts() noexcept;
+
+	void ClearAttempts() noexcept;
+
+	void OnAttemptSuccess(Attempt &attempt,
+			      UniqueSocketDescriptor &&fd) noexcept;
+	void OnAttemptError(Attempt &attempt,
+			    std::exception_ptr ep) noexcept;
+
+	void OnDelay() noexcept;
+	void OnTimeout() noexcept;
+};
@@ -37,7 +37,9 @@
 #include "net/SocketAddress.hxx"
 #include "net/StaticSocketAddress.hxx"
 #include "net/AllocatedSocketAddress.hxx"
+#include "event/Duration.hxx"
 #include "system/Error.hxx"
+#include "util/Trace.h"
 
 #include <assert.h>
 #include <stddef.h>
@@ -53,7 +55,13 @@
 ServerSocket::~ServerSocket()
 {
 	if (fd.IsDefined())
-		event.Delete();
+		RemoveEvent();
+}
+
+static bool
+IsTCP(SocketAddress address)
+{
+	return address.GetFamily() == AF_INET || address.GetFamily() == AF_INET6;
 }
 
 void
@@ -63,6 +71,7 @@ ServerSocket::Listen(UniqueSocketDescriptor &&_fd)
 	assert(_fd.IsDefined());
 
 	fd = std::move(_fd);
+	is_tcp = IsTCP(fd.GetLocalAddress());
 	event.Set(fd.Get(), SocketEvent::READ|SocketEvent::PERSIST);
 	AddEvent();
 }
@@ -124,12 +133,6 @@ MakeListener(const SocketAddress address,
 	return fd;
 }
 
-static bool
-IsTCP(SocketAddress address)
-{
-	return address.GetFamily() == AF_INET || address.GetFamily() == AF_INET6;
-}
-
 void
 ServerSocket::Listen(SocketAddress address,
 		     bool reuse_port,
@@ -182,8 +185,28 @@ ServerSocket::GetLocalAddress() const
 	return fd.GetLocalAddress();
 }
 
-void
-ServerSocket::EventCallback(unsigned)
+inline bool
+ServerSocket::CheckAcceptRate()
+{
+	if (accept_rate <= 0)
+		return true;
+
+	const auto now = std::chrono::duration_cast<std::chrono::duration<double>>(GetEventLoop().SteadyNow().time_since_epoch()).count();
+	if (accept_limiter.Check(now, accept_rate, accept_burst))
+		return true;
+
+	/* too many connections: stop accepting until enough tokens
+	   have accumulated; the kernel keeps the pending
+	   connections in the listen backlog meanwhile */
+	event.Delete();
+
+	const std::chrono::duration<double> delay(accept_limiter.GetDelay(now, accept_rate));
+	resume_timer.Add(ToEventDuration(std::chrono::duration_cast<std::chrono::microseconds>(delay)));
+	return false;
+}
+
+inline bool
+ServerSocket::AcceptOne()
 {
 	StaticSocketAddress remote_address;
 	auto remote_fd = fd.AcceptNonBlock(remote_address);
@@ -192,13 +215,35 @@ ServerSocket::EventCallback(unsigned)
 		if (e != EAGAIN && e != EWOULDBLOCK)
 			OnAcceptError(std::make_exception_ptr(MakeErrno(e, "Failed to accept connection")));
 
-		return;
+		return false;
 	}
 
-	if (IsTCP(remote_address) && !remote_fd.SetNoDelay()) {
+	if (is_tcp && !remote_fd.SetNoDelay()) {
 		OnAcceptError(std::make_exception_ptr(MakeErrno("setsockopt(TCP_NODELAY) failed")));
-		return;
+		return false;
 	}
 
+	TRACE_POINT(server_socket_accept, this, remote_fd.Get());
+
 	OnAccept(std::move(remote_fd), remote_address);
+	return true;
+}
+
+void
+ServerSocket::EventCallback(unsigned)
+{
+	for (unsigned i = 0; i < accept_batch; ++i) {
+		if (!CheckAcceptRate() || !AcceptOne())
+			break;
+
+		if (!event.IsPending(SocketEvent::READ))
+			/* OnAccept() has called RemoveEvent() */
+			break;
+	}
+}
+
+void
+ServerSocket::OnResumeTimer()
+{
+	AddEvent();
 }
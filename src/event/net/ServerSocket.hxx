@@ -34,9 +34,13 @@
 
 #include "net/UniqueSocketDescriptor.hxx"
 #include "event/SocketEvent.hxx"
+#include "event/TimerEvent.hxx"
+#include "util/TokenBucket.hxx"
 
 #include <exception>
 
+#include <assert.h>
+
 class SocketAddress;
 
 /**
@@ -46,9 +50,35 @@ class ServerSocket {
 	UniqueSocketDescriptor fd;
 	SocketEvent event;
 
+	/**
+	 * Re-enables the #event after the accept rate limit has been
+	 * exceeded.
+	 */
+	TimerEvent resume_timer;
+
+	TokenBucket accept_limiter;
+
+	/**
+	 * The maximum number of connections accepted per wakeup.
+	 */
+	unsigned accept_batch = 1;
+
+	/**
+	 * The accept rate limit (connections per second); 0 means
+	 * unlimited.
+	 */
+	double accept_rate = 0, accept_burst;
+
+	/**
+	 * Is this a TCP listener?  If yes, TCP_NODELAY is set on all
+	 * accepted sockets.
+	 */
+	bool is_tcp;
+
 public:
 	explicit ServerSocket(EventLoop &event_loop)
-		:event(event_loop, BIND_THIS_METHOD(EventCallback)) {}
+		:event(event_loop, BIND_THIS_METHOD(EventCallback)),
+		 resume_timer(event_loop, BIND_THIS_METHOD(OnResumeTimer)) {}
 
 	ServerSocket(EventLoop &event_loop, UniqueSocketDescriptor &&_fd)
 		:ServerSocket(event_loop) {
@@ -57,6 +87,10 @@ public:
 
 	~ServerSocket();
 
+	EventLoop &GetEventLoop() {
+		return event.GetEventLoop();
+	}
+
 	void Listen(UniqueSocketDescriptor &&_fd);
 
 	/**
@@ -79,18 +113,50 @@ public:
 		return fd.SetTcpDeferAccept(seconds);
 	}
 
+	/**
+	 * Accept up to this number of connections per wakeup instead
+	 * of just one.  This reduces the number of event loop
+	 * iterations during connection storms.
+	 */
+	void SetAcceptBatch(unsigned n) {
+		assert(n > 0);
+
+		accept_batch = n;
+	}
+
+	/**
+	 * Limit the rate of accepted connections, to prevent this
+	 * listener from starving the rest of the event loop.  Excess
+	 * connections remain in the kernel's backlog.
+	 *
+	 * @param rate the number of connections per second; 0
+	 * disables the limit
+	 * @param burst the maximum number of connections which may
+	 * be accepted at once after an idle period
+	 */
+	void SetAcceptRateLimit(double rate, double burst) {
+		accept_rate = rate;
+		accept_burst = burst;
+		accept_limiter.Reset();
+	}
+
 	void AddEvent() {
 		event.Add();
 	}
 
 	void RemoveEvent() {
 		event.Delete();
+		resume_timer.Cancel();
 	}
 
 protected:
 	/**
 	 * A new incoming connection has been established.
 	 *
+	 * In batch mode (see SetAcceptBatch()), this method may call
+	 * RemoveEvent() to stop accepting more connections, but it
+	 * must not destroy this object.
+	 *
 	 * @param fd the socket owned by the callee
 	 */
 	virtual void OnAccept(UniqueSocketDescriptor &&fd,
@@ -98,5 +164,19 @@ protected:
 	virtual void OnAcceptError(std::exception_ptr ep) = 0;
 
 private:
+	/**
+	 * Check the accept rate limit.  If it has been exceeded,
+	 * disable the event and schedule the #resume_timer.
+	 *
+	 * @return true if another connection may be accepted
+	 */
+	bool CheckAcceptRate();
+
+	/**
+	 * @return true if another connection may be accepted
+	 */
+	bool AcceptOne();
+
 	void EventCallback(unsigned events);
+	void OnResumeTimer();
 };
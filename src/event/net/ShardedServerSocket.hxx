@@ -0,0 +1,116 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "ServerSocket.hxx"
+#include "net/SocketAddress.hxx"
+
+#include <forward_list>
+#include <exception>
+
+struct SocketConfig;
+class EventLoopPool;
+
+class ShardedServerSocketHandler {
+public:
+	/**
+	 * A new incoming connection has been accepted.  This method
+	 * is invoked in the thread of the given #EventLoop; the
+	 * implementation must therefore be thread-safe.
+	 *
+	 * @param loop the #EventLoop which has accepted the
+	 * connection; the new connection should be handled by it
+	 * @param fd the socket owned by the callee
+	 */
+	virtual void OnShardAccept(EventLoop &loop,
+				   UniqueSocketDescriptor &&fd,
+				   SocketAddress address) noexcept = 0;
+
+	virtual void OnShardAcceptError(EventLoop &loop,
+					std::exception_ptr ep) noexcept = 0;
+};
+
+/**
+ * A listener which opens one SO_REUSEPORT socket for each #EventLoop
+ * of an #EventLoopPool.  The kernel distributes incoming connections
+ * among these sockets, and each connection is handled in the thread
+ * which has accepted it.
+ */
+class ShardedServerSocket {
+	class Shard final : public ServerSocket {
+		ShardedServerSocketHandler &handler;
+
+	public:
+		Shard(EventLoop &_loop, UniqueSocketDescriptor &&_fd,
+		      ShardedServerSocketHandler &_handler)
+			:ServerSocket(_loop, std::move(_fd)),
+			 handler(_handler) {}
+
+	protected:
+		void OnAccept(UniqueSocketDescriptor &&new_fd,
+			      SocketAddress address) override {
+			handler.OnShardAccept(GetEventLoop(), std::move(new_fd),
+					      address);
+		}
+
+		void OnAcceptError(std::exception_ptr ep) override {
+			handler.OnShardAcceptError(GetEventLoop(), ep);
+		}
+	};
+
+	ShardedServerSocketHandler &handler;
+
+	std::forward_list<Shard> shards;
+
+public:
+	explicit ShardedServerSocket(ShardedServerSocketHandler &_handler)
+		:handler(_handler) {}
+
+	/**
+	 * Create one listener socket for each #EventLoop in the pool.
+	 * SocketConfig::reuse_port is implied.  This must be called
+	 * before EventLoopPool::Start().
+	 *
+	 * The sockets are created in the order of the pool's
+	 * threads; with SocketConfig::reuse_port_cpu and threads
+	 * pinned to their CPUs (the #EventLoopPool default), each
+	 * connection is accepted on the CPU which received its
+	 * packets.
+	 *
+	 * Throws on error.
+	 */
+	void Listen(EventLoopPool &pool, const SocketConfig &config);
+
+	void AddEvent() noexcept;
+	void RemoveEvent() noexcept;
+};
@@ -31,32 +31,89 @@
  */
 
 #include "SocketWrapper.hxx"
+#include "event/Loop.hxx"
 #include "io/Splice.hxx"
 #include "net/Buffered.hxx"
 
+#include <algorithm>
+#include <system_error>
+
 #include <unistd.h>
+#include <errno.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+
+void
+SocketWrapper::ReadEventCallback(unsigned) noexcept
+{
+	assert(IsValid());
+
+	if (edge_triggered) {
+		/* a new edge: there is data, and a pending deferred
+		   call is obsolete */
+		read_ready = true;
+		defer_read.Cancel();
+	}
+
+	/* like libevent's persistent timeouts, the timeout is
+	   restarted each time the event fires */
+	if (read_timeout_event.IsPending())
+		read_timeout_event.Schedule(read_timeout);
+
+	/* completion notifications in the error queue are reported
+	   by epoll as EPOLLERR, which wakes up both events */
+	if (zerocopy && !ReceiveZeroCopyCompletions())
+		return;
+
+	handler.OnSocketRead();
+}
 
 void
-SocketWrapper::ReadEventCallback(unsigned events) noexcept
+SocketWrapper::OnDeferredRead() noexcept
 {
 	assert(IsValid());
+	assert(edge_triggered);
 
-	if (events & SocketEvent::TIMEOUT)
-		handler.OnSocketTimeout();
-	else
-		handler.OnSocketRead();
+	if (read_ready)
+		ReadEventCallback(SocketEvent::READ);
 }
 
 void
-SocketWrapper::WriteEventCallback(unsigned events) noexcept
+SocketWrapper::WriteEventCallback(unsigned) noexcept
 {
 	assert(IsValid());
 
-	if (events & SocketEvent::TIMEOUT)
-		handler.OnSocketTimeout();
-	else
-		handler.OnSocketWrite();
+	if (write_timeout_event.IsPending())
+		write_timeout_event.Schedule(write_timeout);
+
+	if (write_blocked_since != SocketStats::TimePoint()) {
+		stats.write_blocked += GetEventLoop().SteadyNow() - write_blocked_since;
+		write_blocked_since = SocketStats::TimePoint();
+	}
+
+	if (zerocopy && !ReceiveZeroCopyCompletions())
+		return;
+
+	handler.OnSocketWrite();
+}
+
+void
+SocketWrapper::OnReadTimeout() noexcept
+{
+	assert(IsValid());
+
+	read_timeout_event.Schedule(read_timeout);
+	handler.OnSocketTimeout();
+}
+
+void
+SocketWrapper::OnWriteTimeout() noexcept
+{
+	assert(IsValid());
+
+	write_timeout_event.Schedule(write_timeout);
+	handler.OnSocketTimeout();
 }
 
 void
@@ -67,6 +124,16 @@ SocketWrapper::Init(SocketDescriptor _fd, FdType _fd_type) noexcept
 	fd = _fd;
 	fd_type = _fd_type;
 
+	edge_triggered = false;
+	read_ready = false;
+
+	zerocopy = false;
+	zerocopy_next = 0;
+	zerocopy_pending = 0;
+
+	stats_enabled = false;
+	write_blocked_since = SocketStats::TimePoint();
+
 	read_event.Set(fd.Get(), SocketEvent::READ|SocketEvent::PERSIST);
 	write_event.Set(fd.Get(), SocketEvent::WRITE|SocketEvent::PERSIST);
 }
@@ -75,6 +142,23 @@ void
 SocketWrapper::Init(SocketWrapper &&src) noexcept
 {
 	Init(src.fd, src.fd_type);
+
+	if (src.edge_triggered) {
+		EnableEdgeTriggered();
+		read_ready = src.read_ready;
+	}
+
+	/* the kernel's zero-copy counter belongs to the socket */
+	zerocopy = src.zerocopy;
+	zerocopy_next = src.zerocopy_next;
+	zerocopy_pending = src.zerocopy_pending;
+
+	/* data which is still in the pipe belongs to this socket's
+	   stream */
+	pipe = std::move(src.pipe);
+	pipe_fill = src.pipe_fill;
+	src.pipe_fill = 0;
+
 	src.Abandon();
 }
 
@@ -95,6 +179,11 @@ SocketWrapper::Close() noexcept
 
 	read_event.Delete();
 	write_event.Delete();
+	defer_read.Cancel();
+	read_timeout_event.Cancel();
+	write_timeout_event.Cancel();
+
+	ReleasePipe();
 
 	fd.Close();
 }
@@ -106,6 +195,11 @@ SocketWrapper::Abandon() noexcept
 
 	read_event.Delete();
 	write_event.Delete();
+	defer_read.Cancel();
+	read_timeout_event.Cancel();
+	write_timeout_event.Cancel();
+
+	ReleasePipe();
 
 	fd = SocketDescriptor::Undefined();
 }
@@ -125,7 +219,29 @@ SocketWrapper::ReadToBuffer(ForeignFifoBuffer<uint8_t> &buffer) noexcept
 {
 	assert(IsValid());
 
-	return ReceiveToBuffer(fd.Get(), buffer);
+	ssize_t nbytes = ReceiveToBuffer(fd.Get(), buffer);
+	if (nbytes != -2) {
+		AccountRead(nbytes);
+
+		if (nbytes < 0 && errno == EAGAIN)
+			read_ready = false;
+	}
+
+	return nbytes;
+}
+
+void
+SocketWrapper::EnableEdgeTriggered() noexcept
+{
+	assert(IsValid());
+	assert(!IsReadPending());
+
+	read_event.Set(fd.Get(), SocketEvent::READ|SocketEvent::PERSIST|
+		       SocketEvent::EDGE_TRIGGERED);
+	edge_triggered = true;
+
+	/* data may have arrived before the event was registered */
+	read_ready = true;
 }
 
 bool
@@ -141,7 +257,8 @@ SocketWrapper::Write(const void *data, size_t length) noexcept
 {
 	assert(IsValid());
 
-	return send(fd.Get(), data, length, MSG_DONTWAIT|MSG_NOSIGNAL);
+	return AccountWrite(send(fd.Get(), data, length,
+				 MSG_DONTWAIT|MSG_NOSIGNAL));
 }
 
 ssize_t
@@ -159,12 +276,229 @@ SocketWrapper::WriteV(const struct iovec *v, size_t n) noexcept
 		.msg_flags = 0,
 	};
 
-	return sendmsg(fd.Get(), &m, MSG_DONTWAIT|MSG_NOSIGNAL);
+	return AccountWrite(sendmsg(fd.Get(), &m, MSG_DONTWAIT|MSG_NOSIGNAL));
+}
+
+void
+SocketWrapper::ReleasePipe() noexcept
+{
+	if (!pipe.IsDefined())
+		return;
+
+	if (pipe_fill == 0)
+		GetEventLoop().GetPipePool().Put(std::move(pipe));
+
+	/* a pipe which still contains data is closed; it cannot be
+	   reused */
+	pipe = PipePool::Pipe();
+	pipe_fill = 0;
+}
+
+inline ssize_t
+SocketWrapper::WriteFromPipe(int other_fd, size_t length) noexcept
+{
+	if (pipe_fill == 0) {
+		if (!pipe.IsDefined()) {
+			try {
+				pipe = GetEventLoop().GetPipePool().Get();
+			} catch (const std::system_error &e) {
+				errno = e.code().value();
+				return -1;
+			}
+		}
+
+		ssize_t nbytes = Splice(other_fd, pipe.w.Get(), length);
+		if (nbytes <= 0) {
+			ReleasePipe();
+			return nbytes;
+		}
+
+		pipe_fill = nbytes;
+	}
+
+	ssize_t nbytes = AccountWrite(Splice(pipe.r.Get(), fd.Get(),
+					     std::min(pipe_fill, length)));
+	if (nbytes > 0) {
+		pipe_fill -= nbytes;
+		if (pipe_fill == 0)
+			ReleasePipe();
+	}
+
+	return nbytes;
 }
 
 ssize_t
 SocketWrapper::WriteFrom(int other_fd, FdType other_fd_type,
 			 size_t length) noexcept
 {
-	return SpliceToSocket(other_fd_type, other_fd, fd.Get(), length);
+	assert(IsValid());
+
+	if (pipe_fill > 0 ||
+	    (other_fd_type != FdType::FD_PIPE &&
+	     other_fd_type != FdType::FD_FILE))
+		return WriteFromPipe(other_fd, length);
+
+	return AccountWrite(SpliceToSocket(other_fd_type, other_fd,
+					   fd.Get(), length));
+}
+
+ssize_t
+SocketWrapper::SendFile(int file_fd, off_t &offset, size_t length,
+			bool one_shot) noexcept
+{
+	assert(IsValid());
+
+	/* must not be mixed with a pending WriteFrom() transfer */
+	assert(pipe_fill == 0);
+
+	return AccountWrite(::SendFile(file_fd, offset, fd.Get(), length,
+				       one_shot));
+}
+
+void
+SocketWrapper::EnableStats() noexcept
+{
+	stats = SocketStats();
+	stats.start = GetEventLoop().SteadyNow();
+	stats_enabled = true;
+	write_blocked_since = SocketStats::TimePoint();
+}
+
+void
+SocketWrapper::AccountWrite2(ssize_t nbytes) noexcept
+{
+	assert(stats_enabled);
+
+	++stats.write_calls;
+
+	if (nbytes > 0)
+		stats.sent_bytes += nbytes;
+	else if (nbytes < 0 && errno == EAGAIN &&
+		 write_blocked_since == SocketStats::TimePoint())
+		write_blocked_since = GetEventLoop().SteadyNow();
+}
+
+bool
+SocketWrapper::EnableZeroCopy() noexcept
+{
+	assert(IsValid());
+
+#ifdef SO_ZEROCOPY
+	if (!fd.SetBoolOption(SOL_SOCKET, SO_ZEROCOPY, true))
+		return false;
+
+	zerocopy = true;
+	return true;
+#else
+	return false;
+#endif
+}
+
+ssize_t
+SocketWrapper::WriteZeroCopy(const void *data, size_t length,
+			     uint32_t &id_r) noexcept
+{
+	struct iovec v;
+	v.iov_base = const_cast<void *>(data);
+	v.iov_len = length;
+
+	return WriteVZeroCopy(&v, 1, id_r);
+}
+
+ssize_t
+SocketWrapper::WriteVZeroCopy(const struct iovec *v, size_t n,
+			      uint32_t &id_r) noexcept
+{
+	assert(IsValid());
+	assert(zerocopy);
+
+#ifdef MSG_ZEROCOPY
+	struct msghdr m = {
+		.msg_name = nullptr,
+		.msg_namelen = 0,
+		.msg_iov = const_cast<struct iovec *>(v),
+		.msg_iovlen = n,
+		.msg_control = nullptr,
+		.msg_controllen = 0,
+		.msg_flags = 0,
+	};
+
+	ssize_t nbytes = AccountWrite(sendmsg(fd.Get(), &m,
+					      MSG_DONTWAIT|MSG_NOSIGNAL|MSG_ZEROCOPY));
+	if (nbytes >= 0) {
+		/* the kernel increments its counter for each
+		   successful call */
+		id_r = zerocopy_next++;
+		++zerocopy_pending;
+	}
+
+	return nbytes;
+#else
+	(void)v;
+	(void)n;
+	(void)id_r;
+	errno = EOPNOTSUPP;
+	return -1;
+#endif
+}
+
+bool
+SocketWrapper::ReceiveZeroCopyCompletions() noexcept
+{
+	assert(IsValid());
+
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+	while (zerocopy_pending > 0) {
+		char control[CMSG_SPACE(sizeof(struct sock_extended_err) +
+					sizeof(struct sockaddr_in6))];
+		struct msghdr msg = {
+			.msg_name = nullptr,
+			.msg_namelen = 0,
+			.msg_iov = nullptr,
+			.msg_iovlen = 0,
+			.msg_control = control,
+			.msg_controllen = sizeof(control),
+			.msg_flags = 0,
+		};
+
+		if (recvmsg(fd.Get(), &msg, MSG_ERRQUEUE|MSG_DONTWAIT) < 0)
+			/* EAGAIN: no more notifications */
+			break;
+
+#ifdef __clang__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wcast-align"
+#endif
+
+		for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		     cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (!((cmsg->cmsg_level == SOL_IP &&
+			       cmsg->cmsg_type == IP_RECVERR) ||
+			      (cmsg->cmsg_level == SOL_IPV6 &&
+			       cmsg->cmsg_type == IPV6_RECVERR)))
+				continue;
+
+			const auto &ee = *(const struct sock_extended_err *)
+				CMSG_DATA(cmsg);
+			if (ee.ee_errno != 0 ||
+			    ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+				continue;
+
+			/* ee_info..ee_data is the inclusive range of
+			   completed ids */
+			const uint32_t first = ee.ee_info, last = ee.ee_data;
+			zerocopy_pending -= std::min(zerocopy_pending,
+						     last - first + 1);
+
+			if (!handler.OnSocketZeroCopyCompleted(first, last))
+				return false;
+		}
+
+#ifdef __clang__
+#pragma GCC diagnostic pop
+#endif
+	}
+#endif
+
+	return true;
 }
@@ -33,10 +33,16 @@
 #pragma once
 
 #include "io/FdType.hxx"
+#include "io/PipePool.hxx"
 #include "event/SocketEvent.hxx"
+#include "event/DeferEvent.hxx"
+#include "event/CoarseTimerEvent.hxx"
+#include "event/Duration.hxx"
 #include "net/SocketDescriptor.hxx"
 #include "util/Compiler.h"
 
+#include <chrono>
+
 #include <sys/types.h>
 #include <assert.h>
 #include <stddef.h>
@@ -64,6 +70,61 @@ public:
 	 * @return false when the socket has been closed
 	 */
 	virtual bool OnSocketTimeout() noexcept = 0;
+
+	/**
+	 * The kernel has finished transmitting the buffers passed to
+	 * SocketWrapper::WriteZeroCopy() with the given (inclusive)
+	 * range of ids, and they may now be reused.
+	 *
+	 * @return false when the socket has been closed
+	 */
+	virtual bool OnSocketZeroCopyCompleted(gcc_unused uint32_t first,
+					       gcc_unused uint32_t last) noexcept {
+		return true;
+	}
+};
+
+/**
+ * Traffic and latency counters of a #SocketWrapper, see
+ * SocketWrapper::EnableStats().
+ */
+struct SocketStats {
+	typedef std::chrono::steady_clock::time_point TimePoint;
+	typedef std::chrono::steady_clock::duration Duration;
+
+	uint64_t received_bytes = 0, sent_bytes = 0;
+
+	/**
+	 * The number of receive and send system calls.
+	 */
+	unsigned read_calls = 0, write_calls = 0;
+
+	/**
+	 * When was EnableStats() called?
+	 */
+	TimePoint start;
+
+	/**
+	 * When was the first byte received?  Unset if nothing has
+	 * been received yet.
+	 */
+	TimePoint first_byte;
+
+	/**
+	 * The total time spent waiting for the socket to become
+	 * writable after a send failed with EAGAIN.
+	 */
+	Duration write_blocked = Duration::zero();
+
+	bool HasReceived() const noexcept {
+		return first_byte != TimePoint();
+	}
+
+	Duration GetTimeToFirstByte() const noexcept {
+		assert(HasReceived());
+
+		return first_byte - start;
+	}
 };
 
 class SocketWrapper {
@@ -72,12 +133,84 @@ class SocketWrapper {
 
 	SocketEvent read_event, write_event;
 
+	/**
+	 * Invokes SocketHandler::OnSocketRead() in edge-triggered
+	 * mode if ScheduleRead() is called while the socket may
+	 * still have unread data, because there will be no new edge
+	 * for it.
+	 */
+	DeferEvent defer_read;
+
+	/**
+	 * Timeouts are managed by the #EventLoop's #TimerWheel
+	 * instead of libevent, because they are rescheduled after
+	 * each I/O operation.
+	 */
+	CoarseTimerEvent read_timeout_event, write_timeout_event;
+
+	CoarseTimerEvent::Duration read_timeout, write_timeout;
+
 	SocketHandler &handler;
 
+	/**
+	 * Was EnableEdgeTriggered() called?
+	 */
+	bool edge_triggered;
+
+	/**
+	 * Only used in edge-triggered mode: may the socket have
+	 * unread data, i.e. has no read failed with EAGAIN since the
+	 * read event fired last?
+	 */
+	bool read_ready;
+
+	/**
+	 * Was SO_ZEROCOPY enabled with EnableZeroCopy()?
+	 */
+	bool zerocopy;
+
+	/**
+	 * The id which will be assigned to the next successful
+	 * WriteZeroCopy() call; this mirrors the kernel's counter.
+	 */
+	uint32_t zerocopy_next;
+
+	/**
+	 * The number of WriteZeroCopy() calls whose completion
+	 * notification has not yet been received.
+	 */
+	uint32_t zerocopy_pending;
+
+	/**
+	 * A pipe borrowed from the #EventLoop's #PipePool for
+	 * WriteFrom() transfers from sources which cannot be spliced
+	 * to a socket directly.  It is returned to the pool as soon
+	 * as it is empty.
+	 */
+	PipePool::Pipe pipe;
+
+	/**
+	 * The number of bytes in #pipe.
+	 */
+	size_t pipe_fill = 0;
+
+	bool stats_enabled = false;
+
+	SocketStats stats;
+
+	/**
+	 * When did the last send fail with EAGAIN?  Unset if the
+	 * socket is not blocked.
+	 */
+	SocketStats::TimePoint write_blocked_since;
+
 public:
 	SocketWrapper(EventLoop &event_loop, SocketHandler &_handler) noexcept
 		:read_event(event_loop, BIND_THIS_METHOD(ReadEventCallback)),
 		 write_event(event_loop, BIND_THIS_METHOD(WriteEventCallback)),
+		 defer_read(event_loop, BIND_THIS_METHOD(OnDeferredRead)),
+		 read_timeout_event(event_loop, BIND_THIS_METHOD(OnReadTimeout)),
+		 write_timeout_event(event_loop, BIND_THIS_METHOD(OnWriteTimeout)),
 		 handler(_handler) {}
 
 	SocketWrapper(const SocketWrapper &) = delete;
@@ -131,33 +264,39 @@ public:
 	void ScheduleRead(const struct timeval *timeout) noexcept {
 		assert(IsValid());
 
-		if (timeout == nullptr && read_event.IsTimerPending())
-			/* work around libevent bug: event_add() should disable the
-			   timeout if tv==nullptr, but in fact it does not; workaround:
-			   delete the whole event first, then re-add it */
-			read_event.Delete();
+		read_event.Add();
 
-		read_event.Add(timeout);
+		if (edge_triggered && read_ready)
+			defer_read.Schedule();
+
+		if (timeout != nullptr) {
+			read_timeout = ToChrono(*timeout);
+			read_timeout_event.Schedule(read_timeout);
+		} else
+			read_timeout_event.Cancel();
 	}
 
 	void UnscheduleRead() noexcept {
 		read_event.Delete();
+		defer_read.Cancel();
+		read_timeout_event.Cancel();
 	}
 
 	void ScheduleWrite(const struct timeval *timeout) noexcept {
 		assert(IsValid());
 
-		if (timeout == nullptr && write_event.IsTimerPending())
-			/* work around libevent bug: event_add() should disable the
-			   timeout if tv==nullptr, but in fact it does not; workaround:
-			   delete the whole event first, then re-add it */
-			write_event.Delete();
+		write_event.Add();
 
-		write_event.Add(timeout);
+		if (timeout != nullptr) {
+			write_timeout = ToChrono(*timeout);
+			write_timeout_event.Schedule(write_timeout);
+		} else
+			write_timeout_event.Cancel();
 	}
 
 	void UnscheduleWrite() noexcept {
 		write_event.Delete();
+		write_timeout_event.Cancel();
 	}
 
 	gcc_pure
@@ -179,10 +318,161 @@ public:
 
 	ssize_t WriteV(const struct iovec *v, size_t n) noexcept;
 
+	/**
+	 * Transfer data from the given file descriptor to the
+	 * socket.  Pipes and regular files are transferred directly
+	 * with splice() or sendfile(); other sources (e.g. sockets)
+	 * are spliced through a pipe from the #EventLoop's
+	 * #PipePool.  Data which has been moved into that pipe but
+	 * not yet to the socket is not included in the return value;
+	 * it will be sent first by the next call.
+	 */
 	ssize_t WriteFrom(int other_fd, FdType other_fd_type,
 			  size_t length) noexcept;
 
+	/**
+	 * Transfer data from a regular file to the socket with
+	 * sendfile(), starting at the given offset, which is advanced
+	 * by the number of bytes transferred.  The file position is
+	 * not used.
+	 *
+	 * @param one_shot the file will not be sent again soon; drop
+	 * transferred data from the page cache
+	 */
+	ssize_t SendFile(int file_fd, off_t &offset, size_t length,
+			 bool one_shot=false) noexcept;
+
+	/**
+	 * Start collecting #SocketStats.  Counters are reset.
+	 */
+	void EnableStats() noexcept;
+
+	bool IsStatsEnabled() const noexcept {
+		return stats_enabled;
+	}
+
+	/**
+	 * Returns the counters collected since EnableStats().  A
+	 * write block which is still in progress is not yet
+	 * included.
+	 */
+	const SocketStats &GetStats() const noexcept {
+		return stats;
+	}
+
+	/**
+	 * Register the read event edge-triggered (see
+	 * SocketEvent::EDGE_TRIGGERED), which saves epoll wakeups on
+	 * busy sockets.  No data gets lost if the handler stops
+	 * reading before EAGAIN: as long as no read has failed with
+	 * EAGAIN, ScheduleRead() invokes SocketHandler::OnSocketRead()
+	 * again from a #DeferEvent.  Handlers which read from the
+	 * socket descriptor directly must call SetReadDrained() when
+	 * they get EAGAIN.
+	 *
+	 * This must be called after Init(), while no read is
+	 * scheduled.
+	 */
+	void EnableEdgeTriggered() noexcept;
+
+	bool IsEdgeTriggered() const noexcept {
+		return edge_triggered;
+	}
+
+	/**
+	 * Notify this object that the socket has no more data to be
+	 * read (i.e. a read on the socket descriptor has failed with
+	 * EAGAIN).  Only needed in edge-triggered mode.
+	 */
+	void SetReadDrained() noexcept {
+		read_ready = false;
+	}
+
+	/**
+	 * Enable SO_ZEROCOPY on the socket, which allows using
+	 * WriteZeroCopy().
+	 *
+	 * @return false if the kernel does not support MSG_ZEROCOPY
+	 */
+	bool EnableZeroCopy() noexcept;
+
+	bool IsZeroCopyEnabled() const noexcept {
+		return zerocopy;
+	}
+
+	/**
+	 * Returns the number of zero-copy writes which have not yet
+	 * been completed.
+	 */
+	uint32_t GetZeroCopyPending() const noexcept {
+		return zerocopy_pending;
+	}
+
+	/**
+	 * Send data with MSG_ZEROCOPY.  The kernel transmits directly
+	 * from the given buffers, which must therefore not be
+	 * modified or freed until
+	 * SocketHandler::OnSocketZeroCopyCompleted() has been invoked
+	 * with the id returned in #id_r.  This is only worth the
+	 * overhead for large buffers.
+	 *
+	 * Completion notifications are received from the socket's
+	 * error queue whenever the read or write event fires, or
+	 * explicitly with ReceiveZeroCopyCompletions().
+	 *
+	 * On ENOBUFS (the kernel's limit of pinned pages has been
+	 * reached), the caller may fall back to Write().
+	 *
+	 * @param id_r on success, the id of this write is returned
+	 * here
+	 */
+	ssize_t WriteZeroCopy(const void *data, size_t length,
+			      uint32_t &id_r) noexcept;
+
+	ssize_t WriteVZeroCopy(const struct iovec *v, size_t n,
+			       uint32_t &id_r) noexcept;
+
+	/**
+	 * Receive all pending MSG_ZEROCOPY completion notifications
+	 * from the socket's error queue and pass them to
+	 * SocketHandler::OnSocketZeroCopyCompleted().
+	 *
+	 * @return false when the socket has been closed
+	 */
+	bool ReceiveZeroCopyCompletions() noexcept;
+
 private:
+	void AccountRead(ssize_t nbytes) noexcept {
+		if (gcc_likely(!stats_enabled))
+			return;
+
+		++stats.read_calls;
+		if (nbytes > 0) {
+			stats.received_bytes += nbytes;
+			if (!stats.HasReceived())
+				stats.first_byte = GetEventLoop().SteadyNow();
+		}
+	}
+
+	ssize_t AccountWrite(ssize_t nbytes) noexcept {
+		if (gcc_unlikely(stats_enabled))
+			AccountWrite2(nbytes);
+		return nbytes;
+	}
+
+	void AccountWrite2(ssize_t nbytes) noexcept;
+
+	ssize_t WriteFromPipe(int other_fd, size_t length) noexcept;
+
+	/**
+	 * Give #pipe back to the #PipePool (or close it if it still
+	 * contains data).
+	 */
+	void ReleasePipe() noexcept;
+
 	void ReadEventCallback(unsigned events) noexcept;
+	void OnDeferredRead() noexcept;
 	void WriteEventCallback(unsigned events) noexcept;
+	void OnReadTimeout() noexcept;
+	void OnWriteTimeout() noexcept;
 };
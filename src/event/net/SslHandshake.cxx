@@ -0,0 +1,119 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "SslHandshake.hxx"
+#include "ssl/Error.hxx"
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+SslHandshake::SslHandshake(EventLoop &event_loop, SSL &_ssl,
+			   SslHandshakeHandler &_handler) noexcept
+	:ssl(_ssl), handler(_handler),
+	 socket_event(event_loop, SSL_get_fd(&_ssl), SocketEvent::READ,
+		      BIND_THIS_METHOD(OnSocketReady)),
+	 async_event(event_loop, -1, 0, BIND_THIS_METHOD(OnAsyncReady)),
+	 retry_event(event_loop, BIND_THIS_METHOD(Step))
+{
+	SSL_set_mode(&ssl, SSL_MODE_ASYNC);
+}
+
+void
+SslHandshake::Cancel() noexcept
+{
+	socket_event.Delete();
+	async_event.Delete();
+	retry_event.Cancel();
+}
+
+void
+SslHandshake::Step() noexcept
+{
+	ERR_clear_error();
+
+	const int result = SSL_do_handshake(&ssl);
+	if (result == 1) {
+		handler.OnSslHandshakeSuccess();
+		return;
+	}
+
+	switch (SSL_get_error(&ssl, result)) {
+	case SSL_ERROR_WANT_READ:
+		socket_event.Set(SSL_get_fd(&ssl), SocketEvent::READ);
+		socket_event.Add();
+		return;
+
+	case SSL_ERROR_WANT_WRITE:
+		socket_event.Set(SSL_get_fd(&ssl), SocketEvent::WRITE);
+		socket_event.Add();
+		return;
+
+	case SSL_ERROR_WANT_ASYNC:
+		{
+			/* only one private-key operation is pending at a
+			   time */
+			size_t n;
+			if (!SSL_get_all_async_fds(&ssl, nullptr, &n) || n != 1)
+				break;
+
+			OSSL_ASYNC_FD fd;
+			if (!SSL_get_all_async_fds(&ssl, &fd, &n))
+				break;
+
+			async_event.Set(fd, SocketEvent::READ);
+			async_event.Add();
+		}
+
+		return;
+
+	case SSL_ERROR_WANT_ASYNC_JOB:
+		retry_event.Schedule();
+		return;
+
+	default:
+		break;
+	}
+
+	handler.OnSslHandshakeError(std::make_exception_ptr(SslError("TLS handshake failed")));
+}
+
+void
+SslHandshake::OnSocketReady(unsigned) noexcept
+{
+	Step();
+}
+
+void
+SslHandshake::OnAsyncReady(unsigned) noexcept
+{
+	Step();
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "event/SocketEvent.hxx"
+#include "event/DeferEvent.hxx"
+#include "util/Cancellable.hxx"
+
+#include <openssl/ossl_typ.h>
+
+#include <exception>
+
+class SslHandshakeHandler {
+public:
+	virtual void OnSslHandshakeSuccess() noexcept = 0;
+	virtual void OnSslHandshakeError(std::exception_ptr ep) noexcept = 0;
+};
+
+/**
+ * Performs a TLS handshake on a non-blocking socket without
+ * blocking the #EventLoop.  The connection is switched to
+ * #SSL_MODE_ASYNC, so private-key operations of keys created by
+ * MakeAsyncKey() (or of an async-capable engine) pause the
+ * handshake; it is resumed when their completion is signalled on the
+ * async wait file descriptor, which is polled by the #EventLoop like
+ * the socket.
+ *
+ * Canceling while a private-key operation is pending merely stops
+ * this object from resuming the handshake; the operation runs to
+ * completion and its resources are freed together with the #SSL.
+ */
+class SslHandshake final : public Cancellable {
+	SSL &ssl;
+
+	SslHandshakeHandler &handler;
+
+	/**
+	 * Waits for the socket (#SSL_ERROR_WANT_READ,
+	 * #SSL_ERROR_WANT_WRITE).
+	 */
+	SocketEvent socket_event;
+
+	/**
+	 * Waits for a paused async job (#SSL_ERROR_WANT_ASYNC).
+	 */
+	SocketEvent async_event;
+
+	/**
+	 * Retries later if no async job is available
+	 * (#SSL_ERROR_WANT_ASYNC_JOB).
+	 */
+	DeferEvent retry_event;
+
+public:
+	/**
+	 * @param _ssl a connection with a file descriptor
+	 * (SSL_set_fd()) which is in accept or connect state
+	 */
+	SslHandshake(EventLoop &event_loop, SSL &_ssl,
+		     SslHandshakeHandler &_handler) noexcept;
+
+	~SslHandshake() noexcept {
+		Cancel();
+	}
+
+	SslHandshake(const SslHandshake &) = delete;
+	SslHandshake &operator=(const SslHandshake &) = delete;
+
+	/**
+	 * Start (or continue) the handshake.  The handler may be
+	 * invoked before this method returns.
+	 */
+	void Start() noexcept {
+		Step();
+	}
+
+	/* virtual methods from Cancellable */
+	void Cancel() noexcept override;
+
+private:
+	void Step() noexcept;
+
+	void OnSocketReady(unsigned events) noexcept;
+	void OnAsyncReady(unsigned events) noexcept;
+};
@@ -32,11 +32,28 @@
 
 #pragma once
 
+#include "net/SocketAddress.hxx"
+#include "util/ConstBuffer.hxx"
+
 #include <exception>
 
 #include <stddef.h>
 
-class SocketAddress;
+/**
+ * One datagram received in batch mode, see
+ * UdpHandler::OnUdpDatagramBatch().
+ */
+struct UdpDatagram {
+	const void *data;
+	size_t length;
+
+	SocketAddress address;
+
+	/**
+	 * The peer process uid, or -1 if unknown.
+	 */
+	int uid;
+};
 
 class UdpHandler {
 public:
@@ -46,5 +63,18 @@ public:
 	virtual void OnUdpDatagram(const void *data, size_t length,
 				   SocketAddress address, int uid) = 0;
 
+	/**
+	 * A batch of datagrams has been received (after
+	 * UdpListener::EnableBatch()).  The buffers are only valid
+	 * during this call.
+	 *
+	 * The default implementation calls OnUdpDatagram() for each
+	 * datagram.
+	 */
+	virtual void OnUdpDatagramBatch(ConstBuffer<UdpDatagram> batch) {
+		for (const auto &i : batch)
+			OnUdpDatagram(i.data, i.length, i.address, i.uid);
+	}
+
 	virtual void OnUdpError(std::exception_ptr ep) = 0;
 };
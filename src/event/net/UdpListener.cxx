@@ -33,14 +33,120 @@
 #include "UdpListener.hxx"
 #include "UdpHandler.hxx"
 #include "net/SocketAddress.hxx"
+#include "net/MultiMessage.hxx"
 #include "system/Error.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <algorithm>
+#include <vector>
 
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
 #include <sys/socket.h>
+#include <netinet/udp.h>
 #include <unistd.h>
 
+static constexpr size_t CONTROL_SIZE = CMSG_SPACE(1024);
+
+struct UdpListener::Batch {
+	MultiReceiveMessage multi;
+
+	/**
+	 * The datagrams passed to UdpHandler::OnUdpDatagramBatch();
+	 * allocated once and reused.
+	 */
+	std::vector<UdpDatagram> datagrams;
+
+	Batch(unsigned n, size_t max_datagram_size)
+		:multi(n, max_datagram_size, CONTROL_SIZE) {
+		/* with UDP_GRO, one message may yield more than one
+		   datagram, and the vector will grow as needed */
+		datagrams.reserve(n);
+	}
+};
+
+struct UdpControl {
+	/**
+	 * The peer process uid or -1 if unknown.
+	 */
+	int uid = -1;
+
+	/**
+	 * The UDP_GRO segment size, or 0 if the message was not
+	 * coalesced.
+	 */
+	size_t segment_size = 0;
+};
+
+/**
+ * Parse the control messages of a received datagram.  Passed file
+ * descriptors are closed.
+ */
+static UdpControl
+ParseControl(struct msghdr &msg)
+{
+	UdpControl result;
+
+#ifdef __clang__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wcast-align"
+#endif
+
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	while (cmsg != nullptr) {
+		if (cmsg->cmsg_level == SOL_SOCKET &&
+		    cmsg->cmsg_type == SCM_CREDENTIALS) {
+			const struct ucred *cred = (const struct ucred *)CMSG_DATA(cmsg);
+			result.uid = cred->uid;
+		} else if (cmsg->cmsg_level == SOL_UDP &&
+			   cmsg->cmsg_type == UDP_GRO) {
+			int segment_size;
+			memcpy(&segment_size, CMSG_DATA(cmsg),
+			       sizeof(segment_size));
+			if (segment_size > 0)
+				result.segment_size = segment_size;
+		} else if (cmsg->cmsg_level == SOL_SOCKET &&
+			   cmsg->cmsg_type == SCM_RIGHTS) {
+			const int *fds = (const int *)CMSG_DATA(cmsg);
+			const unsigned n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(fds[0]);
+
+			for (unsigned i = 0; i < n; ++i)
+				close(fds[i]);
+		}
+
+		cmsg = CMSG_NXTHDR(&msg, cmsg);
+	}
+
+#ifdef __clang__
+#pragma GCC diagnostic pop
+#endif
+
+	return result;
+}
+
+/**
+ * Invoke the callback for each segment of a message which may have
+ * been coalesced by UDP_GRO.
+ */
+template<typename F>
+static void
+ForEachSegment(const char *data, size_t length, size_t segment_size,
+	       F &&f)
+{
+	if (segment_size == 0 || segment_size >= length) {
+		f(data, length);
+		return;
+	}
+
+	while (length > 0) {
+		const size_t n = std::min(length, segment_size);
+		f(data, n);
+		data += n;
+		length -= n;
+	}
+}
+
 UdpListener::UdpListener(EventLoop &event_loop, UniqueSocketDescriptor &&_fd,
 			 UdpHandler &_handler)
 	:fd(std::move(_fd)),
@@ -73,15 +179,54 @@ UdpListener::SetFd(UniqueSocketDescriptor &&_fd)
 }
 
 void
-UdpListener::EventCallback(unsigned)
+UdpListener::EnableBatch(unsigned n, size_t max_datagram_size)
+{
+	assert(n > 0);
+	assert(max_datagram_size > 0);
+
+	batch.reset(new Batch(n, max_datagram_size));
+}
+
+void
+UdpListener::SetMaxDatagramSize(size_t size)
+{
+	assert(size > 0);
+
+	receive_buffer.reset(new char[size]);
+	receive_buffer_size = size;
+}
+
+bool
+UdpListener::EnableGro()
+{
+	int value = 1;
+	if (setsockopt(fd.Get(), SOL_UDP, UDP_GRO,
+		       &value, sizeof(value)) == 0)
+		return true;
+
+	if (errno == ENOPROTOOPT)
+		return false;
+
+	throw MakeErrno("Failed to enable UDP_GRO");
+}
+
+inline void
+UdpListener::ReceiveOne()
 {
-	char buffer[4096];
+	char stack_buffer[4096];
+	char *buffer = stack_buffer;
+	size_t buffer_size = sizeof(stack_buffer);
+	if (receive_buffer) {
+		buffer = receive_buffer.get();
+		buffer_size = receive_buffer_size;
+	}
+
 	struct iovec iov;
 	iov.iov_base = buffer;
-	iov.iov_len = sizeof(buffer);
+	iov.iov_len = buffer_size;
 
 	struct sockaddr_storage sa;
-	char cbuffer[CMSG_SPACE(1024)];
+	char cbuffer[CONTROL_SIZE];
 	struct msghdr msg = {
 		.msg_name = &sa,
 		.msg_namelen = sizeof(sa),
@@ -98,39 +243,54 @@ UdpListener::EventCallback(unsigned)
 		return;
 	}
 
-	int uid = -1;
+	const auto control = ParseControl(msg);
+	const SocketAddress address((struct sockaddr *)&sa, msg.msg_namelen);
 
-#ifdef __clang__
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wcast-align"
-#endif
+	ForEachSegment(buffer, nbytes, control.segment_size,
+		       [this, address, &control](const char *data, size_t length){
+			       handler.OnUdpDatagram(data, length,
+						     address, control.uid);
+		       });
+}
 
-	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
-	while (cmsg != nullptr) {
-		if (cmsg->cmsg_level == SOL_SOCKET &&
-		    cmsg->cmsg_type == SCM_CREDENTIALS) {
-			const struct ucred *cred = (const struct ucred *)CMSG_DATA(cmsg);
-			uid = cred->uid;
-		} else if (cmsg->cmsg_level == SOL_SOCKET &&
-			   cmsg->cmsg_type == SCM_RIGHTS) {
-			const int *fds = (const int *)CMSG_DATA(cmsg);
-			const unsigned n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(fds[0]);
+inline void
+UdpListener::ReceiveBatch()
+{
+	auto &b = *batch;
 
-			for (unsigned i = 0; i < n; ++i)
-				close(fds[i]);
-		}
+	try {
+		if (b.multi.Receive(fd) == 0)
+			return;
+	} catch (...) {
+		handler.OnUdpError(std::current_exception());
+		return;
+	}
 
-		cmsg = CMSG_NXTHDR(&msg, cmsg);
+	b.datagrams.clear();
+
+	for (const auto &m : b.multi) {
+		const int uid = m.cred != nullptr ? int(m.cred->uid) : -1;
+
+		ForEachSegment((const char *)m.payload.data,
+			       m.payload.size, m.segment_size,
+			       [&b, &m, uid](const char *data, size_t length){
+				       b.datagrams.push_back({
+					       data, length,
+					       m.address, uid,
+				       });
+			       });
 	}
 
-#ifdef __clang__
-#pragma GCC diagnostic pop
-#endif
+	handler.OnUdpDatagramBatch({b.datagrams.data(), b.datagrams.size()});
+}
 
-	handler.OnUdpDatagram(buffer, nbytes,
-			      SocketAddress((struct sockaddr *)&sa,
-					    msg.msg_namelen),
-			      uid);
+void
+UdpListener::EventCallback(unsigned)
+{
+	if (batch)
+		ReceiveBatch();
+	else
+		ReceiveOne();
 }
 
 void
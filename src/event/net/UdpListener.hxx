@@ -35,6 +35,8 @@
 #include "event/SocketEvent.hxx"
 #include "net/UniqueSocketDescriptor.hxx"
 
+#include <memory>
+
 #include <stddef.h>
 
 class SocketAddress;
@@ -49,6 +51,20 @@ class UdpListener {
 
 	UdpHandler &handler;
 
+	/**
+	 * Preallocated buffers for batch mode, see EnableBatch().
+	 */
+	struct Batch;
+	std::unique_ptr<Batch> batch;
+
+	/**
+	 * An optional heap-allocated receive buffer for the
+	 * non-batch mode, see SetMaxDatagramSize().  If this is
+	 * nullptr, a 4 kB stack buffer is used.
+	 */
+	std::unique_ptr<char[]> receive_buffer;
+	size_t receive_buffer_size = 0;
+
 public:
 	UdpListener(EventLoop &event_loop, UniqueSocketDescriptor &&_fd,
 		    UdpHandler &_handler);
@@ -69,6 +85,41 @@ public:
 		event.Delete();
 	}
 
+	/**
+	 * Switch to batch mode: receive up to the given number of
+	 * datagrams per wakeup with recvmmsg() and deliver them with
+	 * UdpHandler::OnUdpDatagramBatch().  All buffers are
+	 * allocated by this method.
+	 *
+	 * @param n the maximum number of datagrams per batch
+	 * @param max_datagram_size the maximum size of one datagram;
+	 * larger datagrams are truncated
+	 */
+	void EnableBatch(unsigned n, size_t max_datagram_size=4096);
+
+	/**
+	 * Change the size of the receive buffer used in non-batch
+	 * mode (the default is 4 kB).  Larger datagrams are
+	 * truncated.
+	 */
+	void SetMaxDatagramSize(size_t size);
+
+	/**
+	 * Enable UDP generic receive offload (UDP_GRO) on the socket.
+	 * The kernel may then coalesce several datagrams from the
+	 * same peer into one "super-datagram", which gets split
+	 * again by this class before it is passed to the
+	 * #UdpHandler.  To take advantage of this, the receive
+	 * buffer should be large (e.g. 64 kB), see EnableBatch() and
+	 * SetMaxDatagramSize().
+	 *
+	 * This setting belongs to the socket and must be repeated
+	 * after SetFd().
+	 *
+	 * @return false if the kernel does not support UDP_GRO
+	 */
+	bool EnableGro();
+
 	/**
 	 * Replaces the socket.  The old one is closed, and the new one is now
 	 * owned by this object.
@@ -87,5 +138,8 @@ public:
 		   const void *data, size_t data_length);
 
 private:
+	void ReceiveOne();
+	void ReceiveBatch();
+
 	void EventCallback(unsigned events);
 };
@@ -33,6 +33,8 @@
 #include "NetstringClient.hxx"
 #include "util/ConstBuffer.hxx"
 
+#include <stdexcept>
+
 static constexpr timeval send_timeout{10, 0};
 static constexpr timeval recv_timeout{60, 0};
 static constexpr timeval busy_timeout{5, 0};
@@ -56,7 +58,7 @@ NetstringClient::~NetstringClient()
 
 void
 NetstringClient::Request(int _out_fd, int _in_fd,
-			 std::list<ConstBuffer<void>> &&data)
+			 ConstBuffer<struct iovec> data)
 {
 	assert(in_fd < 0);
 	assert(out_fd < 0);
@@ -66,9 +68,10 @@ NetstringClient::Request(int _out_fd, int _in_fd,
 	out_fd = _out_fd;
 	in_fd = _in_fd;
 
-	generator(data);
+	assert(data.size <= MultiWriteBuffer::MAX_BUFFERS);
+
 	for (const auto &i : data)
-		write.Push(i.data, i.size);
+		write.Push(i.iov_base, i.iov_len);
 
 	event.Set(out_fd, SocketEvent::WRITE|SocketEvent::PERSIST);
 	event.Add(send_timeout);
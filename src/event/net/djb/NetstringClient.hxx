@@ -33,15 +33,13 @@
 #pragma once
 
 #include "io/MultiWriteBuffer.hxx"
-#include "net/djb/NetstringGenerator.hxx"
 #include "net/djb/NetstringInput.hxx"
 #include "event/SocketEvent.hxx"
 #include "util/ConstBuffer.hxx"
 
-#include <list>
 #include <exception>
 
-template<typename T> struct ConstBuffer;
+struct iovec;
 
 class NetstringClientHandler {
 public:
@@ -65,7 +63,6 @@ class NetstringClient final {
 
 	SocketEvent event;
 
-	NetstringGenerator generator;
 	MultiWriteBuffer write;
 
 	NetstringInput input;
@@ -85,14 +82,14 @@ public:
 	 * to the QMQP server
 	 * @param _in_fd a connected socket (or a pipe) for receiving data
 	 * from the QMQP server (may be equal to #_out_fd)
-	 * @param data a list of request data chunks which will be
-	 * concatenated, without the Netstring header/trailer; the memory
-	 * regions being pointed to must remain valid until the whole
-	 * request has been sent (i.e. until the #NetstringClientHandler
-	 * has been invoked)
+	 * @param data the complete request netstring including the
+	 * header/trailer (e.g. generated by #NetstringGenerator); the
+	 * vectors and the memory regions being pointed to must remain
+	 * valid until the whole request has been sent (i.e. until the
+	 * #NetstringClientHandler has been invoked)
 	 */
 	void Request(int _out_fd, int _in_fd,
-		     std::list<ConstBuffer<void>> &&data);
+		     ConstBuffer<struct iovec> data);
 
 private:
 	void OnEvent(unsigned events);
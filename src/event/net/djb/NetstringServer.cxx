@@ -31,6 +31,7 @@
  */
 
 #include "NetstringServer.hxx"
+#include "net/djb/NetstringGenerator.hxx"
 #include "util/ConstBuffer.hxx"
 
 #include <stdexcept>
@@ -56,10 +57,10 @@ NetstringServer::~NetstringServer()
 bool
 NetstringServer::SendResponse(const void *data, size_t size)
 	try {
-		std::list<ConstBuffer<void>> list{{data, size}};
-		generator(list);
-		for (const auto &i : list)
-			write.Push(i.data, i.size);
+		NetstringGenerator generator;
+		generator.Append({data, size});
+		for (const auto &i : generator.Finish())
+			write.Push(i.iov_base, i.iov_len);
 
 		switch (write.Write(fd.Get())) {
 		case MultiWriteBuffer::Result::MORE:
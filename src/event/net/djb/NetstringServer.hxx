@@ -34,7 +34,6 @@
 
 #include "io/MultiWriteBuffer.hxx"
 #include "net/djb/NetstringInput.hxx"
-#include "net/djb/NetstringGenerator.hxx"
 #include "net/UniqueSocketDescriptor.hxx"
 #include "event/SocketEvent.hxx"
 
@@ -52,7 +51,6 @@ class NetstringServer {
 	SocketEvent event;
 
 	NetstringInput input;
-	NetstringGenerator generator;
 	MultiWriteBuffer write;
 
 public:
@@ -32,23 +32,14 @@
 
 #include "QmqpClient.hxx"
 
-void
-QmqpClient::AppendNetstring(StringView value)
-{
-	netstring_headers.emplace_front();
-	auto &g = netstring_headers.front();
-	request.emplace_back(g(value.size).ToVoid());
-	request.emplace_back(value.ToVoid());
-	request.emplace_back(",", 1);
-}
+#include <string>
 
 void
 QmqpClient::Commit(int out_fd, int in_fd)
 {
-	assert(!netstring_headers.empty());
-	assert(!request.empty());
+	assert(!empty);
 
-	client.Request(out_fd, in_fd, std::move(request));
+	client.Request(out_fd, in_fd, generator.Finish());
 }
 
 void
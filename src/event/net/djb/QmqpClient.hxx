@@ -33,12 +33,11 @@
 #pragma once
 
 #include "NetstringClient.hxx"
-#include "net/djb/NetstringHeader.hxx"
+#include "net/djb/NetstringGenerator.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/StringView.hxx"
 
-#include <list>
-#include <forward_list>
+#include <stdexcept>
 
 #include <assert.h>
 
@@ -48,25 +47,19 @@ public:
 	virtual void OnQmqpClientError(std::exception_ptr error) = 0;
 };
 
-class QmqpClientError : std::runtime_error {
+class QmqpClientError : public std::runtime_error {
 public:
-	template<typename W>
-	QmqpClientError(W &&what_arg)
-		:std::runtime_error(std::forward<W>(what_arg)) {}
+	using std::runtime_error::runtime_error;
 };
 
-class QmqpClientTemporaryFailure final : QmqpClientError {
+class QmqpClientTemporaryFailure final : public QmqpClientError {
 public:
-	template<typename W>
-	QmqpClientTemporaryFailure(W &&what_arg)
-		:QmqpClientError(std::forward<W>(what_arg)) {}
+	using QmqpClientError::QmqpClientError;
 };
 
-class QmqpClientPermanentFailure final : QmqpClientError {
+class QmqpClientPermanentFailure final : public QmqpClientError {
 public:
-	template<typename W>
-	QmqpClientPermanentFailure(W &&what_arg)
-		:QmqpClientError(std::forward<W>(what_arg)) {}
+	using QmqpClientError::QmqpClientError;
 };
 
 /**
@@ -74,10 +67,21 @@ public:
  * response.
  */
 class QmqpClient final : NetstringClientHandler {
+public:
+	/**
+	 * The maximum number of recipients per email; the generator
+	 * needs two vectors per netstring, plus the outer header,
+	 * the trailer, the message and the sender.
+	 */
+	static constexpr size_t MAX_RECIPIENTS =
+		(NetstringGenerator::MAX_VECTORS - 2) / 2 - 2;
+
+private:
 	NetstringClient client;
 
-	std::forward_list<NetstringHeader> netstring_headers;
-	std::list<ConstBuffer<void>> request;
+	NetstringGenerator generator;
+
+	bool empty = true;
 
 	QmqpClientHandler &handler;
 
@@ -87,16 +91,25 @@ public:
 		 handler(_handler) {}
 
 	void Begin(StringView message, StringView sender) {
-		assert(netstring_headers.empty());
-		assert(request.empty());
+		assert(empty);
 
+		empty = false;
 		AppendNetstring(message);
 		AppendNetstring(sender);
 	}
 
+	/**
+	 * May another recipient be added?  The request is built
+	 * in a fixed-size buffer, which limits the number of
+	 * recipients per email.
+	 */
+	bool CanAddRecipient() const {
+		return generator.CanAppendNetstring();
+	}
+
 	void AddRecipient(StringView recipient) {
-		assert(!netstring_headers.empty());
-		assert(!request.empty());
+		assert(!empty);
+		assert(CanAddRecipient());
 
 		AppendNetstring(recipient);
 	}
@@ -104,7 +117,9 @@ public:
 	void Commit(int out_fd, int in_fd);
 
 private:
-	void AppendNetstring(StringView value);
+	void AppendNetstring(StringView value) {
+		generator.AppendNetstring(value.ToVoid());
+	}
 
 	/* virtual methods from NetstringClientHandler */
 	void OnNetstringResponse(AllocatedArray<uint8_t> &&payload) override;
@@ -0,0 +1,291 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "QmqpSubmitter.hxx"
+#include "net/SocketAddress.hxx"
+#include "util/DeleteDisposer.hxx"
+#include "util/FNVHash.hxx"
+
+#include <assert.h>
+
+QmqpSubmitter::Job::Job(QmqpSubmitter &_parent, QmqpClientHandler &_handler,
+			StringView _message, StringView _sender,
+			ConstBuffer<StringView> _recipients,
+			size_t _hash) noexcept
+	:parent(_parent), handler(_handler),
+	 message(_message), sender(_sender), recipients(_recipients),
+	 hash(_hash),
+	 connect(parent.event_loop, *this) {}
+
+void
+QmqpSubmitter::Job::Start() noexcept
+{
+	assert(relay != nullptr);
+	assert(!connect.IsPending());
+	assert(!client);
+
+	++attempts;
+	connect.Connect(relay->address, parent.connect_timeout);
+}
+
+void
+QmqpSubmitter::Job::Reset() noexcept
+{
+	if (connect.IsPending())
+		connect.Cancel();
+
+	client.reset();
+}
+
+void
+QmqpSubmitter::Job::Cancel()
+{
+	parent.OnJobCanceled(*this);
+}
+
+void
+QmqpSubmitter::Job::OnSocketConnectSuccess(UniqueSocketDescriptor &&fd)
+{
+	client.reset(new QmqpClient(parent.event_loop, *this));
+	client->Begin(message, sender);
+	for (const auto &i : recipients)
+		client->AddRecipient(i);
+
+	const int s = fd.Steal();
+	client->Commit(s, s);
+}
+
+void
+QmqpSubmitter::Job::OnSocketConnectError(std::exception_ptr ep)
+{
+	parent.OnJobError(*this, ep);
+}
+
+void
+QmqpSubmitter::Job::OnQmqpClientSuccess(StringView description)
+{
+	parent.OnJobSuccess(*this, description);
+}
+
+void
+QmqpSubmitter::Job::OnQmqpClientError(std::exception_ptr error)
+{
+	parent.OnJobError(*this, error);
+}
+
+QmqpSubmitter::~QmqpSubmitter() noexcept
+{
+	for (auto &relay : relays) {
+		relay.queue.clear_and_dispose(DeleteDisposer());
+		relay.active.clear_and_dispose(DeleteDisposer());
+	}
+}
+
+/**
+ * Calculate the #HashRing position of one replica of a relay.
+ */
+gcc_pure
+static size_t
+HashRelay(SocketAddress address, size_t replica) noexcept
+{
+	using Algorithm = FNV1aAlgorithm<FNVTraits<uint64_t>>;
+
+	uint64_t hash = FNV1aHash64(address.GetAddress(), address.GetSize());
+	for (size_t i = 0; i < sizeof(replica); ++i)
+		hash = Algorithm::Update(hash, uint8_t(replica >> (i * 8)));
+
+	/* relay addresses often differ only in one byte, which
+	   leaves the low bits of FNV-1a correlated; fold in the
+	   upper half before HashRing takes the modulo */
+	return hash ^ (hash >> 32);
+}
+
+void
+QmqpSubmitter::AddRelay(SocketAddress address, unsigned max_in_flight)
+{
+	assert(!address.IsNull());
+	assert(max_in_flight > 0);
+
+	relays.emplace_back(address, max_in_flight);
+	ring_dirty = true;
+}
+
+static bool
+IsPermanentFailure(std::exception_ptr ep) noexcept
+{
+	try {
+		std::rethrow_exception(ep);
+	} catch (const QmqpClientPermanentFailure &) {
+		return true;
+	} catch (...) {
+		return false;
+	}
+}
+
+void
+QmqpSubmitter::Submit(size_t hash, StringView message, StringView sender,
+		      ConstBuffer<StringView> recipients,
+		      QmqpClientHandler &handler,
+		      CancellablePointer &cancel_ptr)
+{
+	assert(!relays.empty());
+
+	++stats.submitted;
+
+	/* the request is built in a fixed-size buffer; check the
+	   limit here instead of letting QmqpClient assert */
+	if (recipients.size > QmqpClient::MAX_RECIPIENTS) {
+		++stats.failed;
+		handler.OnQmqpClientError(std::make_exception_ptr(QmqpClientPermanentFailure("Too many recipients")));
+		return;
+	}
+
+	if (ring_dirty) {
+		ring.Build(relays, [](const Relay &relay, size_t replica){
+				return HashRelay(relay.address, replica);
+			});
+		ring_dirty = false;
+	}
+
+	auto *job = new Job(*this, handler, message, sender, recipients,
+			    hash);
+	cancel_ptr = *job;
+
+	Enqueue(ring.Pick(hash), *job);
+}
+
+void
+QmqpSubmitter::Enqueue(Relay &relay, Job &job) noexcept
+{
+	job.relay = &relay;
+
+	if (relay.IsFull()) {
+		job.active = false;
+		relay.queue.push_back(job);
+		++stats.queued;
+	} else {
+		job.active = true;
+		relay.active.push_back(job);
+		++stats.in_flight;
+		job.Start();
+	}
+}
+
+void
+QmqpSubmitter::Dispatch(Relay &relay) noexcept
+{
+	while (!relay.queue.empty() && !relay.IsFull()) {
+		auto &job = relay.queue.front();
+		relay.queue.pop_front();
+		--stats.queued;
+
+		job.active = true;
+		relay.active.push_back(job);
+		++stats.in_flight;
+
+		/* this may finish (and delete) the job synchronously,
+		   which is why it has been moved to the active list
+		   first */
+		job.Start();
+	}
+}
+
+void
+QmqpSubmitter::Unlink(Job &job) noexcept
+{
+	auto &relay = *job.relay;
+
+	if (job.active) {
+		relay.active.erase(relay.active.iterator_to(job));
+		--stats.in_flight;
+	} else {
+		relay.queue.erase(relay.queue.iterator_to(job));
+		--stats.queued;
+	}
+}
+
+void
+QmqpSubmitter::OnJobSuccess(Job &job, StringView description) noexcept
+{
+	auto &relay = *job.relay;
+	Unlink(job);
+
+	++stats.delivered;
+	stats.delivered_bytes += job.GetMessageSize();
+
+	/* the description points into the QmqpClient, so the job
+	   must not be deleted before the handler returns */
+	job.GetHandler().OnQmqpClientSuccess(description);
+	delete &job;
+
+	Dispatch(relay);
+}
+
+void
+QmqpSubmitter::OnJobError(Job &job, std::exception_ptr error) noexcept
+{
+	auto &relay = *job.relay;
+	Unlink(job);
+	job.Reset();
+
+	if (job.attempts < max_attempts && !IsPermanentFailure(error)) {
+		const auto next = ring.FindNext(job.hash);
+		if (&next.second != &relay) {
+			/* try the failover relay */
+			job.hash = next.first;
+			++stats.retries;
+			Enqueue(next.second, job);
+			Dispatch(relay);
+			return;
+		}
+	}
+
+	++stats.failed;
+
+	auto &handler = job.GetHandler();
+	delete &job;
+	handler.OnQmqpClientError(error);
+
+	Dispatch(relay);
+}
+
+void
+QmqpSubmitter::OnJobCanceled(Job &job) noexcept
+{
+	auto &relay = *job.relay;
+	const bool was_active = job.active;
+	Unlink(job);
+	delete &job;
+
+	if (was_active)
+		Dispatch(relay);
+}
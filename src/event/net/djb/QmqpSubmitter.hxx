@@ -0,0 +1,304 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "QmqpClient.hxx"
+#include "event/net/ConnectSocket.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "util/HashRing.hxx"
+#include "util/Cancellable.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/StringView.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <list>
+#include <memory>
+
+#include <stdint.h>
+#include <sys/time.h>
+
+class CancellablePointer;
+
+/**
+ * Submits emails to a set of QMQP relays, keeping a bounded number
+ * of transactions in flight per relay.  Messages are distributed
+ * over the relays with consistent hashing (#HashRing) on a
+ * caller-provided hash (e.g. of the recipient domain), so the
+ * same hash always goes to the same relay while it is available.
+ * If a transaction fails with anything other than a permanent QMQP
+ * failure, the message is submitted again to the failover relay
+ * returned by HashRing::FindNext().
+ *
+ * Each transaction uses a new connection, because QMQP does not
+ * allow more than one message per connection.
+ */
+class QmqpSubmitter final {
+public:
+	struct Stats {
+		/**
+		 * The number of messages waiting for a free slot.
+		 */
+		size_t queued = 0;
+
+		/**
+		 * The number of transactions currently in progress.
+		 */
+		size_t in_flight = 0;
+
+		/**
+		 * The total number of messages passed to Submit().
+		 */
+		uint64_t submitted = 0;
+
+		/**
+		 * The total number of messages accepted by a relay.
+		 */
+		uint64_t delivered = 0;
+
+		/**
+		 * The total number of messages whose error was
+		 * passed to the handler.
+		 */
+		uint64_t failed = 0;
+
+		/**
+		 * The total number of times a message was submitted
+		 * again to a failover relay.
+		 */
+		uint64_t retries = 0;
+
+		/**
+		 * The total size of all delivered messages.
+		 */
+		uint64_t delivered_bytes = 0;
+	};
+
+private:
+	struct Relay;
+
+	class Job final
+		: public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>>,
+		  public Cancellable,
+		  QmqpClientHandler, ConnectSocketHandler {
+
+		QmqpSubmitter &parent;
+
+		QmqpClientHandler &handler;
+
+		const StringView message, sender;
+		const ConstBuffer<StringView> recipients;
+
+	public:
+		/**
+		 * The current position in the #HashRing.
+		 */
+		size_t hash;
+
+		Relay *relay = nullptr;
+
+		/**
+		 * The number of connection attempts so far.
+		 */
+		unsigned attempts = 0;
+
+		/**
+		 * Is this job in Relay::active (or in
+		 * Relay::queue)?
+		 */
+		bool active = false;
+
+	private:
+		ConnectSocket connect;
+
+		std::unique_ptr<QmqpClient> client;
+
+	public:
+		Job(QmqpSubmitter &_parent, QmqpClientHandler &_handler,
+		    StringView _message, StringView _sender,
+		    ConstBuffer<StringView> _recipients,
+		    size_t _hash) noexcept;
+
+		QmqpClientHandler &GetHandler() noexcept {
+			return handler;
+		}
+
+		size_t GetMessageSize() const noexcept {
+			return message.size;
+		}
+
+		void Start() noexcept;
+
+		/**
+		 * Abort the current transaction (if any).
+		 */
+		void Reset() noexcept;
+
+		/* virtual methods from Cancellable */
+		void Cancel() override;
+
+	private:
+		/* virtual methods from ConnectSocketHandler */
+		void OnSocketConnectSuccess(UniqueSocketDescriptor &&fd) override;
+		void OnSocketConnectError(std::exception_ptr ep) override;
+
+		/* virtual methods from QmqpClientHandler */
+		void OnQmqpClientSuccess(StringView description) override;
+		void OnQmqpClientError(std::exception_ptr error) override;
+	};
+
+	typedef boost::intrusive::list<Job,
+				       boost::intrusive::constant_time_size<true>> JobList;
+
+	struct Relay {
+		const AllocatedSocketAddress address;
+
+		const unsigned max_in_flight;
+
+		/**
+		 * Jobs waiting for a free slot.
+		 */
+		JobList queue;
+
+		/**
+		 * Jobs with a transaction in progress.
+		 */
+		JobList active;
+
+		Relay(SocketAddress _address, unsigned _max_in_flight) noexcept
+			:address(_address), max_in_flight(_max_in_flight) {}
+
+		bool IsFull() const noexcept {
+			return active.size() >= max_in_flight;
+		}
+	};
+
+	EventLoop &event_loop;
+
+	/**
+	 * A std::list because #ring and #Job point to its items.
+	 */
+	std::list<Relay> relays;
+
+	HashRing<Relay, size_t, 1024, 16> ring;
+
+	/**
+	 * Does #ring need to be rebuilt because a relay was added?
+	 */
+	bool ring_dirty = false;
+
+	struct timeval connect_timeout{10, 0};
+
+	unsigned max_attempts = 3;
+
+	Stats stats;
+
+public:
+	explicit QmqpSubmitter(EventLoop &_event_loop) noexcept
+		:event_loop(_event_loop) {}
+
+	/**
+	 * Pending submissions are canceled without invoking their
+	 * handlers.
+	 */
+	~QmqpSubmitter() noexcept;
+
+	QmqpSubmitter(const QmqpSubmitter &) = delete;
+	QmqpSubmitter &operator=(const QmqpSubmitter &) = delete;
+
+	EventLoop &GetEventLoop() noexcept {
+		return event_loop;
+	}
+
+	/**
+	 * Add a relay.  At least one relay must be added before
+	 * Submit() is called.
+	 *
+	 * @param max_in_flight the maximum number of concurrent
+	 * transactions with this relay; must not be zero
+	 */
+	void AddRelay(SocketAddress address, unsigned max_in_flight);
+
+	/**
+	 * @param attempts the maximum number of relays a message is
+	 * submitted to before its error is passed to the handler
+	 */
+	void SetRetry(const struct timeval &_connect_timeout,
+		      unsigned attempts) noexcept {
+		connect_timeout = _connect_timeout;
+		max_attempts = attempts;
+	}
+
+	const Stats &GetStats() const noexcept {
+		return stats;
+	}
+
+	/**
+	 * Submit an email.  The handler is invoked exactly once
+	 * unless the operation gets canceled.  It may be invoked
+	 * from inside this method, e.g. if there are too many
+	 * recipients.
+	 *
+	 * @param hash selects the relay; messages with equal hashes
+	 * go to the same relay
+	 * @param message the complete message including headers; the
+	 * memory of this and all other parameters must remain valid
+	 * until the handler has been invoked or the operation has been
+	 * canceled
+	 */
+	void Submit(size_t hash, StringView message, StringView sender,
+		    ConstBuffer<StringView> recipients,
+		    QmqpClientHandler &handler,
+		    CancellablePointer &cancel_ptr);
+
+private:
+	/**
+	 * Start the job if the relay has a free slot, or else append
+	 * it to the relay's queue.
+	 */
+	void Enqueue(Relay &relay, Job &job) noexcept;
+
+	/**
+	 * Start queued jobs while the relay has free slots.
+	 */
+	void Dispatch(Relay &relay) noexcept;
+
+	/**
+	 * Remove the job from its relay's list.
+	 */
+	void Unlink(Job &job) noexcept;
+
+	void OnJobSuccess(Job &job, StringView description) noexcept;
+	void OnJobError(Job &job, std::exception_ptr error) noexcept;
+	void OnJobCanceled(Job &job) noexcept;
+};
@@ -0,0 +1,328 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Pipeline.hxx"
+#include "event/InjectEvent.hxx"
+#include "event/net/UdpListener.hxx"
+#include "event/net/UdpHandler.hxx"
+#include "net/log/Datagram.hxx"
+#include "net/log/Parser.hxx"
+#include "net/SocketConfig.hxx"
+#include "net/SocketAddressHash.hxx"
+#include "net/StaticSocketAddress.hxx"
+#include "util/SpscQueue.hxx"
+#include "util/Trace.h"
+
+#include <algorithm>
+
+#include <string.h>
+#include <sys/socket.h>
+
+using namespace Net::Log;
+
+/**
+ * One parsed record in a queue slot (without the magic number).  The #Datagram points into
+ * #data, which is why records are never copied.
+ */
+struct Pipeline::Record {
+	StaticSocketAddress address;
+
+	Datagram datagram;
+
+	char data[MAX_DATAGRAM_SIZE];
+};
+
+class Pipeline::Queue final : public SpscQueue<Record> {
+public:
+	using SpscQueue::SpscQueue;
+};
+
+/**
+ * A counter which is written by only one thread and may be read by
+ * any thread.
+ */
+class SingleWriterCounter {
+	std::atomic<uint64_t> value{0};
+
+public:
+	void Increment() noexcept {
+		value.store(value.load(std::memory_order_relaxed) + 1,
+			    std::memory_order_relaxed);
+	}
+
+	uint64_t Load() const noexcept {
+		return value.load(std::memory_order_relaxed);
+	}
+};
+
+class Pipeline::Sink final {
+	Pipeline &pipeline;
+
+	const unsigned index;
+
+	InjectEvent wake_event;
+
+	/**
+	 * The maximum number of records taken from one queue per
+	 * wakeup, to give the other queues (and the rest of the
+	 * #EventLoop) a chance.
+	 */
+	static constexpr unsigned MAX_PER_QUEUE = 256;
+
+public:
+	SingleWriterCounter delivered;
+
+	Sink(Pipeline &_pipeline, EventLoop &loop, unsigned _index) noexcept
+		:pipeline(_pipeline), index(_index),
+		 wake_event(loop, BIND_THIS_METHOD(OnWake)) {}
+
+	/**
+	 * Called by a receiver thread after it has added records.
+	 */
+	void Wake() noexcept {
+		wake_event.Schedule();
+	}
+
+private:
+	void OnWake() noexcept;
+};
+
+void
+Pipeline::Sink::OnWake() noexcept
+{
+	bool more = false;
+
+	for (unsigned r = 0; r < pipeline.n_receivers; ++r) {
+		auto &queue = pipeline.GetQueue(r, index);
+
+		for (unsigned n = 0;; ++n) {
+			Record *record = queue.Front();
+			if (record == nullptr)
+				break;
+
+			if (n >= MAX_PER_QUEUE) {
+				more = true;
+				break;
+			}
+
+			pipeline.handler.OnLogDatagram(index, record->address,
+						       record->datagram);
+			queue.Pop();
+			delivered.Increment();
+		}
+	}
+
+	if (more)
+		/* continue in the next iteration */
+		wake_event.Schedule();
+}
+
+class Pipeline::Receiver final : UdpHandler {
+	Pipeline &pipeline;
+
+	const unsigned index;
+
+	UdpListener listener;
+
+	/**
+	 * Which sinks need to be woken up after the current batch?
+	 */
+	std::vector<bool> wake;
+
+public:
+	SingleWriterCounter received, malformed, dropped;
+
+	Receiver(Pipeline &_pipeline, EventLoop &loop, unsigned _index,
+		 UniqueSocketDescriptor &&fd, unsigned batch_size)
+		:pipeline(_pipeline), index(_index),
+		 listener(loop, std::move(fd), *this),
+		 wake(pipeline.n_sinks, false) {
+		listener.EnableBatch(batch_size, MAX_DATAGRAM_SIZE);
+	}
+
+private:
+	unsigned SelectSink(SocketAddress address) const noexcept {
+		uint64_t hash = SocketAddressHash()(address);
+		hash ^= hash >> 32;
+		return hash % pipeline.n_sinks;
+	}
+
+	void Receive(const void *data, size_t length,
+		     SocketAddress address) noexcept;
+
+	void WakeSinks() noexcept {
+		for (unsigned s = 0; s < pipeline.n_sinks; ++s) {
+			if (wake[s]) {
+				wake[s] = false;
+				pipeline.sinks[s]->Wake();
+			}
+		}
+	}
+
+	/* virtual methods from class UdpHandler */
+	void OnUdpDatagram(const void *data, size_t length,
+			   SocketAddress address, int) override {
+		Receive(data, length, address);
+		WakeSinks();
+	}
+
+	void OnUdpDatagramBatch(ConstBuffer<UdpDatagram> batch) override {
+		for (const auto &i : batch)
+			Receive(i.data, i.length, i.address);
+		WakeSinks();
+	}
+
+	void OnUdpError(std::exception_ptr) override {
+		/* nobody to report this to; the socket keeps
+		   working */
+	}
+};
+
+inline void
+Pipeline::Receiver::Receive(const void *data, size_t length,
+			    SocketAddress address) noexcept
+{
+	TRACE_POINT(log_datagram_receive, index, length);
+
+	received.Increment();
+
+	const unsigned s = SelectSink(address);
+	auto &queue = pipeline.GetQueue(index, s);
+
+	try {
+		DatagramIterator i(data, (const uint8_t *)data + length);
+
+		ConstBuffer<void> raw;
+		while (!(raw = i.NextRaw()).IsNull()) {
+			if (raw.size > sizeof(Record::data))
+				throw ProtocolError();
+
+			Record *record = queue.Reserve();
+			if (record == nullptr) {
+				TRACE_POINT(log_datagram_drop, index, s);
+				dropped.Increment();
+				continue;
+			}
+
+			/* copy the record to the queue slot and parse
+			   it there, so the Datagram's pointers remain
+			   valid */
+			memcpy(record->data, raw.data, raw.size);
+			record->datagram = ParseDatagramAttributes(record->data,
+								   record->data + raw.size);
+
+			if (address.IsNull())
+				record->address.Clear();
+			else
+				record->address = address;
+
+			queue.Commit();
+			wake[s] = true;
+		}
+	} catch (ProtocolError) {
+		/* records before the malformed one have already been
+		   committed */
+		malformed.Increment();
+	}
+}
+
+Pipeline::Pipeline(const Config &config, const SocketConfig &_socket_config,
+		   PipelineHandler &_handler)
+	:handler(_handler),
+	 receiver_pool(config.n_receivers, true),
+	 sink_pool(std::max(config.n_sinks, 1u), false),
+	 n_receivers(receiver_pool.size()), n_sinks(sink_pool.size())
+{
+	SocketConfig socket_config(_socket_config);
+	socket_config.reuse_port = true;
+
+	queues.reserve(n_receivers * n_sinks);
+	for (unsigned i = 0; i < n_receivers * n_sinks; ++i)
+		queues.emplace_back(new Queue(config.queue_size));
+
+	sinks.reserve(n_sinks);
+	for (unsigned s = 0; s < n_sinks; ++s)
+		sinks.emplace_back(new Sink(*this, sink_pool.GetEventLoop(s), s));
+
+	receivers.reserve(n_receivers);
+	for (unsigned r = 0; r < n_receivers; ++r)
+		receivers.emplace_back(new Receiver(*this,
+						    receiver_pool.GetEventLoop(r),
+						    r,
+						    socket_config.Create(SOCK_DGRAM),
+						    config.batch_size));
+}
+
+Pipeline::~Pipeline() noexcept
+{
+	Stop();
+}
+
+void
+Pipeline::Start()
+{
+	sink_pool.Start();
+	receiver_pool.Start();
+}
+
+void
+Pipeline::Stop() noexcept
+{
+	receiver_pool.Stop();
+	sink_pool.Stop();
+}
+
+Pipeline::Stats
+Pipeline::GetStats() const noexcept
+{
+	Stats stats;
+
+	for (const auto &r : receivers) {
+		stats.received += r->received.Load();
+		stats.malformed += r->malformed.Load();
+		stats.dropped += r->dropped.Load();
+	}
+
+	for (const auto &s : sinks)
+		stats.delivered += s->delivered.Load();
+
+	return stats;
+}
+
+size_t
+Pipeline::GetQueueDepth(unsigned sink) const noexcept
+{
+	size_t result = 0;
+	for (unsigned r = 0; r < n_receivers; ++r)
+		result += GetQueue(r, sink).size();
+	return result;
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "event/Pool.hxx"
+#include "net/SocketAddress.hxx"
+#include "util/Compiler.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <stdint.h>
+
+struct SocketConfig;
+
+namespace Net {
+namespace Log {
+
+struct Datagram;
+
+class PipelineHandler {
+public:
+	/**
+	 * A record has been received.  This method is invoked in the
+	 * thread of the given sink; different sinks may call it
+	 * concurrently.  The #Datagram and the address are only
+	 * valid during this call.
+	 *
+	 * @param sink the index of the sink thread
+	 */
+	virtual void OnLogDatagram(unsigned sink, SocketAddress address,
+				   const Datagram &d) noexcept = 0;
+};
+
+/**
+ * A multi-threaded receiver for #Datagram packets.  Each receiver
+ * thread owns one SO_REUSEPORT socket, parses incoming packets with
+ * ParseDatagram() and hands them through lock-free single-producer
+ * single-consumer queues to a sink thread, which invokes the
+ * #PipelineHandler.
+ *
+ * Each source address is mapped to one sink by hash, and since the
+ * kernel delivers all packets of one source to the same
+ * SO_REUSEPORT socket (as long as the set of sockets does not
+ * change), the records of one source are delivered in order.
+ *
+ * If a queue is full, the record is dropped and counted.
+ */
+class Pipeline {
+public:
+	struct Config {
+		/**
+		 * The number of receiver threads; 0 means one for
+		 * each CPU.  Receiver threads are pinned to their
+		 * CPUs.
+		 */
+		unsigned n_receivers = 0;
+
+		/**
+		 * The number of sink threads.
+		 */
+		unsigned n_sinks = 1;
+
+		/**
+		 * The capacity of each queue (one for each pair of
+		 * receiver and sink); must be a power of two.
+		 */
+		size_t queue_size = 1024;
+
+		/**
+		 * The maximum number of packets received with one
+		 * recvmmsg() call.
+		 */
+		unsigned batch_size = 64;
+	};
+
+	struct Stats {
+		/**
+		 * The number of packets received.
+		 */
+		uint64_t received = 0;
+
+		/**
+		 * The number of packets rejected by
+		 * ParseDatagram().
+		 */
+		uint64_t malformed = 0;
+
+		/**
+		 * The number of records dropped because the queue was
+		 * full.
+		 */
+		uint64_t dropped = 0;
+
+		/**
+		 * The number of records passed to the
+		 * #PipelineHandler.
+		 */
+		uint64_t delivered = 0;
+	};
+
+	/**
+	 * Larger packets are truncated (and will most likely be
+	 * rejected by the parser).
+	 */
+	static constexpr size_t MAX_DATAGRAM_SIZE = 4096;
+
+private:
+	struct Record;
+	class Queue;
+	class Receiver;
+	class Sink;
+
+	PipelineHandler &handler;
+
+	EventLoopPool receiver_pool, sink_pool;
+
+	const unsigned n_receivers, n_sinks;
+
+	/**
+	 * A matrix of n_receivers * n_sinks queues, one row per
+	 * receiver.
+	 */
+	std::vector<std::unique_ptr<Queue>> queues;
+
+	std::vector<std::unique_ptr<Receiver>> receivers;
+	std::vector<std::unique_ptr<Sink>> sinks;
+
+public:
+	/**
+	 * Create all sockets, threads and queues.  SocketConfig::reuse_port
+	 * is implied.
+	 *
+	 * Throws on error.
+	 */
+	Pipeline(const Config &config, const SocketConfig &socket_config,
+		 PipelineHandler &_handler);
+
+	~Pipeline() noexcept;
+
+	Pipeline(const Pipeline &) = delete;
+	Pipeline &operator=(const Pipeline &) = delete;
+
+	unsigned GetReceiverCount() const noexcept {
+		return n_receivers;
+	}
+
+	unsigned GetSinkCount() const noexcept {
+		return n_sinks;
+	}
+
+	/**
+	 * Launch all threads.
+	 *
+	 * Throws on error.
+	 */
+	void Start();
+
+	/**
+	 * Stop all threads.  Records still queued are discarded.
+	 */
+	void Stop() noexcept;
+
+	/**
+	 * Returns the sum of all counters.  May be called from any
+	 * thread.
+	 */
+	gcc_pure
+	Stats GetStats() const noexcept;
+
+	/**
+	 * Returns the number of records waiting for the given sink.
+	 * May be called from any thread.
+	 */
+	gcc_pure
+	size_t GetQueueDepth(unsigned sink) const noexcept;
+
+private:
+	Queue &GetQueue(unsigned receiver, unsigned sink) noexcept {
+		return *queues[receiver * n_sinks + sink];
+	}
+
+	const Queue &GetQueue(unsigned receiver, unsigned sink) const noexcept {
+		return *queues[receiver * n_sinks + sink];
+	}
+};
+
+}}
@@ -0,0 +1,270 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Sender.hxx"
+#include "net/log/Serializer.hxx"
+#include "net/log/Filter.hxx"
+#include "net/log/Datagram.hxx"
+#include "event/Loop.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+#include <sys/socket.h>
+
+using namespace Net::Log;
+
+Sender::Sender(EventLoop &event_loop, UniqueSocketDescriptor &&_fd)
+	:fd(std::move(_fd)),
+	 event(event_loop, fd.Get(), SocketEvent::WRITE,
+	       BIND_THIS_METHOD(OnSocketReady)),
+	 defer_flush(event_loop, BIND_THIS_METHOD(OnDeferredFlush)),
+	 buffer(new uint8_t[BUFFER_SIZE]),
+	 send_batch(MAX_RECORDS)
+{
+}
+
+Sender::~Sender() noexcept
+{
+	Flush();
+
+	event.Delete();
+	defer_flush.Cancel();
+}
+
+inline size_t
+Sender::TrySerialize(const Datagram &d, bool &open) noexcept
+{
+	open = false;
+
+	if (n_records == MAX_RECORDS)
+		return 0;
+
+	uint8_t *const p = buffer.get() + fill;
+	const size_t room = BUFFER_SIZE - fill;
+
+	if (max_packet_size > 0) {
+		const size_t limit = std::min(room, max_packet_size);
+		const size_t header = SerializeMultiHeader(p, limit);
+		if (header > 0) {
+			const size_t size = SerializeMultiRecord(p + header,
+								 limit - header,
+								 d, crc);
+			if (size > 0) {
+				open = true;
+				return header + size;
+			}
+		}
+
+		/* this record does not fit into a multi-record
+		   packet; fall back to the single-record format */
+	}
+
+	return Serialize(p, room, d, crc);
+}
+
+inline bool
+Sender::TryAppend(const Datagram &d) noexcept
+{
+	assert(last_open);
+	assert(n_records > 0);
+
+	auto &last = records[n_records - 1];
+	assert(last.iov_len <= max_packet_size);
+
+	const size_t room = std::min(BUFFER_SIZE - fill,
+				     max_packet_size - last.iov_len);
+	const size_t size = SerializeMultiRecord(buffer.get() + fill, room,
+						 d, crc);
+	if (size == 0) {
+		/* the packet is full */
+		last_open = false;
+		return false;
+	}
+
+	last.iov_len += size;
+	fill += size;
+	++record_counts[n_records - 1];
+	return true;
+}
+
+bool
+Sender::Enqueue(const Datagram &d) noexcept
+{
+	if (last_open && TryAppend(d))
+		return true;
+
+	bool open;
+	size_t size = TrySerialize(d, open);
+	if (size == 0 && n_records > 0) {
+		/* make room and try again */
+		Flush();
+		size = TrySerialize(d, open);
+	}
+
+	if (size == 0) {
+		/* the buffer is full and the socket is not writable,
+		   or this record is larger than the whole buffer */
+		++stats.dropped;
+		return false;
+	}
+
+	records[n_records] = {buffer.get() + fill, size};
+	record_counts[n_records] = 1;
+	++n_records;
+	fill += size;
+	last_open = open;
+
+	if (n_records == MAX_RECORDS)
+		Flush();
+	else if (!event.IsPending(SocketEvent::WRITE))
+		/* no need for the DeferEvent while waiting for the
+		   socket to become writable */
+		defer_flush.Schedule();
+
+	return true;
+}
+
+void
+Sender::MaybeLogSummary(double now) noexcept
+{
+	if (!filter->HasDropped() || now < last_summary + SUMMARY_INTERVAL)
+		return;
+
+	last_summary = now;
+
+	char summary_buffer[256];
+	Datagram summary(filter->FormatSummary(summary_buffer, sizeof(summary_buffer)));
+	summary.SetTimestamp(event.GetEventLoop().SystemNow());
+	Enqueue(summary);
+}
+
+bool
+Sender::Log(const Datagram &d) noexcept
+{
+	if (filter != nullptr) {
+		auto &loop = event.GetEventLoop();
+		const double now = std::chrono::duration_cast<std::chrono::duration<double>>(loop.SteadyNow().time_since_epoch()).count();
+
+		MaybeLogSummary(now);
+
+		if (!filter->Check(d, now)) {
+			++stats.filtered;
+			return false;
+		}
+	}
+
+	return Enqueue(d);
+}
+
+uint64_t
+Sender::CountRecords(unsigned n) const noexcept
+{
+	uint64_t result = 0;
+	for (unsigned i = 0; i < n; ++i)
+		result += record_counts[i];
+	return result;
+}
+
+void
+Sender::Consume(unsigned n) noexcept
+{
+	assert(n <= n_records);
+
+	if (n == n_records) {
+		n_records = 0;
+		fill = 0;
+		last_open = false;
+		return;
+	}
+
+	/* move the remaining records to the beginning of the
+	   buffer */
+	const auto *start = (const uint8_t *)records[n].iov_base;
+	const size_t shift = start - buffer.get();
+	memmove(buffer.get(), start, fill - shift);
+	fill -= shift;
+
+	std::copy(records.begin() + n, records.begin() + n_records,
+		  records.begin());
+	std::copy(record_counts.begin() + n, record_counts.begin() + n_records,
+		  record_counts.begin());
+	n_records -= n;
+
+	for (unsigned i = 0; i < n_records; ++i)
+		records[i].iov_base = (uint8_t *)records[i].iov_base - shift;
+}
+
+void
+Sender::Flush() noexcept
+{
+	defer_flush.Cancel();
+
+	if (n_records == 0)
+		return;
+
+	send_batch.Clear();
+	for (unsigned i = 0; i < n_records; ++i)
+		send_batch.Add({records[i].iov_base, records[i].iov_len});
+
+	size_t n;
+	try {
+		n = send_batch.Send(fd);
+	} catch (...) {
+		/* the first record failed; since there is nobody to
+		   report this to, discard everything and start
+		   over */
+		stats.errors += CountRecords(n_records);
+		Consume(n_records);
+		return;
+	}
+
+	if (n == 0) {
+		/* EAGAIN */
+		event.Add();
+		return;
+	}
+
+	stats.sent += CountRecords(n);
+	Consume(n);
+
+	if (n_records > 0)
+		/* the socket buffer is full */
+		event.Add();
+}
+
+void
+Sender::OnSocketReady(unsigned) noexcept
+{
+	Flush();
+}
@@ -0,0 +1,280 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "event/SocketEvent.hxx"
+#include "event/DeferEvent.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "net/MultiMessage.hxx"
+#include "util/Compiler.h"
+
+#include <array>
+#include <memory>
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+namespace Net {
+namespace Log {
+
+struct Datagram;
+class Filter;
+
+/**
+ * Sends #Datagram objects to a log server over a connected datagram
+ * socket.  Records are serialized into a preallocated buffer and
+ * sent in batches with sendmmsg(), once per #EventLoop iteration or
+ * as soon as the buffer is full.
+ *
+ * Optionally (see EnableMultiRecord()), several records are packed
+ * into one packet.
+ *
+ * Logging never blocks: if the socket is not writable and the
+ * buffer runs full, new records are dropped and counted.
+ */
+class Sender {
+public:
+	struct Stats {
+		/**
+		 * The number of records which were sent.
+		 */
+		uint64_t sent = 0;
+
+		/**
+		 * The number of records which were dropped because
+		 * the buffer was full or because the record was too
+		 * large.
+		 */
+		uint64_t dropped = 0;
+
+		/**
+		 * The number of records which were discarded because
+		 * sendmmsg() failed (e.g. ECONNREFUSED).
+		 */
+		uint64_t errors = 0;
+
+		/**
+		 * The number of records which were rejected by the
+		 * #Filter.
+		 */
+		uint64_t filtered = 0;
+	};
+
+private:
+	static constexpr size_t BUFFER_SIZE = 64 * 1024;
+	static constexpr unsigned MAX_RECORDS = 64;
+
+	/**
+	 * Minimum number of seconds between two #Filter summary
+	 * records.
+	 */
+	static constexpr double SUMMARY_INTERVAL = 10;
+
+	UniqueSocketDescriptor fd;
+
+	/**
+	 * Waits for the socket to become writable after sendmmsg()
+	 * returned EAGAIN.
+	 */
+	SocketEvent event;
+
+	DeferEvent defer_flush;
+
+	/**
+	 * The serialized records, back to back.
+	 */
+	const std::unique_ptr<uint8_t[]> buffer;
+
+	size_t fill = 0;
+
+	/**
+	 * The packets; they point into #buffer.
+	 */
+	std::array<struct iovec, MAX_RECORDS> records;
+
+	/**
+	 * The number of records in each packet.
+	 */
+	std::array<unsigned, MAX_RECORDS> record_counts;
+
+	unsigned n_records = 0;
+
+	/**
+	 * Used by Flush() to submit #records.
+	 */
+	MultiSendMessage send_batch;
+
+	/**
+	 * The maximum size of a multi-record packet; 0 means the
+	 * multi-record format is disabled.
+	 */
+	size_t max_packet_size = 0;
+
+	/**
+	 * Append a CRC32C checksum to each record?
+	 */
+	bool crc = false;
+
+	/**
+	 * Is the last packet in #records a multi-record packet
+	 * which may take more records?
+	 */
+	bool last_open = false;
+
+	Stats stats;
+
+	Filter *filter = nullptr;
+
+	/**
+	 * When was the last #Filter summary record sent?  Steady
+	 * clock in seconds.
+	 */
+	double last_summary = 0;
+
+public:
+	/**
+	 * @param _fd a connected datagram socket; it should be
+	 * non-blocking
+	 */
+	Sender(EventLoop &event_loop, UniqueSocketDescriptor &&_fd);
+
+	/**
+	 * Makes one last attempt to send pending records.
+	 */
+	~Sender() noexcept;
+
+	Sender(const Sender &) = delete;
+	Sender &operator=(const Sender &) = delete;
+
+	const Stats &GetStats() const noexcept {
+		return stats;
+	}
+
+	/**
+	 * Install a #Filter which is consulted before each record
+	 * is enqueued.  Every #SUMMARY_INTERVAL seconds (on the next
+	 * Log() call), a message reporting the records dropped by
+	 * the filter is sent.
+	 *
+	 * @param _filter the filter (owned by the caller) or nullptr
+	 */
+	void SetFilter(Filter *_filter) noexcept {
+		filter = _filter;
+	}
+
+	/**
+	 * Pack several records into one packet using the
+	 * multi-record format (#MULTI_MAGIC).  The receiver must
+	 * support this format.  Records which do not fit into one
+	 * packet of this size are sent in the single-record format.
+	 *
+	 * @param _max_packet_size the maximum payload size, e.g. the
+	 * path MTU minus the IP and UDP headers
+	 */
+	void EnableMultiRecord(size_t _max_packet_size=1400) noexcept {
+		max_packet_size = _max_packet_size;
+	}
+
+	/**
+	 * Append a CRC32C checksum (#Attribute::CRC32C) to each
+	 * record, which is verified by the receiver.
+	 */
+	void EnableCrc() noexcept {
+		crc = true;
+	}
+
+	/**
+	 * @return the number of packets waiting to be sent
+	 */
+	unsigned GetQueueLength() const noexcept {
+		return n_records;
+	}
+
+	/**
+	 * Enqueue a record.  It is sent in the next #EventLoop
+	 * iteration, or right away if the buffer is full.
+	 *
+	 * @return false if the record was dropped
+	 */
+	bool Log(const Datagram &d) noexcept;
+
+	/**
+	 * Send all pending records now (as far as the socket
+	 * allows).
+	 */
+	void Flush() noexcept;
+
+private:
+	/**
+	 * Serialize the record into a new packet in the free space
+	 * of #buffer.
+	 *
+	 * @param open set to true if this is a multi-record packet
+	 * which may take more records
+	 * @return the size, or 0 if there is not enough room
+	 */
+	size_t TrySerialize(const Datagram &d, bool &open) noexcept;
+
+	/**
+	 * Append the record to the last (open) packet.
+	 *
+	 * @return false if it does not fit
+	 */
+	bool TryAppend(const Datagram &d) noexcept;
+
+	bool Enqueue(const Datagram &d) noexcept;
+
+	/**
+	 * Send a #Filter summary record if one is due.
+	 */
+	void MaybeLogSummary(double now) noexcept;
+
+	/**
+	 * Returns the number of records in the first #n packets.
+	 */
+	gcc_pure
+	uint64_t CountRecords(unsigned n) const noexcept;
+
+	/**
+	 * Remove the first #n packets from the buffer.
+	 */
+	void Consume(unsigned n) noexcept;
+
+	void OnDeferredFlush() noexcept {
+		Flush();
+	}
+
+	void OnSocketReady(unsigned events) noexcept;
+};
+
+}}
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Manager.hxx"
+#include "util/PrintException.hxx"
+
+namespace Uring {
+
+Manager::Manager(EventLoop &event_loop, unsigned entries, unsigned flags)
+	:Queue(entries, flags),
+	 event(event_loop, GetFileDescriptor().Get(),
+	       SocketEvent::READ|SocketEvent::PERSIST,
+	       BIND_THIS_METHOD(OnSocketReady)),
+	 defer_submit(event_loop, BIND_THIS_METHOD(DeferredSubmit))
+{
+	event.Add();
+}
+
+Manager::~Manager() noexcept
+{
+	defer_submit.Cancel();
+	event.Delete();
+}
+
+void
+Manager::Push(struct io_uring_sqe &sqe, Operation &operation) noexcept
+{
+	Queue::Push(sqe, operation);
+	defer_submit.Schedule();
+}
+
+void
+Manager::OnSocketReady(unsigned) noexcept
+{
+	try {
+		DispatchCompletions();
+	} catch (...) {
+		PrintException(std::current_exception());
+	}
+}
+
+void
+Manager::DeferredSubmit() noexcept
+{
+	try {
+		Queue::Submit();
+	} catch (...) {
+		PrintException(std::current_exception());
+	}
+}
+
+} /* namespace Uring */
@@ -32,10 +32,14 @@
 
 #include "Date.hxx"
 #include "time/gmtime.h"
+#include "time/Calendar.hxx"
 #include "util/CharUtil.hxx"
 #include "util/DecimalFormat.h"
 
+#include <limits>
+
 #include <stdint.h>
+#include <string.h>
 
 static constexpr char wdays[8][5] = {
 	"Sun,",
@@ -81,14 +85,14 @@ month_name(int month)
 void
 http_date_format_r(char *buffer, std::chrono::system_clock::time_point t)
 {
-	static struct tm tm_buffer;
+	struct tm tm_buffer;
 	const struct tm *tm = sysx_time_gmtime(std::chrono::system_clock::to_time_t(t), &tm_buffer);
 
-	*(uint32_t *)(void *)buffer = *(const uint32_t *)(const void *)wday_name(tm->tm_wday);
+	memcpy(buffer, wday_name(tm->tm_wday), 4);
 	buffer[4] = ' ';
 	format_2digit(buffer + 5, tm->tm_mday);
 	buffer[7] = ' ';
-	*(uint32_t *)(void *)(buffer + 8) = *(const uint32_t *)(const void *)month_name(tm->tm_mon);
+	memcpy(buffer + 8, month_name(tm->tm_mon), 4);
 	format_4digit(buffer + 12, tm->tm_year + 1900);
 	buffer[16] = ' ';
 	format_2digit(buffer + 17, tm->tm_hour);
@@ -97,10 +101,10 @@ http_date_format_r(char *buffer, std::chrono::system_clock::time_point t)
 	buffer[22] = ':';
 	format_2digit(buffer + 23, tm->tm_sec);
 	buffer[25] = ' ';
-	*(uint32_t *)(void *)(buffer + 26) = *(const uint32_t *)(const void *)"GMT";
+	memcpy(buffer + 26, "GMT", 4);
 }
 
-static char buffer[30];
+static thread_local char buffer[30];
 
 const char *
 http_date_format(std::chrono::system_clock::time_point t)
@@ -109,6 +113,23 @@ http_date_format(std::chrono::system_clock::time_point t)
 	return buffer;
 }
 
+const char *
+http_date_format_cached(std::chrono::system_clock::time_point t)
+{
+	static thread_local struct {
+		time_t second = std::numeric_limits<time_t>::min();
+		char buffer[30];
+	} cache;
+
+	const time_t second = std::chrono::system_clock::to_time_t(t);
+	if (second != cache.second) {
+		http_date_format_r(cache.buffer, t);
+		cache.second = second;
+	}
+
+	return cache.buffer;
+}
+
 static int
 parse_2digit(const char *p)
 {
@@ -129,48 +150,151 @@ parse_4digit(const char *p)
 		+ (p[2] - '0') * 10 + (p[3] - '0');
 }
 
-#if GCC_CHECK_VERSION(4,6)
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wstrict-aliasing"
-#endif
+static constexpr uint32_t
+pack3(char a, char b, char c)
+{
+	return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) |
+		(uint32_t(uint8_t(c)) << 16);
+}
 
+/**
+ * Parse a three-letter month name.
+ *
+ * @return the month number (0-11) or -1 on error
+ */
 static int
 parse_month_name(const char *p)
 {
-	int i;
+	switch (pack3(p[0], p[1], p[2])) {
+	case pack3('J', 'a', 'n'): return 0;
+	case pack3('F', 'e', 'b'): return 1;
+	case pack3('M', 'a', 'r'): return 2;
+	case pack3('A', 'p', 'r'): return 3;
+	case pack3('M', 'a', 'y'): return 4;
+	case pack3('J', 'u', 'n'): return 5;
+	case pack3('J', 'u', 'l'): return 6;
+	case pack3('A', 'u', 'g'): return 7;
+	case pack3('S', 'e', 'p'): return 8;
+	case pack3('O', 'c', 't'): return 9;
+	case pack3('N', 'o', 'v'): return 10;
+	case pack3('D', 'e', 'c'): return 11;
+	default: return -1;
+	}
+}
+
+/**
+ * Parse "HH:MM:SS".
+ *
+ * @return the number of seconds since midnight or -1 on error
+ */
+static int
+parse_time_of_day(const char *p)
+{
+	if (p[2] != ':' || p[5] != ':')
+		return -1;
 
-	for (i = 0; i < 12; ++i)
-		if (*(const uint32_t *)(const void *)months[i] == *(const uint32_t *)(const void *)p)
-			return i;
+	const int hour = parse_2digit(p);
+	const int minute = parse_2digit(p + 3);
+	/* allow 60 for leap seconds */
+	const int second = parse_2digit(p + 6);
+	if (hour < 0 || hour > 23 || minute < 0 || minute > 59 ||
+	    second < 0 || second > 60)
+		return -1;
 
-	return -1;
+	return (hour * 60 + minute) * 60 + second;
 }
 
-#if GCC_CHECK_VERSION(4,6)
-#pragma GCC diagnostic pop
-#endif
+static std::chrono::system_clock::time_point
+make_time_point(int year, int month, int day, int time_of_day)
+{
+	if (month < 0 || year < 0 || time_of_day < 0 ||
+	    day < 1 || day > DaysInMonth(year, month))
+		return std::chrono::system_clock::from_time_t(-1);
 
-std::chrono::system_clock::time_point
-http_date_parse(const char *p)
+	const long days = DaysFromCivil(year, month, day);
+	return std::chrono::system_clock::from_time_t(time_t(days) * 86400
+						      + time_of_day);
+}
+
+/**
+ * Parse the IMF-fixdate format: "Sun, 06 Nov 1994 08:49:37 GMT"
+ */
+static std::chrono::system_clock::time_point
+parse_imf_fixdate(const char *p, size_t length)
 {
-	struct tm tm;
+	if (length < 29 || p[4] != ' ' || p[7] != ' ' || p[11] != ' ' ||
+	    p[16] != ' ' || memcmp(p + 25, " GMT", 4) != 0)
+		return std::chrono::system_clock::from_time_t(-1);
 
-	if (strlen(p) < 25)
+	return make_time_point(parse_4digit(p + 12),
+			       parse_month_name(p + 8),
+			       parse_2digit(p + 5),
+			       parse_time_of_day(p + 17));
+}
+
+/**
+ * Parse the obsolete RFC 850 format: "Sunday, 06-Nov-94 08:49:37 GMT"
+ *
+ * @param p the string after the comma following the day name
+ */
+static std::chrono::system_clock::time_point
+parse_rfc850(const char *p, size_t length)
+{
+	if (length < 23 || p[0] != ' ' || p[3] != '-' || p[7] != '-' ||
+	    p[10] != ' ' || memcmp(p + 19, " GMT", 4) != 0)
 		return std::chrono::system_clock::from_time_t(-1);
 
-	tm.tm_sec = parse_2digit(p + 23);
-	tm.tm_min = parse_2digit(p + 20);
-	tm.tm_hour = parse_2digit(p + 17);
-	tm.tm_mday = parse_2digit(p + 5);
-	tm.tm_mon = parse_month_name(p + 8);
-	tm.tm_year = parse_4digit(p + 12);
+	/* RFC 7231 7.1.1.1: interpret a two-digit year which appears
+	   to be more than 50 years in the future as the past; with a
+	   fixed pivot, that means 00-69 is 20xx */
+	int year = parse_2digit(p + 8);
+	if (year >= 0)
+		year += year < 70 ? 2000 : 1900;
+
+	return make_time_point(year,
+			       parse_month_name(p + 4),
+			       parse_2digit(p + 1),
+			       parse_time_of_day(p + 11));
+}
 
-	if (tm.tm_sec == -1 || tm.tm_min == -1 || tm.tm_hour == -1 ||
-	    tm.tm_mday == -1 || tm.tm_mon == -1 || tm.tm_year < 1900)
+/**
+ * Parse the ANSI C asctime() format: "Sun Nov  6 08:49:37 1994"
+ */
+static std::chrono::system_clock::time_point
+parse_asctime(const char *p, size_t length)
+{
+	if (length < 24 || p[7] != ' ' || p[10] != ' ' || p[19] != ' ')
 		return std::chrono::system_clock::from_time_t(-1);
 
-	tm.tm_year -= 1900;
-	tm.tm_isdst = -1;
+	const int day = p[8] == ' '
+		? (IsDigitASCII(p[9]) ? p[9] - '0' : -1)
+		: parse_2digit(p + 8);
+
+	return make_time_point(parse_4digit(p + 20),
+			       parse_month_name(p + 4),
+			       day,
+			       parse_time_of_day(p + 11));
+}
+
+std::chrono::system_clock::time_point
+http_date_parse(const char *p)
+{
+	const size_t length = strlen(p);
+	if (length < 24)
+		return std::chrono::system_clock::from_time_t(-1);
+
+	if (p[3] == ',')
+		return parse_imf_fixdate(p, length);
+
+	if (p[3] == ' ')
+		return parse_asctime(p, length);
+
+	/* RFC 850 has the full day name ("Wednesday" is the longest)
+	   followed by a comma */
+	const char *comma = (const char *)memchr(p + 6, ',', 4);
+	if (comma == nullptr)
+		return std::chrono::system_clock::from_time_t(-1);
 
-	return std::chrono::system_clock::from_time_t(timegm(&tm));
+	++comma;
+	return parse_rfc850(comma, length - (comma - p));
 }
@@ -41,13 +41,32 @@
 
 #include <chrono>
 
+/**
+ * Format a time stamp as HTTP date into the given buffer (which
+ * must be at least 30 bytes large).
+ */
 void
 http_date_format_r(char *buffer, std::chrono::system_clock::time_point t);
 
-gcc_const
+/**
+ * Like http_date_format_r(), but use a thread-local buffer which is
+ * overwritten by the next call in the same thread.
+ */
 const char *
 http_date_format(std::chrono::system_clock::time_point t);
 
+/**
+ * Like http_date_format(), but the string is only rebuilt if the
+ * time stamp falls into a different second than on the previous call
+ * in this thread.  Pass EventLoop::SystemNow() to generate "Date"
+ * response headers cheaply; each #EventLoop thread has its own cache.
+ *
+ * The returned pointer is valid until the next call in the same
+ * thread.
+ */
+const char *
+http_date_format_cached(std::chrono::system_clock::time_point t);
+
 gcc_pure
 std::chrono::system_clock::time_point
 http_date_parse(const char *p);
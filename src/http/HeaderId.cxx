@@ -0,0 +1,233 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "HeaderId.hxx"
+#include "util/StringView.hxx"
+#include "util/StringAPI.hxx"
+#include "util/CharUtil.hxx"
+
+#include <assert.h>
+#include <stddef.h>
+
+static constexpr size_t N_HEADERS = size_t(HttpHeaderId::COUNT);
+
+/**
+ * Indexed by #HttpHeaderId.
+ */
+static constexpr const char *header_names[N_HEADERS] = {
+	"",
+	"accept",
+	"accept-charset",
+	"accept-encoding",
+	"accept-language",
+	"accept-ranges",
+	"access-control-allow-origin",
+	"age",
+	"allow",
+	"authorization",
+	"cache-control",
+	"connection",
+	"content-disposition",
+	"content-encoding",
+	"content-language",
+	"content-length",
+	"content-location",
+	"content-md5",
+	"content-range",
+	"content-security-policy",
+	"content-type",
+	"cookie",
+	"cookie2",
+	"date",
+	"dav",
+	"depth",
+	"destination",
+	"etag",
+	"expect",
+	"expires",
+	"forwarded",
+	"from",
+	"host",
+	"if-match",
+	"if-modified-since",
+	"if-none-match",
+	"if-range",
+	"if-unmodified-since",
+	"keep-alive",
+	"last-modified",
+	"link",
+	"location",
+	"max-forwards",
+	"origin",
+	"overwrite",
+	"pragma",
+	"proxy-authenticate",
+	"proxy-authorization",
+	"range",
+	"referer",
+	"retry-after",
+	"sec-websocket-accept",
+	"sec-websocket-key",
+	"sec-websocket-protocol",
+	"sec-websocket-version",
+	"server",
+	"set-cookie",
+	"set-cookie2",
+	"strict-transport-security",
+	"te",
+	"trailer",
+	"trailers",
+	"transfer-encoding",
+	"upgrade",
+	"user-agent",
+	"vary",
+	"via",
+	"warning",
+	"www-authenticate",
+	"x-forwarded-for",
+};
+
+/* a seed which was found (by brute force) to map all names in
+   #header_names to different slots */
+static constexpr uint32_t HASH_SEED = 0x811ccec1;
+static constexpr size_t HASH_SLOTS = 256;
+
+/**
+ * Case-insensitive FNV-1a variant.  Setting bit 5 folds upper-case
+ * letters to lower-case; it creates false hits for some
+ * non-letters, but those are ruled out by the final string
+ * comparison.
+ */
+static constexpr size_t
+hash_header_name(const char *name, size_t length)
+{
+	uint32_t hash = HASH_SEED;
+	for (size_t i = 0; i < length; ++i)
+		hash = (hash ^ (uint8_t(name[i]) | 0x20)) * 0x01000193;
+	return hash >> 24;
+}
+
+static constexpr size_t
+constexpr_strlen(const char *s)
+{
+	size_t length = 0;
+	while (s[length] != 0)
+		++length;
+	return length;
+}
+
+struct HeaderHashTable {
+	/**
+	 * Maps a hash value to a #HttpHeaderId (or 0 for an empty slot).
+	 */
+	uint8_t slots[HASH_SLOTS];
+
+	/**
+	 * Indexed by #HttpHeaderId.
+	 */
+	uint8_t lengths[N_HEADERS];
+
+	/**
+	 * Set if two names map to the same slot.
+	 */
+	bool collision;
+};
+
+static constexpr HeaderHashTable
+build_header_hash_table()
+{
+	HeaderHashTable table{};
+
+	for (size_t i = 1; i < N_HEADERS; ++i) {
+		const size_t length = constexpr_strlen(header_names[i]);
+		uint8_t &slot = table.slots[hash_header_name(header_names[i],
+							     length)];
+		if (slot != 0)
+			table.collision = true;
+
+		slot = i;
+		table.lengths[i] = length;
+	}
+
+	return table;
+}
+
+static constexpr HeaderHashTable header_hash_table =
+	build_header_hash_table();
+
+static_assert(!header_hash_table.collision,
+	      "Header hash collision; HASH_SEED needs to be adjusted");
+
+HttpHeaderId
+http_header_lookup(StringView name)
+{
+	const size_t id = header_hash_table.slots[hash_header_name(name.data,
+								   name.size)];
+	if (header_hash_table.lengths[id] != name.size ||
+	    id == 0 ||
+	    !StringIsEqualIgnoreCase(name.data, header_names[id], name.size))
+		return HttpHeaderId::UNKNOWN;
+
+	return HttpHeaderId(id);
+}
+
+const char *
+http_header_name(HttpHeaderId id)
+{
+	assert(size_t(id) < N_HEADERS);
+
+	return header_names[size_t(id)];
+}
+
+bool
+http_header_is_hop_by_hop(HttpHeaderId id)
+{
+	switch (id) {
+	case HttpHeaderId::CONNECTION:
+	case HttpHeaderId::CONTENT_LENGTH:
+		/* RFC 2616 14.20 */
+	case HttpHeaderId::EXPECT:
+	case HttpHeaderId::KEEP_ALIVE:
+	case HttpHeaderId::PROXY_AUTHENTICATE:
+	case HttpHeaderId::PROXY_AUTHORIZATION:
+	case HttpHeaderId::TE:
+		/* typo in RFC 2616? */
+	case HttpHeaderId::TRAILER:
+	case HttpHeaderId::TRAILERS:
+	case HttpHeaderId::TRANSFER_ENCODING:
+	case HttpHeaderId::UPGRADE:
+		return true;
+
+	default:
+		return false;
+	}
+}
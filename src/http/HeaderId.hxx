@@ -0,0 +1,154 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "util/Compiler.h"
+
+#include <stdint.h>
+
+struct StringView;
+
+/**
+ * Numeric identifiers for well-known HTTP header names.  They are
+ * contiguous, so they can be used as array indices, e.g. to build a
+ * header map indexed by #HttpHeaderId instead of by string.
+ */
+enum class HttpHeaderId : uint8_t {
+	/**
+	 * Not a well-known header name.
+	 */
+	UNKNOWN = 0,
+
+	ACCEPT,
+	ACCEPT_CHARSET,
+	ACCEPT_ENCODING,
+	ACCEPT_LANGUAGE,
+	ACCEPT_RANGES,
+	ACCESS_CONTROL_ALLOW_ORIGIN,
+	AGE,
+	ALLOW,
+	AUTHORIZATION,
+	CACHE_CONTROL,
+	CONNECTION,
+	CONTENT_DISPOSITION,
+	CONTENT_ENCODING,
+	CONTENT_LANGUAGE,
+	CONTENT_LENGTH,
+	CONTENT_LOCATION,
+	CONTENT_MD5,
+	CONTENT_RANGE,
+	CONTENT_SECURITY_POLICY,
+	CONTENT_TYPE,
+	COOKIE,
+	COOKIE2,
+	DATE,
+	DAV,
+	DEPTH,
+	DESTINATION,
+	ETAG,
+	EXPECT,
+	EXPIRES,
+	FORWARDED,
+	FROM,
+	HOST,
+	IF_MATCH,
+	IF_MODIFIED_SINCE,
+	IF_NONE_MATCH,
+	IF_RANGE,
+	IF_UNMODIFIED_SINCE,
+	KEEP_ALIVE,
+	LAST_MODIFIED,
+	LINK,
+	LOCATION,
+	MAX_FORWARDS,
+	ORIGIN,
+	OVERWRITE,
+	PRAGMA,
+	PROXY_AUTHENTICATE,
+	PROXY_AUTHORIZATION,
+	RANGE,
+	REFERER,
+	RETRY_AFTER,
+	SEC_WEBSOCKET_ACCEPT,
+	SEC_WEBSOCKET_KEY,
+	SEC_WEBSOCKET_PROTOCOL,
+	SEC_WEBSOCKET_VERSION,
+	SERVER,
+	SET_COOKIE,
+	SET_COOKIE2,
+	STRICT_TRANSPORT_SECURITY,
+	TE,
+	TRAILER,
+	TRAILERS,
+	TRANSFER_ENCODING,
+	UPGRADE,
+	USER_AGENT,
+	VARY,
+	VIA,
+	WARNING,
+	WWW_AUTHENTICATE,
+	X_FORWARDED_FOR,
+
+	/**
+	 * The number of identifiers (including #UNKNOWN); not a valid
+	 * value.
+	 */
+	COUNT
+};
+
+/**
+ * Look up the identifier of a header name.  This is
+ * case-insensitive and costs one hash table probe plus one string
+ * comparison.
+ *
+ * @return the identifier or HttpHeaderId::UNKNOWN
+ */
+gcc_pure
+HttpHeaderId
+http_header_lookup(StringView name);
+
+/**
+ * Returns the lower-case name of a header identifier (or an empty
+ * string for HttpHeaderId::UNKNOWN).
+ */
+gcc_const
+const char *
+http_header_name(HttpHeaderId id);
+
+/**
+ * Like http_header_is_hop_by_hop(const char *), but check an
+ * identifier.
+ */
+gcc_const
+bool
+http_header_is_hop_by_hop(HttpHeaderId id);
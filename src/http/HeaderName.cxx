@@ -31,9 +31,10 @@
  */
 
 #include "HeaderName.hxx"
+#include "HeaderId.hxx"
+#include "util/StringView.hxx"
 
 #include <assert.h>
-#include <string.h>
 
 static inline bool
 http_header_name_char_valid(char ch)
@@ -57,32 +58,5 @@ http_header_is_hop_by_hop(const char *name)
 {
 	assert(name != nullptr);
 
-	switch (*name) {
-	case 'c':
-		return strcmp(name, "connection") == 0 ||
-			strcmp(name, "content-length") == 0;
-
-	case 'e':
-		/* RFC 2616 14.20 */
-		return strcmp(name, "expect") == 0;
-
-	case 'k':
-		return strcmp(name, "keep-alive") == 0;
-
-	case 'p':
-		return strcmp(name, "proxy-authenticate") == 0 ||
-			strcmp(name, "proxy-authorization") == 0;
-
-	case 't':
-		return strcmp(name, "te") == 0 ||
-			/* typo in RFC 2616? */
-			strcmp(name, "trailer") == 0 || strcmp(name, "trailers") == 0 ||
-			strcmp(name, "transfer-encoding") == 0;
-
-	case 'u':
-		return strcmp(name, "upgrade") == 0;
-
-	default:
-		return false;
-	}
+	return http_header_is_hop_by_hop(http_header_lookup(name));
 }
@@ -45,7 +45,8 @@ http_header_name_valid(const char *name);
 /**
  * Determines if the specified name is a hop-by-hop header.  In
  * addition to the list in RFC 2616 13.5.1, "Content-Length" is also a
- * hop-by-hop header according to this function.
+ * hop-by-hop header according to this function.  The comparison is
+ * case-insensitive.
  */
 gcc_pure
 bool
@@ -31,7 +31,9 @@
  */
 
 #include "List.hxx"
+#include "util/SimdString.hxx"
 #include "util/StringView.hxx"
+#include "util/CharUtil.hxx"
 
 static StringView
 http_trim(StringView s)
@@ -52,36 +54,76 @@ http_trim(StringView s)
 	return s;
 }
 
+/**
+ * Invoke the predicate for each comma-separated item of the list,
+ * until it returns true.  Commas inside quoted-strings are not
+ * delimiters.
+ *
+ * @return true if the predicate has returned true
+ */
+template<typename P>
 static bool
-http_equals(StringView a, StringView b)
+http_list_split(StringView list, P &&p)
 {
-	return http_trim(a).Equals(http_trim(b));
-}
+	const char *const end = list.end();
+	const char *start = list.begin(), *i = start;
 
-bool
-http_list_contains(const char *list, const char *_item)
-{
-	const StringView item(_item);
+	while (true) {
+		i = SimdFindEither(i, end, ',', '"');
+		if (i == end)
+			return p(StringView(start, end));
 
-	while (*list != 0) {
-		/* XXX what if the comma is within an quoted-string? */
-		const char *comma = strchr(list, ',');
-		if (comma == nullptr)
-			return http_equals(list, item);
+		if (*i == '"') {
+			/* skip the quoted-string */
+			for (++i; i < end && *i != '"'; ++i)
+				if (*i == '\\' && i + 1 < end)
+					++i;
 
-		if (http_equals({list, comma}, item))
+			if (i < end)
+				++i;
+			continue;
+		}
+
+		if (p(StringView(start, i)))
 			return true;
 
-		list = comma + 1;
+		start = ++i;
 	}
+}
 
-	return false;
+/**
+ * Invoke the predicate for each comma-separated item of the list.
+ * A trailing empty item (after the last comma) is skipped.
+ */
+template<typename P>
+static bool
+http_list_any(const char *_list, P &&p)
+{
+	const StringView list(_list);
+	if (list.empty())
+		return false;
+
+	return http_list_split(list, [&list, &p](StringView i){
+			return (i.end() < list.end() || !i.empty()) &&
+				p(i);
+		});
+}
+
+bool
+http_list_contains(const char *list, const char *_item)
+{
+	const StringView item = http_trim(_item);
+
+	return http_list_any(list, [item](StringView i){
+			return http_trim(i).Equals(item);
+		});
 }
 
 static bool
 http_equals_i(StringView a, StringView b)
 {
-	return http_trim(a).EqualsIgnoreCase(b);
+	return a.size == b.size &&
+		SimdEqualsIgnoreCaseASCII(a.data, b.data, b.size);
 }
 
 bool
@@ -89,17 +131,137 @@ http_list_contains_i(const char *list, const char *_item)
 {
 	const StringView item(_item);
 
-	while (*list != 0) {
-		/* XXX what if the comma is within an quoted-string? */
-		const char *comma = strchr(list, ',');
-		if (comma == nullptr)
-			return http_equals_i(list, item);
+	return http_list_any(list, [item](StringView i){
+			return http_equals_i(http_trim(i), item);
+		});
+}
 
-		if (http_equals_i({list, comma}, item))
+static StringView
+http_strip(StringView s)
+{
+	const char *begin = SimdSkipWhitespace(s.begin(), s.end());
+	return {begin, SimdSkipWhitespaceReverse(begin, s.end())};
+}
+
+HttpListTokens::HttpListTokens(StringView _list)
+	:list(_list)
+{
+	http_list_split(list, [this](StringView i){
+			i = http_strip(i);
+			if (i.empty())
+				return false;
+
+			if (!tokens.checked_append(i)) {
+				overflow = true;
+				return true;
+			}
+
+			return false;
+		});
+}
+
+template<typename P>
+bool
+HttpListTokens::Any(P &&p) const
+{
+	if (overflow)
+		return http_list_split(list, [&p](StringView i){
+				i = http_strip(i);
+				return !i.empty() && p(i);
+			});
+
+	for (const StringView i : tokens)
+		if (p(i))
 			return true;
 
-		list = comma + 1;
+	return false;
+}
+
+bool
+HttpListTokens::Contains(StringView _item) const
+{
+	const StringView item = http_trim(_item);
+
+	return Any([item](StringView i){
+			return http_trim(i).Equals(item);
+		});
+}
+
+bool
+HttpListTokens::ContainsIgnoreCase(StringView _item) const
+{
+	const StringView item = http_trim(_item);
+
+	return Any([item](StringView i){
+			return http_equals_i(http_trim(i), item);
+		});
+}
+
+/**
+ * Parse a qvalue (RFC 7231 5.3.1).
+ *
+ * @return the value multiplied by 1000 or -1 on error
+ */
+static int
+http_parse_qvalue(StringView s)
+{
+	if (s.empty() || (s.front() != '0' && s.front() != '1'))
+		return -1;
+
+	int value = (s.front() - '0') * 1000;
+	s.pop_front();
+
+	if (s.empty())
+		return value;
+
+	if (s.front() != '.' || s.size > 4)
+		return -1;
+
+	s.pop_front();
+
+	int factor = 100;
+	for (char ch : s) {
+		if (!IsDigitASCII(ch))
+			return -1;
+
+		value += (ch - '0') * factor;
+		factor /= 10;
 	}
 
-	return false;
+	return value <= 1000 ? value : -1;
+}
+
+int
+HttpListTokens::GetQuality(StringView name) const
+{
+	int quality = -1;
+
+	Any([name, &quality](StringView i){
+			const char *semicolon = i.Find(';');
+			if (!http_equals_i(http_strip({i.begin(),
+							semicolon != nullptr ? semicolon : i.end()}),
+					   name))
+				return false;
+
+			quality = 1000;
+
+			while (semicolon != nullptr) {
+				StringView parameter(semicolon + 1, i.end());
+				semicolon = parameter.Find(';');
+				if (semicolon != nullptr)
+					parameter = {parameter.begin(), semicolon};
+
+				const char *equals = parameter.Find('=');
+				if (equals == nullptr)
+					continue;
+
+				const StringView key = http_strip({parameter.begin(), equals});
+				if (key.size == 1 && (key.front() == 'q' || key.front() == 'Q'))
+					quality = http_parse_qvalue(http_strip({equals + 1, parameter.end()}));
+			}
+
+			return true;
+		});
+
+	return quality;
 }
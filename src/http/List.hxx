@@ -34,6 +34,8 @@
 #define HTTP_LIST_HXX
 
 #include "util/Compiler.h"
+#include "util/StaticArray.hxx"
+#include "util/StringView.hxx"
 
 gcc_pure
 bool
@@ -46,4 +48,58 @@ gcc_pure
 bool
 http_list_contains_i(const char *list, const char *item);
 
+/**
+ * A list header value (RFC 7230 7) split into its items once, for
+ * code which needs to query several items of the same header.  Items
+ * are stored without surrounding whitespace; empty items are
+ * omitted.  Commas inside quoted-strings do not split.
+ *
+ * The object refers to the header value, which must stay valid.
+ */
+class HttpListTokens {
+	static constexpr size_t MAX_TOKENS = 32;
+
+	StringView list;
+
+	StaticArray<StringView, MAX_TOKENS> tokens;
+
+	/**
+	 * Set if the list has more than #MAX_TOKENS items; queries
+	 * then scan the whole #list again.
+	 */
+	bool overflow = false;
+
+public:
+	explicit HttpListTokens(StringView _list);
+
+	/**
+	 * Does the list contain the given item?  Quotes around items
+	 * are ignored.
+	 */
+	gcc_pure
+	bool Contains(StringView item) const;
+
+	/**
+	 * Case-insensitive version of Contains().
+	 */
+	gcc_pure
+	bool ContainsIgnoreCase(StringView item) const;
+
+	/**
+	 * Look up the quality value (RFC 7231 5.3.1) of an item
+	 * with optional parameters, e.g. "gzip;q=0.5" in
+	 * "Accept-Encoding".  Item names are case-insensitive.
+	 *
+	 * @return the quality value multiplied by 1000 (an item
+	 * without "q" parameter has 1000), or -1 if the item is not
+	 * in the list (or its quality value is malformed)
+	 */
+	gcc_pure
+	int GetQuality(StringView name) const;
+
+private:
+	template<typename P>
+	bool Any(P &&p) const;
+};
+
 #endif
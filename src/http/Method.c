@@ -32,6 +32,8 @@
 
 #include "Method.h"
 
+#include <string.h>
+
 const char *const http_method_to_string_data[HTTP_METHOD_INVALID] = {
 	[HTTP_METHOD_HEAD] = "HEAD",
 	[HTTP_METHOD_GET] = "GET",
@@ -53,3 +55,87 @@ const char *const http_method_to_string_data[HTTP_METHOD_INVALID] = {
 	/* RFC 5789 */
 	[HTTP_METHOD_PATCH] = "PATCH",
 };
+
+static http_method_t
+check_method(const char *name, size_t length, http_method_t method)
+{
+	return memcmp(name, http_method_to_string_data[method], length) == 0
+		? method
+		: HTTP_METHOD_NULL;
+}
+
+http_method_t
+http_method_parse(const char *name, size_t length)
+{
+	/* dispatch on length and first character, which leaves at
+	   most one candidate for a memcmp() */
+
+	switch (length) {
+	case 3:
+		switch (name[0]) {
+		case 'G':
+			return check_method(name, length, HTTP_METHOD_GET);
+
+		case 'P':
+			return check_method(name, length, HTTP_METHOD_PUT);
+		}
+
+		break;
+
+	case 4:
+		switch (name[0]) {
+		case 'H':
+			return check_method(name, length, HTTP_METHOD_HEAD);
+
+		case 'P':
+			return check_method(name, length, HTTP_METHOD_POST);
+
+		case 'C':
+			return check_method(name, length, HTTP_METHOD_COPY);
+
+		case 'M':
+			return check_method(name, length, HTTP_METHOD_MOVE);
+
+		case 'L':
+			return check_method(name, length, HTTP_METHOD_LOCK);
+		}
+
+		break;
+
+	case 5:
+		switch (name[0]) {
+		case 'T':
+			return check_method(name, length, HTTP_METHOD_TRACE);
+
+		case 'M':
+			return check_method(name, length, HTTP_METHOD_MKCOL);
+
+		case 'P':
+			return check_method(name, length, HTTP_METHOD_PATCH);
+		}
+
+		break;
+
+	case 6:
+		switch (name[0]) {
+		case 'D':
+			return check_method(name, length, HTTP_METHOD_DELETE);
+
+		case 'U':
+			return check_method(name, length, HTTP_METHOD_UNLOCK);
+		}
+
+		break;
+
+	case 7:
+		return check_method(name, length, HTTP_METHOD_OPTIONS);
+
+	case 8:
+		return check_method(name, length, HTTP_METHOD_PROPFIND);
+
+	case 9:
+		return check_method(name, length, HTTP_METHOD_PROPPATCH);
+	}
+
+	return HTTP_METHOD_NULL;
+}
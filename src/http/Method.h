@@ -32,6 +32,7 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdbool.h>
 #include <assert.h>
 
@@ -62,6 +63,22 @@ typedef enum {
 
 extern const char *const http_method_to_string_data[HTTP_METHOD_INVALID];
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Parse a method name (case-sensitive, RFC 7230 3.1.1).
+ *
+ * @return the method or #HTTP_METHOD_NULL if the name is not known
+ */
+http_method_t
+http_method_parse(const char *name, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
 static inline bool
 http_method_is_valid(http_method_t method)
 {
@@ -31,10 +31,95 @@
  */
 
 #include "Range.hxx"
+#include "util/CharUtil.hxx"
+
+#include <algorithm>
 
 #include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
 #include <string.h>
-#include <stdlib.h>
+
+static const char *
+SkipOWS(const char *p)
+{
+	while (*p == ' ' || *p == '\t')
+		++p;
+	return p;
+}
+
+/**
+ * Parse a non-empty sequence of decimal digits.
+ *
+ * @return false on syntax error or overflow
+ */
+static bool
+ParseDecimal(const char *&p, uint64_t &value_r)
+{
+	if (!IsDigitASCII(*p))
+		return false;
+
+	uint64_t value = 0;
+	do {
+		const unsigned digit = *p++ - '0';
+		if (value > (UINT64_MAX - digit) / 10)
+			return false;
+		value = value * 10 + digit;
+	} while (IsDigitASCII(*p));
+
+	value_r = value;
+	return true;
+}
+
+enum class RangeSpecResult {
+	SYNTAX_ERROR,
+	UNSATISFIABLE,
+	OK,
+};
+
+/**
+ * Parse one byte-range-spec or suffix-byte-range-spec (RFC 7233
+ * 2.1).
+ */
+static RangeSpecResult
+ParseRangeSpec(const char *&p, uint64_t total_size, HttpByteRange &range)
+{
+	if (*p == '-') {
+		/* suffix-byte-range-spec */
+		++p;
+
+		uint64_t length;
+		if (!ParseDecimal(p, length))
+			return RangeSpecResult::SYNTAX_ERROR;
+
+		if (length == 0 || total_size == 0)
+			return RangeSpecResult::UNSATISFIABLE;
+
+		range.start = length < total_size ? total_size - length : 0;
+		range.end = total_size;
+		return RangeSpecResult::OK;
+	}
+
+	uint64_t first, last;
+	if (!ParseDecimal(p, first) || *p != '-')
+		return RangeSpecResult::SYNTAX_ERROR;
+
+	++p;
+
+	if (IsDigitASCII(*p)) {
+		if (!ParseDecimal(p, last) || last < first)
+			return RangeSpecResult::SYNTAX_ERROR;
+	} else
+		/* open-ended, e.g. "wget -c" */
+		last = UINT64_MAX;
+
+	if (first >= total_size)
+		return RangeSpecResult::UNSATISFIABLE;
+
+	range.start = first;
+	range.end = last < total_size ? last + 1 : total_size;
+	return RangeSpecResult::OK;
+}
 
 void
 HttpRangeRequest::ParseRangeHeader(const char *p)
@@ -42,6 +127,7 @@ HttpRangeRequest::ParseRangeHeader(const char *p)
 	assert(p != nullptr);
 	assert(type == Type::NONE);
 	assert(skip == 0);
+	assert(ranges.empty());
 
 	if (strncmp(p, "bytes=", 6) != 0) {
 		type = Type::INVALID;
@@ -50,41 +136,130 @@ HttpRangeRequest::ParseRangeHeader(const char *p)
 
 	p += 6;
 
-	char *endptr;
+	uint64_t span_start = UINT64_MAX, span_end = 0;
+	bool overflow = false;
 
-	if (*p == '-') {
-		/* suffix-byte-range-spec */
-		++p;
+	while (true) {
+		p = SkipOWS(p);
+		if (*p == ',') {
+			/* empty list elements are allowed (RFC 7230 7) */
+			++p;
+			continue;
+		}
+
+		if (*p == 0)
+			break;
 
-		uint64_t v = strtoull(p, &endptr, 10);
-		if (v >= size)
+		HttpByteRange range;
+		switch (ParseRangeSpec(p, total_size, range)) {
+		case RangeSpecResult::SYNTAX_ERROR:
+			type = Type::INVALID;
+			ranges.clear();
 			return;
 
-		skip = size - v;
-	} else {
-		skip = strtoull(p, &endptr, 10);
-		if (skip >= size) {
+		case RangeSpecResult::UNSATISFIABLE:
+			break;
+
+		case RangeSpecResult::OK:
+			span_start = std::min(span_start, range.start);
+			span_end = std::max(span_end, range.end);
+
+			if (!ranges.checked_append(range))
+				overflow = true;
+			break;
+		}
+
+		p = SkipOWS(p);
+		if (*p == ',')
+			++p;
+		else if (*p != 0) {
 			type = Type::INVALID;
+			ranges.clear();
 			return;
 		}
+	}
+
+	if (span_start >= span_end) {
+		/* no satisfiable range (or an empty list) */
+		type = Type::INVALID;
+		return;
+	}
+
+	if (overflow) {
+		ranges.clear();
+		ranges.append({span_start, span_end});
+	} else {
+		std::sort(ranges.begin(), ranges.end(),
+			  [](const HttpByteRange &a, const HttpByteRange &b){
+				  return a.start < b.start;
+			  });
 
-		if (*endptr == '-') {
-			p = endptr + 1;
-			if (*p == 0) {
-				/* "wget -c" */
-				type = Type::VALID;
-				return;
-			}
-
-			uint64_t v = strtoull(p, &endptr, 10);
-			if (*endptr != 0 || v < skip || v >= size) {
-				type = Type::INVALID;
-				return;
-			}
-
-			size = v + 1;
+		/* coalesce ranges which overlap or which are close */
+		size_t n = 1;
+		for (size_t i = 1; i < ranges.size(); ++i) {
+			auto &previous = ranges[n - 1];
+			const auto &current = ranges[i];
+			if (current.start <= previous.end + COALESCE_GAP)
+				previous.end = std::max(previous.end,
+							current.end);
+			else
+				ranges[n++] = current;
 		}
+
+		ranges.shrink(n);
 	}
 
+	skip = span_start;
+	size = span_end;
 	type = Type::VALID;
 }
+
+HttpMultipartRanges::HttpMultipartRanges(const HttpRangeRequest &request,
+					 const char *boundary,
+					 const char *content_type)
+{
+	assert(request.type == HttpRangeRequest::Type::VALID);
+	assert(boundary != nullptr);
+
+	for (const auto &range : request.ranges) {
+		const size_t header_start = buffer.size();
+
+		/* the CRLF preceding the delimiter belongs to the
+		   delimiter (RFC 2046 5.1.1) and is omitted before the
+		   first one */
+		if (header_start > 0)
+			buffer += "\r\n";
+
+		buffer += "--";
+		buffer += boundary;
+		buffer += "\r\n";
+
+		if (content_type != nullptr) {
+			buffer += "Content-Type: ";
+			buffer += content_type;
+			buffer += "\r\n";
+		}
+
+		char content_range[80];
+		snprintf(content_range, sizeof(content_range),
+			 "Content-Range: bytes %" PRIu64 "-%" PRIu64 "/%" PRIu64 "\r\n\r\n",
+			 range.start, range.end - 1, request.total_size);
+		buffer += content_range;
+
+		parts.append({header_start, buffer.size(), range});
+	}
+
+	trailer_start = buffer.size();
+	buffer += "\r\n--";
+	buffer += boundary;
+	buffer += "--\r\n";
+}
+
+uint64_t
+HttpMultipartRanges::GetContentLength() const
+{
+	uint64_t length = buffer.size();
+	for (const auto &part : parts)
+		length += part.range.GetSize();
+	return length;
+}
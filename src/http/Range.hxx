@@ -34,19 +34,78 @@
 #define HTTP_RANGE_HXX
 
 #include "util/Compiler.h"
+#include "util/StaticArray.hxx"
+#include "util/StringView.hxx"
 
-#include <chrono>
+#include <string>
+
+#include <stdint.h>
+
+struct HttpByteRange {
+	/**
+	 * The first byte of the range.
+	 */
+	uint64_t start;
+
+	/**
+	 * One past the last byte of the range.
+	 */
+	uint64_t end;
+
+	constexpr uint64_t GetSize() const {
+		return end - start;
+	}
+};
 
 struct HttpRangeRequest {
+	/**
+	 * The maximum number of ranges which are served as separate
+	 * parts.  If a request contains more (after coalescing), the
+	 * response is a single range spanning all of them.  This
+	 * defuses "Range" headers with thousands of small overlapping
+	 * ranges which are meant to exhaust the server.
+	 */
+	static constexpr size_t MAX_RANGES = 16;
+
+	/**
+	 * Ranges separated by a gap of at most this many bytes are
+	 * merged; that is roughly the overhead of a multipart header.
+	 */
+	static constexpr uint64_t COALESCE_GAP = 80;
+
 	enum class Type {
 		NONE,
 		VALID,
 		INVALID,
 	} type = Type::NONE;
 
+	/**
+	 * The span of all ranges (i.e. the start of the first range
+	 * and the end of the last one).  For a single range, this is
+	 * the range itself.
+	 */
 	uint64_t skip = 0, size;
 
-	explicit HttpRangeRequest(uint64_t _size):size(_size) {}
+	/**
+	 * The size of the whole resource.
+	 */
+	uint64_t total_size;
+
+	/**
+	 * The individual ranges, sorted and without overlaps.  Only
+	 * valid if #type is #Type::VALID.
+	 */
+	StaticArray<HttpByteRange, MAX_RANGES> ranges;
+
+	explicit HttpRangeRequest(uint64_t _size)
+		:size(_size), total_size(_size) {}
+
+	/**
+	 * Does the response need multipart/byteranges (RFC 7233 4.1)?
+	 */
+	bool IsMultiRange() const {
+		return type == Type::VALID && ranges.size() > 1;
+	}
 
 	/**
 	 * Parse a "Range" request header.
@@ -54,4 +113,66 @@ struct HttpRangeRequest {
 	void ParseRangeHeader(const char *p);
 };
 
+/**
+ * Generates the framing of a multipart/byteranges response body (RFC
+ * 7233 4.1).  All part headers are formatted into one buffer; the
+ * caller sends each part's header followed by its byte range (e.g.
+ * with writev() and sendfile()), and finally the trailer.
+ */
+class HttpMultipartRanges {
+	std::string buffer;
+
+	struct Part {
+		size_t header_start, header_end;
+		HttpByteRange range;
+	};
+
+	StaticArray<Part, HttpRangeRequest::MAX_RANGES> parts;
+
+	size_t trailer_start;
+
+public:
+	/**
+	 * @param boundary the multipart boundary (without the leading
+	 * dashes); it must also be passed in the Content-Type response
+	 * header
+	 * @param content_type the Content-Type of the resource or
+	 * nullptr
+	 */
+	HttpMultipartRanges(const HttpRangeRequest &request,
+			    const char *boundary, const char *content_type);
+
+	size_t GetPartCount() const {
+		return parts.size();
+	}
+
+	/**
+	 * The delimiter and headers preceding the given part.
+	 */
+	StringView GetPartHeader(size_t i) const {
+		const auto &part = parts[i];
+		return {buffer.data() + part.header_start,
+			part.header_end - part.header_start};
+	}
+
+	const HttpByteRange &GetPartRange(size_t i) const {
+		return parts[i].range;
+	}
+
+	/**
+	 * The closing delimiter.
+	 */
+	StringView GetTrailer() const {
+		return {buffer.data() + trailer_start,
+			buffer.size() - trailer_start};
+	}
+
+	/**
+	 * The total length of the response body (for the
+	 * Content-Length header).
+	 */
+	gcc_pure
+	uint64_t GetContentLength() const;
+};
+
 #endif
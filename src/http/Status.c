@@ -32,67 +32,76 @@
 
 #include "Status.h"
 
+/**
+ * All status codes with their reason phrases; the argument is a
+ * macro taking the #http_status_t and the status string.
+ */
+#define HTTP_STATUS_LIST(X) \
+	X(HTTP_STATUS_CONTINUE, "100 Continue") \
+	X(HTTP_STATUS_SWITCHING_PROTOCOLS, "101 Switching Protocols") \
+	X(HTTP_STATUS_OK, "200 OK") \
+	X(HTTP_STATUS_CREATED, "201 Created") \
+	X(HTTP_STATUS_ACCEPTED, "202 Accepted") \
+	X(HTTP_STATUS_NON_AUTHORITATIVE_INFORMATION, "203 Non-Authoritative Information") \
+	X(HTTP_STATUS_NO_CONTENT, "204 No Content") \
+	X(HTTP_STATUS_RESET_CONTENT, "205 Reset Content") \
+	X(HTTP_STATUS_PARTIAL_CONTENT, "206 Partial Content") \
+	X(HTTP_STATUS_MULTI_STATUS, "207 Multi-Status") \
+	X(HTTP_STATUS_MULTIPLE_CHOICES, "300 Multiple Choices") \
+	X(HTTP_STATUS_MOVED_PERMANENTLY, "301 Moved Permanently") \
+	X(HTTP_STATUS_FOUND, "302 Found") \
+	X(HTTP_STATUS_SEE_OTHER, "303 See Other") \
+	X(HTTP_STATUS_NOT_MODIFIED, "304 Not Modified") \
+	X(HTTP_STATUS_USE_PROXY, "305 Use Proxy") \
+	X(HTTP_STATUS_TEMPORARY_REDIRECT, "307 Temporary Redirect") \
+	X(HTTP_STATUS_BAD_REQUEST, "400 Bad Request") \
+	X(HTTP_STATUS_UNAUTHORIZED, "401 Unauthorized") \
+	X(HTTP_STATUS_PAYMENT_REQUIRED, "402 Payment Required") \
+	X(HTTP_STATUS_FORBIDDEN, "403 Forbidden") \
+	X(HTTP_STATUS_NOT_FOUND, "404 Not Found") \
+	X(HTTP_STATUS_METHOD_NOT_ALLOWED, "405 Method Not Allowed") \
+	X(HTTP_STATUS_NOT_ACCEPTABLE, "406 Not Acceptable") \
+	X(HTTP_STATUS_PROXY_AUTHENTICATION_REQUIRED, "407 Proxy Authentication Required") \
+	X(HTTP_STATUS_REQUEST_TIMEOUT, "408 Request Timeout") \
+	X(HTTP_STATUS_CONFLICT, "409 Conflict") \
+	X(HTTP_STATUS_GONE, "410 Gone") \
+	X(HTTP_STATUS_LENGTH_REQUIRED, "411 Length Required") \
+	X(HTTP_STATUS_PRECONDITION_FAILED, "412 Precondition Failed") \
+	X(HTTP_STATUS_REQUEST_ENTITY_TOO_LARGE, "413 Request Entity Too Large") \
+	X(HTTP_STATUS_REQUEST_URI_TOO_LONG, "414 Request-URI Too Long") \
+	X(HTTP_STATUS_UNSUPPORTED_MEDIA_TYPE, "415 Unsupported Media Type") \
+	X(HTTP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE, "416 Requested Range Not Satisfiable") \
+	X(HTTP_STATUS_EXPECTATION_FAILED, "417 Expectation failed") \
+	X(HTTP_STATUS_I_M_A_TEAPOT, "418 I'm a teapot") \
+	X(HTTP_STATUS_UNPROCESSABLE_ENTITY, "422 Unprocessable Entity") \
+	X(HTTP_STATUS_LOCKED, "423 Locked") \
+	X(HTTP_STATUS_FAILED_DEPENDENCY, "424 Failed Dependency") \
+	X(HTTP_STATUS_UPGRADE_REQUIRED, "426 Upgrade Required") \
+	X(HTTP_STATUS_PRECONDITION_REQUIRED, "428 Precondition Required") \
+	X(HTTP_STATUS_TOO_MANY_REQUESTS, "429 Too Many Requests") \
+	X(HTTP_STATUS_REQUEST_HEADER_FIELDS_TOO_LARGE, "431 Request Header Fields Too Large") \
+	X(HTTP_STATUS_UNAVAILABLE_FOR_LEGAL_REASONS, "451 Unavailable for Legal Reasons") \
+	X(HTTP_STATUS_INTERNAL_SERVER_ERROR, "500 Internal Server Error") \
+	X(HTTP_STATUS_NOT_IMPLEMENTED, "501 Not Implemented") \
+	X(HTTP_STATUS_BAD_GATEWAY, "502 Bad Gateway") \
+	X(HTTP_STATUS_SERVICE_UNAVAILABLE, "503 Service Unavailable") \
+	X(HTTP_STATUS_GATEWAY_TIMEOUT, "504 Gateway Timeout") \
+	X(HTTP_STATUS_HTTP_VERSION_NOT_SUPPORTED, "505 HTTP Version Not Supported") \
+	X(HTTP_STATUS_INSUFFICIENT_STORAGE, "507 Insufficient Storage") \
+	X(HTTP_STATUS_NETWORK_AUTHENTICATION_REQUIRED, "511 Network Authentication Required")
+
 const char *const http_status_to_string_data[6][60] = {
-	[1] = {
-		[HTTP_STATUS_CONTINUE - 100] = "100 Continue",
-		[HTTP_STATUS_SWITCHING_PROTOCOLS - 100] = "101 Switching Protocols",
-	},
-	[2] = {
-		[HTTP_STATUS_OK - 200] = "200 OK",
-		[HTTP_STATUS_CREATED - 200] = "201 Created",
-		[HTTP_STATUS_ACCEPTED - 200] = "202 Accepted",
-		[HTTP_STATUS_NON_AUTHORITATIVE_INFORMATION - 200] = "203 Non-Authoritative Information",
-		[HTTP_STATUS_NO_CONTENT - 200] = "204 No Content",
-		[HTTP_STATUS_RESET_CONTENT - 200] = "205 Reset Content",
-		[HTTP_STATUS_PARTIAL_CONTENT - 200] = "206 Partial Content",
-		[HTTP_STATUS_MULTI_STATUS - 200] = "207 Multi-Status",
-	},
-	[3] = {
-		[HTTP_STATUS_MULTIPLE_CHOICES - 300] = "300 Multiple Choices",
-		[HTTP_STATUS_MOVED_PERMANENTLY - 300] = "301 Moved Permanently",
-		[HTTP_STATUS_FOUND - 300] = "302 Found",
-		[HTTP_STATUS_SEE_OTHER - 300] = "303 See Other",
-		[HTTP_STATUS_NOT_MODIFIED - 300] = "304 Not Modified",
-		[HTTP_STATUS_USE_PROXY - 300] = "305 Use Proxy",
-		[HTTP_STATUS_TEMPORARY_REDIRECT - 300] = "307 Temporary Redirect",
-	},
-	[4] = {
-		[HTTP_STATUS_BAD_REQUEST - 400] = "400 Bad Request",
-		[HTTP_STATUS_UNAUTHORIZED - 400] = "401 Unauthorized",
-		[HTTP_STATUS_PAYMENT_REQUIRED - 400] = "402 Payment Required",
-		[HTTP_STATUS_FORBIDDEN - 400] = "403 Forbidden",
-		[HTTP_STATUS_NOT_FOUND - 400] = "404 Not Found",
-		[HTTP_STATUS_METHOD_NOT_ALLOWED - 400] = "405 Method Not Allowed",
-		[HTTP_STATUS_NOT_ACCEPTABLE - 400] = "406 Not Acceptable",
-		[HTTP_STATUS_PROXY_AUTHENTICATION_REQUIRED - 400] = "407 Proxy Authentication Required",
-		[HTTP_STATUS_REQUEST_TIMEOUT - 400] = "408 Request Timeout",
-		[HTTP_STATUS_CONFLICT - 400] = "409 Conflict",
-		[HTTP_STATUS_GONE - 400] = "410 Gone",
-		[HTTP_STATUS_LENGTH_REQUIRED - 400] = "411 Length Required",
-		[HTTP_STATUS_PRECONDITION_FAILED - 400] = "412 Precondition Failed",
-		[HTTP_STATUS_REQUEST_ENTITY_TOO_LARGE - 400] = "413 Request Entity Too Large",
-		[HTTP_STATUS_REQUEST_URI_TOO_LONG - 400] = "414 Request-URI Too Long",
-		[HTTP_STATUS_UNSUPPORTED_MEDIA_TYPE - 400] = "415 Unsupported Media Type",
-		[HTTP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE - 400] = "416 Requested Range Not Satisfiable",
-		[HTTP_STATUS_EXPECTATION_FAILED - 400] = "417 Expectation failed",
-		[HTTP_STATUS_I_M_A_TEAPOT - 400] = "418 I'm a teapot",
-		[HTTP_STATUS_UNPROCESSABLE_ENTITY - 400] = "422 Unprocessable Entity",
-		[HTTP_STATUS_LOCKED - 400] = "423 Locked",
-		[HTTP_STATUS_FAILED_DEPENDENCY - 400] = "424 Failed Dependency",
-		[HTTP_STATUS_UPGRADE_REQUIRED - 400] = "426 Upgrade Required",
-		[HTTP_STATUS_PRECONDITION_REQUIRED - 400] = "428 Precondition Required",
-		[HTTP_STATUS_TOO_MANY_REQUESTS - 400] = "429 Too Many Requests",
-		[HTTP_STATUS_REQUEST_HEADER_FIELDS_TOO_LARGE - 400] = "431 Request Header Fields Too Large",
-		[HTTP_STATUS_UNAVAILABLE_FOR_LEGAL_REASONS - 400] = "451 Unavailable for Legal Reasons",
-	},
-	[5] = {
-		[HTTP_STATUS_INTERNAL_SERVER_ERROR - 500] = "500 Internal Server Error",
-		[HTTP_STATUS_NOT_IMPLEMENTED - 500] = "501 Not Implemented",
-		[HTTP_STATUS_BAD_GATEWAY - 500] = "502 Bad Gateway",
-		[HTTP_STATUS_SERVICE_UNAVAILABLE - 500] = "503 Service Unavailable",
-		[HTTP_STATUS_GATEWAY_TIMEOUT - 500] = "504 Gateway Timeout",
-		[HTTP_STATUS_HTTP_VERSION_NOT_SUPPORTED - 500] = "505 HTTP Version Not Supported",
-		[HTTP_STATUS_INSUFFICIENT_STORAGE - 500] = "507 Insufficient Storage",
-		[HTTP_STATUS_NETWORK_AUTHENTICATION_REQUIRED - 500] = "511 Network Authentication Required",
+#define X(status, string) [status / 100][status % 100] = string,
+	HTTP_STATUS_LIST(X)
+#undef X
+};
+
+#define STATUS_LINE(string) "HTTP/1.1 " string "\r\n"
+
+const struct http_status_line http_status_line_data[6][60] = {
+#define X(status, string) [status / 100][status % 100] = { \
+		STATUS_LINE(string), sizeof(STATUS_LINE(string)) - 1, \
 	},
+	HTTP_STATUS_LIST(X)
+#undef X
 };
@@ -144,6 +144,17 @@ typedef enum {
 
 extern const char *const http_status_to_string_data[6][60];
 
+/**
+ * A complete HTTP/1.1 status line including the trailing CRLF,
+ * e.g. "HTTP/1.1 200 OK\r\n", ready to be written to a socket.
+ */
+struct http_status_line {
+	const char *data;
+	size_t length;
+};
+
+extern const struct http_status_line http_status_line_data[6][60];
+
 static inline bool
 http_status_is_valid(http_status_t _status)
 {
@@ -164,6 +175,18 @@ http_status_to_string(http_status_t status)
 	return http_status_to_string_data[status / 100][status % 100];
 }
 
+/**
+ * Returns the precomputed HTTP/1.1 status line.  The status must be
+ * valid.
+ */
+static inline struct http_status_line
+http_status_to_line(http_status_t status)
+{
+	assert(http_status_is_valid(status));
+
+	return http_status_line_data[status / 100][status % 100];
+}
+
 static inline bool
 http_status_is_success(http_status_t _status)
 {
@@ -0,0 +1,353 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AsyncLogger.hxx"
+#include "util/StaticArray.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+
+std::atomic<AsyncLogger *> AsyncLogger::instance{nullptr};
+
+/**
+ * A single-producer single-consumer byte queue.  The producer (one
+ * logging thread) advances #head after a whole message has been
+ * copied; the consumer (the writer) advances #tail after writing.
+ * Both are never wrapped, only masked.
+ */
+struct AsyncLogger::Ring {
+	std::atomic<size_t> head{0}, tail{0};
+
+	const size_t mask;
+
+	const std::unique_ptr<char[]> data;
+
+	explicit Ring(size_t size)
+		:mask(size - 1), data(new char[size]) {}
+
+	size_t GetSize() const noexcept {
+		return mask + 1;
+	}
+
+	bool IsEmpty() const noexcept {
+		return head.load(std::memory_order_acquire) ==
+			tail.load(std::memory_order_relaxed);
+	}
+
+	void Append(size_t &position, const void *_src, size_t length) noexcept {
+		const char *src = (const char *)_src;
+
+		while (length > 0) {
+			const size_t offset = position & mask;
+			const size_t chunk = std::min(length, GetSize() - offset);
+			memcpy(data.get() + offset, src, chunk);
+			src += chunk;
+			length -= chunk;
+			position += chunk;
+		}
+	}
+};
+
+/**
+ * The ring of the current thread.  The #Ring is co-owned by the
+ * #AsyncLogger, which frees it after the thread has exited and all
+ * its messages have been written.
+ */
+struct AsyncLogger::ThreadRing {
+	unsigned generation = 0;
+	std::shared_ptr<Ring> ring;
+};
+
+static std::atomic<unsigned> next_generation{1};
+
+static constexpr size_t
+RoundUpPowerOfTwo(size_t n) noexcept
+{
+	size_t result = 1;
+	while (result < n)
+		result <<= 1;
+	return result;
+}
+
+AsyncLogger::AsyncLogger(int _fd, size_t _ring_size)
+	:generation(next_generation.fetch_add(1, std::memory_order_relaxed)),
+	 fd(_fd),
+	 ring_size(RoundUpPowerOfTwo(std::max<size_t>(_ring_size, 4096)))
+{
+	assert(Get() == nullptr);
+
+	thread = std::thread(&AsyncLogger::Run, this);
+	instance.store(this, std::memory_order_release);
+}
+
+AsyncLogger::~AsyncLogger() noexcept
+{
+	instance.store(nullptr, std::memory_order_release);
+
+	{
+		const std::lock_guard<std::mutex> lock(wake_mutex);
+		quit = true;
+	}
+
+	wake_cond.notify_one();
+	thread.join();
+
+	Flush();
+}
+
+inline AsyncLogger::Ring *
+AsyncLogger::GetThreadRing() noexcept
+{
+	static thread_local ThreadRing t;
+
+	if (t.generation != generation) {
+		/* first message of this thread to this instance */
+		try {
+			auto ring = std::make_shared<Ring>(ring_size);
+
+			{
+				const std::lock_guard<std::mutex> lock(rings_mutex);
+				rings.push_back(ring);
+			}
+
+			t.ring = std::move(ring);
+			t.generation = generation;
+		} catch (...) {
+			return nullptr;
+		}
+	}
+
+	return t.ring.get();
+}
+
+inline void
+AsyncLogger::Wake() noexcept
+{
+	/* pairs with the fence in Run() */
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (sleeping.load(std::memory_order_relaxed)) {
+		const std::lock_guard<std::mutex> lock(wake_mutex);
+		wake_cond.notify_one();
+	}
+}
+
+bool
+AsyncLogger::Push(const struct iovec *v, size_t n) noexcept
+{
+	Ring *ring = GetThreadRing();
+	if (ring == nullptr) {
+		n_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	size_t length = 0;
+	for (size_t i = 0; i < n; ++i)
+		length += v[i].iov_len;
+
+	size_t head = ring->head.load(std::memory_order_relaxed);
+	const size_t tail = ring->tail.load(std::memory_order_acquire);
+	if (length > ring->GetSize() - (head - tail)) {
+		n_dropped.fetch_add(1, std::memory_order_relaxed);
+		Wake();
+		return false;
+	}
+
+	for (size_t i = 0; i < n; ++i)
+		ring->Append(head, v[i].iov_base, v[i].iov_len);
+
+	ring->head.store(head, std::memory_order_release);
+	Wake();
+	return true;
+}
+
+/**
+ * Write all buffers, retrying after partial writes.  On error, the
+ * rest is discarded; there is nobody to report it to.
+ */
+static void
+WriteAll(int fd, struct iovec *v, size_t n) noexcept
+{
+	while (n > 0) {
+		ssize_t nbytes = writev(fd, v, n);
+		if (nbytes < 0) {
+			if (errno == EINTR)
+				continue;
+
+			if (errno == EAGAIN) {
+				struct pollfd pfd = {fd, POLLOUT, 0};
+				poll(&pfd, 1, -1);
+				continue;
+			}
+
+			return;
+		}
+
+		while (n > 0 && size_t(nbytes) >= v->iov_len) {
+			nbytes -= v->iov_len;
+			++v;
+			--n;
+		}
+
+		if (n > 0) {
+			v->iov_base = (char *)v->iov_base + nbytes;
+			v->iov_len -= nbytes;
+		}
+	}
+}
+
+bool
+AsyncLogger::Drain() noexcept
+{
+	std::vector<std::shared_ptr<Ring>> snapshot;
+
+	{
+		const std::lock_guard<std::mutex> lock(rings_mutex);
+
+		/* free the rings of threads which have exited (we
+		   hold the only reference) after they have been
+		   written */
+		rings.erase(std::remove_if(rings.begin(), rings.end(),
+					   [](const std::shared_ptr<Ring> &r){
+						   return r.use_count() == 1 &&
+							   r->IsEmpty();
+					   }),
+			    rings.end());
+
+		try {
+			snapshot = rings;
+		} catch (...) {
+			return false;
+		}
+	}
+
+	bool result = false;
+
+	for (size_t i = 0; i < snapshot.size();) {
+		StaticArray<struct iovec, 64> v;
+		StaticArray<std::pair<Ring *, size_t>, 32> batch;
+
+		for (; i < snapshot.size() && !batch.full(); ++i) {
+			Ring &ring = *snapshot[i];
+			const size_t head = ring.head.load(std::memory_order_acquire);
+			const size_t tail = ring.tail.load(std::memory_order_relaxed);
+			if (head == tail)
+				continue;
+
+			const size_t offset = tail & ring.mask;
+			const size_t length = head - tail;
+			const size_t first = std::min(length, ring.GetSize() - offset);
+			v.push_back({ring.data.get() + offset, first});
+			if (length > first)
+				v.push_back({ring.data.get(), length - first});
+
+			batch.push_back({&ring, head});
+		}
+
+		if (batch.empty())
+			continue;
+
+		WriteAll(fd, v.begin(), v.size());
+
+		for (const auto &b : batch)
+			b.first->tail.store(b.second, std::memory_order_release);
+
+		result = true;
+	}
+
+	ReportDropped();
+	return result;
+}
+
+void
+AsyncLogger::ReportDropped() noexcept
+{
+	const uint64_t dropped = GetDropped();
+	if (dropped == n_dropped_reported)
+		return;
+
+	char buffer[96];
+	int length = snprintf(buffer, sizeof(buffer),
+			      "[AsyncLogger] %llu log messages dropped\n",
+			      (unsigned long long)(dropped - n_dropped_reported));
+	n_dropped_reported = dropped;
+
+	struct iovec v = {buffer, size_t(length)};
+	WriteAll(fd, &v, 1);
+}
+
+void
+AsyncLogger::Flush() noexcept
+{
+	const std::lock_guard<std::mutex> lock(consume_mutex);
+	while (Drain()) {}
+}
+
+void
+AsyncLogger::Run() noexcept
+{
+	while (true) {
+		{
+			const std::lock_guard<std::mutex> lock(consume_mutex);
+			if (Drain())
+				continue;
+		}
+
+		std::unique_lock<std::mutex> lock(wake_mutex);
+		if (quit)
+			break;
+
+		sleeping.store(true, std::memory_order_relaxed);
+		/* pairs with the fence in Wake() */
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		bool pending;
+		{
+			const std::lock_guard<std::mutex> rings_lock(rings_mutex);
+			pending = std::any_of(rings.begin(), rings.end(),
+					      [](const std::shared_ptr<Ring> &r){
+						      return !r->IsEmpty();
+					      });
+		}
+
+		if (!pending)
+			wake_cond.wait_for(lock, std::chrono::seconds(1));
+
+		sleeping.store(false, std::memory_order_relaxed);
+	}
+}
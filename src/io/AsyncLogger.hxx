@@ -0,0 +1,183 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "util/Compiler.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+
+struct iovec;
+
+/**
+ * An asynchronous backend for the #Logger functions: while an
+ * instance exists, log messages are copied into a per-thread
+ * lock-free ring buffer and a background thread writes them with
+ * batched writev() calls.  Logging therefore never blocks on a slow
+ * stderr pipe; if a ring buffer is full, the message is dropped and
+ * counted.
+ *
+ * Only one instance may exist at a time.  It must be constructed
+ * before and destroyed after all other threads which log.  The
+ * destructor flushes all pending messages.
+ */
+class AsyncLogger {
+	struct Ring;
+
+	struct ThreadRing;
+
+	static std::atomic<AsyncLogger *> instance;
+
+	/**
+	 * Distinguishes instances for the thread-local ring
+	 * pointers.
+	 */
+	const unsigned generation;
+
+	const int fd;
+
+	/**
+	 * The size of each ring buffer (a power of two).
+	 */
+	const size_t ring_size;
+
+	/**
+	 * Protects #rings.  The lock is only taken by producers when
+	 * they log for the first time.
+	 */
+	std::mutex rings_mutex;
+
+	std::vector<std::shared_ptr<Ring>> rings;
+
+	/**
+	 * Serializes consumers: the writer thread and Flush().
+	 */
+	std::mutex consume_mutex;
+
+	std::mutex wake_mutex;
+	std::condition_variable wake_cond;
+	std::atomic<bool> sleeping{false};
+	bool quit = false;
+
+	std::atomic<uint64_t> n_dropped{0};
+
+	/**
+	 * The value of #n_dropped which was last reported to the
+	 * log; protected by #consume_mutex.
+	 */
+	uint64_t n_dropped_reported = 0;
+
+	std::thread thread;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param _fd the file descriptor log messages are written to
+	 * @param _ring_size the size of each thread's ring buffer in
+	 * bytes; it is rounded up to a power of two
+	 */
+	explicit AsyncLogger(int _fd=STDERR_FILENO,
+			     size_t _ring_size=64 * 1024);
+
+	~AsyncLogger() noexcept;
+
+	AsyncLogger(const AsyncLogger &) = delete;
+	AsyncLogger &operator=(const AsyncLogger &) = delete;
+
+	/**
+	 * Returns the installed instance or nullptr.
+	 */
+	gcc_pure
+	static AsyncLogger *Get() noexcept {
+		return instance.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * Returns the number of messages which were dropped because
+	 * a ring buffer was full.
+	 */
+	uint64_t GetDropped() const noexcept {
+		return n_dropped.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Copy one log message into the calling thread's ring
+	 * buffer.  This method is thread-safe and lock-free (except
+	 * for the first call in each thread).
+	 *
+	 * @return false if the message was dropped
+	 */
+	bool Push(const struct iovec *v, size_t n) noexcept;
+
+	/**
+	 * Write all pending messages synchronously from the calling
+	 * thread.  Call this before aborting the process after a
+	 * fatal error.
+	 */
+	void Flush() noexcept;
+
+	/**
+	 * Call Flush() on the installed instance (if any).
+	 */
+	static void FlushInstance() noexcept {
+		auto *i = Get();
+		if (i != nullptr)
+			i->Flush();
+	}
+
+private:
+	Ring *GetThreadRing() noexcept;
+
+	void Wake() noexcept;
+
+	/**
+	 * Write pending messages.  The caller must hold
+	 * #consume_mutex.
+	 *
+	 * @return true if something was written
+	 */
+	bool Drain() noexcept;
+
+	void ReportDropped() noexcept;
+
+	void Run() noexcept;
+};
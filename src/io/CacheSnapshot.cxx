@@ -0,0 +1,214 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CacheSnapshot.hxx"
+#include "UniqueFileDescriptor.hxx"
+#include "system/Error.hxx"
+#include "util/ByteOrder.hxx"
+#include "util/WyHash.hxx"
+
+#include <stdexcept>
+
+#include <string.h>
+#include <sys/mman.h>
+
+using std::chrono::system_clock;
+
+static constexpr int64_t EXPIRES_NEVER = INT64_MAX;
+
+static constexpr size_t
+PadSize(size_t size) noexcept
+{
+	return (size + 7) & ~size_t(7);
+}
+
+template<typename T>
+static T
+LoadRaw(const uint8_t *p) noexcept
+{
+	T value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static int64_t
+ToMicroseconds(system_clock::time_point t) noexcept
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+}
+
+CacheSnapshotWriter::CacheSnapshotWriter(const char *path)
+	:file(path), now(Expiry::Now()), system_now(system_clock::now())
+{
+	CacheSnapshotFileHeader header;
+	header.magic = ToLE32(CACHE_SNAPSHOT_MAGIC);
+	header.flags = 0;
+	buffer.append((const char *)&header, sizeof(header));
+}
+
+void
+CacheSnapshotWriter::Add(StringView key, ConstBuffer<void> value,
+			 Expiry expires)
+{
+	int64_t wall_expires = EXPIRES_NEVER;
+	if (!(expires == Expiry::Never())) {
+		if (expires.IsExpired(now))
+			return;
+
+		wall_expires = ToMicroseconds(system_now) +
+			std::chrono::duration_cast<std::chrono::microseconds>(expires.GetRemaining(now)).count();
+	}
+
+	CacheSnapshotRecordHeader header;
+	header.key_size = ToLE32(key.size);
+	header.value_size = ToLE32(value.size);
+	header.expires = ToLE64(wall_expires);
+
+	const size_t record_size = sizeof(header) + key.size + value.size;
+	buffer.append((const char *)&header, sizeof(header));
+	buffer.append(key.data, key.size);
+	buffer.append((const char *)value.data, value.size);
+	buffer.append(PadSize(record_size) - record_size, 0);
+
+	if (buffer.size() >= 65536)
+		Flush();
+}
+
+void
+CacheSnapshotWriter::Flush()
+{
+	file.Write(buffer.data(), buffer.size());
+	buffer.clear();
+}
+
+void
+CacheSnapshotWriter::Commit()
+{
+	Flush();
+	file.Commit();
+}
+
+size_t
+CacheSnapshot::KeyHash::operator()(StringView key) const noexcept
+{
+	return WyHash64(key.data, key.size);
+}
+
+CacheSnapshot::CacheSnapshot(const char *path)
+	:now(Expiry::Now()), system_now(system_clock::now())
+{
+	UniqueFileDescriptor fd;
+	if (!fd.OpenReadOnly(path))
+		throw FormatErrno("Failed to open %s", path);
+
+	const off_t file_size = fd.GetSize();
+	if (file_size < 0)
+		throw FormatErrno("Failed to stat %s", path);
+
+	if (size_t(file_size) < sizeof(CacheSnapshotFileHeader))
+		throw std::runtime_error(std::string("Not a cache snapshot: ") + path);
+
+	size = file_size;
+	void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd.Get(), 0);
+	if (p == MAP_FAILED)
+		throw FormatErrno("Failed to map %s", path);
+
+	data = (const uint8_t *)p;
+
+	const auto file_header = LoadRaw<CacheSnapshotFileHeader>(data);
+	if (FromLE32(file_header.magic) != CACHE_SNAPSHOT_MAGIC) {
+		munmap(p, size);
+		throw std::runtime_error(std::string("Not a cache snapshot: ") + path);
+	}
+
+	const uint8_t *position = data + sizeof(file_header);
+	const uint8_t *const end = data + size;
+	while (size_t(end - position) >= sizeof(CacheSnapshotRecordHeader)) {
+		const auto header = LoadRaw<CacheSnapshotRecordHeader>(position);
+		const size_t key_size = FromLE32(header.key_size);
+		const size_t value_size = FromLE32(header.value_size);
+		const uint8_t *key = position + sizeof(header);
+
+		if (size_t(end - key) < key_size + value_size)
+			/* truncated */
+			break;
+
+		const StringView key_view((const char *)key, key_size);
+		const Record record{
+			{key + key_size, value_size},
+			int64_t(FromLE64(header.expires)),
+		};
+
+		/* a duplicate key replaces the older record */
+		records[key_view] = record;
+
+		const size_t record_size = sizeof(header) + key_size + value_size;
+		if (size_t(end - position) < PadSize(record_size))
+			break;
+
+		position += PadSize(record_size);
+	}
+}
+
+CacheSnapshot::~CacheSnapshot() noexcept
+{
+	munmap(const_cast<uint8_t *>(data), size);
+}
+
+Expiry
+CacheSnapshot::ToExpiry(int64_t expires) const noexcept
+{
+	if (expires == EXPIRES_NEVER)
+		return Expiry::Never();
+
+	const int64_t remaining = expires - ToMicroseconds(system_now);
+	if (remaining <= 0)
+		return Expiry::AlreadyExpired();
+
+	return Expiry::Touched(now, std::chrono::microseconds(remaining));
+}
+
+bool
+CacheSnapshot::Take(StringView key, Expiry cache_now, Entry &entry) noexcept
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+
+	auto i = records.find(key);
+	if (i == records.end())
+		return false;
+
+	entry.value = i->second.value;
+	entry.expires = ToExpiry(i->second.expires);
+	records.erase(i);
+
+	return !entry.expires.IsExpired(cache_now);
+}
@@ -0,0 +1,257 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "FileWriter.hxx"
+#include "util/Expiry.hxx"
+#include "util/StringView.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Compiler.h"
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A file containing a snapshot of a cache (e.g. #Cache, #ShardedCache
+ * or #ExpiringCache), which allows a restarted process to begin with
+ * a warm cache.
+ *
+ * Keys and values are opaque byte strings; the cache owner is
+ * responsible for serialising them.  Expiry time stamps are stored
+ * as wall-clock time, because the monotonic clock used by #Expiry
+ * does not survive a reboot.
+ *
+ * File format (all integers little-endian): a
+ * #CacheSnapshotFileHeader followed by records; each record is a
+ * #CacheSnapshotRecordHeader followed by the key, the value and
+ * padding to a multiple of 8 bytes.
+ */
+
+static constexpr uint32_t CACHE_SNAPSHOT_MAGIC = 0x63736e31;
+
+struct CacheSnapshotFileHeader {
+	uint32_t magic;
+
+	/**
+	 * Reserved, must be zero.
+	 */
+	uint32_t flags;
+};
+
+struct CacheSnapshotRecordHeader {
+	uint32_t key_size, value_size;
+
+	/**
+	 * Microseconds since the epoch; INT64_MAX means "never".
+	 */
+	int64_t expires;
+};
+
+/**
+ * Writes a cache snapshot file.  Expired items are skipped.  The
+ * file is replaced atomically by Commit() (see #FileWriter).
+ *
+ * Example:
+ *
+ *     CacheSnapshotWriter w(path);
+ *     cache.ForEachWithExpiry([&w](const Key &key, const Data &data,
+ *                                  Expiry expires){
+ *         w.Add(SerializeKey(key), SerializeData(data), expires);
+ *     });
+ *     w.Commit();
+ */
+class CacheSnapshotWriter {
+	FileWriter file;
+
+	std::string buffer;
+
+	/**
+	 * The current time, used to convert #Expiry (monotonic) to
+	 * wall-clock time.
+	 */
+	const Expiry now;
+	const std::chrono::system_clock::time_point system_now;
+
+public:
+	/**
+	 * Throws std::system_error on error.
+	 */
+	explicit CacheSnapshotWriter(const char *path);
+
+	/**
+	 * Add an item to the snapshot.  Nothing is written if it has
+	 * expired already.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void Add(StringView key, ConstBuffer<void> value, Expiry expires);
+
+	/**
+	 * Throws std::runtime_error on error.
+	 */
+	void Commit();
+
+private:
+	void Flush();
+};
+
+/**
+ * Loads a cache snapshot which was written by #CacheSnapshotWriter.
+ * The file is mapped into memory, and only the record headers are
+ * read by the constructor, so this is fast even for large
+ * snapshots.  Values are deserialised lazily by the cache owner on a
+ * cache miss:
+ *
+ *     Data *data = cache.Get(key, now);
+ *     CacheSnapshot::Entry e;
+ *     if (data == nullptr && snapshot &&
+ *         snapshot->Take(SerializeKey(key), now, e))
+ *         data = cache.Put(key, Deserialize(e.value), cost, e.expires);
+ *
+ * Once IsEmpty() returns true (or after a while), the object should
+ * be destroyed to release the mapping.
+ *
+ * This class is thread-safe.
+ */
+class CacheSnapshot {
+	const uint8_t *data;
+	size_t size;
+
+	struct Record {
+		ConstBuffer<void> value;
+
+		int64_t expires;
+	};
+
+	struct KeyHash {
+		gcc_pure
+		size_t operator()(StringView key) const noexcept;
+	};
+
+	struct KeyEqual {
+		gcc_pure
+		bool operator()(StringView a, StringView b) const noexcept {
+			return a.Equals(b);
+		}
+	};
+
+	/**
+	 * The records which have not yet been taken; the keys point
+	 * into the mapping.
+	 */
+	std::unordered_map<StringView, Record, KeyHash, KeyEqual> records;
+
+	mutable std::mutex mutex;
+
+	/**
+	 * The time of loading, used to convert wall-clock time stamps
+	 * to #Expiry (monotonic).
+	 */
+	const Expiry now;
+	const std::chrono::system_clock::time_point system_now;
+
+public:
+	struct Entry {
+		/**
+		 * The serialised value; it points into the mapping
+		 * and is valid as long as the #CacheSnapshot exists.
+		 */
+		ConstBuffer<void> value;
+
+		Expiry expires;
+	};
+
+	/**
+	 * Throws std::system_error on I/O error and
+	 * std::runtime_error if the file is not a cache snapshot.
+	 * Truncated files (e.g. after a crash) are accepted; the
+	 * incomplete record is ignored.
+	 */
+	explicit CacheSnapshot(const char *path);
+	~CacheSnapshot() noexcept;
+
+	CacheSnapshot(const CacheSnapshot &) = delete;
+	CacheSnapshot &operator=(const CacheSnapshot &) = delete;
+
+	gcc_pure
+	bool IsEmpty() const noexcept {
+		const std::lock_guard<std::mutex> lock(mutex);
+		return records.empty();
+	}
+
+	/**
+	 * Returns the number of records which have not yet been
+	 * taken.
+	 */
+	gcc_pure
+	size_t GetCount() const noexcept {
+		const std::lock_guard<std::mutex> lock(mutex);
+		return records.size();
+	}
+
+	/**
+	 * Look up a record and remove it from the snapshot, i.e. each
+	 * record can be taken only once.
+	 *
+	 * @param cache_now the current time, e.g. from
+	 * EventLoop::SteadyNow()
+	 * @return false if there is no such record or if it has
+	 * expired
+	 */
+	bool Take(StringView key, Expiry cache_now, Entry &entry) noexcept;
+
+	/**
+	 * Invoke the callback for each record which has not yet been
+	 * taken and has not yet expired, e.g. to populate a cache
+	 * eagerly, passing the key and an #Entry.  The callback must
+	 * not call other methods of this object.
+	 */
+	template<typename F>
+	void ForEach(Expiry cache_now, F &&f) const {
+		const std::lock_guard<std::mutex> lock(mutex);
+		for (const auto &i : records) {
+			const Expiry expires = ToExpiry(i.second.expires);
+			if (!expires.IsExpired(cache_now))
+				f(i.first, Entry{i.second.value, expires});
+		}
+	}
+
+private:
+	gcc_pure
+	Expiry ToExpiry(int64_t expires) const noexcept;
+};
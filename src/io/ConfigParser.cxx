@@ -37,9 +37,17 @@
 
 #include "util/Compiler.h"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 #include <assert.h>
 #include <errno.h>
 #include <fnmatch.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 namespace fs = boost::filesystem;
 
@@ -318,34 +326,190 @@ IncludeConfigParser::IncludePath(boost::filesystem::path &&p)
 
 		std::sort(files.begin(), files.end());
 
+		if (reentrant != nullptr && files.size() > 1) {
+			IncludeParallel(std::move(files));
+			return;
+		}
+
 		for (auto &i : files) {
 			IncludeConfigParser sub(std::move(i), child, false);
+			if (reentrant != nullptr)
+				sub.EnableParallel(*reentrant, n_threads);
 			ParseConfigFile(sub.path.c_str(), sub);
 		}
 	} else {
 		IncludeConfigParser sub(std::move(p), child, false);
+		if (reentrant != nullptr)
+			sub.EnableParallel(*reentrant, n_threads);
 		ParseConfigFile(sub.path.c_str(), sub);
 	}
 }
 
+namespace {
+
+/**
+ * The state of one file parsed by
+ * IncludeConfigParser::IncludeParallel().
+ */
+struct ConfigFragment {
+	fs::path path;
+
+	std::unique_ptr<ConfigParser> parser;
+
+	std::exception_ptr error;
+
+	ConfigFragment(fs::path &&_path,
+		       std::unique_ptr<ConfigParser> &&_parser) noexcept
+		:path(std::move(_path)), parser(std::move(_parser)) {}
+
+	void Parse() noexcept {
+		try {
+			/* nested includes inside the fragment are
+			   parsed sequentially by this worker
+			   thread */
+			IncludeConfigParser sub(fs::path(path), *parser);
+			ParseConfigFile(path, sub);
+		} catch (...) {
+			error = std::current_exception();
+		}
+	}
+};
+
+}
+
+inline void
+IncludeConfigParser::IncludeParallel(std::vector<fs::path> &&files)
+{
+	assert(reentrant != nullptr);
+
+	std::vector<ConfigFragment> fragments;
+	fragments.reserve(files.size());
+	for (auto &i : files)
+		fragments.emplace_back(std::move(i),
+				       reentrant->CreateFragmentParser());
+
+	unsigned max_threads = n_threads;
+	if (max_threads == 0)
+		max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	/* the calling thread is a worker, too */
+	const size_t n_workers = std::min<size_t>(max_threads,
+						  fragments.size()) - 1;
+
+	std::atomic<size_t> next{0};
+	auto work = [&fragments, &next](){
+		size_t i;
+		while ((i = next.fetch_add(1, std::memory_order_relaxed)) < fragments.size())
+			fragments[i].Parse();
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(n_workers);
+
+	AtScopeExit(&threads, &next, &fragments) {
+		/* on error (std::thread creation failure), abort the
+		   other workers */
+		next = fragments.size();
+
+		for (auto &i : threads)
+			i.join();
+	};
+
+	for (size_t i = 0; i < n_workers; ++i)
+		threads.emplace_back(work);
+
+	work();
+
+	for (auto &i : threads)
+		i.join();
+	threads.clear();
+
+	/* merge in declaration order; the first error wins */
+	for (auto &i : fragments) {
+		if (i.error)
+			std::rethrow_exception(i.error);
+
+		reentrant->MergeFragment(std::move(i.parser));
+	}
+}
+
 static void
-ParseConfigFile(const boost::filesystem::path &path, FILE *file,
-		ConfigParser &parser)
+ParseConfigLine(const boost::filesystem::path &path, char *line,
+		unsigned i, ConfigParser &parser)
 {
-	char buffer[4096], *line;
+	FileLineParser line_parser(path, line);
+
+	try {
+		if (!parser.PreParseLine(line_parser))
+			parser.ParseLine(line_parser);
+	} catch (...) {
+		std::throw_with_nested(LineParser::Error(path.native() + ':' + std::to_string(i)));
+	}
+}
+
+/**
+ * Map the file into memory and split it into lines in place; this
+ * avoids the per-line stdio overhead, and memchr() is vectorized.
+ * The mapping is private and writable, because #LineParser modifies
+ * the line (the newline is replaced with a null terminator).
+ *
+ * @return false if the file cannot be mapped (e.g. because it is
+ * not a regular file or it is empty); the caller shall fall back
+ * to reading it with stdio
+ */
+static bool
+ParseMappedConfigFile(const boost::filesystem::path &path, int fd,
+		      ConfigParser &parser)
+{
+	struct stat st;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+	    uintmax_t(st.st_size) > SIZE_MAX)
+		return false;
+
+	const size_t size = st.st_size;
+	void *const map = mmap(nullptr, size, PROT_READ|PROT_WRITE,
+			       MAP_PRIVATE|MAP_POPULATE, fd, 0);
+	if (map == MAP_FAILED)
+		return false;
+
+	AtScopeExit(map, size) { munmap(map, size); };
+
+	madvise(map, size, MADV_SEQUENTIAL);
+
+	char *p = (char *)map;
+	char *const end = p + size;
 	unsigned i = 1;
-	while ((line = fgets(buffer, sizeof(buffer), file)) != nullptr) {
-		FileLineParser line_parser(path, line);
 
-		try {
-			if (!parser.PreParseLine(line_parser))
-				parser.ParseLine(line_parser);
-		} catch (...) {
-			std::throw_with_nested(LineParser::Error(path.native() + ':' + std::to_string(i)));
+	while (p < end) {
+		char *newline = (char *)memchr(p, '\n', end - p);
+		if (newline == nullptr) {
+			/* the last line is not terminated; there may be
+			   no room for the null terminator after the
+			   end of the mapping, so copy it */
+			std::string last(p, end);
+			ParseConfigLine(path, &last.front(), i, parser);
+			break;
 		}
 
-		++i;
+		*newline = 0;
+		ParseConfigLine(path, p, i++, parser);
+		p = newline + 1;
 	}
+
+	return true;
+}
+
+static void
+ParseConfigFile(const boost::filesystem::path &path, FILE *file,
+		ConfigParser &parser)
+{
+	if (ParseMappedConfigFile(path, fileno(file), parser))
+		return;
+
+	char buffer[4096], *line;
+	unsigned i = 1;
+	while ((line = fgets(buffer, sizeof(buffer), file)) != nullptr)
+		ParseConfigLine(path, line, i++, parser);
 }
 
 inline void
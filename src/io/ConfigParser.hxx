@@ -37,6 +37,7 @@
 
 #include <memory>
 #include <map>
+#include <vector>
 
 class FileLineParser;
 
@@ -120,6 +121,36 @@ private:
 	void Expand(FileLineParser &line) const;
 };
 
+/**
+ * A #ConfigParser whose included files are independent of each
+ * other, and may therefore be parsed concurrently (see
+ * IncludeConfigParser::EnableParallel()).
+ */
+class ReentrantConfigParser : public ConfigParser {
+public:
+	/**
+	 * Create a new parser for one included file.  This is called
+	 * in the main thread, but the returned parser will be used by
+	 * a worker thread, including its Finish() call; it must not
+	 * access mutable state shared with other parsers.  Comments
+	 * and variables need to be handled by the returned parser
+	 * (e.g. by wrapping it in #CommentConfigParser).
+	 *
+	 * Throws on error.
+	 */
+	virtual std::unique_ptr<ConfigParser> CreateFragmentParser() = 0;
+
+	/**
+	 * Merge the result of a parser created by
+	 * CreateFragmentParser() after it has finished.  This is
+	 * called in the main thread, in the same order in which the
+	 * files would have been parsed sequentially.
+	 *
+	 * Throws on error.
+	 */
+	virtual void MergeFragment(std::unique_ptr<ConfigParser> &&fragment) = 0;
+};
+
 /**
  * A #ConfigParser which can "include" other files.
  */
@@ -128,6 +159,14 @@ class IncludeConfigParser final : public ConfigParser {
 
 	ConfigParser &child;
 
+	/**
+	 * If not nullptr, then wildcard includes are parsed
+	 * concurrently with fragment parsers created by this object.
+	 */
+	ReentrantConfigParser *reentrant = nullptr;
+
+	unsigned n_threads;
+
 	/**
 	 * Does our Finish() override call child.Finish()?  This is a
 	 * kludge to avoid calling a foreign child's Finish() method
@@ -142,6 +181,23 @@ public:
 		:path(std::move(_path)), child(_child),
 		 finish_child(_finish_child) {}
 
+	/**
+	 * Opt in to parsing the files matched by a wildcard include
+	 * (e.g. "@include 'site*.conf'") concurrently: each file is
+	 * parsed by a fragment parser (see
+	 * ReentrantConfigParser::CreateFragmentParser()) on a worker
+	 * thread, and the results are merged sorted by file name, as
+	 * if they had been parsed sequentially.
+	 *
+	 * @param _n_threads the maximum number of worker threads; 0
+	 * means one per CPU
+	 */
+	void EnableParallel(ReentrantConfigParser &_reentrant,
+			    unsigned _n_threads=0) noexcept {
+		reentrant = &_reentrant;
+		n_threads = _n_threads;
+	}
+
 	/* virtual methods from class ConfigParser */
 	bool PreParseLine(FileLineParser &line) override;
 	void ParseLine(FileLineParser &line) override;
@@ -149,6 +205,7 @@ public:
 
 private:
 	void IncludePath(boost::filesystem::path &&p);
+	void IncludeParallel(std::vector<boost::filesystem::path> &&files);
 	void IncludeOptionalPath(boost::filesystem::path &&p);
 };
 
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "DynamicMultiWriteBuffer.hxx"
+#include "system/Error.hxx"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+inline void
+DynamicMultiWriteBuffer::Consume(size_t nbytes)
+{
+    while (nbytes > 0) {
+        assert(i < buffers.size());
+
+        auto &b = buffers[i];
+        if (nbytes < b.iov_len) {
+            b.iov_base = (uint8_t *)b.iov_base + nbytes;
+            b.iov_len -= nbytes;
+            return;
+        }
+
+        nbytes -= b.iov_len;
+        ++i;
+    }
+}
+
+template<typename F>
+inline DynamicMultiWriteBuffer::Result
+DynamicMultiWriteBuffer::WriteLoop(F &&f)
+{
+    assert(!IsEmpty());
+
+    do {
+        const size_t n = std::min<size_t>(buffers.size() - i, IOV_MAX);
+        const bool last = i + n == buffers.size();
+
+        size_t size = 0;
+        for (size_t j = i; j < i + n; ++j)
+            size += buffers[j].iov_len;
+
+        ssize_t nbytes = f(&buffers[i], n, last);
+        if (nbytes < 0) {
+            switch (errno) {
+            case EAGAIN:
+            case EINTR:
+                return Result::MORE;
+
+            default:
+                throw MakeErrno("Failed to write");
+            }
+        }
+
+        Consume(nbytes);
+
+        if (size_t(nbytes) < size)
+            /* short write: the kernel buffer is full */
+            return Result::MORE;
+    } while (!IsEmpty());
+
+    Clear();
+    return Result::FINISHED;
+}
+
+DynamicMultiWriteBuffer::Result
+DynamicMultiWriteBuffer::Write(int fd)
+{
+    return WriteLoop([fd](const struct iovec *v, size_t n, bool){
+            return writev(fd, v, n);
+        });
+}
+
+DynamicMultiWriteBuffer::Result
+DynamicMultiWriteBuffer::Send(int fd, int flags)
+{
+    return WriteLoop([fd, flags](struct iovec *v, size_t n, bool last){
+            struct msghdr m = {
+                .msg_name = nullptr,
+                .msg_namelen = 0,
+                .msg_iov = v,
+                .msg_iovlen = n,
+                .msg_control = nullptr,
+                .msg_controllen = 0,
+                .msg_flags = 0,
+            };
+
+            return sendmsg(fd, &m, last ? flags : flags | MSG_MORE);
+        });
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DYNAMIC_MULTI_WRITE_BUFFER_HXX
+#define DYNAMIC_MULTI_WRITE_BUFFER_HXX
+
+#include "WriteBuffer.hxx"
+
+#include <vector>
+#include <cstddef>
+#include <cassert>
+
+#include <sys/uio.h>
+
+/**
+ * Like #MultiWriteBuffer, but the number of buffers is not limited.
+ * Each system call submits up to IOV_MAX buffers, and Write() /
+ * Send() keep calling until everything has been written or the
+ * file descriptor would block.
+ */
+class DynamicMultiWriteBuffer {
+    /**
+     * The index of the first buffer which has not been written
+     * completely.
+     */
+    size_t i = 0;
+
+    /**
+     * The buffers are stored as #iovec so they can be passed to
+     * writev() and sendmsg() without copying.
+     */
+    std::vector<struct iovec> buffers;
+
+public:
+    typedef WriteBuffer::Result Result;
+
+    bool IsEmpty() const {
+        return i == buffers.size();
+    }
+
+    /**
+     * Returns the number of buffers which have not been written
+     * completely.
+     */
+    size_t GetPendingCount() const {
+        return buffers.size() - i;
+    }
+
+    void Reserve(size_t n) {
+        buffers.reserve(n);
+    }
+
+    /**
+     * Remove all buffers.
+     */
+    void Clear() {
+        buffers.clear();
+        i = 0;
+    }
+
+    /**
+     * Append a buffer.  The caller is responsible for keeping it
+     * valid until it has been written.
+     */
+    void Push(const void *buffer, size_t size) {
+        if (size == 0)
+            return;
+
+        if (IsEmpty())
+            /* recycle the vector's memory */
+            Clear();
+
+        buffers.push_back({const_cast<void *>(buffer), size});
+    }
+
+    /**
+     * Write with writev().
+     *
+     * Throws std::system_error on error.
+     */
+    Result Write(int fd);
+
+    /**
+     * Write to a socket with sendmsg().  MSG_MORE is added
+     * automatically to all but the last system call.  With
+     * MSG_ZEROCOPY (which requires SO_ZEROCOPY), the caller must
+     * keep the buffers valid until the kernel has signalled
+     * completion on the socket's error queue.
+     *
+     * Throws std::system_error on error.
+     *
+     * @param flags flags for sendmsg(), e.g. MSG_NOSIGNAL,
+     * MSG_MORE (to indicate that more data will follow after all
+     * buffers) or MSG_ZEROCOPY
+     */
+    Result Send(int fd, int flags=0);
+
+private:
+    /**
+     * Mark the given number of bytes as written.
+     */
+    void Consume(size_t nbytes);
+
+    template<typename F>
+    Result WriteLoop(F &&f);
+};
+
+#endif
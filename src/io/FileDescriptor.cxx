@@ -29,7 +29,10 @@
 
 #include "FileDescriptor.hxx"
 
+#include <algorithm>
+
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 
 #ifdef __BIONIC__
@@ -81,6 +84,14 @@ FileDescriptor::OpenReadOnly(const char *pathname) noexcept
 
 #ifndef _WIN32
 
+bool
+FileDescriptor::Open(FileDescriptor dir, const char *pathname,
+		     int flags, mode_t mode) noexcept
+{
+	fd = ::openat(dir.Get(), pathname, flags | O_NOCTTY | O_CLOEXEC, mode);
+	return IsDefined();
+}
+
 bool
 FileDescriptor::OpenNonBlocking(const char *pathname) noexcept
 {
@@ -188,6 +199,53 @@ FileDescriptor::CheckDuplicate(FileDescriptor new_fd) noexcept
 
 #endif
 
+#ifdef __linux__
+
+off_t
+FileDescriptor::GetResidentBytes(off_t offset, off_t length) const noexcept
+{
+	assert(IsDefined());
+	assert(offset >= 0);
+	assert(length >= 0);
+
+	if (length == 0)
+		return 0;
+
+	static const off_t page_size = sysconf(_SC_PAGESIZE);
+
+	/* mmap() requires a page-aligned offset */
+	const off_t map_offset = offset & ~(page_size - 1);
+	const size_t map_length = length + (offset - map_offset);
+
+	void *p = mmap(nullptr, map_length, PROT_READ, MAP_SHARED,
+		       fd, map_offset);
+	if (p == MAP_FAILED)
+		return -1;
+
+	const size_t n_pages = (map_length + page_size - 1) / page_size;
+
+	/* check in chunks to keep the stack buffer small */
+	unsigned char vec[1024];
+	size_t n_resident = 0;
+	int result = 0;
+	for (size_t i = 0; i < n_pages && result == 0;) {
+		const size_t n = std::min(n_pages - i, sizeof(vec));
+		result = mincore((char *)p + i * page_size, n * page_size, vec);
+		for (size_t j = 0; j < n; ++j)
+			n_resident += vec[j] & 1;
+		i += n;
+	}
+
+	munmap(p, map_length);
+
+	if (result < 0)
+		return -1;
+
+	return std::min<off_t>(n_resident * page_size, length);
+}
+
+#endif
+
 #ifdef HAVE_EVENTFD
 
 bool
@@ -43,6 +43,7 @@
 #define HAVE_SIGNALFD
 #define HAVE_INOTIFY
 #include <signal.h>
+#include <fcntl.h>
 #endif
 
 /**
@@ -105,6 +106,12 @@ public:
 	bool OpenReadOnly(const char *pathname) noexcept;
 
 #ifndef _WIN32
+	/**
+	 * Open a file relative to the given directory (openat()).
+	 */
+	bool Open(FileDescriptor dir, const char *pathname,
+		  int flags, mode_t mode=0666) noexcept;
+
 	bool OpenNonBlocking(const char *pathname) noexcept;
 
 #ifdef __linux__
@@ -208,6 +215,63 @@ public:
 		return ::write(fd, buffer, length);
 	}
 
+#ifdef __linux__
+	/*
+	 * Access pattern hints for the page cache.  These are only
+	 * hints; they return false on error, but the caller usually
+	 * doesn't need to check.  A length of 0 means "until the end
+	 * of the file".
+	 */
+
+	/**
+	 * The given range will be read sequentially
+	 * (POSIX_FADV_SEQUENTIAL, doubles the readahead window).
+	 */
+	bool AdviseSequential(off_t offset=0, off_t length=0) const noexcept {
+		return posix_fadvise(fd, offset, length,
+				     POSIX_FADV_SEQUENTIAL) == 0;
+	}
+
+	/**
+	 * The given range will be needed soon; start reading it
+	 * asynchronously (POSIX_FADV_WILLNEED).
+	 */
+	bool AdviseWillNeed(off_t offset, off_t length) const noexcept {
+		return posix_fadvise(fd, offset, length,
+				     POSIX_FADV_WILLNEED) == 0;
+	}
+
+	/**
+	 * The given range will not be needed again; drop it from
+	 * the page cache (POSIX_FADV_DONTNEED).  Dirty and busy pages
+	 * are not affected.
+	 */
+	bool AdviseDontNeed(off_t offset=0, off_t length=0) const noexcept {
+		return posix_fadvise(fd, offset, length,
+				     POSIX_FADV_DONTNEED) == 0;
+	}
+
+	/**
+	 * Populate the page cache with the given range (readahead()).
+	 * Unlike AdviseWillNeed(), this may block until the read
+	 * requests have been submitted.
+	 */
+	bool ReadAhead(off_t offset, size_t count) const noexcept {
+		return readahead(fd, offset, count) == 0;
+	}
+
+	/**
+	 * Determine how much of the given file range is currently in
+	 * the page cache (using mincore()).  This can be used to
+	 * decide whether a read will block.
+	 *
+	 * @return the number of resident bytes (rounded to whole
+	 * pages, but not more than the range), or -1 on error
+	 */
+	gcc_pure
+	off_t GetResidentBytes(off_t offset, off_t length) const noexcept;
+#endif
+
 #ifndef _WIN32
 	int Poll(short events, int timeout) const noexcept;
 
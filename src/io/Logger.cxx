@@ -31,15 +31,26 @@
  */
 
 #include "Logger.hxx"
+#include "AsyncLogger.hxx"
 #include "util/StaticArray.hxx"
 #include "util/Exception.hxx"
+#include "util/FNVHash.hxx"
+#include "util/TokenBucket.hxx"
+
+#include <array>
+#include <mutex>
 
 #include <sys/uio.h>
 #include <unistd.h>
 #include <stdarg.h>
+#include <string.h>
+#include <time.h>
 
 unsigned LoggerDetail::max_level = 1;
 
+double LoggerDetail::rate_limit = 0;
+double LoggerDetail::rate_limit_burst = 0;
+
 LoggerDetail::ParamWrapper<std::exception_ptr>::ParamWrapper(std::exception_ptr ep)
 	:ParamWrapper<std::string>(GetFullMessage(ep)) {}
 
@@ -77,14 +88,18 @@ LoggerDetail::WriteV(StringView domain,
 
 	v.push_back(ToIovec("\n"));
 
-	writev(STDERR_FILENO, v.raw(), v.size());
+	auto *async = AsyncLogger::Get();
+	if (async != nullptr)
+		async->Push(v.raw(), v.size());
+	else
+		writev(STDERR_FILENO, v.raw(), v.size());
 }
 
 void
 LoggerDetail::Format(unsigned level, StringView domain,
 		     const char *fmt, ...) noexcept
 {
-	if (!CheckLevel(level))
+	if (!CheckLevel(level) || !CheckRateLimit(level, domain))
 		return;
 
 	char buffer[2048];
@@ -97,6 +112,120 @@ LoggerDetail::Format(unsigned level, StringView domain,
 	WriteV(domain, {&s, 1});
 }
 
+namespace {
+
+/**
+ * The rate limiter state of one domain/level pair.
+ */
+struct RateLimitSlot {
+	std::string domain;
+	uint32_t hash;
+	unsigned level;
+
+	TokenBucket bucket;
+
+	/**
+	 * The number of messages suppressed since #report_time.
+	 */
+	unsigned suppressed;
+
+	double report_time;
+
+	bool Match(uint32_t _hash, unsigned _level, StringView _domain) const noexcept {
+		return hash == _hash && level == _level &&
+			domain.length() == _domain.size &&
+			memcmp(domain.data(), _domain.data, _domain.size) == 0;
+	}
+};
+
+}
+
+/**
+ * The rate limiter table; it is direct-mapped, and a colliding
+ * domain/level pair evicts the previous one.
+ */
+static std::array<RateLimitSlot, 256> rate_limit_slots;
+static std::mutex rate_limit_mutex;
+
+/**
+ * While messages are being suppressed, log a summary at most this
+ * often.
+ */
+static constexpr double SUPPRESSED_REPORT_INTERVAL = 10;
+
+static double
+GetRateLimitClock() noexcept
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+ReportSuppressed(StringView domain, unsigned n) noexcept
+{
+	char buffer[64];
+	StringView s(buffer, StaticFormat(buffer, sizeof(buffer),
+					  STATIC_FORMAT("{} messages suppressed"),
+					  n));
+	LoggerDetail::WriteV(domain, {&s, 1});
+}
+
+bool
+LoggerDetail::CheckRateLimitSlow(unsigned level, StringView domain) noexcept
+{
+	const uint32_t hash = FNV1aHash32(domain.data, domain.size);
+	auto &slot = rate_limit_slots[(hash ^ (level * 0x9e3779b1u)) %
+				      rate_limit_slots.size()];
+	const double now = GetRateLimitClock();
+
+	std::string report_domain;
+	unsigned report = 0;
+	bool result;
+
+	{
+		const std::lock_guard<std::mutex> lock(rate_limit_mutex);
+
+		if (!slot.Match(hash, level, domain)) {
+			try {
+				slot.domain.assign(domain.data, domain.size);
+			} catch (...) {
+				/* out of memory: don't limit */
+				return true;
+			}
+
+			slot.hash = hash;
+			slot.level = level;
+			slot.bucket.Reset();
+			slot.suppressed = 0;
+			slot.report_time = now;
+		}
+
+		result = slot.bucket.Check(now, rate_limit,
+					   std::max(rate_limit_burst, 1.));
+		if (!result)
+			++slot.suppressed;
+
+		if (slot.suppressed > 0 &&
+		    (result || now >= slot.report_time + SUPPRESSED_REPORT_INTERVAL)) {
+			report = slot.suppressed;
+			slot.suppressed = 0;
+			slot.report_time = now;
+
+			try {
+				report_domain = slot.domain;
+			} catch (...) {
+			}
+		}
+	}
+
+	if (report > 0)
+		ReportSuppressed({report_domain.data(), report_domain.length()},
+				 report);
+
+	return result;
+}
+
 std::string
 ChildLoggerDomain::Make(StringView parent, const char *name)
 {
@@ -33,7 +33,9 @@
 #ifndef LOGGER_HXX
 #define LOGGER_HXX
 
+#include "StructuredLog.hxx"
 #include "util/StringView.hxx"
+#include "util/StaticFormat.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/Compiler.h"
 
@@ -213,6 +215,25 @@ CheckLevel(unsigned level)
 	return level <= max_level;
 }
 
+/**
+ * The number of messages per second allowed for each domain/level
+ * pair; 0 disables rate limiting.
+ */
+extern double rate_limit;
+extern double rate_limit_burst;
+
+bool
+CheckRateLimitSlow(unsigned level, StringView domain) noexcept;
+
+/**
+ * @return false if the message shall be suppressed
+ */
+inline bool
+CheckRateLimit(unsigned level, StringView domain) noexcept
+{
+	return rate_limit <= 0 || CheckRateLimitSlow(level, domain);
+}
+
 void
 WriteV(StringView domain, ConstBuffer<StringView> buffers) noexcept;
 
@@ -220,7 +241,7 @@ template<typename... Params>
 void
 LogConcat(unsigned level, StringView domain, Params... _params) noexcept
 {
-	if (!CheckLevel(level))
+	if (!CheckLevel(level) || !CheckRateLimit(level, domain))
 		return;
 
 	const ParamArray<Params...> params(_params...);
@@ -232,6 +253,43 @@ gcc_printf(3, 4)
 void
 Format(unsigned level, StringView domain, const char *fmt, ...) noexcept;
 
+/**
+ * Like the printf-style Format(), but with a STATIC_FORMAT() string
+ * which is parsed at compile time.
+ */
+template<typename S, typename... Params>
+typename std::enable_if<IsStaticFormatString<S>::value>::type
+Format(unsigned level, StringView domain, S fmt, Params&&... params) noexcept
+{
+	if (!CheckLevel(level) || !CheckRateLimit(level, domain))
+		return;
+
+	char buffer[2048];
+	StringView s(buffer, StaticFormat(buffer, sizeof(buffer), fmt,
+					  std::forward<Params>(params)...));
+	WriteV(domain, {&s, 1});
+}
+
+template<typename... Params>
+void
+LogStructured(unsigned level, StringView domain, uint32_t message_id,
+	      Params... _params) noexcept
+{
+	if (!CheckLevel(level) || !CheckRateLimit(level, domain))
+		return;
+
+	auto *sink = StructuredLog::GetSink();
+	if (sink == nullptr) {
+		/* no structured sink installed: fall back to the
+		   text logger */
+		LogConcat(level, domain, _params...);
+		return;
+	}
+
+	const StructuredParamArray<Params...> params(_params...);
+	sink->OnLogRecord({level, domain, message_id, params.GetValues()});
+}
+
 } /* namespace LoggerDetail */
 
 inline void
@@ -240,6 +298,24 @@ SetLogLevel(unsigned level)
 	LoggerDetail::max_level = level;
 }
 
+/**
+ * Limit the number of messages logged per domain and level with a
+ * token bucket.  Suppressed messages are counted, and a summary is
+ * logged when the domain is allowed to log again (or every few
+ * seconds while it keeps flooding).  This is not thread-safe; call
+ * it during startup.
+ *
+ * @param rate the number of messages per second; 0 disables rate
+ * limiting
+ * @param burst the number of messages which may be logged at once
+ */
+inline void
+SetLogRateLimit(double rate, double burst)
+{
+	LoggerDetail::rate_limit = rate;
+	LoggerDetail::rate_limit_burst = burst;
+}
+
 inline bool
 CheckLogLevel(unsigned level)
 {
@@ -254,6 +330,22 @@ LogConcat(unsigned level, D &&domain, Params... params) noexcept
 				std::forward<Params>(params)...);
 }
 
+/**
+ * Log a message with a message id (see
+ * StructuredLog::MakeMessageId()).  If a StructuredLog::Sink is
+ * installed, it receives the raw parameter values; otherwise, this
+ * is the same as LogConcat().
+ */
+template<typename D, typename... Params>
+void
+LogStructured(unsigned level, D &&domain, uint32_t message_id,
+	      Params... params) noexcept
+{
+	LoggerDetail::LogStructured(level, std::forward<D>(domain),
+				    message_id,
+				    std::forward<Params>(params)...);
+}
+
 template<typename D, typename... Params>
 void
 LogFormat(unsigned level, D &&domain,
@@ -263,6 +355,18 @@ LogFormat(unsigned level, D &&domain,
 			     fmt, std::forward<Params>(params)...);
 }
 
+/**
+ * Log a message formatted with a STATIC_FORMAT() string, e.g.
+ * LogFormat(3, domain, STATIC_FORMAT("{} failed: {}"), name, error).
+ */
+template<typename D, typename S, typename... Params>
+typename std::enable_if<IsStaticFormatString<S>::value>::type
+LogFormat(unsigned level, D &&domain, S fmt, Params&&... params) noexcept
+{
+	LoggerDetail::Format(level, std::forward<D>(domain),
+			     fmt, std::forward<Params>(params)...);
+}
+
 template<typename Domain>
 class BasicLogger : public Domain {
 public:
@@ -282,6 +386,13 @@ public:
 					std::forward<Params>(params)...);
 	}
 
+	template<typename... Params>
+	void Structured(unsigned level, uint32_t message_id,
+			Params... params) const noexcept {
+		LoggerDetail::LogStructured(level, GetDomain(), message_id,
+					    std::forward<Params>(params)...);
+	}
+
 	template<typename... Params>
 	void Format(unsigned level,
 		    const char *fmt, Params... params) const noexcept {
@@ -289,6 +400,13 @@ public:
 				     fmt, std::forward<Params>(params)...);
 	}
 
+	template<typename S, typename... Params>
+	typename std::enable_if<IsStaticFormatString<S>::value>::type
+	Format(unsigned level, S fmt, Params&&... params) const noexcept {
+		LoggerDetail::Format(level, GetDomain(),
+				     fmt, std::forward<Params>(params)...);
+	}
+
 	StringView GetDomain() const {
 		return Domain::GetDomain();
 	}
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "MirroredFifoBuffer.hxx"
+#include "UniqueFileDescriptor.hxx"
+#include "system/Error.hxx"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+
+static size_t
+RoundUpToPageSize(size_t size) noexcept
+{
+	static const size_t page_size = sysconf(_SC_PAGESIZE);
+
+	if (size == 0)
+		size = 1;
+
+	return (size + page_size - 1) / page_size * page_size;
+}
+
+MirroredMapping::MirroredMapping(size_t min_size)
+	:size(RoundUpToPageSize(min_size))
+{
+	UniqueFileDescriptor fd(FileDescriptor(int(syscall(__NR_memfd_create,
+							   "MirroredMapping",
+							   MFD_CLOEXEC))));
+	if (!fd.IsDefined())
+		throw MakeErrno("memfd_create() failed");
+
+	if (ftruncate(fd.Get(), size) < 0)
+		throw MakeErrno("ftruncate() failed");
+
+	/* reserve an address range for both halves, then map the
+	   memfd over it twice */
+	auto *p = (uint8_t *)mmap(nullptr, 2 * size, PROT_NONE,
+				  MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE,
+				  -1, 0);
+	if (p == (uint8_t *)MAP_FAILED)
+		throw MakeErrno("mmap() failed");
+
+	if (mmap(p, size, PROT_READ|PROT_WRITE,
+		 MAP_SHARED|MAP_FIXED, fd.Get(), 0) == MAP_FAILED ||
+	    mmap(p + size, size, PROT_READ|PROT_WRITE,
+		 MAP_SHARED|MAP_FIXED, fd.Get(), 0) == MAP_FAILED) {
+		const int e = errno;
+		munmap(p, 2 * size);
+		throw MakeErrno(e, "mmap() failed");
+	}
+
+	data = p;
+}
+
+MirroredMapping::~MirroredMapping() noexcept
+{
+	if (data != nullptr)
+		munmap(data, 2 * size);
+}
@@ -0,0 +1,280 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include "util/WritableBuffer.hxx"
+
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+#include <assert.h>
+#include <stddef.h>
+
+/**
+ * An anonymous shared memory area which is mapped twice into
+ * adjacent virtual address ranges, i.e. the byte at offset `size+i`
+ * is the same as the byte at offset `i`.  This allows a ring buffer
+ * to present every readable and writable region as one contiguous
+ * span.
+ */
+class MirroredMapping {
+	void *data = nullptr;
+	size_t size = 0;
+
+public:
+	MirroredMapping() = default;
+
+	/**
+	 * Throws std::system_error on error.
+	 *
+	 * @param min_size the minimum size; it is rounded up to a
+	 * multiple of the page size
+	 */
+	explicit MirroredMapping(size_t min_size);
+
+	~MirroredMapping() noexcept;
+
+	MirroredMapping(MirroredMapping &&src) noexcept
+		:data(std::exchange(src.data, nullptr)),
+		 size(std::exchange(src.size, 0)) {}
+
+	MirroredMapping &operator=(MirroredMapping &&src) noexcept {
+		std::swap(data, src.data);
+		std::swap(size, src.size);
+		return *this;
+	}
+
+	bool IsDefined() const noexcept {
+		return data != nullptr;
+	}
+
+	/**
+	 * Returns the start of the mapping; `2 * GetSize()` bytes are
+	 * accessible.
+	 */
+	void *Get() const noexcept {
+		return data;
+	}
+
+	/**
+	 * Returns the size of one half of the mapping.
+	 */
+	size_t GetSize() const noexcept {
+		return size;
+	}
+};
+
+/**
+ * A first-in-first-out ring buffer backed by a #MirroredMapping.
+ * Unlike #DynamicFifoBuffer, it never needs to shift data to the
+ * front: the readable and the writable regions are always
+ * contiguous, even when they wrap around the end of the buffer.  It
+ * is not thread safe.
+ *
+ * The capacity is rounded up to a multiple of the page size, and
+ * each buffer costs a memfd and two mappings, so this is meant for
+ * long-lived buffers on hot paths, not for many short-lived ones.
+ */
+template<typename T>
+class MirroredFifoBuffer {
+	static_assert(std::is_trivially_copyable<T>::value,
+		      "T must be trivially copyable");
+	static_assert((sizeof(T) & (sizeof(T) - 1)) == 0,
+		      "sizeof(T) must be a power of two");
+
+public:
+	typedef size_t size_type;
+	typedef WritableBuffer<T> Range;
+	typedef typename Range::pointer_type pointer_type;
+	typedef typename Range::const_pointer_type const_pointer_type;
+
+private:
+	MirroredMapping mapping;
+
+	T *data;
+	size_type capacity;
+
+	/**
+	 * The position of the first readable element; always less
+	 * than #capacity.
+	 */
+	size_type head = 0;
+
+	/**
+	 * The number of readable elements.
+	 */
+	size_type fill = 0;
+
+public:
+	/**
+	 * Throws std::system_error on error.
+	 */
+	explicit MirroredFifoBuffer(size_type min_capacity)
+		:mapping(min_capacity * sizeof(T)),
+		 data((T *)mapping.Get()),
+		 capacity(mapping.GetSize() / sizeof(T)) {}
+
+	MirroredFifoBuffer(MirroredFifoBuffer &&src) noexcept
+		:mapping(std::move(src.mapping)),
+		 data(std::exchange(src.data, nullptr)),
+		 capacity(std::exchange(src.capacity, 0)),
+		 head(std::exchange(src.head, 0)),
+		 fill(std::exchange(src.fill, 0)) {}
+
+	MirroredFifoBuffer &operator=(MirroredFifoBuffer &&src) noexcept {
+		std::swap(mapping, src.mapping);
+		std::swap(data, src.data);
+		std::swap(capacity, src.capacity);
+		std::swap(head, src.head);
+		std::swap(fill, src.fill);
+		return *this;
+	}
+
+	size_type GetCapacity() const noexcept {
+		return capacity;
+	}
+
+	void Clear() noexcept {
+		head = fill = 0;
+	}
+
+	bool IsEmpty() const noexcept {
+		return fill == 0;
+	}
+
+	bool IsFull() const noexcept {
+		return fill == capacity;
+	}
+
+	size_type GetAvailable() const noexcept {
+		return fill;
+	}
+
+	/**
+	 * Return a buffer range which may be read.  The buffer pointer is
+	 * writable, to allow modifications while parsing.
+	 */
+	Range Read() const noexcept {
+		return Range(data + head, fill);
+	}
+
+	/**
+	 * Marks a chunk as consumed.
+	 */
+	void Consume(size_type n) noexcept {
+		assert(n <= fill);
+
+		fill -= n;
+		if (fill == 0)
+			/* restart at the front, where the pages are
+			   probably still in the cache */
+			head = 0;
+		else {
+			head += n;
+			if (head >= capacity)
+				head -= capacity;
+		}
+	}
+
+	/**
+	 * Prepares writing.  Returns a buffer range which may be
+	 * written; it is all free space.  When you are finished, call
+	 * Append().
+	 */
+	Range Write() noexcept {
+		return Range(data + head + fill, capacity - fill);
+	}
+
+	/**
+	 * Expands the tail of the buffer, after data has been written to
+	 * the buffer returned by Write().
+	 */
+	void Append(size_type n) noexcept {
+		assert(n <= capacity - fill);
+
+		fill += n;
+	}
+
+	/**
+	 * Replace the mapping with a larger one.  This copies the
+	 * readable data once.
+	 *
+	 * Throws std::system_error on error.
+	 */
+	void Grow(size_type new_capacity) {
+		assert(new_capacity > GetCapacity());
+
+		MirroredMapping new_mapping(new_capacity * sizeof(T));
+		T *new_data = (T *)new_mapping.Get();
+		std::copy_n(data + head, fill, new_data);
+
+		mapping = std::move(new_mapping);
+		data = new_data;
+		capacity = mapping.GetSize() / sizeof(T);
+		head = 0;
+	}
+
+	/**
+	 * Ensure that at least the given number of elements can be
+	 * written, growing the buffer as needed.
+	 */
+	void WantWrite(size_type n) {
+		const size_type required_capacity = fill + n;
+		if (required_capacity <= capacity)
+			return;
+
+		size_type new_capacity = capacity;
+		do {
+			new_capacity <<= 1;
+		} while (new_capacity < required_capacity);
+
+		Grow(new_capacity);
+	}
+
+	/**
+	 * Write data to the buffer, growing it as needed.  Returns a
+	 * writable pointer.
+	 */
+	pointer_type Write(size_type n) {
+		WantWrite(n);
+		return Write().data;
+	}
+
+	/**
+	 * Append data to the buffer, growing it as needed.
+	 */
+	void Append(const_pointer_type p, size_type n) {
+		std::copy_n(p, n, Write(n));
+		Append(n);
+	}
+};
@@ -33,22 +33,15 @@
 #include "MultiWriteBuffer.hxx"
 #include "system/Error.hxx"
 
-#include <sys/uio.h>
 #include <errno.h>
+#include <stdint.h>
 
 MultiWriteBuffer::Result
 MultiWriteBuffer::Write(int fd)
 {
     assert(i < n);
 
-    std::array<iovec, MAX_BUFFERS> iov;
-
-    for (unsigned k = i; k != n; ++k) {
-        iov[k].iov_base = const_cast<void *>(buffers[k].GetData());
-        iov[k].iov_len = buffers[k].GetSize();
-    };
-
-    ssize_t nbytes = writev(fd, &iov[i], n - i);
+    ssize_t nbytes = writev(fd, &buffers[i], n - i);
     if (nbytes < 0) {
         switch (errno) {
         case EAGAIN:
@@ -61,13 +54,14 @@ MultiWriteBuffer::Write(int fd)
     }
 
     while (i != n) {
-        WriteBuffer &b = buffers[i];
-        if (size_t(nbytes) < b.GetSize()) {
-            b.buffer += nbytes;
+        auto &b = buffers[i];
+        if (size_t(nbytes) < b.iov_len) {
+            b.iov_base = (uint8_t *)b.iov_base + nbytes;
+            b.iov_len -= nbytes;
             return Result::MORE;
         }
 
-        nbytes -= b.GetSize();
+        nbytes -= b.iov_len;
         ++i;
     }
 
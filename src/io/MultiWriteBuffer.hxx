@@ -39,20 +39,34 @@
 #include <cstddef>
 #include <cassert>
 
+#include <sys/uio.h>
+
 class MultiWriteBuffer {
-    static constexpr size_t MAX_BUFFERS = 32;
+public:
+    static constexpr size_t MAX_BUFFERS = 128;
 
+private:
     unsigned i = 0, n = 0;
 
-    std::array<WriteBuffer, MAX_BUFFERS> buffers;
+    /**
+     * The buffers are stored as #iovec so Write() can pass them
+     * to writev() without copying.
+     */
+    std::array<struct iovec, MAX_BUFFERS> buffers;
 
 public:
     typedef WriteBuffer::Result Result;
 
+    bool IsFull() const {
+        return n == buffers.size();
+    }
+
     void Push(const void *buffer, size_t size) {
         assert(n < buffers.size());
 
-        buffers[n++] = WriteBuffer(buffer, size);
+        auto &v = buffers[n++];
+        v.iov_base = const_cast<void *>(buffer);
+        v.iov_len = size;
     }
 
     /**
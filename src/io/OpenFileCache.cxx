@@ -0,0 +1,236 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "OpenFileCache.hxx"
+#include "system/Error.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+static constexpr uint32_t WATCH_MASK =
+	IN_ATTRIB|IN_CLOSE_WRITE|IN_CREATE|IN_DELETE|IN_DELETE_SELF|
+	IN_MODIFY|IN_MOVE_SELF|IN_MOVED_FROM|IN_MOVED_TO|IN_ONLYDIR;
+
+OpenFileCache::OpenFileCache()
+{
+	if (!inotify_fd.CreateInotify())
+		throw MakeErrno("inotify_init1() failed");
+}
+
+OpenFileCache::~OpenFileCache() noexcept
+{
+	/* the watches are removed implicitly by closing the inotify
+	   file descriptor */
+}
+
+/**
+ * Returns the key prefix of the directory containing the given path
+ * (see OpenFileCache::Directory::prefix).
+ */
+static std::string
+GetDirectoryPrefix(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+	if (slash == nullptr)
+		return std::string();
+
+	return std::string(path, slash + 1);
+}
+
+int
+OpenFileCache::AddWatch(const char *path) noexcept
+{
+	try {
+		auto prefix = GetDirectoryPrefix(path);
+		const char *directory = prefix.empty()
+			? "."
+			: prefix.c_str();
+
+		const int wd = inotify_add_watch(inotify_fd.Get(), directory,
+						 WATCH_MASK);
+		if (wd < 0)
+			return -1;
+
+		/* inotify returns the same watch descriptor for the
+		   same directory */
+		auto &d = directories[wd];
+		if (std::find(d.prefixes.begin(), d.prefixes.end(),
+			      prefix) == d.prefixes.end())
+			d.prefixes.emplace_back(std::move(prefix));
+
+		++d.n_items;
+		return wd;
+	} catch (...) {
+		return -1;
+	}
+}
+
+void
+OpenFileCache::ReleaseWatch(int wd) noexcept
+{
+	auto i = directories.find(wd);
+	if (i == directories.end())
+		/* already removed by the kernel (IN_IGNORED) */
+		return;
+
+	assert(i->second.n_items > 0);
+	if (--i->second.n_items == 0) {
+		inotify_rm_watch(inotify_fd.Get(), wd);
+		directories.erase(i);
+	}
+}
+
+const OpenFileCache::Item &
+OpenFileCache::Open(const char *path)
+{
+	uncached.fd.Close();
+
+	auto *item = cache.Get(std::string(path));
+	if (item != nullptr)
+		return *item;
+
+	UniqueFileDescriptor fd;
+	if (!fd.OpenReadOnly(path))
+		throw FormatErrno("Failed to open %s", path);
+
+	struct stat st;
+	if (fstat(fd.Get(), &st) < 0)
+		throw FormatErrno("Failed to stat %s", path);
+
+	/* add the watch before the file may be modified again, or
+	   we might miss the event */
+	const int wd = AddWatch(path);
+	if (wd < 0) {
+		uncached = Item(std::move(fd), st, -1);
+		return uncached;
+	}
+
+	if (cache.IsFull()) {
+		auto &oldest = *cache.PeekOldest();
+		ReleaseWatch(oldest.wd);
+		cache.RemoveItem(oldest);
+	}
+
+	return cache.Put(std::string(path), Item(std::move(fd), st, wd));
+}
+
+void
+OpenFileCache::Invalidate(const char *path) noexcept
+{
+	try {
+		auto *item = cache.Get(std::string(path));
+		if (item != nullptr) {
+			ReleaseWatch(item->wd);
+			cache.RemoveItem(*item);
+		}
+	} catch (...) {
+		/* out of memory: play safe */
+		Clear();
+	}
+}
+
+void
+OpenFileCache::Clear() noexcept
+{
+	cache.Clear();
+
+	for (const auto &i : directories)
+		inotify_rm_watch(inotify_fd.Get(), i.first);
+	directories.clear();
+}
+
+void
+OpenFileCache::InvalidateDirectory(int wd) noexcept
+{
+	cache.RemoveIf([wd](const std::string &, const Item &item){
+			return item.wd == wd;
+		});
+
+	directories.erase(wd);
+}
+
+void
+OpenFileCache::HandleInotifyEvents() noexcept
+{
+	alignas(struct inotify_event) char buffer[4096];
+
+	while (true) {
+		ssize_t nbytes = read(inotify_fd.Get(), buffer, sizeof(buffer));
+		if (nbytes <= 0)
+			break;
+
+		const char *p = buffer, *const end = buffer + nbytes;
+		while (p < end) {
+			const auto &event = *(const struct inotify_event *)p;
+			p += sizeof(event) + event.len;
+
+			if (event.mask & IN_Q_OVERFLOW) {
+				/* we lost events; start over */
+				Clear();
+				continue;
+			}
+
+			auto i = directories.find(event.wd);
+			if (i == directories.end())
+				continue;
+
+			if (event.mask & (IN_IGNORED|IN_DELETE_SELF|IN_MOVE_SELF)) {
+				/* the directory itself has vanished;
+				   IN_IGNORED means the kernel has
+				   removed the watch */
+				if (!(event.mask & IN_IGNORED))
+					inotify_rm_watch(inotify_fd.Get(),
+							 event.wd);
+				InvalidateDirectory(event.wd);
+				continue;
+			}
+
+			if (event.len > 0) {
+				try {
+					/* copy the prefixes, because
+					   Invalidate() may delete the
+					   Directory */
+					const auto prefixes = i->second.prefixes;
+					for (const auto &prefix : prefixes)
+						Invalidate((prefix + event.name).c_str());
+				} catch (...) {
+					Clear();
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "UniqueFileDescriptor.hxx"
+#include "util/Cache.hxx"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+/**
+ * A cache of open (read-only) file descriptors with their fstat()
+ * metadata, keyed by path.  The least recently used file is closed
+ * when the cache is full.  Entries are invalidated with inotify
+ * watches on their parent directories, which catch modifications,
+ * deletions and replacements (e.g. by #FileWriter).
+ *
+ * The inotify file descriptor must be registered with the caller's
+ * event loop; HandleInotifyEvents() shall be called whenever it
+ * becomes readable.
+ *
+ * Since the file descriptors are shared by all callers, they must
+ * not modify the file position; use pread() or sendfile() with an
+ * explicit offset.
+ *
+ * This class is not thread-safe.
+ */
+class OpenFileCache {
+public:
+	struct Item {
+		UniqueFileDescriptor fd;
+
+		struct stat st;
+
+		/**
+		 * The inotify watch descriptor of the parent
+		 * directory, or -1 if this item is not cached.
+		 */
+		int wd;
+
+		Item(UniqueFileDescriptor &&_fd, const struct stat &_st,
+		     int _wd) noexcept
+			:fd(std::move(_fd)), st(_st), wd(_wd) {}
+
+		Item(Item &&) = default;
+		Item &operator=(Item &&) = default;
+
+		FileDescriptor GetFileDescriptor() const noexcept {
+			return fd.ToFileDescriptor();
+		}
+	};
+
+	static constexpr size_t MAX_FILES = 1024;
+
+private:
+	UniqueFileDescriptor inotify_fd;
+
+	Cache<std::string, Item, MAX_FILES, 1021> cache;
+
+	struct Directory {
+		/**
+		 * The paths of the directory with a trailing slash,
+		 * or an empty string for the current working
+		 * directory; these are the key prefixes of all files
+		 * in this directory.  Usually, there is only one, but
+		 * different spellings of the same directory share
+		 * one inotify watch.
+		 */
+		std::vector<std::string> prefixes;
+
+		/**
+		 * The number of cached items in this directory.
+		 */
+		unsigned n_items = 0;
+	};
+
+	/**
+	 * Maps inotify watch descriptors to directories.
+	 */
+	std::map<int, Directory> directories;
+
+	/**
+	 * Holds a file which could not be added to the cache (e.g.
+	 * because the inotify watch failed), until the next Open()
+	 * call.
+	 */
+	Item uncached{UniqueFileDescriptor(), {}, -1};
+
+public:
+	/**
+	 * Throws std::system_error on error.
+	 */
+	OpenFileCache();
+
+	~OpenFileCache() noexcept;
+
+	OpenFileCache(const OpenFileCache &) = delete;
+	OpenFileCache &operator=(const OpenFileCache &) = delete;
+
+	FileDescriptor GetInotifyFileDescriptor() const noexcept {
+		return inotify_fd.ToFileDescriptor();
+	}
+
+	/**
+	 * Open the given file, or return the cached file descriptor.
+	 * The returned reference is valid until the next call to a
+	 * non-const method.
+	 *
+	 * Throws std::system_error on error.
+	 */
+	const Item &Open(const char *path);
+
+	/**
+	 * Close the given file if it is in the cache.
+	 */
+	void Invalidate(const char *path) noexcept;
+
+	/**
+	 * Close all files.
+	 */
+	void Clear() noexcept;
+
+	/**
+	 * Read all pending inotify events and invalidate the affected
+	 * files.  This never blocks.
+	 */
+	void HandleInotifyEvents() noexcept;
+
+private:
+	/**
+	 * Add an inotify watch on the parent directory of the given
+	 * path.
+	 *
+	 * @return the watch descriptor, or -1 on error
+	 */
+	int AddWatch(const char *path) noexcept;
+
+	/**
+	 * Release the directory watch of an item which is being
+	 * removed from the cache.
+	 */
+	void ReleaseWatch(int wd) noexcept;
+
+	void InvalidateDirectory(int wd) noexcept;
+};
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "PipePool.hxx"
+#include "system/Error.hxx"
+
+#include <fcntl.h>
+#include <assert.h>
+
+PipePool::Pipe
+PipePool::Create()
+{
+	Pipe pipe;
+	if (!UniqueFileDescriptor::CreatePipeNonBlock(pipe.r, pipe.w))
+		throw MakeErrno("pipe() failed");
+
+#ifdef F_SETPIPE_SZ
+	if (capacity > 0)
+		/* failure is not fatal; the pipe just keeps its
+		   default capacity */
+		fcntl(pipe.w.Get(), F_SETPIPE_SZ, int(capacity));
+#endif
+
+	return pipe;
+}
+
+PipePool::Pipe
+PipePool::Get()
+{
+	if (idle.empty())
+		return Create();
+
+	Pipe pipe = std::move(idle.back());
+	idle.pop_back();
+	return pipe;
+}
+
+void
+PipePool::Put(Pipe &&pipe) noexcept
+{
+	assert(pipe.IsDefined());
+
+	if (idle.size() < max_idle) {
+		try {
+			idle.emplace_back(std::move(pipe));
+		} catch (...) {
+			/* out of memory: just close the pipe */
+		}
+	}
+}
+
+void
+PipePool::Reserve(size_t n)
+{
+	if (n > max_idle)
+		n = max_idle;
+
+	while (idle.size() < n)
+		idle.emplace_back(Create());
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "UniqueFileDescriptor.hxx"
+
+#include <vector>
+
+#include <stddef.h>
+
+/**
+ * A pool of non-blocking pipes which are used as intermediate
+ * buffers for splice().  Recycling pipes saves the pipe2() and
+ * fcntl(F_SETPIPE_SZ) system calls for each transfer.
+ *
+ * This class is not thread-safe.
+ */
+class PipePool {
+public:
+	struct Pipe {
+		UniqueFileDescriptor r, w;
+
+		bool IsDefined() const noexcept {
+			return r.IsDefined();
+		}
+	};
+
+private:
+	/**
+	 * The desired pipe capacity in bytes (F_SETPIPE_SZ); 0 means
+	 * the kernel's default.
+	 */
+	const size_t capacity;
+
+	/**
+	 * The maximum number of idle pipes kept in the pool.
+	 */
+	const size_t max_idle;
+
+	std::vector<Pipe> idle;
+
+public:
+	explicit PipePool(size_t _capacity=0, size_t _max_idle=16) noexcept
+		:capacity(_capacity), max_idle(_max_idle) {}
+
+	PipePool(const PipePool &) = delete;
+	PipePool &operator=(const PipePool &) = delete;
+
+	size_t GetIdleCount() const noexcept {
+		return idle.size();
+	}
+
+	/**
+	 * Obtain a pipe, either a recycled one or a new one.
+	 *
+	 * Throws std::system_error on error.
+	 */
+	Pipe Get();
+
+	/**
+	 * Return a pipe obtained by Get() to the pool.  The pipe
+	 * must be empty; a pipe which still contains data must be
+	 * closed instead.
+	 */
+	void Put(Pipe &&pipe) noexcept;
+
+	/**
+	 * Create pipes until there are at least the given number of
+	 * idle pipes.
+	 *
+	 * Throws std::system_error on error.
+	 */
+	void Reserve(size_t n);
+
+	/**
+	 * Close all idle pipes.
+	 */
+	void Clear() noexcept {
+		idle.clear();
+	}
+
+private:
+	Pipe Create();
+};
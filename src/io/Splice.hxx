@@ -55,6 +55,47 @@ SpliceToPipe(int src_fd, int dest_fd, size_t max_length)
     return Splice(src_fd, dest_fd, max_length);
 }
 
+/**
+ * The granularity of the page cache hints issued by SendFile().
+ */
+static constexpr unsigned SENDFILE_WINDOW_SHIFT = 21; // 2 MiB
+
+/**
+ * Copy data from a regular file to a socket with sendfile(),
+ * starting at the given offset (which is updated).  The file's
+ * position is not modified, so the file descriptor may be shared.
+ *
+ * Each time the offset crosses a window boundary, the next window is
+ * announced with POSIX_FADV_WILLNEED.  This doesn't depend on the
+ * kernel's per-file readahead state, which gets confused when
+ * several transfers share one file descriptor.
+ *
+ * @param one_shot the file will not be sent again soon; drop each
+ * completed window from the page cache instead of evicting other
+ * (hotter) files
+ */
+static inline ssize_t
+SendFile(int src_fd, off_t &offset, int dest_fd, size_t max_length,
+         bool one_shot=false)
+{
+    assert(src_fd != dest_fd);
+
+    const off_t old_offset = offset;
+    ssize_t nbytes = sendfile(dest_fd, src_fd, &offset, max_length);
+    if (nbytes > 0 &&
+        (old_offset >> SENDFILE_WINDOW_SHIFT) != (offset >> SENDFILE_WINDOW_SHIFT)) {
+        constexpr off_t window_size = off_t(1) << SENDFILE_WINDOW_SHIFT;
+        const off_t window = offset & ~(window_size - 1);
+
+        posix_fadvise(src_fd, window, window_size, POSIX_FADV_WILLNEED);
+
+        if (one_shot)
+            posix_fadvise(src_fd, 0, window, POSIX_FADV_DONTNEED);
+    }
+
+    return nbytes;
+}
+
 static inline ssize_t
 SpliceToSocket(FdType src_type, int src_fd,
                int dest_fd, size_t max_length)
@@ -0,0 +1,264 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "StructuredLog.hxx"
+#include "util/ByteOrder.hxx"
+#include "util/Exception.hxx"
+
+#include <algorithm>
+
+#include <string.h>
+#include <sys/socket.h>
+
+namespace StructuredLog {
+
+Sink *Detail::sink;
+
+namespace {
+
+/**
+ * Appends to a fixed-size buffer; once something did not fit, all
+ * further writes are ignored and IsOverflow() returns true.
+ */
+class SerializeBuffer {
+	uint8_t *p;
+	uint8_t *const end;
+
+public:
+	SerializeBuffer(void *buffer, size_t size) noexcept
+		:p((uint8_t *)buffer), end(p + size) {}
+
+	bool IsOverflow() const noexcept {
+		return p == nullptr;
+	}
+
+	uint8_t *GetPosition() const noexcept {
+		return p;
+	}
+
+	void Write(const void *src, size_t size) noexcept {
+		if (p == nullptr)
+			return;
+
+		if (size_t(end - p) < size) {
+			p = nullptr;
+			return;
+		}
+
+		memcpy(p, src, size);
+		p += size;
+	}
+
+	void WriteU8(uint8_t value) noexcept {
+		Write(&value, sizeof(value));
+	}
+
+	void WriteU16(uint16_t value) noexcept {
+		value = ToBE16(value);
+		Write(&value, sizeof(value));
+	}
+
+	void WriteU32(uint32_t value) noexcept {
+		value = ToBE32(value);
+		Write(&value, sizeof(value));
+	}
+
+	void WriteU64(uint64_t value) noexcept {
+		value = ToBE64(value);
+		Write(&value, sizeof(value));
+	}
+
+	void WriteString(StringView s) noexcept {
+		const size_t length = std::min<size_t>(s.size, 0xffff);
+		WriteU16(length);
+		Write(s.data, length);
+	}
+};
+
+class DeserializeBuffer {
+	const uint8_t *p;
+	const uint8_t *const end;
+
+public:
+	DeserializeBuffer(const void *buffer, size_t size) noexcept
+		:p((const uint8_t *)buffer), end(p + size) {}
+
+	bool IsEnd() const noexcept {
+		return p == end;
+	}
+
+	const void *Read(size_t size) {
+		if (size_t(end - p) < size)
+			throw ProtocolError();
+
+		const void *result = p;
+		p += size;
+		return result;
+	}
+
+	uint8_t ReadU8() {
+		return *(const uint8_t *)Read(sizeof(uint8_t));
+	}
+
+	uint16_t ReadU16() {
+		uint16_t value;
+		memcpy(&value, Read(sizeof(value)), sizeof(value));
+		return FromBE16(value);
+	}
+
+	uint32_t ReadU32() {
+		uint32_t value;
+		memcpy(&value, Read(sizeof(value)), sizeof(value));
+		return FromBE32(value);
+	}
+
+	uint64_t ReadU64() {
+		uint64_t value;
+		memcpy(&value, Read(sizeof(value)), sizeof(value));
+		return FromBE64(value);
+	}
+
+	StringView ReadString() {
+		const size_t length = ReadU16();
+		return {(const char *)Read(length), length};
+	}
+};
+
+}
+
+/*
+ * Wire format (all numbers big-endian):
+ *
+ * - uint32_t magic (#MAGIC)
+ * - uint32_t message id
+ * - uint8_t level
+ * - uint8_t number of parameters
+ * - string domain
+ * - for each parameter: uint8_t type (#Param::Type), followed by a
+ *   string or an uint64_t
+ *
+ * Strings are prefixed with an uint16_t length and are not
+ * null-terminated.
+ */
+
+size_t
+Serialize(void *buffer, size_t size, const Record &record) noexcept
+{
+	if (record.params.size > MAX_PARAMS)
+		return 0;
+
+	SerializeBuffer b(buffer, size);
+	b.WriteU32(MAGIC);
+	b.WriteU32(record.message_id);
+	b.WriteU8(std::min(record.level, 0xffu));
+	b.WriteU8(record.params.size);
+	b.WriteString(record.domain);
+
+	for (const auto &i : record.params) {
+		b.WriteU8(uint8_t(i.type));
+
+		switch (i.type) {
+		case Param::Type::STRING:
+			b.WriteString(i.string_value);
+			break;
+
+		case Param::Type::SIGNED:
+		case Param::Type::UNSIGNED:
+			b.WriteU64(i.unsigned_value);
+			break;
+		}
+	}
+
+	if (b.IsOverflow())
+		return 0;
+
+	return b.GetPosition() - (uint8_t *)buffer;
+}
+
+Record
+Parse(const void *buffer, size_t size, Param *params, size_t max_params)
+{
+	DeserializeBuffer b(buffer, size);
+	if (b.ReadU32() != MAGIC)
+		throw ProtocolError();
+
+	Record record;
+	record.message_id = b.ReadU32();
+	record.level = b.ReadU8();
+
+	const size_t n_params = b.ReadU8();
+	if (n_params > max_params)
+		throw ProtocolError();
+
+	record.domain = b.ReadString();
+
+	for (size_t i = 0; i < n_params; ++i) {
+		auto &param = params[i];
+		param.type = Param::Type(b.ReadU8());
+
+		switch (param.type) {
+		case Param::Type::STRING:
+			param.unsigned_value = 0;
+			param.string_value = b.ReadString();
+			break;
+
+		case Param::Type::SIGNED:
+		case Param::Type::UNSIGNED:
+			param.unsigned_value = b.ReadU64();
+			param.string_value = nullptr;
+			break;
+
+		default:
+			throw ProtocolError();
+		}
+	}
+
+	if (!b.IsEnd())
+		throw ProtocolError();
+
+	record.params = {params, n_params};
+	return record;
+}
+
+void
+DatagramSink::OnLogRecord(const Record &record) noexcept
+{
+	uint8_t buffer[16384];
+	size_t size = Serialize(buffer, sizeof(buffer), record);
+	if (size > 0)
+		send(fd.Get(), buffer, size, MSG_DONTWAIT|MSG_NOSIGNAL);
+}
+
+} /* namespace StructuredLog */
+
+LoggerDetail::StructuredParamWrapper<std::exception_ptr>::StructuredParamWrapper(std::exception_ptr ep)
+	:value(GetFullMessage(ep)) {}
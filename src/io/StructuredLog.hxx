@@ -0,0 +1,292 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "FileDescriptor.hxx"
+#include "util/StringView.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Compiler.h"
+
+#include <exception>
+#include <string>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A structured binary representation of log messages: instead of
+ * formatting a text line, the level, the domain, a message id and
+ * the raw parameter values are recorded, and formatting is left to
+ * the reader.
+ */
+namespace StructuredLog {
+
+/**
+ * The magic number at the beginning of a serialized #Record.
+ */
+static constexpr uint32_t MAGIC = 0x534c4f47; // "SLOG"
+
+class ProtocolError {};
+
+/**
+ * Calculate a message id from a string at compile time.  Use this
+ * with "constexpr", e.g.:
+ *
+ *     static constexpr uint32_t CONNECT_FAILED =
+ *         StructuredLog::MakeMessageId("connect_failed");
+ */
+constexpr uint32_t
+MakeMessageId(const char *name) noexcept
+{
+	/* FNV-1a */
+	uint32_t hash = 2166136261u;
+	while (*name != 0)
+		hash = (hash ^ uint8_t(*name++)) * 16777619u;
+	return hash;
+}
+
+struct Param {
+	enum class Type : uint8_t {
+		STRING = 1,
+		SIGNED = 2,
+		UNSIGNED = 3,
+	};
+
+	Type type;
+
+	union {
+		int64_t signed_value;
+		uint64_t unsigned_value;
+	};
+
+	StringView string_value;
+
+	Param() = default;
+
+	constexpr Param(StringView _value) noexcept
+		:type(Type::STRING), unsigned_value(0),
+		 string_value(_value) {}
+
+	Param(const char *_value) noexcept
+		:Param(StringView(_value)) {}
+
+	Param(const std::string &_value) noexcept
+		:Param(StringView(_value.data(), _value.length())) {}
+
+	constexpr Param(int _value) noexcept
+		:type(Type::SIGNED), signed_value(_value),
+		 string_value(nullptr) {}
+
+	constexpr Param(long _value) noexcept
+		:type(Type::SIGNED), signed_value(_value),
+		 string_value(nullptr) {}
+
+	constexpr Param(unsigned _value) noexcept
+		:type(Type::UNSIGNED), unsigned_value(_value),
+		 string_value(nullptr) {}
+
+	constexpr Param(unsigned long _value) noexcept
+		:type(Type::UNSIGNED), unsigned_value(_value),
+		 string_value(nullptr) {}
+};
+
+struct Record {
+	unsigned level;
+
+	StringView domain;
+
+	uint32_t message_id;
+
+	ConstBuffer<Param> params;
+};
+
+/**
+ * Receives structured log records from LogStructured().
+ */
+class Sink {
+public:
+	virtual void OnLogRecord(const Record &record) noexcept = 0;
+};
+
+namespace Detail {
+extern Sink *sink;
+}
+
+/**
+ * Install a sink which receives all structured log records instead
+ * of the text logger.  Pass nullptr to uninstall.  This is not
+ * thread-safe; call it during startup.
+ */
+inline void
+SetSink(Sink *_sink) noexcept
+{
+	Detail::sink = _sink;
+}
+
+inline Sink *
+GetSink() noexcept
+{
+	return Detail::sink;
+}
+
+/**
+ * The maximum number of parameters in one #Record.
+ */
+static constexpr size_t MAX_PARAMS = 255;
+
+/**
+ * Serialize a #Record into the wire format understood by Parse().
+ * Strings longer than 64 kB are truncated.
+ *
+ * @return the number of bytes written to the buffer, or 0 if the
+ * buffer is too small
+ */
+size_t
+Serialize(void *buffer, size_t size, const Record &record) noexcept;
+
+/**
+ * Parse a serialized #Record.  The strings point into the buffer.
+ *
+ * Throws #ProtocolError on error.
+ *
+ * @param params a buffer for the parameters; the returned
+ * #Record::params points into it
+ * @param max_params the capacity of #params
+ */
+Record
+Parse(const void *buffer, size_t size,
+      Param *params, size_t max_params);
+
+/**
+ * A #Sink which serializes each record and sends it as one datagram
+ * to a connected socket, e.g. a Net::Log-style log server.  Records
+ * are dropped if the socket buffer is full.
+ */
+class DatagramSink final : public Sink {
+	const FileDescriptor fd;
+
+public:
+	explicit DatagramSink(FileDescriptor _fd) noexcept
+		:fd(_fd) {}
+
+	/* virtual methods from class Sink */
+	void OnLogRecord(const Record &record) noexcept override;
+};
+
+} /* namespace StructuredLog */
+
+namespace LoggerDetail {
+
+template<typename T>
+struct StructuredParamWrapper {
+	StructuredLog::Param value;
+
+	explicit StructuredParamWrapper(const T &_value) noexcept
+		:value(_value) {}
+
+	const StructuredLog::Param &GetValue() const noexcept {
+		return value;
+	}
+};
+
+template<>
+struct StructuredParamWrapper<std::exception_ptr> {
+	std::string value;
+
+	explicit StructuredParamWrapper(std::exception_ptr ep);
+
+	StructuredLog::Param GetValue() const noexcept {
+		return value;
+	}
+};
+
+template<typename... Params>
+class StructuredParamCollector;
+
+template<>
+class StructuredParamCollector<> {
+public:
+	static constexpr size_t Count() {
+		return 0;
+	}
+
+	template<typename O>
+	O Fill(O output) const noexcept {
+		return output;
+	}
+};
+
+template<typename T, typename... Rest>
+class StructuredParamCollector<T, Rest...> {
+	StructuredParamWrapper<T> first;
+	StructuredParamCollector<Rest...> rest;
+
+public:
+	explicit StructuredParamCollector(const T &t, const Rest &... _rest)
+		:first(t), rest(_rest...) {}
+
+	static constexpr size_t Count() {
+		return 1 + decltype(rest)::Count();
+	}
+
+	template<typename O>
+	O Fill(O output) const noexcept {
+		*output++ = first.GetValue();
+		return rest.Fill(output);
+	}
+};
+
+/**
+ * Convert all parameters; unlike #ParamArray, numbers are not
+ * formatted.  Strings are not copied, so the parameters must
+ * outlive this object.
+ */
+template<typename... Params>
+class StructuredParamArray {
+	StructuredParamCollector<Params...> collector;
+
+	/* one extra element so the array is never empty */
+	StructuredLog::Param values[sizeof...(Params) + 1];
+
+public:
+	explicit StructuredParamArray(const Params &... params)
+		:collector(params...) {
+		collector.Fill(values);
+	}
+
+	ConstBuffer<StructuredLog::Param> GetValues() const noexcept {
+		return {values, sizeof...(Params)};
+	}
+};
+
+} /* namespace LoggerDetail */
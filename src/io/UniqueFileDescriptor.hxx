@@ -133,6 +133,14 @@ public:
 	using FileDescriptor::Read;
 	using FileDescriptor::Write;
 
+#ifdef __linux__
+	using FileDescriptor::AdviseSequential;
+	using FileDescriptor::AdviseWillNeed;
+	using FileDescriptor::AdviseDontNeed;
+	using FileDescriptor::ReadAhead;
+	using FileDescriptor::GetResidentBytes;
+#endif
+
 #ifndef _WIN32
 	using FileDescriptor::Poll;
 	using FileDescriptor::WaitReadable;
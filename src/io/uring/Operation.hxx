@@ -0,0 +1,130 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+namespace Uring {
+
+class CancellableOperation;
+
+/**
+ * An asynchronous I/O operation to be queued in a #Queue instance.
+ */
+class Operation {
+	friend class CancellableOperation;
+
+	CancellableOperation *cancellable = nullptr;
+
+public:
+	Operation() = default;
+
+	~Operation() noexcept {
+		CancelUring();
+	}
+
+	Operation(const Operation &) = delete;
+	Operation &operator=(const Operation &) = delete;
+
+	/**
+	 * Are we waiting for the operation to complete?
+	 */
+	bool IsUringPending() const noexcept {
+		return cancellable != nullptr;
+	}
+
+	/**
+	 * Cancel the operation.  OnUringCompletion() will not be
+	 * invoked after this.
+	 *
+	 * Note that the kernel may still be accessing buffers which
+	 * were submitted with the operation; the caller is
+	 * responsible for keeping them valid until the kernel is done
+	 * with them.
+	 */
+	void CancelUring() noexcept;
+
+	/**
+	 * This method is called when the operation completes.
+	 *
+	 * @param res the result code; the meaning is specific to the
+	 * operation, but negative values usually mean an error has
+	 * occurred
+	 */
+	virtual void OnUringCompletion(int res) noexcept = 0;
+};
+
+/**
+ * Internal class which is registered as the `user_data` of a
+ * submission; it survives the #Operation to allow cancellation while
+ * the kernel still owns the submission.
+ */
+class CancellableOperation {
+	Operation *operation;
+
+public:
+	explicit CancellableOperation(Operation &_operation) noexcept
+		:operation(&_operation) {
+		operation->cancellable = this;
+	}
+
+	~CancellableOperation() noexcept {
+		if (operation != nullptr)
+			operation->cancellable = nullptr;
+	}
+
+	void Cancel() noexcept {
+		if (operation != nullptr) {
+			operation->cancellable = nullptr;
+			operation = nullptr;
+		}
+	}
+
+	void OnUringCompletion(int res) noexcept {
+		if (operation == nullptr)
+			/* canceled */
+			return;
+
+		auto &o = *operation;
+		o.cancellable = nullptr;
+		operation = nullptr;
+		o.OnUringCompletion(res);
+	}
+};
+
+inline void
+Operation::CancelUring() noexcept
+{
+	if (cancellable != nullptr)
+		cancellable->Cancel();
+}
+
+} /* namespace Uring */
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Queue.hxx"
+#include "Operation.hxx"
+
+#include <stdexcept>
+
+#include <assert.h>
+
+namespace Uring {
+
+Queue::Queue(unsigned entries, unsigned flags)
+	:ring(entries, flags)
+{
+}
+
+struct io_uring_sqe &
+Queue::RequireSubmitEntry()
+{
+	auto *sqe = GetSubmitEntry();
+	if (sqe == nullptr) {
+		/* the submit queue is full; submit it to the kernel
+		   and try again */
+		Submit();
+
+		sqe = GetSubmitEntry();
+		if (sqe == nullptr)
+			throw std::runtime_error("io_uring_get_sqe() failed");
+	}
+
+	return *sqe;
+}
+
+void
+Queue::Push(struct io_uring_sqe &sqe, Operation &operation) noexcept
+{
+	operation.CancelUring();
+
+	auto *c = new CancellableOperation(operation);
+	io_uring_sqe_set_data(&sqe, c);
+	++n_pending;
+}
+
+void
+Queue::PushRead(FileDescriptor fd, void *buffer, size_t size,
+		off_t offset, Operation &operation)
+{
+	auto &sqe = RequireSubmitEntry();
+	io_uring_prep_read(&sqe, fd.Get(), buffer, size, offset);
+	Push(sqe, operation);
+}
+
+void
+Queue::PushWrite(FileDescriptor fd, const void *buffer, size_t size,
+		 off_t offset, Operation &operation)
+{
+	auto &sqe = RequireSubmitEntry();
+	io_uring_prep_write(&sqe, fd.Get(), buffer, size, offset);
+	Push(sqe, operation);
+}
+
+void
+Queue::PushAccept(SocketDescriptor fd,
+		  struct sockaddr *address, socklen_t *address_length,
+		  int flags, Operation &operation)
+{
+	auto &sqe = RequireSubmitEntry();
+	io_uring_prep_accept(&sqe, fd.Get(), address, address_length, flags);
+	Push(sqe, operation);
+}
+
+void
+Queue::PushTimeout(struct __kernel_timespec &ts, Operation &operation)
+{
+	auto &sqe = RequireSubmitEntry();
+	io_uring_prep_timeout(&sqe, &ts, 0, 0);
+	Push(sqe, operation);
+}
+
+inline void
+Queue::DispatchOneCompletion(struct io_uring_cqe &cqe) noexcept
+{
+	auto *c = (CancellableOperation *)io_uring_cqe_get_data(&cqe);
+	const int res = cqe.res;
+	ring.SeenCompletion(cqe);
+
+	if (c == nullptr)
+		/* an entry which was submitted without an
+		   #Operation */
+		return;
+
+	assert(n_pending > 0);
+	--n_pending;
+
+	c->OnUringCompletion(res);
+	delete c;
+}
+
+bool
+Queue::DispatchOneCompletion()
+{
+	auto *cqe = ring.PeekCompletion();
+	if (cqe == nullptr)
+		return false;
+
+	DispatchOneCompletion(*cqe);
+	return true;
+}
+
+void
+Queue::DispatchCompletions()
+{
+	while (DispatchOneCompletion()) {}
+}
+
+bool
+Queue::WaitDispatchOneCompletion()
+{
+	auto *cqe = ring.WaitCompletion();
+	if (cqe == nullptr)
+		return false;
+
+	DispatchOneCompletion(*cqe);
+	return true;
+}
+
+} /* namespace Uring */
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Ring.hxx"
+#include "net/SocketDescriptor.hxx"
+
+#include <sys/types.h>
+#include <stddef.h>
+
+struct sockaddr;
+
+namespace Uring {
+
+class Operation;
+
+/**
+ * A queue of #Operation instances running on an io_uring.  It wraps
+ * the #Ring and dispatches completions to the #Operation which was
+ * submitted with the entry.
+ */
+class Queue {
+	Ring ring;
+
+	/**
+	 * The number of operations which have been pushed but whose
+	 * completion has not yet been dispatched.
+	 */
+	unsigned n_pending = 0;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	Queue(unsigned entries, unsigned flags);
+
+	virtual ~Queue() noexcept = default;
+
+	Queue(const Queue &) = delete;
+	Queue &operator=(const Queue &) = delete;
+
+	FileDescriptor GetFileDescriptor() const noexcept {
+		return ring.GetFileDescriptor();
+	}
+
+	bool HasPending() const noexcept {
+		return n_pending > 0;
+	}
+
+	struct io_uring_sqe *GetSubmitEntry() noexcept {
+		return ring.GetSubmitEntry();
+	}
+
+	/**
+	 * Like GetSubmitEntry(), but if the submission queue is full,
+	 * submit it to make room for one more entry.
+	 *
+	 * Throws on error.
+	 */
+	struct io_uring_sqe &RequireSubmitEntry();
+
+	/**
+	 * Register the given #Operation with the submission entry
+	 * obtained by RequireSubmitEntry().  The entry will be
+	 * submitted with the next Submit() call.
+	 */
+	virtual void Push(struct io_uring_sqe &sqe,
+			  Operation &operation) noexcept;
+
+	/**
+	 * Throws on error.
+	 */
+	virtual void Submit() {
+		ring.Submit();
+	}
+
+	void PushRead(FileDescriptor fd, void *buffer, size_t size,
+		      off_t offset, Operation &operation);
+	void PushWrite(FileDescriptor fd, const void *buffer, size_t size,
+		       off_t offset, Operation &operation);
+	void PushAccept(SocketDescriptor fd,
+			struct sockaddr *address, socklen_t *address_length,
+			int flags, Operation &operation);
+
+	/**
+	 * Complete the given #Operation after the given time span
+	 * has elapsed.  The #__kernel_timespec object must remain
+	 * valid until the operation has been submitted.
+	 */
+	void PushTimeout(struct __kernel_timespec &ts,
+			 Operation &operation);
+
+	/**
+	 * Dispatch all completions which are available right now,
+	 * without blocking.
+	 *
+	 * Throws on error.
+	 */
+	void DispatchCompletions();
+
+	/**
+	 * Throws on error.
+	 *
+	 * @return true if a completion was dispatched, false if the
+	 * completion queue is empty
+	 */
+	bool DispatchOneCompletion();
+
+	/**
+	 * Block until a completion is available and dispatch it.
+	 *
+	 * Throws on error.
+	 *
+	 * @return true if a completion was dispatched
+	 */
+	bool WaitDispatchOneCompletion();
+
+private:
+	void DispatchOneCompletion(struct io_uring_cqe &cqe) noexcept;
+};
+
+} /* namespace Uring */
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Ring.hxx"
+#include "system/Error.hxx"
+
+namespace Uring {
+
+Ring::Ring(unsigned entries, unsigned flags)
+{
+	int error = io_uring_queue_init(entries, &ring, flags);
+	if (error < 0)
+		throw MakeErrno(-error, "io_uring_queue_init() failed");
+}
+
+void
+Ring::Submit()
+{
+	int error = io_uring_submit(&ring);
+	if (error < 0)
+		throw MakeErrno(-error, "io_uring_submit() failed");
+}
+
+struct io_uring_cqe *
+Ring::WaitCompletion()
+{
+	struct io_uring_cqe *cqe;
+	int error = io_uring_wait_cqe(&ring, &cqe);
+	if (error < 0) {
+		if (error == -EAGAIN)
+			return nullptr;
+
+		throw MakeErrno(-error, "io_uring_wait_cqe() failed");
+	}
+
+	return cqe;
+}
+
+struct io_uring_cqe *
+Ring::PeekCompletion()
+{
+	struct io_uring_cqe *cqe;
+	int error = io_uring_peek_cqe(&ring, &cqe);
+	if (error < 0) {
+		if (error == -EAGAIN)
+			return nullptr;
+
+		throw MakeErrno(-error, "io_uring_peek_cqe() failed");
+	}
+
+	return cqe;
+}
+
+} /* namespace Uring */
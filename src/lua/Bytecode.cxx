@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2016-2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Bytecode.hxx"
+#include "State.hxx"
+#include "Error.hxx"
+
+extern "C" {
+#include <lauxlib.h>
+}
+
+#include <new>
+
+static int
+AppendWriter(lua_State *, const void *p, size_t size, void *ud)
+{
+	auto &code = *(std::string *)ud;
+	try {
+		code.append((const char *)p, size);
+		return 0;
+	} catch (const std::bad_alloc &) {
+		return 1;
+	}
+}
+
+Lua::Bytecode
+Lua::Bytecode::CompileFile(const char *path)
+{
+	State state(luaL_newstate());
+	if (!state)
+		throw std::bad_alloc();
+
+	lua_State *L = state.get();
+	if (luaL_loadfile(L, path))
+		throw PopError(L);
+
+	std::string code;
+	if (lua_dump(L, AppendWriter, &code) != 0)
+		throw std::bad_alloc();
+
+	std::string name("@");
+	name.append(path);
+
+	return Bytecode(std::move(name), std::move(code));
+}
+
+void
+Lua::Bytecode::Push(lua_State *L) const
+{
+	if (luaL_loadbuffer(L, code.data(), code.size(), name.c_str()))
+		throw PopError(L);
+}
+
+void
+Lua::Bytecode::Run(lua_State *L) const
+{
+	Push(L);
+	if (lua_pcall(L, 0, 0, 0))
+		throw PopError(L);
+}
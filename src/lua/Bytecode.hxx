@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2016-2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LUA_BYTECODE_HXX
+#define LUA_BYTECODE_HXX
+
+#include <string>
+#include <utility>
+
+struct lua_State;
+
+namespace Lua {
+
+/**
+ * A precompiled Lua chunk, i.e. the output of lua_dump().  Loading
+ * it into a #lua_State skips reading and parsing the source file.
+ */
+class Bytecode {
+	/**
+	 * The chunk name passed to luaL_loadbuffer(); "@" followed by
+	 * the path for chunks compiled from a file, just like
+	 * luaL_loadfile() does it.
+	 */
+	std::string name;
+
+	std::string code;
+
+public:
+	Bytecode(std::string &&_name, std::string &&_code) noexcept
+		:name(std::move(_name)), code(std::move(_code)) {}
+
+	/**
+	 * Load and compile the specified file.  This uses a temporary
+	 * #lua_State and does not run the chunk.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	static Bytecode CompileFile(const char *path);
+
+	const std::string &GetName() const noexcept {
+		return name;
+	}
+
+	size_t size() const noexcept {
+		return code.size();
+	}
+
+	/**
+	 * Load the chunk and push it as a function on the stack.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void Push(lua_State *L) const;
+
+	/**
+	 * Load and run the chunk; this is the precompiled equivalent
+	 * of RunFile().
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void Run(lua_State *L) const;
+};
+
+}
+
+#endif
@@ -37,6 +37,7 @@ extern "C" {
 #include <lauxlib.h>
 }
 
+#include <new>
 #include <type_traits>
 
 namespace Lua {
@@ -44,6 +45,11 @@ namespace Lua {
 /**
  * Helper to wrap a C++ class in a Lua metatable.  This allows
  * instantiating C++ objects managed by Lua.
+ *
+ * Besides the usual string key (for luaL_checkudata() and Lua code),
+ * the metatable is registered with a light userdata key (the address
+ * of #name), which New() and Check() use; this avoids interning and
+ * hashing the name string for each call.
  */
 template<typename T, const char *name>
 struct Class {
@@ -60,6 +66,10 @@ struct Class {
 
 		luaL_newmetatable(L, name);
 
+		lua_pushlightuserdata(L, GetRegistryKey());
+		lua_pushvalue(L, -2);
+		lua_rawset(L, LUA_REGISTRYINDEX);
+
 		/* let Lua's garbage collector call the destructor
 		   (but only if there is one) */
 		if (!std::is_trivially_destructible<T>::value)
@@ -78,7 +88,7 @@ struct Class {
 		const ScopeCheckStack check_stack(L, 1);
 
 		void *p = lua_newuserdata(L, sizeof(value_type));
-		luaL_getmetatable(L, name);
+		PushMetatable(L);
 		lua_setmetatable(L, -2);
 
 		try {
@@ -104,7 +114,7 @@ struct Class {
 		if (lua_getmetatable(L, idx) == 0)
 			return nullptr;
 
-		lua_getfield(L, LUA_REGISTRYINDEX, name);
+		PushMetatable(L);
 		bool equal = lua_rawequal(L, -1, -2);
 		lua_pop(L, 2);
 		if (!equal)
@@ -119,10 +129,26 @@ struct Class {
 	 */
 	gcc_pure
 	static reference_type Cast(lua_State *L, int idx) {
-		return *(pointer_type)luaL_checkudata(L, idx, name);
+		auto *p = Check(L, idx);
+		if (p == nullptr)
+			luaL_typerror(L, idx, name);
+
+		return *p;
 	}
 
 private:
+	static void *GetRegistryKey() {
+		return const_cast<char *>(name);
+	}
+
+	/**
+	 * Push the metatable registered by Register() on the stack.
+	 */
+	static void PushMetatable(lua_State *L) {
+		lua_pushlightuserdata(L, GetRegistryKey());
+		lua_rawget(L, LUA_REGISTRYINDEX);
+	}
+
 	static int l_gc(lua_State *L) {
 		const ScopeCheckStack check_stack(L);
 
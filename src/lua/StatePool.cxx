@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2016-2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "StatePool.hxx"
+
+extern "C" {
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+}
+
+#include <new>
+
+#include <assert.h>
+
+void
+Lua::StatePool::AddFile(const char *path)
+{
+	assert(n_created == 0);
+
+	scripts.emplace_back(Bytecode::CompileFile(path));
+}
+
+Lua::State
+Lua::StatePool::MakeState()
+{
+	State state(luaL_newstate());
+	if (!state)
+		throw std::bad_alloc();
+
+	lua_State *L = state.get();
+	luaL_openlibs(L);
+
+	if (initializer)
+		initializer(L);
+
+	for (const auto &i : scripts)
+		i.Run(L);
+
+	assert(lua_gettop(L) == 0);
+
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		++n_created;
+	}
+
+	return state;
+}
+
+void
+Lua::StatePool::Populate(unsigned n)
+{
+	while (GetIdleCount() < n) {
+		auto state = MakeState();
+
+		const std::lock_guard<std::mutex> lock(mutex);
+		idle.emplace_back(std::move(state));
+	}
+}
+
+Lua::StatePool::Lease
+Lua::StatePool::Acquire()
+{
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		if (!idle.empty()) {
+			auto state = std::move(idle.back());
+			idle.pop_back();
+			return Lease(*this, std::move(state));
+		}
+	}
+
+	/* create the new state outside of the lock, because running
+	   the scripts may take a while */
+	return Lease(*this, MakeState());
+}
+
+void
+Lua::StatePool::Release(State &&state) noexcept
+{
+	/* discard whatever the previous user left on the stack */
+	lua_settop(state.get(), 0);
+
+	const std::lock_guard<std::mutex> lock(mutex);
+
+	try {
+		idle.emplace_back(std::move(state));
+	} catch (const std::bad_alloc &) {
+		/* the state is closed by its destructor */
+	}
+}
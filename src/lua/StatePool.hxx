@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2016-2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LUA_STATE_POOL_HXX
+#define LUA_STATE_POOL_HXX
+
+#include "State.hxx"
+#include "Bytecode.hxx"
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace Lua {
+
+/**
+ * A pool of pre-initialized #lua_State instances.  Each state gets
+ * the standard libraries, is passed to the #Initializer (which may
+ * register C functions and globals) and runs all scripts added with
+ * AddFile().  The scripts are compiled only once, and each new state
+ * loads the cached bytecode.
+ *
+ * A #lua_State is not thread-safe; a caller obtains one with
+ * Acquire() and owns it exclusively until the #Lease is destructed.
+ * A thread or an #EventLoop may keep its #Lease for its whole
+ * lifetime, or acquire one for each request.  This class is
+ * thread-safe.
+ */
+class StatePool {
+public:
+	typedef std::function<void(lua_State *L)> Initializer;
+
+	/**
+	 * Exclusive ownership of one pooled #lua_State; it is
+	 * returned to the pool by the destructor.
+	 */
+	class Lease {
+		StatePool *pool;
+		State state;
+
+	public:
+		Lease(StatePool &_pool, State &&_state) noexcept
+			:pool(&_pool), state(std::move(_state)) {}
+
+		Lease(Lease &&) = default;
+		Lease &operator=(Lease &&src) noexcept {
+			std::swap(pool, src.pool);
+			std::swap(state, src.state);
+			return *this;
+		}
+
+		~Lease() noexcept {
+			if (state)
+				pool->Release(std::move(state));
+		}
+
+		lua_State *Get() const noexcept {
+			return state.get();
+		}
+
+		operator lua_State *() const noexcept {
+			return Get();
+		}
+	};
+
+private:
+	const Initializer initializer;
+
+	std::vector<Bytecode> scripts;
+
+	mutable std::mutex mutex;
+
+	std::vector<State> idle;
+
+	/**
+	 * The total number of states created by this pool.
+	 */
+	unsigned n_created = 0;
+
+public:
+	explicit StatePool(Initializer _initializer=nullptr) noexcept
+		:initializer(std::move(_initializer)) {}
+
+	StatePool(const StatePool &) = delete;
+	StatePool &operator=(const StatePool &) = delete;
+
+	/**
+	 * Compile a script which will be run in each new state.  This
+	 * must be called before the first state is created, i.e.
+	 * before Populate() and Acquire().
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void AddFile(const char *path);
+
+	/**
+	 * Create and initialize states until there are at least the
+	 * given number of idle states.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void Populate(unsigned n);
+
+	/**
+	 * Obtain an idle state; if there is none, a new one is
+	 * created.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	Lease Acquire();
+
+	unsigned GetCreatedCount() const noexcept {
+		const std::lock_guard<std::mutex> lock(mutex);
+		return n_created;
+	}
+
+	size_t GetIdleCount() const noexcept {
+		const std::lock_guard<std::mutex> lock(mutex);
+		return idle.size();
+	}
+
+private:
+	State MakeState();
+
+	void Release(State &&state) noexcept;
+};
+
+}
+
+#endif
@@ -42,7 +42,9 @@ ReceiveToBuffer(int fd, ForeignFifoBuffer<uint8_t> &buffer)
 {
 	assert(fd >= 0);
 
-	auto w = buffer.Write();
+	/* compact the buffer (if cheap), to receive everything in
+	   one system call */
+	auto w = buffer.WriteCompact();
 	if (w.empty())
 		return -2;
 
@@ -0,0 +1,368 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "DnsMessage.hxx"
+#include "SocketProtocolError.hxx"
+#include "util/CharUtil.hxx"
+
+#include <algorithm>
+#include <string>
+
+#include <string.h>
+#include <sys/socket.h>
+
+static constexpr uint16_t DNS_CLASS_IN = 1;
+static constexpr uint16_t DNS_TYPE_SOA = 6;
+
+static constexpr unsigned DNS_FLAG_QR = 0x8000;
+static constexpr unsigned DNS_FLAG_TC = 0x0200;
+static constexpr unsigned DNS_FLAG_RD = 0x0100;
+
+static constexpr size_t DNS_HEADER_SIZE = 12;
+
+/**
+ * The maximum number of CNAME records we follow.
+ */
+static constexpr unsigned DNS_MAX_CNAME_CHAIN = 8;
+
+static constexpr uint16_t
+ReadUint16(const uint8_t *p) noexcept
+{
+	return (p[0] << 8) | p[1];
+}
+
+static constexpr uint32_t
+ReadUint32(const uint8_t *p) noexcept
+{
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+		(uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+static uint8_t *
+WriteUint16(uint8_t *p, uint16_t value) noexcept
+{
+	*p++ = value >> 8;
+	*p++ = value;
+	return p;
+}
+
+size_t
+BuildDnsQuery(void *_buffer, size_t size, uint16_t id,
+	      const char *name, uint16_t type) noexcept
+{
+	const size_t name_length = strlen(name);
+
+	/* each label gets a length byte, plus the root label; the
+	   maximum is 255 bytes on the wire */
+	const size_t wire_name_length = name_length + 2;
+	if (name_length == 0 || wire_name_length > 255 ||
+	    size < DNS_HEADER_SIZE + wire_name_length + 4)
+		return 0;
+
+	auto *const buffer = (uint8_t *)_buffer;
+	uint8_t *p = buffer;
+	p = WriteUint16(p, id);
+	p = WriteUint16(p, DNS_FLAG_RD);
+	p = WriteUint16(p, 1); /* QDCOUNT */
+	p = WriteUint16(p, 0); /* ANCOUNT */
+	p = WriteUint16(p, 0); /* NSCOUNT */
+	p = WriteUint16(p, 0); /* ARCOUNT */
+
+	const char *s = name;
+	while (true) {
+		const char *dot = strchr(s, '.');
+		const size_t label_length = dot != nullptr
+			? size_t(dot - s)
+			: strlen(s);
+		if (label_length == 0 || label_length > 63)
+			return 0;
+
+		*p++ = label_length;
+		p = std::copy_n((const uint8_t *)s, label_length, p);
+
+		if (dot == nullptr)
+			break;
+
+		s = dot + 1;
+		if (*s == 0)
+			/* trailing dot */
+			break;
+	}
+
+	*p++ = 0; /* root label */
+
+	p = WriteUint16(p, type);
+	p = WriteUint16(p, DNS_CLASS_IN);
+	return p - buffer;
+}
+
+int
+GetDnsId(ConstBuffer<void> packet) noexcept
+{
+	if (packet.size < 2)
+		return -1;
+
+	return ReadUint16((const uint8_t *)packet.data);
+}
+
+/**
+ * Decode a (possibly compressed) domain name to lower case dotted
+ * notation (without the trailing dot).
+ *
+ * @param position the offset of the name; on return, it points to
+ * the first byte after the name
+ */
+static std::string
+ReadName(const uint8_t *packet, size_t size, size_t &position)
+{
+	std::string result;
+
+	size_t p = position;
+	bool jumped = false;
+	unsigned n_jumps = 0;
+
+	while (true) {
+		if (p >= size)
+			throw SocketProtocolError("Truncated DNS name");
+
+		const unsigned length = packet[p];
+		if ((length & 0xc0) == 0xc0) {
+			/* compression pointer */
+			if (p + 2 > size)
+				throw SocketProtocolError("Truncated DNS name");
+
+			if (++n_jumps > 64)
+				throw SocketProtocolError("DNS name compression loop");
+
+			if (!jumped) {
+				position = p + 2;
+				jumped = true;
+			}
+
+			p = ReadUint16(packet + p) & 0x3fff;
+			continue;
+		}
+
+		if (length > 63)
+			throw SocketProtocolError("Malformed DNS label");
+
+		++p;
+
+		if (length == 0)
+			break;
+
+		if (p + length > size)
+			throw SocketProtocolError("Truncated DNS name");
+
+		if (!result.empty())
+			result.push_back('.');
+
+		for (unsigned i = 0; i < length; ++i)
+			result.push_back(ToLowerASCII(packet[p + i]));
+
+		if (result.length() > 255)
+			throw SocketProtocolError("DNS name too long");
+
+		p += length;
+	}
+
+	if (!jumped)
+		position = p;
+
+	return result;
+}
+
+static std::string
+NormalizeName(const char *name) noexcept
+{
+	std::string result;
+	for (const char *p = name; *p != 0; ++p)
+		result.push_back(ToLowerASCII(*p));
+
+	if (!result.empty() && result.back() == '.')
+		result.pop_back();
+
+	return result;
+}
+
+namespace {
+
+struct DnsRecord {
+	std::string name;
+	uint16_t type;
+	uint32_t ttl;
+	size_t rdata, rdlength;
+};
+
+}
+
+static DnsRecord
+ReadRecord(const uint8_t *packet, size_t size, size_t &position)
+{
+	DnsRecord r;
+	r.name = ReadName(packet, size, position);
+
+	if (position + 10 > size)
+		throw SocketProtocolError("Truncated DNS record");
+
+	const uint8_t *p = packet + position;
+	r.type = ReadUint16(p);
+	r.ttl = ReadUint32(p + 4);
+	r.rdlength = ReadUint16(p + 8);
+	r.rdata = position + 10;
+
+	/* RFC 2181 8: treat TTLs with the most significant bit set
+	   as zero */
+	if (r.ttl > 0x7fffffff)
+		r.ttl = 0;
+
+	if (r.rdata + r.rdlength > size)
+		throw SocketProtocolError("Truncated DNS record");
+
+	position = r.rdata + r.rdlength;
+	return r;
+}
+
+DnsResponse
+ParseDnsResponse(ConstBuffer<void> _packet,
+		 const char *query_name, uint16_t query_type)
+{
+	const auto *const packet = (const uint8_t *)_packet.data;
+	const size_t size = _packet.size;
+
+	if (size < DNS_HEADER_SIZE)
+		throw SocketProtocolError("DNS response too short");
+
+	const unsigned flags = ReadUint16(packet + 2);
+	if ((flags & DNS_FLAG_QR) == 0)
+		throw SocketProtocolError("Not a DNS response");
+
+	DnsResponse response;
+	response.id = ReadUint16(packet);
+	response.rcode = flags & 0xf;
+	response.truncated = (flags & DNS_FLAG_TC) != 0;
+	response.ttl = 0;
+
+	const unsigned qdcount = ReadUint16(packet + 4);
+	const unsigned ancount = ReadUint16(packet + 6);
+	const unsigned nscount = ReadUint16(packet + 8);
+
+	std::string name = NormalizeName(query_name);
+
+	size_t position = DNS_HEADER_SIZE;
+
+	if (qdcount != 1)
+		throw SocketProtocolError("Wrong number of questions in DNS response");
+
+	if (ReadName(packet, size, position) != name)
+		throw SocketProtocolError("DNS response for wrong name");
+
+	if (position + 4 > size)
+		throw SocketProtocolError("Truncated DNS question");
+
+	if (ReadUint16(packet + position) != query_type ||
+	    ReadUint16(packet + position + 2) != DNS_CLASS_IN)
+		throw SocketProtocolError("DNS response for wrong question");
+
+	position += 4;
+
+	if (response.truncated)
+		/* the rest of the message is unreliable */
+		return response;
+
+	std::vector<DnsRecord> records;
+	records.reserve(ancount);
+	for (unsigned i = 0; i < ancount; ++i)
+		records.push_back(ReadRecord(packet, size, position));
+
+	/* follow the CNAME chain; the records in the answer section
+	   may be in any order */
+	uint32_t ttl = UINT32_MAX;
+	for (unsigned n = 0; n < DNS_MAX_CNAME_CHAIN; ++n) {
+		const auto cname = std::find_if(records.begin(), records.end(),
+						[&name](const DnsRecord &r){
+							return r.type == DNS_TYPE_CNAME &&
+								r.name == name;
+						});
+		if (cname == records.end())
+			break;
+
+		size_t p = cname->rdata;
+		name = ReadName(packet, size, p);
+		ttl = std::min(ttl, cname->ttl);
+	}
+
+	const int family = query_type == DNS_TYPE_AAAA ? AF_INET6 : AF_INET;
+	const size_t address_size = family == AF_INET6 ? 16 : 4;
+
+	for (const auto &r : records) {
+		if (r.type != query_type || r.name != name)
+			continue;
+
+		if (r.rdlength != address_size)
+			throw SocketProtocolError("Malformed address in DNS response");
+
+		DnsAnswer answer;
+		answer.family = family;
+		memset(answer.address, 0, sizeof(answer.address));
+		memcpy(answer.address, packet + r.rdata, address_size);
+		answer.ttl = r.ttl;
+		response.answers.push_back(answer);
+
+		ttl = std::min(ttl, r.ttl);
+	}
+
+	if (!response.answers.empty()) {
+		response.ttl = ttl;
+		return response;
+	}
+
+	/* negative response: look for the SOA record */
+	for (unsigned i = 0; i < nscount; ++i) {
+		const auto r = ReadRecord(packet, size, position);
+		if (r.type != DNS_TYPE_SOA)
+			continue;
+
+		size_t p = r.rdata;
+		ReadName(packet, size, p); /* MNAME */
+		ReadName(packet, size, p); /* RNAME */
+		if (p + 20 > r.rdata + r.rdlength)
+			throw SocketProtocolError("Malformed SOA record");
+
+		/* RFC 2308 5: the lower of the SOA TTL and the
+		   "minimum" field */
+		response.ttl = std::min(r.ttl, ReadUint32(packet + p + 16));
+		break;
+	}
+
+	return response;
+}
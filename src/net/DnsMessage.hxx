@@ -0,0 +1,140 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Encoder and decoder for the DNS wire format (RFC 1035), limited
+ * to what a stub resolver needs: building A/AAAA queries and
+ * extracting addresses from responses.
+ */
+
+#pragma once
+
+#include "util/ConstBuffer.hxx"
+#include "util/Compiler.h"
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+static constexpr uint16_t DNS_TYPE_A = 1;
+static constexpr uint16_t DNS_TYPE_CNAME = 5;
+static constexpr uint16_t DNS_TYPE_AAAA = 28;
+
+static constexpr unsigned DNS_RCODE_NOERROR = 0;
+static constexpr unsigned DNS_RCODE_SERVFAIL = 2;
+static constexpr unsigned DNS_RCODE_NXDOMAIN = 3;
+
+/**
+ * The maximum size of a DNS message over UDP without EDNS0.
+ */
+static constexpr size_t DNS_MAX_UDP_SIZE = 512;
+
+struct DnsAnswer {
+	/**
+	 * AF_INET or AF_INET6.
+	 */
+	int family;
+
+	/**
+	 * The raw address in network byte order; only the first 4
+	 * bytes are used for AF_INET.
+	 */
+	uint8_t address[16];
+
+	/**
+	 * The time to live in seconds.
+	 */
+	uint32_t ttl;
+};
+
+struct DnsResponse {
+	uint16_t id;
+
+	/**
+	 * The response code (one of DNS_RCODE_*).
+	 */
+	unsigned rcode;
+
+	/**
+	 * Was the "TC" flag set?  If yes, the query should be repeated
+	 * over TCP.
+	 */
+	bool truncated;
+
+	/**
+	 * The addresses matching the query (after following CNAME
+	 * records).
+	 */
+	std::vector<DnsAnswer> answers;
+
+	/**
+	 * The lowest TTL of all records (addresses and CNAMEs) on the
+	 * path to the answers; for negative responses, this is the
+	 * "minimum" field of the SOA record in the authority section
+	 * (RFC 2308), or 0 if there is none.
+	 */
+	uint32_t ttl;
+};
+
+/**
+ * Build a query with one question (class IN) and the "recursion
+ * desired" flag set.
+ *
+ * @param name the host name without the trailing dot
+ * @return the size of the query in bytes, or 0 if the buffer is too
+ * small or the name is not valid
+ */
+size_t
+BuildDnsQuery(void *buffer, size_t size, uint16_t id,
+	      const char *name, uint16_t type) noexcept;
+
+/**
+ * Obtain the transaction id of a DNS message.  Returns -1 if the
+ * message is too short.
+ */
+gcc_pure
+int
+GetDnsId(ConstBuffer<void> packet) noexcept;
+
+/**
+ * Parse a response to a query built with BuildDnsQuery().  Throws
+ * #SocketProtocolError if the response is malformed or does not
+ * match the question.
+ *
+ * @param name the name that was queried
+ * @param type the type that was queried (#DNS_TYPE_A or
+ * #DNS_TYPE_AAAA)
+ */
+DnsResponse
+ParseDnsResponse(ConstBuffer<void> packet,
+		 const char *name, uint16_t type);
@@ -0,0 +1,244 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Handover.hxx"
+#include "ScmRightsBuilder.hxx"
+#include "system/Error.hxx"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+#include <string.h>
+#include <sys/socket.h>
+
+enum class HandoverCommand : uint8_t {
+	LISTENER = 1,
+	SNAPSHOT = 2,
+	END = 3,
+
+	/**
+	 * Sent by the receiver in response to #END.
+	 */
+	ACK = 4,
+};
+
+/**
+ * The maximum payload size of one #HandoverCommand::SNAPSHOT message.
+ */
+static constexpr size_t MAX_CHUNK = 60 * 1024;
+
+static constexpr size_t MAX_NAME = 256;
+
+void
+HandoverWriter::SendMessage(uint8_t command, const char *name,
+			    ConstBuffer<void> data, int fd)
+{
+	const size_t name_length = strlen(name);
+	if (name_length >= MAX_NAME)
+		throw std::runtime_error("Handover name is too long");
+
+	struct iovec v[3] = {
+		{ &command, sizeof(command) },
+		{ const_cast<char *>(name), name_length + 1 },
+		{ const_cast<void *>(data.data), data.size },
+	};
+
+	struct msghdr msg{};
+	msg.msg_iov = v;
+	msg.msg_iovlen = 3;
+
+	ScmRightsBuilder<1> b(msg);
+	if (fd >= 0) {
+		b.push_back(fd);
+		b.Finish(msg);
+	} else {
+		msg.msg_control = nullptr;
+		msg.msg_controllen = 0;
+	}
+
+	if (sendmsg(s.Get(), &msg, MSG_NOSIGNAL) < 0)
+		throw MakeErrno("Failed to send handover message");
+}
+
+void
+HandoverWriter::AddListener(const char *name, SocketDescriptor fd)
+{
+	SendMessage(uint8_t(HandoverCommand::LISTENER), name, nullptr,
+		    fd.Get());
+}
+
+void
+HandoverWriter::AddSnapshot(const char *name, ConstBuffer<void> _data)
+{
+	auto data = ConstBuffer<uint8_t>::FromVoid(_data);
+
+	do {
+		const size_t n = std::min(data.size, MAX_CHUNK);
+		SendMessage(uint8_t(HandoverCommand::SNAPSHOT), name,
+			    ConstBuffer<void>(data.data, n));
+		data.skip_front(n);
+	} while (!data.empty());
+}
+
+void
+HandoverWriter::Finish()
+{
+	SendMessage(uint8_t(HandoverCommand::END), "", nullptr);
+
+	uint8_t response;
+	ssize_t nbytes = recv(s.Get(), &response, sizeof(response), 0);
+	if (nbytes < 0)
+		throw MakeErrno("Failed to receive handover acknowledgement");
+
+	if (nbytes == 0 || response != uint8_t(HandoverCommand::ACK))
+		throw std::runtime_error("Handover was not acknowledged");
+}
+
+static bool
+IsListener(SocketDescriptor fd) noexcept
+{
+	int value = 0;
+	return fd.GetOption(SOL_SOCKET, SO_ACCEPTCONN,
+			    &value, sizeof(value)) == sizeof(value) &&
+		value != 0;
+}
+
+void
+HandoverReader::Receive(SocketDescriptor s)
+{
+	static constexpr size_t buffer_size = 1 + MAX_NAME + MAX_CHUNK;
+	std::unique_ptr<char[]> buffer(new char[buffer_size]);
+
+	while (true) {
+		struct iovec v = { buffer.get(), buffer_size };
+
+		long control[(CMSG_SPACE(4 * sizeof(int)) + sizeof(long) - 1) / sizeof(long)];
+
+		struct msghdr msg{};
+		msg.msg_iov = &v;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		ssize_t nbytes = recvmsg(s.Get(), &msg, MSG_CMSG_CLOEXEC);
+		if (nbytes < 0)
+			throw MakeErrno("Failed to receive handover message");
+
+		if (nbytes == 0)
+			throw std::runtime_error("Premature end of handover");
+
+		/* take ownership of all received file descriptors
+		   first, so they get closed on error */
+		UniqueSocketDescriptor fd;
+		for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		     cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level != SOL_SOCKET ||
+			    cmsg->cmsg_type != SCM_RIGHTS)
+				continue;
+
+			const int *fds = (const int *)(const void *)CMSG_DATA(cmsg);
+			const size_t n_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			for (size_t i = 0; i < n_fds; ++i) {
+				UniqueSocketDescriptor tmp(fds[i]);
+				if (!fd.IsDefined())
+					fd = std::move(tmp);
+			}
+		}
+
+		if (msg.msg_flags & (MSG_TRUNC|MSG_CTRUNC))
+			throw std::runtime_error("Handover message too large");
+
+		const char *const end = buffer.get() + nbytes;
+		const char *name = buffer.get() + 1;
+		const char *name_end = (const char *)memchr(name, 0, end - name);
+		if (name_end == nullptr)
+			throw std::runtime_error("Malformed handover message");
+
+		const ConstBuffer<void> payload(name_end + 1,
+						end - (name_end + 1));
+
+		switch (HandoverCommand(buffer[0])) {
+		case HandoverCommand::LISTENER:
+			if (!fd.IsDefined() || !IsListener(fd))
+				throw std::runtime_error("Malformed handover listener");
+
+			listeners[name] = std::move(fd);
+			break;
+
+		case HandoverCommand::SNAPSHOT:
+			snapshots[name].append((const char *)payload.data,
+					       payload.size);
+			break;
+
+		case HandoverCommand::END:
+			{
+				static constexpr uint8_t ack = uint8_t(HandoverCommand::ACK);
+				if (send(s.Get(), &ack, sizeof(ack), MSG_NOSIGNAL) < 0)
+					throw MakeErrno("Failed to acknowledge handover");
+			}
+
+			return;
+
+		default:
+			throw std::runtime_error("Unknown handover message");
+		}
+	}
+}
+
+UniqueSocketDescriptor
+HandoverReader::TakeListener(const char *name) noexcept
+{
+	UniqueSocketDescriptor result;
+
+	auto i = listeners.find(name);
+	if (i != listeners.end()) {
+		result = std::move(i->second);
+		listeners.erase(i);
+	}
+
+	return result;
+}
+
+std::string
+HandoverReader::TakeSnapshot(const char *name) noexcept
+{
+	std::string result;
+
+	auto i = snapshots.find(name);
+	if (i != snapshots.end()) {
+		result = std::move(i->second);
+		snapshots.erase(i);
+	}
+
+	return result;
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "UniqueSocketDescriptor.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <map>
+#include <string>
+
+/*
+ * Hand over listener sockets (and optionally serialized cache
+ * snapshots) from an old process to its replacement, so a restart
+ * does not refuse connections or lose the accept queue.
+ *
+ * The two processes are connected with an AF_LOCAL SOCK_SEQPACKET
+ * socket (e.g. a socketpair() inherited by the new process, or a
+ * listener on a well-known path).  The old process sends with
+ * #HandoverWriter and keeps its listeners open (but stops accepting)
+ * until Finish() returns; the new process receives everything with
+ * #HandoverReader and adopts the listeners instead of binding new
+ * ones.
+ *
+ * Both classes use blocking I/O; a handover happens during startup
+ * and shutdown, not in the #EventLoop.
+ */
+
+class HandoverWriter {
+	const SocketDescriptor s;
+
+public:
+	explicit HandoverWriter(SocketDescriptor _s) noexcept
+		:s(_s) {}
+
+	/**
+	 * Pass a listener socket identified by the given name.
+	 *
+	 * Throws on error.
+	 */
+	void AddListener(const char *name, SocketDescriptor fd);
+
+	/**
+	 * Pass an opaque blob (e.g. a serialized cache) identified by
+	 * the given name.  Large blobs are split into several
+	 * messages.
+	 *
+	 * Throws on error.
+	 */
+	void AddSnapshot(const char *name, ConstBuffer<void> data);
+
+	/**
+	 * Announce the end of the handover and wait until the
+	 * receiver has acknowledged it.  After this method returns,
+	 * the old process may close its listeners.
+	 *
+	 * Throws on error.
+	 */
+	void Finish();
+
+private:
+	void SendMessage(uint8_t command, const char *name,
+			 ConstBuffer<void> data, int fd=-1);
+};
+
+class HandoverReader {
+	std::map<std::string, UniqueSocketDescriptor, std::less<>> listeners;
+	std::map<std::string, std::string, std::less<>> snapshots;
+
+public:
+	/**
+	 * Receive everything until the sender calls
+	 * HandoverWriter::Finish(), and acknowledge it.
+	 *
+	 * Throws on error.
+	 */
+	void Receive(SocketDescriptor s);
+
+	/**
+	 * Take ownership of the listener with the given name.
+	 * Returns an undefined #UniqueSocketDescriptor if there is
+	 * none (the caller should create a new one then).
+	 */
+	UniqueSocketDescriptor TakeListener(const char *name) noexcept;
+
+	/**
+	 * Take the snapshot with the given name.  Returns an empty
+	 * string if there is none.
+	 */
+	std::string TakeSnapshot(const char *name) noexcept;
+
+	/**
+	 * Returns all listeners which were received but not taken.
+	 * The caller may close them, or keep them for a later
+	 * configuration reload.
+	 */
+	std::map<std::string, UniqueSocketDescriptor, std::less<>> &GetListeners() noexcept {
+		return listeners;
+	}
+};
@@ -0,0 +1,320 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "InterfaceTable.hxx"
+#include "SocketAddress.hxx"
+#include "UniqueSocketDescriptor.hxx"
+#include "system/Error.hxx"
+#include "util/WyHash.hxx"
+
+#include <stdexcept>
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+
+size_t
+NetworkInterfaceTable::AddressKeyHash::operator()(const AddressKey &key) const noexcept
+{
+	return WyHash64(key.address.data(), key.address.size(), key.family);
+}
+
+/**
+ * Convert a #SocketAddress to an #AddressKey.
+ *
+ * @return false if the address family is not supported
+ */
+template<typename K>
+static bool
+ToAddressKey(K &key, SocketAddress address) noexcept
+{
+	key.family = address.GetFamily();
+	key.address.fill(0);
+
+	switch (address.GetFamily()) {
+	case AF_INET:
+		memcpy(key.address.data(),
+		       &((const struct sockaddr_in *)(const void *)address.GetAddress())->sin_addr,
+		       4);
+		return true;
+
+	case AF_INET6:
+		memcpy(key.address.data(),
+		       &((const struct sockaddr_in6 *)(const void *)address.GetAddress())->sin6_addr,
+		       16);
+		return true;
+
+	default:
+		/* other address families are unsupported */
+		return false;
+	}
+}
+
+void
+NetworkInterfaceTable::Load()
+{
+	UniqueSocketDescriptor s;
+	if (!s.Create(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE))
+		throw MakeErrno("Failed to create netlink socket");
+
+	/* build a new table, and keep the old one if this fails */
+	NetworkInterfaceTable tmp;
+	tmp.Dump(s, RTM_GETLINK, 1);
+	tmp.Dump(s, RTM_GETADDR, 2);
+	*this = std::move(tmp);
+}
+
+void
+NetworkInterfaceTable::Dump(SocketDescriptor s, uint16_t type, uint32_t seq)
+{
+	struct {
+		struct nlmsghdr header;
+		struct rtgenmsg body;
+	} request;
+
+	memset(&request, 0, sizeof(request));
+	request.header.nlmsg_len = NLMSG_LENGTH(sizeof(request.body));
+	request.header.nlmsg_type = type;
+	request.header.nlmsg_flags = NLM_F_REQUEST|NLM_F_DUMP;
+	request.header.nlmsg_seq = seq;
+	request.body.rtgen_family = AF_UNSPEC;
+
+	if (send(s.Get(), &request, request.header.nlmsg_len, 0) < 0)
+		throw MakeErrno("Failed to send netlink request");
+
+	while (true) {
+		alignas(struct nlmsghdr) char buffer[32768];
+		ssize_t nbytes = recv(s.Get(), buffer, sizeof(buffer), 0);
+		if (nbytes < 0)
+			throw MakeErrno("Failed to receive netlink response");
+
+		if (nbytes == 0)
+			throw std::runtime_error("Netlink socket closed");
+
+		const auto *nlh = (const struct nlmsghdr *)(const void *)buffer;
+		for (size_t remaining = nbytes; NLMSG_OK(nlh, remaining);
+		     nlh = NLMSG_NEXT(nlh, remaining)) {
+			if (nlh->nlmsg_type == NLMSG_ERROR) {
+				const auto &e = *(const struct nlmsgerr *)NLMSG_DATA(nlh);
+				if (e.error != 0)
+					throw MakeErrno(-e.error, "Netlink dump failed");
+			}
+		}
+
+		if (!Feed(buffer, nbytes))
+			break;
+	}
+}
+
+bool
+NetworkInterfaceTable::Feed(const void *data, size_t size) noexcept
+{
+	const auto *nlh = (const struct nlmsghdr *)data;
+	for (; NLMSG_OK(nlh, size); nlh = NLMSG_NEXT(nlh, size)) {
+		switch (nlh->nlmsg_type) {
+		case NLMSG_DONE:
+		case NLMSG_ERROR:
+			return false;
+
+		case RTM_NEWLINK:
+		case RTM_DELLINK:
+			HandleLink(*nlh);
+			break;
+
+		case RTM_NEWADDR:
+		case RTM_DELADDR:
+			HandleAddress(*nlh);
+			break;
+		}
+	}
+
+	return true;
+}
+
+inline void
+NetworkInterfaceTable::HandleLink(const struct nlmsghdr &nlh) noexcept
+{
+	if (nlh.nlmsg_len < NLMSG_LENGTH(sizeof(struct ifinfomsg)))
+		return;
+
+	const auto &ifi = *(const struct ifinfomsg *)NLMSG_DATA(&nlh);
+	if (ifi.ifi_index <= 0)
+		return;
+
+	const unsigned index = ifi.ifi_index;
+
+	if (nlh.nlmsg_type == RTM_DELLINK) {
+		RemoveInterface(index);
+		return;
+	}
+
+	const char *name = nullptr;
+	size_t name_length = 0;
+
+	int length = IFLA_PAYLOAD(&nlh);
+	for (const struct rtattr *rta = IFLA_RTA(&ifi); RTA_OK(rta, length);
+	     rta = RTA_NEXT(rta, length)) {
+		if (rta->rta_type == IFLA_IFNAME) {
+			name = (const char *)RTA_DATA(rta);
+			name_length = strnlen(name, RTA_PAYLOAD(rta));
+		}
+	}
+
+	auto &i = interfaces[index];
+	i.flags = ifi.ifi_flags;
+
+	if (name != nullptr && i.name.compare(0, std::string::npos,
+					      name, name_length) != 0) {
+		/* new interface or renamed */
+		if (!i.name.empty()) {
+			auto n = names.find(i.name);
+			if (n != names.end() && n->second == index)
+				names.erase(n);
+		}
+
+		i.name.assign(name, name_length);
+		names[i.name] = index;
+	}
+}
+
+inline void
+NetworkInterfaceTable::HandleAddress(const struct nlmsghdr &nlh) noexcept
+{
+	if (nlh.nlmsg_len < NLMSG_LENGTH(sizeof(struct ifaddrmsg)))
+		return;
+
+	const auto &ifa = *(const struct ifaddrmsg *)NLMSG_DATA(&nlh);
+
+	size_t address_size;
+	switch (ifa.ifa_family) {
+	case AF_INET:
+		address_size = 4;
+		break;
+
+	case AF_INET6:
+		address_size = 16;
+		break;
+
+	default:
+		return;
+	}
+
+	/* IFA_LOCAL is the local address; IFA_ADDRESS is the peer
+	   address on point-to-point links, and the local address
+	   otherwise (and the only one for IPv6) */
+	const void *local = nullptr, *address = nullptr;
+
+	int length = IFA_PAYLOAD(&nlh);
+	for (const struct rtattr *rta = IFA_RTA(&ifa); RTA_OK(rta, length);
+	     rta = RTA_NEXT(rta, length)) {
+		if (RTA_PAYLOAD(rta) < address_size)
+			continue;
+
+		if (rta->rta_type == IFA_LOCAL)
+			local = RTA_DATA(rta);
+		else if (rta->rta_type == IFA_ADDRESS)
+			address = RTA_DATA(rta);
+	}
+
+	if (local == nullptr)
+		local = address;
+	if (local == nullptr)
+		return;
+
+	AddressKey key;
+	key.family = ifa.ifa_family;
+	key.address.fill(0);
+	memcpy(key.address.data(), local, address_size);
+
+	if (nlh.nlmsg_type == RTM_NEWADDR)
+		addresses[key] = ifa.ifa_index;
+	else {
+		auto i = addresses.find(key);
+		if (i != addresses.end() && i->second == ifa.ifa_index)
+			addresses.erase(i);
+	}
+}
+
+void
+NetworkInterfaceTable::RemoveInterface(unsigned index) noexcept
+{
+	auto i = interfaces.find(index);
+	if (i == interfaces.end())
+		return;
+
+	auto n = names.find(i->second.name);
+	if (n != names.end() && n->second == index)
+		names.erase(n);
+
+	interfaces.erase(i);
+
+	for (auto a = addresses.begin(); a != addresses.end();) {
+		if (a->second == index)
+			a = addresses.erase(a);
+		else
+			++a;
+	}
+}
+
+unsigned
+NetworkInterfaceTable::FindByAddress(SocketAddress address) const noexcept
+{
+	AddressKey key;
+	if (!ToAddressKey(key, address))
+		return 0;
+
+	auto i = addresses.find(key);
+	return i != addresses.end()
+		? i->second
+		: 0;
+}
+
+unsigned
+NetworkInterfaceTable::FindByName(const char *name) const noexcept
+{
+	auto i = names.find(name);
+	return i != names.end()
+		? i->second
+		: 0;
+}
+
+const NetworkInterfaceTable::Interface *
+NetworkInterfaceTable::FindByIndex(unsigned index) const noexcept
+{
+	auto i = interfaces.find(index);
+	return i != interfaces.end()
+		? &i->second
+		: nullptr;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "util/Compiler.h"
+
+#include <array>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include <stddef.h>
+#include <stdint.h>
+
+class SocketAddress;
+class SocketDescriptor;
+struct nlmsghdr;
+
+/**
+ * An in-process table of network interfaces and their addresses,
+ * populated from RTNETLINK.  Lookups do not need system calls,
+ * unlike FindNetworkInterface() and if_nametoindex().
+ *
+ * Load() fills the table with a full dump; after that, it can be
+ * kept up to date by passing RTNETLINK notifications to Feed() (see
+ * #NetworkInterfaceMonitor).
+ *
+ * This class is not thread-safe.
+ */
+class NetworkInterfaceTable {
+public:
+	struct Interface {
+		std::string name;
+
+		/**
+		 * The IFF_* flags.
+		 */
+		unsigned flags;
+	};
+
+private:
+	/**
+	 * The interfaces, indexed by their interface index.
+	 */
+	std::map<unsigned, Interface> interfaces;
+
+	/**
+	 * Maps interface names to interface indexes.
+	 */
+	std::map<std::string, unsigned, std::less<>> names;
+
+	struct AddressKey {
+		uint8_t family;
+		std::array<uint8_t, 16> address;
+
+		gcc_pure
+		bool operator==(const AddressKey &other) const noexcept {
+			return family == other.family &&
+				address == other.address;
+		}
+	};
+
+	struct AddressKeyHash {
+		gcc_pure
+		size_t operator()(const AddressKey &key) const noexcept;
+	};
+
+	/**
+	 * Maps local addresses to interface indexes.
+	 */
+	std::unordered_map<AddressKey, unsigned, AddressKeyHash> addresses;
+
+public:
+	bool IsEmpty() const noexcept {
+		return interfaces.empty();
+	}
+
+	size_t GetInterfaceCount() const noexcept {
+		return interfaces.size();
+	}
+
+	size_t GetAddressCount() const noexcept {
+		return addresses.size();
+	}
+
+	void Clear() noexcept {
+		interfaces.clear();
+		names.clear();
+		addresses.clear();
+	}
+
+	/**
+	 * Replace the contents with a full dump of all interfaces
+	 * and addresses.  This opens a temporary netlink socket and
+	 * blocks until the kernel has replied.
+	 *
+	 * Throws on error; the table is left unchanged then.
+	 */
+	void Load();
+
+	/**
+	 * Apply a buffer of RTNETLINK messages (RTM_NEWLINK,
+	 * RTM_DELLINK, RTM_NEWADDR, RTM_DELADDR); other messages
+	 * are ignored.
+	 *
+	 * @return false if the buffer contains NLMSG_DONE or
+	 * NLMSG_ERROR (which terminate a dump)
+	 */
+	bool Feed(const void *data, size_t size) noexcept;
+
+	/**
+	 * Find the interface with the given local address.
+	 *
+	 * @return the interface index or 0 if no matching network
+	 * interface was found
+	 */
+	gcc_pure
+	unsigned FindByAddress(SocketAddress address) const noexcept;
+
+	/**
+	 * @return the interface index or 0 if there is no such
+	 * interface
+	 */
+	gcc_pure
+	unsigned FindByName(const char *name) const noexcept;
+
+	/**
+	 * @return the interface or nullptr if there is no such
+	 * interface
+	 */
+	gcc_pure
+	const Interface *FindByIndex(unsigned index) const noexcept;
+
+private:
+	void Dump(SocketDescriptor s, uint16_t type, uint32_t seq);
+
+	void HandleLink(const struct nlmsghdr &nlh) noexcept;
+	void HandleAddress(const struct nlmsghdr &nlh) noexcept;
+
+	void RemoveInterface(unsigned index) noexcept;
+};
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "MaskedSocketAddressSet.hxx"
+#include "SocketAddress.hxx"
+
+#include <assert.h>
+#include <string.h>
+#include <netinet/in.h>
+
+/**
+ * Convert an IPv4 or IPv6 address to a 128 bit trie key.  IPv4
+ * addresses are mapped to "::ffff:a.b.c.d".
+ *
+ * @return the number of bits prepended to the address (96 for IPv4,
+ * 0 for IPv6) or -1 if this is neither IPv4 nor IPv6
+ */
+static int
+ToKey(SocketAddress address, uint8_t key[16]) noexcept
+{
+	if (address.IsNull() || !address.IsDefined())
+		return -1;
+
+	switch (address.GetFamily()) {
+	case AF_INET:
+		{
+			const auto &sin = *(const struct sockaddr_in *)
+				(const void *)address.GetAddress();
+			memset(key, 0, 10);
+			key[10] = key[11] = 0xff;
+			memcpy(key + 12, &sin.sin_addr, 4);
+			return 96;
+		}
+
+	case AF_INET6:
+		{
+			const auto &sin6 = *(const struct sockaddr_in6 *)
+				(const void *)address.GetAddress();
+			memcpy(key, &sin6.sin6_addr, 16);
+			return 0;
+		}
+
+	default:
+		return -1;
+	}
+}
+
+static constexpr unsigned
+GetBit(const uint8_t *key, unsigned i) noexcept
+{
+	return (key[i / 8] >> (7 - i % 8)) & 1;
+}
+
+MaskedSocketAddressSet::MaskedSocketAddressSet() noexcept
+	:nodes(1)
+{
+}
+
+void
+MaskedSocketAddressSet::Add(const uint8_t *key, unsigned prefix_length)
+{
+	assert(prefix_length <= 128);
+
+	uint32_t i = 0;
+	for (unsigned bit = 0; bit < prefix_length; ++bit) {
+		if (nodes[i].terminal)
+			/* a shorter prefix already covers this one */
+			return;
+
+		const unsigned b = GetBit(key, bit);
+		if (nodes[i].children[b] == 0) {
+			nodes[i].children[b] = nodes.size();
+			nodes.emplace_back();
+		}
+
+		i = nodes[i].children[b];
+	}
+
+	auto &node = nodes[i];
+	node.terminal = true;
+
+	/* longer prefixes below this node are redundant now; they
+	   stay in the vector (building is a one-time job), but are
+	   not reachable anymore */
+	node.children[0] = node.children[1] = 0;
+}
+
+void
+MaskedSocketAddressSet::Add(const MaskedSocketAddress &a)
+{
+	uint8_t key[16];
+	const int offset = ToKey(a.GetAddress(), key);
+	if (offset < 0) {
+		others.push_back(a);
+		return;
+	}
+
+	Add(key, offset + a.GetPrefixLength());
+}
+
+bool
+MaskedSocketAddressSet::Matches(SocketAddress address) const noexcept
+{
+	uint8_t key[16];
+	if (ToKey(address, key) < 0) {
+		for (const auto &i : others)
+			if (i.Matches(address))
+				return true;
+
+		return false;
+	}
+
+	uint32_t i = 0;
+	for (unsigned bit = 0;; ++bit) {
+		const auto &node = nodes[i];
+		if (node.terminal)
+			return true;
+
+		if (bit >= 128)
+			return false;
+
+		i = node.children[GetBit(key, bit)];
+		if (i == 0)
+			return false;
+	}
+}
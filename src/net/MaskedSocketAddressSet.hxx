@@ -0,0 +1,99 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "MaskedSocketAddress.hxx"
+#include "util/Compiler.h"
+
+#include <vector>
+
+#include <stdint.h>
+
+/**
+ * A compiled set of #MaskedSocketAddress instances which can be
+ * queried quickly.  IPv4 and IPv6 addresses are stored in a binary
+ * prefix trie (IPv4 addresses as IPv4-mapped IPv6 addresses, so
+ * one query matches both forms), and a lookup costs at most one
+ * step per address bit, regardless of the number of entries.  Other
+ * address families (e.g. local sockets) are compared linearly.
+ */
+class MaskedSocketAddressSet {
+	struct Node {
+		/**
+		 * Indexes into #nodes; 0 means "no child" (the root
+		 * node cannot be anybody's child).
+		 */
+		uint32_t children[2] = {0, 0};
+
+		/**
+		 * Does a prefix end at this node?
+		 */
+		bool terminal = false;
+	};
+
+	/**
+	 * The trie nodes; the first one is the root.
+	 */
+	std::vector<Node> nodes;
+
+	/**
+	 * Entries which are not IPv4 or IPv6.
+	 */
+	std::vector<MaskedSocketAddress> others;
+
+public:
+	MaskedSocketAddressSet() noexcept;
+
+	template<typename I>
+	MaskedSocketAddressSet(I begin, I end)
+		:MaskedSocketAddressSet() {
+		for (; begin != end; ++begin)
+			Add(*begin);
+	}
+
+	bool empty() const noexcept {
+		return !nodes.front().terminal && nodes.size() == 1 &&
+			others.empty();
+	}
+
+	void Add(const MaskedSocketAddress &a);
+
+	/**
+	 * Does any entry match the given address?
+	 */
+	gcc_pure
+	bool Matches(SocketAddress address) const noexcept;
+
+private:
+	void Add(const uint8_t *key, unsigned prefix_length);
+};
@@ -0,0 +1,292 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "MultiMessage.hxx"
+#include "SocketDescriptor.hxx"
+#include "system/Error.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <netinet/udp.h>
+#include <unistd.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+/**
+ * Round up to a multiple of sizeof(size_t), which is the alignment
+ * of struct cmsghdr.
+ */
+static constexpr size_t
+AlignCmsgSlot(size_t size) noexcept
+{
+	return (size + sizeof(size_t) - 1) / sizeof(size_t);
+}
+
+MultiReceiveMessage::MultiReceiveMessage(size_t _capacity,
+					 size_t _max_payload_size,
+					 size_t max_cmsg_size,
+					 bool want_addresses)
+	:capacity(_capacity), max_payload_size(_max_payload_size),
+	 cmsg_slot_size(AlignCmsgSlot(max_cmsg_size)),
+	 payloads(new uint8_t[capacity * max_payload_size]),
+	 cmsgs(cmsg_slot_size > 0
+	       ? new size_t[capacity * cmsg_slot_size]
+	       : nullptr),
+	 addresses(want_addresses
+		   ? new struct sockaddr_storage[capacity]
+		   : nullptr),
+	 iov(new struct iovec[capacity]),
+	 msgs(new struct mmsghdr[capacity]),
+	 results(new Result[capacity])
+{
+	assert(capacity > 0);
+	assert(max_payload_size > 0);
+
+	for (size_t i = 0; i < capacity; ++i) {
+		iov[i].iov_base = &payloads[i * max_payload_size];
+		iov[i].iov_len = max_payload_size;
+	}
+}
+
+void
+MultiReceiveMessage::Clear() noexcept
+{
+	for (size_t i = 0; i < n; ++i)
+		for (int fd : results[i].fds)
+			close(fd);
+
+	n = 0;
+}
+
+static void
+ParseControl(struct msghdr &msg, MultiReceiveMessage::Result &result) noexcept
+{
+#ifdef __clang__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wcast-align"
+#endif
+
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	while (cmsg != nullptr) {
+		if (cmsg->cmsg_level == SOL_SOCKET &&
+		    cmsg->cmsg_type == SCM_CREDENTIALS) {
+			result.cred = (const struct ucred *)CMSG_DATA(cmsg);
+		} else if (cmsg->cmsg_level == SOL_SOCKET &&
+			   cmsg->cmsg_type == SCM_RIGHTS) {
+			const int *fds = (const int *)CMSG_DATA(cmsg);
+			const size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(fds[0]);
+
+			if (result.fds.IsNull())
+				result.fds = {fds, n};
+			else
+				/* more than one SCM_RIGHTS message is
+				   not supported */
+				for (size_t i = 0; i < n; ++i)
+					close(fds[i]);
+		} else if (cmsg->cmsg_level == SOL_UDP &&
+			   cmsg->cmsg_type == UDP_GRO) {
+			int segment_size;
+			memcpy(&segment_size, CMSG_DATA(cmsg),
+			       sizeof(segment_size));
+			if (segment_size > 0)
+				result.segment_size = segment_size;
+		}
+
+		cmsg = CMSG_NXTHDR(&msg, cmsg);
+	}
+
+#ifdef __clang__
+#pragma GCC diagnostic pop
+#endif
+}
+
+size_t
+MultiReceiveMessage::Receive(SocketDescriptor s)
+{
+	Clear();
+
+	/* reset the fields modified by the kernel */
+	for (size_t i = 0; i < capacity; ++i) {
+		auto &msg = msgs[i].msg_hdr;
+		if (addresses) {
+			msg.msg_name = &addresses[i];
+			msg.msg_namelen = sizeof(addresses[i]);
+		} else {
+			msg.msg_name = nullptr;
+			msg.msg_namelen = 0;
+		}
+
+		msg.msg_iov = &iov[i];
+		msg.msg_iovlen = 1;
+
+		if (cmsg_slot_size > 0) {
+			msg.msg_control = &cmsgs[i * cmsg_slot_size];
+			msg.msg_controllen = cmsg_slot_size * sizeof(size_t);
+		} else {
+			msg.msg_control = nullptr;
+			msg.msg_controllen = 0;
+		}
+
+		msg.msg_flags = 0;
+	}
+
+	int result = recvmmsg(s.Get(), msgs.get(), capacity,
+			      MSG_DONTWAIT|MSG_CMSG_CLOEXEC, nullptr);
+	if (result < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return 0;
+
+		throw MakeErrno("recvmmsg() failed");
+	}
+
+	for (size_t i = 0; i < size_t(result); ++i) {
+		auto &msg = msgs[i].msg_hdr;
+		auto &r = results[i];
+
+		r.address = msg.msg_namelen > 0
+			? SocketAddress((const struct sockaddr *)msg.msg_name,
+					msg.msg_namelen)
+			: SocketAddress(nullptr);
+		r.payload = {iov[i].iov_base,
+			     std::min<size_t>(msgs[i].msg_len,
+					      max_payload_size)};
+		r.cred = nullptr;
+		r.fds = nullptr;
+		r.segment_size = 0;
+		r.truncated = (msg.msg_flags & MSG_TRUNC) != 0;
+		r.control_truncated = (msg.msg_flags & MSG_CTRUNC) != 0;
+
+		ParseControl(msg, r);
+	}
+
+	n = result;
+	return n;
+}
+
+MultiSendMessage::MultiSendMessage(size_t _capacity, size_t max_cmsg_size)
+	:capacity(_capacity),
+	 cmsg_slot_size(AlignCmsgSlot(max_cmsg_size)),
+	 cmsgs(cmsg_slot_size > 0
+	       ? new size_t[capacity * cmsg_slot_size]
+	       : nullptr),
+	 addresses(new struct sockaddr_storage[capacity]),
+	 iov(new struct iovec[capacity]),
+	 msgs(new struct mmsghdr[capacity])
+{
+	assert(capacity > 0);
+}
+
+bool
+MultiSendMessage::Add(ConstBuffer<void> payload, SocketAddress address,
+		      ConstBuffer<int> fds, uint16_t segment_size) noexcept
+{
+	if (IsFull())
+		return false;
+
+	const size_t cmsg_size = GetCmsgSize(fds.size, segment_size > 0);
+	assert(cmsg_size <= cmsg_slot_size * sizeof(size_t));
+
+	auto &v = iov[n];
+	v.iov_base = const_cast<void *>(payload.data);
+	v.iov_len = payload.size;
+
+	auto &m = msgs[n];
+	auto &msg = m.msg_hdr;
+	memset(&m, 0, sizeof(m));
+	msg.msg_iov = &v;
+	msg.msg_iovlen = 1;
+
+	if (!address.IsNull()) {
+		assert(address.GetSize() <= sizeof(addresses[n]));
+
+		memcpy(&addresses[n], address.GetAddress(), address.GetSize());
+		msg.msg_name = &addresses[n];
+		msg.msg_namelen = address.GetSize();
+	}
+
+	if (cmsg_size > 0) {
+		msg.msg_control = &cmsgs[n * cmsg_slot_size];
+		msg.msg_controllen = cmsg_size;
+
+		/* CMSG_NXTHDR() inspects the next header */
+		memset(msg.msg_control, 0, cmsg_size);
+
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+
+		if (!fds.empty()) {
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_RIGHTS;
+			cmsg->cmsg_len = CMSG_LEN(fds.size * sizeof(int));
+			memcpy(CMSG_DATA(cmsg), fds.data,
+			       fds.size * sizeof(int));
+			cmsg = CMSG_NXTHDR(&msg, cmsg);
+		}
+
+		if (segment_size > 0) {
+			cmsg->cmsg_level = SOL_UDP;
+			cmsg->cmsg_type = UDP_SEGMENT;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(segment_size));
+			memcpy(CMSG_DATA(cmsg), &segment_size,
+			       sizeof(segment_size));
+		}
+	}
+
+	++n;
+	return true;
+}
+
+size_t
+MultiSendMessage::Send(SocketDescriptor s, int flags)
+{
+	if (empty())
+		return 0;
+
+	int result = sendmmsg(s.Get(), &msgs[first], n - first, flags);
+	if (result < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			return 0;
+
+		throw MakeErrno("sendmmsg() failed");
+	}
+
+	first += result;
+	return result;
+}
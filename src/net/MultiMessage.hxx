@@ -0,0 +1,278 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "SocketAddress.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <memory>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+class SocketDescriptor;
+
+/**
+ * Receive many datagrams with one recvmmsg() call.  All buffers
+ * (payloads, control messages, addresses) are allocated by the
+ * constructor and reused for each Receive() call.
+ *
+ * Control messages are parsed: SCM_CREDENTIALS, SCM_RIGHTS and
+ * UDP_GRO.  Received file descriptors are owned by this object and
+ * are closed by the next Receive() call unless the caller obtains
+ * them with TakeFds().
+ */
+class MultiReceiveMessage {
+public:
+	struct Result {
+		/**
+		 * The sender address; SocketAddress::IsNull() if the
+		 * source address was not requested or if the socket
+		 * has none.
+		 */
+		SocketAddress address;
+
+		/**
+		 * The payload.  A stream or seqpacket socket whose peer
+		 * has closed the connection yields an empty payload.
+		 */
+		ConstBuffer<void> payload;
+
+		/**
+		 * Credentials from SCM_CREDENTIALS (requires
+		 * SO_PASSCRED), or nullptr.
+		 */
+		const struct ucred *cred;
+
+		/**
+		 * File descriptors from SCM_RIGHTS; still owned by
+		 * the #MultiReceiveMessage, see TakeFds().
+		 */
+		ConstBuffer<int> fds;
+
+		/**
+		 * The UDP_GRO segment size, or 0 if the message was
+		 * not coalesced.
+		 */
+		size_t segment_size;
+
+		/**
+		 * Was the payload (MSG_TRUNC) or were the control
+		 * messages (MSG_CTRUNC) truncated?
+		 */
+		bool truncated, control_truncated;
+	};
+
+private:
+	const size_t capacity, max_payload_size, cmsg_slot_size;
+
+	std::unique_ptr<uint8_t[]> payloads;
+	std::unique_ptr<size_t[]> cmsgs;
+	std::unique_ptr<struct sockaddr_storage[]> addresses;
+	std::unique_ptr<struct iovec[]> iov;
+	std::unique_ptr<struct mmsghdr[]> msgs;
+	std::unique_ptr<Result[]> results;
+
+	size_t n = 0;
+
+public:
+	/**
+	 * @param _capacity the maximum number of datagrams per
+	 * Receive() call
+	 * @param _max_payload_size the maximum size of one datagram;
+	 * larger datagrams are truncated
+	 * @param max_cmsg_size the control buffer size for each
+	 * datagram, e.g. CMSG_SPACE(sizeof(int) * max_fds); 0 means
+	 * control messages are not received
+	 * @param want_addresses receive source addresses?
+	 */
+	MultiReceiveMessage(size_t _capacity, size_t _max_payload_size,
+			    size_t max_cmsg_size=0,
+			    bool want_addresses=true);
+
+	~MultiReceiveMessage() noexcept {
+		Clear();
+	}
+
+	MultiReceiveMessage(const MultiReceiveMessage &) = delete;
+	MultiReceiveMessage &operator=(const MultiReceiveMessage &) = delete;
+
+	/**
+	 * Receive up to #capacity datagrams without blocking.  This
+	 * invalidates all results of the previous call.
+	 *
+	 * Throws on error.
+	 *
+	 * @return the number of datagrams received, 0 if the socket
+	 * would block
+	 */
+	size_t Receive(SocketDescriptor s);
+
+	/**
+	 * Discard all results and close all received file
+	 * descriptors which have not been taken.
+	 */
+	void Clear() noexcept;
+
+	bool empty() const noexcept {
+		return n == 0;
+	}
+
+	size_t size() const noexcept {
+		return n;
+	}
+
+	const Result &operator[](size_t i) const noexcept {
+		return results[i];
+	}
+
+	const Result *begin() const noexcept {
+		return results.get();
+	}
+
+	const Result *end() const noexcept {
+		return results.get() + n;
+	}
+
+	/**
+	 * Transfer ownership of the file descriptors received with
+	 * the given datagram to the caller, who is then responsible
+	 * for closing them.  After this call, Result::fds is empty.
+	 */
+	ConstBuffer<int> TakeFds(size_t i) noexcept {
+		auto fds = results[i].fds;
+		results[i].fds = nullptr;
+		return fds;
+	}
+};
+
+/**
+ * Send many datagrams with one sendmmsg() call.  The payloads are
+ * not copied; they must remain valid until they have been sent or
+ * Clear() has been called.  Addresses and control messages
+ * (SCM_RIGHTS, UDP_SEGMENT) are copied to buffers allocated by the
+ * constructor.
+ */
+class MultiSendMessage {
+	const size_t capacity, cmsg_slot_size;
+
+	std::unique_ptr<size_t[]> cmsgs;
+	std::unique_ptr<struct sockaddr_storage[]> addresses;
+	std::unique_ptr<struct iovec[]> iov;
+	std::unique_ptr<struct mmsghdr[]> msgs;
+
+	/**
+	 * The number of datagrams added with Add().
+	 */
+	size_t n = 0;
+
+	/**
+	 * The index of the first datagram which has not been sent
+	 * yet.
+	 */
+	size_t first = 0;
+
+public:
+	/**
+	 * @param _capacity the maximum number of datagrams
+	 * @param max_cmsg_size the maximum control buffer size for
+	 * each datagram; use GetCmsgSize() to calculate it
+	 */
+	explicit MultiSendMessage(size_t _capacity, size_t max_cmsg_size=0);
+
+	MultiSendMessage(const MultiSendMessage &) = delete;
+	MultiSendMessage &operator=(const MultiSendMessage &) = delete;
+
+	/**
+	 * Calculate the control buffer size needed for a datagram
+	 * with the given number of file descriptors and with or
+	 * without UDP_SEGMENT.
+	 */
+	static constexpr size_t GetCmsgSize(size_t max_fds,
+					    bool segment=false) noexcept {
+		return (max_fds > 0 ? CMSG_SPACE(max_fds * sizeof(int)) : 0) +
+			(segment ? CMSG_SPACE(sizeof(uint16_t)) : 0);
+	}
+
+	bool empty() const noexcept {
+		return first == n;
+	}
+
+	bool IsFull() const noexcept {
+		return n == capacity;
+	}
+
+	/**
+	 * The number of datagrams which have been added but not yet
+	 * sent.
+	 */
+	size_t GetPending() const noexcept {
+		return n - first;
+	}
+
+	/**
+	 * Add a datagram.
+	 *
+	 * @param address the destination address; nullptr for
+	 * connected sockets
+	 * @param fds file descriptors to be passed with SCM_RIGHTS
+	 * (they are not closed or duplicated)
+	 * @param segment_size if non-zero, the kernel splits the
+	 * payload into datagrams of this size (UDP_SEGMENT, generic
+	 * segmentation offload)
+	 * @return false if the batch is full
+	 */
+	bool Add(ConstBuffer<void> payload, SocketAddress address=nullptr,
+		 ConstBuffer<int> fds=nullptr,
+		 uint16_t segment_size=0) noexcept;
+
+	/**
+	 * Send all pending datagrams (as far as the socket accepts
+	 * them).  Datagrams which were not sent remain pending for
+	 * the next call.
+	 *
+	 * Throws on error.
+	 *
+	 * @return the number of datagrams sent, 0 if the socket
+	 * would block
+	 */
+	size_t Send(SocketDescriptor s, int flags=MSG_DONTWAIT|MSG_NOSIGNAL);
+
+	/**
+	 * Discard all datagrams, sent or not.
+	 */
+	void Clear() noexcept {
+		n = first = 0;
+	}
+};
@@ -0,0 +1,302 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "NumericParser.hxx"
+#include "StaticSocketAddress.hxx"
+#include "util/CharUtil.hxx"
+
+#include <string.h>
+#include <netinet/in.h>
+
+/**
+ * Parse a decimal number without sign or leading zeroes.
+ *
+ * @return the number of characters consumed or 0 on error
+ */
+static size_t
+ParseDecimal(const char *p, const char *end, unsigned max,
+	     unsigned &value_r) noexcept
+{
+	const char *const begin = p;
+	unsigned value = 0;
+
+	while (p != end && IsDigitASCII(*p)) {
+		if (p > begin && value == 0)
+			/* leading zero: inet_aton() would interpret
+			   this as octal */
+			return 0;
+
+		value = value * 10 + (*p++ - '0');
+		if (value > max)
+			return 0;
+	}
+
+	value_r = value;
+	return p - begin;
+}
+
+/**
+ * Parse up to four hexadecimal digits.
+ *
+ * @return the number of characters consumed or 0 on error
+ */
+static size_t
+ParseHex16(const char *p, const char *end, unsigned &value_r) noexcept
+{
+	const char *const begin = p;
+	unsigned value = 0;
+
+	while (p != end && p - begin < 4) {
+		const char ch = *p;
+		unsigned digit;
+		if (IsDigitASCII(ch))
+			digit = ch - '0';
+		else if (ch >= 'a' && ch <= 'f')
+			digit = ch - 'a' + 10;
+		else if (ch >= 'A' && ch <= 'F')
+			digit = ch - 'A' + 10;
+		else
+			break;
+
+		value = (value << 4) | digit;
+		++p;
+	}
+
+	value_r = value;
+	return p - begin;
+}
+
+static bool
+ParseNumericIPv4(const char *p, const char *end, uint8_t dest[4]) noexcept
+{
+	for (unsigned i = 0; i < 4; ++i) {
+		if (i > 0) {
+			if (p == end || *p != '.')
+				return false;
+			++p;
+		}
+
+		unsigned value;
+		const size_t n = ParseDecimal(p, end, 255, value);
+		if (n == 0)
+			return false;
+
+		dest[i] = value;
+		p += n;
+	}
+
+	return p == end;
+}
+
+bool
+ParseNumericIPv4(StringView s, struct in_addr &dest) noexcept
+{
+	uint8_t bytes[4];
+	if (!ParseNumericIPv4(s.begin(), s.end(), bytes))
+		return false;
+
+	memcpy(&dest, bytes, sizeof(bytes));
+	return true;
+}
+
+bool
+ParseNumericIPv6(StringView s, struct in6_addr &dest) noexcept
+{
+	const char *p = s.begin(), *const end = s.end();
+
+	uint8_t bytes[16];
+	unsigned n = 0;
+
+	/* the position of "::" in #bytes, or -1 */
+	int gap = -1;
+
+	if (p != end && *p == ':') {
+		/* the only way to start with a colon is "::" */
+		if (end - p < 2 || p[1] != ':')
+			return false;
+
+		gap = 0;
+		p += 2;
+	}
+
+	while (p != end && n < 16) {
+		unsigned value;
+		const size_t length = ParseHex16(p, end, value);
+		if (length == 0)
+			return false;
+
+		if (p + length != end && p[length] == '.') {
+			/* embedded IPv4 address (RFC 4291 2.2.3) */
+			if (n > 12 ||
+			    !ParseNumericIPv4(p, end, bytes + n))
+				return false;
+
+			n += 4;
+			p = end;
+			break;
+		}
+
+		bytes[n++] = value >> 8;
+		bytes[n++] = value;
+		p += length;
+
+		if (p == end)
+			break;
+
+		if (*p != ':')
+			return false;
+
+		++p;
+
+		if (p != end && *p == ':') {
+			if (gap >= 0)
+				/* more than one "::" */
+				return false;
+
+			gap = n;
+			++p;
+		} else if (p == end)
+			/* trailing single colon */
+			return false;
+	}
+
+	if (p != end)
+		return false;
+
+	if (gap >= 0) {
+		if (n == 16)
+			/* "::" must stand for at least one group */
+			return false;
+
+		/* move the part after "::" to the end and fill the
+		   gap with zeroes */
+		const unsigned tail = n - gap;
+		memmove(bytes + 16 - tail, bytes + gap, tail);
+		memset(bytes + gap, 0, 16 - n);
+	} else if (n != 16)
+		return false;
+
+	memcpy(&dest, bytes, sizeof(bytes));
+	return true;
+}
+
+static bool
+ParsePort(const char *p, unsigned default_port, unsigned &port_r) noexcept
+{
+	if (*p == 0) {
+		port_r = default_port;
+		return true;
+	}
+
+	if (*p != ':')
+		return false;
+
+	++p;
+
+	const char *end = p + strlen(p);
+	const size_t n = ParseDecimal(p, end, 0xffff, port_r);
+	return n > 0 && p + n == end;
+}
+
+bool
+ParseNumericSocketAddress(StaticSocketAddress &dest, const char *s,
+			  unsigned default_port) noexcept
+{
+	const char *host, *host_end, *rest;
+	bool bracket = false;
+
+	if (*s == '[') {
+		host = s + 1;
+		host_end = strchr(host, ']');
+		if (host_end == nullptr)
+			return false;
+
+		rest = host_end + 1;
+		bracket = true;
+	} else {
+		host = s;
+
+		/* a colon can be a port separator only after an IPv4
+		   address (one colon); more than one colon means this
+		   is an IPv6 address without port */
+		const char *colon = strchr(s, ':');
+		if (colon != nullptr && strchr(colon + 1, ':') == nullptr) {
+			host_end = colon;
+		} else
+			host_end = s + strlen(s);
+
+		rest = host_end;
+	}
+
+	unsigned port;
+	if (!ParsePort(rest, default_port, port))
+		return false;
+
+	const char *percent = (const char *)memchr(host, '%', host_end - host);
+
+	struct in_addr in;
+	if (!bracket && percent == nullptr &&
+	    ParseNumericIPv4({host, host_end}, in)) {
+		auto &sin = *(struct sockaddr_in *)(struct sockaddr *)dest;
+		memset(&sin, 0, sizeof(sin));
+		sin.sin_family = AF_INET;
+		sin.sin_port = htons(port);
+		sin.sin_addr = in;
+		dest.SetSize(sizeof(sin));
+		return true;
+	}
+
+	unsigned scope_id = 0;
+	if (percent != nullptr) {
+		/* only numeric interface indexes; interface names
+		   are left to getaddrinfo() */
+		const size_t n = ParseDecimal(percent + 1, host_end,
+					      0xffffffff / 10, scope_id);
+		if (n == 0 || percent + 1 + n != host_end)
+			return false;
+
+		host_end = percent;
+	}
+
+	struct in6_addr in6;
+	if (!ParseNumericIPv6({host, host_end}, in6))
+		return false;
+
+	auto &sin6 = *(struct sockaddr_in6 *)(struct sockaddr *)dest;
+	memset(&sin6, 0, sizeof(sin6));
+	sin6.sin6_family = AF_INET6;
+	sin6.sin6_port = htons(port);
+	sin6.sin6_addr = in6;
+	sin6.sin6_scope_id = scope_id;
+	dest.SetSize(sizeof(sin6));
+	return true;
+}
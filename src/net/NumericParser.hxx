@@ -0,0 +1,80 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Allocation-free parsers for numeric IPv4 and IPv6 addresses which
+ * do not need getaddrinfo().
+ */
+
+#pragma once
+
+#include "util/StringView.hxx"
+#include "util/Compiler.h"
+
+struct in_addr;
+struct in6_addr;
+class StaticSocketAddress;
+
+/**
+ * Parse a strict dotted-quad IPv4 address ("192.168.1.2").  The
+ * legacy forms accepted by inet_aton() (e.g. "127.1" or octal
+ * numbers) are rejected.
+ */
+gcc_pure
+bool
+ParseNumericIPv4(StringView s, struct in_addr &dest) noexcept;
+
+/**
+ * Parse an IPv6 address in the text form described in RFC 4291 2.2,
+ * including "::" compression and an embedded dotted-quad IPv4
+ * address at the end.  A scope suffix ("%2") is not allowed here.
+ */
+gcc_pure
+bool
+ParseNumericIPv6(StringView s, struct in6_addr &dest) noexcept;
+
+/**
+ * Parse a numeric socket address in one of the forms "IPv4",
+ * "IPv4:PORT", "IPv6", "IPv6%SCOPE" and "[IPv6%SCOPE]:PORT"
+ * (brackets and scope optional) into the given buffer.  SCOPE must
+ * be a numeric interface index.
+ *
+ * This covers the common cases of ParseSocketAddress() without
+ * the overhead of getaddrinfo().
+ *
+ * @return true on success, false if the string is not in one of the
+ * supported forms (which does not mean it is invalid; the caller
+ * should fall back to the resolver)
+ */
+bool
+ParseNumericSocketAddress(StaticSocketAddress &dest, const char *s,
+			  unsigned default_port) noexcept;
@@ -33,6 +33,8 @@
 #include "Parser.hxx"
 #include "AddressInfo.hxx"
 #include "Resolver.hxx"
+#include "NumericParser.hxx"
+#include "StaticSocketAddress.hxx"
 #include "AllocatedSocketAddress.hxx"
 
 #include <stdexcept>
@@ -61,6 +63,13 @@ ParseSocketAddress(const char *p, int default_port, bool passive)
 #endif
 	}
 
+	/* fast path for the common numeric forms; everything else
+	   (host names, wildcards, interface names, service names) is
+	   handled by getaddrinfo() */
+	StaticSocketAddress numeric;
+	if (ParseNumericSocketAddress(numeric, p, default_port))
+		return AllocatedSocketAddress(numeric);
+
 	static constexpr struct addrinfo hints = {
 		.ai_flags = AI_NUMERICHOST|AI_ADDRCONFIG,
 		.ai_family = AF_UNSPEC,
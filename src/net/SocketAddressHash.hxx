@@ -0,0 +1,66 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "SocketAddress.hxx"
+#include "StaticSocketAddress.hxx"
+#include "AllocatedSocketAddress.hxx"
+#include "util/FNVHash.hxx"
+#include "util/Compiler.h"
+
+#include <functional>
+
+/**
+ * A hash function for #SocketAddress which is consistent with
+ * SocketAddress::operator==(), i.e. it covers all bytes of the
+ * address including the port.
+ */
+struct SocketAddressHash {
+	gcc_pure
+	size_t operator()(SocketAddress address) const noexcept {
+		return FNV1aHash64(address.GetAddress(), address.GetSize());
+	}
+};
+
+namespace std {
+
+template<>
+struct hash<SocketAddress> : SocketAddressHash {};
+
+template<>
+struct hash<StaticSocketAddress> : SocketAddressHash {};
+
+template<>
+struct hash<AllocatedSocketAddress> : SocketAddressHash {};
+
+} /* namespace std */
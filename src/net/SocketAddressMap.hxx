@@ -0,0 +1,292 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "SocketAddressHash.hxx"
+#include "util/Manual.hxx"
+
+#include <memory>
+#include <utility>
+
+#include <assert.h>
+
+/**
+ * A hash map with #SocketAddress keys using open addressing with
+ * linear probing.  The keys are stored inline in
+ * #StaticSocketAddress instances, so lookups and insertions need no
+ * string conversion and (except for growing the table) no heap
+ * allocation.
+ *
+ * Keys are compared with all bytes, including the port; to key on
+ * the host only, clear the port before using the address.
+ *
+ * Pointers and references to values are invalidated by insertions
+ * (which may grow the table) and by erasures (which may move other
+ * entries).
+ */
+template<typename V, typename Hash=SocketAddressHash>
+class SocketAddressMap {
+	struct Slot {
+		/**
+		 * The key; its family is AF_UNSPEC if this slot is
+		 * unused.
+		 */
+		StaticSocketAddress key;
+
+		size_t hash;
+
+		Manual<V> value;
+
+		Slot() noexcept {
+			key.Clear();
+		}
+
+		~Slot() noexcept {
+			if (IsUsed())
+				value.Destruct();
+		}
+
+		bool IsUsed() const noexcept {
+			return key.IsDefined();
+		}
+	};
+
+	std::unique_ptr<Slot[]> slots;
+
+	/**
+	 * The capacity minus one; the capacity is always a power of
+	 * two.
+	 */
+	size_t mask = 0;
+
+	size_t n = 0;
+
+	Hash hash_function;
+
+public:
+	SocketAddressMap() = default;
+
+	explicit SocketAddressMap(size_t initial_capacity) {
+		Rehash(RoundCapacity(initial_capacity));
+	}
+
+	SocketAddressMap(SocketAddressMap &&) = default;
+	SocketAddressMap &operator=(SocketAddressMap &&) = default;
+
+	bool empty() const noexcept {
+		return n == 0;
+	}
+
+	size_t size() const noexcept {
+		return n;
+	}
+
+	size_t capacity() const noexcept {
+		return slots ? mask + 1 : 0;
+	}
+
+	void clear() noexcept {
+		slots.reset();
+		mask = 0;
+		n = 0;
+	}
+
+	gcc_pure
+	V *Find(SocketAddress key) noexcept {
+		Slot *slot = FindSlot(key, hash_function(key));
+		return slot != nullptr ? &slot->value.Get() : nullptr;
+	}
+
+	gcc_pure
+	const V *Find(SocketAddress key) const noexcept {
+		return const_cast<SocketAddressMap *>(this)->Find(key);
+	}
+
+	/**
+	 * Insert a new value constructed from the given arguments
+	 * unless the key exists already.
+	 *
+	 * @return a reference to the value and true if it was
+	 * inserted, false if it existed already
+	 */
+	template<typename... Args>
+	std::pair<V &, bool> Emplace(SocketAddress key, Args&&... args) {
+		assert(!key.IsNull());
+		assert(key.IsDefined());
+
+		const size_t hash = hash_function(key);
+		Slot *slot = FindSlot(key, hash);
+		if (slot != nullptr)
+			return {slot->value.Get(), false};
+
+		if ((n + 1) * 4 > capacity() * 3)
+			Rehash(slots ? capacity() * 2 : 8);
+
+		slot = &FindFreeSlot(hash);
+		slot->value.Construct(std::forward<Args>(args)...);
+		slot->key = key;
+		slot->hash = hash;
+		++n;
+		return {slot->value.Get(), true};
+	}
+
+	V &operator[](SocketAddress key) {
+		return Emplace(key).first;
+	}
+
+	/**
+	 * @return true if the key was found and removed
+	 */
+	bool Erase(SocketAddress key) noexcept {
+		Slot *slot = FindSlot(key, hash_function(key));
+		if (slot == nullptr)
+			return false;
+
+		EraseSlot(slot - slots.get());
+		return true;
+	}
+
+	/**
+	 * Remove all entries for which the predicate (invoked with
+	 * the key and a reference to the value) returns true.  The
+	 * predicate may be invoked more than once for an entry.
+	 */
+	template<typename P>
+	void EraseIf(P &&p) noexcept {
+		for (size_t i = 0; i < capacity();) {
+			Slot &slot = slots[i];
+			if (slot.IsUsed() &&
+			    p((SocketAddress)slot.key, slot.value.Get()))
+				/* don't advance: EraseSlot() may have
+				   moved another entry here */
+				EraseSlot(i);
+			else
+				++i;
+		}
+	}
+
+	/**
+	 * Invoke the function for each entry with the key and a
+	 * reference to the value.
+	 */
+	template<typename F>
+	void ForEach(F &&f) {
+		for (size_t i = 0; i < capacity(); ++i) {
+			Slot &slot = slots[i];
+			if (slot.IsUsed())
+				f((SocketAddress)slot.key, slot.value.Get());
+		}
+	}
+
+private:
+	static constexpr size_t RoundCapacity(size_t n) noexcept {
+		size_t capacity = 8;
+		while (capacity * 3 < n * 4)
+			capacity *= 2;
+		return capacity;
+	}
+
+	gcc_pure
+	Slot *FindSlot(SocketAddress key, size_t hash) noexcept {
+		if (!slots)
+			return nullptr;
+
+		for (size_t i = hash & mask;; i = (i + 1) & mask) {
+			Slot &slot = slots[i];
+			if (!slot.IsUsed())
+				return nullptr;
+
+			if (slot.hash == hash && slot.key == key)
+				return &slot;
+		}
+	}
+
+	Slot &FindFreeSlot(size_t hash) noexcept {
+		for (size_t i = hash & mask;; i = (i + 1) & mask)
+			if (!slots[i].IsUsed())
+				return slots[i];
+	}
+
+	void MoveSlot(Slot &dest, Slot &src) noexcept {
+		dest.value.Construct(std::move(src.value.Get()));
+		dest.key = src.key;
+		dest.hash = src.hash;
+
+		src.value.Destruct();
+		src.key.Clear();
+	}
+
+	/**
+	 * Remove the entry in the given slot and close the gap with
+	 * backward-shift deletion, which avoids tombstones.
+	 */
+	void EraseSlot(size_t i) noexcept {
+		slots[i].value.Destruct();
+		slots[i].key.Clear();
+		--n;
+
+		for (size_t j = (i + 1) & mask;; j = (j + 1) & mask) {
+			Slot &slot = slots[j];
+			if (!slot.IsUsed())
+				break;
+
+			/* can this entry be moved to the gap, i.e. is
+			   its home slot not in the cyclic range
+			   (i, j]? */
+			const size_t home = slot.hash & mask;
+			if (((j - home) & mask) >= ((j - i) & mask)) {
+				MoveSlot(slots[i], slot);
+				i = j;
+			}
+		}
+	}
+
+	void Rehash(size_t new_capacity) {
+		assert(new_capacity > n);
+
+		const size_t old_capacity = capacity();
+		auto old_slots = std::move(slots);
+
+		slots.reset(new Slot[new_capacity]);
+		mask = new_capacity - 1;
+
+		if (!old_slots)
+			return;
+
+		for (size_t i = 0; i < old_capacity; ++i) {
+			Slot &old = old_slots[i];
+			if (old.IsUsed())
+				MoveSlot(FindFreeSlot(old.hash), old);
+		}
+	}
+};
@@ -38,6 +38,7 @@
 
 #include <assert.h>
 #include <sys/un.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
 
 void
@@ -88,12 +89,27 @@ SocketConfig::Create(int type) const
 	    !fd.SetReuseAddress(true))
 		throw MakeErrno("Failed to set SO_REUSEADDR");
 
-	if (reuse_port && !fd.SetReusePort())
+	if ((reuse_port || reuse_port_cpu) && !fd.SetReusePort())
 		throw MakeErrno("Failed to set SO_REUSEPORT");
 
 	if (free_bind && !fd.SetFreeBind())
 		throw MakeErrno("Failed to set SO_FREEBIND");
 
+	if (receive_buffer > 0 &&
+	    !fd.SetIntOption(SOL_SOCKET, SO_RCVBUF, receive_buffer))
+		throw MakeErrno("Failed to set SO_RCVBUF");
+
+	if (send_buffer > 0 &&
+	    !fd.SetIntOption(SOL_SOCKET, SO_SNDBUF, send_buffer))
+		throw MakeErrno("Failed to set SO_SNDBUF");
+
+	if (receive_low_water > 0 &&
+	    !fd.SetIntOption(SOL_SOCKET, SO_RCVLOWAT, receive_low_water))
+		throw MakeErrno("Failed to set SO_RCVLOWAT");
+
+	if (busy_poll > 0 && !fd.SetBusyPoll(busy_poll, prefer_busy_poll))
+		throw MakeErrno("Failed to set SO_BUSY_POLL");
+
 	if (!fd.Bind(bind_address)) {
 		const int e = errno;
 
@@ -125,10 +141,22 @@ SocketConfig::Create(int type) const
 
 		if (tcp_defer_accept > 0)
 			fd.SetTcpDeferAccept(tcp_defer_accept);
+
+		if (tcp_not_sent_low_water > 0 &&
+		    !fd.SetIntOption(SOL_TCP, TCP_NOTSENT_LOWAT,
+				     tcp_not_sent_low_water))
+			throw MakeErrno("Failed to set TCP_NOTSENT_LOWAT");
 	}
 
 	if (listen > 0 && !fd.Listen(listen))
 		throw MakeErrno("Failed to listen");
 
+	/* this must be done after listen(), because a TCP socket
+	   joins its SO_REUSEPORT group only then; the program is
+	   shared by the whole group, and attaching it again with each
+	   new socket is harmless */
+	if (reuse_port_cpu && !fd.AttachReusePortCpuFilter())
+		throw MakeErrno("Failed to attach SO_REUSEPORT CPU filter");
+
 	return fd;
 }
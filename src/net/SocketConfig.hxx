@@ -59,8 +59,47 @@ struct SocketConfig {
 	 */
 	unsigned tcp_defer_accept = 0;
 
+	/**
+	 * If non-zero, sets SO_BUSY_POLL.  Value is a number of
+	 * microseconds.
+	 */
+	unsigned busy_poll = 0;
+
+	/**
+	 * If non-zero, sets SO_RCVBUF / SO_SNDBUF.  Value is a number
+	 * of bytes.
+	 */
+	unsigned receive_buffer = 0, send_buffer = 0;
+
+	/**
+	 * If non-zero, sets SO_RCVLOWAT.  Value is a number of bytes.
+	 */
+	unsigned receive_low_water = 0;
+
+	/**
+	 * If non-zero, sets TCP_NOTSENT_LOWAT.  Value is a number of
+	 * bytes.
+	 */
+	unsigned tcp_not_sent_low_water = 0;
+
+	/**
+	 * Set SO_PREFER_BUSY_POLL (only if #busy_poll is set)?
+	 */
+	bool prefer_busy_poll = false;
+
 	bool reuse_port = false;
 
+	/**
+	 * Steer incoming connections/datagrams to the
+	 * SO_REUSEPORT socket whose index equals the CPU which
+	 * received the packet (see
+	 * SocketDescriptor::AttachReusePortCpuFilter()).  This only
+	 * makes sense if one socket per CPU is created in CPU order,
+	 * each handled by a thread pinned to that CPU, e.g. with
+	 * #ShardedServerSocket.  Implies #reuse_port.
+	 */
+	bool reuse_port_cpu = false;
+
 	bool free_bind = false;
 
 	bool pass_cred = false;
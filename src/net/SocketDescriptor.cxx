@@ -32,6 +32,7 @@
 #include "StaticSocketAddress.hxx"
 #include "IPv4Address.hxx"
 #include "IPv6Address.hxx"
+#include "util/Macros.hxx"
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -40,6 +41,10 @@
 #include <sys/socket.h>
 #endif
 
+#ifdef __linux__
+#include <linux/filter.h>
+#endif
+
 #include <errno.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -225,6 +230,28 @@ SocketDescriptor::SetReusePort(bool value)
 	return SetBoolOption(SOL_SOCKET, SO_REUSEPORT, value);
 }
 
+bool
+SocketDescriptor::AttachReusePortCpuFilter() noexcept
+{
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+	/* A = CPU number; return A */
+	static struct sock_filter code[] = {
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS, uint32_t(SKF_AD_OFF + SKF_AD_CPU)),
+		BPF_STMT(BPF_RET|BPF_A, 0),
+	};
+
+	struct sock_fprog program;
+	program.len = ARRAY_SIZE(code);
+	program.filter = code;
+
+	return SetOption(SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+			 &program, sizeof(program));
+#else
+	errno = ENOPROTOOPT;
+	return false;
+#endif
+}
+
 bool
 SocketDescriptor::SetFreeBind(bool value)
 {
@@ -267,6 +294,36 @@ SocketDescriptor::SetTcpFastOpen(int qlen)
 	return SetOption(SOL_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen));
 }
 
+bool
+SocketDescriptor::SetBusyPoll(unsigned usecs, bool prefer)
+{
+	if (!SetIntOption(SOL_SOCKET, SO_BUSY_POLL, usecs))
+		return false;
+
+#ifdef SO_PREFER_BUSY_POLL
+	if (prefer && !SetBoolOption(SOL_SOCKET, SO_PREFER_BUSY_POLL, true))
+		return false;
+#else
+	(void)prefer;
+#endif
+
+	return true;
+}
+
+unsigned
+SocketDescriptor::GetIncomingNapiId() const noexcept
+{
+#ifdef SO_INCOMING_NAPI_ID
+	unsigned id;
+	if (GetOption(SOL_SOCKET, SO_INCOMING_NAPI_ID,
+		      &id, sizeof(id)) < sizeof(id))
+		return 0;
+	return id;
+#else
+	return 0;
+#endif
+}
+
 bool
 SocketDescriptor::AddMembership(const IPv4Address &address)
 {
@@ -150,9 +150,25 @@ public:
 		return SetOption(level, name, &value, sizeof(value));
 	}
 
+	bool SetIntOption(int level, int name, const int &value) {
+		return SetOption(level, name, &value, sizeof(value));
+	}
+
 #ifdef __linux__
 	bool SetReuseAddress(bool value=true);
 	bool SetReusePort(bool value=true);
+
+	/**
+	 * Attach a classic BPF program to this socket's SO_REUSEPORT
+	 * group which selects the socket whose index in the group
+	 * (i.e. the order of bind() calls) equals the number of the
+	 * CPU which received the packet.  If there is no such socket,
+	 * the kernel falls back to its hash.
+	 *
+	 * The socket must have SO_REUSEPORT enabled.
+	 */
+	bool AttachReusePortCpuFilter() noexcept;
+
 	bool SetFreeBind(bool value=true);
 	bool SetNoDelay(bool value=true);
 	bool SetCork(bool value=true);
@@ -167,6 +183,24 @@ public:
 
 	bool SetTcpFastOpen(int qlen=16);
 
+	/**
+	 * Setter for SO_BUSY_POLL (and SO_PREFER_BUSY_POLL if
+	 * #prefer is true).
+	 *
+	 * @param usecs the number of microseconds to busy-poll the
+	 * device queue on blocking receives
+	 */
+	bool SetBusyPoll(unsigned usecs, bool prefer=false);
+
+	/**
+	 * Returns the NAPI id of the device queue which received the
+	 * last packet on this socket (SO_INCOMING_NAPI_ID), or 0 if
+	 * unknown.  This can be used to steer connections to the
+	 * thread which polls that queue.
+	 */
+	gcc_pure
+	unsigned GetIncomingNapiId() const noexcept;
+
 	bool AddMembership(const IPv4Address &address);
 	bool AddMembership(const IPv6Address &address);
 	bool AddMembership(SocketAddress address);
@@ -32,33 +32,194 @@
 
 #include "ToString.hxx"
 #include "SocketAddress.hxx"
-#include "IPv4Address.hxx"
-#include "IPv6Address.hxx"
 
 #include <algorithm>
 
 #include <assert.h>
 #include <sys/un.h>
-#include <netdb.h>
+#include <netinet/in.h>
+#include <net/if.h>
 #include <string.h>
 #include <stdint.h>
 
-static SocketAddress
-ipv64_normalize_mapped(SocketAddress address)
+/**
+ * The maximum length of a formatted IPv6 address with scope, brackets
+ * and port, not including the null terminator.
+ */
+static constexpr size_t MAX_FORMATTED = 45 + 1 + IF_NAMESIZE + 2 + 6;
+
+static char *
+FormatDecimal(char *p, unsigned value) noexcept
+{
+	char tmp[10];
+	char *q = tmp + sizeof(tmp);
+	do {
+		*--q = '0' + value % 10;
+		value /= 10;
+	} while (value > 0);
+
+	return std::copy(q, tmp + sizeof(tmp), p);
+}
+
+static char *
+FormatIPv4(char *p, const uint8_t *a) noexcept
+{
+	for (unsigned i = 0; i < 4; ++i) {
+		if (i > 0)
+			*p++ = '.';
+		p = FormatDecimal(p, a[i]);
+	}
+
+	return p;
+}
+
+static char *
+FormatHex16(char *p, unsigned value) noexcept
+{
+	static constexpr char digits[] = "0123456789abcdef";
+
+	/* no leading zeroes (RFC 5952 4.1) */
+	bool started = false;
+	for (int shift = 12; shift >= 0; shift -= 4) {
+		const unsigned digit = (value >> shift) & 0xf;
+		if (digit != 0 || started || shift == 0) {
+			*p++ = digits[digit];
+			started = true;
+		}
+	}
+
+	return p;
+}
+
+/**
+ * Format an IPv6 address according to RFC 5952.
+ */
+static char *
+FormatIPv6(char *p, const uint8_t *a) noexcept
 {
-	const auto &a6 = *(const struct sockaddr_in6 *)(const void *)address.GetAddress();
+	unsigned groups[8];
+	for (unsigned i = 0; i < 8; ++i)
+		groups[i] = (a[i * 2] << 8) | a[i * 2 + 1];
 
-	if (!address.IsV4Mapped())
-		return address;
+	/* find the longest run of zero groups; only runs of at least
+	   two groups are compressed, and the first one wins a tie
+	   (RFC 5952 4.2) */
+	int best_start = -1;
+	unsigned best_length = 1;
+	for (unsigned i = 0; i < 8;) {
+		if (groups[i] != 0) {
+			++i;
+			continue;
+		}
 
-	struct in_addr inaddr;
-	memcpy(&inaddr, ((const char *)&a6.sin6_addr) + 12, sizeof(inaddr));
-	const uint16_t port = FromBE16(a6.sin6_port);
+		unsigned j = i;
+		while (j < 8 && groups[j] == 0)
+			++j;
 
-	static IPv4Address a4;
-	a4 = {inaddr, port};
+		if (j - i > best_length) {
+			best_start = i;
+			best_length = j - i;
+		}
 
-	return a4;
+		i = j;
+	}
+
+	for (unsigned i = 0; i < 8; ++i) {
+		if (int(i) == best_start) {
+			*p++ = ':';
+			if (i == 0)
+				*p++ = ':';
+			i += best_length - 1;
+			continue;
+		}
+
+		p = FormatHex16(p, groups[i]);
+		if (i < 7)
+			*p++ = ':';
+	}
+
+	return p;
+}
+
+static constexpr bool
+IsLinkLocal(const uint8_t *a) noexcept
+{
+	return (a[0] == 0xfe && (a[1] & 0xc0) == 0x80) ||
+		(a[0] == 0xff && (a[1] & 0x0f) == 0x02);
+}
+
+/**
+ * Format the host part of an IPv4 or IPv6 address (with
+ * IPv4-mapped addresses converted to plain IPv4).
+ *
+ * @param brackets enclose IPv6 addresses in square brackets?
+ * @return the end of the string or nullptr if the address family is
+ * not supported
+ */
+static char *
+FormatHost(char *p, SocketAddress address, bool brackets) noexcept
+{
+	switch (address.GetFamily()) {
+	case AF_INET:
+		{
+			const auto &sin = *(const struct sockaddr_in *)
+				(const void *)address.GetAddress();
+			return FormatIPv4(p, (const uint8_t *)&sin.sin_addr);
+		}
+
+	case AF_INET6:
+		{
+			const auto &sin6 = *(const struct sockaddr_in6 *)
+				(const void *)address.GetAddress();
+			const auto *a = (const uint8_t *)&sin6.sin6_addr;
+
+			if (address.IsV4Mapped())
+				return FormatIPv4(p, a + 12);
+
+			if (brackets)
+				*p++ = '[';
+
+			p = FormatIPv6(p, a);
+
+			if (sin6.sin6_scope_id != 0) {
+				*p++ = '%';
+
+				/* like getnameinfo(), use the interface
+				   name for link-local addresses */
+				char name[IF_NAMESIZE];
+				if (IsLinkLocal(a) &&
+				    if_indextoname(sin6.sin6_scope_id, name) != nullptr)
+					p = stpcpy(p, name);
+				else
+					p = FormatDecimal(p, sin6.sin6_scope_id);
+			}
+
+			if (brackets)
+				*p++ = ']';
+
+			return p;
+		}
+
+	default:
+		return nullptr;
+	}
+}
+
+static bool
+CopyFormatted(char *buffer, size_t buffer_size,
+	      const char *src, const char *end) noexcept
+{
+	if (end == nullptr)
+		return false;
+
+	const size_t length = end - src;
+	if (length >= buffer_size)
+		/* no more room */
+		return false;
+
+	memcpy(buffer, src, length);
+	buffer[length] = 0;
+	return true;
 }
 
 static bool
@@ -99,40 +260,14 @@ ToString(char *buffer, size_t buffer_size,
 				     (const struct sockaddr_un *)address.GetAddress(),
 				     address.GetSize());
 
-	address = ipv64_normalize_mapped(address);
-
-	char serv[16];
-	int ret = getnameinfo(address.GetAddress(), address.GetSize(),
-			      buffer, buffer_size,
-			      serv, sizeof(serv),
-			      NI_NUMERICHOST | NI_NUMERICSERV);
-	if (ret != 0)
-		return false;
-
-	if (serv[0] != 0) {
-		if (address.GetFamily() == AF_INET6) {
-			/* enclose IPv6 address in square brackets */
-
-			size_t length = strlen(buffer);
-			if (length + 4 >= buffer_size)
-				/* no more room */
-				return false;
-
-			memmove(buffer + 1, buffer, length);
-			buffer[0] = '[';
-			buffer[++length] = ']';
-			buffer[++length] = 0;
-		}
-
-		if (strlen(buffer) + 1 + strlen(serv) >= buffer_size)
-			/* no more room */
-			return false;
-
-		strcat(buffer, ":");
-		strcat(buffer, serv);
+	char tmp[MAX_FORMATTED];
+	char *end = FormatHost(tmp, address, true);
+	if (end != nullptr) {
+		*end++ = ':';
+		end = FormatDecimal(end, address.GetPort());
 	}
 
-	return true;
+	return CopyFormatted(buffer, buffer_size, tmp, end);
 }
 
 bool
@@ -147,10 +282,7 @@ HostToString(char *buffer, size_t buffer_size,
 				     (const struct sockaddr_un *)address.GetAddress(),
 				     address.GetSize());
 
-	address = ipv64_normalize_mapped(address);
-
-	return getnameinfo(address.GetAddress(), address.GetSize(),
-			   buffer, buffer_size,
-			   nullptr, 0,
-			   NI_NUMERICHOST | NI_NUMERICSERV) == 0;
+	char tmp[MAX_FORMATTED];
+	return CopyFormatted(buffer, buffer_size,
+			     tmp, FormatHost(tmp, address, false));
 }
@@ -31,26 +31,94 @@
  */
 
 #include "NetstringGenerator.hxx"
-#include "util/ConstBuffer.hxx"
-#include "util/StringView.hxx"
 
-#include <cstddef>
+#include <algorithm>
 
-template<typename L>
-static inline size_t
-GetTotalSize(const L &list)
+#include <assert.h>
+
+static char *
+FormatDecimal(char *p, size_t value)
+{
+	char buffer[20];
+	char *q = buffer + sizeof(buffer);
+
+	do {
+		*--q = '0' + value % 10;
+		value /= 10;
+	} while (value > 0);
+
+	size_t length = buffer + sizeof(buffer) - q;
+	std::copy_n(q, length, p);
+	return p + length;
+}
+
+ConstBuffer<char>
+NetstringGenerator::FormatHeader(size_t size, bool leading_comma)
+{
+	assert(arena_fill + MAX_HEADER <= sizeof(arena));
+
+	char *const start = arena + arena_fill;
+	char *p = start;
+	if (leading_comma)
+		*p++ = ',';
+	p = FormatDecimal(p, size);
+	*p++ = ':';
+
+	arena_fill += p - start;
+	return {start, size_t(p - start)};
+}
+
+void
+NetstringGenerator::FlushComma()
+{
+	if (pending_comma) {
+		Push(",", 1);
+		pending_comma = false;
+	}
+}
+
+void
+NetstringGenerator::Append(ConstBuffer<void> value)
 {
-	size_t result = 0;
-	for (const auto &i : list)
-		result += i.size;
-	return result;
+	assert(vectors.size() + 2 <= vectors.capacity());
+
+	FlushComma();
+
+	Push(value.data, value.size);
+	value_size += value.size;
 }
 
 void
-NetstringGenerator::operator()(std::list<ConstBuffer<void>> &list, bool comma)
+NetstringGenerator::AppendNetstring(ConstBuffer<void> value)
 {
-	list.emplace_front(header(GetTotalSize(list)).ToVoid());
+	assert(CanAppendNetstring());
+
+	/* the previous nested netstring's trailing comma is merged
+	   into this header, which saves one vector */
+	const auto header = FormatHeader(value.size, pending_comma);
+	Push(header.data, header.size);
+	Push(value.data, value.size);
+
+	/* the comma is accounted for right away even though it is
+	   written later */
+	value_size += header.size - pending_comma + value.size + 1;
+	pending_comma = true;
+}
+
+ConstBuffer<struct iovec>
+NetstringGenerator::Finish(bool comma)
+{
+	assert(vectors.size() < vectors.capacity());
+
+	const auto header = FormatHeader(value_size, false);
+	vectors.front() = {const_cast<char *>(header.data), header.size};
+
+	if (pending_comma && comma)
+		Push(",,", 2);
+	else if (pending_comma || comma)
+		Push(",", 1);
+
+	pending_comma = false;
 
-	if (comma)
-		list.emplace_back(",", 1);
+	return {vectors.raw(), vectors.size()};
 }
@@ -33,20 +33,109 @@
 #ifndef NETSTRING_GENERATOR_HXX
 #define NETSTRING_GENERATOR_HXX
 
-#include "NetstringHeader.hxx"
+#include "util/StaticArray.hxx"
+#include "util/ConstBuffer.hxx"
 
-#include <list>
-
-template<typename T> struct ConstBuffer;
+#include <sys/uio.h>
 
+/**
+ * Generates a netstring (http://cr.yp.to/proto/netstrings.txt)
+ * without allocating heap memory.  The headers are formatted into a
+ * fixed-size arena inside this object, and the result is a list of
+ * #iovec which can be passed to writev().  Values are referenced,
+ * not copied; they must remain valid until the result has been
+ * written.
+ *
+ * Since the result points into this object, it must not be moved
+ * while the result is in use.
+ */
 class NetstringGenerator {
-	NetstringHeader header;
+public:
+	/**
+	 * The maximum number of #iovec in the result.
+	 */
+	static constexpr size_t MAX_VECTORS = 128;
+
+private:
+	/**
+	 * Enough for "," plus 20 decimal digits plus ":".
+	 */
+	static constexpr size_t MAX_HEADER = 24;
+
+	/**
+	 * Each nested netstring needs one header and one value
+	 * vector; the trailing comma of a nested netstring is merged
+	 * into the following header.  Plus one for the outer header.
+	 */
+	static constexpr size_t MAX_HEADERS = MAX_VECTORS / 2 + 1;
+
+	char arena[MAX_HEADERS * MAX_HEADER];
+	size_t arena_fill = 0;
+
+	/**
+	 * The first element is reserved for the outer header, which
+	 * is only known after the last value has been appended.
+	 */
+	StaticArray<struct iovec, MAX_VECTORS> vectors;
+
+	/**
+	 * The total size of the outer netstring's value.
+	 */
+	size_t value_size = 0;
+
+	/**
+	 * Does the last nested netstring still lack its trailing
+	 * comma?
+	 */
+	bool pending_comma = false;
 
 public:
+	NetstringGenerator() {
+		vectors.push_back({});
+	}
+
+	NetstringGenerator(const NetstringGenerator &) = delete;
+	NetstringGenerator &operator=(const NetstringGenerator &) = delete;
+
 	/**
+	 * Can another nested netstring be appended with
+	 * AppendNetstring()?
+	 */
+	bool CanAppendNetstring() const {
+		/* reserve one for Finish() */
+		return vectors.size() + 3 <= vectors.capacity();
+	}
+
+	/**
+	 * Append raw data to the outer netstring's value.
+	 */
+	void Append(ConstBuffer<void> value);
+
+	/**
+	 * Append a nested netstring (header, value and comma) to the
+	 * outer netstring's value.
+	 */
+	void AppendNetstring(ConstBuffer<void> value);
+
+	/**
+	 * Finish the outer netstring and return the complete list of
+	 * vectors.  After this, no more data may be appended.
+	 *
 	 * @param comma generate the trailing comma?
 	 */
-	void operator()(std::list<ConstBuffer<void>> &list, bool comma=true);
+	ConstBuffer<struct iovec> Finish(bool comma=true);
+
+private:
+	void Push(const void *data, size_t size) {
+		vectors.push_back({const_cast<void *>(data), size});
+	}
+
+	void FlushComma();
+
+	/**
+	 * Format a netstring header into the arena.
+	 */
+	ConstBuffer<char> FormatHeader(size_t size, bool leading_comma);
 };
 
 #endif
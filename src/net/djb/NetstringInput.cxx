@@ -35,70 +35,103 @@
 #include "util/RuntimeError.hxx"
 #include "util/CharUtil.hxx"
 
+#include <algorithm>
+
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
 
-static bool
-OnlyDigits(const char *p, size_t size)
-{
-	for (size_t i = 0; i != size; ++i)
-		if (!IsDigitASCII(p[i]))
-			return false;
-
-	return true;
-}
+/**
+ * The maximum length of a netstring header including the colon.
+ */
+static constexpr size_t MAX_HEADER = 32;
 
-inline NetstringInput::Result
-NetstringInput::ReceiveHeader(int fd)
+/**
+ * Wrapper for read() which maps the "harmless" errors.
+ *
+ * @return the number of bytes read, 0 if the peer has closed the
+ * connection or -1 if no data is available (yet)
+ */
+static ssize_t
+ReadSome(int fd, void *p, size_t size)
 {
-	ssize_t nbytes = read(fd, header_buffer + header_position,
-			      sizeof(header_buffer) - header_position);
+	ssize_t nbytes = read(fd, p, size);
 	if (nbytes < 0) {
 		switch (errno) {
 		case EAGAIN:
 		case EINTR:
-			return Result::MORE;
+			return -1;
 
 		case ECONNRESET:
-			return Result::CLOSED;
+			return 0;
 
 		default:
 			throw MakeErrno("read() failed");
 		}
 	}
 
-	if (nbytes == 0)
-		return Result::CLOSED;
+	return nbytes;
+}
+
+inline NetstringInput::Result
+NetstringInput::ParseHeader()
+{
+	assert(state == State::HEADER);
+
+	const auto r = staging.Read();
+	const auto *const begin = (const char *)r.data;
+	const size_t size = std::min(r.size, MAX_HEADER);
 
-	header_position += nbytes;
+	size_t length = 0;
+	const char *p = begin;
+	for (const char *end = begin + size; p != end; ++p) {
+		if (*p == ':')
+			break;
 
-	char *colon = (char *)memchr(header_buffer + 1, ':', header_position - 1);
-	if (colon == nullptr) {
-		if (header_position == sizeof(header_buffer) ||
-		    !OnlyDigits(header_buffer, header_position))
+		if (!IsDigitASCII(*p))
+			throw std::runtime_error("Malformed netstring");
+
+		length = length * 10 + (*p - '0');
+		if (length >= max_size)
+			throw FormatRuntimeError("Netstring is too large: %zu",
+						 length);
+	}
+
+	if (p == begin + size) {
+		/* no colon yet */
+		if (size == MAX_HEADER)
 			throw std::runtime_error("Malformed netstring");
 
 		return Result::MORE;
 	}
 
-	*colon = 0;
-	char *endptr;
-	size_t size = strtoul(header_buffer, &endptr, 10);
-	if (endptr != colon)
+	if (p == begin)
+		/* no digits */
 		throw std::runtime_error("Malformed netstring");
 
-	if (size >= max_size)
-		throw FormatRuntimeError("Netstring is too large: %zu", size);
+	staging.Consume(p + 1 - begin);
 
 	/* allocate only extra byte for the trailing comma */
-	value.ResizeDiscard(size + 1);
+	value.ResizeDiscard(length + 1);
 	state = State::VALUE;
 	value_position = 0;
 
-	size_t vbytes = header_position - (colon - header_buffer) - 1;
-	memcpy(&value.front(), colon + 1, vbytes);
-	return ValueData(vbytes);
+	return ParseValue();
+}
+
+inline NetstringInput::Result
+NetstringInput::ParseValue()
+{
+	assert(state == State::VALUE);
+
+	const auto r = staging.Read();
+	const size_t n = std::min(r.size, value.size() - value_position);
+	if (n == 0)
+		return Result::MORE;
+
+	memcpy(&value.front() + value_position, r.data, n);
+	staging.Consume(n);
+	return ValueData(n);
 }
 
 NetstringInput::Result
@@ -122,45 +155,58 @@ NetstringInput::ValueData(size_t nbytes)
 	return Result::MORE;
 }
 
-inline NetstringInput::Result
-NetstringInput::ReceiveValue(int fd)
+NetstringInput::Result
+NetstringInput::Parse()
 {
-	ssize_t nbytes = read(fd, &value.front() + value_position,
-			      value.size() - value_position);
-	if (nbytes < 0) {
-		switch (errno) {
-		case EAGAIN:
-		case EINTR:
-			return Result::MORE;
+	switch (state) {
+	case State::FINISHED:
+		assert(false);
+		gcc_unreachable();
 
-		case ECONNRESET:
-			return Result::CLOSED;
+	case State::HEADER:
+		return ParseHeader();
 
-		default:
-			throw MakeErrno("read() failed");
-		}
+	case State::VALUE:
+		return ParseValue();
 	}
 
-	if (nbytes == 0)
-		return Result::CLOSED;
-
-	return ValueData(nbytes);
+	gcc_unreachable();
 }
 
 NetstringInput::Result
 NetstringInput::Receive(int fd)
 {
-	switch (state) {
-	case State::FINISHED:
-		assert(false);
-		gcc_unreachable();
+	auto result = Parse();
+	if (result != Result::MORE)
+		return result;
+
+	assert(state == State::HEADER || staging.IsEmpty());
+
+	if (state == State::VALUE &&
+	    value.size() - value_position >= staging.GetCapacity()) {
+		/* a large value: bypass the staging buffer to avoid
+		   copying */
+		ssize_t nbytes = ReadSome(fd, &value.front() + value_position,
+					  value.size() - value_position);
+		if (nbytes < 0)
+			return Result::MORE;
 
-	case State::HEADER:
-		return ReceiveHeader(fd);
+		if (nbytes == 0)
+			return Result::CLOSED;
 
-	case State::VALUE:
-		return ReceiveValue(fd);
+		return ValueData(nbytes);
 	}
 
-	gcc_unreachable();
+	auto w = staging.Write();
+	assert(!w.empty());
+
+	ssize_t nbytes = ReadSome(fd, w.data, w.size);
+	if (nbytes < 0)
+		return Result::MORE;
+
+	if (nbytes == 0)
+		return Result::CLOSED;
+
+	staging.Append(nbytes);
+	return Parse();
 }
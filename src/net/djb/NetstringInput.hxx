@@ -34,6 +34,7 @@
 #define NETSTRING_INPUT_HXX
 
 #include "util/AllocatedArray.hxx"
+#include "util/StaticFifoBuffer.hxx"
 
 #include <cstddef>
 #include <cassert>
@@ -41,6 +42,13 @@
 
 /**
  * A netstring input buffer.
+ *
+ * Data is read into a staging buffer first, so one read() usually
+ * obtains the header together with a small value; values larger
+ * than the staging buffer are read directly into their final
+ * location.  Bytes following a netstring remain in the staging
+ * buffer, which allows parsing several pipelined netstrings from a
+ * single read() (see Reset() and Parse()).
  */
 class NetstringInput {
 	enum class State {
@@ -51,8 +59,7 @@ class NetstringInput {
 
 	State state = State::HEADER;
 
-	char header_buffer[32];
-	size_t header_position = 0;
+	StaticFifoBuffer<uint8_t, 1024> staging;
 
 	AllocatedArray<uint8_t> value;
 	size_t value_position;
@@ -70,10 +77,39 @@ public:
 	};
 
 	/**
+	 * Parse buffered data, and read more from the socket if
+	 * that was not enough to finish the netstring.
+	 *
 	 * Throws std::runtime_error on error.
 	 */
 	Result Receive(int fd);
 
+	/**
+	 * Like Receive(), but parse only data which has already been
+	 * read; no system call is made.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	Result Parse();
+
+	/**
+	 * Are there (unparsed) bytes in the staging buffer, e.g. the
+	 * beginning of the next pipelined netstring?
+	 */
+	bool HasBufferedData() const noexcept {
+		return !staging.IsEmpty();
+	}
+
+	/**
+	 * Prepare for receiving the next netstring after the current
+	 * one has been finished.  Buffered data is preserved.
+	 */
+	void Reset() noexcept {
+		assert(state == State::FINISHED);
+
+		state = State::HEADER;
+	}
+
 	AllocatedArray<uint8_t> &GetValue() {
 		assert(state == State::FINISHED);
 
@@ -81,9 +117,9 @@ public:
 	}
 
 private:
-	Result ReceiveHeader(int fd);
+	Result ParseHeader();
+	Result ParseValue();
 	Result ValueData(size_t nbytes);
-	Result ReceiveValue(int fd);
 };
 
 #endif
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Aggregator.hxx"
+#include "Datagram.hxx"
+#include "util/FNVHash.hxx"
+
+#include <string.h>
+
+using namespace Net::Log;
+
+static constexpr size_t
+RoundUpPowerOfTwo(size_t n) noexcept
+{
+	size_t result = 1;
+	while (result < n)
+		result <<= 1;
+	return result;
+}
+
+Aggregator::Aggregator(size_t capacity, Key _key)
+	:key(_key),
+	 /* keep the load factor at or below 3/4 */
+	 mask(RoundUpPowerOfTwo(capacity + capacity / 3 + 1) - 1),
+	 max_used(capacity),
+	 slots(new Slot[mask + 1])
+{
+}
+
+inline bool
+Aggregator::Slot::Match(StringView k) const noexcept
+{
+	return key_length == k.size && memcmp(key, k.data, k.size) == 0;
+}
+
+void
+Aggregator::Slot::Add(const Datagram &d) noexcept
+{
+	requests.Add(1);
+
+	unsigned status_class = 0;
+	if (d.valid_http_status) {
+		status_class = unsigned(d.http_status) / 100;
+		if (status_class >= status.size())
+			status_class = 0;
+	}
+
+	status[status_class].Add(1);
+
+	if (d.valid_traffic) {
+		traffic_received.Add(d.traffic_received);
+		traffic_sent.Add(d.traffic_sent);
+	}
+
+	if (d.valid_duration)
+		duration[Log2Histogram::BucketIndex(d.duration)].Add(1);
+}
+
+void
+Aggregator::Slot::Load(Counters &c) const noexcept
+{
+	c.requests = requests.Load();
+
+	for (size_t i = 0; i < status.size(); ++i)
+		c.status[i] = status[i].Load();
+
+	c.traffic_received = traffic_received.Load();
+	c.traffic_sent = traffic_sent.Load();
+
+	for (size_t i = 0; i < duration.size(); ++i)
+		c.duration[i] = duration[i].Load();
+}
+
+inline StringView
+Aggregator::GetKey(const Datagram &d) const noexcept
+{
+	const char *k = key == Key::SITE ? d.site : d.host;
+	return k != nullptr ? k : "";
+}
+
+Aggregator::Slot &
+Aggregator::FindOrInsert(StringView k) noexcept
+{
+	if (k.size > MAX_KEY_LENGTH)
+		return overflow;
+
+	for (size_t i = FNV1aHash64(k.data, k.size) & mask;;
+	     i = (i + 1) & mask) {
+		Slot &slot = slots[i];
+
+		if (!slot.used.load(std::memory_order_relaxed)) {
+			/* not found */
+
+			if (n_used >= max_used)
+				return overflow;
+
+			++n_used;
+			memcpy(slot.key, k.data, k.size);
+			slot.key_length = k.size;
+			slot.used.store(true, std::memory_order_release);
+			return slot;
+		}
+
+		if (slot.Match(k))
+			return slot;
+	}
+}
+
+void
+Aggregator::Add(const Datagram &d) noexcept
+{
+	Slot &slot = FindOrInsert(GetKey(d));
+	if (&slot == &overflow && !overflow.used.load(std::memory_order_relaxed)) {
+		overflow.key_length = 0;
+		overflow.used.store(true, std::memory_order_release);
+	}
+
+	slot.Add(d);
+}
+
+std::vector<Aggregator::Entry>
+Aggregator::Snapshot() const
+{
+	std::vector<Entry> result;
+
+	ForEach([&result](StringView k, const Counters &c){
+			result.push_back({std::string(k.data, k.size), c});
+		});
+
+	return result;
+}
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "util/Log2Histogram.hxx"
+#include "util/StringView.hxx"
+#include "util/Compiler.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace Net {
+namespace Log {
+
+struct Datagram;
+
+/**
+ * Keeps per-site (or per-host) traffic counters from a stream of
+ * #Datagram objects in a fixed-size open-addressing table.
+ *
+ * There may be only one thread calling Add(), but any number of
+ * threads may call Snapshot() or ForEach() at the same time without
+ * blocking ingestion.  All counters are cumulative; a consumer which
+ * wants rates subtracts two snapshots.
+ *
+ * Keys which do not fit into the table (because it is full or the
+ * key is too long) are accounted in one "overflow" entry with an
+ * empty key.
+ */
+class Aggregator {
+public:
+	enum class Key {
+		SITE,
+		HOST,
+	};
+
+	static constexpr size_t MAX_KEY_LENGTH = 63;
+
+	static constexpr unsigned N_DURATION_BUCKETS =
+		Log2Histogram::N_BUCKETS;
+
+	/**
+	 * A plain (non-atomic) copy of one entry's counters.
+	 */
+	struct Counters {
+		uint64_t requests = 0;
+
+		/**
+		 * Indexed by the first digit of the HTTP status; 0
+		 * counts records without a valid status.
+		 */
+		std::array<uint64_t, 6> status{};
+
+		uint64_t traffic_received = 0, traffic_sent = 0;
+
+		/**
+		 * Duration histogram with the #Log2Histogram bucket
+		 * layout.
+		 */
+		std::array<uint64_t, N_DURATION_BUCKETS> duration{};
+	};
+
+	struct Entry {
+		std::string key;
+		Counters counters;
+	};
+
+private:
+	/**
+	 * Written only by the ingesting thread; a load-add-store
+	 * sequence is enough, and readers see each value atomically.
+	 */
+	struct AtomicCounter {
+		std::atomic<uint64_t> value{0};
+
+		void Add(uint64_t delta) noexcept {
+			value.store(value.load(std::memory_order_relaxed) + delta,
+				    std::memory_order_relaxed);
+		}
+
+		uint64_t Load() const noexcept {
+			return value.load(std::memory_order_relaxed);
+		}
+	};
+
+	struct Slot {
+		/**
+		 * Set (with release semantics) after #key has been
+		 * written; never cleared.
+		 */
+		std::atomic<bool> used{false};
+
+		uint8_t key_length;
+		char key[MAX_KEY_LENGTH];
+
+		AtomicCounter requests;
+		std::array<AtomicCounter, 6> status;
+		AtomicCounter traffic_received, traffic_sent;
+		std::array<AtomicCounter, N_DURATION_BUCKETS> duration;
+
+		gcc_pure
+		bool Match(StringView k) const noexcept;
+
+		void Add(const Datagram &d) noexcept;
+
+		void Load(Counters &c) const noexcept;
+	};
+
+	const Key key;
+
+	/**
+	 * The number of slots minus one (a power of two minus one).
+	 */
+	const size_t mask;
+
+	/**
+	 * New keys are rejected when this number of slots is used,
+	 * to keep probe sequences short.
+	 */
+	const size_t max_used;
+
+	size_t n_used = 0;
+
+	const std::unique_ptr<Slot[]> slots;
+
+	Slot overflow;
+
+public:
+	/**
+	 * @param capacity the (approximate) maximum number of
+	 * distinct keys
+	 */
+	explicit Aggregator(size_t capacity, Key _key=Key::SITE);
+
+	Aggregator(const Aggregator &) = delete;
+	Aggregator &operator=(const Aggregator &) = delete;
+
+	/**
+	 * Account one record.  Must not be called concurrently with
+	 * itself.
+	 */
+	void Add(const Datagram &d) noexcept;
+
+	/**
+	 * Invoke the given function with (StringView key, const
+	 * Counters &) for each used entry; the overflow entry comes
+	 * last (if it is used) and has an empty key.  May be called
+	 * from any thread.
+	 */
+	template<typename F>
+	void ForEach(F &&f) const {
+		Counters c;
+
+		for (size_t i = 0; i <= mask; ++i) {
+			const Slot &slot = slots[i];
+			if (!slot.used.load(std::memory_order_acquire))
+				continue;
+
+			slot.Load(c);
+			f(StringView(slot.key, slot.key_length), c);
+		}
+
+		if (overflow.used.load(std::memory_order_acquire)) {
+			overflow.Load(c);
+			f(StringView(""), c);
+		}
+	}
+
+	/**
+	 * Copy all entries.  May be called from any thread.
+	 */
+	std::vector<Entry> Snapshot() const;
+
+private:
+	gcc_pure
+	StringView GetKey(const Datagram &d) const noexcept;
+
+	Slot &FindOrInsert(StringView k) noexcept;
+};
+
+}}
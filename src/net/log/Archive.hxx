@@ -0,0 +1,95 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+/*
+ * Definitions for the Net::Log archive file format.
+ *
+ * An archive is a file header followed by a sequence of blocks.
+ * Each block consists of a #ArchiveBlockHeader and the records;
+ * each record is a 32 bit length followed by a raw datagram
+ * payload (see Protocol.hxx).  There is no alignment padding.  All
+ * integers are little-endian.
+ *
+ * The block headers form the index: each one contains the size of
+ * its records, so the start of the next block is known without
+ * reading the records.  The file is append-only; a truncated block
+ * at the end (after a crash) is ignored by readers and removed by
+ * the next writer.
+ */
+
+#include <stdint.h>
+
+namespace Net {
+namespace Log {
+
+static constexpr uint32_t ARCHIVE_MAGIC = 0x4e4c4131; // "NLA1"
+static constexpr uint32_t ARCHIVE_BLOCK_MAGIC = 0x4e4c4142; // "NLAB"
+
+struct ArchiveFileHeader {
+	uint32_t magic;
+
+	/**
+	 * Reserved, must be zero.
+	 */
+	uint32_t flags;
+};
+
+struct ArchiveBlockHeader {
+	uint32_t magic;
+
+	uint32_t n_records;
+
+	/**
+	 * The total size of all records in this block following
+	 * this header.
+	 */
+	uint32_t size;
+
+	/**
+	 * Reserved, must be zero.
+	 */
+	uint32_t flags;
+
+	/**
+	 * The smallest and the largest timestamp of all records in
+	 * this block; if no record has a timestamp, the minimum is
+	 * larger than the maximum.
+	 */
+	uint64_t timestamp_min, timestamp_max;
+};
+
+static_assert(sizeof(ArchiveFileHeader) == 8, "Wrong size");
+static_assert(sizeof(ArchiveBlockHeader) == 32, "Wrong size");
+
+}}
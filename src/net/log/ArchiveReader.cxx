@@ -0,0 +1,128 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ArchiveReader.hxx"
+#include "Archive.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "system/Error.hxx"
+#include "util/ByteOrder.hxx"
+
+#include <stdexcept>
+#include <string>
+
+#include <string.h>
+#include <sys/mman.h>
+
+using namespace Net::Log;
+
+template<typename T>
+static T
+LoadRaw(const uint8_t *p) noexcept
+{
+	T value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+ArchiveReader::ArchiveReader(const char *path)
+{
+	UniqueFileDescriptor fd;
+	if (!fd.OpenReadOnly(path))
+		throw FormatErrno("Failed to open %s", path);
+
+	const off_t file_size = fd.GetSize();
+	if (file_size < 0)
+		throw FormatErrno("Failed to stat %s", path);
+
+	if (size_t(file_size) < sizeof(ArchiveFileHeader))
+		throw std::runtime_error(std::string("Not an archive: ") + path);
+
+	size = file_size;
+	void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd.Get(), 0);
+	if (p == MAP_FAILED)
+		throw FormatErrno("Failed to map %s", path);
+
+	data = (const uint8_t *)p;
+
+	const auto file_header = LoadRaw<ArchiveFileHeader>(data);
+	if (FromLE32(file_header.magic) != ARCHIVE_MAGIC) {
+		munmap(p, size);
+		throw std::runtime_error(std::string("Not an archive: ") + path);
+	}
+
+	/* the records are read front to back */
+	madvise(p, size, MADV_SEQUENTIAL);
+
+	/* collect the block headers; stop at the first truncated or
+	   corrupt block, which may be the result of a crash */
+	const uint8_t *position = data + sizeof(ArchiveFileHeader);
+	const uint8_t *const end = data + size;
+	while (size_t(end - position) >= sizeof(ArchiveBlockHeader)) {
+		const auto header = LoadRaw<ArchiveBlockHeader>(position);
+		if (FromLE32(header.magic) != ARCHIVE_BLOCK_MAGIC)
+			break;
+
+		const uint8_t *records = position + sizeof(header);
+		const size_t records_size = FromLE32(header.size);
+		if (size_t(end - records) < records_size)
+			break;
+
+		blocks.push_back({records, records_size,
+				  FromLE32(header.n_records),
+				  FromLE64(header.timestamp_min),
+				  FromLE64(header.timestamp_max)});
+
+		position = records + records_size;
+	}
+}
+
+ArchiveReader::~ArchiveReader() noexcept
+{
+	munmap(const_cast<uint8_t *>(data), size);
+}
+
+ConstBuffer<uint8_t>
+ArchiveReader::NextRecord(const uint8_t *&p, const uint8_t *end) noexcept
+{
+	if (size_t(end - p) < sizeof(uint32_t))
+		return nullptr;
+
+	const size_t length = FromLE32(LoadRaw<uint32_t>(p));
+	p += sizeof(uint32_t);
+
+	if (size_t(end - p) < length)
+		return nullptr;
+
+	ConstBuffer<uint8_t> payload(p, length);
+	p += length;
+	return payload;
+}
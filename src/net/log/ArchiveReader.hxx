@@ -0,0 +1,150 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Datagram.hxx"
+#include "Parser.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Net {
+namespace Log {
+
+/**
+ * Reads an archive file (see Archive.hxx) which is mapped into
+ * memory.  The #Datagram objects passed to the callbacks point
+ * into the mapping; they are valid as long as this object exists.
+ */
+class ArchiveReader {
+	const uint8_t *data;
+	size_t size;
+
+	struct Block {
+		/**
+		 * The first record.
+		 */
+		const uint8_t *records;
+
+		size_t size;
+
+		unsigned n_records;
+
+		uint64_t timestamp_min, timestamp_max;
+
+		bool Overlaps(uint64_t since, uint64_t until) const noexcept {
+			return timestamp_min <= until && timestamp_max >= since;
+		}
+	};
+
+	std::vector<Block> blocks;
+
+public:
+	/**
+	 * Throws std::system_error on I/O error and
+	 * std::runtime_error if the file is not an archive.
+	 */
+	explicit ArchiveReader(const char *path);
+	~ArchiveReader() noexcept;
+
+	ArchiveReader(const ArchiveReader &) = delete;
+	ArchiveReader &operator=(const ArchiveReader &) = delete;
+
+	size_t GetBlockCount() const noexcept {
+		return blocks.size();
+	}
+
+	/**
+	 * Invoke the callback for each record.  Malformed records
+	 * are skipped.
+	 */
+	template<typename F>
+	void ForEach(F &&f) const {
+		for (const auto &block : blocks)
+			ForEachInBlock(block, f);
+	}
+
+	/**
+	 * Invoke the callback for each record with a timestamp in
+	 * the given range (inclusive, microseconds since epoch, see
+	 * Datagram::timestamp).  Blocks outside of the range are
+	 * skipped without looking at their records.
+	 */
+	template<typename F>
+	void ForEachInRange(uint64_t since, uint64_t until, F &&f) const {
+		for (const auto &block : blocks)
+			if (block.Overlaps(since, until))
+				ForEachInBlock(block, [&](const Datagram &d){
+						if (d.valid_timestamp &&
+						    d.timestamp >= since &&
+						    d.timestamp <= until)
+							f(d);
+					});
+	}
+
+private:
+	template<typename F>
+	static void ForEachInBlock(const Block &block, F &&f) {
+		const uint8_t *p = block.records;
+		const uint8_t *const end = p + block.size;
+
+		for (unsigned i = 0; i < block.n_records; ++i) {
+			const auto payload = NextRecord(p, end);
+			if (payload.IsNull())
+				break;
+
+			Datagram d;
+			try {
+				d = ParseDatagram(payload.data,
+						  payload.data + payload.size);
+			} catch (const ProtocolError &) {
+				continue;
+			}
+
+			f(d);
+		}
+	}
+
+	/**
+	 * Returns the payload of the record at the given position
+	 * and advances the pointer, or returns nullptr if the record
+	 * is truncated.
+	 */
+	static ConstBuffer<uint8_t> NextRecord(const uint8_t *&p,
+					       const uint8_t *end) noexcept;
+};
+
+}}
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ArchiveWriter.hxx"
+#include "Archive.hxx"
+#include "Datagram.hxx"
+#include "system/Error.hxx"
+#include "util/ByteOrder.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace Net::Log;
+
+static constexpr size_t RECORD_HEADER = sizeof(uint32_t);
+
+static void
+PWriteFull(FileDescriptor fd, const void *data, size_t size, off_t offset)
+{
+	ssize_t nbytes = pwrite(fd.Get(), data, size, offset);
+	if (nbytes < 0)
+		throw MakeErrno("Failed to write archive");
+	if (size_t(nbytes) != size)
+		throw std::runtime_error("Short write to archive");
+}
+
+/**
+ * Determine the end of the last complete block.
+ */
+static off_t
+FindEnd(FileDescriptor fd, off_t file_size)
+{
+	off_t position = sizeof(ArchiveFileHeader);
+
+	while (file_size - position >= off_t(sizeof(ArchiveBlockHeader))) {
+		ArchiveBlockHeader header;
+		ssize_t nbytes = pread(fd.Get(), &header, sizeof(header),
+				       position);
+		if (nbytes < 0)
+			throw MakeErrno("Failed to read archive");
+
+		if (size_t(nbytes) != sizeof(header) ||
+		    FromLE32(header.magic) != ARCHIVE_BLOCK_MAGIC)
+			break;
+
+		const off_t end = position + sizeof(header)
+			+ FromLE32(header.size);
+		if (end > file_size)
+			break;
+
+		position = end;
+	}
+
+	return position;
+}
+
+ArchiveWriter::ArchiveWriter(const char *path)
+	:buffer(new uint8_t[BLOCK_SIZE])
+{
+	if (!fd.Open(path, O_RDWR|O_CREAT|O_CLOEXEC))
+		throw FormatErrno("Failed to open %s", path);
+
+	const off_t size = fd.GetSize();
+	if (size < 0)
+		throw FormatErrno("Failed to stat %s", path);
+
+	if (size == 0) {
+		ArchiveFileHeader header{ToLE32(ARCHIVE_MAGIC), 0};
+		PWriteFull(fd.ToFileDescriptor(), &header, sizeof(header), 0);
+	} else {
+		ArchiveFileHeader header;
+		if (pread(fd.Get(), &header, sizeof(header), 0) != sizeof(header) ||
+		    FromLE32(header.magic) != ARCHIVE_MAGIC)
+			throw std::runtime_error(std::string("Not an archive: ") + path);
+
+		const off_t end = FindEnd(fd.ToFileDescriptor(), size);
+		if (end < size && ftruncate(fd.Get(), end) < 0)
+			throw FormatErrno("Failed to truncate %s", path);
+	}
+
+	if (lseek(fd.Get(), 0, SEEK_END) < 0)
+		throw FormatErrno("Failed to seek %s", path);
+
+	ResetBlock();
+}
+
+ArchiveWriter::~ArchiveWriter() noexcept
+{
+	try {
+		Flush();
+	} catch (...) {
+	}
+}
+
+inline void
+ArchiveWriter::ResetBlock() noexcept
+{
+	fill = 0;
+	n_records = 0;
+	timestamp_min = UINT64_MAX;
+	timestamp_max = 0;
+}
+
+void
+ArchiveWriter::WriteBlock(ConstBuffer<void> a, ConstBuffer<void> b)
+{
+	ArchiveBlockHeader header;
+	header.magic = ToLE32(ARCHIVE_BLOCK_MAGIC);
+	header.n_records = ToLE32(n_records);
+	header.size = ToLE32(a.size + b.size);
+	header.flags = 0;
+	header.timestamp_min = ToLE64(timestamp_min);
+	header.timestamp_max = ToLE64(timestamp_max);
+
+	struct iovec v[] = {
+		{&header, sizeof(header)},
+		{const_cast<void *>(a.data), a.size},
+		{const_cast<void *>(b.data), b.size},
+	};
+
+	const size_t size = sizeof(header) + a.size + b.size;
+	ssize_t nbytes = writev(fd.Get(), v, 3);
+	if (nbytes < 0)
+		throw MakeErrno("Failed to write archive");
+	if (size_t(nbytes) != size)
+		throw std::runtime_error("Short write to archive");
+
+	ResetBlock();
+}
+
+void
+ArchiveWriter::Append(ConstBuffer<void> payload, const Datagram &d)
+{
+	const size_t size = RECORD_HEADER + payload.size;
+	if (fill + size > BLOCK_SIZE)
+		Flush();
+
+	if (d.valid_timestamp) {
+		if (d.timestamp < timestamp_min)
+			timestamp_min = d.timestamp;
+		if (d.timestamp > timestamp_max)
+			timestamp_max = d.timestamp;
+	}
+
+	const uint32_t length = ToLE32(payload.size);
+
+	if (size > BLOCK_SIZE) {
+		/* too large for the buffer: write a block containing
+		   only this record directly from the caller's
+		   buffer */
+		n_records = 1;
+		WriteBlock({&length, sizeof(length)}, payload);
+		return;
+	}
+
+	uint8_t *p = buffer.get() + fill;
+	memcpy(p, &length, sizeof(length));
+	memcpy(p + RECORD_HEADER, payload.data, payload.size);
+	fill += size;
+	++n_records;
+}
+
+void
+ArchiveWriter::Flush()
+{
+	if (n_records > 0)
+		WriteBlock({buffer.get(), fill}, nullptr);
+}
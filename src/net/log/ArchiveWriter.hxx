@@ -0,0 +1,116 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "io/UniqueFileDescriptor.hxx"
+
+#include <memory>
+
+#include <stdint.h>
+
+template<typename T> struct ConstBuffer;
+
+namespace Net {
+namespace Log {
+
+struct Datagram;
+
+/**
+ * Appends raw datagrams to an archive file (see Archive.hxx).
+ * Records are collected in memory and written one block at a time.
+ */
+class ArchiveWriter {
+	UniqueFileDescriptor fd;
+
+	const std::unique_ptr<uint8_t[]> buffer;
+
+	size_t fill = 0;
+
+	unsigned n_records = 0;
+
+	uint64_t timestamp_min, timestamp_max;
+
+public:
+	/**
+	 * The size above which a block is written.  Larger records
+	 * get a block of their own.
+	 */
+	static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+	/**
+	 * Open an archive file for appending; it is created if it
+	 * does not exist.  A truncated block at the end of the file
+	 * is removed.
+	 *
+	 * Throws std::system_error on I/O error and
+	 * std::runtime_error if the file is not an archive.
+	 */
+	explicit ArchiveWriter(const char *path);
+
+	/**
+	 * Writes pending records; errors are ignored, call Flush()
+	 * to check them.
+	 */
+	~ArchiveWriter() noexcept;
+
+	ArchiveWriter(const ArchiveWriter &) = delete;
+	ArchiveWriter &operator=(const ArchiveWriter &) = delete;
+
+	/**
+	 * Append a record.
+	 *
+	 * Throws std::system_error on error.
+	 *
+	 * @param payload the raw datagram
+	 * @param d the parsed datagram; only its timestamp is used
+	 */
+	void Append(ConstBuffer<void> payload, const Datagram &d);
+
+	/**
+	 * Write all pending records to the file.
+	 *
+	 * Throws std::system_error on error.
+	 */
+	void Flush();
+
+private:
+	void ResetBlock() noexcept;
+
+	/**
+	 * Write a block whose records are the concatenation of the
+	 * two buffers.
+	 */
+	void WriteBlock(ConstBuffer<void> a, ConstBuffer<void> b);
+};
+
+}}
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Filter.hxx"
+#include "Datagram.hxx"
+#include "util/FNVHash.hxx"
+
+#include <algorithm>
+
+#include <stdio.h>
+
+using namespace Net::Log;
+
+static constexpr uint64_t
+ToThreshold(double rate) noexcept
+{
+	return rate >= 1
+		? UINT64_MAX
+		: rate <= 0
+		? 0
+		: uint64_t(rate * 18446744073709551616.);
+}
+
+Filter::Filter(const Config &_config) noexcept
+	:config(_config),
+	 sample_threshold(ToThreshold(config.sample_rate)),
+	 sample_all(config.sample_rate >= 1)
+{
+}
+
+inline bool
+Filter::CheckSample(const Datagram &d) const noexcept
+{
+	if (sample_all)
+		return true;
+
+	const char *key = config.sample_key == SampleKey::REMOTE_HOST
+		? d.remote_host
+		: d.host;
+	if (key == nullptr)
+		return true;
+
+	/* the low bits of FNV-1a are poorly distributed for short
+	   similar strings such as IP addresses; mix in the high
+	   bits */
+	uint64_t hash = FNV1aHash64(key);
+	hash ^= hash >> 29;
+	hash *= 0xbf58476d1ce4e5b9ULL;
+	hash ^= hash >> 32;
+
+	return hash < sample_threshold;
+}
+
+TokenBucket &
+Filter::GetBucket(const char *site) noexcept
+{
+	if (site == nullptr)
+		site = "";
+
+	auto i = sites.lower_bound(site);
+	if (i != sites.end() && i->first == site)
+		return i->second;
+
+	if (sites.size() >= config.max_sites)
+		return overflow_bucket;
+
+	try {
+		return sites.emplace_hint(i, site, TokenBucket())->second;
+	} catch (...) {
+		/* out of memory: fall back to the shared bucket */
+		return overflow_bucket;
+	}
+}
+
+bool
+Filter::Check(const Datagram &d, double now) noexcept
+{
+	if (!CheckSample(d)) {
+		++stats.sampled;
+		++pending.sampled;
+		return false;
+	}
+
+	if (config.site_rate > 0 &&
+	    !GetBucket(d.site).Check(now, config.site_rate,
+				     config.site_burst)) {
+		++stats.rate_limited;
+		++pending.rate_limited;
+		return false;
+	}
+
+	++stats.accepted;
+	++pending.accepted;
+	return true;
+}
+
+StringView
+Filter::FormatSummary(char *buffer, size_t size) noexcept
+{
+	const Stats p = pending;
+	pending = {};
+
+	if (p.GetDropped() == 0)
+		return nullptr;
+
+	int length = snprintf(buffer, size,
+			      "log filter: dropped %llu of %llu records "
+			      "(%llu sampled, %llu rate-limited)",
+			      (unsigned long long)p.GetDropped(),
+			      (unsigned long long)(p.GetDropped() + p.accepted),
+			      (unsigned long long)p.sampled,
+			      (unsigned long long)p.rate_limited);
+	if (length < 0)
+		return nullptr;
+
+	return {buffer, std::min(size_t(length), size - 1)};
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "util/TokenBucket.hxx"
+#include "util/StringView.hxx"
+#include "util/Compiler.h"
+
+#include <map>
+#include <string>
+
+#include <stdint.h>
+
+namespace Net {
+namespace Log {
+
+struct Datagram;
+
+/**
+ * A filter stage which sheds load from a stream of #Datagram objects
+ * before it reaches a sink (or the wire).  It combines two
+ * mechanisms:
+ *
+ * - deterministic sampling: a hash of the client address (or of the
+ *   "Host" header) decides whether a record is kept, so all requests
+ *   of one client are either kept or dropped together
+ *
+ * - per-site rate limiting with a token bucket
+ *
+ * Records without a key (e.g. plain messages) are never sampled and
+ * records without a site share one bucket.
+ *
+ * Dropped records are counted, and FormatSummary() can be used to
+ * generate a message reporting them.
+ */
+class Filter {
+public:
+	enum class SampleKey {
+		REMOTE_HOST,
+		HOST,
+	};
+
+	struct Config {
+		/**
+		 * The fraction of keys which are kept (0..1).
+		 */
+		double sample_rate = 1;
+
+		SampleKey sample_key = SampleKey::REMOTE_HOST;
+
+		/**
+		 * The number of records per second allowed for each
+		 * site; 0 disables rate limiting.
+		 */
+		double site_rate = 0;
+
+		/**
+		 * The maximum number of records a site may send in one
+		 * burst.
+		 */
+		double site_burst = 0;
+
+		/**
+		 * The maximum number of sites tracked individually.
+		 * All others share one bucket.
+		 */
+		size_t max_sites = 4096;
+	};
+
+	struct Stats {
+		uint64_t accepted = 0;
+
+		/**
+		 * The number of records which were rejected by the
+		 * sampler.
+		 */
+		uint64_t sampled = 0;
+
+		/**
+		 * The number of records which were rejected by the
+		 * rate limiter.
+		 */
+		uint64_t rate_limited = 0;
+
+		constexpr uint64_t GetDropped() const noexcept {
+			return sampled + rate_limited;
+		}
+	};
+
+private:
+	const Config config;
+
+	/**
+	 * Keys whose hash is below this threshold are kept.
+	 */
+	const uint64_t sample_threshold;
+
+	const bool sample_all;
+
+	std::map<std::string, TokenBucket, std::less<>> sites;
+
+	/**
+	 * Shared by all sites beyond #Config::max_sites.
+	 */
+	TokenBucket overflow_bucket;
+
+	/**
+	 * Totals since this object was constructed.
+	 */
+	Stats stats;
+
+	/**
+	 * Counters since the last FormatSummary() call.
+	 */
+	Stats pending;
+
+public:
+	explicit Filter(const Config &_config) noexcept;
+
+	Filter(const Filter &) = delete;
+	Filter &operator=(const Filter &) = delete;
+
+	const Stats &GetStats() const noexcept {
+		return stats;
+	}
+
+	/**
+	 * Does the current summary period contain dropped
+	 * records?
+	 */
+	bool HasDropped() const noexcept {
+		return pending.GetDropped() > 0;
+	}
+
+	/**
+	 * Decide whether the given record shall be passed on.
+	 *
+	 * @param now the current time in seconds from a monotonic
+	 * clock
+	 */
+	bool Check(const Datagram &d, double now) noexcept;
+
+	/**
+	 * Format a message reporting the records dropped since the
+	 * last call and start a new period.  The caller may wrap it
+	 * in a #Datagram and log it.
+	 *
+	 * @return the message (pointing into the given buffer) or
+	 * nullptr if nothing was dropped
+	 */
+	StringView FormatSummary(char *buffer, size_t size) noexcept;
+
+private:
+	gcc_pure
+	bool CheckSample(const Datagram &d) const noexcept;
+
+	TokenBucket &GetBucket(const char *site) noexcept;
+};
+
+}}
@@ -33,136 +33,315 @@
 #include "OneLine.hxx"
 #include "Datagram.hxx"
 #include "io/FileDescriptor.hxx"
+#include "system/Error.hxx"
 
-#include <stdio.h>
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
 #include <time.h>
 
-static const char *
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * The buffer sizes for the escaped fields (see EscapeString());
+ * longer values are truncated.
+ */
+static constexpr size_t MAX_ESCAPED_URI = 4096;
+static constexpr size_t MAX_ESCAPED_REFERER = 2048;
+static constexpr size_t MAX_ESCAPED_USER_AGENT = 1024;
+static constexpr size_t MAX_ESCAPED_MESSAGE = 4096;
+
+/**
+ * The maximum length of string attributes which are copied without
+ * escaping (site, remote host); longer values are truncated.
+ */
+static constexpr size_t MAX_UNESCAPED = 1024;
+
+static constexpr size_t MAX_DECIMAL = 20;
+
+static constexpr size_t MAX_TIMESTAMP = sizeof("01/Jan/1970:00:00:00 +0000") - 1 + MAX_DECIMAL;
+
+static_assert(2 * MAX_UNESCAPED + MAX_TIMESTAMP + 64 /* method */
+	      + MAX_ESCAPED_URI + MAX_ESCAPED_REFERER
+	      + MAX_ESCAPED_USER_AGENT + 3 * MAX_DECIMAL
+	      + 64 /* punctuation */ <= ONE_LINE_MAX,
+	      "ONE_LINE_MAX too small");
+
+static_assert(MAX_UNESCAPED + MAX_TIMESTAMP + MAX_ESCAPED_MESSAGE
+	      + 64 /* punctuation */ <= ONE_LINE_MAX,
+	      "ONE_LINE_MAX too small");
+
+static StringView
 OptionalString(const char *p)
 {
 	if (p == nullptr)
 		return "-";
 
-	return p;
+	return {p, strnlen(p, MAX_UNESCAPED)};
 }
 
-static bool
+static constexpr bool
 IsHarmlessChar(signed char ch)
 {
 	return ch >= 0x20 && ch != '"' && ch != '\\';
 }
 
-static const char *
-EscapeString(const char *value, char *const buffer, size_t buffer_size)
+/**
+ * Returns the number of leading harmless characters (see
+ * IsHarmlessChar()) in the given range.
+ */
+gcc_pure
+static size_t
+CountHarmless(const char *s, size_t size) noexcept
 {
-	char *p = buffer, *const buffer_limit = buffer + buffer_size - 4;
-	char ch;
-	while (p < buffer_limit && (ch = *value++) != 0) {
-		if (IsHarmlessChar(ch))
-			*p++ = ch;
-		else
-			p += sprintf(p, "\\x%02X", (unsigned char)ch);
+	size_t i = 0;
+
+#ifdef __SSE2__
+	/* a signed comparison catches both control characters and
+	   bytes >= 0x80 */
+	const __m128i space = _mm_set1_epi8(0x20);
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+
+	for (; i + 16 <= size; i += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+		const __m128i bad =
+			_mm_or_si128(_mm_cmplt_epi8(v, space),
+				     _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+						  _mm_cmpeq_epi8(v, backslash)));
+		const unsigned mask = _mm_movemask_epi8(bad);
+		if (mask != 0)
+			return i + __builtin_ctz(mask);
 	}
+#endif
+
+	while (i < size && IsHarmlessChar(s[i]))
+		++i;
 
-	*p = 0;
-	return buffer;
+	return i;
 }
 
-static const char *
-EscapeString(StringView value, char *const buffer, size_t buffer_size)
+/**
+ * Copy the string, escaping all characters which are not
+ * harmless as "\xNN".  The output is truncated as soon as it
+ * reaches the last 4 bytes of the buffer, which means it is at most
+ * dest_size-1 bytes long.
+ *
+ * @return the end of the output
+ */
+static char *
+EscapeString(char *dest, size_t dest_size, StringView value) noexcept
 {
-	char *p = buffer, *const buffer_limit = buffer + buffer_size - 4;
+	static constexpr char hex_digits[] = "0123456789ABCDEF";
+
+	const char *const limit = dest + dest_size - 4;
+
+	while (!value.empty() && dest < limit) {
+		/* copy a run of harmless characters */
+		size_t n = CountHarmless(value.data, value.size);
+		n = std::min(n, size_t(limit - dest));
+		dest = std::copy_n(value.data, n, dest);
+		value.skip_front(n);
 
-	for (char ch : value) {
-		if (p >= buffer_limit)
+		if (value.empty() || dest >= limit)
 			break;
 
-		if (IsHarmlessChar(ch))
-			*p++ = ch;
-		else
-			p += sprintf(p, "\\x%02X", (unsigned char)ch);
+		const unsigned char ch = value.front();
+		value.pop_front();
+
+		*dest++ = '\\';
+		*dest++ = 'x';
+		*dest++ = hex_digits[ch >> 4];
+		*dest++ = hex_digits[ch & 0xf];
 	}
 
-	*p = 0;
-	return buffer;
+	return dest;
+}
+
+static char *
+Append(char *dest, StringView value) noexcept
+{
+	return std::copy_n(value.data, value.size, dest);
+}
+
+static char *
+AppendDecimal(char *dest, uint64_t value) noexcept
+{
+	char buffer[20];
+	char *p = buffer + sizeof(buffer);
+
+	do {
+		*--p = '0' + value % 10;
+		value /= 10;
+	} while (value > 0);
+
+	return std::copy(p, buffer + sizeof(buffer), dest);
 }
 
-static void
-LogOneLineHttp(FileDescriptor fd, const Net::Log::Datagram &d)
+static char *
+AppendTwoDigits(char *dest, unsigned value) noexcept
+{
+	*dest++ = '0' + value / 10;
+	*dest++ = '0' + value % 10;
+	return dest;
+}
+
+/**
+ * Append the timestamp in the format "%d/%b/%Y:%H:%M:%S %z"
+ * (always UTC) without strftime().
+ */
+static char *
+AppendTimestamp(char *dest, const Net::Log::Datagram &d) noexcept
+{
+	if (!d.valid_timestamp) {
+		*dest++ = '-';
+		return dest;
+	}
+
+	static constexpr char month_names[12][4] = {
+		"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+		"Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+	};
+
+	const time_t t = d.timestamp / 1000000;
+	struct tm tm;
+	gmtime_r(&t, &tm);
+
+	dest = AppendTwoDigits(dest, tm.tm_mday);
+	*dest++ = '/';
+	dest = std::copy_n(month_names[tm.tm_mon], 3, dest);
+	*dest++ = '/';
+	dest = AppendDecimal(dest, tm.tm_year + 1900);
+	*dest++ = ':';
+	dest = AppendTwoDigits(dest, tm.tm_hour);
+	*dest++ = ':';
+	dest = AppendTwoDigits(dest, tm.tm_min);
+	*dest++ = ':';
+	dest = AppendTwoDigits(dest, tm.tm_sec);
+	return Append(dest, " +0000");
+}
+
+static char *
+AppendOptionalDecimal(char *dest, bool valid, uint64_t value) noexcept
+{
+	if (!valid) {
+		*dest++ = '-';
+		return dest;
+	}
+
+	return AppendDecimal(dest, value);
+}
+
+static char *
+FormatOneLineHttp(char *p, const Net::Log::Datagram &d) noexcept
 {
 	const char *method = d.valid_http_method &&
 		http_method_is_valid(d.http_method)
 		? http_method_to_string(d.http_method)
 		: "?";
 
-	char stamp_buffer[32];
-	const char *stamp = "-";
-	if (d.valid_timestamp) {
-		time_t t = d.timestamp / 1000000;
-		strftime(stamp_buffer, sizeof(stamp_buffer),
-			 "%d/%b/%Y:%H:%M:%S %z", gmtime(&t));
-		stamp = stamp_buffer;
-	}
+	p = Append(p, OptionalString(d.site));
+	*p++ = ' ';
+	p = Append(p, OptionalString(d.remote_host));
+	p = Append(p, " - - [");
+	p = AppendTimestamp(p, d);
+	p = Append(p, "] \"");
+	p = Append(p, method);
+	*p++ = ' ';
+	p = EscapeString(p, MAX_ESCAPED_URI, d.http_uri);
+	p = Append(p, " HTTP/1.1\" ");
+	p = AppendDecimal(p, unsigned(d.http_status));
+	*p++ = ' ';
+	p = AppendOptionalDecimal(p, d.valid_length, d.length);
+	p = Append(p, " \"");
+	p = EscapeString(p, MAX_ESCAPED_REFERER,
+			 OptionalString(d.http_referer));
+	p = Append(p, "\" \"");
+	p = EscapeString(p, MAX_ESCAPED_USER_AGENT,
+			 OptionalString(d.user_agent));
+	p = Append(p, "\" ");
+	p = AppendOptionalDecimal(p, d.valid_duration, d.duration);
+	*p++ = '\n';
+	return p;
+}
 
-	char length_buffer[32];
-	const char *length = "-";
-	if (d.valid_length) {
-		snprintf(length_buffer, sizeof(length_buffer), "%llu",
-			 (unsigned long long)d.length);
-		length = length_buffer;
-	}
+static char *
+FormatOneLineMessage(char *p, const Net::Log::Datagram &d) noexcept
+{
+	p = Append(p, OptionalString(d.site));
+	p = Append(p, " [");
+	p = AppendTimestamp(p, d);
+	p = Append(p, "] ");
+	p = EscapeString(p, MAX_ESCAPED_MESSAGE, d.message);
+	*p++ = '\n';
+	return p;
+}
 
-	char duration_buffer[32];
-	const char *duration = "-";
-	if (d.valid_duration) {
-		snprintf(duration_buffer, sizeof(duration_buffer), "%llu",
-			 (unsigned long long)d.duration);
-		duration = duration_buffer;
-	}
+size_t
+FormatOneLine(char *buffer, size_t size,
+	      const Net::Log::Datagram &d) noexcept
+{
+	assert(size >= ONE_LINE_MAX);
+	(void)size;
 
-	char escaped_uri[4096], escaped_referer[2048], escaped_ua[1024];
-
-	dprintf(fd.Get(),
-		"%s %s - - [%s] \"%s %s HTTP/1.1\" %u %s \"%s\" \"%s\" %s\n",
-		OptionalString(d.site),
-		OptionalString(d.remote_host),
-		stamp, method,
-		EscapeString(d.http_uri, escaped_uri, sizeof(escaped_uri)),
-		d.http_status, length,
-		EscapeString(OptionalString(d.http_referer),
-			     escaped_referer, sizeof(escaped_referer)),
-		EscapeString(OptionalString(d.user_agent),
-			     escaped_ua, sizeof(escaped_ua)),
-		duration);
-}
-
-static void
-LogOneLineMessage(FileDescriptor fd, const Net::Log::Datagram &d)
-{
-	char stamp_buffer[32];
-	const char *stamp = "-";
-	if (d.valid_timestamp) {
-		time_t t = d.timestamp / 1000000;
-		strftime(stamp_buffer, sizeof(stamp_buffer),
-			 "%d/%b/%Y:%H:%M:%S %z", gmtime(&t));
-		stamp = stamp_buffer;
+	char *end;
+	if (d.http_uri != nullptr && d.valid_http_status)
+		end = FormatOneLineHttp(buffer, d);
+	else if (d.message != nullptr)
+		end = FormatOneLineMessage(buffer, d);
+	else
+		return 0;
+
+	return end - buffer;
+}
+
+void
+LogOneLine(FileDescriptor fd, const Net::Log::Datagram &d)
+{
+	char buffer[ONE_LINE_MAX];
+	size_t length = FormatOneLine(buffer, sizeof(buffer), d);
+	if (length > 0)
+		fd.Write(buffer, length);
+}
+
+OneLineWriter::OneLineWriter(FileDescriptor _fd, size_t _capacity)
+	:fd(_fd), buffer(new char[_capacity]), capacity(_capacity)
+{
+	assert(capacity >= ONE_LINE_MAX);
+}
+
+OneLineWriter::~OneLineWriter() noexcept
+{
+	try {
+		Flush();
+	} catch (...) {
 	}
+}
 
-	char escaped_message[4096];
+void
+OneLineWriter::Write(const Net::Log::Datagram &d)
+{
+	if (capacity - fill < ONE_LINE_MAX)
+		Flush();
 
-	dprintf(fd.Get(),
-		"%s [%s] %s\n",
-		OptionalString(d.site),
-		stamp,
-		EscapeString(d.message, escaped_message,
-			     sizeof(escaped_message)));
+	fill += FormatOneLine(buffer.get() + fill, capacity - fill, d);
 }
 
 void
-LogOneLine(FileDescriptor fd, const Net::Log::Datagram &d)
+OneLineWriter::Flush()
 {
-	if (d.http_uri != nullptr && d.valid_http_status)
-		LogOneLineHttp(fd, d);
-	else if (d.message != nullptr)
-		LogOneLineMessage(fd, d);
+	const char *p = buffer.get();
+	while (fill > 0) {
+		ssize_t nbytes = fd.Write(p, fill);
+		if (nbytes < 0) {
+			fill = 0;
+			throw MakeErrno("Failed to write log");
+		}
+
+		p += nbytes;
+		fill -= nbytes;
+	}
 }
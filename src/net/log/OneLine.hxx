@@ -32,8 +32,32 @@
 
 #pragma once
 
+#include "io/FileDescriptor.hxx"
+
+#include <memory>
+
+#include <stddef.h>
+
 namespace Net { namespace Log { struct Datagram; }}
-class FileDescriptor;
+
+/**
+ * The maximum length of a line generated by FormatOneLine(),
+ * including the newline character.
+ */
+static constexpr size_t ONE_LINE_MAX = 16384;
+
+/**
+ * Format the #Net::Log::Datagram in one line (including the
+ * newline character), similar to Apache's "combined" log format.
+ *
+ * @param size the size of the buffer; must be at least
+ * #ONE_LINE_MAX
+ * @return the length of the line, or 0 if the datagram is neither
+ * an HTTP request nor a message
+ */
+size_t
+FormatOneLine(char *buffer, size_t size,
+	      const Net::Log::Datagram &d) noexcept;
 
 /**
  * Print the #Net::Log::Datagram in one line, similar to Apache's
@@ -41,3 +65,48 @@ class FileDescriptor;
  */
 void
 LogOneLine(FileDescriptor fd, const Net::Log::Datagram &d);
+
+/**
+ * Collects lines generated by FormatOneLine() in a large buffer
+ * and writes them in blocks.
+ */
+class OneLineWriter {
+	FileDescriptor fd;
+
+	const std::unique_ptr<char[]> buffer;
+	const size_t capacity;
+	size_t fill = 0;
+
+public:
+	/**
+	 * @param _capacity the buffer size; must be at least
+	 * #ONE_LINE_MAX
+	 */
+	explicit OneLineWriter(FileDescriptor _fd,
+			       size_t _capacity=256 * 1024);
+
+	/**
+	 * Writes pending lines; errors are ignored, call Flush() to
+	 * check them.
+	 */
+	~OneLineWriter() noexcept;
+
+	OneLineWriter(const OneLineWriter &) = delete;
+	OneLineWriter &operator=(const OneLineWriter &) = delete;
+
+	/**
+	 * Format a line into the buffer; the buffer is flushed
+	 * first if it is too full.
+	 *
+	 * Throws std::system_error on error.
+	 */
+	void Write(const Net::Log::Datagram &d);
+
+	/**
+	 * Write all pending lines.  On error, the pending lines are
+	 * discarded.
+	 *
+	 * Throws std::system_error on error.
+	 */
+	void Flush();
+};
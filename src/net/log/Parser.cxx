@@ -34,121 +34,138 @@
 #include "Datagram.hxx"
 #include "Protocol.hxx"
 #include "util/ByteOrder.hxx"
+#include "util/CRC32C.hxx"
 
 #include <string.h>
 
 using namespace Net::Log;
 
-static const void *
-read_uint8(uint8_t *value_r, const void *p, const uint8_t *end)
-{
-	auto src = (const uint8_t *)p;
-	if (src + sizeof(*value_r) > end)
-		return nullptr;
+namespace {
 
-	*value_r = *src++;
-	return src;
-}
+/**
+ * A cursor over the attribute list of a datagram.  All reads are
+ * bounds-checked and throw #ProtocolError on overflow.  Strings are
+ * not copied; they point into the datagram.
+ */
+class AttributeReader {
+	const uint8_t *p;
+	const uint8_t *const end;
 
-static const void *
-read_uint16(uint16_t *value_r, const void *p, const uint8_t *end)
-{
-	if ((const uint8_t *)p + sizeof(*value_r) > end)
-		return nullptr;
+public:
+	AttributeReader(const uint8_t *_p, const uint8_t *_end) noexcept
+		:p(_p), end(_end) {}
 
-	auto src = (const uint16_t *)p;
-	uint16_t value;
-	memcpy(&value, src, sizeof(value));
+	bool empty() const noexcept {
+		return p >= end;
+	}
 
-	*value_r = FromBE16(value);
-	return src + 1;
-}
+	const uint8_t *GetPosition() const noexcept {
+		return p;
+	}
 
-static const void *
-read_uint64(uint64_t *value_r, const void *p, const uint8_t *end)
-{
-	if ((const uint8_t *)p + sizeof(*value_r) > end)
-		return nullptr;
+	size_t GetRemaining() const noexcept {
+		return end - p;
+	}
 
-	auto src = (const uint64_t *)p;
-	uint64_t value;
-	memcpy(&value, src, sizeof(value));
+	Attribute ReadAttribute() noexcept {
+		return Attribute(*p++);
+	}
 
-	*value_r = FromBE64(value);
-	return src + 1;
-}
+	/**
+	 * Read a fixed-width value; the datagram has no alignment
+	 * guarantees, so this uses memcpy(), which compiles to a
+	 * single unaligned load.
+	 */
+	template<typename T>
+	T ReadRaw() {
+		if (size_t(end - p) < sizeof(T))
+			throw ProtocolError();
 
-static const void *
-read_string(const char **value_r, const void *p, const uint8_t *end)
-{
-	auto q = (const char *)p;
+		T value;
+		memcpy(&value, p, sizeof(value));
+		p += sizeof(value);
+		return value;
+	}
 
-	*value_r = q;
+	uint8_t ReadU8() {
+		return ReadRaw<uint8_t>();
+	}
 
-	q += strlen(q) + 1;
-	return q > (const char *)end ? nullptr : q;
-}
+	uint16_t ReadU16() {
+		return FromBE16(ReadRaw<uint16_t>());
+	}
+
+	uint32_t ReadU32() {
+		return FromBE32(ReadRaw<uint32_t>());
+	}
+
+	uint64_t ReadU64() {
+		return FromBE64(ReadRaw<uint64_t>());
+	}
+
+	/**
+	 * Read a null-terminated string.  The memchr() is bounded by
+	 * the end of the datagram and resumes right after the
+	 * previous string, so each byte is scanned only once.
+	 */
+	StringView ReadString() {
+		const auto *nul = (const uint8_t *)memchr(p, 0, end - p);
+		if (nul == nullptr)
+			throw ProtocolError();
+
+		StringView value((const char *)p, nul - p);
+		p = nul + 1;
+		return value;
+	}
+
+	const char *ReadCString() {
+		return ReadString().data;
+	}
+};
 
-static const void *
-ReadStringView(StringView &value_r, const void *p, const uint8_t *end)
-{
-	const char *value;
-	p = read_string(&value, p, end);
-	value_r = value;
-	return p;
 }
 
 static Datagram
-log_server_apply_attributes(const void *p, const uint8_t *end)
+ParseAttributes(AttributeReader r)
 {
-	assert(p != nullptr);
-	assert(end != nullptr);
-	assert((const char *)p < (const char *)end);
+	if (!r.empty() && Attribute(*r.GetPosition()) == Attribute::CRC32C) {
+		r.ReadAttribute();
+		const uint32_t expected = r.ReadU32();
+		const uint8_t *const start = r.GetPosition();
+		if (CRC32C(start, r.GetRemaining()) != expected)
+			throw ProtocolError();
+	}
 
 	Datagram datagram;
 
-	while (true) {
-		auto attr_p = (const uint8_t *)p;
-		if (attr_p >= end)
-			return datagram;
-
-		auto attr = (Attribute)*attr_p++;
-		p = attr_p;
-
-		switch (attr) {
-			uint8_t u8;
-			uint16_t u16;
-
+	while (!r.empty()) {
+		switch (r.ReadAttribute()) {
 		case Attribute::NOP:
 			break;
 
 		case Attribute::TIMESTAMP:
-			p = read_uint64(&datagram.timestamp, p, end);
+			datagram.timestamp = r.ReadU64();
 			datagram.valid_timestamp = true;
 			break;
 
 		case Attribute::REMOTE_HOST:
-			p = read_string(&datagram.remote_host, p, end);
+			datagram.remote_host = r.ReadCString();
 			break;
 
 		case Attribute::FORWARDED_TO:
-			p = read_string(&datagram.forwarded_to, p, end);
+			datagram.forwarded_to = r.ReadCString();
 			break;
 
 		case Attribute::HOST:
-			p = read_string(&datagram.host, p, end);
+			datagram.host = r.ReadCString();
 			break;
 
 		case Attribute::SITE:
-			p = read_string(&datagram.site, p, end);
+			datagram.site = r.ReadCString();
 			break;
 
 		case Attribute::HTTP_METHOD:
-			p = read_uint8(&u8, p, end);
-			if (p == nullptr)
-				throw ProtocolError();
-
-			datagram.http_method = http_method_t(u8);
+			datagram.http_method = http_method_t(r.ReadU8());
 			if (!http_method_is_valid(datagram.http_method))
 				throw ProtocolError();
 
@@ -156,27 +173,23 @@ log_server_apply_attributes(const void *p, const uint8_t *end)
 			break;
 
 		case Attribute::HTTP_URI:
-			p = read_string(&datagram.http_uri, p, end);
+			datagram.http_uri = r.ReadCString();
 			break;
 
 		case Attribute::HTTP_REFERER:
-			p = read_string(&datagram.http_referer, p, end);
+			datagram.http_referer = r.ReadCString();
 			break;
 
 		case Attribute::USER_AGENT:
-			p = read_string(&datagram.user_agent, p, end);
+			datagram.user_agent = r.ReadCString();
 			break;
 
 		case Attribute::MESSAGE:
-			p = ReadStringView(datagram.message, p, end);
+			datagram.message = r.ReadString();
 			break;
 
 		case Attribute::HTTP_STATUS:
-			p = read_uint16(&u16, p, end);
-			if (p == nullptr)
-				throw ProtocolError();
-
-			datagram.http_status = http_status_t(u16);
+			datagram.http_status = http_status_t(r.ReadU16());
 			if (!http_status_is_valid(datagram.http_status))
 				throw ProtocolError();
 
@@ -184,34 +197,100 @@ log_server_apply_attributes(const void *p, const uint8_t *end)
 			break;
 
 		case Attribute::LENGTH:
-			p = read_uint64(&datagram.length, p, end);
+			datagram.length = r.ReadU64();
 			datagram.valid_length = true;
 			break;
 
 		case Attribute::TRAFFIC:
-			p = read_uint64(&datagram.traffic_received, p, end);
-			if (p != nullptr)
-				p = read_uint64(&datagram.traffic_sent, p, end);
+			datagram.traffic_received = r.ReadU64();
+			datagram.traffic_sent = r.ReadU64();
 			datagram.valid_traffic = true;
 			break;
 
 		case Attribute::DURATION:
-			p = read_uint64(&datagram.duration, p, end);
+			datagram.duration = r.ReadU64();
 			datagram.valid_duration = true;
 			break;
-		}
 
-		if (p == nullptr)
+		case Attribute::CRC32C:
+			/* only allowed at the beginning, see above */
 			throw ProtocolError();
+		}
 	}
+
+	return datagram;
 }
 
 Datagram
 Net::Log::ParseDatagram(const void *p, const void *end)
 {
-	auto magic = (const uint32_t *)p;
-	if (*magic != MAGIC)
+	AttributeReader r((const uint8_t *)p, (const uint8_t *)end);
+
+	if (r.ReadRaw<uint32_t>() != MAGIC)
 		throw ProtocolError();
 
-	return log_server_apply_attributes(magic + 1, (const uint8_t *)end);
+	return ParseAttributes(r);
+}
+
+Datagram
+Net::Log::ParseDatagramAttributes(const void *p, const void *end)
+{
+	return ParseAttributes(AttributeReader((const uint8_t *)p,
+					       (const uint8_t *)end));
+}
+
+DatagramIterator::DatagramIterator(const void *_p, const void *_end)
+	:p((const uint8_t *)_p), end((const uint8_t *)_end)
+{
+	AttributeReader r(p, end);
+	const auto magic = r.ReadRaw<uint32_t>();
+	if (magic == MAGIC)
+		multi = false;
+	else if (magic == MULTI_MAGIC)
+		multi = true;
+	else
+		throw ProtocolError();
+
+	p += sizeof(magic);
+}
+
+ConstBuffer<void>
+DatagramIterator::NextRaw()
+{
+	if (!multi) {
+		/* the remainder of a single-record packet is one
+		   attribute list (which may be empty) */
+		if (p == nullptr)
+			return nullptr;
+
+		ConstBuffer<void> result(p, end - p);
+		p = nullptr;
+		return result;
+	}
+
+	if (p == end)
+		return nullptr;
+
+	AttributeReader r(p, end);
+	const size_t size = FromBE16(r.ReadRaw<uint16_t>());
+	p += sizeof(uint16_t);
+
+	if (size_t(end - p) < size)
+		throw ProtocolError();
+
+	ConstBuffer<void> result(p, size);
+	p += size;
+	return result;
+}
+
+bool
+DatagramIterator::Next(Datagram &d)
+{
+	const auto raw = NextRaw();
+	if (raw.IsNull())
+		return false;
+
+	const auto *data = (const uint8_t *)raw.data;
+	d = ParseDatagramAttributes(data, data + raw.size);
+	return true;
 }
@@ -32,6 +32,10 @@
 
 #pragma once
 
+#include "util/ConstBuffer.hxx"
+
+#include <stdint.h>
+
 namespace Net {
 namespace Log {
 
@@ -45,4 +49,53 @@ class ProtocolError {};
 Datagram
 ParseDatagram(const void *p, const void *end);
 
+/**
+ * Parse an attribute list without a magic number, i.e. one record
+ * obtained from DatagramIterator::NextRaw().
+ *
+ * Throws #ProtocolError on error.
+ */
+Datagram
+ParseDatagramAttributes(const void *p, const void *end);
+
+/**
+ * Iterates over the records of one packet.  This accepts both the
+ * single-record format (#MAGIC) and the multi-record format
+ * (#MULTI_MAGIC).  All strings point into the packet.
+ */
+class DatagramIterator {
+	const uint8_t *p;
+	const uint8_t *const end;
+
+	bool multi;
+
+public:
+	/**
+	 * Throws #ProtocolError if the magic number is unknown.
+	 */
+	DatagramIterator(const void *_p, const void *_end);
+
+	bool IsMulti() const noexcept {
+		return multi;
+	}
+
+	/**
+	 * Returns the attribute list of the next record (to be
+	 * passed to ParseDatagramAttributes()) or nullptr after the
+	 * last one.
+	 *
+	 * Throws #ProtocolError on error.
+	 */
+	ConstBuffer<void> NextRaw();
+
+	/**
+	 * Parse the next record.
+	 *
+	 * Throws #ProtocolError on error.
+	 *
+	 * @return false after the last record
+	 */
+	bool Next(Datagram &d);
+};
+
 }}
@@ -46,6 +46,15 @@ namespace Log {
  */
 static constexpr uint32_t MAGIC = 0x63046102;
 
+/**
+ * This magic number precedes a UDP packet containing several
+ * records.  Each record consists of its size (16 bit big-endian,
+ * not including the size field itself) followed by its attribute
+ * list.  Receivers which do not know this magic number discard
+ * these packets, so senders must enable this format explicitly.
+ */
+static constexpr uint32_t MULTI_MAGIC = 0x63046103;
+
 enum class Attribute : uint8_t {
 	NOP = 0,
 
@@ -124,6 +133,14 @@ enum class Attribute : uint8_t {
 	 * forwarded to.
 	 */
 	FORWARDED_TO,
+
+	/**
+	 * The CRC32C checksum (32 bit integer) of all following
+	 * attributes of this record (not including the magic number
+	 * or the record size).  This optional attribute must be the
+	 * first one.
+	 */
+	CRC32C,
 };
 
 }}
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Serializer.hxx"
+#include "Datagram.hxx"
+#include "Protocol.hxx"
+#include "util/ByteOrder.hxx"
+#include "util/CRC32C.hxx"
+
+#include <string.h>
+
+using namespace Net::Log;
+
+namespace {
+
+/**
+ * Appends to a fixed-size buffer; once something did not fit, all
+ * further writes are ignored and IsOverflow() returns true.
+ */
+class SerializeBuffer {
+	uint8_t *p;
+	uint8_t *const end;
+
+public:
+	SerializeBuffer(void *buffer, size_t size) noexcept
+		:p((uint8_t *)buffer), end(p + size) {}
+
+	bool IsOverflow() const noexcept {
+		return p == nullptr;
+	}
+
+	uint8_t *GetPosition() const noexcept {
+		return p;
+	}
+
+	void Write(const void *src, size_t size) noexcept {
+		if (p == nullptr)
+			return;
+
+		if (size_t(end - p) < size) {
+			p = nullptr;
+			return;
+		}
+
+		memcpy(p, src, size);
+		p += size;
+	}
+
+	void WriteAttribute(Attribute a) noexcept {
+		const uint8_t value = uint8_t(a);
+		Write(&value, sizeof(value));
+	}
+
+	void WriteU8(Attribute a, uint8_t value) noexcept {
+		WriteAttribute(a);
+		Write(&value, sizeof(value));
+	}
+
+	void WriteU16(Attribute a, uint16_t value) noexcept {
+		WriteAttribute(a);
+		value = ToBE16(value);
+		Write(&value, sizeof(value));
+	}
+
+	void WriteU32(Attribute a, uint32_t value) noexcept {
+		WriteAttribute(a);
+		value = ToBE32(value);
+		Write(&value, sizeof(value));
+	}
+
+	void WriteU64(Attribute a, uint64_t value) noexcept {
+		WriteAttribute(a);
+		value = ToBE64(value);
+		Write(&value, sizeof(value));
+	}
+
+	void WriteString(Attribute a, const char *value, size_t length) noexcept {
+		WriteAttribute(a);
+		Write(value, length);
+
+		static constexpr char nul = 0;
+		Write(&nul, sizeof(nul));
+	}
+
+	void WriteOptionalString(Attribute a, const char *value) noexcept {
+		if (value != nullptr)
+			WriteString(a, value, strlen(value));
+	}
+};
+
+}
+
+static void
+SerializeAttributes(SerializeBuffer &b, const Datagram &d, bool crc) noexcept
+{
+	/* reserve space for the checksum; it is filled in after all
+	   other attributes have been written */
+	uint8_t *const crc_position = b.GetPosition();
+	if (crc)
+		b.WriteU32(Attribute::CRC32C, 0);
+
+	const uint8_t *const start = b.GetPosition();
+
+	if (d.valid_timestamp)
+		b.WriteU64(Attribute::TIMESTAMP, d.timestamp);
+
+	b.WriteOptionalString(Attribute::REMOTE_HOST, d.remote_host);
+	b.WriteOptionalString(Attribute::FORWARDED_TO, d.forwarded_to);
+	b.WriteOptionalString(Attribute::HOST, d.host);
+	b.WriteOptionalString(Attribute::SITE, d.site);
+
+	if (d.valid_http_method)
+		b.WriteU8(Attribute::HTTP_METHOD, uint8_t(d.http_method));
+
+	b.WriteOptionalString(Attribute::HTTP_URI, d.http_uri);
+	b.WriteOptionalString(Attribute::HTTP_REFERER, d.http_referer);
+	b.WriteOptionalString(Attribute::USER_AGENT, d.user_agent);
+
+	if (!d.message.IsNull())
+		b.WriteString(Attribute::MESSAGE,
+			      d.message.data, d.message.size);
+
+	if (d.valid_http_status)
+		b.WriteU16(Attribute::HTTP_STATUS, uint16_t(d.http_status));
+
+	if (d.valid_length)
+		b.WriteU64(Attribute::LENGTH, d.length);
+
+	if (d.valid_traffic) {
+		b.WriteU64(Attribute::TRAFFIC, d.traffic_received);
+		const uint64_t sent = ToBE64(d.traffic_sent);
+		b.Write(&sent, sizeof(sent));
+	}
+
+	if (d.valid_duration)
+		b.WriteU64(Attribute::DURATION, d.duration);
+
+	if (crc && !b.IsOverflow()) {
+		const uint32_t value = ToBE32(CRC32C(start,
+						     b.GetPosition() - start));
+		memcpy(crc_position + 1, &value, sizeof(value));
+	}
+}
+
+static void
+WriteMagic(SerializeBuffer &b, uint32_t magic) noexcept
+{
+	/* the parser compares the magic in host byte order */
+	b.Write(&magic, sizeof(magic));
+}
+
+size_t
+Net::Log::Serialize(void *buffer, size_t size, const Datagram &d,
+		    bool crc) noexcept
+{
+	SerializeBuffer b(buffer, size);
+	WriteMagic(b, MAGIC);
+	SerializeAttributes(b, d, crc);
+
+	if (b.IsOverflow())
+		return 0;
+
+	return b.GetPosition() - (uint8_t *)buffer;
+}
+
+size_t
+Net::Log::SerializeMultiHeader(void *buffer, size_t size) noexcept
+{
+	SerializeBuffer b(buffer, size);
+	WriteMagic(b, MULTI_MAGIC);
+
+	if (b.IsOverflow())
+		return 0;
+
+	return b.GetPosition() - (uint8_t *)buffer;
+}
+
+size_t
+Net::Log::SerializeMultiRecord(void *buffer, size_t size,
+			       const Datagram &d, bool crc) noexcept
+{
+	/* reserve space for the size field; it is filled in after
+	   the attributes have been written */
+	uint16_t length = 0;
+
+	SerializeBuffer b(buffer, size);
+	b.Write(&length, sizeof(length));
+	SerializeAttributes(b, d, crc);
+
+	if (b.IsOverflow())
+		return 0;
+
+	const size_t total = b.GetPosition() - (uint8_t *)buffer;
+	if (total - sizeof(length) > 0xffff)
+		return 0;
+
+	length = ToBE16(total - sizeof(length));
+	memcpy(buffer, &length, sizeof(length));
+	return total;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+namespace Net {
+namespace Log {
+
+struct Datagram;
+
+/**
+ * Serialize a #Datagram into the wire format understood by
+ * ParseDatagram().
+ *
+ * @param crc append a #Attribute::CRC32C checksum?
+ * @return the number of bytes written to the buffer, or 0 if the
+ * buffer is too small
+ */
+size_t
+Serialize(void *buffer, size_t size, const Datagram &d,
+	  bool crc=false) noexcept;
+
+/**
+ * Begin a multi-record packet (see #MULTI_MAGIC).  Records are then
+ * appended with SerializeMultiRecord().
+ *
+ * @return the number of bytes written to the buffer, or 0 if the
+ * buffer is too small
+ */
+size_t
+SerializeMultiHeader(void *buffer, size_t size) noexcept;
+
+/**
+ * Serialize a #Datagram as one length-prefixed record of a
+ * multi-record packet.
+ *
+ * @param crc append a #Attribute::CRC32C checksum?
+ * @return the number of bytes written to the buffer, or 0 if the
+ * buffer is too small
+ */
+size_t
+SerializeMultiRecord(void *buffer, size_t size, const Datagram &d,
+		     bool crc=false) noexcept;
+
+}}
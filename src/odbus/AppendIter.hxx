@@ -82,14 +82,27 @@ public:
 		return *this;
 	};
 
-	AppendMessageIter &AppendFixedArray(ConstBuffer<uint32_t> value) {
-		return AppendFixedArray(DBUS_TYPE_UINT32,
+	/**
+	 * Append all elements of an array of a fixed-size type with
+	 * one library call.  This must be called on an array
+	 * container iterator.
+	 */
+	template<typename T>
+	AppendMessageIter &AppendFixedArray(ConstBuffer<T> value) {
+		static_assert(IsFixedType<T>::value, "Not a fixed-size type");
+
+		return AppendFixedArray(TypeTraits<T>::TYPE,
 					value.data, value.size);
 	}
 
-	AppendMessageIter &Append(ConstBuffer<uint32_t> value) {
+	/**
+	 * Append an array of a fixed-size type (including the array
+	 * container).
+	 */
+	template<typename T>
+	AppendMessageIter &Append(ConstBuffer<T> value) {
 		return AppendMessageIter(*this, DBUS_TYPE_ARRAY,
-					 DBUS_TYPE_UINT32_AS_STRING)
+					 TypeTraits<T>::TypeAsString::value)
 			.AppendFixedArray(value)
 			.CloseContainer(*this);
 	}
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AsyncCall.hxx"
+
+#include <stdexcept>
+
+#include <assert.h>
+
+namespace ODBus {
+
+void
+AsyncCall::Send(DBusConnection *connection, DBusMessage *message,
+		int timeout_ms)
+{
+	assert(!IsPending());
+
+	auto new_pending = PendingCall::SendWithReply(connection, message,
+						      timeout_ms);
+	if (!dbus_pending_call_set_notify(new_pending.Get(), NotifyFunction,
+					  this, nullptr)) {
+		dbus_pending_call_cancel(new_pending.Get());
+		throw std::runtime_error("dbus_pending_call_set_notify() failed");
+	}
+
+	pending = std::move(new_pending);
+}
+
+void
+AsyncCall::Cancel() noexcept
+{
+	assert(IsPending());
+
+	dbus_pending_call_cancel(pending.Get());
+	pending = PendingCall();
+}
+
+inline void
+AsyncCall::OnNotify() noexcept
+{
+	assert(IsPending());
+
+	/* release the PendingCall before invoking the callback,
+	   which may destroy this object or send another call; this
+	   cannot throw, because the call has completed */
+	auto reply = Message::StealReply(*pending.Get());
+	pending = PendingCall();
+
+	callback(std::move(reply));
+}
+
+void
+AsyncCall::NotifyFunction(DBusPendingCall *, void *user_data) noexcept
+{
+	auto &call = *(AsyncCall *)user_data;
+	call.OnNotify();
+}
+
+} /* namespace ODBus */
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Message.hxx"
+#include "PendingCall.hxx"
+#include "util/BindMethod.hxx"
+#include "util/Cancellable.hxx"
+
+#include <dbus/dbus.h>
+
+namespace ODBus {
+
+/**
+ * An asynchronous D-Bus method call.  The connection must be
+ * integrated into the #EventLoop with a #WatchManager, which
+ * dispatches the reply and handles the call timeout; the callback
+ * is then invoked in the #EventLoop thread.  Any number of calls may
+ * be in flight on one connection.
+ *
+ * The callback receives the reply message, which may be an error
+ * (see Message::CheckThrowError()); a timeout or a disconnect is
+ * reported as an error reply generated by libdbus.  It may destroy
+ * this object.
+ */
+class AsyncCall final : public Cancellable {
+public:
+	typedef BoundMethod<void(Message &&reply)> Callback;
+
+private:
+	PendingCall pending;
+
+	const Callback callback;
+
+public:
+	explicit AsyncCall(Callback _callback) noexcept
+		:callback(_callback) {}
+
+	~AsyncCall() noexcept {
+		if (IsPending())
+			Cancel();
+	}
+
+	AsyncCall(const AsyncCall &) = delete;
+	AsyncCall &operator=(const AsyncCall &) = delete;
+
+	bool IsPending() noexcept {
+		return pending.Get() != nullptr;
+	}
+
+	/**
+	 * Send a method call.  This does not block; the message is
+	 * written by the #WatchManager if the socket is not writable
+	 * right now.
+	 *
+	 * Throws on error.
+	 *
+	 * @param timeout_ms the timeout in milliseconds; -1 means the
+	 * libdbus default (25 seconds)
+	 */
+	void Send(DBusConnection *connection, DBusMessage *message,
+		  int timeout_ms=-1);
+
+	/**
+	 * Discard the pending call; the callback will not be
+	 * invoked.
+	 */
+	void Cancel() noexcept override;
+
+private:
+	void OnNotify() noexcept;
+
+	static void NotifyFunction(DBusPendingCall *pending,
+				   void *user_data) noexcept;
+};
+
+} /* namespace ODBus */
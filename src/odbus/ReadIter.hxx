@@ -34,6 +34,8 @@
 #define ODBUS_READ_ITER_HXX
 
 #include "Iter.hxx"
+#include "Types.hxx"
+#include "util/ConstBuffer.hxx"
 
 namespace ODBus {
 
@@ -59,6 +61,14 @@ public:
 		return dbus_message_iter_get_signature(&iter);
 	}
 
+	/**
+	 * Returns the element type of the array at the current
+	 * position.
+	 */
+	int GetArrayElementType() {
+		return dbus_message_iter_get_element_type(&iter);
+	}
+
 	void GetBasic(void *value) {
 		dbus_message_iter_get_basic(&iter, value);
 	}
@@ -68,6 +78,33 @@ public:
 		GetBasic(&value);
 		return value;
 	}
+
+	/**
+	 * Obtain all elements of an array of a fixed-size type with
+	 * one library call.  The returned buffer points into the
+	 * message and remains valid as long as the message exists.
+	 *
+	 * @return the array elements; an empty buffer if the array
+	 * is empty or if the current argument is not an array of #T
+	 * (which can be distinguished with GetArgType() and
+	 * GetArrayElementType())
+	 */
+	template<typename T>
+	ConstBuffer<T> GetFixedArray() {
+		static_assert(IsFixedType<T>::value, "Not a fixed-size type");
+
+		if (GetArgType() != DBUS_TYPE_ARRAY ||
+		    GetArrayElementType() != TypeTraits<T>::TYPE)
+			return nullptr;
+
+		DBusMessageIter sub;
+		dbus_message_iter_recurse(&iter, &sub);
+
+		const T *data = nullptr;
+		int n_elements = 0;
+		dbus_message_iter_get_fixed_array(&sub, &data, &n_elements);
+		return {data, size_t(n_elements)};
+	}
 };
 
 } /* namespace ODBus */
@@ -37,6 +37,8 @@
 
 #include <dbus/dbus.h>
 
+#include <type_traits>
+
 namespace ODBus {
 
 template<int type>
@@ -55,10 +57,49 @@ struct TypeTraits<const char *> : BasicTypeTraits<DBUS_TYPE_STRING> {
 
 using StringTypeTraits = TypeTraits<const char *>;
 
+template<>
+struct TypeTraits<unsigned char> : BasicTypeTraits<DBUS_TYPE_BYTE> {
+};
+
+template<>
+struct TypeTraits<dbus_int16_t> : BasicTypeTraits<DBUS_TYPE_INT16> {
+};
+
+template<>
+struct TypeTraits<dbus_uint16_t> : BasicTypeTraits<DBUS_TYPE_UINT16> {
+};
+
+template<>
+struct TypeTraits<dbus_int32_t> : BasicTypeTraits<DBUS_TYPE_INT32> {
+};
+
 template<>
 struct TypeTraits<dbus_uint32_t> : BasicTypeTraits<DBUS_TYPE_UINT32> {
 };
 
+template<>
+struct TypeTraits<dbus_int64_t> : BasicTypeTraits<DBUS_TYPE_INT64> {
+};
+
+template<>
+struct TypeTraits<dbus_uint64_t> : BasicTypeTraits<DBUS_TYPE_UINT64> {
+};
+
+template<>
+struct TypeTraits<double> : BasicTypeTraits<DBUS_TYPE_DOUBLE> {
+};
+
+/**
+ * Is this a D-Bus type with a fixed size, i.e. one which can be
+ * marshalled with dbus_message_iter_append_fixed_array() and
+ * dbus_message_iter_get_fixed_array()?  (Booleans are not
+ * supported here, because #dbus_bool_t is the same C type as
+ * #dbus_uint32_t.)
+ */
+template<typename T>
+struct IsFixedType : std::is_arithmetic<T> {
+};
+
 using BooleanTypeTraits = BasicTypeTraits<DBUS_TYPE_BOOLEAN>;
 
 template<typename T>
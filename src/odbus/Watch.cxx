@@ -75,6 +75,39 @@ WatchManager::Watch::OnSocketReady(unsigned events)
 	parent.ScheduleDispatch();
 }
 
+WatchManager::Timeout::Timeout(EventLoop &event_loop,
+			       WatchManager &_parent, DBusTimeout &_timeout)
+	:parent(_parent), timeout(_timeout),
+	 event(event_loop, BIND_THIS_METHOD(OnTimer))
+{
+	Toggled();
+}
+
+void
+WatchManager::Timeout::Toggled()
+{
+	event.Cancel();
+
+	if (dbus_timeout_get_enabled(&timeout)) {
+		const int ms = dbus_timeout_get_interval(&timeout);
+		const struct timeval tv{ms / 1000, (ms % 1000) * 1000};
+		event.Add(tv);
+	}
+}
+
+void
+WatchManager::Timeout::OnTimer()
+{
+	/* libdbus timeouts are periodic until they are removed or
+	   disabled; re-arm before handling, because the handler may
+	   remove this object */
+	Toggled();
+
+	auto &p = parent;
+	dbus_timeout_handle(&timeout);
+	p.ScheduleDispatch();
+}
+
 void
 WatchManager::Shutdown()
 {
@@ -82,7 +115,15 @@ WatchManager::Shutdown()
 					    nullptr, nullptr,
 					    nullptr, nullptr,
 					    nullptr);
+	dbus_connection_set_timeout_functions(connection,
+					      nullptr, nullptr,
+					      nullptr, nullptr,
+					      nullptr);
+	dbus_connection_set_dispatch_status_function(connection,
+						     nullptr, nullptr,
+						     nullptr);
 	watches.clear();
+	timeouts.clear();
 	defer_dispatch.Cancel();
 }
 
@@ -116,4 +157,29 @@ WatchManager::Toggled(DBusWatch *watch)
 	i->second.Toggled();
 }
 
+bool
+WatchManager::AddTimeout(DBusTimeout *timeout)
+{
+	timeouts.emplace(std::piecewise_construct,
+			 std::forward_as_tuple(timeout),
+			 std::forward_as_tuple(GetEventLoop(), *this,
+					       *timeout));
+	return true;
+}
+
+void
+WatchManager::RemoveTimeout(DBusTimeout *timeout)
+{
+	timeouts.erase(timeout);
+}
+
+void
+WatchManager::TimeoutToggled(DBusTimeout *timeout)
+{
+	auto i = timeouts.find(timeout);
+	assert(i != timeouts.end());
+
+	i->second.Toggled();
+}
+
 } /* namespace ODBus */
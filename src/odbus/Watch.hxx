@@ -36,6 +36,7 @@
 #include "Connection.hxx"
 #include "event/SocketEvent.hxx"
 #include "event/DeferEvent.hxx"
+#include "event/TimerEvent.hxx"
 #include "util/Compiler.h"
 
 #include <dbus/dbus.h>
@@ -47,7 +48,9 @@ class EventLoop;
 namespace ODBus {
 
 /**
- * Integrate a DBusConnection into the #EventLoop.
+ * Integrate a DBusConnection into the #EventLoop: its sockets
+ * (#DBusWatch), its timers (#DBusTimeout, e.g. for method call
+ * timeouts) and dispatching of incoming messages.
  */
 class WatchManager {
 	Connection connection;
@@ -73,6 +76,27 @@ class WatchManager {
 
 	std::map<DBusWatch *, Watch> watches;
 
+	class Timeout {
+		WatchManager &parent;
+		DBusTimeout &timeout;
+		TimerEvent event;
+
+	public:
+		Timeout(EventLoop &event_loop, WatchManager &_parent,
+			DBusTimeout &_timeout);
+
+		~Timeout() {
+			event.Cancel();
+		}
+
+		void Toggled();
+
+	private:
+		void OnTimer();
+	};
+
+	std::map<DBusTimeout *, Timeout> timeouts;
+
 	DeferEvent defer_dispatch;
 
 public:
@@ -87,6 +111,16 @@ public:
 						    ToggledFunction,
 						    (void *)this,
 						    nullptr);
+		dbus_connection_set_timeout_functions(connection,
+						      AddTimeoutFunction,
+						      RemoveTimeoutFunction,
+						      TimeoutToggledFunction,
+						      (void *)this,
+						      nullptr);
+		dbus_connection_set_dispatch_status_function(connection,
+							     DispatchStatusFunction,
+							     (void *)this,
+							     nullptr);
 	}
 
 	~WatchManager() {
@@ -102,6 +136,10 @@ public:
 		return defer_dispatch.GetEventLoop();
 	}
 
+	Connection &GetConnection() {
+		return connection;
+	}
+
 	void ScheduleDispatch() {
 		defer_dispatch.Schedule();
 	}
@@ -127,6 +165,37 @@ private:
 		auto &wm = *(WatchManager *)data;
 		wm.Toggled(watch);
 	}
+
+	bool AddTimeout(DBusTimeout *timeout);
+	void RemoveTimeout(DBusTimeout *timeout);
+	void TimeoutToggled(DBusTimeout *timeout);
+
+	static dbus_bool_t AddTimeoutFunction(DBusTimeout *timeout,
+					      void *data) {
+		auto &wm = *(WatchManager *)data;
+		return wm.AddTimeout(timeout);
+	}
+
+	static void RemoveTimeoutFunction(DBusTimeout *timeout, void *data) {
+		auto &wm = *(WatchManager *)data;
+		wm.RemoveTimeout(timeout);
+	}
+
+	static void TimeoutToggledFunction(DBusTimeout *timeout,
+					   void *data) {
+		auto &wm = *(WatchManager *)data;
+		wm.TimeoutToggled(timeout);
+	}
+
+	static void DispatchStatusFunction(DBusConnection *,
+					   DBusDispatchStatus status,
+					   void *data) {
+		auto &wm = *(WatchManager *)data;
+		if (status == DBUS_DISPATCH_DATA_REMAINS)
+			/* can't dispatch from inside this callback;
+			   defer */
+			wm.ScheduleDispatch();
+	}
 };
 
 } /* namespace ODBus */
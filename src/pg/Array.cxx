@@ -31,84 +31,202 @@
  */
 
 #include "Array.hxx"
+#include "util/Arena.hxx"
 
+#include <algorithm>
 #include <stdexcept>
 
 #include <assert.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace Pg {
 
-std::list<std::string>
-DecodeArray(const char *p)
+/**
+ * Find the first occurrence of one of the two characters.
+ *
+ * @return the position or #end if neither was found
+ */
+gcc_pure
+static const char *
+FindEither(const char *p, const char *const end, char a, char b) noexcept
 {
-	std::list<std::string> dest;
+#ifdef __SSE2__
+	const __m128i va = _mm_set1_epi8(a);
+	const __m128i vb = _mm_set1_epi8(b);
+
+	for (; end - p >= 16; p += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)p);
+		const unsigned mask =
+			_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, va),
+						       _mm_cmpeq_epi8(v, vb)));
+		if (mask != 0)
+			return p + __builtin_ctz(mask);
+	}
+#endif
+
+	for (; p != end; ++p)
+		if (*p == a || *p == b)
+			return p;
+
+	return end;
+}
+
+/**
+ * Find the closing double quote of a quoted element, skipping
+ * backslash escapes.
+ *
+ * Throws std::invalid_argument on syntax error.
+ *
+ * @param p the beginning of the element (after the opening quote)
+ * @param length_r receives the length of the unescaped value
+ * @return the position of the closing quote
+ */
+static const char *
+FindClosingQuote(const char *p, const char *const end, size_t &length_r)
+{
+	size_t length = 0;
+
+	while (true) {
+		const char *q = FindEither(p, end, '"', '\\');
+		if (q == end)
+			throw std::invalid_argument("missing closing double quote");
+
+		length += q - p;
 
-	if (p == nullptr || *p == 0)
+		if (*q == '"') {
+			length_r = length;
+			return q;
+		}
+
+		/* skip the backslash and the escaped character */
+		if (++q == end)
+			throw std::invalid_argument("backslash at end of string");
+
+		++length;
+		p = q + 1;
+	}
+}
+
+/**
+ * Copy a quoted element which was verified by FindClosingQuote(),
+ * removing the backslashes.
+ */
+static char *
+UnescapeQuoted(char *dest, const char *p, const char *const end) noexcept
+{
+	while (true) {
+		const char *q = FindEither(p, end, '"', '\\');
+		assert(q != end);
+
+		dest = std::copy(p, q, dest);
+		if (*q == '"')
+			return dest;
+
+		*dest++ = q[1];
+		p = q + 2;
+	}
+}
+
+std::vector<StringView>
+DecodeArray(StringView src, Arena &arena)
+{
+	std::vector<StringView> dest;
+
+	if (src.empty())
 		return dest;
 
+	const char *p = src.begin();
+	const char *const end = src.end();
+
 	if (*p != '{')
 		throw std::invalid_argument("'{' expected");
 
-	if (p[1] == '}' && p[2] == 0)
-		return dest; /* special case: empty array */
+	++p;
 
-	do {
-		++p;
+	if (p != end && *p == '}') {
+		/* special case: empty array */
+		if (p + 1 != end)
+			throw std::invalid_argument("garbage after '}'");
 
-		if (*p == '\"') {
-			++p;
+		return dest;
+	}
 
-			std::string value;
+	while (true) {
+		if (p == end)
+			throw std::invalid_argument("missing '}'");
 
-			while (*p != '\"') {
-				if (*p == '\\') {
-					++p;
+		if (*p == '"') {
+			++p;
 
-					if (*p == 0)
-						throw std::invalid_argument("backslash at end of string");
+			size_t length;
+			const char *q = FindClosingQuote(p, end, length);
 
-					value.push_back(*p++);
-				} else if (*p == 0) {
-					throw std::invalid_argument("missing closing double quote");
-				} else {
-					value.push_back(*p++);
-				}
+			if (length == size_t(q - p)) {
+				/* no backslash: refer to the source */
+				dest.emplace_back(p, q);
+			} else {
+				char *value = (char *)arena.Allocate(length, 1);
+				UnescapeQuoted(value, p, end);
+				dest.emplace_back(value, length);
 			}
 
-			++p;
-
-			if (*p != '}' && *p != ',')
-				throw std::invalid_argument("'}' or ',' expected");
-
-			dest.push_back(std::move(value));
-		} else if (*p == 0) {
-			throw std::invalid_argument("missing '}'");
+			p = q + 1;
 		} else if (*p == '{') {
 			throw std::invalid_argument("unexpected '{'");
 		} else {
-			const char *end = strchr(p, ',');
-			if (end == nullptr) {
-				end = strchr(p, '}');
-				if (end == nullptr)
-					throw std::invalid_argument("missing '}'");
-			}
+			const char *q = FindEither(p, end, ',', '}');
+			if (q == end)
+				throw std::invalid_argument("missing '}'");
 
-			dest.push_back(std::string(p, end));
+			StringView value(p, q);
+			if (value.Equals("NULL"))
+				value = nullptr;
 
-			p = end;
+			dest.push_back(value);
+			p = q;
 		}
-	} while (*p == ',');
 
-	if (*p != '}')
-		throw std::invalid_argument("'}' expected");
+		if (p == end)
+			throw std::invalid_argument("missing '}'");
 
-	++p;
+		if (*p == '}')
+			break;
+
+		if (*p != ',')
+			throw std::invalid_argument("'}' or ',' expected");
 
-	if (*p != 0)
+		++p;
+	}
+
+	if (p + 1 != end)
 		throw std::invalid_argument("garbage after '}'");
 
 	return dest;
 }
 
+std::list<std::string>
+DecodeArray(const char *p)
+{
+	std::list<std::string> dest;
+
+	if (p == nullptr)
+		return dest;
+
+	Arena arena;
+	for (const auto i : DecodeArray(StringView(p), arena)) {
+		if (i.data == nullptr)
+			/* this function does not distinguish NULL
+			   elements */
+			dest.emplace_back("NULL");
+		else
+			dest.emplace_back(i.data, i.size);
+	}
+
+	return dest;
+}
+
 } /* namespace Pg */
@@ -37,8 +37,13 @@
 #ifndef PG_ARRAY_HXX
 #define PG_ARRAY_HXX
 
+#include "util/StringView.hxx"
+
 #include <list>
 #include <string>
+#include <vector>
+
+class Arena;
 
 namespace Pg {
 
@@ -48,6 +53,18 @@ namespace Pg {
 std::list<std::string>
 DecodeArray(const char *p);
 
+/**
+ * Decode a one-dimensional array in the text format.  Elements which
+ * need no unescaping point into the source buffer; the others are
+ * unescaped into the #Arena.  An unquoted NULL element is returned
+ * as a nullptr #StringView.  For arrays in the binary format, see
+ * #BinaryArray.
+ *
+ * Throws std::invalid_argument on syntax error.
+ */
+std::vector<StringView>
+DecodeArray(StringView src, Arena &arena);
+
 template<typename L>
 std::string
 EncodeArray(const L &src)
@@ -35,6 +35,12 @@
 
 namespace Pg {
 
+/**
+ * Flush "COPY FROM STDIN" data after this number of bytes has been
+ * queued.
+ */
+static constexpr size_t COPY_FLUSH_THRESHOLD = 64 * 1024;
+
 AsyncConnection::AsyncConnection(EventLoop &event_loop,
 				 const char *_conninfo, const char *_schema,
 				 AsyncConnectionHandler &_handler) noexcept
@@ -63,6 +69,28 @@ AsyncConnection::Error()
 		rh->OnResultError();
 	}
 
+	internal_step = InternalStep::NONE;
+	measurement.Cancel();
+
+	copy_state = CopyState::NONE;
+	copy_handler = nullptr;
+	copy_blocked = false;
+
+#ifdef LIBPQ_HAS_PIPELINING
+	pipeline_sync_pending = false;
+
+	auto _pipeline = std::move(pipeline);
+	pipeline.clear();
+	for (auto &i : _pipeline)
+		if (i.type == PipelineItem::Type::QUERY)
+			i.handler->OnResultError();
+#endif
+
+	auto _queue = std::move(queue);
+	queue.clear();
+	for (auto &q : _queue)
+		q.handler.OnResultError();
+
 	if (was_connected)
 		handler.OnDisconnect();
 
@@ -101,6 +129,19 @@ AsyncConnection::Poll(PostgresPollingStatusType status)
 			}
 		}
 
+#ifdef LIBPQ_HAS_PIPELINING
+		if (pipelining && !IsPipelineMode()) {
+			try {
+				EnterPipelineMode();
+			} catch (...) {
+				handler.OnError("Failed to enter pipeline mode",
+						GetFullMessage(std::current_exception()).c_str());
+				Error();
+				break;
+			}
+		}
+#endif
+
 		state = State::READY;
 		socket_event.Set(GetSocket(), SocketEvent::READ|SocketEvent::PERSIST);
 		socket_event.Add();
@@ -139,26 +180,536 @@ AsyncConnection::PollReconnect()
 	Poll(Connection::PollReconnect());
 }
 
+inline void
+AsyncConnection::HandleInternalResult(Result &&result) noexcept
+{
+	assert(!queue.empty());
+
+	/* errors from DEALLOCATE are ignored; at worst, the server
+	   keeps an unused statement */
+
+	if (internal_step == InternalStep::PREPARE &&
+	    !result.IsCommandSuccessful()) {
+		/* send the query without a prepared statement, which
+		   reports the error to its handler */
+		auto &q = queue.front();
+		GetStatementCache()->Remove(q.query.GetQuery());
+		q.unprepared = true;
+	}
+}
+
 inline void
 AsyncConnection::PollResult()
 {
 	while (!IsBusy()) {
+		if (copy_state == CopyState::IN)
+			/* waiting for the producer */
+			break;
+
+		if (copy_state == CopyState::OUT && !PollCopyOut())
+			break;
+
 		auto result = ReceiveResult();
+		if (copy_handler != nullptr && result.IsDefined()) {
+			const auto status = result.GetStatus();
+			if (status == PGRES_COPY_IN) {
+				BeginCopyIn();
+				break;
+			} else if (status == PGRES_COPY_OUT) {
+				copy_state = CopyState::OUT;
+				continue;
+			}
+		}
+
+		if (internal_step != InternalStep::NONE) {
+			if (result.IsDefined()) {
+				HandleInternalResult(std::move(result));
+				continue;
+			}
+
+			internal_step = InternalStep::NONE;
+			if (state == State::READY)
+				SendQueuedQuery();
+			break;
+		}
+
 		if (result_handler != nullptr) {
-			if (result.IsDefined())
+			if (result.IsDefined()) {
+				if (measurement.IsActive())
+					measurement.OnResult(result);
+
 				result_handler->OnResult(std::move(result));
-			else {
+			} else {
 				auto rh = result_handler;
 				result_handler = nullptr;
+				copy_handler = nullptr;
+
+				if (measurement.IsActive())
+					FinishMeasurement(measurement);
+
 				rh->OnResultEnd();
 			}
 		}
 
-		if (!result.IsDefined())
+		if (!result.IsDefined()) {
+			if (state == State::READY && result_handler == nullptr &&
+			    !queue.empty())
+				SendQueuedQuery();
 			break;
+		}
+	}
+}
+
+#ifdef LIBPQ_HAS_PIPELINING
+
+inline void
+AsyncConnection::FinishPipelineQuery()
+{
+	assert(!pipeline.empty());
+
+	auto item = std::move(pipeline.front());
+	pipeline.pop_front();
+	pipeline_sync_pending = item.sync;
+
+	if (item.type == PipelineItem::Type::QUERY) {
+		if (item.measurement.IsActive())
+			FinishMeasurement(item.measurement);
+
+		item.handler->OnResultEnd();
+	}
+}
+
+inline void
+AsyncConnection::HandlePipelineResult(Result &&result)
+{
+	assert(!pipeline.empty());
+
+	auto &item = pipeline.front();
+	switch (item.type) {
+	case PipelineItem::Type::QUERY:
+		if (!item.discard) {
+			if (item.measurement.IsActive())
+				item.measurement.OnResult(result);
+
+			item.handler->OnResult(std::move(result));
+		}
+		break;
+
+	case PipelineItem::Type::DEALLOCATE:
+		/* errors are ignored; at worst, the server keeps an
+		   unused statement */
+		break;
+
+	case PipelineItem::Type::PREPARE:
+		if (!result.IsCommandSuccessful()) {
+			GetStatementCache()->RemoveId(item.statement_id);
+
+			/* the query in the same sync segment gets
+			   PGRES_PIPELINE_ABORTED; deliver the PREPARE
+			   error instead */
+			assert(pipeline.size() > 1);
+			assert(pipeline[1].type == PipelineItem::Type::QUERY);
+			pipeline[1].discard = true;
+
+			if (pipeline[1].measurement.IsActive())
+				pipeline[1].measurement.OnResult(result);
+
+			item.handler->OnResult(std::move(result));
+		}
+
+		break;
+	}
+}
+
+inline void
+AsyncConnection::PollPipelineResults()
+{
+	/* each query in the pipeline produces its results, a nullptr
+	   and then a PGRES_PIPELINE_SYNC result */
+
+	while (state == State::READY && !IsBusy()) {
+		auto result = ReceiveResult();
+		if (!result.IsDefined()) {
+			if (pipeline_sync_pending || pipeline.empty())
+				/* no more data available */
+				break;
+
+			FinishPipelineQuery();
+			continue;
+		}
+
+		if (result.GetStatus() == PGRES_PIPELINE_SYNC) {
+			if (!pipeline_sync_pending && !pipeline.empty())
+				/* not preceded by a nullptr; just in case */
+				FinishPipelineQuery();
+
+			pipeline_sync_pending = false;
+			continue;
+		}
+
+		if (!pipeline.empty())
+			HandlePipelineResult(std::move(result));
 	}
 }
 
+void
+AsyncConnection::SendPipelineQuery(AsyncResultHandler &_handler,
+				   const char *query,
+				   size_t n_params, const char *const*values)
+{
+	auto *cache = GetStatementCache();
+	if (cache != nullptr && cache->Lookup(query) < 0) {
+		if (cache->IsFull()) {
+			/* in its own sync segment, so a failure does not
+			   abort the query */
+			const StatementCache::Name name(cache->EvictOldest());
+			std::string sql = "DEALLOCATE ";
+			sql += name;
+			_SendQuery(false, sql.c_str(), 0, nullptr,
+				   nullptr, nullptr);
+			pipeline.emplace_back(PipelineItem::Type::DEALLOCATE,
+					      nullptr, true);
+			PipelineSync();
+		}
+
+		const unsigned id = cache->Insert(query);
+
+		try {
+			SendPrepare(StatementCache::Name(id), query, n_params);
+		} catch (...) {
+			cache->RemoveId(id);
+			throw;
+		}
+
+		pipeline.emplace_back(PipelineItem::Type::PREPARE,
+				      &_handler, false, id);
+	}
+
+	try {
+		_SendQuery(false, query, n_params, values, nullptr, nullptr);
+		pipeline.emplace_back(PipelineItem::Type::QUERY,
+				      &_handler, true);
+		if (GetInstrumentation() != nullptr)
+			StartMeasurement(pipeline.back().measurement,
+					 _handler, query,
+					 std::chrono::steady_clock::now());
+		PipelineSync();
+	} catch (...) {
+		/* roll back the items which refer to this handler */
+		while (!pipeline.empty() &&
+		       pipeline.back().handler == &_handler)
+			pipeline.pop_back();
+		throw;
+	}
+}
+
+#endif
+
+inline void
+AsyncConnection::BeginCopyIn()
+{
+	assert(copy_handler != nullptr);
+	assert(copy_state == CopyState::NONE);
+
+	try {
+		/* without this, PQputCopyData() may block; our own
+		   flushing provides the back pressure */
+		SetNonBlocking(true);
+	} catch (...) {
+		handler.OnError("Failed to start COPY",
+				GetFullMessage(std::current_exception()).c_str());
+		Error();
+		return;
+	}
+
+	copy_state = CopyState::IN;
+	copy_unflushed = 0;
+	copy_handler->OnCopyReady();
+}
+
+inline bool
+AsyncConnection::PollCopyOut()
+{
+	assert(copy_handler != nullptr);
+	assert(copy_state == CopyState::OUT);
+
+	while (true) {
+		char *buffer;
+		const int n = GetCopyData(&buffer);
+		if (n == 0)
+			return false;
+
+		if (n < 0) {
+			/* complete (-1) or failed (-2); the result
+			   follows */
+			copy_state = CopyState::NONE;
+			return true;
+		}
+
+		copy_handler->OnCopyData({buffer, size_t(n)});
+		PQfreemem(buffer);
+
+		if (copy_state != CopyState::OUT)
+			/* the handler has closed the connection */
+			return false;
+	}
+}
+
+bool
+AsyncConnection::FlushCopy()
+{
+	copy_unflushed = 0;
+
+	if (Flush())
+		return true;
+
+	copy_blocked = true;
+	UpdateSocketEvent(true);
+	return false;
+}
+
+void
+AsyncConnection::FinishCopyIn()
+{
+	assert(copy_state == CopyState::END);
+
+	copy_state = CopyState::NONE;
+	SetNonBlocking(false);
+}
+
+void
+AsyncConnection::StartCopy(AsyncCopyHandler &_handler, const char *query)
+{
+	assert(IsIdle());
+	assert(query != nullptr);
+#ifdef LIBPQ_HAS_PIPELINING
+	assert(!IsPipelineMode());
+#endif
+
+	Connection::SendQuery(query);
+	result_handler = copy_handler = &_handler;
+}
+
+bool
+AsyncConnection::CopyData(ConstBuffer<void> data)
+{
+	assert(copy_state == CopyState::IN);
+
+	PutCopyData(data);
+	copy_unflushed += data.size;
+
+	if (copy_blocked)
+		return false;
+
+	if (copy_unflushed < COPY_FLUSH_THRESHOLD)
+		return true;
+
+	return FlushCopy();
+}
+
+void
+AsyncConnection::CopyEnd(const char *error)
+{
+	assert(copy_state == CopyState::IN);
+
+	PutCopyEnd(error);
+	copy_state = CopyState::END;
+
+	/* if blocked, OnCopyWritable() will finish */
+	if (!copy_blocked && FlushCopy())
+		FinishCopyIn();
+}
+
+inline void
+AsyncConnection::OnCopyWritable()
+{
+	assert(copy_blocked);
+	assert(copy_state == CopyState::IN || copy_state == CopyState::END);
+
+	try {
+		if (!Flush())
+			return;
+
+		copy_blocked = false;
+		UpdateSocketEvent(false);
+
+		if (copy_state == CopyState::END) {
+			FinishCopyIn();
+			return;
+		}
+	} catch (...) {
+		handler.OnError("Failed to send COPY data",
+				GetFullMessage(std::current_exception()).c_str());
+		Error();
+		return;
+	}
+
+	copy_handler->OnCopyReady();
+}
+
+void
+AsyncConnection::UpdateSocketEvent(bool write) noexcept
+{
+	unsigned events = SocketEvent::READ|SocketEvent::PERSIST;
+	if (write)
+		events |= SocketEvent::WRITE;
+
+	socket_event.Delete();
+	socket_event.Set(GetSocket(), events);
+	socket_event.Add();
+}
+
+void
+AsyncConnection::SendQueuedQuery()
+{
+	assert(state == State::READY);
+	assert(result_handler == nullptr);
+	assert(!queue.empty());
+
+	auto &q = queue.front();
+	auto *cache = GetStatementCache();
+
+	const auto values = q.query.GetValues();
+
+	try {
+		if (cache != nullptr && !q.unprepared &&
+		    cache->Lookup(q.query.GetQuery()) < 0 &&
+		    IsTransactionIdle()) {
+			/* prepare the statement first; the query is sent
+			   when the result arrives (see PollResult()) */
+
+			if (cache->IsFull()) {
+				const StatementCache::Name name(cache->EvictOldest());
+				std::string sql = "DEALLOCATE ";
+				sql += name;
+				Connection::SendQuery(sql.c_str());
+				internal_step = InternalStep::DEALLOCATE;
+			} else {
+				const unsigned id = cache->Insert(q.query.GetQuery());
+				SendPrepare(StatementCache::Name(id),
+					    q.query.GetQuery(),
+					    q.query.GetParamCount());
+				internal_step = InternalStep::PREPARE;
+			}
+
+			return;
+		}
+
+		_SendQuery(false, q.query.GetQuery(),
+			   values.size(), values.data(),
+			   nullptr, nullptr);
+		ApplyChunkSize(q.chunk_size);
+	} catch (...) {
+		handler.OnError("Failed to send query",
+				GetFullMessage(std::current_exception()).c_str());
+		Error();
+		return;
+	}
+
+	if (GetInstrumentation() != nullptr)
+		StartMeasurement(measurement, q.handler, q.query.GetQuery(),
+				 q.enqueued);
+
+	result_handler = &q.handler;
+	queue.pop_front();
+}
+
+void
+AsyncConnection::StartMeasurement(QueryMeasurement &m,
+				  const AsyncResultHandler &_handler,
+				  const char *query,
+				  std::chrono::steady_clock::time_point enqueued) noexcept
+{
+	const char *label = _handler.GetQueryLabel();
+	m.Start(label != nullptr ? label : query, enqueued);
+}
+
+void
+AsyncConnection::FinishMeasurement(QueryMeasurement &m) noexcept
+{
+	auto *i = GetInstrumentation();
+	if (i != nullptr)
+		m.Finish(*i);
+	else
+		/* the instrumentation was removed meanwhile */
+		m.Cancel();
+}
+
+inline void
+AsyncConnection::ApplyChunkSize(unsigned chunk_size) noexcept
+{
+	if (chunk_size == 0)
+		return;
+
+#ifdef LIBPQ_HAS_CHUNK_MODE
+	if (chunk_size > 1 && SetChunkedRowsMode(chunk_size))
+		return;
+#endif
+
+	SetSingleRowMode();
+}
+
+void
+AsyncConnection::_EnqueueQuery(AsyncResultHandler &_handler,
+			       const char *query,
+			       size_t n_params, const char *const*values,
+			       unsigned chunk_size)
+{
+	assert(IsReady());
+
+#ifdef LIBPQ_HAS_PIPELINING
+	if (IsPipelineMode()) {
+		SendPipelineQuery(_handler, query, n_params, values);
+		return;
+	}
+#endif
+
+	if (IsIdle()) {
+		auto *cache = GetStatementCache();
+		if (cache == nullptr || !IsTransactionIdle() ||
+		    cache->Lookup(query) >= 0) {
+			_SendQuery(false, query, n_params, values,
+				   nullptr, nullptr);
+			ApplyChunkSize(chunk_size);
+			result_handler = &_handler;
+
+			if (GetInstrumentation() != nullptr)
+				StartMeasurement(measurement, _handler, query,
+						 std::chrono::steady_clock::now());
+			return;
+		}
+
+		/* needs to be prepared first, which is done by
+		   SendQueuedQuery() */
+		queue.emplace_back(_handler, query, n_params, values,
+				   chunk_size);
+		if (GetInstrumentation() != nullptr)
+			queue.back().enqueued = std::chrono::steady_clock::now();
+		SendQueuedQuery();
+		return;
+	}
+
+	queue.emplace_back(_handler, query, n_params, values, chunk_size);
+	if (GetInstrumentation() != nullptr)
+		queue.back().enqueued = std::chrono::steady_clock::now();
+}
+
+inline void
+AsyncConnection::DispatchNotify()
+{
+	auto notify = GetNextNotify();
+	if (!notify)
+		return;
+
+	NotifyBatch batch(coalesce_notify);
+
+	do {
+		batch.Add(std::move(notify));
+	} while ((notify = GetNextNotify()));
+
+	handler.OnNotifyBatch(batch.GetItems());
+}
+
 void
 AsyncConnection::PollNotify()
 {
@@ -169,13 +720,16 @@ AsyncConnection::PollNotify()
 
 	ConsumeInput();
 
-	Notify notify;
 	switch (GetStatus()) {
 	case CONNECTION_OK:
-		PollResult();
+#ifdef LIBPQ_HAS_PIPELINING
+		if (IsPipelineMode())
+			PollPipelineResults();
+		else
+#endif
+			PollResult();
 
-		while ((notify = GetNextNotify()))
-			handler.OnNotify(notify->relname);
+		DispatchNotify();
 
 		if (!was_idle && IsIdle())
 			handler.OnIdle();
@@ -217,6 +771,16 @@ AsyncConnection::Reconnect()
 
 	socket_event.Delete();
 	StartReconnect();
+
+	if (IsNonBlocking()) {
+		/* left over from an aborted COPY; this cannot fail
+		   because the output buffer has been discarded */
+		try {
+			SetNonBlocking(false);
+		} catch (...) {
+		}
+	}
+
 	state = State::RECONNECTING;
 	PollReconnect();
 }
@@ -231,21 +795,29 @@ AsyncConnection::Disconnect()
 	reconnect_timer.Cancel();
 	Connection::Disconnect();
 	state = State::DISCONNECTED;
+
+	queue.clear();
+	internal_step = InternalStep::NONE;
+	measurement.Cancel();
+	copy_state = CopyState::NONE;
+	copy_handler = nullptr;
+	copy_blocked = false;
+#ifdef LIBPQ_HAS_PIPELINING
+	pipeline.clear();
+	pipeline_sync_pending = false;
+#endif
 }
 
 void
 AsyncConnection::ScheduleReconnect() noexcept
 {
-	/* attempt to reconnect every 10 seconds */
-	static constexpr struct timeval delay{ 10, 0 };
-
 	assert(state == State::DISCONNECTED);
 
-	reconnect_timer.Add(delay);
+	reconnect_timer.Add(reconnect_delay);
 }
 
 inline void
-AsyncConnection::OnSocketEvent(unsigned)
+AsyncConnection::OnSocketEvent(unsigned events)
 {
 	switch (state) {
 	case State::DISCONNECTED:
@@ -261,7 +833,14 @@ AsyncConnection::OnSocketEvent(unsigned)
 		break;
 
 	case State::READY:
-		PollNotify();
+		if ((events & SocketEvent::WRITE) && copy_blocked) {
+			OnCopyWritable();
+			if (state != State::READY)
+				break;
+		}
+
+		if (events & SocketEvent::READ)
+			PollNotify();
 		break;
 	}
 }
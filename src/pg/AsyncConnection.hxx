@@ -34,9 +34,12 @@
 #define ASYNC_PG_CONNECTION_HXX
 
 #include "Connection.hxx"
+#include "NotifyBatch.hxx"
+#include "StoredQuery.hxx"
 #include "event/SocketEvent.hxx"
 #include "event/TimerEvent.hxx"
 
+#include <deque>
 #include <cassert>
 
 namespace Pg {
@@ -55,6 +58,20 @@ public:
 
 	virtual void OnDisconnect() = 0;
 	virtual void OnNotify(const char *name) = 0;
+
+	/**
+	 * Called with all notifications received by one socket
+	 * wakeup, in the order they were received.  The pointers are
+	 * only valid during this call.  The default implementation
+	 * calls OnNotify() for each item.
+	 *
+	 * @see AsyncConnection::SetCoalesceNotify()
+	 */
+	virtual void OnNotifyBatch(ConstBuffer<NotifyItem> batch) {
+		for (const auto &i : batch)
+			OnNotify(i.channel);
+	}
+
 	virtual void OnError(const char *prefix, const char *error) = 0;
 };
 
@@ -65,6 +82,37 @@ public:
 	virtual void OnResultError() {
 		OnResultEnd();
 	}
+
+	/**
+	 * Returns the label which groups this handler's queries in the
+	 * #QueryInstrumentation (see Connection::SetInstrumentation());
+	 * nullptr means the query string is used.
+	 */
+	virtual const char *GetQueryLabel() const noexcept {
+		return nullptr;
+	}
+};
+
+/**
+ * Receives the data of a COPY started with
+ * AsyncConnection::StartCopy().  The final result of the command is
+ * delivered with the #AsyncResultHandler methods.
+ */
+class AsyncCopyHandler : public AsyncResultHandler {
+public:
+	/**
+	 * "COPY FROM STDIN": the server is ready to receive data (the
+	 * first call), or the output buffer has drained after
+	 * AsyncConnection::CopyData() has returned false.  The producer
+	 * may now call CopyData() and finally CopyEnd().
+	 */
+	virtual void OnCopyReady() {}
+
+	/**
+	 * "COPY TO STDOUT": one row (text format) or chunk (binary
+	 * format) of data.  The buffer is only valid during this call.
+	 */
+	virtual void OnCopyData(ConstBuffer<void>) {}
 };
 
 /**
@@ -104,7 +152,7 @@ class AsyncConnection : public Connection {
 		/**
 		 * Connection is ready to be used.  As soon as the socket
 		 * becomes readable, notifications will be received and
-		 * forwarded to AsyncConnectionHandler::OnNotify().
+		 * forwarded to AsyncConnectionHandler::OnNotifyBatch().
 		 */
 		READY,
 	};
@@ -129,8 +177,178 @@ class AsyncConnection : public Connection {
 	 */
 	TimerEvent reconnect_timer;
 
+	struct timeval reconnect_delay{10, 0};
+
 	AsyncResultHandler *result_handler = nullptr;
 
+	/**
+	 * A query submitted with EnqueueQuery() while another one was in
+	 * progress (without pipeline mode).
+	 */
+	struct QueuedQuery {
+		AsyncResultHandler &handler;
+
+		StoredQuery query;
+
+		/**
+		 * Execute this query without a prepared statement, because
+		 * preparing it has failed.
+		 */
+		bool unprepared = false;
+
+		/**
+		 * See StreamQuery(); 0 means the result is delivered at
+		 * once.
+		 */
+		unsigned chunk_size;
+
+		/**
+		 * When was this query submitted?  Only set if a
+		 * #QueryInstrumentation is installed.
+		 */
+		std::chrono::steady_clock::time_point enqueued;
+
+		QueuedQuery(AsyncResultHandler &_handler, const char *_query,
+			    size_t n_params, const char *const*_values,
+			    unsigned _chunk_size)
+			:handler(_handler), query(_query, n_params, _values),
+			 chunk_size(_chunk_size) {}
+	};
+
+	/**
+	 * Queries waiting to be sent after #result_handler has
+	 * finished.
+	 */
+	std::deque<QueuedQuery> queue;
+
+	/**
+	 * Measures the query of #result_handler (if a
+	 * #QueryInstrumentation is installed).
+	 */
+	QueryMeasurement measurement;
+
+	/**
+	 * A statement cache request sent (without pipeline mode) on
+	 * behalf of the first #queue item, before the query itself.
+	 */
+	enum class InternalStep {
+		NONE,
+		DEALLOCATE,
+		PREPARE,
+	} internal_step = InternalStep::NONE;
+
+	enum class CopyState {
+		NONE,
+
+		/**
+		 * "COPY FROM STDIN" is in progress; the connection is in
+		 * non-blocking mode.
+		 */
+		IN,
+
+		/**
+		 * CopyEnd() has been called, but the output buffer has
+		 * not been flushed yet.
+		 */
+		END,
+
+		/**
+		 * "COPY TO STDOUT" is in progress.
+		 */
+		OUT,
+	} copy_state = CopyState::NONE;
+
+	/**
+	 * The handler passed to StartCopy(); it is also the
+	 * #result_handler.
+	 */
+	AsyncCopyHandler *copy_handler = nullptr;
+
+	/**
+	 * The number of bytes passed to PutCopyData() since the last
+	 * Flush().
+	 */
+	size_t copy_unflushed = 0;
+
+	/**
+	 * Is the output buffer full during "COPY FROM STDIN"?  Then we
+	 * wait for the socket to become writable.
+	 */
+	bool copy_blocked = false;
+
+	/**
+	 * Use libpq's pipeline mode (if available) for EnqueueQuery()?
+	 */
+	bool pipelining = false;
+
+	/**
+	 * @see SetCoalesceNotify()
+	 */
+	bool coalesce_notify = false;
+
+#ifdef LIBPQ_HAS_PIPELINING
+	struct PipelineItem {
+		enum class Type {
+			QUERY,
+
+			/**
+			 * Deallocating an evicted prepared statement;
+			 * #handler is nullptr.
+			 */
+			DEALLOCATE,
+
+			/**
+			 * Preparing the statement for the following
+			 * #QUERY item with the same #handler.
+			 */
+			PREPARE,
+		} type;
+
+		AsyncResultHandler *handler;
+
+		/**
+		 * The statement id (#PREPARE only).
+		 */
+		unsigned statement_id;
+
+		/**
+		 * Is this command followed by a sync point?
+		 */
+		bool sync;
+
+		/**
+		 * Discard the results of this #QUERY, because its
+		 * #PREPARE has failed and the error has been delivered to
+		 * the handler already.
+		 */
+		bool discard = false;
+
+		/**
+		 * Measures this #QUERY (if a #QueryInstrumentation is
+		 * installed).
+		 */
+		QueryMeasurement measurement;
+
+		PipelineItem(Type _type, AsyncResultHandler *_handler,
+			     bool _sync, unsigned _statement_id=0) noexcept
+			:type(_type), handler(_handler),
+			 statement_id(_statement_id), sync(_sync) {}
+	};
+
+	/**
+	 * In pipeline mode: all commands which have been sent, but whose
+	 * results have not been received completely.
+	 */
+	std::deque<PipelineItem> pipeline;
+
+	/**
+	 * In pipeline mode: all results of the query which was removed
+	 * last from #pipeline have been received, but its
+	 * PGRES_PIPELINE_SYNC has not been received yet.
+	 */
+	bool pipeline_sync_pending = false;
+#endif
+
 public:
 	/**
 	 * Construct the object, but do not initiate the connect yet.
@@ -152,6 +370,17 @@ public:
 		return state == State::READY;
 	}
 
+	/**
+	 * Let EnqueueQuery() use libpq's pipeline mode, which is entered
+	 * after each (re)connect.  Without libpq support, this is a
+	 * no-op.  In pipeline mode, the synchronous query methods
+	 * inherited from #Connection and SendQuery() must not be used.
+	 * Call this before Connect().
+	 */
+	void EnablePipelining() noexcept {
+		pipelining = true;
+	}
+
 	/**
 	 * Initiate the initial connect.  This may be called only once.
 	 */
@@ -169,7 +398,12 @@ public:
 	bool IsIdle() const {
 		assert(IsDefined());
 
-		return state == State::READY && result_handler == nullptr;
+		return state == State::READY && result_handler == nullptr &&
+			queue.empty()
+#ifdef LIBPQ_HAS_PIPELINING
+			&& pipeline.empty() && !pipeline_sync_pending
+#endif
+			;
 	}
 
 	template<typename... Params>
@@ -181,6 +415,127 @@ public:
 		Connection::SendQuery(params...);
 	}
 
+	/**
+	 * Send a query even if other queries are still in progress.  The
+	 * handlers receive the results in the order the queries were
+	 * enqueued.
+	 *
+	 * In pipeline mode (see EnablePipelining()), the query is sent
+	 * right away, followed by its own synchronization point, so a
+	 * failed query does not abort the following ones.  Otherwise,
+	 * the query and its parameters are copied and sent as soon as
+	 * the previous query has finished.
+	 *
+	 * With the statement cache (see
+	 * Connection::EnableStatementCache()), queries are prepared
+	 * asynchronously on first use.
+	 *
+	 * Pending queries are discarded by Disconnect(); a connection
+	 * failure invokes AsyncResultHandler::OnResultError() on all of
+	 * them.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	template<typename... Params>
+	void EnqueueQuery(AsyncResultHandler &_handler,
+			  const char *query, Params... _params) {
+		assert(IsReady());
+		assert(query != nullptr);
+
+		const TextParamArray<Params...> params(_params...);
+		EnqueueQueryValues(_handler, query,
+				   params.count, params.values);
+	}
+
+	/**
+	 * Like EnqueueQuery(), but with an array of text parameter
+	 * values (nullptr means SQL NULL).
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void EnqueueQueryValues(AsyncResultHandler &_handler,
+				const char *query,
+				size_t n_params, const char *const*values) {
+		_EnqueueQuery(_handler, query, n_params, values, 0);
+	}
+
+	/**
+	 * Like EnqueueQuery(), but the rows are delivered incrementally
+	 * instead of buffering the whole result in memory: each
+	 * AsyncResultHandler::OnResult() call receives a Result with up
+	 * to #chunk_size rows (exactly one row unless libpq supports
+	 * chunked mode), see Result::IsRowChunk(); the last one is an
+	 * empty PGRES_TUPLES_OK result.
+	 *
+	 * In pipeline mode, libpq cannot enable this for a query other
+	 * than the current one, so the result is delivered at once.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	template<typename... Params>
+	void StreamQuery(AsyncResultHandler &_handler, unsigned chunk_size,
+			 const char *query, Params... _params) {
+		assert(IsReady());
+		assert(chunk_size > 0);
+		assert(query != nullptr);
+
+		const TextParamArray<Params...> params(_params...);
+		_EnqueueQuery(_handler, query, params.count, params.values,
+			      chunk_size);
+	}
+
+	/**
+	 * Start a "COPY ... FROM STDIN" or "COPY ... TO STDOUT" command;
+	 * this is not possible in pipeline mode.  The data is
+	 * transferred with AsyncCopyHandler::OnCopyReady() and
+	 * CopyData() or with AsyncCopyHandler::OnCopyData(); the final
+	 * result is delivered to AsyncResultHandler::OnResult().
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void StartCopy(AsyncCopyHandler &_handler, const char *query);
+
+	/**
+	 * Send data (in the text or binary COPY format, as specified in
+	 * the command) after AsyncCopyHandler::OnCopyReady().  Data is
+	 * buffered and flushed in large chunks.
+	 *
+	 * Throws std::runtime_error on error.
+	 *
+	 * @return true if more data may be sent right away, false if the
+	 * producer shall wait for the next OnCopyReady() call (the data
+	 * has been queued nonetheless)
+	 */
+	bool CopyData(ConstBuffer<void> data);
+
+	/**
+	 * Finish "COPY FROM STDIN".
+	 *
+	 * Throws std::runtime_error on error.
+	 *
+	 * @param error if not nullptr, the COPY fails with this
+	 * message
+	 */
+	void CopyEnd(const char *error=nullptr);
+
+	/**
+	 * Change the delay for reconnecting after a failure (default:
+	 * 10 seconds).  It applies to the next reconnect.
+	 */
+	void SetReconnectDelay(const struct timeval &delay) noexcept {
+		reconnect_delay = delay;
+	}
+
+	/**
+	 * Deliver a notification only once per
+	 * AsyncConnectionHandler::OnNotifyBatch() call if its channel
+	 * and payload are equal to those of an earlier one in the
+	 * same batch.
+	 */
+	void SetCoalesceNotify(bool _coalesce_notify) noexcept {
+		coalesce_notify = _coalesce_notify;
+	}
+
 	void CheckNotify() {
 		if (IsReady())
 			PollNotify();
@@ -199,8 +554,84 @@ protected:
 	void PollConnect();
 	void PollReconnect();
 	void PollResult();
+	void DispatchNotify();
 	void PollNotify();
 
+#ifdef LIBPQ_HAS_PIPELINING
+	void PollPipelineResults();
+	void FinishPipelineQuery();
+	void HandlePipelineResult(Result &&result);
+
+	/**
+	 * Send a query in pipeline mode, preparing it first if the
+	 * statement cache is enabled.
+	 */
+	void SendPipelineQuery(AsyncResultHandler &_handler,
+			       const char *query,
+			       size_t n_params, const char *const*values);
+#endif
+
+	/**
+	 * Handle a result of the #internal_step.
+	 */
+	void HandleInternalResult(Result &&result) noexcept;
+
+	void BeginCopyIn();
+
+	/**
+	 * Receive "COPY TO STDOUT" data.
+	 *
+	 * @return true if the COPY is complete (its result can now be
+	 * received); false if more data needs to be awaited
+	 */
+	bool PollCopyOut();
+
+	/**
+	 * Attempt to send all "COPY FROM STDIN" data which was queued.
+	 *
+	 * Throws std::runtime_error on error.
+	 *
+	 * @return true if all data has been sent
+	 */
+	bool FlushCopy();
+
+	/**
+	 * All output of a "COPY FROM STDIN" has been sent after
+	 * CopyEnd().
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void FinishCopyIn();
+
+	void OnCopyWritable();
+
+	/**
+	 * Register the socket for reading, and writing if requested.
+	 */
+	void UpdateSocketEvent(bool write) noexcept;
+
+	void _EnqueueQuery(AsyncResultHandler &_handler, const char *query,
+			   size_t n_params, const char *const*values,
+			   unsigned chunk_size);
+
+	void StartMeasurement(QueryMeasurement &m,
+			      const AsyncResultHandler &_handler,
+			      const char *query,
+			      std::chrono::steady_clock::time_point enqueued) noexcept;
+
+	void FinishMeasurement(QueryMeasurement &m) noexcept;
+
+	/**
+	 * Switch to single-row or chunked mode after sending a query
+	 * (if #chunk_size is non-zero).
+	 */
+	void ApplyChunkSize(unsigned chunk_size) noexcept;
+
+	/**
+	 * Send the first query of the #queue.
+	 */
+	void SendQueuedQuery();
+
 	void ScheduleReconnect() noexcept;
 
 private:
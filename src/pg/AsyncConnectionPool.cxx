@@ -0,0 +1,316 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AsyncConnectionPool.hxx"
+#include "util/Exception.hxx"
+#include "util/DeleteDisposer.hxx"
+
+#include <stdexcept>
+
+namespace Pg {
+
+class AsyncConnectionPool::Item final : AsyncConnectionHandler {
+	AsyncConnectionPool &pool;
+
+public:
+	AsyncConnection connection;
+
+	unsigned in_flight = 0;
+
+	uint64_t n_queries = 0;
+
+	std::chrono::steady_clock::duration busy_time =
+		std::chrono::steady_clock::duration::zero();
+
+	/**
+	 * When did #in_flight become non-zero?
+	 */
+	std::chrono::steady_clock::time_point busy_since;
+
+	/**
+	 * The delay for the next reconnect.
+	 */
+	std::chrono::seconds reconnect_delay;
+
+	Item(AsyncConnectionPool &_pool, EventLoop &event_loop,
+	     const char *conninfo, const char *schema) noexcept
+		:pool(_pool),
+		 connection(event_loop, conninfo, schema, *this),
+		 reconnect_delay(pool.config.min_reconnect_delay) {
+		if (pool.config.pipelining)
+			connection.EnablePipelining();
+	}
+
+	bool IsAvailable() const noexcept {
+		return connection.IsReady() &&
+			in_flight < pool.config.max_in_flight;
+	}
+
+	void OnQueryStart() noexcept {
+		if (in_flight++ == 0)
+			busy_since = std::chrono::steady_clock::now();
+		++n_queries;
+	}
+
+	void OnQueryEnd() noexcept {
+		assert(in_flight > 0);
+
+		if (--in_flight == 0)
+			busy_time += std::chrono::steady_clock::now() - busy_since;
+	}
+
+	ConnectionStats GetStats() const noexcept {
+		ConnectionStats stats;
+		stats.ready = connection.IsReady();
+		stats.in_flight = in_flight;
+		stats.n_queries = n_queries;
+		stats.busy_time = busy_time;
+		if (in_flight > 0)
+			stats.busy_time += std::chrono::steady_clock::now() - busy_since;
+		return stats;
+	}
+
+	/**
+	 * Discard all queries (see AsyncConnectionPool::Disconnect()).
+	 */
+	void Reset() noexcept {
+		if (in_flight > 0) {
+			busy_time += std::chrono::steady_clock::now() - busy_since;
+			in_flight = 0;
+		}
+	}
+
+private:
+	/**
+	 * Apply the current reconnect delay to the reconnect which is
+	 * about to be scheduled, and double it for the next one.
+	 */
+	void Backoff() noexcept {
+		const struct timeval tv{time_t(reconnect_delay.count()), 0};
+		connection.SetReconnectDelay(tv);
+
+		reconnect_delay = std::min(reconnect_delay * 2,
+					   pool.config.max_reconnect_delay);
+	}
+
+	/* virtual methods from class AsyncConnectionHandler */
+	void OnConnect() override {
+		reconnect_delay = pool.config.min_reconnect_delay;
+		pool.OnItemAvailable(*this);
+	}
+
+	void OnDisconnect() override {
+		Backoff();
+	}
+
+	void OnNotify(const char *) override {
+	}
+
+	void OnError(const char *prefix, const char *error) override {
+		pool.handler.OnPoolError(prefix, error);
+
+		if (!connection.IsReady())
+			/* a connect has failed; if a ready connection fails,
+			   OnDisconnect() will follow */
+			Backoff();
+	}
+};
+
+inline void
+AsyncConnectionPool::Query::Start(Item &_item) noexcept
+{
+	assert(item == nullptr);
+
+	item = &_item;
+	item->OnQueryStart();
+}
+
+void
+AsyncConnectionPool::Query::OnResult(Result &&result)
+{
+	handler.OnResult(std::move(result));
+}
+
+inline AsyncConnectionPool::Item &
+AsyncConnectionPool::Query::Finish() noexcept
+{
+	assert(item != nullptr);
+
+	auto &i = *item;
+	delete this;
+
+	i.OnQueryEnd();
+	return i;
+}
+
+void
+AsyncConnectionPool::Query::OnResultEnd()
+{
+	auto &p = pool;
+	auto &h = handler;
+	auto &i = Finish();
+
+	p.OnItemAvailable(i);
+	h.OnResultEnd();
+}
+
+void
+AsyncConnectionPool::Query::OnResultError()
+{
+	auto &p = pool;
+	auto &h = handler;
+	auto &i = Finish();
+
+	p.OnItemAvailable(i);
+	h.OnResultError();
+}
+
+AsyncConnectionPool::AsyncConnectionPool(EventLoop &event_loop,
+					 const char *conninfo,
+					 const char *schema,
+					 const Config &_config,
+					 AsyncConnectionPoolHandler &_handler)
+	:config(_config), handler(_handler)
+{
+	assert(config.size > 0);
+	assert(config.max_in_flight > 0);
+
+	items.reserve(config.size);
+	for (unsigned i = 0; i < config.size; ++i)
+		items.emplace_back(new Item(*this, event_loop,
+					    conninfo, schema));
+}
+
+AsyncConnectionPool::~AsyncConnectionPool() noexcept
+{
+	Disconnect();
+}
+
+void
+AsyncConnectionPool::Connect()
+{
+	/* warm up: connect all of them right away instead of on
+	   demand */
+	for (auto &i : items)
+		i->connection.Connect();
+}
+
+void
+AsyncConnectionPool::Disconnect() noexcept
+{
+	for (auto &i : items) {
+		i->connection.Disconnect();
+		i->Reset();
+	}
+
+	waiting.clear();
+	queries.clear_and_dispose(DeleteDisposer());
+}
+
+AsyncConnectionPool::Item *
+AsyncConnectionPool::FindAvailable() const noexcept
+{
+	Item *result = nullptr;
+
+	for (const auto &i : items)
+		if (i->IsAvailable() &&
+		    (result == nullptr || i->in_flight < result->in_flight))
+			result = i.get();
+
+	return result;
+}
+
+void
+AsyncConnectionPool::Submit(Item &item, Query &query,
+			    const char *query_string,
+			    size_t n_params, const char *const*values)
+{
+	item.connection.EnqueueQueryValues(query, query_string,
+					   n_params, values);
+	query.Start(item);
+}
+
+void
+AsyncConnectionPool::SendQueryValues(AsyncResultHandler &_handler,
+				     const char *query_string,
+				     size_t n_params, const char *const*values)
+{
+	assert(query_string != nullptr);
+
+	/* don't overtake queries which are already waiting */
+	Item *item = waiting.empty() ? FindAvailable() : nullptr;
+
+	if (item == nullptr && waiting.size() >= config.max_queued)
+		throw std::runtime_error("Too many queued database queries");
+
+	std::unique_ptr<Query> query(new Query(*this, _handler));
+
+	if (item != nullptr)
+		Submit(*item, *query, query_string, n_params, values);
+	else
+		waiting.emplace_back(*query, query_string, n_params, values);
+
+	queries.push_back(*query.release());
+}
+
+void
+AsyncConnectionPool::OnItemAvailable(Item &item) noexcept
+{
+	while (!waiting.empty() && item.IsAvailable()) {
+		auto w = std::move(waiting.front());
+		waiting.pop_front();
+
+		const auto values = w.stored.GetValues();
+
+		try {
+			Submit(item, *w.query, w.stored.GetQuery(),
+			       values.size(), values.data());
+		} catch (...) {
+			handler.OnPoolError("Failed to send query",
+					    GetFullMessage(std::current_exception()).c_str());
+
+			auto &h = w.query->GetHandler();
+			delete w.query;
+			h.OnResultError();
+		}
+	}
+}
+
+AsyncConnectionPool::ConnectionStats
+AsyncConnectionPool::GetConnectionStats(size_t i) const noexcept
+{
+	assert(i < items.size());
+
+	return items[i]->GetStats();
+}
+
+} /* namespace Pg */
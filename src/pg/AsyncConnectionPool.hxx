@@ -0,0 +1,275 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PG_ASYNC_CONNECTION_POOL_HXX
+#define PG_ASYNC_CONNECTION_POOL_HXX
+
+#include "AsyncConnection.hxx"
+#include "StoredQuery.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <stdint.h>
+
+namespace Pg {
+
+class AsyncConnectionPoolHandler {
+public:
+	virtual void OnPoolError(const char *prefix,
+				 const char *error) noexcept = 0;
+};
+
+/**
+ * Manages several #AsyncConnection instances to the same database.
+ * Each query is dispatched to the least loaded connection; if all
+ * of them are busy (or not connected), it is queued.
+ */
+class AsyncConnectionPool {
+public:
+	struct Config {
+		/**
+		 * The number of connections.
+		 */
+		unsigned size = 4;
+
+		/**
+		 * The maximum number of queries submitted to one
+		 * connection at a time.  Values larger than 1 make sense
+		 * only with #pipelining.
+		 */
+		unsigned max_in_flight = 1;
+
+		/**
+		 * See AsyncConnection::EnablePipelining().
+		 */
+		bool pipelining = false;
+
+		/**
+		 * The maximum number of queries waiting for a connection.
+		 */
+		size_t max_queued = 1024;
+
+		/**
+		 * The reconnect delay starts at this value and is doubled
+		 * after each consecutive failure, up to
+		 * #max_reconnect_delay.
+		 */
+		std::chrono::seconds min_reconnect_delay{1};
+		std::chrono::seconds max_reconnect_delay{60};
+	};
+
+	struct ConnectionStats {
+		bool ready;
+
+		/**
+		 * The number of queries submitted to this connection
+		 * which are not finished yet.
+		 */
+		unsigned in_flight;
+
+		uint64_t n_queries;
+
+		/**
+		 * The total time this connection had at least one query
+		 * in flight.
+		 */
+		std::chrono::steady_clock::duration busy_time;
+	};
+
+private:
+	class Item;
+
+	/**
+	 * Wraps the caller's #AsyncResultHandler to keep track of the
+	 * connection load.
+	 */
+	class Query final
+		: public AsyncResultHandler,
+		  public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::auto_unlink>> {
+		AsyncConnectionPool &pool;
+		AsyncResultHandler &handler;
+
+		/**
+		 * The connection this query has been submitted to, or
+		 * nullptr if it is still waiting.
+		 */
+		Item *item = nullptr;
+
+	public:
+		Query(AsyncConnectionPool &_pool,
+		      AsyncResultHandler &_handler) noexcept
+			:pool(_pool), handler(_handler) {}
+
+		AsyncResultHandler &GetHandler() noexcept {
+			return handler;
+		}
+
+		void Start(Item &_item) noexcept;
+
+		/* virtual methods from class AsyncResultHandler */
+		void OnResult(Result &&result) override;
+		void OnResultEnd() override;
+		void OnResultError() override;
+
+	private:
+		/**
+		 * Release the connection and delete this object.
+		 *
+		 * @return the connection this query was submitted to
+		 */
+		Item &Finish() noexcept;
+	};
+
+	/**
+	 * A query waiting for a connection.
+	 */
+	struct Waiting {
+		Query *query;
+
+		StoredQuery stored;
+
+		Waiting(Query &_query, const char *_query_string,
+			size_t n_params, const char *const*values)
+			:query(&_query),
+			 stored(_query_string, n_params, values) {}
+	};
+
+	const Config config;
+
+	AsyncConnectionPoolHandler &handler;
+
+	std::vector<std::unique_ptr<Item>> items;
+
+	std::deque<Waiting> waiting;
+
+	/**
+	 * All #Query instances (waiting or in flight); they are deleted
+	 * without notifying their handlers by Disconnect().
+	 */
+	boost::intrusive::list<Query,
+			       boost::intrusive::constant_time_size<false>> queries;
+
+public:
+	AsyncConnectionPool(EventLoop &event_loop,
+			    const char *conninfo, const char *schema,
+			    const Config &_config,
+			    AsyncConnectionPoolHandler &_handler);
+
+	~AsyncConnectionPool() noexcept;
+
+	AsyncConnectionPool(const AsyncConnectionPool &) = delete;
+	AsyncConnectionPool &operator=(const AsyncConnectionPool &) = delete;
+
+	/**
+	 * Initiate connecting all connections.  This may be called only
+	 * once.
+	 */
+	void Connect();
+
+	/**
+	 * Close all connections.  Pending queries are discarded
+	 * without notifying their handlers (like
+	 * AsyncConnection::Disconnect()).
+	 */
+	void Disconnect() noexcept;
+
+	/**
+	 * Submit a query to the least loaded connection, or queue it
+	 * until one becomes available.
+	 *
+	 * Throws std::runtime_error on error, e.g. if the queue is
+	 * full.
+	 */
+	template<typename... Params>
+	void SendQuery(AsyncResultHandler &_handler,
+		       const char *query, Params... _params) {
+		const TextParamArray<Params...> params(_params...);
+		SendQueryValues(_handler, query,
+				params.count, params.values);
+	}
+
+	/**
+	 * Like SendQuery(), but with an array of text parameter values
+	 * (nullptr means SQL NULL).
+	 */
+	void SendQueryValues(AsyncResultHandler &_handler,
+			     const char *query,
+			     size_t n_params, const char *const*values);
+
+	size_t GetSize() const noexcept {
+		return items.size();
+	}
+
+	/**
+	 * Returns the number of queries waiting for a connection.
+	 */
+	size_t GetQueueLength() const noexcept {
+		return waiting.size();
+	}
+
+	/**
+	 * Obtain load statistics for one connection; they help sizing
+	 * the pool.
+	 *
+	 * @param i an index below GetSize()
+	 */
+	ConnectionStats GetConnectionStats(size_t i) const noexcept;
+
+private:
+	/**
+	 * Find the connected #Item with the fewest queries in flight
+	 * which can accept another one.
+	 */
+	gcc_pure
+	Item *FindAvailable() const noexcept;
+
+	/**
+	 * Throws on error.
+	 */
+	void Submit(Item &item, Query &query, const char *query_string,
+		    size_t n_params, const char *const*values);
+
+	/**
+	 * The given connection may be able to accept more queries;
+	 * submit waiting queries to it.
+	 */
+	void OnItemAvailable(Item &item) noexcept;
+};
+
+} /* namespace Pg */
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "TypeOid.hxx"
+#include "Timestamp.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/ByteOrder.hxx"
+
+#include <chrono>
+#include <string>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace Pg {
+
+/**
+ * Wrap a value to pass it as a parameter in PostgreSQL's binary
+ * format (e.g. to Connection::ExecuteBinary()), which saves the
+ * formatting on the client and the parsing on the server.  The C++
+ * type must match the SQL type of the parameter exactly (e.g. int32_t
+ * for "integer", int64_t for "bigint"), because the server does not
+ * convert binary values.
+ *
+ * Supported are all types with a #BinaryEncoder specialization and
+ * one-dimensional arrays of them (as ConstBuffer<T>); for "bytea",
+ * pass a #BinaryValue instead.
+ */
+template<typename T>
+struct Binary {
+	T value;
+
+	explicit constexpr Binary(T _value):value(_value) {}
+};
+
+/**
+ * Encodes a C++ value in PostgreSQL's binary format; the counterpart
+ * of #BinaryDecoder.  Each specialization provides:
+ *
+ * - `static constexpr Oid TYPE`: the SQL type (for array headers)
+ *
+ * - `static constexpr size_t SIZE`: the size of the encoded value
+ *
+ * - `static void Store(void *dest, T value)`: write the value in
+ *   network byte order
+ */
+template<typename T>
+struct BinaryEncoder;
+
+template<>
+struct BinaryEncoder<bool> {
+	static constexpr Oid TYPE = TypeOid::BOOL;
+	static constexpr size_t SIZE = 1;
+
+	static void Store(void *dest, bool value) noexcept {
+		*(uint8_t *)dest = value;
+	}
+};
+
+template<>
+struct BinaryEncoder<int16_t> {
+	static constexpr Oid TYPE = TypeOid::INT2;
+	static constexpr size_t SIZE = sizeof(int16_t);
+
+	static void Store(void *dest, int16_t value) noexcept {
+		StoreBE16(dest, value);
+	}
+};
+
+template<>
+struct BinaryEncoder<int32_t> {
+	static constexpr Oid TYPE = TypeOid::INT4;
+	static constexpr size_t SIZE = sizeof(int32_t);
+
+	static void Store(void *dest, int32_t value) noexcept {
+		StoreBE32(dest, value);
+	}
+};
+
+template<>
+struct BinaryEncoder<uint32_t> {
+	static constexpr Oid TYPE = TypeOid::OID;
+	static constexpr size_t SIZE = sizeof(uint32_t);
+
+	static void Store(void *dest, uint32_t value) noexcept {
+		StoreBE32(dest, value);
+	}
+};
+
+template<>
+struct BinaryEncoder<int64_t> {
+	static constexpr Oid TYPE = TypeOid::INT8;
+	static constexpr size_t SIZE = sizeof(int64_t);
+
+	static void Store(void *dest, int64_t value) noexcept {
+		StoreBE64(dest, value);
+	}
+};
+
+template<>
+struct BinaryEncoder<float> {
+	static constexpr Oid TYPE = TypeOid::FLOAT4;
+	static constexpr size_t SIZE = sizeof(float);
+
+	static void Store(void *dest, float value) noexcept {
+		static_assert(sizeof(float) == sizeof(uint32_t), "");
+
+		uint32_t i;
+		memcpy(&i, &value, sizeof(i));
+		StoreBE32(dest, i);
+	}
+};
+
+template<>
+struct BinaryEncoder<double> {
+	static constexpr Oid TYPE = TypeOid::FLOAT8;
+	static constexpr size_t SIZE = sizeof(double);
+
+	static void Store(void *dest, double value) noexcept {
+		static_assert(sizeof(double) == sizeof(uint64_t), "");
+
+		uint64_t i;
+		memcpy(&i, &value, sizeof(i));
+		StoreBE64(dest, i);
+	}
+};
+
+/**
+ * Encodes as "timestamp" (without time zone, i.e. UTC); the binary
+ * format of "timestamptz" is the same, but array element types must
+ * match the column exactly.  time_point::max() and time_point::min()
+ * are mapped to "infinity" and "-infinity".
+ */
+template<>
+struct BinaryEncoder<std::chrono::system_clock::time_point> {
+	static constexpr Oid TYPE = TypeOid::TIMESTAMP;
+	static constexpr size_t SIZE = sizeof(int64_t);
+
+	static void Store(void *dest,
+			  std::chrono::system_clock::time_point value) noexcept {
+		StoreBE64(dest, ToBinaryTimestamp(value));
+	}
+};
+
+/**
+ * Encode a one-dimensional array (without NULL elements) in
+ * PostgreSQL's binary format; the counterpart of #BinaryArray.
+ */
+template<typename T>
+std::string
+EncodeBinaryArray(ConstBuffer<T> src)
+{
+	typedef BinaryEncoder<T> E;
+
+	/* header: ndim, flags (has NULLs), element type; then size
+	   and lower bound of the (only) dimension */
+	const size_t header_size = src.empty() ? 12 : 20;
+
+	std::string result(header_size + src.size * (4 + E::SIZE), '\0');
+	uint8_t *p = (uint8_t *)&result.front();
+
+	StoreBE32(p, !src.empty());
+	StoreBE32(p + 4, 0);
+	StoreBE32(p + 8, E::TYPE);
+	if (!src.empty()) {
+		StoreBE32(p + 12, src.size);
+		StoreBE32(p + 16, 1);
+	}
+
+	p += header_size;
+
+	for (const auto &i : src) {
+		StoreBE32(p, E::SIZE);
+		p += 4;
+		E::Store(p, i);
+		p += E::SIZE;
+	}
+
+	return result;
+}
+
+} /* namespace Pg */
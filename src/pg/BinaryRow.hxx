@@ -0,0 +1,492 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PG_BINARY_ROW_HXX
+#define PG_BINARY_ROW_HXX
+
+#include "Result.hxx"
+#include "TypeOid.hxx"
+#include "BinaryValue.hxx"
+#include "Timestamp.hxx"
+#include "util/StringView.hxx"
+#include "util/ByteOrder.hxx"
+
+#include <postgresql/libpq-fe.h>
+
+#include <array>
+#include <chrono>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace Pg {
+
+/**
+ * Decodes a value in PostgreSQL's binary format into a C++ type.
+ * Each specialization provides:
+ *
+ * - `static bool CheckType(Oid type)`: can values of this column
+ *   type be decoded?
+ *
+ * - `static T Decode(BinaryValue value)`: decode one value; a SQL
+ *   NULL is passed as a nullptr buffer.  Throws std::invalid_argument
+ *   on error.
+ *
+ * Only #StringView and #BinaryValue accept NULL (as nullptr); all
+ * other types throw.
+ */
+template<typename T>
+struct BinaryDecoder;
+
+namespace BinaryDetail {
+
+using ::LoadBE16;
+using ::LoadBE32;
+using ::LoadBE64;
+
+/**
+ * Throws std::invalid_argument if the value is NULL or does not
+ * have the given size.
+ */
+static inline void
+CheckFixedSize(BinaryValue value, size_t size)
+{
+	if (value.data == nullptr)
+		throw std::invalid_argument("Unexpected NULL value");
+
+	if (value.size != size)
+		throw std::invalid_argument("Wrong binary value size");
+}
+
+} /* namespace BinaryDetail */
+
+template<>
+struct BinaryDecoder<bool> {
+	static constexpr bool CheckType(Oid type) noexcept {
+		return type == TypeOid::BOOL;
+	}
+
+	static bool Decode(BinaryValue value) {
+		BinaryDetail::CheckFixedSize(value, 1);
+		return *(const uint8_t *)value.data != 0;
+	}
+};
+
+template<>
+struct BinaryDecoder<int16_t> {
+	static constexpr bool CheckType(Oid type) noexcept {
+		return type == TypeOid::INT2;
+	}
+
+	static int16_t Decode(BinaryValue value) {
+		BinaryDetail::CheckFixedSize(value, sizeof(int16_t));
+		return BinaryDetail::LoadBE16(value.data);
+	}
+};
+
+template<>
+struct BinaryDecoder<int32_t> {
+	static constexpr bool CheckType(Oid type) noexcept {
+		return type == TypeOid::INT4;
+	}
+
+	static int32_t Decode(BinaryValue value) {
+		BinaryDetail::CheckFixedSize(value, sizeof(int32_t));
+		return BinaryDetail::LoadBE32(value.data);
+	}
+};
+
+template<>
+struct BinaryDecoder<uint32_t> {
+	static constexpr bool CheckType(Oid type) noexcept {
+		return type == TypeOid::OID;
+	}
+
+	static uint32_t Decode(BinaryValue value) {
+		BinaryDetail::CheckFixedSize(value, sizeof(uint32_t));
+		return BinaryDetail::LoadBE32(value.data);
+	}
+};
+
+template<>
+struct BinaryDecoder<int64_t> {
+	static constexpr bool CheckType(Oid type) noexcept {
+		return type == TypeOid::INT8;
+	}
+
+	static int64_t Decode(BinaryValue value) {
+		BinaryDetail::CheckFixedSize(value, sizeof(int64_t));
+		return BinaryDetail::LoadBE64(value.data);
+	}
+};
+
+template<>
+struct BinaryDecoder<float> {
+	static constexpr bool CheckType(Oid type) noexcept {
+		return type == TypeOid::FLOAT4;
+	}
+
+	static float Decode(BinaryValue value) {
+		static_assert(sizeof(float) == sizeof(uint32_t), "");
+
+		BinaryDetail::CheckFixedSize(value, sizeof(float));
+		const uint32_t i = BinaryDetail::LoadBE32(value.data);
+		float f;
+		memcpy(&f, &i, sizeof(f));
+		return f;
+	}
+};
+
+template<>
+struct BinaryDecoder<double> {
+	static constexpr bool CheckType(Oid type) noexcept {
+		return type == TypeOid::FLOAT8;
+	}
+
+	static double Decode(BinaryValue value) {
+		static_assert(sizeof(double) == sizeof(uint64_t), "");
+
+		BinaryDetail::CheckFixedSize(value, sizeof(double));
+		const uint64_t i = BinaryDetail::LoadBE64(value.data);
+		double d;
+		memcpy(&d, &i, sizeof(d));
+		return d;
+	}
+};
+
+/**
+ * Points into the #Result; the binary format of text types is the
+ * plain string without a null terminator.
+ */
+template<>
+struct BinaryDecoder<StringView> {
+	static constexpr bool CheckType(Oid type) noexcept {
+		return type == TypeOid::TEXT || type == TypeOid::VARCHAR ||
+			type == TypeOid::BPCHAR || type == TypeOid::NAME;
+	}
+
+	static StringView Decode(BinaryValue value) noexcept {
+		return StringView((const char *)value.data, value.size);
+	}
+};
+
+/**
+ * Accepts any column type and returns the raw binary value.
+ */
+template<>
+struct BinaryDecoder<BinaryValue> {
+	static constexpr bool CheckType(Oid) noexcept {
+		return true;
+	}
+
+	static BinaryValue Decode(BinaryValue value) noexcept {
+		return value;
+	}
+};
+
+/**
+ * "timestamp" and "timestamptz" (both are microseconds since
+ * 2000-01-01 UTC in the binary format).  "infinity" and "-infinity"
+ * are mapped to time_point::max() and time_point::min().
+ */
+template<>
+struct BinaryDecoder<std::chrono::system_clock::time_point> {
+	typedef std::chrono::system_clock::time_point time_point;
+
+	static constexpr bool CheckType(Oid type) noexcept {
+		return type == TypeOid::TIMESTAMP ||
+			type == TypeOid::TIMESTAMPTZ;
+	}
+
+	static time_point Decode(BinaryValue value) {
+		return FromBinaryTimestamp(BinaryDecoder<int64_t>::Decode(value));
+	}};
+
+/**
+ * A view on a one-dimensional array in PostgreSQL's binary format.
+ * Elements are decoded while iterating, without copying.
+ */
+template<typename T>
+class BinaryArray {
+	const uint8_t *elements = nullptr;
+	unsigned n = 0;
+
+public:
+	BinaryArray() = default;
+
+	/**
+	 * Throws std::invalid_argument on error.
+	 */
+	explicit BinaryArray(BinaryValue value) {
+		using namespace BinaryDetail;
+
+		if (value.data == nullptr)
+			throw std::invalid_argument("Unexpected NULL value");
+
+		const uint8_t *p = (const uint8_t *)value.data;
+		const uint8_t *const end = p + value.size;
+
+		/* header: ndim, flags, element type; then size and
+		   lower bound of each dimension */
+		if (value.size < 12)
+			throw std::invalid_argument("Malformed binary array");
+
+		const uint32_t ndim = LoadBE32(p);
+		if (ndim == 0)
+			/* empty array */
+			return;
+
+		if (ndim != 1)
+			throw std::invalid_argument("Multi-dimensional binary arrays not supported");
+
+		if (!BinaryDecoder<T>::CheckType(LoadBE32(p + 8)))
+			throw std::invalid_argument("Wrong binary array element type");
+
+		if (value.size < 20)
+			throw std::invalid_argument("Malformed binary array");
+
+		n = LoadBE32(p + 12);
+		elements = p + 20;
+
+		/* verify the element lengths now, so the iterator does
+		   not need to */
+		p = elements;
+		for (unsigned i = 0; i < n; ++i) {
+			if (size_t(end - p) < 4)
+				throw std::invalid_argument("Malformed binary array");
+
+			const int32_t length = LoadBE32(p);
+			p += 4;
+
+			if (length > 0) {
+				if (size_t(end - p) < size_t(length))
+					throw std::invalid_argument("Malformed binary array");
+				p += length;
+			}
+		}
+	}
+
+	unsigned size() const noexcept {
+		return n;
+	}
+
+	bool empty() const noexcept {
+		return n == 0;
+	}
+
+	class const_iterator {
+		const uint8_t *p;
+		unsigned i;
+
+	public:
+		typedef std::input_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const T *pointer;
+		typedef T reference;
+
+		constexpr const_iterator(const uint8_t *_p, unsigned _i) noexcept
+			:p(_p), i(_i) {}
+
+		bool operator==(const const_iterator &other) const noexcept {
+			return i == other.i;
+		}
+
+		bool operator!=(const const_iterator &other) const noexcept {
+			return i != other.i;
+		}
+
+		const_iterator &operator++() noexcept {
+			const int32_t length = BinaryDetail::LoadBE32(p);
+			p += 4;
+			if (length > 0)
+				p += length;
+			++i;
+			return *this;
+		}
+
+		/**
+		 * Throws std::invalid_argument on error.
+		 */
+		T operator*() const {
+			const int32_t length = BinaryDetail::LoadBE32(p);
+			return BinaryDecoder<T>::Decode(length < 0
+							? BinaryValue(nullptr, 0)
+							: BinaryValue(p + 4, length));
+		}
+	};
+
+	const_iterator begin() const noexcept {
+		return {elements, 0};
+	}
+
+	const_iterator end() const noexcept {
+		return {nullptr, n};
+	}
+};
+
+template<typename T>
+struct BinaryDecoder<BinaryArray<T>> {
+	static constexpr bool CheckType(Oid) noexcept {
+		/* the element type is checked by the BinaryArray
+		   constructor */
+		return true;
+	}
+
+	static BinaryArray<T> Decode(BinaryValue value) {
+		return BinaryArray<T>(value);
+	}
+};
+
+/**
+ * Decodes rows of a #Result with binary columns (e.g. from
+ * Connection::ExecuteParams() with result_binary=true) into typed
+ * values.  The column indexes and types are looked up and checked
+ * once by the constructor, not for each row.
+ *
+ * Values of type #StringView, #BinaryValue and #BinaryArray point
+ * into the #Result, which must outlive them.
+ */
+template<typename... Types>
+class BinaryRowDecoder {
+	typedef std::tuple<Types...> Tuple;
+
+	static constexpr std::size_t N = sizeof...(Types);
+
+	const Result &result;
+
+	std::array<unsigned, N> columns;
+
+public:
+	/**
+	 * Use the first columns of the result, in order.
+	 *
+	 * Throws std::invalid_argument if the result does not match
+	 * the types.
+	 */
+	explicit BinaryRowDecoder(const Result &_result)
+		:result(_result) {
+		if (result.GetColumnCount() < N)
+			throw std::invalid_argument("Not enough columns");
+
+		for (unsigned i = 0; i < N; ++i)
+			columns[i] = i;
+
+		CheckColumns();
+	}
+
+	/**
+	 * Look up the columns by their names.
+	 *
+	 * Throws std::invalid_argument if a column does not exist or
+	 * does not match its type.
+	 */
+	BinaryRowDecoder(const Result &_result,
+			 std::initializer_list<const char *> names)
+		:result(_result) {
+		if (names.size() != N)
+			throw std::invalid_argument("Wrong number of column names");
+
+		unsigned i = 0;
+		for (const char *name : names) {
+			const int column = result.GetColumnIndex(name);
+			if (column < 0)
+				throw std::invalid_argument(std::string("No such column: ") + name);
+
+			columns[i++] = column;
+		}
+
+		CheckColumns();
+	}
+
+	/**
+	 * Decode one value.
+	 *
+	 * Throws std::invalid_argument on error.
+	 */
+	template<std::size_t I>
+	typename std::tuple_element<I, Tuple>::type Get(unsigned row) const {
+		typedef typename std::tuple_element<I, Tuple>::type T;
+
+		return BinaryDecoder<T>::Decode(GetRawValue(row, columns[I]));
+	}
+
+	/**
+	 * Decode all values of a row.
+	 *
+	 * Throws std::invalid_argument on error.
+	 */
+	Tuple Decode(unsigned row) const {
+		return DecodeRow(row, std::index_sequence_for<Types...>());
+	}
+
+private:
+	void CheckColumns() const {
+		typedef bool (*CheckFunction)(Oid);
+		const std::array<CheckFunction, N> check{{&BinaryDecoder<Types>::CheckType...}};
+
+		for (unsigned i = 0; i < N; ++i) {
+			const unsigned column = columns[i];
+
+			if (!result.IsColumnBinary(column))
+				throw std::invalid_argument(std::string("Column is not binary: ") +
+							    result.GetColumnName(column));
+
+			if (!check[i](result.GetColumnType(column)))
+				throw std::invalid_argument(std::string("Wrong column type: ") +
+							    result.GetColumnName(column));
+		}
+	}
+
+	gcc_pure
+	BinaryValue GetRawValue(unsigned row, unsigned column) const noexcept {
+		return result.IsValueNull(row, column)
+			? BinaryValue(nullptr, 0)
+			: BinaryValue(result.GetValue(row, column),
+				      result.GetValueLength(row, column));
+	}
+
+	template<std::size_t... I>
+	Tuple DecodeRow(unsigned row, std::index_sequence<I...>) const {
+		return Tuple(Get<I>(row)...);
+	}
+};
+
+} /* namespace Pg */
+
+#endif
@@ -78,12 +78,80 @@ Connection::SetSchema(const char *schema)
 	ExecuteOrThrow(sql.c_str());
 }
 
+long
+Connection::PrepareCached(const char *query, size_t n_params,
+			  Result &result_r)
+{
+	assert(IsDefined());
+	assert(statement_cache);
+
+	const long cached = statement_cache->Lookup(query);
+	if (cached >= 0)
+		return cached;
+
+	if (!IsTransactionIdle())
+		/* don't let a failing PREPARE or DEALLOCATE abort the
+		   caller's transaction; just execute the query
+		   unprepared this time */
+		return -1;
+
+	if (statement_cache->IsFull()) {
+		const StatementCache::Name name(statement_cache->EvictOldest());
+		std::string sql = "DEALLOCATE ";
+		sql += name;
+		/* ignore errors; a leftover statement is harmless */
+		Execute(sql.c_str());
+	}
+
+	const unsigned id = statement_cache->Insert(query);
+	auto result = CheckResult(::PQprepare(conn, StatementCache::Name(id),
+					      query, n_params, nullptr));
+	if (!result.IsCommandSuccessful()) {
+		statement_cache->Remove(query);
+		result_r = std::move(result);
+		return -1;
+	}
+
+	return id;
+}
+
+Result
+Connection::ExecuteParamsUnmeasured(bool result_binary, const char *query,
+				    size_t n_params, const char *const*values,
+				    const int *lengths, const int *formats)
+{
+	assert(IsDefined());
+	assert(query != nullptr);
+
+	if (statement_cache) {
+		Result error;
+		const long id = PrepareCached(query, n_params, error);
+		if (id >= 0)
+			return CheckResult(::PQexecPrepared(conn,
+							    StatementCache::Name(id),
+							    n_params, values,
+							    lengths, formats,
+							    result_binary));
+
+		if (error.IsDefined())
+			/* the PREPARE error is the same one which
+			   executing the query would have caused */
+			return error;
+	}
+
+	return CheckResult(::PQexecParams(conn, query, n_params, nullptr,
+					  values, lengths, formats,
+					  result_binary));
+}
+
 void
 Connection::SendQuery(const char *query)
 {
 	assert(IsDefined());
 	assert(query != nullptr);
 
+	TRACE_POINT(pg_query_send, this, query);
+
 	if (::PQsendQuery(conn, query) == 0)
 		throw std::runtime_error(GetErrorMessage());
 }
@@ -96,8 +164,34 @@ Connection::_SendQuery(bool result_binary, const char *query,
 	assert(IsDefined());
 	assert(query != nullptr);
 
-	if (::PQsendQueryParams(conn, query, n_params, nullptr,
-				values, lengths, formats, result_binary) == 0)
+	/* only statements which have already been prepared can be used
+	   here; preparing is up to the caller, because it needs a
+	   separate round trip */
+	const long id = statement_cache
+		? statement_cache->Lookup(query)
+		: -1;
+
+	TRACE_POINT(pg_query_send, this, query);
+
+	const int success = id >= 0
+		? ::PQsendQueryPrepared(conn, StatementCache::Name(id),
+					n_params, values, lengths, formats,
+					result_binary)
+		: ::PQsendQueryParams(conn, query, n_params, nullptr,
+				      values, lengths, formats, result_binary);
+	if (success == 0)
+		throw std::runtime_error(GetErrorMessage());
+}
+
+void
+Connection::SendPrepare(const char *name, const char *query,
+			size_t n_params)
+{
+	assert(IsDefined());
+	assert(name != nullptr);
+	assert(query != nullptr);
+
+	if (::PQsendPrepare(conn, name, query, n_params, nullptr) == 0)
 		throw std::runtime_error(GetErrorMessage());
 }
 
@@ -37,8 +37,11 @@
 #include "DynamicParamWrapper.hxx"
 #include "Result.hxx"
 #include "Notify.hxx"
+#include "StatementCache.hxx"
+#include "Instrumentation.hxx"
 
 #include "util/Compiler.h"
+#include "util/Trace.h"
 
 #include <postgresql/libpq-fe.h>
 #include <postgresql/pg_config.h>
@@ -58,6 +61,15 @@ namespace Pg {
 class Connection {
 	PGconn *conn = nullptr;
 
+	/**
+	 * If set, then parameterized queries are prepared on first use
+	 * and executed as prepared statements afterwards.  See
+	 * EnableStatementCache().
+	 */
+	std::unique_ptr<StatementCache> statement_cache;
+
+	QueryInstrumentation *instrumentation = nullptr;
+
 public:
 	Connection() = default;
 
@@ -73,12 +85,16 @@ public:
 	Connection(const Connection &other) = delete;
 
 	Connection(Connection &&other) noexcept
-		:conn(std::exchange(other.conn, nullptr)) {}
+		:conn(std::exchange(other.conn, nullptr)),
+		 statement_cache(std::move(other.statement_cache)),
+		 instrumentation(std::exchange(other.instrumentation, nullptr)) {}
 
 	Connection &operator=(const Connection &other) = delete;
 
 	Connection &operator=(Connection &&other) noexcept {
 		std::swap(conn, other.conn);
+		std::swap(statement_cache, other.statement_cache);
+		std::swap(instrumentation, other.instrumentation);
 		return *this;
 	}
 
@@ -137,6 +153,8 @@ public:
 			::PQfinish(conn);
 			conn = nullptr;
 		}
+
+		ClearStatementCache();
 	}
 
 	void Connect(const char *conninfo);
@@ -151,12 +169,14 @@ public:
 	void Reconnect() noexcept {
 		assert(IsDefined());
 
+		ClearStatementCache();
 		::PQreset(conn);
 	}
 
 	void StartReconnect() noexcept {
 		assert(IsDefined());
 
+		ClearStatementCache();
 		::PQresetStart(conn);
 	}
 
@@ -178,6 +198,72 @@ public:
 		return Notify(::PQnotifies(conn));
 	}
 
+	/**
+	 * Prepare each distinct parameterized query (ExecuteParams(),
+	 * ExecuteBinary(), ExecuteDynamic()) on first use and execute it
+	 * as a named prepared statement afterwards, which saves the
+	 * server from parsing and planning it again.  SendQuery() with
+	 * parameters uses statements which are already cached, but does
+	 * not prepare new ones (AsyncConnection::EnqueueQuery() does).  The least recently used statements are
+	 * deallocated when the cache is full; a reconnect discards all
+	 * of them.
+	 *
+	 * Statements are planned with the "search_path" which is active
+	 * when they are prepared; don't use this if the search path
+	 * changes after SetSchema().
+	 */
+	void EnableStatementCache() {
+		if (!statement_cache)
+			statement_cache.reset(new StatementCache());
+	}
+
+	bool IsStatementCacheEnabled() const noexcept {
+		return statement_cache != nullptr;
+	}
+
+	/**
+	 * Install (or, with nullptr, remove) an object which collects
+	 * statistics about all queries.  Synchronous queries are keyed
+	 * by their query string; asynchronous queries by
+	 * AsyncResultHandler::GetQueryLabel().  The object is owned by
+	 * the caller.
+	 */
+	void SetInstrumentation(QueryInstrumentation *_instrumentation) noexcept {
+		instrumentation = _instrumentation;
+	}
+
+	QueryInstrumentation *GetInstrumentation() noexcept {
+		return instrumentation;
+	}
+
+protected:
+	void ClearStatementCache() noexcept {
+		if (statement_cache)
+			statement_cache->Clear();
+	}
+
+	StatementCache *GetStatementCache() noexcept {
+		return statement_cache.get();
+	}
+
+	gcc_pure
+	bool IsTransactionIdle() const noexcept {
+		return ::PQtransactionStatus(conn) == PQTRANS_IDLE;
+	}
+
+	/**
+	 * Look up the query in the #statement_cache, and prepare it
+	 * (synchronously) if it is not there yet.
+	 *
+	 * @param result_r on failure to prepare the statement, the
+	 * error result is returned here
+	 * @return the statement id or -1 if the query shall be executed
+	 * without a prepared statement
+	 */
+	long PrepareCached(const char *query, size_t n_params,
+			   Result &result_r);
+
+public:
 protected:
 	Result CheckResult(PGresult *result) {
 		if (result == nullptr)
@@ -186,6 +272,27 @@ protected:
 		return Result(result);
 	}
 
+	/**
+	 * Run a synchronous query, submitting its measurement to the
+	 * #instrumentation (if one is installed).
+	 */
+	template<typename F>
+	Result Measure(const char *query, F &&f) {
+		if (instrumentation == nullptr)
+			return f();
+
+		QueryMeasurement m;
+		m.Start(query);
+		auto result = f();
+		m.OnResult(result);
+		m.Finish(*instrumentation);
+		return result;
+	}
+
+	Result ExecuteParamsUnmeasured(bool result_binary, const char *query,
+				       size_t n_params, const char *const*values,
+				       const int *lengths, const int *formats);
+
 	static size_t CountDynamic() noexcept {
 		return 0;
 	}
@@ -196,6 +303,16 @@ protected:
 			CountDynamic(params...);
 	}
 
+	Result _ExecuteParams(bool result_binary, const char *query,
+			      size_t n_params, const char *const*values,
+			      const int *lengths, const int *formats) {
+		return Measure(query, [&](){
+				return ExecuteParamsUnmeasured(result_binary, query,
+							       n_params, values,
+							       lengths, formats);
+			});
+	}
+
 	Result ExecuteDynamic2(const char *query,
 			       const char *const*values,
 			       const int *lengths, const int *formats,
@@ -203,9 +320,8 @@ protected:
 		assert(IsDefined());
 		assert(query != nullptr);
 
-		return CheckResult(::PQexecParams(conn, query, n,
-						  nullptr, values, lengths, formats,
-						  false));
+		return _ExecuteParams(false, query, n,
+				      values, lengths, formats);
 	}
 
 	template<typename T, typename... Params>
@@ -229,7 +345,9 @@ public:
 		assert(IsDefined());
 		assert(query != nullptr);
 
-		return CheckResult(::PQexec(conn, query));
+		return Measure(query, [this, query](){
+				return CheckResult(::PQexec(conn, query));
+			});
 	}
 
 	template<typename... Params>
@@ -240,10 +358,8 @@ public:
 
 		const TextParamArray<Params...> params(_params...);
 
-		return CheckResult(::PQexecParams(conn, query, params.count,
-						  nullptr, params.values,
-						  nullptr, nullptr,
-						  result_binary));
+		return _ExecuteParams(result_binary, query, params.count,
+				      params.values, nullptr, nullptr);
 	}
 
 	template<typename... Params>
@@ -258,10 +374,9 @@ public:
 
 		const BinaryParamArray<Params...> params(_params...);
 
-		return CheckResult(::PQexecParams(conn, query, params.count,
-						  nullptr, params.values,
-						  params.lengths, params.formats,
-						  false));
+		return _ExecuteParams(false, query, params.count,
+				      params.values,
+				      params.lengths, params.formats);
 	}
 
 	/**
@@ -383,11 +498,19 @@ public:
 
 	void SendQuery(const char *query);
 
-private:
+protected:
 	void _SendQuery(bool result_binary, const char *query,
 			size_t n_params, const char *const*values,
 			const int *lengths, const int *formats);
 
+	/**
+	 * Send a request to create a prepared statement.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void SendPrepare(const char *name, const char *query,
+			 size_t n_params);
+
 public:
 	template<typename... Params>
 	void SendQuery(bool result_binary,
@@ -412,10 +535,137 @@ public:
 	}
 #endif
 
+#ifdef LIBPQ_HAS_CHUNK_MODE
+	/**
+	 * @return false if the mode could not be set (e.g. because a
+	 * result has already been received)
+	 */
+	bool SetChunkedRowsMode(unsigned chunk_size) noexcept {
+		return PQsetChunkedRowsMode(conn, chunk_size) != 0;
+	}
+#endif
+
+#ifdef LIBPQ_HAS_PIPELINING
+	gcc_pure
+	bool IsPipelineMode() const noexcept {
+		assert(IsDefined());
+
+		return ::PQpipelineStatus(conn) != PQ_PIPELINE_OFF;
+	}
+
+	/**
+	 * Throws std::runtime_error on error.
+	 */
+	void EnterPipelineMode() {
+		assert(IsDefined());
+
+		if (::PQenterPipelineMode(conn) == 0)
+			throw std::runtime_error(GetErrorMessage());
+	}
+
+	/**
+	 * Mark a synchronization point in the pipeline and flush the
+	 * output buffer.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void PipelineSync() {
+		assert(IsDefined());
+
+		if (::PQpipelineSync(conn) == 0)
+			throw std::runtime_error(GetErrorMessage());
+	}
+#endif
+
 	Result ReceiveResult() noexcept {
 		assert(IsDefined());
 
-		return Result(PQgetResult(conn));
+		PGresult *result = PQgetResult(conn);
+		TRACE_POINT(pg_result, this, result);
+		return Result(result);
+	}
+
+	gcc_pure
+	bool IsNonBlocking() const noexcept {
+		assert(IsDefined());
+
+		return ::PQisnonblocking(conn) != 0;
+	}
+
+	/**
+	 * Throws std::runtime_error on error.
+	 */
+	void SetNonBlocking(bool value) {
+		assert(IsDefined());
+
+		if (::PQsetnonblocking(conn, value) != 0)
+			throw std::runtime_error(GetErrorMessage());
+	}
+
+	/**
+	 * Attempt to send queued output data to the server.
+	 *
+	 * Throws std::runtime_error on error.
+	 *
+	 * @return true if all data has been sent, false if some remains
+	 * (only in non-blocking mode)
+	 */
+	bool Flush() {
+		assert(IsDefined());
+
+		const int result = ::PQflush(conn);
+		if (result < 0)
+			throw std::runtime_error(GetErrorMessage());
+
+		return result == 0;
+	}
+
+	/**
+	 * Queue data for "COPY FROM STDIN".
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void PutCopyData(ConstBuffer<void> data) {
+		assert(IsDefined());
+
+		const int result = ::PQputCopyData(conn,
+						   (const char *)data.data,
+						   data.size);
+		if (result < 0)
+			throw std::runtime_error(GetErrorMessage());
+
+		if (result == 0)
+			/* only in non-blocking mode, when the output
+			   buffer could not be enlarged */
+			throw std::bad_alloc();
+	}
+
+	/**
+	 * Receive one row from "COPY TO STDOUT" without blocking.
+	 *
+	 * @return the number of bytes (the buffer must be freed with
+	 * PQfreemem()), 0 if no complete row is available yet, -1 when
+	 * the COPY is complete and -2 on error
+	 */
+	int GetCopyData(char **buffer_r) noexcept {
+		assert(IsDefined());
+
+		return ::PQgetCopyData(conn, buffer_r, true);
+	}
+
+	/**
+	 * Finish "COPY FROM STDIN".
+	 *
+	 * Throws std::runtime_error on error.
+	 *
+	 * @param error if not nullptr, the COPY fails with this
+	 * message
+	 */
+	void PutCopyEnd(const char *error=nullptr) {
+		assert(IsDefined());
+
+		if (::PQputCopyEnd(conn, error) <= 0)
+			throw std::runtime_error(GetErrorMessage());
 	}
 
 	gcc_pure
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PG_COPY_FORMAT_HXX
+#define PG_COPY_FORMAT_HXX
+
+#include "util/ConstBuffer.hxx"
+#include "util/StringView.hxx"
+#include "util/ByteOrder.hxx"
+
+#include <string>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace Pg {
+
+/**
+ * Builds data in PostgreSQL's binary COPY format, to be passed to
+ * AsyncConnection::CopyData().  Call AppendHeader() once at the
+ * beginning of the stream and AppendTrailer() at the end; in
+ * between, each row consists of BeginRow() and one Append*() call
+ * per field.  Clear() may be called after each CopyData() to reuse
+ * the buffer.
+ */
+class CopyBinaryBuilder {
+	std::string buffer;
+
+public:
+	bool empty() const noexcept {
+		return buffer.empty();
+	}
+
+	size_t size() const noexcept {
+		return buffer.size();
+	}
+
+	ConstBuffer<void> Get() const noexcept {
+		return {buffer.data(), buffer.size()};
+	}
+
+	void Clear() noexcept {
+		buffer.clear();
+	}
+
+	void AppendHeader() {
+		/* signature (including the null byte), flags, header
+		   extension length */
+		static constexpr char signature[] = "PGCOPY\n\377\r\n";
+		buffer.append(signature, sizeof(signature));
+		AppendRaw32(0);
+		AppendRaw32(0);
+	}
+
+	void AppendTrailer() {
+		AppendRaw16(0xffff);
+	}
+
+	void BeginRow(unsigned n_fields) {
+		AppendRaw16(n_fields);
+	}
+
+	void AppendNull() {
+		AppendRaw32(0xffffffff);
+	}
+
+	void AppendBinary(ConstBuffer<void> value) {
+		AppendRaw32(value.size);
+		buffer.append((const char *)value.data, value.size);
+	}
+
+	/**
+	 * For text, varchar and similar types.
+	 */
+	void AppendString(StringView value) {
+		AppendBinary(value.ToVoid());
+	}
+
+	void AppendBool(bool value) {
+		AppendRaw32(1);
+		buffer.push_back(value);
+	}
+
+	void AppendInt16(int16_t value) {
+		AppendRaw32(sizeof(value));
+		AppendRaw16(value);
+	}
+
+	void AppendInt32(int32_t value) {
+		AppendRaw32(sizeof(value));
+		AppendRaw32(value);
+	}
+
+	void AppendInt64(int64_t value) {
+		AppendRaw32(sizeof(value));
+		AppendRaw64(value);
+	}
+
+	void AppendDouble(double value) {
+		uint64_t i;
+		memcpy(&i, &value, sizeof(i));
+		AppendRaw32(sizeof(i));
+		AppendRaw64(i);
+	}
+
+private:
+	void AppendRaw16(uint16_t value) {
+		value = ToBE16(value);
+		buffer.append((const char *)&value, sizeof(value));
+	}
+
+	void AppendRaw32(uint32_t value) {
+		value = ToBE32(value);
+		buffer.append((const char *)&value, sizeof(value));
+	}
+
+	void AppendRaw64(uint64_t value) {
+		value = ToBE64(value);
+		buffer.append((const char *)&value, sizeof(value));
+	}
+};
+
+/**
+ * Append a field value to a row in the text COPY format, escaping
+ * backslashes and the characters which delimit fields and rows.
+ * Fields are separated by a tab, rows are terminated by a newline,
+ * and NULL is written as "\N".
+ */
+static inline void
+AppendCopyText(std::string &dest, StringView value)
+{
+	for (const char ch : value) {
+		switch (ch) {
+		case '\\':
+			dest.append("\\\\");
+			break;
+
+		case '\t':
+			dest.append("\\t");
+			break;
+
+		case '\n':
+			dest.append("\\n");
+			break;
+
+		case '\r':
+			dest.append("\\r");
+			break;
+
+		default:
+			dest.push_back(ch);
+		}
+	}
+}
+
+} /* namespace Pg */
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Instrumentation.hxx"
+#include "Result.hxx"
+
+#include <stdio.h>
+
+namespace Pg {
+
+void
+QueryInstrumentation::Stats::Add(const QueryTiming &t) noexcept
+{
+	++n_queries;
+	if (t.error)
+		++n_errors;
+
+	n_rows += t.n_rows;
+	n_bytes += t.n_bytes;
+
+	queue_wait.Add(t.queue_wait);
+	execution.Add(t.execution);
+	transfer.Add(t.transfer);
+}
+
+void
+QueryInstrumentation::Clear() noexcept
+{
+	total = {};
+	labels.clear();
+	n_slow_queries = 0;
+}
+
+void
+QueryInstrumentation::Add(const char *label, const QueryTiming &t) noexcept
+{
+	total.Add(t);
+
+	try {
+		auto i = labels.find(label);
+		if (i == labels.end())
+			i = labels.emplace(label, Stats()).first;
+
+		i->second.Add(t);
+	} catch (...) {
+		/* out of memory: only the total is updated */
+	}
+
+	if (t.GetTotal() >= slow_threshold) {
+		++n_slow_queries;
+		OnSlowQuery(label, t);
+	}
+}
+
+void
+QueryInstrumentation::OnSlowQuery(const char *label,
+				  const QueryTiming &t) noexcept
+{
+	typedef std::chrono::duration<double, std::milli> ms;
+
+	fprintf(stderr, "slow PostgreSQL query: %1.3f ms (queue=%1.3f execution=%1.3f transfer=%1.3f) rows=%u bytes=%llu%s: %s\n",
+		std::chrono::duration_cast<ms>(t.GetTotal()).count(),
+		std::chrono::duration_cast<ms>(t.queue_wait).count(),
+		std::chrono::duration_cast<ms>(t.execution).count(),
+		std::chrono::duration_cast<ms>(t.transfer).count(),
+		t.n_rows, (unsigned long long)t.n_bytes,
+		t.error ? " (error)" : "",
+		label);
+}
+
+void
+QueryMeasurement::Start(const char *_label,
+			Clock::time_point enqueued) noexcept
+{
+	try {
+		label = _label;
+	} catch (...) {
+		label.clear();
+	}
+
+	sent = Clock::now();
+	timing = {};
+	timing.queue_wait = sent - enqueued;
+	received = false;
+	active = true;
+}
+
+void
+QueryMeasurement::OnResult(const Result &result) noexcept
+{
+	if (!active)
+		return;
+
+	if (!received) {
+		received = true;
+		first_result = Clock::now();
+		timing.execution = first_result - sent;
+	}
+
+	if (result.IsError())
+		timing.error = true;
+
+	const unsigned n_rows = result.GetRowCount();
+	const unsigned n_columns = result.GetColumnCount();
+	timing.n_rows += n_rows;
+
+	for (unsigned row = 0; row < n_rows; ++row)
+		for (unsigned column = 0; column < n_columns; ++column)
+			timing.n_bytes += result.GetValueLength(row, column);
+}
+
+void
+QueryMeasurement::Finish(QueryInstrumentation &instrumentation) noexcept
+{
+	if (!active)
+		return;
+
+	active = false;
+
+	const auto now = Clock::now();
+	if (received)
+		timing.transfer = now - first_result;
+	else
+		/* no result at all */
+		timing.execution = now - sent;
+
+	instrumentation.Add(label.c_str(), timing);
+}
+
+} /* namespace Pg */
@@ -0,0 +1,198 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "util/Log2Histogram.hxx"
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+
+#include <stdint.h>
+
+namespace Pg {
+
+class Result;
+
+/**
+ * The measurements of one query.
+ */
+struct QueryTiming {
+	typedef std::chrono::steady_clock::duration Duration;
+
+	/**
+	 * The time the query has waited in the client before it was
+	 * sent (including preparing it, see
+	 * Connection::EnableStatementCache()).
+	 */
+	Duration queue_wait = Duration::zero();
+
+	/**
+	 * The time from sending the query until the first result
+	 * arrived.
+	 */
+	Duration execution = Duration::zero();
+
+	/**
+	 * The time from the first result until the last one (only
+	 * greater than zero with AsyncConnection::StreamQuery()).
+	 */
+	Duration transfer = Duration::zero();
+
+	unsigned n_rows = 0;
+
+	/**
+	 * The total size of all values received.
+	 */
+	uint64_t n_bytes = 0;
+
+	bool error = false;
+
+	Duration GetTotal() const noexcept {
+		return queue_wait + execution + transfer;
+	}
+};
+
+/**
+ * Collects per-query statistics of a #Connection or
+ * #AsyncConnection.  Install it with Connection::SetInstrumentation().
+ * While no instance is installed, the overhead is one branch per
+ * query and per result.
+ */
+class QueryInstrumentation {
+public:
+	typedef QueryTiming::Duration Duration;
+
+	struct Stats {
+		uint64_t n_queries = 0, n_errors = 0;
+		uint64_t n_rows = 0, n_bytes = 0;
+
+		Log2Histogram queue_wait, execution, transfer;
+
+		void Add(const QueryTiming &t) noexcept;
+	};
+
+	/**
+	 * All queries.
+	 */
+	Stats total;
+
+	/**
+	 * Statistics per label: AsyncResultHandler::GetQueryLabel() or
+	 * the query string.
+	 */
+	std::map<std::string, Stats, std::less<>> labels;
+
+	/**
+	 * Queries which take at least this long in total are reported
+	 * to OnSlowQuery().
+	 */
+	Duration slow_threshold;
+
+	uint64_t n_slow_queries = 0;
+
+	explicit QueryInstrumentation(Duration _slow_threshold=std::chrono::milliseconds(100)) noexcept
+		:slow_threshold(_slow_threshold) {}
+
+	virtual ~QueryInstrumentation() noexcept = default;
+
+	QueryInstrumentation(const QueryInstrumentation &) = delete;
+	QueryInstrumentation &operator=(const QueryInstrumentation &) = delete;
+
+	void Clear() noexcept;
+
+	void Add(const char *label, const QueryTiming &t) noexcept;
+
+protected:
+	/**
+	 * A query has exceeded #slow_threshold.  The default
+	 * implementation prints a message to stderr.
+	 */
+	virtual void OnSlowQuery(const char *label,
+				 const QueryTiming &t) noexcept;
+};
+
+/**
+ * Measures one query in flight, to be submitted to a
+ * #QueryInstrumentation when it is finished.
+ */
+class QueryMeasurement {
+	typedef std::chrono::steady_clock Clock;
+
+	std::string label;
+
+	Clock::time_point sent, first_result;
+
+	QueryTiming timing;
+
+	bool active = false;
+
+	/**
+	 * Has OnResult() been called already?
+	 */
+	bool received;
+
+public:
+	bool IsActive() const noexcept {
+		return active;
+	}
+
+	/**
+	 * The query is about to be sent.
+	 *
+	 * @param enqueued the time the query was submitted by the
+	 * caller
+	 */
+	void Start(const char *_label, Clock::time_point enqueued) noexcept;
+
+	void Start(const char *_label) noexcept {
+		Start(_label, Clock::now());
+	}
+
+	void OnResult(const Result &result) noexcept;
+
+	/**
+	 * All results have been received; submit the measurement.
+	 */
+	void Finish(QueryInstrumentation &instrumentation) noexcept;
+
+	/**
+	 * Discard the measurement (e.g. after a connection failure).
+	 */
+	void Cancel() noexcept {
+		active = false;
+	}
+};
+
+} /* namespace Pg */
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Notify.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <string.h>
+
+namespace Pg {
+
+/**
+ * One asynchronous notification, see
+ * AsyncConnectionHandler::OnNotifyBatch().
+ */
+struct NotifyItem {
+	const char *channel;
+
+	/**
+	 * The payload string; empty if the sender did not specify
+	 * one.
+	 */
+	const char *payload;
+
+	/**
+	 * The process id of the sending server process.
+	 */
+	int pid;
+};
+
+/**
+ * Collects the notifications received by one socket wakeup, so they
+ * can be dispatched in one call.
+ */
+class NotifyBatch {
+	struct Less {
+		typedef std::pair<const char *, const char *> Key;
+
+		gcc_pure
+		bool operator()(const Key &a, const Key &b) const noexcept {
+			int cmp = strcmp(a.first, b.first);
+			if (cmp == 0)
+				cmp = strcmp(a.second, b.second);
+			return cmp < 0;
+		}
+	};
+
+	/**
+	 * Owns the memory #items point to.
+	 */
+	std::vector<Notify> notifies;
+
+	std::vector<NotifyItem> items;
+
+	/**
+	 * The (channel, payload) pairs in #items; only used if
+	 * #coalesce is enabled.
+	 */
+	std::set<Less::Key, Less> seen;
+
+	const bool coalesce;
+
+public:
+	/**
+	 * @param _coalesce drop notifications whose channel and
+	 * payload equal those of an earlier one in this batch
+	 */
+	explicit NotifyBatch(bool _coalesce=false) noexcept
+		:coalesce(_coalesce) {}
+
+	bool IsEmpty() const noexcept {
+		return items.empty();
+	}
+
+	void Add(Notify &&notify);
+
+	/**
+	 * Returns the notifications in the order they were received.
+	 * The strings are valid until this object is destroyed.
+	 */
+	ConstBuffer<NotifyItem> GetItems() const noexcept {
+		return {items.data(), items.size()};
+	}
+};
+
+} /* namespace Pg */
@@ -35,6 +35,7 @@
 
 #include "Serial.hxx"
 #include "BinaryValue.hxx"
+#include "BinaryParam.hxx"
 #include "Array.hxx"
 
 #include <iterator>
@@ -210,6 +211,53 @@ struct ParamWrapper<bool> {
 	}
 };
 
+/**
+ * A fixed-size value in the binary format, see #Binary.
+ */
+template<typename T>
+struct ParamWrapper<Binary<T>> {
+	uint8_t buffer[BinaryEncoder<T>::SIZE];
+
+	ParamWrapper(Binary<T> b) noexcept {
+		BinaryEncoder<T>::Store(buffer, b.value);
+	}
+
+	const char *GetValue() const {
+		return (const char *)buffer;
+	}
+
+	static constexpr bool IsBinary() {
+		return true;
+	}
+
+	static constexpr size_t GetSize() {
+		return BinaryEncoder<T>::SIZE;
+	}
+};
+
+/**
+ * A one-dimensional array in the binary format, see #Binary.
+ */
+template<typename T>
+struct ParamWrapper<Binary<ConstBuffer<T>>> {
+	std::string value;
+
+	ParamWrapper(Binary<ConstBuffer<T>> b)
+		:value(EncodeBinaryArray(b.value)) {}
+
+	const char *GetValue() const {
+		return value.data();
+	}
+
+	static constexpr bool IsBinary() {
+		return true;
+	}
+
+	size_t GetSize() const {
+		return value.size();
+	}
+};
+
 /**
  * Specialization for STL container types of std::string instances.
  */
@@ -88,11 +88,36 @@ public:
 		return GetStatus() == PGRES_COMMAND_OK;
 	}
 
+	/**
+	 * Is this a (partial) row set?  This includes the chunks
+	 * delivered by AsyncConnection::StreamQuery().
+	 */
 	gcc_pure
 	bool IsQuerySuccessful() const noexcept {
-		return GetStatus() == PGRES_TUPLES_OK;
+		const auto status = GetStatus();
+		return status == PGRES_TUPLES_OK || IsRowChunk(status);
+	}
+
+	/**
+	 * Is this a partial row set from single-row or chunked mode?
+	 * The last result of such a query is an empty PGRES_TUPLES_OK.
+	 */
+	gcc_pure
+	bool IsRowChunk() const noexcept {
+		return IsRowChunk(GetStatus());
+	}
+
+private:
+	static constexpr bool IsRowChunk(ExecStatusType status) noexcept {
+		return status == PGRES_SINGLE_TUPLE
+#ifdef LIBPQ_HAS_CHUNK_MODE
+			|| status == PGRES_TUPLES_CHUNK
+#endif
+			;
 	}
 
+public:
+
 	gcc_pure
 	bool IsError() const noexcept {
 		const auto status = GetStatus();
@@ -165,6 +190,18 @@ public:
 		return ::PQfname(result, column);
 	}
 
+	/**
+	 * Look up a column by its name.
+	 *
+	 * @return the column index or -1 if there is no such column
+	 */
+	gcc_pure
+	int GetColumnIndex(const char *name) const noexcept {
+		assert(IsDefined());
+
+		return ::PQfnumber(result, name);
+	}
+
 	gcc_pure
 	bool IsColumnBinary(unsigned column) const noexcept {
 		assert(IsDefined());
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PG_STATEMENT_CACHE_HXX
+#define PG_STATEMENT_CACHE_HXX
+
+#include "util/Cache.hxx"
+
+#include <string>
+
+#include <assert.h>
+#include <stdio.h>
+
+namespace Pg {
+
+/**
+ * Maps query strings to the names of prepared statements on one
+ * connection.  The least recently used statement is evicted when
+ * the cache is full; the caller is responsible for deallocating it
+ * on the server.
+ */
+class StatementCache {
+	Cache<std::string, unsigned, 64, 61> cache;
+
+	unsigned next_id = 0;
+
+public:
+	/**
+	 * A buffer for a statement name.
+	 */
+	struct Name {
+		char value[16];
+
+		explicit Name(unsigned id) noexcept {
+			snprintf(value, sizeof(value), "_pgsc%u", id);
+		}
+
+		operator const char *() const noexcept {
+			return value;
+		}
+	};
+
+	/**
+	 * Look up the statement id of a query which has been prepared
+	 * already.
+	 *
+	 * @return the id, or -1 if the query is not cached
+	 */
+	long Lookup(const char *query) noexcept {
+		const auto *id = cache.Get(std::string(query));
+		return id != nullptr ? long(*id) : -1;
+	}
+
+	bool IsFull() const noexcept {
+		return cache.IsFull();
+	}
+
+	/**
+	 * Remove the least recently used statement (the cache must not
+	 * be empty).
+	 *
+	 * @return its id, to be deallocated by the caller
+	 */
+	unsigned EvictOldest() noexcept {
+		auto *oldest = cache.PeekOldest();
+		assert(oldest != nullptr);
+
+		const unsigned id = *oldest;
+		cache.RemoveItem(*oldest);
+		return id;
+	}
+
+	/**
+	 * Add a query which is about to be prepared.  There must be
+	 * room for it (see IsFull()).
+	 *
+	 * @return the new statement id
+	 */
+	unsigned Insert(const char *query) {
+		assert(!IsFull());
+
+		const unsigned id = next_id++;
+		cache.Put(std::string(query), id);
+		return id;
+	}
+
+	/**
+	 * Remove a query, e.g. after preparing it has failed.
+	 */
+	void Remove(const char *query) noexcept {
+		auto *id = cache.Get(std::string(query));
+		if (id != nullptr)
+			cache.RemoveItem(*id);
+	}
+
+	/**
+	 * Remove a statement by its id (if still present).
+	 */
+	void RemoveId(unsigned id) noexcept {
+		cache.RemoveIf([id](const std::string &, unsigned i){
+				return i == id;
+			});
+	}
+
+	/**
+	 * Forget all statements, e.g. after the connection has been
+	 * reset (which deallocates them on the server).
+	 */
+	void Clear() noexcept {
+		cache.Clear();
+	}
+};
+
+} /* namespace Pg */
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PG_STORED_QUERY_HXX
+#define PG_STORED_QUERY_HXX
+
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+
+namespace Pg {
+
+/**
+ * A copy of a query string and its text parameter values, which
+ * allows sending the query later, after the caller's buffers have
+ * been freed.
+ */
+class StoredQuery {
+	std::string query;
+
+	std::vector<std::string> values;
+
+	/**
+	 * Which of the #values are SQL NULL?
+	 */
+	std::vector<bool> nulls;
+
+public:
+	/**
+	 * @param values the parameter values; nullptr means SQL NULL
+	 */
+	StoredQuery(const char *_query,
+		    size_t n_params, const char *const*_values)
+		:query(_query) {
+		values.reserve(n_params);
+		nulls.reserve(n_params);
+
+		for (size_t i = 0; i < n_params; ++i) {
+			const bool is_null = _values[i] == nullptr;
+			values.emplace_back(is_null ? "" : _values[i]);
+			nulls.push_back(is_null);
+		}
+	}
+
+	const char *GetQuery() const noexcept {
+		return query.c_str();
+	}
+
+	size_t GetParamCount() const noexcept {
+		return values.size();
+	}
+
+	/**
+	 * Build the parameter array for PQsendQueryParams().  It
+	 * remains valid as long as this object is not modified.
+	 */
+	std::vector<const char *> GetValues() const {
+		std::vector<const char *> result;
+		result.reserve(values.size());
+		for (size_t i = 0; i < values.size(); ++i)
+			result.push_back(nulls[i] ? nullptr : values[i].c_str());
+		return result;
+	}
+};
+
+} /* namespace Pg */
+
+#endif
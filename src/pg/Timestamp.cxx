@@ -31,96 +31,315 @@
  */
 
 #include "Timestamp.hxx"
-#include "time/Convert.hxx"
 #include "util/StringBuffer.hxx"
+#include "util/StringView.hxx"
+#include "util/CharUtil.hxx"
+#include "util/ByteOrder.hxx"
 
 #include <stdexcept>
 
 #include <assert.h>
+#include <string.h>
 
 namespace Pg {
 
-static std::chrono::system_clock::duration
-ParsePositiveTimezoneOffset(const char *s)
+typedef std::chrono::system_clock::time_point time_point;
+typedef std::chrono::system_clock::duration duration;
+
+/**
+ * Convert a date of the proleptic Gregorian calendar to the number
+ * of days since 1970-01-01.
+ */
+static constexpr int64_t
+DaysFromCivil(int64_t y, unsigned m, unsigned d) noexcept
 {
-	char *endptr;
-	const auto hours = strtoul(s, &endptr, 10);
-	if (endptr != s + 2 || hours >= 24)
-		throw std::runtime_error("Failed to parse time zone offset");
+	/* http://howardhinnant.github.io/date_algorithms.html */
+	y -= m <= 2;
+	const int64_t era = (y >= 0 ? y : y - 399) / 400;
+	const unsigned yoe = unsigned(y - era * 400);
+	const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + int64_t(doe) - 719468;
+}
 
-	s = endptr;
+static_assert(DaysFromCivil(1970, 1, 1) == 0, "");
+static_assert(DaysFromCivil(2000, 3, 1) == 11017, "");
 
-	std::chrono::system_clock::duration result = std::chrono::hours(hours);
+struct CivilDate {
+	int64_t year;
+	unsigned month, day;
+};
 
-	if (*s == ':') {
-		++s;
-		const auto minutes = strtoul(s, &endptr, 10);
-		if (endptr != s + 2 || hours >= 60)
-			throw std::runtime_error("Failed to parse time zone offset");
+/**
+ * The inverse of DaysFromCivil().
+ */
+static constexpr CivilDate
+CivilFromDays(int64_t z) noexcept
+{
+	z += 719468;
+	const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+	const unsigned doe = unsigned(z - era * 146097);
+	const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	const unsigned mp = (5 * doy + 2) / 153;
+	const unsigned d = doy - (153 * mp + 2) / 5 + 1;
+	const unsigned m = mp < 10 ? mp + 3 : mp - 9;
+	return {int64_t(yoe) + era * 400 + (m <= 2), m, d};
+}
+
+static constexpr bool
+IsLeapYear(int64_t y) noexcept
+{
+	return y % 4 == 0 && (y % 100 != 0 || y % 400 == 0);
+}
+
+static constexpr unsigned
+DaysInMonth(int64_t y, unsigned m) noexcept
+{
+	return m == 2
+		? (IsLeapYear(y) ? 29 : 28)
+		: (m == 4 || m == 6 || m == 9 || m == 11 ? 30 : 31);
+}
+
+[[noreturn]]
+static void
+ThrowMalformed()
+{
+	throw std::runtime_error("Failed to parse PostgreSQL timestamp");
+}
+
+/**
+ * Parse exactly #n decimal digits.
+ */
+static unsigned
+ParseDigits(const char *&s, unsigned n)
+{
+	unsigned value = 0;
+	for (unsigned i = 0; i < n; ++i) {
+		if (!IsDigitASCII(s[i]))
+			ThrowMalformed();
+
+		value = value * 10 + (s[i] - '0');
+	}
+
+	s += n;
+	return value;
+}
+
+static void
+Expect(const char *&s, char ch)
+{
+	if (*s != ch)
+		ThrowMalformed();
+
+	++s;
+}
 
-		s = endptr;
+/**
+ * Parse the time zone offset after the sign: "HH[[:]MM[[:]SS]]".
+ */
+static std::chrono::seconds
+ParsePositiveTimezoneOffset(const char *&s)
+{
+	const unsigned hours = ParseDigits(s, 2);
+	unsigned minutes = 0, seconds = 0;
+
+	if (*s == ':')
+		++s;
+	if (IsDigitASCII(*s)) {
+		minutes = ParseDigits(s, 2);
 
-		result += std::chrono::minutes(minutes);
+		if (*s == ':')
+			++s;
+		if (IsDigitASCII(*s))
+			seconds = ParseDigits(s, 2);
 	}
 
-	return result;
+	if (hours >= 24 || minutes >= 60 || seconds >= 60)
+		throw std::runtime_error("Failed to parse time zone offset");
+
+	return std::chrono::hours(hours) + std::chrono::minutes(minutes) +
+		std::chrono::seconds(seconds);
 }
 
-std::chrono::system_clock::time_point
+time_point
 ParseTimestamp(const char *s)
 {
 	assert(s != nullptr);
 
-	struct tm tm;
-	const char *end = strptime(s, "%F %T", &tm);
-	if (end == nullptr)
-		throw std::runtime_error("Failed to parse PostgreSQL timestamp");
+	if (StringView(s).Equals("infinity"))
+		return time_point::max();
 
-	s = end;
+	if (StringView(s).Equals("-infinity"))
+		return time_point::min();
 
-	auto t = TimeGm(tm);
+	/* the year has at least 4 digits */
+	int64_t year = ParseDigits(s, 4);
+	while (IsDigitASCII(*s)) {
+		if (year >= 100000000)
+			ThrowMalformed();
 
-	if (*s == '.') {
-		/* parse fractional part */
-		char *endptr;
-		double fractional_s = strtod(s, &endptr);
-		if (endptr == s)
-			throw std::runtime_error("Failed to parse PostgreSQL timestamp");
+		year = year * 10 + (*s++ - '0');
+	}
 
-		assert(fractional_s >= 0);
-		assert(fractional_s < 1);
+	Expect(s, '-');
+	const unsigned month = ParseDigits(s, 2);
+	Expect(s, '-');
+	const unsigned day = ParseDigits(s, 2);
 
-		s = endptr;
+	if (*s != ' ' && *s != 'T')
+		ThrowMalformed();
+	++s;
 
-		const std::chrono::duration<double> f(fractional_s);
-		t += std::chrono::duration_cast<std::chrono::system_clock::duration>(f);
+	const unsigned hour = ParseDigits(s, 2);
+	Expect(s, ':');
+	const unsigned minute = ParseDigits(s, 2);
+	Expect(s, ':');
+	const unsigned second = ParseDigits(s, 2);
+
+	if (month < 1 || month > 12 || day < 1 ||
+	    day > DaysInMonth(year, month) ||
+	    hour > 24 || minute >= 60 || second >= 60 ||
+	    (hour == 24 && (minute > 0 || second > 0)))
+		ThrowMalformed();
+
+	const int64_t days = DaysFromCivil(year, month, day);
+	const int64_t seconds = ((days * 24 + hour) * 60 + minute) * 60
+		+ second;
+
+	constexpr int64_t max_seconds =
+		std::chrono::duration_cast<std::chrono::seconds>(duration::max()).count() - 86400;
+	if (seconds > max_seconds || seconds < -max_seconds)
+		throw std::runtime_error("PostgreSQL timestamp out of range");
+
+	duration t = std::chrono::seconds(seconds);
+
+	if (*s == '.') {
+		/* fractional part; digits beyond the resolution of
+		   nanoseconds are ignored */
+		++s;
+		if (!IsDigitASCII(*s))
+			ThrowMalformed();
+
+		unsigned ns = 0, scale = 1000000000;
+		for (; IsDigitASCII(*s); ++s) {
+			if (scale > 1) {
+				scale /= 10;
+				ns += (*s - '0') * scale;
+			}
+		}
+
+		t += std::chrono::duration_cast<duration>(std::chrono::nanoseconds(ns));
 	}
 
 	switch (*s) {
 	case '+':
-		t -= ParsePositiveTimezoneOffset(s + 1);
+		++s;
+		t -= ParsePositiveTimezoneOffset(s);
 		break;
 
 	case '-':
-		t += ParsePositiveTimezoneOffset(s + 1);
+		++s;
+		t += ParsePositiveTimezoneOffset(s);
+		break;
+
+	case 'Z':
+		++s;
 		break;
 	}
 
-	return t;
+	if (*s != 0)
+		ThrowMalformed();
+
+	return time_point(t);
 }
 
-static StringBuffer<64>
-FormatTimestamp(const struct tm &tm) noexcept
+static char *
+FormatDigits(char *p, unsigned value, unsigned n) noexcept
 {
+	for (unsigned i = n; i-- > 0;) {
+		p[i] = '0' + value % 10;
+		value /= 10;
+	}
+
+	return p + n;
+}
+
+StringBuffer<64>
+FormatTimestamp(time_point tp) noexcept
+{
+	const int64_t us =
+		std::chrono::duration_cast<std::chrono::microseconds>(tp.time_since_epoch()).count();
+
+	constexpr int64_t us_per_day = int64_t(86400) * 1000000;
+	int64_t days = us / us_per_day;
+	int64_t rest = us % us_per_day;
+	if (rest < 0) {
+		/* round towards negative infinity */
+		--days;
+		rest += us_per_day;
+	}
+
+	const auto date = CivilFromDays(days);
+	const unsigned seconds = rest / 1000000;
+	const unsigned fraction = rest % 1000000;
+
 	StringBuffer<64> buffer;
-	strftime(buffer.data(), buffer.capacity(), "%F %T", &tm);
+	char *p = buffer.data();
+
+	if (date.year >= 0 && date.year <= 9999) {
+		p = FormatDigits(p, date.year, 4);
+	} else {
+		/* outside of PostgreSQL's usual range; this is not
+		   expected to happen */
+		char digits[24];
+		char *q = digits + sizeof(digits);
+		uint64_t y = date.year < 0 ? -date.year : date.year;
+		do {
+			*--q = '0' + y % 10;
+			y /= 10;
+		} while (y > 0);
+
+		if (date.year < 0)
+			*p++ = '-';
+
+		const size_t n = digits + sizeof(digits) - q;
+		memcpy(p, q, n);
+		p += n;
+	}
+
+	*p++ = '-';
+	p = FormatDigits(p, date.month, 2);
+	*p++ = '-';
+	p = FormatDigits(p, date.day, 2);
+	*p++ = ' ';
+	p = FormatDigits(p, seconds / 3600, 2);
+	*p++ = ':';
+	p = FormatDigits(p, seconds / 60 % 60, 2);
+	*p++ = ':';
+	p = FormatDigits(p, seconds % 60, 2);
+
+	if (fraction > 0) {
+		/* like PostgreSQL, omit trailing zeroes */
+		*p++ = '.';
+		p = FormatDigits(p, fraction, 6);
+		while (p[-1] == '0')
+			--p;
+	}
+
+	*p = 0;
 	return buffer;
 }
 
-StringBuffer<64>
-FormatTimestamp(std::chrono::system_clock::time_point tp)
+time_point
+DecodeBinaryTimestamp(ConstBuffer<void> src)
 {
-	return FormatTimestamp(GmTime(tp));
+	if (src.size != sizeof(int64_t))
+		throw std::runtime_error("Wrong size of binary PostgreSQL timestamp");
+
+	uint64_t value;
+	memcpy(&value, src.data, sizeof(value));
+	return FromBinaryTimestamp(FromBE64(value));
 }
 
 }
@@ -32,20 +32,79 @@
 
 #pragma once
 
+#include "util/ConstBuffer.hxx"
+
 #include <chrono>
 
+#include <stdint.h>
+
 template<size_t> class StringBuffer;
 
 namespace Pg {
 
+/**
+ * Parse a timestamp in PostgreSQL's ISO output format
+ * ("YYYY-MM-DD HH:MM:SS[.fraction][+HH[:MM[:SS]]]"); without a time
+ * zone offset, UTC is assumed.  "infinity" and "-infinity" are
+ * mapped to time_point::max() and time_point::min().
+ *
+ * Throws std::runtime_error on error.
+ */
 std::chrono::system_clock::time_point
 ParseTimestamp(const char *s);
 
 /**
  * Format the given time_point as a PostgreSQL timestamp without time
- * zone.
+ * zone (in UTC).  Fractional seconds are appended (with microsecond
+ * precision) only if they are non-zero.
  */
 StringBuffer<64>
-FormatTimestamp(std::chrono::system_clock::time_point tp);
+FormatTimestamp(std::chrono::system_clock::time_point tp) noexcept;
+
+/**
+ * Convert a binary "timestamp" or "timestamptz" value (microseconds
+ * since 2000-01-01 00:00:00 UTC, in host byte order) to a
+ * time_point.  "infinity" and "-infinity" are mapped to
+ * time_point::max() and time_point::min().
+ */
+constexpr std::chrono::system_clock::time_point
+FromBinaryTimestamp(int64_t us) noexcept
+{
+	typedef std::chrono::system_clock::time_point time_point;
+
+	return us == INT64_MAX
+		? time_point::max()
+		: (us == INT64_MIN
+		   ? time_point::min()
+		   /* 946684800 = 2000-01-01 00:00:00 UTC */
+		   : time_point(std::chrono::duration_cast<time_point::duration>(std::chrono::seconds(946684800) +
+										 std::chrono::microseconds(us))));
+}
+
+/**
+ * The inverse of FromBinaryTimestamp(): convert a time_point to
+ * microseconds since 2000-01-01 00:00:00 UTC (in host byte order).
+ */
+constexpr int64_t
+ToBinaryTimestamp(std::chrono::system_clock::time_point tp) noexcept
+{
+	typedef std::chrono::system_clock::time_point time_point;
+
+	return tp == time_point::max()
+		? INT64_MAX
+		: (tp == time_point::min()
+		   ? INT64_MIN
+		   : std::chrono::duration_cast<std::chrono::microseconds>(tp.time_since_epoch()).count()
+		   /* 946684800 = 2000-01-01 00:00:00 UTC */
+		   - INT64_C(946684800000000));
+}
+
+/**
+ * Decode a "timestamp" or "timestamptz" value in the binary format.
+ *
+ * Throws std::runtime_error on error.
+ */
+std::chrono::system_clock::time_point
+DecodeBinaryTimestamp(ConstBuffer<void> src);
 
 }
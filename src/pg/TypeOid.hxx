@@ -0,0 +1,60 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <postgresql/postgres_ext.h>
+
+namespace Pg {
+
+/**
+ * Type OIDs from the server's catalog/pg_type_d.h, which is not part
+ * of libpq's public headers.
+ */
+namespace TypeOid {
+constexpr Oid BOOL = 16;
+constexpr Oid BYTEA = 17;
+constexpr Oid NAME = 19;
+constexpr Oid INT8 = 20;
+constexpr Oid INT2 = 21;
+constexpr Oid INT4 = 23;
+constexpr Oid TEXT = 25;
+constexpr Oid OID = 26;
+constexpr Oid FLOAT4 = 700;
+constexpr Oid FLOAT8 = 701;
+constexpr Oid BPCHAR = 1042;
+constexpr Oid VARCHAR = 1043;
+constexpr Oid TIMESTAMP = 1114;
+constexpr Oid TIMESTAMPTZ = 1184;
+}
+
+} /* namespace Pg */
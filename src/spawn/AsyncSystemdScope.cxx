@@ -0,0 +1,251 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AsyncSystemdScope.hxx"
+#include "Systemd.hxx"
+#include "odbus/Error.hxx"
+
+#include <stdexcept>
+
+#include <string.h>
+
+static constexpr char JOB_REMOVED_MATCH[] = "type='signal',"
+    "sender='org.freedesktop.systemd1',"
+    "interface='org.freedesktop.systemd1.Manager',"
+    "member='JobRemoved',"
+    "path='/org/freedesktop/systemd1'";
+
+static constexpr char UNIT_REMOVED_MATCH[] = "type='signal',"
+    "sender='org.freedesktop.systemd1',"
+    "interface='org.freedesktop.systemd1.Manager',"
+    "member='UnitRemoved',"
+    "path='/org/freedesktop/systemd1'";
+
+/**
+ * How long to wait for systemd to create the scope?
+ */
+static constexpr std::chrono::seconds START_TIMEOUT(30);
+
+/**
+ * How long to wait for a stale scope (of a crashed predecessor) to
+ * disappear?
+ */
+static constexpr std::chrono::seconds UNIT_REMOVED_TIMEOUT(2);
+
+AsyncSystemdScope::AsyncSystemdScope(EventLoop &event_loop,
+                                     const char *_name,
+                                     const char *description,
+                                     int pid, bool _delegate,
+                                     const char *slice,
+                                     SystemdScopeHandler &_handler)
+    :handler(_handler), name(_name), delegate(_delegate),
+     connection(ODBus::Connection::GetSystem()),
+     watch(event_loop, connection),
+     request(MakeStartTransientUnitMessage(_name, description, pid,
+                                           _delegate, slice)),
+     call(BIND_THIS_METHOD(OnReply)),
+     timeout_event(event_loop, BIND_THIS_METHOD(OnTimeout)),
+     complete_event(event_loop, BIND_THIS_METHOD(OnComplete))
+{
+    /* without a DBusError, dbus_bus_add_match() does not wait for
+       the reply */
+    dbus_bus_add_match(connection, JOB_REMOVED_MATCH, nullptr);
+    dbus_bus_add_match(connection, UNIT_REMOVED_MATCH, nullptr);
+
+    if (!dbus_connection_add_filter(connection, HandleMessage,
+                                    this, nullptr))
+        throw std::runtime_error("dbus_connection_add_filter() failed");
+
+    SendRequest();
+
+    /* connecting to the bus may have queued messages already */
+    watch.ScheduleDispatch();
+}
+
+AsyncSystemdScope::~AsyncSystemdScope()
+{
+    dbus_connection_remove_filter(connection, HandleMessage, this);
+
+    dbus_bus_remove_match(connection, UNIT_REMOVED_MATCH, nullptr);
+    dbus_bus_remove_match(connection, JOB_REMOVED_MATCH, nullptr);
+    dbus_connection_flush(connection);
+}
+
+void
+AsyncSystemdScope::SendRequest()
+{
+    /* the WatchManager writes the message (without blocking) and
+       dispatches the reply */
+    call.Send(connection, request.Get());
+
+    state = State::START;
+    timeout_event.Schedule(START_TIMEOUT);
+}
+
+void
+AsyncSystemdScope::Finish(CgroupState &&_result)
+{
+    state = State::DONE;
+    timeout_event.Cancel();
+    result = std::move(_result);
+    complete_event.Schedule();
+}
+
+void
+AsyncSystemdScope::Fail(std::exception_ptr e)
+{
+    state = State::DONE;
+    timeout_event.Cancel();
+    failure = std::move(e);
+    complete_event.Schedule();
+}
+
+void
+AsyncSystemdScope::OnReply(ODBus::Message &&reply)
+{
+    /* if the scope already exists, it may be because the previous
+       instance crashed and its spawner process was not yet cleaned
+       up by systemd; wait for the UnitRemoved signal, and then try
+       again (see CreateSystemdScope()) */
+    if (!retried && reply.GetType() == DBUS_MESSAGE_TYPE_ERROR &&
+        strcmp(reply.GetErrorName(),
+               "org.freedesktop.systemd1.UnitExists") == 0) {
+        retried = true;
+        state = State::WAIT_UNIT_REMOVED;
+        timeout_event.Schedule(UNIT_REMOVED_TIMEOUT);
+        return;
+    }
+
+    try {
+        reply.CheckThrowError();
+
+        ODBus::Error error;
+        const char *object_path;
+        if (!reply.GetArgs(error, DBUS_TYPE_OBJECT_PATH, &object_path))
+            error.Throw("StartTransientUnit reply failed");
+
+        job_path = object_path;
+    } catch (...) {
+        Fail(std::current_exception());
+        return;
+    }
+
+    state = State::WAIT_JOB_REMOVED;
+}
+
+inline void
+AsyncSystemdScope::OnJobRemoved(DBusMessage &msg)
+{
+    ODBus::Error error;
+    dbus_uint32_t job_id;
+    const char *removed_object_path, *unit_name, *result_string;
+    if (!dbus_message_get_args(&msg, error,
+                               DBUS_TYPE_UINT32, &job_id,
+                               DBUS_TYPE_OBJECT_PATH, &removed_object_path,
+                               DBUS_TYPE_STRING, &unit_name,
+                               DBUS_TYPE_STRING, &result_string,
+                               DBUS_TYPE_INVALID))
+        return;
+
+    if (job_path == removed_object_path)
+        Finish(delegate
+               ? LoadSystemdCgroupState(0)
+               : CgroupState());
+}
+
+inline void
+AsyncSystemdScope::OnUnitRemoved(DBusMessage &msg)
+{
+    ODBus::Error error;
+    const char *unit_name, *object_path;
+    if (!dbus_message_get_args(&msg, error,
+                               DBUS_TYPE_STRING, &unit_name,
+                               DBUS_TYPE_OBJECT_PATH, &object_path,
+                               DBUS_TYPE_INVALID))
+        return;
+
+    if (name != unit_name)
+        return;
+
+    /* send the StartTransientUnit message again and hope it
+       succeeds this time */
+    try {
+        SendRequest();
+    } catch (...) {
+        Fail(std::current_exception());
+    }
+}
+
+void
+AsyncSystemdScope::OnTimeout()
+{
+    switch (state) {
+    case State::START:
+    case State::WAIT_JOB_REMOVED:
+        Fail(std::make_exception_ptr(std::runtime_error("Timeout waiting for systemd")));
+        break;
+
+    case State::WAIT_UNIT_REMOVED:
+        Fail(std::make_exception_ptr(std::runtime_error("systemd scope exists already")));
+        break;
+
+    case State::DONE:
+        break;
+    }
+}
+
+void
+AsyncSystemdScope::OnComplete()
+{
+    if (failure)
+        handler.OnSystemdScopeError(std::move(failure));
+    else
+        handler.OnSystemdScopeReady(std::move(result));
+}
+
+DBusHandlerResult
+AsyncSystemdScope::HandleMessage(DBusConnection *, DBusMessage *msg,
+                                 void *data)
+{
+    auto &scope = *(AsyncSystemdScope *)data;
+
+    if (scope.state == State::WAIT_JOB_REMOVED &&
+        dbus_message_is_signal(msg, "org.freedesktop.systemd1.Manager",
+                               "JobRemoved"))
+        scope.OnJobRemoved(*msg);
+    else if (scope.state == State::WAIT_UNIT_REMOVED &&
+             dbus_message_is_signal(msg, "org.freedesktop.systemd1.Manager",
+                                    "UnitRemoved"))
+        scope.OnUnitRemoved(*msg);
+
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BENG_PROXY_SPAWN_ASYNC_SYSTEMD_SCOPE_HXX
+#define BENG_PROXY_SPAWN_ASYNC_SYSTEMD_SCOPE_HXX
+
+#include "CgroupState.hxx"
+#include "odbus/Connection.hxx"
+#include "odbus/Watch.hxx"
+#include "odbus/Message.hxx"
+#include "odbus/AsyncCall.hxx"
+#include "event/CoarseTimerEvent.hxx"
+#include "event/DeferEvent.hxx"
+
+#include <string>
+#include <exception>
+
+class SystemdScopeHandler {
+public:
+    /**
+     * The scope has been created, and the calling process has been
+     * moved into it.
+     *
+     * @param state the new cgroup membership (empty if delegation
+     * was not requested)
+     */
+    virtual void OnSystemdScopeReady(CgroupState &&state) = 0;
+
+    virtual void OnSystemdScopeError(std::exception_ptr e) = 0;
+};
+
+/**
+ * Create a new systemd scope like CreateSystemdScope(), but without
+ * blocking: the D-Bus connection is integrated into the #EventLoop,
+ * and the #SystemdScopeHandler is invoked when systemd has finished
+ * the job.  Only connecting to the bus is still synchronous.
+ *
+ * The handler is invoked from a #DeferEvent, i.e. outside of libdbus
+ * callbacks, and it may destroy this object.
+ */
+class AsyncSystemdScope {
+    SystemdScopeHandler &handler;
+
+    const std::string name;
+
+    const bool delegate;
+
+    ODBus::Connection connection;
+    ODBus::WatchManager watch;
+
+    ODBus::Message request;
+    ODBus::AsyncCall call;
+
+    /**
+     * The object path of the job returned by StartTransientUnit.
+     */
+    std::string job_path;
+
+    enum class State {
+        /**
+         * Waiting for the StartTransientUnit reply.
+         */
+        START,
+
+        /**
+         * The scope existed already; waiting for the UnitRemoved
+         * signal before trying again.
+         */
+        WAIT_UNIT_REMOVED,
+
+        /**
+         * Waiting for the JobRemoved signal.
+         */
+        WAIT_JOB_REMOVED,
+
+        DONE,
+    } state = State::START;
+
+    /**
+     * The "UnitExists" error is retried only once.
+     */
+    bool retried = false;
+
+    CoarseTimerEvent timeout_event;
+
+    /**
+     * Invokes the #handler after #state has become State::DONE.
+     */
+    DeferEvent complete_event;
+
+    CgroupState result;
+    std::exception_ptr failure;
+
+public:
+    /**
+     * Throws on error.
+     *
+     * @param slice create the new scope in this slice (optional)
+     */
+    AsyncSystemdScope(EventLoop &event_loop,
+                      const char *name, const char *description,
+                      int pid, bool delegate, const char *slice,
+                      SystemdScopeHandler &_handler);
+
+    ~AsyncSystemdScope();
+
+    AsyncSystemdScope(const AsyncSystemdScope &) = delete;
+    AsyncSystemdScope &operator=(const AsyncSystemdScope &) = delete;
+
+private:
+    void SendRequest();
+
+    void Finish(CgroupState &&state);
+    void Fail(std::exception_ptr e);
+
+    void OnReply(ODBus::Message &&reply);
+    void OnJobRemoved(DBusMessage &msg);
+    void OnUnitRemoved(DBusMessage &msg);
+
+    void OnTimeout();
+    void OnComplete();
+
+    static DBusHandlerResult HandleMessage(DBusConnection *connection,
+                                           DBusMessage *msg, void *data);
+};
+
+#endif
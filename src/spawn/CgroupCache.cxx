@@ -0,0 +1,172 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CgroupCache.hxx"
+#include "CgroupOptions.hxx"
+#include "CgroupState.hxx"
+#include "system/Error.hxx"
+#include "util/RuntimeError.hxx"
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+FileDescriptor
+CgroupCache::Group::FindDirectory(const std::string &mount) const
+{
+    for (const auto &i : mounts)
+        if (i.name == mount)
+            return i.directory.ToFileDescriptor();
+
+    return FileDescriptor::Undefined();
+}
+
+static UniqueFileDescriptor
+MakeGroupDirectory(const char *path)
+{
+    if (mkdir(path, 0777) < 0) {
+        switch (errno) {
+        case EEXIST:
+            break;
+
+        default:
+            throw FormatErrno("mkdir('%s') failed", path);
+        }
+    }
+
+    UniqueFileDescriptor fd;
+    if (!fd.Open(path, O_DIRECTORY|O_RDONLY))
+        throw FormatErrno("Failed to open '%s'", path);
+
+    return fd;
+}
+
+CgroupCache::Group &
+CgroupCache::MakeGroup(const char *name)
+{
+    auto i = groups.find(name);
+    if (i != groups.end())
+        return i->second;
+
+    Group group;
+
+    for (const auto &mount_point : state.mounts) {
+        char path[PATH_MAX];
+        if (snprintf(path, sizeof(path), "/sys/fs/cgroup/%s%s/%s",
+                     mount_point.c_str(), state.group_path.c_str(),
+                     name) >= (int)sizeof(path))
+            throw std::runtime_error("Path is too long");
+
+        auto directory = MakeGroupDirectory(path);
+
+        UniqueFileDescriptor procs;
+        if (!procs.Open(directory.ToFileDescriptor(), "cgroup.procs", O_WRONLY))
+            throw FormatErrno("Failed to open '%s/cgroup.procs'", path);
+
+        group.procs.emplace_back(std::move(procs));
+        group.mounts.emplace_back(Mount{mount_point, std::move(directory)});
+    }
+
+    return groups.emplace(name, std::move(group)).first->second;
+}
+
+void
+CgroupCache::ApplySettings(const Group &group, const CgroupOptions &options)
+{
+    for (const auto *set = options.set_head; set != nullptr; set = set->next) {
+        const char *dot = strchr(set->name, '.');
+        assert(dot != nullptr);
+
+        const std::string controller(set->name, dot);
+        auto i = state.controllers.find(controller);
+        if (i == state.controllers.end())
+            throw FormatRuntimeError("cgroup controller '%s' is unavailable",
+                                     controller.c_str());
+
+        const FileDescriptor directory = group.FindDirectory(i->second);
+        assert(directory.IsDefined());
+
+        UniqueFileDescriptor fd;
+        if (!fd.Open(directory, set->name, O_WRONLY))
+            throw FormatErrno("Failed to open '%s'", set->name);
+
+        const size_t length = strlen(set->value);
+        if (fd.Write(set->value, length) != ssize_t(length))
+            throw FormatErrno("write('%s') failed", set->name);
+    }
+}
+
+const std::vector<UniqueFileDescriptor> *
+CgroupCache::Prepare(const CgroupOptions &options)
+{
+    if (!options.IsDefined())
+        return nullptr;
+
+    if (!state.IsEnabled())
+        throw std::runtime_error("Control groups are disabled");
+
+    std::string settings;
+    for (const auto *set = options.set_head; set != nullptr; set = set->next) {
+        settings += set->name;
+        settings += '=';
+        settings += set->value;
+        settings += ';';
+    }
+
+    auto &group = MakeGroup(options.name);
+
+    if (group.settings != settings) {
+        /* clear first, so a partial failure causes a retry next
+           time */
+        group.settings.clear();
+        ApplySettings(group, options);
+        group.settings = std::move(settings);
+    }
+
+    return &group.procs;
+}
+
+bool
+MoveToPreparedCgroup(const std::vector<UniqueFileDescriptor> &procs)
+{
+    for (const auto &i : procs) {
+        FileDescriptor fd = i.ToFileDescriptor();
+        if (fd.Write("0", 1) != 1)
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BENG_PROXY_SPAWN_CGROUP_CACHE_HXX
+#define BENG_PROXY_SPAWN_CGROUP_CACHE_HXX
+
+#include "io/UniqueFileDescriptor.hxx"
+
+#include <string>
+#include <vector>
+#include <map>
+
+struct CgroupOptions;
+struct CgroupState;
+
+/**
+ * Prepares control groups in the spawner, moving the expensive parts
+ * of CgroupOptions::Apply() out of the child process.  Each group is
+ * created only once, and its settings are only written when they
+ * differ from the ones applied last time; all writes go through
+ * directory file descriptors which are kept open.  The child process
+ * only needs to write to the "cgroup.procs" files which were opened
+ * here (see MoveToPreparedCgroup()).
+ */
+class CgroupCache {
+    const CgroupState &state;
+
+    struct Mount {
+        /**
+         * The controller mount point name (see CgroupState::mounts).
+         */
+        std::string name;
+
+        /**
+         * The group directory below this mount point.
+         */
+        UniqueFileDescriptor directory;
+    };
+
+    struct Group {
+        std::vector<Mount> mounts;
+
+        /**
+         * The "cgroup.procs" files, one for each of #mounts.
+         */
+        std::vector<UniqueFileDescriptor> procs;
+
+        /**
+         * Describes the settings which have been written last;
+         * empty if none were written yet.
+         */
+        std::string settings;
+
+        FileDescriptor FindDirectory(const std::string &mount) const;
+    };
+
+    /**
+     * Key is CgroupOptions::name.
+     */
+    std::map<std::string, Group> groups;
+
+public:
+    explicit CgroupCache(const CgroupState &_state)
+        :state(_state) {}
+
+    CgroupCache(const CgroupCache &) = delete;
+    CgroupCache &operator=(const CgroupCache &) = delete;
+
+    /**
+     * Create and configure the group described by the given
+     * options.
+     *
+     * Throws std::runtime_error on error.
+     *
+     * @return the "cgroup.procs" file descriptors to be passed to
+     * MoveToPreparedCgroup(), owned by this object, or nullptr if
+     * no control group was configured
+     */
+    const std::vector<UniqueFileDescriptor> *
+    Prepare(const CgroupOptions &options);
+
+    void Clear() {
+        groups.clear();
+    }
+
+private:
+    Group &MakeGroup(const char *name);
+    void ApplySettings(const Group &group, const CgroupOptions &options);
+};
+
+/**
+ * Move the current process into a group prepared by
+ * CgroupCache::Prepare().
+ *
+ * @return false on error (errno set); the group may have been
+ * removed meanwhile, and the caller should fall back to
+ * CgroupOptions::Apply()
+ */
+bool
+MoveToPreparedCgroup(const std::vector<UniqueFileDescriptor> &procs);
+
+#endif
@@ -35,6 +35,7 @@
 #include "Config.hxx"
 #include "AllocatorPtr.hxx"
 #include "system/Error.hxx"
+#include "system/ProcessQos.hxx"
 #include "io/WriteFile.hxx"
 #include "util/StringView.hxx"
 #include "util/RuntimeError.hxx"
@@ -75,6 +76,22 @@ CgroupOptions::Set(AllocatorPtr alloc, StringView _name, StringView _value)
     set_head = new_set;
 }
 
+void
+CgroupOptions::SetQos(AllocatorPtr alloc, const ProcessQos &qos)
+{
+    char buffer[16];
+
+    if (qos.cpu_weight != 0) {
+        snprintf(buffer, sizeof(buffer), "%u", qos.cpu_weight);
+        Set(alloc, "cpu.weight", buffer);
+    }
+
+    if (qos.io_weight != 0) {
+        snprintf(buffer, sizeof(buffer), "%u", qos.io_weight);
+        Set(alloc, "io.weight", buffer);
+    }
+}
+
 static void
 WriteFile(const char *path, const char *data)
 {
@@ -38,6 +38,7 @@
 class AllocatorPtr;
 struct StringView;
 struct CgroupState;
+struct ProcessQos;
 
 struct CgroupOptions {
     const char *name = nullptr;
@@ -62,6 +63,13 @@ struct CgroupOptions {
 
     void Set(AllocatorPtr alloc, StringView name, StringView value);
 
+    /**
+     * Add "cpu.weight" and "io.weight" settings for the cgroup2
+     * weights of the given #ProcessQos (if specified).  The
+     * scheduler policy and I/O class are not handled here.
+     */
+    void SetQos(AllocatorPtr alloc, const ProcessQos &qos);
+
     /**
      * Throws std::runtime_error on error.
      */
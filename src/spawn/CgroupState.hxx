@@ -33,9 +33,10 @@
 #ifndef BENG_PROXY_CGROUP_STATE_HXX
 #define BENG_PROXY_CGROUP_STATE_HXX
 
+#include "util/FlatMap.hxx"
+
 #include <forward_list>
 #include <string>
-#include <map>
 
 struct CgroupState {
     /**
@@ -54,7 +55,7 @@ struct CgroupState {
      * A mapping from controller name to mount point name.  More than
      * one controller may be mounted at one mount point.
      */
-    std::map<std::string, std::string> controllers;
+    FlatMap<std::string, std::string> controllers;
 
     bool IsEnabled() const {
         return !group_path.empty();
@@ -76,7 +76,11 @@ ChildOptions::ChildOptions(AllocatorPtr alloc,
      forbid_user_ns(src.forbid_user_ns),
      forbid_multicast(src.forbid_multicast),
      forbid_bind(src.forbid_bind),
-     no_new_privs(src.no_new_privs)
+     no_new_privs(src.no_new_privs),
+     deferred_expandable(src.deferred_expandable),
+     deferred(src.IsDeferred()
+              ? alloc.Dup(src.deferred)
+              : ConstBuffer<void>(nullptr))
 {
 }
 
@@ -94,7 +98,7 @@ ChildOptions::Check() const
 bool
 ChildOptions::IsExpandable() const
 {
-    return expand_stderr_path != nullptr ||
+    return deferred_expandable || expand_stderr_path != nullptr ||
         env.IsExpandable() ||
         ns.IsExpandable() ||
         (jail != nullptr && jail->IsExpandable());
@@ -103,6 +107,8 @@ ChildOptions::IsExpandable() const
 void
 ChildOptions::Expand(AllocatorPtr alloc, const MatchInfo &match_info)
 {
+    assert(!IsDeferred());
+
     if (expand_stderr_path != nullptr)
         stderr_path = expand_string_unescaped(alloc, expand_stderr_path,
                                               match_info);
@@ -119,6 +125,8 @@ ChildOptions::Expand(AllocatorPtr alloc, const MatchInfo &match_info)
 char *
 ChildOptions::MakeId(char *p) const
 {
+    assert(!IsDeferred());
+
     if (umask >= 0)
         p += sprintf(p, ";u%o", umask);
 
@@ -192,6 +200,8 @@ ChildOptions::CopyTo(PreparedChildProcess &dest
 #endif
                      ) const
 {
+    assert(!IsDeferred());
+
 #if TRANSLATION_ENABLE_JAILCGI
     if (use_jail && jail != nullptr)
         jail->InsertWrapper(dest, document_root);
@@ -40,6 +40,7 @@
 #include "NamespaceOptions.hxx"
 #include "UidGid.hxx"
 #include "util/ShallowCopy.hxx"
+#include "util/ConstBuffer.hxx"
 
 struct ResourceLimits;
 struct JailParams;
@@ -107,6 +108,19 @@ struct ChildOptions {
 
     bool no_new_privs = false;
 
+    /**
+     * Does #deferred contain EXPAND_* packets?
+     */
+    bool deferred_expandable = false;
+
+    /**
+     * Translation packets which have not been parsed yet, see
+     * TranslateParser::SetDeferChildOptions().  The attributes
+     * above are incomplete until
+     * TranslateParser::MaterializeChildOptions() has been called.
+     */
+    ConstBuffer<void> deferred = nullptr;
+
     ChildOptions() = default;
 
     constexpr ChildOptions(ShallowCopy shallow_copy, const ChildOptions &src)
@@ -128,13 +142,19 @@ struct ChildOptions {
          forbid_user_ns(src.forbid_user_ns),
          forbid_multicast(src.forbid_multicast),
          forbid_bind(src.forbid_bind),
-         no_new_privs(src.no_new_privs) {}
+         no_new_privs(src.no_new_privs),
+         deferred_expandable(src.deferred_expandable),
+         deferred(src.deferred) {}
 
     ChildOptions(AllocatorPtr alloc, const ChildOptions &src);
 
     ChildOptions(ChildOptions &&) = default;
     ChildOptions &operator=(ChildOptions &&) = default;
 
+    bool IsDeferred() const {
+        return !deferred.IsNull();
+    }
+
     /**
      * Throws std::runtime_error on error.
      */
@@ -42,6 +42,7 @@
 #include "util/ScopeExit.hxx"
 
 #include <array>
+#include <algorithm>
 
 #include <assert.h>
 #include <errno.h>
@@ -49,8 +50,30 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/wait.h>
+
+SpawnServerClient::PendingRequest::PendingRequest(int _pid,
+                                                  ConstBuffer<void> _payload,
+                                                  ConstBuffer<int> _fds)
+    :pid(_pid),
+     payload((const uint8_t *)_payload.data,
+             (const uint8_t *)_payload.data + _payload.size)
+{
+    for (int i : _fds)
+        fds.push_back(i);
+}
+
+void
+SpawnServerClient::PendingRequest::CloseFds()
+{
+    /* the same file descriptor may be listed more than once (e.g.
+       stdin and stdout of a TTY) */
+    for (auto i = fds.begin(); i != fds.end(); ++i)
+        if (std::find(fds.begin(), i, *i) == i)
+            close(*i);
 
-static constexpr size_t MAX_FDS = 8;
+    fds.clear();
+}
 
 SpawnServerClient::SpawnServerClient(EventLoop &event_loop,
                                      const SpawnConfig &_config, int _fd,
@@ -58,6 +81,7 @@ SpawnServerClient::SpawnServerClient(EventLoop &event_loop,
     :config(_config), fd(_fd),
      read_event(event_loop, fd, SocketEvent::READ|SocketEvent::PERSIST,
                 BIND_THIS_METHOD(OnSocketEvent)),
+     flush_event(event_loop, BIND_THIS_METHOD(Flush)),
      verify(_verify)
 {
     read_event.Add();
@@ -92,9 +116,13 @@ SpawnServerClient::Close()
 {
     assert(fd >= 0);
 
+    ClearQueue();
+
     read_event.Delete();
     close(fd);
     fd = -1;
+
+    stats = SpawnStatsMapping();
 }
 
 void
@@ -103,7 +131,9 @@ SpawnServerClient::Shutdown()
     shutting_down = true;
 
     if (processes.empty() && fd >= 0)
-        Close();
+        /* send the remaining requests; this closes the socket
+           afterwards */
+        Flush();
 }
 
 void
@@ -121,10 +151,126 @@ SpawnServerClient::Send(ConstBuffer<void> payload, ConstBuffer<int> fds)
     ::Send<MAX_FDS>(fd, payload, fds);
 }
 
-inline void
-SpawnServerClient::Send(const SpawnSerializer &s)
+void
+SpawnServerClient::Enqueue(int pid, const SpawnSerializer &s)
+{
+    queue.emplace_back(pid, s.GetPayload(), s.GetFds());
+    flush_event.Schedule();
+}
+
+void
+SpawnServerClient::ClearQueue()
 {
-    ::Send<MAX_FDS>(fd, s);
+    flush_event.Cancel();
+
+    for (auto &r : queue)
+        r.CloseFds();
+    queue.clear();
+
+    if (fd >= 0 && read_event.IsPending(SocketEvent::WRITE)) {
+        read_event.Delete();
+        read_event.Set(fd, SocketEvent::READ|SocketEvent::PERSIST);
+        read_event.Add();
+    }
+}
+
+void
+SpawnServerClient::OnSendError(PendingRequest &r, int error)
+{
+    fprintf(stderr, "failed to send to spawner: %s\n", strerror(error));
+
+    r.CloseFds();
+
+    if (r.pid == 0)
+        return;
+
+    auto i = processes.find(r.pid);
+    if (i == processes.end())
+        return;
+
+    auto *listener = i->second.listener;
+    processes.erase(i);
+
+    /* report this like a failed execve() on the server */
+    if (listener != nullptr)
+        listener->OnChildProcessExit(W_EXITCODE(0xff, 0));
+}
+
+void
+SpawnServerClient::Flush()
+{
+    constexpr size_t N = 64;
+    std::array<struct iovec, N> iovs;
+    std::array<struct mmsghdr, N> msgs;
+    std::array<char[CMSG_SPACE(MAX_FDS * sizeof(int))], N> cmsgs;
+
+    while (!queue.empty() && fd >= 0) {
+        const size_t n = std::min(queue.size(), N);
+
+        for (size_t i = 0; i < n; ++i) {
+            auto &r = queue[i];
+
+            auto &iov = iovs[i];
+            iov.iov_base = &r.payload.front();
+            iov.iov_len = r.payload.size();
+
+            auto &msg = msgs[i].msg_hdr;
+            msg.msg_name = nullptr;
+            msg.msg_namelen = 0;
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = nullptr;
+            msg.msg_controllen = 0;
+            msg.msg_flags = 0;
+
+            if (!r.fds.empty()) {
+                const size_t fds_size = r.fds.size() * sizeof(int);
+                msg.msg_control = cmsgs[i];
+                msg.msg_controllen = CMSG_SPACE(fds_size);
+
+                struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type = SCM_RIGHTS;
+                cmsg->cmsg_len = CMSG_LEN(fds_size);
+                memcpy(CMSG_DATA(cmsg), &r.fds.front(), fds_size);
+            }
+        }
+
+        int result = sendmmsg(fd, &msgs.front(), n, MSG_NOSIGNAL);
+        if (result < 0) {
+            const int e = errno;
+            if (e == EAGAIN) {
+                /* the server is busy; continue when the socket
+                   becomes writable */
+                read_event.Delete();
+                read_event.Set(fd, SocketEvent::READ|SocketEvent::WRITE|
+                               SocketEvent::PERSIST);
+                read_event.Add();
+                return;
+            }
+
+            /* the first request has failed; drop it and
+               continue with the next one */
+            auto r = std::move(queue.front());
+            queue.pop_front();
+            OnSendError(r, e);
+            continue;
+        }
+
+        for (int i = 0; i < result; ++i) {
+            queue.front().CloseFds();
+            queue.pop_front();
+        }
+    }
+
+    if (read_event.IsPending(SocketEvent::WRITE)) {
+        read_event.Delete();
+        read_event.Set(fd, SocketEvent::READ|SocketEvent::PERSIST);
+        read_event.Add();
+    }
+
+    if (shutting_down && processes.empty() && fd >= 0)
+        Close();
 }
 
 int
@@ -338,11 +484,9 @@ SpawnServerClient::SpawnChildProcess(const char *name,
         throw std::runtime_error("Spawn payload is too large");
     }
 
-    try {
-        Send(s.GetPayload(), s.GetFds());
-    } catch (const std::runtime_error &e) {
-        std::throw_with_nested(std::runtime_error("Spawn server failed"));
-    }
+    /* the file descriptors are now owned by the queue */
+    Enqueue(pid, s);
+    p.stdin_fd = p.stdout_fd = p.stderr_fd = p.control_fd = -1;
 
     processes.emplace(std::piecewise_construct,
                       std::forward_as_tuple(pid),
@@ -374,15 +518,7 @@ SpawnServerClient::KillChildProcess(int pid, int signo)
     s.WriteInt(pid);
     s.WriteInt(signo);
 
-    try {
-        Send(s.GetPayload(), s.GetFds());
-    } catch (const std::runtime_error &e) {
-        fprintf(stderr, "failed to send KILL(%d) to spawner: %s\n",
-                pid,e.what());
-    }
-
-    if (shutting_down && processes.empty())
-        Close();
+    Enqueue(0, s);
 }
 
 inline void
@@ -391,6 +527,13 @@ SpawnServerClient::HandleExitMessage(SpawnPayload payload)
     int pid, status;
     payload.ReadInt(pid);
     payload.ReadInt(status);
+
+    /* the resource usage is optional */
+    ChildResourceUsage usage;
+    const bool have_usage = !payload.IsEmpty();
+    if (have_usage)
+        payload.ReadT(usage);
+
     if (!payload.IsEmpty())
         throw MalformedSpawnPayloadError();
 
@@ -401,15 +544,36 @@ SpawnServerClient::HandleExitMessage(SpawnPayload payload)
     auto *listener = i->second.listener;
     processes.erase(i);
 
-    if (listener != nullptr)
+    if (listener != nullptr) {
+        if (have_usage)
+            listener->OnChildProcessResourceUsage(usage);
         listener->OnChildProcessExit(status);
+    }
 
     if (shutting_down && processes.empty())
-        Close();
+        /* send pending KILL requests before closing the socket */
+        Flush();
 }
 
 inline void
-SpawnServerClient::HandleMessage(ConstBuffer<uint8_t> payload)
+SpawnServerClient::HandleStatsMessage(const struct msghdr &msg)
+{
+    const struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET ||
+        cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(int)))
+        return;
+
+    int stats_fd;
+    memcpy(&stats_fd, CMSG_DATA(cmsg), sizeof(stats_fd));
+
+    stats = SpawnStatsMapping(FileDescriptor(stats_fd));
+    close(stats_fd);
+}
+
+inline void
+SpawnServerClient::HandleMessage(const struct msghdr &msg,
+                                 ConstBuffer<uint8_t> payload)
 {
     const auto cmd = (SpawnResponseCommand)payload.shift();
 
@@ -421,14 +585,19 @@ SpawnServerClient::HandleMessage(ConstBuffer<uint8_t> payload)
     case SpawnResponseCommand::EXIT:
         HandleExitMessage(SpawnPayload(payload));
         break;
+
+    case SpawnResponseCommand::STATS:
+        HandleStatsMessage(msg);
+        break;
     }
 }
 
 inline void
-SpawnServerClient::OnSocketEvent(unsigned)
+SpawnServerClient::ReceiveMessages()
 {
     constexpr size_t N = 64;
-    std::array<uint8_t[16], N> payloads;
+    std::array<uint8_t[64], N> payloads;
+    std::array<char[CMSG_SPACE(sizeof(int))], N> ccmsgs;
     std::array<struct iovec, N> iovs;
     std::array<struct mmsghdr, N> msgs;
 
@@ -442,8 +611,9 @@ SpawnServerClient::OnSocketEvent(unsigned)
         msg.msg_namelen = 0;
         msg.msg_iov = &iov;
         msg.msg_iovlen = 1;
-        msg.msg_control = nullptr;
-        msg.msg_controllen = 0;
+        msg.msg_control = ccmsgs[i];
+        msg.msg_controllen = sizeof(ccmsgs[i]);
+        msg.msg_flags = 0;
     }
 
     int n = recvmmsg(fd, &msgs.front(), msgs.size(),
@@ -468,6 +638,16 @@ SpawnServerClient::OnSocketEvent(unsigned)
             return;
         }
 
-        HandleMessage({payloads[i], msgs[i].msg_len});
+        HandleMessage(msgs[i].msg_hdr, {payloads[i], msgs[i].msg_len});
     }
 }
+
+inline void
+SpawnServerClient::OnSocketEvent(unsigned events)
+{
+    if (events & SocketEvent::WRITE)
+        Flush();
+
+    if ((events & SocketEvent::READ) && fd >= 0)
+        ReceiveMessages();
+}
@@ -35,9 +35,16 @@
 
 #include "Interface.hxx"
 #include "Config.hxx"
+#include "Stats.hxx"
 #include "event/SocketEvent.hxx"
+#include "event/DeferEvent.hxx"
+#include "util/StaticArray.hxx"
 
 #include <map>
+#include <deque>
+#include <vector>
+
+#include <stdint.h>
 
 template<typename T> struct ConstBuffer;
 struct PreparedChildProcess;
@@ -45,6 +52,8 @@ class SpawnPayload;
 class SpawnSerializer;
 
 class SpawnServerClient final : public SpawnService {
+    static constexpr size_t MAX_FDS = 8;
+
     struct ChildProcess {
         ExitListener *listener;
 
@@ -62,6 +71,35 @@ class SpawnServerClient final : public SpawnService {
 
     SocketEvent read_event;
 
+    /**
+     * A request which has been serialized, but has not been sent
+     * yet.  It owns the file descriptors.
+     */
+    struct PendingRequest {
+        /**
+         * The pid of an EXEC request, or 0.
+         */
+        int pid;
+
+        std::vector<uint8_t> payload;
+
+        StaticArray<int, MAX_FDS> fds;
+
+        PendingRequest(int _pid, ConstBuffer<void> _payload,
+                       ConstBuffer<int> _fds);
+
+        void CloseFds();
+    };
+
+    /**
+     * Requests are collected here and sent with one sendmmsg()
+     * call by #flush_event at the end of the current #EventLoop
+     * iteration.
+     */
+    std::deque<PendingRequest> queue;
+
+    DeferEvent flush_event;
+
     /**
      * Call UidGid::Verify() before sending the spawn request to the
      * server?
@@ -72,6 +110,11 @@ class SpawnServerClient final : public SpawnService {
 
     bool shutting_down = false;
 
+    /**
+     * Received with SpawnResponseCommand::STATS.
+     */
+    SpawnStatsMapping stats;
+
 public:
     explicit SpawnServerClient(EventLoop &event_loop,
                                const SpawnConfig &_config, int _fd,
@@ -90,6 +133,20 @@ public:
         return cgroups;
     }
 
+    /**
+     * Obtain the spawner's live counters, which may be used to
+     * throttle before the spawner gets overloaded.  They are
+     * available after receiving the SpawnResponseCommand::STATS
+     * packet, which the spawner sends right after accepting a
+     * connection.  Note that with SpawnConfig::n_workers>1, each
+     * connection sees only the counters of the worker serving it.
+     *
+     * @return the counters or nullptr if none were received
+     */
+    const SpawnStats *GetStats() const {
+        return stats.Get();
+    }
+
     void ReplaceSocket(int new_fd);
 
     void Shutdown();
@@ -116,10 +173,36 @@ private:
     void CheckOrAbort();
 
     void Send(ConstBuffer<void> payload, ConstBuffer<int> fds);
-    void Send(const SpawnSerializer &s);
+
+    /**
+     * Append a request to the #queue and schedule the
+     * #flush_event.  The file descriptors are owned by the #queue
+     * from now on.
+     */
+    void Enqueue(int pid, const SpawnSerializer &s);
+
+    /**
+     * Send as many requests from the #queue as possible.
+     */
+    void Flush();
+
+    /**
+     * Discard the #queue without sending it.
+     */
+    void ClearQueue();
+
+    /**
+     * Sending a request has failed; report this to the
+     * #ExitListener (if it was an EXEC request).
+     */
+    void OnSendError(PendingRequest &r, int error);
+
+    void ReceiveMessages();
 
     void HandleExitMessage(SpawnPayload payload);
-    void HandleMessage(ConstBuffer<uint8_t> payload);
+    void HandleStatsMessage(const struct msghdr &msg);
+    void HandleMessage(const struct msghdr &msg,
+                       ConstBuffer<uint8_t> payload);
     void OnSocketEvent(unsigned events);
 
 public:
@@ -35,10 +35,11 @@
 
 #include "UidGid.hxx"
 #include "util/RuntimeError.hxx"
+#include "util/FlatSet.hxx"
 
 #include "util/Compiler.h"
 
-#include <set>
+#include <string>
 
 /**
  * Configuration for the spawner.
@@ -54,8 +55,8 @@ struct SpawnConfig {
 
     UidGid default_uid_gid;
 
-    std::set<uid_t> allowed_uids;
-    std::set<gid_t> allowed_gids;
+    FlatSet<uid_t> allowed_uids;
+    FlatSet<gid_t> allowed_gids;
 
     /**
      * Ignore #allowed_uids and #allowed_gids, and allow all uids/gids
@@ -64,13 +65,64 @@ struct SpawnConfig {
      */
     bool allow_any_uid_gid = false;
 
+    /**
+     * The number of processes handling spawn requests.  Values
+     * greater than one fork additional worker processes which share
+     * the clients' connections; each child process is managed by
+     * the worker which has spawned it.
+     */
+    unsigned n_workers = 1;
+
+    /**
+     * Track child processes with pidfds instead of scanning with
+     * wait4() on each SIGCHLD (see ChildProcessRegistry::EnablePidfd()).
+     */
+    bool pidfd = false;
+
+    /**
+     * The maximum number of zygote processes (see SpawnZygotePool).
+     * 0 disables the feature.
+     */
+    unsigned max_zygotes = 0;
+
+    /**
+     * After how many spawns with the same profile is a zygote
+     * started?
+     */
+    unsigned zygote_threshold = 4;
+
+    /**
+     * Prepare mount namespaces once per configuration and let child
+     * processes enter them instead of setting up the mounts each
+     * time (see MountNamespaceCache)?
+     */
+    bool reuse_mount_namespaces = false;
+
+    /**
+     * Keep the network namespaces in /run/netns open (see
+     * NetworkNamespaceCache)?
+     */
+    bool network_namespace_cache = false;
+
+    /**
+     * Create and configure control groups in the spawner, and keep
+     * their files open (see CgroupCache)?
+     */
+    bool cgroup_cache = false;
+
+    /**
+     * Measure the duration of each phase of spawning a child
+     * process and log histograms (see SpawnPhaseTracer)?
+     */
+    bool trace_phases = false;
+
     void VerifyUid(uid_t uid) const {
-        if (allowed_uids.find(uid) == allowed_uids.end())
+        if (!allowed_uids.contains(uid))
             throw FormatRuntimeError("uid %d is not allowed", int(uid));
     }
 
     void VerifyGid(gid_t gid) const {
-        if (allowed_gids.find(gid) == allowed_gids.end())
+        if (!allowed_gids.contains(gid))
             throw FormatRuntimeError("gid %d is not allowed", int(gid));
     }
 
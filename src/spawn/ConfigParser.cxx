@@ -77,6 +77,34 @@ SpawnConfigParser::ParseLine(FileLineParser &line)
         config.allowed_uids.insert(ParseUser(line.ExpectValueAndEnd()));
     } else if (strcmp(word, "allow_group") == 0) {
         config.allowed_gids.insert(ParseGroup(line.ExpectValueAndEnd()));
+    } else if (strcmp(word, "workers") == 0) {
+        config.n_workers = line.NextPositiveInteger();
+        if (config.n_workers > 256)
+            throw LineParser::Error("Too many workers");
+        line.ExpectEnd();
+    } else if (strcmp(word, "pidfd") == 0) {
+        config.pidfd = line.NextBool();
+        line.ExpectEnd();
+    } else if (strcmp(word, "zygotes") == 0) {
+        config.max_zygotes = line.NextPositiveInteger();
+        if (config.max_zygotes > 64)
+            throw LineParser::Error("Too many zygotes");
+        line.ExpectEnd();
+    } else if (strcmp(word, "zygote_threshold") == 0) {
+        config.zygote_threshold = line.NextPositiveInteger();
+        line.ExpectEnd();
+    } else if (strcmp(word, "reuse_mount_namespaces") == 0) {
+        config.reuse_mount_namespaces = line.NextBool();
+        line.ExpectEnd();
+    } else if (strcmp(word, "network_namespace_cache") == 0) {
+        config.network_namespace_cache = line.NextBool();
+        line.ExpectEnd();
+    } else if (strcmp(word, "cgroup_cache") == 0) {
+        config.cgroup_cache = line.NextBool();
+        line.ExpectEnd();
+    } else if (strcmp(word, "trace_phases") == 0) {
+        config.trace_phases = line.NextBool();
+        line.ExpectEnd();
     } else
         throw LineParser::Error("Unknown option");
 }
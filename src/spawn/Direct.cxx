@@ -32,6 +32,10 @@
 
 #include "Direct.hxx"
 #include "Prepared.hxx"
+#include "MountNamespaceCache.hxx"
+#include "NetworkNamespaceCache.hxx"
+#include "CgroupCache.hxx"
+#include "PhaseTrace.hxx"
 #include "SeccompFilter.hxx"
 #include "SyscallFilter.hxx"
 #include "Init.hxx"
@@ -39,6 +43,7 @@
 #include "system/IOPrio.hxx"
 #include "util/PrintException.hxx"
 #include "util/ScopeExit.hxx"
+#include "util/Trace.h"
 
 #include "util/Compiler.h"
 
@@ -114,7 +119,12 @@ UnblockSignals()
 gcc_noreturn
 static void
 Exec(const char *path, PreparedChildProcess &&p,
-     const CgroupState &cgroup_state)
+     const CgroupState &cgroup_state,
+     const Seccomp::Program *seccomp_program,
+     FileDescriptor mount_namespace,
+     FileDescriptor network_namespace,
+     const std::vector<UniqueFileDescriptor> *cgroup_procs,
+     SpawnPhaseTimer &timer)
 try {
     UnignoreSignals();
     UnblockSignals();
@@ -136,7 +146,10 @@ try {
             stderr_fd = journal_fd;
     }
 
-    p.cgroup.Apply(cgroup_state);
+    timer.Skip();
+
+    if (cgroup_procs == nullptr || !MoveToPreparedCgroup(*cgroup_procs))
+        p.cgroup.Apply(cgroup_state);
 
     if (p.ns.enable_cgroup && p.cgroup.IsDefined()) {
         /* if the process was just moved to another cgroup, we need to
@@ -151,9 +164,13 @@ try {
             throw MakeErrno("Failed to unshare cgroup namespace");
     }
 
+    timer.Mark(SpawnPhase::CGROUP);
+
     p.refence.Apply();
 
-    p.ns.Setup(p.uid_gid);
+    timer.Skip();
+    p.ns.Setup(p.uid_gid, mount_namespace, network_namespace);
+    timer.Mark(SpawnPhase::NAMESPACES);
     p.rlimits.Apply();
 
     if (p.chroot != nullptr && chroot(p.chroot) < 0) {
@@ -229,35 +246,31 @@ try {
         }
     }
 
-    try {
-        Seccomp::Filter sf(SCMP_ACT_ALLOW);
-        sf.AddSecondaryArchs();
-
-        BuildSyscallFilter(sf);
-
-        if (p.forbid_user_ns)
-            ForbidUserNamespace(sf);
-
-        if (p.forbid_multicast)
-            ForbidMulticast(sf);
-
-        if (p.forbid_bind)
-            ForbidBind(sf);
+    timer.Skip();
 
-        sf.Load();
-    } catch (const std::runtime_error &e) {
-        if (p.HasSyscallFilter())
-            /* filter options have been explicitly enabled, and thus
-               failure to set up the filter are fatal */
-            throw;
+    if (seccomp_program != nullptr) {
+        try {
+            seccomp_program->Load();
+        } catch (const std::runtime_error &e) {
+            if (p.HasSyscallFilter())
+                /* filter options have been explicitly enabled, and
+                   thus failure to set up the filter are fatal */
+                throw;
 
-        fprintf(stderr, "Failed to setup seccomp filter for '%s': %s\n",
-                path, e.what());
+            fprintf(stderr, "Failed to setup seccomp filter for '%s': %s\n",
+                    path, e.what());
+        }
     }
 
+    timer.Mark(SpawnPhase::SECCOMP);
+    timer.MarkTotal(SpawnPhase::CHILD_TOTAL);
+    timer.Complete();
+
     if (p.exec_function != nullptr) {
         _exit(p.exec_function(std::move(p)));
     } else {
+        TRACE_POINT(spawn_exec, path);
+
         execve(path, const_cast<char *const*>(p.args.raw()),
                const_cast<char *const*>(p.env.raw()));
 
@@ -275,6 +288,38 @@ struct SpawnChildProcessContext {
 
     const char *path;
 
+    /**
+     * The precompiled system call filter; nullptr if it could not
+     * be built (and the failure is not fatal).
+     */
+    const Seccomp::Program *seccomp_program = nullptr;
+
+    /**
+     * A prepared mount namespace from the #MountNamespaceCache to be
+     * entered by the child process instead of setting up the
+     * mounts.
+     */
+    FileDescriptor mount_namespace = FileDescriptor::Undefined();
+
+    /**
+     * An open handle to NamespaceOptions::network_namespace from
+     * the #NetworkNamespaceCache.
+     */
+    FileDescriptor network_namespace = FileDescriptor::Undefined();
+
+    /**
+     * The "cgroup.procs" files of the group prepared by the
+     * #CgroupCache; nullptr if the child process shall apply the
+     * #CgroupOptions by itself.
+     */
+    const std::vector<UniqueFileDescriptor> *cgroup_procs = nullptr;
+
+    /**
+     * Shared memory where both processes store the duration of
+     * their phases; nullptr if tracing is disabled.
+     */
+    SpawnPhaseRecord *trace = nullptr;
+
     /**
      * A pipe used by the child process to wait for the parent to set
      * it up (e.g. uid/gid mappings).
@@ -293,6 +338,8 @@ spawn_fn(void *_ctx)
 {
     auto &ctx = *(SpawnChildProcessContext *)_ctx;
 
+    SpawnPhaseTimer timer(ctx.trace);
+
     if (ctx.wait_pipe_r.IsDefined()) {
         /* wait for the parent to set us up */
 
@@ -306,18 +353,93 @@ spawn_fn(void *_ctx)
             _exit(EXIT_FAILURE);
     }
 
-    Exec(ctx.path, std::move(ctx.params), ctx.cgroup_state);
+    Exec(ctx.path, std::move(ctx.params), ctx.cgroup_state,
+         ctx.seccomp_program, ctx.mount_namespace, ctx.network_namespace,
+         ctx.cgroup_procs, timer);
+}
+
+/**
+ * Can the child process share our address space until it calls
+ * execve() (CLONE_VM|CLONE_VFORK)?  This avoids copying the page
+ * tables, but is only safe for simple children which neither enter
+ * new namespaces nor change their uid/gid, and which don't run code
+ * (#PreparedChildProcess::exec_function) which might modify our
+ * memory.
+ */
+gcc_pure
+static bool
+CanShareAddressSpace(const SpawnChildProcessContext &ctx, int clone_flags)
+{
+    return clone_flags == SIGCHLD &&
+        !ctx.mount_namespace.IsDefined() &&
+        !ctx.wait_pipe_r.IsDefined() &&
+        ctx.params.exec_function == nullptr &&
+        ctx.params.uid_gid.IsEmpty();
 }
 
 pid_t
 SpawnChildProcess(PreparedChildProcess &&params,
-                  const CgroupState &cgroup_state)
+                  const CgroupState &cgroup_state,
+                  const SpawnChildProcessHelpers &helpers)
 {
     int clone_flags = SIGCHLD;
     clone_flags = params.ns.GetCloneFlags(clone_flags);
 
     SpawnChildProcessContext ctx(std::move(params), cgroup_state);
 
+    if (helpers.tracer != nullptr)
+        ctx.trace = helpers.tracer->Begin();
+
+    SpawnPhaseTimer timer(ctx.trace);
+
+    /* compile the system call filter here in the spawner, where it
+       is cached, and not in each child process */
+    try {
+        ctx.seccomp_program =
+            &GetSyscallFilterProgram(ctx.params.forbid_user_ns,
+                                     ctx.params.forbid_multicast,
+                                     ctx.params.forbid_bind);
+    } catch (const std::runtime_error &e) {
+        if (ctx.params.HasSyscallFilter())
+            throw;
+
+        fprintf(stderr, "Failed to setup seccomp filter for '%s': %s\n",
+                ctx.path, e.what());
+    }
+
+    if (helpers.mount_namespaces != nullptr) {
+        try {
+            ctx.mount_namespace = helpers.mount_namespaces->Get(ctx.params.ns);
+        } catch (const std::runtime_error &e) {
+            /* not fatal: fall back to setting up the mounts in the
+               child process */
+            fprintf(stderr, "Failed to prepare mount namespace for '%s': %s\n",
+                    ctx.path, e.what());
+        }
+
+        if (ctx.mount_namespace.IsDefined())
+            /* the child process will enter the prepared mount
+               namespace with setns() */
+            clone_flags &= ~CLONE_NEWNS;
+    }
+
+    if (helpers.cgroups != nullptr)
+        /* create and configure the cgroup here, so the child process
+           only needs to move itself into it */
+        ctx.cgroup_procs = helpers.cgroups->Prepare(ctx.params.cgroup);
+
+    if (helpers.network_namespaces != nullptr &&
+        ctx.params.ns.network_namespace != nullptr) {
+        try {
+            ctx.network_namespace =
+                helpers.network_namespaces->Get(ctx.params.ns.network_namespace);
+        } catch (const std::runtime_error &) {
+            /* not fatal: fall back to opening the namespace by its
+               name (which will probably fail, too, but with a
+               proper error message) */
+        }
+    }
+
     UniqueFileDescriptor old_netns;
 
     AtScopeExit(&old_netns) {
@@ -343,7 +465,7 @@ SpawnChildProcess(PreparedChildProcess &&params,
 
         /* then let this process reassociate with the target network
            namespace */
-        ctx.params.ns.ReassociateNetwork();
+        ctx.params.ns.ReassociateNetwork(ctx.network_namespace);
 
         /* clear the option, so the child process doesn't call setns()
            again */
@@ -362,15 +484,45 @@ SpawnChildProcess(PreparedChildProcess &&params,
         ctx.params.ns.enable_user = false;
     }
 
-    char stack[8192];
-    long pid = clone(spawn_fn, stack + sizeof(stack), clone_flags, &ctx);
+    timer.Mark(SpawnPhase::PREPARE);
+
+    long pid;
+    if (CanShareAddressSpace(ctx, clone_flags)) {
+        /* the parent is suspended until the child has called
+           execve() or has exited, so there is never more than one
+           user of this stack; it must not live on our stack,
+           because the child writes to it while our stack frame is
+           still in use */
+        alignas(16) static char vm_stack[65536];
+
+        /* block all signals, so the child doesn't run one of our
+           signal handlers (in our address space) before it has
+           reset them */
+        sigset_t all, old_mask;
+        sigfillset(&all);
+        sigprocmask(SIG_SETMASK, &all, &old_mask);
+
+        pid = clone(spawn_fn, vm_stack + sizeof(vm_stack),
+                    clone_flags|CLONE_VM|CLONE_VFORK, &ctx);
+
+        const int e = errno;
+        sigprocmask(SIG_SETMASK, &old_mask, nullptr);
+        errno = e;
+    } else {
+        char stack[8192];
+        pid = clone(spawn_fn, stack + sizeof(stack), clone_flags, &ctx);
+    }
+
     if (pid < 0)
         throw MakeErrno("clone() failed");
 
+    timer.Mark(SpawnPhase::CLONE);
+
     if (ctx.wait_pipe_w.IsDefined()) {
         /* set up the child's uid/gid mapping and wake it up */
         ctx.wait_pipe_r.Close();
         ctx.params.ns.SetupUidGidMap(ctx.params.uid_gid, pid);
+        timer.Mark(SpawnPhase::UID_GID_MAP);
 
         /* after success (no exception was thrown), we send one byte
            to the pipe and close it, so the child knows everything's
@@ -37,6 +37,36 @@
 
 struct PreparedChildProcess;
 struct CgroupState;
+class MountNamespaceCache;
+class NetworkNamespaceCache;
+class CgroupCache;
+class SpawnPhaseTracer;
+
+/**
+ * Optional spawner-side helpers for SpawnChildProcess(); each of
+ * them may be nullptr.
+ */
+struct SpawnChildProcessHelpers {
+    /**
+     * A cache of prepared mount namespaces.
+     */
+    MountNamespaceCache *mount_namespaces = nullptr;
+
+    /**
+     * A cache of open network namespace handles.
+     */
+    NetworkNamespaceCache *network_namespaces = nullptr;
+
+    /**
+     * A cache of prepared control groups.
+     */
+    CgroupCache *cgroups = nullptr;
+
+    /**
+     * Measure the duration of each phase.
+     */
+    SpawnPhaseTracer *tracer = nullptr;
+};
 
 /**
  * Throws exception on error.
@@ -45,6 +75,7 @@ struct CgroupState;
  */
 pid_t
 SpawnChildProcess(PreparedChildProcess &&params,
-                  const CgroupState &cgroup_state);
+                  const CgroupState &cgroup_state,
+                  const SpawnChildProcessHelpers &helpers=SpawnChildProcessHelpers());
 
 #endif
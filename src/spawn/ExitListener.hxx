@@ -33,12 +33,41 @@
 #ifndef BENG_PROXY_SPAWN_EXIT_LISTENER_HXX
 #define BENG_PROXY_SPAWN_EXIT_LISTENER_HXX
 
+#include <stdint.h>
+
+/**
+ * Resources consumed by a child process, collected by wait4().  This
+ * struct is transferred over the spawner protocol as-is.
+ */
+struct ChildResourceUsage {
+    /**
+     * CPU time spent in user and kernel mode [microseconds].
+     */
+    uint64_t user_time = 0, system_time = 0;
+
+    /**
+     * Maximum resident set size [KiB].
+     */
+    uint64_t max_rss = 0;
+
+    /**
+     * Number of block input/output operations.
+     */
+    uint64_t in_blocks = 0, out_blocks = 0;
+};
+
 /**
  * This interface gets notified when the registered child process
  * exits.
  */
 class ExitListener {
 public:
+    /**
+     * Called right before OnChildProcessExit() with the resources
+     * consumed by the process, if known.
+     */
+    virtual void OnChildProcessResourceUsage(const ChildResourceUsage &) {}
+
     virtual void OnChildProcessExit(int status) = 0;
 };
 
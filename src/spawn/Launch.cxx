@@ -107,6 +107,12 @@ RunSpawnServer2(void *p)
     signal(SIGUSR1, SIG_IGN);
     signal(SIGUSR2, SIG_IGN);
 
+    if (!ctx.config.systemd_scope.empty() && ctx.config.n_workers <= 1) {
+        /* don't block while systemd sets up the scope */
+        RunSpawnServerAsyncScope(ctx.config, ctx.hook, ctx.fd, real_pid);
+        return 0;
+    }
+
     CgroupState cgroup_state;
 
     if (!ctx.config.systemd_scope.empty()) {
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "MountNamespaceCache.hxx"
+#include "NamespaceOptions.hxx"
+#include "system/Error.hxx"
+#include "util/PrintException.hxx"
+
+#include <exception>
+#include <stdexcept>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+static constexpr std::chrono::steady_clock::duration MOUNT_NAMESPACE_TTL =
+    std::chrono::minutes(5);
+
+struct MountNamespaceHelperContext {
+    const NamespaceOptions &ns;
+
+    /**
+     * The helper process writes one byte to this pipe after the
+     * namespace has been set up.
+     */
+    UniqueFileDescriptor pipe_r, pipe_w;
+
+    explicit MountNamespaceHelperContext(const NamespaceOptions &_ns)
+        :ns(_ns) {}
+};
+
+static int
+mount_namespace_helper_fn(void *_ctx)
+{
+    auto &ctx = *(MountNamespaceHelperContext *)_ctx;
+
+    ctx.pipe_r.Close();
+
+    try {
+        ctx.ns.SetupMountNamespace();
+    } catch (...) {
+        PrintException(std::current_exception());
+        _exit(EXIT_FAILURE);
+    }
+
+    static constexpr char buffer = 0;
+    ctx.pipe_w.Write(&buffer, sizeof(buffer));
+
+    /* stay alive until the parent has opened the namespace and
+       kills us */
+    while (true)
+        pause();
+}
+
+/**
+ * Set up a new mount namespace in a helper process and return a
+ * file descriptor referring to it.
+ */
+static UniqueFileDescriptor
+MakeMountNamespace(const NamespaceOptions &ns)
+{
+    MountNamespaceHelperContext ctx(ns);
+    if (!UniqueFileDescriptor::CreatePipe(ctx.pipe_r, ctx.pipe_w))
+        throw MakeErrno("pipe() failed");
+
+    char stack[8192];
+    long pid = clone(mount_namespace_helper_fn, stack + sizeof(stack),
+                     CLONE_NEWNS|SIGCHLD, &ctx);
+    if (pid < 0)
+        throw MakeErrno("clone() failed");
+
+    ctx.pipe_w.Close();
+
+    char buffer;
+    const bool success = ctx.pipe_r.Read(&buffer, sizeof(buffer)) == 1;
+
+    UniqueFileDescriptor fd;
+    if (success) {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%ld/ns/mnt", pid);
+        if (!fd.OpenReadOnly(path)) {
+            const int e = errno;
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+            throw MakeErrno(e, "Failed to open mount namespace");
+        }
+
+        kill(pid, SIGKILL);
+    }
+
+    /* reap the helper right now, before the ChildProcessRegistry
+       sees it */
+    waitpid(pid, nullptr, 0);
+
+    if (!success)
+        throw std::runtime_error("Failed to set up mount namespace");
+
+    return fd;
+}
+
+FileDescriptor
+MountNamespaceCache::Get(const NamespaceOptions &ns)
+{
+    if (!ns.IsMountNamespaceReusable())
+        return FileDescriptor::Undefined();
+
+    char buffer[16384];
+    *ns.MakeId(buffer) = 0;
+    const std::string key(buffer);
+
+    const auto now = std::chrono::steady_clock::now();
+
+    Item *item = cache.Get(key);
+    if (item != nullptr) {
+        if (now < item->expires)
+            return item->fd.ToFileDescriptor();
+
+        cache.RemoveItem(*item);
+    }
+
+    return cache.Put(key, Item(MakeMountNamespace(ns),
+                               now + MOUNT_NAMESPACE_TTL)).fd.ToFileDescriptor();
+}
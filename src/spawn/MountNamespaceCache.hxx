@@ -0,0 +1,86 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BENG_PROXY_SPAWN_MOUNT_NAMESPACE_CACHE_HXX
+#define BENG_PROXY_SPAWN_MOUNT_NAMESPACE_CACHE_HXX
+
+#include "io/UniqueFileDescriptor.hxx"
+#include "util/Cache.hxx"
+
+#include <string>
+#include <chrono>
+
+struct NamespaceOptions;
+
+/**
+ * Keeps prepared mount namespaces, so the mounts of a
+ * #NamespaceOptions configuration are set up only once instead of in
+ * each child process; the child process just enters the namespace
+ * with setns().  Each namespace is set up by a short-lived helper
+ * process and is kept alive by a file descriptor referring to it.
+ *
+ * Only configurations which pass
+ * NamespaceOptions::IsMountNamespaceReusable() are eligible,
+ * i.e. those without per-process mounts.  Items expire after a
+ * while, to pick up changes to the bind-mounted directories.
+ */
+class MountNamespaceCache {
+    struct Item {
+        UniqueFileDescriptor fd;
+
+        std::chrono::steady_clock::time_point expires;
+
+        Item(UniqueFileDescriptor &&_fd,
+             std::chrono::steady_clock::time_point _expires)
+            :fd(std::move(_fd)), expires(_expires) {}
+    };
+
+    Cache<std::string, Item, 64, 61> cache;
+
+public:
+    /**
+     * Look up (or create) the mount namespace for the given options.
+     *
+     * Throws exception on error.
+     *
+     * @return a file descriptor for setns() which remains owned by
+     * this object, or FileDescriptor::Undefined() if the options
+     * are not eligible
+     */
+    FileDescriptor Get(const NamespaceOptions &ns);
+
+    void Clear() {
+        cache.Clear();
+    }
+};
+
+#endif
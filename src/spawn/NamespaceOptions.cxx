@@ -45,8 +45,6 @@
 #include "pexpand.hxx"
 #endif
 
-#include <set>
-
 #include <assert.h>
 #include <sched.h>
 #include <unistd.h>
@@ -136,10 +134,10 @@ void
 NamespaceOptions::SetupUidGidMap(const UidGid &uid_gid,
                                  int pid) const
 {
-    /* collect all gids (including supplementary groups) in a std::set
-       to eliminate duplicates, and then map them all into the new
-       user namespace */
-    std::set<unsigned> gids;
+    /* collect all gids (including supplementary groups) in a sorted
+       set to eliminate duplicates, and then map them all into the
+       new user namespace */
+    GidSet gids;
     gids.emplace(uid_gid.gid);
     for (unsigned i = 0; uid_gid.groups[i] != 0; ++i)
         gids.emplace(uid_gid.groups[i]);
@@ -158,10 +156,13 @@ NamespaceOptions::SetupUidGidMap(const UidGid &uid_gid,
 }
 
 void
-NamespaceOptions::ReassociateNetwork() const
+NamespaceOptions::ReassociateNetwork(FileDescriptor fd) const
 {
     assert(network_namespace != nullptr);
 
+    if (fd.IsDefined() && setns(fd.Get(), CLONE_NEWNET) == 0)
+        return;
+
     ReassociateNetworkNamespace(network_namespace);
 }
 
@@ -204,7 +205,9 @@ MountOrThrow(const char *source, const char *target,
 }
 
 void
-NamespaceOptions::Setup(const UidGid &uid_gid) const
+NamespaceOptions::Setup(const UidGid &uid_gid,
+                        FileDescriptor mount_namespace,
+                        FileDescriptor network_namespace_fd) const
 {
     /* set up UID/GID mapping in the old /proc */
     if (enable_user) {
@@ -218,8 +221,37 @@ NamespaceOptions::Setup(const UidGid &uid_gid) const
     }
 
     if (network_namespace != nullptr)
-        ReassociateNetwork();
+        ReassociateNetwork(network_namespace_fd);
+
+    if (mount_namespace.IsDefined()) {
+        /* enter the prepared mount namespace; this also moves our
+           root and working directory to its root */
+        if (setns(mount_namespace.Get(), CLONE_NEWNS) < 0)
+            throw MakeErrno("Failed to reassociate with mount namespace");
+    } else
+        SetupMountNamespace();
+
+    if (hostname != nullptr &&
+        sethostname(hostname, strlen(hostname)) < 0)
+        throw MakeErrno("sethostname() failed");
+}
+
+bool
+NamespaceOptions::IsMountNamespaceReusable() const
+{
+    /* only if no per-process state is mounted (/proc of a new PID
+       namespace, devpts instances, writable tmpfs), and only if the
+       namespace will be owned by our user namespace, because a new
+       user namespace lacks the privileges to setns() into it */
+    return enable_mount && !enable_user &&
+        !(mount_proc && enable_pid) &&
+        !mount_pts &&
+        mount_tmp_tmpfs == nullptr && mount_tmpfs == nullptr;
+}
 
+void
+NamespaceOptions::SetupMountNamespace() const
+{
     if (enable_mount)
         /* convert all "shared" mounts to "private" mounts */
         mount(nullptr, "/", nullptr, MS_PRIVATE|MS_REC, nullptr);
@@ -357,10 +389,6 @@ NamespaceOptions::Setup(const UidGid &uid_gid) const
                      MS_NODEV|MS_NOEXEC|MS_NOSUID,
                      options);
     }
-
-    if (hostname != nullptr &&
-        sethostname(hostname, strlen(hostname)) < 0)
-        throw MakeErrno("sethostname() failed");
 }
 
 char *
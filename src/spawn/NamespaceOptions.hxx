@@ -34,6 +34,7 @@
 #define BENG_PROXY_NAMESPACE_OPTIONS_HXX
 
 #include "translation/Features.hxx"
+#include "io/FileDescriptor.hxx"
 
 #include "util/Compiler.h"
 
@@ -155,13 +156,41 @@ struct NamespaceOptions {
 
     /**
      * Apply #network_namespace.
+     *
+     * @param fd if defined, then this is an already opened handle
+     * to the namespace (see #NetworkNamespaceCache); if setns()
+     * fails with it, the namespace is opened again by its name
+     */
+    void ReassociateNetwork(FileDescriptor fd=FileDescriptor::Undefined()) const;
+
+    /**
+     * Throws std::system_error on error.
+     *
+     * @param mount_namespace if defined, then enter this mount
+     * namespace (prepared by SetupMountNamespace()) instead of
+     * setting up the mounts
+     * @param network_namespace_fd if defined, then this is an
+     * already opened handle to #network_namespace
      */
-    void ReassociateNetwork() const;
+    void Setup(const UidGid &uid_gid,
+               FileDescriptor mount_namespace=FileDescriptor::Undefined(),
+               FileDescriptor network_namespace_fd=FileDescriptor::Undefined()) const;
 
     /**
+     * Can the mount namespace be shared by all processes with the
+     * same MakeId() (see MountNamespaceCache)?
+     */
+    gcc_pure
+    bool IsMountNamespaceReusable() const;
+
+    /**
+     * Apply all mount options to the current mount namespace.  This
+     * is the part of Setup() which may be done once for a
+     * #MountNamespaceCache instead of in each process.
+     *
      * Throws std::system_error on error.
      */
-    void Setup(const UidGid &uid_gid) const;
+    void SetupMountNamespace() const;
 
     char *MakeId(char *p) const;
 
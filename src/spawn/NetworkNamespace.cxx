@@ -36,20 +36,28 @@
 
 #include <sched.h>
 
+std::string
+MakeNetworkNamespacePath(const char *name)
+{
+    char path[4096];
+    if (snprintf(path, sizeof(path),
+                 "/run/netns/%s", name) >= (int)sizeof(path))
+        throw std::runtime_error("Network namespace name is too long");
+
+    return path;
+}
+
 /**
  * Open a network namespace in /run/netns.
  */
 static UniqueFileDescriptor
 OpenNetworkNS(const char *name)
 {
-    char path[4096];
-    if (snprintf(path, sizeof(path),
-                 "/run/netns/%s", name) >= (int)sizeof(path))
-        throw std::runtime_error("Network namespace name is too long");
+    const auto path = MakeNetworkNamespacePath(name);
 
     UniqueFileDescriptor fd;
-    if (!fd.OpenReadOnly(path))
-        throw FormatErrno("Failed to open %s", path);
+    if (!fd.OpenReadOnly(path.c_str()))
+        throw FormatErrno("Failed to open %s", path.c_str());
 
     return fd;
 }
@@ -59,7 +67,13 @@ ReassociateNetworkNamespace(const char *name)
 {
     assert(name != nullptr);
 
-    if (setns(OpenNetworkNS(name).Get(), CLONE_NEWNET) < 0)
+    ReassociateNetworkNamespace(OpenNetworkNS(name).ToFileDescriptor(), name);
+}
+
+void
+ReassociateNetworkNamespace(FileDescriptor fd, const char *name)
+{
+    if (setns(fd.Get(), CLONE_NEWNET) < 0)
         throw FormatErrno("Failed to reassociate with network namespace '%s'",
                           name);
 }
@@ -32,9 +32,31 @@
 
 #pragma once
 
+#include <string>
+
+class FileDescriptor;
+
+/**
+ * Build the path of the given network namespace in /run/netns/.
+ *
+ * Throws std::runtime_error if the name is too long.
+ */
+std::string
+MakeNetworkNamespacePath(const char *name);
+
 /**
  * Reassociate the current process with the given network namespace
  * (set up with "ip netns" mounted in /run/netns/).
  */
 void
 ReassociateNetworkNamespace(const char *name);
+
+/**
+ * Reassociate the current process with the network namespace
+ * referred to by the given file descriptor (e.g. from the
+ * #NetworkNamespaceCache).
+ *
+ * @param name the namespace name for the error message
+ */
+void
+ReassociateNetworkNamespace(FileDescriptor fd, const char *name);
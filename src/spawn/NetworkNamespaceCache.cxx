@@ -0,0 +1,61 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "NetworkNamespaceCache.hxx"
+#include "NetworkNamespace.hxx"
+#include "system/Error.hxx"
+
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+NetworkNamespaceCache::NetworkNamespaceCache()
+{
+    struct stat st;
+    if (stat("/proc/self/ns/net", &st) < 0)
+        throw MakeErrno("Failed to stat /proc/self/ns/net");
+
+    nsfs_dev = st.st_dev;
+}
+
+FileDescriptor
+NetworkNamespaceCache::Get(const char *name)
+{
+    const auto path = MakeNetworkNamespacePath(name);
+    const auto &item = files.Open(path.c_str());
+    if (item.st.st_dev != nsfs_dev) {
+        files.Invalidate(path.c_str());
+        throw std::runtime_error("Not a network namespace: " + path);
+    }
+
+    return item.GetFileDescriptor();
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "io/OpenFileCache.hxx"
+
+#include <sys/types.h>
+
+/**
+ * Keeps the network namespaces in /run/netns open, so spawning many
+ * processes into the same few namespaces does not need a path lookup
+ * and open()/close() each time.  Entries are invalidated by inotify
+ * when the namespace is deleted or replaced (e.g. "ip netns delete");
+ * the caller must register GetInotifyFileDescriptor() with its event
+ * loop and call HandleInotifyEvents() when it becomes readable.
+ */
+class NetworkNamespaceCache {
+    OpenFileCache files;
+
+    /**
+     * The device of the "nsfs" filesystem; files which are not on
+     * it are not (yet) namespaces, e.g. "ip netns add" creates an
+     * empty file first and then bind-mounts the namespace on it.
+     */
+    dev_t nsfs_dev;
+
+public:
+    /**
+     * Throws std::system_error on error.
+     */
+    NetworkNamespaceCache();
+
+    FileDescriptor GetInotifyFileDescriptor() const noexcept {
+        return files.GetInotifyFileDescriptor();
+    }
+
+    void HandleInotifyEvents() noexcept {
+        files.HandleInotifyEvents();
+    }
+
+    /**
+     * Look up (or open) the named network namespace.
+     *
+     * Throws exception on error.
+     *
+     * @return a file descriptor for setns() which remains owned by
+     * this object until the next call
+     */
+    FileDescriptor Get(const char *name);
+
+    void Clear() noexcept {
+        files.Clear();
+    }
+};
@@ -0,0 +1,207 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "PhaseTrace.hxx"
+
+#include <algorithm>
+
+#include <stdio.h>
+#include <sys/mman.h>
+
+const char *
+ToString(SpawnPhase phase)
+{
+    switch (phase) {
+    case SpawnPhase::PREPARE:
+        return "prepare";
+
+    case SpawnPhase::CLONE:
+        return "clone";
+
+    case SpawnPhase::UID_GID_MAP:
+        return "uid_gid_map";
+
+    case SpawnPhase::CGROUP:
+        return "cgroup";
+
+    case SpawnPhase::NAMESPACES:
+        return "namespaces";
+
+    case SpawnPhase::SECCOMP:
+        return "seccomp";
+
+    case SpawnPhase::CHILD_TOTAL:
+        return "child_total";
+
+    case SpawnPhase::N:
+        break;
+    }
+
+    return "?";
+}
+
+static void
+SetDuration(SpawnPhaseRecord &record, SpawnPhase phase,
+            std::chrono::steady_clock::duration d)
+{
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    record.durations[size_t(phase)] =
+        uint32_t(std::min<decltype(us)>(us, UINT32_MAX));
+}
+
+void
+SpawnPhaseTimer::Mark(SpawnPhase phase)
+{
+    if (record == nullptr)
+        return;
+
+    const auto now = std::chrono::steady_clock::now();
+    SetDuration(*record, phase, now - last);
+    last = now;
+}
+
+void
+SpawnPhaseTimer::Skip()
+{
+    if (record != nullptr)
+        last = std::chrono::steady_clock::now();
+}
+
+void
+SpawnPhaseTimer::MarkTotal(SpawnPhase phase)
+{
+    if (record != nullptr)
+        SetDuration(*record, phase, std::chrono::steady_clock::now() - start);
+}
+
+void
+SpawnPhaseTimer::Complete()
+{
+    if (record != nullptr)
+        record->state.store(SpawnPhaseRecord::State::COMPLETE,
+                            std::memory_order_release);
+}
+
+SpawnPhaseTracer::~SpawnPhaseTracer()
+{
+    if (records != nullptr)
+        munmap(records, sizeof(*records) * N_RECORDS);
+}
+
+SpawnPhaseRecord *
+SpawnPhaseTracer::Begin()
+{
+    if (records == nullptr) {
+        void *p = mmap(nullptr, sizeof(*records) * N_RECORDS,
+                       PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS,
+                       -1, 0);
+        if (p == MAP_FAILED)
+            return nullptr;
+
+        /* the anonymous mapping is zero-filled, i.e. all records
+           are FREE */
+        records = (SpawnPhaseRecord *)p;
+    }
+
+    auto &record = records[next];
+    next = (next + 1) % N_RECORDS;
+
+    Collect(record);
+
+    record.durations.fill(0);
+    record.state.store(SpawnPhaseRecord::State::IN_USE,
+                       std::memory_order_relaxed);
+    return &record;
+}
+
+void
+SpawnPhaseTracer::Collect(SpawnPhaseRecord &record)
+{
+    switch (record.state.load(std::memory_order_acquire)) {
+    case SpawnPhaseRecord::State::FREE:
+        return;
+
+    case SpawnPhaseRecord::State::IN_USE:
+        /* the child process has failed (or is still running after
+           a whole round through the ring buffer) */
+        ++n_dropped;
+        break;
+
+    case SpawnPhaseRecord::State::COMPLETE:
+        ++n_collected;
+
+        for (size_t i = 0; i < record.durations.size(); ++i)
+            histograms[i].Add(std::chrono::microseconds(record.durations[i]));
+
+        break;
+    }
+
+    record.state.store(SpawnPhaseRecord::State::FREE,
+                       std::memory_order_relaxed);
+}
+
+void
+SpawnPhaseTracer::Collect()
+{
+    if (records == nullptr)
+        return;
+
+    for (size_t i = 0; i < N_RECORDS; ++i)
+        if (records[i].state.load(std::memory_order_acquire) ==
+            SpawnPhaseRecord::State::COMPLETE)
+            Collect(records[i]);
+}
+
+std::string
+SpawnPhaseTracer::Format(SpawnPhase phase) const
+{
+    const auto &h = histograms[size_t(phase)];
+
+    std::string result = ToString(phase);
+
+    char buffer[64];
+    for (unsigned i = 0; i < Log2Histogram::N_BUCKETS; ++i) {
+        if (h[i] == 0)
+            continue;
+
+        const uint64_t limit = Log2Histogram::GetBucketLimit(i);
+        if (limit > 0)
+            snprintf(buffer, sizeof(buffer), " <%lluus:%llu",
+                     (unsigned long long)limit, (unsigned long long)h[i]);
+        else
+            snprintf(buffer, sizeof(buffer), " more:%llu",
+                     (unsigned long long)h[i]);
+        result += buffer;
+    }
+
+    return result;
+}
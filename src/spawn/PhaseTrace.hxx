@@ -0,0 +1,219 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BENG_PROXY_SPAWN_PHASE_TRACE_HXX
+#define BENG_PROXY_SPAWN_PHASE_TRACE_HXX
+
+#include "util/Log2Histogram.hxx"
+#include "util/Compiler.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include <stdint.h>
+
+/**
+ * A phase of SpawnChildProcess() which is timed by the
+ * #SpawnPhaseTracer.
+ */
+enum class SpawnPhase : unsigned {
+    /**
+     * Spawner: preparations before clone() (system call filter,
+     * mount namespace, cgroup).
+     */
+    PREPARE,
+
+    /**
+     * Spawner: the clone() system call.
+     */
+    CLONE,
+
+    /**
+     * Spawner: SetupUidMap() and SetupGidMap() for the new user
+     * namespace.
+     */
+    UID_GID_MAP,
+
+    /**
+     * Child: moving into the cgroup.
+     */
+    CGROUP,
+
+    /**
+     * Child: setting up the namespaces, including all mounts.
+     */
+    NAMESPACES,
+
+    /**
+     * Child: loading the system call filter.
+     */
+    SECCOMP,
+
+    /**
+     * Child: from its start until right before execve().
+     */
+    CHILD_TOTAL,
+
+    N
+};
+
+gcc_const
+const char *
+ToString(SpawnPhase phase);
+
+/**
+ * The durations of one spawn.  It lives in memory which is shared
+ * between the spawner and its child processes, so the child can
+ * report its phases without a round trip.
+ */
+struct SpawnPhaseRecord {
+    enum class State : unsigned {
+        FREE,
+        IN_USE,
+
+        /**
+         * The child process has finished all its phases.
+         */
+        COMPLETE,
+    };
+
+    std::atomic<State> state;
+
+    /**
+     * Durations in microseconds.
+     */
+    std::array<uint32_t, size_t(SpawnPhase::N)> durations;
+};
+
+/**
+ * Measures consecutive phases and stores them in a
+ * #SpawnPhaseRecord.  Does nothing if the record is nullptr.
+ */
+class SpawnPhaseTimer {
+    SpawnPhaseRecord *const record;
+
+    std::chrono::steady_clock::time_point start, last;
+
+public:
+    explicit SpawnPhaseTimer(SpawnPhaseRecord *_record)
+        :record(_record) {
+        if (record != nullptr)
+            start = last = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * The given phase has ended; it began when the previous one
+     * ended (or when this object was constructed).
+     */
+    void Mark(SpawnPhase phase);
+
+    /**
+     * Begin the next phase now, i.e. do not account the time since
+     * the previous Mark() to any phase.
+     */
+    void Skip();
+
+    /**
+     * The given phase has ended; it began when this object was
+     * constructed.
+     */
+    void MarkTotal(SpawnPhase phase);
+
+    /**
+     * Mark the record as complete; it will be collected by the
+     * #SpawnPhaseTracer.
+     */
+    void Complete();
+};
+
+/**
+ * Collects #SpawnPhaseRecord instances into a histogram per
+ * #SpawnPhase.  The records are a ring buffer in shared memory; a
+ * record is collected when its slot is reused or when Collect() is
+ * called.  Records of child processes which failed before
+ * completing are dropped.
+ */
+class SpawnPhaseTracer {
+    static constexpr size_t N_RECORDS = 256;
+
+    /**
+     * Mapped lazily by Begin(), so forked worker processes do not
+     * share it.
+     */
+    SpawnPhaseRecord *records = nullptr;
+
+    size_t next = 0;
+
+    uint64_t n_collected = 0, n_dropped = 0;
+
+    std::array<Log2Histogram, size_t(SpawnPhase::N)> histograms;
+
+public:
+    SpawnPhaseTracer() = default;
+    ~SpawnPhaseTracer();
+
+    SpawnPhaseTracer(const SpawnPhaseTracer &) = delete;
+    SpawnPhaseTracer &operator=(const SpawnPhaseTracer &) = delete;
+
+    /**
+     * Obtain a record for a new spawn.
+     *
+     * @return the record or nullptr if the shared memory could not
+     * be allocated
+     */
+    SpawnPhaseRecord *Begin();
+
+    /**
+     * Fold all completed records into the histograms.
+     */
+    void Collect();
+
+    uint64_t GetCollected() const {
+        return n_collected;
+    }
+
+    uint64_t GetDropped() const {
+        return n_dropped;
+    }
+
+    /**
+     * Format the histogram of one phase as a human-readable string.
+     */
+    std::string Format(SpawnPhase phase) const;
+
+private:
+    void Collect(SpawnPhaseRecord &record);
+};
+
+#endif
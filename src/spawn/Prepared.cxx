@@ -71,11 +71,7 @@ PreparedChildProcess::SetEnv(const char *name, const char *value)
     assert(name != nullptr);
     assert(value != nullptr);
 
-    strings.emplace_front(name);
-    auto &s = strings.front();
-    s.push_back('=');
-    s.append(value);
-    return PutEnv(s.c_str());
+    return PutEnv(arena.Concat(name, "=", value));
 }
 
 void
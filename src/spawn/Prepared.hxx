@@ -39,9 +39,7 @@
 #include "RefenceOptions.hxx"
 #include "NamespaceOptions.hxx"
 #include "UidGid.hxx"
-
-#include <string>
-#include <forward_list>
+#include "util/Arena.hxx"
 
 #include <assert.h>
 
@@ -145,9 +143,11 @@ struct PreparedChildProcess {
     bool tty = false;
 
     /**
-     * String allocations for SetEnv().
+     * Allocations for SetEnv() and for the objects referenced by
+     * this object (e.g. when deserializing a spawn request); they
+     * are all freed at once with this object.
      */
-    std::forward_list<std::string> strings;
+    Arena arena;
 
     PreparedChildProcess();
     ~PreparedChildProcess();
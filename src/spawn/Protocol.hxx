@@ -89,6 +89,12 @@ enum class SpawnResponseCommand : uint16_t {
     CGROUPS_AVAILABLE,
 
     EXIT,
+
+    /**
+     * Passes a read-only file descriptor referring to the
+     * #SpawnStats shared memory.
+     */
+    STATS,
 };
 
 #endif
@@ -33,46 +33,114 @@
 #include "Registry.hxx"
 #include "ExitListener.hxx"
 #include "util/DeleteDisposer.hxx"
-#include "util/StringFormat.hxx"
+#include "util/StaticFormat.hxx"
 
 #include <string.h>
 #include <errno.h>
 #include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <sys/resource.h>
 
-static constexpr struct timeval child_kill_timeout = {
-    .tv_sec = 60,
-    .tv_usec = 0,
-};
+#ifndef __NR_pidfd_send_signal
+#define __NR_pidfd_send_signal 424
+#endif
+
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434
+#endif
+
+static int
+my_pidfd_open(pid_t pid)
+{
+    return syscall(__NR_pidfd_open, pid, 0);
+}
+
+static int
+my_pidfd_send_signal(int pidfd, int sig)
+{
+    return syscall(__NR_pidfd_send_signal, pidfd, sig, nullptr, 0);
+}
+
+static constexpr std::chrono::seconds child_kill_timeout(60);
 
 static std::string
 MakeChildProcessLogDomain(unsigned pid, const char *name)
 {
-    return StringFormat<64>("spawn:%u:%s", pid, name).c_str();
+    return StaticFormat<64>(STATIC_FORMAT("spawn:{}:{}"), pid, name).c_str();
 }
 
-ChildProcessRegistry::ChildProcess::ChildProcess(EventLoop &_event_loop,
+ChildProcessRegistry::ChildProcess::ChildProcess(ChildProcessRegistry &_registry,
                                                  pid_t _pid, const char *_name,
                                                  ExitListener *_listener)
-    :logger(MakeChildProcessLogDomain(_pid, _name)),
+    :registry(_registry),
+     logger(MakeChildProcessLogDomain(_pid, _name)),
      pid(_pid), name(_name),
-     start_time(std::chrono::steady_clock::now()),
+     start_time(registry.event_loop.SteadyNow()),
      listener(_listener),
-     kill_timeout_event(_event_loop, BIND_THIS_METHOD(KillTimeoutCallback))
+     kill_timeout_event(registry.event_loop,
+                        BIND_THIS_METHOD(KillTimeoutCallback)),
+     pidfd_event(registry.event_loop, BIND_THIS_METHOD(OnPidfdReady))
 {
+    if (registry.use_pidfd) {
+        /* the process cannot be reaped before it has been
+           registered, therefore the pid still refers to it */
+        pidfd = my_pidfd_open(pid);
+        if (pidfd >= 0) {
+            pidfd_event.Set(pidfd, SocketEvent::READ|SocketEvent::PERSIST);
+            pidfd_event.Add();
+        } else if (errno != ENOSYS)
+            logger(2, "pidfd_open() failed: ", strerror(errno));
+    }
+
     logger(5, "added child process");
 }
 
+ChildProcessRegistry::ChildProcess::~ChildProcess()
+{
+    if (pidfd >= 0) {
+        pidfd_event.Delete();
+        close(pidfd);
+    }
+}
+
+int
+ChildProcessRegistry::ChildProcess::SendSignal(int signo)
+{
+    return pidfd >= 0
+        ? my_pidfd_send_signal(pidfd, signo)
+        : kill(pid, signo);
+}
+
 static constexpr double
 timeval_to_double(const struct timeval &tv)
 {
     return tv.tv_sec + tv.tv_usec / 1000000.;
 }
 
+static constexpr uint64_t
+timeval_to_us(const struct timeval &tv)
+{
+    return uint64_t(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+static ChildResourceUsage
+ToChildResourceUsage(const struct rusage &rusage)
+{
+    ChildResourceUsage usage;
+    usage.user_time = timeval_to_us(rusage.ru_utime);
+    usage.system_time = timeval_to_us(rusage.ru_stime);
+    usage.max_rss = rusage.ru_maxrss;
+    usage.in_blocks = rusage.ru_inblock;
+    usage.out_blocks = rusage.ru_oublock;
+    return usage;
+}
+
 void
 ChildProcessRegistry::ChildProcess::OnExit(int status,
-                                           const struct rusage &rusage)
+                                           const struct rusage &rusage,
+                                           std::chrono::steady_clock::time_point now)
 {
     const int exit_status = WEXITSTATUS(status);
     if (WIFSIGNALED(status)) {
@@ -88,7 +156,7 @@ ChildProcessRegistry::ChildProcess::OnExit(int status,
     else
         logger(2, "exited with status ", exit_status);
 
-    const auto duration = std::chrono::steady_clock::now() - start_time;
+    const auto duration = now - start_time;
     const auto duration_f = std::chrono::duration_cast<std::chrono::duration<double>>(duration);
 
     logger.Format(6, "stats: %1.3fs elapsed, %1.3fs user, %1.3fs sys, %ld/%ld faults, %ld/%ld switches",
@@ -98,8 +166,10 @@ ChildProcessRegistry::ChildProcess::OnExit(int status,
                   rusage.ru_minflt, rusage.ru_majflt,
                   rusage.ru_nvcsw, rusage.ru_nivcsw);
 
-    if (listener != nullptr)
+    if (listener != nullptr) {
+        listener->OnChildProcessResourceUsage(ToChildResourceUsage(rusage));
         listener->OnChildProcessExit(status);
+    }
 }
 
 inline void
@@ -107,12 +177,14 @@ ChildProcessRegistry::ChildProcess::KillTimeoutCallback()
 {
     logger(3, "sending SIGKILL to due to timeout");
 
-    if (kill(pid, SIGKILL) < 0)
+    if (SendSignal(SIGKILL) < 0)
         logger(1, "failed to kill child process: ", strerror(errno));
 }
 
 ChildProcessRegistry::ChildProcessRegistry(EventLoop &_event_loop)
     :logger("spawn"), event_loop(_event_loop),
+     children(ChildProcessSet::bucket_traits(&buckets.front(),
+                                             buckets.size())),
      sigchld_event(event_loop, SIGCHLD, BIND_THIS_METHOD(OnSigChld))
 {
     sigchld_event.Enable();
@@ -122,6 +194,7 @@ void
 ChildProcessRegistry::Clear()
 {
     children.clear_and_dispose(DeleteDisposer());
+    n_without_pidfd = 0;
 
     CheckVolatileEvent();
 }
@@ -134,7 +207,9 @@ ChildProcessRegistry::Add(pid_t pid, const char *name, ExitListener *listener)
     if (volatile_event && IsEmpty())
         sigchld_event.Enable();
 
-    auto child = new ChildProcess(event_loop, pid, name, listener);
+    auto child = new ChildProcess(*this, pid, name, listener);
+    if (child->pidfd < 0)
+        ++n_without_pidfd;
 
     children.insert(*child);
 }
@@ -165,7 +240,7 @@ ChildProcessRegistry::Kill(pid_t pid, int signo)
     assert(child->listener != nullptr);
     child->listener = nullptr;
 
-    if (kill(pid, signo) < 0) {
+    if (child->SendSignal(signo) < 0) {
         logger(1, "failed to kill child process: ", strerror(errno));
 
         /* if we can't kill the process, we can't do much, so let's
@@ -177,7 +252,7 @@ ChildProcessRegistry::Kill(pid_t pid, int signo)
         return;
     }
 
-    child->kill_timeout_event.Add(child_kill_timeout);
+    child->kill_timeout_event.Schedule(child_kill_timeout);
 }
 
 void
@@ -196,14 +271,41 @@ ChildProcessRegistry::OnExit(pid_t pid, int status,
 
     auto *child = &*i;
     Remove(i);
-    child->OnExit(status, rusage);
+    child->OnExit(status, rusage, event_loop.SteadyNow());
     delete child;
 }
 
 
+inline void
+ChildProcessRegistry::ChildProcess::OnPidfdReady(unsigned)
+{
+    registry.OnPidfdReady(*this);
+}
+
+inline void
+ChildProcessRegistry::OnPidfdReady(ChildProcess &child)
+{
+    int status;
+    struct rusage rusage;
+
+    /* the pid cannot have been recycled, because we hold a pidfd
+       and the process has not been reaped yet */
+    pid_t pid = wait4(child.pid, &status, WNOHANG, &rusage);
+    if (pid <= 0)
+        return;
+
+    OnExit(pid, status, rusage);
+    CheckVolatileEvent();
+}
+
 void
 ChildProcessRegistry::OnSigChld(int)
 {
+    if (use_pidfd && n_without_pidfd == 0)
+        /* all registered processes are tracked by their pidfd; don't
+           touch anybody else's child processes */
+        return;
+
     pid_t pid;
     int status;
 
@@ -34,15 +34,18 @@
 #define BENG_PROXY_SPAWN_REGISTRY_HXX
 
 #include "io/Logger.hxx"
-#include "event/TimerEvent.hxx"
+#include "event/CoarseTimerEvent.hxx"
 #include "event/SignalEvent.hxx"
+#include "event/SocketEvent.hxx"
 
 #include "util/Compiler.h"
 
-#include <boost/intrusive/set.hpp>
+#include <boost/intrusive/unordered_set.hpp>
 
+#include <array>
 #include <string>
 #include <chrono>
+#include <functional>
 
 #include <assert.h>
 #include <sys/types.h>
@@ -52,11 +55,18 @@ class ExitListener;
 
 /**
  * Multiplexer for SIGCHLD.
+ *
+ * Optionally (see EnablePidfd()), each child process is tracked with
+ * a pidfd, which becomes readable when the process exits.  This
+ * resolves each exit directly to its #ChildProcess, and signals sent
+ * through the pidfd cannot hit a recycled process id.
  */
 class ChildProcessRegistry {
 
     struct ChildProcess
-        : boost::intrusive::set_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
+        : boost::intrusive::unordered_set_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
+
+        ChildProcessRegistry &registry;
 
         const Logger logger;
 
@@ -75,33 +85,67 @@ class ChildProcessRegistry {
         /**
          * This timer is set up by child_kill_signal().  If the child
          * process hasn't exited after a certain amount of time, we send
-         * SIGKILL.
+         * SIGKILL.  It is a coarse timer on the #EventLoop's shared
+         * timer wheel, because it is set up for every killed process
+         * and usually canceled.
+         */
+        CoarseTimerEvent kill_timeout_event;
+
+        /**
+         * A pidfd referring to this process, or -1 if pidfds are
+         * disabled or not supported by the kernel.
          */
-        TimerEvent kill_timeout_event;
+        int pidfd = -1;
+
+        SocketEvent pidfd_event;
 
-        ChildProcess(EventLoop &event_loop,
+        ChildProcess(ChildProcessRegistry &_registry,
                      pid_t _pid, const char *_name,
                      ExitListener *_listener);
 
+        ~ChildProcess();
+
         void Disable() {
             kill_timeout_event.Cancel();
+
+            if (pidfd >= 0)
+                pidfd_event.Delete();
         }
 
-        void OnExit(int status, const struct rusage &rusage);
+        /**
+         * Send a signal, preferably through the pidfd.
+         *
+         * @return 0 on success, -1 on error (with errno set)
+         */
+        int SendSignal(int signo);
+
+        void OnExit(int status, const struct rusage &rusage,
+                    std::chrono::steady_clock::time_point now);
 
         void KillTimeoutCallback();
+        void OnPidfdReady(unsigned events);
 
-        struct Compare {
-            bool operator()(const ChildProcess &a, const ChildProcess &b) const {
-                return a.pid < b.pid;
+        struct Hash {
+            gcc_pure
+            size_t operator()(pid_t pid) const {
+                return std::hash<pid_t>()(pid);
             }
 
-            bool operator()(const ChildProcess &a, pid_t b) const {
-                return a.pid < b;
+            gcc_pure
+            size_t operator()(const ChildProcess &c) const {
+                return std::hash<pid_t>()(c.pid);
+            }
+        };
+
+        struct Equal {
+            gcc_pure
+            bool operator()(const ChildProcess &a, const ChildProcess &b) const {
+                return a.pid == b.pid;
             }
 
+            gcc_pure
             bool operator()(pid_t a, const ChildProcess &b) const {
-                return a < b.pid;
+                return a == b.pid;
             }
         };
     };
@@ -110,9 +154,18 @@ class ChildProcessRegistry {
 
     EventLoop &event_loop;
 
-    typedef boost::intrusive::set<ChildProcess,
-                                  boost::intrusive::compare<ChildProcess::Compare>,
-                                  boost::intrusive::constant_time_size<true>> ChildProcessSet;
+    typedef boost::intrusive::unordered_set<ChildProcess,
+                                            boost::intrusive::hash<ChildProcess::Hash>,
+                                            boost::intrusive::equal<ChildProcess::Equal>,
+                                            boost::intrusive::constant_time_size<true>> ChildProcessSet;
+
+    /**
+     * The number of hash table buckets; rule of thumb: should be
+     * prime.  This is sized for tens of thousands of processes.
+     */
+    static constexpr size_t N_BUCKETS = 8191;
+
+    std::array<ChildProcessSet::bucket_type, N_BUCKETS> buckets;
 
     ChildProcessSet children;
 
@@ -125,6 +178,17 @@ class ChildProcessRegistry {
      */
     bool volatile_event = false;
 
+    /**
+     * Track new child processes with a pidfd?
+     */
+    bool use_pidfd = false;
+
+    /**
+     * The number of registered child processes which don't have a
+     * pidfd.  If this is zero, SIGCHLD can be ignored.
+     */
+    unsigned n_without_pidfd = 0;
+
 public:
     ChildProcessRegistry(EventLoop &loop);
 
@@ -140,6 +204,16 @@ public:
         return children.empty();
     }
 
+    /**
+     * Track child processes added from now on with a pidfd (if the
+     * kernel supports it).  Note that in this mode, only registered
+     * child processes are reaped, unless there are registered
+     * processes without a pidfd.
+     */
+    void EnablePidfd() {
+        use_pidfd = true;
+    }
+
     /**
      * Forget all registered children.  Call this in the new child process
      * after forking.
@@ -184,7 +258,8 @@ public:
 private:
     gcc_pure
     ChildProcessSet::iterator FindByPid(pid_t pid) {
-        return children.find(pid, ChildProcess::Compare());
+        return children.find(pid, ChildProcess::Hash(),
+                             ChildProcess::Equal());
     }
 
     void Remove(ChildProcessSet::iterator i) {
@@ -192,6 +267,11 @@ private:
 
         i->Disable();
 
+        if (i->pidfd < 0) {
+            assert(n_without_pidfd > 0);
+            --n_without_pidfd;
+        }
+
         children.erase(i);
     }
 
@@ -201,6 +281,7 @@ private:
     }
 
     void OnExit(pid_t pid, int status, const struct rusage &rusage);
+    void OnPidfdReady(ChildProcess &child);
     void OnSigChld(int signo);
 };
 
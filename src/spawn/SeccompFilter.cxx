@@ -31,9 +31,34 @@
  */
 
 #include "SeccompFilter.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <linux/seccomp.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
 
 namespace Seccomp {
 
+void
+Program::Load() const
+{
+    struct sock_fprog prog;
+    prog.len = instructions.size();
+    prog.filter = const_cast<struct sock_filter *>(&instructions.front());
+
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) < 0)
+        throw MakeErrno("prctl(PR_SET_NO_NEW_PRIVS) failed");
+
+    if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog, 0, 0) < 0)
+        throw MakeErrno("prctl(PR_SET_SECCOMP) failed");
+}
+
 Filter::Filter(uint32_t def_action)
     :ctx(seccomp_init(def_action))
 {
@@ -57,6 +82,38 @@ Filter::Load() const
         throw MakeErrno(-error, "seccomp_load() failed");
 }
 
+Program
+Filter::Export() const
+{
+    /* libseccomp can only export to a file descriptor */
+    UniqueFileDescriptor fd(FileDescriptor(int(syscall(__NR_memfd_create,
+                                                       "seccomp",
+                                                       MFD_CLOEXEC))));
+    if (!fd.IsDefined())
+        throw MakeErrno("memfd_create() failed");
+
+    int error = seccomp_export_bpf(ctx, fd.Get());
+    if (error < 0)
+        throw MakeErrno(-error, "seccomp_export_bpf() failed");
+
+    off_t size = lseek(fd.Get(), 0, SEEK_END);
+    if (size < 0)
+        throw MakeErrno("lseek() failed");
+
+    if (size == 0 || size % sizeof(struct sock_filter) != 0)
+        throw std::runtime_error("Malformed BPF program");
+
+    std::vector<struct sock_filter> instructions(size / sizeof(struct sock_filter));
+    ssize_t nbytes = pread(fd.Get(), &instructions.front(), size, 0);
+    if (nbytes < 0)
+        throw MakeErrno("Failed to read BPF program");
+
+    if (nbytes != size)
+        throw std::runtime_error("Short read from BPF program");
+
+    return Program(std::move(instructions));
+}
+
 void
 Filter::AddArch(uint32_t arch_token)
 {
@@ -38,9 +38,39 @@
 #include "seccomp.h"
 
 #include <stdexcept>
+#include <vector>
+
+#include <linux/filter.h>
 
 namespace Seccomp {
 
+/**
+ * A BPF program compiled by Filter::Export().  It can be loaded
+ * without libseccomp, e.g. in a child process, without repeating the
+ * compilation for each process.
+ */
+class Program {
+    std::vector<struct sock_filter> instructions;
+
+public:
+    Program() = default;
+
+    explicit Program(std::vector<struct sock_filter> &&_instructions)
+        :instructions(std::move(_instructions)) {}
+
+    bool empty() const {
+        return instructions.empty();
+    }
+
+    /**
+     * Load the program into the current process.  Like
+     * seccomp_load(), this sets PR_SET_NO_NEW_PRIVS first.
+     *
+     * Throws std::system_error on error.
+     */
+    void Load() const;
+};
+
 class Filter {
     const scmp_filter_ctx ctx;
 
@@ -64,6 +94,13 @@ public:
 
     void Load() const;
 
+    /**
+     * Compile the filter to a BPF program.
+     *
+     * Throws std::system_error on error.
+     */
+    Program Export() const;
+
     void AddArch(uint32_t arch_token);
     void AddSecondaryArchs() noexcept;
 
@@ -41,27 +41,44 @@
 #include "CgroupState.hxx"
 #include "Direct.hxx"
 #include "Registry.hxx"
+#include "Zygote.hxx"
+#include "MountNamespaceCache.hxx"
+#include "NetworkNamespaceCache.hxx"
+#include "CgroupCache.hxx"
+#include "PhaseTrace.hxx"
+#include "Stats.hxx"
+#include "AsyncSystemdScope.hxx"
 #include "ExitListener.hxx"
 #include "event/SocketEvent.hxx"
+#include "event/DeferEvent.hxx"
 #include "io/UniqueFileDescriptor.hxx"
 #include "util/DeleteDisposer.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/StaticArray.hxx"
 #include "util/PrintException.hxx"
 #include "util/Exception.hxx"
+#include "util/Trace.h"
+
+#include <systemd/sd-daemon.h>
 
 #include <boost/intrusive/list.hpp>
 
 #include <system_error>
+#include <string>
 #include <algorithm>
+#include <chrono>
+#include <array>
 #include <memory>
 #include <map>
+#include <vector>
 
 #include <unistd.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
 #include <signal.h>
 #include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 
@@ -118,11 +135,33 @@ class SpawnServerChild final : public ExitListener {
 
     const std::string name;
 
+    /**
+     * Received from OnChildProcessResourceUsage(), forwarded to the
+     * client with the EXIT response.
+     */
+    ChildResourceUsage usage;
+
+    SpawnStatsPublisher *const stats;
+
+    /**
+     * The #SpawnStats slot which counts this child, see
+     * SpawnStatsPublisher::OnSpawned().
+     */
+    SpawnStats::Cgroup *const stats_cgroup;
+
 public:
     explicit SpawnServerChild(SpawnServerConnection &_connection,
                               int _id, pid_t _pid,
-                              const char *_name)
-        :connection(_connection), id(_id), pid(_pid), name(_name) {}
+                              const char *_name,
+                              SpawnStatsPublisher *_stats,
+                              SpawnStats::Cgroup *_stats_cgroup)
+        :connection(_connection), id(_id), pid(_pid), name(_name),
+         stats(_stats), stats_cgroup(_stats_cgroup) {}
+
+    ~SpawnServerChild() {
+        if (stats != nullptr)
+            stats->OnExit(stats_cgroup);
+    }
 
     SpawnServerChild(const SpawnServerChild &) = delete;
     SpawnServerChild &operator=(const SpawnServerChild &) = delete;
@@ -136,6 +175,10 @@ public:
     }
 
     /* virtual methods from ExitListener */
+    void OnChildProcessResourceUsage(const ChildResourceUsage &_usage) override {
+        usage = _usage;
+    }
+
     void OnChildProcessExit(int status) override;
 
     /* boost::instrusive::set hooks */
@@ -166,6 +209,36 @@ class SpawnServerConnection
 
     SocketEvent event;
 
+    /**
+     * Flushes #pending_exits.
+     */
+    DeferEvent flush_event;
+
+    /**
+     * A serialized EXIT response: command, id, status, resource
+     * usage.
+     */
+    struct ExitMessage {
+        uint8_t data[1 + 2 * sizeof(int) + sizeof(ChildResourceUsage)];
+
+        ExitMessage(int id, int status, const ChildResourceUsage &usage) {
+            uint8_t *p = data;
+            *p++ = (uint8_t)SpawnResponseCommand::EXIT;
+            memcpy(p, &id, sizeof(id));
+            p += sizeof(id);
+            memcpy(p, &status, sizeof(status));
+            p += sizeof(status);
+            memcpy(p, &usage, sizeof(usage));
+        }
+    };
+
+    /**
+     * EXIT responses which have not been sent yet.  They are
+     * collected and then sent with one sendmmsg() call, see
+     * FlushExits().
+     */
+    std::vector<ExitMessage> pending_exits;
+
     typedef boost::intrusive::set<SpawnServerChild,
                                   boost::intrusive::member_hook<SpawnServerChild,
                                                                 SpawnServerChild::IdHook,
@@ -177,12 +250,35 @@ public:
     SpawnServerConnection(SpawnServerProcess &_process, int _fd);
     ~SpawnServerConnection();
 
-    void OnChildProcessExit(int id, int status, SpawnServerChild *child);
+    void OnChildProcessExit(int id, int status,
+                            const ChildResourceUsage &usage,
+                            SpawnServerChild *child);
+
+    /**
+     * Tell the client that the cgroups feature is available.
+     */
+    void SendCgroupsAvailable();
+
+    /**
+     * Pass the #SpawnStats shared memory to the client.
+     */
+    void SendStats();
 
 private:
     void RemoveConnection();
 
-    void SendExit(int id, int status);
+    void SendExit(int id, int status,
+                  const ChildResourceUsage &usage=ChildResourceUsage());
+
+    /**
+     * Wait until the socket becomes writable.
+     *
+     * @return false on timeout
+     */
+    bool WaitWritable();
+
+    void FlushExits();
+
     void SpawnChild(int id, const char *name, PreparedChildProcess &&p);
 
     void HandleExecMessage(SpawnPayload payload, SpawnFdList &&fds);
@@ -196,22 +292,88 @@ private:
 void
 SpawnServerChild::OnChildProcessExit(int status)
 {
-    connection.OnChildProcessExit(id, status, this);
+    connection.OnChildProcessExit(id, status, usage, this);
 }
 
 void
 SpawnServerConnection::OnChildProcessExit(int id, int status,
+                                          const ChildResourceUsage &usage,
                                           SpawnServerChild *child)
 {
+    TRACE_POINT(spawn_exit, id, status);
+
+    /* this copies the usage, before the child (which owns the
+       referenced object) is deleted */
+    SendExit(id, status, usage);
+
     children.erase(children.iterator_to(*child));
     delete child;
-
-    SendExit(id, status);
 }
 
-class SpawnServerProcess {
+/**
+ * A worker process forked by RunSpawnServer() (see
+ * SpawnConfig::n_workers).  Connections are passed to it with a
+ * CONNECT request over #fd.
+ */
+class SpawnServerWorker final
+    : public ExitListener,
+      public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
+    SpawnServerProcess &process;
+    int fd;
+
+public:
+    SpawnServerWorker(SpawnServerProcess &_process, int _fd)
+        :process(_process), fd(_fd) {}
+
+    ~SpawnServerWorker() {
+        CloseSocket();
+    }
+
+    SpawnServerWorker(const SpawnServerWorker &) = delete;
+    SpawnServerWorker &operator=(const SpawnServerWorker &) = delete;
+
+    bool IsConnected() const {
+        return fd >= 0;
+    }
+
+    /**
+     * Close the socket, which makes the worker exit as soon as its
+     * last connection is closed.
+     */
+    void CloseSocket() {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    /**
+     * Pass a connection to the worker.  The caller still owns the
+     * file descriptor.
+     *
+     * Throws std::system_error on error.
+     */
+    void SendConnection(int connection_fd) {
+        assert(IsConnected());
+
+        static constexpr SpawnRequestCommand cmd = SpawnRequestCommand::CONNECT;
+        ::Send<1>(fd, ConstBuffer<void>(&cmd, sizeof(cmd)),
+                  {&connection_fd, 1});
+    }
+
+    /* virtual methods from ExitListener */
+    void OnChildProcessExit(int status) override;
+};
+
+class SpawnServerProcess final : SystemdScopeHandler {
     const SpawnConfig config;
-    const CgroupState &cgroup_state;
+
+    /**
+     * This is owned by the process because it may be updated when
+     * the systemd scope becomes available, see StartSystemdScope().
+     */
+    CgroupState cgroup_state;
+
     SpawnHook *const hook;
 
     const LLogger logger;
@@ -220,17 +382,85 @@ class SpawnServerProcess {
 
     ChildProcessRegistry child_process_registry;
 
+    SpawnZygotePool zygotes;
+
+    MountNamespaceCache mount_namespaces;
+
+    /**
+     * Only allocated if SpawnConfig::network_namespace_cache is
+     * enabled.
+     */
+    std::unique_ptr<NetworkNamespaceCache> network_namespaces;
+
+    /**
+     * Watches the inotify file descriptor of #network_namespaces.
+     */
+    SocketEvent network_namespaces_event;
+
+    CgroupCache cgroups;
+
+    SpawnPhaseTracer tracer;
+
+    std::unique_ptr<AsyncSystemdScope> systemd_scope;
+
+    /**
+     * Counters for the clients, or nullptr if the shared memory
+     * could not be allocated.
+     */
+    std::unique_ptr<SpawnStatsPublisher> stats;
+
     typedef boost::intrusive::list<SpawnServerConnection,
                                    boost::intrusive::constant_time_size<false>> ConnectionList;
     ConnectionList connections;
 
+    typedef boost::intrusive::list<SpawnServerWorker,
+                                   boost::intrusive::constant_time_size<true>> WorkerList;
+    WorkerList workers;
+
+    /**
+     * Counter for distributing new connections round-robin among the
+     * #workers and this process.
+     */
+    size_t next_worker = 0;
+
 public:
     SpawnServerProcess(const SpawnConfig &_config,
                        const CgroupState &_cgroup_state,
                        SpawnHook *_hook)
         :config(_config), cgroup_state(_cgroup_state), hook(_hook),
          logger("spawn"),
-         child_process_registry(loop) {}
+         child_process_registry(loop),
+         zygotes(child_process_registry, cgroup_state,
+                 config.max_zygotes, config.zygote_threshold),
+         network_namespaces_event(loop,
+                                  BIND_THIS_METHOD(OnNetworkNamespacesInotify)),
+         cgroups(cgroup_state) {
+        if (config.pidfd)
+            child_process_registry.EnablePidfd();
+
+        if (config.network_namespace_cache) {
+            try {
+                network_namespaces.reset(new NetworkNamespaceCache());
+                network_namespaces_event.Set(network_namespaces->GetInotifyFileDescriptor().Get(),
+                                             SocketEvent::READ|SocketEvent::PERSIST);
+                network_namespaces_event.Add();
+            } catch (...) {
+                logger(2, "Failed to create network namespace cache: ",
+                       GetFullMessage(std::current_exception()).c_str());
+            }
+        }
+
+        try {
+            stats.reset(new SpawnStatsPublisher());
+        } catch (...) {
+            logger(2, "Failed to create spawn statistics: ",
+                   GetFullMessage(std::current_exception()).c_str());
+        }
+    }
+
+    ~SpawnServerProcess() {
+        workers.clear_and_dispose(DeleteDisposer());
+    }
 
     const SpawnConfig &GetConfig() const {
         return config;
@@ -248,6 +478,26 @@ public:
         return child_process_registry;
     }
 
+    SpawnZygotePool &GetZygotes() {
+        return zygotes;
+    }
+
+    SpawnChildProcessHelpers GetHelpers() {
+        SpawnChildProcessHelpers helpers;
+        if (config.reuse_mount_namespaces)
+            helpers.mount_namespaces = &mount_namespaces;
+        helpers.network_namespaces = network_namespaces.get();
+        if (config.cgroup_cache)
+            helpers.cgroups = &cgroups;
+        if (config.trace_phases)
+            helpers.tracer = &tracer;
+        return helpers;
+    }
+
+    SpawnStatsPublisher *GetStats() {
+        return stats.get();
+    }
+
     bool Verify(const PreparedChildProcess &p) const {
         return hook != nullptr && hook->Verify(p);
     }
@@ -255,6 +505,24 @@ public:
     void AddConnection(int fd) {
         auto connection = new SpawnServerConnection(*this, fd);
         connections.push_back(*connection);
+        connection->SendStats();
+    }
+
+    /**
+     * Handle a new connection in this process or in one of the
+     * #workers.
+     */
+    void DispatchConnection(int fd);
+
+    void AddWorker(pid_t pid, int fd) {
+        auto *worker = new SpawnServerWorker(*this, fd);
+        workers.push_back(*worker);
+        child_process_registry.Add(pid, "worker", worker);
+    }
+
+    void OnWorkerExit(SpawnServerWorker &worker) {
+        workers.erase_and_dispose(workers.iterator_to(worker),
+                                  DeleteDisposer());
     }
 
     void RemoveConnection(SpawnServerConnection &connection) {
@@ -266,27 +534,139 @@ public:
             Quit();
     }
 
+    /**
+     * Create the systemd scope (see SpawnConfig::systemd_scope)
+     * while already handling requests.  When it is ready, the
+     * #CgroupState is updated and all clients are notified.
+     */
+    void StartSystemdScope(int pid);
+
     void Run();
 
 private:
+    /* virtual methods from class SystemdScopeHandler */
+    void OnSystemdScopeReady(CgroupState &&state) override;
+    void OnSystemdScopeError(std::exception_ptr e) override;
+
+    void OnNetworkNamespacesInotify(unsigned) {
+        network_namespaces->HandleInotifyEvents();
+    }
+
+    void LogPhaseHistograms() {
+        tracer.Collect();
+
+        logger(2, "spawn phases: collected=", tracer.GetCollected(),
+               " dropped=", tracer.GetDropped());
+
+        for (unsigned i = 0; i < unsigned(SpawnPhase::N); ++i)
+            logger(2, tracer.Format(SpawnPhase(i)).c_str());
+    }
+
     void Quit() {
         assert(connections.empty());
 
+        /* let the workers exit after their last connection is
+           closed; they are still registered, so the loop keeps
+           running until they are gone */
+        for (auto &worker : workers)
+            worker.CloseSocket();
+
+        systemd_scope.reset();
+        zygotes.Clear();
+        mount_namespaces.Clear();
+        if (network_namespaces) {
+            network_namespaces_event.Delete();
+            network_namespaces.reset();
+        }
+        cgroups.Clear();
+
+        if (config.trace_phases)
+            LogPhaseHistograms();
+
         child_process_registry.SetVolatile();
     }
 };
 
+void
+SpawnServerProcess::StartSystemdScope(int pid)
+{
+    if (!sd_booted())
+        return;
+
+    try {
+        systemd_scope.reset(new AsyncSystemdScope(loop,
+                                                  config.systemd_scope.c_str(),
+                                                  config.systemd_scope_description.c_str(),
+                                                  pid, true, nullptr,
+                                                  *this));
+    } catch (...) {
+        OnSystemdScopeError(std::current_exception());
+    }
+}
+
+void
+SpawnServerProcess::OnSystemdScopeReady(CgroupState &&state)
+{
+    systemd_scope.reset();
+
+    /* the zygotes and the cgroup cache refer to this object, so
+       update it in place */
+    cgroup_state = std::move(state);
+
+    if (cgroup_state.IsEnabled())
+        for (auto &connection : connections)
+            connection.SendCgroupsAvailable();
+}
+
+void
+SpawnServerProcess::OnSystemdScopeError(std::exception_ptr e)
+{
+    systemd_scope.reset();
+
+    fprintf(stderr, "Failed to create systemd scope: ");
+    PrintException(e);
+}
+
+void
+SpawnServerWorker::OnChildProcessExit(int)
+{
+    process.OnWorkerExit(*this);
+}
+
+void
+SpawnServerProcess::DispatchConnection(int fd)
+{
+    const size_t i = next_worker++ % (workers.size() + 1);
+    if (i < workers.size()) {
+        auto &worker = *std::next(workers.begin(), i);
+        if (worker.IsConnected()) {
+            try {
+                worker.SendConnection(fd);
+                close(fd);
+                return;
+            } catch (...) {
+                logger(2, "Failed to pass connection to worker: ",
+                       GetFullMessage(std::current_exception()).c_str());
+            }
+        }
+    }
+
+    AddConnection(fd);
+}
+
 SpawnServerConnection::SpawnServerConnection(SpawnServerProcess &_process,
                                              int _fd)
     :process(_process), fd(_fd),
      logger("spawn"),
      event(process.GetEventLoop(), fd, SocketEvent::READ|SocketEvent::PERSIST,
-           BIND_THIS_METHOD(ReadEventCallback)) {
+           BIND_THIS_METHOD(ReadEventCallback)),
+     flush_event(process.GetEventLoop(), BIND_THIS_METHOD(FlushExits)) {
     event.Add();
 }
 
 SpawnServerConnection::~SpawnServerConnection()
 {
+    flush_event.Cancel();
     event.Delete();
     close(fd);
 
@@ -304,53 +684,85 @@ SpawnServerConnection::RemoveConnection()
 }
 
 void
-SpawnServerConnection::SendExit(int id, int status)
+SpawnServerConnection::SendExit(int id, int status,
+                                const ChildResourceUsage &usage)
 {
-    SpawnSerializer s(SpawnResponseCommand::EXIT);
-    s.WriteInt(id);
-    s.WriteInt(status);
+    pending_exits.emplace_back(id, status, usage);
+    flush_event.Schedule();
+}
 
-    try {
-        try {
-            ::Send<1>(fd, s);
-        } catch (const std::system_error &e) {
-            if (e.code().category() == std::system_category() &&
-                e.code().value() == EAGAIN) {
-                /* the client may be busy, while the datagram queue
-                   has filled (see /proc/sys/net/unix/max_dgram_qlen);
-                   wait some more before giving up */
-                struct pollfd pfd;
-                pfd.fd = fd;
-                pfd.events = POLLOUT;
-
-                static const struct timespec timeout = {10, 0};
-
-                /* ignore all signals while waiting, or else the poll
-                   may be interrupted too early by the next SIGCHLD */
-                sigset_t signals;
-                sigfillset(&signals);
-
-                if (ppoll(&pfd, 1, &timeout, &signals) > 0) {
-                    /* try again (may throw another exception) */
-                    ::Send<1>(fd, s);
-                    /* yay, it worked! */
-                    return;
-                }
-            }
+bool
+SpawnServerConnection::WaitWritable()
+{
+    /* the client may be busy, while the datagram queue has filled
+       (see /proc/sys/net/unix/max_dgram_qlen); wait some more before
+       giving up */
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+
+    static const struct timespec timeout = {10, 0};
+
+    /* ignore all signals while waiting, or else the poll may be
+       interrupted too early by the next SIGCHLD */
+    sigset_t signals;
+    sigfillset(&signals);
 
-            throw;
+    return ppoll(&pfd, 1, &timeout, &signals) > 0;
+}
+
+void
+SpawnServerConnection::FlushExits()
+{
+    constexpr size_t N = 64;
+    std::array<struct iovec, N> iovs;
+    std::array<struct mmsghdr, N> msgs;
+
+    auto i = pending_exits.begin();
+    while (i != pending_exits.end()) {
+        const size_t n = std::min<size_t>(std::distance(i, pending_exits.end()),
+                                          N);
+
+        for (size_t j = 0; j < n; ++j) {
+            auto &iov = iovs[j];
+            iov.iov_base = i[j].data;
+            iov.iov_len = sizeof(i[j].data);
+
+            auto &msg = msgs[j].msg_hdr;
+            msg.msg_name = nullptr;
+            msg.msg_namelen = 0;
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = nullptr;
+            msg.msg_controllen = 0;
+            msg.msg_flags = 0;
         }
-    } catch (...) {
-        logger(1, "Failed to send EXIT to worker: ",
-               GetFullMessage(std::current_exception()).c_str());
-        RemoveConnection();
+
+        int result = sendmmsg(fd, &msgs.front(), n,
+                              MSG_DONTWAIT|MSG_NOSIGNAL);
+        if (result < 0) {
+            if (errno == EAGAIN && WaitWritable())
+                /* try again */
+                continue;
+
+            logger(1, "Failed to send EXIT to worker: ", strerror(errno));
+            pending_exits.clear();
+            RemoveConnection();
+            return;
+        }
+
+        i += result;
     }
+
+    pending_exits.clear();
 }
 
 inline void
 SpawnServerConnection::SpawnChild(int id, const char *name,
                                   PreparedChildProcess &&p)
 {
+    TRACE_POINT(spawn_request, id, name);
+
     const auto &config = process.GetConfig();
 
     if (!p.uid_gid.IsEmpty()) {
@@ -374,19 +786,40 @@ SpawnServerConnection::SpawnChild(int id, const char *name,
         p.uid_gid = config.default_uid_gid;
     }
 
+    auto *const stats = process.GetStats();
+    const auto start_time = std::chrono::steady_clock::now();
+
+    /* copy the cgroup name before "p" is moved */
+    const std::string cgroup_name(p.cgroup.name != nullptr
+                                  ? p.cgroup.name : "");
+
     pid_t pid;
 
     try {
-        pid = SpawnChildProcess(std::move(p),
-                                process.GetCgroupState());
+        pid = process.GetZygotes().Spawn(p);
+        if (pid < 0)
+            pid = SpawnChildProcess(std::move(p),
+                                    process.GetCgroupState(),
+                                    process.GetHelpers());
     } catch (...) {
         logger(1, "Failed to spawn child process: ",
                GetFullMessage(std::current_exception()).c_str());
+        if (stats != nullptr)
+            stats->OnFailed();
         SendExit(id, W_EXITCODE(0xff, 0));
         return;
     }
 
-    auto *child = new SpawnServerChild(*this, id, pid, name);
+    TRACE_POINT(spawn_forked, id, pid);
+
+    SpawnStats::Cgroup *stats_cgroup = nullptr;
+    if (stats != nullptr)
+        stats_cgroup = stats->OnSpawned(cgroup_name.empty()
+                                        ? nullptr : cgroup_name.c_str(),
+                                        std::chrono::steady_clock::now() - start_time);
+
+    auto *child = new SpawnServerChild(*this, id, pid, name,
+                                       stats, stats_cgroup);
     children.insert(*child);
 
     process.GetChildProcessRegistry().Add(pid, name, child);
@@ -430,10 +863,6 @@ SpawnServerConnection::HandleExecMessage(SpawnPayload payload,
     MountList **mount_tail = &p.ns.mounts;
     assert(*mount_tail == nullptr);
 
-    std::forward_list<MountList> mounts;
-    std::forward_list<std::string> strings;
-    std::forward_list<CgroupOptions::SetItem> cgroup_sets;
-
     while (!payload.IsEmpty()) {
         const SpawnExecCommand cmd = (SpawnExecCommand)payload.ReadByte();
         switch (cmd) {
@@ -539,12 +968,12 @@ SpawnServerConnection::HandleExecMessage(SpawnPayload payload,
                 const char *target = payload.ReadString();
                 bool writable = payload.ReadByte();
                 bool exec = payload.ReadByte();
-                mounts.emplace_front(source, target, false,
-                                     writable, exec);
+                auto *m = p.arena.New<MountList>(source, target, false,
+                                                 writable, exec);
+                *mount_tail = m;
+                mount_tail = &m->next;
             }
 
-            *mount_tail = &mounts.front();
-            mount_tail = &mounts.front().next;
             break;
 
         case SpawnExecCommand::HOSTNAME:
@@ -589,17 +1018,13 @@ SpawnServerConnection::HandleExecMessage(SpawnPayload payload,
 
         case SpawnExecCommand::CGROUP_SET:
             {
-                const char *set_name = payload.ReadString();
-                const char *set_value = payload.ReadString();
-                strings.emplace_front(set_name);
-                set_name = strings.front().c_str();
-                strings.emplace_front(set_value);
-                set_value = strings.front().c_str();
-
-                cgroup_sets.emplace_front(set_name, set_value);
-                auto &set = cgroup_sets.front();
-                set.next = p.cgroup.set_head;
-                p.cgroup.set_head = &set;
+                const char *set_name = p.arena.Dup(payload.ReadString());
+                const char *set_value = p.arena.Dup(payload.ReadString());
+
+                auto *set = p.arena.New<CgroupOptions::SetItem>(set_name,
+                                                                 set_value);
+                set->next = p.cgroup.set_head;
+                p.cgroup.set_head = set;
             }
 
             break;
@@ -660,7 +1085,7 @@ SpawnServerConnection::HandleMessage(ConstBuffer<uint8_t> payload,
         if (!payload.empty() || fds.size() != 1)
             throw MalformedSpawnPayloadError();
 
-        process.AddConnection(fds.Get().Steal());
+        process.DispatchConnection(fds.Get().Steal());
         break;
 
     case SpawnRequestCommand::EXEC:
@@ -694,36 +1119,90 @@ SpawnServerConnection::HandleMessage(const struct msghdr &msg,
 inline void
 SpawnServerConnection::ReadEventCallback(unsigned)
 {
-    uint8_t payload[8192];
-
-    struct iovec iov;
-    iov.iov_base = payload;
-    iov.iov_len = sizeof(payload);
-
-    int fds[32];
-    char ccmsg[CMSG_SPACE(sizeof(fds))];
-    struct msghdr msg = {
-        .msg_name = nullptr,
-        .msg_namelen = 0,
-        .msg_iov = &iov,
-        .msg_iovlen = 1,
-        .msg_control = ccmsg,
-        .msg_controllen = sizeof(ccmsg),
-        .msg_flags = 0,
-    };
+    /* receive a batch of requests with one system call */
+    constexpr size_t N = 8;
+    constexpr size_t MAX_FDS = 32;
+
+    std::array<uint8_t[8192], N> payloads;
+    std::array<char[CMSG_SPACE(MAX_FDS * sizeof(int))], N> ccmsgs;
+    std::array<struct iovec, N> iovs;
+    std::array<struct mmsghdr, N> msgs;
+
+    for (size_t i = 0; i < N; ++i) {
+        auto &iov = iovs[i];
+        iov.iov_base = payloads[i];
+        iov.iov_len = sizeof(payloads[i]);
+
+        auto &msg = msgs[i].msg_hdr;
+        msg.msg_name = nullptr;
+        msg.msg_namelen = 0;
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = ccmsgs[i];
+        msg.msg_controllen = sizeof(ccmsgs[i]);
+        msg.msg_flags = 0;
+    }
 
-    ssize_t nbytes = recvmsg(fd, &msg, MSG_DONTWAIT|MSG_CMSG_CLOEXEC);
-    if (nbytes <= 0) {
-        if (nbytes < 0)
+    int n = recvmmsg(fd, &msgs.front(), msgs.size(),
+                     MSG_DONTWAIT|MSG_CMSG_CLOEXEC, nullptr);
+    if (n <= 0) {
+        if (n < 0)
             logger(2, "recvmsg() failed: ", strerror(errno));
         RemoveConnection();
         return;
     }
 
+    auto *const stats = process.GetStats();
+
+    for (int i = 0; i < n; ++i) {
+        if (msgs[i].msg_len == 0) {
+            /* when the peer closes the socket, recvmmsg() doesn't
+               return 0; instead, it fills the mmsghdr array with
+               empty packets */
+            if (stats != nullptr)
+                stats->SetQueued(0);
+            RemoveConnection();
+            return;
+        }
+
+        if (stats != nullptr)
+            stats->SetQueued(n - i);
+
+        try {
+            HandleMessage(msgs[i].msg_hdr, {payloads[i], msgs[i].msg_len});
+        } catch (MalformedSpawnPayloadError) {
+            logger(3, "Malformed spawn payload");
+        }
+    }
+
+    if (stats != nullptr)
+        stats->SetQueued(0);
+}
+
+void
+SpawnServerConnection::SendCgroupsAvailable()
+{
+    static constexpr auto cmd = SpawnResponseCommand::CGROUPS_AVAILABLE;
+    send(fd, &cmd, sizeof(cmd), MSG_NOSIGNAL);
+}
+
+void
+SpawnServerConnection::SendStats()
+{
+    const auto *stats = process.GetStats();
+    if (stats == nullptr)
+        return;
+
     try {
-        HandleMessage(msg, {payload, size_t(nbytes)});
-    } catch (MalformedSpawnPayloadError) {
-        logger(3, "Malformed spawn payload");
+        auto stats_fd = stats->OpenReadOnly();
+        const int stats_fd_value = stats_fd.Get();
+
+        static constexpr auto cmd = SpawnResponseCommand::STATS;
+        ::Send<1>(fd, ConstBuffer<void>(&cmd, sizeof(cmd)),
+                  {&stats_fd_value, 1});
+    } catch (...) {
+        logger(2, "Failed to send spawn statistics: ",
+               GetFullMessage(std::current_exception()).c_str());
     }
 }
 
@@ -746,7 +1225,62 @@ RunSpawnServer(const SpawnConfig &config, const CgroupState &cgroup_state,
         send(fd, &cmd, sizeof(cmd), MSG_NOSIGNAL);
     }
 
+    /* fork the workers before creating the EventLoop, which must
+       not be shared with them */
+    std::vector<std::pair<pid_t, int>> workers;
+    for (unsigned i = 1; i < config.n_workers; ++i) {
+        int sv[2];
+        if (socketpair(AF_LOCAL, SOCK_SEQPACKET|SOCK_CLOEXEC|SOCK_NONBLOCK,
+                       0, sv) < 0) {
+            fprintf(stderr, "socketpair() failed: %s\n", strerror(errno));
+            break;
+        }
+
+        const pid_t pid = fork();
+        if (pid < 0) {
+            fprintf(stderr, "Failed to fork spawn worker: %s\n",
+                    strerror(errno));
+            close(sv[0]);
+            close(sv[1]);
+            break;
+        }
+
+        if (pid == 0) {
+            /* the worker only receives connections passed by this
+               process */
+            close(sv[0]);
+            close(fd);
+            for (const auto &w : workers)
+                close(w.second);
+
+            {
+                SpawnServerProcess process(config, cgroup_state, hook);
+                process.AddConnection(sv[1]);
+                process.Run();
+            }
+
+            _exit(EXIT_SUCCESS);
+        }
+
+        close(sv[1]);
+        workers.emplace_back(pid, sv[0]);
+    }
+
     SpawnServerProcess process(config, cgroup_state, hook);
+    for (const auto &w : workers)
+        process.AddWorker(w.first, w.second);
+    process.AddConnection(fd);
+    process.Run();
+}
+
+void
+RunSpawnServerAsyncScope(const SpawnConfig &config, SpawnHook *hook,
+                         int fd, int pid)
+{
+    assert(config.n_workers <= 1);
+
+    SpawnServerProcess process(config, CgroupState(), hook);
     process.AddConnection(fd);
+    process.StartSystemdScope(pid);
     process.Run();
 }
@@ -42,4 +42,20 @@ RunSpawnServer(const SpawnConfig &config, const CgroupState &cgroup_state,
                SpawnHook *hook,
                int fd);
 
+/**
+ * Like RunSpawnServer(), but create the systemd scope (see
+ * SpawnConfig::systemd_scope) asynchronously, accepting spawn
+ * requests while systemd is still busy.  Until the scope is ready,
+ * children are spawned without cgroup support.
+ *
+ * This requires SpawnConfig::n_workers<=1, because workers are
+ * forked before the scope is known.
+ *
+ * @param pid the "real" PID of this process to be moved into the
+ * new scope
+ */
+void
+RunSpawnServerAsyncScope(const SpawnConfig &config, SpawnHook *hook,
+                         int fd, int pid);
+
 #endif
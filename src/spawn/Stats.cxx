@@ -0,0 +1,174 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Stats.hxx"
+#include "system/Error.hxx"
+
+#include <new>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+uint32_t
+SpawnStats::GetCgroupRunning(const char *_name) const noexcept
+{
+    const size_t n = n_cgroups.load(std::memory_order_acquire);
+    for (size_t i = 0; i < n; ++i)
+        if (strcmp(cgroups[i].name, _name) == 0)
+            return cgroups[i].running.load(std::memory_order_relaxed);
+
+    return 0;
+}
+
+SpawnStatsPublisher::SpawnStatsPublisher()
+    :fd(FileDescriptor(int(syscall(__NR_memfd_create, "spawn_stats",
+                                   MFD_CLOEXEC))))
+{
+    if (!fd.IsDefined())
+        throw MakeErrno("memfd_create() failed");
+
+    if (ftruncate(fd.Get(), sizeof(*stats)) < 0)
+        throw MakeErrno("ftruncate() failed");
+
+    void *p = mmap(nullptr, sizeof(*stats), PROT_READ|PROT_WRITE,
+                   MAP_SHARED, fd.Get(), 0);
+    if (p == MAP_FAILED)
+        throw MakeErrno("mmap() failed");
+
+    stats = ::new(p) SpawnStats();
+}
+
+SpawnStatsPublisher::~SpawnStatsPublisher()
+{
+    if (stats != nullptr) {
+        stats->~SpawnStats();
+        munmap(stats, sizeof(*stats));
+    }
+}
+
+UniqueFileDescriptor
+SpawnStatsPublisher::OpenReadOnly() const
+{
+    /* reopening via /proc yields a file descriptor which cannot be
+       mapped writable */
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd.Get());
+
+    UniqueFileDescriptor result;
+    if (!result.OpenReadOnly(path))
+        throw FormatErrno("Failed to open %s", path);
+
+    return result;
+}
+
+inline SpawnStats::Cgroup *
+SpawnStatsPublisher::FindCgroup(const char *name) noexcept
+{
+    const size_t n = stats->n_cgroups.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < n; ++i)
+        if (strcmp(stats->cgroups[i].name, name) == 0)
+            return &stats->cgroups[i];
+
+    if (n >= SpawnStats::MAX_CGROUPS ||
+        strlen(name) >= sizeof(stats->cgroups[n].name))
+        return nullptr;
+
+    /* allocate a new slot and publish it after its name has been
+       written */
+    auto &cgroup = stats->cgroups[n];
+    cgroup.running.store(0, std::memory_order_relaxed);
+    strcpy(cgroup.name, name);
+    stats->n_cgroups.store(n + 1, std::memory_order_release);
+    return &cgroup;
+}
+
+SpawnStats::Cgroup *
+SpawnStatsPublisher::OnSpawned(const char *cgroup_name,
+                               std::chrono::steady_clock::duration latency) noexcept
+{
+    stats->spawned.fetch_add(1, std::memory_order_relaxed);
+    stats->running.fetch_add(1, std::memory_order_relaxed);
+
+    const uint32_t us =
+        std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    stats->last_latency_us.store(us, std::memory_order_relaxed);
+
+    /* exponential moving average with a weight of 1/8 */
+    const uint32_t old_average =
+        stats->average_latency_us.load(std::memory_order_relaxed);
+    const uint32_t new_average = old_average > 0
+        ? uint32_t((int64_t(old_average) * 7 + us) / 8)
+        : us;
+    stats->average_latency_us.store(new_average, std::memory_order_relaxed);
+
+    if (cgroup_name == nullptr)
+        return nullptr;
+
+    auto *cgroup = FindCgroup(cgroup_name);
+    if (cgroup != nullptr)
+        cgroup->running.fetch_add(1, std::memory_order_relaxed);
+    return cgroup;
+}
+
+void
+SpawnStatsPublisher::OnExit(SpawnStats::Cgroup *cgroup) noexcept
+{
+    stats->running.fetch_sub(1, std::memory_order_relaxed);
+
+    if (cgroup != nullptr)
+        cgroup->running.fetch_sub(1, std::memory_order_relaxed);
+}
+
+SpawnStatsMapping::SpawnStatsMapping(FileDescriptor fd) noexcept
+{
+    void *p = mmap(nullptr, sizeof(SpawnStats), PROT_READ, MAP_SHARED,
+                   fd.Get(), 0);
+    if (p == MAP_FAILED)
+        return;
+
+    const auto *s = (const SpawnStats *)p;
+    if (s->magic != SpawnStats::MAGIC || s->size != sizeof(*s)) {
+        munmap(p, sizeof(SpawnStats));
+        return;
+    }
+
+    stats = s;
+}
+
+SpawnStatsMapping::~SpawnStatsMapping() noexcept
+{
+    if (stats != nullptr)
+        munmap(const_cast<SpawnStats *>(stats), sizeof(*stats));
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BENG_PROXY_SPAWN_STATS_HXX
+#define BENG_PROXY_SPAWN_STATS_HXX
+
+#include "io/UniqueFileDescriptor.hxx"
+#include "util/Compiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <utility>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Live counters published by the spawner in a shared memory page.
+ * Clients map it read-only (see SpawnServerClient::GetStats()), which
+ * allows them to throttle before the spawner stalls, without a round
+ * trip.
+ *
+ * There is only one writer (the spawner's event loop thread), and
+ * all fields are atomic; readers get a consistent view of each field,
+ * but not of the whole structure.
+ */
+struct SpawnStats {
+    static constexpr uint32_t MAGIC = 0x53535431;
+
+    /**
+     * Allows the client to verify the layout.
+     */
+    uint32_t magic, size;
+
+    /**
+     * The number of requests which have been received by the
+     * spawner, but have not been handled yet.
+     */
+    std::atomic<uint32_t> queued;
+
+    /**
+     * The number of child processes which are currently running.
+     */
+    std::atomic<uint32_t> running;
+
+    std::atomic<uint64_t> spawned, failed;
+
+    /**
+     * The duration of the most recent spawn in microseconds.
+     */
+    std::atomic<uint32_t> last_latency_us;
+
+    /**
+     * A moving average of the spawn duration in microseconds.
+     */
+    std::atomic<uint32_t> average_latency_us;
+
+    static constexpr size_t MAX_CGROUPS = 64;
+
+    struct Cgroup {
+        std::atomic<uint32_t> running;
+
+        /**
+         * Null-terminated.  Written only once, before the slot is
+         * published by incrementing #n_cgroups.
+         */
+        char name[60];
+    };
+
+    /**
+     * The number of valid #cgroups slots.  Child processes in
+     * other cgroups are counted only in #running.
+     */
+    std::atomic<uint32_t> n_cgroups;
+
+    Cgroup cgroups[MAX_CGROUPS];
+
+    SpawnStats() noexcept
+        :magic(MAGIC), size(sizeof(*this)),
+         queued(0), running(0), spawned(0), failed(0),
+         last_latency_us(0), average_latency_us(0), n_cgroups(0) {}
+
+    /**
+     * Look up the number of running children in the given cgroup.
+     * Returns 0 if it is unknown.
+     */
+    gcc_pure
+    uint32_t GetCgroupRunning(const char *name) const noexcept;
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "Shared memory requires lock-free atomics");
+
+/**
+ * The spawner's side of #SpawnStats: allocates the shared memory and
+ * updates the counters.
+ */
+class SpawnStatsPublisher {
+    UniqueFileDescriptor fd;
+
+    SpawnStats *stats = nullptr;
+
+public:
+    /**
+     * Throws on error.
+     */
+    SpawnStatsPublisher();
+    ~SpawnStatsPublisher();
+
+    SpawnStatsPublisher(const SpawnStatsPublisher &) = delete;
+    SpawnStatsPublisher &operator=(const SpawnStatsPublisher &) = delete;
+
+    /**
+     * Open a new read-only file descriptor referring to the shared
+     * memory, to be passed to a client.
+     *
+     * Throws on error.
+     */
+    UniqueFileDescriptor OpenReadOnly() const;
+
+    void SetQueued(unsigned n) noexcept {
+        stats->queued.store(n, std::memory_order_relaxed);
+    }
+
+    /**
+     * A child process has been spawned.
+     *
+     * @param cgroup the name of its cgroup or nullptr
+     * @return the cgroup slot to be passed to OnExit()
+     */
+    SpawnStats::Cgroup *OnSpawned(const char *cgroup,
+                                  std::chrono::steady_clock::duration latency) noexcept;
+
+    void OnFailed() noexcept {
+        stats->failed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void OnExit(SpawnStats::Cgroup *cgroup) noexcept;
+
+private:
+    SpawnStats::Cgroup *FindCgroup(const char *name) noexcept;
+};
+
+/**
+ * The client's side of #SpawnStats: a read-only mapping.
+ */
+class SpawnStatsMapping {
+    const SpawnStats *stats = nullptr;
+
+public:
+    SpawnStatsMapping() = default;
+
+    /**
+     * Map the shared memory received from the spawner.  On error
+     * (e.g. layout mismatch), the mapping remains empty.
+     */
+    explicit SpawnStatsMapping(FileDescriptor fd) noexcept;
+
+    ~SpawnStatsMapping() noexcept;
+
+    SpawnStatsMapping(SpawnStatsMapping &&src) noexcept
+        :stats(src.stats) {
+        src.stats = nullptr;
+    }
+
+    SpawnStatsMapping &operator=(SpawnStatsMapping &&src) noexcept {
+        std::swap(stats, src.stats);
+        return *this;
+    }
+
+    /**
+     * @return the counters or nullptr if none were received
+     */
+    const SpawnStats *Get() const noexcept {
+        return stats;
+    }
+};
+
+#endif
@@ -33,7 +33,10 @@
 #include "SyscallFilter.hxx"
 #include "SeccompFilter.hxx"
 
-#include <set>
+#include "util/FlatSet.hxx"
+
+#include <array>
+#include <memory>
 
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -109,9 +112,9 @@ static constexpr int forbidden_syscalls[] = {
     SCMP_SYS(vm86old),
 };
 
-/* using a std::set to make sure the list is sorted; now if only there
+/* using a FlatSet to make sure the list is sorted; now if only there
    was a way to sort a constexpr array at compile time... */
-static const std::set<scmp_datum_t> allowed_socket_domains = {
+static const FlatSet<scmp_datum_t> allowed_socket_domains = {
     AF_LOCAL, AF_INET, AF_INET6
 };
 
@@ -125,7 +128,7 @@ AddRange(Seccomp::Filter &sf, uint32_t action, int syscall,
 
 static void
 AddInverted(Seccomp::Filter &sf, uint32_t action, int syscall,
-            Seccomp::Arg arg, const std::set<scmp_datum_t> &whitelist)
+            Seccomp::Arg arg, const FlatSet<scmp_datum_t> &whitelist)
 {
     auto i = whitelist.begin();
 
@@ -229,3 +232,32 @@ ForbidBind(Seccomp::Filter &sf)
     sf.AddRule(SCMP_ACT_ERRNO(EACCES), SCMP_SYS(bind));
     sf.AddRule(SCMP_ACT_ERRNO(EACCES), SCMP_SYS(listen));
 }
+
+const Seccomp::Program &
+GetSyscallFilterProgram(bool forbid_user_ns, bool forbid_multicast,
+                        bool forbid_bind)
+{
+    static std::array<std::unique_ptr<Seccomp::Program>, 8> cache;
+
+    auto &program = cache[forbid_user_ns | (forbid_multicast << 1) |
+                          (forbid_bind << 2)];
+    if (!program) {
+        Seccomp::Filter sf(SCMP_ACT_ALLOW);
+        sf.AddSecondaryArchs();
+
+        BuildSyscallFilter(sf);
+
+        if (forbid_user_ns)
+            ForbidUserNamespace(sf);
+
+        if (forbid_multicast)
+            ForbidMulticast(sf);
+
+        if (forbid_bind)
+            ForbidBind(sf);
+
+        program.reset(new Seccomp::Program(sf.Export()));
+    }
+
+    return *program;
+}
@@ -33,7 +33,7 @@
 #ifndef SPAWN_SYSCALL_FILTER_HXX
 #define SPAWN_SYSCALL_FILTER_HXX
 
-namespace Seccomp { class Filter; }
+namespace Seccomp { class Filter; class Program; }
 
 /**
  * Build a standard system call filter.
@@ -63,4 +63,16 @@ ForbidMulticast(Seccomp::Filter &sf);
 void
 ForbidBind(Seccomp::Filter &sf);
 
+/**
+ * Obtain the compiled BPF program of the standard system call filter
+ * (see BuildSyscallFilter()) plus the given options.  Each
+ * combination is compiled only once and then cached for the lifetime
+ * of the process.  This function is not thread-safe.
+ *
+ * Throws std::runtime_error on error.
+ */
+const Seccomp::Program &
+GetSyscallFilterProgram(bool forbid_user_ns, bool forbid_multicast,
+                        bool forbid_bind);
+
 #endif
@@ -211,33 +211,10 @@ WaitUnitRemoved(ODBus::Connection &connection, const char *name,
     }
 }
 
-CgroupState
-CreateSystemdScope(const char *name, const char *description,
-                   int pid, bool delegate, const char *slice)
+ODBus::Message
+MakeStartTransientUnitMessage(const char *name, const char *description,
+                              int pid, bool delegate, const char *slice)
 {
-    if (!sd_booted())
-        return CgroupState();
-
-    ODBus::Error error;
-
-    auto connection = ODBus::Connection::GetSystem();
-
-    const char *match = "type='signal',"
-        "sender='org.freedesktop.systemd1',"
-        "interface='org.freedesktop.systemd1.Manager',"
-        "member='JobRemoved',"
-        "path='/org/freedesktop/systemd1'";
-    const ODBus::ScopeMatch scope_match(connection, match);
-
-    /* the match for WaitUnitRemoved() */
-    const char *unit_removed_match = "type='signal',"
-        "sender='org.freedesktop.systemd1',"
-        "interface='org.freedesktop.systemd1.Manager',"
-        "member='UnitRemoved',"
-        "path='/org/freedesktop/systemd1'";
-    const ODBus::ScopeMatch unit_removed_scope_match(connection,
-                                                     unit_removed_match);
-
     using namespace ODBus;
 
     auto msg = Message::NewMethodCall("org.freedesktop.systemd1",
@@ -270,6 +247,41 @@ CreateSystemdScope(const char *name, const char *description,
                                                                             VariantTypeTraits>>>;
     args.AppendEmptyArray<AuxTypeTraits>();
 
+    return msg;
+}
+
+CgroupState
+CreateSystemdScope(const char *name, const char *description,
+                   int pid, bool delegate, const char *slice)
+{
+    if (!sd_booted())
+        return CgroupState();
+
+    ODBus::Error error;
+
+    auto connection = ODBus::Connection::GetSystem();
+
+    const char *match = "type='signal',"
+        "sender='org.freedesktop.systemd1',"
+        "interface='org.freedesktop.systemd1.Manager',"
+        "member='JobRemoved',"
+        "path='/org/freedesktop/systemd1'";
+    const ODBus::ScopeMatch scope_match(connection, match);
+
+    /* the match for WaitUnitRemoved() */
+    const char *unit_removed_match = "type='signal',"
+        "sender='org.freedesktop.systemd1',"
+        "interface='org.freedesktop.systemd1.Manager',"
+        "member='UnitRemoved',"
+        "path='/org/freedesktop/systemd1'";
+    const ODBus::ScopeMatch unit_removed_scope_match(connection,
+                                                     unit_removed_match);
+
+    using namespace ODBus;
+
+    auto msg = MakeStartTransientUnitMessage(name, description, pid,
+                                             delegate, slice);
+
     auto pending = PendingCall::SendWithReply(connection, msg.Get());
 
     dbus_connection_flush(connection);
@@ -34,6 +34,7 @@
 #define BENG_PROXY_SYSTEMD_HXX
 
 struct CgroupState;
+namespace ODBus { class Message; }
 
 /**
  * Obtain cgroup membership information from the cgroups assigned by
@@ -45,6 +46,19 @@ struct CgroupState;
 CgroupState
 LoadSystemdCgroupState(unsigned pid) noexcept;
 
+/**
+ * Build the "StartTransientUnit" method call which creates a new
+ * systemd scope containing the specified process.
+ *
+ * Throws std::runtime_error on error.
+ *
+ * @param slice create the new scope in this slice (optional)
+ */
+ODBus::Message
+MakeStartTransientUnitMessage(const char *name, const char *description,
+                              int pid, bool delegate=false,
+                              const char *slice=nullptr);
+
 /**
  * Create a new systemd scope and move the current process into it.
  *
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "UidGidCache.hxx"
+
+UidGidCache::UidGidCache(size_t max_items,
+                         Duration _refresh_after, Duration _max_age)
+    :refresh_after(_refresh_after), max_age(_max_age),
+     /* each item costs 1, so the cost budget is the item limit */
+     cache(max_items) {}
+
+UidGidCache::~UidGidCache()
+{
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+        cond.notify_one();
+    }
+
+    if (thread.joinable())
+        thread.join();
+}
+
+UidGid
+UidGidCache::Lookup(const char *username)
+{
+    std::string key(username);
+    const auto now = Expiry::Now();
+
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        auto *item = cache.Get(key, now);
+        if (item != nullptr) {
+            if (!item->refreshing && item->refresh.IsExpired(now)) {
+                item->refreshing = true;
+                ScheduleRefresh(key);
+            }
+
+            return item->value;
+        }
+    }
+
+    /* cache miss: resolve synchronously, without holding the
+       lock */
+    UidGid value;
+    value.Lookup(username);
+
+    Store(std::move(key), value, now);
+    return value;
+}
+
+void
+UidGidCache::Store(std::string &&username, const UidGid &value, Expiry now)
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    cache.Put(std::move(username),
+              Item(value, Expiry::Touched(now, refresh_after)),
+              1, Expiry::Touched(now, max_age));
+}
+
+void
+UidGidCache::ScheduleRefresh(const std::string &username)
+{
+    queue.emplace_back(username);
+
+    if (thread.joinable())
+        cond.notify_one();
+    else
+        thread = std::thread(&UidGidCache::Run, this);
+}
+
+void
+UidGidCache::Run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        cond.wait(lock, [this]{ return quit || !queue.empty(); });
+        if (quit)
+            break;
+
+        std::string username = std::move(queue.front());
+        queue.pop_front();
+
+        lock.unlock();
+
+        const auto now = Expiry::Now();
+        UidGid value;
+        bool success;
+        try {
+            value.Lookup(username.c_str());
+            success = true;
+        } catch (...) {
+            success = false;
+        }
+
+        if (success) {
+            Store(std::move(username), value, now);
+            lock.lock();
+        } else {
+            lock.lock();
+            cache.Remove(username);
+        }
+    }
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BENG_PROXY_SPAWN_UID_GID_CACHE_HXX
+#define BENG_PROXY_SPAWN_UID_GID_CACHE_HXX
+
+#include "UidGid.hxx"
+#include "util/ExpiringCache.hxx"
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+
+/**
+ * Caches the results of UidGid::Lookup(), because with NSS backends
+ * like LDAP or sssd, getpwnam() and getgrouplist() may block for
+ * milliseconds.
+ *
+ * After #refresh_after, an item is still used, but it is refreshed
+ * asynchronously by a worker thread (which is launched on demand).
+ * After #max_age, the item is discarded and the next lookup blocks
+ * again.  If a refresh fails (e.g. because the user has been
+ * deleted), the item is removed, so the next Lookup() reports the
+ * error.  Failed lookups are not cached.
+ *
+ * All public methods are thread-safe.
+ */
+class UidGidCache {
+    typedef std::chrono::steady_clock::duration Duration;
+
+    struct Item {
+        UidGid value;
+
+        /**
+         * When shall this item be refreshed?
+         */
+        Expiry refresh;
+
+        /**
+         * Has this item already been submitted to the worker
+         * thread?
+         */
+        bool refreshing = false;
+
+        Item(const UidGid &_value, Expiry _refresh)
+            :value(_value), refresh(_refresh) {}
+    };
+
+    const Duration refresh_after, max_age;
+
+    /**
+     * Protects all fields below.
+     */
+    std::mutex mutex;
+
+    ExpiringCache<std::string, Item, 1024, 1021> cache;
+
+    /**
+     * User names scheduled for a refresh by the worker thread.
+     */
+    std::deque<std::string> queue;
+
+    std::condition_variable cond;
+
+    bool quit = false;
+
+    std::thread thread;
+
+public:
+    /**
+     * @param max_items the maximum number of cached users (up to
+     * 1024)
+     */
+    explicit UidGidCache(size_t max_items=256,
+                         Duration _refresh_after=std::chrono::minutes(1),
+                         Duration _max_age=std::chrono::minutes(10));
+
+    ~UidGidCache();
+
+    UidGidCache(const UidGidCache &) = delete;
+    UidGidCache &operator=(const UidGidCache &) = delete;
+
+    /**
+     * Like UidGid::Lookup(), but consult the cache first.
+     *
+     * Throws std::runtime_error on error.
+     */
+    UidGid Lookup(const char *username);
+
+    void Clear() {
+        const std::lock_guard<std::mutex> lock(mutex);
+        cache.Clear();
+    }
+
+private:
+    void Store(std::string &&username, const UidGid &value, Expiry now);
+
+    /**
+     * Caller must hold the mutex.
+     */
+    void ScheduleRefresh(const std::string &username);
+
+    void Run();
+};
+
+#endif
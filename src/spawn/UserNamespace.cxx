@@ -88,7 +88,7 @@ SetupGidMap(unsigned pid, unsigned gid, bool root)
 }
 
 void
-SetupGidMap(unsigned pid, const std::set<unsigned> &gids)
+SetupGidMap(unsigned pid, const GidSet &gids)
 {
     assert(!gids.empty());
 
@@ -32,7 +32,18 @@
 
 #pragma once
 
-#include <set>
+#include "util/FlatSet.hxx"
+#include "util/StaticArray.hxx"
+
+#include <functional>
+
+/**
+ * A sorted set of group ids for SetupGidMap().  The capacity is
+ * enough for the primary group, 32 supplementary groups (see
+ * #UidGid) and root.
+ */
+using GidSet = FlatSet<unsigned, std::less<unsigned>,
+                       StaticArray<unsigned, 34>>;
 
 /**
  * Write "deny" to /proc/self/setgroups which is necessary for
@@ -72,4 +83,4 @@ SetupGidMap(unsigned pid, unsigned gid, bool root);
  * @param gids the group ids to be mapped inside the user namespace
  */
 void
-SetupGidMap(unsigned pid, const std::set<unsigned> &gids);
+SetupGidMap(unsigned pid, const GidSet &gids);
@@ -0,0 +1,582 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Zygote.hxx"
+#include "Prepared.hxx"
+#include "Direct.hxx"
+#include "Registry.hxx"
+#include "Protocol.hxx"
+#include "Builder.hxx"
+#include "Parser.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "util/StaticArray.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Exception.hxx"
+
+#include <systemd/sd-journal.h>
+
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+/**
+ * The zygote's end of the control socket.
+ */
+static constexpr int ZYGOTE_FILENO = 3;
+
+/**
+ * How long to wait for the zygote's reply [ms]?
+ */
+static constexpr int ZYGOTE_TIMEOUT = 5000;
+
+/**
+ * When #SpawnZygotePool::counters has grown this large, it is
+ * cleared, to avoid unbounded growth with many rarely used
+ * profiles.
+ */
+static constexpr size_t MAX_COUNTERS = 1024;
+
+/**
+ * A request received by the zygote.
+ */
+struct ZygoteRequest {
+    const char *path = nullptr;
+
+    StaticArray<const char *, 33> args, env;
+
+    int umask = -1;
+
+    const char *stderr_path = nullptr;
+    const char *chdir = nullptr;
+
+    int stdin_fd = -1, stdout_fd = -1, stderr_fd = -1, control_fd = -1;
+};
+
+/**
+ * The new process, forked by the zygote.
+ */
+static int
+ZygoteChildFunction(void *_request)
+{
+    auto &r = *(ZygoteRequest *)_request;
+
+    if (r.umask >= 0)
+        umask(r.umask);
+
+    if (r.stderr_fd < 0 && r.stderr_path != nullptr) {
+        r.stderr_fd = open(r.stderr_path,
+                           O_CREAT|O_WRONLY|O_APPEND|O_CLOEXEC|O_NOCTTY,
+                           0600);
+        if (r.stderr_fd < 0) {
+            perror("Failed to open STDERR_PATH");
+            _exit(EXIT_FAILURE);
+        }
+    }
+
+    if (r.control_fd < 0)
+        /* don't leak the zygote's control socket */
+        close(ZYGOTE_FILENO);
+
+    if (r.stdin_fd >= 0)
+        FileDescriptor(r.stdin_fd).CheckDuplicate(FileDescriptor(STDIN_FILENO));
+    if (r.stdout_fd >= 0)
+        FileDescriptor(r.stdout_fd).CheckDuplicate(FileDescriptor(STDOUT_FILENO));
+    if (r.stderr_fd >= 0)
+        FileDescriptor(r.stderr_fd).CheckDuplicate(FileDescriptor(STDERR_FILENO));
+    if (r.control_fd >= 0)
+        FileDescriptor(r.control_fd).CheckDuplicate(FileDescriptor(ZYGOTE_FILENO));
+
+    setsid();
+
+    if (r.chdir != nullptr && chdir(r.chdir) < 0) {
+        fprintf(stderr, "chdir('%s') failed: %s\n",
+                r.chdir, strerror(errno));
+        _exit(EXIT_FAILURE);
+    }
+
+    execve(r.path, const_cast<char *const*>(r.args.raw()),
+           const_cast<char *const*>(r.env.raw()));
+
+    fprintf(stderr, "failed to execute %s: %s\n", r.path, strerror(errno));
+    _exit(EXIT_FAILURE);
+}
+
+static int
+TakeFd(ConstBuffer<int> &fds)
+{
+    if (fds.empty())
+        throw MalformedSpawnPayloadError();
+
+    return fds.shift();
+}
+
+static void
+ParseZygoteRequest(ZygoteRequest &r, SpawnPayload payload,
+                   ConstBuffer<int> fds)
+{
+    if (payload.IsEmpty() ||
+        (SpawnRequestCommand)payload.ReadByte() != SpawnRequestCommand::EXEC)
+        throw MalformedSpawnPayloadError();
+
+    r.path = payload.ReadString();
+
+    while (!payload.IsEmpty()) {
+        const auto cmd = (SpawnExecCommand)payload.ReadByte();
+        switch (cmd) {
+        case SpawnExecCommand::ARG:
+            if (r.args.size() + 1 >= r.args.capacity())
+                throw MalformedSpawnPayloadError();
+            r.args.push_back(payload.ReadString());
+            break;
+
+        case SpawnExecCommand::SETENV:
+            if (r.env.size() + 1 >= r.env.capacity())
+                throw MalformedSpawnPayloadError();
+            r.env.push_back(payload.ReadString());
+            break;
+
+        case SpawnExecCommand::UMASK:
+            {
+                uint16_t value;
+                payload.ReadT(value);
+                r.umask = value;
+            }
+
+            break;
+
+        case SpawnExecCommand::STDIN:
+            r.stdin_fd = TakeFd(fds);
+            break;
+
+        case SpawnExecCommand::STDOUT:
+            r.stdout_fd = TakeFd(fds);
+            break;
+
+        case SpawnExecCommand::STDERR:
+            r.stderr_fd = TakeFd(fds);
+            break;
+
+        case SpawnExecCommand::STDERR_PATH:
+            r.stderr_path = payload.ReadString();
+            break;
+
+        case SpawnExecCommand::CONTROL:
+            r.control_fd = TakeFd(fds);
+            break;
+
+        case SpawnExecCommand::CHDIR:
+            r.chdir = payload.ReadString();
+            break;
+
+        default:
+            /* everything else has been applied to the zygote
+               already */
+            throw MalformedSpawnPayloadError();
+        }
+    }
+
+    if (r.args.empty())
+        throw MalformedSpawnPayloadError();
+
+    r.args.push_back(nullptr);
+    r.env.push_back(nullptr);
+}
+
+static pid_t
+HandleZygoteRequest(SpawnPayload payload, ConstBuffer<int> fds)
+{
+    ZygoteRequest r;
+    ParseZygoteRequest(r, payload, fds);
+
+    /* CLONE_PARENT makes the new process a sibling of the zygote
+       and thus a child of the spawner, which will reap it */
+    char stack[8192];
+    long pid = clone(ZygoteChildFunction, stack + sizeof(stack),
+                     CLONE_PARENT|SIGCHLD, &r);
+    if (pid < 0)
+        return -errno;
+
+    return pid;
+}
+
+/**
+ * The main loop of the zygote process; it is the
+ * PreparedChildProcess::exec_function and runs after the whole
+ * profile has been applied.
+ */
+static int
+RunZygote(PreparedChildProcess &&)
+{
+    /* close all file descriptors inherited from the spawner (the
+       zygote doesn't call execve(), so O_CLOEXEC doesn't help); this
+       is important for the spawner's end of our control socket,
+       because we wouldn't see EOF otherwise */
+    long max_fd = sysconf(_SC_OPEN_MAX);
+    if (max_fd < 1024)
+        max_fd = 1024;
+    for (int i = ZYGOTE_FILENO + 1; i < max_fd; ++i)
+        close(i);
+
+    while (true) {
+        uint8_t payload[8192];
+
+        struct iovec iov;
+        iov.iov_base = payload;
+        iov.iov_len = sizeof(payload);
+
+        int fds[8];
+        char ccmsg[CMSG_SPACE(sizeof(fds))];
+        struct msghdr msg = {
+            .msg_name = nullptr,
+            .msg_namelen = 0,
+            .msg_iov = &iov,
+            .msg_iovlen = 1,
+            .msg_control = ccmsg,
+            .msg_controllen = sizeof(ccmsg),
+            .msg_flags = 0,
+        };
+
+        ssize_t nbytes = recvmsg(ZYGOTE_FILENO, &msg, MSG_CMSG_CLOEXEC);
+        if (nbytes < 0 && errno == EINTR)
+            continue;
+
+        if (nbytes <= 0)
+            /* the spawner has closed the socket */
+            return EXIT_SUCCESS;
+
+        ConstBuffer<int> received = nullptr;
+        const struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg != nullptr && cmsg->cmsg_level == SOL_SOCKET &&
+            cmsg->cmsg_type == SCM_RIGHTS) {
+            auto data = ConstBuffer<void>(CMSG_DATA(const_cast<struct cmsghdr *>(cmsg)),
+                                          cmsg->cmsg_len - CMSG_LEN(0));
+            received = ConstBuffer<int>::FromVoid(data);
+        }
+
+        int result;
+        try {
+            result = HandleZygoteRequest(SpawnPayload({payload, size_t(nbytes)}),
+                                         received);
+        } catch (MalformedSpawnPayloadError) {
+            result = -EINVAL;
+        }
+
+        for (int fd : received)
+            close(fd);
+
+        if (send(ZYGOTE_FILENO, &result, sizeof(result), MSG_NOSIGNAL) < 0)
+            return EXIT_FAILURE;
+    }
+}
+
+SpawnZygote::~SpawnZygote()
+{
+    close(fd);
+}
+
+pid_t
+SpawnZygote::Spawn(const PreparedChildProcess &p)
+{
+    assert(!p.args.empty());
+
+    /* this is what PreparedChildProcess::Finish() does, but without
+       modifying the object */
+    const char *path = p.exec_path, *arg0 = p.args.front();
+    if (path == nullptr) {
+        path = arg0;
+        const char *slash = strrchr(path, '/');
+        if (slash != nullptr && slash[1] != 0)
+            arg0 = slash + 1;
+    }
+
+    SpawnSerializer s(SpawnRequestCommand::EXEC);
+    s.WriteString(path);
+
+    s.WriteString(SpawnExecCommand::ARG, arg0);
+    for (auto i = std::next(p.args.begin()); i != p.args.end(); ++i)
+        s.WriteString(SpawnExecCommand::ARG, *i);
+
+    for (const char *i : p.env)
+        s.WriteString(SpawnExecCommand::SETENV, i);
+
+    if (p.umask >= 0) {
+        s.Write(SpawnExecCommand::UMASK);
+        s.WriteT(uint16_t(p.umask));
+    }
+
+    s.WriteOptionalString(SpawnExecCommand::STDERR_PATH, p.stderr_path);
+    s.WriteOptionalString(SpawnExecCommand::CHDIR, p.chdir);
+
+    int stdout_fd = p.stdout_fd, stderr_fd = p.stderr_fd;
+
+    /* the zygote may not have access to the journal socket anymore
+       (see Exec()), so the spawner connects to it */
+    UniqueFileDescriptor journal_fd;
+    if (stdout_fd < 0 || (stderr_fd < 0 && p.stderr_path == nullptr)) {
+        int jfd = sd_journal_stream_fd(p.args.front(), LOG_INFO, true);
+        if (jfd >= 0) {
+            journal_fd = UniqueFileDescriptor(FileDescriptor(jfd));
+            if (stdout_fd < 0)
+                stdout_fd = jfd;
+            if (stderr_fd < 0 && p.stderr_path == nullptr)
+                stderr_fd = jfd;
+        }
+    }
+
+    s.CheckWriteFd(SpawnExecCommand::STDIN, p.stdin_fd);
+    s.CheckWriteFd(SpawnExecCommand::STDOUT, stdout_fd);
+    s.CheckWriteFd(SpawnExecCommand::STDERR, stderr_fd);
+    s.CheckWriteFd(SpawnExecCommand::CONTROL, p.control_fd);
+
+    ::Send<8>(fd, s);
+
+    struct pollfd pfd = {
+        .fd = fd,
+        .events = POLLIN,
+        .revents = 0,
+    };
+
+    int n = poll(&pfd, 1, ZYGOTE_TIMEOUT);
+    if (n < 0)
+        throw MakeErrno("poll() failed");
+
+    if (n == 0)
+        throw std::runtime_error("Zygote has timed out");
+
+    int result;
+    ssize_t nbytes = recv(fd, &result, sizeof(result), MSG_DONTWAIT);
+    if (nbytes < 0)
+        throw MakeErrno("Failed to receive from zygote");
+
+    if (nbytes != sizeof(result))
+        throw std::runtime_error("Zygote has closed the connection");
+
+    if (result < 0)
+        throw MakeErrno(-result, "Zygote has failed to spawn");
+
+    return result;
+}
+
+void
+SpawnZygote::OnChildProcessExit(int)
+{
+    pool.OnZygoteExit(*this);
+}
+
+/**
+ * Can this child process be spawned by a zygote?
+ */
+static bool
+IsZygoteCompatible(const PreparedChildProcess &p)
+{
+    /* with a PID namespace, the zygote would be the init process
+       of the namespace, and CLONE_PARENT is not allowed there; TTY
+       setup and exec_function are not implemented by the zygote */
+    return !p.ns.enable_pid && !p.tty && p.exec_function == nullptr &&
+        !p.args.empty();
+}
+
+/**
+ * Build a string identifying everything which is applied to the
+ * zygote (and not per request).
+ */
+static std::string
+MakeZygoteKey(const PreparedChildProcess &p)
+{
+    char buffer[16384];
+    char *q = buffer;
+
+    q = p.cgroup.MakeId(q);
+    q = p.rlimits.MakeId(q);
+    q = p.refence.MakeId(q);
+    q = p.ns.MakeId(q);
+    q = p.uid_gid.MakeId(q);
+
+    if (p.chroot != nullptr) {
+        q = (char *)mempcpy(q, ";cr=", 4);
+        q = stpcpy(q, p.chroot);
+    }
+
+    if (p.priority != 0)
+        q += sprintf(q, ";prio%d", p.priority);
+
+    if (p.sched_idle)
+        q = (char *)mempcpy(q, ";si", 3);
+
+    if (p.ioprio_idle)
+        q = (char *)mempcpy(q, ";ii", 3);
+
+    if (p.forbid_user_ns)
+        q = (char *)mempcpy(q, ";fu", 3);
+
+    if (p.forbid_multicast)
+        q = (char *)mempcpy(q, ";fm", 3);
+
+    if (p.forbid_bind)
+        q = (char *)mempcpy(q, ";fb", 3);
+
+    if (p.no_new_privs)
+        q = (char *)mempcpy(q, ";nnp", 4);
+
+    assert(q < buffer + sizeof(buffer));
+
+    return std::string(buffer, q);
+}
+
+void
+SpawnZygotePool::Clear()
+{
+    while (!zygotes.empty())
+        Kill(zygotes.front());
+
+    counters.clear();
+}
+
+pid_t
+SpawnZygotePool::Spawn(const PreparedChildProcess &p)
+{
+    if (max_zygotes == 0 || !IsZygoteCompatible(p))
+        return -1;
+
+    const auto key = MakeZygoteKey(p);
+
+    auto i = std::find_if(zygotes.begin(), zygotes.end(),
+                          [&key](const SpawnZygote &z){
+                              return z.GetKey() == key;
+                          });
+
+    SpawnZygote *zygote;
+    if (i == zygotes.end()) {
+        if (counters.size() >= MAX_COUNTERS)
+            counters.clear();
+
+        auto c = counters.emplace(key, 0).first;
+        if (++c->second < threshold)
+            return -1;
+
+        counters.erase(c);
+
+        if (zygotes.size() >= max_zygotes)
+            /* evict the least recently used zygote */
+            Kill(zygotes.back());
+
+        try {
+            zygote = &Start(key, p);
+        } catch (...) {
+            logger(2, "Failed to start zygote: ",
+                   GetFullMessage(std::current_exception()).c_str());
+            return -1;
+        }
+    } else {
+        zygote = &*i;
+
+        /* move to the front of the LRU list */
+        zygotes.erase(i);
+        zygotes.push_front(*zygote);
+    }
+
+    try {
+        return zygote->Spawn(p);
+    } catch (...) {
+        logger(2, "Zygote has failed: ",
+               GetFullMessage(std::current_exception()).c_str());
+        Kill(*zygote);
+        return -1;
+    }
+}
+
+SpawnZygote &
+SpawnZygotePool::Start(const std::string &key, const PreparedChildProcess &p)
+{
+    int sv[2];
+    if (socketpair(AF_LOCAL, SOCK_SEQPACKET|SOCK_CLOEXEC, 0, sv) < 0)
+        throw MakeErrno("socketpair() failed");
+
+    UniqueFileDescriptor spawner_fd{FileDescriptor(sv[0])};
+
+    PreparedChildProcess z;
+    z.exec_function = RunZygote;
+    z.args.push_back(p.args.front());
+    z.SetControl(sv[1]);
+
+    z.priority = p.priority;
+    z.cgroup = p.cgroup;
+    z.refence = p.refence;
+    z.ns = p.ns;
+    z.rlimits = p.rlimits;
+    z.uid_gid = p.uid_gid;
+    z.chroot = p.chroot;
+    z.sched_idle = p.sched_idle;
+    z.ioprio_idle = p.ioprio_idle;
+    z.forbid_user_ns = p.forbid_user_ns;
+    z.forbid_multicast = p.forbid_multicast;
+    z.forbid_bind = p.forbid_bind;
+    z.no_new_privs = p.no_new_privs;
+
+    const pid_t pid = SpawnChildProcess(std::move(z), cgroup_state);
+
+    auto *zygote = new SpawnZygote(*this, key, spawner_fd.Steal(), pid);
+    zygotes.push_front(*zygote);
+    registry.Add(pid, "zygote", zygote);
+
+    logger(4, "started zygote ", int(pid));
+
+    return *zygote;
+}
+
+void
+SpawnZygotePool::Kill(SpawnZygote &zygote)
+{
+    zygotes.erase(zygotes.iterator_to(zygote));
+    registry.Kill(zygote.GetPid(), SIGTERM);
+    delete &zygote;
+}
+
+void
+SpawnZygotePool::OnZygoteExit(SpawnZygote &zygote)
+{
+    logger(3, "zygote ", int(zygote.GetPid()), " has exited");
+
+    zygotes.erase(zygotes.iterator_to(zygote));
+    delete &zygote;
+}
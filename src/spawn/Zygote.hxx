@@ -0,0 +1,180 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef BENG_PROXY_SPAWN_ZYGOTE_HXX
+#define BENG_PROXY_SPAWN_ZYGOTE_HXX
+
+#include "ExitListener.hxx"
+#include "io/Logger.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <string>
+#include <map>
+
+#include <sys/types.h>
+
+struct PreparedChildProcess;
+struct CgroupState;
+class ChildProcessRegistry;
+class SpawnZygotePool;
+
+/**
+ * A pre-initialized process for one child process profile (see
+ * SpawnZygotePool).  It has entered all namespaces, applied all
+ * mounts, resource limits, the cgroup, the uid/gid and the seccomp
+ * filter of the profile, and now forks and executes the final
+ * command on request.  The new processes are children of the
+ * spawner (CLONE_PARENT), which reaps them as usual.
+ */
+class SpawnZygote final
+    : public ExitListener,
+      public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
+
+    SpawnZygotePool &pool;
+
+    const std::string key;
+
+    /**
+     * The spawner's end of the socket which is the zygote's
+     * control channel.
+     */
+    const int fd;
+
+    const pid_t pid;
+
+public:
+    SpawnZygote(SpawnZygotePool &_pool, const std::string &_key,
+                int _fd, pid_t _pid)
+        :pool(_pool), key(_key), fd(_fd), pid(_pid) {}
+
+    ~SpawnZygote();
+
+    SpawnZygote(const SpawnZygote &) = delete;
+    SpawnZygote &operator=(const SpawnZygote &) = delete;
+
+    const std::string &GetKey() const {
+        return key;
+    }
+
+    pid_t GetPid() const {
+        return pid;
+    }
+
+    /**
+     * Let the zygote spawn a process.  The caller still owns the
+     * file descriptors in #p.
+     *
+     * Throws exception on error.
+     *
+     * @return the process id
+     */
+    pid_t Spawn(const PreparedChildProcess &p);
+
+    /* virtual methods from ExitListener */
+    void OnChildProcessExit(int status) override;
+};
+
+/**
+ * Manages #SpawnZygote processes for frequently used child process
+ * profiles.  Two child processes share a profile if everything
+ * which is applied before execve() (namespaces, mounts, cgroup,
+ * resource limits, uid/gid, seccomp options) is equal; the key is
+ * made from the MakeId() methods of the options.
+ *
+ * A zygote is started after a profile has been used
+ * SpawnConfig::zygote_threshold times; at most
+ * SpawnConfig::max_zygotes exist, the least recently used one is
+ * killed to make room for a new one.
+ */
+class SpawnZygotePool {
+    friend class SpawnZygote;
+
+    const LLogger logger;
+
+    ChildProcessRegistry &registry;
+    const CgroupState &cgroup_state;
+
+    const unsigned max_zygotes, threshold;
+
+    /**
+     * How often has each profile without a zygote been used?
+     */
+    std::map<std::string, unsigned> counters;
+
+    typedef boost::intrusive::list<SpawnZygote,
+                                   boost::intrusive::constant_time_size<true>> ZygoteList;
+
+    /**
+     * All zygotes, the most recently used one first.
+     */
+    ZygoteList zygotes;
+
+public:
+    SpawnZygotePool(ChildProcessRegistry &_registry,
+                    const CgroupState &_cgroup_state,
+                    unsigned _max_zygotes, unsigned _threshold)
+        :logger("zygote"),
+         registry(_registry), cgroup_state(_cgroup_state),
+         max_zygotes(_max_zygotes), threshold(_threshold) {}
+
+    ~SpawnZygotePool() {
+        Clear();
+    }
+
+    SpawnZygotePool(const SpawnZygotePool &) = delete;
+    SpawnZygotePool &operator=(const SpawnZygotePool &) = delete;
+
+    /**
+     * Kill all zygotes.
+     */
+    void Clear();
+
+    /**
+     * Spawn the child process with a zygote if possible.  Returns
+     * -1 if the caller shall spawn it with SpawnChildProcess(); in
+     * that case, #p is unmodified.
+     */
+    pid_t Spawn(const PreparedChildProcess &p);
+
+private:
+    /**
+     * Throws exception on error.
+     */
+    SpawnZygote &Start(const std::string &key,
+                       const PreparedChildProcess &p);
+
+    void Kill(SpawnZygote &zygote);
+
+    void OnZygoteExit(SpawnZygote &zygote);
+};
+
+#endif
@@ -0,0 +1,469 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AsyncKey.hxx"
+#include "Error.hxx"
+#include "util/WorkStealingPool.hxx"
+
+#include <openssl/async.h>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/ec.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <new>
+
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * A private-key operation being executed by a worker thread.  It
+ * owns copies of all inputs and the output buffer, because the
+ * #SSL (and the async job's stack) may be freed while the worker is
+ * still running.
+ *
+ * There are two references: one held by the worker, and one held
+ * by the paused async job (or by the #ASYNC_WAIT_CTX if the job is
+ * never resumed).
+ */
+class AsyncKeyOperation : public WorkStealingPool::Job {
+	std::atomic<unsigned> refs{2};
+
+	std::atomic<bool> done{false};
+
+	/**
+	 * An eventfd which becomes readable when the operation has
+	 * completed; it is passed to OpenSSL as the async job's wait
+	 * fd.
+	 */
+	const int fd;
+
+	const size_t output_size;
+
+protected:
+	/**
+	 * The output buffer, followed by a copy of the input.
+	 */
+	const std::unique_ptr<unsigned char[]> buffer;
+
+	/**
+	 * The return value of the original key method.
+	 */
+	int result = -1;
+
+	AsyncKeyOperation(const void *input, size_t input_size,
+			  size_t _output_size)
+		:fd(eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC)),
+		 output_size(_output_size),
+		 buffer(new unsigned char[output_size + input_size]) {
+		if (fd < 0)
+			throw std::bad_alloc();
+
+		memcpy(GetInput(), input, input_size);
+	}
+
+	virtual ~AsyncKeyOperation() noexcept {
+		close(fd);
+	}
+
+public:
+	AsyncKeyOperation(const AsyncKeyOperation &) = delete;
+	AsyncKeyOperation &operator=(const AsyncKeyOperation &) = delete;
+
+	void Unref() noexcept {
+		if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			delete this;
+	}
+
+	/**
+	 * Submit this operation to the pool and pause the current
+	 * async job until it has completed.  Throws on error; in
+	 * that case, the worker's reference has been released
+	 * already.
+	 */
+	void Execute(WorkStealingPool &pool, ASYNC_JOB &job);
+
+	int GetResult() const noexcept {
+		return result;
+	}
+
+protected:
+	unsigned char *GetOutput() noexcept {
+		return buffer.get();
+	}
+
+	const unsigned char *GetOutput() const noexcept {
+		return buffer.get();
+	}
+
+	unsigned char *GetInput() noexcept {
+		return buffer.get() + output_size;
+	}
+
+	/**
+	 * Call the original key method; runs in a worker thread.
+	 */
+	virtual void Compute() noexcept = 0;
+
+private:
+	static void WaitFdCleanup(ASYNC_WAIT_CTX *, const void *,
+				  OSSL_ASYNC_FD, void *custom_data) noexcept {
+		auto &op = *(AsyncKeyOperation *)custom_data;
+		op.Unref();
+	}
+
+	void WaitBlocking() noexcept {
+		struct pollfd pfd{fd, POLLIN, 0};
+		while (!done.load(std::memory_order_acquire))
+			poll(&pfd, 1, -1);
+	}
+
+	/* virtual methods from WorkStealingPool::Job */
+	void Run() noexcept override {
+		Compute();
+		done.store(true, std::memory_order_release);
+
+		static constexpr uint64_t one = 1;
+		if (write(fd, &one, sizeof(one)) < 0) {
+			/* cannot happen with an eventfd counter this
+			   small */
+		}
+
+		Unref();
+	}
+};
+
+void
+AsyncKeyOperation::Execute(WorkStealingPool &pool, ASYNC_JOB &job)
+{
+	ASYNC_WAIT_CTX *wait_ctx = ASYNC_get_wait_ctx(&job);
+	if (wait_ctx == nullptr ||
+	    !ASYNC_WAIT_CTX_set_wait_fd(wait_ctx, this, fd, this,
+					WaitFdCleanup)) {
+		refs.fetch_sub(1, std::memory_order_relaxed);
+		throw SslError("ASYNC_WAIT_CTX_set_wait_fd() failed");
+	}
+
+	try {
+		pool.Submit(*this);
+	} catch (...) {
+		/* a freshly added fd is removed without invoking
+		   WaitFdCleanup() */
+		ASYNC_WAIT_CTX_clear_fd(wait_ctx, this);
+		refs.fetch_sub(1, std::memory_order_relaxed);
+		throw;
+	}
+
+	/* from here on, this must not fail, because the worker owns
+	   the buffer until it sets the "done" flag */
+
+	while (!done.load(std::memory_order_acquire)) {
+		if (!ASYNC_pause_job()) {
+			/* cannot pause; block this thread */
+			WaitBlocking();
+			break;
+		}
+
+		/* the job may be resumed before the worker has
+		   finished; pause again */
+	}
+
+	ASYNC_WAIT_CTX_clear_fd(wait_ctx, this);
+}
+
+typedef int (*RsaFunction)(int flen, const unsigned char *from,
+			   unsigned char *to, RSA *rsa, int padding);
+
+class RsaOperation final : public AsyncKeyOperation {
+	const RsaFunction function;
+	RSA &rsa;
+	const int flen, padding;
+
+public:
+	RsaOperation(RsaFunction _function,
+		     int _flen, const unsigned char *from,
+		     RSA &_rsa, int _padding)
+		:AsyncKeyOperation(from, _flen, RSA_size(&_rsa)),
+		 function(_function), rsa(_rsa),
+		 flen(_flen), padding(_padding) {
+		RSA_up_ref(&rsa);
+	}
+
+	void CopyOutput(unsigned char *to) const noexcept {
+		if (result > 0)
+			memcpy(to, GetOutput(), result);
+	}
+
+private:
+	~RsaOperation() noexcept override {
+		RSA_free(&rsa);
+	}
+
+	void Compute() noexcept override {
+		result = function(flen, GetInput(), GetOutput(),
+				  &rsa, padding);
+	}
+};
+
+typedef int (*EcSignFunction)(int type, const unsigned char *dgst, int dlen,
+			      unsigned char *sig, unsigned int *siglen,
+			      const BIGNUM *kinv, const BIGNUM *r,
+			      EC_KEY *eckey);
+
+class EcSignOperation final : public AsyncKeyOperation {
+	const EcSignFunction function;
+	EC_KEY &key;
+	const int type, dlen;
+	unsigned siglen = 0;
+
+public:
+	EcSignOperation(EcSignFunction _function, int _type,
+			const unsigned char *dgst, int _dlen,
+			EC_KEY &_key)
+		:AsyncKeyOperation(dgst, _dlen, ECDSA_size(&_key)),
+		 function(_function), key(_key),
+		 type(_type), dlen(_dlen) {
+		EC_KEY_up_ref(&key);
+	}
+
+	void CopyOutput(unsigned char *sig,
+			unsigned int *siglen_r) const noexcept {
+		if (result > 0) {
+			memcpy(sig, GetOutput(), siglen);
+			*siglen_r = siglen;
+		}
+	}
+
+private:
+	~EcSignOperation() noexcept override {
+		EC_KEY_free(&key);
+	}
+
+	void Compute() noexcept override {
+		result = function(type, GetInput(), dlen,
+				  GetOutput(), &siglen,
+				  nullptr, nullptr, &key);
+	}
+};
+
+}
+
+/**
+ * Run an operation on the pool if we're inside an async job.
+ *
+ * @return the completed operation (the caller must release it with
+ * Unref()) or nullptr if the operation must be performed inline
+ */
+template<typename T, typename... Args>
+static T *
+Offload(WorkStealingPool *pool, Args&&... args) noexcept
+{
+	if (pool == nullptr)
+		return nullptr;
+
+	ASYNC_JOB *job = ASYNC_get_current_job();
+	if (job == nullptr)
+		return nullptr;
+
+	T *op;
+	try {
+		op = new T(std::forward<Args>(args)...);
+	} catch (...) {
+		return nullptr;
+	}
+
+	try {
+		op->Execute(*pool, *job);
+	} catch (...) {
+		op->Unref();
+		return nullptr;
+	}
+
+	return op;
+}
+
+static int rsa_ex_index = -1, ec_ex_index = -1;
+static RSA_METHOD *async_rsa_method;
+static EC_KEY_METHOD *async_ec_method;
+
+template<RsaFunction (*get)(const RSA_METHOD *)>
+static int
+AsyncRsaCall(int flen, const unsigned char *from,
+	     unsigned char *to, RSA *rsa, int padding) noexcept
+{
+	const auto function = get(RSA_PKCS1_OpenSSL());
+	auto *pool = (WorkStealingPool *)RSA_get_ex_data(rsa, rsa_ex_index);
+
+	auto *op = Offload<RsaOperation>(pool, function, flen, from,
+					 *rsa, padding);
+	if (op == nullptr)
+		return function(flen, from, to, rsa, padding);
+
+	op->CopyOutput(to);
+	const int result = op->GetResult();
+	op->Unref();
+	return result;
+}
+
+static int
+AsyncEcSign(int type, const unsigned char *dgst, int dlen,
+	    unsigned char *sig, unsigned int *siglen,
+	    const BIGNUM *kinv, const BIGNUM *r,
+	    EC_KEY *eckey) noexcept
+{
+	EcSignFunction function;
+	EC_KEY_METHOD_get_sign(EC_KEY_OpenSSL(), &function,
+			       nullptr, nullptr);
+
+	auto *pool = (WorkStealingPool *)EC_KEY_get_ex_data(eckey, ec_ex_index);
+
+	/* explicit kinv/r values are only used by tests; compute
+	   those inline */
+	auto *op = kinv == nullptr && r == nullptr
+		? Offload<EcSignOperation>(pool, function, type,
+					   dgst, dlen, *eckey)
+		: nullptr;
+	if (op == nullptr)
+		return function(type, dgst, dlen, sig, siglen,
+				kinv, r, eckey);
+
+	op->CopyOutput(sig, siglen);
+	const int result = op->GetResult();
+	op->Unref();
+	return result;
+}
+
+static void
+InitMethods()
+{
+	static std::once_flag once;
+	std::call_once(once, [](){
+		rsa_ex_index = RSA_get_ex_new_index(0, nullptr, nullptr,
+						    nullptr, nullptr);
+		ec_ex_index = EC_KEY_get_ex_new_index(0, nullptr, nullptr,
+						      nullptr, nullptr);
+
+		async_rsa_method = RSA_meth_dup(RSA_PKCS1_OpenSSL());
+		async_ec_method = EC_KEY_METHOD_new(EC_KEY_OpenSSL());
+		if (rsa_ex_index < 0 || ec_ex_index < 0 ||
+		    async_rsa_method == nullptr || async_ec_method == nullptr)
+			throw SslError("Failed to create async key methods");
+
+		RSA_meth_set1_name(async_rsa_method, "async offload");
+		RSA_meth_set_priv_enc(async_rsa_method,
+				      AsyncRsaCall<RSA_meth_get_priv_enc>);
+		RSA_meth_set_priv_dec(async_rsa_method,
+				      AsyncRsaCall<RSA_meth_get_priv_dec>);
+
+		int (*sign_setup)(EC_KEY *, BN_CTX *, BIGNUM **, BIGNUM **);
+		ECDSA_SIG *(*sign_sig)(const unsigned char *, int,
+				       const BIGNUM *, const BIGNUM *,
+				       EC_KEY *);
+		EC_KEY_METHOD_get_sign(EC_KEY_OpenSSL(), nullptr,
+				       &sign_setup, &sign_sig);
+		EC_KEY_METHOD_set_sign(async_ec_method, AsyncEcSign,
+				       sign_setup, sign_sig);
+	});
+}
+
+static UniqueEVP_PKEY
+MakeAsyncRsaKey(EVP_PKEY &key, WorkStealingPool &pool)
+{
+	UniqueRSA rsa(EVP_PKEY_get1_RSA(&key));
+	if (!rsa)
+		throw SslError("EVP_PKEY_get1_RSA() failed");
+
+	/* copy the key, because changing its method would affect
+	   all users */
+	UniqueRSA copy(RSAPrivateKey_dup(rsa.get()));
+	if (!copy)
+		throw SslError("RSAPrivateKey_dup() failed");
+
+	if (!RSA_set_method(copy.get(), async_rsa_method) ||
+	    !RSA_set_ex_data(copy.get(), rsa_ex_index, &pool))
+		throw SslError("Failed to set up async RSA key");
+
+	UniqueEVP_PKEY result(EVP_PKEY_new());
+	if (!result || !EVP_PKEY_assign_RSA(result.get(), copy.get()))
+		throw SslError("EVP_PKEY_assign_RSA() failed");
+
+	copy.release();
+	return result;
+}
+
+static UniqueEVP_PKEY
+MakeAsyncEcKey(EVP_PKEY &key, WorkStealingPool &pool)
+{
+	UniqueEC_KEY ec(EVP_PKEY_get1_EC_KEY(&key));
+	if (!ec)
+		throw SslError("EVP_PKEY_get1_EC_KEY() failed");
+
+	UniqueEC_KEY copy(EC_KEY_dup(ec.get()));
+	if (!copy)
+		throw SslError("EC_KEY_dup() failed");
+
+	if (!EC_KEY_set_method(copy.get(), async_ec_method) ||
+	    !EC_KEY_set_ex_data(copy.get(), ec_ex_index, &pool))
+		throw SslError("Failed to set up async EC key");
+
+	UniqueEVP_PKEY result(EVP_PKEY_new());
+	if (!result || !EVP_PKEY_assign_EC_KEY(result.get(), copy.get()))
+		throw SslError("EVP_PKEY_assign_EC_KEY() failed");
+
+	copy.release();
+	return result;
+}
+
+UniqueEVP_PKEY
+MakeAsyncKey(EVP_PKEY &key, WorkStealingPool &pool)
+{
+	InitMethods();
+
+	switch (EVP_PKEY_base_id(&key)) {
+	case EVP_PKEY_RSA:
+		return MakeAsyncRsaKey(key, pool);
+
+	case EVP_PKEY_EC:
+		return MakeAsyncEcKey(key, pool);
+
+	default:
+		EVP_PKEY_up_ref(&key);
+		return UniqueEVP_PKEY(&key);
+	}
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Private keys whose operations are offloaded to a thread pool
+ * during asynchronous handshakes.
+ */
+
+#pragma once
+
+#include "Unique.hxx"
+
+class WorkStealingPool;
+
+/**
+ * Create a copy of the given private key whose signing (and RSA
+ * decryption) operations are executed on the given
+ * #WorkStealingPool when they are invoked inside an OpenSSL async
+ * job, i.e. during a handshake on a connection with #SSL_MODE_ASYNC
+ * (see #SslHandshake).  The job is paused (SSL_do_handshake()
+ * returns #SSL_ERROR_WANT_ASYNC) until the worker signals the
+ * completion on a file descriptor which can be polled by the
+ * #EventLoop.
+ *
+ * Outside of an async job, the operations are performed inline.
+ *
+ * Only RSA and EC keys can be offloaded; other key types are
+ * returned unmodified (with an additional reference).
+ *
+ * The pool must outlive the returned key.
+ *
+ * Throws #SslError on error.
+ */
+UniqueEVP_PKEY
+MakeAsyncKey(EVP_PKEY &key, WorkStealingPool &pool);
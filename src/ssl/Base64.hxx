@@ -31,7 +31,7 @@
  */
 
 /*
- * OpenSSL BIO_f_base64() wrapper.
+ * Base64 encoding of OpenSSL objects.
  */
 
 #ifndef SSL_BASE64_HXX
@@ -40,7 +40,10 @@
 #include "MemBio.hxx"
 #include "Unique.hxx"
 #include "Error.hxx"
+#include "util/Base64.hxx"
+#include "util/ScopeExit.hxx"
 
+#include <memory>
 #include <string>
 
 #include <string.h>
@@ -68,9 +71,9 @@ BioWriterToBase64String(W &&writer)
 static inline AllocatedString<>
 Base64(ConstBuffer<void> data)
 {
-	return BioWriterToBase64String([data](BIO &bio){
-			BIO_write(&bio, data.data, data.size);
-		});
+	char *p = new char[CalculateBase64OutputSize(data.size) + 1];
+	p[EncodeBase64(p, data)] = 0;
+	return AllocatedString<>::Donate(p);
 }
 
 static inline AllocatedString<>
@@ -82,20 +85,22 @@ Base64(const std::string &s)
 static inline AllocatedString<>
 Base64(const BIGNUM &bn)
 {
-	return BioWriterToBase64String([&bn](BIO &bio){
-			size_t size = BN_num_bytes(&bn);
-			std::unique_ptr<unsigned char[]> data(new unsigned char[size]);
-			BN_bn2bin(&bn, data.get());
-			BIO_write(&bio, data.get(), size);
-		});
+	size_t size = BN_num_bytes(&bn);
+	std::unique_ptr<unsigned char[]> data(new unsigned char[size]);
+	BN_bn2bin(&bn, data.get());
+	return Base64(ConstBuffer<void>(data.get(), size));
 }
 
 static inline AllocatedString<>
 Base64(X509_REQ &req)
 {
-	return BioWriterToBase64String([&req](BIO &bio){
-			i2d_X509_REQ_bio(&bio, &req);
-		});
+	unsigned char *data = nullptr;
+	const int size = i2d_X509_REQ(&req, &data);
+	if (size < 0)
+		throw SslError("i2d_X509_REQ() failed");
+
+	AtScopeExit(data) { OPENSSL_free(data); };
+	return Base64(ConstBuffer<void>(data, size));
 }
 
 template<typename T>
@@ -114,6 +119,14 @@ UrlSafeBase64(T &&t)
 	return s;
 }
 
+static inline AllocatedString<>
+UrlSafeBase64(ConstBuffer<void> data)
+{
+	char *p = new char[CalculateBase64OutputSize(data.size) + 1];
+	p[EncodeUrlSafeBase64(p, data)] = 0;
+	return AllocatedString<>::Donate(p);
+}
+
 static inline AllocatedString<>
 UrlSafeBase64SHA256(ConstBuffer<void> data)
 {
@@ -0,0 +1,419 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "BulkLoad.hxx"
+#include "system/Error.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/ScopeExit.hxx"
+#include "util/WorkStealingPool.hxx"
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Submit a batch after this many records or bytes, whichever comes
+ * first.
+ */
+static constexpr size_t BATCH_RECORDS = 256;
+static constexpr size_t BATCH_BYTES = 512 * 1024;
+
+namespace {
+
+enum class RecordType : uint8_t {
+	DER,
+
+	/**
+	 * The Base64 body of a PEM block.
+	 */
+	PEM,
+
+	/**
+	 * The Base64 body of a "TRUSTED CERTIFICATE" PEM block
+	 * (with OpenSSL's auxiliary trust information).
+	 */
+	PEM_AUX,
+};
+
+struct Record {
+	const unsigned char *data;
+	size_t size;
+	RecordType type;
+};
+
+class BulkLoadContext;
+
+class Batch final : public WorkStealingPool::Job {
+	BulkLoadContext &context;
+
+public:
+	std::vector<Record> records;
+
+	std::vector<UniqueX509> certificates;
+
+	size_t n_errors = 0, n_bytes = 0;
+
+	explicit Batch(BulkLoadContext &_context) noexcept
+		:context(_context) {
+		records.reserve(BATCH_RECORDS);
+	}
+
+	bool IsFull() const noexcept {
+		return records.size() >= BATCH_RECORDS ||
+			n_bytes >= BATCH_BYTES;
+	}
+
+private:
+	UniqueX509 Decode(const Record &record,
+			  EVP_ENCODE_CTX &ctx,
+			  std::vector<unsigned char> &buffer) noexcept;
+
+	/* virtual methods from WorkStealingPool::Job */
+	void Run() noexcept override;
+};
+
+class BulkLoadContext {
+	std::mutex mutex;
+	std::condition_variable cond;
+	size_t n_running = 0;
+
+public:
+	void Submit(WorkStealingPool &pool, Batch &batch) {
+		{
+			const std::lock_guard<std::mutex> lock(mutex);
+			++n_running;
+		}
+
+		try {
+			pool.Submit(batch);
+		} catch (...) {
+			Finished();
+			throw;
+		}
+	}
+
+	void Finished() noexcept {
+		const std::lock_guard<std::mutex> lock(mutex);
+		if (--n_running == 0)
+			cond.notify_one();
+	}
+
+	void Wait() noexcept {
+		std::unique_lock<std::mutex> lock(mutex);
+		cond.wait(lock, [this]{ return n_running == 0; });
+	}
+};
+
+UniqueX509
+Batch::Decode(const Record &record, EVP_ENCODE_CTX &ctx,
+	      std::vector<unsigned char> &buffer) noexcept
+{
+	const unsigned char *der = record.data;
+	long der_size = record.size;
+
+	if (record.type != RecordType::DER) {
+		/* Base64 decodes to at most 3/4 of its size */
+		buffer.resize(record.size / 4 * 3 + 3);
+
+		int n, n_final;
+		EVP_DecodeInit(&ctx);
+		if (EVP_DecodeUpdate(&ctx, &buffer.front(), &n,
+				     record.data, record.size) < 0 ||
+		    EVP_DecodeFinal(&ctx, &buffer.front() + n,
+				    &n_final) < 0)
+			return nullptr;
+
+		der = &buffer.front();
+		der_size = n + n_final;
+	}
+
+	return UniqueX509(record.type == RecordType::PEM_AUX
+			  ? d2i_X509_AUX(nullptr, &der, der_size)
+			  : d2i_X509(nullptr, &der, der_size));
+}
+
+void
+Batch::Run() noexcept
+{
+	certificates.reserve(records.size());
+
+	EVP_ENCODE_CTX *ctx = EVP_ENCODE_CTX_new();
+	std::vector<unsigned char> buffer;
+
+	for (const auto &record : records) {
+		auto cert = ctx != nullptr
+			? Decode(record, *ctx, buffer)
+			: nullptr;
+		if (cert)
+			certificates.emplace_back(std::move(cert));
+		else
+			++n_errors;
+	}
+
+	EVP_ENCODE_CTX_free(ctx);
+
+	/* errors are reported in the statistics; don't leave them
+	   in this worker's error queue */
+	ERR_clear_error();
+
+	context.Finished();
+}
+
+}
+
+static const unsigned char *
+SkipWhitespace(const unsigned char *p, const unsigned char *end) noexcept
+{
+	while (p < end && (*p == ' ' || *p == '\t' ||
+			   *p == '\r' || *p == '\n'))
+		++p;
+	return p;
+}
+
+/**
+ * Determine the size of the DER SEQUENCE at the given position.
+ *
+ * @return the total size (including the header) or 0 if the record
+ * is malformed or truncated
+ */
+static size_t
+GetDerSize(const unsigned char *p, const unsigned char *end) noexcept
+{
+	if (end - p < 2)
+		return 0;
+
+	size_t length = p[1], header = 2;
+	if (length >= 0x80) {
+		/* long form; certificates are never larger than
+		   4 GB */
+		const size_t n = length & 0x7f;
+		if (n == 0 || n > 4 || size_t(end - p) < 2 + n)
+			return 0;
+
+		length = 0;
+		for (size_t i = 0; i < n; ++i)
+			length = (length << 8) | p[2 + i];
+
+		header += n;
+	}
+
+	if (length > size_t(end - p) - header)
+		return 0;
+
+	return header + length;
+}
+
+static const unsigned char *
+Find(const unsigned char *p, const unsigned char *end,
+     const char *needle, size_t needle_size) noexcept
+{
+	return (const unsigned char *)memmem(p, end - p, needle, needle_size);
+}
+
+static const unsigned char *
+FindLineEnd(const unsigned char *p, const unsigned char *end) noexcept
+{
+	auto *eol = (const unsigned char *)memchr(p, '\n', end - p);
+	return eol != nullptr ? eol + 1 : end;
+}
+
+static bool
+LabelEquals(const unsigned char *label, size_t label_size,
+	    const char *expected) noexcept
+{
+	return label_size == strlen(expected) &&
+		memcmp(label, expected, label_size) == 0;
+}
+
+std::vector<UniqueX509>
+BulkDecodeCertificates(ConstBuffer<void> src, WorkStealingPool &pool,
+		       SslBulkLoadStats *stats)
+{
+	static constexpr char BEGIN[] = "-----BEGIN ";
+	static constexpr char END[] = "-----END ";
+	static constexpr char DASHES[] = "-----";
+
+	const auto start_time = std::chrono::steady_clock::now();
+
+	BulkLoadContext context;
+	std::vector<std::unique_ptr<Batch>> batches;
+	size_t n_records = 0, n_errors = 0;
+
+	/* wait for all submitted batches even if splitting fails */
+	AtScopeExit(&context) { context.Wait(); };
+
+	auto *p = (const unsigned char *)src.data;
+	auto *const end = p + src.size;
+
+	Batch *batch = nullptr;
+
+	while (true) {
+		p = SkipWhitespace(p, end);
+		if (p == end)
+			break;
+
+		Record record;
+
+		if (*p == 0x30) {
+			/* DER SEQUENCE */
+			const size_t size = GetDerSize(p, end);
+			if (size == 0) {
+				/* the rest of the input cannot be split */
+				++n_records;
+				++n_errors;
+				break;
+			}
+
+			record = {p, size, RecordType::DER};
+			p += size;
+		} else {
+			p = Find(p, end, BEGIN, sizeof(BEGIN) - 1);
+			if (p == nullptr)
+				break;
+
+			const auto *label = p + sizeof(BEGIN) - 1;
+			const auto *label_end = Find(label, end, DASHES,
+						     sizeof(DASHES) - 1);
+			if (label_end == nullptr)
+				break;
+
+			const auto *body = FindLineEnd(label_end, end);
+			const auto *body_end = Find(body, end,
+						    END, sizeof(END) - 1);
+			if (body_end == nullptr) {
+				++n_records;
+				++n_errors;
+				break;
+			}
+
+			p = FindLineEnd(body_end, end);
+
+			const size_t label_size = label_end - label;
+			if (LabelEquals(label, label_size, "CERTIFICATE") ||
+			    LabelEquals(label, label_size, "X509 CERTIFICATE"))
+				record = {body, size_t(body_end - body),
+					  RecordType::PEM};
+			else if (LabelEquals(label, label_size,
+					     "TRUSTED CERTIFICATE"))
+				record = {body, size_t(body_end - body),
+					  RecordType::PEM_AUX};
+			else
+				/* not a certificate */
+				continue;
+		}
+
+		if (batch == nullptr) {
+			batches.emplace_back(new Batch(context));
+			batch = batches.back().get();
+		}
+
+		batch->records.push_back(record);
+		batch->n_bytes += record.size;
+		++n_records;
+
+		if (batch->IsFull()) {
+			context.Submit(pool, *batch);
+			batch = nullptr;
+		}
+	}
+
+	if (batch != nullptr)
+		context.Submit(pool, *batch);
+
+	context.Wait();
+
+	std::vector<UniqueX509> result;
+	result.reserve(n_records);
+
+	for (auto &i : batches) {
+		n_errors += i->n_errors;
+		for (auto &cert : i->certificates)
+			result.emplace_back(std::move(cert));
+	}
+
+	if (stats != nullptr) {
+		stats->n_records = n_records;
+		stats->n_errors = n_errors;
+		stats->n_bytes = src.size;
+		stats->duration = std::chrono::steady_clock::now() - start_time;
+	}
+
+	return result;
+}
+
+std::vector<UniqueX509>
+BulkLoadCertificates(const char *path, WorkStealingPool &pool,
+		     SslBulkLoadStats *stats)
+{
+	const auto start_time = std::chrono::steady_clock::now();
+
+	const int fd = open(path, O_RDONLY|O_CLOEXEC|O_NOCTTY);
+	if (fd < 0)
+		throw FormatErrno("Failed to open %s", path);
+
+	AtScopeExit(fd) { close(fd); };
+
+	struct stat st;
+	if (fstat(fd, &st) < 0)
+		throw FormatErrno("Failed to stat %s", path);
+
+	if (st.st_size == 0) {
+		if (stats != nullptr)
+			*stats = SslBulkLoadStats();
+		return {};
+	}
+
+	const size_t size = st.st_size;
+	void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		throw FormatErrno("Failed to map %s", path);
+
+	AtScopeExit(map, size) { munmap(map, size); };
+
+	/* records are split front to back */
+	madvise(map, size, MADV_SEQUENTIAL);
+
+	auto result = BulkDecodeCertificates({map, size}, pool, stats);
+	if (stats != nullptr)
+		stats->duration = std::chrono::steady_clock::now() - start_time;
+	return result;
+}
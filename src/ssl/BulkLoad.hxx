@@ -0,0 +1,112 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Decode large files of certificates on a thread pool.
+ */
+
+#pragma once
+
+#include "Unique.hxx"
+
+#include <chrono>
+#include <vector>
+
+#include <stddef.h>
+
+template<typename T> struct ConstBuffer;
+class WorkStealingPool;
+
+struct SslBulkLoadStats {
+	/**
+	 * The number of certificate records found in the input.
+	 */
+	size_t n_records = 0;
+
+	/**
+	 * The number of records which could not be decoded; they are
+	 * omitted from the result.
+	 */
+	size_t n_errors = 0;
+
+	/**
+	 * The size of the input.
+	 */
+	size_t n_bytes = 0;
+
+	/**
+	 * The wall-clock time spent in the loader, including mapping
+	 * the file.
+	 */
+	std::chrono::steady_clock::duration duration{};
+
+	double GetSeconds() const noexcept {
+		return std::chrono::duration<double>(duration).count();
+	}
+
+	double GetRecordsPerSecond() const noexcept {
+		const double s = GetSeconds();
+		return s > 0 ? n_records / s : 0;
+	}
+
+	double GetBytesPerSecond() const noexcept {
+		const double s = GetSeconds();
+		return s > 0 ? n_bytes / s : 0;
+	}
+};
+
+/**
+ * Decode a buffer of concatenated certificates.  Each record may be
+ * DER (a bare ASN.1 SEQUENCE) or PEM ("CERTIFICATE", "X509
+ * CERTIFICATE" or "TRUSTED CERTIFICATE"), and both may be mixed.
+ * Text outside of PEM blocks and other PEM types (e.g. keys) are
+ * ignored.
+ *
+ * The calling thread splits the input into records and submits
+ * them in batches to the #WorkStealingPool, which decodes them in
+ * parallel.  The certificates are returned in input order.
+ *
+ * Throws on error; records which fail to decode are only counted in
+ * SslBulkLoadStats::n_errors.
+ */
+std::vector<UniqueX509>
+BulkDecodeCertificates(ConstBuffer<void> src, WorkStealingPool &pool,
+		       SslBulkLoadStats *stats=nullptr);
+
+/**
+ * Map a file and decode it with BulkDecodeCertificates().
+ *
+ * Throws on error.
+ */
+std::vector<UniqueX509>
+BulkLoadCertificates(const char *path, WorkStealingPool &pool,
+		     SslBulkLoadStats *stats=nullptr);
@@ -0,0 +1,255 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CertStore.hxx"
+#include "AltName.hxx"
+#include "Name.hxx"
+#include "Error.hxx"
+#include "Unique.hxx"
+#include "util/CharUtil.hxx"
+
+#include <openssl/err.h>
+#include <openssl/pem.h>
+
+#include <sys/stat.h>
+
+static std::string
+ToLower(const char *s)
+{
+	std::string result(s);
+	for (auto &ch : result)
+		ch = ToLowerASCII(ch);
+
+	/* ignore the trailing dot of an absolute name */
+	if (!result.empty() && result.back() == '.')
+		result.pop_back();
+
+	return result;
+}
+
+static size_t
+GetFileSize(const std::string &path)
+{
+	struct stat st;
+	return stat(path.c_str(), &st) == 0 ? size_t(st.st_size) : 0;
+}
+
+/**
+ * Load a certificate from a PEM or DER file.
+ */
+static UniqueX509
+LoadCertificate(const std::string &path)
+{
+	UniqueBIO bio(BIO_new_file(path.c_str(), "r"));
+	if (!bio)
+		throw SslError("Failed to open " + path);
+
+	UniqueX509 cert(PEM_read_bio_X509(bio.get(), nullptr, nullptr, nullptr));
+	if (!cert) {
+		ERR_clear_error();
+		BIO_reset(bio.get());
+		cert.reset(d2i_X509_bio(bio.get(), nullptr));
+		if (!cert)
+			throw SslError("Failed to read certificate from " + path);
+	}
+
+	return cert;
+}
+
+SslCertStore::SslCertStore(CtxFactory _factory, size_t _max_memory)
+	:factory(std::move(_factory)), max_memory(_max_memory) {}
+
+void
+SslCertStore::Add(std::string cert_path, std::string key_path,
+		  const std::forward_list<std::string> &host_names)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	entries.emplace_front(std::move(cert_path), std::move(key_path));
+	++n_entries;
+
+	Entry &entry = entries.front();
+	for (const auto &i : host_names)
+		names.emplace(ToLower(i.c_str()), &entry);
+}
+
+void
+SslCertStore::AddFile(std::string cert_path, std::string key_path)
+{
+	auto cert = LoadCertificate(cert_path);
+
+	auto host_names = GetSubjectAltNames(*cert);
+
+	const auto common_name = GetCommonName(*cert);
+	if (!common_name.IsNull())
+		host_names.emplace_front(common_name.c_str());
+
+	Add(std::move(cert_path), std::move(key_path), host_names);
+}
+
+SslCertStore::Entry *
+SslCertStore::Lookup(const char *_host) const
+{
+	const std::string host = ToLower(_host);
+
+	auto i = names.find(host);
+	if (i != names.end())
+		return i->second;
+
+	/* a wildcard matches exactly one label (RFC 6125 6.4.3) */
+	const auto dot = host.find('.');
+	if (dot == 0 || dot == std::string::npos)
+		return nullptr;
+
+	i = names.find("*" + host.substr(dot));
+	if (i != names.end())
+		return i->second;
+
+	return nullptr;
+}
+
+SslCtx
+SslCertStore::Load(const Entry &entry) const
+{
+	SslCtx ctx = factory();
+
+	if (SSL_CTX_use_certificate_chain_file(ctx.get(),
+					       entry.cert_path.c_str()) != 1) {
+		ERR_clear_error();
+		if (SSL_CTX_use_certificate_file(ctx.get(),
+						 entry.cert_path.c_str(),
+						 SSL_FILETYPE_ASN1) != 1)
+			throw SslError("Failed to load certificate from " +
+				       entry.cert_path);
+	}
+
+	if (SSL_CTX_use_PrivateKey_file(ctx.get(), entry.key_path.c_str(),
+					SSL_FILETYPE_PEM) != 1) {
+		ERR_clear_error();
+		if (SSL_CTX_use_PrivateKey_file(ctx.get(),
+						entry.key_path.c_str(),
+						SSL_FILETYPE_ASN1) != 1)
+			throw SslError("Failed to load key from " +
+				       entry.key_path);
+	}
+
+	if (SSL_CTX_check_private_key(ctx.get()) != 1)
+		throw SslError("Key " + entry.key_path +
+			       " does not match certificate " +
+			       entry.cert_path);
+
+	return ctx;
+}
+
+void
+SslCertStore::Unload(Entry &entry)
+{
+	lru.erase(lru.iterator_to(entry));
+	memory -= entry.cost;
+	entry.ctx.reset();
+}
+
+SslCtx
+SslCertStore::Get(const char *host)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Entry *entry = Lookup(host);
+	if (entry == nullptr || entry->failed)
+		return SslCtx();
+
+	if (entry->ctx) {
+		/* move to the front of the LRU list */
+		lru.erase(lru.iterator_to(*entry));
+		lru.push_front(*entry);
+		return entry->ctx;
+	}
+
+	try {
+		entry->ctx = Load(*entry);
+	} catch (...) {
+		entry->failed = true;
+		throw;
+	}
+
+	entry->cost = CTX_OVERHEAD
+		+ 2 * (GetFileSize(entry->cert_path) + GetFileSize(entry->key_path));
+	memory += entry->cost;
+	lru.push_front(*entry);
+
+	while (memory > max_memory && lru.size() > 1)
+		Unload(lru.back());
+
+	return entry->ctx;
+}
+
+void
+SslCertStore::Flush()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	while (!lru.empty())
+		Unload(lru.front());
+
+	for (auto &entry : entries)
+		entry.failed = false;
+}
+
+int
+SslCertStore::SniCallback(SSL *ssl, int *al, void *arg)
+{
+	auto &store = *(SslCertStore *)arg;
+
+	const char *host = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+	if (host == nullptr)
+		return SSL_TLSEXT_ERR_NOACK;
+
+	try {
+		const auto ctx = store.Get(host);
+		if (!ctx)
+			return SSL_TLSEXT_ERR_NOACK;
+
+		SSL_set_SSL_CTX(ssl, ctx.get());
+	} catch (...) {
+		*al = SSL_AD_INTERNAL_ERROR;
+		return SSL_TLSEXT_ERR_ALERT_FATAL;
+	}
+
+	return SSL_TLSEXT_ERR_OK;
+}
+
+void
+SslCertStore::InstallSniCallback(SSL_CTX &ssl_ctx)
+{
+	SSL_CTX_set_tlsext_servername_callback(&ssl_ctx, SniCallback);
+	SSL_CTX_set_tlsext_servername_arg(&ssl_ctx, this);
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * A store for a large number of server certificates, selected by
+ * SNI.
+ */
+
+#pragma once
+
+#include "Ctx.hxx"
+#include "util/Compiler.h"
+
+#include <boost/intrusive/list.hpp>
+
+#include <forward_list>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Indexes certificate/key file pairs by host name (exact and
+ * wildcard, e.g. "*.example.com"), but does not load them.  The
+ * #SSL_CTX for a certificate is built on the first handshake
+ * requesting one of its names.  Hot contexts are kept in an LRU list
+ * whose approximate memory usage is capped; evicted contexts are
+ * rebuilt on demand.
+ *
+ * This class is thread-safe: the SNI callback may be invoked from
+ * handshakes running in worker threads.
+ */
+class SslCertStore {
+public:
+	/**
+	 * Creates a new #SSL_CTX with all server settings (protocols,
+	 * ciphers, ALPN, session cache), but without a certificate.
+	 * May throw.
+	 */
+	typedef std::function<SslCtx()> CtxFactory;
+
+private:
+	/**
+	 * A rough estimate of the memory used by an #SSL_CTX without
+	 * its certificate and key; each context is accounted with
+	 * this plus twice the size of its files.
+	 */
+	static constexpr size_t CTX_OVERHEAD = 16384;
+
+	struct Entry {
+		typedef boost::intrusive::list_member_hook<boost::intrusive::link_mode<boost::intrusive::safe_link>> LruHook;
+		LruHook lru_hook;
+
+		const std::string cert_path, key_path;
+
+		SslCtx ctx;
+
+		/**
+		 * The accounted memory of #ctx (if it is set).
+		 */
+		size_t cost;
+
+		/**
+		 * Set if loading has failed; this entry will not be
+		 * retried until Flush() is called, to avoid loading a
+		 * broken file on every handshake.
+		 */
+		bool failed = false;
+
+		Entry(std::string &&_cert_path, std::string &&_key_path)
+			:cert_path(std::move(_cert_path)),
+			 key_path(std::move(_key_path)) {}
+	};
+
+	typedef boost::intrusive::list<Entry,
+				       boost::intrusive::member_hook<Entry,
+								     Entry::LruHook,
+								     &Entry::lru_hook>,
+				       boost::intrusive::constant_time_size<true>> LruList;
+
+	const CtxFactory factory;
+
+	const size_t max_memory;
+
+	mutable std::mutex mutex;
+
+	/**
+	 * All certificates; a std::forward_list because entry
+	 * addresses must be stable.
+	 */
+	std::forward_list<Entry> entries;
+	size_t n_entries = 0;
+
+	/**
+	 * Maps lower-case host names and wildcard patterns to
+	 * #entries.
+	 */
+	std::unordered_map<std::string, Entry *> names;
+
+	/**
+	 * Entries with a loaded #SSL_CTX; the most recently used one
+	 * is at the front.
+	 */
+	LruList lru;
+
+	size_t memory = 0;
+
+public:
+	/**
+	 * @param max_memory the approximate upper limit for the memory
+	 * used by loaded contexts; at least one context is kept
+	 * regardless
+	 */
+	SslCertStore(CtxFactory _factory, size_t _max_memory);
+
+	SslCertStore(const SslCertStore &) = delete;
+	SslCertStore &operator=(const SslCertStore &) = delete;
+
+	/**
+	 * Register a certificate under the given names without
+	 * loading it.  If a name is already registered, the first
+	 * certificate keeps it.
+	 *
+	 * @param cert_path a PEM file (certificate followed by its
+	 * chain) or a DER file with just the certificate
+	 * @param key_path the private key (PEM or DER)
+	 */
+	void Add(std::string cert_path, std::string key_path,
+		 const std::forward_list<std::string> &host_names);
+
+	/**
+	 * Like Add(), but read the names (common name and DNS
+	 * subjectAltNames) from the certificate.  Only the certificate
+	 * is parsed; the key is not touched.
+	 *
+	 * Throws SslError on error.
+	 */
+	void AddFile(std::string cert_path, std::string key_path);
+
+	/**
+	 * Find the context for the given host name, loading it if
+	 * necessary.
+	 *
+	 * @return the context or an empty #SslCtx if there is no
+	 * matching certificate or if loading has failed
+	 */
+	SslCtx Get(const char *host);
+
+	/**
+	 * Install a SNI callback in the given (default) context which
+	 * switches each connection to the matching context from this
+	 * store.  Connections without a matching name stay on the
+	 * default context.  This object must outlive the context.
+	 */
+	void InstallSniCallback(SSL_CTX &ssl_ctx);
+
+	/**
+	 * Unload all contexts, e.g. after certificate files have been
+	 * replaced.  Connections still using a context keep their
+	 * reference.
+	 */
+	void Flush();
+
+	gcc_pure
+	size_t GetCertificateCount() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		return n_entries;
+	}
+
+	gcc_pure
+	size_t GetLoadedCount() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		return lru.size();
+	}
+
+	gcc_pure
+	size_t GetMemoryUsage() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		return memory;
+	}
+
+private:
+	gcc_pure
+	Entry *Lookup(const char *host) const;
+
+	SslCtx Load(const Entry &entry) const;
+
+	void Unload(Entry &entry);
+
+	static int SniCallback(SSL *ssl, int *al, void *arg);
+};
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CertificateInfo.hxx"
+#include "Buffer.hxx"
+#include "Name.hxx"
+#include "AltName.hxx"
+#include "Error.hxx"
+
+#include <openssl/x509.h>
+
+#include <time.h>
+
+static std::chrono::system_clock::time_point
+ToTimePoint(const ASN1_TIME *t)
+{
+	if (t == nullptr)
+		throw SslError("Certificate without validity");
+
+	struct tm tm;
+	if (!ASN1_TIME_to_tm(t, &tm))
+		throw SslError("Malformed certificate validity");
+
+	return std::chrono::system_clock::from_time_t(timegm(&tm));
+}
+
+CertificateInfo::CertificateInfo(UniqueX509 &&_cert)
+	:cert(std::move(_cert)),
+	 common_name(::GetCommonName(*cert)),
+	 issuer_common_name(::GetIssuerCommonName(*cert)),
+	 alt_names(::GetSubjectAltNames(*cert))
+{
+	{
+		const SslBuffer der(*cert);
+		sha1 = CalcSHA1(der.get());
+		sha256 = CalcSHA256(der.get());
+	}
+
+	spki_sha256 = CalcSpkiSHA256(*cert);
+
+	subject_sha1 = CalcSHA1(*X509_get_subject_name(cert.get()));
+	issuer_sha1 = CalcSHA1(*X509_get_issuer_name(cert.get()));
+
+	not_before = ToTimePoint(X509_get0_notBefore(cert.get()));
+	not_after = ToTimePoint(X509_get0_notAfter(cert.get()));
+}
+
+static UniqueX509
+Share(X509 &cert)
+{
+	X509_up_ref(&cert);
+	return UniqueX509(&cert);
+}
+
+CertificateInfo::CertificateInfo(X509 &_cert)
+	:CertificateInfo(Share(_cert)) {}
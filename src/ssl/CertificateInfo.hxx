@@ -0,0 +1,170 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Unique.hxx"
+#include "Hash.hxx"
+#include "util/AllocatedString.hxx"
+#include "util/Compiler.h"
+
+#include <chrono>
+#include <forward_list>
+#include <string>
+
+/**
+ * Wraps a #X509 certificate and caches the attributes which are
+ * often needed when managing many certificates: fingerprints, the
+ * public key digest, names and validity.  All of them are computed
+ * once in the constructor, so the getters are cheap.
+ */
+class CertificateInfo {
+	UniqueX509 cert;
+
+	/**
+	 * Fingerprints of the DER-encoded certificate.
+	 */
+	SHA1Digest sha1;
+	SHA256Digest sha256;
+
+	/**
+	 * The SHA-256 digest of the SubjectPublicKeyInfo.
+	 */
+	SHA256Digest spki_sha256;
+
+	/**
+	 * Digests of the DER-encoded subject and issuer names.
+	 */
+	SHA1Digest subject_sha1, issuer_sha1;
+
+	AllocatedString<> common_name, issuer_common_name;
+
+	std::forward_list<std::string> alt_names;
+
+	std::chrono::system_clock::time_point not_before, not_after;
+
+public:
+	/**
+	 * Throws #SslError on error.
+	 */
+	explicit CertificateInfo(UniqueX509 &&_cert);
+
+	/**
+	 * Share the given certificate (by incrementing its reference
+	 * counter).  Throws #SslError on error.
+	 */
+	explicit CertificateInfo(X509 &_cert);
+
+	CertificateInfo(CertificateInfo &&) = default;
+	CertificateInfo &operator=(CertificateInfo &&) = default;
+
+	X509 &GetCertificate() const {
+		return *cert;
+	}
+
+	const SHA1Digest &GetSHA1() const {
+		return sha1;
+	}
+
+	const SHA256Digest &GetSHA256() const {
+		return sha256;
+	}
+
+	const SHA256Digest &GetSpkiSHA256() const {
+		return spki_sha256;
+	}
+
+	const SHA1Digest &GetSubjectSHA1() const {
+		return subject_sha1;
+	}
+
+	const SHA1Digest &GetIssuerSHA1() const {
+		return issuer_sha1;
+	}
+
+	/**
+	 * @return the common name or nullptr if there is none
+	 */
+	const char *GetCommonName() const {
+		return common_name.c_str();
+	}
+
+	/**
+	 * @return the issuer's common name or nullptr if there is none
+	 */
+	const char *GetIssuerCommonName() const {
+		return issuer_common_name.c_str();
+	}
+
+	const std::forward_list<std::string> &GetSubjectAltNames() const {
+		return alt_names;
+	}
+
+	std::chrono::system_clock::time_point GetNotBefore() const {
+		return not_before;
+	}
+
+	std::chrono::system_clock::time_point GetNotAfter() const {
+		return not_after;
+	}
+
+	gcc_pure
+	bool IsValidAt(std::chrono::system_clock::time_point t) const {
+		return t >= not_before && t <= not_after;
+	}
+
+	/**
+	 * Was this certificate issued by itself?
+	 */
+	gcc_pure
+	bool IsSelfIssued() const {
+		return subject_sha1 == issuer_sha1;
+	}
+
+	/**
+	 * Does the given key belong to this certificate?  This
+	 * compares SubjectPublicKeyInfo digests and works for all key
+	 * types.  When matching many keys, calculate their digests
+	 * with CalcSpkiSHA256() once and use the other overload.
+	 *
+	 * Throws #SslError on error.
+	 */
+	gcc_pure
+	bool MatchKey(EVP_PKEY &key) const {
+		return MatchKey(CalcSpkiSHA256(key));
+	}
+
+	gcc_pure
+	bool MatchKey(const SHA256Digest &key_spki_sha256) const {
+		return spki_sha256 == key_spki_sha256;
+	}
+};
@@ -36,6 +36,7 @@
 #include "util/ConstBuffer.hxx"
 
 #include <openssl/evp.h>
+#include <openssl/x509.h>
 
 SHA1Digest
 CalcSHA1(ConstBuffer<void> src)
@@ -54,3 +55,52 @@ CalcSHA1(X509_NAME &src)
 	const SslBuffer buffer(src);
 	return CalcSHA1(buffer.get());
 }
+
+SHA256Digest
+CalcSHA256(ConstBuffer<void> src)
+{
+	SHA256Digest result;
+	if (!EVP_Digest(src.data, src.size, result.data, nullptr,
+			EVP_sha256(), nullptr))
+		throw SslError("EVP_Digest() failed");
+
+	return result;
+}
+
+SHA256Digest
+CalcSpkiSHA256(EVP_PKEY &key)
+{
+	unsigned char *der = nullptr;
+	const int length = i2d_PUBKEY(&key, &der);
+	if (length <= 0)
+		throw SslError("Failed to encode public key");
+
+	try {
+		const auto result = CalcSHA256({der, size_t(length)});
+		OPENSSL_free(der);
+		return result;
+	} catch (...) {
+		OPENSSL_free(der);
+		throw;
+	}
+}
+
+SHA256Digest
+CalcSpkiSHA256(X509 &cert)
+{
+	/* X509_get_X509_PUBKEY() returns the SPKI without decoding
+	   the key */
+	unsigned char *der = nullptr;
+	const int length = i2d_X509_PUBKEY(X509_get_X509_PUBKEY(&cert), &der);
+	if (length <= 0)
+		throw SslError("Failed to encode public key");
+
+	try {
+		const auto result = CalcSHA256({der, size_t(length)});
+		OPENSSL_free(der);
+		return result;
+	} catch (...) {
+		OPENSSL_free(der);
+		throw;
+	}
+}
@@ -42,10 +42,36 @@
 #include <openssl/ossl_typ.h>
 #include <openssl/sha.h>
 
+#include <string.h>
+
 template<typename T> struct ConstBuffer;
 
 struct SHA1Digest {
 	unsigned char data[SHA_DIGEST_LENGTH];
+
+	gcc_pure
+	bool operator==(const SHA1Digest &other) const {
+		return memcmp(data, other.data, sizeof(data)) == 0;
+	}
+
+	gcc_pure
+	bool operator!=(const SHA1Digest &other) const {
+		return !(*this == other);
+	}
+};
+
+struct SHA256Digest {
+	unsigned char data[SHA256_DIGEST_LENGTH];
+
+	gcc_pure
+	bool operator==(const SHA256Digest &other) const {
+		return memcmp(data, other.data, sizeof(data)) == 0;
+	}
+
+	gcc_pure
+	bool operator!=(const SHA256Digest &other) const {
+		return !(*this == other);
+	}
 };
 
 gcc_pure
@@ -56,4 +82,26 @@ gcc_pure
 SHA1Digest
 CalcSHA1(X509_NAME &src);
 
+gcc_pure
+SHA256Digest
+CalcSHA256(ConstBuffer<void> src);
+
+/**
+ * Calculate the SHA-256 digest of the DER-encoded
+ * SubjectPublicKeyInfo of the given (public or private) key.  This
+ * identifies a key pair independent of its type; a certificate and
+ * a key belong together if their SPKI digests are equal.
+ */
+gcc_pure
+SHA256Digest
+CalcSpkiSHA256(EVP_PKEY &key);
+
+/**
+ * Like CalcSpkiSHA256(EVP_PKEY &), but use the public key of a
+ * certificate.
+ */
+gcc_pure
+SHA256Digest
+CalcSpkiSHA256(X509 &cert);
+
 #endif
@@ -72,6 +72,69 @@ GenerateRsaKey()
 	return key;
 }
 
+/**
+ * Generate a key with EVP_PKEY_keygen().
+ *
+ * @param configure a function which configures the #EVP_PKEY_CTX
+ * after EVP_PKEY_keygen_init()
+ */
+template<typename F>
+static UniqueEVP_PKEY
+GenerateEvpKey(int id, F &&configure)
+{
+	const UniqueEVP_PKEY_CTX ctx(EVP_PKEY_CTX_new_id(id, nullptr));
+	if (!ctx)
+		throw SslError("EVP_PKEY_CTX_new_id() failed");
+
+	if (EVP_PKEY_keygen_init(ctx.get()) <= 0)
+		throw SslError("EVP_PKEY_keygen_init() failed");
+
+	configure(*ctx);
+
+	EVP_PKEY *key = nullptr;
+	if (EVP_PKEY_keygen(ctx.get(), &key) <= 0)
+		throw SslError("EVP_PKEY_keygen() failed");
+
+	return UniqueEVP_PKEY(key);
+}
+
+UniqueEVP_PKEY
+GenerateEcKey(int nid)
+{
+	return GenerateEvpKey(EVP_PKEY_EC, [nid](EVP_PKEY_CTX &ctx){
+			if (EVP_PKEY_CTX_set_ec_paramgen_curve_nid(&ctx, nid) <= 0)
+				throw SslError("EVP_PKEY_CTX_set_ec_paramgen_curve_nid() failed");
+		});
+}
+
+UniqueEVP_PKEY
+GenerateKey(KeyType type)
+{
+	switch (type) {
+	case KeyType::RSA_4096:
+		return GenerateRsaKey();
+
+	case KeyType::EC_P256:
+		return GenerateEcKey(NID_X9_62_prime256v1);
+
+	case KeyType::X25519:
+#ifdef EVP_PKEY_X25519
+		return GenerateEvpKey(EVP_PKEY_X25519, [](EVP_PKEY_CTX &){});
+#else
+		break;
+#endif
+
+	case KeyType::ED25519:
+#ifdef EVP_PKEY_ED25519
+		return GenerateEvpKey(EVP_PKEY_ED25519, [](EVP_PKEY_CTX &){});
+#else
+		break;
+#endif
+	}
+
+	throw SslError("Key type not supported");
+}
+
 UniqueEVP_PKEY
 DecodeDerKey(ConstBuffer<void> der)
 {
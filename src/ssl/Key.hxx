@@ -42,12 +42,60 @@
 #include "util/Compiler.h"
 
 #include <openssl/ossl_typ.h>
+#include <openssl/obj_mac.h>
 
 template<typename T> struct ConstBuffer;
 
+/**
+ * Generate a 4096 bit RSA key.  This takes hundreds of milliseconds;
+ * consider using #SslKeyPool.
+ *
+ * Throws SslError on error.
+ */
 UniqueEVP_PKEY
 GenerateRsaKey();
 
+/**
+ * Generate an elliptic curve key on the given named curve.
+ *
+ * Throws SslError on error.
+ */
+UniqueEVP_PKEY
+GenerateEcKey(int nid=NID_X9_62_prime256v1);
+
+enum class KeyType {
+	/**
+	 * 4096 bit RSA, see GenerateRsaKey().
+	 */
+	RSA_4096,
+
+	/**
+	 * ECDSA on NIST P-256.
+	 */
+	EC_P256,
+
+	/**
+	 * X25519 (key agreement only, RFC 7748).
+	 */
+	X25519,
+
+	/**
+	 * Ed25519 (signatures, RFC 8032).
+	 */
+	ED25519,
+};
+
+static constexpr unsigned N_KEY_TYPES = unsigned(KeyType::ED25519) + 1;
+
+/**
+ * Generate a key of the given type.
+ *
+ * Throws SslError on error (e.g. if this OpenSSL version does not
+ * support the type).
+ */
+UniqueEVP_PKEY
+GenerateKey(KeyType type);
+
 /**
  * Decode a private key encoded with DER.  It is a wrapper for
  * d2i_AutoPrivateKey().
@@ -0,0 +1,149 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "KeyPool.hxx"
+
+class SslKeyPool::RefillJob final : public WorkStealingPool::Job {
+	SslKeyPool &pool;
+	const KeyType type;
+
+public:
+	RefillJob(SslKeyPool &_pool, KeyType _type) noexcept
+		:pool(_pool), type(_type) {}
+
+	void Run() noexcept override {
+		UniqueEVP_PKEY key;
+		try {
+			key = GenerateKey(type);
+		} catch (...) {
+		}
+
+		SslKeyPool &_pool = pool;
+		const KeyType _type = type;
+		delete this;
+
+		_pool.OnJobFinished(_type, std::move(key));
+	}
+};
+
+SslKeyPool::~SslKeyPool() noexcept
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	quit = true;
+	finished_cond.wait(lock, [this]{ return n_running == 0; });
+}
+
+void
+SslKeyPool::Refill(KeyType type)
+{
+	auto &stock = GetStock(type);
+
+	while (!quit && !stock.failed &&
+	       stock.keys.size() + stock.n_running < stock.depth &&
+	       stock.n_running < workers.size()) {
+		auto *job = new RefillJob(*this, type);
+		try {
+			workers.Submit(*job);
+		} catch (...) {
+			delete job;
+			break;
+		}
+
+		++stock.n_running;
+		++n_running;
+	}
+}
+
+void
+SslKeyPool::OnJobFinished(KeyType type, UniqueEVP_PKEY &&key) noexcept
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+	auto &stock = GetStock(type);
+
+	--stock.n_running;
+	--n_running;
+
+	if (key) {
+		if (!quit)
+			stock.keys.emplace_back(std::move(key));
+		Refill(type);
+	} else
+		stock.failed = true;
+
+	if (n_running == 0)
+		finished_cond.notify_all();
+}
+
+void
+SslKeyPool::SetDepth(KeyType type, size_t depth)
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+	auto &stock = GetStock(type);
+
+	stock.depth = depth;
+	stock.failed = false;
+
+	while (stock.keys.size() > depth)
+		stock.keys.pop_back();
+
+	Refill(type);
+}
+
+UniqueEVP_PKEY
+SslKeyPool::Get(KeyType type)
+{
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		auto &stock = GetStock(type);
+
+		if (!stock.keys.empty()) {
+			auto key = std::move(stock.keys.front());
+			stock.keys.pop_front();
+			++stock.hits;
+			Refill(type);
+			return key;
+		}
+
+		++stock.misses;
+		Refill(type);
+	}
+
+	return GenerateKey(type);
+}
+
+SslKeyPool::Stats
+SslKeyPool::GetStats(KeyType type)
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+	const auto &stock = GetStock(type);
+	return {stock.keys.size(), stock.hits, stock.misses};
+}
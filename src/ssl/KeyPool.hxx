@@ -0,0 +1,141 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Keys generated in advance.
+ */
+
+#pragma once
+
+#include "Key.hxx"
+#include "Unique.hxx"
+#include "util/Compiler.h"
+#include "util/WorkStealingPool.hxx"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+/**
+ * Keeps a number of freshly generated keys of each #KeyType in
+ * stock, so certificates can be issued without waiting for key
+ * generation (a 4096 bit RSA key takes hundreds of milliseconds).
+ * Keys are generated by jobs on a #WorkStealingPool, in parallel up
+ * to the number of worker threads.
+ *
+ * All methods are thread-safe.
+ */
+class SslKeyPool {
+	class RefillJob;
+
+	struct Stock {
+		std::deque<UniqueEVP_PKEY> keys;
+
+		/**
+		 * The number of keys to keep in stock.
+		 */
+		size_t depth = 0;
+
+		/**
+		 * The number of #RefillJob instances for this type
+		 * which have not yet finished.
+		 */
+		size_t n_running = 0;
+
+		uint64_t hits = 0, misses = 0;
+
+		/**
+		 * Set after key generation in a job has failed; no
+		 * further jobs are submitted (until SetDepth() is
+		 * called again) to avoid a busy loop.
+		 */
+		bool failed = false;
+	};
+
+	WorkStealingPool &workers;
+
+	std::mutex mutex;
+	std::condition_variable finished_cond;
+
+	Stock stocks[N_KEY_TYPES];
+
+	size_t n_running = 0;
+
+	bool quit = false;
+
+public:
+	struct Stats {
+		size_t available;
+		uint64_t hits, misses;
+	};
+
+	explicit SslKeyPool(WorkStealingPool &_workers)
+		:workers(_workers) {}
+
+	/**
+	 * Waits for running jobs and frees all keys.
+	 */
+	~SslKeyPool() noexcept;
+
+	SslKeyPool(const SslKeyPool &) = delete;
+	SslKeyPool &operator=(const SslKeyPool &) = delete;
+
+	/**
+	 * Configure how many keys of the given type shall be kept
+	 * in stock, and start generating them.
+	 */
+	void SetDepth(KeyType type, size_t depth);
+
+	/**
+	 * Obtain a key.  If the stock is empty, the key is generated
+	 * synchronously in the calling thread.
+	 *
+	 * Throws SslError on error.
+	 */
+	UniqueEVP_PKEY Get(KeyType type);
+
+	gcc_pure
+	Stats GetStats(KeyType type);
+
+private:
+	Stock &GetStock(KeyType type) {
+		return stocks[unsigned(type)];
+	}
+
+	/**
+	 * Submit jobs until the stock (plus the keys being generated)
+	 * reaches the configured depth.  Caller must lock the mutex.
+	 */
+	void Refill(KeyType type);
+
+	void OnJobFinished(KeyType type, UniqueEVP_PKEY &&key) noexcept;
+};
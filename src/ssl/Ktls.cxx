@@ -0,0 +1,84 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Ktls.hxx"
+
+bool
+EnableKtls(SSL_CTX &ctx) noexcept
+{
+#ifdef SSL_OP_ENABLE_KTLS
+	SSL_CTX_set_options(&ctx, SSL_OP_ENABLE_KTLS);
+	return true;
+#else
+	(void)ctx;
+	return false;
+#endif
+}
+
+bool
+IsKtlsSend(SSL &ssl) noexcept
+{
+#ifdef SSL_OP_ENABLE_KTLS
+	BIO *bio = SSL_get_wbio(&ssl);
+	return bio != nullptr && BIO_get_ktls_send(bio) > 0;
+#else
+	(void)ssl;
+	return false;
+#endif
+}
+
+bool
+IsKtlsReceive(SSL &ssl) noexcept
+{
+#ifdef SSL_OP_ENABLE_KTLS
+	BIO *bio = SSL_get_rbio(&ssl);
+	return bio != nullptr && BIO_get_ktls_recv(bio) > 0;
+#else
+	(void)ssl;
+	return false;
+#endif
+}
+
+bool
+CanReleaseToKernel(SSL &ssl) noexcept
+{
+#ifdef SSL_OP_ENABLE_KTLS
+	/* SSL_has_pending() also checks for records which have been
+	   received but not yet decrypted */
+	return SSL_is_init_finished(&ssl) &&
+		IsKtlsSend(ssl) && IsKtlsReceive(ssl) &&
+		!SSL_has_pending(&ssl);
+#else
+	(void)ssl;
+	return false;
+#endif
+}
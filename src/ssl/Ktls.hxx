@@ -0,0 +1,84 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Kernel TLS offload helpers.
+ */
+
+#pragma once
+
+#include "util/Compiler.h"
+
+#include <openssl/ssl.h>
+
+/**
+ * Ask OpenSSL to push the negotiated keys into the kernel
+ * (setsockopt(TCP_ULP, "tls")) for all connections created from
+ * this context.  This requires OpenSSL 3 built with kTLS support
+ * and a kernel with the "tls" module; if either is missing,
+ * connections silently keep using userspace encryption.
+ *
+ * @return false if this OpenSSL version does not support kTLS
+ */
+bool
+EnableKtls(SSL_CTX &ctx) noexcept;
+
+/**
+ * Is the sending direction of this (established) connection
+ * handled by the kernel?  If yes, plain send(), sendfile() and
+ * splice() on the socket produce TLS records.
+ */
+gcc_pure
+bool
+IsKtlsSend(SSL &ssl) noexcept;
+
+/**
+ * Is the receiving direction of this (established) connection
+ * handled by the kernel?
+ */
+gcc_pure
+bool
+IsKtlsReceive(SSL &ssl) noexcept;
+
+/**
+ * Can the socket of this connection be used as a plain socket,
+ * e.g. with #BufferedSocket instead of an SSL filter?  This is the
+ * case if both directions are offloaded to the kernel and OpenSSL
+ * does not hold any decrypted data which has not yet been read.
+ *
+ * Note that the kernel passes only application data records to
+ * recv(); a control record (e.g. a TLS 1.3 KeyUpdate) makes recv()
+ * fail with EIO, which is then reported as a socket error.
+ */
+gcc_pure
+bool
+CanReleaseToKernel(SSL &ssl) noexcept;
@@ -0,0 +1,301 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "SessionCache.hxx"
+#include "system/Error.hxx"
+#include "util/FNVHash.hxx"
+
+#include <new>
+
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+struct SslSessionCache::Slot {
+	/**
+	 * The expiry time (Unix time); 0 means this slot is empty.
+	 */
+	int64_t expires;
+
+	uint16_t der_length;
+
+	uint8_t id_length;
+
+	uint8_t id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+
+	uint8_t der[MAX_DER];
+
+	bool Matches(const unsigned char *_id, size_t _id_length) const {
+		return expires != 0 && id_length == _id_length &&
+			memcmp(id, _id, _id_length) == 0;
+	}
+};
+
+struct SslSessionCache::Set {
+	std::atomic<uint32_t> lock;
+
+	Slot slots[WAYS];
+
+	bool TryLock() {
+		return lock.exchange(1, std::memory_order_acquire) == 0;
+	}
+
+	void Unlock() {
+		lock.store(0, std::memory_order_release);
+	}
+};
+
+struct SslSessionCache::Shared {
+	std::atomic<uint64_t> hits, misses, stores, skipped;
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+	      "Lock-free atomics are needed in shared memory");
+
+static size_t
+RoundUpPowerOfTwo(size_t n)
+{
+	size_t result = 1;
+	while (result < n)
+		result <<= 1;
+	return result;
+}
+
+SslSessionCache::SslSessionCache(size_t capacity)
+	:n_sets(RoundUpPowerOfTwo((capacity + WAYS - 1) / WAYS))
+{
+	static_assert(sizeof(Shared) % alignof(Set) == 0, "");
+	mapping_size = sizeof(Shared) + n_sets * sizeof(Set);
+
+	/* the mapping is zero-filled, which is a valid (empty)
+	   state; the sets are not initialized explicitly, because
+	   that would commit all pages right away */
+	void *p = mmap(nullptr, mapping_size, PROT_READ|PROT_WRITE,
+		       MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		throw MakeErrno("Failed to allocate TLS session cache");
+
+	shared = ::new(p) Shared();
+	sets = reinterpret_cast<Set *>(shared + 1);
+}
+
+SslSessionCache::~SslSessionCache()
+{
+	munmap(shared, mapping_size);
+}
+
+SslSessionCache::Set &
+SslSessionCache::GetSet(const unsigned char *id, size_t id_length) const
+{
+	return sets[FNV1aHash64(id, id_length) & (n_sets - 1)];
+}
+
+static int64_t
+Now()
+{
+	return time(nullptr);
+}
+
+bool
+SslSessionCache::Store(SSL_SESSION &session)
+{
+	unsigned id_length;
+	const unsigned char *id = SSL_SESSION_get_id(&session, &id_length);
+	if (id_length == 0 || id_length > SSL_MAX_SSL_SESSION_ID_LENGTH) {
+		++shared->skipped;
+		return false;
+	}
+
+	const int der_length = i2d_SSL_SESSION(&session, nullptr);
+	if (der_length <= 0 || size_t(der_length) > MAX_DER) {
+		++shared->skipped;
+		return false;
+	}
+
+	auto &set = GetSet(id, id_length);
+	if (!set.TryLock()) {
+		++shared->skipped;
+		return false;
+	}
+
+	/* replace a slot with the same id, an empty/expired one or
+	   the one which expires first */
+	const int64_t now = Now();
+	Slot *victim = &set.slots[0];
+	for (auto &slot : set.slots) {
+		if (slot.Matches(id, id_length) || slot.expires <= now) {
+			victim = &slot;
+			break;
+		}
+
+		if (slot.expires < victim->expires)
+			victim = &slot;
+	}
+
+	victim->expires = int64_t(SSL_SESSION_get_time(&session))
+		+ SSL_SESSION_get_timeout(&session);
+	victim->id_length = id_length;
+	memcpy(victim->id, id, id_length);
+	unsigned char *der = victim->der;
+	victim->der_length = i2d_SSL_SESSION(&session, &der);
+
+	set.Unlock();
+
+	++shared->stores;
+	return true;
+}
+
+SSL_SESSION *
+SslSessionCache::Find(const unsigned char *id, size_t id_length)
+{
+	auto &set = GetSet(id, id_length);
+	if (!set.TryLock()) {
+		++shared->misses;
+		return nullptr;
+	}
+
+	const int64_t now = Now();
+	SSL_SESSION *session = nullptr;
+	for (auto &slot : set.slots) {
+		if (slot.Matches(id, id_length)) {
+			if (slot.expires > now) {
+				const unsigned char *der = slot.der;
+				session = d2i_SSL_SESSION(nullptr, &der,
+							  slot.der_length);
+			} else
+				slot.expires = 0;
+			break;
+		}
+	}
+
+	set.Unlock();
+
+	++(session != nullptr ? shared->hits : shared->misses);
+	return session;
+}
+
+void
+SslSessionCache::Remove(const unsigned char *id, size_t id_length)
+{
+	auto &set = GetSet(id, id_length);
+	if (!set.TryLock())
+		/* it will expire eventually */
+		return;
+
+	for (auto &slot : set.slots)
+		if (slot.Matches(id, id_length))
+			slot.expires = 0;
+
+	set.Unlock();
+}
+
+void
+SslSessionCache::Flush()
+{
+	for (size_t i = 0; i < n_sets; ++i) {
+		auto &set = sets[i];
+		if (!set.TryLock())
+			continue;
+
+		for (auto &slot : set.slots)
+			slot.expires = 0;
+
+		set.Unlock();
+	}
+}
+
+SslSessionCache::Stats
+SslSessionCache::GetStats() const
+{
+	return {shared->hits, shared->misses, shared->stores, shared->skipped};
+}
+
+static int
+GetExIndex()
+{
+	static const int index =
+		SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+	return index;
+}
+
+static SslSessionCache &
+GetCache(SSL_CTX &ssl_ctx)
+{
+	auto *cache = (SslSessionCache *)SSL_CTX_get_ex_data(&ssl_ctx,
+							     GetExIndex());
+	assert(cache != nullptr);
+	return *cache;
+}
+
+int
+SslSessionCache::NewSessionCallback(SSL *ssl, SSL_SESSION *session)
+{
+	GetCache(*SSL_get_SSL_CTX(ssl)).Store(*session);
+
+	/* we did not keep a reference */
+	return 0;
+}
+
+SSL_SESSION *
+SslSessionCache::GetSessionCallback(SSL *ssl,
+				    SessionIdPointer id, int id_length,
+				    int *copy)
+{
+	/* the returned session is a new object which belongs to
+	   OpenSSL */
+	*copy = 0;
+
+	return GetCache(*SSL_get_SSL_CTX(ssl)).Find(id, id_length);
+}
+
+void
+SslSessionCache::RemoveSessionCallback(SSL_CTX *ssl_ctx,
+				       SSL_SESSION *session)
+{
+	unsigned id_length;
+	const unsigned char *id = SSL_SESSION_get_id(session, &id_length);
+	GetCache(*ssl_ctx).Remove(id, id_length);
+}
+
+void
+SslSessionCache::Install(SSL_CTX &ssl_ctx)
+{
+	SSL_CTX_set_ex_data(&ssl_ctx, GetExIndex(), this);
+
+	SSL_CTX_set_session_cache_mode(&ssl_ctx,
+				       SSL_SESS_CACHE_SERVER |
+				       SSL_SESS_CACHE_NO_INTERNAL);
+	SSL_CTX_sess_set_new_cb(&ssl_ctx, NewSessionCallback);
+	SSL_CTX_sess_set_get_cb(&ssl_ctx, GetSessionCallback);
+	SSL_CTX_sess_set_remove_cb(&ssl_ctx, RemoveSessionCallback);
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * A TLS session cache in shared memory.
+ */
+
+#pragma once
+
+#include "util/Compiler.h"
+
+#include <openssl/ssl.h>
+
+#include <atomic>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A server-side TLS session cache in an anonymous shared memory
+ * mapping.  Create it before forking the worker processes; then all
+ * workers (and all threads) see the same sessions, and a client
+ * reconnecting to a different worker gets an abbreviated handshake.
+ *
+ * The table is 4-way set associative with one lock per set.  The
+ * locks are only ever tried, never waited for: on contention, a
+ * lookup misses and a store is skipped.  This means a worker which
+ * dies while holding a lock can not block the others forever; it
+ * only loses one set.
+ *
+ * This only caches session ids (TLS 1.2 and earlier, and clients
+ * which do not support tickets); see #SslTicketKeys for session
+ * tickets.
+ */
+class SslSessionCache {
+	/**
+	 * Sessions with a larger DER encoding are not cached.
+	 * Without client certificates, sessions are typically a few
+	 * hundred bytes.
+	 */
+	static constexpr size_t MAX_DER = 1024;
+
+	static constexpr size_t WAYS = 4;
+
+	struct Slot;
+	struct Set;
+	struct Shared;
+
+	Shared *shared;
+	Set *sets;
+
+	size_t n_sets;
+
+	size_t mapping_size;
+
+public:
+	struct Stats {
+		uint64_t hits, misses, stores, skipped;
+	};
+
+	/**
+	 * Throws on error.
+	 *
+	 * @param capacity the maximum number of sessions (rounded up
+	 * to a power of two)
+	 */
+	explicit SslSessionCache(size_t capacity);
+	~SslSessionCache();
+
+	SslSessionCache(const SslSessionCache &) = delete;
+	SslSessionCache &operator=(const SslSessionCache &) = delete;
+
+	/**
+	 * Make the given context use this cache instead of its
+	 * internal one.  All contexts sharing a cache should have the
+	 * same session id context (SSL_CTX_set_session_id_context()).
+	 */
+	void Install(SSL_CTX &ssl_ctx);
+
+	/**
+	 * Store a session.
+	 *
+	 * @return false if the session was not stored (too large,
+	 * not resumable or lock contention)
+	 */
+	bool Store(SSL_SESSION &session);
+
+	/**
+	 * Look up a session.
+	 *
+	 * @return the session or nullptr; the caller owns the
+	 * reference
+	 */
+	SSL_SESSION *Find(const unsigned char *id, size_t id_length);
+
+	void Remove(const unsigned char *id, size_t id_length);
+
+	/**
+	 * Remove all sessions.
+	 */
+	void Flush();
+
+	gcc_pure
+	Stats GetStats() const;
+
+private:
+	gcc_pure
+	Set &GetSet(const unsigned char *id, size_t id_length) const;
+
+	static int NewSessionCallback(SSL *ssl, SSL_SESSION *session);
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	typedef const unsigned char *SessionIdPointer;
+#else
+	typedef unsigned char *SessionIdPointer;
+#endif
+
+	static SSL_SESSION *GetSessionCallback(SSL *ssl, SessionIdPointer id,
+					       int id_length, int *copy);
+	static void RemoveSessionCallback(SSL_CTX *ssl_ctx,
+					  SSL_SESSION *session);
+};
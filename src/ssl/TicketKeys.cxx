@@ -0,0 +1,252 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "TicketKeys.hxx"
+#include "Error.hxx"
+#include "system/Error.hxx"
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+
+#include <atomic>
+#include <new>
+
+#include <assert.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+
+struct SslTicketKeys::Shared {
+	/**
+	 * A sequence lock: odd while Rotate() modifies #keys.
+	 */
+	std::atomic<uint32_t> sequence;
+
+	/**
+	 * The current key is at index 0.
+	 */
+	Key keys[N_KEYS];
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2,
+	      "Lock-free atomics are needed in shared memory");
+
+static void
+GenerateKey(SslTicketKeys::Key &key)
+{
+	if (RAND_bytes((unsigned char *)&key, sizeof(key)) != 1)
+		throw SslError("RAND_bytes() failed");
+}
+
+SslTicketKeys::SslTicketKeys()
+{
+	void *p = mmap(nullptr, sizeof(Shared), PROT_READ|PROT_WRITE,
+		       MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		throw MakeErrno("Failed to allocate TLS ticket keys");
+
+	shared = ::new(p) Shared();
+
+	try {
+		/* all keys are random, so none of the unused slots
+		   can match a ticket */
+		for (auto &key : shared->keys)
+			GenerateKey(key);
+	} catch (...) {
+		munmap(shared, sizeof(Shared));
+		throw;
+	}
+}
+
+SslTicketKeys::~SslTicketKeys()
+{
+	munmap(shared, sizeof(Shared));
+}
+
+void
+SslTicketKeys::Rotate()
+{
+	Key key;
+	GenerateKey(key);
+	Rotate(key);
+}
+
+void
+SslTicketKeys::Rotate(const Key &key)
+{
+	const uint32_t sequence =
+		shared->sequence.load(std::memory_order_relaxed);
+	assert(sequence % 2 == 0);
+
+	shared->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	memmove(&shared->keys[1], &shared->keys[0],
+		sizeof(shared->keys[0]) * (N_KEYS - 1));
+	shared->keys[0] = key;
+
+	shared->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+SslTicketKeys::Snapshot
+SslTicketKeys::Load() const
+{
+	Snapshot snapshot;
+
+	/* give up waiting after a while; a process which has died in
+	   the middle of Rotate() must not block handshakes */
+	for (unsigned i = 0; i < 1000; ++i) {
+		const uint32_t sequence =
+			shared->sequence.load(std::memory_order_acquire);
+		if (sequence % 2 != 0) {
+			sched_yield();
+			continue;
+		}
+
+		memcpy(&snapshot.keys, &shared->keys, sizeof(snapshot.keys));
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if (shared->sequence.load(std::memory_order_relaxed) == sequence)
+			break;
+	}
+
+	return snapshot;
+}
+
+static int
+GetExIndex()
+{
+	static const int index =
+		SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+	return index;
+}
+
+const SslTicketKeys &
+SslTicketKeys::Get(SSL &ssl)
+{
+	auto *keys = (const SslTicketKeys *)
+		SSL_CTX_get_ex_data(SSL_get_SSL_CTX(&ssl), GetExIndex());
+	assert(keys != nullptr);
+	return *keys;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+
+static bool
+InitMac(EVP_MAC_CTX &ctx, const SslTicketKeys::Key &key)
+{
+	char digest[] = "SHA256";
+	const OSSL_PARAM params[] = {
+		OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+						 digest, 0),
+		OSSL_PARAM_construct_end(),
+	};
+
+	return EVP_MAC_init(&ctx, key.hmac_key, sizeof(key.hmac_key),
+			    params) == 1;
+}
+
+#else
+
+static bool
+InitMac(HMAC_CTX &ctx, const SslTicketKeys::Key &key)
+{
+	return HMAC_Init_ex(&ctx, key.hmac_key, sizeof(key.hmac_key),
+			    EVP_sha256(), nullptr) == 1;
+}
+
+#endif
+
+int
+SslTicketKeys::Callback(SSL *ssl, unsigned char *name, unsigned char *iv,
+			EVP_CIPHER_CTX *cipher_ctx,
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+			EVP_MAC_CTX *mac_ctx,
+#else
+			HMAC_CTX *mac_ctx,
+#endif
+			int enc)
+{
+	const auto snapshot = Get(*ssl).Load();
+
+	if (enc) {
+		/* issue a new ticket with the current key */
+		const auto &key = snapshot.keys[0];
+
+		if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1)
+			return -1;
+
+		memcpy(name, key.name, sizeof(key.name));
+
+		if (EVP_EncryptInit_ex(cipher_ctx, EVP_aes_256_cbc(), nullptr,
+				       key.aes_key, iv) != 1 ||
+		    !InitMac(*mac_ctx, key))
+			return -1;
+
+		return 1;
+	}
+
+	for (size_t i = 0; i < N_KEYS; ++i) {
+		const auto &key = snapshot.keys[i];
+		if (memcmp(name, key.name, sizeof(key.name)) != 0)
+			continue;
+
+		if (EVP_DecryptInit_ex(cipher_ctx, EVP_aes_256_cbc(), nullptr,
+				       key.aes_key, iv) != 1 ||
+		    !InitMac(*mac_ctx, key))
+			return -1;
+
+		/* 2 = valid, but issue a new ticket with the current
+		   key */
+		return i == 0 ? 1 : 2;
+	}
+
+	/* unknown key (expired or from elsewhere): full handshake */
+	return 0;
+}
+
+void
+SslTicketKeys::Install(SSL_CTX &ssl_ctx)
+{
+	SSL_CTX_set_ex_data(&ssl_ctx, GetExIndex(), this);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	SSL_CTX_set_tlsext_ticket_key_evp_cb(&ssl_ctx, Callback);
+#else
+	SSL_CTX_set_tlsext_ticket_key_cb(&ssl_ctx, Callback);
+#endif
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * TLS session ticket keys shared by all workers.
+ */
+
+#pragma once
+
+#include <openssl/ssl.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Session ticket keys (RFC 5077) in an anonymous shared memory
+ * mapping.  Create it before forking the worker processes and call
+ * Rotate() periodically in one process (usually the master); all
+ * workers then issue and accept the same tickets, so a client can
+ * resume on any worker.  To share tickets between hosts, distribute
+ * keys and pass them to Rotate(const Key &).
+ *
+ * The newest key is used to issue tickets; tickets encrypted with
+ * one of the older keys are still accepted, and the client receives
+ * a fresh ticket.
+ *
+ * Rotate() must not be called concurrently from more than one
+ * thread or process.
+ */
+class SslTicketKeys {
+public:
+	struct Key {
+		uint8_t name[16];
+		uint8_t aes_key[32];
+		uint8_t hmac_key[32];
+	};
+
+	/**
+	 * The number of keys which are accepted, including the
+	 * current one.  With a rotation interval of one hour, tickets
+	 * are valid for up to three hours.
+	 */
+	static constexpr size_t N_KEYS = 3;
+
+private:
+	struct Shared;
+	Shared *shared;
+
+	struct Snapshot {
+		Key keys[N_KEYS];
+	};
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	SslTicketKeys();
+	~SslTicketKeys();
+
+	SslTicketKeys(const SslTicketKeys &) = delete;
+	SslTicketKeys &operator=(const SslTicketKeys &) = delete;
+
+	/**
+	 * Generate a new random key and make it the current one; the
+	 * oldest key is discarded.
+	 *
+	 * Throws SslError on error.
+	 */
+	void Rotate();
+
+	/**
+	 * Make the given key the current one.
+	 */
+	void Rotate(const Key &key);
+
+	/**
+	 * Make the given context use these keys for session tickets.
+	 */
+	void Install(SSL_CTX &ssl_ctx);
+
+private:
+	Snapshot Load() const;
+
+	static const SslTicketKeys &Get(SSL &ssl);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	static int Callback(SSL *ssl, unsigned char *name, unsigned char *iv,
+			    EVP_CIPHER_CTX *cipher_ctx, EVP_MAC_CTX *mac_ctx,
+			    int enc);
+#else
+	static int Callback(SSL *ssl, unsigned char *name, unsigned char *iv,
+			    EVP_CIPHER_CTX *cipher_ctx, HMAC_CTX *hmac_ctx,
+			    int enc);
+#endif
+};
@@ -32,16 +32,112 @@
 
 #include "BindMount.hxx"
 #include "system/Error.hxx"
+#include "system/mount_api.h"
 
 #include <sys/mount.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 
+#ifdef HAVE_MOUNT_API
+
+/**
+ * Set to false after the kernel has rejected the new mount API with
+ * ENOSYS.
+ */
+static bool have_mount_api = true;
+
+static bool
+ToMountAttr(int flags, uint64_t &attr)
+{
+    attr = 0;
+
+    if (flags & MS_RDONLY)
+        attr |= MY_MOUNT_ATTR_RDONLY;
+    if (flags & MS_NOSUID)
+        attr |= MY_MOUNT_ATTR_NOSUID;
+    if (flags & MS_NODEV)
+        attr |= MY_MOUNT_ATTR_NODEV;
+    if (flags & MS_NOEXEC)
+        attr |= MY_MOUNT_ATTR_NOEXEC;
+
+    /* all other flags are only supported by the old API */
+    return (flags & ~(MS_RDONLY|MS_NOSUID|MS_NODEV|MS_NOEXEC)) == 0;
+}
+
+/**
+ * Bind-mount with open_tree(), mount_setattr() and move_mount(): the
+ * flags are applied to the detached copy, so the new mount is never
+ * visible without them, and there is no remount.
+ *
+ * @return false if the kernel does not support this API
+ */
+static bool
+BindMountAPI(const char *source, const char *target, int flags)
+{
+    struct my_mount_attr attr = {};
+    if (!ToMountAttr(flags, attr.attr_set))
+        return false;
+
+    int fd = my_open_tree(AT_FDCWD, source,
+                          MY_OPEN_TREE_CLONE|MY_OPEN_TREE_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOSYS) {
+            have_mount_api = false;
+            return false;
+        }
+
+        throw FormatErrno("bind_mount('%s', '%s') failed", source, target);
+    }
+
+    if (attr.attr_set != 0) {
+        int result = my_mount_setattr(fd, "", MY_AT_EMPTY_PATH,
+                                      &attr, sizeof(attr));
+        if (result < 0 && errno == ENOSYS) {
+            close(fd);
+            have_mount_api = false;
+            return false;
+        }
+
+        /* after EPERM, try again with MOUNT_ATTR_NOEXEC (see
+           below) */
+        if (result < 0 && errno == EPERM && (flags & MS_NOEXEC) == 0) {
+            attr.attr_set |= MY_MOUNT_ATTR_NOEXEC;
+            result = my_mount_setattr(fd, "", MY_AT_EMPTY_PATH,
+                                      &attr, sizeof(attr));
+        }
+
+        if (result < 0) {
+            const int e = errno;
+            close(fd);
+            throw FormatErrno(e, "remount('%s') failed", target);
+        }
+    }
+
+    if (my_move_mount(fd, "", AT_FDCWD, target,
+                      MY_MOVE_MOUNT_F_EMPTY_PATH) < 0) {
+        const int e = errno;
+        close(fd);
+        throw FormatErrno(e, "bind_mount('%s', '%s') failed",
+                          source, target);
+    }
+
+    close(fd);
+    return true;
+}
+
+#endif
+
 void
 BindMount(const char *source, const char *target, int flags)
 {
+#ifdef HAVE_MOUNT_API
+    if (have_mount_api && BindMountAPI(source, target, flags))
+        return;
+#endif
+
     if (mount(source, target, nullptr, MS_BIND, nullptr) < 0)
         throw FormatErrno("bind_mount('%s', '%s') failed", source, target);
 
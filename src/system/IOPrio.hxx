@@ -31,23 +31,56 @@
 #define IOPRIO_HXX
 
 #include <sys/syscall.h>
+#include <unistd.h>
 
-static int
+static constexpr int IOPRIO_WHO_PROCESS_ = 1;
+
+static constexpr int IOPRIO_CLASS_NONE_ = 0;
+static constexpr int IOPRIO_CLASS_RT_ = 1;
+static constexpr int IOPRIO_CLASS_BE_ = 2;
+static constexpr int IOPRIO_CLASS_IDLE_ = 3;
+
+static constexpr int IOPRIO_CLASS_SHIFT_ = 13;
+
+/**
+ * Build an I/O priority value from a class and a level (0 = highest,
+ * 7 = lowest).
+ */
+static constexpr int
+ioprio_value(int io_class, int level)
+{
+	return (io_class << IOPRIO_CLASS_SHIFT_) | level;
+}
+
+static inline int
 ioprio_set(int which, int who, int ioprio)
 {
 	return syscall(__NR_ioprio_set, which, who, ioprio);
 }
 
-static void
-ioprio_set_idle()
+static inline int
+ioprio_get(int which, int who)
 {
-	static constexpr int _IOPRIO_WHO_PROCESS = 1;
-	static constexpr int _IOPRIO_CLASS_IDLE = 3;
-	static constexpr int _IOPRIO_CLASS_SHIFT = 13;
-	static constexpr int _IOPRIO_IDLE =
-		(_IOPRIO_CLASS_IDLE << _IOPRIO_CLASS_SHIFT) | 7;
+	return syscall(__NR_ioprio_get, which, who);
+}
+
+/**
+ * Change the I/O priority of the specified thread (0 = the current
+ * one).
+ *
+ * @return -1 on error (with errno set)
+ */
+static inline int
+ioprio_set_class(int io_class, int level, pid_t tid=0)
+{
+	return ioprio_set(IOPRIO_WHO_PROCESS_, tid,
+			  ioprio_value(io_class, level));
+}
 
-	ioprio_set(_IOPRIO_WHO_PROCESS, 0, _IOPRIO_IDLE);
+static inline void
+ioprio_set_idle()
+{
+	ioprio_set_class(IOPRIO_CLASS_IDLE_, 7);
 }
 
 #endif
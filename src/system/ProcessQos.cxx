@@ -0,0 +1,158 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ProcessQos.hxx"
+#include "IOPrio.hxx"
+#include "Error.hxx"
+#include "io/WriteFile.hxx"
+
+#include <stdexcept>
+
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+static int
+ToSchedPolicy(ProcessQos::CpuPolicy policy)
+{
+	switch (policy) {
+	case ProcessQos::CpuPolicy::UNCHANGED:
+	case ProcessQos::CpuPolicy::NORMAL:
+		break;
+
+	case ProcessQos::CpuPolicy::BATCH:
+		return SCHED_BATCH;
+
+	case ProcessQos::CpuPolicy::IDLE:
+		return SCHED_IDLE;
+	}
+
+	return SCHED_OTHER;
+}
+
+void
+ProcessQos::ApplySched(pid_t tid) const
+{
+	if (cpu_policy != CpuPolicy::UNCHANGED) {
+		static constexpr struct sched_param param{};
+		if (sched_setscheduler(tid, ToSchedPolicy(cpu_policy),
+				       &param) < 0)
+			throw MakeErrno("sched_setscheduler() failed");
+	}
+
+	switch (io_class) {
+	case IoClass::UNCHANGED:
+		break;
+
+	case IoClass::BEST_EFFORT:
+		if (ioprio_set_class(IOPRIO_CLASS_BE_, io_level & 7, tid) < 0)
+			throw MakeErrno("ioprio_set() failed");
+		break;
+
+	case IoClass::IDLE:
+		if (ioprio_set_class(IOPRIO_CLASS_IDLE_, 7, tid) < 0)
+			throw MakeErrno("ioprio_set() failed");
+		break;
+	}
+}
+
+/**
+ * Determine the cgroup2 path of the current process from
+ * /proc/self/cgroup.
+ */
+static void
+GetCgroup2Path(char *buffer, size_t size)
+{
+	FILE *file = fopen("/proc/self/cgroup", "r");
+	if (file == nullptr)
+		throw FormatErrno("Failed to open %s", "/proc/self/cgroup");
+
+	char line[PATH_MAX + 16];
+	bool found = false;
+	while (fgets(line, sizeof(line), file) != nullptr) {
+		/* the unified hierarchy is "0::/path" */
+		if (memcmp(line, "0::/", 4) == 0) {
+			char *path = line + 3;
+			path[strcspn(path, "\n")] = 0;
+
+			found = snprintf(buffer, size, "/sys/fs/cgroup%s",
+					 path) < (int)size;
+			break;
+		}
+	}
+
+	fclose(file);
+
+	if (!found)
+		throw std::runtime_error("No cgroup2 membership");
+}
+
+static void
+WriteCgroupAttribute(const char *group_path, const char *name,
+		     unsigned value)
+{
+	char path[PATH_MAX];
+	if (snprintf(path, sizeof(path), "%s/%s",
+		     group_path, name) >= (int)sizeof(path))
+		throw std::runtime_error("Path is too long");
+
+	char buffer[16];
+	snprintf(buffer, sizeof(buffer), "%u", value);
+
+	switch (TryWriteExistingFile(path, buffer)) {
+	case WriteFileResult::SUCCESS:
+		break;
+
+	case WriteFileResult::ERROR:
+		throw FormatErrno("write('%s') failed", path);
+
+	case WriteFileResult::SHORT:
+		throw std::runtime_error("Short write to cgroup attribute");
+	}
+}
+
+void
+ProcessQos::ApplyCgroup() const
+{
+	if (!HasCgroupWeights())
+		return;
+
+	char group_path[PATH_MAX];
+	GetCgroup2Path(group_path, sizeof(group_path));
+
+	if (cpu_weight != 0)
+		WriteCgroupAttribute(group_path, "cpu.weight", cpu_weight);
+
+	if (io_weight != 0)
+		WriteCgroupAttribute(group_path, "io.weight", io_weight);
+}
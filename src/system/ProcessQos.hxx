@@ -0,0 +1,137 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <sys/types.h>
+#include <stdint.h>
+
+/**
+ * CPU and I/O scheduling parameters for background work which shall
+ * be de-prioritized without being starved (unlike SCHED_IDLE and
+ * IOPRIO_CLASS_IDLE, which run only if nothing else wants to).
+ */
+struct ProcessQos {
+	enum class CpuPolicy : uint8_t {
+		/**
+		 * Don't change the scheduling policy.
+		 */
+		UNCHANGED,
+
+		/**
+		 * SCHED_OTHER.
+		 */
+		NORMAL,
+
+		/**
+		 * SCHED_BATCH: like SCHED_OTHER, but the thread is
+		 * considered CPU-bound and gets a slight penalty in
+		 * wakeup decisions.
+		 */
+		BATCH,
+
+		/**
+		 * SCHED_IDLE: run only when the CPU is otherwise idle.
+		 */
+		IDLE,
+	};
+
+	enum class IoClass : uint8_t {
+		/**
+		 * Don't change the I/O priority.
+		 */
+		UNCHANGED,
+
+		/**
+		 * IOPRIO_CLASS_BE with #io_level.
+		 */
+		BEST_EFFORT,
+
+		/**
+		 * IOPRIO_CLASS_IDLE.
+		 */
+		IDLE,
+	};
+
+	CpuPolicy cpu_policy = CpuPolicy::UNCHANGED;
+
+	IoClass io_class = IoClass::UNCHANGED;
+
+	/**
+	 * The level for IoClass::BEST_EFFORT (0 = highest, 7 =
+	 * lowest).
+	 */
+	uint8_t io_level = 4;
+
+	/**
+	 * The cgroup2 "cpu.weight" (1..10000, the kernel's default
+	 * is 100).  0 means don't change.
+	 */
+	unsigned cpu_weight = 0;
+
+	/**
+	 * The cgroup2 "io.weight" (1..10000, the kernel's default is
+	 * 100).  0 means don't change.
+	 */
+	unsigned io_weight = 0;
+
+	bool HasCgroupWeights() const noexcept {
+		return cpu_weight != 0 || io_weight != 0;
+	}
+
+	/**
+	 * Apply #cpu_policy and #io_class to the specified thread.
+	 * Note that both are per-thread attributes on Linux; threads
+	 * created afterwards inherit them.
+	 *
+	 * Throws std::system_error on error.
+	 *
+	 * @param tid the thread id; 0 means the calling thread
+	 */
+	void ApplySched(pid_t tid=0) const;
+
+	/**
+	 * Write the weights to the cgroup2 group the current process
+	 * is a member of.  This affects all processes in that group;
+	 * it is meant for a process which runs in a (delegated) group
+	 * of its own.  For spawned child processes, use
+	 * CgroupOptions::SetQos() instead.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void ApplyCgroup() const;
+
+	void Apply() const {
+		ApplySched();
+		ApplyCgroup();
+	}
+};
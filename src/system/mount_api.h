@@ -0,0 +1,94 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Provide access to the new mount API system calls (Linux 5.2 and
+ * 5.12), which are not yet wrapped by all C libraries.
+ */
+
+#ifndef SYSTEM_MOUNT_API_H
+#define SYSTEM_MOUNT_API_H
+
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#if defined(__NR_open_tree) && defined(__NR_move_mount) && defined(__NR_mount_setattr)
+#define HAVE_MOUNT_API
+#endif
+
+#ifdef HAVE_MOUNT_API
+
+#define MY_OPEN_TREE_CLONE 1
+#define MY_OPEN_TREE_CLOEXEC 02000000 /* O_CLOEXEC */
+
+#define MY_MOVE_MOUNT_F_EMPTY_PATH 0x00000004
+
+#define MY_AT_EMPTY_PATH 0x1000
+#define MY_AT_RECURSIVE 0x8000
+
+#define MY_MOUNT_ATTR_RDONLY 0x00000001
+#define MY_MOUNT_ATTR_NOSUID 0x00000002
+#define MY_MOUNT_ATTR_NODEV 0x00000004
+#define MY_MOUNT_ATTR_NOEXEC 0x00000008
+
+struct my_mount_attr {
+    uint64_t attr_set;
+    uint64_t attr_clr;
+    uint64_t propagation;
+    uint64_t userns_fd;
+};
+
+static inline int
+my_open_tree(int dfd, const char *filename, unsigned flags)
+{
+    return syscall(__NR_open_tree, dfd, filename, flags);
+}
+
+static inline int
+my_move_mount(int from_dfd, const char *from_pathname,
+              int to_dfd, const char *to_pathname, unsigned flags)
+{
+    return syscall(__NR_move_mount, from_dfd, from_pathname,
+                   to_dfd, to_pathname, flags);
+}
+
+static inline int
+my_mount_setattr(int dfd, const char *path, unsigned flags,
+                 struct my_mount_attr *attr, size_t size)
+{
+    return syscall(__NR_mount_setattr, dfd, path, flags, attr, size);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Proleptic Gregorian calendar arithmetic.
+ */
+
+#pragma once
+
+static constexpr bool
+IsLeapYear(int year) noexcept
+{
+	return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+/**
+ * @param month the month number (0-11)
+ */
+static constexpr int
+DaysInMonth(int year, int month) noexcept
+{
+	return month == 1
+		? (IsLeapYear(year) ? 29 : 28)
+		: 31 - ((month + (month >= 7)) & 1);
+}
+
+/**
+ * Convert a date to the number of days since 1970-01-01 (Howard
+ * Hinnant's "days_from_civil" algorithm).
+ *
+ * @param month the month number (0-11)
+ * @param day the day of the month (1-31)
+ */
+static constexpr long
+DaysFromCivil(int year, int month, int day) noexcept
+{
+	if (month < 2)
+		--year;
+
+	const int era = (year >= 0 ? year : year - 399) / 400;
+	const int year_of_era = year - era * 400;
+	const int day_of_year = (153 * (month + (month >= 2 ? -2 : 10)) + 2) / 5
+		+ day - 1;
+	const int day_of_era = year_of_era * 365 + year_of_era / 4
+		- year_of_era / 100 + day_of_year;
+	return era * 146097L + day_of_era - 719468L;
+}
+
+struct CivilDate {
+	int year;
+
+	/**
+	 * The month number (0-11).
+	 */
+	int month;
+
+	/**
+	 * The day of the month (1-31).
+	 */
+	int day;
+};
+
+/**
+ * The inverse of DaysFromCivil() ("civil_from_days").
+ */
+static constexpr CivilDate
+CivilFromDays(long days) noexcept
+{
+	days += 719468;
+	const long era = (days >= 0 ? days : days - 146096) / 146097;
+	const int day_of_era = days - era * 146097;
+	const int year_of_era = (day_of_era - day_of_era / 1460
+				 + day_of_era / 36524
+				 - day_of_era / 146096) / 365;
+	const int day_of_year = day_of_era - (365 * year_of_era
+					      + year_of_era / 4
+					      - year_of_era / 100);
+	const int mp = (5 * day_of_year + 2) / 153;
+	const int month = mp < 10 ? mp + 2 : mp - 10;
+	return {
+		int(year_of_era + era * 400) + (month < 2),
+		month,
+		day_of_year - (153 * mp + 2) / 5 + 1,
+	};
+}
+
+static_assert(DaysInMonth(2000, 1) == 29, "");
+static_assert(DaysInMonth(1900, 1) == 28, "");
+static_assert(DaysInMonth(1994, 0) == 31, "");
+static_assert(DaysInMonth(1994, 10) == 30, "");
+static_assert(DaysInMonth(1994, 11) == 31, "");
+
+static_assert(DaysFromCivil(1970, 0, 1) == 0, "");
+static_assert(DaysFromCivil(2000, 2, 1) == 11017, "");
+
+static_assert(CivilFromDays(11017).year == 2000, "");
+static_assert(CivilFromDays(11017).month == 2, "");
+static_assert(CivilFromDays(11017).day == 1, "");
+static_assert(CivilFromDays(-1).year == 1969, "");
+static_assert(CivilFromDays(-1).month == 11, "");
+static_assert(CivilFromDays(-1).day == 31, "");
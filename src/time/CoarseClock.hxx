@@ -0,0 +1,125 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Clocks based on the kernel's coarse clock sources, which are
+ * read from the vDSO without touching the hardware timer.  They are
+ * much cheaper than std::chrono::steady_clock::now(), but their
+ * resolution is only one kernel tick (1-10 ms, see
+ * GetResolution()).  Use them for expiry and logging time stamps.
+ */
+
+#pragma once
+
+#include "Convert.hxx"
+
+#include <chrono>
+
+#include <time.h>
+
+/**
+ * Read the given clock and return a time point of the given type.
+ */
+template<typename TimePoint>
+static inline TimePoint
+ReadClock(clockid_t id) noexcept
+{
+	struct timespec ts;
+	clock_gettime(id, &ts);
+	return TimePoint(std::chrono::duration_cast<typename TimePoint::duration>(ToDuration(ts)));
+}
+
+/**
+ * @see ReadClock()
+ */
+template<typename Duration>
+static inline Duration
+GetClockResolution(clockid_t id) noexcept
+{
+	struct timespec ts;
+	clock_getres(id, &ts);
+	return std::chrono::duration_cast<Duration>(ToDuration(ts));
+}
+
+/**
+ * A coarse variant of std::chrono::steady_clock
+ * (#CLOCK_MONOTONIC_COARSE).  It has the same epoch, and its
+ * time_point type is std::chrono::steady_clock::time_point, so time
+ * stamps of both clocks can be mixed (e.g. with #Expiry), as long as
+ * the difference in resolution is acceptable.
+ */
+struct CoarseSteadyClock {
+	typedef std::chrono::steady_clock::duration duration;
+	typedef duration::rep rep;
+	typedef duration::period period;
+	typedef std::chrono::steady_clock::time_point time_point;
+
+	static constexpr bool is_steady = true;
+
+	static time_point now() noexcept {
+		return ReadClock<time_point>(CLOCK_MONOTONIC_COARSE);
+	}
+
+	static duration GetResolution() noexcept {
+		return GetClockResolution<duration>(CLOCK_MONOTONIC_COARSE);
+	}
+};
+
+/**
+ * A coarse variant of std::chrono::system_clock
+ * (#CLOCK_REALTIME_COARSE); its time_point type is
+ * std::chrono::system_clock::time_point.
+ */
+struct CoarseSystemClock {
+	typedef std::chrono::system_clock::duration duration;
+	typedef duration::rep rep;
+	typedef duration::period period;
+	typedef std::chrono::system_clock::time_point time_point;
+
+	static constexpr bool is_steady = false;
+
+	static time_point now() noexcept {
+		return ReadClock<time_point>(CLOCK_REALTIME_COARSE);
+	}
+
+	static duration GetResolution() noexcept {
+		return GetClockResolution<duration>(CLOCK_REALTIME_COARSE);
+	}
+
+	static time_t to_time_t(time_point t) noexcept {
+		return std::chrono::system_clock::to_time_t(t);
+	}
+
+	static time_point from_time_t(time_t t) noexcept {
+		return std::chrono::system_clock::from_time_t(t);
+	}
+};
@@ -35,6 +35,8 @@
 
 #include <chrono>
 
+#include <time.h>
+
 /**
  * Convert a UTC-based time point to a UTC-based "struct tm".
  */
@@ -59,4 +61,45 @@ TimeGm(struct tm &tm);
 std::chrono::system_clock::time_point
 MakeTime(struct tm &tm);
 
+/**
+ * Convert a "struct timespec" (e.g. from clock_gettime()) to a
+ * std::chrono duration.
+ */
+constexpr std::chrono::nanoseconds
+ToDuration(const struct timespec &ts) noexcept
+{
+	return std::chrono::seconds(ts.tv_sec) +
+		std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+/**
+ * Convert a std::chrono duration to a "struct timespec" (e.g. for
+ * clock_nanosleep() or timerfd_settime()).  Negative durations are
+ * normalized so that tv_nsec is never negative.
+ */
+template<typename Rep, typename Period>
+constexpr struct timespec
+ToTimespec(std::chrono::duration<Rep, Period> d) noexcept
+{
+	const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+	struct timespec ts{time_t(ns / 1000000000), long(ns % 1000000000)};
+	if (ts.tv_nsec < 0) {
+		--ts.tv_sec;
+		ts.tv_nsec += 1000000000;
+	}
+
+	return ts;
+}
+
+/**
+ * Convert a time point to a "struct timespec" relative to its
+ * clock's epoch.
+ */
+template<typename Clock, typename Duration>
+constexpr struct timespec
+ToTimespec(std::chrono::time_point<Clock, Duration> tp) noexcept
+{
+	return ToTimespec(tp.time_since_epoch());
+}
+
 #endif
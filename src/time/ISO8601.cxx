@@ -31,33 +31,247 @@
  */
 
 #include "ISO8601.hxx"
-#include "Convert.hxx"
+#include "Calendar.hxx"
+#include "util/DecimalFormat.h"
+#include "util/StringView.hxx"
 
 #include <stdexcept>
 
+#include <stdint.h>
 #include <time.h>
 
+typedef std::chrono::system_clock::duration Duration;
+
+static constexpr int64_t NANOSECONDS_PER_SECOND = 1000000000;
+static constexpr int64_t SECONDS_PER_DAY = 24 * 60 * 60;
+
+/**
+ * Division rounding towards negative infinity.
+ */
+static constexpr int64_t
+FloorDiv(int64_t a, int64_t b) noexcept
+{
+	return a / b - (a % b < 0);
+}
+
+static char *
+FormatDateTime(char *p, int year, int month, int day,
+	       unsigned hour, unsigned minute, unsigned second) noexcept
+{
+	/* RFC 3339 has only four year digits */
+	if (year < 0)
+		year = 0;
+	else if (year > 9999)
+		year = 9999;
+
+	format_4digit(p, year);
+	p[4] = '-';
+	format_2digit(p + 5, month + 1);
+	p[7] = '-';
+	format_2digit(p + 8, day);
+	p[10] = 'T';
+	format_2digit(p + 11, hour);
+	p[13] = ':';
+	format_2digit(p + 14, minute);
+	p[16] = ':';
+	format_2digit(p + 17, second);
+	return p + 19;
+}
+
 std::string
 FormatISO8601(const struct tm &tm)
 {
-	char buffer[64];
-	strftime(buffer, sizeof(buffer), "%FT%TZ", &tm);
-	return buffer;
+	char buffer[ISO8601_BUFFER_SIZE];
+	char *p = FormatDateTime(buffer, tm.tm_year + 1900, tm.tm_mon,
+				 tm.tm_mday,
+				 tm.tm_hour, tm.tm_min, tm.tm_sec);
+	*p++ = 'Z';
+	return std::string(buffer, p);
+}
+
+char *
+FormatISO8601(char *buffer, std::chrono::system_clock::time_point tp,
+	      unsigned fraction_digits,
+	      std::chrono::minutes utc_offset) noexcept
+{
+	tp += utc_offset;
+
+	const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+	const int64_t seconds = FloorDiv(ns, NANOSECONDS_PER_SECOND);
+	const int64_t days = FloorDiv(seconds, SECONDS_PER_DAY);
+	const unsigned time_of_day = seconds - days * SECONDS_PER_DAY;
+
+	const auto date = CivilFromDays(days);
+	char *p = FormatDateTime(buffer, date.year, date.month, date.day,
+				 time_of_day / 3600,
+				 time_of_day / 60 % 60,
+				 time_of_day % 60);
+
+	if (fraction_digits > 0) {
+		if (fraction_digits > 9)
+			fraction_digits = 9;
+
+		unsigned fraction = ns - seconds * NANOSECONDS_PER_SECOND;
+		*p = '.';
+		for (unsigned i = 9; i > 0; --i) {
+			if (i <= fraction_digits)
+				p[i] = char('0' + fraction % 10);
+			fraction /= 10;
+		}
+
+		p += 1 + fraction_digits;
+	}
+
+	const int offset_minutes = utc_offset.count();
+	if (offset_minutes == 0) {
+		*p++ = 'Z';
+	} else {
+		const unsigned abs_offset = offset_minutes < 0
+			? -offset_minutes
+			: offset_minutes;
+		p[0] = offset_minutes < 0 ? '-' : '+';
+		format_2digit(p + 1, abs_offset / 60 % 100);
+		p[3] = ':';
+		format_2digit(p + 4, abs_offset % 60);
+		p += 6;
+	}
+
+	*p = 0;
+	return p;
 }
 
 std::string
 FormatISO8601(std::chrono::system_clock::time_point tp)
 {
-	return FormatISO8601(GmTime(tp));
+	char buffer[ISO8601_BUFFER_SIZE];
+	const char *end = FormatISO8601(buffer, tp);
+	return std::string(buffer, end - buffer);
+}
+
+/**
+ * @return the digit value or a value >= 10 if this is not a digit
+ */
+static constexpr unsigned
+DigitValue(char ch) noexcept
+{
+	return unsigned(ch) - unsigned('0');
+}
+
+/**
+ * Parse a fixed number of decimal digits.  Errors are accumulated
+ * in #error instead of checking each digit separately.
+ */
+template<unsigned n>
+static unsigned
+ParseDigits(const char *p, unsigned &error) noexcept
+{
+	unsigned value = 0;
+	for (unsigned i = 0; i < n; ++i) {
+		const unsigned digit = DigitValue(p[i]);
+		error |= digit >= 10;
+		value = value * 10 + digit;
+	}
+
+	return value;
 }
 
 std::chrono::system_clock::time_point
-ParseISO8601(const char *s)
+ParseISO8601(StringView s)
 {
-	struct tm tm;
-	const char *end = strptime(s, "%FT%TZ", &tm);
-	if (end == nullptr || *end != 0)
+	/* "YYYY-MM-DDTHH:MM:SS" plus at least "Z" */
+	if (s.size < 20)
+		throw std::runtime_error("Failed to parse ISO8601");
+
+	const char *p = s.data;
+	const char *const end = s.data + s.size;
+
+	unsigned error = 0;
+	const unsigned year = ParseDigits<4>(p, error);
+	const unsigned month = ParseDigits<2>(p + 5, error) - 1;
+	const unsigned day = ParseDigits<2>(p + 8, error);
+	const unsigned hour = ParseDigits<2>(p + 11, error);
+	const unsigned minute = ParseDigits<2>(p + 14, error);
+	const unsigned second = ParseDigits<2>(p + 17, error);
+
+	error |= (p[4] != '-') | (p[7] != '-') |
+		((p[10] != 'T') & (p[10] != 't') & (p[10] != ' ')) |
+		(p[13] != ':') | (p[16] != ':');
+
+	/* a leap second (60) is folded into the next second */
+	error |= (month >= 12) | (hour >= 24) | (minute >= 60) |
+		(second > 60);
+
+	if (error || day < 1 || day > unsigned(DaysInMonth(year, month)))
 		throw std::runtime_error("Failed to parse ISO8601");
 
-	return TimeGm(tm);
+	p += 19;
+
+	int64_t nanoseconds = 0;
+	if (*p == '.' || *p == ',') {
+		++p;
+
+		const char *const fraction = p;
+		int64_t scale = NANOSECONDS_PER_SECOND;
+		while (p < end && DigitValue(*p) < 10) {
+			/* digits beyond nanoseconds are ignored */
+			if (scale > 1) {
+				scale /= 10;
+				nanoseconds += DigitValue(*p) * scale;
+			}
+
+			++p;
+		}
+
+		if (p == fraction)
+			throw std::runtime_error("Failed to parse ISO8601");
+	}
+
+	if (p == end)
+		throw std::runtime_error("Failed to parse ISO8601");
+
+	int offset_minutes = 0;
+	if (*p == 'Z' || *p == 'z') {
+		++p;
+	} else if (*p == '+' || *p == '-') {
+		const bool negative = *p == '-';
+		++p;
+
+		if (end - p < 2)
+			throw std::runtime_error("Failed to parse ISO8601");
+
+		const unsigned offset_hours = ParseDigits<2>(p, error);
+		p += 2;
+
+		unsigned offset_extra_minutes = 0;
+		if (p < end && *p == ':')
+			++p;
+		if (end - p >= 2) {
+			offset_extra_minutes = ParseDigits<2>(p, error);
+			p += 2;
+		}
+
+		if (error || offset_hours >= 24 || offset_extra_minutes >= 60)
+			throw std::runtime_error("Failed to parse ISO8601");
+
+		offset_minutes = offset_hours * 60 + offset_extra_minutes;
+		if (negative)
+			offset_minutes = -offset_minutes;
+	} else
+		throw std::runtime_error("Failed to parse ISO8601");
+
+	if (p != end)
+		throw std::runtime_error("Failed to parse ISO8601");
+
+	const int64_t seconds = DaysFromCivil(year, month, day) * SECONDS_PER_DAY
+		+ (int(hour * 60 + minute) - offset_minutes) * 60 + second;
+
+	const std::chrono::nanoseconds since_epoch(seconds * NANOSECONDS_PER_SECOND
+						   + nanoseconds);
+	return std::chrono::system_clock::time_point(std::chrono::duration_cast<Duration>(since_epoch));
+}
+
+std::chrono::system_clock::time_point
+ParseISO8601(const char *s)
+{
+	return ParseISO8601(StringView(s));
 }
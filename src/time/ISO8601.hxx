@@ -36,14 +36,51 @@
 #include <string>
 #include <chrono>
 
+#include <stddef.h>
+
 struct tm;
+struct StringView;
+
+/**
+ * The buffer size needed by FormatISO8601(char *, ...), including
+ * the null terminator: "YYYY-MM-DDTHH:MM:SS.nnnnnnnnn+HH:MM".
+ */
+static constexpr size_t ISO8601_BUFFER_SIZE = 36;
 
 std::string
 FormatISO8601(const struct tm &tm);
 
+/**
+ * Format a time stamp as "YYYY-MM-DDTHH:MM:SS[.fff]Z" (or with a
+ * "+HH:MM" offset instead of "Z") into the given buffer.  Years
+ * outside of 0..9999 are clamped.
+ *
+ * @param fraction_digits the number of fractional second digits
+ * (0-9); the fraction is truncated, not rounded
+ * @param utc_offset the offset of the desired time zone; the time
+ * stamp is converted to local time in that zone
+ * @return a pointer to the null terminator
+ */
+char *
+FormatISO8601(char *buffer, std::chrono::system_clock::time_point tp,
+	      unsigned fraction_digits=0,
+	      std::chrono::minutes utc_offset=std::chrono::minutes::zero()) noexcept;
+
 std::string
 FormatISO8601(std::chrono::system_clock::time_point tp);
 
+/**
+ * Parse an ISO 8601 (RFC 3339) time stamp:
+ * "YYYY-MM-DDTHH:MM:SS", optionally followed by a fraction of up to
+ * nine significant digits, followed by "Z" or a "+HH:MM", "+HHMM" or
+ * "+HH" offset.  A lower-case "t" or a space may be used instead of
+ * "T", and a lower-case "z" instead of "Z".
+ *
+ * Throws std::runtime_error on error.
+ */
+std::chrono::system_clock::time_point
+ParseISO8601(StringView s);
+
 std::chrono::system_clock::time_point
 ParseISO8601(const char *s);
 
@@ -193,29 +193,42 @@ LEAP_IN_GREG(unsigned year) {
 // ---------- implementation (public) --------------------------
 */
 
+/**
+ * The calendar fields of the most recently converted day.  Most
+ * callers convert the current time over and over, so only the
+ * time of day needs to be computed.  This is per thread, so no
+ * locking is needed.
+ */
+struct gmtime_day_cache {
+    unsigned day;
+
+    int year, mon, mday, yday, wday;
+};
+
+/* initialized with a day number which no 32 bit time_t can reach */
+static __thread struct gmtime_day_cache day_cache = { .day = ~0u };
+
 /**
  * This is an implementation of the "slender"
  * algorithm described in the feb. 1993 paper
  * "efficient timestamp input and output" by
  * C. Dyreson and R. Snodgrass. (Chapter 4.3).
  */
-LIBCORE__STDCALL(xbrokentime *)
-sysx_time_gmtime(time_t tm32, xbrokentime *tmrec)
+static void
+gmtime_day(unsigned day, struct gmtime_day_cache *dest)
 {
-    const unsigned utm32 = (unsigned)tm32; /* year 2037 problem! */
-    unsigned days, year, secs;
+    unsigned days, year;
     int tm_greg;
 
     unsigned int leap;
 
-    secs = utm32 % SECONDS_PER_DAY;
-    days = utm32 / SECONDS_PER_DAY + DAYS_TO_1970;
+    days = day + DAYS_TO_1970;
     tm_greg = days / DAYS_IN_GREG;
     days %= DAYS_IN_GREG;
 
     assert((int)days >= 0);
 
-    tmrec->tm_wday = (days + 1) % 7;
+    dest->wday = (days + 1) % 7;
 
     year = days / 365;
     days = days % 365 - years_to_leap_days[year];
@@ -227,10 +240,28 @@ sysx_time_gmtime(time_t tm32, xbrokentime *tmrec)
     } else
         leap = LEAP_IN_GREG(year);
 
-    tmrec->tm_year = tm_greg * 400 + year + 1 - 1900;
-    tmrec->tm_mon  = day_to_mon[days] >> 4 * leap & 0x0f;
-    tmrec->tm_mday = day_to_day[days] >> 8 * leap & 0xff;
-    tmrec->tm_yday = days;
+    dest->day = day;
+    dest->year = tm_greg * 400 + year + 1 - 1900;
+    dest->mon  = day_to_mon[days] >> 4 * leap & 0x0f;
+    dest->mday = day_to_day[days] >> 8 * leap & 0xff;
+    dest->yday = days;
+}
+
+LIBCORE__STDCALL(xbrokentime *)
+sysx_time_gmtime(time_t tm32, xbrokentime *tmrec)
+{
+    const unsigned utm32 = (unsigned)tm32; /* year 2037 problem! */
+    const unsigned day = utm32 / SECONDS_PER_DAY;
+    unsigned secs = utm32 % SECONDS_PER_DAY;
+
+    if (gcc_unlikely(day_cache.day != day))
+        gmtime_day(day, &day_cache);
+
+    tmrec->tm_wday = day_cache.wday;
+    tmrec->tm_year = day_cache.year;
+    tmrec->tm_mon  = day_cache.mon;
+    tmrec->tm_mday = day_cache.mday;
+    tmrec->tm_yday = day_cache.yday;
 
     tmrec->tm_hour = secs / 3600;
     secs %= 3600;
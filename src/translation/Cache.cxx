@@ -0,0 +1,330 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Cache.hxx"
+
+#if TRANSLATION_ENABLE_CACHE
+
+#include "Response.hxx"
+#include "AllocatorPtr.hxx"
+
+#include <string.h>
+
+/**
+ * Append the request's values of the given commands to the key.
+ * Each value is encoded as the command, a "present" flag, and (if
+ * present) a 32 bit length and the payload.
+ */
+static void
+AppendVary(std::string &key, const TranslationCacheRequest &request,
+           ConstBuffer<TranslationCommand> vary)
+{
+    key.push_back('\0');
+
+    for (const auto command : vary) {
+        key.append((const char *)&command, sizeof(command));
+
+        const auto value = request.GetCacheParameter(command);
+        if (value.IsNull()) {
+            key.push_back(0);
+            continue;
+        }
+
+        key.push_back(1);
+
+        const uint32_t size = value.size;
+        key.append((const char *)&size, sizeof(size));
+        key.append((const char *)value.data, value.size);
+    }
+}
+
+/**
+ * Find a command's value in a suffix built by AppendVary().
+ *
+ * @return false if the command is not part of the suffix
+ */
+gcc_pure
+static bool
+FindVaryValue(StringView suffix, TranslationCommand command,
+              ConstBuffer<void> &value_r) noexcept
+{
+    if (suffix.empty())
+        return false;
+
+    /* skip the separator */
+    suffix.skip_front(1);
+
+    while (!suffix.empty()) {
+        TranslationCommand c;
+        memcpy(&c, suffix.data, sizeof(c));
+        suffix.skip_front(sizeof(c));
+
+        const bool present = suffix.front() != 0;
+        suffix.skip_front(1);
+
+        ConstBuffer<void> value = nullptr;
+        if (present) {
+            uint32_t size;
+            memcpy(&size, suffix.data, sizeof(size));
+            suffix.skip_front(sizeof(size));
+
+            value = {suffix.data, size};
+            suffix.skip_front(size);
+        }
+
+        if (c == command) {
+            value_r = value;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+gcc_pure
+static bool
+ParameterEquals(ConstBuffer<void> a, ConstBuffer<void> b) noexcept
+{
+    if (a.IsNull() || b.IsNull())
+        return a.IsNull() == b.IsNull();
+
+    return a.size == b.size && memcmp(a.data, b.data, a.size) == 0;
+}
+
+TranslationCache::Item *
+TranslationCache::Find(StringView _key, TimePoint now,
+                       const TranslationCacheRequest &request) noexcept
+{
+    std::string key(_key.data, _key.size);
+
+    Item *item = cache.Get(key);
+    if (item == nullptr)
+        return nullptr;
+
+    if (item->expires <= now) {
+        Remove(*item);
+        return nullptr;
+    }
+
+    if (!item->IsMarker())
+        return item;
+
+    /* the response varies on request attributes: look up the item
+       for this request's values */
+    AppendVary(key, request, {item->vary.data(), item->vary.size()});
+
+    item = cache.Get(key);
+    if (item == nullptr)
+        return nullptr;
+
+    if (item->expires <= now) {
+        Remove(*item);
+        return nullptr;
+    }
+
+    return item;
+}
+
+ConstBuffer<void>
+TranslationCache::Lookup(AllocatorPtr alloc,
+                         const TranslationCacheRequest &request,
+                         TimePoint now,
+                         StringView &base_suffix_r) noexcept
+{
+    const StringView key = request.GetCacheKey();
+
+    size_t prefix_length = key.size;
+    const Item *item = Find(key, now, request);
+
+    /* no exact match: look for a BASE response covering this key,
+       starting with the longest prefix */
+    while (item == nullptr && prefix_length > 1) {
+        --prefix_length;
+        if (key[prefix_length - 1] != '/')
+            continue;
+
+        item = Find({key.data, prefix_length}, now, request);
+        if (item != nullptr && !item->base)
+            item = nullptr;
+    }
+
+    if (item == nullptr) {
+        ++stats.misses;
+        return nullptr;
+    }
+
+    ++stats.hits;
+
+    base_suffix_r = item->base
+        ? StringView(key.data + prefix_length, key.size - prefix_length)
+        : nullptr;
+
+    return alloc.Dup(item->GetImage());
+}
+
+void
+TranslationCache::MakeRoom(size_t size) noexcept
+{
+    while (cache.IsFull() || bytes + size > config.max_bytes) {
+        Item *oldest = cache.PeekOldest();
+        if (oldest == nullptr)
+            break;
+
+        Remove(*oldest);
+        ++stats.evictions;
+    }
+}
+
+void
+TranslationCache::Put(std::string &&key, Item &&item) noexcept
+{
+    item.bytes = sizeof(item) + key.size() + item.image_size +
+        item.site.size() + item.vary.size() * sizeof(item.vary.front());
+
+    Item *old = cache.Get(key);
+    if (old != nullptr)
+        Remove(*old);
+
+    MakeRoom(item.bytes);
+
+    bytes += item.bytes;
+    cache.Put(std::move(key), std::move(item));
+}
+
+void
+TranslationCache::Store(const TranslationCacheRequest &request,
+                        const TranslateResponse &response,
+                        ConstBuffer<void> image,
+                        TimePoint now) noexcept
+{
+    if (!response.invalidate.empty())
+        Invalidate(request, response.invalidate);
+
+    if (image.empty() || response.max_age.count() == 0 ||
+        response.regex != nullptr || response.inverse_regex != nullptr ||
+        image.size + request.GetCacheKey().size > config.max_bytes / 2) {
+        ++stats.uncacheable;
+        return;
+    }
+
+    StringView key = request.GetCacheKey();
+
+    /* a response with a BASE covering the key is stored under the
+       BASE, so it is found for all keys below it */
+    bool base = false;
+    if (response.base != nullptr) {
+        const StringView b(response.base);
+        if (!b.empty() && b.back() == '/' && key.StartsWith(b)) {
+            key = b;
+            base = true;
+        }
+    }
+
+    Item item;
+    item.site = response.site != nullptr ? response.site : "";
+    item.expires = now + (response.max_age.count() > 0
+                          ? response.max_age
+                          : config.default_max_age);
+    item.base = base;
+
+    std::string primary(key.data, key.size);
+
+    if (!response.vary.empty()) {
+        Item marker;
+        marker.image_size = 0;
+        marker.site = item.site;
+        marker.vary.assign(response.vary.begin(), response.vary.end());
+        marker.vary_offset = primary.size();
+        marker.expires = item.expires;
+        marker.base = base;
+
+        item.vary_offset = primary.size();
+
+        std::string full = primary;
+        AppendVary(full, request, response.vary);
+
+        Put(std::move(primary), std::move(marker));
+        primary = std::move(full);
+    } else
+        item.vary_offset = primary.size();
+
+    item.image.reset(new uint8_t[image.size]);
+    memcpy(item.image.get(), image.data, image.size);
+    item.image_size = image.size;
+
+    Put(std::move(primary), std::move(item));
+    ++stats.stores;
+}
+
+void
+TranslationCache::Invalidate(const TranslationCacheRequest &request,
+                             ConstBuffer<TranslationCommand> commands) noexcept
+{
+    cache.RemoveIf([this, &request, commands](const std::string &key,
+                                              const Item &item){
+            if (item.IsMarker())
+                return false;
+
+            const StringView suffix(key.data() + item.vary_offset,
+                                    key.size() - item.vary_offset);
+
+            /* commands the item does not vary on match any value;
+               this may remove more items than necessary, but never
+               too few */
+            for (const auto command : commands) {
+                ConstBuffer<void> value;
+                if (FindVaryValue(suffix, command, value) &&
+                    !ParameterEquals(value,
+                                     request.GetCacheParameter(command)))
+                    return false;
+            }
+
+            bytes -= item.bytes;
+            ++stats.invalidations;
+            return true;
+        });
+}
+
+void
+TranslationCache::InvalidateSite(StringView site) noexcept
+{
+    cache.RemoveIf([this, site](const std::string &, const Item &item){
+            if (!site.Equals(StringView(item.site.data(), item.site.size())))
+                return false;
+
+            bytes -= item.bytes;
+            ++stats.invalidations;
+            return true;
+        });
+}
+
+#endif
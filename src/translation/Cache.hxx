@@ -0,0 +1,276 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BENG_PROXY_TRANSLATE_CACHE_HXX
+#define BENG_PROXY_TRANSLATE_CACHE_HXX
+
+#include "translation/Features.hxx"
+
+#if TRANSLATION_ENABLE_CACHE
+
+#include "Protocol.hxx"
+#include "util/Cache.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/StringView.hxx"
+#include "util/Compiler.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct TranslateResponse;
+class AllocatorPtr;
+
+/**
+ * The request attributes a #TranslationCache needs.  This is an
+ * interface so the cache does not depend on the request structure
+ * of a specific client.
+ */
+class TranslationCacheRequest {
+public:
+    /**
+     * The primary cache key, usually the request URI.
+     */
+    gcc_pure
+    virtual StringView GetCacheKey() const noexcept = 0;
+
+    /**
+     * Returns the payload of the request packet with the given
+     * command (for #TranslationCommand::VARY and
+     * #TranslationCommand::INVALIDATE), or nullptr if the request
+     * did not contain it.
+     */
+    gcc_pure
+    virtual ConstBuffer<void> GetCacheParameter(TranslationCommand command) const noexcept = 0;
+};
+
+/**
+ * A cache for translation responses.  The responses are stored as
+ * images built by #TranslationImageBuilder; a hit returns a copy of
+ * that image, which TranslateParser::ProcessImage() turns back into
+ * a #TranslateResponse.
+ *
+ * The cache honours #TranslationCommand::MAX_AGE, VARY, INVALIDATE
+ * and BASE.  Responses with REGEX or INVERSE_REGEX are not cached.
+ */
+class TranslationCache {
+public:
+    struct Config {
+        /**
+         * The maximum number of bytes occupied by all items.
+         */
+        size_t max_bytes = 16 * 1024 * 1024;
+
+        /**
+         * The lifetime of responses without MAX_AGE.
+         */
+        std::chrono::seconds default_max_age = std::chrono::hours(1);
+    };
+
+    struct Stats {
+        uint64_t hits = 0, misses = 0;
+
+        uint64_t stores = 0;
+
+        /**
+         * Responses which were not stored because they were not
+         * cacheable.
+         */
+        uint64_t uncacheable = 0;
+
+        /**
+         * Items removed to stay within the item limit or the
+         * memory budget.
+         */
+        uint64_t evictions = 0;
+
+        /**
+         * Items removed by INVALIDATE or InvalidateSite().
+         */
+        uint64_t invalidations = 0;
+    };
+
+private:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    struct Item {
+        /**
+         * The response image; nullptr for a VARY marker.
+         */
+        std::unique_ptr<uint8_t[]> image;
+        size_t image_size;
+
+        /**
+         * The response's SITE, for InvalidateSite().
+         */
+        std::string site;
+
+        /**
+         * For a VARY marker: the commands the response varies on.
+         * The actual response is stored under a key which includes
+         * the request's values of these commands.
+         */
+        std::vector<TranslationCommand> vary;
+
+        /**
+         * The position of the VARY values within the key; this
+         * equals the key length if there are none.
+         */
+        size_t vary_offset;
+
+        /**
+         * The number of bytes accounted for this item.
+         */
+        size_t bytes;
+
+        TimePoint expires;
+
+        /**
+         * Was this response stored under its BASE?
+         */
+        bool base;
+
+        bool IsMarker() const noexcept {
+            return image == nullptr;
+        }
+
+        ConstBuffer<void> GetImage() const noexcept {
+            return {image.get(), image_size};
+        }
+    };
+
+    static constexpr size_t MAX_ITEMS = 16384;
+
+    /**
+     * Segmented LRU, so a crawler sweeping over many URLs once
+     * cannot flush the entries of popular sites.
+     */
+    typedef ::Cache<std::string, Item, MAX_ITEMS, 16411,
+                    std::hash<std::string>, std::equal_to<std::string>,
+                    CacheSlruPolicy<>> ItemCache;
+
+    const Config config;
+
+    ItemCache cache;
+
+    size_t bytes = 0;
+
+    Stats stats;
+
+public:
+    explicit TranslationCache(const Config &_config) noexcept
+        :config(_config) {}
+
+    TranslationCache(const TranslationCache &) = delete;
+    TranslationCache &operator=(const TranslationCache &) = delete;
+
+    const Stats &GetStats() const noexcept {
+        return stats;
+    }
+
+    /**
+     * The number of bytes occupied by all items.
+     */
+    size_t GetBytes() const noexcept {
+        return bytes;
+    }
+
+    void Clear() noexcept {
+        cache.Clear();
+        bytes = 0;
+    }
+
+    /**
+     * Look up a response.
+     *
+     * @param alloc the allocator for the returned image
+     * @param base_suffix_r if the response was stored under its
+     * BASE, then this receives the part of the key following the
+     * base; the caller must apply it to the response, like
+     * TranslateResponse::CacheStore() does
+     * @return a copy of the response image or nullptr on miss
+     */
+    ConstBuffer<void> Lookup(AllocatorPtr alloc,
+                             const TranslationCacheRequest &request,
+                             TimePoint now,
+                             StringView &base_suffix_r) noexcept;
+
+    /**
+     * Store a response received from the translation server.
+     * This also handles the response's INVALIDATE list, even if the
+     * response itself is not cacheable.
+     *
+     * @param image the image recorded by
+     * TranslateParser::SetImageBuilder() while parsing the response
+     */
+    void Store(const TranslationCacheRequest &request,
+               const TranslateResponse &response,
+               ConstBuffer<void> image,
+               TimePoint now) noexcept;
+
+    /**
+     * Remove all items whose request values of the given commands
+     * match the given request.
+     */
+    void Invalidate(const TranslationCacheRequest &request,
+                    ConstBuffer<TranslationCommand> commands) noexcept;
+
+    /**
+     * Remove all items belonging to the given SITE.
+     */
+    void InvalidateSite(StringView site) noexcept;
+
+private:
+    Item *Find(StringView key, TimePoint now,
+               const TranslationCacheRequest &request) noexcept;
+
+    void Put(std::string &&key, Item &&item) noexcept;
+
+    void Remove(Item &item) noexcept {
+        bytes -= item.bytes;
+        cache.RemoveItem(item);
+    }
+
+    /**
+     * Evict least recently used items until there is room for an
+     * item of the given size.
+     */
+    void MakeRoom(size_t size) noexcept;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,369 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Client.hxx"
+#include "Parser.hxx"
+#include "Handler.hxx"
+#include "event/Loop.hxx"
+
+#include <stdexcept>
+
+#include <assert.h>
+#include <string.h>
+
+void
+TranslationClient::Waiter::Deliver(ConstBuffer<void> data) noexcept
+{
+    try {
+        TranslateParser parser(alloc
+#if TRANSLATION_CLIENT_HAS_REQUEST
+                               , request
+#endif
+                               );
+
+        const auto *p = (const uint8_t *)data.data;
+        const auto *const end = p + data.size;
+
+        TranslateParser::Result result = TranslateParser::Result::MORE;
+        while (result == TranslateParser::Result::MORE && p < end) {
+            size_t nbytes = parser.Feed(p, end - p);
+            if (nbytes == 0)
+                break;
+
+            p += nbytes;
+            result = parser.Process();
+        }
+
+        if (result != TranslateParser::Result::DONE)
+            throw std::runtime_error("Truncated translation response");
+
+        const auto &_handler = handler;
+        void *const _ctx = ctx;
+        delete this;
+        _handler.response(parser.GetResponse(), _ctx);
+    } catch (...) {
+        ++operation.client.stats.errors;
+        Fail(std::current_exception());
+    }
+}
+
+void
+TranslationClient::Waiter::Fail(std::exception_ptr error) noexcept
+{
+    const auto &_handler = handler;
+    void *const _ctx = ctx;
+    delete this;
+    _handler.error(error, _ctx);
+}
+
+void
+TranslationClient::Waiter::Cancel()
+{
+    operation.Cancel(*this);
+}
+
+void
+TranslationClient::Operation::Cancel(Waiter &waiter) noexcept
+{
+    waiters.erase(waiters.iterator_to(waiter));
+    delete &waiter;
+
+    /* a request which has been sent already is kept until its
+       response arrives, to keep the connection usable */
+    if (waiters.empty() && connection == nullptr)
+        client.RemoveOperation(*this);
+}
+
+bool
+TranslationClient::Connection::TryWrite() noexcept
+{
+    assert(operation != nullptr);
+
+    const std::string &packets = *operation->packets;
+    assert(write_position < packets.size());
+
+    ssize_t nbytes = socket.Write(packets.data() + write_position,
+                                  packets.size() - write_position);
+    if (nbytes < 0) {
+        if (nbytes == WRITE_BLOCKING)
+            return true;
+
+        if (nbytes == WRITE_DESTROYED)
+            return false;
+
+        Abort(std::make_exception_ptr(std::runtime_error("Failed to send translation request")));
+        return false;
+    }
+
+    write_position += nbytes;
+    if (write_position < packets.size()) {
+        socket.ScheduleWrite();
+        return true;
+    }
+
+    socket.UnscheduleWrite();
+    socket.ScheduleReadTimeout(true, &client.config.timeout);
+    return true;
+}
+
+bool
+TranslationClient::Connection::ScanResponse()
+{
+    while (response.size() - scan_position >= sizeof(TranslationHeader)) {
+        TranslationHeader header;
+        memcpy(&header, &response[scan_position], sizeof(header));
+
+        const size_t packet_size = sizeof(header) + header.length;
+        if (response.size() - scan_position < packet_size)
+            /* need more data */
+            break;
+
+        scan_position += packet_size;
+
+        if (header.command != TranslationCommand::END)
+            continue;
+
+        if (scan_position != response.size())
+            throw SocketProtocolError("Excess data after translation response");
+
+        Operation &o = *std::exchange(operation, nullptr);
+        client.OnResponse(*this, o, {response.data(), response.size()});
+        return true;
+    }
+
+    return true;
+}
+
+BufferedResult
+TranslationClient::Connection::OnBufferedData(const void *buffer, size_t size)
+{
+    if (operation == nullptr)
+        throw SocketProtocolError("Unexpected data from translation server");
+
+    const auto *p = (const uint8_t *)buffer;
+    response.insert(response.end(), p, p + size);
+    socket.Consumed(size);
+
+    ScanResponse();
+    return operation != nullptr
+        ? BufferedResult::MORE
+        : BufferedResult::OK;
+}
+
+TranslationClient::TranslationClient(EventLoop &_event_loop,
+                                     const Config &_config,
+                                     std::vector<AllocatedSocketAddress> &&_servers) noexcept
+    :event_loop(_event_loop), config(_config),
+     defer_dispatch(_event_loop, BIND_THIS_METHOD(Dispatch))
+{
+    assert(!_servers.empty());
+
+    servers.reserve(_servers.size());
+    for (auto &i : _servers)
+        servers.emplace_back(std::move(i));
+}
+
+TranslationClient::~TranslationClient() noexcept
+{
+    assert(busy_connections.empty());
+    assert(queue.empty());
+
+    idle_connections.clear_and_dispose([](Connection *c){
+            delete c;
+        });
+}
+
+void
+TranslationClient::SendRequest(AllocatorPtr alloc,
+#if TRANSLATION_CLIENT_HAS_REQUEST
+                               const TranslateRequest &request,
+#endif
+                               ConstBuffer<void> packets,
+                               const TranslateHandler &handler, void *ctx,
+                               CancellablePointer &cancel_ptr) noexcept
+{
+    ++stats.requests;
+
+    std::string key((const char *)packets.data, packets.size);
+
+    auto i = operations.find(key);
+    if (i != operations.end()) {
+        ++stats.coalesced;
+    } else {
+        if (queue.size() >= config.max_queued) {
+            ++stats.rejected;
+            handler.error(std::make_exception_ptr(std::runtime_error("Translation client queue is full")),
+                          ctx);
+            return;
+        }
+
+        i = operations.emplace(std::piecewise_construct,
+                               std::forward_as_tuple(std::move(key)),
+                               std::forward_as_tuple(*this)).first;
+
+        Operation &o = i->second;
+        o.packets = &i->first;
+        queue.push_back(o);
+        defer_dispatch.Schedule();
+    }
+
+    Operation &o = i->second;
+    auto *waiter = new Waiter(o, alloc,
+#if TRANSLATION_CLIENT_HAS_REQUEST
+                              request,
+#endif
+                              handler, ctx);
+    o.waiters.push_back(*waiter);
+    cancel_ptr = *waiter;
+}
+
+size_t
+TranslationClient::PickServer() noexcept
+{
+    const auto now = event_loop.SteadyNow();
+
+    for (size_t n = 0; n < servers.size(); ++n) {
+        const size_t i = (next_server + n) % servers.size();
+        if (servers[i].failed_until <= now) {
+            next_server = (i + 1) % servers.size();
+            return i;
+        }
+    }
+
+    /* all servers have failed recently: try the next one anyway */
+    const size_t i = next_server;
+    next_server = (i + 1) % servers.size();
+    return i;
+}
+
+void
+TranslationClient::Dispatch() noexcept
+{
+    while (!queue.empty()) {
+        Operation &o = queue.front();
+
+        if (!idle_connections.empty()) {
+            Connection &c = idle_connections.front();
+            idle_connections.pop_front();
+            busy_connections.push_back(c);
+
+            queue.pop_front();
+            o.connection = &c;
+            c.Start(o);
+        } else if (GetConnectionCount() < config.max_connections) {
+            const size_t server = PickServer();
+            auto *c = new Connection(*this, server, o);
+            busy_connections.push_back(*c);
+
+            queue.pop_front();
+            o.connection = c;
+
+            /* on error, this calls OnConnectionError(), which
+               deletes the connection */
+            c->Connect(servers[server].address);
+        } else
+            break;
+    }
+}
+
+void
+TranslationClient::RemoveOperation(Operation &o) noexcept
+{
+    if (o.IsQueued())
+        queue.erase(queue.iterator_to(o));
+
+    operations.erase(operations.find(*o.packets));
+}
+
+void
+TranslationClient::OnResponse(Connection &c, Operation &o,
+                              ConstBuffer<void> response) noexcept
+{
+    /* the connection can be reused now */
+    busy_connections.erase(busy_connections.iterator_to(c));
+    idle_connections.push_front(c);
+    if (!queue.empty())
+        defer_dispatch.Schedule();
+
+    /* remove the operation before invoking the handlers, so
+       requests submitted by them are not attached to it */
+    WaiterList waiters;
+    waiters.swap(o.waiters);
+    RemoveOperation(o);
+
+    waiters.clear_and_dispose([response](Waiter *w){
+            w->Deliver(response);
+        });
+}
+
+void
+TranslationClient::OnConnectionError(Connection &c, Operation *o,
+                                     std::exception_ptr error,
+                                     bool retry) noexcept
+{
+    const size_t server = c.GetServer();
+    busy_connections.erase(busy_connections.iterator_to(c));
+    delete &c;
+
+    if (o == nullptr)
+        /* an idle connection was closed */
+        return;
+
+    servers[server].failed_until =
+        event_loop.SteadyNow() + config.failure_duration;
+
+    o->connection = nullptr;
+
+    if (o->waiters.empty()) {
+        /* all callers have canceled */
+        RemoveOperation(*o);
+    } else if (retry && ++o->failures < servers.size()) {
+        ++stats.failovers;
+        queue.push_front(*o);
+        defer_dispatch.Schedule();
+    } else
+        Fail(*o, error);
+}
+
+void
+TranslationClient::Fail(Operation &o, std::exception_ptr error) noexcept
+{
+    ++stats.errors;
+
+    WaiterList waiters;
+    waiters.swap(o.waiters);
+    RemoveOperation(o);
+
+    waiters.clear_and_dispose([error](Waiter *w){
+            w->Fail(error);
+        });
+}
@@ -0,0 +1,452 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BENG_PROXY_TRANSLATE_CLIENT_HXX
+#define BENG_PROXY_TRANSLATE_CLIENT_HXX
+
+#include "translation/Features.hxx"
+#include "AllocatorPtr.hxx"
+#include "event/DeferEvent.hxx"
+#include "event/net/ConnectSocket.hxx"
+#include "event/net/BufferedSocket.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "net/SocketProtocolError.hxx"
+#include "util/Cancellable.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <chrono>
+#include <exception>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/time.h>
+
+#define TRANSLATION_CLIENT_HAS_REQUEST (TRANSLATION_ENABLE_RADDRESS || TRANSLATION_ENABLE_HTTP || TRANSLATION_ENABLE_WANT)
+
+struct TranslateRequest;
+struct TranslateHandler;
+class EventLoop;
+
+/**
+ * A client for the translation protocol with a pool of persistent
+ * connections to one or more translation servers.
+ *
+ * The protocol allows only one request at a time on a connection.
+ * Requests are therefore spread over up to
+ * #Config::max_connections connections, and the rest wait in a
+ * bounded queue.  Identical concurrent requests (same packets) are
+ * sent only once; all callers receive a copy of the response.
+ *
+ * If connecting fails, or a connection fails before the first
+ * response byte, the request is retried on the next server.  The
+ * failed server is skipped for #Config::failure_duration.
+ */
+class TranslationClient {
+public:
+    struct Config {
+        unsigned max_connections = 8;
+
+        /**
+         * The maximum number of requests waiting for a connection.
+         * Beyond that, new requests fail immediately.
+         */
+        unsigned max_queued = 1024;
+
+        std::chrono::steady_clock::duration failure_duration =
+            std::chrono::seconds(10);
+
+        /**
+         * The read/write timeout of a busy connection.
+         */
+        struct timeval timeout = {30, 0};
+    };
+
+    struct Stats {
+        uint64_t requests = 0;
+
+        /**
+         * Requests which were attached to an identical pending
+         * request.
+         */
+        uint64_t coalesced = 0;
+
+        /**
+         * Requests which failed because the queue was full.
+         */
+        uint64_t rejected = 0;
+
+        /**
+         * Requests which were retried on another server.
+         */
+        uint64_t failovers = 0;
+
+        uint64_t errors = 0;
+    };
+
+private:
+    struct Server {
+        AllocatedSocketAddress address;
+
+        std::chrono::steady_clock::time_point failed_until;
+
+        explicit Server(AllocatedSocketAddress &&_address) noexcept
+            :address(std::move(_address)) {}
+    };
+
+    struct Operation;
+    class Connection;
+
+    /**
+     * One caller waiting for the response of an #Operation.
+     */
+    struct Waiter final
+        : boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>>,
+          Cancellable {
+
+        Operation &operation;
+
+        AllocatorPtr alloc;
+
+    #if TRANSLATION_CLIENT_HAS_REQUEST
+        const TranslateRequest &request;
+    #endif
+
+        const TranslateHandler &handler;
+        void *const ctx;
+
+        Waiter(Operation &_operation, AllocatorPtr _alloc,
+    #if TRANSLATION_CLIENT_HAS_REQUEST
+               const TranslateRequest &_request,
+    #endif
+               const TranslateHandler &_handler, void *_ctx) noexcept
+            :operation(_operation), alloc(_alloc),
+    #if TRANSLATION_CLIENT_HAS_REQUEST
+             request(_request),
+    #endif
+             handler(_handler), ctx(_ctx) {}
+
+        /**
+         * Parse the response and invoke the handler.  Deletes this
+         * object.
+         */
+        void Deliver(ConstBuffer<void> response) noexcept;
+
+        /**
+         * Invoke the error handler.  Deletes this object.
+         */
+        void Fail(std::exception_ptr error) noexcept;
+
+        /* virtual methods from class Cancellable */
+        void Cancel() override;
+    };
+
+    typedef boost::intrusive::list<Waiter,
+                                   boost::intrusive::constant_time_size<false>> WaiterList;
+
+    /**
+     * A request which is queued or being sent to a server, together
+     * with all callers waiting for its response.
+     */
+    struct Operation final
+        : boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::safe_link>> {
+
+        TranslationClient &client;
+
+        /**
+         * The request packets; this is the key in
+         * TranslationClient::operations.
+         */
+        const std::string *packets = nullptr;
+
+        WaiterList waiters;
+
+        /**
+         * The connection this request has been assigned to, or
+         * nullptr if it is still queued.
+         */
+        Connection *connection = nullptr;
+
+        /**
+         * The number of servers which have failed this request.
+         */
+        unsigned failures = 0;
+
+        explicit Operation(TranslationClient &_client) noexcept
+            :client(_client) {}
+
+        ~Operation() noexcept {
+            assert(waiters.empty());
+        }
+
+        Operation(const Operation &) = delete;
+        Operation &operator=(const Operation &) = delete;
+
+        bool IsQueued() const noexcept {
+            return is_linked();
+        }
+
+        void Cancel(Waiter &waiter) noexcept;
+    };
+
+    /**
+     * A connection to one translation server.  It handles one
+     * #Operation at a time.
+     */
+    class Connection final
+        : public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>>,
+          ConnectSocketHandler, BufferedSocketHandler {
+
+        TranslationClient &client;
+
+        const size_t server;
+
+        ConnectSocket connect;
+
+        BufferedSocket socket;
+
+        Operation *operation;
+
+        size_t write_position;
+
+        /**
+         * The response received so far.  It is collected until the END
+         * packet has been seen, and then parsed for each waiter.
+         */
+        std::vector<uint8_t> response;
+
+        /**
+         * The position in #response up to which complete packets
+         * have been scanned.
+         */
+        size_t scan_position;
+
+    public:
+        Connection(TranslationClient &_client, size_t _server,
+                   Operation &_operation) noexcept
+            :client(_client), server(_server),
+             connect(_client.event_loop, *this),
+             socket(_client.event_loop),
+             operation(&_operation) {}
+
+        ~Connection() noexcept {
+            if (socket.IsValid()) {
+                if (socket.IsConnected())
+                    socket.Close();
+                socket.Destroy();
+            }
+        }
+
+        size_t GetServer() const noexcept {
+            return server;
+        }
+
+        /**
+         * Connect to the server and send the request.
+         *
+         * @return false if the connection has been destroyed already
+         */
+        bool Connect(SocketAddress address) noexcept {
+            return connect.Connect(address, client.config.timeout);
+        }
+
+        /**
+         * Send a request on this idle connection.
+         */
+        void Start(Operation &_operation) noexcept {
+            assert(operation == nullptr);
+
+            operation = &_operation;
+            BeginRequest();
+        }
+
+    private:
+        void BeginRequest() noexcept {
+            write_position = 0;
+            response.clear();
+            scan_position = 0;
+            TryWrite();
+        }
+
+        /**
+         * @return false if the connection has been destroyed
+         */
+        bool TryWrite() noexcept;
+
+        /**
+         * @return false if the connection has been destroyed
+         */
+        bool ScanResponse();
+
+        void Abort(std::exception_ptr error) noexcept {
+            Operation *o = std::exchange(operation, nullptr);
+            client.OnConnectionError(*this, o, error, response.empty());
+        }
+
+        /* virtual methods from class ConnectSocketHandler */
+        void OnSocketConnectSuccess(UniqueSocketDescriptor &&fd) override {
+            socket.Init(fd.Release(), FD_SOCKET,
+                        &client.config.timeout, &client.config.timeout,
+                        *this);
+            BeginRequest();
+        }
+
+        void OnSocketConnectError(std::exception_ptr ep) override {
+            Abort(ep);
+        }
+
+        /* virtual methods from class BufferedSocketHandler */
+        BufferedResult OnBufferedData(const void *buffer, size_t size) override;
+
+        bool OnBufferedClosed() noexcept override {
+            Abort(std::make_exception_ptr(SocketClosedPrematurelyError()));
+            return false;
+        }
+
+        bool OnBufferedWrite() override {
+            return TryWrite();
+        }
+
+        void OnBufferedError(std::exception_ptr e) noexcept override {
+            Abort(e);
+        }
+    };
+
+    typedef boost::intrusive::list<Operation,
+                                   boost::intrusive::constant_time_size<true>> OperationQueue;
+
+    typedef boost::intrusive::list<Connection,
+                                   boost::intrusive::constant_time_size<true>> ConnectionList;
+
+    EventLoop &event_loop;
+
+    const Config config;
+
+    std::vector<Server> servers;
+
+    /**
+     * The next server to try for a new connection.
+     */
+    size_t next_server = 0;
+
+    /**
+     * All pending requests, indexed by their packets for
+     * coalescing.
+     */
+    std::unordered_map<std::string, Operation> operations;
+
+    /**
+     * Requests waiting for a connection.
+     */
+    OperationQueue queue;
+
+    ConnectionList idle_connections, busy_connections;
+
+    /**
+     * Assigns queued requests to connections.  Deferred so request
+     * submission and error handling never recurse into each other.
+     */
+    DeferEvent defer_dispatch;
+
+    Stats stats;
+
+public:
+    /**
+     * @param _servers the addresses of the translation servers;
+     * must not be empty
+     */
+    TranslationClient(EventLoop &_event_loop, const Config &_config,
+                      std::vector<AllocatedSocketAddress> &&_servers) noexcept;
+
+    /**
+     * All requests must have been finished or canceled.
+     */
+    ~TranslationClient() noexcept;
+
+    TranslationClient(const TranslationClient &) = delete;
+    TranslationClient &operator=(const TranslationClient &) = delete;
+
+    const Stats &GetStats() const noexcept {
+        return stats;
+    }
+
+    size_t GetConnectionCount() const noexcept {
+        return idle_connections.size() + busy_connections.size();
+    }
+
+    size_t GetQueueLength() const noexcept {
+        return queue.size();
+    }
+
+    /**
+     * Send a translation request.  Exactly one of the handler
+     * methods will be called, unless the operation is canceled.
+     *
+     * @param alloc the allocator for the response
+     * @param request the request the packets were built from; it
+     * is used by #TranslateParser and must remain valid until the
+     * handler has been called
+     * @param packets the serialized request, from BEGIN to END;
+     * it is copied
+     */
+    void SendRequest(AllocatorPtr alloc,
+#if TRANSLATION_CLIENT_HAS_REQUEST
+                     const TranslateRequest &request,
+#endif
+                     ConstBuffer<void> packets,
+                     const TranslateHandler &handler, void *ctx,
+                     CancellablePointer &cancel_ptr) noexcept;
+
+private:
+    size_t PickServer() noexcept;
+
+    void Dispatch() noexcept;
+
+    void RemoveOperation(Operation &operation) noexcept;
+
+    void OnResponse(Connection &connection, Operation &operation,
+                    ConstBuffer<void> response) noexcept;
+
+    /**
+     * @param retry may the request be sent again, i.e. has no
+     * response byte been received yet?
+     */
+    void OnConnectionError(Connection &connection, Operation *operation,
+                           std::exception_ptr error, bool retry) noexcept;
+
+    void Fail(Operation &operation, std::exception_ptr error) noexcept;
+};
+
+#endif
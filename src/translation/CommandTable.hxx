@@ -0,0 +1,124 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * A constexpr classification of all #TranslationCommand values,
+ * used for rejecting unexpected packets before dispatching them.
+ */
+
+#ifndef BENG_PROXY_TRANSLATION_COMMAND_TABLE_HXX
+#define BENG_PROXY_TRANSLATION_COMMAND_TABLE_HXX
+
+#include "Protocol.hxx"
+
+#include <stddef.h>
+
+enum class TranslationCommandClass : uint8_t {
+    /**
+     * Not a known command (never assigned, or obsolete).
+     */
+    UNKNOWN,
+
+    /**
+     * This command may only appear in a request.
+     */
+    REQUEST,
+
+    /**
+     * This command may appear in a response.
+     */
+    RESPONSE,
+};
+
+class TranslationCommandTable {
+    /**
+     * One more than the highest known command.
+     */
+    static constexpr size_t SIZE = size_t(TranslationCommand::CHILD_TAG) + 1;
+
+    TranslationCommandClass classes[SIZE]{};
+
+public:
+    constexpr TranslationCommandTable() {
+        for (size_t i = 1; i < SIZE; ++i)
+            classes[i] = TranslationCommandClass::RESPONSE;
+
+        /* this value was never assigned */
+        classes[25] = TranslationCommandClass::UNKNOWN;
+
+        constexpr TranslationCommand request_only[] = {
+            TranslationCommand::PARAM,
+            TranslationCommand::REMOTE_HOST,
+            TranslationCommand::WIDGET_TYPE,
+            TranslationCommand::USER_AGENT,
+            TranslationCommand::ARGS,
+            TranslationCommand::QUERY_STRING,
+            TranslationCommand::LOCAL_ADDRESS,
+            TranslationCommand::LOCAL_ADDRESS_STRING,
+            TranslationCommand::AUTHORIZATION,
+            TranslationCommand::UA_CLASS,
+            TranslationCommand::SUFFIX,
+            TranslationCommand::LISTENER_TAG,
+            TranslationCommand::LOGIN,
+            TranslationCommand::CRON,
+            TranslationCommand::PASSWORD,
+            TranslationCommand::SERVICE,
+        };
+
+        for (auto i : request_only)
+            classes[size_t(i)] = TranslationCommandClass::REQUEST;
+    }
+
+    constexpr TranslationCommandClass
+    operator[](TranslationCommand command) const {
+        return size_t(command) < SIZE
+            ? classes[size_t(command)]
+            : TranslationCommandClass::UNKNOWN;
+    }
+};
+
+static constexpr TranslationCommandTable translation_command_table;
+
+constexpr TranslationCommandClass
+GetTranslationCommandClass(TranslationCommand command)
+{
+    return translation_command_table[command];
+}
+
+static_assert(GetTranslationCommandClass(TranslationCommand::BEGIN) == TranslationCommandClass::RESPONSE, "");
+static_assert(GetTranslationCommandClass(TranslationCommand::PARAM) == TranslationCommandClass::REQUEST, "");
+static_assert(GetTranslationCommandClass(TranslationCommand(0)) == TranslationCommandClass::UNKNOWN, "");
+static_assert(GetTranslationCommandClass(TranslationCommand(25)) == TranslationCommandClass::UNKNOWN, "");
+static_assert(GetTranslationCommandClass(TranslationCommand::CHILD_TAG) == TranslationCommandClass::RESPONSE, "");
+static_assert(GetTranslationCommandClass(TranslationCommand(0xffff)) == TranslationCommandClass::UNKNOWN, "");
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The translation feature set of this build (see
+ * translation/Features.hxx) as a constexpr traits type, for code
+ * which wants to check features in ordinary C++ expressions
+ * (static_assert, template arguments, dead-code-eliminated "if"
+ * branches) instead of preprocessor conditionals.
+ */
+
+#ifndef BENG_PROXY_TRANSLATION_FEATURE_SET_HXX
+#define BENG_PROXY_TRANSLATION_FEATURE_SET_HXX
+
+#include "translation/Features.hxx"
+
+#include <stdint.h>
+
+enum class TranslationFeature : uint16_t {
+    CACHE = 0x1,
+    WANT = 0x2,
+    EXPAND = 0x4,
+    SESSION = 0x8,
+    HTTP = 0x10,
+    WIDGET = 0x20,
+    RADDRESS = 0x40,
+    TRANSFORMATION = 0x80,
+    EXECUTE = 0x100,
+    JAILCGI = 0x200,
+};
+
+/**
+ * A set of #TranslationFeature values.
+ */
+class TranslationFeatureSet {
+    uint16_t mask;
+
+public:
+    constexpr TranslationFeatureSet(uint16_t _mask=0)
+        :mask(_mask) {}
+
+    constexpr TranslationFeatureSet(TranslationFeature f)
+        :mask(uint16_t(f)) {}
+
+    constexpr uint16_t GetMask() const {
+        return mask;
+    }
+
+    constexpr bool Contains(TranslationFeature f) const {
+        return (mask & uint16_t(f)) != 0;
+    }
+
+    /**
+     * Does this set contain all features of the other set?
+     */
+    constexpr bool Contains(TranslationFeatureSet other) const {
+        return (mask & other.mask) == other.mask;
+    }
+
+    constexpr TranslationFeatureSet operator|(TranslationFeatureSet other) const {
+        return mask | other.mask;
+    }
+};
+
+constexpr TranslationFeatureSet
+operator|(TranslationFeature a, TranslationFeature b)
+{
+    return TranslationFeatureSet(a) | b;
+}
+
+/**
+ * The features enabled in this build.
+ */
+static constexpr TranslationFeatureSet translation_features =
+    (TRANSLATION_ENABLE_CACHE ? uint16_t(TranslationFeature::CACHE) : 0) |
+    (TRANSLATION_ENABLE_WANT ? uint16_t(TranslationFeature::WANT) : 0) |
+    (TRANSLATION_ENABLE_EXPAND ? uint16_t(TranslationFeature::EXPAND) : 0) |
+    (TRANSLATION_ENABLE_SESSION ? uint16_t(TranslationFeature::SESSION) : 0) |
+    (TRANSLATION_ENABLE_HTTP ? uint16_t(TranslationFeature::HTTP) : 0) |
+    (TRANSLATION_ENABLE_WIDGET ? uint16_t(TranslationFeature::WIDGET) : 0) |
+    (TRANSLATION_ENABLE_RADDRESS ? uint16_t(TranslationFeature::RADDRESS) : 0) |
+    (TRANSLATION_ENABLE_TRANSFORMATION ? uint16_t(TranslationFeature::TRANSFORMATION) : 0) |
+    (TRANSLATION_ENABLE_EXECUTE ? uint16_t(TranslationFeature::EXECUTE) : 0) |
+    (TRANSLATION_ENABLE_JAILCGI ? uint16_t(TranslationFeature::JAILCGI) : 0);
+
+/**
+ * Is the given feature enabled in this build?
+ */
+constexpr bool
+IsTranslationFeatureEnabled(TranslationFeature f)
+{
+    return translation_features.Contains(f);
+}
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Image.hxx"
+#include "AllocatorPtr.hxx"
+
+#include <stdexcept>
+
+#include <assert.h>
+#include <string.h>
+
+static constexpr size_t IMAGE_HEADER_SIZE = TRANSLATION_IMAGE_ALIGN;
+
+static_assert(sizeof(TranslationHeader) <= IMAGE_HEADER_SIZE, "Wrong size");
+
+static constexpr size_t
+ImagePadding(size_t size)
+{
+    return (size + TRANSLATION_IMAGE_ALIGN - 1) & ~(TRANSLATION_IMAGE_ALIGN - 1);
+}
+
+void
+TranslationImageBuilder::Add(TranslationCommand command,
+                             ConstBuffer<void> payload)
+{
+    assert(payload.size <= 0xffff);
+
+    const size_t position = buffer.size();
+    buffer.resize(position + IMAGE_HEADER_SIZE +
+                  ImagePadding(payload.size + 1));
+
+    uint8_t *p = &buffer[position];
+
+    TranslationHeader header;
+    header.length = uint16_t(payload.size);
+    header.command = command;
+    memcpy(p, &header, sizeof(header));
+    p += IMAGE_HEADER_SIZE;
+
+    if (payload.size > 0)
+        memcpy(p, payload.data, payload.size);
+
+    /* the null terminator and the padding have already been
+       zero-initialised by resize() */
+}
+
+ConstBuffer<void>
+TranslationImageBuilder::Dup(AllocatorPtr alloc) const
+{
+    if (buffer.empty())
+        return nullptr;
+
+    return alloc.Dup(GetImage());
+}
+
+bool
+TranslationImageReader::Next(TranslationCommand &command_r,
+                             ConstBuffer<void> &payload_r)
+{
+    if (p == end)
+        return false;
+
+    if (size_t(end - p) < IMAGE_HEADER_SIZE)
+        throw std::runtime_error("Truncated translation image");
+
+    TranslationHeader header;
+    memcpy(&header, p, sizeof(header));
+    p += IMAGE_HEADER_SIZE;
+
+    const size_t padded = ImagePadding(header.length + 1);
+    if (size_t(end - p) < padded || p[header.length] != 0)
+        throw std::runtime_error("Malformed translation image");
+
+    command_r = header.command;
+    payload_r = {p, header.length};
+    p += padded;
+    return true;
+}
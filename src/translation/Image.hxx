@@ -0,0 +1,117 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BENG_PROXY_TRANSLATE_IMAGE_HXX
+#define BENG_PROXY_TRANSLATE_IMAGE_HXX
+
+#include "Protocol.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+class AllocatorPtr;
+
+/**
+ * A contiguous, position-independent copy of the packets which make
+ * up one translation response.  It contains no pointers, only
+ * lengths, so it can be copied with memcpy() and placed in shared
+ * memory.  TranslateParser::ProcessImage() rebuilds a
+ * #TranslateResponse from it without copying any payload.
+ *
+ * Each packet is stored as a #TranslationHeader, followed by 4 bytes
+ * of padding, the payload, a null byte and more padding up to the
+ * next multiple of #TRANSLATION_IMAGE_ALIGN.  This keeps all payloads
+ * aligned (as long as the image itself is) and null-terminated, just
+ * like the copies made by #TranslatePacketReader.
+ */
+static constexpr size_t TRANSLATION_IMAGE_ALIGN = 8;
+
+/**
+ * Collects packets into a #TranslationImage buffer.
+ */
+class TranslationImageBuilder {
+    std::vector<uint8_t> buffer;
+
+public:
+    bool empty() const {
+        return buffer.empty();
+    }
+
+    size_t size() const {
+        return buffer.size();
+    }
+
+    void Clear() {
+        buffer.clear();
+    }
+
+    void Add(TranslationCommand command, ConstBuffer<void> payload);
+
+    /**
+     * Returns the image in the builder's own buffer.  It remains
+     * valid until the builder is modified or destroyed.
+     */
+    ConstBuffer<void> GetImage() const {
+        return {buffer.data(), buffer.size()};
+    }
+
+    /**
+     * Copy the image into one allocation.
+     */
+    ConstBuffer<void> Dup(AllocatorPtr alloc) const;
+};
+
+/**
+ * Iterate over the packets of an image created by
+ * #TranslationImageBuilder.  Payloads point into the image.
+ */
+class TranslationImageReader {
+    const uint8_t *p, *const end;
+
+public:
+    explicit TranslationImageReader(ConstBuffer<void> image)
+        :p((const uint8_t *)image.data), end(p + image.size) {}
+
+    /**
+     * Obtain the next packet.
+     *
+     * Throws std::runtime_error if the image is malformed.
+     *
+     * @return false if the end of the image has been reached
+     */
+    bool Next(TranslationCommand &command_r, ConstBuffer<void> &payload_r);
+};
+
+#endif
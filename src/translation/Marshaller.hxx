@@ -0,0 +1,335 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Serialize translation request packets.
+ */
+
+#ifndef BENG_PROXY_TRANSLATION_MARSHALLER_HXX
+#define BENG_PROXY_TRANSLATION_MARSHALLER_HXX
+
+#include "Protocol.hxx"
+#include "net/SocketAddress.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/StringView.hxx"
+#include "util/DynamicFifoBuffer.hxx"
+#include "util/StaticArray.hxx"
+#include "util/Compiler.h"
+
+#include <stdexcept>
+#include <type_traits>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/uio.h>
+
+/**
+ * The payload type of each command a client may send.  There is no
+ * definition for other commands, so sending them with
+ * TranslationMarshallerBase::Write() fails to compile.  "void" means
+ * the packet has no payload.
+ */
+template<TranslationCommand command>
+struct TranslationRequestPayload;
+
+#define TRANSLATION_REQUEST_PAYLOAD(command, T) \
+    template<> \
+    struct TranslationRequestPayload<TranslationCommand::command> { \
+        typedef T type; \
+    }
+
+TRANSLATION_REQUEST_PAYLOAD(BEGIN, uint8_t);
+TRANSLATION_REQUEST_PAYLOAD(END, void);
+TRANSLATION_REQUEST_PAYLOAD(LOGIN, void);
+
+TRANSLATION_REQUEST_PAYLOAD(HOST, StringView);
+TRANSLATION_REQUEST_PAYLOAD(URI, StringView);
+TRANSLATION_REQUEST_PAYLOAD(PARAM, StringView);
+TRANSLATION_REQUEST_PAYLOAD(USER, StringView);
+TRANSLATION_REQUEST_PAYLOAD(LANGUAGE, StringView);
+TRANSLATION_REQUEST_PAYLOAD(REMOTE_HOST, StringView);
+TRANSLATION_REQUEST_PAYLOAD(WIDGET_TYPE, StringView);
+TRANSLATION_REQUEST_PAYLOAD(USER_AGENT, StringView);
+TRANSLATION_REQUEST_PAYLOAD(QUERY_STRING, StringView);
+TRANSLATION_REQUEST_PAYLOAD(LOCAL_ADDRESS_STRING, StringView);
+TRANSLATION_REQUEST_PAYLOAD(ARGS, StringView);
+TRANSLATION_REQUEST_PAYLOAD(AUTHORIZATION, StringView);
+TRANSLATION_REQUEST_PAYLOAD(UA_CLASS, StringView);
+TRANSLATION_REQUEST_PAYLOAD(SUFFIX, StringView);
+TRANSLATION_REQUEST_PAYLOAD(PROBE_SUFFIX, StringView);
+TRANSLATION_REQUEST_PAYLOAD(LISTENER_TAG, StringView);
+TRANSLATION_REQUEST_PAYLOAD(PASSWORD, StringView);
+TRANSLATION_REQUEST_PAYLOAD(SERVICE, StringView);
+TRANSLATION_REQUEST_PAYLOAD(CRON, StringView);
+
+TRANSLATION_REQUEST_PAYLOAD(SESSION, ConstBuffer<void>);
+TRANSLATION_REQUEST_PAYLOAD(CHECK, ConstBuffer<void>);
+TRANSLATION_REQUEST_PAYLOAD(AUTH, ConstBuffer<void>);
+TRANSLATION_REQUEST_PAYLOAD(WANT_FULL_URI, ConstBuffer<void>);
+TRANSLATION_REQUEST_PAYLOAD(INTERNAL_REDIRECT, ConstBuffer<void>);
+TRANSLATION_REQUEST_PAYLOAD(ERROR_DOCUMENT, ConstBuffer<void>);
+TRANSLATION_REQUEST_PAYLOAD(FILE_NOT_FOUND, ConstBuffer<void>);
+TRANSLATION_REQUEST_PAYLOAD(CONTENT_TYPE_LOOKUP, ConstBuffer<void>);
+TRANSLATION_REQUEST_PAYLOAD(DIRECTORY_INDEX, ConstBuffer<void>);
+TRANSLATION_REQUEST_PAYLOAD(ENOTDIR_, ConstBuffer<void>);
+TRANSLATION_REQUEST_PAYLOAD(PROBE_PATH_SUFFIXES, ConstBuffer<void>);
+TRANSLATION_REQUEST_PAYLOAD(READ_FILE, ConstBuffer<void>);
+
+TRANSLATION_REQUEST_PAYLOAD(LOCAL_ADDRESS, SocketAddress);
+TRANSLATION_REQUEST_PAYLOAD(STATUS, uint16_t);
+TRANSLATION_REQUEST_PAYLOAD(WANT, ConstBuffer<TranslationCommand>);
+
+#undef TRANSLATION_REQUEST_PAYLOAD
+
+/**
+ * The typed front end shared by all marshallers.  The derived class
+ * implements WriteReference() (the payload remains valid until the
+ * request has been sent) and WriteCopy() (the payload is a
+ * temporary and must be copied).
+ */
+template<typename Derived>
+class TranslationMarshallerBase {
+public:
+    template<TranslationCommand command>
+    void Write() {
+        static_assert(std::is_void<typename TranslationRequestPayload<command>::type>::value,
+                      "This command requires a payload");
+
+        GetDerived().WriteCopy(command, nullptr);
+    }
+
+    template<TranslationCommand command>
+    void Write(typename TranslationRequestPayload<command>::type value) {
+        WritePayload(command, value);
+    }
+
+    /**
+     * Write the packet only if the value is not nullptr.
+     */
+    template<TranslationCommand command, typename T>
+    void WriteOptional(T value) {
+        if (!IsNullPayload(value))
+            Write<command>(value);
+    }
+
+    /**
+     * Write a packet without type checking, e.g. for commands this
+     * library does not know.
+     */
+    void WriteRaw(TranslationCommand command, ConstBuffer<void> payload) {
+        GetDerived().WriteReference(command, payload);
+    }
+
+private:
+    Derived &GetDerived() {
+        return *static_cast<Derived *>(this);
+    }
+
+    static constexpr bool IsNullPayload(const char *value) {
+        return value == nullptr;
+    }
+
+    template<typename T>
+    static constexpr bool IsNullPayload(ConstBuffer<T> value) {
+        return value.IsNull();
+    }
+
+    static bool IsNullPayload(SocketAddress value) {
+        return value.IsNull();
+    }
+
+    void WritePayload(TranslationCommand command, StringView value) {
+        GetDerived().WriteReference(command, value.ToVoid());
+    }
+
+    void WritePayload(TranslationCommand command, ConstBuffer<void> value) {
+        GetDerived().WriteReference(command, value);
+    }
+
+    void WritePayload(TranslationCommand command,
+                      ConstBuffer<TranslationCommand> value) {
+        GetDerived().WriteReference(command, value.ToVoid());
+    }
+
+    void WritePayload(TranslationCommand command, SocketAddress value) {
+        GetDerived().WriteReference(command,
+                                    {value.GetAddress(), value.GetSize()});
+    }
+
+    void WritePayload(TranslationCommand command, uint8_t value) {
+        GetDerived().WriteCopy(command, {&value, sizeof(value)});
+    }
+
+    void WritePayload(TranslationCommand command, uint16_t value) {
+        GetDerived().WriteCopy(command, {&value, sizeof(value)});
+    }
+
+protected:
+    static TranslationHeader MakeHeader(TranslationCommand command,
+                                        size_t length) {
+        if (length > 0xffff)
+            throw std::runtime_error("Translation payload too large");
+
+        TranslationHeader header;
+        header.length = uint16_t(length);
+        header.command = command;
+        return header;
+    }
+};
+
+/**
+ * Serialize request packets into a #DynamicFifoBuffer, growing it
+ * only when it is too small.  The result is one contiguous buffer,
+ * ready to be passed to TranslationClient::SendRequest().
+ */
+class TranslationMarshaller final
+    : public TranslationMarshallerBase<TranslationMarshaller> {
+
+    friend class TranslationMarshallerBase<TranslationMarshaller>;
+
+    DynamicFifoBuffer<uint8_t> &buffer;
+
+public:
+    explicit TranslationMarshaller(DynamicFifoBuffer<uint8_t> &_buffer)
+        :buffer(_buffer) {}
+
+    ConstBuffer<void> GetData() const {
+        const auto r = buffer.Read();
+        return {r.data, r.size};
+    }
+
+private:
+    void WriteCopy(TranslationCommand command, ConstBuffer<void> payload) {
+        const auto header = MakeHeader(command, payload.size);
+
+        uint8_t *p = buffer.Write(sizeof(header) + payload.size);
+        memcpy(p, &header, sizeof(header));
+        if (payload.size > 0)
+            memcpy(p + sizeof(header), payload.data, payload.size);
+        buffer.Append(sizeof(header) + payload.size);
+    }
+
+    void WriteReference(TranslationCommand command,
+                        ConstBuffer<void> payload) {
+        WriteCopy(command, payload);
+    }
+};
+
+/**
+ * Serialize request packets into an iovec list without copying
+ * strings and buffers: only the headers (and small scalar payloads)
+ * are stored in this object, everything else is referenced.  The
+ * referenced memory must remain valid until the request has been
+ * sent.
+ *
+ * @param max_packets the maximum number of packets
+ */
+template<size_t max_packets>
+class TranslationIovecMarshaller final
+    : public TranslationMarshallerBase<TranslationIovecMarshaller<max_packets>> {
+
+    friend class TranslationMarshallerBase<TranslationIovecMarshaller<max_packets>>;
+
+    /**
+     * A packet header followed by room for a scalar payload, so both
+     * fit in one iovec.
+     */
+    struct Slot {
+        TranslationHeader header;
+        uint8_t payload[4];
+    };
+
+    static_assert(offsetof(Slot, payload) == sizeof(TranslationHeader),
+                  "Unexpected padding");
+
+    StaticArray<Slot, max_packets> slots;
+    StaticArray<struct iovec, max_packets * 2> vec;
+
+public:
+    TranslationIovecMarshaller() = default;
+
+    TranslationIovecMarshaller(const TranslationIovecMarshaller &) = delete;
+    TranslationIovecMarshaller &operator=(const TranslationIovecMarshaller &) = delete;
+
+    ConstBuffer<struct iovec> GetVector() const {
+        return {vec.begin(), vec.size()};
+    }
+
+    /**
+     * The total number of bytes in all vectors.
+     */
+    gcc_pure
+    size_t GetSize() const {
+        size_t size = 0;
+        for (const auto &i : vec)
+            size += i.iov_len;
+        return size;
+    }
+
+private:
+    Slot &AddSlot(TranslationCommand command, size_t length) {
+        if (slots.full())
+            throw std::runtime_error("Too many translation packets");
+
+        slots.append(Slot());
+        Slot &slot = slots.back();
+        slot.header = TranslationIovecMarshaller::MakeHeader(command, length);
+        return slot;
+    }
+
+    void Append(const void *data, size_t size) {
+        vec.append({const_cast<void *>(data), size});
+    }
+
+    void WriteCopy(TranslationCommand command, ConstBuffer<void> payload) {
+        assert(payload.size <= sizeof(Slot::payload));
+
+        Slot &slot = AddSlot(command, payload.size);
+        if (payload.size > 0)
+            memcpy(slot.payload, payload.data, payload.size);
+
+        Append(&slot, sizeof(slot.header) + payload.size);
+    }
+
+    void WriteReference(TranslationCommand command,
+                        ConstBuffer<void> payload) {
+        Slot &slot = AddSlot(command, payload.size);
+        Append(&slot.header, sizeof(slot.header));
+
+        if (payload.size > 0)
+            Append(payload.data, payload.size);
+    }
+};
+
+#endif
@@ -57,6 +57,8 @@ TranslatePacketReader::Feed(AllocatorPtr alloc,
 
         memcpy(&header, data, sizeof(header));
 
+        borrowed = false;
+
         if (header.length == 0) {
             payload = nullptr;
             state = State::COMPLETE;
@@ -67,11 +69,19 @@ TranslatePacketReader::Feed(AllocatorPtr alloc,
         data += sizeof(header);
         length -= sizeof(header);
 
+        if (zero_copy && length >= header.length) {
+            /* the whole packet is in the caller's buffer */
+            payload = (const char *)data;
+            borrowed = true;
+            state = State::COMPLETE;
+            return consumed + header.length;
+        }
+
         state = State::PAYLOAD;
 
         payload_position = 0;
-        payload = alloc.NewArray<char>(header.length + 1);
-        payload[header.length] = 0;
+        payload = copy = alloc.NewArray<char>(header.length + 1);
+        copy[header.length] = 0;
 
         if (length == 0)
             return consumed;
@@ -85,7 +95,7 @@ TranslatePacketReader::Feed(AllocatorPtr alloc,
     if (nbytes > length)
         nbytes = length;
 
-    memcpy(payload + payload_position, data, nbytes);
+    memcpy(copy + payload_position, data, nbytes);
     payload_position += nbytes;
     if (payload_position == header.length)
         state = State::COMPLETE;
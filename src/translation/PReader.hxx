@@ -34,6 +34,8 @@
 #define BENG_PROXY_TRANSLATE_READER_HXX
 
 #include "Protocol.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/StringView.hxx"
 
 #include <assert.h>
 #include <stddef.h>
@@ -43,6 +45,14 @@ class AllocatorPtr;
 
 /**
  * Parse translation response packets.
+ *
+ * By default, each payload is copied to a null-terminated array
+ * allocated from the given pool, and remains valid as long as the
+ * pool.  In zero-copy mode (see constructor), a packet which is
+ * complete in the buffer passed to Feed() is not copied; its
+ * payload points into that buffer and is only valid until the
+ * caller modifies or frees it.  Only packets which span several
+ * Feed() calls are copied in zero-copy mode.
  */
 class TranslatePacketReader {
     enum class State {
@@ -53,12 +63,33 @@ class TranslatePacketReader {
 
     State state = State::HEADER;
 
+    const bool zero_copy;
+
+    /**
+     * Does #payload point into the caller's buffer?  In that
+     * case, it is not null-terminated.
+     */
+    bool borrowed;
+
     TranslationHeader header;
 
-    char *payload;
+    const char *payload;
+
+    /**
+     * The pool-allocated copy being filled in #State::PAYLOAD.
+     */
+    char *copy;
     size_t payload_position;
 
 public:
+    /**
+     * @param _zero_copy enable zero-copy mode (see class
+     * documentation); the caller must make sure that payloads are
+     * not used after the input buffer has been consumed
+     */
+    explicit TranslatePacketReader(bool _zero_copy=false)
+        :zero_copy(_zero_copy) {}
+
     /**
      * Read a packet from the socket.
      *
@@ -76,6 +107,10 @@ public:
         return header.command;
     }
 
+    /**
+     * Returns the payload.  Unless IsPayloadBorrowed() returns
+     * true, it is null-terminated.
+     */
     const void *GetPayload() const {
         assert(IsComplete());
 
@@ -84,6 +119,28 @@ public:
             : "";
     }
 
+    /**
+     * Does the payload point into the buffer passed to Feed()
+     * (zero-copy mode only)?
+     */
+    bool IsPayloadBorrowed() const {
+        assert(IsComplete());
+
+        return borrowed;
+    }
+
+    ConstBuffer<void> GetPayloadBuffer() const {
+        assert(IsComplete());
+
+        return {GetPayload(), header.length};
+    }
+
+    StringView GetPayloadString() const {
+        assert(IsComplete());
+
+        return {(const char *)GetPayload(), header.length};
+    }
+
     size_t GetLength() const {
         assert(IsComplete());
 
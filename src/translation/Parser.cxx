@@ -31,6 +31,7 @@
  */
 
 #include "Parser.hxx"
+#include "CommandTable.hxx"
 #if TRANSLATION_ENABLE_TRANSFORMATION
 #include "translation/Transformation.hxx"
 #include "processor.hxx"
@@ -60,6 +61,7 @@
 #endif
 #include "util/CharUtil.hxx"
 #include "util/RuntimeError.hxx"
+#include "util/Trace.h"
 
 #if TRANSLATION_ENABLE_HTTP
 #include "http/HeaderName.hxx"
@@ -71,6 +73,8 @@
 void
 TranslateParser::SetChildOptions(ChildOptions &_child_options)
 {
+    FlushDeferredChildOptions();
+
     child_options = &_child_options;
     ns_options = &child_options->ns;
     mount_list = &ns_options->mounts;
@@ -253,6 +257,7 @@ TranslateParser::AddView(const char *name)
     *widget_view_tail = new_view;
     widget_view_tail = &new_view->next;
     resource_address = &new_view->address;
+    FlushDeferredChildOptions();
     jail = nullptr;
     child_options = nullptr;
     ns_options = nullptr;
@@ -1023,6 +1028,7 @@ TranslateParser::HandleRegularPacket(TranslationCommand command,
 
     case TranslationCommand::BEGIN:
     case TranslationCommand::END:
+        /* handled by HandlePacket() */
         gcc_unreachable();
 
     case TranslationCommand::PARAM:
@@ -1041,7 +1047,9 @@ TranslateParser::HandleRegularPacket(TranslationCommand command,
     case TranslationCommand::CRON:
     case TranslationCommand::PASSWORD:
     case TranslationCommand::SERVICE:
-        throw std::runtime_error("misplaced translate request packet");
+        /* rejected by HandlePacket() with
+           GetTranslationCommandClass() */
+        gcc_unreachable();
 
     case TranslationCommand::UID_GID:
         HandleUidGid({_payload, payload_length});
@@ -1301,6 +1309,7 @@ TranslateParser::HandleRegularPacket(TranslationCommand command,
     case TranslationCommand::FILTER:
 #if TRANSLATION_ENABLE_TRANSFORMATION
         resource_address = AddFilter();
+        FlushDeferredChildOptions();
         jail = nullptr;
         child_options = nullptr;
         ns_options = nullptr;
@@ -3344,7 +3353,103 @@ TranslateParser::HandleRegularPacket(TranslationCommand command,
     throw FormatRuntimeError("unknown translation packet: %u", command);
 }
 
-inline TranslateParser::Result
+inline /**
+ * May this packet be recorded in ChildOptions::deferred instead of
+ * being parsed right away?  These commands modify only the current
+ * #ChildOptions (and its #NamespaceOptions and mount list), and
+ * their order relative to all other commands does not matter.
+ */
+static constexpr bool
+IsDeferrableChildOptionsCommand(TranslationCommand command)
+{
+    switch (command) {
+    case TranslationCommand::UID_GID:
+    case TranslationCommand::UMASK:
+    case TranslationCommand::USER_NAMESPACE:
+    case TranslationCommand::PID_NAMESPACE:
+    case TranslationCommand::NETWORK_NAMESPACE:
+    case TranslationCommand::NETWORK_NAMESPACE_NAME:
+    case TranslationCommand::IPC_NAMESPACE:
+    case TranslationCommand::UTS_NAMESPACE:
+    case TranslationCommand::CGROUP_NAMESPACE:
+    case TranslationCommand::PIVOT_ROOT:
+    case TranslationCommand::MOUNT_PROC:
+    case TranslationCommand::MOUNT_HOME:
+    case TranslationCommand::MOUNT_TMP_TMPFS:
+    case TranslationCommand::MOUNT_TMPFS:
+    case TranslationCommand::MOUNT_ROOT_TMPFS:
+    case TranslationCommand::BIND_MOUNT:
+    case TranslationCommand::BIND_MOUNT_RW:
+    case TranslationCommand::BIND_MOUNT_EXEC:
+    case TranslationCommand::EXPAND_BIND_MOUNT:
+    case TranslationCommand::EXPAND_BIND_MOUNT_RW:
+    case TranslationCommand::EXPAND_BIND_MOUNT_EXEC:
+    case TranslationCommand::RLIMITS:
+    case TranslationCommand::REFENCE:
+    case TranslationCommand::CGROUP:
+    case TranslationCommand::CGROUP_SET:
+    case TranslationCommand::FORBID_USER_NS:
+    case TranslationCommand::FORBID_MULTICAST:
+    case TranslationCommand::FORBID_BIND:
+    case TranslationCommand::NO_NEW_PRIVS:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+static constexpr bool
+IsExpandChildOptionsCommand(TranslationCommand command)
+{
+    return command == TranslationCommand::EXPAND_BIND_MOUNT ||
+        command == TranslationCommand::EXPAND_BIND_MOUNT_RW ||
+        command == TranslationCommand::EXPAND_BIND_MOUNT_EXEC;
+}
+
+void
+TranslateParser::FlushDeferredChildOptions()
+{
+    if (deferred_builder.empty())
+        return;
+
+    assert(child_options != nullptr);
+    assert(child_options->deferred.IsNull());
+
+    child_options->deferred = deferred_builder.Dup(alloc);
+    deferred_builder.Clear();
+}
+
+TranslateParser::TranslateParser(AllocatorPtr _alloc,
+                                 ChildOptions &options)
+    :alloc(_alloc), begun(true)
+{
+    SetChildOptions(options);
+#if TRANSLATION_ENABLE_JAILCGI
+    jail = options.jail;
+#endif
+}
+
+void
+TranslateParser::MaterializeChildOptions(AllocatorPtr alloc,
+                                         ChildOptions &options)
+{
+    if (!options.IsDeferred())
+        return;
+
+    const auto image = std::exchange(options.deferred, nullptr);
+    options.deferred_expandable = false;
+
+    TranslateParser parser(alloc, options);
+
+    TranslationImageReader r(image);
+    TranslationCommand command;
+    ConstBuffer<void> payload;
+    while (r.Next(command, payload))
+        parser.HandleRegularPacket(command, payload.data, payload.size);
+}
+
+TranslateParser::Result
 TranslateParser::HandlePacket(TranslationCommand command,
                               const void *const payload, size_t payload_length)
 {
@@ -3358,16 +3463,34 @@ TranslateParser::HandlePacket(TranslationCommand command,
             throw std::runtime_error("no BEGIN from translation server");
     }
 
+    /* one table lookup rejects all commands which must not appear
+       in a response, so HandleRegularPacket() does not need to
+       deal with them */
+    switch (GetTranslationCommandClass(command)) {
+    case TranslationCommandClass::UNKNOWN:
+        throw FormatRuntimeError("unknown translation packet: %u", command);
+
+    case TranslationCommandClass::REQUEST:
+        throw std::runtime_error("misplaced translate request packet");
+
+    case TranslationCommandClass::RESPONSE:
+        break;
+    }
+
     switch (command) {
     case TranslationCommand::END:
+        FlushDeferredChildOptions();
         translate_response_finish(&response);
 
 #if TRANSLATION_ENABLE_WIDGET
         FinishView();
+        response.IndexViews(alloc);
 #endif
+        TRACE_POINT(translation_parse_end, this);
         return Result::DONE;
 
     case TranslationCommand::BEGIN:
+        TRACE_POINT(translation_parse_begin, this);
         begun = true;
         response.Clear();
         previous_command = command;
@@ -3411,6 +3534,14 @@ TranslateParser::HandlePacket(TranslationCommand command,
         return Result::MORE;
 
     default:
+        if (defer_child_options && child_options != nullptr &&
+            IsDeferrableChildOptionsCommand(command)) {
+            deferred_builder.Add(command, {payload, payload_length});
+            if (IsExpandChildOptionsCommand(command))
+                child_options->deferred_expandable = true;
+            return Result::MORE;
+        }
+
         HandleRegularPacket(command, payload, payload_length);
         return Result::MORE;
     }
@@ -3423,6 +3554,23 @@ TranslateParser::Process()
         /* need more data */
         return Result::MORE;
 
+    if (image_builder != nullptr)
+        image_builder->Add(reader.GetCommand(), reader.GetPayloadBuffer());
+
     return HandlePacket(reader.GetCommand(),
                         reader.GetPayload(), reader.GetLength());
 }
+
+TranslateParser::Result
+TranslateParser::ProcessImage(ConstBuffer<void> image)
+{
+    TranslationImageReader r(image);
+    TranslationCommand command;
+    ConstBuffer<void> payload;
+
+    while (r.Next(command, payload))
+        if (HandlePacket(command, payload.data, payload.size) == Result::DONE)
+            return Result::DONE;
+
+    return Result::MORE;
+}
@@ -34,7 +34,9 @@
 #define BENG_PROXY_TRANSLATE_PARSER_HXX
 
 #include "PReader.hxx"
+#include "Image.hxx"
 #include "Response.hxx"
+#include "FeatureSet.hxx"
 #include "adata/ExpandableStringList.hxx"
 #include "AllocatorPtr.hxx"
 
@@ -64,19 +66,21 @@ class TranslateParser {
 #if TRANSLATION_ENABLE_RADDRESS || TRANSLATION_ENABLE_HTTP || TRANSLATION_ENABLE_WANT || TRANSLATION_ENABLE_RADDRESS
     struct FromRequest {
 #if TRANSLATION_ENABLE_RADDRESS
-        const char *uri;
+        const char *uri = nullptr;
 #endif
 
 #if TRANSLATION_ENABLE_HTTP
-        bool want_full_uri;
+        bool want_full_uri = false;
 #endif
 
-        bool want;
+        bool want = false;
 
 #if TRANSLATION_ENABLE_RADDRESS
-        bool content_type_lookup;
+        bool content_type_lookup = false;
 #endif
 
+        FromRequest() = default;
+
         explicit FromRequest(const TranslateRequest &r)
             :
 #if TRANSLATION_ENABLE_RADDRESS
@@ -98,7 +102,30 @@ class TranslateParser {
      */
     bool begun = false;
 
+    /**
+     * Not in zero-copy mode, because many payloads are stored in
+     * #response and must live as long as the pool.
+     */
     TranslatePacketReader reader;
+
+    /**
+     * If not nullptr, then each packet is added to this image (see
+     * SetImageBuilder()).
+     */
+    TranslationImageBuilder *image_builder = nullptr;
+
+    /**
+     * See SetDeferChildOptions().
+     */
+    bool defer_child_options = false;
+
+    /**
+     * Packets for #child_options which are deferred; they are moved
+     * to ChildOptions::deferred as soon as the parser leaves that
+     * #ChildOptions.
+     */
+    TranslationImageBuilder deferred_builder;
+
     TranslateResponse response;
 
     TranslationCommand previous_command;
@@ -180,6 +207,47 @@ public:
     {
     }
 
+    /**
+     * Record packets which only configure the child process
+     * (namespaces, mounts, resource limits, cgroups, ...) in
+     * ChildOptions::deferred instead of parsing them.  This saves
+     * work for responses whose child options are never used.  Before
+     * a #ChildOptions is used, MaterializeChildOptions() must be
+     * called; errors in deferred packets are only reported then.
+     */
+    void SetDeferChildOptions(bool enable) {
+        defer_child_options = enable;
+    }
+
+    /**
+     * Parse the packets deferred by SetDeferChildOptions() into the
+     * given #ChildOptions.  Does nothing if there are none.
+     *
+     * Throws std::runtime_error on error.
+     *
+     * @param alloc the allocator which was used for parsing the
+     * response (or for copying the #ChildOptions)
+     */
+    static void MaterializeChildOptions(AllocatorPtr alloc,
+                                        ChildOptions &options);
+
+    /**
+     * The translation features this parser was compiled with.
+     * Callers may use this in a static_assert to make sure they
+     * are linked with the expected feature set.
+     */
+    static constexpr TranslationFeatureSet GetFeatures() {
+        return translation_features;
+    }
+
+    /**
+     * Record all packets in the given image, e.g. to store a
+     * contiguous copy of the response in a cache.
+     */
+    void SetImageBuilder(TranslationImageBuilder &_builder) {
+        image_builder = &_builder;
+    }
+
     size_t Feed(const uint8_t *data, size_t length) {
         return reader.Feed(alloc, data, length);
     }
@@ -194,11 +262,28 @@ public:
      */
     Result Process();
 
+    /**
+     * Parse a response from an image built by
+     * #TranslationImageBuilder instead of calling Feed() and
+     * Process().  Payloads are not copied; the response points into
+     * the image, which must therefore outlive it.
+     *
+     * Throws std::runtime_error on error.
+     */
+    Result ProcessImage(ConstBuffer<void> image);
+
     TranslateResponse &GetResponse() {
         return response;
     }
 
 private:
+    /**
+     * Constructor for MaterializeChildOptions().
+     */
+    TranslateParser(AllocatorPtr _alloc, ChildOptions &options);
+
+    void FlushDeferredChildOptions();
+
     bool HasArgs() const {
 #if TRANSLATION_ENABLE_RADDRESS
         if (cgi_address != nullptr || lhttp_address != nullptr)
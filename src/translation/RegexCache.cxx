@@ -0,0 +1,100 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "RegexCache.hxx"
+
+#if TRANSLATION_ENABLE_EXPAND
+
+#include "regex.hxx"
+
+RegexCache::~RegexCache() noexcept = default;
+
+RegexCache &
+RegexCache::GetDefault() noexcept
+{
+    static RegexCache instance;
+    return instance;
+}
+
+std::shared_ptr<const UniqueRegex>
+RegexCache::Get(const char *pattern, bool anchored, bool capture)
+{
+    Key key(pattern, anchored, capture);
+
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+
+        auto i = map.find(key);
+        if (i != map.end()) {
+            ++hits;
+            return i->second;
+        }
+
+        ++misses;
+    }
+
+    /* compile without holding the lock; if another thread compiles
+       the same pattern concurrently, the first one to finish wins */
+    std::shared_ptr<const UniqueRegex> regex =
+        std::make_shared<UniqueRegex>(pattern, anchored, capture);
+
+    const std::lock_guard<std::mutex> lock(mutex);
+
+    if (map.size() >= max_size) {
+        Sweep();
+        if (map.size() >= max_size)
+            /* everything is in use: don't cache this one */
+            return regex;
+    }
+
+    return map.emplace(std::move(key), std::move(regex)).first->second;
+}
+
+void
+RegexCache::Clear() noexcept
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    map.clear();
+}
+
+void
+RegexCache::Sweep() noexcept
+{
+    for (auto i = map.begin(); i != map.end();) {
+        if (i->second.use_count() == 1)
+            i = map.erase(i);
+        else
+            ++i;
+    }
+}
+
+#endif
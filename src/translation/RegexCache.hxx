@@ -0,0 +1,129 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BENG_PROXY_TRANSLATE_REGEX_CACHE_HXX
+#define BENG_PROXY_TRANSLATE_REGEX_CACHE_HXX
+
+#include "translation/Features.hxx"
+
+#if TRANSLATION_ENABLE_EXPAND
+
+#include "util/Compiler.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+#include <stddef.h>
+
+class UniqueRegex;
+
+/**
+ * A thread-safe cache of compiled #UniqueRegex objects, keyed by
+ * the pattern and the compile flags.  Translation servers tend to
+ * send the same few patterns over and over, and compiling them
+ * (including the JIT pass done by #UniqueRegex) is much more
+ * expensive than a lookup.
+ *
+ * Compiled regexes are shared with std::shared_ptr, so a cached
+ * response may keep one as long as it likes.  If the cache is full,
+ * items which are not referenced elsewhere are evicted; if all are
+ * referenced, a new regex is compiled without being cached.
+ */
+class RegexCache {
+    typedef std::tuple<std::string, bool, bool> Key;
+
+    const size_t max_size;
+
+    std::mutex mutex;
+
+    std::map<Key, std::shared_ptr<const UniqueRegex>, std::less<>> map;
+
+    size_t hits = 0, misses = 0;
+
+public:
+    explicit RegexCache(size_t _max_size=1024) noexcept
+        :max_size(_max_size) {}
+
+    ~RegexCache() noexcept;
+
+    RegexCache(const RegexCache &) = delete;
+    RegexCache &operator=(const RegexCache &) = delete;
+
+    /**
+     * The process-wide instance.
+     */
+    gcc_const
+    static RegexCache &GetDefault() noexcept;
+
+    /**
+     * Obtain a compiled regex, compiling it if it is not in the
+     * cache yet.
+     *
+     * Throws std::runtime_error on error.
+     *
+     * @param anchored see #UniqueRegex
+     * @param capture see #UniqueRegex
+     */
+    std::shared_ptr<const UniqueRegex> Get(const char *pattern,
+                                           bool anchored, bool capture);
+
+    size_t GetSize() noexcept {
+        const std::lock_guard<std::mutex> lock(mutex);
+        return map.size();
+    }
+
+    size_t GetHits() noexcept {
+        const std::lock_guard<std::mutex> lock(mutex);
+        return hits;
+    }
+
+    size_t GetMisses() noexcept {
+        const std::lock_guard<std::mutex> lock(mutex);
+        return misses;
+    }
+
+    void Clear() noexcept;
+
+private:
+    /**
+     * Remove all items which are not referenced outside of the
+     * cache.  Caller must lock the mutex.
+     */
+    void Sweep() noexcept;
+};
+
+#endif
+
+#endif
@@ -43,6 +43,7 @@
 #include "AllocatorPtr.hxx"
 #if TRANSLATION_ENABLE_EXPAND
 #include "regex.hxx"
+#include "RegexCache.hxx"
 #include "pexpand.hxx"
 #endif
 #if TRANSLATION_ENABLE_SESSION
@@ -50,6 +51,12 @@
 #endif
 #include "util/StringView.hxx"
 
+#if TRANSLATION_ENABLE_WIDGET
+#include <algorithm>
+
+#include <string.h>
+#endif
+
 void
 TranslateResponse::Clear()
 {
@@ -222,6 +229,7 @@ TranslateResponse::Clear()
 
 #if TRANSLATION_ENABLE_WIDGET
     views = nullptr;
+    view_index = nullptr;
     widget_group = nullptr;
     container_groups.Init();
 #endif
@@ -424,6 +432,7 @@ TranslateResponse::CopyFrom(AllocatorPtr alloc, const TranslateResponse &src)
     views = src.views != nullptr
         ? src.views->CloneChain(alloc)
         : nullptr;
+    IndexViews(alloc);
 #endif
 
 #if TRANSLATION_ENABLE_CACHE
@@ -449,6 +458,59 @@ TranslateResponse::CopyFrom(AllocatorPtr alloc, const TranslateResponse &src)
     validate_mtime.path = alloc.CheckDup(src.validate_mtime.path);
 }
 
+#if TRANSLATION_ENABLE_WIDGET
+
+static bool
+CompareViewName(const WidgetView *a, const WidgetView *b) noexcept
+{
+    return strcmp(a->name, b->name) < 0;
+}
+
+void
+TranslateResponse::IndexViews(AllocatorPtr alloc)
+{
+    view_index = nullptr;
+
+    if (views == nullptr)
+        return;
+
+    /* the first view is the unnamed default view */
+    size_t n = 0;
+    for (const WidgetView *v = views->next; v != nullptr; v = v->next)
+        ++n;
+
+    if (n == 0)
+        return;
+
+    WidgetView **index = alloc.NewArray<WidgetView *>(n);
+    WidgetView **p = index;
+    for (WidgetView *v = views->next; v != nullptr; v = v->next)
+        *p++ = v;
+
+    /* stable, so lookups find the first of several views with the
+       same name, just like a linear search */
+    std::stable_sort(index, index + n, CompareViewName);
+
+    view_index = {index, n};
+}
+
+const WidgetView *
+TranslateResponse::FindView(const char *name) const noexcept
+{
+    if (name == nullptr)
+        return views;
+
+    auto i = std::lower_bound(view_index.begin(), view_index.end(), name,
+                              [](const WidgetView *v, const char *n){
+                                  return strcmp(v->name, n) < 0;
+                              });
+    return i != view_index.end() && strcmp((*i)->name, name) == 0
+        ? *i
+        : nullptr;
+}
+
+#endif
+
 #if TRANSLATION_ENABLE_CACHE
 
 bool
@@ -566,6 +628,22 @@ TranslateResponse::CompileInverseRegex() const
     return {inverse_regex, protocol_version >= 3, false};
 }
 
+std::shared_ptr<const UniqueRegex>
+TranslateResponse::CompileRegex(RegexCache &cache) const
+{
+    assert(regex != nullptr);
+
+    return cache.Get(regex, protocol_version >= 3, IsExpandable());
+}
+
+std::shared_ptr<const UniqueRegex>
+TranslateResponse::CompileInverseRegex(RegexCache &cache) const
+{
+    assert(inverse_regex != nullptr);
+
+    return cache.Get(inverse_regex, protocol_version >= 3, false);
+}
+
 bool
 TranslateResponse::IsExpandable() const
 {
@@ -57,6 +57,7 @@
 #endif
 
 #include <chrono>
+#include <memory>
 
 #include <assert.h>
 #include <stdint.h>
@@ -65,6 +66,7 @@ enum class TranslationCommand : uint16_t;
 struct WidgetView;
 class AllocatorPtr;
 class UniqueRegex;
+class RegexCache;
 class MatchInfo;
 
 struct TranslateResponse {
@@ -342,6 +344,12 @@ struct TranslateResponse {
 #if TRANSLATION_ENABLE_WIDGET
     WidgetView *views;
 
+    /**
+     * All named #views sorted by name, for FindView().  Built by
+     * IndexViews().
+     */
+    ConstBuffer<WidgetView *> view_index;
+
     /**
      * From #TranslationCommand::WIDGET_GROUP.
      */
@@ -430,6 +438,25 @@ struct TranslateResponse {
 
     void CopyFrom(AllocatorPtr alloc, const TranslateResponse &src);
 
+#if TRANSLATION_ENABLE_WIDGET
+    /**
+     * Build #view_index from #views.  This must be called again
+     * after #views has been replaced.
+     */
+    void IndexViews(AllocatorPtr alloc);
+
+    /**
+     * Look up a view by its name with a binary search in
+     * #view_index.  If there are several views with the same
+     * name, the first one is returned.
+     *
+     * @param name the view name; nullptr selects the default view
+     * @return the view or nullptr if no such view exists
+     */
+    gcc_pure
+    const WidgetView *FindView(const char *name) const noexcept;
+#endif
+
 #if TRANSLATION_ENABLE_CACHE
     /**
      * Copy data from #src for storing in the translation cache.
@@ -453,6 +480,15 @@ struct TranslateResponse {
     UniqueRegex CompileRegex() const;
     UniqueRegex CompileInverseRegex() const;
 
+    /**
+     * Like CompileRegex(), but obtain a shared instance from the
+     * given cache instead of compiling the pattern again.
+     *
+     * Throws std::runtime_error on error.
+     */
+    std::shared_ptr<const UniqueRegex> CompileRegex(RegexCache &cache) const;
+    std::shared_ptr<const UniqueRegex> CompileInverseRegex(RegexCache &cache) const;
+
 #if TRANSLATION_ENABLE_EXPAND
     /**
      * Does any response need to be expanded with
@@ -39,6 +39,11 @@
  * A string pointer whose memory is managed by this class.
  *
  * Unlike std::string, this object can hold a "nullptr" special value.
+ *
+ * Short strings (up to #INLINE_CAPACITY characters) are stored inside
+ * the object instead of on the heap.  Therefore, unlike the pointer
+ * returned by Steal(), the pointer returned by c_str() and data() is
+ * only valid until the object is moved.
  */
 template<typename T=char>
 class AllocatedString {
@@ -53,21 +58,66 @@ public:
 	static constexpr value_type SENTINEL = '\0';
 
 private:
+	/**
+	 * The size of the inline buffer (including the null
+	 * terminator); chosen so the whole object fits in 32 bytes.
+	 */
+	static constexpr size_type INLINE_SIZE =
+		(32 - sizeof(pointer_type)) / sizeof(value_type);
+
+public:
+	/**
+	 * The maximum length of a string which is stored inline,
+	 * without a heap allocation.
+	 */
+	static constexpr size_type INLINE_CAPACITY = INLINE_SIZE - 1;
+
+private:
+	/**
+	 * Points to a heap allocation, to #inline_buffer or is
+	 * nullptr.
+	 */
 	pointer_type value;
 
+	value_type inline_buffer[INLINE_SIZE];
+
 	explicit AllocatedString(pointer_type _value)
 		:value(_value) {}
 
+	bool IsInline() const {
+		return value == inline_buffer;
+	}
+
+	void MoveFrom(AllocatedString &src) {
+		if (src.IsInline()) {
+			std::copy_n(src.inline_buffer, INLINE_SIZE,
+				    inline_buffer);
+			value = inline_buffer;
+		} else
+			value = src.value;
+
+		src.value = nullptr;
+	}
+
+	void Free() {
+		if (!IsInline())
+			delete[] value;
+	}
+
 public:
 	AllocatedString(std::nullptr_t n):value(n) {}
 
-	AllocatedString(AllocatedString &&src)
-		:value(src.Steal()) {}
+	AllocatedString(AllocatedString &&src) {
+		MoveFrom(src);
+	}
 
 	~AllocatedString() {
-		delete[] value;
+		Free();
 	}
 
+	/**
+	 * Take over ownership of a string allocated with new[].
+	 */
 	static AllocatedString Donate(pointer_type value) {
 		return AllocatedString(value);
 	}
@@ -77,29 +127,39 @@ public:
 	}
 
 	static AllocatedString Empty() {
-		auto p = new value_type[1];
-		p[0] = SENTINEL;
-		return Donate(p);
+		return Duplicate(nullptr, size_type(0));
 	}
 
 	static AllocatedString Duplicate(const_pointer_type src);
 
 	static AllocatedString Duplicate(const_pointer_type begin,
 					 const_pointer_type end) {
-		auto p = new value_type[end - begin + 1];
-		*std::copy(begin, end, p) = SENTINEL;
-		return Donate(p);
+		return Duplicate(begin, size_type(end - begin));
 	}
 
 	static AllocatedString Duplicate(const_pointer_type begin,
 					 size_type length) {
+		if (length <= INLINE_CAPACITY) {
+			AllocatedString s(nullptr);
+			s.value = s.inline_buffer;
+			*std::copy_n(begin, length, s.inline_buffer) = SENTINEL;
+			return s;
+		}
+
 		auto p = new value_type[length + 1];
 		*std::copy_n(begin, length, p) = SENTINEL;
 		return Donate(p);
 	}
 
 	AllocatedString &operator=(AllocatedString &&src) {
-		std::swap(value, src.value);
+		if (!IsInline() && !src.IsInline())
+			/* fast path: just swap the heap pointers */
+			std::swap(value, src.value);
+		else if (this != &src) {
+			Free();
+			MoveFrom(src);
+		}
+
 		return *this;
 	}
 
@@ -135,7 +195,19 @@ public:
 		return value[i];
 	}
 
+	/**
+	 * Give up ownership and return the string, which must be
+	 * freed with delete[].  An inline string is copied to the
+	 * heap.
+	 */
 	pointer_type Steal() {
+		if (IsInline()) {
+			auto p = new value_type[INLINE_SIZE];
+			std::copy_n(inline_buffer, INLINE_SIZE, p);
+			value = nullptr;
+			return p;
+		}
+
 		pointer_type result = value;
 		value = nullptr;
 		return result;
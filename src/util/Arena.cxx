@@ -0,0 +1,181 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Arena.hxx"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+void
+Arena::FreeChunk(Chunk *chunk) noexcept
+{
+	if (sizeof(*chunk) + chunk->size >= HUGE_PAGE_SIZE)
+		FreeLarge(chunk, sizeof(*chunk) + chunk->size);
+	else
+		free(chunk);
+}
+
+void
+Arena::Clear() noexcept
+{
+	while (head != nullptr) {
+		Chunk *chunk = head;
+		head = chunk->next;
+		FreeChunk(chunk);
+	}
+
+	next_chunk_size = chunk_size;
+}
+
+void
+Arena::Reset() noexcept
+{
+	/* find the most recent regular chunk */
+	Chunk *keep = head;
+	while (keep != nullptr && keep->dedicated)
+		keep = keep->next;
+
+	while (head != nullptr) {
+		Chunk *chunk = head;
+		head = chunk->next;
+		if (chunk != keep)
+			FreeChunk(chunk);
+	}
+
+	if (keep != nullptr) {
+		keep->next = nullptr;
+		keep->position = 0;
+		head = keep;
+	}
+}
+
+Arena::Chunk &
+Arena::AllocateChunk(size_t size, bool dedicated)
+{
+	Chunk *chunk;
+
+	if (sizeof(*chunk) + size >= HUGE_PAGE_SIZE) {
+		/* round up to whole huge pages and use the remaining
+		   space, too */
+		size_t total = sizeof(*chunk) + size;
+		chunk = (Chunk *)AllocateLarge(total);
+		size = total - sizeof(*chunk);
+	} else {
+		chunk = (Chunk *)malloc(sizeof(*chunk) + size);
+		if (chunk == nullptr)
+			throw std::bad_alloc();
+	}
+
+	chunk->size = size;
+	chunk->position = 0;
+	chunk->dedicated = dedicated;
+	return *chunk;
+}
+
+void *
+Arena::Allocate(size_t size, size_t alignment)
+{
+	assert(alignment > 0);
+	assert((alignment & (alignment - 1)) == 0);
+	assert(alignment <= alignof(max_align_t));
+
+	if (head != nullptr) {
+		const size_t position = (head->position + alignment - 1)
+			& ~(alignment - 1);
+		if (position + size <= head->size) {
+			head->position = position + size;
+			return head->GetData() + position;
+		}
+	}
+
+	if (size > next_chunk_size / 4) {
+		/* large allocation: give it a chunk of its own, and
+		   insert it after the head, so the remaining space of
+		   the current chunk can still be used */
+		Chunk &chunk = AllocateChunk(size, true);
+		chunk.position = size;
+
+		if (head != nullptr) {
+			chunk.next = head->next;
+			head->next = &chunk;
+		} else {
+			chunk.next = nullptr;
+			head = &chunk;
+		}
+
+		return chunk.GetData();
+	}
+
+	Chunk &chunk = AllocateChunk(next_chunk_size, false);
+	chunk.next = head;
+	head = &chunk;
+
+	/* the next chunk will be twice as large */
+	if (sizeof(chunk) + next_chunk_size * 2 <= MAX_CHUNK_SIZE)
+		next_chunk_size *= 2;
+	else
+		next_chunk_size = MAX_CHUNK_SIZE - sizeof(chunk);
+
+	chunk.position = size;
+	return chunk.GetData();
+}
+
+const char *
+Arena::Dup(const char *src)
+{
+	return DupZ(src);
+}
+
+const char *
+Arena::DupZ(StringView src)
+{
+	char *p = (char *)Allocate(src.size + 1, 1);
+	memcpy(p, src.data, src.size);
+	p[src.size] = 0;
+	return p;
+}
+
+const char *
+Arena::Concat(StringView a, StringView b, StringView c)
+{
+	char *p = (char *)Allocate(a.size + b.size + c.size + 1, 1);
+	char *q = p;
+	memcpy(q, a.data, a.size);
+	q += a.size;
+	memcpy(q, b.data, b.size);
+	q += b.size;
+	memcpy(q, c.data, c.size);
+	q += c.size;
+	*q = 0;
+	return p;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "StringView.hxx"
+#include "LargeAllocation.hxx"
+#include "Compiler.h"
+
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#include <stddef.h>
+
+/**
+ * A simple "bump pointer" allocator.  Memory is carved out of large
+ * chunks and is only freed all at once, when the #Arena is destroyed
+ * or by Clear() or Reset(); destructors of allocated objects are
+ * never invoked, therefore only trivially destructible types may be
+ * allocated.
+ *
+ * Each new regular chunk is twice as large as the previous one, up
+ * to #MAX_CHUNK_SIZE.  Chunks of that size are allocated aligned to
+ * (and as a multiple of) the huge page size, so the kernel can back
+ * them with transparent huge pages.
+ *
+ * This class is not thread-safe.
+ */
+class Arena {
+	struct Chunk {
+		Chunk *next;
+		size_t size;
+		size_t position;
+
+		/**
+		 * Was this chunk allocated for one large allocation?
+		 * Such chunks are not kept by Reset().
+		 */
+		bool dedicated;
+
+		char *GetData() noexcept {
+			return (char *)(this + 1);
+		}
+	};
+
+	static_assert(sizeof(Chunk) % alignof(max_align_t) == 0,
+		      "Chunk data would be misaligned");
+
+public:
+	/**
+	 * The maximum size of a regular chunk (including the chunk
+	 * header); growth stops here.
+	 */
+	static constexpr size_t MAX_CHUNK_SIZE = HUGE_PAGE_SIZE;
+
+private:
+	/**
+	 * The most recently allocated chunk, followed by all older
+	 * ones.
+	 */
+	Chunk *head = nullptr;
+
+	/**
+	 * The size of the first regular chunk (excluding the #Chunk
+	 * header).  Allocations larger than a quarter of the current
+	 * chunk size get a chunk of their own.
+	 */
+	const size_t chunk_size;
+
+	/**
+	 * The size of the next regular chunk (excluding the #Chunk
+	 * header).
+	 */
+	size_t next_chunk_size;
+
+public:
+	explicit Arena(size_t _chunk_size=16384) noexcept
+		:chunk_size(_chunk_size), next_chunk_size(_chunk_size) {}
+
+	Arena(Arena &&src) noexcept
+		:head(src.head), chunk_size(src.chunk_size),
+		 next_chunk_size(src.next_chunk_size) {
+		src.head = nullptr;
+		src.next_chunk_size = src.chunk_size;
+	}
+
+	~Arena() noexcept {
+		Clear();
+	}
+
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+
+	/**
+	 * Free all allocations and all chunks.
+	 */
+	void Clear() noexcept;
+
+	/**
+	 * Free all allocations, but keep the most recent (i.e. the
+	 * largest) regular chunk for reuse.  This is cheaper than
+	 * destroying and recreating the #Arena for each unit of work.
+	 */
+	void Reset() noexcept;
+
+	/**
+	 * Throws std::bad_alloc on error.
+	 */
+	gcc_malloc
+	void *Allocate(size_t size,
+		       size_t alignment=alignof(max_align_t));
+
+	template<typename T, typename... Args>
+	T *New(Args&&... args) {
+		static_assert(std::is_trivially_destructible<T>::value,
+			      "Destructor would not be called");
+
+		return ::new(Allocate(sizeof(T), alignof(T)))
+			T(std::forward<Args>(args)...);
+	}
+
+	const char *Dup(const char *src);
+
+	/**
+	 * Copy the string and append a null terminator.
+	 */
+	const char *DupZ(StringView src);
+
+	/**
+	 * Concatenate all strings into a new null-terminated string.
+	 */
+	const char *Concat(StringView a, StringView b, StringView c);
+
+private:
+	Chunk &AllocateChunk(size_t size, bool dedicated);
+	static void FreeChunk(Chunk *chunk) noexcept;
+};
@@ -0,0 +1,310 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Base64.hxx"
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#define HAVE_BASE64_SSSE3
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HAVE_BASE64_NEON
+#endif
+
+namespace {
+
+static constexpr char standard_alphabet[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static constexpr char url_safe_alphabet[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+/**
+ * Maps each character to its 6 bit value or -1; both alphabets are
+ * accepted.
+ */
+struct DecodeTable {
+	int8_t t[256]{};
+
+	constexpr DecodeTable() noexcept {
+		for (unsigned i = 0; i < 256; ++i)
+			t[i] = -1;
+
+		for (unsigned i = 0; i < 64; ++i) {
+			t[(uint8_t)standard_alphabet[i]] = i;
+			t[(uint8_t)url_safe_alphabet[i]] = i;
+		}
+	}
+};
+
+static constexpr DecodeTable decode_table;
+
+}
+
+static char *
+EncodeScalar(char *dest, const uint8_t *src, size_t size,
+	     const char *alphabet, bool padding) noexcept
+{
+	for (; size >= 3; src += 3, size -= 3) {
+		const uint_fast32_t v = (src[0] << 16) | (src[1] << 8) | src[2];
+		*dest++ = alphabet[(v >> 18) & 0x3f];
+		*dest++ = alphabet[(v >> 12) & 0x3f];
+		*dest++ = alphabet[(v >> 6) & 0x3f];
+		*dest++ = alphabet[v & 0x3f];
+	}
+
+	if (size > 0) {
+		const uint_fast32_t v = (src[0] << 16) |
+			(size > 1 ? src[1] << 8 : 0);
+		*dest++ = alphabet[(v >> 18) & 0x3f];
+		*dest++ = alphabet[(v >> 12) & 0x3f];
+		if (size > 1)
+			*dest++ = alphabet[(v >> 6) & 0x3f];
+		else if (padding)
+			*dest++ = '=';
+
+		if (padding)
+			*dest++ = '=';
+	}
+
+	return dest;
+}
+
+#ifdef HAVE_BASE64_SSSE3
+
+/**
+ * Encode 12 bytes from each 16 byte block; the algorithm is the one
+ * by Wojciech Muła, see
+ * http://0x80.pl/notesen/2016-01-12-sse-base64-encoding.html
+ *
+ * @return the number of input bytes consumed
+ */
+__attribute__((target("ssse3")))
+static size_t
+EncodeSSSE3(char *dest, const uint8_t *src, size_t size,
+	    bool url_safe) noexcept
+{
+	const __m128i shuffle = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+					     4, 5, 3, 4, 1, 2, 0, 1);
+
+	/* the offset to be added to each 6 bit value, indexed by
+	   its "class" */
+	const __m128i offsets =
+		_mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52,
+			      '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			      '0' - 52, '0' - 52, '0' - 52,
+			      (url_safe ? '-' : '+') - 62,
+			      (url_safe ? '_' : '/') - 63,
+			      'A', 0, 0);
+
+	const uint8_t *const start = src;
+
+	/* each step reads 16 bytes, but consumes only 12 */
+	for (; size >= 16; src += 12, size -= 12, dest += 16) {
+		__m128i in = _mm_loadu_si128((const __m128i *)src);
+		in = _mm_shuffle_epi8(in, shuffle);
+
+		/* extract the four 6 bit values of each 32 bit lane
+		   into separate bytes */
+		const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+		const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+		const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+		const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+		const __m128i indices = _mm_or_si128(t1, t3);
+
+		/* classify: 0..25 => 13, 26..51 => 0, 52..61 => 1..10,
+		   62 => 11, 63 => 12 */
+		__m128i c = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+		const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+		c = _mm_or_si128(c, _mm_and_si128(less, _mm_set1_epi8(13)));
+
+		const __m128i out =
+			_mm_add_epi8(_mm_shuffle_epi8(offsets, c), indices);
+		_mm_storeu_si128((__m128i *)dest, out);
+	}
+
+	return src - start;
+}
+
+static bool
+HaveSSSE3() noexcept
+{
+	return __builtin_cpu_supports("ssse3");
+}
+
+#elif defined(HAVE_BASE64_NEON)
+
+/**
+ * Encode 48 bytes per step with a 64 byte table lookup.
+ *
+ * @return the number of input bytes consumed
+ */
+static size_t
+EncodeNEON(char *dest, const uint8_t *src, size_t size,
+	   bool url_safe) noexcept
+{
+	const auto *alphabet = (const uint8_t *)(url_safe
+						 ? url_safe_alphabet
+						 : standard_alphabet);
+	uint8x16x4_t table;
+	table.val[0] = vld1q_u8(alphabet);
+	table.val[1] = vld1q_u8(alphabet + 16);
+	table.val[2] = vld1q_u8(alphabet + 32);
+	table.val[3] = vld1q_u8(alphabet + 48);
+
+	const uint8x16_t mask = vdupq_n_u8(0x3f);
+	const uint8_t *const start = src;
+
+	for (; size >= 48; src += 48, size -= 48, dest += 64) {
+		const uint8x16x3_t in = vld3q_u8(src);
+
+		uint8x16x4_t out;
+		out.val[0] = vshrq_n_u8(in.val[0], 2);
+		out.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4),
+					       vshrq_n_u8(in.val[1], 4)),
+				      mask);
+		out.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2),
+					       vshrq_n_u8(in.val[2], 6)),
+				      mask);
+		out.val[3] = vandq_u8(in.val[2], mask);
+
+		for (auto &i : out.val)
+			i = vqtbl4q_u8(table, i);
+
+		vst4q_u8((uint8_t *)dest, out);
+	}
+
+	return src - start;
+}
+
+#endif
+
+static size_t
+Encode(char *dest, ConstBuffer<void> _src, bool url_safe) noexcept
+{
+	auto src = ConstBuffer<uint8_t>::FromVoid(_src);
+	char *const start = dest;
+
+#ifdef HAVE_BASE64_SSSE3
+	/* detected only once; the initialization of function-local
+	   statics is thread-safe */
+	static const bool have_ssse3 = HaveSSSE3();
+	if (have_ssse3) {
+		const size_t n = EncodeSSSE3(dest, src.data, src.size,
+					     url_safe);
+		src.skip_front(n);
+		dest += n / 3 * 4;
+	}
+#elif defined(HAVE_BASE64_NEON)
+	const size_t n = EncodeNEON(dest, src.data, src.size, url_safe);
+	src.skip_front(n);
+	dest += n / 3 * 4;
+#endif
+
+	dest = EncodeScalar(dest, src.data, src.size,
+			    url_safe ? url_safe_alphabet : standard_alphabet,
+			    !url_safe);
+	return dest - start;
+}
+
+size_t
+EncodeBase64(char *dest, ConstBuffer<void> src) noexcept
+{
+	return Encode(dest, src, false);
+}
+
+size_t
+EncodeUrlSafeBase64(char *dest, ConstBuffer<void> src) noexcept
+{
+	return Encode(dest, src, true);
+}
+
+size_t
+EncodeBase64Scalar(char *dest, ConstBuffer<void> _src) noexcept
+{
+	const auto src = ConstBuffer<uint8_t>::FromVoid(_src);
+	return EncodeScalar(dest, src.data, src.size,
+			    standard_alphabet, true) - dest;
+}
+
+ssize_t
+DecodeBase64(void *_dest, StringView src) noexcept
+{
+	/* strip the padding; if present, the length must be a
+	   multiple of 4 */
+	if (!src.empty() && src.back() == '=') {
+		if (src.size % 4 != 0)
+			return -1;
+
+		src.pop_back();
+		if (src.back() == '=')
+			src.pop_back();
+	}
+
+	if (src.size % 4 == 1)
+		return -1;
+
+	auto *dest = (uint8_t *)_dest;
+	uint8_t *const start = dest;
+	const auto *p = (const uint8_t *)src.data;
+	size_t size = src.size;
+
+	for (; size >= 4; p += 4, size -= 4) {
+		const int_fast32_t a = decode_table.t[p[0]];
+		const int_fast32_t b = decode_table.t[p[1]];
+		const int_fast32_t c = decode_table.t[p[2]];
+		const int_fast32_t d = decode_table.t[p[3]];
+		if ((a | b | c | d) < 0)
+			return -1;
+
+		const uint_fast32_t v = (a << 18) | (b << 12) | (c << 6) | d;
+		*dest++ = v >> 16;
+		*dest++ = v >> 8;
+		*dest++ = v;
+	}
+
+	if (size > 0) {
+		const int_fast32_t a = decode_table.t[p[0]];
+		const int_fast32_t b = decode_table.t[p[1]];
+		const int_fast32_t c = size > 2 ? decode_table.t[p[2]] : 0;
+		if ((a | b | c) < 0)
+			return -1;
+
+		const uint_fast32_t v = (a << 18) | (b << 12) | (c << 6);
+		*dest++ = v >> 16;
+		if (size > 2)
+			*dest++ = v >> 8;
+	}
+
+	return dest - start;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Base64 encoder and decoder (RFC 4648) which write into a buffer
+ * provided by the caller.
+ */
+
+#pragma once
+
+#include "ConstBuffer.hxx"
+#include "StringView.hxx"
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * The length of the padded Base64 encoding of the given number of
+ * bytes.
+ */
+constexpr size_t
+CalculateBase64OutputSize(size_t in_size) noexcept
+{
+	return (in_size + 2) / 3 * 4;
+}
+
+/**
+ * The maximum number of bytes decoded from a Base64 string of the
+ * given length.
+ */
+constexpr size_t
+CalculateBase64DecodedSize(size_t in_size) noexcept
+{
+	return (in_size + 3) / 4 * 3;
+}
+
+/**
+ * Encode with the standard alphabet and "=" padding, without line
+ * breaks.  No null terminator is written.
+ *
+ * @param dest a buffer of at least CalculateBase64OutputSize() bytes
+ * @return the number of characters written
+ */
+size_t
+EncodeBase64(char *dest, ConstBuffer<void> src) noexcept;
+
+/**
+ * Encode with the URL and filename safe alphabet ("-" and "_"
+ * instead of "+" and "/") and without padding, as used by JOSE/ACME.
+ *
+ * @param dest a buffer of at least CalculateBase64OutputSize() bytes
+ * @return the number of characters written
+ */
+size_t
+EncodeUrlSafeBase64(char *dest, ConstBuffer<void> src) noexcept;
+
+/**
+ * Decode a Base64 string.  Both alphabets are accepted, and the
+ * padding is optional; whitespace is not allowed.
+ *
+ * @param dest a buffer of at least CalculateBase64DecodedSize()
+ * bytes
+ * @return the number of bytes written or -1 if the string is
+ * malformed
+ */
+ssize_t
+DecodeBase64(void *dest, StringView src) noexcept;
+
+/**
+ * The portable implementation of EncodeBase64(); only exposed for
+ * unit tests and benchmarks.
+ */
+size_t
+EncodeBase64Scalar(char *dest, ConstBuffer<void> src) noexcept;
@@ -76,6 +76,23 @@ public:
 	R operator()(Args... args) const {
 		return function(instance_, std::forward<Args>(args)...);
 	}
+
+	/**
+	 * Returns the instance pointer.  This is only meant for
+	 * diagnostics.
+	 */
+	void *GetInstance() const {
+		return instance_;
+	}
+
+	/**
+	 * Returns the address of the wrapper function.  This is only
+	 * meant for diagnostics, e.g. to look up the symbol name of
+	 * the bound method.
+	 */
+	const void *GetFunctionAddress() const {
+		return (const void *)function;
+	}
 };
 
 namespace BindMethodDetail {
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <iterator>
+
+#include <stddef.h>
+
+/**
+ * Find the first element in the sorted range [first, first+n) for
+ * which @is_less returns false.  Unlike std::lower_bound(), the loop
+ * body has no data dependent branch; the compiler emits a
+ * conditional move instead, which is faster on small arrays because
+ * it never mispredicts.
+ *
+ * @param is_less a function which returns true if the given element
+ * is less than the key being searched
+ */
+template<typename I, typename F>
+static inline I
+BranchlessLowerBound(I first, size_t n, F &&is_less)
+{
+	if (n == 0)
+		return first;
+
+	while (n > 1) {
+		const size_t half = n / 2;
+		first = is_less(*std::next(first, half - 1))
+			? std::next(first, half)
+			: first;
+		n -= half;
+	}
+
+	if (is_less(*first))
+		++first;
+
+	return first;
+}
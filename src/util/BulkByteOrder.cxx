@@ -0,0 +1,241 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "BulkByteOrder.hxx"
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define HAVE_BULK_BYTE_ORDER_SSE
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_BULK_BYTE_ORDER_SSE
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HAVE_BULK_BYTE_ORDER_NEON
+#endif
+
+namespace {
+
+#ifdef HAVE_BULK_BYTE_ORDER_SSE
+
+typedef __m128i Vector;
+
+static inline Vector
+LoadVector(const uint8_t *p) noexcept
+{
+	return _mm_loadu_si128((const __m128i *)p);
+}
+
+static inline void
+StoreVector(uint8_t *p, Vector v) noexcept
+{
+	_mm_storeu_si128((__m128i *)p, v);
+}
+
+#ifdef __SSSE3__
+
+static inline Vector
+Swap16(Vector v) noexcept
+{
+	return _mm_shuffle_epi8(v, _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+						 9, 8, 11, 10, 13, 12, 15, 14));
+}
+
+static inline Vector
+Swap32(Vector v) noexcept
+{
+	return _mm_shuffle_epi8(v, _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+						 11, 10, 9, 8, 15, 14, 13, 12));
+}
+
+static inline Vector
+Swap64(Vector v) noexcept
+{
+	return _mm_shuffle_epi8(v, _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0,
+						 15, 14, 13, 12, 11, 10, 9, 8));
+}
+
+#else
+
+/* SSE2 has no byte shuffle: swap the bytes within each 16 bit
+   word, then reorder the words */
+
+static inline Vector
+Swap16(Vector v) noexcept
+{
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static inline Vector
+Swap32(Vector v) noexcept
+{
+	v = Swap16(v);
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xb1), 0xb1);
+}
+
+static inline Vector
+Swap64(Vector v) noexcept
+{
+	v = Swap16(v);
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0x1b), 0x1b);
+}
+
+#endif
+
+#elif defined(HAVE_BULK_BYTE_ORDER_NEON)
+
+typedef uint8x16_t Vector;
+
+static inline Vector
+LoadVector(const uint8_t *p) noexcept
+{
+	return vld1q_u8(p);
+}
+
+static inline void
+StoreVector(uint8_t *p, Vector v) noexcept
+{
+	vst1q_u8(p, v);
+}
+
+static inline Vector
+Swap16(Vector v) noexcept
+{
+	return vrev16q_u8(v);
+}
+
+static inline Vector
+Swap32(Vector v) noexcept
+{
+	return vrev32q_u8(v);
+}
+
+static inline Vector
+Swap64(Vector v) noexcept
+{
+	return vrev64q_u8(v);
+}
+
+#endif
+
+struct Traits16 {
+	typedef uint16_t value_type;
+
+	static value_type Swap(value_type value) noexcept {
+		return ByteSwap16(value);
+	}
+
+#if defined(HAVE_BULK_BYTE_ORDER_SSE) || defined(HAVE_BULK_BYTE_ORDER_NEON)
+	static Vector Swap(Vector v) noexcept {
+		return Swap16(v);
+	}
+#endif
+};
+
+struct Traits32 {
+	typedef uint32_t value_type;
+
+	static value_type Swap(value_type value) noexcept {
+		return ByteSwap32(value);
+	}
+
+#if defined(HAVE_BULK_BYTE_ORDER_SSE) || defined(HAVE_BULK_BYTE_ORDER_NEON)
+	static Vector Swap(Vector v) noexcept {
+		return Swap32(v);
+	}
+#endif
+};
+
+struct Traits64 {
+	typedef uint64_t value_type;
+
+	static value_type Swap(value_type value) noexcept {
+		return ByteSwap64(value);
+	}
+
+#if defined(HAVE_BULK_BYTE_ORDER_SSE) || defined(HAVE_BULK_BYTE_ORDER_NEON)
+	static Vector Swap(Vector v) noexcept {
+		return Swap64(v);
+	}
+#endif
+};
+
+template<typename Traits>
+static void
+SwapArray(void *_dest, const void *_src, size_t n) noexcept
+{
+	using T = typename Traits::value_type;
+
+	auto *dest = (uint8_t *)_dest;
+	const auto *src = (const uint8_t *)_src;
+	size_t size = n * sizeof(T);
+
+#if defined(HAVE_BULK_BYTE_ORDER_SSE) || defined(HAVE_BULK_BYTE_ORDER_NEON)
+	/* two vectors per step; both are loaded before storing, so
+	   in-place conversion works */
+	for (; size >= 32; src += 32, dest += 32, size -= 32) {
+		const Vector a = Traits::Swap(LoadVector(src));
+		const Vector b = Traits::Swap(LoadVector(src + 16));
+		StoreVector(dest, a);
+		StoreVector(dest + 16, b);
+	}
+
+	if (size >= 16) {
+		StoreVector(dest, Traits::Swap(LoadVector(src)));
+		src += 16;
+		dest += 16;
+		size -= 16;
+	}
+#endif
+
+	for (; size > 0; src += sizeof(T), dest += sizeof(T), size -= sizeof(T))
+		StoreUnaligned(dest, Traits::Swap(LoadUnaligned<T>(src)));
+}
+
+}
+
+void
+ByteSwapArray16(void *dest, const void *src, size_t n) noexcept
+{
+	SwapArray<Traits16>(dest, src, n);
+}
+
+void
+ByteSwapArray32(void *dest, const void *src, size_t n) noexcept
+{
+	SwapArray<Traits32>(dest, src, n);
+}
+
+void
+ByteSwapArray64(void *dest, const void *src, size_t n) noexcept
+{
+	SwapArray<Traits64>(dest, src, n);
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Byte order conversion of whole arrays of integers, vectorized with
+ * SSE2 (x86-64) or NEON (AArch64).  The source may be unaligned;
+ * source and destination may be the same buffer, but must not
+ * overlap partially.
+ */
+
+#pragma once
+
+#include "ByteOrder.hxx"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Swap the byte order of @n 16 bit values.  Both buffers may be
+ * unaligned.
+ */
+void
+ByteSwapArray16(void *dest, const void *src, size_t n) noexcept;
+
+void
+ByteSwapArray32(void *dest, const void *src, size_t n) noexcept;
+
+void
+ByteSwapArray64(void *dest, const void *src, size_t n) noexcept;
+
+/**
+ * Load @n big-endian values from @src (which may be unaligned) and
+ * convert them to the system's byte order.
+ */
+static inline void
+LoadBE16Array(uint16_t *dest, const void *src, size_t n) noexcept
+{
+	if (IsBigEndian())
+		memmove(dest, src, n * sizeof(*dest));
+	else
+		ByteSwapArray16(dest, src, n);
+}
+
+static inline void
+LoadBE32Array(uint32_t *dest, const void *src, size_t n) noexcept
+{
+	if (IsBigEndian())
+		memmove(dest, src, n * sizeof(*dest));
+	else
+		ByteSwapArray32(dest, src, n);
+}
+
+static inline void
+LoadBE64Array(uint64_t *dest, const void *src, size_t n) noexcept
+{
+	if (IsBigEndian())
+		memmove(dest, src, n * sizeof(*dest));
+	else
+		ByteSwapArray64(dest, src, n);
+}
+
+static inline void
+LoadLE16Array(uint16_t *dest, const void *src, size_t n) noexcept
+{
+	if (IsLittleEndian())
+		memmove(dest, src, n * sizeof(*dest));
+	else
+		ByteSwapArray16(dest, src, n);
+}
+
+static inline void
+LoadLE32Array(uint32_t *dest, const void *src, size_t n) noexcept
+{
+	if (IsLittleEndian())
+		memmove(dest, src, n * sizeof(*dest));
+	else
+		ByteSwapArray32(dest, src, n);
+}
+
+static inline void
+LoadLE64Array(uint64_t *dest, const void *src, size_t n) noexcept
+{
+	if (IsLittleEndian())
+		memmove(dest, src, n * sizeof(*dest));
+	else
+		ByteSwapArray64(dest, src, n);
+}
+
+/**
+ * Convert @n values from the system's byte order to big-endian and
+ * store them at @dest (which may be unaligned).
+ */
+static inline void
+StoreBE16Array(void *dest, const uint16_t *src, size_t n) noexcept
+{
+	if (IsBigEndian())
+		memmove(dest, src, n * sizeof(*src));
+	else
+		ByteSwapArray16(dest, src, n);
+}
+
+static inline void
+StoreBE32Array(void *dest, const uint32_t *src, size_t n) noexcept
+{
+	if (IsBigEndian())
+		memmove(dest, src, n * sizeof(*src));
+	else
+		ByteSwapArray32(dest, src, n);
+}
+
+static inline void
+StoreBE64Array(void *dest, const uint64_t *src, size_t n) noexcept
+{
+	if (IsBigEndian())
+		memmove(dest, src, n * sizeof(*src));
+	else
+		ByteSwapArray64(dest, src, n);
+}
+
+static inline void
+StoreLE16Array(void *dest, const uint16_t *src, size_t n) noexcept
+{
+	if (IsLittleEndian())
+		memmove(dest, src, n * sizeof(*src));
+	else
+		ByteSwapArray16(dest, src, n);
+}
+
+static inline void
+StoreLE32Array(void *dest, const uint32_t *src, size_t n) noexcept
+{
+	if (IsLittleEndian())
+		memmove(dest, src, n * sizeof(*src));
+	else
+		ByteSwapArray32(dest, src, n);
+}
+
+static inline void
+StoreLE64Array(void *dest, const uint64_t *src, size_t n) noexcept
+{
+	if (IsLittleEndian())
+		memmove(dest, src, n * sizeof(*src));
+	else
+		ByteSwapArray64(dest, src, n);
+}
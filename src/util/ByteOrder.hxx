@@ -33,6 +33,7 @@
 #include "Compiler.h"
 
 #include <stdint.h>
+#include <string.h>
 
 #if defined(__i386__) || defined(__x86_64__) || defined(__ARMEL__)
 /* well-known little-endian */
@@ -234,4 +235,99 @@ ToLE64(uint64_t value)
 	return IsLittleEndian() ? value : ByteSwap64(value);
 }
 
+/**
+ * Load a value from a possibly unaligned address; memcpy() compiles
+ * to a single load instruction.
+ */
+template<typename T>
+static inline T
+LoadUnaligned(const void *p) noexcept
+{
+	T value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+/**
+ * Store a value at a possibly unaligned address.
+ */
+template<typename T>
+static inline void
+StoreUnaligned(void *p, T value) noexcept
+{
+	memcpy(p, &value, sizeof(value));
+}
+
+static inline uint16_t
+LoadBE16(const void *p) noexcept
+{
+	return FromBE16(LoadUnaligned<uint16_t>(p));
+}
+
+static inline uint32_t
+LoadBE32(const void *p) noexcept
+{
+	return FromBE32(LoadUnaligned<uint32_t>(p));
+}
+
+static inline uint64_t
+LoadBE64(const void *p) noexcept
+{
+	return FromBE64(LoadUnaligned<uint64_t>(p));
+}
+
+static inline uint16_t
+LoadLE16(const void *p) noexcept
+{
+	return FromLE16(LoadUnaligned<uint16_t>(p));
+}
+
+static inline uint32_t
+LoadLE32(const void *p) noexcept
+{
+	return FromLE32(LoadUnaligned<uint32_t>(p));
+}
+
+static inline uint64_t
+LoadLE64(const void *p) noexcept
+{
+	return FromLE64(LoadUnaligned<uint64_t>(p));
+}
+
+static inline void
+StoreBE16(void *p, uint16_t value) noexcept
+{
+	StoreUnaligned(p, ToBE16(value));
+}
+
+static inline void
+StoreBE32(void *p, uint32_t value) noexcept
+{
+	StoreUnaligned(p, ToBE32(value));
+}
+
+static inline void
+StoreBE64(void *p, uint64_t value) noexcept
+{
+	StoreUnaligned(p, ToBE64(value));
+}
+
+static inline void
+StoreLE16(void *p, uint16_t value) noexcept
+{
+	StoreUnaligned(p, ToLE16(value));
+}
+
+static inline void
+StoreLE32(void *p, uint32_t value) noexcept
+{
+	StoreUnaligned(p, ToLE32(value));
+}
+
+static inline void
+StoreLE64(void *p, uint64_t value) noexcept
+{
+	StoreUnaligned(p, ToLE64(value));
+}
+
 #endif
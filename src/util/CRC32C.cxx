@@ -0,0 +1,162 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CRC32C.hxx"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define HAVE_CRC32C_SSE42
+#elif defined(__aarch64__) && defined(__linux__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define HAVE_CRC32C_ARM64
+#endif
+
+namespace {
+
+/**
+ * The reflected Castagnoli polynomial.
+ */
+static constexpr uint32_t POLY = 0x82f63b78;
+
+struct CRC32CTable {
+	uint32_t t[256]{};
+
+	constexpr CRC32CTable() noexcept {
+		for (unsigned i = 0; i < 256; ++i) {
+			uint32_t crc = i;
+			for (unsigned j = 0; j < 8; ++j)
+				crc = (crc >> 1) ^ (POLY & (0 - (crc & 1)));
+			t[i] = crc;
+		}
+	}
+};
+
+static constexpr CRC32CTable table;
+
+}
+
+uint32_t
+CRC32CSoftware(const void *_data, size_t size, uint32_t crc) noexcept
+{
+	const auto *data = (const uint8_t *)_data;
+
+	crc = ~crc;
+	while (size-- > 0)
+		crc = table.t[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+#ifdef HAVE_CRC32C_SSE42
+
+__attribute__((target("sse4.2")))
+static uint32_t
+CRC32CHardware(const void *_data, size_t size, uint32_t crc) noexcept
+{
+	const auto *data = (const uint8_t *)_data;
+
+	crc = ~crc;
+
+#ifdef __x86_64__
+	uint64_t crc64 = crc;
+	for (; size >= 8; data += 8, size -= 8) {
+		uint64_t value;
+		memcpy(&value, data, sizeof(value));
+		crc64 = _mm_crc32_u64(crc64, value);
+	}
+	crc = crc64;
+#endif
+
+	for (; size >= 4; data += 4, size -= 4) {
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		crc = _mm_crc32_u32(crc, value);
+	}
+
+	while (size-- > 0)
+		crc = _mm_crc32_u8(crc, *data++);
+
+	return ~crc;
+}
+
+static bool
+HaveHardware() noexcept
+{
+	return __builtin_cpu_supports("sse4.2");
+}
+
+#elif defined(HAVE_CRC32C_ARM64)
+
+__attribute__((target("+crc")))
+static uint32_t
+CRC32CHardware(const void *_data, size_t size, uint32_t crc) noexcept
+{
+	const auto *data = (const uint8_t *)_data;
+
+	crc = ~crc;
+
+	for (; size >= 8; data += 8, size -= 8) {
+		uint64_t value;
+		memcpy(&value, data, sizeof(value));
+		crc = __crc32cd(crc, value);
+	}
+
+	while (size-- > 0)
+		crc = __crc32cb(crc, *data++);
+
+	return ~crc;
+}
+
+static bool
+HaveHardware() noexcept
+{
+	return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+
+#endif
+
+uint32_t
+CRC32C(const void *data, size_t size, uint32_t crc) noexcept
+{
+#if defined(HAVE_CRC32C_SSE42) || defined(HAVE_CRC32C_ARM64)
+	/* detected only once; the initialization of function-local
+	   statics is thread-safe */
+	static const bool have_hardware = HaveHardware();
+	if (have_hardware)
+		return CRC32CHardware(data, size, crc);
+#endif
+
+	return CRC32CSoftware(data, size, crc);
+}
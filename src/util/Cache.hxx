@@ -42,19 +42,200 @@
 #include <assert.h>
 
 /**
- * A simple LRU cache.  Item lookup is done with a hash table.  No
+ * The default #Cache eviction policy: strict LRU.  The least
+ * recently used item is evicted.
+ */
+struct CacheLruPolicy {
+	/**
+	 * Per-item data needed by this policy (a base class of each
+	 * cache item).
+	 */
+	struct ItemData {};
+
+	template<typename Item, typename List, std::size_t max_size>
+	class State {
+		List list;
+
+	public:
+		bool IsEmpty() const noexcept {
+			return list.empty();
+		}
+
+		/**
+		 * Add a new item.
+		 */
+		void Insert(Item &item) noexcept {
+			list.push_front(item);
+		}
+
+		/**
+		 * An item has been accessed.
+		 */
+		void Touch(Item &item) noexcept {
+			list.erase(list.iterator_to(item));
+			list.push_front(item);
+		}
+
+		void Erase(Item &item) noexcept {
+			list.erase(list.iterator_to(item));
+		}
+
+		/**
+		 * Returns the item which shall be evicted next.  The
+		 * cache must not be empty.
+		 */
+		Item &GetVictim() noexcept {
+			return list.back();
+		}
+
+		template<typename D>
+		void ClearAndDispose(D &&d) noexcept {
+			list.clear_and_dispose(d);
+		}
+
+		template<typename P, typename D>
+		void RemoveAndDisposeIf(P &&p, D &&d) noexcept {
+			list.remove_and_dispose_if(p, d);
+		}
+
+		template<typename F>
+		void ForEach(F &&f) const {
+			for (const auto &i : list)
+				f(i);
+		}
+	};
+};
+
+/**
+ * A scan-resistant #Cache eviction policy: segmented LRU.  New items
+ * are inserted into a "probationary" segment; only an item which is
+ * accessed again is promoted to the "protected" segment.  Items are
+ * evicted from the probationary segment first, so a burst of
+ * one-time lookups (e.g. a crawler) cannot flush the items which are
+ * used repeatedly.
+ *
+ * @param protected_percent the maximum size of the protected
+ * segment in percent of the cache size; when it overflows, its least
+ * recently used item is demoted to the probationary segment
+ */
+template<unsigned protected_percent=80>
+struct CacheSlruPolicy {
+	static_assert(protected_percent < 100,
+		      "Need room in the probationary segment");
+
+	struct ItemData {
+		bool is_protected;
+	};
+
+	template<typename Item, typename List, std::size_t max_size>
+	class State {
+		static constexpr std::size_t max_protected =
+			max_size * protected_percent / 100;
+
+		List probation, protected_list;
+
+		std::size_t n_protected = 0;
+
+		void Protect(Item &item) noexcept {
+			if (n_protected >= max_protected) {
+				if (protected_list.empty())
+					/* max_protected is zero */
+					return;
+
+				/* make room by demoting the least
+				   recently used protected item */
+				Item &demoted = protected_list.back();
+				protected_list.pop_back();
+				demoted.is_protected = false;
+				probation.push_front(demoted);
+				--n_protected;
+			}
+
+			item.is_protected = true;
+			protected_list.push_front(item);
+			++n_protected;
+		}
+
+	public:
+		bool IsEmpty() const noexcept {
+			return probation.empty() && protected_list.empty();
+		}
+
+		void Insert(Item &item) noexcept {
+			item.is_protected = false;
+			probation.push_front(item);
+		}
+
+		void Touch(Item &item) noexcept {
+			if (item.is_protected) {
+				protected_list.erase(protected_list.iterator_to(item));
+				protected_list.push_front(item);
+			} else {
+				probation.erase(probation.iterator_to(item));
+				Protect(item);
+				if (!item.is_protected)
+					probation.push_front(item);
+			}
+		}
+
+		void Erase(Item &item) noexcept {
+			if (item.is_protected) {
+				protected_list.erase(protected_list.iterator_to(item));
+				--n_protected;
+			} else
+				probation.erase(probation.iterator_to(item));
+		}
+
+		Item &GetVictim() noexcept {
+			return probation.empty()
+				? protected_list.back()
+				: probation.back();
+		}
+
+		template<typename D>
+		void ClearAndDispose(D &&d) noexcept {
+			probation.clear_and_dispose(d);
+			protected_list.clear_and_dispose(d);
+			n_protected = 0;
+		}
+
+		template<typename P, typename D>
+		void RemoveAndDisposeIf(P &&p, D &&d) noexcept {
+			probation.remove_and_dispose_if(p, d);
+			protected_list.remove_and_dispose_if(p, [this, &d](Item *item){
+					--n_protected;
+					d(item);
+				});
+		}
+
+		template<typename F>
+		void ForEach(F &&f) const {
+			for (const auto &i : protected_list)
+				f(i);
+			for (const auto &i : probation)
+				f(i);
+		}
+	};
+};
+
+/**
+ * A simple fixed-size cache; by default, the least recently used
+ * item is evicted.  Item lookup is done with a hash table.  No
  * dynamic allocation; all items are allocated statically inside this
  * class.
  *
  * @param max_size the maximum number of items in the cache
  * @param table_size the size of the internal hash table; rule of
  * thumb: should be prime
+ * @param Policy the eviction policy, e.g. #CacheLruPolicy or
+ * #CacheSlruPolicy
  */
 template<typename Key, typename Data,
 	 std::size_t max_size,
 	 std::size_t table_size,
 	 typename Hash=std::hash<Key>,
-	 typename Equal=std::equal_to<Key>>
+	 typename Equal=std::equal_to<Key>,
+	 typename Policy=CacheLruPolicy>
 class Cache {
 
 	struct Pair {
@@ -84,7 +265,8 @@ class Cache {
 
 	class Item
 		: public boost::intrusive::unordered_set_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>>,
-		  public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
+		  public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>>,
+		  public Policy::ItemData {
 
 		Manual<Pair> pair;
 
@@ -157,7 +339,10 @@ class Cache {
 	 */
 	ItemList unallocated_list;
 
-	ItemList chronological_list;
+	/**
+	 * The allocated items, managed by the eviction policy.
+	 */
+	typename Policy::template State<Item, ItemList, max_size> policy;
 
 	typedef boost::intrusive::unordered_set<Item,
 						boost::intrusive::hash<ItemHash>,
@@ -172,20 +357,20 @@ class Cache {
 
 	gcc_pure
 	Item &GetOldest() noexcept {
-		assert(!chronological_list.empty());
+		assert(!policy.IsEmpty());
 
-		return chronological_list.back();
+		return policy.GetVictim();
 	}
 
 	/**
 	 * Remove the oldest item from the cache (both from the #map and
-	 * from #chronological_list), but do not destruct it.
+	 * from #policy), but do not destruct it.
 	 */
 	Item &RemoveOldest() noexcept {
 		Item &item = GetOldest();
 
 		map.erase(map.iterator_to(item));
-		chronological_list.erase(chronological_list.iterator_to(item));
+		policy.Erase(item);
 
 		return item;
 	}
@@ -231,7 +416,7 @@ public:
 	Cache &operator=(const Cache &) = delete;
 
 	bool IsEmpty() const noexcept {
-		return chronological_list.empty();
+		return policy.IsEmpty();
 	}
 
 	bool IsFull() const noexcept {
@@ -241,7 +426,7 @@ public:
 	void Clear() noexcept {
 		map.clear();
 
-		chronological_list.clear_and_dispose([this](Item *item){
+		policy.ClearAndDispose([this](Item *item){
 				item->Destruct();
 				unallocated_list.push_front(*item);
 			});
@@ -260,13 +445,44 @@ public:
 
 		Item &item = *i;
 
-		/* move to the front of the chronological list */
-		chronological_list.erase(chronological_list.iterator_to(item));
-		chronological_list.push_front(item);
+		/* mark as recently used */
+		policy.Touch(item);
 
 		return &item.GetData();
 	}
 
+	/**
+	 * Look up an item by its key without marking it as recently
+	 * used.  Unlike Get(), this does not modify the cache, so it
+	 * may be called concurrently by multiple readers.  Returns
+	 * nullptr if no such item exists.
+	 */
+	template<typename K>
+	gcc_pure
+	const Data *Peek(K &&key) const noexcept {
+		auto i = map.find(std::forward<K>(key),
+				  map.hash_function(), map.key_eq());
+		if (i == map.end())
+			return nullptr;
+
+		return &i->GetData();
+	}
+
+	/**
+	 * Returns the item which would be evicted next (with the
+	 * default policy: the least recently used one) without
+	 * modifying the cache, or nullptr if the cache is empty.  This
+	 * allows the caller to evict items with RemoveItem() according
+	 * to its own policy.
+	 */
+	gcc_pure
+	Data *PeekOldest() noexcept {
+		if (policy.IsEmpty())
+			return nullptr;
+
+		return &GetOldest().GetData();
+	}
+
 	/**
 	 * Insert a new item into the cache.  The key must not exist
 	 * already, i.e. Get() has returned nullptr; it is not
@@ -277,7 +493,7 @@ public:
 	template<typename K, typename U>
 	Data &Put(K &&key, U &&data) {
 		Item &item = Make(std::forward<K>(key), std::forward<U>(data));
-		chronological_list.push_front(item);
+		policy.Insert(item);
 		auto i = map.insert(item);
 		(void)i;
 		assert(i.second && "Key must not exist already");
@@ -296,7 +512,7 @@ public:
 					  icd);
 		if (i.second) {
 			Item &item = Make(std::forward<K>(key), std::forward<U>(data));
-			chronological_list.push_front(item);
+			policy.Insert(item);
 			map.insert_commit(item, icd);
 			return item.GetData();
 		} else {
@@ -313,7 +529,7 @@ public:
 		auto &item = Item::Cast(data);
 
 		map.erase(map.iterator_to(item));
-		chronological_list.erase(chronological_list.iterator_to(item));
+		policy.Erase(item);
 
 		item.Destruct();
 		unallocated_list.push_front(item);
@@ -331,7 +547,7 @@ public:
 		Item &item = *i;
 
 		map.erase(i);
-		chronological_list.erase(chronological_list.iterator_to(item));
+		policy.Erase(item);
 
 		item.Destruct();
 		unallocated_list.push_front(item);
@@ -343,7 +559,7 @@ public:
 	 */
 	template<typename P>
 	void RemoveIf(P &&p) noexcept {
-		chronological_list.remove_and_dispose_if([&p](const Item &item){
+		policy.RemoveAndDisposeIf([&p](const Item &item){
 				return p(item.GetKey(), item.GetData());
 			},
 			[this](Item *item){
@@ -360,8 +576,9 @@ public:
 	 */
 	template<typename F>
 	void ForEach(F &&f) const {
-		for (const auto &i : chronological_list)
-			f(i.GetKey(), i.GetData());
+		policy.ForEach([&f](const Item &i){
+				f(i.GetKey(), i.GetData());
+			});
 	}
 };
 
@@ -0,0 +1,281 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include "util/Compiler.h"
+
+#include <algorithm>
+#include <array>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A memory-efficient variant of #HashRing.  Buckets store small node
+ * indices instead of pointers (with the default 16 bit index type, a
+ * ring with 64k buckets occupies 128 kB instead of 512 kB), and nodes
+ * can be added and removed incrementally, touching only the buckets
+ * owned by that node.
+ *
+ * The highest bit of each bucket marks an "injection point", i.e. a
+ * bucket where a node's replica starts.  Unlike #HashRing, when two
+ * replicas collide in one bucket, the first one wins; this makes
+ * AddNode() and RemoveNode() independent of the order of previous
+ * modifications (except for collisions).
+ *
+ * @param Node the node type
+ * @param hash_t the type of a hash value
+ * @param N_BUCKETS the number of buckets in the ring
+ * @param N_REPLICAS the number of replicas in the ring for each node
+ * @param index_t an unsigned integer type for node indices; one bit
+ * is reserved, i.e. #uint8_t allows 127 nodes and #uint16_t allows
+ * 32767 nodes
+ */
+template<typename Node, typename hash_t,
+	 size_t N_BUCKETS, size_t N_REPLICAS,
+	 typename index_t=uint16_t>
+class CompactHashRing {
+	static_assert(std::is_unsigned<index_t>::value,
+		      "Index type must be unsigned");
+
+	/**
+	 * This bit marks an injection point.
+	 */
+	static constexpr index_t POINT = index_t(1) << (sizeof(index_t) * 8 - 1);
+
+	/**
+	 * The index value of a bucket not owned by any node (only if
+	 * the ring is empty).  This is also the (exclusive) limit for
+	 * node indices.
+	 */
+	static constexpr index_t NONE = POINT - 1;
+
+	std::array<index_t, N_BUCKETS> buckets;
+
+	/**
+	 * Maps node indices to nodes.  Unused indices are nullptr.
+	 */
+	std::vector<Node *> nodes;
+
+	/**
+	 * The number of injection points in #buckets.
+	 */
+	size_t n_points;
+
+	static constexpr size_t Next(size_t b) noexcept {
+		return b + 1 == N_BUCKETS ? 0 : b + 1;
+	}
+
+	static constexpr size_t Previous(size_t b) noexcept {
+		return b == 0 ? N_BUCKETS - 1 : b - 1;
+	}
+
+	bool IsPoint(size_t b) const noexcept {
+		return (buckets[b] & POINT) != 0;
+	}
+
+	index_t GetOwner(size_t b) const noexcept {
+		return buckets[b] & NONE;
+	}
+
+	/**
+	 * Assign the given owner to the given bucket and all
+	 * following buckets until the next injection point.
+	 */
+	void FillFrom(size_t b, index_t owner) noexcept {
+		buckets[b] = (buckets[b] & POINT) | owner;
+
+		for (size_t i = Next(b); i != b && !IsPoint(i); i = Next(i))
+			buckets[i] = owner;
+	}
+
+	/**
+	 * Find the owner of the nearest injection point before the
+	 * given bucket.
+	 */
+	gcc_pure
+	index_t FindPreviousOwner(size_t b) const noexcept {
+		if (n_points == 0)
+			return NONE;
+
+		do {
+			b = Previous(b);
+		} while (!IsPoint(b));
+
+		return GetOwner(b);
+	}
+
+	index_t AllocateIndex(Node &node) {
+		auto i = std::find(nodes.begin(), nodes.end(), nullptr);
+		if (i != nodes.end()) {
+			*i = &node;
+			return index_t(std::distance(nodes.begin(), i));
+		}
+
+		assert(nodes.size() < NONE);
+		nodes.push_back(&node);
+		return index_t(nodes.size() - 1);
+	}
+
+	gcc_pure
+	index_t FindIndex(const Node &node) const noexcept {
+		auto i = std::find(nodes.begin(), nodes.end(), &node);
+		assert(i != nodes.end());
+		return index_t(std::distance(nodes.begin(), i));
+	}
+
+public:
+	CompactHashRing() noexcept {
+		Clear();
+	}
+
+	bool IsEmpty() const noexcept {
+		return n_points == 0;
+	}
+
+	void Clear() noexcept {
+		std::fill(buckets.begin(), buckets.end(), index_t(NONE));
+		nodes.clear();
+		n_points = 0;
+	}
+
+	/**
+	 * Build the hash ring using nodes from the given container.
+	 *
+	 * @param nodes a non-empty iterable container which contains
+	 * nodes; pointers to those nodes will be stored in this object
+	 * (i.e. they must be valid as long as this object is used)
+	 * @param hasher a functor object which generates a secure hash of
+	 * a node and a replica number
+	 */
+	template<typename C, typename H>
+	void Build(C &&_nodes, H &&hasher) {
+		Clear();
+
+		for (auto &node : _nodes)
+			AddNode(node, hasher);
+	}
+
+	/**
+	 * Add a node to the ring.  Only the buckets which are taken
+	 * over by the new node are modified.
+	 *
+	 * @param node the node; it must not be in the ring already
+	 * @param hasher see Build()
+	 */
+	template<typename H>
+	void AddNode(Node &node, H &&hasher) {
+		const index_t i = AllocateIndex(node);
+
+		for (size_t replica = 0; replica < N_REPLICAS; ++replica) {
+			const size_t b = hasher(node, replica) % N_BUCKETS;
+			if (IsPoint(b))
+				/* collision: the existing replica wins */
+				continue;
+
+			buckets[b] |= POINT;
+			++n_points;
+			FillFrom(b, i);
+		}
+	}
+
+	/**
+	 * Remove a node from the ring.  Only the buckets owned by
+	 * this node are modified; they are taken over by the
+	 * preceding nodes.
+	 *
+	 * @param node a node which was previously added
+	 * @param hasher the same functor which was used to add it
+	 */
+	template<typename H>
+	void RemoveNode(const Node &node, H &&hasher) {
+		const index_t i = FindIndex(node);
+
+		/* first remove all of its injection points, so the
+		   second pass will not find them as predecessors */
+		std::array<size_t, N_REPLICAS> removed;
+		size_t n_removed = 0;
+		for (size_t replica = 0; replica < N_REPLICAS; ++replica) {
+			const size_t b = hasher(node, replica) % N_BUCKETS;
+			if (IsPoint(b) && GetOwner(b) == i) {
+				buckets[b] &= NONE;
+				--n_points;
+				removed[n_removed++] = b;
+			}
+		}
+
+		for (size_t j = 0; j < n_removed; ++j) {
+			const size_t b = removed[j];
+			if (GetOwner(b) == i)
+				FillFrom(b, FindPreviousOwner(b));
+		}
+
+		nodes[i] = nullptr;
+		while (!nodes.empty() && nodes.back() == nullptr)
+			nodes.pop_back();
+	}
+
+	/**
+	 * Pick a node using the given hash.
+	 *
+	 * The ring must not be empty.
+	 */
+	gcc_pure
+	Node &Pick(hash_t h) const noexcept {
+		assert(!IsEmpty());
+
+		return *nodes[GetOwner(h % N_BUCKETS)];
+	}
+
+	/**
+	 * Find the next node after the given one.  This is useful for
+	 * skipping known-bad nodes and turning to a failover node.
+	 *
+	 * @return a new hash (for another FindNext() call) and a node
+	 * reference (may be equal to the previous node if there is only
+	 * one node)
+	 */
+	gcc_pure
+	std::pair<hash_t, Node &> FindNext(hash_t h) const noexcept {
+		auto &node = Pick(h++);
+
+		for (size_t i = N_BUCKETS - 1;; --i, ++h) {
+			auto &n = Pick(h);
+			if (i == 0 || &n != &node)
+				return {h, n};
+		}
+	}
+};
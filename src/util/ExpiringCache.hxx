@@ -0,0 +1,328 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include "Cache.hxx"
+#include "Expiry.hxx"
+#include "Cast.hxx"
+#include "Compiler.h"
+
+#include <boost/intrusive/set.hpp>
+
+#include <assert.h>
+#include <stddef.h>
+
+/**
+ * A #Cache whose items expire and which is bounded by the sum of
+ * the items' "cost" (usually their size in bytes) in addition to the
+ * compile-time maximum number of items.  Large and small items can
+ * therefore share one memory budget.
+ *
+ * Expired items are removed lazily by Get(), and incrementally by
+ * Sweep(), which should be called periodically (e.g. from a timer)
+ * and does a bounded amount of work per call.  All methods which
+ * need the current time take it as a parameter, so callers can pass
+ * the event loop's cached clock (Expiry::FromTimePoint(
+ * EventLoop::SteadyNow())).
+ *
+ * @param max_size the maximum number of items in the cache
+ * @param table_size the size of the internal hash table; should be
+ * prime
+ * @param Policy the eviction policy, see #Cache
+ */
+template<typename Key, typename Data,
+	 std::size_t max_size,
+	 std::size_t table_size,
+	 typename Hash=std::hash<Key>,
+	 typename Equal=std::equal_to<Key>,
+	 typename Policy=CacheLruPolicy>
+class ExpiringCache {
+	struct Entry {
+		typedef boost::intrusive::set_member_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> SetHook;
+		SetHook expiry_hook;
+
+		Expiry expires;
+
+		size_t cost;
+
+		Data data;
+
+		template<typename U>
+		Entry(U &&_data, size_t _cost, Expiry _expires)
+			:expires(_expires), cost(_cost),
+			 data(std::forward<U>(_data)) {}
+
+		/* the hook is not copied; the caller is responsible
+		   for (re-)linking the entry */
+		Entry(Entry &&src)
+			:expires(src.expires), cost(src.cost),
+			 data(std::move(src.data)) {}
+
+		Entry &operator=(Entry &&src) {
+			expires = src.expires;
+			cost = src.cost;
+			data = std::move(src.data);
+			return *this;
+		}
+
+		static Entry &Cast(Data &data) noexcept {
+			return ContainerCast(data, &Entry::data);
+		}
+
+		struct Compare {
+			gcc_pure
+			bool operator()(const Entry &a, const Entry &b) const noexcept {
+				return !(a.expires >= b.expires);
+			}
+		};
+	};
+
+	typedef ::Cache<Key, Entry, max_size, table_size,
+			Hash, Equal, Policy> EntryCache;
+
+	EntryCache cache;
+
+	/**
+	 * All entries ordered by their expiry, for Sweep().
+	 */
+	typedef boost::intrusive::multiset<Entry,
+					   boost::intrusive::member_hook<Entry,
+									 typename Entry::SetHook,
+									 &Entry::expiry_hook>,
+					   boost::intrusive::compare<typename Entry::Compare>,
+					   boost::intrusive::constant_time_size<false>> ExpirySet;
+
+	ExpirySet expiry_set;
+
+	const size_t max_cost;
+
+	size_t cost = 0;
+
+	void RemoveEntry(Entry &entry) noexcept {
+		assert(cost >= entry.cost);
+
+		cost -= entry.cost;
+		expiry_set.erase(expiry_set.iterator_to(entry));
+		cache.RemoveItem(entry);
+	}
+
+	/**
+	 * Evict items (according to the #Policy) until there is room
+	 * for a new item with the given cost.
+	 */
+	void MakeRoom(size_t new_cost) noexcept {
+		while (cache.IsFull() || cost + new_cost > max_cost) {
+			Entry *victim = cache.PeekOldest();
+			if (victim == nullptr)
+				break;
+
+			RemoveEntry(*victim);
+		}
+	}
+
+public:
+	/**
+	 * @param _max_cost the maximum sum of all items' costs
+	 */
+	explicit ExpiringCache(size_t _max_cost) noexcept
+		:max_cost(_max_cost) {}
+
+	~ExpiringCache() noexcept {
+		Clear();
+	}
+
+	ExpiringCache(const ExpiringCache &) = delete;
+	ExpiringCache &operator=(const ExpiringCache &) = delete;
+
+	bool IsEmpty() const noexcept {
+		return cache.IsEmpty();
+	}
+
+	/**
+	 * Returns the sum of all items' costs.
+	 */
+	size_t GetCost() const noexcept {
+		return cost;
+	}
+
+	size_t GetMaxCost() const noexcept {
+		return max_cost;
+	}
+
+	void Clear() noexcept {
+		expiry_set.clear();
+		cache.Clear();
+		cost = 0;
+	}
+
+	/**
+	 * Look up an item by its key.  Returns nullptr if no such
+	 * item exists or if it has expired; in the latter case, it is
+	 * removed.
+	 */
+	template<typename K>
+	Data *Get(K &&key, Expiry now) noexcept {
+		Entry *entry = cache.Get(std::forward<K>(key));
+		if (entry == nullptr)
+			return nullptr;
+
+		if (entry->expires.IsExpired(now)) {
+			RemoveEntry(*entry);
+			return nullptr;
+		}
+
+		return &entry->data;
+	}
+
+	/**
+	 * Insert a new item into the cache, replacing an existing
+	 * item with the same key.  Items are evicted until both the
+	 * item count and the cost fit.
+	 *
+	 * @param item_cost the cost accounted for this item
+	 * @return the new item, or nullptr if its cost exceeds the
+	 * whole budget (then it is not stored)
+	 */
+	template<typename K, typename U>
+	Data *Put(K &&key, U &&data, size_t item_cost, Expiry expires) {
+		Entry *old = cache.Get(key);
+		if (old != nullptr)
+			RemoveEntry(*old);
+
+		if (item_cost > max_cost)
+			return nullptr;
+
+		MakeRoom(item_cost);
+
+		Entry &entry = cache.Put(std::forward<K>(key),
+					 Entry(std::forward<U>(data),
+					       item_cost, expires));
+		expiry_set.insert(entry);
+		cost += item_cost;
+		return &entry.data;
+	}
+
+	/**
+	 * Remove an item from the cache using a reference to the
+	 * value.
+	 */
+	void RemoveItem(Data &data) noexcept {
+		RemoveEntry(Entry::Cast(data));
+	}
+
+	/**
+	 * Remove an item from the cache if it exists.
+	 *
+	 * @return true if the item was removed
+	 */
+	template<typename K>
+	bool Remove(K &&key) noexcept {
+		Entry *entry = cache.Get(std::forward<K>(key));
+		if (entry == nullptr)
+			return false;
+
+		RemoveEntry(*entry);
+		return true;
+	}
+
+	/**
+	 * Remove up to the given number of expired items, starting
+	 * with the ones which expired first.
+	 *
+	 * @return the number of items removed
+	 */
+	size_t Sweep(Expiry now, size_t max_items) noexcept {
+		size_t n = 0;
+		while (n < max_items && !expiry_set.empty()) {
+			Entry &entry = *expiry_set.begin();
+			if (!entry.expires.IsExpired(now))
+				break;
+
+			RemoveEntry(entry);
+			++n;
+		}
+
+		return n;
+	}
+
+	/**
+	 * Returns the expiry of the item which expires first, or
+	 * Expiry::Never() if the cache is empty.  This can be used to
+	 * schedule the next Sweep().
+	 */
+	gcc_pure
+	Expiry GetNextExpiry() const noexcept {
+		return expiry_set.empty()
+			? Expiry::Never()
+			: expiry_set.begin()->expires;
+	}
+
+	/**
+	 * Iterates over all items and remove all those which match
+	 * the given predicate.
+	 */
+	template<typename P>
+	void RemoveIf(P &&p) noexcept {
+		cache.RemoveIf([this, &p](const Key &key, const Entry &entry){
+				if (!p(key, entry.data))
+					return false;
+
+				cost -= entry.cost;
+				expiry_set.erase(expiry_set.iterator_to(entry));
+				return true;
+			});
+	}
+
+	/**
+	 * Iterates over all items (including expired ones which have
+	 * not been removed yet), passing each key/value pair to a
+	 * given function.  The cache must not be modified from within
+	 * that function.
+	 */
+	template<typename F>
+	void ForEach(F &&f) const {
+		cache.ForEach([&f](const Key &key, const Entry &entry){
+				f(key, entry.data);
+			});
+	}
+
+	/**
+	 * Like ForEach(), but pass the item's expiry as third
+	 * parameter, e.g. for #CacheSnapshotWriter.
+	 */
+	template<typename F>
+	void ForEachWithExpiry(F &&f) const {
+		cache.ForEach([&f](const Key &key, const Entry &entry){
+				f(key, entry.data, entry.expires);
+			});
+	}
+};
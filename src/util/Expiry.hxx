@@ -33,6 +33,8 @@
 #ifndef EXPIRY_HXX
 #define EXPIRY_HXX
 
+#include "time/CoarseClock.hxx"
+
 #include <chrono>
 
 /**
@@ -54,6 +56,23 @@ public:
 		return clock_type::now();
 	}
 
+	/**
+	 * Like Now(), but read the (much cheaper) coarse clock; its
+	 * value may lag behind by one kernel tick.
+	 */
+	static Expiry CoarseNow() noexcept {
+		return CoarseSteadyClock::now();
+	}
+
+	/**
+	 * Construct an instance from a time stamp which was obtained
+	 * elsewhere, e.g. from EventLoop::SteadyNow(), to avoid
+	 * reading the clock again.
+	 */
+	static constexpr Expiry FromTimePoint(value_type t) {
+		return t;
+	}
+
 	static constexpr Expiry AlreadyExpired() {
 		return value_type::min();
 	}
@@ -70,6 +89,10 @@ public:
 		return Touched(Now(), duration);
 	}
 
+	static Expiry CoarseTouched(duration_type duration) noexcept {
+		return Touched(CoarseNow(), duration);
+	}
+
 	void Touch(Expiry now, duration_type duration) {
 		value = now.value + duration;
 	}
@@ -86,6 +109,15 @@ public:
 		return IsExpired(Now());
 	}
 
+	/**
+	 * Returns the duration until this time stamp expires; it is
+	 * zero or negative if it has expired already.  Do not call
+	 * this on Never().
+	 */
+	constexpr duration_type GetRemaining(Expiry now) const {
+		return value - now.value;
+	}
+
 	constexpr bool operator==(Expiry other) const {
 		return value == other.value;
 	}
@@ -83,6 +83,18 @@ struct FNV1aAlgorithm {
 
 		return hash;
 	}
+
+	gcc_pure gcc_hot
+	static value_type BinaryHash(const void *_p, size_t size) {
+		using Algorithm = FNV1aAlgorithm<Traits>;
+
+		const auto *p = (const uint8_t *)_p;
+		fast_type hash = Traits::OFFSET_BASIS;
+		while (size-- > 0)
+			hash = Algorithm::Update(hash, *p++);
+
+		return hash;
+	}
 };
 
 gcc_pure gcc_hot
@@ -103,6 +115,24 @@ FNV1aHash64(const char *s)
 	return Algorithm::StringHash(s);
 }
 
+gcc_pure gcc_hot
+inline uint32_t
+FNV1aHash32(const void *p, size_t size)
+{
+	using Traits = FNVTraits<uint32_t>;
+	using Algorithm = FNV1aAlgorithm<Traits>;
+	return Algorithm::BinaryHash(p, size);
+}
+
+gcc_pure gcc_hot
+inline uint64_t
+FNV1aHash64(const void *p, size_t size)
+{
+	using Traits = FNVTraits<uint64_t>;
+	using Algorithm = FNV1aAlgorithm<Traits>;
+	return Algorithm::BinaryHash(p, size);
+}
+
 gcc_pure gcc_hot
 inline uint32_t
 FNV1aHashFold32(const char *s)
@@ -0,0 +1,228 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include "BranchlessSearch.hxx"
+#include "Compiler.h"
+
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/**
+ * A map implemented as a sorted array of key/value pairs; see
+ * #FlatSet for the rationale.  Insertion and removal invalidate all
+ * iterators.
+ *
+ * @param Container the underlying storage; it must provide random
+ * access iterators, push_back() and pop_back().  Pass a #StaticArray
+ * to keep the elements inline, without any heap allocation.
+ */
+template<typename K, typename V, typename Compare=std::less<K>,
+	 typename Container=std::vector<std::pair<K, V>>>
+class FlatMap {
+	Container items;
+
+	Compare compare;
+
+public:
+	typedef K key_type;
+	typedef V mapped_type;
+
+	/**
+	 * Unlike std::map, the key is not "const" because the
+	 * elements get moved around; don't modify it.
+	 */
+	typedef std::pair<K, V> value_type;
+	typedef typename Container::size_type size_type;
+	typedef typename Container::iterator iterator;
+	typedef typename Container::const_iterator const_iterator;
+
+	FlatMap() = default;
+
+	template<typename I>
+	FlatMap(I _begin, I _end) {
+		for (I i = _begin; i != _end; ++i)
+			insert(*i);
+	}
+
+	FlatMap(std::initializer_list<value_type> init)
+		:FlatMap(init.begin(), init.end()) {}
+
+	bool empty() const noexcept {
+		return items.empty();
+	}
+
+	size_type size() const noexcept {
+		return items.size();
+	}
+
+	void clear() noexcept {
+		items.clear();
+	}
+
+	iterator begin() noexcept {
+		return items.begin();
+	}
+
+	iterator end() noexcept {
+		return items.end();
+	}
+
+	const_iterator begin() const noexcept {
+		return items.begin();
+	}
+
+	const_iterator end() const noexcept {
+		return items.end();
+	}
+
+	/**
+	 * Returns the first element whose key is not less than the
+	 * given key.
+	 */
+	template<typename L>
+	gcc_pure
+	iterator lower_bound(const L &key) noexcept {
+		return BranchlessLowerBound(begin(), size(),
+					    [this, &key](const value_type &i){
+						    return compare(i.first, key);
+					    });
+	}
+
+	template<typename L>
+	gcc_pure
+	const_iterator lower_bound(const L &key) const noexcept {
+		return BranchlessLowerBound(begin(), size(),
+					    [this, &key](const value_type &i){
+						    return compare(i.first, key);
+					    });
+	}
+
+	template<typename L>
+	gcc_pure
+	iterator find(const L &key) noexcept {
+		auto i = lower_bound(key);
+		return i != end() && !compare(key, i->first)
+			? i
+			: end();
+	}
+
+	template<typename L>
+	gcc_pure
+	const_iterator find(const L &key) const noexcept {
+		auto i = lower_bound(key);
+		return i != end() && !compare(key, i->first)
+			? i
+			: end();
+	}
+
+	template<typename L>
+	gcc_pure
+	bool contains(const L &key) const noexcept {
+		return find(key) != end();
+	}
+
+	template<typename L>
+	gcc_pure
+	size_type count(const L &key) const noexcept {
+		return contains(key);
+	}
+
+	/**
+	 * Insert a new element unless one with the same key exists
+	 * already.  The value is only constructed if the key is new.
+	 *
+	 * @return an iterator to the (new or old) element and a
+	 * flag specifying whether the element was inserted
+	 */
+	template<typename L, typename... Args>
+	std::pair<iterator, bool> emplace(L &&key, Args&&... args) {
+		auto i = lower_bound(key);
+		if (i != end() && !compare(key, i->first))
+			return {i, false};
+
+		const auto position = std::distance(begin(), i);
+		items.push_back(value_type(std::piecewise_construct,
+					   std::forward_as_tuple(std::forward<L>(key)),
+					   std::forward_as_tuple(std::forward<Args>(args)...)));
+
+		i = std::next(begin(), position);
+		std::rotate(i, std::prev(end()), end());
+		return {i, true};
+	}
+
+	std::pair<iterator, bool> insert(const value_type &value) {
+		return emplace(value.first, value.second);
+	}
+
+	std::pair<iterator, bool> insert(value_type &&value) {
+		return emplace(std::move(value.first), std::move(value.second));
+	}
+
+	/**
+	 * Look up the value for the given key, and insert a
+	 * default-constructed one if it does not exist yet.
+	 */
+	template<typename L>
+	V &operator[](L &&key) {
+		return emplace(std::forward<L>(key)).first->second;
+	}
+
+	/**
+	 * Remove the given element.
+	 *
+	 * @return an iterator to the element following the removed
+	 * one
+	 */
+	iterator erase(iterator i) {
+		std::move(std::next(i), end(), i);
+		items.pop_back();
+		return i;
+	}
+
+	/**
+	 * @return the number of elements removed (0 or 1)
+	 */
+	template<typename L>
+	size_type erase(const L &key) {
+		auto i = find(key);
+		if (i == end())
+			return 0;
+
+		erase(i);
+		return 1;
+	}
+};
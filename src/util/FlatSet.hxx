@@ -0,0 +1,187 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include "BranchlessSearch.hxx"
+#include "Compiler.h"
+
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+/**
+ * A set implemented as a sorted array.  Lookups are a branchless
+ * binary search over contiguous memory, which beats node-based
+ * containers such as std::set for small sets that are searched more
+ * often than they are modified.  Insertion and removal are O(n),
+ * and they invalidate all iterators.
+ *
+ * @param Container the underlying storage; it must provide random
+ * access iterators, push_back() and pop_back().  Pass a #StaticArray
+ * to keep the elements inline, without any heap allocation.
+ */
+template<typename T, typename Compare=std::less<T>,
+	 typename Container=std::vector<T>>
+class FlatSet {
+	Container items;
+
+	Compare compare;
+
+public:
+	typedef T key_type;
+	typedef T value_type;
+	typedef typename Container::size_type size_type;
+
+	/* elements must not be modified, because that could break
+	   the order */
+	typedef typename Container::const_iterator iterator;
+	typedef typename Container::const_iterator const_iterator;
+
+	FlatSet() = default;
+
+	template<typename I>
+	FlatSet(I _begin, I _end) {
+		for (I i = _begin; i != _end; ++i)
+			insert(*i);
+	}
+
+	FlatSet(std::initializer_list<T> init)
+		:FlatSet(init.begin(), init.end()) {}
+
+	bool empty() const noexcept {
+		return items.empty();
+	}
+
+	size_type size() const noexcept {
+		return items.size();
+	}
+
+	void clear() noexcept {
+		items.clear();
+	}
+
+	const_iterator begin() const noexcept {
+		return items.begin();
+	}
+
+	const_iterator end() const noexcept {
+		return items.end();
+	}
+
+	/**
+	 * Returns the first element which is not less than the given
+	 * key.
+	 */
+	template<typename K>
+	gcc_pure
+	const_iterator lower_bound(const K &key) const noexcept {
+		return BranchlessLowerBound(begin(), size(),
+					    [this, &key](const T &i){
+						    return compare(i, key);
+					    });
+	}
+
+	template<typename K>
+	gcc_pure
+	const_iterator find(const K &key) const noexcept {
+		auto i = lower_bound(key);
+		return i != end() && !compare(key, *i)
+			? i
+			: end();
+	}
+
+	template<typename K>
+	gcc_pure
+	bool contains(const K &key) const noexcept {
+		return find(key) != end();
+	}
+
+	template<typename K>
+	gcc_pure
+	size_type count(const K &key) const noexcept {
+		return contains(key);
+	}
+
+	/**
+	 * Insert a new element unless an equal one exists already.
+	 *
+	 * @return an iterator to the (new or old) element and a
+	 * flag specifying whether the element was inserted
+	 */
+	template<typename U>
+	std::pair<const_iterator, bool> insert(U &&value) {
+		auto i = lower_bound(value);
+		if (i != end() && !compare(value, *i))
+			return {i, false};
+
+		const auto position = std::distance(begin(), i);
+		items.push_back(std::forward<U>(value));
+
+		auto p = std::next(items.begin(), position);
+		std::rotate(p, std::prev(items.end()), items.end());
+		return {std::next(begin(), position), true};
+	}
+
+	template<typename... Args>
+	std::pair<const_iterator, bool> emplace(Args&&... args) {
+		return insert(T(std::forward<Args>(args)...));
+	}
+
+	/**
+	 * Remove the given element.
+	 *
+	 * @return an iterator to the element following the removed
+	 * one
+	 */
+	const_iterator erase(const_iterator i) {
+		const auto position = std::distance(begin(), i);
+		auto p = std::next(items.begin(), position);
+		std::move(std::next(p), items.end(), p);
+		items.pop_back();
+		return std::next(begin(), position);
+	}
+
+	/**
+	 * @return the number of elements removed (0 or 1)
+	 */
+	template<typename K>
+	size_type erase(const K &key) {
+		auto i = find(key);
+		if (i == end())
+			return 0;
+
+		erase(i);
+		return 1;
+	}
+};
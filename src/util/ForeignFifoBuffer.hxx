@@ -155,6 +155,23 @@ public:
 		return Range(data + tail, capacity - tail);
 	}
 
+	/**
+	 * Like Write(), but make all free space contiguous if the
+	 * free space before the head is larger than the free space
+	 * after the tail, and shifting is cheap (i.e. the data to be
+	 * moved is not larger than the space gained).  This allows
+	 * refilling a partially consumed buffer with one read
+	 * instead of two.
+	 */
+	Range WriteCompact() {
+		if (IsEmpty())
+			Clear();
+		else if (head > capacity - tail && GetAvailable() <= head)
+			Shift();
+
+		return Write();
+	}
+
 	bool WantWrite(size_type n) {
 		if (tail + n <= capacity)
 			/* enough space after the tail */
@@ -35,8 +35,11 @@
 
 #include "util/Compiler.h"
 
+#include <algorithm>
 #include <array>
+#include <utility>
 
+#include <assert.h>
 #include <stddef.h>
 
 class AllocatorPtr;
@@ -50,6 +53,7 @@ class AllocatorPtr;
  * @param N_REPLICAS the number of replicas in the ring for each node
  *
  * @see https://en.wikipedia.org/wiki/Consistent_hashing
+ * @see MaglevTable, JumpHash
  */
 template<typename Node, typename hash_t,
 	 size_t N_BUCKETS, size_t N_REPLICAS>
@@ -68,13 +72,31 @@ public:
 	 */
 	template<typename C, typename H>
 	void Build(C &&nodes, H &&hasher) {
+		Build(std::forward<C>(nodes), std::forward<H>(hasher),
+		      [](const Node &){ return 1u; });
+	}
+
+	/**
+	 * Build the hash ring with weighted nodes.  Each node gets
+	 * N_REPLICAS times its weight replicas, i.e. a node with
+	 * twice the weight receives roughly twice the share of hash
+	 * values.  Nodes with weight 0 are omitted, but at least one
+	 * node must have a non-zero weight.
+	 *
+	 * @param weigher a functor object which returns the
+	 * (unsigned) weight of a node
+	 */
+	template<typename C, typename H, typename W>
+	void Build(C &&nodes, H &&hasher, W &&weigher) {
 		/* clear all buckets */
 		std::fill(buckets.begin(), buckets.end(), nullptr);
 
 		/* inject nodes (and their replicas) at certain buckets */
-		for (auto &node : nodes)
-			for (size_t replica = 0; replica < N_REPLICAS; ++replica)
+		for (auto &node : nodes) {
+			const size_t n_replicas = N_REPLICAS * weigher(node);
+			for (size_t replica = 0; replica < n_replicas; ++replica)
 				buckets[hasher(node, replica) % N_BUCKETS] = &node;
+		}
 
 		/* fill follow-up buckets */
 		Node *node = nullptr;
@@ -87,6 +109,9 @@ public:
 				i = node;
 		}
 
+		/* at least one node must have been injected */
+		assert(node != nullptr);
+
 		/* handle roll-over */
 		for (auto &i : buckets) {
 			if (i != nullptr)
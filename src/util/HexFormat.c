@@ -32,4 +32,98 @@
 
 #include "HexFormat.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 const char hex_digits[0x10] = "0123456789abcdef";
+
+#ifdef __SSE2__
+
+/**
+ * Convert 16 nibbles (one per byte) to hex digits.
+ */
+static inline __m128i
+nibbles_to_hex(__m128i n)
+{
+	/* '0'+n, plus 'a'-'0'-10 for n > 9 */
+	const __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(n, _mm_set1_epi8(9)),
+					     _mm_set1_epi8('a' - '0' - 10));
+	return _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')), letter);
+}
+
+#endif
+
+char *
+format_hex(char *dest, const void *_src, size_t size)
+{
+	const uint8_t *src = (const uint8_t *)_src;
+
+#ifdef __SSE2__
+	const __m128i mask = _mm_set1_epi8(0xf);
+	for (; size >= 16; src += 16, size -= 16, dest += 32) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)src);
+		const __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+		const __m128i lo = _mm_and_si128(v, mask);
+
+		/* interleave so the high nibble comes first */
+		_mm_storeu_si128((__m128i *)dest,
+				 nibbles_to_hex(_mm_unpacklo_epi8(hi, lo)));
+		_mm_storeu_si128((__m128i *)(dest + 16),
+				 nibbles_to_hex(_mm_unpackhi_epi8(hi, lo)));
+	}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	const uint8x16_t table = vld1q_u8((const uint8_t *)hex_digits);
+	const uint8x16_t mask = vdupq_n_u8(0xf);
+	for (; size >= 16; src += 16, size -= 16, dest += 32) {
+		const uint8x16_t v = vld1q_u8(src);
+		const uint8x16_t hi = vqtbl1q_u8(table, vshrq_n_u8(v, 4));
+		const uint8x16_t lo = vqtbl1q_u8(table, vandq_u8(v, mask));
+		vst1q_u8((uint8_t *)dest, vzip1q_u8(hi, lo));
+		vst1q_u8((uint8_t *)dest + 16, vzip2q_u8(hi, lo));
+	}
+#endif
+
+	for (; size > 0; ++src, --size, dest += 2)
+		format_uint8_hex_fixed(dest, *src);
+
+	return dest;
+}
+
+/**
+ * @return the value of the hex digit or -1
+ */
+static inline int
+parse_hex_digit(char ch)
+{
+	if (ch >= '0' && ch <= '9')
+		return ch - '0';
+
+	/* fold to lower case */
+	ch |= 0x20;
+	if (ch >= 'a' && ch <= 'f')
+		return ch - 'a' + 10;
+
+	return -1;
+}
+
+bool
+parse_hex(void *_dest, const char *src, size_t length)
+{
+	if (length % 2 != 0)
+		return false;
+
+	uint8_t *dest = (uint8_t *)_dest;
+	for (; length > 0; src += 2, length -= 2) {
+		const int hi = parse_hex_digit(src[0]);
+		const int lo = parse_hex_digit(src[1]);
+		if ((hi | lo) < 0)
+			return false;
+
+		*dest++ = (uint8_t)((hi << 4) | lo);
+	}
+
+	return true;
+}
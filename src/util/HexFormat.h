@@ -35,11 +35,43 @@
 
 #include "Compiler.h"
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 extern const char hex_digits[0x10];
 
+/**
+ * Format a buffer as a lower-case hex string.  No null terminator
+ * is written.
+ *
+ * @param dest the destination buffer; it must have room for
+ * `2 * size` characters
+ * @return a pointer to the end of the hex string
+ */
+char *
+format_hex(char *dest, const void *src, size_t size);
+
+/**
+ * Parse a hex string (upper or lower case) into a buffer.
+ *
+ * @param dest the destination buffer; it must have room for
+ * `length / 2` bytes
+ * @return false if the string has an odd length or contains a
+ * non-hex character (the destination buffer is undefined then)
+ */
+bool
+parse_hex(void *dest, const char *src, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
 static gcc_always_inline void
 format_uint8_hex_fixed(char dest[2], uint8_t number) {
 	dest[0] = hex_digits[(number >> 4) & 0xf];
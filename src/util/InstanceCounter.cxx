@@ -0,0 +1,63 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "InstanceCounter.hxx"
+
+#include <cxxabi.h>
+#include <stdlib.h>
+
+std::atomic<bool> InstanceCounter::enabled{false};
+std::atomic<InstanceCounter *> InstanceCounter::head{nullptr};
+
+InstanceCounter::InstanceCounter(const std::type_info &_type) noexcept
+	:type(_type)
+{
+	/* prepend to the global list; "next" is initialized before
+	   the release store publishes this object */
+	next = head.load(std::memory_order_relaxed);
+	while (!head.compare_exchange_weak(next, this,
+					   std::memory_order_release,
+					   std::memory_order_relaxed)) {}
+}
+
+std::string
+InstanceCounter::GetName() const
+{
+	int status;
+	char *demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr,
+					      &status);
+	if (demangled == nullptr)
+		return type.name();
+
+	std::string result(demangled);
+	free(demangled);
+	return result;
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <typeinfo>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Counts the live instances of one type.  Unlike #LeakDetector,
+ * this is cheap enough for production builds: each construction and
+ * destruction is just a few relaxed atomic operations, and no
+ * instance list is maintained.
+ *
+ * Counting is disabled by default and can be switched on at runtime
+ * with Enable().  Objects constructed while counting was disabled
+ * are never counted, not even after it is enabled.
+ *
+ * Do not use this class directly; derive from #CountedInstance
+ * instead.
+ */
+class InstanceCounter {
+	const std::type_info &type;
+
+	/**
+	 * The next counter in the global list of all counters.
+	 * Counters are only ever added to this list, never removed.
+	 */
+	InstanceCounter *next;
+
+	std::atomic<size_t> live{0}, peak{0};
+	std::atomic<uint64_t> total{0};
+
+	static std::atomic<bool> enabled;
+	static std::atomic<InstanceCounter *> head;
+
+public:
+	explicit InstanceCounter(const std::type_info &_type) noexcept;
+
+	InstanceCounter(const InstanceCounter &) = delete;
+	InstanceCounter &operator=(const InstanceCounter &) = delete;
+
+	static void Enable(bool value=true) noexcept {
+		enabled.store(value, std::memory_order_relaxed);
+	}
+
+	static bool IsEnabled() noexcept {
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Invoke a function for each counter.  The list contains
+	 * only types which have had at least one instance constructed
+	 * while counting was enabled.
+	 */
+	template<typename F>
+	static void ForEach(F &&f) {
+		for (const auto *i = head.load(std::memory_order_acquire);
+		     i != nullptr; i = i->next)
+			f(*i);
+	}
+
+	/**
+	 * Returns the demangled name of the counted type.
+	 */
+	std::string GetName() const;
+
+	/**
+	 * The number of instances currently alive.
+	 */
+	size_t GetLive() const noexcept {
+		return live.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * The highest value of GetLive() since the counter was created
+	 * or since the last ResetPeak() call.
+	 */
+	size_t GetPeak() const noexcept {
+		return peak.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * The number of instances ever constructed.
+	 */
+	uint64_t GetTotal() const noexcept {
+		return total.load(std::memory_order_relaxed);
+	}
+
+	void ResetPeak() noexcept {
+		peak.store(GetLive(), std::memory_order_relaxed);
+	}
+
+	void Add() noexcept {
+		const size_t n = live.fetch_add(1, std::memory_order_relaxed) + 1;
+		total.fetch_add(1, std::memory_order_relaxed);
+
+		size_t old_peak = peak.load(std::memory_order_relaxed);
+		while (n > old_peak &&
+		       !peak.compare_exchange_weak(old_peak, n,
+						   std::memory_order_relaxed)) {}
+	}
+
+	void Remove() noexcept {
+		live.fetch_sub(1, std::memory_order_relaxed);
+	}
+};
+
+/**
+ * Derive from this class (passing the derived class as template
+ * argument) to count its instances with an #InstanceCounter.
+ */
+template<typename T>
+class CountedInstance {
+	/**
+	 * Was counting enabled when this object was constructed?
+	 * This is remembered so the destructor doesn't decrement a
+	 * counter which was never incremented.
+	 */
+	const bool counted;
+
+protected:
+	CountedInstance() noexcept
+		:counted(InstanceCounter::IsEnabled()) {
+		if (counted)
+			GetInstanceCounter().Add();
+	}
+
+	CountedInstance(const CountedInstance &) noexcept
+		:CountedInstance() {}
+
+	~CountedInstance() noexcept {
+		if (counted)
+			GetInstanceCounter().Remove();
+	}
+
+	CountedInstance &operator=(const CountedInstance &) noexcept {
+		return *this;
+	}
+
+public:
+	static InstanceCounter &GetInstanceCounter() noexcept {
+		static InstanceCounter counter(typeid(T));
+		return counter;
+	}
+};
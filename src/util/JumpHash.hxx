@@ -0,0 +1,167 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include "util/Compiler.h"
+
+#include <utility>
+#include <vector>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Jump consistent hash: map a 64 bit key to one of the given number
+ * of buckets.  When the number of buckets grows by one, only 1/n of
+ * all keys move (all to the new bucket).  It needs no memory and no
+ * precomputation.
+ *
+ * @see https://arxiv.org/abs/1406.2294
+ */
+gcc_const
+static inline uint32_t
+JumpConsistentHash(uint64_t key, uint32_t n_buckets) noexcept
+{
+	assert(n_buckets > 0);
+
+	int64_t b = -1, j = 0;
+	while (j < int64_t(n_buckets)) {
+		b = j;
+		key = key * 2862933555777941757ULL + 1;
+		j = int64_t((b + 1) * (double(int64_t(1) << 31) /
+				       double((key >> 33) + 1)));
+	}
+
+	return uint32_t(b);
+}
+
+/**
+ * Node selection with JumpConsistentHash(), with the same
+ * Build()/Pick()/FindNext() API as #HashRing.  Unlike #HashRing and
+ * #MaglevTable, memory usage depends only on the number of nodes,
+ * and no hashes of the nodes are needed.  The downside is that
+ * minimal disruption applies only when nodes are appended to (or
+ * removed from) the end of the container; removing a node from the
+ * middle moves the keys of all nodes after it.
+ *
+ * @param Node the node type
+ * @param hash_t the type of a hash value
+ */
+template<typename Node, typename hash_t>
+class JumpHash {
+	std::vector<Node *> nodes;
+
+	/**
+	 * Generate another key from the given one, for FindNext().
+	 */
+	gcc_const
+	static hash_t Rehash(hash_t h) noexcept {
+		return hash_t(uint64_t(h) * 0x9e3779b97f4a7c15ULL + 1);
+	}
+
+	/**
+	 * The maximum number of Rehash() attempts in FindNext().
+	 */
+	static constexpr unsigned MAX_REHASH = 32;
+
+public:
+	/**
+	 * Build the node list from the given container.
+	 *
+	 * @param _nodes a non-empty iterable container which contains
+	 * nodes; pointers to those nodes will be stored in this object
+	 * (i.e. they must be valid as long as this object is used)
+	 */
+	template<typename C>
+	void Build(C &&_nodes) {
+		Build(std::forward<C>(_nodes), [](const Node &){ return 1u; });
+	}
+
+	/**
+	 * Build the node list with weighted nodes: each node is
+	 * inserted as many times as its weight.  Changing a node's
+	 * weight moves the keys of all nodes after it, so weights
+	 * should be rarely changed, and new nodes appended at the
+	 * end.
+	 *
+	 * @param weigher a functor object which returns the
+	 * (unsigned) weight of a node
+	 */
+	template<typename C, typename W>
+	void Build(C &&_nodes, W &&weigher) {
+		nodes.clear();
+
+		for (auto &node : _nodes) {
+			const unsigned weight = weigher(node);
+			for (unsigned i = 0; i < weight; ++i)
+				nodes.push_back(&node);
+		}
+
+		assert(!nodes.empty());
+	}
+
+	/**
+	 * Pick a node using the given hash.
+	 *
+	 * Before calling this, Build() must have been called.
+	 */
+	gcc_pure
+	Node &Pick(hash_t h) const {
+		return *nodes[JumpConsistentHash(uint64_t(h), nodes.size())];
+	}
+
+	/**
+	 * Find another node than the one picked for the given hash.
+	 * This is useful for skipping known-bad nodes and turning to
+	 * a failover node.
+	 *
+	 * @return a new hash (for another FindNext() call) and a node
+	 * reference (may be equal to the previous node if there is only
+	 * one node)
+	 */
+	gcc_pure
+	std::pair<hash_t, Node &> FindNext(hash_t h) const {
+		auto &node = Pick(h);
+
+		for (unsigned i = 0; i < MAX_REHASH; ++i) {
+			h = Rehash(h);
+			auto &n = Pick(h);
+			if (&n != &node)
+				return {h, n};
+		}
+
+		/* all attempts ended up at the same (heavily weighted)
+		   node, or there is only one node */
+		return {h, node};
+	}
+};
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "LargeAllocation.hxx"
+
+#include <new>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#endif
+
+static constexpr size_t
+AlignUp(size_t size, size_t alignment) noexcept
+{
+	return (size + alignment - 1) & ~(alignment - 1);
+}
+
+static size_t
+GetPageSize() noexcept
+{
+	static const size_t page_size = sysconf(_SC_PAGESIZE);
+	return page_size;
+}
+
+static void *
+MapAnonymous(size_t size, int flags=0) noexcept
+{
+	void *p = mmap(nullptr, size, PROT_READ|PROT_WRITE,
+		       MAP_PRIVATE|MAP_ANONYMOUS|flags, -1, 0);
+	return p != MAP_FAILED ? p : nullptr;
+}
+
+/**
+ * Map huge-page-aligned memory by over-allocating and unmapping the
+ * excess at both ends.
+ */
+static void *
+MapHugeAligned(size_t size) noexcept
+{
+	void *p = MapAnonymous(size + HUGE_PAGE_SIZE);
+	if (p == nullptr)
+		return nullptr;
+
+	const uintptr_t start = (uintptr_t)p;
+	const uintptr_t aligned = AlignUp(start, HUGE_PAGE_SIZE);
+	if (aligned > start)
+		munmap(p, aligned - start);
+	munmap((void *)(aligned + size), start + HUGE_PAGE_SIZE - aligned);
+
+#ifdef MADV_HUGEPAGE
+	madvise((void *)aligned, size, MADV_HUGEPAGE);
+#endif
+
+	return (void *)aligned;
+}
+
+#if defined(__linux__) && defined(__NR_mbind) && defined(__NR_getcpu)
+
+/**
+ * Set the NUMA policy of a fresh mapping to "preferred: the node of
+ * the calling thread".  Errors are ignored; they just mean that the
+ * kernel's default (first touch) policy remains in effect, e.g. on a
+ * kernel without NUMA support.
+ */
+static void
+BindToLocalNode(void *p, size_t size) noexcept
+{
+	unsigned cpu, node;
+	if (syscall(__NR_getcpu, &cpu, &node, nullptr) < 0)
+		return;
+
+	constexpr unsigned BITS = sizeof(unsigned long) * 8;
+	unsigned long mask[4] = {};
+	if (node >= sizeof(mask) * 8)
+		return;
+
+	mask[node / BITS] = 1UL << (node % BITS);
+	syscall(__NR_mbind, p, size, MPOL_PREFERRED, mask,
+		sizeof(mask) * 8, 0);
+}
+
+#else
+
+static void
+BindToLocalNode(void *, size_t) noexcept
+{
+}
+
+#endif
+
+void *
+AllocateLarge(size_t &size, LargeAllocationOptions options)
+{
+	using HugePages = LargeAllocationOptions::HugePages;
+
+	void *p = nullptr;
+
+	if (options.huge_pages != HugePages::NONE && size >= HUGE_PAGE_SIZE) {
+		const size_t huge_size = AlignUp(size, HUGE_PAGE_SIZE);
+
+#ifdef MAP_HUGETLB
+		if (options.huge_pages == HugePages::EXPLICIT)
+			p = MapAnonymous(huge_size, MAP_HUGETLB);
+#endif
+
+		if (p == nullptr)
+			p = MapHugeAligned(huge_size);
+
+		if (p != nullptr)
+			size = huge_size;
+	} else {
+		size = AlignUp(size, GetPageSize());
+		p = MapAnonymous(size);
+	}
+
+	if (p == nullptr)
+		throw std::bad_alloc();
+
+	if (options.numa_local)
+		BindToLocalNode(p, size);
+
+	return p;
+}
+
+void
+FreeLarge(void *p, size_t size) noexcept
+{
+	munmap(p, size);
+}
+
+void
+DiscardLarge(void *p, size_t size) noexcept
+{
+	madvise(p, size, MADV_DONTNEED);
+}
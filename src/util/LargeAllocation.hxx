@@ -0,0 +1,165 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <utility>
+
+#include <stddef.h>
+
+/**
+ * The (transparent) huge page size on x86-64 and on AArch64 with 4 kB
+ * base pages.
+ */
+static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/**
+ * Options for AllocateLarge().
+ */
+struct LargeAllocationOptions {
+	enum class HugePages {
+		/**
+		 * Use regular pages only.
+		 */
+		NONE,
+
+		/**
+		 * Align the allocation to huge pages and ask the
+		 * kernel to back it with transparent huge pages
+		 * (MADV_HUGEPAGE).
+		 */
+		TRANSPARENT,
+
+		/**
+		 * Try to allocate from the preallocated hugetlb pool
+		 * (MAP_HUGETLB); if that pool is exhausted or not
+		 * configured, fall back to #TRANSPARENT.
+		 */
+		EXPLICIT,
+	};
+
+	/**
+	 * Huge pages are only used for allocations of at least
+	 * #HUGE_PAGE_SIZE bytes; smaller ones ignore this setting.
+	 */
+	HugePages huge_pages = HugePages::TRANSPARENT;
+
+	/**
+	 * Prefer memory on the NUMA node of the calling thread, even
+	 * if the pages are first touched by another thread.  Call
+	 * AllocateLarge() from the thread which will use the memory
+	 * (e.g. the #EventLoop thread).
+	 */
+	bool numa_local = false;
+};
+
+/**
+ * Allocate a large block of anonymous memory directly from the
+ * kernel.  It is page-aligned (or huge-page-aligned) and
+ * zero-filled.
+ *
+ * Throws std::bad_alloc on error.
+ *
+ * @param size the requested size; it is rounded up to the
+ * granularity of the chosen page type, and the caller may use the
+ * rounded size; it must be passed to FreeLarge()
+ */
+void *
+AllocateLarge(size_t &size, LargeAllocationOptions options={});
+
+/**
+ * Free memory allocated by AllocateLarge().
+ *
+ * @param size the (rounded) size returned by AllocateLarge()
+ */
+void
+FreeLarge(void *p, size_t size) noexcept;
+
+/**
+ * Give the physical memory of a range back to the kernel; the range
+ * remains mapped and reads as zeroes afterwards.
+ */
+void
+DiscardLarge(void *p, size_t size) noexcept;
+
+/**
+ * An owning wrapper for AllocateLarge().
+ */
+class LargeAllocation {
+	void *data = nullptr;
+	size_t the_size = 0;
+
+public:
+	LargeAllocation() = default;
+
+	/**
+	 * Throws std::bad_alloc on error.
+	 */
+	explicit LargeAllocation(size_t _size,
+				 LargeAllocationOptions options={})
+		:data(AllocateLarge(_size, options)), the_size(_size) {}
+
+	LargeAllocation(LargeAllocation &&src) noexcept
+		:data(src.data), the_size(src.the_size) {
+		src.data = nullptr;
+		src.the_size = 0;
+	}
+
+	~LargeAllocation() noexcept {
+		if (data != nullptr)
+			FreeLarge(data, the_size);
+	}
+
+	LargeAllocation &operator=(LargeAllocation &&src) noexcept {
+		std::swap(data, src.data);
+		std::swap(the_size, src.the_size);
+		return *this;
+	}
+
+	bool IsDefined() const noexcept {
+		return data != nullptr;
+	}
+
+	void *get() const noexcept {
+		return data;
+	}
+
+	/**
+	 * The (rounded) size of the allocation.
+	 */
+	size_t size() const noexcept {
+		return the_size;
+	}
+
+	void Discard() noexcept {
+		DiscardLarge(data, the_size);
+	}
+};
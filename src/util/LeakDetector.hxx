@@ -37,6 +37,9 @@
 /**
  * Derive from this class to verify that its destructor gets called
  * before the process exits.
+ *
+ * This is only enabled in debug builds; see #CountedInstance for a
+ * cheaper alternative which can be used in production.
  */
 class LeakDetector : public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
 	enum class State {
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+
+#include <stdint.h>
+
+/**
+ * A histogram of durations with power-of-two buckets.  Bucket 0
+ * counts durations below one microsecond, bucket i counts durations
+ * in the range [2^(i-1), 2^i) microseconds, and the last bucket
+ * counts everything beyond that.
+ *
+ * This class is not thread-safe.
+ */
+class Log2Histogram {
+public:
+	static constexpr unsigned N_BUCKETS = 32;
+
+	typedef std::chrono::steady_clock::duration Duration;
+
+private:
+	std::array<uint64_t, N_BUCKETS> buckets;
+
+	uint64_t count, sum_us;
+
+public:
+	Log2Histogram() noexcept {
+		Clear();
+	}
+
+	void Clear() noexcept {
+		buckets.fill(0);
+		count = sum_us = 0;
+	}
+
+	void Add(Duration d) noexcept {
+		const uint64_t us = d > d.zero()
+			? std::chrono::duration_cast<std::chrono::microseconds>(d).count()
+			: 0;
+
+		++buckets[BucketIndex(us)];
+		++count;
+		sum_us += us;
+	}
+
+	uint64_t GetCount() const noexcept {
+		return count;
+	}
+
+	/**
+	 * Returns the sum of all durations in microseconds.
+	 */
+	uint64_t GetSumMicroseconds() const noexcept {
+		return sum_us;
+	}
+
+	uint64_t operator[](unsigned i) const noexcept {
+		return buckets[i];
+	}
+
+	/**
+	 * Returns the (exclusive) upper bound of the given bucket in
+	 * microseconds.  The last bucket is unbounded, and this
+	 * method returns 0 for it.
+	 */
+	static constexpr uint64_t GetBucketLimit(unsigned i) noexcept {
+		return i + 1 < N_BUCKETS
+			? uint64_t(1) << i
+			: 0;
+	}
+
+	/**
+	 * Returns the index of the bucket for the given duration in
+	 * microseconds.
+	 */
+	static constexpr unsigned BucketIndex(uint64_t us) noexcept {
+		if (us == 0)
+			return 0;
+
+		const unsigned i = 64 - __builtin_clzll(us);
+		return i < N_BUCKETS ? i : N_BUCKETS - 1;
+	}
+};
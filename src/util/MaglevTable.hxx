@@ -0,0 +1,178 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include "util/Compiler.h"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+#include <vector>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Maglev consistent hashing: a lookup table where each node owns a
+ * nearly equal (or weighted) share of the entries, with O(1)
+ * lookups.  When a node is added or removed, only few entries of the
+ * other nodes change.  It is a drop-in alternative to #HashRing with
+ * the same Build()/Pick()/FindNext() API, and gives a much more even
+ * distribution than a ring with few replicas.
+ *
+ * @param Node the node type
+ * @param hash_t the type of a hash value
+ * @param TABLE_SIZE the number of table entries; must be a prime
+ * number, and should be much larger than the number of nodes
+ *
+ * @see https://research.google/pubs/pub44824/
+ */
+template<typename Node, typename hash_t, size_t TABLE_SIZE>
+class MaglevTable {
+	static_assert(TABLE_SIZE > 1, "Table too small");
+
+	std::array<Node *, TABLE_SIZE> table;
+
+public:
+	/**
+	 * Build the lookup table using nodes from the given container.
+	 *
+	 * @param nodes a non-empty iterable container which contains
+	 * nodes; pointers to those nodes will be stored in this object
+	 * (i.e. they must be valid as long as this object is used)
+	 * @param hasher a functor object which generates a secure hash
+	 * of a node and a number; it is called with the numbers 0 and 1,
+	 * and the two results should be independent (the same functor
+	 * as for #HashRing can be used)
+	 */
+	template<typename C, typename H>
+	void Build(C &&nodes, H &&hasher) {
+		Build(std::forward<C>(nodes), std::forward<H>(hasher),
+		      [](const Node &){ return 1u; });
+	}
+
+	/**
+	 * Build the lookup table with weighted nodes: each node
+	 * receives a share of the table entries proportional to its
+	 * weight.  Nodes with weight 0 are omitted, but at least one
+	 * node must have a non-zero weight.
+	 *
+	 * @param weigher a functor object which returns the
+	 * (unsigned) weight of a node
+	 */
+	template<typename C, typename H, typename W>
+	void Build(C &&nodes, H &&hasher, W &&weigher) {
+		/**
+		 * The state of one node's permutation of the table.
+		 */
+		struct Permutation {
+			Node *node;
+			unsigned weight;
+			size_t position, skip;
+		};
+
+		std::vector<Permutation> permutations;
+		unsigned max_weight = 0;
+
+		for (auto &node : nodes) {
+			const unsigned weight = weigher(node);
+			if (weight == 0)
+				continue;
+
+			max_weight = std::max(max_weight, weight);
+			permutations.push_back({
+					&node, weight,
+					size_t(hasher(node, 0) % TABLE_SIZE),
+					size_t(hasher(node, 1) % (TABLE_SIZE - 1) + 1),
+				});
+		}
+
+		assert(!permutations.empty());
+
+		std::fill(table.begin(), table.end(), nullptr);
+
+		/* in each round, each node claims the next free entry in
+		   its permutation; a node with less than the maximum
+		   weight skips some rounds */
+		size_t n_filled = 0;
+		for (uint64_t round = 1;; ++round) {
+			for (auto &p : permutations) {
+				if (round * p.weight / max_weight ==
+				    (round - 1) * p.weight / max_weight)
+					continue;
+
+				/* since TABLE_SIZE is prime, the
+				   permutation visits every entry, so
+				   this finds a free one */
+				while (table[p.position] != nullptr)
+					p.position = (p.position + p.skip) % TABLE_SIZE;
+
+				table[p.position] = p.node;
+
+				if (++n_filled == TABLE_SIZE)
+					return;
+			}
+		}
+	}
+
+	/**
+	 * Pick a node using the given hash.
+	 *
+	 * Before calling this, Build() must have been called.
+	 */
+	gcc_pure
+	Node &Pick(hash_t h) const {
+		return *table[h % TABLE_SIZE];
+	}
+
+	/**
+	 * Find the next node after the given one.  This is useful for
+	 * skipping known-bad nodes and turning to a failover node.
+	 * Since the table entries are spread pseudo-randomly, the
+	 * failover load of a node is spread over all other nodes.
+	 *
+	 * @return a new hash (for another FindNext() call) and a node
+	 * reference (may be equal to the previous node if there is only
+	 * one node)
+	 */
+	gcc_pure
+	std::pair<hash_t, Node &> FindNext(hash_t h) const {
+		auto &node = Pick(h++);
+
+		for (size_t i = TABLE_SIZE - 1;; --i, ++h) {
+			auto &n = Pick(h);
+			if (i == 0 || &n != &node)
+				return {h, n};
+		}
+	}
+};
@@ -0,0 +1,374 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Metrics.hxx"
+
+#include <new>
+#include <stdexcept>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void
+PrometheusWriter::WriteHeader(const char *name, const char *help,
+			      const char *type)
+{
+	out.append("# HELP ").append(name).push_back(' ');
+
+	/* escape backslash and line feed */
+	for (const char *p = help; *p != 0; ++p) {
+		if (*p == '\\')
+			out.append("\\\\");
+		else if (*p == '\n')
+			out.append("\\n");
+		else
+			out.push_back(*p);
+	}
+
+	out.append("\n# TYPE ").append(name).push_back(' ');
+	out.append(type).push_back('\n');
+}
+
+void
+PrometheusWriter::WriteName(const char *name, const char *suffix,
+			    const char *labels, const char *extra_label)
+{
+	out.append(name).append(suffix);
+
+	const bool have_labels = labels != nullptr && *labels != 0;
+	if (have_labels || extra_label != nullptr) {
+		out.push_back('{');
+		if (have_labels)
+			out.append(labels);
+		if (extra_label != nullptr) {
+			if (have_labels)
+				out.push_back(',');
+			out.append(extra_label);
+		}
+		out.push_back('}');
+	}
+
+	out.push_back(' ');
+}
+
+void
+PrometheusWriter::WriteSample(const char *name, const char *labels,
+			      uint64_t value)
+{
+	WriteName(name, "", labels, nullptr);
+
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%llu\n", (unsigned long long)value);
+	out.append(buffer);
+}
+
+void
+PrometheusWriter::WriteSample(const char *name, const char *labels,
+			      double value)
+{
+	WriteName(name, "", labels, nullptr);
+
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.15g\n", value);
+	out.append(buffer);
+}
+
+void
+PrometheusWriter::WriteHistogram(const char *name, const char *labels,
+				 const uint64_t *buckets,
+				 uint64_t count, uint64_t sum_us)
+{
+	char buffer[64];
+	uint64_t cumulative = 0;
+
+	for (unsigned i = 0; i < Log2Histogram::N_BUCKETS - 1; ++i) {
+		cumulative += buckets[i];
+
+		snprintf(buffer, sizeof(buffer), "le=\"%g\"",
+			 Log2Histogram::GetBucketLimit(i) / 1e6);
+		WriteName(name, "_bucket", labels, buffer);
+
+		snprintf(buffer, sizeof(buffer), "%llu\n",
+			 (unsigned long long)cumulative);
+		out.append(buffer);
+	}
+
+	WriteName(name, "_bucket", labels, "le=\"+Inf\"");
+	snprintf(buffer, sizeof(buffer), "%llu\n", (unsigned long long)count);
+	out.append(buffer);
+
+	WriteName(name, "_sum", labels, nullptr);
+	snprintf(buffer, sizeof(buffer), "%llu.%06llu\n",
+		 (unsigned long long)(sum_us / 1000000),
+		 (unsigned long long)(sum_us % 1000000));
+	out.append(buffer);
+
+	WriteName(name, "_count", labels, nullptr);
+	snprintf(buffer, sizeof(buffer), "%llu\n", (unsigned long long)count);
+	out.append(buffer);
+}
+
+void
+PrometheusWriter::WriteHistogram(const char *name, const char *labels,
+				 const Log2Histogram &h)
+{
+	std::array<uint64_t, Log2Histogram::N_BUCKETS> buckets;
+	for (unsigned i = 0; i < buckets.size(); ++i)
+		buckets[i] = h[i];
+
+	WriteHistogram(name, labels, buckets.data(),
+		       h.GetCount(), h.GetSumMicroseconds());
+}
+
+MetricsRegistry::Shard::Shard() noexcept
+	:in_use(false)
+{
+	for (auto &i : slots)
+		i.store(0, std::memory_order_relaxed);
+}
+
+void *
+MetricsRegistry::Shard::operator new(size_t size)
+{
+	void *p;
+	if (posix_memalign(&p, alignof(Shard), size) != 0)
+		throw std::bad_alloc();
+	return p;
+}
+
+void
+MetricsRegistry::Shard::operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+thread_local MetricsRegistry::ThreadCache MetricsRegistry::thread_cache;
+
+/**
+ * Releases the calling thread's shard when the thread exits, so it
+ * can be adopted by another thread.
+ */
+struct MetricsShardReleaser {
+	MetricsRegistry::Shard *shard = nullptr;
+
+	~MetricsShardReleaser() noexcept {
+		Release();
+	}
+
+	void Release() noexcept {
+		if (shard != nullptr) {
+			shard->in_use.store(false, std::memory_order_release);
+			shard = nullptr;
+		}
+	}
+};
+
+static thread_local MetricsShardReleaser shard_releaser;
+
+MetricsRegistry::~MetricsRegistry() noexcept
+{
+	if (thread_cache.registry == this) {
+		thread_cache.registry = nullptr;
+		shard_releaser.shard = nullptr;
+	}
+}
+
+unsigned
+MetricsRegistry::Register(const char *name, const char *help,
+			  const char *labels, Type type)
+{
+	if (labels == nullptr)
+		labels = "";
+
+	const unsigned size = type == Type::HISTOGRAM
+		? Log2Histogram::N_BUCKETS + 2
+		: 1;
+
+	const std::lock_guard<std::mutex> lock(mutex);
+
+	auto position = series.end();
+	for (auto i = series.begin(); i != series.end(); ++i) {
+		if (i->name != name)
+			continue;
+
+		if (i->type != type)
+			throw std::runtime_error("Metric type mismatch");
+
+		if (i->labels == labels)
+			return i->slot;
+
+		/* insert after the last series of this family */
+		position = std::next(i);
+	}
+
+	if (n_slots + size > MAX_SLOTS)
+		throw std::runtime_error("Too many metrics");
+
+	const unsigned slot = n_slots;
+	series.insert(position, Series{name, labels, help, type, slot});
+	n_slots += size;
+	return slot;
+}
+
+MetricsCounter
+MetricsRegistry::AddCounter(const char *name, const char *help,
+			    const char *labels)
+{
+	return MetricsCounter(*this,
+			      Register(name, help, labels, Type::COUNTER));
+}
+
+MetricsHistogram
+MetricsRegistry::AddHistogram(const char *name, const char *help,
+			      const char *labels)
+{
+	return MetricsHistogram(*this,
+				Register(name, help, labels, Type::HISTOGRAM));
+}
+
+void
+MetricsRegistry::AddCollector(Collector collector)
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+	collectors.emplace_back(std::move(collector));
+}
+
+std::atomic<uint64_t> *
+MetricsRegistry::AcquireShard() noexcept
+{
+	/* give up the shard of another registry used previously by
+	   this thread */
+	shard_releaser.Release();
+
+	Shard *shard = nullptr;
+
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+
+		for (const auto &i : shards) {
+			bool expected = false;
+			if (i->in_use.compare_exchange_strong(expected, true,
+							      std::memory_order_acquire)) {
+				shard = i.get();
+				break;
+			}
+		}
+
+		if (shard == nullptr) {
+			std::unique_ptr<Shard> new_shard(new Shard());
+			new_shard->in_use.store(true, std::memory_order_relaxed);
+			shard = new_shard.get();
+			shards.emplace_back(std::move(new_shard));
+		}
+	}
+
+	shard_releaser.shard = shard;
+	thread_cache.registry = this;
+	thread_cache.shard = shard;
+	return shard->slots.data();
+}
+
+uint64_t
+MetricsRegistry::Sum(unsigned slot) const noexcept
+{
+	uint64_t sum = 0;
+	for (const auto &i : shards)
+		sum += i->slots[slot].load(std::memory_order_relaxed);
+	return sum;
+}
+
+uint64_t
+MetricsRegistry::GetValue(MetricsCounter counter) const noexcept
+{
+	assert(counter.IsDefined());
+
+	const std::lock_guard<std::mutex> lock(mutex);
+	return Sum(counter.slot);
+}
+
+void
+MetricsRegistry::Write(PrometheusWriter &w) const
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+
+	const std::string *previous_name = nullptr;
+
+	for (const auto &i : series) {
+		const bool new_family = previous_name == nullptr ||
+			*previous_name != i.name;
+		previous_name = &i.name;
+
+		switch (i.type) {
+		case Type::COUNTER:
+			if (new_family)
+				w.WriteHeader(i.name.c_str(), i.help.c_str(),
+					      "counter");
+
+			w.WriteSample(i.name.c_str(), i.labels.c_str(),
+				      Sum(i.slot));
+			break;
+
+		case Type::HISTOGRAM:
+			if (new_family)
+				w.WriteHeader(i.name.c_str(), i.help.c_str(),
+					      "histogram");
+
+			{
+				std::array<uint64_t, Log2Histogram::N_BUCKETS> buckets;
+				for (unsigned j = 0; j < buckets.size(); ++j)
+					buckets[j] = Sum(i.slot + j);
+
+				w.WriteHistogram(i.name.c_str(),
+						 i.labels.c_str(),
+						 buckets.data(),
+						 Sum(i.slot + Log2Histogram::N_BUCKETS),
+						 Sum(i.slot + Log2Histogram::N_BUCKETS + 1));
+			}
+
+			break;
+		}
+	}
+
+	for (const auto &i : collectors)
+		i(w);
+}
+
+std::string
+MetricsRegistry::Format() const
+{
+	std::string result;
+	PrometheusWriter w(result);
+	Write(w);
+	return result;
+}
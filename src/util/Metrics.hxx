@@ -0,0 +1,326 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Log2Histogram.hxx"
+#include "Compiler.h"
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+class MetricsRegistry;
+
+/**
+ * Generates the Prometheus text exposition format (version 0.0.4).
+ */
+class PrometheusWriter {
+	std::string &out;
+
+public:
+	explicit PrometheusWriter(std::string &_out) noexcept
+		:out(_out) {}
+
+	/**
+	 * Write the "HELP" and "TYPE" lines of a metric family.
+	 *
+	 * @param type "counter", "gauge" or "histogram"
+	 */
+	void WriteHeader(const char *name, const char *help,
+			 const char *type);
+
+	/**
+	 * @param labels a comma-separated list of label pairs
+	 * (e.g. "a=\"x\",b=\"y\""); may be nullptr or empty
+	 */
+	void WriteSample(const char *name, const char *labels,
+			 uint64_t value);
+
+	void WriteSample(const char *name, const char *labels,
+			 double value);
+
+	/**
+	 * Write the samples of a histogram with #Log2Histogram
+	 * buckets (in seconds).
+	 *
+	 * @param buckets an array of Log2Histogram::N_BUCKETS
+	 * (non-cumulative) bucket counters
+	 */
+	void WriteHistogram(const char *name, const char *labels,
+			    const uint64_t *buckets,
+			    uint64_t count, uint64_t sum_us);
+
+	void WriteHistogram(const char *name, const char *labels,
+			    const Log2Histogram &h);
+
+private:
+	void WriteName(const char *name, const char *suffix,
+		       const char *labels, const char *extra_label);
+};
+
+/**
+ * A counter registered in a #MetricsRegistry.  This is a cheap handle
+ * which may be copied and used from any thread.
+ */
+class MetricsCounter {
+	friend class MetricsRegistry;
+
+	MetricsRegistry *registry = nullptr;
+	unsigned slot;
+
+public:
+	MetricsCounter() = default;
+
+	constexpr MetricsCounter(MetricsRegistry &_registry,
+				 unsigned _slot) noexcept
+		:registry(&_registry), slot(_slot) {}
+
+	bool IsDefined() const noexcept {
+		return registry != nullptr;
+	}
+
+	inline void Add(uint64_t n=1) const noexcept;
+
+	void operator++() const noexcept {
+		Add(1);
+	}
+};
+
+/**
+ * A histogram of durations (with #Log2Histogram buckets) registered
+ * in a #MetricsRegistry.
+ */
+class MetricsHistogram {
+	MetricsRegistry *registry = nullptr;
+	unsigned slot;
+
+public:
+	typedef Log2Histogram::Duration Duration;
+
+	MetricsHistogram() = default;
+
+	constexpr MetricsHistogram(MetricsRegistry &_registry,
+				   unsigned _slot) noexcept
+		:registry(&_registry), slot(_slot) {}
+
+	bool IsDefined() const noexcept {
+		return registry != nullptr;
+	}
+
+	inline void Add(Duration d) const noexcept;
+};
+
+/**
+ * A registry of counters and histograms which can be updated from
+ * any thread at the cost of a plain (non-atomic read-modify-write)
+ * increment.  Each thread writes to its own cache-line aligned
+ * shard, and all shards are summed up when the metrics are
+ * formatted.
+ *
+ * Values which are maintained elsewhere (e.g. #Log2Histogram
+ * instances in #EventLoopInstrumentation or cache statistics) can be
+ * exported with AddCollector().
+ *
+ * The registry must outlive all threads which have updated its
+ * metrics.
+ */
+class MetricsRegistry {
+public:
+	/**
+	 * The maximum number of slots; a counter uses one slot, a
+	 * histogram Log2Histogram::N_BUCKETS + 2.
+	 */
+	static constexpr unsigned MAX_SLOTS = 1024;
+
+	typedef std::function<void(PrometheusWriter &w)> Collector;
+
+	struct alignas(64) Shard {
+		std::array<std::atomic<uint64_t>, MAX_SLOTS> slots;
+
+		/**
+		 * Is this shard owned by a thread?  Only the owner
+		 * writes to #slots.  After the thread exits, another
+		 * thread may adopt it; since all values are sums,
+		 * this does not falsify the results.
+		 */
+		std::atomic<bool> in_use;
+
+		Shard() noexcept;
+
+		/* C++14 does not honor "alignas" in operator new */
+		static void *operator new(size_t size);
+		static void operator delete(void *p) noexcept;
+	};
+
+private:
+	enum class Type : uint8_t {
+		COUNTER,
+		HISTOGRAM,
+	};
+
+	struct Series {
+		std::string name, labels, help;
+		Type type;
+		unsigned slot;
+	};
+
+	mutable std::mutex mutex;
+
+	/**
+	 * All series, grouped by name (families must be contiguous
+	 * in the exposition format).
+	 */
+	std::vector<Series> series;
+
+	std::vector<std::unique_ptr<Shard>> shards;
+
+	std::vector<Collector> collectors;
+
+	unsigned n_slots = 0;
+
+	struct ThreadCache {
+		const MetricsRegistry *registry;
+		Shard *shard;
+	};
+
+	static thread_local ThreadCache thread_cache;
+
+public:
+	MetricsRegistry() = default;
+	~MetricsRegistry() noexcept;
+
+	MetricsRegistry(const MetricsRegistry &) = delete;
+	MetricsRegistry &operator=(const MetricsRegistry &) = delete;
+
+	/**
+	 * Register a counter.  Registering the same name and labels
+	 * again returns the existing counter.
+	 *
+	 * Throws std::runtime_error if there are too many metrics or
+	 * if the name is already used by a histogram.
+	 *
+	 * @param labels see PrometheusWriter::WriteSample()
+	 */
+	MetricsCounter AddCounter(const char *name, const char *help,
+				  const char *labels=nullptr);
+
+	/**
+	 * Register a histogram; see AddCounter().
+	 */
+	MetricsHistogram AddHistogram(const char *name, const char *help,
+				      const char *labels=nullptr);
+
+	/**
+	 * Register a function which writes additional metrics.  It is
+	 * invoked by Write() (with the registry locked, so it must
+	 * not call methods of this object) in the thread which
+	 * formats the metrics; it is responsible for synchronizing
+	 * access to the data it exports.
+	 */
+	void AddCollector(Collector collector);
+
+	/**
+	 * Returns the current (merged) value of a counter.
+	 */
+	gcc_pure
+	uint64_t GetValue(MetricsCounter counter) const noexcept;
+
+	/**
+	 * Write all metrics in the Prometheus text format.
+	 */
+	void Write(PrometheusWriter &w) const;
+
+	std::string Format() const;
+
+	void Add(unsigned slot, uint64_t n) noexcept {
+		Increment(GetSlots()[slot], n);
+	}
+
+	void AddDuration(unsigned slot, Log2Histogram::Duration d) noexcept {
+		const uint64_t us = d > d.zero()
+			? std::chrono::duration_cast<std::chrono::microseconds>(d).count()
+			: 0;
+
+		auto *slots = GetSlots() + slot;
+		Increment(slots[Log2Histogram::BucketIndex(us)], 1);
+		Increment(slots[Log2Histogram::N_BUCKETS], 1);
+		Increment(slots[Log2Histogram::N_BUCKETS + 1], us);
+	}
+
+private:
+	static void Increment(std::atomic<uint64_t> &value,
+			      uint64_t n) noexcept {
+		/* only the owning thread writes into its shard, so a
+		   relaxed load and store suffice; unlike fetch_add(),
+		   this compiles to a plain increment */
+		value.store(value.load(std::memory_order_relaxed) + n,
+			    std::memory_order_relaxed);
+	}
+
+	unsigned Register(const char *name, const char *help,
+			  const char *labels, Type type);
+
+	std::atomic<uint64_t> *GetSlots() noexcept {
+		const auto &c = thread_cache;
+		if (gcc_likely(c.registry == this))
+			return c.shard->slots.data();
+
+		return AcquireShard();
+	}
+
+	/**
+	 * Obtain a shard for the calling thread and store it in
+	 * #thread_cache.
+	 */
+	std::atomic<uint64_t> *AcquireShard() noexcept;
+
+	uint64_t Sum(unsigned slot) const noexcept;
+};
+
+inline void
+MetricsCounter::Add(uint64_t n) const noexcept
+{
+	registry->Add(slot, n);
+}
+
+inline void
+MetricsHistogram::Add(Duration d) const noexcept
+{
+	registry->AddDuration(slot, d);
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <atomic>
+
+#include <stddef.h>
+
+/**
+ * Derive from this class to make objects insertable into a
+ * #MpscQueue.  An object can be in at most one queue at a time.
+ */
+class MpscQueueHook {
+	template<typename T> friend class MpscQueue;
+
+	std::atomic<MpscQueueHook *> mpsc_next{nullptr};
+
+public:
+	MpscQueueHook() noexcept = default;
+
+	/* the hook is never copied along with the object */
+	MpscQueueHook(const MpscQueueHook &) noexcept {}
+
+	MpscQueueHook &operator=(const MpscQueueHook &) noexcept {
+		return *this;
+	}
+};
+
+/**
+ * An unbounded intrusive lock-free multi-producer/single-consumer
+ * FIFO queue (Dmitry Vyukov's algorithm).  Push() is wait-free (one
+ * atomic exchange) and may be called from any thread; Pop() must only
+ * be called by a single consumer thread.  The queue never allocates
+ * memory; it links objects through their #MpscQueueHook.
+ *
+ * A producer which has been preempted in the middle of Push() makes
+ * its element (and all elements pushed after it) temporarily
+ * invisible to the consumer; Pop() returns nullptr in this case even
+ * though the queue is not empty.  The consumer must therefore not
+ * rely on Pop() returning nullptr as a "queue is empty" signal for
+ * synchronization; a separate wakeup mechanism (e.g. an eventfd
+ * written by the producer) is needed anyway.
+ *
+ * @param T the element type; it must derive from #MpscQueueHook
+ */
+template<typename T>
+class MpscQueue {
+	/**
+	 * The most recently pushed hook; producers swap themselves in
+	 * here.
+	 */
+	std::atomic<MpscQueueHook *> tail;
+
+	/**
+	 * Keep the producers' and the consumer's members in different
+	 * cache lines.
+	 */
+	char padding[64];
+
+	/**
+	 * The oldest hook in the queue (or #stub); only accessed by
+	 * the consumer.
+	 */
+	MpscQueueHook *head;
+
+	/**
+	 * A dummy hook which keeps the list non-empty, so producers
+	 * never need to touch #head.
+	 */
+	MpscQueueHook stub;
+
+public:
+	MpscQueue() noexcept
+		:tail(&stub), head(&stub) {}
+
+	MpscQueue(const MpscQueue &) = delete;
+	MpscQueue &operator=(const MpscQueue &) = delete;
+
+	/**
+	 * Producer: append an object to the end of the queue.
+	 */
+	void Push(T &item) noexcept {
+		PushHook(item);
+	}
+
+	/**
+	 * Consumer: remove the oldest object from the queue.
+	 *
+	 * @return the object, or nullptr if the queue is empty or if
+	 * the next object is still being pushed
+	 */
+	T *Pop() noexcept {
+		MpscQueueHook *h = head;
+		MpscQueueHook *next = h->mpsc_next.load(std::memory_order_acquire);
+
+		if (h == &stub) {
+			if (next == nullptr)
+				return nullptr;
+
+			/* skip the stub */
+			head = h = next;
+			next = next->mpsc_next.load(std::memory_order_acquire);
+		}
+
+		if (next != nullptr) {
+			head = next;
+			return static_cast<T *>(h);
+		}
+
+		if (h != tail.load(std::memory_order_acquire))
+			/* a producer has swapped itself in, but has not
+			   linked its hook yet */
+			return nullptr;
+
+		/* "h" is the last object; re-insert the stub behind it,
+		   so "h" can be unlinked */
+		PushHook(stub);
+
+		next = h->mpsc_next.load(std::memory_order_acquire);
+		if (next != nullptr) {
+			head = next;
+			return static_cast<T *>(h);
+		}
+
+		return nullptr;
+	}
+
+	/**
+	 * Consumer: remove objects and invoke a function on each one
+	 * until Pop() returns nullptr.
+	 *
+	 * @return the number of objects removed
+	 */
+	template<typename F>
+	size_t PopAll(F &&f) {
+		size_t n = 0;
+		while (T *item = Pop()) {
+			f(*item);
+			++n;
+		}
+
+		return n;
+	}
+
+private:
+	void PushHook(MpscQueueHook &hook) noexcept {
+		hook.mpsc_next.store(nullptr, std::memory_order_relaxed);
+		MpscQueueHook *prev = tail.exchange(&hook,
+						    std::memory_order_acq_rel);
+		prev->mpsc_next.store(&hook, std::memory_order_release);
+	}
+};
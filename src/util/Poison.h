@@ -49,6 +49,8 @@
 #include <string.h>
 #endif
 
+#include <stddef.h>
+
 /**
  * Poisons the specified memory area and marks it as "not accessible".
  *
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "ForeignFifoBuffer.hxx"
+#include "SlabBufferPool.hxx"
+
+#include <stdint.h>
+#include <assert.h>
+
+/**
+ * A #ForeignFifoBuffer which borrows its memory from a
+ * #SlabBufferPool.  The buffer is "null" initially; Allocate() takes
+ * a buffer from the pool and Free() returns it.  The idea is to hold
+ * a buffer only while there is data in it.
+ */
+class PooledFifoBuffer : public ForeignFifoBuffer<uint8_t> {
+	SlabBufferPool &pool;
+
+public:
+	explicit PooledFifoBuffer(SlabBufferPool &_pool) noexcept
+		:ForeignFifoBuffer<uint8_t>(nullptr), pool(_pool) {}
+
+	~PooledFifoBuffer() noexcept {
+		FreeIfDefined();
+	}
+
+	PooledFifoBuffer(const PooledFifoBuffer &) = delete;
+
+	/**
+	 * Take over the buffer of another instance, which must use
+	 * the same pool.  This instance must be null.
+	 */
+	PooledFifoBuffer &operator=(PooledFifoBuffer &&src) noexcept {
+		assert(&pool == &src.pool);
+		assert(IsNull());
+
+		ForeignFifoBuffer<uint8_t>::operator=(std::move(src));
+		return *this;
+	}
+
+	SlabBufferPool &GetPool() const noexcept {
+		return pool;
+	}
+
+	bool IsDefinedAndFull() const noexcept {
+		return IsDefined() && IsFull();
+	}
+
+	void Allocate() {
+		assert(IsNull());
+
+		SetBuffer((uint8_t *)pool.Allocate(), pool.GetBufferSize());
+	}
+
+	void AllocateIfNull() {
+		if (IsNull())
+			Allocate();
+	}
+
+	void Free() noexcept {
+		assert(IsDefined());
+
+		pool.Free(GetBuffer());
+		SetNull();
+	}
+
+	void FreeIfDefined() noexcept {
+		if (IsDefined())
+			Free();
+	}
+
+	/**
+	 * Return the buffer to the pool if it is empty.
+	 */
+	void FreeIfEmpty() noexcept {
+		if (IsEmpty())
+			FreeIfDefined();
+	}
+};
@@ -0,0 +1,262 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include "Cache.hxx"
+#include "Compiler.h"
+
+#include <array>
+#include <mutex>
+#include <shared_mutex>
+
+#include <stdint.h>
+
+/**
+ * A thread-safe variant of #Cache.  Keys are partitioned by their
+ * hash into #n_shards independent LRU caches, each protected by its
+ * own lock, so threads working on different keys rarely contend.
+ *
+ * Since a pointer into the cache would be invalidated by other
+ * threads as soon as the lock is released, lookups pass the value to
+ * a callback which runs while the shard is locked.  The callback
+ * must not access this cache.
+ *
+ * Get() marks the item as recently used and therefore needs an
+ * exclusive lock.  Peek() leaves the LRU order alone and takes only
+ * a shared lock, so hits on a popular key can be served by many
+ * readers in parallel; the price is that items only found via Peek()
+ * may be evicted early.
+ *
+ * This object is large (all items are allocated inside it) and
+ * should usually be allocated on the heap.
+ *
+ * @param n_shards the number of shards; more shards mean less lock
+ * contention, but a less accurate global LRU order
+ * @param shard_max_size the maximum number of items in each shard
+ * @param shard_table_size the size of each shard's hash table;
+ * should be prime
+ * @param Policy the eviction policy of each shard, see #Cache
+ */
+template<typename Key, typename Data,
+	 std::size_t n_shards,
+	 std::size_t shard_max_size,
+	 std::size_t shard_table_size,
+	 typename Hash=std::hash<Key>,
+	 typename Equal=std::equal_to<Key>,
+	 typename Policy=CacheLruPolicy>
+class ShardedCache {
+	static_assert(n_shards > 0, "Need at least one shard");
+
+	typedef Cache<Key, Data, shard_max_size, shard_table_size,
+		      Hash, Equal, Policy> ShardCache;
+
+	struct Shard {
+		mutable std::shared_timed_mutex mutex;
+		ShardCache cache;
+
+		/**
+		 * Keep the next shard's mutex in a different cache
+		 * line, so locking one shard does not slow down its
+		 * neighbour.
+		 */
+		char padding[64];
+	};
+
+	std::array<Shard, n_shards> shards;
+
+	Hash hash;
+
+	/**
+	 * Select the shard for the given key.  The hash is mixed
+	 * before, because the shard's hash table uses the same hash
+	 * value, and without mixing, it would see only a fraction of
+	 * its buckets.
+	 */
+	template<typename K>
+	gcc_pure
+	Shard &GetShard(const K &key) noexcept {
+		const uint64_t h = uint64_t(hash(key)) * 0x9e3779b97f4a7c15ULL;
+		return shards[(h >> 32) % n_shards];
+	}
+
+	template<typename K>
+	gcc_pure
+	const Shard &GetShard(const K &key) const noexcept {
+		return const_cast<ShardedCache *>(this)->GetShard(key);
+	}
+
+	typedef std::unique_lock<std::shared_timed_mutex> ExclusiveLock;
+	typedef std::shared_lock<std::shared_timed_mutex> SharedLock;
+
+public:
+	ShardedCache() = default;
+
+	ShardedCache(const ShardedCache &) = delete;
+	ShardedCache &operator=(const ShardedCache &) = delete;
+
+	gcc_pure
+	bool IsEmpty() const noexcept {
+		for (const auto &shard : shards) {
+			const SharedLock lock(shard.mutex);
+			if (!shard.cache.IsEmpty())
+				return false;
+		}
+
+		return true;
+	}
+
+	void Clear() noexcept {
+		for (auto &shard : shards) {
+			const ExclusiveLock lock(shard.mutex);
+			shard.cache.Clear();
+		}
+	}
+
+	/**
+	 * Look up an item by its key and mark it as recently used.
+	 * If it exists, pass a (mutable) reference to the value to
+	 * the given function.
+	 *
+	 * @return true if the item was found
+	 */
+	template<typename K, typename F>
+	bool Get(K &&key, F &&f) {
+		auto &shard = GetShard(key);
+		const ExclusiveLock lock(shard.mutex);
+
+		auto *data = shard.cache.Get(std::forward<K>(key));
+		if (data == nullptr)
+			return false;
+
+		f(*data);
+		return true;
+	}
+
+	/**
+	 * Look up an item by its key without marking it as recently
+	 * used, and pass a const reference to the value to the given
+	 * function.  This takes only a shared lock, i.e. concurrent
+	 * Peek() calls do not block each other.
+	 *
+	 * @return true if the item was found
+	 */
+	template<typename K, typename F>
+	bool Peek(K &&key, F &&f) const {
+		const auto &shard = GetShard(key);
+		const SharedLock lock(shard.mutex);
+
+		const auto *data = shard.cache.Peek(std::forward<K>(key));
+		if (data == nullptr)
+			return false;
+
+		f(*data);
+		return true;
+	}
+
+	/**
+	 * Insert a new item into the cache.  Unlike Cache::Put(), an
+	 * existing item is replaced, because another thread may have
+	 * inserted the same key after the caller's lookup failed.
+	 * If the shard is full, its least recently used item is
+	 * deleted.
+	 */
+	template<typename K, typename U>
+	void Put(K &&key, U &&data) {
+		auto &shard = GetShard(key);
+		const ExclusiveLock lock(shard.mutex);
+		shard.cache.PutOrReplace(std::forward<K>(key),
+					 std::forward<U>(data));
+	}
+
+	/**
+	 * Insert a new item into the cache only if the key does not
+	 * exist yet.
+	 *
+	 * @return true if the item was inserted, false if the key
+	 * existed already (the cache is not modified then)
+	 */
+	template<typename K, typename U>
+	bool PutIfAbsent(K &&key, U &&data) {
+		auto &shard = GetShard(key);
+		const ExclusiveLock lock(shard.mutex);
+		if (shard.cache.Peek(key) != nullptr)
+			return false;
+
+		shard.cache.Put(std::forward<K>(key), std::forward<U>(data));
+		return true;
+	}
+
+	/**
+	 * Remove an item from the cache.  Unlike Cache::Remove(), the
+	 * key does not need to exist.
+	 *
+	 * @return true if the item was removed
+	 */
+	template<typename K>
+	bool Remove(K &&key) noexcept {
+		auto &shard = GetShard(key);
+		const ExclusiveLock lock(shard.mutex);
+
+		auto *data = shard.cache.Get(std::forward<K>(key));
+		if (data == nullptr)
+			return false;
+
+		shard.cache.RemoveItem(*data);
+		return true;
+	}
+
+	/**
+	 * Iterates over all items and remove all those which match
+	 * the given predicate.  Each shard is locked separately, so
+	 * this is not atomic with respect to other threads.
+	 */
+	template<typename P>
+	void RemoveIf(P &&p) noexcept {
+		for (auto &shard : shards) {
+			const ExclusiveLock lock(shard.mutex);
+			shard.cache.RemoveIf(p);
+		}
+	}
+
+	/**
+	 * Iterates over all items, passing each key/value pair to a
+	 * given function.  The cache must not be modified from within
+	 * that function.
+	 */
+	template<typename F>
+	void ForEach(F &&f) const {
+		for (const auto &shard : shards) {
+			const SharedLock lock(shard.mutex);
+			shard.cache.ForEach(f);
+		}
+	}
+};
@@ -0,0 +1,363 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include "Poison.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <utility>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A thread-safe variant of #Recycler.  Each thread has its own
+ * cache of up to #N_LOCAL objects, which needs no synchronization at
+ * all.  When it is full, freed objects go to a global lock-free
+ * stack of up to #N_GLOBAL objects, from which other threads can
+ * refill their caches; this way, objects freed by one event loop
+ * can be reused by another one.
+ *
+ * All instances share the per-type state, therefore all methods are
+ * static.
+ *
+ * @param MAX_BYTES a limit for the memory held by the global stack
+ * and by each thread's cache; it lowers #N_LOCAL and #N_GLOBAL for
+ * large objects
+ */
+template<class T, size_t N_LOCAL, size_t N_GLOBAL,
+	 size_t MAX_BYTES=SIZE_MAX>
+class SharedRecycler {
+	union Item {
+		Item *next;
+
+		T value;
+
+		template<typename... Args>
+		Item(Args&&... args)
+			:value(std::forward<Args>(args)...) {}
+
+		~Item() {}
+	};
+
+	static constexpr size_t MAX_LOCAL =
+		std::min(N_LOCAL, MAX_BYTES / sizeof(Item));
+
+	static constexpr size_t MAX_GLOBAL =
+		std::min(N_GLOBAL, MAX_BYTES / sizeof(Item));
+
+public:
+	struct Stats {
+		/**
+		 * Get() calls served from the thread's cache.
+		 */
+		uint64_t local_hits = 0;
+
+		/**
+		 * Get() calls which refilled the thread's cache from
+		 * the global stack.
+		 */
+		uint64_t global_hits = 0;
+
+		/**
+		 * Get() calls which had to allocate a new object.
+		 */
+		uint64_t misses = 0;
+
+		/**
+		 * Put() calls which freed the object because all
+		 * caches were full.
+		 */
+		uint64_t overflows = 0;
+
+		Stats &operator+=(const Stats &other) noexcept {
+			local_hits += other.local_hits;
+			global_hits += other.global_hits;
+			misses += other.misses;
+			overflows += other.overflows;
+			return *this;
+		}
+	};
+
+private:
+	/**
+	 * The global overflow stack.  To avoid the ABA problem
+	 * without tagged pointers, items are only ever popped all at
+	 * once with an atomic exchange; there is no single-item pop.
+	 */
+	struct Global {
+		std::atomic<Item *> head{nullptr};
+
+		/**
+		 * An approximation of the number of items in the
+		 * stack, used to enforce #MAX_GLOBAL.
+		 */
+		std::atomic<size_t> size{0};
+
+		/**
+		 * Statistics of threads which have exited.
+		 */
+		std::atomic<uint64_t> local_hits{0}, global_hits{0};
+		std::atomic<uint64_t> misses{0}, overflows{0};
+
+		~Global() noexcept {
+			DeleteChain(head.exchange(nullptr));
+		}
+
+		/**
+		 * Push a chain of items ending with the given tail.
+		 */
+		void PushChain(Item *first, Item *tail) noexcept {
+			tail->next = head.load(std::memory_order_relaxed);
+			while (!head.compare_exchange_weak(tail->next, first,
+							   std::memory_order_release,
+							   std::memory_order_relaxed)) {}
+		}
+
+		/**
+		 * Try to push one item; returns false if the stack is
+		 * full.
+		 */
+		bool Push(Item &item) noexcept {
+			if (size.fetch_add(1, std::memory_order_relaxed) >= MAX_GLOBAL) {
+				size.fetch_sub(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			PushChain(&item, &item);
+			return true;
+		}
+
+		Item *PopAll() noexcept {
+			return head.exchange(nullptr, std::memory_order_acquire);
+		}
+
+		void AddStats(const Stats &s) noexcept {
+			local_hits.fetch_add(s.local_hits, std::memory_order_relaxed);
+			global_hits.fetch_add(s.global_hits, std::memory_order_relaxed);
+			misses.fetch_add(s.misses, std::memory_order_relaxed);
+			overflows.fetch_add(s.overflows, std::memory_order_relaxed);
+		}
+
+		Stats GetStats() const noexcept {
+			Stats s;
+			s.local_hits = local_hits.load(std::memory_order_relaxed);
+			s.global_hits = global_hits.load(std::memory_order_relaxed);
+			s.misses = misses.load(std::memory_order_relaxed);
+			s.overflows = overflows.load(std::memory_order_relaxed);
+			return s;
+		}
+	};
+
+	/**
+	 * The cache of one thread.
+	 */
+	struct Local {
+		Item *head = nullptr;
+		size_t size = 0;
+
+		Stats stats;
+
+		/**
+		 * On thread exit, give the cached items to other
+		 * threads (or free them).
+		 */
+		~Local() noexcept {
+			auto &global = GetGlobal();
+			while (Item *item = Pop())
+				if (!global.Push(*item))
+					delete item;
+
+			global.AddStats(stats);
+		}
+
+		void Push(Item &item) noexcept {
+			PoisonInaccessibleT(item);
+			PoisonUndefinedT(item.next);
+
+			item.next = head;
+			head = &item;
+			++size;
+		}
+
+		Item *Pop() noexcept {
+			Item *item = head;
+			if (item != nullptr) {
+				head = item->next;
+				--size;
+			}
+
+			return item;
+		}
+	};
+
+	static Global &GetGlobal() noexcept {
+		static Global global;
+		return global;
+	}
+
+	static Local &GetLocal() noexcept {
+		static thread_local Local local;
+		return local;
+	}
+
+	static void DeleteChain(Item *item) noexcept {
+		while (item != nullptr) {
+			Item *next = item->next;
+			delete item;
+			item = next;
+		}
+	}
+
+	/**
+	 * Take all items from the global stack, keep up to
+	 * #MAX_LOCAL in the thread's cache and return one to the
+	 * caller.  Surplus items are pushed back.
+	 */
+	static Item *Refill(Local &local) noexcept {
+		auto &global = GetGlobal();
+		Item *chain = global.PopAll();
+		if (chain == nullptr)
+			return nullptr;
+
+		Item *result = chain;
+		chain = chain->next;
+		size_t n_taken = 1;
+
+		while (chain != nullptr && local.size < MAX_LOCAL) {
+			Item *next = chain->next;
+			local.Push(*chain);
+			chain = next;
+			++n_taken;
+		}
+
+		global.size.fetch_sub(n_taken, std::memory_order_relaxed);
+
+		if (chain != nullptr) {
+			Item *tail = chain;
+			while (tail->next != nullptr)
+				tail = tail->next;
+			global.PushChain(chain, tail);
+		}
+
+		return result;
+	}
+
+	template<typename... Args>
+	static T *Construct(Local &local, Item &item, Args&&... args) {
+		PoisonUndefinedT(item.value);
+
+		try {
+			new (&item.value) T(std::forward<Args>(args)...);
+			return &item.value;
+		} catch (...) {
+			if (local.size < MAX_LOCAL)
+				local.Push(item);
+			else
+				delete &item;
+			throw;
+		}
+	}
+
+public:
+	/**
+	 * Allocate a new object, potentially taking the memory
+	 * allocation from a cache.  The instance must be freed with
+	 * Put(), which may be called in any thread.
+	 */
+	template<typename... Args>
+	static T *Get(Args&&... args) {
+		auto &local = GetLocal();
+
+		Item *item = local.Pop();
+		if (item != nullptr) {
+			++local.stats.local_hits;
+			return Construct(local, *item, std::forward<Args>(args)...);
+		}
+
+		item = Refill(local);
+		if (item != nullptr) {
+			++local.stats.global_hits;
+			return Construct(local, *item, std::forward<Args>(args)...);
+		}
+
+		++local.stats.misses;
+		item = new Item(std::forward<Args>(args)...);
+		return &item->value;
+	}
+
+	/**
+	 * Free an instance allocated with Get().
+	 */
+	static void Put(T *value) noexcept {
+		auto *item = (Item *)value;
+		item->value.~T();
+
+		auto &local = GetLocal();
+		if (local.size < MAX_LOCAL) {
+			local.Push(*item);
+		} else if (!GetGlobal().Push(*item)) {
+			++local.stats.overflows;
+			delete item;
+		}
+	}
+
+	/**
+	 * Free all objects in the calling thread's cache and in the
+	 * global stack.  Caches of other threads are not affected.
+	 */
+	static void Clear() noexcept {
+		auto &local = GetLocal();
+		while (Item *item = local.Pop())
+			delete item;
+
+		auto &global = GetGlobal();
+		Item *chain = global.PopAll();
+		size_t n = 0;
+		for (Item *i = chain; i != nullptr; i = i->next)
+			++n;
+		global.size.fetch_sub(n, std::memory_order_relaxed);
+		DeleteChain(chain);
+	}
+
+	/**
+	 * Returns the statistics of the calling thread plus those of
+	 * all threads which have exited.
+	 */
+	static Stats GetStats() noexcept {
+		Stats s = GetGlobal().GetStats();
+		s += GetLocal().stats;
+		return s;
+	}
+};
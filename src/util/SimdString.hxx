@@ -0,0 +1,246 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Vectorized helpers for short-string parsing: whitespace skipping
+ * and ASCII case-insensitive comparison, 16 bytes per step.  They
+ * use SSE2 on x86-64 and NEON on AArch64 (both are part of the
+ * baseline instruction set, so no runtime dispatch is needed) and
+ * plain loops elsewhere.  Nothing is read outside the given range.
+ *
+ * Searching for a single character is not here: memchr() already
+ * is vectorized (with runtime dispatch) by the C library.
+ * SimdFindEither() is for the case where two delimiters must be
+ * found in one pass.
+ */
+
+#pragma once
+
+#include "CharUtil.hxx"
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_SIMD_STRING_SSE2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HAVE_SIMD_STRING_NEON
+#endif
+
+#ifdef HAVE_SIMD_STRING_NEON
+
+/**
+ * Convert a vector of bytes (each 0x00 or 0xff) to a 64 bit mask with
+ * 4 bits per byte.
+ */
+static inline uint64_t
+SimdNeonMask(uint8x16_t v) noexcept
+{
+	return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(v), 4)), 0);
+}
+
+#endif
+
+/**
+ * Skip all characters which are IsWhitespaceOrNull().
+ *
+ * @return a pointer to the first other character or @end
+ */
+gcc_pure
+static inline const char *
+SimdSkipWhitespace(const char *p, const char *end) noexcept
+{
+#ifdef HAVE_SIMD_STRING_SSE2
+	const __m128i space = _mm_set1_epi8(0x20);
+	while (end - p >= 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)p);
+		/* unsigned "v <= 0x20" */
+		const __m128i ws = _mm_cmpeq_epi8(_mm_min_epu8(v, space), v);
+		const unsigned mask = ~unsigned(_mm_movemask_epi8(ws)) & 0xffff;
+		if (mask != 0)
+			return p + __builtin_ctz(mask);
+		p += 16;
+	}
+#elif defined(HAVE_SIMD_STRING_NEON)
+	const uint8x16_t space = vdupq_n_u8(0x20);
+	while (end - p >= 16) {
+		const uint8x16_t v = vld1q_u8((const uint8_t *)p);
+		const uint64_t mask =
+			SimdNeonMask(vmvnq_u8(vcleq_u8(v, space)));
+		if (mask != 0)
+			return p + __builtin_ctzll(mask) / 4;
+		p += 16;
+	}
+#endif
+
+	while (p < end && IsWhitespaceOrNull(*p))
+		++p;
+	return p;
+}
+
+/**
+ * Skip all trailing characters which are IsWhitespaceOrNull().
+ *
+ * @return the new end pointer
+ */
+gcc_pure
+static inline const char *
+SimdSkipWhitespaceReverse(const char *begin, const char *end) noexcept
+{
+#ifdef HAVE_SIMD_STRING_SSE2
+	const __m128i space = _mm_set1_epi8(0x20);
+	while (end - begin >= 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)(end - 16));
+		const __m128i ws = _mm_cmpeq_epi8(_mm_min_epu8(v, space), v);
+		const unsigned mask = ~unsigned(_mm_movemask_epi8(ws)) & 0xffff;
+		if (mask != 0)
+			return end - 16 + (31 - __builtin_clz(mask)) + 1;
+		end -= 16;
+	}
+#elif defined(HAVE_SIMD_STRING_NEON)
+	const uint8x16_t space = vdupq_n_u8(0x20);
+	while (end - begin >= 16) {
+		const uint8x16_t v = vld1q_u8((const uint8_t *)(end - 16));
+		const uint64_t mask =
+			SimdNeonMask(vmvnq_u8(vcleq_u8(v, space)));
+		if (mask != 0)
+			return end - 16 + (63 - __builtin_clzll(mask)) / 4 + 1;
+		end -= 16;
+	}
+#endif
+
+	while (end > begin && IsWhitespaceOrNull(end[-1]))
+		--end;
+	return end;
+}
+
+/**
+ * Find the first occurrence of either of the two characters.
+ *
+ * @return a pointer to the first match or @end
+ */
+gcc_pure
+static inline const char *
+SimdFindEither(const char *p, const char *end, char a, char b) noexcept
+{
+#ifdef HAVE_SIMD_STRING_SSE2
+	const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b);
+	while (end - p >= 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)p);
+		const __m128i match = _mm_or_si128(_mm_cmpeq_epi8(v, va),
+						   _mm_cmpeq_epi8(v, vb));
+		const unsigned mask = _mm_movemask_epi8(match);
+		if (mask != 0)
+			return p + __builtin_ctz(mask);
+		p += 16;
+	}
+#elif defined(HAVE_SIMD_STRING_NEON)
+	const uint8x16_t va = vdupq_n_u8(a), vb = vdupq_n_u8(b);
+	while (end - p >= 16) {
+		const uint8x16_t v = vld1q_u8((const uint8_t *)p);
+		const uint64_t mask =
+			SimdNeonMask(vorrq_u8(vceqq_u8(v, va),
+					      vceqq_u8(v, vb)));
+		if (mask != 0)
+			return p + __builtin_ctzll(mask) / 4;
+		p += 16;
+	}
+#endif
+
+	while (p < end && *p != a && *p != b)
+		++p;
+	return p;
+}
+
+#ifdef HAVE_SIMD_STRING_SSE2
+
+static inline __m128i
+SimdToLowerASCII(__m128i v) noexcept
+{
+	/* signed comparisons are fine: bytes >= 0x80 are negative
+	   and thus never upper case */
+	const __m128i upper =
+		_mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+			      _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+	return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+#elif defined(HAVE_SIMD_STRING_NEON)
+
+static inline uint8x16_t
+SimdToLowerASCII(uint8x16_t v) noexcept
+{
+	const uint8x16_t upper =
+		vandq_u8(vcgeq_u8(v, vdupq_n_u8('A')),
+			 vcleq_u8(v, vdupq_n_u8('Z')));
+	return vorrq_u8(v, vandq_u8(upper, vdupq_n_u8(0x20)));
+}
+
+#endif
+
+/**
+ * Compare two buffers, ignoring the case of ASCII letters.  Unlike
+ * strncasecmp(), this does not depend on the locale and does not
+ * stop at null bytes; this is what HTTP tokens need.
+ */
+gcc_pure
+static inline bool
+SimdEqualsIgnoreCaseASCII(const char *a, const char *b, size_t size) noexcept
+{
+#ifdef HAVE_SIMD_STRING_SSE2
+	for (; size >= 16; a += 16, b += 16, size -= 16) {
+		const __m128i va = _mm_loadu_si128((const __m128i *)a);
+		const __m128i vb = _mm_loadu_si128((const __m128i *)b);
+		const __m128i eq = _mm_cmpeq_epi8(SimdToLowerASCII(va),
+						  SimdToLowerASCII(vb));
+		if (_mm_movemask_epi8(eq) != 0xffff)
+			return false;
+	}
+#elif defined(HAVE_SIMD_STRING_NEON)
+	for (; size >= 16; a += 16, b += 16, size -= 16) {
+		const uint8x16_t va = vld1q_u8((const uint8_t *)a);
+		const uint8x16_t vb = vld1q_u8((const uint8_t *)b);
+		const uint8x16_t eq = vceqq_u8(SimdToLowerASCII(va),
+					       SimdToLowerASCII(vb));
+		if (vminvq_u8(eq) != 0xff)
+			return false;
+	}
+#endif
+
+	for (size_t i = 0; i < size; ++i)
+		if (ToLowerASCII(a[i]) != ToLowerASCII(b[i]))
+			return false;
+
+	return true;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "SlabBufferPool.hxx"
+#include "Poison.h"
+
+#include <new>
+
+#include <assert.h>
+
+bool
+SlabBufferPool::SlabCompare::operator()(const Slab &a,
+					const Slab &b) const noexcept
+{
+	return a.data < b.data;
+}
+
+SlabBufferPool::~SlabBufferPool() noexcept
+{
+	assert(n_allocated == 0);
+	assert(full.empty());
+
+	Compress();
+
+	partial.clear_and_dispose([this](Slab *slab){
+			assert(slab->n_allocated == 0);
+
+			slabs.erase(slabs.iterator_to(*slab));
+			DeleteSlab(*slab);
+		});
+
+	assert(slabs.empty());
+}
+
+SlabBufferPool::Slab &
+SlabBufferPool::AddSlab()
+{
+	if (reserve != nullptr) {
+		Slab &slab = *reserve;
+		reserve = nullptr;
+		partial.push_front(slab);
+		return slab;
+	}
+
+	size_t size = buffers_per_slab * buffer_size;
+	void *data = AllocateLarge(size, allocation_options);
+
+	Slab *slab;
+	try {
+		slab = new Slab((char *)data, buffers_per_slab, size);
+	} catch (...) {
+		FreeLarge(data, size);
+		throw;
+	}
+
+	slabs.insert(*slab);
+	partial.push_front(*slab);
+	return *slab;
+}
+
+void
+SlabBufferPool::DeleteSlab(Slab &slab) noexcept
+{
+	FreeLarge(slab.data, slab.size);
+	delete &slab;
+}
+
+void *
+SlabBufferPool::Allocate()
+{
+	Slab &slab = partial.empty()
+		? AddSlab()
+		: partial.front();
+
+	void *p;
+	if (slab.free_head != nullptr) {
+		p = slab.free_head;
+		slab.free_head = *(void **)p;
+	} else {
+		assert(slab.n_fresh > 0);
+		p = slab.data + (buffers_per_slab - slab.n_fresh) * buffer_size;
+		--slab.n_fresh;
+	}
+
+	if (++slab.n_allocated == buffers_per_slab) {
+		partial.erase(partial.iterator_to(slab));
+		full.push_front(slab);
+	}
+
+	++n_allocated;
+
+	PoisonUndefined(p, buffer_size);
+	return p;
+}
+
+void
+SlabBufferPool::Free(void *p) noexcept
+{
+	assert(p != nullptr);
+	assert(n_allocated > 0);
+
+	/* find the slab with the highest address not above p */
+	Slab key((char *)p, 0);
+	auto i = slabs.upper_bound(key);
+	assert(i != slabs.begin());
+	--i;
+
+	Slab &slab = *i;
+	assert((char *)p >= slab.data);
+	assert((char *)p < slab.data + buffers_per_slab * buffer_size);
+	assert(slab.n_allocated > 0);
+
+	PoisonUndefined(p, buffer_size);
+
+	*(void **)p = slab.free_head;
+	slab.free_head = p;
+	--n_allocated;
+
+	if (slab.n_allocated-- == buffers_per_slab) {
+		full.erase(full.iterator_to(slab));
+		partial.push_front(slab);
+	}
+
+	if (slab.n_allocated == 0) {
+		/* this slab is unused now: keep it as the reserve or
+		   give it back to the operating system */
+		partial.erase(partial.iterator_to(slab));
+
+		if (reserve == nullptr) {
+			reserve = &slab;
+		} else {
+			slabs.erase(slabs.iterator_to(slab));
+			DeleteSlab(slab);
+		}
+	}
+}
+
+void
+SlabBufferPool::Compress() noexcept
+{
+	if (reserve != nullptr) {
+		slabs.erase(slabs.iterator_to(*reserve));
+		DeleteSlab(*reserve);
+		reserve = nullptr;
+	}
+}
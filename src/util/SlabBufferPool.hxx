@@ -0,0 +1,193 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "LargeAllocation.hxx"
+#include "Compiler.h"
+
+#include <boost/intrusive/list.hpp>
+#include <boost/intrusive/set.hpp>
+
+#include <stddef.h>
+
+/**
+ * A pool of fixed-size buffers which are carved out of large
+ * "slabs".  Free buffers are recycled, and slabs which become
+ * completely unused are returned to the operating system (except
+ * for one which is kept as a reserve).
+ *
+ * This class is not thread-safe.
+ */
+class SlabBufferPool {
+	struct Slab;
+
+	struct SlabCompare {
+		gcc_pure
+		bool operator()(const Slab &a, const Slab &b) const noexcept;
+	};
+
+	typedef boost::intrusive::list_member_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> ListHook;
+	typedef boost::intrusive::set_member_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> SetHook;
+
+	struct Slab {
+		ListHook list_hook;
+		SetHook set_hook;
+
+		char *const data;
+
+		/**
+		 * The size of #data as returned by AllocateLarge().
+		 */
+		const size_t size;
+
+		/**
+		 * A singly-linked list of free buffers; the "next"
+		 * pointer is stored inside the buffer.
+		 */
+		void *free_head = nullptr;
+
+		/**
+		 * The number of buffers which have never been
+		 * allocated; they are located at the end of #data
+		 * (after all others).
+		 */
+		unsigned n_fresh;
+
+		unsigned n_allocated = 0;
+
+		Slab(char *_data, unsigned n, size_t _size=0) noexcept
+			:data(_data), size(_size), n_fresh(n) {}
+	};
+
+	typedef boost::intrusive::list<Slab,
+				       boost::intrusive::member_hook<Slab, ListHook, &Slab::list_hook>,
+				       boost::intrusive::constant_time_size<false>> SlabList;
+
+	typedef boost::intrusive::set<Slab,
+				      boost::intrusive::member_hook<Slab, SetHook, &Slab::set_hook>,
+				      boost::intrusive::compare<SlabCompare>,
+				      boost::intrusive::constant_time_size<true>> SlabSet;
+
+	const size_t buffer_size;
+	const unsigned buffers_per_slab;
+
+	const LargeAllocationOptions allocation_options;
+
+	/**
+	 * Slabs which have at least one free buffer.
+	 */
+	SlabList partial;
+
+	/**
+	 * Slabs without a free buffer.
+	 */
+	SlabList full;
+
+	/**
+	 * All slabs, ordered by address; used by Free() to look up
+	 * the slab a buffer belongs to.
+	 */
+	SlabSet slabs;
+
+	/**
+	 * A completely unused slab which is kept around to avoid
+	 * trashing when the number of buffers hovers around a slab
+	 * boundary.  It is not in #partial.
+	 */
+	Slab *reserve = nullptr;
+
+	size_t n_allocated = 0;
+
+public:
+	/**
+	 * @param _buffer_size the size of each buffer; should be a
+	 * multiple of the page size
+	 * @param _buffers_per_slab the number of buffers allocated at
+	 * a time; slabs of at least #HUGE_PAGE_SIZE bytes are
+	 * backed by huge pages as specified by @_options
+	 * @param _options how slabs are allocated; if
+	 * LargeAllocationOptions::numa_local is set, slabs are bound
+	 * to the NUMA node of the thread calling Allocate()
+	 */
+	explicit SlabBufferPool(size_t _buffer_size,
+				unsigned _buffers_per_slab=64,
+				LargeAllocationOptions _options={}) noexcept
+		:buffer_size(_buffer_size),
+		 buffers_per_slab(_buffers_per_slab),
+		 allocation_options(_options) {}
+
+	~SlabBufferPool() noexcept;
+
+	SlabBufferPool(const SlabBufferPool &) = delete;
+	SlabBufferPool &operator=(const SlabBufferPool &) = delete;
+
+	size_t GetBufferSize() const noexcept {
+		return buffer_size;
+	}
+
+	/**
+	 * Returns the number of buffers currently handed out.
+	 */
+	size_t GetAllocatedCount() const noexcept {
+		return n_allocated;
+	}
+
+	/**
+	 * Returns the number of bytes allocated from the operating
+	 * system.
+	 */
+	size_t GetFootprint() const noexcept {
+		return slabs.size() * buffers_per_slab * buffer_size;
+	}
+
+	/**
+	 * Allocate a buffer of GetBufferSize() bytes.
+	 *
+	 * Throws std::bad_alloc on error.
+	 */
+	void *Allocate();
+
+	/**
+	 * Return a buffer obtained from Allocate() to the pool.
+	 */
+	void Free(void *p) noexcept;
+
+	/**
+	 * Return the reserve slab to the operating system.
+	 */
+	void Compress() noexcept;
+
+private:
+	Slab &AddSlab();
+	void DeleteSlab(Slab &slab) noexcept;
+};
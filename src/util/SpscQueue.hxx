@@ -0,0 +1,168 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include <assert.h>
+#include <stddef.h>
+
+/**
+ * A bounded lock-free single-producer/single-consumer queue.  The
+ * slots are allocated once by the constructor and reused; the
+ * producer fills a slot in place (Reserve(), Commit()) and the
+ * consumer reads it in place (Front(), Pop()), so no element is ever
+ * copied or moved by this class.
+ *
+ * Exactly one thread may call the producer methods and exactly one
+ * (other) thread may call the consumer methods.
+ */
+template<typename T>
+class SpscQueue {
+	/**
+	 * The capacity minus one (a power of two minus one).
+	 */
+	const size_t mask;
+
+	const std::unique_ptr<T[]> slots;
+
+	/* the members used mostly by the consumer */
+
+	/**
+	 * The index of the next slot to be read; written only by the
+	 * consumer.
+	 */
+	std::atomic<size_t> head{0};
+
+	/**
+	 * The consumer's cached copy of #tail, to avoid touching the
+	 * producer's cache line on every pop.
+	 */
+	size_t cached_tail = 0;
+
+	/**
+	 * Keep the consumer's and the producer's members in
+	 * different cache lines.
+	 */
+	char padding[64];
+
+	/* the members used mostly by the producer */
+
+	/**
+	 * The index of the next slot to be written; written only by
+	 * the producer.
+	 */
+	std::atomic<size_t> tail{0};
+
+	/**
+	 * The producer's cached copy of #head.
+	 */
+	size_t cached_head = 0;
+
+public:
+	/**
+	 * @param capacity the maximum number of elements; must be a
+	 * power of two
+	 */
+	explicit SpscQueue(size_t capacity)
+		:mask(capacity - 1), slots(new T[capacity]) {
+		assert(capacity > 0);
+		assert((capacity & mask) == 0);
+	}
+
+	SpscQueue(const SpscQueue &) = delete;
+	SpscQueue &operator=(const SpscQueue &) = delete;
+
+	size_t capacity() const noexcept {
+		return mask + 1;
+	}
+
+	/**
+	 * Returns the number of elements.  May be called from any
+	 * thread, but the result is only a snapshot.
+	 */
+	size_t size() const noexcept {
+		return tail.load(std::memory_order_relaxed) -
+			head.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Producer: obtain the next free slot, or nullptr if the
+	 * queue is full.  The slot contains whatever value was left
+	 * there previously.  It becomes visible to the consumer with
+	 * Commit().
+	 */
+	T *Reserve() noexcept {
+		const size_t t = tail.load(std::memory_order_relaxed);
+		if (t - cached_head > mask) {
+			cached_head = head.load(std::memory_order_acquire);
+			if (t - cached_head > mask)
+				return nullptr;
+		}
+
+		return &slots[t & mask];
+	}
+
+	/**
+	 * Producer: publish the slot returned by Reserve().
+	 */
+	void Commit() noexcept {
+		const size_t t = tail.load(std::memory_order_relaxed);
+		tail.store(t + 1, std::memory_order_release);
+	}
+
+	/**
+	 * Consumer: obtain the oldest element, or nullptr if the
+	 * queue is empty.
+	 */
+	T *Front() noexcept {
+		const size_t h = head.load(std::memory_order_relaxed);
+		if (h == cached_tail) {
+			cached_tail = tail.load(std::memory_order_acquire);
+			if (h == cached_tail)
+				return nullptr;
+		}
+
+		return &slots[h & mask];
+	}
+
+	/**
+	 * Consumer: release the element returned by Front().
+	 */
+	void Pop() noexcept {
+		const size_t h = head.load(std::memory_order_relaxed);
+		assert(h != tail.load(std::memory_order_relaxed));
+		head.store(h + 1, std::memory_order_release);
+	}
+};
@@ -0,0 +1,400 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * String formatting with a format string which is parsed and
+ * checked at compile time.  The format string is split into
+ * literal chunks of constant length and typed placeholders; no
+ * parsing happens at runtime, and nothing is allocated.
+ *
+ * Syntax: "{}" inserts the next argument, "{:x}" inserts an integer
+ * as lower-case hexadecimal, "{{" and "}}" are literal braces.
+ *
+ * Supported argument types: integers, char, bool, const char *
+ * (nullptr is formatted as "(null)") and #StringView.
+ *
+ *     char buffer[64];
+ *     StaticFormat(buffer, sizeof(buffer),
+ *                  STATIC_FORMAT("spawn:{}:{}"), pid, name);
+ */
+
+#pragma once
+
+#include "StringBuffer.hxx"
+#include "StringView.hxx"
+#include "Compiler.h"
+
+#include <type_traits>
+#include <utility>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace StaticFormatDetail {
+
+/**
+ * Base class of all types created by STATIC_FORMAT().
+ */
+struct FormatString {};
+
+enum class Token {
+	END,
+
+	/**
+	 * "{{" or "}}".
+	 */
+	ESCAPE,
+
+	/**
+	 * "{}".
+	 */
+	DEFAULT,
+
+	/**
+	 * "{:x}".
+	 */
+	HEX,
+
+	INVALID,
+};
+
+constexpr size_t
+FindBrace(const char *s, size_t i) noexcept
+{
+	while (s[i] != 0 && s[i] != '{' && s[i] != '}')
+		++i;
+	return i;
+}
+
+constexpr Token
+Classify(const char *s, size_t i) noexcept
+{
+	if (s[i] == 0)
+		return Token::END;
+
+	if (s[i] == '}')
+		return s[i + 1] == '}' ? Token::ESCAPE : Token::INVALID;
+
+	if (s[i + 1] == '{')
+		return Token::ESCAPE;
+
+	if (s[i + 1] == '}')
+		return Token::DEFAULT;
+
+	if (s[i + 1] == ':' && s[i + 2] == 'x' && s[i + 3] == '}')
+		return Token::HEX;
+
+	return Token::INVALID;
+}
+
+constexpr size_t
+GetTokenLength(Token token) noexcept
+{
+	return token == Token::HEX ? 4 : 2;
+}
+
+/**
+ * Count the placeholders.
+ *
+ * @return the number of placeholders or -1 if the format string is
+ * malformed
+ */
+constexpr int
+CountPlaceholders(const char *s) noexcept
+{
+	int n = 0;
+	size_t i = 0;
+
+	while (true) {
+		i = FindBrace(s, i);
+		const Token token = Classify(s, i);
+		switch (token) {
+		case Token::END:
+			return n;
+
+		case Token::INVALID:
+			return -1;
+
+		case Token::ESCAPE:
+			break;
+
+		case Token::DEFAULT:
+		case Token::HEX:
+			++n;
+			break;
+		}
+
+		i += GetTokenLength(token);
+	}
+}
+
+/**
+ * Appends to a buffer, silently truncating.  One byte is reserved
+ * for the null terminator.
+ */
+class Writer {
+	char *p;
+	char *const end;
+
+public:
+	Writer(char *_p, size_t size) noexcept
+		:p(_p), end(_p + size - 1) {}
+
+	char *GetPosition() const noexcept {
+		return p;
+	}
+
+	void Append(char ch) noexcept {
+		if (p < end)
+			*p++ = ch;
+	}
+
+	gcc_always_inline
+	void Append(const char *s, size_t length) noexcept {
+		if (gcc_unlikely(length > size_t(end - p)))
+			length = end - p;
+		memcpy(p, s, length);
+		p += length;
+	}
+
+	void AppendDecimal(uint64_t value) noexcept {
+		char buffer[20];
+		char *q = buffer + sizeof(buffer);
+		do {
+			*--q = '0' + char(value % 10);
+			value /= 10;
+		} while (value != 0);
+
+		Append(q, buffer + sizeof(buffer) - q);
+	}
+
+	void AppendHex(uint64_t value) noexcept {
+		char buffer[16];
+		char *q = buffer + sizeof(buffer);
+		do {
+			*--q = "0123456789abcdef"[value & 0xf];
+			value >>= 4;
+		} while (value != 0);
+
+		Append(q, buffer + sizeof(buffer) - q);
+	}
+};
+
+template<typename T>
+using IsInteger = std::integral_constant<bool,
+					 std::is_integral<T>::value &&
+					 !std::is_same<T, char>::value &&
+					 !std::is_same<T, bool>::value>;
+
+template<typename T>
+static inline typename std::enable_if<IsInteger<T>::value &&
+				      std::is_signed<T>::value>::type
+AppendArgument(Writer &w, T value) noexcept
+{
+	if (value < 0) {
+		w.Append('-');
+		w.AppendDecimal(-uint64_t(value));
+	} else
+		w.AppendDecimal(value);
+}
+
+template<typename T>
+static inline typename std::enable_if<IsInteger<T>::value &&
+				      std::is_unsigned<T>::value>::type
+AppendArgument(Writer &w, T value) noexcept
+{
+	w.AppendDecimal(value);
+}
+
+static inline void
+AppendArgument(Writer &w, char ch) noexcept
+{
+	w.Append(ch);
+}
+
+static inline void
+AppendArgument(Writer &w, bool value) noexcept
+{
+	if (value)
+		w.Append("true", 4);
+	else
+		w.Append("false", 5);
+}
+
+static inline void
+AppendArgument(Writer &w, StringView s) noexcept
+{
+	w.Append(s.data, s.size);
+}
+
+static inline void
+AppendArgument(Writer &w, const char *s) noexcept
+{
+	if (s == nullptr)
+		s = "(null)";
+
+	w.Append(s, strlen(s));
+}
+
+template<typename T>
+static inline void
+AppendHexArgument(Writer &w, T value) noexcept
+{
+	static_assert(IsInteger<T>::value, "{:x} requires an integer");
+	w.AppendHex(typename std::make_unsigned<T>::type(value));
+}
+
+/**
+ * Emit the literal chunk starting at #pos and the following token.
+ * The chunk length is a compile-time constant.
+ */
+template<typename S, size_t pos>
+struct Step {
+	static constexpr size_t brace = FindBrace(S::Get(), pos);
+	static constexpr Token token = Classify(S::Get(), brace);
+	static constexpr size_t next = brace + GetTokenLength(token);
+
+	template<typename... Args>
+	static void Apply(Writer &w, Args&&... args) noexcept {
+		ApplyToken(w, std::integral_constant<Token, token>(),
+			   std::forward<Args>(args)...);
+	}
+
+private:
+	template<typename... Args>
+	static void ApplyToken(Writer &w,
+			       std::integral_constant<Token, Token::END>,
+			  Args&&...) noexcept {
+		w.Append(S::Get() + pos, brace - pos);
+	}
+
+	template<typename... Args>
+	static void ApplyToken(Writer &,
+			       std::integral_constant<Token, Token::INVALID>,
+			  Args&&...) noexcept {
+	}
+
+	template<typename... Args>
+	static void ApplyToken(Writer &w,
+			       std::integral_constant<Token, Token::ESCAPE>,
+			  Args&&... args) noexcept {
+		/* include the first brace of the pair */
+		w.Append(S::Get() + pos, brace + 1 - pos);
+		Step<S, next>::Apply(w, std::forward<Args>(args)...);
+	}
+
+	static void ApplyToken(Writer &,
+			       std::integral_constant<Token, Token::DEFAULT>) noexcept {
+	}
+
+	template<typename First, typename... Args>
+	static void ApplyToken(Writer &w,
+			       std::integral_constant<Token, Token::DEFAULT>,
+			       First &&first, Args&&... args) noexcept {
+		w.Append(S::Get() + pos, brace - pos);
+		AppendArgument(w, std::forward<First>(first));
+		Step<S, next>::Apply(w, std::forward<Args>(args)...);
+	}
+
+	static void ApplyToken(Writer &,
+			       std::integral_constant<Token, Token::HEX>) noexcept {
+	}
+
+	template<typename First, typename... Args>
+	static void ApplyToken(Writer &w,
+			       std::integral_constant<Token, Token::HEX>,
+			       First &&first, Args&&... args) noexcept {
+		w.Append(S::Get() + pos, brace - pos);
+		AppendHexArgument(w, first);
+		Step<S, next>::Apply(w, std::forward<Args>(args)...);
+	}
+};
+
+} // namespace StaticFormatDetail
+
+/**
+ * Create a compile-time format string for StaticFormat().  Each call
+ * produces a distinct type which carries the string.
+ */
+#define STATIC_FORMAT(s) \
+	[]{ \
+		struct _StaticFormatString : StaticFormatDetail::FormatString { \
+			static constexpr const char *Get() noexcept { \
+				return s; \
+			} \
+		}; \
+		return _StaticFormatString(); \
+	}()
+
+template<typename S>
+using IsStaticFormatString =
+	std::is_base_of<StaticFormatDetail::FormatString, S>;
+
+/**
+ * Format into the given buffer, truncating the result if it does
+ * not fit.  The result is always null-terminated.
+ *
+ * @param size the size of the buffer including the null terminator;
+ * must not be 0
+ * @return the length of the result (without the null terminator)
+ */
+template<typename S, typename... Args>
+static inline typename std::enable_if<IsStaticFormatString<S>::value, size_t>::type
+StaticFormat(char *buffer, size_t size, S, Args&&... args) noexcept
+{
+	static_assert(StaticFormatDetail::CountPlaceholders(S::Get()) >= 0,
+		      "Malformed format string");
+	static_assert(StaticFormatDetail::CountPlaceholders(S::Get()) == int(sizeof...(Args)),
+		      "Wrong number of arguments for format string");
+
+	StaticFormatDetail::Writer w(buffer, size);
+	StaticFormatDetail::Step<S, 0>::Apply(w, std::forward<Args>(args)...);
+	*w.GetPosition() = 0;
+	return w.GetPosition() - buffer;
+}
+
+template<size_t CAPACITY, typename S, typename... Args>
+static inline typename std::enable_if<IsStaticFormatString<S>::value, size_t>::type
+StaticFormat(StringBuffer<CAPACITY> &buffer, S s, Args&&... args) noexcept
+{
+	return StaticFormat(buffer.data(), buffer.capacity(), s,
+			    std::forward<Args>(args)...);
+}
+
+template<size_t CAPACITY, typename S, typename... Args>
+static inline typename std::enable_if<IsStaticFormatString<S>::value,
+				      StringBuffer<CAPACITY>>::type
+StaticFormat(S s, Args&&... args) noexcept
+{
+	StringBuffer<CAPACITY> result;
+	StaticFormat(result, s, std::forward<Args>(args)...);
+	return result;
+}
@@ -32,6 +32,8 @@
 
 #include <array>
 
+#include <stddef.h>
+
 /**
  * A statically allocated string buffer.
  */
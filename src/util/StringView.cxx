@@ -29,21 +29,58 @@
 
 #include "StringView.hxx"
 #include "CharUtil.hxx"
+#include "SimdString.hxx"
+
+template<typename T>
+static const T *
+SkipWhitespace(const T *p, const T *end) noexcept
+{
+	while (p < end && IsWhitespaceOrNull(*p))
+		++p;
+	return p;
+}
+
+static const char *
+SkipWhitespace(const char *p, const char *end) noexcept
+{
+	return SimdSkipWhitespace(p, end);
+}
+
+template<typename T>
+static const T *
+SkipWhitespaceReverse(const T *begin, const T *end) noexcept
+{
+	while (end > begin && IsWhitespaceOrNull(end[-1]))
+		--end;
+	return end;
+}
+
+static const char *
+SkipWhitespaceReverse(const char *begin, const char *end) noexcept
+{
+	return SimdSkipWhitespaceReverse(begin, end);
+}
 
 template<typename T>
 void
 BasicStringView<T>::StripLeft() noexcept
 {
-	while (!empty() && IsWhitespaceOrNull(front()))
-		pop_front();
+	if (empty())
+		return;
+
+	const auto *new_data = SkipWhitespace(data, data + size);
+	size -= new_data - data;
+	data = new_data;
 }
 
 template<typename T>
 void
 BasicStringView<T>::StripRight() noexcept
 {
-	while (!empty() && IsWhitespaceOrNull(back()))
-		pop_back();
+	if (empty())
+		return;
+
+	size = SkipWhitespaceReverse(data, data + size) - data;
 }
 
 template struct BasicStringView<char>;
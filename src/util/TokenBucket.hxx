@@ -0,0 +1,83 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <algorithm>
+
+/**
+ * A token bucket rate limiter.  The caller provides the current time
+ * (in seconds, from a monotonic clock), the rate (tokens per second)
+ * and the burst size (the maximum number of tokens which can
+ * accumulate).
+ *
+ * Instead of storing the number of tokens, this class stores the
+ * (virtual) time at which the bucket was empty; this way, no
+ * periodic refill is needed.
+ */
+class TokenBucket {
+	double zero_time = 0;
+
+public:
+	/**
+	 * Attempt to take the given number of tokens.
+	 *
+	 * @return true on success, false if there are not enough
+	 * tokens (and none were taken)
+	 */
+	bool Check(double now, double rate, double burst,
+		   double size=1) noexcept {
+		double available = std::min((now - zero_time) * rate, burst);
+		if (available < size)
+			return false;
+
+		available -= size;
+		zero_time = now - available / rate;
+		return true;
+	}
+
+	/**
+	 * Returns the number of seconds until the given number of
+	 * tokens will be available (0 if they are available right
+	 * now).
+	 */
+	double GetDelay(double now, double rate, double size=1) const noexcept {
+		const double available = (now - zero_time) * rate;
+		return available >= size
+			? 0.
+			: (size - available) / rate;
+	}
+
+	void Reset() noexcept {
+		zero_time = 0;
+	}
+};
@@ -280,6 +280,12 @@ public:
 		append() = T(std::forward<Args>(args)...);
 	}
 
+	void pop_back() {
+		assert(the_size > 0);
+
+		--the_size;
+	}
+
 	T &front() {
 		assert(the_size > 0);
 
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "WorkStealingPool.hxx"
+
+#include <assert.h>
+
+/**
+ * The pool and the worker index of the calling thread, if it is a
+ * worker thread.
+ */
+static thread_local const WorkStealingPool *current_pool;
+static thread_local unsigned current_index;
+
+WorkStealingPool::WorkStealingPool(unsigned n_threads)
+{
+	if (n_threads == 0) {
+		n_threads = std::thread::hardware_concurrency();
+		if (n_threads == 0)
+			n_threads = 1;
+	}
+
+	workers.reserve(n_threads);
+	for (unsigned i = 0; i < n_threads; ++i)
+		workers.emplace_back(new Worker());
+
+	try {
+		for (unsigned i = 0; i < n_threads; ++i)
+			workers[i]->thread = std::thread(&WorkStealingPool::Run,
+							 this, i);
+	} catch (...) {
+		Stop();
+		throw;
+	}
+}
+
+WorkStealingPool::~WorkStealingPool() noexcept
+{
+	Stop();
+}
+
+void
+WorkStealingPool::Stop() noexcept
+{
+	{
+		const std::lock_guard<std::mutex> lock(wake_mutex);
+		quit = true;
+	}
+
+	wake_cond.notify_all();
+
+	for (auto &i : workers)
+		if (i->thread.joinable())
+			i->thread.join();
+
+	assert(n_queued.load() == 0);
+}
+
+void
+WorkStealingPool::Submit(Job &job)
+{
+	const unsigned index = current_pool == this
+		? current_index
+		: next_worker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+
+	Worker &worker = *workers[index];
+
+	/* sequentially consistent, paired with Run(): either we see
+	   the sleeper, or the sleeper sees the new job */
+	n_queued.fetch_add(1);
+
+	try {
+		const std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.queue.push_back(&job);
+	} catch (...) {
+		n_queued.fetch_sub(1);
+		throw;
+	}
+
+	if (n_sleeping.load() > 0) {
+		{
+			const std::lock_guard<std::mutex> lock(wake_mutex);
+		}
+
+		wake_cond.notify_one();
+	}
+}
+
+inline WorkStealingPool::Job *
+WorkStealingPool::PopLocal(Worker &worker) noexcept
+{
+	const std::lock_guard<std::mutex> lock(worker.mutex);
+	if (worker.queue.empty())
+		return nullptr;
+
+	Job *job = worker.queue.front();
+	worker.queue.pop_front();
+	return job;
+}
+
+inline WorkStealingPool::Job *
+WorkStealingPool::Steal(unsigned self) noexcept
+{
+	const unsigned n = workers.size();
+	for (unsigned i = 1; i < n; ++i) {
+		Worker &victim = *workers[(self + i) % n];
+
+		const std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.queue.empty()) {
+			Job *job = victim.queue.back();
+			victim.queue.pop_back();
+			return job;
+		}
+	}
+
+	return nullptr;
+}
+
+void
+WorkStealingPool::Run(unsigned index) noexcept
+{
+	current_pool = this;
+	current_index = index;
+
+	Worker &worker = *workers[index];
+
+	while (true) {
+		Job *job = PopLocal(worker);
+		if (job == nullptr)
+			job = Steal(index);
+
+		if (job != nullptr) {
+			n_queued.fetch_sub(1, std::memory_order_relaxed);
+			job->Run();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(wake_mutex);
+		n_sleeping.fetch_add(1);
+
+		if (n_queued.load() == 0) {
+			if (quit) {
+				n_sleeping.fetch_sub(1);
+				break;
+			}
+
+			wake_cond.wait(lock);
+		}
+
+		n_sleeping.fetch_sub(1);
+	}
+
+	current_pool = nullptr;
+}
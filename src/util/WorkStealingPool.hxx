@@ -0,0 +1,149 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A pool of worker threads running CPU-bound jobs.  Each worker has
+ * its own queue; jobs submitted from outside are distributed
+ * round-robin, jobs submitted by a worker go to its own queue, and an
+ * idle worker steals jobs from the others.
+ *
+ * The pool is meant for coarse jobs (milliseconds or more, e.g. key
+ * generation or parsing a large file); the per-job overhead is a few
+ * uncontended mutex operations.
+ *
+ * All methods are thread-safe.
+ */
+class WorkStealingPool {
+public:
+	class Job {
+	public:
+		/**
+		 * Called in a worker thread.  The pool does not
+		 * touch the object after this method has been
+		 * invoked, so it may delete itself (or hand itself
+		 * over to another thread).
+		 */
+		virtual void Run() noexcept = 0;
+	};
+
+private:
+	struct Worker {
+		std::mutex mutex;
+
+		/**
+		 * The owner pops from the front (FIFO, to be fair to
+		 * submitters); thieves take from the back.
+		 */
+		std::deque<Job *> queue;
+
+		std::thread thread;
+
+		/**
+		 * Keep the mutexes of different workers in different
+		 * cache lines.
+		 */
+		char padding[64];
+	};
+
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	/**
+	 * The number of jobs in all queues.
+	 */
+	std::atomic<size_t> n_queued{0};
+
+	/**
+	 * The number of workers waiting on #wake_cond.  Submit() only
+	 * locks #wake_mutex if this is non-zero.
+	 */
+	std::atomic<unsigned> n_sleeping{0};
+
+	/**
+	 * Round-robin counter for jobs submitted from outside the
+	 * pool.
+	 */
+	std::atomic<unsigned> next_worker{0};
+
+	std::mutex wake_mutex;
+	std::condition_variable wake_cond;
+
+	/**
+	 * Protected by #wake_mutex.
+	 */
+	bool quit = false;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param n_threads the number of worker threads; 0 means one
+	 * per CPU
+	 */
+	explicit WorkStealingPool(unsigned n_threads=0);
+
+	/**
+	 * Waits for all queued jobs to finish and stops the worker
+	 * threads.
+	 */
+	~WorkStealingPool() noexcept;
+
+	WorkStealingPool(const WorkStealingPool &) = delete;
+	WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+	unsigned size() const noexcept {
+		return workers.size();
+	}
+
+	/**
+	 * Add a job to a queue.  The caller retains ownership; the
+	 * job must stay alive until its Run() method is invoked.
+	 *
+	 * Throws std::bad_alloc on error.
+	 */
+	void Submit(Job &job);
+
+private:
+	void Stop() noexcept;
+
+	Job *PopLocal(Worker &worker) noexcept;
+	Job *Steal(unsigned self) noexcept;
+	void Run(unsigned index) noexcept;
+};
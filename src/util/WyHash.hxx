@@ -0,0 +1,191 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Implementation of the wyhash function (final version 4) by Wang
+ * Yi.  It consumes 16 or 48 bytes per step, and is much faster than
+ * FNV-1a for keys longer than a few bytes.  Not suitable for
+ * cryptographic purposes.
+ *
+ * https://github.com/wangyi-fudan/wyhash
+ */
+
+#pragma once
+
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+struct WyHashAlgorithm {
+	typedef uint64_t value_type;
+
+	/* the default secret; scalars instead of an array so they
+	   don't need an out-of-class definition */
+	static constexpr uint64_t SECRET0 = 0x2d358dccaa6c78a5ull;
+	static constexpr uint64_t SECRET1 = 0x8bb84b93962eacc9ull;
+	static constexpr uint64_t SECRET2 = 0x4b33a62ed433d4a3ull;
+	static constexpr uint64_t SECRET3 = 0x4d5a2da51de1aa47ull;
+
+	/**
+	 * Multiply two 64 bit values and return the 128 bit result
+	 * in the two parameters (low, high).
+	 */
+	static void Multiply(uint64_t &a, uint64_t &b) noexcept {
+		const __uint128_t r = __uint128_t(a) * b;
+		a = uint64_t(r);
+		b = uint64_t(r >> 64);
+	}
+
+	static uint64_t Mix(uint64_t a, uint64_t b) noexcept {
+		Multiply(a, b);
+		return a ^ b;
+	}
+
+	/* unaligned little-endian loads; memcpy() compiles to a
+	   single "mov" */
+
+	static uint64_t Load8(const uint8_t *p) noexcept {
+		uint64_t v;
+		memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		v = __builtin_bswap64(v);
+#endif
+		return v;
+	}
+
+	static uint64_t Load4(const uint8_t *p) noexcept {
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		v = __builtin_bswap32(v);
+#endif
+		return v;
+	}
+
+	/**
+	 * Load 1 to 3 bytes.
+	 */
+	static uint64_t Load3(const uint8_t *p, size_t size) noexcept {
+		return (uint64_t(p[0]) << 16) | (uint64_t(p[size >> 1]) << 8) |
+			p[size - 1];
+	}
+
+	gcc_pure gcc_hot
+	static value_type BinaryHash(const void *_p, size_t size,
+				     uint64_t seed=0) noexcept {
+		const auto *p = (const uint8_t *)_p;
+		seed ^= Mix(seed ^ SECRET0, SECRET1);
+
+		uint64_t a, b;
+		if (gcc_likely(size <= 16)) {
+			if (gcc_likely(size >= 4)) {
+				/* two (possibly overlapping) pairs of 4
+				   byte loads cover the whole key */
+				const size_t delta = (size >> 3) << 2;
+				a = (Load4(p) << 32) | Load4(p + delta);
+				b = (Load4(p + size - 4) << 32) |
+					Load4(p + size - 4 - delta);
+			} else if (gcc_likely(size > 0)) {
+				a = Load3(p, size);
+				b = 0;
+			} else
+				a = b = 0;
+		} else {
+			size_t i = size;
+			if (gcc_unlikely(i >= 48)) {
+				/* three independent lanes */
+				uint64_t see1 = seed, see2 = seed;
+				do {
+					seed = Mix(Load8(p) ^ SECRET1,
+						   Load8(p + 8) ^ seed);
+					see1 = Mix(Load8(p + 16) ^ SECRET2,
+						   Load8(p + 24) ^ see1);
+					see2 = Mix(Load8(p + 32) ^ SECRET3,
+						   Load8(p + 40) ^ see2);
+					p += 48;
+					i -= 48;
+				} while (gcc_likely(i >= 48));
+
+				seed ^= see1 ^ see2;
+			}
+
+			while (gcc_unlikely(i > 16)) {
+				seed = Mix(Load8(p) ^ SECRET1,
+					   Load8(p + 8) ^ seed);
+				i -= 16;
+				p += 16;
+			}
+
+			/* the last 16 bytes, possibly overlapping
+			   with the previous step */
+			a = Load8(p + i - 16);
+			b = Load8(p + i - 8);
+		}
+
+		a ^= SECRET1;
+		b ^= seed;
+		Multiply(a, b);
+		return Mix(a ^ SECRET0 ^ size, b ^ SECRET1);
+	}
+
+	gcc_pure gcc_hot
+	static value_type StringHash(const char *s) noexcept {
+		return BinaryHash(s, strlen(s));
+	}
+};
+
+gcc_pure gcc_hot
+inline uint64_t
+WyHash64(const char *s) noexcept
+{
+	return WyHashAlgorithm::StringHash(s);
+}
+
+gcc_pure gcc_hot
+inline uint64_t
+WyHash64(const void *p, size_t size, uint64_t seed=0) noexcept
+{
+	return WyHashAlgorithm::BinaryHash(p, size, seed);
+}
+
+gcc_pure gcc_hot
+inline uint32_t
+WyHashFold32(const char *s) noexcept
+{
+	const uint64_t h64 = WyHash64(s);
+
+	/* XOR folding */
+	const uint_fast32_t lo(h64);
+	const uint_fast32_t hi(h64 >> 32);
+	return lo ^ hi;
+}
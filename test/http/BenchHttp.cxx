@@ -0,0 +1,248 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Microbenchmarks for the HTTP helpers on realistic header values.
+ * Run with "meson test --benchmark" or directly; an optional argument
+ * specifies the minimum duration of each measurement in seconds.
+ */
+
+#include "http/Date.hxx"
+#include "http/HeaderId.hxx"
+#include "http/HeaderName.hxx"
+#include "http/List.hxx"
+#include "http/Method.h"
+#include "http/Range.hxx"
+#include "http/Status.h"
+#include "util/StringView.hxx"
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+using std::chrono::system_clock;
+
+/**
+ * Prevent the compiler from optimizing away a result.
+ */
+static volatile uint64_t sink;
+
+template<typename T, typename F>
+static void
+Measure(const char *what, const std::vector<T> &corpus, double min_seconds,
+        F &&f)
+{
+    using clock = std::chrono::steady_clock;
+
+    uint64_t n = 0;
+    const auto start = clock::now();
+    std::chrono::duration<double> elapsed;
+
+    do {
+        for (const auto &i : corpus)
+            f(i);
+        n += corpus.size();
+        elapsed = clock::now() - start;
+    } while (elapsed.count() < min_seconds);
+
+    printf("%-28s %7.1f ns/op\n", what, elapsed.count() * 1e9 / n);
+}
+
+static std::vector<std::string>
+MakeDates(std::mt19937 &rng)
+{
+    std::vector<std::string> dates;
+    char buffer[30];
+    for (unsigned i = 0; i < 256; ++i) {
+        http_date_format_r(buffer,
+                           system_clock::from_time_t(1000000000 + rng() % 1000000000));
+        dates.emplace_back(buffer);
+    }
+
+    return dates;
+}
+
+/**
+ * Header names in the mix of a typical browser request and backend
+ * response, including some which are not well-known.
+ */
+static const std::vector<std::string> header_names = {
+    "host", "user-agent", "accept", "accept-language", "accept-encoding",
+    "referer", "cookie", "connection", "upgrade-insecure-requests",
+    "if-modified-since", "if-none-match", "cache-control", "x-forwarded-for",
+    "content-type", "content-length", "date", "server", "etag",
+    "last-modified", "set-cookie", "vary", "transfer-encoding",
+    "x-request-id", "x-powered-by", "sec-fetch-mode", "dnt",
+};
+
+static const std::vector<std::string> header_names_mixed_case = {
+    "Host", "User-Agent", "Accept", "Accept-Language", "Accept-Encoding",
+    "Referer", "Cookie", "Connection", "Upgrade-Insecure-Requests",
+    "If-Modified-Since", "If-None-Match", "Cache-Control", "X-Forwarded-For",
+    "Content-Type", "Content-Length", "Date", "Server", "ETag",
+    "Last-Modified", "Set-Cookie", "Vary", "Transfer-Encoding",
+    "X-Request-ID", "X-Powered-By", "Sec-Fetch-Mode", "DNT",
+};
+
+static const std::vector<std::string> list_headers = {
+    "gzip, deflate, br",
+    "gzip, deflate",
+    "br;q=1.0, gzip;q=0.8, *;q=0.1",
+    "keep-alive",
+    "keep-alive, Upgrade",
+    "close",
+    "no-cache",
+    "max-age=0",
+    "private, no-cache, no-store, must-revalidate, max-age=0",
+    "public, max-age=31536000, immutable",
+    "de-DE,de;q=0.9,en-US;q=0.8,en;q=0.7",
+};
+
+static const std::vector<std::string> range_headers = {
+    "bytes=0-",
+    "bytes=0-1023",
+    "bytes=1048576-",
+    "bytes=-500",
+    "bytes=0-65535",
+    "bytes=500-999, 7000-7999",
+    "bytes=0-0,-1",
+    "bytes=100-199,300-399,500-599,700-799",
+};
+
+static const std::vector<std::string> methods = {
+    "GET", "GET", "GET", "GET", "POST", "HEAD", "GET", "PUT",
+    "OPTIONS", "GET", "DELETE", "PROPFIND", "GET", "PATCH", "FOO",
+};
+
+static const std::vector<http_status_t> statuses = {
+    HTTP_STATUS_OK, HTTP_STATUS_OK, HTTP_STATUS_OK, HTTP_STATUS_NOT_MODIFIED,
+    HTTP_STATUS_OK, HTTP_STATUS_FOUND, HTTP_STATUS_NOT_FOUND,
+    HTTP_STATUS_PARTIAL_CONTENT, HTTP_STATUS_OK,
+    HTTP_STATUS_INTERNAL_SERVER_ERROR, HTTP_STATUS_NO_CONTENT,
+};
+
+int
+main(int argc, char **argv)
+{
+    const double min_seconds = argc > 1 ? strtod(argv[1], nullptr) : 0.5;
+
+    std::mt19937 rng(42);
+    const auto dates = MakeDates(rng);
+
+    std::vector<system_clock::time_point> times;
+    for (const auto &i : dates)
+        times.push_back(http_date_parse(i.c_str()));
+
+    Measure("http_date_format_r", times, min_seconds,
+            [](system_clock::time_point t){
+                char buffer[30];
+                http_date_format_r(buffer, t);
+                sink += buffer[6];
+            });
+
+    /* a busy server formats the same second over and over */
+    const std::vector<system_clock::time_point> same_second(256, times.front());
+    Measure("http_date_format_cached", same_second, min_seconds,
+            [](system_clock::time_point t){
+                sink += *http_date_format_cached(t);
+            });
+
+    Measure("http_date_parse", dates, min_seconds,
+            [](const std::string &s){
+                sink += system_clock::to_time_t(http_date_parse(s.c_str()));
+            });
+
+    Measure("http_header_name_valid", header_names, min_seconds,
+            [](const std::string &s){
+                sink += http_header_name_valid(s.c_str());
+            });
+
+    Measure("http_header_is_hop_by_hop", header_names, min_seconds,
+            [](const std::string &s){
+                sink += http_header_is_hop_by_hop(s.c_str());
+            });
+
+    Measure("http_header_lookup", header_names, min_seconds,
+            [](const std::string &s){
+                sink += unsigned(http_header_lookup({s.data(), s.size()}));
+            });
+
+    Measure("http_header_lookup (case)", header_names_mixed_case, min_seconds,
+            [](const std::string &s){
+                sink += unsigned(http_header_lookup({s.data(), s.size()}));
+            });
+
+    Measure("http_list_contains_i x3", list_headers, min_seconds,
+            [](const std::string &s){
+                sink += http_list_contains_i(s.c_str(), "gzip") +
+                    http_list_contains_i(s.c_str(), "close") +
+                    http_list_contains_i(s.c_str(), "no-store");
+            });
+
+    Measure("HttpListTokens x3", list_headers, min_seconds,
+            [](const std::string &s){
+                const HttpListTokens tokens({s.data(), s.size()});
+                sink += tokens.ContainsIgnoreCase("gzip") +
+                    tokens.ContainsIgnoreCase("close") +
+                    tokens.ContainsIgnoreCase("no-store");
+            });
+
+    Measure("HttpListTokens::GetQuality", list_headers, min_seconds,
+            [](const std::string &s){
+                const HttpListTokens tokens({s.data(), s.size()});
+                sink += tokens.GetQuality("gzip");
+            });
+
+    Measure("ParseRangeHeader", range_headers, min_seconds,
+            [](const std::string &s){
+                HttpRangeRequest request(10000000);
+                request.ParseRangeHeader(s.c_str());
+                sink += request.skip + request.ranges.size();
+            });
+
+    Measure("http_method_parse", methods, min_seconds,
+            [](const std::string &s){
+                sink += http_method_parse(s.data(), s.size());
+            });
+
+    Measure("http_status_to_line", statuses, min_seconds,
+            [](http_status_t status){
+                sink += http_status_to_line(status).length;
+            });
+
+    return EXIT_SUCCESS;
+}
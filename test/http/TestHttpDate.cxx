@@ -0,0 +1,169 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "http/Date.hxx"
+#include "time/gmtime.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include <string.h>
+
+using std::chrono::system_clock;
+
+TEST(HttpDate, Format)
+{
+    char buffer[30];
+    http_date_format_r(buffer, system_clock::from_time_t(784111777));
+    ASSERT_STREQ(buffer, "Sun, 06 Nov 1994 08:49:37 GMT");
+
+    ASSERT_STREQ(http_date_format(system_clock::from_time_t(0)),
+                 "Thu, 01 Jan 1970 00:00:00 GMT");
+}
+
+TEST(HttpDate, Parse)
+{
+    ASSERT_EQ(http_date_parse("Sun, 06 Nov 1994 08:49:37 GMT"),
+              system_clock::from_time_t(784111777));
+    ASSERT_EQ(http_date_parse("Sun, 06 Foo 1994 08:49:37 GMT"),
+              system_clock::from_time_t(-1));
+    ASSERT_EQ(http_date_parse("Sun, 06 Nov 1994"),
+              system_clock::from_time_t(-1));
+
+    /* obsolete formats (RFC 7231 7.1.1.1) */
+    ASSERT_EQ(http_date_parse("Sunday, 06-Nov-94 08:49:37 GMT"),
+              system_clock::from_time_t(784111777));
+    ASSERT_EQ(http_date_parse("Wednesday, 01-Mar-00 00:00:00 GMT"),
+              system_clock::from_time_t(951868800));
+    ASSERT_EQ(http_date_parse("Sun Nov  6 08:49:37 1994"),
+              system_clock::from_time_t(784111777));
+    ASSERT_EQ(http_date_parse("Wed Mar 01 00:00:00 2000"),
+              system_clock::from_time_t(951868800));
+
+    /* leap years and month lengths */
+    ASSERT_EQ(http_date_parse("Tue, 29 Feb 2000 23:59:59 GMT"),
+              system_clock::from_time_t(951868799));
+    ASSERT_EQ(http_date_parse("Thu, 01 Jan 1970 00:00:00 GMT"),
+              system_clock::from_time_t(0));
+    ASSERT_EQ(http_date_parse("Thu, 29 Feb 2001 00:00:00 GMT"),
+              system_clock::from_time_t(-1));
+    ASSERT_EQ(http_date_parse("Thu, 31 Apr 2001 00:00:00 GMT"),
+              system_clock::from_time_t(-1));
+
+    /* malformed */
+    ASSERT_EQ(http_date_parse("Sun, 06 Nov 1994 24:00:00 GMT"),
+              system_clock::from_time_t(-1));
+    ASSERT_EQ(http_date_parse("Sun, 06 Nov 1994 08:49:37 UTC"),
+              system_clock::from_time_t(-1));
+    ASSERT_EQ(http_date_parse("Sunday, 06 Nov 94 08:49:37 GMT"),
+              system_clock::from_time_t(-1));
+    ASSERT_EQ(http_date_parse("Sun Nov  x 08:49:37 1994"),
+              system_clock::from_time_t(-1));
+    ASSERT_EQ(http_date_parse("Sunday, 06-Nov-94 08:49:37"),
+              system_clock::from_time_t(-1));
+}
+
+TEST(HttpDate, RoundTrip)
+{
+    char buffer[30];
+    for (time_t t = 0; t < 4102444800; t += 86400 * 7 + 3607) {
+        http_date_format_r(buffer, system_clock::from_time_t(t));
+        ASSERT_EQ(http_date_parse(buffer), system_clock::from_time_t(t))
+            << buffer;
+    }
+}
+
+TEST(HttpDate, Cached)
+{
+    const auto t = system_clock::from_time_t(784111777);
+
+    const char *a = http_date_format_cached(t);
+    ASSERT_STREQ(a, "Sun, 06 Nov 1994 08:49:37 GMT");
+
+    /* same second: same buffer, same contents */
+    const char *b = http_date_format_cached(t + std::chrono::milliseconds(999));
+    ASSERT_EQ(a, b);
+    ASSERT_STREQ(b, "Sun, 06 Nov 1994 08:49:37 GMT");
+
+    ASSERT_STREQ(http_date_format_cached(t + std::chrono::seconds(1)),
+                 "Sun, 06 Nov 1994 08:49:38 GMT");
+    ASSERT_STREQ(http_date_format_cached(t - std::chrono::seconds(1)),
+                 "Sun, 06 Nov 1994 08:49:36 GMT");
+}
+
+TEST(HttpDate, Threads)
+{
+    /* each thread has its own cache */
+    const char *main_result =
+        http_date_format_cached(system_clock::from_time_t(784111777));
+
+    std::thread thread([main_result](){
+        const char *result =
+            http_date_format_cached(system_clock::from_time_t(0));
+        EXPECT_NE(result, main_result);
+        EXPECT_STREQ(result, "Thu, 01 Jan 1970 00:00:00 GMT");
+    });
+    thread.join();
+
+    ASSERT_STREQ(main_result, "Sun, 06 Nov 1994 08:49:37 GMT");
+}
+
+static void
+ExpectGmtime(time_t t)
+{
+    struct tm expected, actual;
+    gmtime_r(&t, &expected);
+    sysx_time_gmtime(t, &actual);
+
+    EXPECT_EQ(actual.tm_year, expected.tm_year) << t;
+    EXPECT_EQ(actual.tm_mon, expected.tm_mon) << t;
+    EXPECT_EQ(actual.tm_mday, expected.tm_mday) << t;
+    EXPECT_EQ(actual.tm_yday, expected.tm_yday) << t;
+    EXPECT_EQ(actual.tm_wday, expected.tm_wday) << t;
+    EXPECT_EQ(actual.tm_hour, expected.tm_hour) << t;
+    EXPECT_EQ(actual.tm_min, expected.tm_min) << t;
+    EXPECT_EQ(actual.tm_sec, expected.tm_sec) << t;
+}
+
+TEST(HttpDate, GmtimeDayCache)
+{
+    /* consecutive seconds across midnight (hitting the per-day
+       cache), including a leap day */
+    for (time_t t = 951782400 - 10; t < 951868800 + 10; t += 7)
+        ExpectGmtime(t);
+
+    /* alternate between days, invalidating the cache each time */
+    for (time_t t = 0; t < 4102444800; t += 86400 * 13 + 4001) {
+        ExpectGmtime(t);
+        ExpectGmtime(784111777);
+    }
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "http/HeaderId.hxx"
+#include "http/HeaderName.hxx"
+#include "util/StringView.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+TEST(HttpHeaderId, Lookup)
+{
+    ASSERT_EQ(http_header_lookup("content-type"), HttpHeaderId::CONTENT_TYPE);
+    ASSERT_EQ(http_header_lookup("Content-Type"), HttpHeaderId::CONTENT_TYPE);
+    ASSERT_EQ(http_header_lookup("CONTENT-TYPE"), HttpHeaderId::CONTENT_TYPE);
+    ASSERT_EQ(http_header_lookup("te"), HttpHeaderId::TE);
+    ASSERT_EQ(http_header_lookup("x-forwarded-for"),
+              HttpHeaderId::X_FORWARDED_FOR);
+
+    ASSERT_EQ(http_header_lookup(""), HttpHeaderId::UNKNOWN);
+    ASSERT_EQ(http_header_lookup("content-typ"), HttpHeaderId::UNKNOWN);
+    ASSERT_EQ(http_header_lookup("content-types"), HttpHeaderId::UNKNOWN);
+    ASSERT_EQ(http_header_lookup("x-foo"), HttpHeaderId::UNKNOWN);
+
+    /* the name does not need to be null-terminated */
+    ASSERT_EQ(http_header_lookup(StringView("hostname", 4)),
+              HttpHeaderId::HOST);
+}
+
+TEST(HttpHeaderId, RoundTrip)
+{
+    ASSERT_STREQ(http_header_name(HttpHeaderId::UNKNOWN), "");
+
+    for (size_t i = 1; i < size_t(HttpHeaderId::COUNT); ++i) {
+        const auto id = HttpHeaderId(i);
+        const char *name = http_header_name(id);
+        ASSERT_NE(*name, 0);
+        ASSERT_EQ(http_header_lookup(name), id) << name;
+
+        std::string upper(name);
+        for (auto &ch : upper)
+            ch = toupper(ch);
+        ASSERT_EQ(http_header_lookup(upper.c_str()), id) << upper;
+    }
+}
+
+TEST(HttpHeaderId, HopByHop)
+{
+    ASSERT_TRUE(http_header_is_hop_by_hop("connection"));
+    ASSERT_TRUE(http_header_is_hop_by_hop("Connection"));
+    ASSERT_TRUE(http_header_is_hop_by_hop("content-length"));
+    ASSERT_TRUE(http_header_is_hop_by_hop("transfer-encoding"));
+    ASSERT_TRUE(http_header_is_hop_by_hop("trailers"));
+    ASSERT_TRUE(http_header_is_hop_by_hop(HttpHeaderId::UPGRADE));
+    ASSERT_FALSE(http_header_is_hop_by_hop("content-type"));
+    ASSERT_FALSE(http_header_is_hop_by_hop("x-foo"));
+    ASSERT_FALSE(http_header_is_hop_by_hop(HttpHeaderId::UNKNOWN));
+}
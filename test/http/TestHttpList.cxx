@@ -34,6 +34,8 @@
 
 #include <gtest/gtest.h>
 
+#include <string>
+
 TEST(HttpListTest, Contains)
 {
     ASSERT_TRUE(http_list_contains("foo", "foo"));
@@ -46,3 +48,82 @@ TEST(HttpListTest, Contains)
     ASSERT_TRUE(http_list_contains("\"bar\",\"foo\"", "\"bar\""));
     ASSERT_TRUE(http_list_contains("\"bar\",\"foo\"", "bar"));
 }
+
+TEST(HttpListTest, Whitespace)
+{
+    ASSERT_TRUE(http_list_contains("foo, bar", "bar"));
+    ASSERT_TRUE(http_list_contains(" foo ,\tbar ", "foo"));
+    ASSERT_TRUE(http_list_contains("foo,bar", " bar "));
+    ASSERT_TRUE(!http_list_contains("", ""));
+    ASSERT_TRUE(!http_list_contains("foo,", ""));
+    ASSERT_TRUE(http_list_contains("foo,,bar", ""));
+}
+
+TEST(HttpListTest, ContainsIgnoreCase)
+{
+    ASSERT_TRUE(http_list_contains_i("Keep-Alive, Upgrade", "upgrade"));
+    ASSERT_TRUE(http_list_contains_i("keep-alive", "KEEP-ALIVE"));
+    ASSERT_TRUE(!http_list_contains_i("keep-alive", "close"));
+    ASSERT_TRUE(!http_list_contains_i("keep-alive,", ""));
+    ASSERT_TRUE(http_list_contains_i("\"Close\"", "close"));
+    ASSERT_TRUE(http_list_contains_i("x-very-long-connection-token-name,close",
+                                     "X-Very-Long-Connection-Token-Name"));
+}
+
+TEST(HttpListTest, Quoted)
+{
+    ASSERT_TRUE(http_list_contains("\"a,b\",c", "c"));
+    ASSERT_TRUE(http_list_contains("\"a,b\",c", "a,b"));
+    ASSERT_TRUE(!http_list_contains("\"a,b\",c", "a"));
+    ASSERT_TRUE(!http_list_contains("\"a,b\",c", "b"));
+    ASSERT_TRUE(http_list_contains("\"a\\\",b\",c", "c"));
+}
+
+TEST(HttpListTest, Tokens)
+{
+    const HttpListTokens connection("keep-alive, Upgrade");
+    ASSERT_TRUE(connection.ContainsIgnoreCase("upgrade"));
+    ASSERT_TRUE(connection.ContainsIgnoreCase("Keep-Alive"));
+    ASSERT_TRUE(connection.Contains("Upgrade"));
+    ASSERT_TRUE(!connection.Contains("upgrade"));
+    ASSERT_TRUE(!connection.ContainsIgnoreCase("close"));
+
+    const HttpListTokens empty("");
+    ASSERT_TRUE(!empty.Contains(""));
+    ASSERT_TRUE(!empty.ContainsIgnoreCase("foo"));
+
+    /* empty items are ignored */
+    const HttpListTokens sparse(" , foo ,, \"bar\" ,");
+    ASSERT_TRUE(sparse.Contains("foo"));
+    ASSERT_TRUE(sparse.Contains("bar"));
+    ASSERT_TRUE(!sparse.Contains(""));
+}
+
+TEST(HttpListTest, Quality)
+{
+    const HttpListTokens accept("gzip;q=0.5, deflate ; q=0 , br;level=1;Q=1.0, identity;q=0.125, x;q=2, y;q=0.1234, *;q=0.01");
+    ASSERT_EQ(accept.GetQuality("gzip"), 500);
+    ASSERT_EQ(accept.GetQuality("GZIP"), 500);
+    ASSERT_EQ(accept.GetQuality("deflate"), 0);
+    ASSERT_EQ(accept.GetQuality("br"), 1000);
+    ASSERT_EQ(accept.GetQuality("identity"), 125);
+    ASSERT_EQ(accept.GetQuality("*"), 10);
+    ASSERT_EQ(accept.GetQuality("compress"), -1);
+    ASSERT_EQ(accept.GetQuality("x"), -1);
+    ASSERT_EQ(accept.GetQuality("y"), -1);
+
+    ASSERT_EQ(HttpListTokens("text/html").GetQuality("text/html"), 1000);
+}
+
+TEST(HttpListTest, TokensOverflow)
+{
+    std::string list;
+    for (unsigned i = 0; i < 100; ++i)
+        list += "t" + std::to_string(i) + ";q=0." + std::to_string(i % 10) + ",";
+
+    const HttpListTokens tokens(list.c_str());
+    ASSERT_TRUE(tokens.Contains("t0;q=0.0"));
+    ASSERT_TRUE(tokens.Contains("t99;q=0.9"));
+    ASSERT_EQ(tokens.GetQuality("t98"), 800);
+    ASSERT_EQ(tokens.GetQuality("t100"), -1);
+}
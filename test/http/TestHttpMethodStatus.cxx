@@ -0,0 +1,80 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "http/Method.h"
+#include "http/Status.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <string.h>
+
+TEST(HttpMethod, Parse)
+{
+    for (unsigned i = HTTP_METHOD_HEAD; i < HTTP_METHOD_INVALID; ++i) {
+        const auto method = http_method_t(i);
+        const char *name = http_method_to_string(method);
+        ASSERT_EQ(http_method_parse(name, strlen(name)), method) << name;
+    }
+
+    ASSERT_EQ(http_method_parse("", 0), HTTP_METHOD_NULL);
+    ASSERT_EQ(http_method_parse("get", 3), HTTP_METHOD_NULL);
+    ASSERT_EQ(http_method_parse("GOT", 3), HTTP_METHOD_NULL);
+    ASSERT_EQ(http_method_parse("GETS", 4), HTTP_METHOD_NULL);
+    ASSERT_EQ(http_method_parse("OPTIONZ", 7), HTTP_METHOD_NULL);
+    ASSERT_EQ(http_method_parse("CONNECT", 7), HTTP_METHOD_NULL);
+
+    /* not null-terminated */
+    ASSERT_EQ(http_method_parse("POSTX", 4), HTTP_METHOD_POST);
+}
+
+TEST(HttpStatus, Line)
+{
+    auto line = http_status_to_line(HTTP_STATUS_OK);
+    ASSERT_EQ(std::string(line.data, line.length), "HTTP/1.1 200 OK\r\n");
+    ASSERT_EQ(line.length, strlen(line.data));
+
+    line = http_status_to_line(HTTP_STATUS_NETWORK_AUTHENTICATION_REQUIRED);
+    ASSERT_EQ(std::string(line.data, line.length),
+              "HTTP/1.1 511 Network Authentication Required\r\n");
+
+    for (unsigned i = 100; i < 600; ++i) {
+        const auto status = http_status_t(i);
+        if (!http_status_is_valid(status))
+            continue;
+
+        line = http_status_to_line(status);
+        ASSERT_EQ(std::string(line.data, line.length),
+                  std::string("HTTP/1.1 ") + http_status_to_string(status) + "\r\n");
+    }
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "http/Range.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+static HttpRangeRequest
+Parse(const char *header, uint64_t size=1000)
+{
+    HttpRangeRequest request(size);
+    request.ParseRangeHeader(header);
+    return request;
+}
+
+TEST(HttpRange, Single)
+{
+    auto r = Parse("bytes=0-499");
+    ASSERT_EQ(r.type, HttpRangeRequest::Type::VALID);
+    ASSERT_FALSE(r.IsMultiRange());
+    ASSERT_EQ(r.skip, 0u);
+    ASSERT_EQ(r.size, 500u);
+
+    r = Parse("bytes=500-");
+    ASSERT_EQ(r.type, HttpRangeRequest::Type::VALID);
+    ASSERT_EQ(r.skip, 500u);
+    ASSERT_EQ(r.size, 1000u);
+
+    r = Parse("bytes=-100");
+    ASSERT_EQ(r.type, HttpRangeRequest::Type::VALID);
+    ASSERT_EQ(r.skip, 900u);
+    ASSERT_EQ(r.size, 1000u);
+
+    /* suffix longer than the resource */
+    r = Parse("bytes=-5000");
+    ASSERT_EQ(r.type, HttpRangeRequest::Type::VALID);
+    ASSERT_EQ(r.skip, 0u);
+    ASSERT_EQ(r.size, 1000u);
+
+    /* last-byte-pos beyond the end is clamped */
+    r = Parse("bytes=900-5000");
+    ASSERT_EQ(r.type, HttpRangeRequest::Type::VALID);
+    ASSERT_EQ(r.skip, 900u);
+    ASSERT_EQ(r.size, 1000u);
+}
+
+TEST(HttpRange, Invalid)
+{
+    ASSERT_EQ(Parse("items=0-1").type, HttpRangeRequest::Type::INVALID);
+    ASSERT_EQ(Parse("bytes=").type, HttpRangeRequest::Type::INVALID);
+    ASSERT_EQ(Parse("bytes=1000-").type, HttpRangeRequest::Type::INVALID);
+    ASSERT_EQ(Parse("bytes=-0").type, HttpRangeRequest::Type::INVALID);
+    ASSERT_EQ(Parse("bytes=5-4").type, HttpRangeRequest::Type::INVALID);
+    ASSERT_EQ(Parse("bytes=x-4").type, HttpRangeRequest::Type::INVALID);
+    ASSERT_EQ(Parse("bytes=0-4x").type, HttpRangeRequest::Type::INVALID);
+    ASSERT_EQ(Parse("bytes=0-4,").type, HttpRangeRequest::Type::VALID);
+    ASSERT_EQ(Parse("bytes=0-4,junk").type, HttpRangeRequest::Type::INVALID);
+    ASSERT_EQ(Parse("bytes=99999999999999999999-").type,
+              HttpRangeRequest::Type::INVALID);
+
+    /* unsatisfiable ranges are ignored if others remain */
+    auto r = Parse("bytes=2000-3000, 10-19");
+    ASSERT_EQ(r.type, HttpRangeRequest::Type::VALID);
+    ASSERT_EQ(r.skip, 10u);
+    ASSERT_EQ(r.size, 20u);
+}
+
+TEST(HttpRange, Multi)
+{
+    auto r = Parse("bytes=0-99, 500-599,900-");
+    ASSERT_EQ(r.type, HttpRangeRequest::Type::VALID);
+    ASSERT_TRUE(r.IsMultiRange());
+    ASSERT_EQ(r.ranges.size(), 3u);
+    ASSERT_EQ(r.ranges[0].start, 0u);
+    ASSERT_EQ(r.ranges[0].end, 100u);
+    ASSERT_EQ(r.ranges[1].start, 500u);
+    ASSERT_EQ(r.ranges[1].end, 600u);
+    ASSERT_EQ(r.ranges[2].start, 900u);
+    ASSERT_EQ(r.ranges[2].end, 1000u);
+    ASSERT_EQ(r.skip, 0u);
+    ASSERT_EQ(r.size, 1000u);
+
+    /* unsorted, overlapping and adjacent ranges are coalesced */
+    r = Parse("bytes=500-599,0-99,550-700,150-199,-1");
+    ASSERT_EQ(r.type, HttpRangeRequest::Type::VALID);
+    ASSERT_EQ(r.ranges.size(), 3u);
+    ASSERT_EQ(r.ranges[0].start, 0u);
+    ASSERT_EQ(r.ranges[0].end, 200u);
+    ASSERT_EQ(r.ranges[1].start, 500u);
+    ASSERT_EQ(r.ranges[1].end, 701u);
+    ASSERT_EQ(r.ranges[2].start, 999u);
+    ASSERT_EQ(r.ranges[2].end, 1000u);
+}
+
+TEST(HttpRange, Abuse)
+{
+    std::string header = "bytes=";
+    for (unsigned i = 0; i < 1000; ++i)
+        header += std::to_string(i * 200) + "-" + std::to_string(i * 200) + ",";
+
+    auto r = Parse(header.c_str(), 1000000);
+    ASSERT_EQ(r.type, HttpRangeRequest::Type::VALID);
+    ASSERT_FALSE(r.IsMultiRange());
+    ASSERT_EQ(r.ranges.size(), 1u);
+    ASSERT_EQ(r.skip, 0u);
+    ASSERT_EQ(r.size, 999u * 200 + 1);
+}
+
+TEST(HttpRange, Multipart)
+{
+    auto r = Parse("bytes=0-9,500-509");
+    HttpMultipartRanges m(r, "BOUNDARY", "text/plain");
+    ASSERT_EQ(m.GetPartCount(), 2u);
+    ASSERT_EQ(std::string(m.GetPartHeader(0).data, m.GetPartHeader(0).size),
+              "--BOUNDARY\r\n"
+              "Content-Type: text/plain\r\n"
+              "Content-Range: bytes 0-9/1000\r\n\r\n");
+    ASSERT_EQ(m.GetPartRange(0).start, 0u);
+    ASSERT_EQ(m.GetPartRange(0).end, 10u);
+    ASSERT_EQ(std::string(m.GetPartHeader(1).data, m.GetPartHeader(1).size),
+              "\r\n--BOUNDARY\r\n"
+              "Content-Type: text/plain\r\n"
+              "Content-Range: bytes 500-509/1000\r\n\r\n");
+    ASSERT_EQ(std::string(m.GetTrailer().data, m.GetTrailer().size),
+              "\r\n--BOUNDARY--\r\n");
+
+    uint64_t length = 20;
+    for (size_t i = 0; i < m.GetPartCount(); ++i)
+        length += m.GetPartHeader(i).size;
+    length += m.GetTrailer().size;
+    ASSERT_EQ(m.GetContentLength(), length);
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "io/AsyncLogger.hxx"
+#include "io/Logger.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static std::string
+ReadAll(int fd)
+{
+	std::string result;
+	char buffer[4096];
+	ssize_t nbytes;
+	while ((nbytes = read(fd, buffer, sizeof(buffer))) > 0)
+		result.append(buffer, nbytes);
+	return result;
+}
+
+static unsigned
+CountLines(const std::string &s, const char *prefix)
+{
+	unsigned n = 0;
+	size_t start = 0;
+	while (true) {
+		size_t end = s.find('\n', start);
+		if (end == s.npos)
+			break;
+
+		if (s.compare(start, strlen(prefix), prefix) == 0)
+			++n;
+		start = end + 1;
+	}
+
+	return n;
+}
+
+TEST(AsyncLogger, Basic)
+{
+	int fds[2];
+	ASSERT_EQ(pipe(fds), 0);
+
+	std::string output;
+	std::thread reader([&](){ output = ReadAll(fds[0]); });
+
+	{
+		AsyncLogger logger(fds[1]);
+		ASSERT_EQ(AsyncLogger::Get(), &logger);
+
+		struct iovec v[] = {
+			{const_cast<char *>("hello "), 6},
+			{const_cast<char *>("world\n"), 6},
+		};
+
+		ASSERT_TRUE(logger.Push(v, 2));
+	}
+
+	ASSERT_EQ(AsyncLogger::Get(), nullptr);
+
+	close(fds[1]);
+	reader.join();
+	close(fds[0]);
+
+	ASSERT_EQ(output, "hello world\n");
+}
+
+TEST(AsyncLogger, Threads)
+{
+	constexpr unsigned n_threads = 8, n_messages = 10000;
+
+	int fds[2];
+	ASSERT_EQ(pipe(fds), 0);
+
+	std::string output;
+	std::thread reader([&](){ output = ReadAll(fds[0]); });
+
+	uint64_t dropped;
+
+	{
+		AsyncLogger logger(fds[1], 4096);
+
+		std::vector<std::thread> threads;
+		for (unsigned i = 0; i < n_threads; ++i)
+			threads.emplace_back([](){
+				for (unsigned j = 0; j < n_messages; ++j)
+					LogConcat(1, "test", "message ", j);
+			});
+
+		for (auto &i : threads)
+			i.join();
+
+		logger.Flush();
+		dropped = logger.GetDropped();
+	}
+
+	close(fds[1]);
+	reader.join();
+	close(fds[0]);
+
+	/* each message arrives as one complete line, or not at
+	   all */
+	ASSERT_EQ(CountLines(output, "[test] message ") + dropped,
+		  n_threads * n_messages);
+	ASSERT_EQ(output.back(), '\n');
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "io/CacheSnapshot.hxx"
+#include "util/ExpiringCache.hxx"
+#include "util/ScopeExit.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace std::chrono;
+
+static std::string
+ToString(ConstBuffer<void> b)
+{
+	return std::string((const char *)b.data, b.size);
+}
+
+TEST(CacheSnapshot, Basic)
+{
+	char directory[] = "/tmp/TestCacheSnapshot.XXXXXX";
+	ASSERT_NE(mkdtemp(directory), nullptr);
+
+	const std::string path = std::string(directory) + "/snapshot";
+	AtScopeExit(&) {
+		unlink(path.c_str());
+		rmdir(directory);
+	};
+
+	const auto now = Expiry::Now();
+
+	ExpiringCache<std::string, std::string, 8, 7> cache(1024);
+	cache.Put("a", "foo", 3, Expiry::Touched(now, hours(1)));
+	cache.Put("b", "bar", 3, Expiry::Never());
+	cache.Put("c", "expired", 7, Expiry::AlreadyExpired());
+	cache.Put("d", std::string(1000, 'x'), 100, Expiry::Touched(now, minutes(5)));
+
+	{
+		CacheSnapshotWriter w(path.c_str());
+		cache.ForEachWithExpiry([&w](const std::string &key,
+					     const std::string &data,
+					     Expiry expires){
+				w.Add({key.data(), key.size()},
+				      {data.data(), data.size()}, expires);
+			});
+		w.Commit();
+	}
+
+	CacheSnapshot snapshot(path.c_str());
+	ASSERT_EQ(snapshot.GetCount(), 3u);
+
+	unsigned n = 0;
+	snapshot.ForEach(now, [&n](StringView, const CacheSnapshot::Entry &){
+			++n;
+		});
+	ASSERT_EQ(n, 3u);
+
+	CacheSnapshot::Entry e;
+	ASSERT_FALSE(snapshot.Take("c", now, e));
+	ASSERT_FALSE(snapshot.Take("x", now, e));
+
+	ASSERT_TRUE(snapshot.Take("a", now, e));
+	ASSERT_EQ(ToString(e.value), "foo");
+	ASSERT_FALSE(e.expires.IsExpired(Expiry::Touched(now, minutes(59))));
+	ASSERT_TRUE(e.expires.IsExpired(Expiry::Touched(now, minutes(61))));
+
+	/* each record can be taken only once */
+	ASSERT_FALSE(snapshot.Take("a", now, e));
+
+	ASSERT_TRUE(snapshot.Take("b", now, e));
+	ASSERT_EQ(ToString(e.value), "bar");
+	ASSERT_TRUE(e.expires == Expiry::Never());
+
+	/* expired meanwhile */
+	ASSERT_FALSE(snapshot.Take("d", Expiry::Touched(now, minutes(6)), e));
+
+	ASSERT_TRUE(snapshot.IsEmpty());
+}
+
+TEST(CacheSnapshot, Truncated)
+{
+	char directory[] = "/tmp/TestCacheSnapshot.XXXXXX";
+	ASSERT_NE(mkdtemp(directory), nullptr);
+
+	const std::string path = std::string(directory) + "/snapshot";
+	AtScopeExit(&) {
+		unlink(path.c_str());
+		rmdir(directory);
+	};
+
+	{
+		CacheSnapshotWriter w(path.c_str());
+		w.Add("a", {"foo", 3}, Expiry::Never());
+		w.Add("b", {"bar", 3}, Expiry::Never());
+		w.Commit();
+	}
+
+	/* cut off the last byte of the second value */
+	const auto size = sizeof(CacheSnapshotFileHeader) +
+		2 * (sizeof(CacheSnapshotRecordHeader) + 8);
+	ASSERT_EQ(truncate(path.c_str(), size - 5 - 1), 0);
+
+	CacheSnapshot snapshot(path.c_str());
+	ASSERT_EQ(snapshot.GetCount(), 1u);
+
+	CacheSnapshot::Entry e;
+	ASSERT_TRUE(snapshot.Take("a", Expiry::Now(), e));
+	ASSERT_EQ(ToString(e.value), "foo");
+}
+
+TEST(CacheSnapshot, Malformed)
+{
+	char path[] = "/tmp/TestCacheSnapshot.XXXXXX";
+	const int fd = mkstemp(path);
+	ASSERT_GE(fd, 0);
+	AtScopeExit(&) { unlink(path); };
+
+	ASSERT_EQ(write(fd, "garbage garbage", 15), 15);
+	close(fd);
+
+	ASSERT_THROW(CacheSnapshot snapshot(path), std::runtime_error);
+	ASSERT_THROW(CacheSnapshot snapshot("/does/not/exist"),
+		     std::system_error);
+}
@@ -40,6 +40,8 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
 
 class MyConfigParser final
     : public ConfigParser, public std::vector<std::string> {
@@ -105,3 +107,140 @@ TEST(ConfigParserTest, VariableConfigParser)
         ASSERT_STREQ(v_output[i], p[i].c_str());
     }
 }
+
+static void
+WriteFile(const std::string &path, const std::string &contents)
+{
+    FILE *file = fopen(path.c_str(), "w");
+    ASSERT_NE(file, nullptr);
+    fwrite(contents.data(), 1, contents.size(), file);
+    fclose(file);
+}
+
+TEST(ConfigParserTest, File)
+{
+    char directory[] = "/tmp/TestConfigParser.XXXXXX";
+    ASSERT_NE(mkdtemp(directory), nullptr);
+
+    const std::string main_path = std::string(directory) + "/main.conf";
+    const std::string include_path = std::string(directory) + "/include.conf";
+    AtScopeExit(&) {
+        unlink(main_path.c_str());
+        unlink(include_path.c_str());
+        rmdir(directory);
+    };
+
+    /* a line which is longer than the old stdio line buffer */
+    const std::string long_value(10000, 'x');
+
+    WriteFile(main_path,
+              "'first'\n"
+              "# comment\n"
+              "@include 'include.conf'\n"
+              "\n"
+              "'" + long_value + "'\n"
+              "'last' ");
+    WriteFile(include_path, "'included'\n");
+
+    MyConfigParser p;
+    CommentConfigParser c(p);
+    IncludeConfigParser i(main_path, c);
+    ParseConfigFile(main_path, i);
+
+    ASSERT_EQ(p.size(), 4u);
+    ASSERT_EQ(p[0], "first");
+    ASSERT_EQ(p[1], "included");
+    ASSERT_EQ(p[2], long_value);
+    ASSERT_EQ(p[3], "last");
+}
+
+class MyReentrantConfigParser final : public ReentrantConfigParser {
+    MyConfigParser values;
+    CommentConfigParser comment;
+
+public:
+    MyReentrantConfigParser():comment(values) {}
+
+    const std::vector<std::string> &GetValues() const {
+        return values;
+    }
+
+    bool PreParseLine(FileLineParser &line) override {
+        return comment.PreParseLine(line);
+    }
+
+    void ParseLine(FileLineParser &line) override {
+        comment.ParseLine(line);
+    }
+
+    std::unique_ptr<ConfigParser> CreateFragmentParser() override {
+        return std::make_unique<MyReentrantConfigParser>();
+    }
+
+    void MergeFragment(std::unique_ptr<ConfigParser> &&_fragment) override {
+        auto &fragment = static_cast<MyReentrantConfigParser &>(*_fragment);
+        values.insert(values.end(),
+                      fragment.values.begin(), fragment.values.end());
+    }
+};
+
+TEST(ConfigParserTest, Parallel)
+{
+    char directory[] = "/tmp/TestConfigParser.XXXXXX";
+    ASSERT_NE(mkdtemp(directory), nullptr);
+
+    std::vector<std::string> paths;
+    AtScopeExit(&) {
+        for (const auto &i : paths)
+            unlink(i.c_str());
+        rmdir(directory);
+    };
+
+    const std::string main_path = std::string(directory) + "/main.conf";
+    paths.push_back(main_path);
+    WriteFile(main_path,
+              "'first'\n"
+              "@include 'site*.conf'\n"
+              "'last'\n");
+
+    const std::string nested_path = std::string(directory) + "/nested.inc";
+    paths.push_back(nested_path);
+    WriteFile(nested_path, "'nested'\n");
+
+    constexpr unsigned n_sites = 64;
+    for (unsigned i = 0; i < n_sites; ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "/site%03u.conf", i);
+        paths.push_back(directory + std::string(name));
+
+        std::string contents = "# site\n'site" + std::to_string(i) + "'\n";
+        if (i == 7)
+            contents += "@include 'nested.inc'\n";
+        WriteFile(paths.back(), contents);
+    }
+
+    MyReentrantConfigParser p;
+    IncludeConfigParser include(main_path, p);
+    include.EnableParallel(p, 4);
+    ParseConfigFile(main_path, include);
+
+    const auto &values = p.GetValues();
+    ASSERT_EQ(values.size(), n_sites + 3);
+    ASSERT_EQ(values.front(), "first");
+    ASSERT_EQ(values.back(), "last");
+
+    for (unsigned i = 0, j = 1; i < n_sites; ++i, ++j) {
+        ASSERT_EQ(values[j], "site" + std::to_string(i));
+        if (i == 7) {
+            ASSERT_EQ(values[++j], "nested");
+        }
+    }
+
+    /* a syntax error in a fragment is reported */
+    WriteFile(paths.back(), "unquoted\n");
+
+    MyReentrantConfigParser p2;
+    IncludeConfigParser include2(main_path, p2);
+    include2.EnableParallel(p2, 4);
+    ASSERT_THROW(ParseConfigFile(main_path, include2), std::runtime_error);
+}
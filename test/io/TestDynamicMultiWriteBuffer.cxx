@@ -0,0 +1,140 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "io/DynamicMultiWriteBuffer.hxx"
+#include "util/ScopeExit.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static std::string
+ReadAll(int fd)
+{
+	std::string result;
+	char buffer[65536];
+	ssize_t nbytes;
+	while ((nbytes = read(fd, buffer, sizeof(buffer))) > 0)
+		result.append(buffer, nbytes);
+	return result;
+}
+
+/**
+ * Build many small buffers, more than IOV_MAX.
+ */
+static std::string
+Fill(DynamicMultiWriteBuffer &b, std::vector<std::string> &storage,
+     unsigned n)
+{
+	storage.clear();
+	storage.reserve(n);
+
+	std::string expected;
+	for (unsigned i = 0; i < n; ++i) {
+		storage.push_back(std::to_string(i) + ",");
+		b.Push(storage.back().data(), storage.back().size());
+		expected += storage.back();
+	}
+
+	return expected;
+}
+
+TEST(DynamicMultiWriteBuffer, Write)
+{
+	int fds[2];
+	ASSERT_EQ(pipe(fds), 0);
+	AtScopeExit(&fds) { close(fds[0]); };
+
+	std::string output;
+	std::thread reader([&](){ output = ReadAll(fds[0]); });
+
+	DynamicMultiWriteBuffer b;
+	std::vector<std::string> storage;
+	const auto expected = Fill(b, storage, 3 * IOV_MAX + 7);
+	ASSERT_EQ(b.GetPendingCount(), 3u * IOV_MAX + 7);
+
+	/* blocking pipe: everything is written in one call */
+	ASSERT_EQ(b.Write(fds[1]), DynamicMultiWriteBuffer::Result::FINISHED);
+	ASSERT_TRUE(b.IsEmpty());
+
+	close(fds[1]);
+	reader.join();
+
+	ASSERT_EQ(output, expected);
+}
+
+TEST(DynamicMultiWriteBuffer, SendPartial)
+{
+	int sv[2];
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+	AtScopeExit(&sv) { close(sv[0]); close(sv[1]); };
+
+	int size = 4096;
+	setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+	setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	fcntl(sv[0], F_SETFL, O_NONBLOCK);
+	fcntl(sv[1], F_SETFL, O_NONBLOCK);
+
+	DynamicMultiWriteBuffer b;
+	std::vector<std::string> storage;
+	const auto expected = Fill(b, storage, 20000);
+
+	/* the socket buffer is much smaller than the data, so this
+	   takes many partial writes */
+	std::string output;
+	unsigned n_more = 0;
+	while (b.Send(sv[0], MSG_NOSIGNAL) == DynamicMultiWriteBuffer::Result::MORE) {
+		++n_more;
+
+		char buffer[65536];
+		ssize_t nbytes;
+		while ((nbytes = recv(sv[1], buffer, sizeof(buffer), 0)) > 0)
+			output.append(buffer, nbytes);
+	}
+
+	ASSERT_GT(n_more, 0u);
+	ASSERT_TRUE(b.IsEmpty());
+
+	char buffer[65536];
+	ssize_t nbytes;
+	while ((nbytes = recv(sv[1], buffer, sizeof(buffer), 0)) > 0)
+		output.append(buffer, nbytes);
+
+	ASSERT_EQ(output, expected);
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "io/FileDescriptor.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "io/Splice.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+static UniqueFileDescriptor
+CreateTemporaryFile(size_t size)
+{
+	char path[] = "/tmp/TestFileDescriptor.XXXXXX";
+	UniqueFileDescriptor fd(FileDescriptor(mkstemp(path)));
+	if (!fd.IsDefined())
+		return fd;
+
+	unlink(path);
+
+	std::vector<char> buffer(size);
+	for (size_t i = 0; i < size; ++i)
+		buffer[i] = char(i * 7);
+
+	if (fd.Write(buffer.data(), size) != ssize_t(size))
+		fd.Close();
+
+	return fd;
+}
+
+TEST(FileDescriptor, ResidentBytes)
+{
+	constexpr size_t size = 1024 * 1024 + 123;
+	auto fd = CreateTemporaryFile(size);
+	ASSERT_TRUE(fd.IsDefined());
+
+	EXPECT_EQ(fd.GetResidentBytes(0, 0), 0);
+
+	/* the data was just written, so it should be in the page
+	   cache */
+	EXPECT_TRUE(fd.AdviseWillNeed(0, size));
+	EXPECT_TRUE(fd.ReadAhead(0, size));
+	EXPECT_EQ(fd.GetResidentBytes(0, size), off_t(size));
+
+	/* unaligned ranges are clipped */
+	EXPECT_EQ(fd.GetResidentBytes(100, 10), 10);
+	EXPECT_EQ(fd.GetResidentBytes(4000, 5000), 5000);
+
+	/* dropping the page cache can't be verified reliably (tmpfs
+	   ignores the hint), but must not fail or inflate the count */
+	EXPECT_TRUE(fd.AdviseSequential());
+	EXPECT_TRUE(fd.AdviseDontNeed());
+	const off_t resident = fd.GetResidentBytes(0, size);
+	EXPECT_GE(resident, 0);
+	EXPECT_LE(resident, off_t(size));
+}
+
+TEST(FileDescriptor, SendFileWindows)
+{
+	constexpr size_t size = 5 * 1024 * 1024 + 4321;
+	auto fd = CreateTemporaryFile(size);
+	ASSERT_TRUE(fd.IsDefined());
+
+	int sv[2];
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+	UniqueFileDescriptor r{FileDescriptor{sv[0]}}, w{FileDescriptor{sv[1]}};
+
+	std::vector<char> received;
+	received.reserve(size);
+
+	off_t offset = 0;
+	while (size_t(offset) < size) {
+		ssize_t nbytes = SendFile(fd.Get(), offset, w.Get(),
+					  std::min<size_t>(size - offset, 65536),
+					  true);
+		ASSERT_GT(nbytes, 0);
+
+		while (nbytes > 0) {
+			char buffer[65536];
+			ssize_t n = r.Read(buffer, sizeof(buffer));
+			ASSERT_GT(n, 0);
+			received.insert(received.end(), buffer, buffer + n);
+			nbytes -= n;
+		}
+	}
+
+	ASSERT_EQ(received.size(), size);
+	for (size_t i = 0; i < size; ++i)
+		ASSERT_EQ(received[i], char(i * 7));
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "io/Logger.hxx"
+#include "util/ScopeExit.hxx"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * Redirects stderr into a pipe while it exists.
+ */
+class CaptureStderr {
+	int pipe_fds[2];
+	int old_stderr;
+
+public:
+	CaptureStderr() {
+		if (pipe2(pipe_fds, O_NONBLOCK) < 0)
+			throw std::runtime_error("pipe2() failed");
+
+		old_stderr = dup(STDERR_FILENO);
+		dup2(pipe_fds[1], STDERR_FILENO);
+	}
+
+	~CaptureStderr() {
+		dup2(old_stderr, STDERR_FILENO);
+		close(old_stderr);
+		close(pipe_fds[0]);
+		close(pipe_fds[1]);
+	}
+
+	std::string Read() {
+		std::string result;
+		char buffer[4096];
+		ssize_t nbytes;
+		while ((nbytes = read(pipe_fds[0], buffer, sizeof(buffer))) > 0)
+			result.append(buffer, nbytes);
+		return result;
+	}
+};
+
+static unsigned
+CountLines(const std::string &s, const char *line)
+{
+	unsigned n = 0;
+	for (size_t i = s.find(line); i != s.npos; i = s.find(line, i + 1))
+		++n;
+	return n;
+}
+
+TEST(LogRateLimit, Basic)
+{
+	SetLogRateLimit(0.001, 5);
+	AtScopeExit() { SetLogRateLimit(0, 0); };
+
+	CaptureStderr capture;
+
+	for (unsigned i = 0; i < 100; ++i) {
+		LogConcat(1, "flood", "message");
+		LogFormat(1, "other", "message %u", i);
+	}
+
+	/* a different level has its own bucket */
+	LogConcat(0, "flood", "error");
+
+	const auto output = capture.Read();
+	ASSERT_EQ(CountLines(output, "[flood] message\n"), 5u);
+	ASSERT_EQ(CountLines(output, "[other] message "), 5u);
+	ASSERT_EQ(CountLines(output, "[flood] error\n"), 1u);
+	ASSERT_EQ(CountLines(output, "suppressed"), 0u);
+}
+
+TEST(LogRateLimit, Disabled)
+{
+	CaptureStderr capture;
+
+	for (unsigned i = 0; i < 100; ++i)
+		LogConcat(1, "flood2", "message");
+
+	ASSERT_EQ(CountLines(capture.Read(), "[flood2] message\n"), 100u);
+}
+
+TEST(LogRateLimit, Summary)
+{
+	SetLogRateLimit(1000, 1);
+	AtScopeExit() { SetLogRateLimit(0, 0); };
+
+	CaptureStderr capture;
+
+	for (unsigned i = 0; i < 10; ++i)
+		LogConcat(1, "flood3", "message");
+
+	/* wait until the bucket has refilled */
+	usleep(20000);
+	LogConcat(1, "flood3", "message");
+
+	const auto output = capture.Read();
+	ASSERT_EQ(CountLines(output, "[flood3] message\n"), 2u);
+	ASSERT_EQ(CountLines(output, "[flood3] 9 messages suppressed\n"), 1u);
+}
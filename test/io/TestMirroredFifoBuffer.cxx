@@ -0,0 +1,147 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "io/MirroredFifoBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include <string.h>
+#include <unistd.h>
+
+TEST(MirroredFifoBuffer, Capacity)
+{
+	const size_t page_size = sysconf(_SC_PAGESIZE);
+
+	MirroredFifoBuffer<uint8_t> a(1);
+	EXPECT_EQ(a.GetCapacity(), page_size);
+
+	MirroredFifoBuffer<uint32_t> b(page_size);
+	EXPECT_EQ(b.GetCapacity(), page_size);
+
+	MirroredFifoBuffer<uint8_t> c(page_size + 1);
+	EXPECT_EQ(c.GetCapacity(), 2 * page_size);
+	EXPECT_TRUE(c.IsEmpty());
+	EXPECT_FALSE(c.IsFull());
+	EXPECT_EQ(c.Write().size, 2 * page_size);
+}
+
+TEST(MirroredFifoBuffer, Mirror)
+{
+	MirroredFifoBuffer<char> buffer(1);
+	const size_t capacity = buffer.GetCapacity();
+
+	auto w = buffer.Write();
+	ASSERT_EQ(w.size, capacity);
+	memset(w.data, 'a', w.size);
+	buffer.Append(capacity);
+	EXPECT_TRUE(buffer.IsFull());
+	EXPECT_EQ(buffer.Write().size, 0u);
+
+	/* the second half mirrors the first one */
+	EXPECT_EQ(buffer.Read().data[capacity - 1], 'a');
+	buffer.Read().data[0] = 'b';
+	buffer.Consume(1);
+	EXPECT_EQ(buffer.Write().size, 1u);
+	EXPECT_EQ(buffer.Write().data[0], 'b');
+}
+
+/**
+ * Data which wraps around the end of the buffer is still contiguous,
+ * without any copying.
+ */
+TEST(MirroredFifoBuffer, WrapAround)
+{
+	MirroredFifoBuffer<char> buffer(1);
+	const size_t capacity = buffer.GetCapacity();
+	const char *const base = buffer.Write().data;
+
+	/* keep at least one element in the buffer so the head
+	   drifts around the end; use odd chunk sizes */
+	unsigned write_sequence = 0, read_sequence = 0, n_wrapped = 0;
+	for (unsigned i = 0; i < 256; ++i) {
+		auto w = buffer.Write();
+		const size_t n_write = std::min<size_t>(w.size, 1021 + i);
+		for (size_t j = 0; j < n_write; ++j)
+			w.data[j] = char(write_sequence++);
+		buffer.Append(n_write);
+
+		auto r = buffer.Read();
+		if (r.data + r.size > base + capacity)
+			++n_wrapped;
+
+		const size_t n_read = std::min<size_t>(r.size - 1, 997 + i);
+		for (size_t j = 0; j < n_read; ++j)
+			ASSERT_EQ(r.data[j], char(read_sequence++));
+		buffer.Consume(n_read);
+	}
+
+	EXPECT_GT(n_wrapped, 0u);
+	EXPECT_FALSE(buffer.IsEmpty());
+
+	/* fill the buffer completely */
+	auto w = buffer.Write();
+	for (size_t j = 0; j < w.size; ++j)
+		w.data[j] = char(write_sequence++);
+	buffer.Append(w.size);
+	EXPECT_TRUE(buffer.IsFull());
+
+	auto r = buffer.Read();
+	ASSERT_EQ(r.size, capacity);
+	for (size_t j = 0; j < r.size; ++j)
+		ASSERT_EQ(r.data[j], char(read_sequence++));
+}
+
+TEST(MirroredFifoBuffer, Grow)
+{
+	MirroredFifoBuffer<char> buffer(1);
+	const size_t capacity = buffer.GetCapacity();
+
+	/* wrap the readable data around the end */
+	buffer.Write(capacity - 2);
+	buffer.Append(capacity - 2);
+	buffer.Consume(capacity - 2);
+	buffer.Append("x", 1);
+	buffer.Consume(1);
+	buffer.Append("hello world", 11);
+
+	buffer.WantWrite(capacity);
+	EXPECT_EQ(buffer.GetCapacity(), 2 * capacity);
+	ASSERT_EQ(buffer.GetAvailable(), 11u);
+	EXPECT_EQ(memcmp(buffer.Read().data, "hello world", 11), 0);
+	EXPECT_EQ(buffer.Write().size, 2 * capacity - 11);
+
+	MirroredFifoBuffer<char> moved(std::move(buffer));
+	EXPECT_EQ(memcmp(moved.Read().data, "hello world", 11), 0);
+	EXPECT_EQ(buffer.GetCapacity(), 0u);
+	EXPECT_TRUE(buffer.IsEmpty());
+}
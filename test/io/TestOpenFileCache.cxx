@@ -0,0 +1,145 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "io/OpenFileCache.hxx"
+#include "util/ScopeExit.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static void
+WriteFile(const std::string &path, const char *contents)
+{
+	FILE *file = fopen(path.c_str(), "w");
+	ASSERT_NE(file, nullptr);
+	fputs(contents, file);
+	fclose(file);
+}
+
+static std::string
+ReadFile(const OpenFileCache::Item &item)
+{
+	std::string result(item.st.st_size, 0);
+	ssize_t nbytes = pread(item.GetFileDescriptor().Get(), &result.front(),
+			       result.size(), 0);
+	result.resize(std::max<ssize_t>(nbytes, 0));
+	return result;
+}
+
+TEST(OpenFileCache, Basic)
+{
+	char directory[] = "/tmp/TestOpenFileCache.XXXXXX";
+	ASSERT_NE(mkdtemp(directory), nullptr);
+
+	const std::string a = std::string(directory) + "/a";
+	const std::string b = std::string(directory) + "/b";
+	const std::string tmp = std::string(directory) + "/tmp";
+	AtScopeExit(&) {
+		unlink(a.c_str());
+		unlink(b.c_str());
+		unlink(tmp.c_str());
+		rmdir(directory);
+	};
+
+	WriteFile(a, "foo");
+	WriteFile(b, "bar");
+
+	OpenFileCache cache;
+
+	const int fd_a = cache.Open(a.c_str()).GetFileDescriptor().Get();
+	ASSERT_EQ(ReadFile(cache.Open(a.c_str())), "foo");
+	ASSERT_EQ(ReadFile(cache.Open(b.c_str())), "bar");
+
+	/* cache hit */
+	ASSERT_EQ(cache.Open(a.c_str()).GetFileDescriptor().Get(), fd_a);
+
+	/* modification */
+	WriteFile(a, "hello");
+	cache.HandleInotifyEvents();
+	ASSERT_EQ(ReadFile(cache.Open(a.c_str())), "hello");
+
+	/* atomic replacement */
+	WriteFile(tmp, "replaced");
+	ASSERT_EQ(rename(tmp.c_str(), b.c_str()), 0);
+	cache.HandleInotifyEvents();
+	ASSERT_EQ(ReadFile(cache.Open(b.c_str())), "replaced");
+
+	/* deletion */
+	ASSERT_EQ(unlink(a.c_str()), 0);
+	cache.HandleInotifyEvents();
+	ASSERT_THROW(cache.Open(a.c_str()), std::system_error);
+
+	/* explicit invalidation */
+	cache.Invalidate(b.c_str());
+	ASSERT_EQ(ReadFile(cache.Open(b.c_str())), "replaced");
+}
+
+TEST(OpenFileCache, Evict)
+{
+	char directory[] = "/tmp/TestOpenFileCache.XXXXXX";
+	ASSERT_NE(mkdtemp(directory), nullptr);
+
+	const std::string path = std::string(directory) + "/x";
+	AtScopeExit(&) {
+		unlink(path.c_str());
+		rmdir(directory);
+	};
+
+	WriteFile(path, "x");
+
+	OpenFileCache cache;
+
+	/* fill the cache with more files than it can hold; they are
+	   all the same file, reached through different paths */
+	for (unsigned i = 0; i < OpenFileCache::MAX_FILES + 10; ++i) {
+		std::string p = std::string(directory);
+		for (unsigned j = 0; j < i; ++j)
+			p += "/.";
+		p += "/x";
+
+		if (p.length() >= 4000)
+			break;
+
+		ASSERT_EQ(ReadFile(cache.Open(p.c_str())), "x");
+	}
+
+	/* all spellings are invalidated */
+	WriteFile(path, "y");
+	cache.HandleInotifyEvents();
+	ASSERT_EQ(ReadFile(cache.Open((std::string(directory) + "/./x").c_str())), "y");
+	ASSERT_EQ(ReadFile(cache.Open(path.c_str())), "y");
+}
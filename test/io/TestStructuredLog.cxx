@@ -0,0 +1,175 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "io/StructuredLog.hxx"
+#include "io/Logger.hxx"
+#include "util/ScopeExit.hxx"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+struct MyParam {
+	StructuredLog::Param::Type type;
+	uint64_t number;
+	std::string string;
+};
+
+struct MySink final : StructuredLog::Sink {
+	unsigned level;
+	std::string domain;
+	uint32_t message_id;
+	std::vector<MyParam> params;
+
+	void OnLogRecord(const StructuredLog::Record &record) noexcept override {
+		level = record.level;
+		domain.assign(record.domain.data, record.domain.size);
+		message_id = record.message_id;
+
+		params.clear();
+		for (const auto &i : record.params)
+			params.push_back({i.type, i.unsigned_value,
+					  std::string(i.string_value.data,
+						      i.string_value.size)});
+	}
+};
+
+}
+
+static constexpr uint32_t TEST_ID = StructuredLog::MakeMessageId("test");
+
+TEST(StructuredLog, Sink)
+{
+	MySink sink;
+	StructuredLog::SetSink(&sink);
+	AtScopeExit() { StructuredLog::SetSink(nullptr); };
+
+	const std::string s("bar");
+	LLogger logger("domain");
+	logger.Structured(1, TEST_ID, "foo", s, 42, -7, 123456789012ul,
+			  std::make_exception_ptr(std::runtime_error("error")));
+
+	ASSERT_EQ(sink.level, 1u);
+	ASSERT_EQ(sink.domain, "domain");
+	ASSERT_EQ(sink.message_id, TEST_ID);
+	ASSERT_EQ(sink.params.size(), 6u);
+
+	using Type = StructuredLog::Param::Type;
+	ASSERT_EQ(sink.params[0].type, Type::STRING);
+	ASSERT_EQ(sink.params[0].string, "foo");
+	ASSERT_EQ(sink.params[1].type, Type::STRING);
+	ASSERT_EQ(sink.params[1].string, "bar");
+	ASSERT_EQ(sink.params[2].type, Type::SIGNED);
+	ASSERT_EQ(int64_t(sink.params[2].number), 42);
+	ASSERT_EQ(sink.params[3].type, Type::SIGNED);
+	ASSERT_EQ(int64_t(sink.params[3].number), -7);
+	ASSERT_EQ(sink.params[4].type, Type::UNSIGNED);
+	ASSERT_EQ(sink.params[4].number, 123456789012u);
+	ASSERT_EQ(sink.params[5].type, Type::STRING);
+	ASSERT_EQ(sink.params[5].string, "error");
+
+	/* filtered by log level */
+	sink.params.clear();
+	logger.Structured(10, TEST_ID, "foo");
+	ASSERT_TRUE(sink.params.empty());
+}
+
+TEST(StructuredLog, SerializeParse)
+{
+	const StructuredLog::Param params[] = {
+		"hello",
+		-1,
+		0xffffffffu,
+	};
+
+	const StructuredLog::Record record{2, "a/b", TEST_ID, {params, 3}};
+
+	uint8_t buffer[256];
+	size_t size = StructuredLog::Serialize(buffer, sizeof(buffer), record);
+	ASSERT_GT(size, 0u);
+
+	/* too small */
+	ASSERT_EQ(StructuredLog::Serialize(buffer, size - 1, record), 0u);
+
+	StructuredLog::Param parsed_params[4];
+	const auto parsed = StructuredLog::Parse(buffer, size,
+						 parsed_params, 4);
+	ASSERT_EQ(parsed.level, 2u);
+	ASSERT_TRUE(parsed.domain.Equals("a/b"));
+	ASSERT_EQ(parsed.message_id, TEST_ID);
+	ASSERT_EQ(parsed.params.size, 3u);
+	ASSERT_TRUE(parsed.params[0].string_value.Equals("hello"));
+	ASSERT_EQ(parsed.params[1].signed_value, -1);
+	ASSERT_EQ(parsed.params[2].unsigned_value, 0xffffffffu);
+
+	/* truncated input */
+	ASSERT_THROW(StructuredLog::Parse(buffer, size - 1, parsed_params, 4),
+		     StructuredLog::ProtocolError);
+
+	/* not enough room for parameters */
+	ASSERT_THROW(StructuredLog::Parse(buffer, size, parsed_params, 2),
+		     StructuredLog::ProtocolError);
+
+	/* bad magic */
+	buffer[0] ^= 1;
+	ASSERT_THROW(StructuredLog::Parse(buffer, size, parsed_params, 4),
+		     StructuredLog::ProtocolError);
+}
+
+TEST(StructuredLog, DatagramSink)
+{
+	int sv[2];
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, sv), 0);
+	AtScopeExit(&sv) { close(sv[0]); close(sv[1]); };
+
+	StructuredLog::DatagramSink sink{FileDescriptor(sv[0])};
+	StructuredLog::SetSink(&sink);
+	AtScopeExit() { StructuredLog::SetSink(nullptr); };
+
+	LogStructured(1, "x", TEST_ID, "value=", 3);
+
+	uint8_t buffer[256];
+	ssize_t nbytes = recv(sv[1], buffer, sizeof(buffer), MSG_DONTWAIT);
+	ASSERT_GT(nbytes, 0);
+
+	StructuredLog::Param params[4];
+	const auto record = StructuredLog::Parse(buffer, nbytes, params, 4);
+	ASSERT_TRUE(record.domain.Equals("x"));
+	ASSERT_EQ(record.params.size, 2u);
+	ASSERT_EQ(record.params[1].signed_value, 3);
+}
@@ -0,0 +1,529 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Throughput benchmark for the networking core: an echo server built
+ * on #ServerSocket and #BufferedSocket, and a load generator using
+ * #BufferedSocket, both running in one #EventLoop.
+ *
+ * Usage: BenchEcho [CONNECTIONS [SIZE [PIPELINE [SECONDS [edge]]]]]
+ *
+ * Each client connection keeps PIPELINE requests of SIZE bytes in
+ * flight.  The report contains requests per second, the round-trip
+ * latency and the number of system calls per request (send/recv on
+ * both sides plus one epoll_wait() per event loop iteration).  With
+ * "edge", all sockets use edge-triggered read events.
+ */
+
+#include "event/Loop.hxx"
+#include "event/TimerEvent.hxx"
+#include "event/Instrumentation.hxx"
+#include "event/net/ServerSocket.hxx"
+#include "event/net/BufferedSocket.hxx"
+#include "net/IPv4Address.hxx"
+#include "net/StaticSocketAddress.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "system/Error.hxx"
+#include "util/PrintException.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Use BufferedSocket::EnableEdgeTriggered() on all sockets?
+ */
+static bool edge_triggered = false;
+
+struct EchoStats {
+	uint64_t read_calls = 0, write_calls = 0;
+
+	void Add(const SocketStats &s) noexcept {
+		read_calls += s.read_calls;
+		write_calls += s.write_calls;
+	}
+};
+
+class EchoConnection final : BufferedSocketHandler {
+	BufferedSocket socket;
+
+public:
+	EchoConnection(EventLoop &event_loop,
+		       UniqueSocketDescriptor &&fd) noexcept
+		:socket(event_loop) {
+		socket.Init(fd.Release(), FD_TCP, nullptr, nullptr, *this);
+		if (edge_triggered)
+			socket.EnableEdgeTriggered();
+		socket.EnableStats();
+		socket.ScheduleReadNoTimeout(false);
+	}
+
+	~EchoConnection() noexcept {
+		if (socket.IsValid()) {
+			if (socket.IsConnected())
+				socket.Close();
+			socket.Destroy();
+		}
+	}
+
+	void CollectStats(EchoStats &stats) const noexcept {
+		if (socket.IsValid())
+			stats.Add(socket.GetStats());
+	}
+
+private:
+	void Destroy() noexcept {
+		socket.Close();
+		socket.Destroy();
+	}
+
+	/* virtual methods from class BufferedSocketHandler */
+	BufferedResult OnBufferedData(const void *buffer, size_t size) override {
+		ssize_t nbytes = socket.Write(buffer, size);
+		if (nbytes < 0) {
+			if (nbytes == WRITE_BLOCKING) {
+				socket.ScheduleWrite();
+				return BufferedResult::BLOCKING;
+			}
+
+			if (nbytes != WRITE_DESTROYED)
+				Destroy();
+			return BufferedResult::CLOSED;
+		}
+
+		socket.Consumed(nbytes);
+		if (size_t(nbytes) < size) {
+			/* wait until the peer has received what we sent */
+			socket.ScheduleWrite();
+			return BufferedResult::BLOCKING;
+		}
+
+		return BufferedResult::OK;
+	}
+
+	bool OnBufferedClosed() noexcept override {
+		Destroy();
+		return false;
+	}
+
+	bool OnBufferedWrite() override {
+		socket.UnscheduleWrite();
+		return socket.Read(false);
+	}
+
+	void OnBufferedError(std::exception_ptr e) noexcept override {
+		PrintException(e);
+		Destroy();
+	}
+};
+
+class EchoServer final : public ServerSocket {
+	std::vector<std::unique_ptr<EchoConnection>> connections;
+
+public:
+	using ServerSocket::ServerSocket;
+
+	size_t GetConnectionCount() const noexcept {
+		return connections.size();
+	}
+
+	void CollectStats(EchoStats &stats) const noexcept {
+		for (const auto &i : connections)
+			i->CollectStats(stats);
+	}
+
+protected:
+	void OnAccept(UniqueSocketDescriptor &&fd, SocketAddress) override {
+		connections.emplace_back(new EchoConnection(GetEventLoop(),
+							    std::move(fd)));
+	}
+
+	void OnAcceptError(std::exception_ptr ep) override {
+		PrintException(ep);
+	}
+};
+
+class LoadGenerator;
+
+class LoadConnection final : BufferedSocketHandler {
+	LoadGenerator &generator;
+
+	BufferedSocket socket;
+
+	/**
+	 * A buffer containing PIPELINE requests, which allows
+	 * sending all pending requests with one system call.
+	 */
+	const char *const message;
+	const size_t message_size;
+
+	/**
+	 * The size of one request.
+	 */
+	const size_t size;
+
+	/**
+	 * The send times of requests whose response has not yet
+	 * been received completely.
+	 */
+	std::deque<Clock::time_point> in_flight;
+
+	/**
+	 * The number of request bytes which have not yet been
+	 * sent.
+	 */
+	size_t unsent = 0;
+
+	/**
+	 * Position within #message.
+	 */
+	size_t send_position = 0;
+
+	/**
+	 * Position within the current response.
+	 */
+	size_t receive_position = 0;
+
+public:
+	LoadConnection(LoadGenerator &_generator, EventLoop &event_loop,
+		       UniqueSocketDescriptor &&fd,
+		       const char *_message, size_t _message_size,
+		       size_t _size) noexcept
+		:generator(_generator), socket(event_loop),
+		 message(_message), message_size(_message_size),
+		 size(_size) {
+		socket.Init(fd.Release(), FD_TCP, nullptr, nullptr, *this);
+		if (edge_triggered)
+			socket.EnableEdgeTriggered();
+		socket.EnableStats();
+	}
+
+	~LoadConnection() noexcept {
+		if (socket.IsValid()) {
+			if (socket.IsConnected())
+				socket.Close();
+			socket.Destroy();
+		}
+	}
+
+	void Start(unsigned pipeline) noexcept {
+		for (unsigned i = 0; i < pipeline; ++i)
+			Enqueue();
+
+		socket.ScheduleReadNoTimeout(true);
+		TryWrite();
+	}
+
+	void CollectStats(EchoStats &stats) const noexcept {
+		if (socket.IsValid())
+			stats.Add(socket.GetStats());
+	}
+
+private:
+	void Enqueue() noexcept {
+		in_flight.push_back(Clock::now());
+		unsent += size;
+	}
+
+	void Fail(const char *msg) noexcept {
+		fprintf(stderr, "%s\n", msg);
+		socket.Close();
+		socket.Destroy();
+	}
+
+	/**
+	 * @return false if the connection has been destroyed
+	 */
+	bool TryWrite() noexcept {
+		while (unsent > 0) {
+			const size_t chunk = std::min(unsent,
+						      message_size - send_position);
+			ssize_t nbytes = socket.Write(message + send_position,
+						      chunk);
+			if (nbytes < 0) {
+				if (nbytes == WRITE_BLOCKING) {
+					socket.ScheduleWrite();
+					return true;
+				}
+
+				if (nbytes != WRITE_DESTROYED)
+					Fail("Failed to send request");
+				return false;
+			}
+
+			unsent -= nbytes;
+			send_position += nbytes;
+			if (send_position == message_size)
+				send_position = 0;
+
+			if (size_t(nbytes) < chunk) {
+				socket.ScheduleWrite();
+				return true;
+			}
+		}
+
+		socket.UnscheduleWrite();
+		return true;
+	}
+
+	/* virtual methods from class BufferedSocketHandler */
+	BufferedResult OnBufferedData(const void *buffer, size_t size) override;
+
+	bool OnBufferedClosed() noexcept override {
+		Fail("Server closed the connection");
+		return false;
+	}
+
+	bool OnBufferedWrite() override {
+		return TryWrite();
+	}
+
+	void OnBufferedError(std::exception_ptr e) noexcept override {
+		PrintException(e);
+		socket.Close();
+		socket.Destroy();
+	}
+};
+
+class LoadGenerator {
+	EventLoop &event_loop;
+
+	TimerEvent stop_timer;
+
+	std::vector<std::unique_ptr<LoadConnection>> connections;
+
+	std::unique_ptr<char[]> message;
+	const size_t message_size;
+
+	/**
+	 * Round-trip times (in nanoseconds) of all completed
+	 * requests.
+	 */
+	std::vector<uint32_t> latencies;
+
+	bool running = true;
+
+public:
+	LoadGenerator(EventLoop &_event_loop, size_t size, unsigned pipeline)
+		:event_loop(_event_loop),
+		 stop_timer(event_loop, BIND_THIS_METHOD(OnStopTimer)),
+		 message(new char[size * pipeline]),
+		 message_size(size * pipeline) {
+		memset(message.get(), 'x', message_size);
+		latencies.reserve(1 << 20);
+	}
+
+	void Connect(SocketAddress address, unsigned n, size_t size) {
+		for (unsigned i = 0; i < n; ++i) {
+			UniqueSocketDescriptor fd;
+			if (!fd.Create(AF_INET, SOCK_STREAM, 0))
+				throw MakeErrno("Failed to create socket");
+
+			/* a blocking connect() to a loopback listener
+			   completes immediately */
+			if (!fd.Connect(address))
+				throw MakeErrno("Failed to connect");
+
+			fd.SetNonBlocking();
+			fd.SetNoDelay();
+
+			connections.emplace_back(new LoadConnection(*this, event_loop,
+								    std::move(fd),
+								    message.get(),
+								    message_size,
+								    size));
+		}
+	}
+
+	void Start(unsigned pipeline, unsigned seconds) noexcept {
+		stop_timer.Add({time_t(seconds), 0});
+
+		for (auto &i : connections)
+			i->Start(pipeline);
+	}
+
+	bool IsRunning() const noexcept {
+		return running;
+	}
+
+	void AddLatency(Clock::duration d) noexcept {
+		latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+	}
+
+	std::vector<uint32_t> &GetLatencies() noexcept {
+		return latencies;
+	}
+
+	void CollectStats(EchoStats &stats) const noexcept {
+		for (const auto &i : connections)
+			i->CollectStats(stats);
+	}
+
+private:
+	void OnStopTimer() noexcept {
+		running = false;
+		event_loop.Break();
+	}
+};
+
+BufferedResult
+LoadConnection::OnBufferedData(const void *, size_t length)
+{
+	socket.Consumed(length);
+
+	while (length > 0) {
+		if (in_flight.empty()) {
+			Fail("Excess data from server");
+			return BufferedResult::CLOSED;
+		}
+
+		const size_t chunk = std::min(length,
+					      size - receive_position);
+		receive_position += chunk;
+		length -= chunk;
+
+		if (receive_position == size) {
+			receive_position = 0;
+
+			generator.AddLatency(Clock::now() - in_flight.front());
+			in_flight.pop_front();
+
+			if (generator.IsRunning())
+				Enqueue();
+		}
+	}
+
+	if (!TryWrite())
+		return BufferedResult::CLOSED;
+
+	return in_flight.empty()
+		? BufferedResult::OK
+		: BufferedResult::MORE;
+}
+
+static double
+Percentile(std::vector<uint32_t> &v, double p) noexcept
+{
+	if (v.empty())
+		return 0;
+
+	auto i = v.begin() + size_t((v.size() - 1) * p);
+	std::nth_element(v.begin(), i, v.end());
+	return *i / 1000.;
+}
+
+int
+main(int argc, char **argv)
+try {
+	const unsigned n_connections = argc > 1 ? strtoul(argv[1], nullptr, 10) : 16;
+	const size_t size = argc > 2 ? strtoul(argv[2], nullptr, 10) : 64;
+	const unsigned pipeline = argc > 3 ? strtoul(argv[3], nullptr, 10) : 1;
+	const unsigned seconds = argc > 4 ? strtoul(argv[4], nullptr, 10) : 3;
+	edge_triggered = argc > 5 && strcmp(argv[5], "edge") == 0;
+
+	if (n_connections == 0 || size == 0 || pipeline == 0 || seconds == 0 ||
+	    (argc > 5 && !edge_triggered)) {
+		fprintf(stderr, "Usage: %s [CONNECTIONS [SIZE [PIPELINE [SECONDS [edge]]]]]\n",
+			argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	EventLoop event_loop;
+
+	EchoServer server(event_loop);
+	server.Listen(IPv4Address(127, 0, 0, 1, 0));
+	server.SetAcceptBatch(64);
+
+	LoadGenerator generator(event_loop, size, pipeline);
+	generator.Connect(server.GetLocalAddress(), n_connections, size);
+
+	/* accept all connections before starting the clock */
+	while (server.GetConnectionCount() < n_connections)
+		event_loop.LoopOnce();
+
+	EventLoopInstrumentation instrumentation;
+	event_loop.SetInstrumentation(&instrumentation);
+
+	const auto start = Clock::now();
+	generator.Start(pipeline, seconds);
+	event_loop.Dispatch();
+	const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+	event_loop.SetInstrumentation(nullptr);
+
+	EchoStats client_stats, server_stats;
+	generator.CollectStats(client_stats);
+	server.CollectStats(server_stats);
+
+	auto &latencies = generator.GetLatencies();
+	const double n_requests = latencies.size();
+	if (n_requests == 0) {
+		fprintf(stderr, "No request completed\n");
+		return EXIT_FAILURE;
+	}
+
+	const uint64_t iterations = instrumentation.busy.GetCount();
+
+	printf("connections=%u size=%zu pipeline=%u%s\n",
+	       n_connections, size, pipeline,
+	       edge_triggered ? " edge-triggered" : "");
+	printf("%.0f requests/s, %.1f MB/s\n",
+	       n_requests / elapsed.count(),
+	       n_requests * size / elapsed.count() / 1e6);
+	printf("latency p50=%.1f us p99=%.1f us\n",
+	       Percentile(latencies, 0.5),
+	       Percentile(latencies, 0.99));
+	printf("syscalls/request: client send=%.2f recv=%.2f"
+	       " server send=%.2f recv=%.2f epoll_wait=%.2f total=%.2f\n",
+	       client_stats.write_calls / n_requests,
+	       client_stats.read_calls / n_requests,
+	       server_stats.write_calls / n_requests,
+	       server_stats.read_calls / n_requests,
+	       iterations / n_requests,
+	       (client_stats.write_calls + client_stats.read_calls +
+		server_stats.write_calls + server_stats.read_calls +
+		iterations) / n_requests);
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
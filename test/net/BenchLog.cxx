@@ -0,0 +1,227 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Micro-benchmarks for the Net::Log codec.  Run with "meson test
+ * --benchmark" or directly; an optional argument specifies the
+ * minimum duration of each measurement in seconds.
+ */
+
+#include "net/log/Serializer.hxx"
+#include "net/log/Parser.hxx"
+#include "net/log/OneLine.hxx"
+#include "net/log/Datagram.hxx"
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+using namespace Net::Log;
+
+static constexpr size_t CORPUS_SIZE = 1024;
+
+static const char *const user_agents[] = {
+	"Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36",
+	"Mozilla/5.0 (iPhone; CPU iPhone OS 17_1 like Mac OS X) AppleWebKit/605.1.15 (KHTML, like Gecko) Version/17.1 Mobile/15E148 Safari/604.1",
+	"Mozilla/5.0 (Windows NT 10.0; Win64; x64; rv:121.0) Gecko/20100101 Firefox/121.0",
+	"curl/8.4.0",
+	"Googlebot/2.1 (+http://www.google.com/bot.html)",
+};
+
+/**
+ * A set of records together with the strings they point to.
+ */
+struct Corpus {
+	const char *name;
+
+	std::vector<std::string> strings;
+	std::vector<Datagram> datagrams;
+
+	/**
+	 * All records serialized back to back; #offsets has one more
+	 * element than #datagrams.
+	 */
+	std::vector<uint8_t> packets;
+	std::vector<size_t> offsets;
+
+	size_t total_size = 0;
+
+	Corpus(const char *_name, bool long_uri, bool user_agent);
+};
+
+static std::string
+RandomPath(std::mt19937 &rng, unsigned n_segments)
+{
+	static constexpr char chars[] = "abcdefghijklmnopqrstuvwxyz0123456789-_";
+
+	std::string path;
+	for (unsigned i = 0; i < n_segments; ++i) {
+		path.push_back('/');
+		const unsigned length = 3 + rng() % 10;
+		for (unsigned j = 0; j < length; ++j)
+			path.push_back(chars[rng() % (sizeof(chars) - 1)]);
+	}
+
+	return path;
+}
+
+Corpus::Corpus(const char *_name, bool long_uri, bool user_agent)
+	:name(_name)
+{
+	std::mt19937 rng(42);
+
+	/* four strings per record; reserve so the pointers stay
+	   valid */
+	strings.reserve(CORPUS_SIZE * 4);
+	datagrams.reserve(CORPUS_SIZE);
+
+	for (size_t i = 0; i < CORPUS_SIZE; ++i) {
+		std::string uri = long_uri
+			? RandomPath(rng, 8) + "?utm_source=newsletter&utm_medium=email&session=" + std::to_string(rng()) + "&q=%22quoted%22"
+			: RandomPath(rng, 1 + rng() % 2);
+		strings.emplace_back(std::move(uri));
+		const char *uri_p = strings.back().c_str();
+
+		strings.emplace_back(std::to_string(10 + rng() % 200) + "." +
+				     std::to_string(rng() % 256) + "." +
+				     std::to_string(rng() % 256) + "." +
+				     std::to_string(rng() % 256));
+		const char *remote_host = strings.back().c_str();
+
+		strings.emplace_back("site" + std::to_string(rng() % 50));
+		const char *site = strings.back().c_str();
+
+		strings.emplace_back("www." + std::string(site) + ".example.com");
+		const char *host = strings.back().c_str();
+
+		datagrams.emplace_back(std::chrono::system_clock::time_point(std::chrono::seconds(1700000000 + i)),
+				       HTTP_METHOD_GET, uri_p,
+				       remote_host, host, site,
+				       user_agent ? "https://www.example.com/index.html" : nullptr,
+				       user_agent ? user_agents[rng() % (sizeof(user_agents) / sizeof(user_agents[0]))] : nullptr,
+				       HTTP_STATUS_OK, rng() % 100000,
+				       300 + rng() % 500, 1000 + rng() % 100000,
+				       std::chrono::microseconds(rng() % 1000000));
+	}
+
+	packets.resize(datagrams.size() * 4096);
+	offsets.push_back(0);
+	for (const auto &d : datagrams) {
+		const size_t size = Serialize(&packets[total_size],
+					      packets.size() - total_size, d);
+		if (size == 0)
+			abort();
+
+		total_size += size;
+		offsets.push_back(total_size);
+	}
+}
+
+/**
+ * Invoke the function on all records of the corpus repeatedly for
+ * at least the given duration and print the result.
+ */
+template<typename F>
+static void
+Measure(const char *what, const Corpus &corpus, double min_seconds, F &&f)
+{
+	using clock = std::chrono::steady_clock;
+
+	uint64_t n = 0;
+	const auto start = clock::now();
+	std::chrono::duration<double> elapsed;
+
+	do {
+		for (size_t i = 0; i < corpus.datagrams.size(); ++i)
+			f(i);
+		n += corpus.datagrams.size();
+		elapsed = clock::now() - start;
+	} while (elapsed.count() < min_seconds);
+
+	const double ns = elapsed.count() * 1e9 / n;
+	printf("%-14s %-16s %10.0f records/s %8.1f ns/record\n",
+	       what, corpus.name, n / elapsed.count(), ns);
+}
+
+/**
+ * Prevent the compiler from optimizing away a result.
+ */
+static volatile size_t sink;
+
+int
+main(int argc, char **argv)
+{
+	const double min_seconds = argc > 1 ? strtod(argv[1], nullptr) : 0.5;
+
+	const Corpus corpora[] = {
+		{"short-uri", false, false},
+		{"short-uri+agent", false, true},
+		{"long-uri", true, false},
+		{"long-uri+agent", true, true},
+	};
+
+	for (const auto &corpus : corpora)
+		printf("corpus %-16s %5.0f bytes/record\n", corpus.name,
+		       double(corpus.total_size) / corpus.datagrams.size());
+
+	for (const auto &corpus : corpora) {
+		Measure("parse", corpus, min_seconds, [&corpus](size_t i){
+				const auto *p = &corpus.packets[corpus.offsets[i]];
+				const auto *end = &corpus.packets[corpus.offsets[i + 1]];
+				sink += ParseDatagram(p, end).length;
+			});
+
+		uint8_t buffer[4096];
+		Measure("serialize", corpus, min_seconds, [&corpus, &buffer](size_t i){
+				sink += Serialize(buffer, sizeof(buffer),
+						  corpus.datagrams[i]);
+			});
+
+		Measure("serialize+crc", corpus, min_seconds, [&corpus, &buffer](size_t i){
+				sink += Serialize(buffer, sizeof(buffer),
+						  corpus.datagrams[i], true);
+			});
+
+		static char line[ONE_LINE_MAX];
+		Measure("oneline", corpus, min_seconds, [&corpus](size_t i){
+				sink += FormatOneLine(line, sizeof(line),
+						      corpus.datagrams[i]);
+			});
+	}
+
+	return EXIT_SUCCESS;
+}
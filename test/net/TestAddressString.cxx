@@ -63,3 +63,41 @@ TEST(SocketAddressStringTest, Basic)
         ASSERT_STREQ(buffer, host);
     }
 }
+
+TEST(SocketAddressStringTest, Format)
+{
+    static constexpr struct {
+        const char *in, *out;
+    } tests[] = {
+        { "0.0.0.0:0", "0.0.0.0:0" },
+        { "255.255.255.255:65535", "255.255.255.255:65535" },
+        { "::", "[::]:80" },
+        { "2001:DB8:0:0:0:0:2:1", "[2001:db8::2:1]:80" },
+        { "2001:db8:0:1:1:1:1:1", "[2001:db8:0:1:1:1:1:1]:80" },
+        { "2001:0:0:1:0:0:0:1", "[2001:0:0:1::1]:80" },
+        { "2001:db8:0:0:1:0:0:1", "[2001:db8::1:0:0:1]:80" },
+        { "1:0:0:0:0:0:0:0", "[1::]:80" },
+        { "0:0:0:0:0:0:0:1", "[::1]:80" },
+        { "[2001:db8::1%3]:22", "[2001:db8::1%3]:22" },
+        { "::ffff:c0a8:102", "192.168.1.2:80" },
+        { "[::ffff:c0a8:102]:8080", "192.168.1.2:8080" },
+    };
+
+    for (const auto &i : tests) {
+        const auto address = ParseSocketAddress(i.in, 80, false);
+
+        char buffer[256];
+        ASSERT_TRUE(ToString(buffer, sizeof(buffer), address));
+        ASSERT_STREQ(buffer, i.out);
+    }
+
+    /* buffer too small */
+    const auto address = ParseSocketAddress("192.168.1.2:80", 80, false);
+    char buffer[16];
+    ASSERT_FALSE(ToString(buffer, 14, address));
+    ASSERT_TRUE(ToString(buffer, 15, address));
+    ASSERT_STREQ(buffer, "192.168.1.2:80");
+    ASSERT_FALSE(HostToString(buffer, 11, address));
+    ASSERT_TRUE(HostToString(buffer, 12, address));
+    ASSERT_STREQ(buffer, "192.168.1.2");
+}
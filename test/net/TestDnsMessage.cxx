@@ -0,0 +1,229 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "net/DnsMessage.hxx"
+#include "net/SocketProtocolError.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <string.h>
+#include <sys/socket.h>
+
+namespace {
+
+/**
+ * Helper to assemble DNS responses.
+ */
+class ResponseBuilder {
+	std::vector<uint8_t> data;
+
+public:
+	ResponseBuilder(const char *name, uint16_t type,
+			unsigned rcode=0, unsigned ancount=1,
+			unsigned nscount=0) {
+		uint8_t buffer[512];
+		size_t size = BuildDnsQuery(buffer, sizeof(buffer), 0x1234,
+					    name, type);
+		EXPECT_GT(size, 0u);
+		data.assign(buffer, buffer + size);
+
+		data[2] |= 0x80; /* QR */
+		data[3] |= rcode;
+		data[7] = ancount;
+		data[9] = nscount;
+	}
+
+	ResponseBuilder &Byte(uint8_t value) {
+		data.push_back(value);
+		return *this;
+	}
+
+	ResponseBuilder &Uint16(uint16_t value) {
+		return Byte(value >> 8).Byte(value);
+	}
+
+	ResponseBuilder &Uint32(uint32_t value) {
+		return Uint16(value >> 16).Uint16(value);
+	}
+
+	/**
+	 * Append a compression pointer to the question name.
+	 */
+	ResponseBuilder &QuestionName() {
+		return Uint16(0xc00c);
+	}
+
+	ResponseBuilder &Name(const char *name) {
+		while (*name != 0) {
+			const char *dot = strchr(name, '.');
+			size_t length = dot != nullptr ? size_t(dot - name) : strlen(name);
+			Byte(length);
+			data.insert(data.end(), name, name + length);
+			name += length;
+			if (*name == '.')
+				++name;
+		}
+
+		return Byte(0);
+	}
+
+	ResponseBuilder &Header(uint16_t type, uint32_t ttl,
+				uint16_t rdlength) {
+		return Uint16(type).Uint16(1).Uint32(ttl).Uint16(rdlength);
+	}
+
+	ResponseBuilder &A(uint32_t ttl, uint8_t a, uint8_t b,
+			   uint8_t c, uint8_t d) {
+		return Header(DNS_TYPE_A, ttl, 4).Byte(a).Byte(b).Byte(c).Byte(d);
+	}
+
+	ConstBuffer<void> Get() const {
+		return {data.data(), data.size()};
+	}
+};
+
+}
+
+TEST(DnsMessage, BuildQuery)
+{
+	uint8_t buffer[512];
+	size_t size = BuildDnsQuery(buffer, sizeof(buffer), 0xabcd,
+				    "www.example.com", DNS_TYPE_AAAA);
+
+	static constexpr uint8_t expected[] = {
+		0xab, 0xcd, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00,
+		3, 'w', 'w', 'w', 7, 'e', 'x', 'a', 'm', 'p', 'l', 'e',
+		3, 'c', 'o', 'm', 0,
+		0x00, 0x1c, 0x00, 0x01,
+	};
+
+	ASSERT_EQ(size, sizeof(expected));
+	EXPECT_EQ(memcmp(buffer, expected, size), 0);
+	EXPECT_EQ(GetDnsId({buffer, size}), 0xabcd);
+
+	/* a trailing dot is allowed */
+	EXPECT_EQ(BuildDnsQuery(buffer, sizeof(buffer), 0xabcd,
+				"www.example.com.", DNS_TYPE_AAAA),
+		  sizeof(expected));
+
+	/* invalid names */
+	EXPECT_EQ(BuildDnsQuery(buffer, sizeof(buffer), 0, "", DNS_TYPE_A), 0u);
+	EXPECT_EQ(BuildDnsQuery(buffer, sizeof(buffer), 0, "foo..bar", DNS_TYPE_A), 0u);
+	EXPECT_EQ(BuildDnsQuery(buffer, sizeof(buffer), 0, ".", DNS_TYPE_A), 0u);
+
+	/* buffer too small */
+	EXPECT_EQ(BuildDnsQuery(buffer, 20, 0, "www.example.com", DNS_TYPE_A), 0u);
+}
+
+TEST(DnsMessage, ParseA)
+{
+	ResponseBuilder b("Example.com", DNS_TYPE_A, 0, 2);
+	b.QuestionName().A(300, 192, 0, 2, 1);
+	b.QuestionName().A(200, 192, 0, 2, 2);
+
+	const auto r = ParseDnsResponse(b.Get(), "example.COM", DNS_TYPE_A);
+	EXPECT_EQ(r.id, 0x1234);
+	EXPECT_EQ(r.rcode, DNS_RCODE_NOERROR);
+	EXPECT_FALSE(r.truncated);
+	EXPECT_EQ(r.ttl, 200u);
+	ASSERT_EQ(r.answers.size(), 2u);
+	EXPECT_EQ(r.answers[0].family, AF_INET);
+	EXPECT_EQ(r.answers[0].ttl, 300u);
+	EXPECT_EQ(r.answers[0].address[3], 1);
+	EXPECT_EQ(r.answers[1].address[3], 2);
+}
+
+TEST(DnsMessage, ParseCname)
+{
+	/* the CNAME record comes after the address record to check
+	   that the order does not matter */
+	ResponseBuilder b("www.example.com", DNS_TYPE_A, 0, 3);
+	b.Name("cdn.example.net").A(600, 198, 51, 100, 7);
+	b.Name("other.example.net").A(600, 203, 0, 113, 1);
+	b.QuestionName().Header(DNS_TYPE_CNAME, 60, 17).Name("cdn.example.net");
+
+	const auto r = ParseDnsResponse(b.Get(), "www.example.com", DNS_TYPE_A);
+	EXPECT_EQ(r.ttl, 60u);
+	ASSERT_EQ(r.answers.size(), 1u);
+	EXPECT_EQ(r.answers[0].address[0], 198);
+}
+
+TEST(DnsMessage, ParseNegative)
+{
+	ResponseBuilder b("nx.example.com", DNS_TYPE_AAAA,
+			  DNS_RCODE_NXDOMAIN, 0, 1);
+	b.Name("example.com").Header(6, 3600, 2 + 20)
+		.Byte(0).Byte(0)
+		.Uint32(1).Uint32(7200).Uint32(900).Uint32(86400).Uint32(120);
+
+	const auto r = ParseDnsResponse(b.Get(), "nx.example.com", DNS_TYPE_AAAA);
+	EXPECT_EQ(r.rcode, DNS_RCODE_NXDOMAIN);
+	EXPECT_TRUE(r.answers.empty());
+	EXPECT_EQ(r.ttl, 120u);
+}
+
+TEST(DnsMessage, ParseTruncated)
+{
+	ResponseBuilder b("example.com", DNS_TYPE_A, 0, 1);
+	const_cast<uint8_t *>((const uint8_t *)b.Get().data)[2] |= 0x02;
+
+	const auto r = ParseDnsResponse(b.Get(), "example.com", DNS_TYPE_A);
+	EXPECT_TRUE(r.truncated);
+	EXPECT_TRUE(r.answers.empty());
+}
+
+TEST(DnsMessage, ParseMalformed)
+{
+	/* wrong name */
+	ResponseBuilder a("example.com", DNS_TYPE_A, 0, 0);
+	EXPECT_THROW(ParseDnsResponse(a.Get(), "example.org", DNS_TYPE_A),
+		     SocketProtocolError);
+
+	/* wrong type */
+	EXPECT_THROW(ParseDnsResponse(a.Get(), "example.com", DNS_TYPE_AAAA),
+		     SocketProtocolError);
+
+	/* record is truncated */
+	ResponseBuilder b("example.com", DNS_TYPE_A, 0, 1);
+	b.QuestionName().Header(DNS_TYPE_A, 60, 4).Byte(1);
+	EXPECT_THROW(ParseDnsResponse(b.Get(), "example.com", DNS_TYPE_A),
+		     SocketProtocolError);
+
+	/* compression loop */
+	ResponseBuilder c("example.com", DNS_TYPE_A, 0, 1);
+	c.Uint16(0xc000 | 29).A(60, 1, 2, 3, 4);
+	EXPECT_THROW(ParseDnsResponse(c.Get(), "example.com", DNS_TYPE_A),
+		     SocketProtocolError);
+}
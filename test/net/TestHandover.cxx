@@ -0,0 +1,119 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "net/Handover.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "net/IPv4Address.hxx"
+#include "net/StaticSocketAddress.hxx"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include <sys/socket.h>
+
+static void
+CreatePair(UniqueSocketDescriptor &a, UniqueSocketDescriptor &b)
+{
+	ASSERT_TRUE(UniqueSocketDescriptor::CreateSocketPair(AF_LOCAL,
+							     SOCK_SEQPACKET, 0,
+							     a, b));
+}
+
+TEST(Handover, Basic)
+{
+	UniqueSocketDescriptor old_side, new_side;
+	CreatePair(old_side, new_side);
+
+	UniqueSocketDescriptor listener;
+	ASSERT_TRUE(listener.Create(AF_INET, SOCK_STREAM, 0));
+	ASSERT_TRUE(listener.Bind(IPv4Address(127, 0, 0, 1, 0)));
+	ASSERT_TRUE(listener.Listen(16));
+
+	/* a connection in the accept queue survives the handover */
+	UniqueSocketDescriptor client;
+	ASSERT_TRUE(client.Create(AF_INET, SOCK_STREAM, 0));
+	ASSERT_TRUE(client.Connect(listener.GetLocalAddress()));
+
+	std::string snapshot(200000, 0);
+	for (size_t i = 0; i < snapshot.size(); ++i)
+		snapshot[i] = char(i * 7);
+
+	std::thread thread([&](){
+		HandoverWriter w(old_side);
+		w.AddListener("http", listener);
+		w.AddSnapshot("cache", {snapshot.data(), snapshot.size()});
+		w.AddSnapshot("empty", nullptr);
+		w.Finish();
+		listener.Close();
+	});
+
+	HandoverReader r;
+	r.Receive(new_side);
+	thread.join();
+
+	auto fd = r.TakeListener("http");
+	ASSERT_TRUE(fd.IsDefined());
+	EXPECT_FALSE(r.TakeListener("http").IsDefined());
+	EXPECT_FALSE(r.TakeListener("ftp").IsDefined());
+	EXPECT_TRUE(r.GetListeners().empty());
+
+	EXPECT_EQ(r.TakeSnapshot("cache"), snapshot);
+	EXPECT_EQ(r.TakeSnapshot("empty"), "");
+
+	UniqueSocketDescriptor accepted(fd.Accept());
+	EXPECT_TRUE(accepted.IsDefined());
+}
+
+TEST(Handover, NotListener)
+{
+	UniqueSocketDescriptor old_side, new_side;
+	CreatePair(old_side, new_side);
+
+	HandoverWriter w(old_side);
+	w.AddListener("x", old_side);
+
+	HandoverReader r;
+	EXPECT_THROW(r.Receive(new_side), std::runtime_error);
+}
+
+TEST(Handover, PrematureEnd)
+{
+	UniqueSocketDescriptor old_side, new_side;
+	CreatePair(old_side, new_side);
+
+	HandoverWriter(old_side).AddSnapshot("x", nullptr);
+	old_side.Close();
+
+	HandoverReader r;
+	EXPECT_THROW(r.Receive(new_side), std::runtime_error);
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "net/InterfaceTable.hxx"
+#include "net/Interface.hxx"
+#include "net/IPv4Address.hxx"
+#include "net/IPv6Address.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <string.h>
+
+/**
+ * Builds a buffer of netlink messages.
+ */
+class NetlinkBuilder {
+	std::string buffer;
+
+	size_t message_start;
+
+	void AppendPadded(const void *data, size_t size) {
+		buffer.append((const char *)data, size);
+		buffer.append(NLMSG_ALIGN(size) - size, 0);
+	}
+
+public:
+	template<typename T>
+	void Begin(uint16_t type, const T &body) {
+		message_start = buffer.size();
+
+		struct nlmsghdr nlh;
+		memset(&nlh, 0, sizeof(nlh));
+		nlh.nlmsg_type = type;
+		AppendPadded(&nlh, sizeof(nlh));
+		AppendPadded(&body, sizeof(body));
+	}
+
+	void Attribute(uint16_t type, const void *data, size_t size) {
+		struct rtattr rta;
+		rta.rta_type = type;
+		rta.rta_len = RTA_LENGTH(size);
+		buffer.append((const char *)&rta, sizeof(rta));
+		AppendPadded(data, size);
+	}
+
+	void End() {
+		auto *nlh = (struct nlmsghdr *)&buffer[message_start];
+		nlh->nlmsg_len = buffer.size() - message_start;
+	}
+
+	void Link(uint16_t type, int index, const char *name) {
+		struct ifinfomsg ifi;
+		memset(&ifi, 0, sizeof(ifi));
+		ifi.ifi_index = index;
+		ifi.ifi_flags = IFF_UP;
+		Begin(type, ifi);
+		Attribute(IFLA_IFNAME, name, strlen(name) + 1);
+		End();
+	}
+
+	void Address(uint16_t type, int index, int family,
+		     const void *address, size_t size) {
+		struct ifaddrmsg ifa;
+		memset(&ifa, 0, sizeof(ifa));
+		ifa.ifa_family = family;
+		ifa.ifa_index = index;
+		Begin(type, ifa);
+		Attribute(IFA_ADDRESS, address, size);
+		End();
+	}
+
+	bool FeedTo(NetworkInterfaceTable &table) {
+		bool result = table.Feed(buffer.data(), buffer.size());
+		buffer.clear();
+		return result;
+	}
+};
+
+TEST(InterfaceTable, Feed)
+{
+	NetworkInterfaceTable table;
+	NetlinkBuilder b;
+
+	const uint8_t a4[] = {192, 168, 1, 2};
+	struct in6_addr a6;
+	memset(&a6, 0, sizeof(a6));
+	a6.s6_addr[0] = 0x20;
+	a6.s6_addr[1] = 0x01;
+	a6.s6_addr[15] = 0x42;
+
+	b.Link(RTM_NEWLINK, 7, "eth0");
+	b.Link(RTM_NEWLINK, 8, "eth1");
+	b.Address(RTM_NEWADDR, 7, AF_INET, a4, sizeof(a4));
+	b.Address(RTM_NEWADDR, 8, AF_INET6, &a6, sizeof(a6));
+	ASSERT_TRUE(b.FeedTo(table));
+
+	EXPECT_EQ(table.GetInterfaceCount(), 2u);
+	EXPECT_EQ(table.GetAddressCount(), 2u);
+	EXPECT_EQ(table.FindByName("eth0"), 7u);
+	EXPECT_EQ(table.FindByName("eth1"), 8u);
+	EXPECT_EQ(table.FindByName("eth2"), 0u);
+	ASSERT_NE(table.FindByIndex(7), nullptr);
+	EXPECT_EQ(table.FindByIndex(7)->name, "eth0");
+	EXPECT_EQ(table.FindByAddress(IPv4Address(192, 168, 1, 2, 80)), 7u);
+	EXPECT_EQ(table.FindByAddress(IPv4Address(192, 168, 1, 3, 80)), 0u);
+	EXPECT_EQ(table.FindByAddress(IPv6Address(0x2001, 0, 0, 0, 0, 0, 0, 0x42, 0)), 8u);
+
+	/* rename */
+	b.Link(RTM_NEWLINK, 7, "lan");
+	ASSERT_TRUE(b.FeedTo(table));
+	EXPECT_EQ(table.FindByName("eth0"), 0u);
+	EXPECT_EQ(table.FindByName("lan"), 7u);
+
+	/* remove the address */
+	b.Address(RTM_DELADDR, 7, AF_INET, a4, sizeof(a4));
+	ASSERT_TRUE(b.FeedTo(table));
+	EXPECT_EQ(table.FindByAddress(IPv4Address(192, 168, 1, 2, 80)), 0u);
+
+	/* removing an interface removes its addresses */
+	b.Link(RTM_DELLINK, 8, "eth1");
+	ASSERT_TRUE(b.FeedTo(table));
+	EXPECT_EQ(table.FindByName("eth1"), 0u);
+	EXPECT_EQ(table.FindByIndex(8), nullptr);
+	EXPECT_EQ(table.GetAddressCount(), 0u);
+
+	/* NLMSG_DONE terminates a dump */
+	b.Begin(NLMSG_DONE, 0);
+	b.End();
+	ASSERT_FALSE(b.FeedTo(table));
+}
+
+TEST(InterfaceTable, Load)
+{
+	NetworkInterfaceTable table;
+	table.Load();
+
+	const unsigned lo = table.FindByName("lo");
+	ASSERT_NE(lo, 0u);
+	ASSERT_EQ(lo, if_nametoindex("lo"));
+
+	const IPv4Address localhost(127, 0, 0, 1, 0);
+	EXPECT_EQ(table.FindByAddress(localhost), lo);
+	EXPECT_EQ(table.FindByAddress(localhost),
+		  FindNetworkInterface(localhost));
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "net/log/Aggregator.hxx"
+#include "net/log/Datagram.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include <stdio.h>
+
+using namespace Net::Log;
+
+static Datagram
+MakeDatagram(const char *site, http_status_t status,
+	     uint64_t received, uint64_t sent, uint64_t duration_us) noexcept
+{
+	Datagram d;
+	d.site = site;
+	d.http_status = status;
+	d.valid_http_status = true;
+	d.traffic_received = received;
+	d.traffic_sent = sent;
+	d.valid_traffic = true;
+	d.duration = duration_us;
+	d.valid_duration = true;
+	return d;
+}
+
+static const Aggregator::Entry *
+FindEntry(const std::vector<Aggregator::Entry> &v, const char *key) noexcept
+{
+	auto i = std::find_if(v.begin(), v.end(),
+			      [key](const Aggregator::Entry &e){
+				      return e.key == key;
+			      });
+	return i != v.end() ? &*i : nullptr;
+}
+
+TEST(LogAggregator, Basic)
+{
+	Aggregator a(16);
+
+	a.Add(MakeDatagram("a", HTTP_STATUS_OK, 100, 1000, 0));
+	a.Add(MakeDatagram("a", HTTP_STATUS_NOT_FOUND, 10, 20, 3));
+	a.Add(MakeDatagram("b", HTTP_STATUS_INTERNAL_SERVER_ERROR, 1, 2, 1000));
+	a.Add(Datagram(StringView("message")));
+
+	const auto s = a.Snapshot();
+	ASSERT_EQ(s.size(), 3u);
+
+	const auto *e = FindEntry(s, "a");
+	ASSERT_NE(e, nullptr);
+	ASSERT_EQ(e->counters.requests, 2u);
+	ASSERT_EQ(e->counters.status[2], 1u);
+	ASSERT_EQ(e->counters.status[4], 1u);
+	ASSERT_EQ(e->counters.traffic_received, 110u);
+	ASSERT_EQ(e->counters.traffic_sent, 1020u);
+	ASSERT_EQ(e->counters.duration[0], 1u);
+	ASSERT_EQ(e->counters.duration[2], 1u);
+
+	e = FindEntry(s, "b");
+	ASSERT_NE(e, nullptr);
+	ASSERT_EQ(e->counters.requests, 1u);
+	ASSERT_EQ(e->counters.status[5], 1u);
+	ASSERT_EQ(e->counters.duration[10], 1u);
+
+	/* records without a site */
+	e = FindEntry(s, "");
+	ASSERT_NE(e, nullptr);
+	ASSERT_EQ(e->counters.requests, 1u);
+	ASSERT_EQ(e->counters.status[0], 1u);
+}
+
+TEST(LogAggregator, Overflow)
+{
+	Aggregator a(4);
+
+	char site[8];
+	for (unsigned i = 0; i < 10; ++i) {
+		snprintf(site, sizeof(site), "s%u", i);
+		a.Add(MakeDatagram(site, HTTP_STATUS_OK, 0, 0, 0));
+	}
+
+	const std::string long_site(100, 'x');
+	a.Add(MakeDatagram(long_site.c_str(), HTTP_STATUS_OK, 0, 0, 0));
+
+	const auto s = a.Snapshot();
+	ASSERT_EQ(s.size(), 5u);
+	ASSERT_EQ(s.back().key, "");
+	ASSERT_EQ(s.back().counters.requests, 7u);
+}
+
+TEST(LogAggregator, ConcurrentSnapshot)
+{
+	Aggregator a(64);
+	std::atomic<bool> done{false};
+
+	std::thread reader([&a, &done](){
+			uint64_t last = 0;
+			while (!done.load()) {
+				uint64_t total = 0;
+				a.ForEach([&total](StringView, const Aggregator::Counters &c){
+						total += c.requests;
+					});
+
+				/* counters never go backwards */
+				ASSERT_GE(total, last);
+				last = total;
+			}
+		});
+
+	char site[8];
+	for (unsigned i = 0; i < 100000; ++i) {
+		snprintf(site, sizeof(site), "s%u", i % 50);
+		a.Add(MakeDatagram(site, HTTP_STATUS_OK, 1, 1, i));
+	}
+
+	done = true;
+	reader.join();
+
+	uint64_t total = 0;
+	for (const auto &e : a.Snapshot())
+		total += e.counters.requests;
+	ASSERT_EQ(total, 100000u);
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "net/log/ArchiveWriter.hxx"
+#include "net/log/ArchiveReader.hxx"
+#include "net/log/Serializer.hxx"
+#include "net/log/Datagram.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+using namespace Net::Log;
+
+namespace {
+
+class TempFile {
+	char path[64] = "/tmp/TestLogArchive.XXXXXX";
+
+public:
+	TempFile() {
+		int fd = mkstemp(path);
+		if (fd < 0)
+			throw std::runtime_error("mkstemp() failed");
+		close(fd);
+	}
+
+	~TempFile() {
+		unlink(path);
+	}
+
+	const char *c_str() const {
+		return path;
+	}
+};
+
+}
+
+static void
+Append(ArchiveWriter &w, uint64_t timestamp, const char *uri)
+{
+	Datagram d;
+	d.timestamp = timestamp;
+	d.valid_timestamp = true;
+	d.http_uri = uri;
+
+	uint8_t buffer[1024];
+	const size_t size = Serialize(buffer, sizeof(buffer), d);
+	ASSERT_GT(size, 0u);
+	w.Append({buffer, size}, d);
+}
+
+static std::vector<std::string>
+Collect(const ArchiveReader &r, uint64_t since, uint64_t until)
+{
+	std::vector<std::string> result;
+	r.ForEachInRange(since, until, [&result](const Datagram &d){
+			result.emplace_back(d.http_uri);
+		});
+	return result;
+}
+
+TEST(LogArchive, Basic)
+{
+	const TempFile path;
+
+	{
+		ArchiveWriter w(path.c_str());
+		Append(w, 100, "/a");
+		Append(w, 200, "/b");
+		w.Flush();
+		Append(w, 300, "/c");
+		Append(w, 400, "/d");
+	}
+
+	const ArchiveReader r(path.c_str());
+	ASSERT_EQ(r.GetBlockCount(), 2u);
+
+	unsigned n = 0;
+	r.ForEach([&n](const Datagram &){ ++n; });
+	ASSERT_EQ(n, 4u);
+
+	ASSERT_EQ(Collect(r, 0, 1000),
+		  (std::vector<std::string>{"/a", "/b", "/c", "/d"}));
+	ASSERT_EQ(Collect(r, 150, 300),
+		  (std::vector<std::string>{"/b", "/c"}));
+	ASSERT_EQ(Collect(r, 301, 399), std::vector<std::string>{});
+	ASSERT_EQ(Collect(r, 500, 600), std::vector<std::string>{});
+}
+
+TEST(LogArchive, Reopen)
+{
+	const TempFile path;
+
+	{
+		ArchiveWriter w(path.c_str());
+		Append(w, 1, "/a");
+	}
+
+	{
+		ArchiveWriter w(path.c_str());
+		Append(w, 2, "/b");
+	}
+
+	const ArchiveReader r(path.c_str());
+	ASSERT_EQ(r.GetBlockCount(), 2u);
+	ASSERT_EQ(Collect(r, 0, 10),
+		  (std::vector<std::string>{"/a", "/b"}));
+}
+
+TEST(LogArchive, Truncated)
+{
+	const TempFile path;
+
+	{
+		ArchiveWriter w(path.c_str());
+		Append(w, 1, "/a");
+		w.Flush();
+		Append(w, 2, "/b");
+	}
+
+	/* simulate a crash while writing the second block */
+	{
+		int fd = open(path.c_str(), O_WRONLY);
+		ASSERT_GE(fd, 0);
+		const off_t size = lseek(fd, 0, SEEK_END);
+		ASSERT_EQ(ftruncate(fd, size - 3), 0);
+		close(fd);
+	}
+
+	{
+		const ArchiveReader r(path.c_str());
+		ASSERT_EQ(r.GetBlockCount(), 1u);
+		ASSERT_EQ(Collect(r, 0, 10), std::vector<std::string>{"/a"});
+	}
+
+	/* the writer removes the truncated block */
+	{
+		ArchiveWriter w(path.c_str());
+		Append(w, 3, "/c");
+	}
+
+	const ArchiveReader r(path.c_str());
+	ASSERT_EQ(r.GetBlockCount(), 2u);
+	ASSERT_EQ(Collect(r, 0, 10),
+		  (std::vector<std::string>{"/a", "/c"}));
+}
+
+TEST(LogArchive, Large)
+{
+	const TempFile path;
+
+	const std::string message(ArchiveWriter::BLOCK_SIZE + 1000, 'x');
+
+	{
+		ArchiveWriter w(path.c_str());
+		Append(w, 1, "/a");
+
+		Datagram d{StringView(message.data(), message.size())};
+		std::vector<uint8_t> buffer(message.size() + 64);
+		const size_t size = Serialize(buffer.data(), buffer.size(), d);
+		ASSERT_GT(size, 0u);
+		w.Append({buffer.data(), size}, d);
+
+		Append(w, 2, "/b");
+	}
+
+	const ArchiveReader r(path.c_str());
+	ASSERT_EQ(r.GetBlockCount(), 3u);
+
+	size_t message_size = 0;
+	r.ForEach([&message_size](const Datagram &d){
+			if (!d.message.IsNull())
+				message_size = d.message.size;
+		});
+	ASSERT_EQ(message_size, message.size());
+
+	ASSERT_EQ(Collect(r, 0, 10),
+		  (std::vector<std::string>{"/a", "/b"}));
+}
+
+TEST(LogArchive, NotAnArchive)
+{
+	const TempFile path;
+
+	{
+		int fd = open(path.c_str(), O_WRONLY);
+		ASSERT_EQ(write(fd, "hello world", 11), 11);
+		close(fd);
+	}
+
+	ASSERT_THROW(ArchiveReader r(path.c_str()), std::runtime_error);
+	ASSERT_THROW(ArchiveWriter w(path.c_str()), std::runtime_error);
+}
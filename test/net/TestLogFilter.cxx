@@ -0,0 +1,129 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "net/log/Filter.hxx"
+#include "net/log/Datagram.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <stdio.h>
+
+using namespace Net::Log;
+
+static Datagram
+MakeDatagram(const char *remote_host, const char *site) noexcept
+{
+	Datagram d;
+	d.remote_host = remote_host;
+	d.site = site;
+	return d;
+}
+
+TEST(LogFilter, PassThrough)
+{
+	Filter filter{Filter::Config()};
+
+	for (unsigned i = 0; i < 1000; ++i)
+		ASSERT_TRUE(filter.Check(MakeDatagram("1.2.3.4", "a"), 0));
+
+	ASSERT_EQ(filter.GetStats().accepted, 1000u);
+	ASSERT_FALSE(filter.HasDropped());
+
+	char buffer[256];
+	ASSERT_TRUE(filter.FormatSummary(buffer, sizeof(buffer)).IsNull());
+}
+
+TEST(LogFilter, Sample)
+{
+	Filter::Config config;
+	config.sample_rate = 0.25;
+	Filter filter(config);
+
+	unsigned kept = 0;
+	for (unsigned i = 0; i < 10000; ++i) {
+		char address[32];
+		snprintf(address, sizeof(address), "10.%u.%u.%u",
+			 i >> 16, (i >> 8) & 0xff, i & 0xff);
+
+		const bool result = filter.Check(MakeDatagram(address, nullptr), 0);
+		if (result)
+			++kept;
+
+		/* deterministic: the same key gives the same result */
+		ASSERT_EQ(filter.Check(MakeDatagram(address, nullptr), 0), result);
+	}
+
+	ASSERT_GT(kept, 2000u);
+	ASSERT_LT(kept, 3000u);
+
+	/* records without a key are never sampled */
+	ASSERT_TRUE(filter.Check(Datagram(StringView("hello")), 0));
+}
+
+TEST(LogFilter, RateLimit)
+{
+	Filter::Config config;
+	config.site_rate = 10;
+	config.site_burst = 5;
+	config.max_sites = 2;
+	Filter filter(config);
+
+	for (unsigned i = 0; i < 5; ++i) {
+		ASSERT_TRUE(filter.Check(MakeDatagram(nullptr, "a"), 100));
+		ASSERT_TRUE(filter.Check(MakeDatagram(nullptr, "b"), 100));
+	}
+
+	ASSERT_FALSE(filter.Check(MakeDatagram(nullptr, "a"), 100));
+	ASSERT_FALSE(filter.Check(MakeDatagram(nullptr, "b"), 100));
+
+	/* these two share the overflow bucket */
+	for (unsigned i = 0; i < 5; ++i)
+		ASSERT_TRUE(filter.Check(MakeDatagram(nullptr, i % 2 ? "c" : "d"), 100));
+	ASSERT_FALSE(filter.Check(MakeDatagram(nullptr, "c"), 100));
+
+	/* refill after 0.1 seconds */
+	ASSERT_TRUE(filter.Check(MakeDatagram(nullptr, "a"), 100.1));
+	ASSERT_FALSE(filter.Check(MakeDatagram(nullptr, "a"), 100.1));
+
+	ASSERT_EQ(filter.GetStats().rate_limited, 4u);
+	ASSERT_TRUE(filter.HasDropped());
+
+	char buffer[256];
+	const auto summary = filter.FormatSummary(buffer, sizeof(buffer));
+	ASSERT_EQ(std::string(summary.data, summary.size),
+		  "log filter: dropped 4 of 20 records (0 sampled, 4 rate-limited)");
+
+	ASSERT_FALSE(filter.HasDropped());
+	ASSERT_TRUE(filter.FormatSummary(buffer, sizeof(buffer)).IsNull());
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "net/log/OneLine.hxx"
+#include "net/log/Datagram.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using namespace Net::Log;
+
+static std::string
+Format(const Datagram &d)
+{
+	char buffer[ONE_LINE_MAX];
+	return std::string(buffer, FormatOneLine(buffer, sizeof(buffer), d));
+}
+
+TEST(LogOneLine, Http)
+{
+	Datagram d(std::chrono::system_clock::time_point(std::chrono::seconds(1500000000)),
+		   HTTP_METHOD_GET, "/foo\"bar\\baz",
+		   "1.2.3.4", "example.com", "site",
+		   nullptr, "Agent/1.0 \x01\xff",
+		   HTTP_STATUS_OK, 1234,
+		   10, 20,
+		   std::chrono::microseconds(42));
+
+	ASSERT_EQ(Format(d),
+		  "site 1.2.3.4 - - [14/Jul/2017:02:40:00 +0000] "
+		  "\"GET /foo\\x22bar\\x5Cbaz HTTP/1.1\" 200 1234 "
+		  "\"-\" \"Agent/1.0 \\x01\\xFF\" 42\n");
+}
+
+TEST(LogOneLine, Message)
+{
+	Datagram d(StringView("hello\nworld, this is a long message"));
+	ASSERT_EQ(Format(d), "- [-] hello\\x0Aworld, this is a long message\n");
+}
+
+TEST(LogOneLine, Empty)
+{
+	ASSERT_EQ(Format(Datagram{}), "");
+}
+
+TEST(LogOneLine, Truncate)
+{
+	const std::string uri(10000, 'a');
+
+	Datagram d;
+	d.http_uri = uri.c_str();
+	d.http_status = HTTP_STATUS_OK;
+	d.valid_http_status = true;
+
+	const auto line = Format(d);
+	ASSERT_EQ(line, "- - - - [-] \"? " + std::string(4092, 'a') +
+		  " HTTP/1.1\" 200 - \"-\" \"-\" -\n");
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "net/log/Parser.hxx"
+#include "net/log/Datagram.hxx"
+#include "net/log/Protocol.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <string.h>
+
+using namespace Net::Log;
+
+static std::string
+MakeDatagram(const std::string &attributes)
+{
+	const uint32_t magic = MAGIC;
+	return std::string((const char *)&magic, sizeof(magic)) + attributes;
+}
+
+static Datagram
+Parse(const std::string &s)
+{
+	return ParseDatagram(s.data(), s.data() + s.size());
+}
+
+TEST(LogParser, Empty)
+{
+	const auto d = Parse(MakeDatagram({}));
+	ASSERT_FALSE(d.valid_timestamp);
+	ASSERT_EQ(d.remote_host, nullptr);
+	ASSERT_TRUE(d.message.IsNull());
+}
+
+TEST(LogParser, BadMagic)
+{
+	ASSERT_THROW(Parse(std::string("\0\0\0\0", 4)), ProtocolError);
+	ASSERT_THROW(Parse(std::string("ab")), ProtocolError);
+	ASSERT_THROW(Parse({}), ProtocolError);
+}
+
+TEST(LogParser, Unaligned)
+{
+	/* a NOP shifts the 64 bit value to an odd offset */
+	const auto d = Parse(MakeDatagram(std::string("\0\x01\0\0\0\0\0\0\x12\x34", 10)));
+	ASSERT_TRUE(d.valid_timestamp);
+	ASSERT_EQ(d.timestamp, 0x1234u);
+}
+
+TEST(LogParser, Strings)
+{
+	/* the strings point into the buffer, so keep it */
+	const auto s = MakeDatagram(std::string("\x02" "1.2.3.4\0"
+						"\x0d" "hello\0"
+						"\x03" "\0", 18));
+	const auto d = Parse(s);
+	ASSERT_STREQ(d.remote_host, "1.2.3.4");
+	ASSERT_EQ(d.message.size, 5u);
+	ASSERT_EQ(memcmp(d.message.data, "hello", 5), 0);
+	ASSERT_STREQ(d.site, "");
+}
+
+TEST(LogParser, Malformed)
+{
+	/* string without null terminator */
+	ASSERT_THROW(Parse(MakeDatagram("\x02" "1.2.3.4")), ProtocolError);
+
+	/* truncated integers */
+	ASSERT_THROW(Parse(MakeDatagram(std::string("\x01\0\0\0", 4))),
+		     ProtocolError);
+	ASSERT_THROW(Parse(MakeDatagram(std::string("\x08\x01", 2))),
+		     ProtocolError);
+	ASSERT_THROW(Parse(MakeDatagram(std::string("\x0a\0\0\0\0\0\0\0\x01\0\0", 11))),
+		     ProtocolError);
+
+	/* invalid HTTP status */
+	ASSERT_THROW(Parse(MakeDatagram(std::string("\x08\0\x01", 3))),
+		     ProtocolError);
+}
@@ -0,0 +1,215 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "net/log/Serializer.hxx"
+#include "net/log/Parser.hxx"
+#include "net/log/Datagram.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+using namespace Net::Log;
+
+TEST(LogSerializer, Empty)
+{
+	uint8_t buffer[64];
+	const Datagram d{};
+	size_t size = Serialize(buffer, sizeof(buffer), d);
+	ASSERT_EQ(size, 4u);
+	ASSERT_EQ(Serialize(buffer, 3, d), 0u);
+}
+
+TEST(LogSerializer, Http)
+{
+	Datagram d(std::chrono::system_clock::time_point(std::chrono::seconds(1234567890)),
+		   HTTP_METHOD_POST, "/foo?bar",
+		   "192.168.1.2", "example.com", "site",
+		   nullptr, "Agent/1.0",
+		   HTTP_STATUS_NOT_FOUND, 4321,
+		   100, 200,
+		   std::chrono::milliseconds(42));
+	d.forwarded_to = "10.0.0.1:80";
+
+	uint8_t buffer[512];
+	size_t size = Serialize(buffer, sizeof(buffer), d);
+	ASSERT_GT(size, 0u);
+
+	const auto p = ParseDatagram(buffer, buffer + size);
+	ASSERT_TRUE(p.valid_timestamp);
+	ASSERT_EQ(p.timestamp, 1234567890000000u);
+	ASSERT_TRUE(p.valid_http_method);
+	ASSERT_EQ(p.http_method, HTTP_METHOD_POST);
+	ASSERT_STREQ(p.http_uri, "/foo?bar");
+	ASSERT_STREQ(p.remote_host, "192.168.1.2");
+	ASSERT_STREQ(p.host, "example.com");
+	ASSERT_STREQ(p.site, "site");
+	ASSERT_STREQ(p.forwarded_to, "10.0.0.1:80");
+	ASSERT_EQ(p.http_referer, nullptr);
+	ASSERT_STREQ(p.user_agent, "Agent/1.0");
+	ASSERT_TRUE(p.valid_http_status);
+	ASSERT_EQ(p.http_status, HTTP_STATUS_NOT_FOUND);
+	ASSERT_TRUE(p.valid_length);
+	ASSERT_EQ(p.length, 4321u);
+	ASSERT_TRUE(p.valid_traffic);
+	ASSERT_EQ(p.traffic_received, 100u);
+	ASSERT_EQ(p.traffic_sent, 200u);
+	ASSERT_TRUE(p.valid_duration);
+	ASSERT_EQ(p.duration, 42000u);
+}
+
+TEST(LogSerializer, Message)
+{
+	Datagram d(StringView("hello world"));
+
+	uint8_t buffer[64];
+	size_t size = Serialize(buffer, sizeof(buffer), d);
+	ASSERT_GT(size, 0u);
+
+	const auto p = ParseDatagram(buffer, buffer + size);
+	ASSERT_EQ(p.message.size, 11u);
+	ASSERT_EQ(memcmp(p.message.data, "hello world", 11), 0);
+}
+
+TEST(LogSerializer, TooSmall)
+{
+	Datagram d(StringView("hello world"));
+
+	uint8_t buffer[64];
+	const size_t size = Serialize(buffer, sizeof(buffer), d);
+
+	for (size_t i = 0; i < size; ++i)
+		ASSERT_EQ(Serialize(buffer, i, d), 0u);
+
+	ASSERT_EQ(Serialize(buffer, size, d), size);
+}
+
+TEST(LogSerializer, Multi)
+{
+	uint8_t buffer[256];
+	size_t size = SerializeMultiHeader(buffer, sizeof(buffer));
+	ASSERT_EQ(size, 4u);
+
+	const char *const messages[] = {"foo", "", "hello world"};
+	for (const char *m : messages) {
+		Datagram d{StringView(m)};
+		const size_t n = SerializeMultiRecord(buffer + size,
+						      sizeof(buffer) - size, d);
+		ASSERT_GT(n, 0u);
+		size += n;
+	}
+
+	/* a multi-record packet is not understood by the
+	   single-record parser */
+	ASSERT_THROW(ParseDatagram(buffer, buffer + size), ProtocolError);
+
+	DatagramIterator i(buffer, buffer + size);
+	ASSERT_TRUE(i.IsMulti());
+
+	Datagram p;
+	for (const char *m : messages) {
+		ASSERT_TRUE(i.Next(p));
+		ASSERT_EQ(p.message.size, strlen(m));
+		ASSERT_EQ(memcmp(p.message.data, m, p.message.size), 0);
+	}
+
+	ASSERT_FALSE(i.Next(p));
+
+	/* truncated packet */
+	DatagramIterator t(buffer, buffer + size - 1);
+	ASSERT_TRUE(t.Next(p));
+	ASSERT_TRUE(t.Next(p));
+	ASSERT_THROW(t.Next(p), ProtocolError);
+}
+
+TEST(LogSerializer, IteratorSingle)
+{
+	Datagram d(StringView("hello world"));
+
+	uint8_t buffer[64];
+	size_t size = Serialize(buffer, sizeof(buffer), d);
+	ASSERT_GT(size, 0u);
+
+	DatagramIterator i(buffer, buffer + size);
+	ASSERT_FALSE(i.IsMulti());
+
+	Datagram p;
+	ASSERT_TRUE(i.Next(p));
+	ASSERT_EQ(p.message.size, 11u);
+	ASSERT_FALSE(i.Next(p));
+
+	buffer[3] ^= 1;
+	ASSERT_THROW(DatagramIterator(buffer, buffer + size), ProtocolError);
+}
+
+TEST(LogSerializer, Crc)
+{
+	Datagram d(StringView("hello world"));
+	d.site = "site";
+
+	uint8_t buffer[64];
+	const size_t plain = Serialize(buffer, sizeof(buffer), d);
+	const size_t size = Serialize(buffer, sizeof(buffer), d, true);
+	ASSERT_EQ(size, plain + 5);
+
+	auto p = ParseDatagram(buffer, buffer + size);
+	ASSERT_STREQ(p.site, "site");
+	ASSERT_EQ(p.message.size, 11u);
+
+	/* any corruption after the checksum attribute is
+	   detected */
+	for (size_t i = 5; i < size; ++i) {
+		buffer[i] ^= 0x10;
+		ASSERT_THROW(ParseDatagram(buffer, buffer + size), ProtocolError);
+		buffer[i] ^= 0x10;
+	}
+
+	/* the checksum must be the first attribute */
+	uint8_t moved[sizeof(buffer)];
+	memcpy(moved, buffer, 4);
+	memcpy(moved + 4, buffer + 9, size - 9);
+	memcpy(moved + size - 5, buffer + 4, 5);
+	ASSERT_THROW(ParseDatagram(moved, moved + size), ProtocolError);
+
+	/* multi-record format */
+	size_t n = SerializeMultiHeader(buffer, sizeof(buffer));
+	n += SerializeMultiRecord(buffer + n, sizeof(buffer) - n, d, true);
+
+	DatagramIterator i(buffer, buffer + n);
+	ASSERT_TRUE(i.Next(p));
+	ASSERT_STREQ(p.site, "site");
+	ASSERT_FALSE(i.Next(p));
+
+	buffer[n - 1] ^= 1;
+	DatagramIterator j(buffer, buffer + n);
+	ASSERT_THROW(j.Next(p), ProtocolError);
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "net/MaskedSocketAddressSet.hxx"
+#include "net/Parser.hxx"
+
+#include <gtest/gtest.h>
+
+static bool
+Matches(const MaskedSocketAddressSet &set, const char *s)
+{
+	return set.Matches(ParseSocketAddress(s, 42, false));
+}
+
+TEST(MaskedSocketAddressSetTest, Empty)
+{
+	const MaskedSocketAddressSet set;
+	EXPECT_TRUE(set.empty());
+	EXPECT_FALSE(Matches(set, "192.168.1.2"));
+	EXPECT_FALSE(Matches(set, "::1"));
+	EXPECT_FALSE(Matches(set, "@foo"));
+}
+
+TEST(MaskedSocketAddressSetTest, Basic)
+{
+	const MaskedSocketAddress list[] = {
+		MaskedSocketAddress("192.168.1.0/24"),
+		MaskedSocketAddress("10.0.0.1"),
+		MaskedSocketAddress("2001:db8::/32"),
+		MaskedSocketAddress("::1"),
+		MaskedSocketAddress("@foo"),
+	};
+
+	const MaskedSocketAddressSet set(std::begin(list), std::end(list));
+	EXPECT_FALSE(set.empty());
+
+	EXPECT_TRUE(Matches(set, "192.168.1.2"));
+	EXPECT_TRUE(Matches(set, "192.168.1.255"));
+	EXPECT_FALSE(Matches(set, "192.168.2.1"));
+	EXPECT_TRUE(Matches(set, "10.0.0.1"));
+	EXPECT_FALSE(Matches(set, "10.0.0.2"));
+
+	EXPECT_TRUE(Matches(set, "2001:db8::1"));
+	EXPECT_TRUE(Matches(set, "2001:db8:ffff::1"));
+	EXPECT_FALSE(Matches(set, "2001:db9::1"));
+	EXPECT_TRUE(Matches(set, "::1"));
+	EXPECT_FALSE(Matches(set, "::2"));
+	EXPECT_FALSE(Matches(set, "::"));
+
+	/* IPv4-mapped IPv6 addresses (::ffff:192.168.1.2 and
+	   ::ffff:192.168.2.1) match IPv4 entries */
+	EXPECT_TRUE(Matches(set, "::ffff:c0a8:102"));
+	EXPECT_FALSE(Matches(set, "::ffff:c0a8:201"));
+
+	EXPECT_TRUE(Matches(set, "@foo"));
+	EXPECT_FALSE(Matches(set, "@bar"));
+}
+
+TEST(MaskedSocketAddressSetTest, Overlapping)
+{
+	MaskedSocketAddressSet set;
+	set.Add(MaskedSocketAddress("10.1.2.3"));
+	set.Add(MaskedSocketAddress("10.0.0.0/8"));
+	set.Add(MaskedSocketAddress("10.2.0.0/16"));
+
+	EXPECT_TRUE(Matches(set, "10.1.2.3"));
+	EXPECT_TRUE(Matches(set, "10.1.2.4"));
+	EXPECT_TRUE(Matches(set, "10.255.255.255"));
+	EXPECT_FALSE(Matches(set, "11.0.0.0"));
+
+	set.Add(MaskedSocketAddress("0.0.0.0/0"));
+	EXPECT_TRUE(Matches(set, "11.0.0.0"));
+	EXPECT_FALSE(Matches(set, "2001:db8::1"));
+}
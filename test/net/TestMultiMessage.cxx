@@ -0,0 +1,142 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "net/MultiMessage.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "net/IPv4Address.hxx"
+#include "net/StaticSocketAddress.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+TEST(MultiMessage, Udp)
+{
+	UniqueSocketDescriptor receiver, sender;
+	ASSERT_TRUE(receiver.Create(AF_INET, SOCK_DGRAM, 0));
+	ASSERT_TRUE(receiver.Bind(IPv4Address(127, 0, 0, 1, 0)));
+	ASSERT_TRUE(sender.Create(AF_INET, SOCK_DGRAM, 0));
+	ASSERT_TRUE(sender.Bind(IPv4Address(127, 0, 0, 1, 0)));
+
+	const auto address = receiver.GetLocalAddress();
+
+	MultiSendMessage s(4);
+	EXPECT_TRUE(s.empty());
+	EXPECT_TRUE(s.Add({"foo", 3}, address));
+	EXPECT_TRUE(s.Add({"hello", 5}, address));
+	EXPECT_TRUE(s.Add({"world!", 6}, address));
+	EXPECT_EQ(s.GetPending(), 3u);
+	EXPECT_EQ(s.Send(sender), 3u);
+	EXPECT_TRUE(s.empty());
+	EXPECT_EQ(s.Send(sender), 0u);
+
+	MultiReceiveMessage r(8, 4);
+	ASSERT_EQ(r.Receive(receiver), 3u);
+	EXPECT_EQ(r[0].payload.size, 3u);
+	EXPECT_EQ(memcmp(r[0].payload.data, "foo", 3), 0);
+	EXPECT_FALSE(r[0].truncated);
+	EXPECT_EQ(r[1].payload.size, 4u);
+	EXPECT_TRUE(r[1].truncated);
+	EXPECT_EQ(memcmp(r[1].payload.data, "hell", 4), 0);
+	EXPECT_TRUE(r[2].truncated);
+
+	const auto sender_address = sender.GetLocalAddress();
+	for (const auto &i : r) {
+		EXPECT_TRUE(sender_address == i.address);
+		EXPECT_EQ(i.cred, nullptr);
+		EXPECT_TRUE(i.fds.empty());
+		EXPECT_EQ(i.segment_size, 0u);
+	}
+
+	/* nothing left */
+	EXPECT_EQ(r.Receive(receiver), 0u);
+	EXPECT_TRUE(r.empty());
+}
+
+TEST(MultiMessage, Full)
+{
+	MultiSendMessage s(2);
+	EXPECT_TRUE(s.Add({"a", 1}));
+	EXPECT_TRUE(s.Add({"b", 1}));
+	EXPECT_TRUE(s.IsFull());
+	EXPECT_FALSE(s.Add({"c", 1}));
+	s.Clear();
+	EXPECT_TRUE(s.empty());
+	EXPECT_FALSE(s.IsFull());
+}
+
+TEST(MultiMessage, FdsAndCredentials)
+{
+	UniqueSocketDescriptor a, b;
+	ASSERT_TRUE(UniqueSocketDescriptor::CreateSocketPair(AF_LOCAL,
+							     SOCK_DGRAM, 0,
+							     a, b));
+	ASSERT_TRUE(b.SetBoolOption(SOL_SOCKET, SO_PASSCRED, true));
+
+	int pipe_fds[2];
+	ASSERT_EQ(pipe(pipe_fds), 0);
+
+	MultiSendMessage s(4, MultiSendMessage::GetCmsgSize(2));
+	EXPECT_TRUE(s.Add({"x", 1}, nullptr, {pipe_fds, 2}));
+	EXPECT_TRUE(s.Add({"y", 1}));
+	EXPECT_EQ(s.Send(a), 2u);
+
+	close(pipe_fds[0]);
+	close(pipe_fds[1]);
+
+	MultiReceiveMessage r(4, 16,
+			      CMSG_SPACE(sizeof(struct ucred)) +
+			      CMSG_SPACE(4 * sizeof(int)),
+			      false);
+	ASSERT_EQ(r.Receive(b), 2u);
+
+	EXPECT_TRUE(r[0].address.IsNull());
+	ASSERT_NE(r[0].cred, nullptr);
+	EXPECT_EQ(r[0].cred->pid, getpid());
+	EXPECT_EQ(r[0].cred->uid, getuid());
+	ASSERT_EQ(r[0].fds.size, 2u);
+	ASSERT_NE(r[1].cred, nullptr);
+	EXPECT_TRUE(r[1].fds.empty());
+
+	/* the taken file descriptors are ours: write into the
+	   received pipe and read from it */
+	const auto fds = r.TakeFds(0);
+	EXPECT_TRUE(r[0].fds.empty());
+	EXPECT_EQ(write(fds[1], "z", 1), 1);
+	char ch;
+	EXPECT_EQ(read(fds[0], &ch, 1), 1);
+	EXPECT_EQ(ch, 'z');
+	close(fds[0]);
+	close(fds[1]);
+}
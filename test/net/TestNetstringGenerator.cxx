@@ -0,0 +1,123 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "net/djb/NetstringGenerator.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <string.h>
+
+static std::string
+ToString(ConstBuffer<struct iovec> v)
+{
+	std::string result;
+	for (const auto &i : v)
+		result.append((const char *)i.iov_base, i.iov_len);
+	return result;
+}
+
+static ConstBuffer<void>
+V(const char *s)
+{
+	return {s, strlen(s)};
+}
+
+TEST(NetstringGenerator, Raw)
+{
+	NetstringGenerator g;
+	g.Append(V("hello "));
+	g.Append(V("world"));
+	ASSERT_EQ(ToString(g.Finish()), "11:hello world,");
+}
+
+TEST(NetstringGenerator, NoComma)
+{
+	NetstringGenerator g;
+	g.Append(V("foo"));
+	ASSERT_EQ(ToString(g.Finish(false)), "3:foo");
+}
+
+TEST(NetstringGenerator, Empty)
+{
+	NetstringGenerator g;
+	ASSERT_EQ(ToString(g.Finish()), "0:,");
+}
+
+TEST(NetstringGenerator, Nested)
+{
+	NetstringGenerator g;
+	g.AppendNetstring(V("message"));
+	g.AppendNetstring(V("sender"));
+	g.AppendNetstring(V(""));
+	g.AppendNetstring(V("rcpt"));
+
+	const auto v = g.Finish();
+	ASSERT_EQ(ToString(v), "29:7:message,6:sender,0:,4:rcpt,,");
+
+	/* outer header, two vectors per nested netstring and the
+	   final ",," */
+	ASSERT_EQ(v.size, 10u);
+}
+
+TEST(NetstringGenerator, Mixed)
+{
+	NetstringGenerator g;
+	g.AppendNetstring(V("a"));
+	g.Append(V("xy"));
+	g.AppendNetstring(V("b"));
+	ASSERT_EQ(ToString(g.Finish()), "10:1:a,xy1:b,,");
+}
+
+TEST(NetstringGenerator, Full)
+{
+	NetstringGenerator g;
+
+	size_t n = 0, size = 0;
+	while (g.CanAppendNetstring()) {
+		g.AppendNetstring(V("value"));
+		++n;
+		size += 8;
+	}
+
+	ASSERT_GT(n, 50u);
+
+	const auto v = g.Finish();
+	ASSERT_LE(v.size, size_t(NetstringGenerator::MAX_VECTORS));
+
+	const auto s = ToString(v);
+	const auto prefix = std::to_string(size) + ":";
+	ASSERT_EQ(s.compare(0, prefix.size(), prefix), 0);
+	ASSERT_EQ(s.size(), prefix.size() + size + 1);
+	ASSERT_EQ(s.substr(s.size() - 9), "5:value,,");
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "net/djb/NetstringInput.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+namespace {
+
+struct Pipe {
+	int r, w;
+
+	Pipe() {
+		int fds[2];
+		if (pipe2(fds, O_NONBLOCK) < 0)
+			throw std::runtime_error("pipe() failed");
+		r = fds[0];
+		w = fds[1];
+	}
+
+	~Pipe() {
+		close(r);
+		if (w >= 0)
+			close(w);
+	}
+
+	void Write(const std::string &s) {
+		ASSERT_EQ(write(w, s.data(), s.size()), ssize_t(s.size()));
+	}
+
+	void CloseWrite() {
+		close(w);
+		w = -1;
+	}
+};
+
+}
+
+static std::string
+ToString(const AllocatedArray<uint8_t> &value)
+{
+	return std::string((const char *)value.begin(), value.size());
+}
+
+TEST(NetstringInput, Basic)
+{
+	Pipe p;
+	NetstringInput input(1024);
+
+	EXPECT_EQ(input.Receive(p.r), NetstringInput::Result::MORE);
+
+	p.Write("5:hel");
+	EXPECT_EQ(input.Receive(p.r), NetstringInput::Result::MORE);
+	p.Write("lo,");
+	ASSERT_EQ(input.Receive(p.r), NetstringInput::Result::FINISHED);
+	EXPECT_EQ(ToString(input.GetValue()), "hello");
+	EXPECT_FALSE(input.HasBufferedData());
+}
+
+TEST(NetstringInput, SplitHeader)
+{
+	Pipe p;
+	NetstringInput input(1024);
+
+	p.Write("1");
+	EXPECT_EQ(input.Receive(p.r), NetstringInput::Result::MORE);
+	p.Write("2:hello world!,");
+	ASSERT_EQ(input.Receive(p.r), NetstringInput::Result::FINISHED);
+	EXPECT_EQ(ToString(input.GetValue()), "hello world!");
+}
+
+TEST(NetstringInput, Pipelined)
+{
+	Pipe p;
+	NetstringInput input(1024);
+
+	p.Write("3:foo,0:,3:ba");
+	ASSERT_EQ(input.Receive(p.r), NetstringInput::Result::FINISHED);
+	EXPECT_EQ(ToString(input.GetValue()), "foo");
+	EXPECT_TRUE(input.HasBufferedData());
+
+	input.Reset();
+	ASSERT_EQ(input.Parse(), NetstringInput::Result::FINISHED);
+	EXPECT_EQ(ToString(input.GetValue()), "");
+
+	input.Reset();
+	EXPECT_EQ(input.Parse(), NetstringInput::Result::MORE);
+	p.Write("r,");
+	ASSERT_EQ(input.Receive(p.r), NetstringInput::Result::FINISHED);
+	EXPECT_EQ(ToString(input.GetValue()), "bar");
+	EXPECT_FALSE(input.HasBufferedData());
+}
+
+TEST(NetstringInput, Large)
+{
+	Pipe p;
+	NetstringInput input(65536);
+
+	const std::string value(4000, 'x');
+	p.Write(std::to_string(value.size()) + ":");
+	p.Write(value.substr(0, 10));
+	EXPECT_EQ(input.Receive(p.r), NetstringInput::Result::MORE);
+
+	/* the rest bypasses the staging buffer */
+	p.Write(value.substr(10) + ",");
+	NetstringInput::Result result;
+	do {
+		result = input.Receive(p.r);
+	} while (result == NetstringInput::Result::MORE);
+
+	ASSERT_EQ(result, NetstringInput::Result::FINISHED);
+	EXPECT_EQ(ToString(input.GetValue()), value);
+}
+
+TEST(NetstringInput, Malformed)
+{
+	{
+		Pipe p;
+		NetstringInput input(1024);
+		p.Write("3:foo;");
+		EXPECT_THROW(input.Receive(p.r), std::runtime_error);
+	}
+
+	{
+		Pipe p;
+		NetstringInput input(1024);
+		p.Write(":foo,");
+		EXPECT_THROW(input.Receive(p.r), std::runtime_error);
+	}
+
+	{
+		Pipe p;
+		NetstringInput input(1024);
+		p.Write("1x:");
+		EXPECT_THROW(input.Receive(p.r), std::runtime_error);
+	}
+
+	{
+		Pipe p;
+		NetstringInput input(1024);
+		p.Write("1024:");
+		EXPECT_THROW(input.Receive(p.r), std::runtime_error);
+	}
+
+	{
+		Pipe p;
+		NetstringInput input(1024);
+		p.Write(std::string(40, '0'));
+		EXPECT_THROW(input.Receive(p.r), std::runtime_error);
+	}
+}
+
+TEST(NetstringInput, Closed)
+{
+	Pipe p;
+	NetstringInput input(1024);
+
+	p.Write("5:he");
+	p.CloseWrite();
+	EXPECT_EQ(input.Receive(p.r), NetstringInput::Result::MORE);
+	EXPECT_EQ(input.Receive(p.r), NetstringInput::Result::CLOSED);
+}
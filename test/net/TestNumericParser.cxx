@@ -0,0 +1,160 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "net/NumericParser.hxx"
+#include "net/StaticSocketAddress.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+static bool
+ParseIPv6(const char *s, struct in6_addr &dest) noexcept
+{
+	return ParseNumericIPv6(StringView(s), dest);
+}
+
+TEST(NumericParser, IPv4)
+{
+	struct in_addr a;
+	ASSERT_TRUE(ParseNumericIPv4(StringView("192.168.1.2"), a));
+	EXPECT_EQ(ntohl(a.s_addr), 0xc0a80102u);
+	ASSERT_TRUE(ParseNumericIPv4(StringView("0.0.0.0"), a));
+	EXPECT_EQ(a.s_addr, 0u);
+	ASSERT_TRUE(ParseNumericIPv4(StringView("255.255.255.255"), a));
+	EXPECT_EQ(a.s_addr, 0xffffffffu);
+
+	EXPECT_FALSE(ParseNumericIPv4(StringView(""), a));
+	EXPECT_FALSE(ParseNumericIPv4(StringView("1.2.3"), a));
+	EXPECT_FALSE(ParseNumericIPv4(StringView("1.2.3.4.5"), a));
+	EXPECT_FALSE(ParseNumericIPv4(StringView("1.2.3.256"), a));
+	EXPECT_FALSE(ParseNumericIPv4(StringView("1.2.3.04"), a));
+	EXPECT_FALSE(ParseNumericIPv4(StringView("1..3.4"), a));
+	EXPECT_FALSE(ParseNumericIPv4(StringView("1.2.3.4 "), a));
+	EXPECT_FALSE(ParseNumericIPv4(StringView("127.1"), a));
+}
+
+TEST(NumericParser, IPv6)
+{
+	static const char *const valid[] = {
+		"::",
+		"::1",
+		"1::",
+		"2001:db8::1",
+		"2001:DB8:0:0:8:800:200C:417A",
+		"ff01::101",
+		"1:2:3:4:5:6:7:8",
+		"1:2:3:4:5:6::8",
+		"1::3:4:5:6:7:8",
+		"::ffff:192.168.1.2",
+		"64:ff9b::10.0.0.1",
+		"1:2:3:4:5:6:1.2.3.4",
+	};
+
+	for (const char *s : valid) {
+		struct in6_addr expected, actual;
+		ASSERT_EQ(inet_pton(AF_INET6, s, &expected), 1) << s;
+		ASSERT_TRUE(ParseIPv6(s, actual)) << s;
+		EXPECT_EQ(memcmp(&expected, &actual, sizeof(actual)), 0) << s;
+	}
+
+	static const char *const invalid[] = {
+		"",
+		":",
+		":1",
+		"1:",
+		"1:::2",
+		"1::2::3",
+		"12345::",
+		"1:2:3:4:5:6:7",
+		"1:2:3:4:5:6:7:8:9",
+		"1:2:3:4::5:6:7:8",
+		"::1.2.3",
+		"1:2:3:4:5:6:7:1.2.3.4",
+		"::g",
+		"::1%2",
+	};
+
+	for (const char *s : invalid) {
+		struct in6_addr a;
+		EXPECT_FALSE(ParseIPv6(s, a)) << s;
+	}
+}
+
+TEST(NumericParser, SocketAddress)
+{
+	StaticSocketAddress a;
+
+	ASSERT_TRUE(ParseNumericSocketAddress(a, "10.0.0.1", 80));
+	EXPECT_EQ(a.GetFamily(), AF_INET);
+	EXPECT_EQ(a.GetPort(), 80u);
+
+	ASSERT_TRUE(ParseNumericSocketAddress(a, "10.0.0.1:8080", 80));
+	EXPECT_EQ(a.GetFamily(), AF_INET);
+	EXPECT_EQ(a.GetPort(), 8080u);
+
+	ASSERT_TRUE(ParseNumericSocketAddress(a, "::1", 80));
+	EXPECT_EQ(a.GetFamily(), AF_INET6);
+	EXPECT_EQ(a.GetPort(), 80u);
+
+	ASSERT_TRUE(ParseNumericSocketAddress(a, "[::1]:443", 80));
+	EXPECT_EQ(a.GetFamily(), AF_INET6);
+	EXPECT_EQ(a.GetPort(), 443u);
+
+	ASSERT_TRUE(ParseNumericSocketAddress(a, "[::1]", 80));
+	EXPECT_EQ(a.GetPort(), 80u);
+
+	ASSERT_TRUE(ParseNumericSocketAddress(a, "fe80::1%3", 80));
+	EXPECT_EQ(((const struct sockaddr_in6 *)(const struct sockaddr *)a)->sin6_scope_id, 3u);
+
+	ASSERT_TRUE(ParseNumericSocketAddress(a, "[fe80::1%3]:22", 80));
+	EXPECT_EQ(((const struct sockaddr_in6 *)(const struct sockaddr *)a)->sin6_scope_id, 3u);
+	EXPECT_EQ(a.GetPort(), 22u);
+
+	/* these must be left to the resolver */
+	EXPECT_FALSE(ParseNumericSocketAddress(a, "localhost", 80));
+	EXPECT_FALSE(ParseNumericSocketAddress(a, "localhost:80", 80));
+	EXPECT_FALSE(ParseNumericSocketAddress(a, "*", 80));
+	EXPECT_FALSE(ParseNumericSocketAddress(a, "*:80", 80));
+	EXPECT_FALSE(ParseNumericSocketAddress(a, "10.0.0.1:http", 80));
+	EXPECT_FALSE(ParseNumericSocketAddress(a, "fe80::1%eth0", 80));
+	EXPECT_FALSE(ParseNumericSocketAddress(a, "127.1", 80));
+
+	/* malformed */
+	EXPECT_FALSE(ParseNumericSocketAddress(a, "10.0.0.1:", 80));
+	EXPECT_FALSE(ParseNumericSocketAddress(a, "10.0.0.1:65536", 80));
+	EXPECT_FALSE(ParseNumericSocketAddress(a, "[10.0.0.1]:80", 80));
+	EXPECT_FALSE(ParseNumericSocketAddress(a, "[::1", 80));
+	EXPECT_FALSE(ParseNumericSocketAddress(a, "[::1]80", 80));
+}
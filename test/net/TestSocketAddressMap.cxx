@@ -0,0 +1,142 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "net/SocketAddressMap.hxx"
+#include "net/IPv4Address.hxx"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory>
+#include <random>
+#include <unordered_set>
+
+static IPv4Address
+MakeAddress(unsigned i, unsigned port=80)
+{
+	return IPv4Address(10, i >> 16, i >> 8, i, port);
+}
+
+TEST(SocketAddressMap, Hash)
+{
+	std::hash<SocketAddress> h;
+	const auto a = MakeAddress(1), b = MakeAddress(2), c = MakeAddress(1, 81);
+
+	EXPECT_EQ(h(a), h(MakeAddress(1)));
+	EXPECT_NE(h(a), h(b));
+	EXPECT_NE(h(a), h(c));
+
+	std::unordered_set<AllocatedSocketAddress> set;
+	set.emplace(SocketAddress(a));
+	set.emplace(SocketAddress(b));
+	set.emplace(SocketAddress(MakeAddress(1)));
+	EXPECT_EQ(set.size(), 2u);
+}
+
+TEST(SocketAddressMap, Basic)
+{
+	SocketAddressMap<int> map;
+	EXPECT_TRUE(map.empty());
+	EXPECT_EQ(map.Find(MakeAddress(1)), nullptr);
+	EXPECT_FALSE(map.Erase(MakeAddress(1)));
+
+	auto r = map.Emplace(MakeAddress(1), 42);
+	EXPECT_TRUE(r.second);
+	EXPECT_EQ(r.first, 42);
+
+	r = map.Emplace(MakeAddress(1), 43);
+	EXPECT_FALSE(r.second);
+	EXPECT_EQ(r.first, 42);
+
+	map[MakeAddress(2)] = 7;
+	EXPECT_EQ(map.size(), 2u);
+	ASSERT_NE(map.Find(MakeAddress(2)), nullptr);
+	EXPECT_EQ(*map.Find(MakeAddress(2)), 7);
+
+	/* the port is part of the key */
+	EXPECT_EQ(map.Find(MakeAddress(2, 81)), nullptr);
+
+	EXPECT_TRUE(map.Erase(MakeAddress(1)));
+	EXPECT_EQ(map.Find(MakeAddress(1)), nullptr);
+	EXPECT_EQ(map.size(), 1u);
+}
+
+/**
+ * Compare with std::map after many random operations, exercising
+ * growth and backward-shift deletion.
+ */
+TEST(SocketAddressMap, Random)
+{
+	SocketAddressMap<std::unique_ptr<unsigned>> map;
+	std::map<unsigned, unsigned> reference;
+
+	std::mt19937 random(42);
+	for (unsigned i = 0; i < 20000; ++i) {
+		const unsigned key = random() % 500;
+		const unsigned op = random() % 3;
+		const auto address = MakeAddress(key);
+
+		if (op == 0) {
+			map.Erase(address);
+			reference.erase(key);
+		} else {
+			auto r = map.Emplace(address,
+					     std::unique_ptr<unsigned>(new unsigned(i)));
+			auto rr = reference.emplace(key, i);
+			ASSERT_EQ(r.second, rr.second);
+			ASSERT_EQ(*r.first, rr.first->second);
+		}
+	}
+
+	ASSERT_EQ(map.size(), reference.size());
+	for (const auto &i : reference) {
+		const auto *value = map.Find(MakeAddress(i.first));
+		ASSERT_NE(value, nullptr);
+		ASSERT_EQ(**value, i.second);
+	}
+
+	size_t n = 0;
+	map.ForEach([&n](SocketAddress, std::unique_ptr<unsigned> &){ ++n; });
+	EXPECT_EQ(n, reference.size());
+
+	/* remove all odd values */
+	map.EraseIf([](SocketAddress, const std::unique_ptr<unsigned> &value){
+			return (*value & 1) != 0;
+		});
+	for (const auto &i : reference) {
+		const auto *value = map.Find(MakeAddress(i.first));
+		if (i.second & 1)
+			EXPECT_EQ(value, nullptr);
+		else
+			EXPECT_NE(value, nullptr);
+	}
+}
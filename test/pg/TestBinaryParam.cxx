@@ -0,0 +1,122 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../../src/pg/ParamWrapper.hxx"
+#include "../../src/pg/BinaryRow.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+template<typename T>
+static Pg::BinaryValue
+ToBinaryValue(const Pg::ParamWrapper<T> &w)
+{
+	return {w.GetValue(), w.GetSize()};
+}
+
+TEST(PgBinaryParam, Scalars)
+{
+	const Pg::ParamWrapper<Pg::Binary<int32_t>> i32(Pg::Binary<int32_t>(0x01020304));
+	ASSERT_TRUE(i32.IsBinary());
+	ASSERT_EQ(i32.GetSize(), 4u);
+	ASSERT_EQ(memcmp(i32.GetValue(), "\x01\x02\x03\x04", 4), 0);
+
+	const Pg::ParamWrapper<Pg::Binary<int16_t>> i16(Pg::Binary<int16_t>(-2));
+	ASSERT_EQ(i16.GetSize(), 2u);
+	ASSERT_EQ(Pg::BinaryDecoder<int16_t>::Decode(ToBinaryValue(i16)), -2);
+
+	const Pg::ParamWrapper<Pg::Binary<int64_t>> i64(Pg::Binary<int64_t>(-1234567890123LL));
+	ASSERT_EQ(i64.GetSize(), 8u);
+	ASSERT_EQ(Pg::BinaryDecoder<int64_t>::Decode(ToBinaryValue(i64)),
+		  -1234567890123LL);
+
+	const Pg::ParamWrapper<Pg::Binary<bool>> b(Pg::Binary<bool>(true));
+	ASSERT_EQ(b.GetSize(), 1u);
+	ASSERT_TRUE(Pg::BinaryDecoder<bool>::Decode(ToBinaryValue(b)));
+
+	const Pg::ParamWrapper<Pg::Binary<double>> d(Pg::Binary<double>(0.25));
+	ASSERT_EQ(Pg::BinaryDecoder<double>::Decode(ToBinaryValue(d)), 0.25);
+}
+
+TEST(PgBinaryParam, Timestamp)
+{
+	typedef std::chrono::system_clock::time_point time_point;
+
+	const auto t = std::chrono::system_clock::from_time_t(1234567890)
+		+ std::chrono::microseconds(500);
+
+	const Pg::ParamWrapper<Pg::Binary<time_point>> w{Pg::Binary<time_point>(t)};
+	ASSERT_EQ(w.GetSize(), 8u);
+	ASSERT_EQ(LoadBE64(w.GetValue()), 287883090ULL * 1000000ULL + 500);
+	ASSERT_EQ(Pg::BinaryDecoder<time_point>::Decode(ToBinaryValue(w)), t);
+
+	ASSERT_EQ(Pg::ToBinaryTimestamp(time_point::max()), INT64_MAX);
+	ASSERT_EQ(Pg::ToBinaryTimestamp(time_point::min()), INT64_MIN);
+}
+
+TEST(PgBinaryParam, Array)
+{
+	const int32_t values[] = {7, 8, 9};
+	typedef Pg::Binary<ConstBuffer<int32_t>> A;
+
+	const Pg::ParamWrapper<A> w{A({values, 3})};
+	ASSERT_TRUE(w.IsBinary());
+	ASSERT_EQ(w.GetSize(), 20u + 3 * 8);
+
+	const Pg::BinaryArray<int32_t> a(ToBinaryValue(w));
+	std::vector<int32_t> v(a.begin(), a.end());
+	ASSERT_EQ(v, (std::vector<int32_t>{7, 8, 9}));
+
+	const Pg::ParamWrapper<A> e{A(nullptr)};
+	ASSERT_EQ(e.GetSize(), 12u);
+	ASSERT_TRUE(Pg::BinaryArray<int32_t>(ToBinaryValue(e)).empty());
+
+	/* the element type is checked by the decoder */
+	ASSERT_THROW(Pg::BinaryArray<int64_t>(ToBinaryValue(w)),
+		     std::invalid_argument);
+}
+
+TEST(PgBinaryParam, Collector)
+{
+	const Pg::BinaryParamArray<Pg::Binary<int32_t>, const char *,
+				   Pg::Binary<bool>>
+		p(Pg::Binary<int32_t>(42), "foo", Pg::Binary<bool>(false));
+
+	ASSERT_EQ(p.formats[0], 1);
+	ASSERT_EQ(p.lengths[0], 4);
+	ASSERT_EQ(p.formats[1], 0);
+	ASSERT_STREQ(p.values[1], "foo");
+	ASSERT_EQ(p.formats[2], 1);
+	ASSERT_EQ(p.lengths[2], 1);
+	ASSERT_EQ(*p.values[2], 0);
+}
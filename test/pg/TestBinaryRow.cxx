@@ -0,0 +1,194 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../../src/pg/BinaryRow.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+static void
+AppendBE32(std::string &s, uint32_t value)
+{
+	value = ToBE32(value);
+	s.append((const char *)&value, sizeof(value));
+}
+
+/**
+ * Construct a one-row binary #Pg::Result without a server.
+ */
+static Pg::Result
+MakeResult(const std::vector<std::pair<const char *, Oid>> &columns,
+	   const std::vector<std::string> &values,
+	   int null_column=-1)
+{
+	PGresult *r = PQmakeEmptyPGresult(nullptr, PGRES_TUPLES_OK);
+
+	std::vector<PGresAttDesc> attrs;
+	for (const auto &i : columns) {
+		PGresAttDesc a{};
+		a.name = const_cast<char *>(i.first);
+		a.format = 1;
+		a.typid = i.second;
+		attrs.push_back(a);
+	}
+
+	/* libpq copies everything; the const_casts are due to its
+	   API */
+	EXPECT_TRUE(PQsetResultAttrs(r, attrs.size(), attrs.data()));
+
+	for (unsigned i = 0; i < values.size(); ++i) {
+		if (int(i) == null_column)
+			EXPECT_TRUE(PQsetvalue(r, 0, i, nullptr, -1));
+		else
+			EXPECT_TRUE(PQsetvalue(r, 0, i,
+					       const_cast<char *>(values[i].data()),
+					       values[i].size()));
+	}
+
+	return Pg::Result(r);
+}
+
+TEST(PgBinaryRow, Scalars)
+{
+	std::string i8("\0\0\0\x01\0\0\0\x02", 8);
+	std::string i4("\xff\xff\xff\xfe", 4);
+	std::string b("\x01", 1);
+	std::string f8("\x40\x09\x21\xfb\x54\x44\x2d\x18", 8);
+
+	const auto result = MakeResult({{"id", Pg::TypeOid::INT8},
+					{"name", Pg::TypeOid::TEXT},
+					{"delta", Pg::TypeOid::INT4},
+					{"flag", Pg::TypeOid::BOOL},
+					{"pi", Pg::TypeOid::FLOAT8}},
+		{i8, "hello", i4, b, f8});
+
+	const Pg::BinaryRowDecoder<int64_t, StringView, int32_t,
+				   bool, double> d(result);
+	int64_t id;
+	StringView name;
+	int32_t delta;
+	bool flag;
+	double pi;
+	std::tie(id, name, delta, flag, pi) = d.Decode(0);
+	ASSERT_EQ(id, 0x100000002LL);
+	ASSERT_TRUE(name.Equals("hello"));
+	ASSERT_EQ(delta, -2);
+	ASSERT_TRUE(flag);
+	ASSERT_DOUBLE_EQ(pi, 3.141592653589793);
+
+	/* lookup by name, different order */
+	const Pg::BinaryRowDecoder<StringView, int64_t> d2(result,
+							 {"name", "id"});
+	ASSERT_TRUE(d2.Get<0>(0).Equals("hello"));
+	ASSERT_EQ(d2.Get<1>(0), 0x100000002LL);
+}
+
+TEST(PgBinaryRow, Timestamp)
+{
+	/* 2009-02-13 23:31:30 UTC is 287883090 seconds after the
+	   PostgreSQL epoch */
+	const uint64_t us = 287883090ULL * 1000000ULL + 500;
+	std::string value;
+	AppendBE32(value, us >> 32);
+	AppendBE32(value, uint32_t(us));
+
+	const auto result = MakeResult({{"t", Pg::TypeOid::TIMESTAMPTZ}},
+				       {value});
+	const Pg::BinaryRowDecoder<std::chrono::system_clock::time_point> d(result);
+	ASSERT_EQ(d.Get<0>(0),
+		  std::chrono::system_clock::from_time_t(1234567890)
+		  + std::chrono::microseconds(500));
+}
+
+TEST(PgBinaryRow, Array)
+{
+	std::string value;
+	AppendBE32(value, 1); /* ndim */
+	AppendBE32(value, 0); /* flags */
+	AppendBE32(value, Pg::TypeOid::INT4);
+	AppendBE32(value, 3); /* size */
+	AppendBE32(value, 1); /* lower bound */
+	for (uint32_t i : {7, 8, 9}) {
+		AppendBE32(value, 4);
+		AppendBE32(value, i);
+	}
+
+	std::string empty;
+	AppendBE32(empty, 0);
+	AppendBE32(empty, 0);
+	AppendBE32(empty, Pg::TypeOid::INT4);
+
+	const auto result = MakeResult({{"a", 1007}, {"e", 1007}},
+				       {value, empty});
+	const Pg::BinaryRowDecoder<Pg::BinaryArray<int32_t>,
+				   Pg::BinaryArray<int32_t>> d(result);
+
+	const auto a = d.Get<0>(0);
+	ASSERT_EQ(a.size(), 3u);
+	std::vector<int32_t> v(a.begin(), a.end());
+	ASSERT_EQ(v, (std::vector<int32_t>{7, 8, 9}));
+
+	ASSERT_TRUE(d.Get<1>(0).empty());
+
+	/* wrong element type */
+	const Pg::BinaryRowDecoder<Pg::BinaryArray<int64_t>> d2(result);
+	ASSERT_THROW(d2.Get<0>(0), std::invalid_argument);
+
+	/* truncated */
+	const auto truncated = MakeResult({{"a", 1007}},
+					  {value.substr(0, value.size() - 1)});
+	const Pg::BinaryRowDecoder<Pg::BinaryArray<int32_t>> d3(truncated);
+	ASSERT_THROW(d3.Get<0>(0), std::invalid_argument);
+}
+
+TEST(PgBinaryRow, Errors)
+{
+	const auto result = MakeResult({{"id", Pg::TypeOid::INT8},
+					{"name", Pg::TypeOid::TEXT}},
+		{std::string(8, '\0'), "x"}, 0);
+
+	/* type mismatch is detected once, by the constructor */
+	ASSERT_THROW((Pg::BinaryRowDecoder<int32_t>(result)),
+		     std::invalid_argument);
+	ASSERT_THROW((Pg::BinaryRowDecoder<StringView>(result, {"foo"})),
+		     std::invalid_argument);
+	ASSERT_THROW((Pg::BinaryRowDecoder<int64_t, StringView, int64_t>(result)),
+		     std::invalid_argument);
+
+	/* NULL */
+	const Pg::BinaryRowDecoder<int64_t, StringView> d(result);
+	ASSERT_THROW(d.Get<0>(0), std::invalid_argument);
+
+	const Pg::BinaryRowDecoder<Pg::BinaryValue> d2(result);
+	ASSERT_EQ(d2.Get<0>(0).data, nullptr);
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../../src/pg/CopyFormat.hxx"
+
+#include <gtest/gtest.h>
+
+TEST(PgCopyFormat, Binary)
+{
+	Pg::CopyBinaryBuilder b;
+	b.AppendHeader();
+	b.BeginRow(4);
+	b.AppendInt32(-2);
+	b.AppendString("ab");
+	b.AppendNull();
+	b.AppendBool(true);
+	b.AppendTrailer();
+
+	const std::string expected("PGCOPY\n\377\r\n\0"
+				   "\0\0\0\0" "\0\0\0\0"
+				   "\0\4"
+				   "\0\0\0\4" "\xff\xff\xff\xfe"
+				   "\0\0\0\2" "ab"
+				   "\xff\xff\xff\xff"
+				   "\0\0\0\1" "\1"
+				   "\xff\xff", 11 + 8 + 2 + 8 + 6 + 4 + 5 + 2);
+
+	const auto data = b.Get();
+	ASSERT_EQ(std::string((const char *)data.data, data.size), expected);
+
+	b.Clear();
+	ASSERT_TRUE(b.empty());
+}
+
+TEST(PgCopyFormat, Text)
+{
+	std::string row;
+	Pg::AppendCopyText(row, "a\tb\\c\nd\re");
+	ASSERT_EQ(row, "a\\tb\\\\c\\nd\\re");
+}
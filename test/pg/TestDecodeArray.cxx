@@ -31,6 +31,7 @@
  */
 
 #include "../../src/pg/Array.hxx"
+#include "../../src/util/Arena.hxx"
 
 #include <gtest/gtest.h>
 
@@ -83,3 +84,50 @@ TEST(PgTest, DecodeArray)
     check_decode("{foo,,bar}", three);
     check_decode("{foo,\"\\\"\\\\\"}", special);
 }
+
+TEST(PgTest, DecodeArrayView)
+{
+    Arena arena;
+
+    ASSERT_TRUE(Pg::DecodeArray(StringView(""), arena).empty());
+    ASSERT_TRUE(Pg::DecodeArray(StringView("{}"), arena).empty());
+
+    /* long enough for the SIMD loop */
+    const char *input = "{0123456789abcdefghij,\"quoted, 0123456789abcdef\","
+        "NULL,\"NULL\",\"esc\\\"aped \\\\ 0123456789abcdef\",}";
+    const auto a = Pg::DecodeArray(StringView(input), arena);
+    ASSERT_EQ(a.size(), 6u);
+
+    ASSERT_TRUE(a[0].Equals("0123456789abcdefghij"));
+    ASSERT_EQ(a[0].data, input + 1);
+
+    ASSERT_TRUE(a[1].Equals("quoted, 0123456789abcdef"));
+    ASSERT_EQ(a[1].data, input + 23);
+
+    ASSERT_EQ(a[2].data, nullptr);
+    ASSERT_TRUE(a[3].Equals("NULL"));
+
+    /* unescaped into the arena */
+    ASSERT_TRUE(a[4].Equals("esc\"aped \\ 0123456789abcdef"));
+    ASSERT_TRUE(a[4].data < input || a[4].data > input + strlen(input));
+
+    ASSERT_TRUE(a[5].empty());
+    ASSERT_NE(a[5].data, nullptr);
+
+    ASSERT_THROW(Pg::DecodeArray(StringView("foo"), arena),
+                 std::invalid_argument);
+    ASSERT_THROW(Pg::DecodeArray(StringView("{foo"), arena),
+                 std::invalid_argument);
+    ASSERT_THROW(Pg::DecodeArray(StringView("{\"foo}"), arena),
+                 std::invalid_argument);
+    ASSERT_THROW(Pg::DecodeArray(StringView("{\"foo\\"), arena),
+                 std::invalid_argument);
+    ASSERT_THROW(Pg::DecodeArray(StringView("{\"foo\"x}"), arena),
+                 std::invalid_argument);
+    ASSERT_THROW(Pg::DecodeArray(StringView("{{foo}}"), arena),
+                 std::invalid_argument);
+    ASSERT_THROW(Pg::DecodeArray(StringView("{foo}x"), arena),
+                 std::invalid_argument);
+    ASSERT_THROW(Pg::DecodeArray(StringView("{}x"), arena),
+                 std::invalid_argument);
+}
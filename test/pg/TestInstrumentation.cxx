@@ -0,0 +1,104 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../../src/pg/Instrumentation.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace {
+
+struct RecordingInstrumentation final : Pg::QueryInstrumentation {
+	std::string slow;
+
+	explicit RecordingInstrumentation(Duration _slow_threshold) noexcept
+		:Pg::QueryInstrumentation(_slow_threshold) {}
+
+protected:
+	void OnSlowQuery(const char *label,
+			 const Pg::QueryTiming &) noexcept override {
+		slow += label;
+		slow += ';';
+	}
+};
+
+static Pg::QueryTiming
+MakeTiming(unsigned execution_ms, unsigned n_rows, bool error=false)
+{
+	Pg::QueryTiming t;
+	t.queue_wait = std::chrono::milliseconds(1);
+	t.execution = std::chrono::milliseconds(execution_ms);
+	t.n_rows = n_rows;
+	t.n_bytes = n_rows * 10;
+	t.error = error;
+	return t;
+}
+
+}
+
+TEST(PgTest, QueryInstrumentation)
+{
+	RecordingInstrumentation qi(std::chrono::milliseconds(50));
+
+	qi.Add("a", MakeTiming(2, 3));
+	qi.Add("a", MakeTiming(100, 1));
+	qi.Add("b", MakeTiming(5, 0, true));
+
+	ASSERT_EQ(qi.total.n_queries, 3u);
+	ASSERT_EQ(qi.total.n_errors, 1u);
+	ASSERT_EQ(qi.total.n_rows, 4u);
+	ASSERT_EQ(qi.total.n_bytes, 40u);
+	ASSERT_EQ(qi.total.execution.GetCount(), 3u);
+	ASSERT_EQ(qi.total.execution.GetSumMicroseconds(), 107000u);
+	ASSERT_EQ(qi.total.queue_wait.GetSumMicroseconds(), 3000u);
+
+	ASSERT_EQ(qi.labels.size(), 2u);
+	ASSERT_EQ(qi.labels["a"].n_queries, 2u);
+	ASSERT_EQ(qi.labels["a"].n_rows, 4u);
+	ASSERT_EQ(qi.labels["b"].n_errors, 1u);
+
+	/* the 101 ms query was slow (including queue wait) */
+	ASSERT_EQ(qi.n_slow_queries, 1u);
+	ASSERT_EQ(qi.slow, "a;");
+
+	/* the threshold includes the queue wait */
+	qi.Add("c", MakeTiming(49, 0));
+	ASSERT_EQ(qi.n_slow_queries, 2u);
+	ASSERT_EQ(qi.slow, "a;c;");
+
+	qi.Clear();
+	ASSERT_EQ(qi.total.n_queries, 0u);
+	ASSERT_EQ(qi.total.execution.GetCount(), 0u);
+	ASSERT_TRUE(qi.labels.empty());
+	ASSERT_EQ(qi.n_slow_queries, 0u);
+}
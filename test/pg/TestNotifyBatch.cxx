@@ -0,0 +1,100 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../../src/pg/NotifyBatch.hxx"
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Allocate a PGnotify the way libpq does: one malloc() block which
+ * also contains the strings.
+ */
+static Pg::Notify
+MakeNotify(const char *channel, const char *payload, int pid)
+{
+	const size_t channel_size = strlen(channel) + 1;
+	const size_t payload_size = strlen(payload) + 1;
+	auto *n = (PGnotify *)malloc(sizeof(PGnotify) + channel_size + payload_size);
+	n->relname = (char *)(n + 1);
+	memcpy(n->relname, channel, channel_size);
+	n->extra = n->relname + channel_size;
+	memcpy(n->extra, payload, payload_size);
+	n->be_pid = pid;
+	n->next = nullptr;
+	return Pg::Notify(n);
+}
+
+TEST(PgTest, NotifyBatch)
+{
+	Pg::NotifyBatch batch;
+	ASSERT_TRUE(batch.IsEmpty());
+
+	batch.Add(MakeNotify("a", "", 1));
+	batch.Add(MakeNotify("a", "", 2));
+	batch.Add(MakeNotify("b", "x", 3));
+	ASSERT_FALSE(batch.IsEmpty());
+
+	const auto items = batch.GetItems();
+	ASSERT_EQ(items.size, 3u);
+	ASSERT_STREQ(items[0].channel, "a");
+	ASSERT_STREQ(items[0].payload, "");
+	ASSERT_EQ(items[0].pid, 1);
+	ASSERT_EQ(items[1].pid, 2);
+	ASSERT_STREQ(items[2].channel, "b");
+	ASSERT_STREQ(items[2].payload, "x");
+	ASSERT_EQ(items[2].pid, 3);
+}
+
+TEST(PgTest, NotifyBatchCoalesce)
+{
+	Pg::NotifyBatch batch(true);
+
+	batch.Add(MakeNotify("a", "1", 1));
+	batch.Add(MakeNotify("b", "1", 2));
+	batch.Add(MakeNotify("a", "1", 3));
+	batch.Add(MakeNotify("a", "2", 4));
+	batch.Add(MakeNotify("b", "1", 5));
+
+	const auto items = batch.GetItems();
+	ASSERT_EQ(items.size, 3u);
+	ASSERT_STREQ(items[0].channel, "a");
+	ASSERT_STREQ(items[0].payload, "1");
+	ASSERT_EQ(items[0].pid, 1);
+	ASSERT_STREQ(items[1].channel, "b");
+	ASSERT_EQ(items[1].pid, 2);
+	ASSERT_STREQ(items[2].channel, "a");
+	ASSERT_STREQ(items[2].payload, "2");
+	ASSERT_EQ(items[2].pid, 4);
+}
@@ -31,9 +31,12 @@
  */
 
 #include "../../src/pg/Timestamp.hxx"
+#include "../../src/util/StringBuffer.hxx"
 
 #include <gtest/gtest.h>
 
+#include <string.h>
+
 TEST(PgTest, ParseTimestamp)
 {
 	ASSERT_EQ(Pg::ParseTimestamp("1970-01-01 00:00:00+00"),
@@ -54,3 +57,72 @@ TEST(PgTest, ParseTimestamp)
 		  + std::chrono::hours(1)
 		  + std::chrono::minutes(30));
 }
+
+TEST(PgTest, ParseTimestampFraction)
+{
+	using namespace std::chrono;
+
+	ASSERT_EQ(Pg::ParseTimestamp("2009-02-13 23:31:30.123456"),
+		  system_clock::from_time_t(1234567890) + microseconds(123456));
+	ASSERT_EQ(Pg::ParseTimestamp("2009-02-13 23:31:30.1+00:00:01"),
+		  system_clock::from_time_t(1234567890) + milliseconds(100)
+		  - seconds(1));
+	ASSERT_EQ(Pg::ParseTimestamp("1969-12-31 23:59:59.5+00"),
+		  system_clock::time_point(milliseconds(-500)));
+	ASSERT_EQ(Pg::ParseTimestamp("2000-02-29 00:00:00+05:30"),
+		  system_clock::from_time_t(951782400) - hours(5)
+		  - minutes(30));
+	ASSERT_EQ(Pg::ParseTimestamp("infinity"),
+		  system_clock::time_point::max());
+	ASSERT_EQ(Pg::ParseTimestamp("-infinity"),
+		  system_clock::time_point::min());
+}
+
+TEST(PgTest, ParseTimestampMalformed)
+{
+	for (const char *s : {"", "2009", "2009-02-13", "2009-02-13 23:31",
+			      "2009-02-30 00:00:00", "2009-13-01 00:00:00",
+			      "2009-02-13 23:60:00", "2009-02-13 23:31:30.",
+			      "2009-02-13 23:31:30+2", "2009-02-13 23:31:30 BC",
+			      "9999999-01-01 00:00:00"})
+		ASSERT_THROW(Pg::ParseTimestamp(s), std::runtime_error) << s;
+}
+
+TEST(PgTest, FormatTimestamp)
+{
+	using namespace std::chrono;
+
+	ASSERT_STREQ(Pg::FormatTimestamp(system_clock::from_time_t(0)),
+		     "1970-01-01 00:00:00");
+	ASSERT_STREQ(Pg::FormatTimestamp(system_clock::from_time_t(1234567890)),
+		     "2009-02-13 23:31:30");
+	ASSERT_STREQ(Pg::FormatTimestamp(system_clock::from_time_t(1234567890)
+					 + microseconds(120000)),
+		     "2009-02-13 23:31:30.12");
+	ASSERT_STREQ(Pg::FormatTimestamp(system_clock::time_point(milliseconds(-500))),
+		     "1969-12-31 23:59:59.5");
+	ASSERT_STREQ(Pg::FormatTimestamp(system_clock::from_time_t(951782400)),
+		     "2000-02-29 00:00:00");
+
+	/* round trip */
+	const auto t = system_clock::from_time_t(4102444799)
+		+ microseconds(999999);
+	ASSERT_EQ(Pg::ParseTimestamp(Pg::FormatTimestamp(t)), t);
+}
+
+TEST(PgTest, DecodeBinaryTimestamp)
+{
+	using namespace std::chrono;
+
+	/* 2000-01-01 00:00:01 UTC */
+	const char one_second[8] = {0, 0, 0, 0, 0, 0xf, 0x42, 0x40};
+	ASSERT_EQ(Pg::DecodeBinaryTimestamp({one_second, sizeof(one_second)}),
+		  system_clock::from_time_t(946684801));
+
+	const char infinity[8] = {0x7f, -1, -1, -1, -1, -1, -1, -1};
+	ASSERT_EQ(Pg::DecodeBinaryTimestamp({infinity, sizeof(infinity)}),
+		  system_clock::time_point::max());
+
+	ASSERT_THROW(Pg::DecodeBinaryTimestamp({one_second, 4}),
+		     std::runtime_error);
+}
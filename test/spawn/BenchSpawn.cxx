@@ -0,0 +1,318 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Benchmark for the spawner: runs RunSpawnServer() in a forked
+ * process, drives it with a SpawnServerClient and measures the
+ * latency from the request until the ExitListener callback.
+ *
+ * Usage: BenchSpawn [PROFILE [COUNT [CONCURRENCY]]]
+ *
+ * PROFILE is one of "plain", "userns", "jail", "cgroup" or "all"
+ * (the default).  Profiles which are not supported by this
+ * environment are skipped.
+ */
+
+#include "spawn/Server.hxx"
+#include "spawn/Client.hxx"
+#include "spawn/Stats.hxx"
+#include "spawn/Config.hxx"
+#include "spawn/CgroupState.hxx"
+#include "spawn/Systemd.hxx"
+#include "spawn/Prepared.hxx"
+#include "spawn/ExitListener.hxx"
+#include "event/Loop.hxx"
+#include "util/PrintException.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+using Clock = std::chrono::steady_clock;
+
+enum class Profile {
+    PLAIN,
+    USER_NAMESPACE,
+    JAIL,
+    CGROUP,
+};
+
+static constexpr struct {
+    Profile profile;
+    const char *name;
+} profiles[] = {
+    { Profile::PLAIN, "plain" },
+    { Profile::USER_NAMESPACE, "userns" },
+    { Profile::JAIL, "jail" },
+    { Profile::CGROUP, "cgroup" },
+};
+
+static void
+ApplyProfile(PreparedChildProcess &p, Profile profile)
+{
+    switch (profile) {
+    case Profile::PLAIN:
+        break;
+
+    case Profile::USER_NAMESPACE:
+        p.ns.enable_user = true;
+        break;
+
+    case Profile::JAIL:
+        p.ns.enable_user = true;
+        p.ns.enable_pid = true;
+        p.ns.enable_network = true;
+        p.ns.enable_ipc = true;
+        p.ns.enable_mount = true;
+        p.ns.mount_proc = true;
+        p.ns.mount_tmp_tmpfs = "";
+        p.ns.hostname = "bench";
+        p.no_new_privs = true;
+        break;
+
+    case Profile::CGROUP:
+        p.cgroup.name = "bench-spawn";
+        break;
+    }
+}
+
+class SpawnBenchmark final {
+    EventLoop &event_loop;
+    SpawnServerClient &client;
+
+    const Profile profile;
+
+    const unsigned n_total;
+    unsigned n_started = 0, n_finished = 0, n_failed = 0;
+
+    /**
+     * Latencies in microseconds.
+     */
+    std::vector<unsigned> latencies;
+
+    class Job final : public ExitListener {
+        SpawnBenchmark &benchmark;
+        const Clock::time_point start;
+
+    public:
+        Job(SpawnBenchmark &_benchmark)
+            :benchmark(_benchmark), start(Clock::now()) {}
+
+        void OnChildProcessExit(int status) override {
+            benchmark.OnExit(Clock::now() - start, status);
+            delete this;
+        }
+    };
+
+public:
+    SpawnBenchmark(EventLoop &_event_loop, SpawnServerClient &_client,
+                   Profile _profile, unsigned _n_total)
+        :event_loop(_event_loop), client(_client),
+         profile(_profile), n_total(_n_total) {
+        latencies.reserve(n_total);
+    }
+
+    void Start(unsigned concurrency) {
+        while (concurrency-- > 0 && n_started < n_total)
+            StartOne();
+    }
+
+    unsigned GetFailed() const {
+        return n_failed;
+    }
+
+    /**
+     * Sort #latencies and return the given percentile.
+     */
+    unsigned GetPercentile(unsigned percent) {
+        if (latencies.empty())
+            return 0;
+
+        std::sort(latencies.begin(), latencies.end());
+        return latencies[(latencies.size() - 1) * percent / 100];
+    }
+
+private:
+    void StartOne() {
+        ++n_started;
+
+        PreparedChildProcess p;
+        p.Append("/bin/true");
+        ApplyProfile(p, profile);
+
+        auto *job = new Job(*this);
+
+        try {
+            client.SpawnChildProcess("bench", std::move(p), job);
+        } catch (...) {
+            delete job;
+            PrintException(std::current_exception());
+            ++n_failed;
+            ++n_finished;
+        }
+    }
+
+    void OnExit(Clock::duration latency, int status) {
+        ++n_finished;
+
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+            latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+        else
+            ++n_failed;
+
+        if (n_started < n_total)
+            StartOne();
+        else if (n_finished == n_total)
+            event_loop.Break();
+    }
+};
+
+static void
+RunProfile(const SpawnConfig &config, const CgroupState &cgroup_state,
+           const char *name, Profile profile,
+           unsigned count, unsigned concurrency)
+{
+    if (profile == Profile::CGROUP && !cgroup_state.IsEnabled()) {
+        printf("%-8s skipped (no delegated cgroup)\n", name);
+        return;
+    }
+
+    int sv[2];
+    if (socketpair(AF_LOCAL, SOCK_SEQPACKET|SOCK_CLOEXEC|SOCK_NONBLOCK,
+                   0, sv) < 0) {
+        perror("socketpair() failed");
+        exit(EXIT_FAILURE);
+    }
+
+    const pid_t server_pid = fork();
+    if (server_pid < 0) {
+        perror("fork() failed");
+        exit(EXIT_FAILURE);
+    }
+
+    if (server_pid == 0) {
+        close(sv[1]);
+        RunSpawnServer(config, cgroup_state, nullptr, sv[0]);
+        _exit(EXIT_SUCCESS);
+    }
+
+    close(sv[0]);
+
+    const auto start = Clock::now();
+    unsigned failed, p50, p99, spawner_average = 0;
+
+    {
+        EventLoop event_loop;
+        SpawnServerClient client(event_loop, config, sv[1], false);
+
+        SpawnBenchmark benchmark(event_loop, client, profile, count);
+        benchmark.Start(concurrency);
+        event_loop.Dispatch();
+
+        failed = benchmark.GetFailed();
+        p50 = benchmark.GetPercentile(50);
+        p99 = benchmark.GetPercentile(99);
+
+        /* the spawner's own view, excluding the round trip */
+        const auto *stats = client.GetStats();
+        if (stats != nullptr)
+            spawner_average = stats->average_latency_us.load();
+
+        client.Shutdown();
+    }
+
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    waitpid(server_pid, nullptr, 0);
+
+    if (failed == count) {
+        printf("%-8s skipped (all spawns failed)\n", name);
+        return;
+    }
+
+    printf("%-8s %8.0f spawns/s  p50=%6uus  p99=%6uus  spawner=%6uus  failed=%u\n",
+           name, count / elapsed.count(), p50, p99, spawner_average,
+           failed);
+}
+
+int
+main(int argc, char **argv)
+try {
+    const char *const profile_name = argc > 1 ? argv[1] : "all";
+    const unsigned count = argc > 2 ? strtoul(argv[2], nullptr, 10) : 500;
+    const unsigned concurrency = argc > 3 ? strtoul(argv[3], nullptr, 10) : 8;
+
+    if (count == 0 || concurrency == 0) {
+        fprintf(stderr, "Usage: BenchSpawn [PROFILE [COUNT [CONCURRENCY]]]\n");
+        return EXIT_FAILURE;
+    }
+
+    SpawnConfig config;
+    if (geteuid() == 0) {
+        config.default_uid_gid.uid = 65534;
+        config.default_uid_gid.gid = 65534;
+    } else {
+        config.default_uid_gid.uid = geteuid();
+        config.default_uid_gid.gid = getegid();
+    }
+
+    const CgroupState cgroup_state = LoadSystemdCgroupState(0);
+
+    bool found = false;
+    for (const auto &i : profiles) {
+        if (strcmp(profile_name, "all") == 0 ||
+            strcmp(profile_name, i.name) == 0) {
+            found = true;
+            RunProfile(config, cgroup_state, i.name, i.profile,
+                       count, concurrency);
+            fflush(stdout);
+        }
+    }
+
+    if (!found) {
+        fprintf(stderr, "Unknown profile: %s\n", profile_name);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+} catch (...) {
+    PrintException(std::current_exception());
+    return EXIT_FAILURE;
+}
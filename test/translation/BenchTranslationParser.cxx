@@ -0,0 +1,214 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Throughput benchmark for #TranslateParser.  Usage:
+ *
+ *   BenchTranslationParser [SECONDS [CORPUS_DIR]]
+ *
+ * SECONDS is the minimum duration of each measurement.  If
+ * CORPUS_DIR is given, each response of the corpus is written there
+ * as a separate file, which can be used as seed corpus for
+ * FuzzTranslationParser.
+ *
+ * The "deferred" measurement uses
+ * TranslateParser::SetDeferChildOptions() and then materializes the
+ * child options, i.e. it is the worst case for deferred parsing.
+ *
+ * Heap usage is counted by interposing glibc's malloc(); the fake
+ * #Allocator carves pool allocations from #Arena chunks, so this
+ * counts chunks (plus objects which need a destructor).
+ */
+
+#include "Corpus.hxx"
+#include "AllocatorPtr.hxx"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+static uint64_t n_allocations, n_allocated_bytes;
+
+extern "C" void *__libc_malloc(size_t size);
+
+extern "C" void *
+malloc(size_t size) noexcept
+{
+    ++n_allocations;
+    n_allocated_bytes += size;
+    return __libc_malloc(size);
+}
+
+/**
+ * Prevent the compiler from optimizing away a result.
+ */
+static volatile size_t sink;
+
+/**
+ * Invoke the function on all responses of the corpus repeatedly for
+ * at least the given duration and print the result.
+ */
+template<typename F>
+static void
+Measure(const char *what, const TranslationCorpus &corpus,
+        double min_seconds, F &&f)
+{
+    using clock = std::chrono::steady_clock;
+
+    const uint64_t allocations_before = n_allocations;
+    const uint64_t bytes_before = n_allocated_bytes;
+
+    uint64_t n = 0;
+    const auto start = clock::now();
+    std::chrono::duration<double> elapsed;
+
+    do {
+        for (size_t i = 0; i < corpus.responses.size(); ++i)
+            f(i);
+        n += corpus.responses.size();
+        elapsed = clock::now() - start;
+    } while (elapsed.count() < min_seconds);
+
+    const double packets_per_response =
+        double(corpus.n_packets) / corpus.responses.size();
+
+    printf("%-9s %-8s %9.0f responses/s %10.0f packets/s %6.1f allocs/response %7.0f bytes/response\n",
+           what, corpus.name, n / elapsed.count(),
+           n * packets_per_response / elapsed.count(),
+           double(n_allocations - allocations_before) / n,
+           double(n_allocated_bytes - bytes_before) / n);
+}
+
+static ConstBuffer<uint8_t>
+ToBuffer(const std::string &s)
+{
+    return {(const uint8_t *)s.data(), s.size()};
+}
+
+/**
+ * Parse each response once with a #TranslationImageBuilder and
+ * return copies of the images.
+ */
+static std::vector<std::string>
+MakeImages(const TranslationCorpus &corpus)
+{
+    std::vector<std::string> images;
+
+    for (const auto &response : corpus.responses) {
+        Allocator allocator;
+        TranslationImageBuilder builder;
+        TestTranslateParser parser(allocator);
+        parser.SetImageBuilder(builder);
+
+        auto data = ToBuffer(response);
+        do {
+            data.skip_front(parser.Feed(data.data, data.size));
+        } while (parser.Process() != TranslateParser::Result::DONE);
+
+        const auto image = builder.GetImage();
+        images.emplace_back((const char *)image.data, image.size);
+    }
+
+    return images;
+}
+
+static void
+WriteCorpus(const char *directory, const TranslationCorpus &corpus)
+{
+    for (size_t i = 0; i < corpus.responses.size(); ++i) {
+        const auto path = std::string(directory) + "/" + corpus.name +
+            "-" + std::to_string(i);
+        FILE *file = fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            perror(path.c_str());
+            exit(EXIT_FAILURE);
+        }
+
+        const auto &response = corpus.responses[i];
+        fwrite(response.data(), 1, response.size(), file);
+        fclose(file);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    const double min_seconds = argc > 1 ? strtod(argv[1], nullptr) : 0.5;
+    const char *const corpus_directory = argc > 2 ? argv[2] : nullptr;
+
+    const auto corpora = MakeTranslationCorpora(256);
+
+    for (const auto &corpus : corpora) {
+        if (!corpus.IsSupported()) {
+            printf("corpus %-8s skipped: not supported by this build\n",
+                   corpus.name);
+            continue;
+        }
+
+        printf("corpus %-8s %5.1f packets/response %5.0f bytes/response\n",
+               corpus.name,
+               double(corpus.n_packets) / corpus.responses.size(),
+               double(corpus.n_bytes) / corpus.responses.size());
+
+        if (corpus_directory != nullptr)
+            WriteCorpus(corpus_directory, corpus);
+    }
+
+    for (const auto &corpus : corpora) {
+        if (!corpus.IsSupported())
+            continue;
+
+        Measure("stream", corpus, min_seconds, [&corpus](size_t i){
+                sink += ParseTranslationStream(ToBuffer(corpus.responses[i]),
+                                               false);
+            });
+
+        Measure("deferred", corpus, min_seconds, [&corpus](size_t i){
+                sink += ParseTranslationStream(ToBuffer(corpus.responses[i]),
+                                               true);
+            });
+
+        const auto images = MakeImages(corpus);
+        Measure("image", corpus, min_seconds, [&images](size_t i){
+                Allocator allocator;
+                TestTranslateParser parser(allocator);
+                const auto &image = images[i];
+                sink += size_t(parser.ProcessImage({image.data(), image.size()}));
+            });
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,319 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Corpus.hxx"
+#include "translation/Protocol.hxx"
+#include "spawn/ChildOptions.hxx"
+#include "util/StringView.hxx"
+#include "AllocatorPtr.hxx"
+
+#include <random>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace {
+
+/**
+ * Serializes packets into one response.
+ */
+class ResponseWriter {
+    TranslationCorpus &corpus;
+    std::string &data;
+
+public:
+    explicit ResponseWriter(TranslationCorpus &_corpus)
+        :corpus(_corpus),
+         data(corpus.AddResponse()) {
+        Packet(TranslationCommand::BEGIN, StringView("\x03", 1));
+    }
+
+    ~ResponseWriter() {
+        Packet(TranslationCommand::END);
+        corpus.n_bytes += data.size();
+    }
+
+    ResponseWriter(const ResponseWriter &) = delete;
+    ResponseWriter &operator=(const ResponseWriter &) = delete;
+
+    void Packet(TranslationCommand command, const void *payload,
+                size_t length) {
+        const TranslationHeader header{uint16_t(length), command};
+        data.append((const char *)&header, sizeof(header));
+        data.append((const char *)payload, length);
+        ++corpus.n_packets;
+    }
+
+    void Packet(TranslationCommand command) {
+        Packet(command, nullptr, 0);
+    }
+
+    void Packet(TranslationCommand command, StringView payload) {
+        Packet(command, payload.data, payload.size);
+    }
+
+    void Packet(TranslationCommand command, const char *payload) {
+        Packet(command, StringView(payload));
+    }
+
+    void Packet(TranslationCommand command, const std::string &payload) {
+        Packet(command, payload.data(), payload.size());
+    }
+
+    void Packet16(TranslationCommand command, uint16_t value) {
+        Packet(command, &value, sizeof(value));
+    }
+
+    void Packet32(TranslationCommand command, uint32_t value) {
+        Packet(command, &value, sizeof(value));
+    }
+};
+
+class Generator {
+    std::mt19937 rng;
+
+public:
+    std::string Name(const char *prefix) {
+        return prefix + std::to_string(rng() % 100000);
+    }
+
+    std::string Path(const char *prefix, unsigned n_segments) {
+        static constexpr char chars[] = "abcdefghijklmnopqrstuvwxyz0123456789-_";
+
+        std::string path(prefix);
+        for (unsigned i = 0; i < n_segments; ++i) {
+            path.push_back('/');
+            const unsigned length = 3 + rng() % 10;
+            for (unsigned j = 0; j < length; ++j)
+                path.push_back(chars[rng() % (sizeof(chars) - 1)]);
+        }
+
+        return path;
+    }
+
+    uint32_t MaxAge() {
+        return 60 * (1 + rng() % 60);
+    }
+};
+
+}
+
+/**
+ * Responses which only use packets known to every parser build.
+ */
+static void
+MakeMinimal(TranslationCorpus &corpus, Generator &g)
+{
+    ResponseWriter w(corpus);
+    w.Packet32(TranslationCommand::MAX_AGE, g.MaxAge());
+    w.Packet16(TranslationCommand::STATUS, 200);
+    w.Packet(TranslationCommand::CANONICAL_HOST,
+             g.Name("www") + ".example.com");
+    w.Packet(TranslationCommand::POOL, "default");
+    w.Packet(TranslationCommand::TOKEN, g.Name("t"));
+    w.Packet(TranslationCommand::AUTO_GZIP);
+
+    const std::string path = g.Path("/var/www", 3);
+    std::string validate_mtime(8, '\0');
+    validate_mtime += path;
+    w.Packet(TranslationCommand::VALIDATE_MTIME, validate_mtime);
+    w.Packet(TranslationCommand::TEST_PATH, path);
+}
+
+/**
+ * Appends the packets of a typical jailed child process.
+ */
+static void
+WriteJail(ResponseWriter &w, Generator &g)
+{
+    const std::string user = g.Name("user");
+    const std::string home = "/var/www/" + user;
+
+    w.Packet(TranslationCommand::USER_NAMESPACE);
+    w.Packet(TranslationCommand::PID_NAMESPACE);
+    w.Packet(TranslationCommand::NETWORK_NAMESPACE);
+    w.Packet(TranslationCommand::IPC_NAMESPACE);
+    w.Packet(TranslationCommand::PIVOT_ROOT, "/srv/chroot/stretch");
+    w.Packet(TranslationCommand::MOUNT_PROC);
+    w.Packet(TranslationCommand::HOME, home);
+    w.Packet(TranslationCommand::MOUNT_HOME, "/home");
+    w.Packet(TranslationCommand::MOUNT_TMP_TMPFS);
+    w.Packet(TranslationCommand::BIND_MOUNT,
+             StringView("/usr/share/zoneinfo\0/usr/share/zoneinfo", 40));
+    w.Packet(TranslationCommand::RLIMITS, "t600f1073741824");
+    w.Packet(TranslationCommand::CGROUP, user);
+    w.Packet(TranslationCommand::CGROUP_SET, "cpu.shares=100");
+    w.Packet(TranslationCommand::NO_NEW_PRIVS);
+
+    const uint32_t uid_gid[] = { 10000, 10000 };
+    w.Packet(TranslationCommand::UID_GID, uid_gid, sizeof(uid_gid));
+    w.Packet(TranslationCommand::CHILD_TAG, user);
+}
+
+static void
+MakeJailed(TranslationCorpus &corpus, Generator &g)
+{
+    ResponseWriter w(corpus);
+    w.Packet32(TranslationCommand::MAX_AGE, g.MaxAge());
+    w.Packet(TranslationCommand::EXECUTE, "/usr/bin/php-cgi");
+    w.Packet(TranslationCommand::APPEND, "-d");
+    w.Packet(TranslationCommand::APPEND, "display_errors=0");
+    w.Packet(TranslationCommand::SETENV, "PATH=/usr/local/bin:/usr/bin:/bin");
+    w.Packet(TranslationCommand::SETENV, "LANG=C.UTF-8");
+    WriteJail(w, g);
+    w.Packet(TranslationCommand::STDERR_NULL);
+}
+
+static void
+MakeCgi(TranslationCorpus &corpus, Generator &g)
+{
+    const std::string document_root = g.Path("/var/www", 2);
+
+    ResponseWriter w(corpus);
+    w.Packet32(TranslationCommand::MAX_AGE, g.MaxAge());
+    w.Packet(TranslationCommand::DOCUMENT_ROOT, document_root);
+    w.Packet(TranslationCommand::CGI, document_root + "/index.cgi");
+    w.Packet(TranslationCommand::SCRIPT_NAME, "/index.cgi");
+    w.Packet(TranslationCommand::PATH_INFO, g.Path("", 2));
+    w.Packet(TranslationCommand::PAIR, "SERVER_ADMIN=webmaster@example.com");
+    WriteJail(w, g);
+}
+
+static void
+MakeFastCgi(TranslationCorpus &corpus, Generator &g)
+{
+    const std::string document_root = g.Path("/var/www", 2);
+
+    ResponseWriter w(corpus);
+    w.Packet32(TranslationCommand::MAX_AGE, g.MaxAge());
+    w.Packet(TranslationCommand::FASTCGI, "/usr/bin/php-cgi");
+    w.Packet(TranslationCommand::ADDRESS_STRING, "/run/php-fpm/www.sock");
+    w.Packet(TranslationCommand::DOCUMENT_ROOT, document_root);
+    w.Packet(TranslationCommand::SCRIPT_NAME, "/index.php");
+    w.Packet(TranslationCommand::PATH_INFO, g.Path("", 3));
+    w.Packet(TranslationCommand::PAIR,
+             "SCRIPT_FILENAME=" + document_root + "/index.php");
+    w.Packet(TranslationCommand::PAIR, "HTTPS=on");
+    w.Packet(TranslationCommand::PAIR, "PHP_VALUE=memory_limit=256M");
+}
+
+static void
+MakeWidget(TranslationCorpus &corpus, Generator &g)
+{
+    const std::string host = g.Name("w") + ".widgets.example.com";
+
+    ResponseWriter w(corpus);
+    w.Packet32(TranslationCommand::MAX_AGE, g.MaxAge());
+    w.Packet(TranslationCommand::WIDGET_GROUP, "portal");
+    w.Packet(TranslationCommand::UNTRUSTED, host);
+    w.Packet(TranslationCommand::HTTP, "http://" + host + g.Path("", 2));
+    w.Packet(TranslationCommand::PROCESS);
+    w.Packet(TranslationCommand::CONTAINER);
+    w.Packet(TranslationCommand::FOCUS_WIDGET);
+
+    static const char *const views[] = { "edit", "preview", "raw" };
+    for (const char *view : views) {
+        w.Packet(TranslationCommand::VIEW, view);
+        w.Packet(TranslationCommand::HTTP,
+                 "http://" + host + "/" + view + g.Path("", 1));
+        w.Packet(TranslationCommand::PROCESS);
+        w.Packet(TranslationCommand::CONTAINER);
+    }
+}
+
+std::vector<TranslationCorpus>
+MakeTranslationCorpora(size_t n_responses)
+{
+    struct Kind {
+        const char *name;
+        TranslationFeatureSet features;
+        void (*make)(TranslationCorpus &corpus, Generator &g);
+    };
+
+    static constexpr Kind kinds[] = {
+        {"minimal", TranslationFeatureSet(), MakeMinimal},
+        {"jailed", TranslationFeature::EXECUTE, MakeJailed},
+        {"cgi", TranslationFeature::RADDRESS, MakeCgi},
+        {"fastcgi", TranslationFeature::RADDRESS|TranslationFeature::HTTP,
+         MakeFastCgi},
+        {"widget",
+         TranslationFeature::RADDRESS|TranslationFeature::WIDGET|TranslationFeature::TRANSFORMATION,
+         MakeWidget},
+    };
+
+    Generator g;
+
+    std::vector<TranslationCorpus> corpora;
+    for (const auto &kind : kinds) {
+        corpora.emplace_back(kind.name, kind.features);
+        auto &corpus = corpora.back();
+
+        for (size_t i = 0; i < n_responses; ++i)
+            kind.make(corpus, g);
+    }
+
+    return corpora;
+}
+
+size_t
+ParseTranslationStream(ConstBuffer<uint8_t> data, bool defer_child_options)
+{
+    size_t n_responses = 0;
+
+    while (!data.empty()) {
+        Allocator allocator;
+        TestTranslateParser parser(allocator);
+        parser.SetDeferChildOptions(defer_child_options);
+
+        while (true) {
+            const size_t nbytes = parser.Feed(data.data, data.size);
+            if (nbytes == 0)
+                /* truncated */
+                return n_responses;
+
+            data.skip_front(nbytes);
+
+            if (parser.Process() == TranslateParser::Result::DONE)
+                break;
+        }
+
+#if TRANSLATION_ENABLE_EXECUTE
+        if (defer_child_options)
+            TranslateParser::MaterializeChildOptions(allocator,
+                                                     parser.GetResponse().child_options);
+#endif
+
+        ++n_responses;
+    }
+
+    return n_responses;
+}
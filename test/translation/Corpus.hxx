@@ -0,0 +1,126 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Synthetic translation response streams shared by the parser
+ * benchmark and the parser fuzzer.
+ */
+
+#ifndef BENG_PROXY_TRANSLATION_TEST_CORPUS_HXX
+#define BENG_PROXY_TRANSLATION_TEST_CORPUS_HXX
+
+#include "translation/Parser.hxx"
+#include "translation/FeatureSet.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+
+/**
+ * A set of complete responses (BEGIN..END) of one kind, each
+ * serialized exactly like a translation server would send it.
+ */
+struct TranslationCorpus {
+    const char *name;
+
+    /**
+     * The features the parser needs to accept these responses; if
+     * the build lacks one of them, the parser rejects the packets as
+     * unknown.
+     */
+    TranslationFeatureSet features;
+
+    std::vector<std::string> responses;
+
+    size_t n_packets = 0, n_bytes = 0;
+
+    TranslationCorpus(const char *_name, TranslationFeatureSet _features)
+        :name(_name), features(_features) {}
+
+    std::string &AddResponse() {
+        responses.emplace_back();
+        return responses.back();
+    }
+
+    bool IsSupported() const {
+        return translation_features.Contains(features);
+    }
+};
+
+/**
+ * Generate all corpora; the result is deterministic.
+ *
+ * @param n_responses the number of responses per corpus
+ */
+std::vector<TranslationCorpus>
+MakeTranslationCorpora(size_t n_responses);
+
+/**
+ * A #TranslateParser for responses which do not belong to a
+ * specific request.
+ */
+class TestTranslateParser : public TranslateParser {
+public:
+    explicit TestTranslateParser(AllocatorPtr alloc)
+        :TranslateParser(alloc
+#if TRANSLATION_ENABLE_RADDRESS || TRANSLATION_ENABLE_HTTP || TRANSLATION_ENABLE_WANT
+                         , GetDummyRequest()
+#endif
+                         ) {}
+
+#if TRANSLATION_ENABLE_RADDRESS || TRANSLATION_ENABLE_HTTP || TRANSLATION_ENABLE_WANT
+private:
+    static const TranslateRequest &GetDummyRequest() {
+        static const TranslateRequest request{};
+        return request;
+    }
+#endif
+};
+
+/**
+ * Feed a stream of responses to #TranslateParser, each one with a
+ * new #Allocator, the way the translation client does it.  A
+ * truncated response at the end is ignored.
+ *
+ * Throws std::runtime_error on error.
+ *
+ * @param defer_child_options see
+ * TranslateParser::SetDeferChildOptions(); if enabled, the child
+ * options of each response are materialized after parsing it
+ * @return the number of complete responses
+ */
+size_t
+ParseTranslationStream(ConstBuffer<uint8_t> data, bool defer_child_options);
+
+#endif
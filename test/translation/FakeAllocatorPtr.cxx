@@ -0,0 +1,67 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Out-of-line methods of the fake AllocatorPtr (see
+ * fake/AllocatorPtr.hxx) used by the translation library.
+ */
+
+#include "AllocatorPtr.hxx"
+
+ConstBuffer<void>
+AllocatorPtr::Dup(ConstBuffer<void> src)
+{
+    if (src.IsNull())
+        return nullptr;
+
+    return {Dup(src.data, src.size), src.size};
+}
+
+StringView
+AllocatorPtr::Dup(StringView src)
+{
+    if (src.IsNull())
+        return nullptr;
+
+    return {(const char *)Dup(src.data, src.size), src.size};
+}
+
+const char *
+AllocatorPtr::DupZ(StringView src)
+{
+    if (src.IsNull())
+        return nullptr;
+
+    char *p = NewArray<char>(src.size + 1);
+    *(char *)mempcpy(p, src.data, src.size) = 0;
+    return p;
+}
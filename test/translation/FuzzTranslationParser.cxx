@@ -0,0 +1,146 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Fuzz target for #TranslatePacketReader and #TranslateParser.
+ *
+ * Build with "-fsanitize=fuzzer -DHAVE_LIBFUZZER" to use libFuzzer;
+ * "BenchTranslationParser SECONDS CORPUS_DIR" writes a seed corpus.
+ * Without libFuzzer, this program passes each file given on the
+ * command line to the fuzz target, or, without arguments, the
+ * built-in corpus and systematic mutations of it (all truncations
+ * and single-byte corruptions).
+ */
+
+#include "Corpus.hxx"
+
+#include <stdexcept>
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+extern "C" int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    for (bool defer : {false, true}) {
+        try {
+            ParseTranslationStream({data, size}, defer);
+        } catch (const std::runtime_error &) {
+            /* malformed input is expected */
+        }
+    }
+
+    return 0;
+}
+
+#ifndef HAVE_LIBFUZZER
+
+static void
+TestOneInput(const std::string &data)
+{
+    LLVMFuzzerTestOneInput((const uint8_t *)data.data(), data.size());
+}
+
+static bool
+TestFile(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        perror(path);
+        return false;
+    }
+
+    std::string data;
+    char buffer[4096];
+    size_t nbytes;
+    while ((nbytes = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        data.append(buffer, nbytes);
+
+    fclose(file);
+
+    TestOneInput(data);
+    return true;
+}
+
+static void
+TestMutations(const std::string &response)
+{
+    TestOneInput(response);
+
+    for (size_t length = 0; length < response.size(); ++length)
+        TestOneInput(response.substr(0, length));
+
+    std::string mutated = response;
+    for (size_t i = 0; i < mutated.size(); ++i) {
+        const char original = mutated[i];
+
+        mutated[i] = ~original;
+        TestOneInput(mutated);
+
+        mutated[i] = 0;
+        TestOneInput(mutated);
+
+        mutated[i] = original;
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i)
+            if (!TestFile(argv[i]))
+                return EXIT_FAILURE;
+
+        return EXIT_SUCCESS;
+    }
+
+    for (const auto &corpus : MakeTranslationCorpora(4)) {
+        if (!corpus.IsSupported())
+            continue;
+
+        std::string all;
+        for (const auto &response : corpus.responses) {
+            TestMutations(response);
+            all += response;
+        }
+
+        /* several responses in one stream */
+        TestOneInput(all);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Compare the hash functions in libcommon on keys of realistic
+ * lengths.  Run with "meson test --benchmark" or directly; an
+ * optional argument specifies the minimum duration of each
+ * measurement in seconds.
+ */
+
+#include "util/FNVHash.hxx"
+#include "util/WyHash.hxx"
+#include "util/djbhash.h"
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+static constexpr size_t N_KEYS = 1024;
+
+struct KeySet {
+	const char *name;
+	std::vector<std::string> keys;
+	size_t total_size = 0;
+
+	template<typename G>
+	KeySet(const char *_name, G &&generate)
+		:name(_name)
+	{
+		std::mt19937 rng(42);
+		keys.reserve(N_KEYS);
+		for (size_t i = 0; i < N_KEYS; ++i) {
+			keys.emplace_back(generate(rng));
+			total_size += keys.back().size();
+		}
+	}
+};
+
+static std::string
+RandomWord(std::mt19937 &rng, unsigned min_length, unsigned max_length)
+{
+	static constexpr char chars[] = "abcdefghijklmnopqrstuvwxyz0123456789-_";
+
+	std::string word;
+	const unsigned length = min_length + rng() % (max_length - min_length + 1);
+	for (unsigned i = 0; i < length; ++i)
+		word.push_back(chars[rng() % (sizeof(chars) - 1)]);
+	return word;
+}
+
+static std::string
+RandomPath(std::mt19937 &rng, unsigned n_segments)
+{
+	std::string path;
+	for (unsigned i = 0; i < n_segments; ++i) {
+		path.push_back('/');
+		path += RandomWord(rng, 3, 12);
+	}
+
+	return path;
+}
+
+template<typename F>
+static void
+Measure(const char *what, const KeySet &set, double min_seconds, F &&f)
+{
+	using clock = std::chrono::steady_clock;
+
+	uint64_t n = 0;
+	const auto start = clock::now();
+	std::chrono::duration<double> elapsed;
+
+	do {
+		for (const auto &key : set.keys)
+			f(key);
+		n += set.keys.size();
+		elapsed = clock::now() - start;
+	} while (elapsed.count() < min_seconds);
+
+	const double ns = elapsed.count() * 1e9 / n;
+	printf("%-12s %-10s %7.1f ns/key %7.2f GB/s\n",
+	       what, set.name, ns,
+	       double(set.total_size) * n / set.keys.size() / elapsed.count() / 1e9);
+}
+
+/**
+ * Prevent the compiler from optimizing away a result.
+ */
+static volatile uint64_t sink;
+
+int
+main(int argc, char **argv)
+{
+	const double min_seconds = argc > 1 ? strtod(argv[1], nullptr) : 0.5;
+
+	const KeySet sets[] = {
+		{"site", [](std::mt19937 &rng){
+				return "site" + std::to_string(rng() % 1000);
+			}},
+		{"host", [](std::mt19937 &rng){
+				return "www." + RandomWord(rng, 4, 12) + ".example.com";
+			}},
+		{"short-uri", [](std::mt19937 &rng){
+				return RandomPath(rng, 1 + rng() % 3);
+			}},
+		{"long-uri", [](std::mt19937 &rng){
+				return RandomPath(rng, 8) + "?utm_source=newsletter&session=" + std::to_string(rng());
+			}},
+	};
+
+	for (const auto &set : sets)
+		printf("keys %-10s %5.1f bytes/key\n", set.name,
+		       double(set.total_size) / set.keys.size());
+
+	for (const auto &set : sets) {
+		Measure("fnv1a64", set, min_seconds, [](const std::string &key){
+				sink += FNV1aHash64(key.data(), key.size());
+			});
+
+		Measure("djb", set, min_seconds, [](const std::string &key){
+				sink += djb_hash(key.data(), key.size());
+			});
+
+		Measure("wyhash", set, min_seconds, [](const std::string &key){
+				sink += WyHash64(key.data(), key.size());
+			});
+
+		Measure("fnv1a64-str", set, min_seconds, [](const std::string &key){
+				sink += FNV1aHash64(key.c_str());
+			});
+
+		Measure("wyhash-str", set, min_seconds, [](const std::string &key){
+				sink += WyHash64(key.c_str());
+			});
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Measure the throughput of the concurrent queues in libcommon,
+ * compared with a std::mutex protected std::deque.  Run with "meson
+ * test --benchmark" or directly; an optional argument specifies the
+ * number of elements passed through each queue (in millions).
+ */
+
+#include "util/SpscQueue.hxx"
+#include "util/MpscQueue.hxx"
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+using Clock = std::chrono::steady_clock;
+
+static void
+Report(const char *what, unsigned n_producers, uint64_t n,
+       Clock::time_point start)
+{
+	const std::chrono::duration<double> elapsed = Clock::now() - start;
+	printf("%-8s producers=%u %7.1f ns/item %7.2f Mitems/s\n",
+	       what, n_producers, elapsed.count() * 1e9 / n,
+	       n / elapsed.count() / 1e6);
+}
+
+static void
+BenchSpsc(uint64_t n)
+{
+	SpscQueue<uint64_t> q(1024);
+
+	const auto start = Clock::now();
+
+	std::thread producer([&q, n](){
+		for (uint64_t i = 0; i < n;) {
+			uint64_t *p = q.Reserve();
+			if (p == nullptr) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			*p = i++;
+			q.Commit();
+		}
+	});
+
+	uint64_t sum = 0;
+	for (uint64_t i = 0; i < n;) {
+		const uint64_t *p = q.Front();
+		if (p == nullptr) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		sum += *p;
+		q.Pop();
+		++i;
+	}
+
+	producer.join();
+	Report("spsc", 1, n, start);
+
+	if (sum != n * (n - 1) / 2)
+		abort();
+}
+
+struct Item : MpscQueueHook {
+	uint64_t value;
+};
+
+static void
+BenchMpsc(uint64_t n, unsigned n_producers)
+{
+	const uint64_t per_producer = n / n_producers;
+	n = per_producer * n_producers;
+
+	MpscQueue<Item> q;
+
+	std::vector<std::unique_ptr<Item[]>> items;
+	for (unsigned i = 0; i < n_producers; ++i)
+		items.emplace_back(new Item[per_producer]);
+
+	const auto start = Clock::now();
+
+	std::vector<std::thread> producers;
+	for (unsigned i = 0; i < n_producers; ++i) {
+		Item *const array = items[i].get();
+		producers.emplace_back([&q, array, per_producer](){
+			for (uint64_t j = 0; j < per_producer; ++j) {
+				array[j].value = j;
+				q.Push(array[j]);
+			}
+		});
+	}
+
+	uint64_t sum = 0;
+	for (uint64_t i = 0; i < n;) {
+		Item *item = q.Pop();
+		if (item == nullptr) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		sum += item->value;
+		++i;
+	}
+
+	for (auto &t : producers)
+		t.join();
+
+	Report("mpsc", n_producers, n, start);
+
+	if (sum != n_producers * (per_producer * (per_producer - 1) / 2))
+		abort();
+}
+
+static void
+BenchMutex(uint64_t n, unsigned n_producers)
+{
+	const uint64_t per_producer = n / n_producers;
+	n = per_producer * n_producers;
+
+	std::mutex mutex;
+	std::deque<uint64_t> q;
+
+	const auto start = Clock::now();
+
+	std::vector<std::thread> producers;
+	for (unsigned i = 0; i < n_producers; ++i) {
+		producers.emplace_back([&mutex, &q, per_producer](){
+			for (uint64_t j = 0; j < per_producer; ++j) {
+				const std::lock_guard<std::mutex> lock(mutex);
+				q.push_back(j);
+			}
+		});
+	}
+
+	uint64_t sum = 0;
+	for (uint64_t i = 0; i < n;) {
+		std::unique_lock<std::mutex> lock(mutex);
+		if (q.empty()) {
+			lock.unlock();
+			std::this_thread::yield();
+			continue;
+		}
+
+		sum += q.front();
+		q.pop_front();
+		++i;
+	}
+
+	for (auto &t : producers)
+		t.join();
+
+	Report("mutex", n_producers, n, start);
+
+	if (sum != n_producers * (per_producer * (per_producer - 1) / 2))
+		abort();
+}
+
+int
+main(int argc, char **argv)
+{
+	const uint64_t n = (argc > 1 ? strtod(argv[1], nullptr) : 2) * 1e6;
+
+	BenchSpsc(n);
+
+	for (unsigned n_producers : {1, 2, 4}) {
+		BenchMpsc(n, n_producers);
+		BenchMutex(n, n_producers);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/AllocatedString.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+TEST(AllocatedString, Null)
+{
+	AllocatedString<> s = nullptr;
+	EXPECT_TRUE(s.IsNull());
+	EXPECT_TRUE(s == nullptr);
+
+	AllocatedString<> t(std::move(s));
+	EXPECT_TRUE(t.IsNull());
+	EXPECT_EQ(t.Steal(), nullptr);
+}
+
+TEST(AllocatedString, Empty)
+{
+	auto s = AllocatedString<>::Empty();
+	EXPECT_FALSE(s.IsNull());
+	EXPECT_TRUE(s.empty());
+	EXPECT_STREQ(s.c_str(), "");
+}
+
+TEST(AllocatedString, Inline)
+{
+	static_assert(AllocatedString<>::INLINE_CAPACITY >= 22, "");
+	static_assert(sizeof(AllocatedString<>) <= 32, "");
+
+	const std::string value(AllocatedString<>::INLINE_CAPACITY, 'x');
+	auto s = AllocatedString<>::Duplicate(value.c_str());
+	EXPECT_STREQ(s.c_str(), value.c_str());
+
+	/* the inline buffer moves with the object */
+	auto t = std::move(s);
+	EXPECT_TRUE(s.IsNull());
+	EXPECT_STREQ(t.c_str(), value.c_str());
+
+	t.data()[0] = 'y';
+	EXPECT_EQ(t[0], 'y');
+
+	auto u = t.Clone();
+	EXPECT_STREQ(u.c_str(), t.c_str());
+	EXPECT_NE(u.c_str(), t.c_str());
+}
+
+TEST(AllocatedString, Heap)
+{
+	const std::string value(AllocatedString<>::INLINE_CAPACITY + 1, 'x');
+	auto s = AllocatedString<>::Duplicate(value.data(),
+					      value.data() + value.length());
+	EXPECT_STREQ(s.c_str(), value.c_str());
+
+	/* a heap string keeps its address when moved */
+	const char *p = s.c_str();
+	auto t = std::move(s);
+	EXPECT_TRUE(s.IsNull());
+	EXPECT_EQ(t.c_str(), p);
+}
+
+TEST(AllocatedString, Steal)
+{
+	auto s = AllocatedString<>::Duplicate("foo");
+	char *p = s.Steal();
+	EXPECT_TRUE(s.IsNull());
+	EXPECT_STREQ(p, "foo");
+
+	auto t = AllocatedString<>::Donate(p);
+	EXPECT_EQ(t.c_str(), p);
+
+	const std::string value(100, 'x');
+	auto u = AllocatedString<>::Duplicate(value.c_str());
+	const char *q = u.c_str();
+	char *r = u.Steal();
+	EXPECT_EQ(r, q);
+	delete[] r;
+}
+
+TEST(AllocatedString, MoveAssign)
+{
+	const std::string long_value(100, 'x');
+
+	auto a = AllocatedString<>::Duplicate("short");
+	auto b = AllocatedString<>::Duplicate(long_value.c_str());
+	auto c = AllocatedString<>::Duplicate(long_value.c_str());
+	AllocatedString<> d = nullptr;
+
+	/* inline over heap */
+	b = std::move(a);
+	EXPECT_STREQ(b.c_str(), "short");
+
+	/* heap over null */
+	d = std::move(c);
+	EXPECT_STREQ(d.c_str(), long_value.c_str());
+
+	/* heap over inline */
+	b = std::move(d);
+	EXPECT_STREQ(b.c_str(), long_value.c_str());
+
+	/* inline over inline */
+	auto e = AllocatedString<>::Duplicate("one");
+	auto f = AllocatedString<>::Duplicate("two");
+	e = std::move(f);
+	EXPECT_STREQ(e.c_str(), "two");
+
+	auto &g = e;
+	e = std::move(g);
+	EXPECT_STREQ(e.c_str(), "two");
+}
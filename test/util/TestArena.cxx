@@ -0,0 +1,163 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/Arena.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <string.h>
+#include <stdint.h>
+
+struct ArenaTestItem {
+	ArenaTestItem *next;
+	int value;
+
+	ArenaTestItem(ArenaTestItem *_next, int _value)
+		:next(_next), value(_value) {}
+};
+
+TEST(Arena, Basic)
+{
+	Arena arena(256);
+
+	ArenaTestItem *head = nullptr;
+	for (int i = 0; i < 1000; ++i) {
+		head = arena.New<ArenaTestItem>(head, i);
+		EXPECT_EQ((uintptr_t)head % alignof(ArenaTestItem), 0u);
+	}
+
+	for (int i = 999; i >= 0; --i) {
+		ASSERT_NE(head, nullptr);
+		EXPECT_EQ(head->value, i);
+		head = head->next;
+	}
+
+	EXPECT_EQ(head, nullptr);
+}
+
+TEST(Arena, Strings)
+{
+	Arena arena(64);
+
+	const char *a = arena.Dup("foo");
+	const char *b = arena.DupZ(StringView("barbaz", 3));
+	const char *c = arena.Concat("NAME", "=", "value");
+
+	EXPECT_STREQ(a, "foo");
+	EXPECT_STREQ(b, "bar");
+	EXPECT_STREQ(c, "NAME=value");
+}
+
+TEST(Arena, Large)
+{
+	Arena arena(256);
+
+	const char *small = arena.Dup("small");
+
+	/* larger than a chunk */
+	char *large = (char *)arena.Allocate(10000, 1);
+	memset(large, 'x', 10000);
+
+	/* the current chunk is still being used */
+	const char *small2 = arena.Dup("small2");
+	EXPECT_EQ(small2, small + 6);
+
+	EXPECT_STREQ(small, "small");
+	EXPECT_STREQ(small2, "small2");
+	EXPECT_EQ(large[9999], 'x');
+
+	arena.Clear();
+	EXPECT_STREQ(arena.Dup("again"), "again");
+}
+
+TEST(Arena, Growth)
+{
+	Arena arena(256);
+
+	/* allocate much more than one chunk; each allocation must be
+	   usable and properly aligned */
+	std::vector<char *> v;
+	for (unsigned i = 0; i < 10000; ++i) {
+		char *p = (char *)arena.Allocate(48);
+		ASSERT_EQ((uintptr_t)p % alignof(max_align_t), 0u);
+		memset(p, i, 48);
+		v.push_back(p);
+	}
+
+	for (unsigned i = 0; i < v.size(); ++i)
+		ASSERT_EQ(v[i][47], char(i));
+}
+
+TEST(Arena, Reset)
+{
+	Arena arena(256);
+
+	for (unsigned i = 0; i < 100; ++i)
+		arena.Dup("0123456789");
+
+	/* larger than a chunk */
+	arena.Allocate(100000, 1);
+
+	const char *a = arena.Dup("a");
+	arena.Reset();
+
+	/* the most recent regular chunk is reused from its start */
+	const char *b = arena.Dup("b");
+	EXPECT_LE(b, a);
+	EXPECT_STREQ(b, "b");
+
+	arena.Reset();
+	EXPECT_EQ(arena.Dup("c"), b);
+}
+
+TEST(Arena, Huge)
+{
+	Arena arena(Arena::MAX_CHUNK_SIZE);
+
+	/* this gets a huge page aligned chunk */
+	char *p = (char *)arena.Allocate(3 * 1024 * 1024, 1);
+	memset(p, 'x', 3 * 1024 * 1024);
+
+	/* regular chunks grow up to the huge page size */
+	Arena arena2(1024);
+	for (unsigned i = 0; i < 100000; ++i)
+		memset(arena2.Allocate(100, 1), 'y', 100);
+
+	/* the huge chunk is kept */
+	arena2.Reset();
+	const char *first = (const char *)arena2.Allocate(100, 1);
+	for (unsigned i = 0; i < 10000; ++i)
+		memset(arena2.Allocate(100, 1), 'z', 100);
+	EXPECT_EQ((const char *)arena2.Allocate(100, 1), first + 10001 * 100);
+}
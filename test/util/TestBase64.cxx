@@ -0,0 +1,133 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/Base64.hxx"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+
+static std::string
+Encode(const char *s, bool url_safe=false)
+{
+	const ConstBuffer<void> src(s, strlen(s));
+	char buffer[256];
+	const size_t length = url_safe
+		? EncodeUrlSafeBase64(buffer, src)
+		: EncodeBase64(buffer, src);
+	EXPECT_LE(length, CalculateBase64OutputSize(src.size));
+	return {buffer, length};
+}
+
+static std::string
+Decode(const char *s)
+{
+	char buffer[256];
+	const auto length = DecodeBase64(buffer, s);
+	if (length < 0)
+		return "ERROR";
+
+	EXPECT_LE(size_t(length), CalculateBase64DecodedSize(strlen(s)));
+	return {buffer, size_t(length)};
+}
+
+TEST(Base64, Encode)
+{
+	/* test vectors from RFC 4648 */
+	EXPECT_EQ(Encode(""), "");
+	EXPECT_EQ(Encode("f"), "Zg==");
+	EXPECT_EQ(Encode("fo"), "Zm8=");
+	EXPECT_EQ(Encode("foo"), "Zm9v");
+	EXPECT_EQ(Encode("foob"), "Zm9vYg==");
+	EXPECT_EQ(Encode("fooba"), "Zm9vYmE=");
+	EXPECT_EQ(Encode("foobar"), "Zm9vYmFy");
+
+	EXPECT_EQ(Encode("\xfb\xff\xfe"), "+//+");
+	EXPECT_EQ(Encode("\xfb\xff\xfe", true), "-__-");
+	EXPECT_EQ(Encode("f", true), "Zg");
+	EXPECT_EQ(Encode("fo", true), "Zm8");
+}
+
+TEST(Base64, Decode)
+{
+	EXPECT_EQ(Decode(""), "");
+	EXPECT_EQ(Decode("Zg=="), "f");
+	EXPECT_EQ(Decode("Zg"), "f");
+	EXPECT_EQ(Decode("Zm8="), "fo");
+	EXPECT_EQ(Decode("Zm8"), "fo");
+	EXPECT_EQ(Decode("Zm9vYmFy"), "foobar");
+	EXPECT_EQ(Decode("+//+"), "\xfb\xff\xfe");
+	EXPECT_EQ(Decode("-__-"), "\xfb\xff\xfe");
+
+	EXPECT_EQ(Decode("Z"), "ERROR");
+	EXPECT_EQ(Decode("Zg="), "ERROR");
+	EXPECT_EQ(Decode("Z==="), "ERROR");
+	EXPECT_EQ(Decode("===="), "ERROR");
+	EXPECT_EQ(Decode("Zm9v YmFy"), "ERROR");
+	EXPECT_EQ(Decode("Zm9v\nYmFy"), "ERROR");
+}
+
+/**
+ * Compare the (vectorized) encoder with the scalar one and verify
+ * the round trip for all lengths.
+ */
+TEST(Base64, Random)
+{
+	std::mt19937 rng(42);
+
+	uint8_t src[256], decoded[256];
+	char a[CalculateBase64OutputSize(sizeof(src))];
+	char b[sizeof(a)];
+
+	for (size_t size = 0; size <= sizeof(src); ++size) {
+		for (size_t i = 0; i < size; ++i)
+			src[i] = rng();
+
+		const size_t length = EncodeBase64(a, {src, size});
+		ASSERT_EQ(length, CalculateBase64OutputSize(size));
+		ASSERT_EQ(EncodeBase64Scalar(b, {src, size}), length);
+		ASSERT_EQ(memcmp(a, b, length), 0);
+
+		ASSERT_EQ(DecodeBase64(decoded, {a, length}), ssize_t(size));
+		ASSERT_EQ(memcmp(decoded, src, size), 0);
+
+		/* the URL-safe variant is the same without padding
+		   and with a different alphabet */
+		const size_t url_length = EncodeUrlSafeBase64(b, {src, size});
+		ASSERT_EQ(url_length, (size * 4 + 2) / 3);
+		for (size_t i = 0; i < url_length; ++i)
+			ASSERT_EQ(b[i], a[i] == '+' ? '-' : a[i] == '/' ? '_' : a[i]);
+
+		ASSERT_EQ(DecodeBase64(decoded, {b, url_length}), ssize_t(size));
+		ASSERT_EQ(memcmp(decoded, src, size), 0);
+	}
+}
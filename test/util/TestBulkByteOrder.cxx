@@ -0,0 +1,142 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/BulkByteOrder.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+static uint8_t input[256 + 16];
+
+static const uint8_t *
+GetInput() noexcept
+{
+	if (input[1] == 0)
+		for (size_t i = 0; i < sizeof(input); ++i)
+			input[i] = uint8_t(i * 7 + 1);
+	return input;
+}
+
+TEST(BulkByteOrder, Scalar)
+{
+	const uint8_t data[] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+
+	EXPECT_EQ(LoadBE16(data + 1), 0x0203);
+	EXPECT_EQ(LoadLE16(data + 1), 0x0302);
+	EXPECT_EQ(LoadBE32(data + 1), 0x02030405u);
+	EXPECT_EQ(LoadLE32(data + 1), 0x05040302u);
+	EXPECT_EQ(LoadBE64(data + 1), 0x0203040506070809ull);
+	EXPECT_EQ(LoadLE64(data + 1), 0x0908070605040302ull);
+
+	uint8_t buffer[9] = {};
+	StoreBE32(buffer + 1, 0x01020304);
+	EXPECT_EQ(memcmp(buffer + 1, data, 4), 0);
+	StoreLE16(buffer + 3, 0x0201);
+	EXPECT_EQ(memcmp(buffer + 3, data, 2), 0);
+	StoreBE64(buffer + 1, 0x0102030405060708ull);
+	EXPECT_EQ(memcmp(buffer + 1, data, 8), 0);
+}
+
+template<typename T, typename F, typename S>
+static void
+CheckArray(F bulk, S scalar)
+{
+	const uint8_t *src = GetInput();
+	const size_t max = 256 / sizeof(T);
+
+	for (size_t offset = 0; offset < 8; ++offset) {
+		for (size_t n = 0; n <= max; ++n) {
+			uint8_t dest[256 + 16];
+			memset(dest, 0xaa, sizeof(dest));
+			bulk(dest + offset, src + offset, n);
+
+			for (size_t i = 0; i < n; ++i)
+				ASSERT_EQ(LoadUnaligned<T>(dest + offset + i * sizeof(T)),
+					  scalar(LoadUnaligned<T>(src + offset + i * sizeof(T))));
+
+			/* nothing after the last element was touched */
+			ASSERT_EQ(dest[offset + n * sizeof(T)], 0xaa);
+		}
+	}
+}
+
+TEST(BulkByteOrder, Swap)
+{
+	CheckArray<uint16_t>(ByteSwapArray16, ByteSwap16);
+	CheckArray<uint32_t>(ByteSwapArray32, ByteSwap32);
+	CheckArray<uint64_t>(ByteSwapArray64, ByteSwap64);
+}
+
+TEST(BulkByteOrder, InPlace)
+{
+	uint8_t buffer[200];
+	memcpy(buffer, GetInput(), sizeof(buffer));
+
+	ByteSwapArray32(buffer + 1, buffer + 1, 49);
+	for (size_t i = 0; i < 49; ++i)
+		ASSERT_EQ(LoadUnaligned<uint32_t>(buffer + 1 + i * 4),
+			  ByteSwap32(LoadUnaligned<uint32_t>(GetInput() + 1 + i * 4)));
+	ASSERT_EQ(buffer[0], GetInput()[0]);
+	ASSERT_EQ(buffer[197], GetInput()[197]);
+}
+
+TEST(BulkByteOrder, LoadStore)
+{
+	const uint8_t *src = GetInput();
+
+	uint16_t a16[37];
+	LoadBE16Array(a16, src + 1, 37);
+	for (size_t i = 0; i < 37; ++i)
+		ASSERT_EQ(a16[i], LoadBE16(src + 1 + i * 2));
+
+	LoadLE16Array(a16, src + 1, 37);
+	for (size_t i = 0; i < 37; ++i)
+		ASSERT_EQ(a16[i], LoadLE16(src + 1 + i * 2));
+
+	uint32_t a32[19];
+	LoadBE32Array(a32, src + 3, 19);
+	for (size_t i = 0; i < 19; ++i)
+		ASSERT_EQ(a32[i], LoadBE32(src + 3 + i * 4));
+
+	uint64_t a64[11];
+	LoadBE64Array(a64, src + 5, 11);
+	for (size_t i = 0; i < 11; ++i)
+		ASSERT_EQ(a64[i], LoadBE64(src + 5 + i * 8));
+
+	uint8_t out[100];
+	StoreBE64Array(out + 1, a64, 11);
+	ASSERT_EQ(memcmp(out + 1, src + 5, 88), 0);
+
+	LoadLE32Array(a32, src, 19);
+	StoreLE32Array(out + 3, a32, 19);
+	ASSERT_EQ(memcmp(out + 3, src, 76), 0);
+}
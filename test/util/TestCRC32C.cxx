@@ -0,0 +1,77 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/CRC32C.hxx"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include <string.h>
+
+TEST(CRC32C, Known)
+{
+	ASSERT_EQ(CRC32C("", 0), 0u);
+	ASSERT_EQ(CRC32CSoftware("", 0), 0u);
+
+	/* the "check" value of the CRC-32C specification */
+	ASSERT_EQ(CRC32C("123456789", 9), 0xe3069283u);
+	ASSERT_EQ(CRC32CSoftware("123456789", 9), 0xe3069283u);
+
+	/* RFC 3720 B.4: 32 bytes of zeroes */
+	const uint8_t zeroes[32]{};
+	ASSERT_EQ(CRC32C(zeroes, sizeof(zeroes)), 0x8a9136aau);
+}
+
+TEST(CRC32C, Incremental)
+{
+	const char *s = "The quick brown fox jumps over the lazy dog";
+	const size_t length = strlen(s);
+	const uint32_t expected = CRC32C(s, length);
+
+	for (size_t i = 0; i <= length; ++i)
+		ASSERT_EQ(CRC32C(s + i, length - i, CRC32C(s, i)), expected);
+}
+
+TEST(CRC32C, Random)
+{
+	std::mt19937 rng(42);
+	uint8_t buffer[1024 + 7];
+	for (auto &i : buffer)
+		i = rng();
+
+	/* all lengths and alignments */
+	for (size_t offset = 0; offset < 8; ++offset)
+		for (size_t size = 0; size + offset <= sizeof(buffer); size += 13)
+			ASSERT_EQ(CRC32C(buffer + offset, size),
+				  CRC32CSoftware(buffer + offset, size));
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/Cache.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+template<typename C>
+static bool
+Contains(C &cache, const std::string &key)
+{
+	return cache.Get(key) != nullptr;
+}
+
+template<typename C>
+static unsigned
+Count(const C &cache)
+{
+	unsigned n = 0;
+	cache.ForEach([&n](const std::string &, int){ ++n; });
+	return n;
+}
+
+TEST(Cache, Lru)
+{
+	Cache<std::string, int, 4, 7> cache;
+
+	cache.Put("a", 1);
+	cache.Put("b", 2);
+	cache.Put("c", 3);
+	cache.Put("d", 4);
+	EXPECT_TRUE(cache.IsFull());
+	EXPECT_EQ(*cache.PeekOldest(), 1);
+
+	/* "a" becomes the most recently used one */
+	EXPECT_EQ(*cache.Get("a"), 1);
+	EXPECT_EQ(*cache.PeekOldest(), 2);
+
+	/* Peek() doesn't change the order */
+	EXPECT_EQ(*cache.Peek("b"), 2);
+	EXPECT_EQ(*cache.PeekOldest(), 2);
+
+	cache.Put("e", 5);
+	EXPECT_FALSE(Contains(cache, "b"));
+	EXPECT_TRUE(Contains(cache, "a"));
+	EXPECT_EQ(Count(cache), 4u);
+
+	cache.Remove("a");
+	cache.RemoveIf([](const std::string &key, int){
+			return key == "c";
+		});
+	EXPECT_EQ(Count(cache), 2u);
+
+	cache.Clear();
+	EXPECT_TRUE(cache.IsEmpty());
+}
+
+TEST(Cache, Slru)
+{
+	Cache<std::string, int, 10, 7,
+	      std::hash<std::string>, std::equal_to<std::string>,
+	      CacheSlruPolicy<50>> cache;
+
+	/* a hot set which is accessed repeatedly */
+	for (int i = 0; i < 5; ++i) {
+		const std::string key = "hot" + std::to_string(i);
+		cache.Put(key, i);
+		EXPECT_TRUE(Contains(cache, key));
+	}
+
+	/* a scan over many cold keys must not flush the hot set */
+	for (int i = 0; i < 100; ++i)
+		cache.PutOrReplace("cold" + std::to_string(i), i);
+
+	EXPECT_TRUE(cache.IsFull());
+	EXPECT_EQ(Count(cache), 10u);
+
+	for (int i = 0; i < 5; ++i)
+		EXPECT_EQ(*cache.Peek("hot" + std::to_string(i)), i);
+
+	EXPECT_NE(cache.Peek("cold99"), nullptr);
+	EXPECT_EQ(cache.Peek("cold0"), nullptr);
+
+	/* promoting more items than fit into the protected segment
+	   demotes the oldest protected item, which can then be
+	   evicted */
+	EXPECT_TRUE(Contains(cache, "cold99"));
+	for (int i = 0; i < 5; ++i)
+		cache.Put("x" + std::to_string(i), i);
+	EXPECT_EQ(cache.Peek("hot0"), nullptr);
+	EXPECT_NE(cache.Peek("hot1"), nullptr);
+	EXPECT_NE(cache.Peek("cold99"), nullptr);
+
+	/* removing protected and probationary items */
+	cache.Remove("cold99");
+	cache.RemoveIf([](const std::string &key, int){
+			return key.compare(0, 3, "hot") == 0;
+		});
+	EXPECT_EQ(Count(cache), 5u);
+
+	for (int i = 0; i < 100; ++i)
+		cache.PutOrReplace("new" + std::to_string(i), i);
+	EXPECT_EQ(Count(cache), 10u);
+
+	cache.Clear();
+	EXPECT_TRUE(cache.IsEmpty());
+}
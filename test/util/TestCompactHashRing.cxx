@@ -0,0 +1,166 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/CompactHashRing.hxx"
+#include "util/HashRing.hxx"
+
+#include <gtest/gtest.h>
+
+#include <array>
+
+namespace {
+
+struct Node {
+	unsigned id;
+};
+
+struct NodeHasher {
+	size_t operator()(const Node &node, size_t replica) const {
+		uint64_t h = (uint64_t(node.id) << 16 | replica) * 0x9e3779b97f4a7c15ULL;
+		return size_t(h ^ (h >> 31));
+	}
+};
+
+}
+
+static constexpr size_t N_BUCKETS = 65536, N_REPLICAS = 16;
+
+typedef CompactHashRing<const Node, size_t, N_BUCKETS, N_REPLICAS> TestRing;
+
+template<typename A, typename B>
+static void
+ExpectEqualRings(const A &a, const B &b)
+{
+	for (size_t h = 0; h < N_BUCKETS; ++h)
+		ASSERT_EQ(a.Pick(h).id, b.Pick(h).id) << "bucket " << h;
+}
+
+TEST(CompactHashRing, Small)
+{
+	struct SmallHasher {
+		unsigned operator()(const Node &node, size_t replica) const {
+			return node.id + replica * 7;
+		}
+	};
+
+	CompactHashRing<const Node, unsigned, 16, 2, uint8_t> hr;
+	EXPECT_TRUE(hr.IsEmpty());
+
+	/* same as HashRingTest.OneReplica */
+	static constexpr std::array<Node, 3> nodes{{{2}, {42}, {4711}}};
+	hr.Build(nodes, SmallHasher());
+	EXPECT_FALSE(hr.IsEmpty());
+
+	ASSERT_EQ(&hr.Pick(0), &nodes[2]);
+	ASSERT_EQ(&hr.Pick(1), &nodes[1]);
+	ASSERT_EQ(&hr.Pick(2), &nodes[0]);
+	ASSERT_EQ(&hr.Pick(8), &nodes[2]);
+	ASSERT_EQ(&hr.Pick(9), &nodes[0]);
+	ASSERT_EQ(&hr.Pick(10), &nodes[1]);
+	ASSERT_EQ(&hr.Pick(14), &nodes[2]);
+	ASSERT_EQ(&hr.FindNext(0).second, &nodes[1]);
+
+	/* removing and re-adding a node restores the ring */
+	hr.RemoveNode(nodes[1], SmallHasher());
+	ASSERT_EQ(&hr.Pick(0), &nodes[2]);
+	ASSERT_EQ(&hr.Pick(1), &nodes[2]);
+	ASSERT_EQ(&hr.Pick(10), &nodes[0]);
+	ASSERT_EQ(&hr.Pick(13), &nodes[0]);
+
+	hr.AddNode(nodes[1], SmallHasher());
+	ASSERT_EQ(&hr.Pick(1), &nodes[1]);
+	ASSERT_EQ(&hr.Pick(10), &nodes[1]);
+
+	/* removing all nodes */
+	hr.RemoveNode(nodes[0], SmallHasher());
+	hr.RemoveNode(nodes[1], SmallHasher());
+	for (unsigned h = 0; h < 16; ++h)
+		ASSERT_EQ(&hr.Pick(h), &nodes[2]);
+
+	hr.RemoveNode(nodes[2], SmallHasher());
+	EXPECT_TRUE(hr.IsEmpty());
+}
+
+TEST(CompactHashRing, Incremental)
+{
+	std::array<Node, 50> nodes;
+	for (unsigned i = 0; i < nodes.size(); ++i)
+		nodes[i].id = i;
+
+	static TestRing a, b;
+	a.Build(nodes, NodeHasher());
+
+	/* remove some nodes incrementally and compare with a full
+	   rebuild */
+	std::array<Node, 45> remaining;
+	unsigned n = 0;
+	for (unsigned i = 0; i < nodes.size(); ++i) {
+		if (i % 10 == 3)
+			a.RemoveNode(nodes[i], NodeHasher());
+		else
+			remaining[n++] = nodes[i];
+	}
+
+	ASSERT_EQ(n, remaining.size());
+	b.Build(remaining, NodeHasher());
+	ExpectEqualRings(a, b);
+
+	/* add them back */
+	for (unsigned i = 3; i < nodes.size(); i += 10)
+		a.AddNode(nodes[i], NodeHasher());
+
+	static TestRing c;
+	c.Build(nodes, NodeHasher());
+	ExpectEqualRings(a, c);
+}
+
+TEST(CompactHashRing, SameAsHashRing)
+{
+	std::array<Node, 20> nodes;
+	for (unsigned i = 0; i < nodes.size(); ++i)
+		nodes[i].id = i;
+
+	static TestRing a;
+	a.Build(nodes, NodeHasher());
+
+	static HashRing<const Node, size_t, N_BUCKETS, N_REPLICAS> b;
+	b.Build(nodes, NodeHasher());
+
+	/* both produce the same ring, except where two replicas
+	   collide (HashRing lets the last one win) */
+	size_t n_different = 0;
+	for (size_t h = 0; h < N_BUCKETS; ++h)
+		if (a.Pick(h).id != b.Pick(h).id)
+			++n_different;
+
+	EXPECT_LT(n_different, N_BUCKETS / 100);
+}
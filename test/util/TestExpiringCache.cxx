@@ -0,0 +1,126 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/ExpiringCache.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using std::chrono::seconds;
+
+typedef ExpiringCache<std::string, std::string, 8, 7> TestCache;
+
+static Expiry
+At(unsigned s)
+{
+	static const Expiry start = Expiry::Now();
+	return Expiry::Touched(start, seconds(s));
+}
+
+TEST(ExpiringCache, Expiry)
+{
+	TestCache cache(1000);
+
+	ASSERT_NE(cache.Put("a", "A", 1, At(10)), nullptr);
+	ASSERT_NE(cache.Put("b", "B", 1, At(20)), nullptr);
+	ASSERT_NE(cache.Put("c", "C", 1, At(30)), nullptr);
+	EXPECT_EQ(cache.GetCost(), 3u);
+	EXPECT_TRUE(cache.GetNextExpiry() == At(10));
+
+	EXPECT_EQ(*cache.Get("a", At(5)), "A");
+
+	/* lazy expiry */
+	EXPECT_EQ(cache.Get("a", At(10)), nullptr);
+	EXPECT_EQ(cache.GetCost(), 2u);
+	EXPECT_TRUE(cache.GetNextExpiry() == At(20));
+
+	/* replacing an item updates its expiry */
+	cache.Put("b", "B2", 2, At(40));
+	EXPECT_EQ(cache.GetCost(), 3u);
+	EXPECT_TRUE(cache.GetNextExpiry() == At(30));
+
+	/* incremental sweeping */
+	cache.Put("d", "D", 1, At(31));
+	cache.Put("e", "E", 1, At(32));
+	EXPECT_EQ(cache.Sweep(At(0), 10), 0u);
+	EXPECT_EQ(cache.Sweep(At(35), 2), 2u);
+	EXPECT_EQ(cache.Sweep(At(35), 2), 1u);
+	EXPECT_EQ(cache.Sweep(At(35), 2), 0u);
+	EXPECT_EQ(cache.GetCost(), 2u);
+	EXPECT_EQ(*cache.Get("b", At(35)), "B2");
+
+	EXPECT_EQ(cache.Sweep(At(100), 10), 1u);
+	EXPECT_TRUE(cache.IsEmpty());
+	EXPECT_EQ(cache.GetCost(), 0u);
+	EXPECT_TRUE(cache.GetNextExpiry() == Expiry::Never());
+}
+
+TEST(ExpiringCache, Cost)
+{
+	TestCache cache(100);
+
+	cache.Put("a", "A", 40, Expiry::Never());
+	cache.Put("b", "B", 40, Expiry::Never());
+	EXPECT_EQ(cache.GetCost(), 80u);
+
+	/* doesn't fit: evicts the least recently used item */
+	EXPECT_NE(cache.Get("a", At(0)), nullptr);
+	cache.Put("c", "C", 30, Expiry::Never());
+	EXPECT_EQ(cache.GetCost(), 70u);
+	EXPECT_EQ(cache.Get("b", At(0)), nullptr);
+	EXPECT_NE(cache.Get("a", At(0)), nullptr);
+
+	/* larger than the whole budget: rejected */
+	EXPECT_EQ(cache.Put("huge", "H", 101, Expiry::Never()), nullptr);
+	EXPECT_EQ(cache.GetCost(), 70u);
+
+	/* many small items: limited by the item count */
+	for (unsigned i = 0; i < 20; ++i)
+		cache.Put(std::to_string(i), "x", 1, Expiry::Never());
+	unsigned n = 0;
+	cache.ForEach([&n](const std::string &, const std::string &){ ++n; });
+	EXPECT_EQ(n, 8u);
+	EXPECT_LE(cache.GetCost(), 100u);
+
+	EXPECT_TRUE(cache.Remove("19"));
+	EXPECT_FALSE(cache.Remove("19"));
+	cache.RemoveIf([](const std::string &key, const std::string &){
+			return key == "18";
+		});
+	cache.RemoveItem(*cache.Get("17", At(0)));
+	EXPECT_EQ(cache.GetCost(), 5u);
+
+	cache.Clear();
+	EXPECT_TRUE(cache.IsEmpty());
+	EXPECT_EQ(cache.GetCost(), 0u);
+}
@@ -60,3 +60,13 @@ TEST(FNVHash, u64)
 	EXPECT_EQ(FNV1aHash64("a"), 0xaf63dc4c8601ec8c);
 	EXPECT_EQ(FNV1aHash64("foobar"), 0x85944171f73967e8);
 }
+
+TEST(FNVHash, Binary)
+{
+	EXPECT_EQ(FNV1aHash32(nullptr, 0), 2166136261u);
+	EXPECT_EQ(FNV1aHash32("foobar", 6), 0xbf9cf968);
+	EXPECT_EQ(FNV1aHash64("foobar", 6), 0x85944171f73967e8);
+
+	/* null bytes are hashed, too */
+	EXPECT_NE(FNV1aHash32("a\0b", 3), FNV1aHash32("a", 1));
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/FlatMap.hxx"
+#include "util/StaticArray.hxx"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <string>
+
+TEST(FlatMap, Basic)
+{
+	FlatMap<std::string, int, std::less<>> m;
+	EXPECT_TRUE(m.empty());
+
+	EXPECT_TRUE(m.emplace("memory", 1).second);
+	EXPECT_TRUE(m.emplace("cpu", 2).second);
+	EXPECT_FALSE(m.emplace("memory", 3).second);
+	EXPECT_TRUE(m.insert({"pids", 4}).second);
+	EXPECT_EQ(m.size(), 3u);
+
+	EXPECT_EQ(m.begin()->first, "cpu");
+
+	auto i = m.find("memory");
+	ASSERT_NE(i, m.end());
+	EXPECT_EQ(i->second, 1);
+	i->second = 5;
+	EXPECT_EQ(m.find(std::string("memory"))->second, 5);
+
+	EXPECT_EQ(m.find("io"), m.end());
+	EXPECT_FALSE(m.contains("io"));
+
+	m["io"] = 6;
+	++m["io"];
+	EXPECT_EQ(m.find("io")->second, 7);
+	EXPECT_EQ(m.size(), 4u);
+
+	EXPECT_EQ(m.erase("cpu"), 1u);
+	EXPECT_EQ(m.erase("cpu"), 0u);
+	EXPECT_EQ(m.begin()->first, "io");
+}
+
+TEST(FlatMap, Inline)
+{
+	FlatMap<int, int, std::less<int>,
+		StaticArray<std::pair<int, int>, 4>> m{{3, 30}, {1, 10}, {2, 20}};
+
+	ASSERT_EQ(m.size(), 3u);
+	EXPECT_EQ(m.begin()->first, 1);
+	EXPECT_EQ(m.find(2)->second, 20);
+	EXPECT_EQ(m.find(4), m.end());
+}
+
+TEST(FlatMap, Random)
+{
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<int> dist(0, 200);
+
+	FlatMap<int, int> m;
+	std::map<int, int> reference;
+
+	for (int i = 0; i < 2000; ++i) {
+		const int key = dist(rng);
+		if (i % 3 == 2)
+			ASSERT_EQ(m.erase(key), reference.erase(key));
+		else
+			ASSERT_EQ(m.emplace(key, i).second,
+				  reference.emplace(key, i).second);
+
+		const auto j = m.find(key);
+		const auto k = reference.find(key);
+		ASSERT_EQ(j == m.end(), k == reference.end());
+		if (j != m.end()) {
+			ASSERT_EQ(j->second, k->second);
+		}
+	}
+
+	ASSERT_EQ(m.size(), reference.size());
+	EXPECT_TRUE(std::equal(m.begin(), m.end(), reference.begin(),
+			       [](const std::pair<int, int> &a,
+				  const std::pair<const int, int> &b){
+				       return a.first == b.first &&
+					       a.second == b.second;
+			       }));
+}
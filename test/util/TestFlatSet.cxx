@@ -0,0 +1,109 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/FlatSet.hxx"
+#include "util/StaticArray.hxx"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <set>
+
+TEST(FlatSet, Basic)
+{
+	FlatSet<unsigned> s;
+	EXPECT_TRUE(s.empty());
+	EXPECT_EQ(s.find(1), s.end());
+
+	EXPECT_TRUE(s.insert(3).second);
+	EXPECT_TRUE(s.insert(1).second);
+	EXPECT_TRUE(s.insert(2).second);
+	EXPECT_FALSE(s.insert(2).second);
+	EXPECT_EQ(s.size(), 3u);
+
+	const unsigned expected[] = {1, 2, 3};
+	EXPECT_TRUE(std::equal(s.begin(), s.end(), std::begin(expected)));
+
+	EXPECT_TRUE(s.contains(2));
+	EXPECT_FALSE(s.contains(4));
+	EXPECT_EQ(*s.lower_bound(0), 1u);
+	EXPECT_EQ(s.lower_bound(4), s.end());
+
+	EXPECT_EQ(s.erase(2), 1u);
+	EXPECT_EQ(s.erase(2), 0u);
+	EXPECT_EQ(s.size(), 2u);
+	EXPECT_EQ(*s.erase(s.begin()), 3u);
+	EXPECT_EQ(s.size(), 1u);
+}
+
+TEST(FlatSet, InitializerList)
+{
+	const FlatSet<int> s{5, -1, 3, 5, 0};
+	const int expected[] = {-1, 0, 3, 5};
+	ASSERT_EQ(s.size(), 4u);
+	EXPECT_TRUE(std::equal(s.begin(), s.end(), std::begin(expected)));
+}
+
+TEST(FlatSet, Inline)
+{
+	FlatSet<unsigned, std::less<unsigned>, StaticArray<unsigned, 8>> s;
+	for (unsigned i : {7, 3, 5, 3, 0, 7})
+		s.insert(i);
+
+	const unsigned expected[] = {0, 3, 5, 7};
+	ASSERT_EQ(s.size(), 4u);
+	EXPECT_TRUE(std::equal(s.begin(), s.end(), std::begin(expected)));
+	EXPECT_TRUE(s.contains(5));
+	EXPECT_FALSE(s.contains(4));
+}
+
+TEST(FlatSet, Random)
+{
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<int> dist(0, 200);
+
+	FlatSet<int> s;
+	std::set<int> reference;
+
+	for (unsigned i = 0; i < 2000; ++i) {
+		const int value = dist(rng);
+		if (i % 3 == 2)
+			ASSERT_EQ(s.erase(value), reference.erase(value));
+		else
+			ASSERT_EQ(s.insert(value).second,
+				  reference.insert(value).second);
+
+		ASSERT_EQ(s.contains(value), reference.count(value) > 0);
+	}
+
+	ASSERT_EQ(s.size(), reference.size());
+	EXPECT_TRUE(std::equal(s.begin(), s.end(), reference.begin()));
+}
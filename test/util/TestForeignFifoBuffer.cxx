@@ -0,0 +1,90 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/ForeignFifoBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+TEST(ForeignFifoBuffer, Basic)
+{
+	char data[16];
+	ForeignFifoBuffer<char> buffer(data, sizeof(data));
+	EXPECT_TRUE(buffer.IsEmpty());
+	EXPECT_FALSE(buffer.IsFull());
+
+	auto w = buffer.Write();
+	EXPECT_EQ(w.data, data);
+	EXPECT_EQ(w.size, sizeof(data));
+
+	buffer.Append(16);
+	EXPECT_TRUE(buffer.IsFull());
+	EXPECT_TRUE(buffer.Write().empty());
+
+	buffer.Consume(4);
+	EXPECT_EQ(buffer.GetAvailable(), 12u);
+
+	/* no room after the tail: Write() shifts */
+	w = buffer.Write();
+	EXPECT_EQ(w.data, data + 12);
+	EXPECT_EQ(w.size, 4u);
+	EXPECT_EQ(buffer.Read().data, data);
+}
+
+TEST(ForeignFifoBuffer, WriteCompact)
+{
+	char data[16];
+	ForeignFifoBuffer<char> buffer(data, sizeof(data));
+
+	buffer.Append(14);
+	buffer.Consume(10);
+
+	/* 4 bytes left, 10 free before the head, 2 after the tail:
+	   WriteCompact() shifts */
+	auto w = buffer.WriteCompact();
+	EXPECT_EQ(w.data, data + 4);
+	EXPECT_EQ(w.size, 12u);
+	EXPECT_EQ(buffer.Read().data, data);
+	EXPECT_EQ(buffer.GetAvailable(), 4u);
+
+	/* shifting would move more than it gains: no shift */
+	buffer.Append(8);
+	buffer.Consume(2);
+	w = buffer.WriteCompact();
+	EXPECT_EQ(w.data, data + 12);
+	EXPECT_EQ(w.size, 4u);
+
+	/* empty buffer: rewind */
+	buffer.Consume(buffer.GetAvailable());
+	w = buffer.WriteCompact();
+	EXPECT_EQ(w.data, data);
+	EXPECT_EQ(w.size, sizeof(data));
+}
@@ -120,3 +120,35 @@ TEST(HashRingTest, OneReplica)
     ASSERT_EQ(&hr.FindNext(14).second, &nodes[1]);
     ASSERT_EQ(&hr.FindNext(15).second, &nodes[1]);
 }
+
+TEST(HashRingTest, Weighted)
+{
+    struct Node {
+        unsigned hash;
+        unsigned weight;
+    };
+
+    struct NodeHasher {
+        unsigned operator()(const Node &node, size_t replica) const {
+            return node.hash + replica * 7;
+        }
+    };
+
+    HashRing<const Node, unsigned, 16, 1> hr;
+
+    /* node 1 is disabled; node 2 gets two replicas (4711 and
+       4718) */
+    static constexpr std::array<Node, 3> nodes{{{2, 1}, {42, 0}, {4711, 2}}};
+    hr.Build(nodes, NodeHasher(), [](const Node &node){
+        return node.weight;
+    });
+
+    ASSERT_EQ(&hr.Pick(0), &nodes[2]);
+    ASSERT_EQ(&hr.Pick(1), &nodes[2]);
+    ASSERT_EQ(&hr.Pick(2), &nodes[0]);
+    ASSERT_EQ(&hr.Pick(6), &nodes[0]);
+    ASSERT_EQ(&hr.Pick(7), &nodes[2]);
+    ASSERT_EQ(&hr.Pick(13), &nodes[2]);
+    ASSERT_EQ(&hr.Pick(14), &nodes[2]);
+    ASSERT_EQ(&hr.Pick(15), &nodes[2]);
+}
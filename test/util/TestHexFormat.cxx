@@ -0,0 +1,85 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/HexFormat.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+TEST(HexFormat, Format)
+{
+	char buffer[64];
+	EXPECT_EQ(format_hex(buffer, "", 0), buffer);
+
+	*format_hex(buffer, "\x01\xab\xff", 3) = 0;
+	EXPECT_STREQ(buffer, "01abff");
+
+	*format_hex(buffer, "0123456789abcdefXYZ", 19) = 0;
+	EXPECT_STREQ(buffer, "303132333435363738396162636465665859" "5a");
+}
+
+TEST(HexFormat, Parse)
+{
+	uint8_t buffer[8];
+	EXPECT_TRUE(parse_hex(buffer, "", 0));
+
+	EXPECT_TRUE(parse_hex(buffer, "01aBfF", 6));
+	EXPECT_EQ(buffer[0], 0x01);
+	EXPECT_EQ(buffer[1], 0xab);
+	EXPECT_EQ(buffer[2], 0xff);
+
+	EXPECT_FALSE(parse_hex(buffer, "0", 1));
+	EXPECT_FALSE(parse_hex(buffer, "0g", 2));
+	EXPECT_FALSE(parse_hex(buffer, "0G", 2));
+	EXPECT_FALSE(parse_hex(buffer, "@0", 2));
+	EXPECT_FALSE(parse_hex(buffer, " 0", 2));
+}
+
+TEST(HexFormat, Random)
+{
+	std::mt19937 rng(42);
+
+	uint8_t src[100], parsed[100];
+	char buffer[2 * sizeof(src)], expected[2 * sizeof(src) + 1];
+
+	for (size_t size = 0; size <= sizeof(src); ++size) {
+		for (size_t i = 0; i < size; ++i) {
+			src[i] = rng();
+			sprintf(expected + 2 * i, "%02x", src[i]);
+		}
+
+		ASSERT_EQ(format_hex(buffer, src, size), buffer + 2 * size);
+		ASSERT_EQ(memcmp(buffer, expected, 2 * size), 0);
+		ASSERT_TRUE(parse_hex(parsed, buffer, 2 * size));
+		ASSERT_EQ(memcmp(parsed, src, size), 0);
+	}
+}
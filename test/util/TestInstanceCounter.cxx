@@ -0,0 +1,119 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/InstanceCounter.hxx"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+namespace {
+
+struct Foo : CountedInstance<Foo> {};
+
+struct Bar : CountedInstance<Bar> {
+	int value = 42;
+};
+
+}
+
+TEST(InstanceCounter, Disabled)
+{
+	InstanceCounter::Enable(false);
+
+	const auto &counter = Bar::GetInstanceCounter();
+	{
+		Bar a, b;
+		(void)a;
+		(void)b;
+	}
+
+	EXPECT_EQ(counter.GetLive(), 0u);
+	EXPECT_EQ(counter.GetTotal(), 0u);
+}
+
+TEST(InstanceCounter, Basic)
+{
+	InstanceCounter::Enable();
+
+	auto &counter = Foo::GetInstanceCounter();
+	EXPECT_EQ(counter.GetName(), "(anonymous namespace)::Foo");
+
+	{
+		Foo a;
+		auto b = std::make_unique<Foo>();
+		EXPECT_EQ(counter.GetLive(), 2u);
+
+		Foo c(a);
+		EXPECT_EQ(counter.GetLive(), 3u);
+		c = *b;
+		EXPECT_EQ(counter.GetLive(), 3u);
+
+		b.reset();
+		EXPECT_EQ(counter.GetLive(), 2u);
+	}
+
+	EXPECT_EQ(counter.GetLive(), 0u);
+	EXPECT_EQ(counter.GetPeak(), 3u);
+	EXPECT_EQ(counter.GetTotal(), 3u);
+
+	counter.ResetPeak();
+	EXPECT_EQ(counter.GetPeak(), 0u);
+
+	bool found = false;
+	InstanceCounter::ForEach([&](const InstanceCounter &i){
+		if (&i == &counter)
+			found = true;
+	});
+	EXPECT_TRUE(found);
+}
+
+TEST(InstanceCounter, EnabledLater)
+{
+	InstanceCounter::Enable(false);
+	auto *early = new Bar();
+
+	InstanceCounter::Enable();
+	const auto &counter = Bar::GetInstanceCounter();
+	const auto live = counter.GetLive();
+
+	{
+		Bar late;
+		EXPECT_EQ(counter.GetLive(), live + 1);
+	}
+
+	/* the object was not counted, so destroying it must not
+	   decrement the counter */
+	delete early;
+	EXPECT_EQ(counter.GetLive(), live);
+
+	InstanceCounter::Enable(false);
+}
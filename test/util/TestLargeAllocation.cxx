@@ -0,0 +1,121 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/LargeAllocation.hxx"
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <string.h>
+
+using HugePages = LargeAllocationOptions::HugePages;
+
+static void
+CheckZeroAndWrite(void *p, size_t size)
+{
+	const auto *b = (const uint8_t *)p;
+	ASSERT_EQ(b[0], 0);
+	ASSERT_EQ(b[size / 2], 0);
+	ASSERT_EQ(b[size - 1], 0);
+
+	memset(p, 0xab, size);
+}
+
+TEST(LargeAllocation, Small)
+{
+	size_t size = 1000;
+	void *p = AllocateLarge(size, {HugePages::TRANSPARENT, true});
+	ASSERT_NE(p, nullptr);
+	ASSERT_GE(size, 1000u);
+	ASSERT_EQ(size % 4096, 0u);
+	ASSERT_EQ((uintptr_t)p % 4096, 0u);
+
+	CheckZeroAndWrite(p, size);
+	FreeLarge(p, size);
+}
+
+TEST(LargeAllocation, Transparent)
+{
+	size_t size = HUGE_PAGE_SIZE + 1;
+	void *p = AllocateLarge(size);
+	ASSERT_EQ(size, 2 * HUGE_PAGE_SIZE);
+	ASSERT_EQ((uintptr_t)p % HUGE_PAGE_SIZE, 0u);
+
+	CheckZeroAndWrite(p, size);
+
+	DiscardLarge(p, size);
+	ASSERT_EQ(((const uint8_t *)p)[size - 1], 0);
+
+	FreeLarge(p, size);
+}
+
+TEST(LargeAllocation, Explicit)
+{
+	/* falls back to transparent huge pages if the hugetlb pool
+	   is empty */
+	size_t size = HUGE_PAGE_SIZE;
+	void *p = AllocateLarge(size, {HugePages::EXPLICIT, true});
+	ASSERT_EQ(size, HUGE_PAGE_SIZE);
+	ASSERT_EQ((uintptr_t)p % HUGE_PAGE_SIZE, 0u);
+
+	CheckZeroAndWrite(p, size);
+	FreeLarge(p, size);
+}
+
+TEST(LargeAllocation, NoHugePages)
+{
+	size_t size = HUGE_PAGE_SIZE + 1;
+	void *p = AllocateLarge(size, {HugePages::NONE, false});
+	ASSERT_LT(size, 2 * HUGE_PAGE_SIZE);
+	ASSERT_EQ(size % 4096, 0u);
+
+	CheckZeroAndWrite(p, size);
+	FreeLarge(p, size);
+}
+
+TEST(LargeAllocation, Wrapper)
+{
+	LargeAllocation a;
+	ASSERT_FALSE(a.IsDefined());
+
+	LargeAllocation b(10000);
+	ASSERT_TRUE(b.IsDefined());
+	ASSERT_GE(b.size(), 10000u);
+	memset(b.get(), 1, b.size());
+
+	a = std::move(b);
+	ASSERT_TRUE(a.IsDefined());
+	ASSERT_FALSE(b.IsDefined());
+
+	LargeAllocation c(std::move(a));
+	ASSERT_TRUE(c.IsDefined());
+	ASSERT_FALSE(a.IsDefined());
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/Log2Histogram.hxx"
+
+#include <gtest/gtest.h>
+
+TEST(Log2Histogram, Basic)
+{
+	Log2Histogram h;
+	EXPECT_EQ(h.GetCount(), 0u);
+
+	h.Add(std::chrono::nanoseconds(500));
+	h.Add(std::chrono::microseconds(1));
+	h.Add(std::chrono::microseconds(3));
+	h.Add(std::chrono::microseconds(4));
+	h.Add(std::chrono::hours(24 * 365));
+
+	EXPECT_EQ(h.GetCount(), 5u);
+	EXPECT_EQ(h[0], 1u);
+	EXPECT_EQ(h[1], 1u);
+	EXPECT_EQ(h[2], 1u);
+	EXPECT_EQ(h[3], 1u);
+	EXPECT_EQ(h[Log2Histogram::N_BUCKETS - 1], 1u);
+
+	EXPECT_EQ(Log2Histogram::GetBucketLimit(0), 1u);
+	EXPECT_EQ(Log2Histogram::GetBucketLimit(2), 4u);
+	EXPECT_EQ(Log2Histogram::GetBucketLimit(Log2Histogram::N_BUCKETS - 1), 0u);
+
+	h.Clear();
+	EXPECT_EQ(h.GetCount(), 0u);
+	EXPECT_EQ(h[1], 0u);
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/MaglevTable.hxx"
+#include "util/JumpHash.hxx"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <map>
+
+namespace {
+
+struct Node {
+	uint64_t hash;
+	unsigned weight;
+};
+
+struct NodeHasher {
+	uint64_t operator()(const Node &node, size_t i) const {
+		uint64_t h = (node.hash + i) * 0x9e3779b97f4a7c15ULL;
+		return h ^ (h >> 29);
+	}
+};
+
+}
+
+template<typename T, typename C>
+static std::map<const Node *, unsigned>
+CountPicks(const T &t, const C &nodes, unsigned n)
+{
+	std::map<const Node *, unsigned> result;
+	for (const auto &node : nodes)
+		result[&node] = 0;
+
+	for (unsigned i = 0; i < n; ++i)
+		++result[&t.Pick(uint64_t(i) * 2654435761u)];
+	return result;
+}
+
+TEST(MaglevTable, Distribution)
+{
+	static constexpr std::array<Node, 4> nodes{{{1, 1}, {2, 1}, {3, 1}, {4, 1}}};
+
+	MaglevTable<const Node, uint64_t, 1021> table;
+	table.Build(nodes, NodeHasher());
+
+	/* each node owns a nearly equal share of the table */
+	const auto counts = CountPicks(table, nodes, 1021);
+	for (const auto &i : counts) {
+		EXPECT_GE(i.second, 250u);
+		EXPECT_LE(i.second, 261u);
+	}
+
+	for (uint64_t h = 0; h < 100; ++h) {
+		const auto next = table.FindNext(h);
+		EXPECT_NE(&next.second, &table.Pick(h));
+	}
+}
+
+TEST(MaglevTable, Weighted)
+{
+	static constexpr std::array<Node, 3> nodes{{{1, 1}, {2, 3}, {3, 0}}};
+
+	MaglevTable<const Node, uint64_t, 1021> table;
+	table.Build(nodes, NodeHasher(), [](const Node &node){
+			return node.weight;
+		});
+
+	const auto counts = CountPicks(table, nodes, 1021);
+	EXPECT_EQ(counts.at(&nodes[2]), 0u);
+	EXPECT_GE(counts.at(&nodes[0]), 250u);
+	EXPECT_LE(counts.at(&nodes[0]), 260u);
+	EXPECT_EQ(counts.at(&nodes[0]) + counts.at(&nodes[1]), 1021u);
+}
+
+TEST(MaglevTable, Disruption)
+{
+	static constexpr std::array<Node, 5> nodes{{{1, 1}, {2, 1}, {3, 1}, {4, 1}, {5, 1}}};
+	static constexpr std::array<Node, 4> fewer{{{1, 1}, {2, 1}, {3, 1}, {4, 1}}};
+
+	MaglevTable<const Node, uint64_t, 1021> a, b;
+	a.Build(nodes, NodeHasher());
+	b.Build(fewer, NodeHasher());
+
+	/* after removing a node, only few keys of the remaining nodes
+	   move */
+	unsigned moved = 0, total = 0;
+	for (unsigned i = 0; i < 1021; ++i) {
+		const Node &x = a.Pick(i);
+		if (x.hash == 5)
+			continue;
+
+		++total;
+		if (b.Pick(i).hash != x.hash)
+			++moved;
+	}
+
+	EXPECT_LT(moved, total / 10);
+}
+
+TEST(JumpHash, Consistency)
+{
+	/* growing from n to n+1 buckets moves keys only to the new
+	   bucket */
+	for (uint32_t n = 1; n < 20; ++n) {
+		unsigned moved = 0;
+		for (uint64_t key = 0; key < 10000; ++key) {
+			const uint32_t a = JumpConsistentHash(key * 2654435761u, n);
+			const uint32_t b = JumpConsistentHash(key * 2654435761u, n + 1);
+			ASSERT_LT(a, n);
+			if (a != b) {
+				ASSERT_EQ(b, n);
+				++moved;
+			}
+		}
+
+		/* about 1/(n+1) of the keys move */
+		EXPECT_GT(moved, 10000u / (n + 1) / 2);
+		EXPECT_LT(moved, 10000u / (n + 1) * 2);
+	}
+}
+
+TEST(JumpHash, Weighted)
+{
+	static constexpr std::array<Node, 3> nodes{{{1, 1}, {2, 3}, {3, 0}}};
+
+	JumpHash<const Node, uint64_t> jh;
+	jh.Build(nodes, [](const Node &node){
+			return node.weight;
+		});
+
+	const auto counts = CountPicks(jh, nodes, 10000);
+	EXPECT_EQ(counts.at(&nodes[2]), 0u);
+	EXPECT_GT(counts.at(&nodes[0]), 2000u);
+	EXPECT_LT(counts.at(&nodes[0]), 3000u);
+
+	for (uint64_t h = 0; h < 100; ++h) {
+		const auto next = jh.FindNext(h);
+		EXPECT_NE(&next.second, &jh.Pick(h));
+	}
+
+	/* only one node */
+	static constexpr std::array<Node, 1> one{{{1, 1}}};
+	JumpHash<const Node, uint64_t> single;
+	single.Build(one);
+	EXPECT_EQ(single.FindNext(42).second.hash, 1u);
+}
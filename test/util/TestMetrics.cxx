@@ -0,0 +1,139 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/Metrics.hxx"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+TEST(Metrics, Counter)
+{
+	MetricsRegistry registry;
+	auto a = registry.AddCounter("test_requests_total", "Requests",
+				     "method=\"GET\"");
+	auto b = registry.AddCounter("test_errors_total", "Errors");
+	auto c = registry.AddCounter("test_requests_total", "Requests",
+				     "method=\"POST\"");
+
+	/* registering again returns the same counter */
+	auto a2 = registry.AddCounter("test_requests_total", "Requests",
+				      "method=\"GET\"");
+
+	++a;
+	a2.Add(2);
+	b.Add(5);
+
+	EXPECT_EQ(registry.GetValue(a), 3u);
+	EXPECT_EQ(registry.GetValue(b), 5u);
+	EXPECT_EQ(registry.GetValue(c), 0u);
+
+	EXPECT_THROW(registry.AddHistogram("test_errors_total", "Errors"),
+		     std::runtime_error);
+
+	/* the family of "test_requests_total" is contiguous */
+	EXPECT_EQ(registry.Format(),
+		  "# HELP test_requests_total Requests\n"
+		  "# TYPE test_requests_total counter\n"
+		  "test_requests_total{method=\"GET\"} 3\n"
+		  "test_requests_total{method=\"POST\"} 0\n"
+		  "# HELP test_errors_total Errors\n"
+		  "# TYPE test_errors_total counter\n"
+		  "test_errors_total 5\n");
+}
+
+TEST(Metrics, Threads)
+{
+	MetricsRegistry registry;
+	auto counter = registry.AddCounter("test_total", "Test");
+
+	static constexpr unsigned N_THREADS = 4, N = 100000;
+
+	for (unsigned round = 0; round < 3; ++round) {
+		std::vector<std::thread> threads;
+		for (unsigned i = 0; i < N_THREADS; ++i)
+			threads.emplace_back([counter](){
+				for (unsigned j = 0; j < N; ++j)
+					++counter;
+			});
+
+		/* concurrent reads are allowed */
+		EXPECT_LE(registry.GetValue(counter), N * N_THREADS * (round + 1));
+
+		for (auto &t : threads)
+			t.join();
+
+		EXPECT_EQ(registry.GetValue(counter),
+			  N * N_THREADS * (round + 1));
+	}
+}
+
+TEST(Metrics, Histogram)
+{
+	MetricsRegistry registry;
+	auto h = registry.AddHistogram("test_seconds", "Duration");
+
+	h.Add(std::chrono::microseconds(3));
+	h.Add(std::chrono::microseconds(3));
+	h.Add(std::chrono::milliseconds(1));
+
+	const auto s = registry.Format();
+	EXPECT_NE(s.find("# TYPE test_seconds histogram\n"), s.npos);
+	EXPECT_NE(s.find("test_seconds_bucket{le=\"1e-06\"} 0\n"), s.npos);
+	EXPECT_NE(s.find("test_seconds_bucket{le=\"4e-06\"} 2\n"), s.npos);
+	EXPECT_NE(s.find("test_seconds_bucket{le=\"0.001024\"} 3\n"), s.npos);
+	EXPECT_NE(s.find("test_seconds_bucket{le=\"+Inf\"} 3\n"), s.npos);
+	EXPECT_NE(s.find("test_seconds_sum 0.001006\n"), s.npos);
+	EXPECT_NE(s.find("test_seconds_count 3\n"), s.npos);
+}
+
+TEST(Metrics, Collector)
+{
+	MetricsRegistry registry;
+
+	Log2Histogram h;
+	h.Add(std::chrono::microseconds(2));
+
+	registry.AddCollector([&h](PrometheusWriter &w){
+		w.WriteHeader("test_gauge", "A gauge", "gauge");
+		w.WriteSample("test_gauge", nullptr, 0.5);
+		w.WriteHeader("test_loop_seconds", "Loop", "histogram");
+		w.WriteHistogram("test_loop_seconds", "loop=\"main\"", h);
+	});
+
+	const auto s = registry.Format();
+	EXPECT_NE(s.find("test_gauge 0.5\n"), s.npos);
+	EXPECT_NE(s.find("test_loop_seconds_bucket{loop=\"main\",le=\"2e-06\"} 0\n"), s.npos);
+	EXPECT_NE(s.find("test_loop_seconds_bucket{loop=\"main\",le=\"4e-06\"} 1\n"), s.npos);
+	EXPECT_NE(s.find("test_loop_seconds_count{loop=\"main\"} 1\n"), s.npos);
+}
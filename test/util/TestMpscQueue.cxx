@@ -0,0 +1,134 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/MpscQueue.hxx"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Item : MpscQueueHook {
+	unsigned producer, sequence;
+};
+
+}
+
+TEST(MpscQueue, Basic)
+{
+	MpscQueue<Item> q;
+	ASSERT_EQ(q.Pop(), nullptr);
+
+	Item items[4];
+	for (unsigned i = 0; i < 4; ++i) {
+		items[i].sequence = i;
+		q.Push(items[i]);
+	}
+
+	for (unsigned i = 0; i < 4; ++i) {
+		Item *item = q.Pop();
+		ASSERT_EQ(item, &items[i]);
+	}
+
+	ASSERT_EQ(q.Pop(), nullptr);
+	ASSERT_EQ(q.Pop(), nullptr);
+
+	/* reuse the items after they have been popped */
+	q.Push(items[2]);
+	ASSERT_EQ(q.Pop(), &items[2]);
+	q.Push(items[1]);
+	q.Push(items[2]);
+	ASSERT_EQ(q.Pop(), &items[1]);
+	q.Push(items[1]);
+	ASSERT_EQ(q.Pop(), &items[2]);
+	ASSERT_EQ(q.Pop(), &items[1]);
+	ASSERT_EQ(q.Pop(), nullptr);
+}
+
+TEST(MpscQueue, PopAll)
+{
+	MpscQueue<Item> q;
+	Item items[3];
+	for (auto &i : items)
+		q.Push(i);
+
+	unsigned n = 0;
+	EXPECT_EQ(q.PopAll([&](Item &item){
+		EXPECT_EQ(&item, &items[n]);
+		++n;
+	}), 3u);
+	EXPECT_EQ(n, 3u);
+}
+
+TEST(MpscQueue, Threads)
+{
+	constexpr unsigned N_PRODUCERS = 4;
+	constexpr unsigned N_ITEMS = 20000;
+
+	MpscQueue<Item> q;
+
+	std::vector<std::unique_ptr<Item[]>> items;
+	std::vector<std::thread> producers;
+	for (unsigned p = 0; p < N_PRODUCERS; ++p) {
+		items.emplace_back(new Item[N_ITEMS]);
+		Item *const array = items.back().get();
+		producers.emplace_back([&q, array, p](){
+			for (unsigned i = 0; i < N_ITEMS; ++i) {
+				array[i].producer = p;
+				array[i].sequence = i;
+				q.Push(array[i]);
+			}
+		});
+	}
+
+	unsigned next[N_PRODUCERS] = {};
+	unsigned total = 0;
+	while (total < N_PRODUCERS * N_ITEMS) {
+		Item *item = q.Pop();
+		if (item == nullptr) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		ASSERT_LT(item->producer, N_PRODUCERS);
+		ASSERT_EQ(item->sequence, next[item->producer]);
+		++next[item->producer];
+		++total;
+	}
+
+	for (auto &t : producers)
+		t.join();
+
+	ASSERT_EQ(q.Pop(), nullptr);
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/ShardedCache.hxx"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef ShardedCache<std::string, int, 4, 8, 7> TestCache;
+
+static int
+GetValue(TestCache &cache, const std::string &key)
+{
+	int result = -1;
+	cache.Get(key, [&result](int value){ result = value; });
+	return result;
+}
+
+TEST(ShardedCache, Basic)
+{
+	auto cache = std::make_unique<TestCache>();
+	EXPECT_TRUE(cache->IsEmpty());
+	EXPECT_EQ(GetValue(*cache, "a"), -1);
+
+	cache->Put("a", 1);
+	cache->Put("b", 2);
+	EXPECT_FALSE(cache->IsEmpty());
+	EXPECT_EQ(GetValue(*cache, "a"), 1);
+	EXPECT_EQ(GetValue(*cache, "b"), 2);
+
+	/* Put() replaces */
+	cache->Put("a", 3);
+	EXPECT_EQ(GetValue(*cache, "a"), 3);
+
+	/* PutIfAbsent() doesn't */
+	EXPECT_FALSE(cache->PutIfAbsent("a", 4));
+	EXPECT_EQ(GetValue(*cache, "a"), 3);
+	EXPECT_TRUE(cache->PutIfAbsent("c", 5));
+
+	int peeked = -1;
+	EXPECT_TRUE(cache->Peek("c", [&peeked](int value){ peeked = value; }));
+	EXPECT_EQ(peeked, 5);
+	EXPECT_FALSE(cache->Peek("d", [](int){ FAIL(); }));
+
+	/* Get() passes a mutable reference */
+	EXPECT_TRUE(cache->Get("c", [](int &value){ ++value; }));
+	EXPECT_EQ(GetValue(*cache, "c"), 6);
+
+	EXPECT_TRUE(cache->Remove("a"));
+	EXPECT_FALSE(cache->Remove("a"));
+	EXPECT_EQ(GetValue(*cache, "a"), -1);
+
+	unsigned n = 0;
+	cache->ForEach([&n](const std::string &, int){ ++n; });
+	EXPECT_EQ(n, 2u);
+
+	cache->RemoveIf([](const std::string &key, int){
+			return key == "b";
+		});
+	EXPECT_EQ(GetValue(*cache, "b"), -1);
+	EXPECT_EQ(GetValue(*cache, "c"), 6);
+
+	cache->Clear();
+	EXPECT_TRUE(cache->IsEmpty());
+}
+
+TEST(ShardedCache, Eviction)
+{
+	auto cache = std::make_unique<TestCache>();
+
+	/* insert more items than fit; the total must never exceed
+	   the sum of all shard sizes */
+	for (int i = 0; i < 1000; ++i)
+		cache->Put(std::to_string(i), i);
+
+	unsigned n = 0;
+	cache->ForEach([&n](const std::string &key, int value){
+			EXPECT_EQ(key, std::to_string(value));
+			++n;
+		});
+	EXPECT_LE(n, 4u * 8u);
+	EXPECT_GT(n, 0u);
+
+	/* the most recent item must still be there */
+	EXPECT_EQ(GetValue(*cache, "999"), 999);
+}
+
+TEST(ShardedCache, Threads)
+{
+	auto cache = std::make_unique<ShardedCache<int, int, 8, 64, 61>>();
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&cache, t](){
+				for (int i = 0; i < 20000; ++i) {
+					const int key = (i * 7 + t) % 300;
+					if (i % 3 == 0)
+						cache->Put(key, key * 2);
+					else if (i % 17 == 0)
+						cache->Remove(key);
+					else if (i % 2 == 0)
+						cache->Get(key, [key](int &value){
+								EXPECT_EQ(value, key * 2);
+							});
+					else
+						cache->Peek(key, [key](int value){
+								EXPECT_EQ(value, key * 2);
+							});
+				}
+			});
+	}
+
+	for (auto &i : threads)
+		i.join();
+
+	cache->ForEach([](int key, int value){
+			EXPECT_EQ(value, key * 2);
+		});
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/SharedRecycler.hxx"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Value {
+	unsigned a, b;
+
+	Value(unsigned _a, unsigned _b) noexcept:a(_a), b(_b) {}
+};
+
+}
+
+TEST(SharedRecycler, Local)
+{
+	typedef SharedRecycler<Value, 4, 0> R;
+	R::Clear();
+	const auto before = R::GetStats();
+
+	Value *v = R::Get(1, 2);
+	EXPECT_EQ(v->a, 1u);
+	EXPECT_EQ(v->b, 2u);
+	R::Put(v);
+
+	/* the same memory is reused */
+	Value *w = R::Get(3, 4);
+	EXPECT_EQ(w, v);
+	EXPECT_EQ(w->a, 3u);
+
+	/* more objects than fit into the cache */
+	std::vector<Value *> values;
+	for (unsigned i = 0; i < 10; ++i)
+		values.push_back(R::Get(i, i));
+	for (auto *i : values)
+		R::Put(i);
+	R::Put(w);
+
+	const auto after = R::GetStats();
+	EXPECT_EQ(after.local_hits - before.local_hits, 1u);
+	EXPECT_EQ(after.misses - before.misses, 11u);
+	EXPECT_EQ(after.overflows - before.overflows, 7u);
+
+	R::Clear();
+}
+
+TEST(SharedRecycler, MaxBytes)
+{
+	/* the byte limit allows only two items */
+	typedef SharedRecycler<Value, 100, 100, 2 * sizeof(Value)> R;
+	const auto before = R::GetStats();
+
+	std::vector<Value *> values;
+	for (unsigned i = 0; i < 10; ++i)
+		values.push_back(R::Get(i, i));
+	for (auto *i : values)
+		R::Put(i);
+
+	const auto after = R::GetStats();
+	EXPECT_EQ(after.overflows - before.overflows, 6u);
+
+	R::Clear();
+}
+
+TEST(SharedRecycler, CrossThread)
+{
+	/* one thread allocates, another one frees; the objects travel
+	   back through the global stack */
+	typedef SharedRecycler<Value, 16, 1024> R;
+	R::Clear();
+
+	static constexpr unsigned N = 100000;
+	std::atomic<Value *> slots[64];
+	for (auto &i : slots)
+		i.store(nullptr);
+
+	std::thread consumer([&slots](){
+			unsigned n = 0;
+			while (n < N) {
+				for (auto &i : slots) {
+					Value *v = i.exchange(nullptr);
+					if (v != nullptr) {
+						EXPECT_EQ(v->a, v->b);
+						R::Put(v);
+						++n;
+					}
+				}
+			}
+		});
+
+	for (unsigned n = 0; n < N;) {
+		for (auto &i : slots) {
+			if (n < N && i.load() == nullptr) {
+				i.store(R::Get(n, n));
+				++n;
+			}
+		}
+	}
+
+	consumer.join();
+
+	/* the consumer's statistics were merged when it exited */
+	const auto stats = R::GetStats();
+	EXPECT_EQ(stats.local_hits + stats.global_hits + stats.misses, N);
+	EXPECT_GT(stats.global_hits, 0u);
+	EXPECT_LT(stats.misses, N / 2);
+
+	R::Clear();
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/SimdString.hxx"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+static const char *
+ScalarSkipWhitespace(const char *p, const char *end)
+{
+	while (p < end && IsWhitespaceOrNull(*p))
+		++p;
+	return p;
+}
+
+static const char *
+ScalarSkipWhitespaceReverse(const char *begin, const char *end)
+{
+	while (end > begin && IsWhitespaceOrNull(end[-1]))
+		--end;
+	return end;
+}
+
+static bool
+ScalarEqualsIgnoreCaseASCII(const char *a, const char *b, size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+		if (ToLowerASCII(a[i]) != ToLowerASCII(b[i]))
+			return false;
+	return true;
+}
+
+TEST(SimdString, SkipWhitespace)
+{
+	EXPECT_EQ(SimdSkipWhitespace(nullptr, nullptr), nullptr);
+
+	static constexpr char s[] = " \t\r\n  \0 \x01\x20\x20\x20\x20\x20\x20\x20\x20\x20\x20\x20\x20\xa0x  ";
+	const char *end = s + sizeof(s) - 1;
+	EXPECT_EQ(SimdSkipWhitespace(s, end), strchr(s + 7, '\xa0'));
+	EXPECT_EQ(SimdSkipWhitespaceReverse(s, end), end - 2);
+}
+
+/**
+ * Compare with the scalar implementation on random input of all
+ * lengths and alignments.
+ */
+TEST(SimdString, Random)
+{
+	std::mt19937 rng(42);
+	static constexpr char chars[] = " \t\r\n\0\x1f\x21" "Aaz\x7f\x80\xff";
+
+	char buffer[80];
+	for (unsigned round = 0; round < 20000; ++round) {
+		const size_t offset = rng() % 8;
+		const size_t size = rng() % (sizeof(buffer) - offset);
+
+		/* mostly whitespace, so the result isn't always at
+		   the beginning */
+		for (size_t i = 0; i < size; ++i)
+			buffer[offset + i] = rng() % 16 == 0
+				? chars[rng() % (sizeof(chars) - 1)]
+				: ' ';
+
+		const char *begin = buffer + offset, *end = begin + size;
+		ASSERT_EQ(SimdSkipWhitespace(begin, end),
+			  ScalarSkipWhitespace(begin, end));
+		ASSERT_EQ(SimdSkipWhitespaceReverse(begin, end),
+			  ScalarSkipWhitespaceReverse(begin, end));
+	}
+}
+
+TEST(SimdString, FindEither)
+{
+	EXPECT_EQ(SimdFindEither(nullptr, nullptr, ',', '"'), nullptr);
+
+	std::mt19937 rng(42);
+	char buffer[80];
+	for (unsigned round = 0; round < 20000; ++round) {
+		const size_t offset = rng() % 8;
+		const size_t size = rng() % (sizeof(buffer) - offset);
+
+		for (size_t i = 0; i < size; ++i)
+			buffer[offset + i] = rng() % 32 == 0
+				? ",\"\xac"[rng() % 3]
+				: 'x';
+
+		const char *begin = buffer + offset, *end = begin + size;
+		const char *expected = begin;
+		while (expected < end && *expected != ',' && *expected != '"')
+			++expected;
+
+		ASSERT_EQ(SimdFindEither(begin, end, ',', '"'), expected);
+	}
+}
+
+TEST(SimdString, EqualsIgnoreCase)
+{
+	EXPECT_TRUE(SimdEqualsIgnoreCaseASCII("", "", 0));
+	EXPECT_TRUE(SimdEqualsIgnoreCaseASCII("Keep-Alive", "keep-alive", 10));
+	EXPECT_FALSE(SimdEqualsIgnoreCaseASCII("Keep-Alive", "keep_alive", 10));
+	EXPECT_TRUE(SimdEqualsIgnoreCaseASCII("Content-Type: Text/HTML",
+					      "content-type: text/html", 23));
+	EXPECT_FALSE(SimdEqualsIgnoreCaseASCII("Content-Type: Text/HTML",
+					       "content-type: text/htmx", 23));
+
+	/* only ASCII letters are folded */
+	EXPECT_FALSE(SimdEqualsIgnoreCaseASCII("@[`{", "`{@[", 4));
+	EXPECT_FALSE(SimdEqualsIgnoreCaseASCII("\xc0\xc1\xc2\xc3\xc4\xc5\xc6\xc7\xc8\xc9\xca\xcb\xcc\xcd\xce\xcf",
+					       "\xe0\xe1\xe2\xe3\xe4\xe5\xe6\xe7\xe8\xe9\xea\xeb\xec\xed\xee\xef",
+					       16));
+
+	/* null bytes don't terminate */
+	EXPECT_FALSE(SimdEqualsIgnoreCaseASCII("a\0b", "a\0c", 3));
+
+	std::mt19937 rng(42);
+	char a[80], b[80];
+	for (unsigned round = 0; round < 20000; ++round) {
+		const size_t size = rng() % sizeof(a);
+		for (size_t i = 0; i < size; ++i) {
+			a[i] = char(rng());
+			b[i] = rng() % 2 ? ToLowerASCII(a[i]) : a[i];
+		}
+
+		if (size > 0 && rng() % 2)
+			b[rng() % size] ^= char(1 << (rng() % 8));
+
+		ASSERT_EQ(SimdEqualsIgnoreCaseASCII(a, b, size),
+			  ScalarEqualsIgnoreCaseASCII(a, b, size));
+	}
+}
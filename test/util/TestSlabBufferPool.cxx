@@ -0,0 +1,91 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/SlabBufferPool.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <string.h>
+
+TEST(SlabBufferPool, Basic)
+{
+	SlabBufferPool pool(4096, 4);
+	EXPECT_EQ(pool.GetBufferSize(), 4096u);
+	EXPECT_EQ(pool.GetAllocatedCount(), 0u);
+	EXPECT_EQ(pool.GetFootprint(), 0u);
+
+	void *a = pool.Allocate();
+	void *b = pool.Allocate();
+	EXPECT_NE(a, b);
+	EXPECT_EQ(pool.GetAllocatedCount(), 2u);
+	EXPECT_EQ(pool.GetFootprint(), 4u * 4096u);
+
+	memset(a, 'a', 4096);
+	memset(b, 'b', 4096);
+	EXPECT_EQ(*(const char *)a, 'a');
+	EXPECT_EQ(*(const char *)b, 'b');
+
+	/* a freed buffer is recycled */
+	pool.Free(a);
+	EXPECT_EQ(pool.Allocate(), a);
+
+	pool.Free(a);
+	pool.Free(b);
+	EXPECT_EQ(pool.GetAllocatedCount(), 0u);
+
+	/* the last slab is kept as reserve */
+	EXPECT_EQ(pool.GetFootprint(), 4u * 4096u);
+
+	pool.Compress();
+	EXPECT_EQ(pool.GetFootprint(), 0u);
+}
+
+TEST(SlabBufferPool, Release)
+{
+	SlabBufferPool pool(4096, 4);
+
+	std::vector<void *> buffers;
+	for (unsigned i = 0; i < 20; ++i)
+		buffers.push_back(pool.Allocate());
+
+	EXPECT_EQ(pool.GetAllocatedCount(), 20u);
+	EXPECT_EQ(pool.GetFootprint(), 20u * 4096u);
+
+	for (auto *p : buffers)
+		pool.Free(p);
+
+	/* all slabs but the reserve have been returned */
+	EXPECT_EQ(pool.GetAllocatedCount(), 0u);
+	EXPECT_EQ(pool.GetFootprint(), 4u * 4096u);
+}
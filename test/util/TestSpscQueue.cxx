@@ -0,0 +1,107 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/SpscQueue.hxx"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+TEST(SpscQueue, Basic)
+{
+	SpscQueue<int> q(4);
+	ASSERT_EQ(q.capacity(), 4u);
+	ASSERT_EQ(q.size(), 0u);
+	ASSERT_EQ(q.Front(), nullptr);
+
+	for (int i = 0; i < 4; ++i) {
+		int *p = q.Reserve();
+		ASSERT_NE(p, nullptr);
+		*p = i;
+		q.Commit();
+	}
+
+	ASSERT_EQ(q.size(), 4u);
+	ASSERT_EQ(q.Reserve(), nullptr);
+
+	ASSERT_EQ(*q.Front(), 0);
+	q.Pop();
+	ASSERT_EQ(*q.Front(), 1);
+
+	/* wrap around */
+	*q.Reserve() = 4;
+	q.Commit();
+	ASSERT_EQ(q.Reserve(), nullptr);
+
+	for (int i = 1; i <= 4; ++i) {
+		ASSERT_EQ(*q.Front(), i);
+		q.Pop();
+	}
+
+	ASSERT_EQ(q.Front(), nullptr);
+	ASSERT_EQ(q.size(), 0u);
+}
+
+TEST(SpscQueue, Threads)
+{
+	static constexpr unsigned N = 1000000;
+
+	SpscQueue<unsigned> q(64);
+
+	std::thread producer([&q](){
+			for (unsigned i = 0; i < N;) {
+				unsigned *p = q.Reserve();
+				if (p == nullptr) {
+					std::this_thread::yield();
+					continue;
+				}
+
+				*p = i++;
+				q.Commit();
+			}
+		});
+
+	for (unsigned expected = 0; expected < N;) {
+		const unsigned *p = q.Front();
+		if (p == nullptr) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		ASSERT_EQ(*p, expected);
+		++expected;
+		q.Pop();
+	}
+
+	producer.join();
+	ASSERT_EQ(q.Front(), nullptr);
+}
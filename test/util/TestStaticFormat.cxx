@@ -0,0 +1,114 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/StaticFormat.hxx"
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+TEST(StaticFormat, Literal)
+{
+	char buffer[64];
+	EXPECT_EQ(StaticFormat(buffer, sizeof(buffer), STATIC_FORMAT("")), 0u);
+	EXPECT_STREQ(buffer, "");
+
+	EXPECT_EQ(StaticFormat(buffer, sizeof(buffer), STATIC_FORMAT("foo")), 3u);
+	EXPECT_STREQ(buffer, "foo");
+
+	StaticFormat(buffer, sizeof(buffer), STATIC_FORMAT("{{x}}{{"));
+	EXPECT_STREQ(buffer, "{x}{");
+}
+
+TEST(StaticFormat, Integers)
+{
+	char buffer[128];
+	StaticFormat(buffer, sizeof(buffer),
+		     STATIC_FORMAT("{} {} {} {} {}"),
+		     0, -1, 42u, INT64_MIN, UINT64_MAX);
+	EXPECT_STREQ(buffer, "0 -1 42 -9223372036854775808 18446744073709551615");
+
+	StaticFormat(buffer, sizeof(buffer),
+		     STATIC_FORMAT("{:x}/{:x}/{:x}"),
+		     0, 0xdeadbeefu, -1);
+	EXPECT_STREQ(buffer, "0/deadbeef/ffffffff");
+
+	const uint8_t small = 200;
+	const short negative = -300;
+	StaticFormat(buffer, sizeof(buffer), STATIC_FORMAT("{} {}"),
+		     small, negative);
+	EXPECT_STREQ(buffer, "200 -300");
+}
+
+TEST(StaticFormat, Strings)
+{
+	char buffer[128];
+	const char *null = nullptr;
+	char mutable_string[] = "mutable";
+	StaticFormat(buffer, sizeof(buffer),
+		     STATIC_FORMAT("[{}|{}|{}|{}|{}|{}|{}]"),
+		     "foo", StringView("barbaz", 3), 'c', true, false, null,
+		     mutable_string);
+	EXPECT_STREQ(buffer, "[foo|bar|c|true|false|(null)|mutable]");
+}
+
+TEST(StaticFormat, Truncate)
+{
+	char buffer[8];
+	EXPECT_EQ(StaticFormat(buffer, sizeof(buffer),
+			       STATIC_FORMAT("{}:{}"), "abcde", 12345),
+		  7u);
+	EXPECT_STREQ(buffer, "abcde:1");
+
+	EXPECT_EQ(StaticFormat(buffer, 1, STATIC_FORMAT("foo{}"), 1), 0u);
+	EXPECT_STREQ(buffer, "");
+}
+
+TEST(StaticFormat, StringBuffer)
+{
+	const auto s = StaticFormat<64>(STATIC_FORMAT("spawn:{}:{}"),
+					1234u, "name");
+	EXPECT_STREQ(s.c_str(), "spawn:1234:name");
+}
+
+TEST(StaticFormat, Count)
+{
+	using namespace StaticFormatDetail;
+
+	static_assert(CountPlaceholders("") == 0, "");
+	static_assert(CountPlaceholders("{}") == 1, "");
+	static_assert(CountPlaceholders("a{}b{:x}c") == 2, "");
+	static_assert(CountPlaceholders("{{}}") == 0, "");
+	static_assert(CountPlaceholders("{") == -1, "");
+	static_assert(CountPlaceholders("}") == -1, "");
+	static_assert(CountPlaceholders("{0}") == -1, "");
+	static_assert(CountPlaceholders("{:d}") == -1, "");
+}
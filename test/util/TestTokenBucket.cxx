@@ -0,0 +1,58 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/TokenBucket.hxx"
+
+#include <gtest/gtest.h>
+
+TEST(TokenBucket, Basic)
+{
+	TokenBucket b;
+
+	/* starts full */
+	EXPECT_TRUE(b.Check(100, 1, 3));
+	EXPECT_TRUE(b.Check(100, 1, 3));
+	EXPECT_TRUE(b.Check(100, 1, 3));
+	EXPECT_FALSE(b.Check(100, 1, 3));
+	EXPECT_DOUBLE_EQ(b.GetDelay(100, 1), 1);
+
+	/* half a token is not enough */
+	EXPECT_FALSE(b.Check(100.5, 1, 3));
+	EXPECT_DOUBLE_EQ(b.GetDelay(100.5, 1), 0.5);
+
+	EXPECT_TRUE(b.Check(101, 1, 3));
+	EXPECT_FALSE(b.Check(101, 1, 3));
+
+	/* the burst size limits accumulation */
+	EXPECT_TRUE(b.Check(1000, 1, 3, 3));
+	EXPECT_FALSE(b.Check(1000, 1, 3));
+}
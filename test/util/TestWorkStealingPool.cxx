@@ -0,0 +1,146 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/WorkStealingPool.hxx"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace {
+
+struct CountJob final : WorkStealingPool::Job {
+	std::atomic<unsigned> &counter;
+
+	explicit CountJob(std::atomic<unsigned> &_counter) noexcept
+		:counter(_counter) {}
+
+	void Run() noexcept override {
+		++counter;
+	}
+};
+
+/**
+ * A job which submits more jobs from within a worker thread.
+ */
+struct ForkJob final : WorkStealingPool::Job {
+	WorkStealingPool &pool;
+	std::atomic<unsigned> &counter;
+	std::vector<std::unique_ptr<CountJob>> children;
+
+	ForkJob(WorkStealingPool &_pool, std::atomic<unsigned> &_counter,
+		unsigned n) noexcept
+		:pool(_pool), counter(_counter) {
+		for (unsigned i = 0; i < n; ++i)
+			children.emplace_back(new CountJob(counter));
+	}
+
+	void Run() noexcept override {
+		for (auto &i : children)
+			pool.Submit(*i);
+	}
+};
+
+struct ThreadJob final : WorkStealingPool::Job {
+	std::atomic<std::thread::id> &id;
+
+	explicit ThreadJob(std::atomic<std::thread::id> &_id) noexcept
+		:id(_id) {}
+
+	void Run() noexcept override {
+		id = std::this_thread::get_id();
+	}
+};
+
+}
+
+TEST(WorkStealingPool, Basic)
+{
+	std::atomic<unsigned> counter{0};
+	std::vector<std::unique_ptr<CountJob>> jobs;
+	for (unsigned i = 0; i < 1000; ++i)
+		jobs.emplace_back(new CountJob(counter));
+
+	{
+		WorkStealingPool pool(4);
+		ASSERT_EQ(pool.size(), 4u);
+
+		for (auto &i : jobs)
+			pool.Submit(*i);
+
+		/* the destructor waits for all jobs */
+	}
+
+	ASSERT_EQ(counter, 1000u);
+}
+
+TEST(WorkStealingPool, Nested)
+{
+	std::atomic<unsigned> counter{0};
+	std::vector<std::unique_ptr<ForkJob>> jobs;
+
+	{
+		WorkStealingPool pool(3);
+
+		for (unsigned i = 0; i < 10; ++i)
+			jobs.emplace_back(new ForkJob(pool, counter, 50));
+
+		for (auto &i : jobs)
+			pool.Submit(*i);
+	}
+
+	ASSERT_EQ(counter, 500u);
+}
+
+TEST(WorkStealingPool, Threads)
+{
+	std::atomic<std::thread::id> ids[8];
+	std::vector<std::unique_ptr<ThreadJob>> jobs;
+	for (auto &i : ids)
+		jobs.emplace_back(new ThreadJob(i));
+
+	{
+		WorkStealingPool pool(2);
+		for (auto &i : jobs)
+			pool.Submit(*i);
+	}
+
+	std::set<std::thread::id> seen;
+	for (auto &i : ids) {
+		ASSERT_NE(i.load(), std::this_thread::get_id());
+		seen.insert(i.load());
+	}
+
+	ASSERT_LE(seen.size(), 2u);
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2007-2017 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/WyHash.hxx"
+
+#include <gtest/gtest.h>
+
+#include <set>
+
+#include <string.h>
+
+TEST(WyHash, Vectors)
+{
+	/* from wyhash's test_vector.cpp; the seed is the index */
+	EXPECT_EQ(WyHash64("", 0, 0), 0x93228a4de0eec5a2u);
+	EXPECT_EQ(WyHash64("a", 1, 1), 0xc5bac3db178713c4u);
+	EXPECT_EQ(WyHash64("abc", 3, 2), 0xa97f2f7b1d9b3314u);
+	EXPECT_EQ(WyHash64("message digest", 14, 3), 0x786d1f1df3801df4u);
+	EXPECT_EQ(WyHash64("abcdefghijklmnopqrstuvwxyz", 26, 4),
+		  0xdca5a8138ad37c87u);
+	EXPECT_EQ(WyHash64("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", 62, 5),
+		  0xb9e734f117cfaf70u);
+	EXPECT_EQ(WyHash64("12345678901234567890123456789012345678901234567890123456789012345678901234567890", 80, 6),
+		  0x6cc5eab49a92d617u);
+}
+
+TEST(WyHash, String)
+{
+	EXPECT_EQ(WyHash64(""), WyHash64("", 0));
+	EXPECT_EQ(WyHash64("foobar"), WyHash64("foobar", 6));
+	EXPECT_EQ(WyHash64(nullptr, 0), WyHash64(""));
+
+	/* null bytes are hashed, too */
+	EXPECT_NE(WyHash64("a\0b", 3), WyHash64("a", 1));
+
+	EXPECT_NE(WyHash64("foobar", 6, 1), WyHash64("foobar", 6));
+}
+
+TEST(WyHash, Unaligned)
+{
+	static constexpr char data[] = "http://www.example.com/some/long/path/to/a/resource.html?query=string";
+	static constexpr size_t size = sizeof(data) - 1;
+
+	char buffer[size + 8];
+	for (size_t offset = 0; offset < 8; ++offset) {
+		memcpy(buffer + offset, data, size);
+		EXPECT_EQ(WyHash64(buffer + offset, size),
+			  WyHash64(data, size));
+	}
+}
+
+/**
+ * Every length (covering all code paths) and every single-bit flip
+ * must produce a distinct hash.
+ */
+TEST(WyHash, Distinct)
+{
+	uint8_t buffer[128];
+	for (size_t i = 0; i < sizeof(buffer); ++i)
+		buffer[i] = i * 7;
+
+	std::set<uint64_t> seen;
+	for (size_t size = 0; size <= sizeof(buffer); ++size) {
+		EXPECT_TRUE(seen.insert(WyHash64(buffer, size)).second);
+
+		for (size_t bit = 0; bit < size * 8; ++bit) {
+			buffer[bit / 8] ^= 1 << (bit % 8);
+			EXPECT_TRUE(seen.insert(WyHash64(buffer, size)).second);
+			buffer[bit / 8] ^= 1 << (bit % 8);
+		}
+	}
+}
+
+/**
+ * Flipping one input bit should flip about half of the output bits.
+ */
+TEST(WyHash, Avalanche)
+{
+	char key[] = "www.site42.example.com";
+	const size_t size = sizeof(key) - 1;
+	const uint64_t h = WyHash64(key, size);
+
+	unsigned total = 0, n = 0;
+	for (size_t bit = 0; bit < size * 8; ++bit) {
+		key[bit / 8] ^= 1 << (bit % 8);
+		total += __builtin_popcountll(h ^ WyHash64(key, size));
+		++n;
+		key[bit / 8] ^= 1 << (bit % 8);
+	}
+
+	const double average = double(total) / n;
+	EXPECT_GT(average, 28);
+	EXPECT_LT(average, 36);
+}
+
+/**
+ * Similar keys must be spread evenly over a small number of buckets.
+ */
+TEST(WyHash, Buckets)
+{
+	static constexpr unsigned N_BUCKETS = 16, N_KEYS = 16000;
+	unsigned buckets[N_BUCKETS]{};
+
+	char key[64];
+	for (unsigned i = 0; i < N_KEYS; ++i) {
+		snprintf(key, sizeof(key), "/images/%u.jpg", i);
+		++buckets[WyHash64(key) % N_BUCKETS];
+	}
+
+	for (const auto n : buckets) {
+		EXPECT_GT(n, N_KEYS / N_BUCKETS * 8 / 10);
+		EXPECT_LT(n, N_KEYS / N_BUCKETS * 12 / 10);
+	}
+}